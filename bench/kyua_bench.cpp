@@ -0,0 +1,673 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// \file bench/kyua_bench.cpp
+/// Benchmark of the overhead that Kyua adds to the execution of test cases.
+///
+/// This program runs synthetic test suites built on top of the plain_helpers
+/// test program and prints the measurements as "suite.metric = value" lines so
+/// that the numbers can be tracked across releases.  The suites are:
+///
+/// * noop: many test programs whose only test case passes right away.
+/// * large_output: test programs that write lots of stdout and stderr.
+/// * include_tree: a deep chain of Kyuafiles that include each other.
+///
+/// The first two suites drive the scheduler and the store directly, mimicking
+/// the run_tests driver, to time every phase that Kyua goes through per test
+/// case: listing the test program, spawning the test, waiting for it,
+/// computing its result, storing it and cleaning up its work directory.  The
+/// last suite goes through the run_tests driver as kyua test does, including
+/// the loading of the Kyuafiles.
+///
+/// The suites to run are given as arguments, all of them by default.  The
+/// --tests, --large-tests, --output-size and --depth options control the size
+/// of the suites and --parallelism the number of tests run concurrently.
+
+extern "C" {
+#include <sys/resource.h>
+
+#include <unistd.h>
+}
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "drivers/run_tests.hpp"
+#include "engine/atf.hpp"
+#include "engine/config.hpp"
+#include "engine/filters.hpp"
+#include "engine/kyuafile.hpp"
+#include "engine/plain.hpp"
+#include "engine/scanner.hpp"
+#include "engine/scheduler.hpp"
+#include "engine/tap.hpp"
+#include "model/metadata.hpp"
+#include "model/test_case.hpp"
+#include "model/test_program.hpp"
+#include "model/test_result.hpp"
+#include "store/write_backend.hpp"
+#include "store/write_transaction.hpp"
+#include "utils/cmdline/exceptions.hpp"
+#include "utils/cmdline/options.hpp"
+#include "utils/cmdline/parser.ipp"
+#include "utils/config/tree.ipp"
+#include "utils/datetime.hpp"
+#include "utils/env.hpp"
+#include "utils/format/macros.hpp"
+#include "utils/fs/operations.hpp"
+#include "utils/fs/path.hpp"
+#include "utils/logging/operations.hpp"
+#include "utils/optional.ipp"
+#include "utils/sanity.hpp"
+
+namespace cmdline = utils::cmdline;
+namespace config = utils::config;
+namespace datetime = utils::datetime;
+namespace fs = utils::fs;
+namespace logging = utils::logging;
+namespace run_tests = drivers::run_tests;
+namespace scheduler = engine::scheduler;
+
+using utils::none;
+using utils::optional;
+
+
+namespace {
+
+
+/// Time spent computing the results of test cases since the last reset.
+///
+/// This is updated by timed_interface, which is the only way to separate this
+/// phase from the wait for the test case without instrumenting the scheduler.
+static datetime::delta compute_result_time;
+
+
+/// Interface decorator that accounts for the time spent computing results.
+class timed_interface : public scheduler::interface {
+    /// The decorated interface.
+    std::shared_ptr< scheduler::interface > _base;
+
+public:
+    /// Constructor.
+    ///
+    /// \param base The interface to decorate.
+    explicit timed_interface(
+        const std::shared_ptr< scheduler::interface > base) :
+        _base(base)
+    {
+    }
+
+    /// Executes a test program's list operation.
+    ///
+    /// \param test_program The test program to execute.
+    /// \param vars User-provided variables to pass to the test program.
+    void
+    exec_list(const model::test_program& test_program,
+              const config::properties_map& vars) const UTILS_NORETURN
+    {
+        _base->exec_list(test_program, vars);
+        UNREACHABLE;
+    }
+
+    /// Computes the test cases list of a test program.
+    ///
+    /// \param status The termination status of the listing subprocess.
+    /// \param stdout_path Path to the file containing the stdout of the list.
+    /// \param stderr_path Path to the file containing the stderr of the list.
+    ///
+    /// \return A list of test cases.
+    model::test_cases_map
+    parse_list(const optional< utils::process::status >& status,
+               const fs::path& stdout_path,
+               const fs::path& stderr_path) const
+    {
+        return _base->parse_list(status, stdout_path, stderr_path);
+    }
+
+    /// Executes a test case of the test program.
+    ///
+    /// \param test_program The test program to execute.
+    /// \param test_case_name Name of the test case to invoke.
+    /// \param vars User-provided variables to pass to the test program.
+    /// \param control_directory Directory for the control files.
+    void
+    exec_test(const model::test_program& test_program,
+              const std::string& test_case_name,
+              const config::properties_map& vars,
+              const fs::path& control_directory) const UTILS_NORETURN
+    {
+        _base->exec_test(test_program, test_case_name, vars,
+                         control_directory);
+        UNREACHABLE;
+    }
+
+    /// Executes a test cleanup routine of the test program.
+    ///
+    /// \param test_program The test program to execute.
+    /// \param test_case_name Name of the test case to invoke.
+    /// \param vars User-provided variables to pass to the test program.
+    /// \param control_directory Directory for the control files.
+    void
+    exec_cleanup(const model::test_program& test_program,
+                 const std::string& test_case_name,
+                 const config::properties_map& vars,
+                 const fs::path& control_directory) const UTILS_NORETURN
+    {
+        _base->exec_cleanup(test_program, test_case_name, vars,
+                            control_directory);
+        UNREACHABLE;
+    }
+
+    /// Computes the result of a test case and accounts for the time it takes.
+    ///
+    /// \param status The termination status of the test subprocess.
+    /// \param control_directory Directory with the control files.
+    /// \param stdout_path Path to the file containing the stdout of the test.
+    /// \param stderr_path Path to the file containing the stderr of the test.
+    ///
+    /// \return A test result.
+    model::test_result
+    compute_result(const optional< utils::process::status >& status,
+                   const fs::path& control_directory,
+                   const fs::path& stdout_path,
+                   const fs::path& stderr_path) const
+    {
+        const datetime::timestamp start = datetime::timestamp::now();
+        const model::test_result result = _base->compute_result(
+            status, control_directory, stdout_path, stderr_path);
+        compute_result_time += datetime::timestamp::now() - start;
+        return result;
+    }
+};
+
+
+/// Registers the interfaces, timing all of them.
+static void
+register_timed_interfaces(void)
+{
+    scheduler::register_interface(
+        "atf", std::shared_ptr< scheduler::interface >(new timed_interface(
+            std::shared_ptr< scheduler::interface >(
+                new engine::atf_interface()))));
+    scheduler::register_interface(
+        "plain", std::shared_ptr< scheduler::interface >(new timed_interface(
+            std::shared_ptr< scheduler::interface >(
+                new engine::plain_interface()))));
+    scheduler::register_interface(
+        "tap", std::shared_ptr< scheduler::interface >(new timed_interface(
+            std::shared_ptr< scheduler::interface >(
+                new engine::tap_interface()))));
+}
+
+
+/// Measurements of a benchmark suite.
+class measurements {
+    /// Name of the suite, used as the prefix of all metrics.
+    std::string _suite;
+
+    /// Number of test cases run.
+    std::size_t _tests;
+
+    /// Time spent in each per-test phase, keyed by the name of the phase.
+    std::map< std::string, datetime::delta > _per_test;
+
+    /// Time spent in each one-off phase, keyed by the name of the phase.
+    std::map< std::string, datetime::delta > _once;
+
+    /// Time at which the suite started.
+    datetime::timestamp _start;
+
+public:
+    /// Constructor.
+    ///
+    /// \param suite Name of the suite being measured.
+    explicit measurements(const std::string& suite) :
+        _suite(suite), _tests(0), _start(datetime::timestamp::now())
+    {
+        compute_result_time = datetime::delta();
+    }
+
+    /// Accounts for a test case that completed.
+    void
+    got_test(void)
+    {
+        ++_tests;
+    }
+
+    /// Adds time to a phase that is incurred by every test case.
+    ///
+    /// \param phase Name of the phase.
+    /// \param start Time at which the phase started; the phase ends now.
+    void
+    per_test(const std::string& phase, const datetime::timestamp& start)
+    {
+        _per_test[phase] += datetime::timestamp::now() - start;
+    }
+
+    /// Adds time to a phase that is incurred once per suite.
+    ///
+    /// \param phase Name of the phase.
+    /// \param start Time at which the phase started; the phase ends now.
+    void
+    once(const std::string& phase, const datetime::timestamp& start)
+    {
+        _once[phase] += datetime::timestamp::now() - start;
+    }
+
+    /// Prints the metrics of the suite.
+    ///
+    /// Per-test phases are reported as their mean duration, in microseconds,
+    /// and one-off phases as their total duration.  The wait phase excludes the
+    /// computation of the results, which is reported on its own.
+    void
+    print(void)
+    {
+        const datetime::delta wall = datetime::timestamp::now() - _start;
+        const double seconds = wall.to_microseconds() / 1000000.0;
+
+        std::map< std::string, datetime::delta > per_test = _per_test;
+        per_test["compute_result"] = compute_result_time;
+        if (per_test.find("wait") != per_test.end()) {
+            const int64_t wait = per_test["wait"].to_microseconds();
+            const int64_t compute = compute_result_time.to_microseconds();
+            per_test["wait"] = datetime::delta::from_microseconds(
+                wait > compute ? wait - compute : 0);
+        }
+
+        std::cout << F("%s.tests = %s\n") % _suite % _tests;
+        std::cout << F("%s.wall_time_usec = %s\n") % _suite %
+            wall.to_microseconds();
+        std::cout << F("%s.tests_per_second = %s\n") % _suite %
+            (seconds > 0 ? _tests / seconds : 0);
+        for (std::map< std::string, datetime::delta >::const_iterator iter =
+                 _once.begin(); iter != _once.end(); ++iter)
+            std::cout << F("%s.%s_usec = %s\n") % _suite % (*iter).first %
+                (*iter).second.to_microseconds();
+        for (std::map< std::string, datetime::delta >::const_iterator iter =
+                 per_test.begin(); iter != per_test.end(); ++iter)
+            std::cout << F("%s.%s_usec = %s\n") % _suite % (*iter).first %
+                (_tests > 0 ?
+                 static_cast< double >((*iter).second.to_microseconds()) /
+                 _tests : 0);
+
+        struct ::rusage ru;
+        if (::getrusage(RUSAGE_SELF, &ru) != -1) {
+#if defined(__APPLE__)
+            const int64_t max_rss = ru.ru_maxrss;
+#else
+            const int64_t max_rss = static_cast< int64_t >(ru.ru_maxrss) * 1024;
+#endif
+            std::cout << F("%s.max_rss_bytes = %s\n") % _suite % max_rss;
+        }
+    }
+};
+
+
+/// Makes a helper test program available under the name of a test case.
+///
+/// plain_helpers selects the test case to run from its own name when invoked.
+///
+/// \param helpers Path to the plain_helpers binary.
+/// \param test_case Name of the test case to expose.
+/// \param directory Directory in which to create the test program.
+static void
+link_helper(const fs::path& helpers, const std::string& test_case,
+            const fs::path& directory)
+{
+    const fs::path link = directory / test_case;
+    if (::symlink(helpers.c_str(), link.c_str()) == -1) {
+        const int original_errno = errno;
+        throw std::runtime_error(F("Cannot create %s: %s") % link %
+                                 std::strerror(original_errno));
+    }
+}
+
+
+/// Runs a test program repeatedly, timing every phase of the execution.
+///
+/// \param suite Name of the suite.
+/// \param test_program Path to the test program, relative to root.
+/// \param root Directory containing the test program.
+/// \param count Number of times to list and run the test program.
+/// \param parallelism Number of tests to run concurrently.
+/// \param user_config Configuration of the run.
+static void
+run_timed(const std::string& suite, const fs::path& test_program,
+          const fs::path& root, const std::size_t count,
+          const std::size_t parallelism, const config::tree& user_config)
+{
+    measurements times(suite);
+
+    scheduler::scheduler_handle handle = scheduler::setup();
+    store::write_backend db = store::write_backend::open_rw(
+        root / "results.db");
+    store::write_transaction tx = db.start_write();
+
+    const model::metadata metadata = model::metadata_builder().build();
+    const model::test_program unlisted(
+        "plain", test_program, root, "bench", metadata,
+        model::test_cases_map());
+
+    std::map< int, int64_t > in_flight;
+    std::size_t started = 0;
+    while (started < count || !in_flight.empty()) {
+        while (started < count && in_flight.size() < parallelism) {
+            datetime::timestamp start = datetime::timestamp::now();
+            const model::test_cases_map test_cases = handle.list_tests(
+                &unlisted, user_config);
+            times.per_test("list", start);
+            const model::test_program_ptr program(new model::test_program(
+                "plain", test_program, root, "bench", metadata, test_cases));
+            const int64_t program_id = tx.put_test_program(*program);
+            const int64_t test_case_id = tx.put_test_case(
+                *program, "main", program_id);
+
+            start = datetime::timestamp::now();
+            const scheduler::exec_handle exec_handle = handle.spawn_test(
+                program, "main", user_config);
+            times.per_test("spawn", start);
+            in_flight[exec_handle] = test_case_id;
+            ++started;
+        }
+
+        datetime::timestamp start = datetime::timestamp::now();
+        const scheduler::result_handle_ptr result_handle = handle.wait_any();
+        times.per_test("wait", start);
+        const scheduler::test_result_handle* test_result_handle =
+            dynamic_cast< const scheduler::test_result_handle* >(
+                result_handle.get());
+        INV(test_result_handle != NULL);
+        const std::map< int, int64_t >::iterator iter = in_flight.find(
+            result_handle->original_pid());
+        INV(iter != in_flight.end());
+
+        start = datetime::timestamp::now();
+        tx.put_result(test_result_handle->test_result(), (*iter).second,
+                      result_handle->start_time(), result_handle->end_time());
+        if (result_handle->usage())
+            tx.put_resource_usage(result_handle->usage().get(),
+                                  (*iter).second);
+        tx.put_test_case_file("__STDOUT__", result_handle->stdout_file(),
+                              (*iter).second);
+        tx.put_test_case_file("__STDERR__", result_handle->stderr_file(),
+                              (*iter).second);
+        times.per_test("store", start);
+
+        start = datetime::timestamp::now();
+        result_handle->cleanup();
+        times.per_test("cleanup", start);
+
+        in_flight.erase(iter);
+        times.got_test();
+    }
+
+    const datetime::timestamp start = datetime::timestamp::now();
+    tx.commit();
+    times.once("commit", start);
+
+    handle.cleanup();
+    times.print();
+}
+
+
+/// Hooks for the run_tests driver that count the executed test cases.
+class counting_hooks : public run_tests::base_hooks {
+    /// The measurements to update.
+    measurements& _times;
+
+public:
+    /// Constructor.
+    ///
+    /// \param times The measurements to update.
+    explicit counting_hooks(measurements& times) :
+        _times(times)
+    {
+    }
+
+    /// Called when the processing of a test case begins.
+    void
+    got_test_case(const model::test_program& /* test_program */,
+                  const std::string& /* test_case_name */)
+    {
+    }
+
+    /// Called when a result of a test case becomes available.
+    void
+    got_result(const model::test_program& /* test_program */,
+               const std::string& /* test_case_name */,
+               const model::test_result& /* result */,
+               const datetime::delta& /* duration */)
+    {
+        _times.got_test();
+    }
+};
+
+
+/// Runs the suite of test programs that pass right away.
+///
+/// \param scratch Directory in which to create the suite.
+/// \param helpers Path to the plain_helpers binary.
+/// \param tests Number of test programs to run.
+/// \param parallelism Number of tests to run concurrently.
+static void
+bench_noop(const fs::path& scratch, const fs::path& helpers,
+           const std::size_t tests, const std::size_t parallelism)
+{
+    link_helper(helpers, "pass", scratch);
+    run_timed("noop", fs::path("pass"), scratch, tests, parallelism,
+              engine::default_config());
+}
+
+
+/// Runs the suite of test programs with large outputs.
+///
+/// \param scratch Directory in which to create the suite.
+/// \param helpers Path to the plain_helpers binary.
+/// \param tests Number of test programs to run.
+/// \param parallelism Number of tests to run concurrently.
+/// \param output_size Bytes that each test writes to stdout and stderr.
+static void
+bench_large_output(const fs::path& scratch, const fs::path& helpers,
+                   const std::size_t tests, const std::size_t parallelism,
+                   const std::size_t output_size)
+{
+    link_helper(helpers, "large_output", scratch);
+    config::tree user_config = engine::default_config();
+    user_config.set_string("test_suites.bench.output_size",
+                           F("%s") % output_size);
+    run_timed("large_output", fs::path("large_output"), scratch, tests,
+              parallelism, user_config);
+}
+
+
+/// Runs a suite defined by a chain of nested Kyuafiles.
+///
+/// Every level of the tree is a directory with one test program and a Kyuafile
+/// that includes the level below it.
+///
+/// \param scratch Directory in which to create the suite.
+/// \param helpers Path to the plain_helpers binary.
+/// \param depth Number of levels in the tree.
+/// \param parallelism Number of tests to run concurrently.
+static void
+bench_include_tree(const fs::path& scratch, const fs::path& helpers,
+                   const std::size_t depth, const std::size_t parallelism)
+{
+    PRE(depth > 0);
+
+    fs::path directory = scratch / "tree";
+    for (std::size_t i = 0; i < depth; ++i) {
+        fs::mkdir(directory, 0755);
+        link_helper(helpers, "pass", directory);
+
+        std::ofstream kyuafile((directory / "Kyuafile").c_str());
+        if (!kyuafile)
+            throw std::runtime_error(F("Cannot create %s") %
+                                     (directory / "Kyuafile"));
+        kyuafile << "syntax(2)\n";
+        kyuafile << "test_suite('bench')\n";
+        kyuafile << "plain_test_program{name='pass'}\n";
+        if (i + 1 < depth)
+            kyuafile << "include('level/Kyuafile')\n";
+        directory = directory / "level";
+    }
+
+    config::tree user_config = engine::default_config();
+    user_config.set< engine::parallelism_node >("parallelism", parallelism);
+
+    measurements times("include_tree");
+    {
+        scheduler::scheduler_handle handle = scheduler::setup();
+        const datetime::timestamp start = datetime::timestamp::now();
+        const engine::kyuafile kyuafile = engine::kyuafile::load(
+            scratch / "tree" / "Kyuafile", none, user_config, handle);
+        times.once("load", start);
+        INV(kyuafile.test_programs().size() == depth);
+        handle.cleanup();
+    }
+
+    counting_hooks hooks(times);
+    const datetime::timestamp start = datetime::timestamp::now();
+    (void)run_tests::drive(scratch / "tree" / "Kyuafile", none,
+                           utils::make_optional(scratch / "results.db"), false,
+                           none,
+                           std::set< engine::test_filter >(), none,
+                           std::vector< engine::metadata_filter >(), none,
+                           false, none, 1, false, user_config, hooks, NULL);
+    times.once("drive", start);
+    times.print();
+}
+
+
+}  // anonymous namespace
+
+
+/// Entry point of the benchmark.
+///
+/// \param argc Number of command-line arguments.
+/// \param argv The command-line arguments: the options and the names of the
+///     suites to run, or none to run all of them.
+///
+/// \return 0 on success, 1 if a suite fails to run and 3 on a usage error.
+int
+main(const int argc, const char* const* argv)
+{
+    const cmdline::path_option helpers_option(
+        "helpers", "Path to the plain_helpers test program", "path");
+    const cmdline::int_option tests_option(
+        "tests", "Number of test programs to run", "count", "10000");
+    const cmdline::int_option large_tests_option(
+        "large-tests", "Number of test programs with large outputs to run",
+        "count", "100");
+    const cmdline::int_option output_size_option(
+        "output-size", "Bytes written to stdout and stderr by the tests with "
+        "large outputs", "bytes", "1048576");
+    const cmdline::int_option depth_option(
+        "depth", "Number of levels of the Kyuafile tree", "count", "100");
+    const cmdline::int_option parallelism_option(
+        "parallelism", "Number of tests to run concurrently", "count", "1");
+
+    cmdline::options_vector options;
+    options.push_back(&helpers_option);
+    options.push_back(&tests_option);
+    options.push_back(&large_tests_option);
+    options.push_back(&output_size_option);
+    options.push_back(&depth_option);
+    options.push_back(&parallelism_option);
+
+    try {
+        const cmdline::parsed_cmdline cmdline = cmdline::parse(
+            argc, argv, options);
+        if (!cmdline.has_option("helpers"))
+            throw cmdline::usage_error("--helpers is required");
+        const int parallelism = cmdline.get_option< cmdline::int_option >(
+            "parallelism");
+        if (parallelism < 1)
+            throw cmdline::usage_error("--parallelism must be positive");
+
+        std::set< std::string > suites(cmdline.arguments().begin(),
+                                       cmdline.arguments().end());
+        if (suites.empty()) {
+            suites.insert("noop");
+            suites.insert("large_output");
+            suites.insert("include_tree");
+        }
+
+        logging::set_inmemory();
+        register_timed_interfaces();
+
+        fs::path helpers = cmdline.get_option< cmdline::path_option >(
+            "helpers");
+        if (!helpers.is_absolute())
+            helpers = helpers.to_absolute();
+        const fs::path scratch = fs::mkdtemp_public("kyua-bench.XXXXXX");
+        // Keep the list cache and the results of the suites out of the
+        // home directory of the user.
+        utils::setenv("HOME", scratch.str());
+
+        for (std::set< std::string >::const_iterator iter = suites.begin();
+             iter != suites.end(); ++iter) {
+            const fs::path directory = scratch / *iter;
+            fs::mkdir(directory, 0755);
+            if (*iter == "noop")
+                bench_noop(directory, helpers,
+                           cmdline.get_option< cmdline::int_option >("tests"),
+                           parallelism);
+            else if (*iter == "large_output")
+                bench_large_output(
+                    directory, helpers,
+                    cmdline.get_option< cmdline::int_option >("large-tests"),
+                    parallelism,
+                    cmdline.get_option< cmdline::int_option >("output-size"));
+            else if (*iter == "include_tree")
+                bench_include_tree(
+                    directory, helpers,
+                    cmdline.get_option< cmdline::int_option >("depth"),
+                    parallelism);
+            else
+                throw cmdline::usage_error(F("Unknown suite %s") % *iter);
+        }
+
+        fs::rm_r(scratch);
+        return EXIT_SUCCESS;
+    } catch (const cmdline::usage_error& e) {
+        std::cerr << F("%s: %s\n") % argv[0] % e.what();
+        return 3;
+    } catch (const std::runtime_error& e) {
+        std::cerr << F("%s: %s\n") % argv[0] % e.what();
+        return EXIT_FAILURE;
+    }
+}
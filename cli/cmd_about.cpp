@@ -87,8 +87,9 @@ cat_file(cmdline::ui* ui, const fs::path& file,
         }
     } else {
         const text::regex filter = text::regex::compile(filter_re, 0);
+        text::regex_matches matches;
         while (std::getline(input, line).good()) {
-            if (filter.match(line)) {
+            if (filter.match(line, matches)) {
                 ui->out(line);
             }
         }
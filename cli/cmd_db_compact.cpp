@@ -0,0 +1,222 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "cli/cmd_db_compact.hpp"
+
+#include <cstddef>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "cli/common.ipp"
+#include "store/compact.hpp"
+#include "store/exceptions.hpp"
+#include "store/layout.hpp"
+#include "store/trends.hpp"
+#include "utils/cmdline/exceptions.hpp"
+#include "utils/cmdline/options.hpp"
+#include "utils/cmdline/parser.ipp"
+#include "utils/cmdline/ui.hpp"
+#include "utils/datetime.hpp"
+#include "utils/defs.hpp"
+#include "utils/format/macros.hpp"
+#include "utils/fs/operations.hpp"
+#include "utils/fs/path.hpp"
+#include "utils/logging/macros.hpp"
+#include "utils/optional.ipp"
+
+namespace cmdline = utils::cmdline;
+namespace config = utils::config;
+namespace datetime = utils::datetime;
+namespace fs = utils::fs;
+namespace layout = store::layout;
+
+using cli::cmd_db_compact;
+using utils::none;
+using utils::optional;
+
+
+namespace {
+
+
+/// Length of the "YYYYmmdd-HHMMSS-uuuuuu.db" suffix of results file names.
+const std::size_t timestamp_suffix_length = 25;
+
+
+/// Selects the results files of a test suite to compact.
+///
+/// The most recent results file is never selected, as it is the one that
+/// reports default to and it may still be in use by a running test suite.
+///
+/// \param files The results files of the test suite, from the oldest to the
+///     most recent one.
+/// \param cutoff If set, only select files created before this timestamp,
+///     formatted like the timestamps in the names of the results files.
+///
+/// \return The files to compact.
+static std::vector< fs::path >
+select_files(const std::vector< fs::path >& files,
+             const optional< std::string >& cutoff)
+{
+    std::vector< fs::path > selected;
+    for (std::size_t i = 0; i + 1 < files.size(); ++i) {
+        const std::string name = files[i].leaf_name();
+        if (cutoff) {
+            // The timestamps in the names sort chronologically, so there is
+            // no need to parse them.
+            const std::string when = name.substr(
+                name.length() - timestamp_suffix_length,
+                cutoff.get().length());
+            if (when >= cutoff.get())
+                break;
+        }
+        selected.push_back(files[i]);
+    }
+    return selected;
+}
+
+
+/// Compacts the selected results files of a test suite.
+///
+/// The runs of the test suite are added to the trends index first so that
+/// their durations are kept even if the files are later pruned.
+///
+/// \param ui Object to interact with the I/O of the program.
+/// \param test_suite The identifier of the test suite.
+/// \param files The results files to compact.
+/// \param strip_output Whether to delete the output of passed test cases.
+///
+/// \throw store::error If any of the files cannot be compacted.
+static void
+compact_test_suite(cmdline::ui* ui, const std::string& test_suite,
+                   const std::vector< fs::path >& files,
+                   const bool strip_output)
+{
+    const fs::path trends_file = layout::query_trends_file();
+    fs::mkdir_p(trends_file.branch_path(), 0755);
+    store::trends_index index = store::trends_index::open_rw(trends_file);
+    const std::size_t added = index.sync(test_suite);
+    index.close();
+    LI(F("Added %s results files to the trends index") % added);
+
+    int64_t reclaimed = 0;
+    std::size_t folded = 0;
+    std::size_t stripped = 0;
+    for (std::vector< fs::path >::const_iterator iter = files.begin();
+         iter != files.end(); ++iter) {
+        const store::compact_stats stats = store::compact_results(
+            *iter, strip_output);
+        reclaimed += stats.old_size - stats.new_size;
+        folded += stats.folded_files;
+        stripped += stats.stripped_files;
+    }
+
+    ui->out(F("Compacted %s results files of test suite %s; reclaimed %s "
+              "bytes") % files.size() % test_suite % reclaimed);
+    if (folded > 0)
+        ui->out(F("Moved %s files from segments into their results files") %
+                folded);
+    if (strip_output)
+        ui->out(F("Stripped %s output files of passed test cases") % stripped);
+}
+
+
+}  // anonymous namespace
+
+
+/// Default constructor for cmd_db_compact.
+cmd_db_compact::cmd_db_compact(void) : cli_command(
+    "db-compact", "[test-suite-id ...]", 0, -1,
+    "Reclaims the space used by old results files in the store")
+{
+    add_option(cmdline::bool_option(
+        "all", "Compact the results files of all test suites in the store"));
+    add_option(cmdline::int_option(
+        "older-than", "Only compact the results files created this many days "
+        "ago or earlier", "days"));
+    add_option(cmdline::bool_option(
+        "strip-passed-output", "Delete the stdout and stderr of the test "
+        "cases that passed"));
+}
+
+
+/// Entry point for the "db-compact" subcommand.
+///
+/// \param ui Object to interact with the I/O of the program.
+/// \param cmdline Representation of the command line to the subcommand.
+/// \param unused_user_config The runtime configuration of the program.
+///
+/// \return 0 if everything is OK, 1 if any of the files cannot be compacted.
+int
+cmd_db_compact::run(cmdline::ui* ui, const cmdline::parsed_cmdline& cmdline,
+                    const config::tree& UTILS_UNUSED_PARAM(user_config))
+{
+    if (cmdline.has_option("all") && !cmdline.arguments().empty())
+        throw cmdline::usage_error("Cannot specify test suites with --all");
+
+    optional< std::string > cutoff = none;
+    if (cmdline.has_option("older-than")) {
+        const int days = cmdline.get_option< cmdline::int_option >(
+            "older-than");
+        if (days < 0)
+            throw cmdline::usage_error(F("Invalid value for --older-than: "
+                                         "%s; must be at least 0") % days);
+        const datetime::timestamp when = datetime::timestamp::now() -
+            datetime::delta(int64_t(days) * 24 * 60 * 60, 0);
+        cutoff = when.strftime("%Y%m%d-%H%M%S");
+    }
+
+    layout::results_map files;
+    if (cmdline.has_option("all")) {
+        files = layout::list_all_results();
+    } else if (cmdline.arguments().empty()) {
+        const std::string test_suite = layout::test_suite_for_path(
+            fs::current_path());
+        files[test_suite] = layout::list_results(test_suite);
+    } else {
+        for (cmdline::args_vector::const_iterator
+                 iter = cmdline.arguments().begin();
+             iter != cmdline.arguments().end(); ++iter)
+            files[*iter] = layout::list_results(*iter);
+    }
+
+    try {
+        for (layout::results_map::const_iterator iter = files.begin();
+             iter != files.end(); ++iter) {
+            const std::vector< fs::path > selected = select_files(
+                (*iter).second, cutoff);
+            if (!selected.empty())
+                compact_test_suite(ui, (*iter).first, selected,
+                                   cmdline.has_option("strip-passed-output"));
+        }
+        return EXIT_SUCCESS;
+    } catch (const store::error& e) {
+        cmdline::print_error(ui, F("Compaction failed: %s.") % e.what());
+        return EXIT_FAILURE;
+    }
+}
@@ -30,37 +30,199 @@
 
 #include <algorithm>
 #include <cstdlib>
+#include <iostream>
 #include <iterator>
 #include <sstream>
+#include <stdexcept>
 #include <string>
+#include <vector>
 
 #include "cli/common.ipp"
 #include "store/exceptions.hpp"
 #include "store/layout.hpp"
 #include "store/read_backend.hpp"
+#include "utils/cmdline/exceptions.hpp"
 #include "utils/cmdline/options.hpp"
 #include "utils/cmdline/parser.ipp"
 #include "utils/cmdline/ui.hpp"
 #include "utils/defs.hpp"
 #include "utils/format/macros.hpp"
 #include "utils/fs/path.hpp"
+#include "utils/optional.ipp"
 #include "utils/sanity.hpp"
 #include "utils/sqlite/database.hpp"
 #include "utils/sqlite/exceptions.hpp"
 #include "utils/sqlite/statement.hpp"
+#include "utils/sqlite/transaction.hpp"
+#include "utils/stream.hpp"
+#include "utils/text/operations.hpp"
 
 namespace cmdline = utils::cmdline;
 namespace config = utils::config;
 namespace fs = utils::fs;
 namespace layout = store::layout;
 namespace sqlite = utils::sqlite;
+namespace text = utils::text;
 
 using cli::cmd_db_exec;
+using utils::optional;
 
 
 namespace {
 
 
+/// Formats in which to print the results of the statements.
+enum output_format {
+    /// Human-readable table printed through the UI, one line at a time.
+    text_format,
+
+    /// Comma-separated values written in bulk to stdout.
+    csv_format,
+
+    /// Tab-separated values written in bulk to stdout.
+    tsv_format,
+
+    /// One JSON object per row written in bulk to stdout.
+    ndjson_format
+};
+
+
+/// Parses the value of the --format flag.
+///
+/// \param cmdline Representation of the command line to the subcommand.
+///
+/// \return The requested output format.
+///
+/// \throw cmdline::usage_error If the format is unknown.
+static output_format
+get_format(const cmdline::parsed_cmdline& cmdline)
+{
+    const std::string format = cmdline.get_option< cmdline::string_option >(
+        "format");
+    if (format == "text")
+        return text_format;
+    else if (format == "csv")
+        return csv_format;
+    else if (format == "tsv")
+        return tsv_format;
+    else if (format == "ndjson")
+        return ndjson_format;
+    else
+        throw cmdline::usage_error(F("Invalid value for --format: %s; must be "
+                                     "one of text, csv, tsv or ndjson") %
+                                   format);
+}
+
+
+/// Writes the contents of a blob as a hexadecimal string.
+///
+/// \param blob The blob to write.
+/// \param output The stream into which to write the blob.
+static void
+write_hex(const sqlite::blob& blob, std::ostream& output)
+{
+    static const char hex_digits[] = "0123456789abcdef";
+
+    const unsigned char* data = static_cast< const unsigned char* >(
+        blob.memory);
+    for (int i = 0; i < blob.size; ++i)
+        output << hex_digits[data[i] >> 4] << hex_digits[data[i] & 0x0F];
+}
+
+
+/// Writes a single field of a delimited row, quoting it if necessary.
+///
+/// \param value The textual value of the field.
+/// \param delimiter The character that separates fields.
+/// \param output The stream into which to write the field.
+static void
+write_delimited_field(const std::string& value, const char delimiter,
+                      std::ostream& output)
+{
+    const char specials[] = { delimiter, '"', '\n', '\r', '\0' };
+    if (value.find_first_of(specials) == std::string::npos) {
+        output << value;
+    } else {
+        output << '"';
+        for (std::string::const_iterator iter = value.begin();
+             iter != value.end(); ++iter) {
+            if (*iter == '"')
+                output << '"';
+            output << *iter;
+        }
+        output << '"';
+    }
+}
+
+
+/// Writes a particular cell of a statement result in delimited form.
+///
+/// \param stmt The statement whose cell to write.
+/// \param index The index of the cell to write.
+/// \param delimiter The character that separates fields.
+/// \param output The stream into which to write the cell.
+static void
+write_delimited_cell(sqlite::statement& stmt, const int index,
+                     const char delimiter, std::ostream& output)
+{
+    switch (stmt.column_type(index)) {
+    case sqlite::type_blob:
+        write_hex(stmt.column_blob(index), output);
+        break;
+
+    case sqlite::type_float:
+        output << stmt.column_double(index);
+        break;
+
+    case sqlite::type_integer:
+        output << stmt.column_int64(index);
+        break;
+
+    case sqlite::type_null:
+        break;
+
+    case sqlite::type_text:
+        write_delimited_field(stmt.column_text(index), delimiter, output);
+        break;
+    }
+}
+
+
+/// Writes a particular cell of a statement result as a JSON value.
+///
+/// \param stmt The statement whose cell to write.
+/// \param index The index of the cell to write.
+/// \param output The stream into which to write the cell.
+static void
+write_json_cell(sqlite::statement& stmt, const int index,
+                std::ostream& output)
+{
+    switch (stmt.column_type(index)) {
+    case sqlite::type_blob:
+        output << '"';
+        write_hex(stmt.column_blob(index), output);
+        output << '"';
+        break;
+
+    case sqlite::type_float:
+        output << stmt.column_double(index);
+        break;
+
+    case sqlite::type_integer:
+        output << stmt.column_int64(index);
+        break;
+
+    case sqlite::type_null:
+        output << "null";
+        break;
+
+    case sqlite::type_text:
+        output << '"' << text::escape_json(stmt.column_text(index)) << '"';
+        break;
+    }
+}
+
+
 /// Concatenates a vector into a string using ' ' as a separator.
 ///
 /// \param args The objects to join.  This cannot be empty.
@@ -148,15 +310,167 @@ cli::format_row(sqlite::statement& stmt)
 }
 
 
+/// Writes the column names of a statement as a delimited line.
+///
+/// \param stmt The statement whose columns to write.
+/// \param delimiter The character that separates fields.
+/// \param output The stream into which to write the line.
+void
+cli::write_delimited_headers(sqlite::statement& stmt, const char delimiter,
+                             std::ostream& output)
+{
+    for (int i = 0; i < stmt.column_count(); ++i) {
+        if (i > 0)
+            output << delimiter;
+        write_delimited_field(stmt.column_name(i), delimiter, output);
+    }
+    output << '\n';
+}
+
+
+/// Writes the current row of a statement as a delimited line.
+///
+/// Fields that contain the delimiter, quotes or line breaks are quoted as
+/// described in RFC 4180.  NULL values are written as empty fields and blobs
+/// are written in hexadecimal.
+///
+/// \param stmt The statement whose current row to write.
+/// \param delimiter The character that separates fields.
+/// \param output The stream into which to write the line.
+void
+cli::write_delimited_row(sqlite::statement& stmt, const char delimiter,
+                         std::ostream& output)
+{
+    for (int i = 0; i < stmt.column_count(); ++i) {
+        if (i > 0)
+            output << delimiter;
+        write_delimited_cell(stmt, i, delimiter, output);
+    }
+    output << '\n';
+}
+
+
+/// Writes the current row of a statement as a single-line JSON object.
+///
+/// \param stmt The statement whose current row to write.
+/// \param output The stream into which to write the line.
+void
+cli::write_ndjson_row(sqlite::statement& stmt, std::ostream& output)
+{
+    output << '{';
+    for (int i = 0; i < stmt.column_count(); ++i) {
+        if (i > 0)
+            output << ',';
+        output << '"' << text::escape_json(stmt.column_name(i)) << "\":";
+        write_json_cell(stmt, i, output);
+    }
+    output << "}\n";
+}
+
+
+namespace {
+
+
+/// Number of rows to accumulate before printing them in the text format.
+static const std::size_t text_batch_rows = 1024;
+
+
+/// Prints all the rows returned by a statement.
+///
+/// \param ui Object to interact with the I/O of the program.
+/// \param stmt The statement to execute.
+/// \param format The format in which to print the rows.
+/// \param headers Whether to print the column names before the first row.
+static void
+print_rows(cmdline::ui* ui, sqlite::statement& stmt,
+           const output_format format, const bool headers)
+{
+    if (!stmt.step())
+        return;
+
+    switch (format) {
+    case text_format: {
+        std::vector< std::string > lines;
+        lines.reserve(text_batch_rows + 1);
+        if (headers)
+            lines.push_back(cli::format_headers(stmt));
+        do {
+            lines.push_back(cli::format_row(stmt));
+            if (lines.size() >= text_batch_rows) {
+                ui->out_lines(lines);
+                lines.clear();
+            }
+        } while (stmt.step());
+        ui->out_lines(lines);
+        break;
+    }
+
+    case csv_format:
+    case tsv_format: {
+        const char delimiter = format == csv_format ? ',' : '\t';
+        if (headers)
+            cli::write_delimited_headers(stmt, delimiter, std::cout);
+        do
+            cli::write_delimited_row(stmt, delimiter, std::cout);
+        while (stmt.step());
+        break;
+    }
+
+    case ndjson_format:
+        do
+            cli::write_ndjson_row(stmt, std::cout);
+        while (stmt.step());
+        break;
+    }
+}
+
+
+/// Executes all the statements in a script within a single transaction.
+///
+/// \param ui Object to interact with the I/O of the program.
+/// \param db The database in which to run the script.
+/// \param script The SQL statements to execute.
+/// \param format The format in which to print the rows.
+/// \param headers Whether to print the column names before the rows of every
+///     statement that returns any.
+///
+/// \throw sqlite::error If any statement fails; in this case, the changes of
+///     all previous statements are rolled back.
+static void
+run_script(cmdline::ui* ui, sqlite::database& db, const std::string& script,
+           const output_format format, const bool headers)
+{
+    sqlite::transaction tx = db.begin_transaction();
+    std::string::size_type offset = 0;
+    for (;;) {
+        optional< sqlite::statement > stmt = db.create_next_statement(
+            script, offset);
+        if (!stmt)
+            break;
+        print_rows(ui, stmt.get(), format, headers);
+    }
+    tx.commit();
+}
+
+
+}  // anonymous namespace
+
+
 /// Default constructor for cmd_db_exec.
 cmd_db_exec::cmd_db_exec(void) : cli_command(
-    "db-exec", "sql_statement", 1, -1,
+    "db-exec", "[sql_statement]", 0, -1,
     "Executes an arbitrary SQL statement in a results file and prints "
     "the resulting table")
 {
     add_option(results_file_open_option);
+    add_option(cmdline::string_option(
+        "format", "Format of the output: text, csv, tsv or ndjson; all but "
+        "text are written in bulk", "format", "text"));
     add_option(cmdline::bool_option("no-headers", "Do not show headers in the "
                                     "output table"));
+    add_option(cmdline::path_option(
+        "script", "File with SQL statements to execute in a single "
+        "transaction instead of the statement in the arguments", "path"));
 }
 
 
@@ -172,6 +486,27 @@ int
 cmd_db_exec::run(cmdline::ui* ui, const cmdline::parsed_cmdline& cmdline,
                  const config::tree& UTILS_UNUSED_PARAM(user_config))
 {
+    const bool has_script = cmdline.has_option("script");
+    if (cmdline.arguments().empty() && !has_script)
+        throw cmdline::usage_error("Not enough arguments");
+    if (!cmdline.arguments().empty() && has_script)
+        throw cmdline::usage_error("Cannot provide both a statement in the "
+                                   "arguments and --script");
+    const output_format format = get_format(cmdline);
+    const bool headers = !cmdline.has_option("no-headers");
+
+    std::string script;
+    if (has_script) {
+        const fs::path script_file = cmdline.get_option< cmdline::path_option >(
+            "script");
+        try {
+            script = utils::read_file(script_file);
+        } catch (const std::runtime_error& e) {
+            cmdline::print_error(ui, F("%s.") % e.what());
+            return EXIT_FAILURE;
+        }
+    }
+
     try {
         const fs::path results_file = layout::find_results(
             results_file_open(cmdline));
@@ -179,22 +514,22 @@ cmd_db_exec::run(cmdline::ui* ui, const cmdline::parsed_cmdline& cmdline,
         // TODO(jmmv): Shouldn't be using store::detail here...
         sqlite::database db = store::detail::open_and_setup(
             results_file, sqlite::open_readwrite);
-        sqlite::statement stmt = db.create_statement(
-            flatten_args(cmdline.arguments()));
-
-        if (stmt.step()) {
-            if (!cmdline.has_option("no-headers"))
-                ui->out(cli::format_headers(stmt));
-            do
-                ui->out(cli::format_row(stmt));
-            while (stmt.step());
+        if (has_script) {
+            run_script(ui, db, script, format, headers);
+        } else {
+            sqlite::statement stmt = db.create_statement(
+                flatten_args(cmdline.arguments()));
+            print_rows(ui, stmt, format, headers);
         }
+        std::cout.flush();
 
         return EXIT_SUCCESS;
     } catch (const sqlite::error& e) {
+        std::cout.flush();
         cmdline::print_error(ui, F("SQLite error: %s.") % e.what());
         return EXIT_FAILURE;
     } catch (const store::error& e) {
+        std::cout.flush();
         cmdline::print_error(ui, F("%s.") % e.what());
         return EXIT_FAILURE;
     }
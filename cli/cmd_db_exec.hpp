@@ -32,6 +32,7 @@
 #if !defined(CLI_CMD_DB_EXEC_HPP)
 #define CLI_CMD_DB_EXEC_HPP
 
+#include <ostream>
 #include <string>
 
 #include "cli/common.hpp"
@@ -43,6 +44,10 @@ namespace cli {
 std::string format_cell(utils::sqlite::statement&, const int);
 std::string format_headers(utils::sqlite::statement&);
 std::string format_row(utils::sqlite::statement&);
+void write_delimited_headers(utils::sqlite::statement&, const char,
+                             std::ostream&);
+void write_delimited_row(utils::sqlite::statement&, const char, std::ostream&);
+void write_ndjson_row(utils::sqlite::statement&, std::ostream&);
 
 
 /// Implementation of the "db-exec" subcommand.
@@ -29,6 +29,7 @@
 #include "cli/cmd_db_exec.hpp"
 
 #include <cstring>
+#include <sstream>
 
 #include <atf-c++.hpp>
 
@@ -71,6 +72,27 @@ do_format_cell_test(const std::string column_type,
 }
 
 
+/// Creates a table with rows that exercise all the types of values.
+///
+/// \param db The database in which to create the table.
+static void
+populate_mixed_table(sqlite::database& db)
+{
+    db.exec("CREATE TABLE test (c1 INTEGER, c2 FLOAT, c3 TEXT, c4 BLOB)");
+
+    const char memory[] = { 'a', '\xff' };
+    sqlite::statement insert = db.create_statement(
+        "INSERT INTO test VALUES (:v1, :v2, :v3, :v4)");
+    insert.bind(":v1", 12);
+    insert.bind(":v2", 1.5);
+    insert.bind(":v3", "Some, \"quoted\"\ttext");
+    insert.bind(":v4", sqlite::blob(memory, sizeof(memory)));
+    insert.step_without_results();
+
+    db.exec("INSERT INTO test VALUES (NULL, NULL, 'plain', NULL)");
+}
+
+
 }  // anonymous namespace
 
 
@@ -151,6 +173,75 @@ ATF_TEST_CASE_BODY(format_row)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(write_delimited_headers);
+ATF_TEST_CASE_BODY(write_delimited_headers)
+{
+    sqlite::database db = sqlite::database::in_memory();
+    db.exec("CREATE TABLE test (c1 TEXT, c2 TEXT)");
+
+    sqlite::statement query = db.create_statement(
+        "SELECT c1, c2 AS \"with,comma\" FROM test");
+    std::ostringstream csv;
+    cli::write_delimited_headers(query, ',', csv);
+    ATF_REQUIRE_EQ("c1,\"with,comma\"\n", csv.str());
+
+    std::ostringstream tsv;
+    cli::write_delimited_headers(query, '\t', tsv);
+    ATF_REQUIRE_EQ("c1\twith,comma\n", tsv.str());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(write_delimited_row__csv);
+ATF_TEST_CASE_BODY(write_delimited_row__csv)
+{
+    sqlite::database db = sqlite::database::in_memory();
+    populate_mixed_table(db);
+
+    sqlite::statement query = db.create_statement(
+        "SELECT * FROM test ORDER BY rowid");
+    std::ostringstream output;
+    while (query.step())
+        cli::write_delimited_row(query, ',', output);
+    ATF_REQUIRE_EQ("12,1.5,\"Some, \"\"quoted\"\"\ttext\",61ff\n"
+                   ",,plain,\n", output.str());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(write_delimited_row__tsv);
+ATF_TEST_CASE_BODY(write_delimited_row__tsv)
+{
+    sqlite::database db = sqlite::database::in_memory();
+    populate_mixed_table(db);
+
+    sqlite::statement query = db.create_statement(
+        "SELECT * FROM test ORDER BY rowid");
+    std::ostringstream output;
+    while (query.step())
+        cli::write_delimited_row(query, '\t', output);
+    ATF_REQUIRE_EQ("12\t1.5\t\"Some, \"\"quoted\"\"\ttext\"\t61ff\n"
+                   "\t\tplain\t\n", output.str());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(write_ndjson_row);
+ATF_TEST_CASE_BODY(write_ndjson_row)
+{
+    sqlite::database db = sqlite::database::in_memory();
+    populate_mixed_table(db);
+
+    sqlite::statement query = db.create_statement(
+        "SELECT * FROM test ORDER BY rowid");
+    std::ostringstream output;
+    while (query.step())
+        cli::write_ndjson_row(query, output);
+    ATF_REQUIRE_EQ(
+        "{\"c1\":12,\"c2\":1.5,\"c3\":\"Some, \\\"quoted\\\"\\ttext\","
+        "\"c4\":\"61ff\"}\n"
+        "{\"c1\":null,\"c2\":null,\"c3\":\"plain\",\"c4\":null}\n",
+        output.str());
+}
+
+
 ATF_INIT_TEST_CASES(tcs)
 {
     ATF_ADD_TEST_CASE(tcs, format_cell__blob);
@@ -162,4 +253,9 @@ ATF_INIT_TEST_CASES(tcs)
     ATF_ADD_TEST_CASE(tcs, format_headers);
 
     ATF_ADD_TEST_CASE(tcs, format_row);
+
+    ATF_ADD_TEST_CASE(tcs, write_delimited_headers);
+    ATF_ADD_TEST_CASE(tcs, write_delimited_row__csv);
+    ATF_ADD_TEST_CASE(tcs, write_delimited_row__tsv);
+    ATF_ADD_TEST_CASE(tcs, write_ndjson_row);
 }
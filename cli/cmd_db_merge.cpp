@@ -0,0 +1,92 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "cli/cmd_db_merge.hpp"
+
+#include <cstdlib>
+#include <vector>
+
+#include "cli/common.ipp"
+#include "store/exceptions.hpp"
+#include "store/layout.hpp"
+#include "store/merge.hpp"
+#include "utils/cmdline/options.hpp"
+#include "utils/cmdline/parser.hpp"
+#include "utils/cmdline/ui.hpp"
+#include "utils/defs.hpp"
+#include "utils/format/macros.hpp"
+#include "utils/fs/operations.hpp"
+#include "utils/fs/path.hpp"
+
+namespace cmdline = utils::cmdline;
+namespace config = utils::config;
+namespace fs = utils::fs;
+namespace layout = store::layout;
+
+using cli::cmd_db_merge;
+
+
+/// Default constructor for cmd_db_merge.
+cmd_db_merge::cmd_db_merge(void) : cli_command(
+    "db-merge", "results-file ...", 1, -1,
+    "Combines various results files into a new one")
+{
+    add_option(results_file_create_option);
+}
+
+
+/// Entry point for the "db-merge" subcommand.
+///
+/// \param ui Object to interact with the I/O of the program.
+/// \param cmdline Representation of the command line to the subcommand.
+/// \param unused_user_config The runtime configuration of the program.
+///
+/// \return 0 if everything is OK, 1 if any of the inputs is invalid or if
+/// there is any other problem.
+int
+cmd_db_merge::run(cmdline::ui* ui, const cmdline::parsed_cmdline& cmdline,
+                  const config::tree& UTILS_UNUSED_PARAM(user_config))
+{
+    try {
+        std::vector< fs::path > inputs;
+        for (cmdline::args_vector::const_iterator
+                 iter = cmdline.arguments().begin();
+             iter != cmdline.arguments().end(); ++iter) {
+            inputs.push_back(layout::find_results(*iter));
+        }
+
+        const layout::results_id_file_pair results = layout::new_db(
+            results_file_create(cmdline), fs::current_path());
+        store::merge_results(inputs, results.second);
+        ui->out(F("Results saved to %s") % results.second);
+        return EXIT_SUCCESS;
+    } catch (const store::error& e) {
+        cmdline::print_error(ui, F("Merge failed: %s.") % e.what());
+        return EXIT_FAILURE;
+    }
+}
@@ -28,6 +28,7 @@
 
 #include "cli/cmd_db_migrate.hpp"
 
+#include <cstddef>
 #include <cstdlib>
 
 #include "cli/common.ipp"
@@ -48,6 +49,42 @@ namespace layout = store::layout;
 using cli::cmd_db_migrate;
 
 
+namespace {
+
+
+/// Number of extracted actions between progress messages.
+static const std::size_t progress_interval = 100;
+
+
+/// Reports the progress of a migration to the user.
+class migrate_progress_hooks : public store::migrate_hooks {
+    /// Object to interact with the I/O of the program.
+    cmdline::ui* _ui;
+
+public:
+    /// Constructor.
+    ///
+    /// \param ui_ Object to interact with the I/O of the program.
+    migrate_progress_hooks(cmdline::ui* ui_) : _ui(ui_)
+    {
+    }
+
+    /// Callback executed when an action of a historical database is processed.
+    ///
+    /// \param done Number of actions processed so far, including this one.
+    /// \param total Number of actions to process.
+    void
+    extracted_action(const std::size_t done, const std::size_t total)
+    {
+        if (done % progress_interval == 0 || done == total)
+            _ui->out(F("Extracted %s of %s actions") % done % total);
+    }
+};
+
+
+}  // anonymous namespace
+
+
 /// Default constructor for cmd_db_migrate.
 cmd_db_migrate::cmd_db_migrate(void) : cli_command(
     "db-migrate", "", 0, 0,
@@ -63,18 +100,20 @@ cmd_db_migrate::cmd_db_migrate(void) : cli_command(
 ///
 /// \param ui Object to interact with the I/O of the program.
 /// \param cmdline Representation of the command line to the subcommand.
-/// \param unused_user_config The runtime configuration of the program.
+/// \param user_config The runtime configuration of the program.
 ///
 /// \return 0 if everything is OK, 1 if the statement is invalid or if there is
 /// any other problem.
 int
 cmd_db_migrate::run(cmdline::ui* ui, const cmdline::parsed_cmdline& cmdline,
-                    const config::tree& UTILS_UNUSED_PARAM(user_config))
+                    const config::tree& user_config)
 {
     try {
         const fs::path results_file = layout::find_results(
             results_file_open(cmdline));
-        store::migrate_schema(results_file);
+        migrate_progress_hooks hooks(ui);
+        store::migrate_schema(results_file,
+                              subprocess_parallelism(user_config), hooks);
         return EXIT_SUCCESS;
     } catch (const store::error& e) {
         cmdline::print_error(ui, F("Migration failed: %s.") % e.what());
@@ -0,0 +1,115 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "cli/cmd_db_prune.hpp"
+
+#include <cstddef>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "cli/common.ipp"
+#include "store/exceptions.hpp"
+#include "store/layout.hpp"
+#include "utils/cmdline/exceptions.hpp"
+#include "utils/cmdline/options.hpp"
+#include "utils/cmdline/parser.ipp"
+#include "utils/cmdline/ui.hpp"
+#include "utils/defs.hpp"
+#include "utils/format/macros.hpp"
+#include "utils/fs/operations.hpp"
+#include "utils/fs/path.hpp"
+
+namespace cmdline = utils::cmdline;
+namespace config = utils::config;
+namespace fs = utils::fs;
+namespace layout = store::layout;
+
+using cli::cmd_db_prune;
+
+
+/// Default constructor for cmd_db_prune.
+cmd_db_prune::cmd_db_prune(void) : cli_command(
+    "db-prune", "[test-suite-id ...]", 0, -1,
+    "Deletes old results files from the store")
+{
+    add_option(cmdline::bool_option(
+        "all", "Prune the results files of all test suites in the store"));
+    add_option(cmdline::int_option(
+        "keep", "Number of most recent results files to keep for each test "
+        "suite", "count", "10"));
+}
+
+
+/// Entry point for the "db-prune" subcommand.
+///
+/// \param ui Object to interact with the I/O of the program.
+/// \param cmdline Representation of the command line to the subcommand.
+/// \param unused_user_config The runtime configuration of the program.
+///
+/// \return 0 if everything is OK, 1 if any of the files cannot be deleted.
+int
+cmd_db_prune::run(cmdline::ui* ui, const cmdline::parsed_cmdline& cmdline,
+                  const config::tree& UTILS_UNUSED_PARAM(user_config))
+{
+    const int keep = cmdline.get_option< cmdline::int_option >("keep");
+    if (keep < 1)
+        throw cmdline::usage_error(F("Invalid value for --keep: %s; must be "
+                                     "at least 1") % keep);
+    if (cmdline.has_option("all") && !cmdline.arguments().empty())
+        throw cmdline::usage_error("Cannot specify test suites with --all");
+
+    layout::results_map files;
+    if (cmdline.has_option("all")) {
+        files = layout::list_all_results();
+    } else if (cmdline.arguments().empty()) {
+        const std::string test_suite = layout::test_suite_for_path(
+            fs::current_path());
+        files[test_suite] = layout::list_results(test_suite);
+    } else {
+        for (cmdline::args_vector::const_iterator
+                 iter = cmdline.arguments().begin();
+             iter != cmdline.arguments().end(); ++iter)
+            files[*iter] = layout::list_results(*iter);
+    }
+
+    try {
+        for (layout::results_map::const_iterator iter = files.begin();
+             iter != files.end(); ++iter) {
+            const std::vector< fs::path > removed = layout::prune_results(
+                (*iter).second, static_cast< std::size_t >(keep));
+            if (!removed.empty())
+                ui->out(F("Pruned %s results files of test suite %s") %
+                        removed.size() % (*iter).first);
+        }
+        return EXIT_SUCCESS;
+    } catch (const store::error& e) {
+        cmdline::print_error(ui, F("Prune failed: %s.") % e.what());
+        return EXIT_FAILURE;
+    }
+}
@@ -29,6 +29,8 @@
 #include "cli/cmd_debug.hpp"
 
 #include <cstdlib>
+#include <memory>
+#include <ostream>
 
 #include "cli/common.ipp"
 #include "drivers/debug_test.hpp"
@@ -38,13 +40,79 @@
 #include "utils/cmdline/parser.ipp"
 #include "utils/cmdline/ui.hpp"
 #include "utils/format/macros.hpp"
+#include "utils/fs/path.hpp"
+#include "utils/stream.hpp"
 
 namespace cmdline = utils::cmdline;
 namespace config = utils::config;
+namespace fs = utils::fs;
 
 using cli::cmd_debug;
 
 
+namespace {
+
+
+/// Hooks to report the failing iterations of a repeated execution.
+class failure_hooks : public drivers::debug_test::repeat_hooks {
+    /// Object to interact with the I/O of the program.
+    cmdline::ui* _ui;
+
+    /// The test case being executed.
+    const engine::test_filter _test_case;
+
+    /// Stream into which to copy the stdout of failing iterations.
+    std::auto_ptr< std::ostream > _stdout;
+
+    /// Stream into which to copy the stderr of failing iterations.
+    std::auto_ptr< std::ostream > _stderr;
+
+public:
+    /// Constructor for the hooks.
+    ///
+    /// \param ui_ Object to interact with the I/O of the program.
+    /// \param test_case_ The test case being executed.
+    /// \param stdout_target Where to copy the stdout of failing iterations.
+    /// \param stderr_target Where to copy the stderr of failing iterations.
+    failure_hooks(cmdline::ui* ui_, const engine::test_filter& test_case_,
+                  const fs::path& stdout_target,
+                  const fs::path& stderr_target) :
+        _ui(ui_),
+        _test_case(test_case_),
+        _stdout(utils::open_ostream(stdout_target)),
+        _stderr(utils::open_ostream(stderr_target))
+    {
+    }
+
+    /// Reports the result of an iteration, but only if it failed.
+    ///
+    /// \param iteration Zero-based number of the iteration.
+    /// \param test_result The result of the iteration.
+    /// \param stdout_file File holding the stdout of the iteration.
+    /// \param stderr_file File holding the stderr of the iteration.
+    void
+    got_result(const std::size_t iteration,
+               const model::test_result& test_result,
+               const fs::path& stdout_file,
+               const fs::path& stderr_file)
+    {
+        if (test_result.good())
+            return;
+
+        *_stdout << utils::read_file(stdout_file);
+        _stdout->flush();
+        *_stderr << utils::read_file(stderr_file);
+        _stderr->flush();
+        _ui->out(F("%s (iteration %s)  ->  %s") %
+                 cli::format_test_case_id(_test_case) % (iteration + 1) %
+                 cli::format_result(test_result));
+    }
+};
+
+
+}  // anonymous namespace
+
+
 /// Default constructor for cmd_debug.
 cmd_debug::cmd_debug(void) : cli_command(
     "debug", "test_case", 1, 1,
@@ -60,6 +128,14 @@ cmd_debug::cmd_debug(void) : cli_command(
     add_option(cmdline::path_option(
         "stderr", "Where to direct the standard error of the test case",
         "path", "/dev/stderr"));
+
+    add_option(cmdline::int_option(
+        "repeat", "Number of times to run the test case; only the output of "
+        "the failing iterations is kept", "count", "1"));
+
+    add_option(cmdline::bool_option(
+        "parallel", "Run the iterations requested by --repeat concurrently "
+        "according to the configured parallelism"));
 }
 
 
@@ -82,6 +158,26 @@ cmd_debug::run(cmdline::ui* ui, const cmdline::parsed_cmdline& cmdline,
     const engine::test_filter filter = engine::test_filter::parse(
         test_case_name);
 
+    const int repeat = cmdline.get_option< cmdline::int_option >("repeat");
+    if (repeat < 1)
+        throw cmdline::usage_error(F("Invalid value for --repeat: %s; must be "
+                                     "positive") % repeat);
+    if (repeat > 1 || cmdline.has_option("parallel")) {
+        failure_hooks hooks(
+            ui, filter, cmdline.get_option< cmdline::path_option >("stdout"),
+            cmdline.get_option< cmdline::path_option >("stderr"));
+        const drivers::debug_test::repeat_result result =
+            drivers::debug_test::drive_repeated(
+                kyuafile_path(cmdline), build_root_path(cmdline), filter,
+                user_config, repeat, cmdline.has_option("parallel"), hooks);
+
+        ui->out(F("%s  ->  %s passed, %s failed") %
+                cli::format_test_case_id(result.test_case) % result.passed %
+                result.failed);
+
+        return result.failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
     const drivers::debug_test::result result = drivers::debug_test::drive(
         kyuafile_path(cmdline), build_root_path(cmdline), filter, user_config,
         cmdline.get_option< cmdline::path_option >("stdout"),
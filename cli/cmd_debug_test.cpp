@@ -75,8 +75,26 @@ ATF_TEST_CASE_BODY(filter_without_test_case)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(invalid_repeat);
+ATF_TEST_CASE_BODY(invalid_repeat)
+{
+    cmdline::args_vector args;
+    args.push_back("debug");
+    args.push_back("--repeat=0");
+    args.push_back("program:test");
+
+    cli::cmd_debug cmd;
+    cmdline::ui_mock ui;
+    ATF_REQUIRE_THROW_RE(cmdline::usage_error, "Invalid value for --repeat",
+                         cmd.main(&ui, args, engine::default_config()));
+    ATF_REQUIRE(ui.out_log().empty());
+    ATF_REQUIRE(ui.err_log().empty());
+}
+
+
 ATF_INIT_TEST_CASES(tcs)
 {
     ATF_ADD_TEST_CASE(tcs, invalid_filter);
     ATF_ADD_TEST_CASE(tcs, filter_without_test_case);
+    ATF_ADD_TEST_CASE(tcs, invalid_repeat);
 }
@@ -28,6 +28,7 @@
 
 #include "cli/cmd_list.hpp"
 
+#include <algorithm>
 #include <cstdlib>
 #include <utility>
 #include <vector>
@@ -35,25 +36,185 @@
 #include "cli/common.ipp"
 #include "drivers/list_tests.hpp"
 #include "engine/filters.hpp"
+#include "engine/kyuafile.hpp"
+#include "engine/scheduler.hpp"
 #include "model/metadata.hpp"
 #include "model/test_case.hpp"
 #include "model/test_program.hpp"
 #include "model/types.hpp"
+#include "utils/cmdline/exceptions.hpp"
 #include "utils/cmdline/options.hpp"
 #include "utils/cmdline/parser.ipp"
 #include "utils/cmdline/ui.hpp"
+#include "utils/datetime.hpp"
 #include "utils/defs.hpp"
 #include "utils/format/macros.hpp"
 #include "utils/fs/path.hpp"
+#include "utils/text/operations.hpp"
 
 namespace cmdline = utils::cmdline;
 namespace config = utils::config;
+namespace datetime = utils::datetime;
 namespace fs = utils::fs;
+namespace scheduler = engine::scheduler;
+namespace text = utils::text;
 
 
 namespace {
 
 
+/// Formats in which to print the listed test cases.
+enum output_format {
+    /// Human-readable text, one test case per line.
+    text_format,
+
+    /// Test case identifiers, each terminated by a NUL character.
+    nulsep_format,
+
+    /// One JSON object per line for each test case.
+    json_format
+};
+
+
+/// Formats a test case as a JSON object.
+///
+/// \param test_program The test program containing the test case.
+/// \param test_case_name The name of the test case.
+///
+/// \return A single-line JSON object describing the test case.
+static std::string
+json_test_case(const model::test_program& test_program,
+               const std::string& test_case_name)
+{
+    std::string record = F("{\"program\":\"%s\",\"case\":\"%s\","
+                           "\"test_suite\":\"%s\",\"metadata\":{") %
+        text::escape_json(test_program.relative_path().str()) %
+        text::escape_json(test_case_name) %
+        text::escape_json(test_program.test_suite_name());
+
+    const model::properties_map props = test_program.find(test_case_name)
+        .get_metadata().to_properties();
+    for (model::properties_map::const_iterator iter = props.begin();
+         iter != props.end(); ++iter) {
+        if (iter != props.begin())
+            record += ",";
+        record += F("\"%s\":\"%s\"") % text::escape_json((*iter).first) %
+            text::escape_json((*iter).second);
+    }
+    return record + "}}";
+}
+
+
+/// The path to a test program along with the statistics of its listing.
+typedef std::pair< std::string, scheduler::listing_stats > program_listing;
+
+
+/// Computes the time that listing a test program costs without the cache.
+///
+/// \param stats The statistics of the listing.
+///
+/// \return The duration of the listing that populated the cache for cached
+/// listings, if known, or the duration of the listing in this run otherwise.
+static datetime::delta
+listing_cost(const scheduler::listing_stats& stats)
+{
+    if (stats.source == scheduler::listing_cached && stats.cached_duration)
+        return stats.cached_duration.get();
+    return stats.duration;
+}
+
+
+/// Sorts listings by decreasing cost and then by test program.
+///
+/// \param a The first listing.
+/// \param b The second listing.
+///
+/// \return True if a has to be reported before b.
+static bool
+costlier_listing(const program_listing& a, const program_listing& b)
+{
+    const datetime::delta cost_a = listing_cost(a.second);
+    const datetime::delta cost_b = listing_cost(b.second);
+    if (cost_a != cost_b)
+        return cost_b < cost_a;
+    return a.first < b.first;
+}
+
+
+/// Formats the statistics of the listing of a test program.
+///
+/// \param listing The listing to format.
+///
+/// \return A single line with the time the listing took, how the test cases
+/// were obtained and how many there are.
+static std::string
+format_listing(const program_listing& listing)
+{
+    const scheduler::listing_stats& stats = listing.second;
+
+    std::string source;
+    switch (stats.source) {
+    case scheduler::listing_executed:
+        source = "executed";
+        break;
+
+    case scheduler::listing_cached:
+        if (stats.cached_duration)
+            source = F("cached from a %s listing") %
+                cli::format_delta(stats.cached_duration.get());
+        else
+            source = "cached";
+        break;
+
+    case scheduler::listing_known:
+        source = "known without executing";
+        break;
+    }
+
+    return F("%s  ->  %s  [%s; %s test %s]") % listing.first %
+        cli::format_delta(stats.duration) % source % stats.test_cases %
+        (stats.test_cases == 1 ? "case" : "cases");
+}
+
+
+/// Sorts Kyuafiles by decreasing cost of their own evaluation.
+///
+/// \param a The first Kyuafile.
+/// \param b The second Kyuafile.
+///
+/// \return True if a has to be reported before b.
+static bool
+costlier_kyuafile(const engine::kyuafile_stats& a,
+                  const engine::kyuafile_stats& b)
+{
+    if (a.self_duration != b.self_duration)
+        return b.self_duration < a.self_duration;
+    return a.file < b.file;
+}
+
+
+/// Prints the costs of the evaluation of the Kyuafiles.
+///
+/// \param ui Object to interact with the I/O of the program.
+/// \param profile The costs to print.  The Kyuafiles that took the longest
+///     to evaluate by themselves are printed first.
+static void
+print_kyuafile_profile(cmdline::ui* ui, engine::kyuafile_profile profile)
+{
+    std::sort(profile.begin(), profile.end(), costlier_kyuafile);
+    ui->out("");
+    ui->out("===> Kyuafile profile");
+    for (engine::kyuafile_profile::const_iterator iter = profile.begin();
+         iter != profile.end(); ++iter) {
+        ui->out(F("%s  ->  %s  [total: %s; %s fs operations; %s test "
+                  "programs]") % (*iter).file %
+                cli::format_delta((*iter).self_duration) %
+                cli::format_delta((*iter).duration) % (*iter).fs_operations %
+                (*iter).test_programs);
+    }
+}
+
+
 /// Hooks for list_tests to print test cases as they come.
 class progress_hooks : public drivers::list_tests::base_hooks {
     /// The ui object to which to print the test cases.
@@ -62,31 +223,116 @@ class progress_hooks : public drivers::list_tests::base_hooks {
     /// Whether to print test case details or just their names.
     bool _verbose;
 
+    /// Format in which to print the test cases.
+    output_format _format;
+
+    /// Statistics of the listing of every test program.
+    std::vector< program_listing > _listings;
+
 public:
     /// Initializes the hooks.
     ///
     /// \param ui_ The ui object to which to print the test cases.
     /// \param verbose_ Whether to print test case details or just their names.
-    progress_hooks(cmdline::ui* ui_, const bool verbose_) :
+    /// \param format_ Format in which to print the test cases.
+    progress_hooks(cmdline::ui* ui_, const bool verbose_,
+                   const output_format format_) :
         _ui(ui_),
-        _verbose(verbose_)
+        _verbose(verbose_),
+        _format(format_)
     {
     }
 
     /// Reports a test case as soon as it is found.
     ///
+    /// The machine-readable formats flush every test case so that consumers
+    /// reading from a pipe see them right away.
+    ///
     /// \param test_program The test program containing the test case.
     /// \param test_case_name The name of the located test case.
     void
     got_test_case(const model::test_program& test_program,
                   const std::string& test_case_name)
     {
-        cli::detail::list_test_case(_ui, _verbose, test_program,
-                                    test_case_name);
+        switch (_format) {
+        case text_format:
+            cli::detail::list_test_case(_ui, _verbose, test_program,
+                                        test_case_name);
+            break;
+
+        case nulsep_format:
+            _ui->out(cli::format_test_case_id(test_program, test_case_name) +
+                     '\0', false);
+            break;
+
+        case json_format:
+            _ui->out(json_test_case(test_program, test_case_name) + '\n',
+                     false);
+            break;
+        }
+    }
+
+    /// Records the statistics of the listing of a test program.
+    ///
+    /// \param test_program The listed test program.
+    /// \param stats The statistics of the listing.
+    void
+    got_listing(const model::test_program& test_program,
+                const scheduler::listing_stats& stats)
+    {
+        _listings.push_back(program_listing(
+            test_program.relative_path().str(), stats));
+    }
+
+    /// Prints the statistics of the listings, the slowest first.
+    void
+    print_stats(void)
+    {
+        std::sort(_listings.begin(), _listings.end(), costlier_listing);
+        _ui->out("");
+        _ui->out("===> Listing statistics");
+        for (std::vector< program_listing >::const_iterator iter =
+                 _listings.begin(); iter != _listings.end(); ++iter)
+            _ui->out(format_listing(*iter));
     }
 };
 
 
+/// Parses the value of the --format flag.
+///
+/// \param cmdline Representation of the command line to the subcommand.
+///
+/// \return The requested output format.
+///
+/// \throw cmdline::usage_error If the format is unknown or if it cannot be
+///     combined with other flags.
+static output_format
+get_format(const cmdline::parsed_cmdline& cmdline)
+{
+    const std::string format = cmdline.get_option< cmdline::string_option >(
+        "format");
+    if (format == "text")
+        return text_format;
+
+    if (cmdline.has_option("verbose"))
+        throw cmdline::usage_error(F("--verbose cannot be used with "
+                                     "--format=%s") % format);
+    if (cmdline.has_option("stats"))
+        throw cmdline::usage_error(F("--stats cannot be used with "
+                                     "--format=%s") % format);
+    if (cmdline.has_option("kyuafile-profile"))
+        throw cmdline::usage_error(F("--kyuafile-profile cannot be used with "
+                                     "--format=%s") % format);
+    if (format == "nulsep")
+        return nulsep_format;
+    else if (format == "json")
+        return json_format;
+    else
+        throw cmdline::usage_error(F("Invalid value for --format: %s; must be "
+                                     "one of text, nulsep or json") % format);
+}
+
+
 }  // anonymous namespace
 
 
@@ -107,7 +353,8 @@ cli::detail::list_test_case(cmdline::ui* ui, const bool verbose,
     if (!verbose) {
         ui->out(id);
     } else {
-        ui->out(F("%s (%s)") % id % test_program.test_suite_name());
+        std::vector< std::string > lines;
+        lines.push_back(F("%s (%s)") % id % test_program.test_suite_name());
 
         // TODO(jmmv): Running these for every test case is probably not the
         // fastest thing to do.
@@ -123,8 +370,10 @@ cli::detail::list_test_case(cmdline::ui* ui, const bool verbose,
                 default_props.find((*iter).first);
             if (default_iter == default_props.end() ||
                 (*iter).second != (*default_iter).second)
-                ui->out(F("    %s = %s") % (*iter).first % (*iter).second);
+                lines.push_back(F("    %s = %s") % (*iter).first %
+                                (*iter).second);
         }
+        ui->out_lines(lines);
     }
 }
 
@@ -136,7 +385,19 @@ cli::cmd_list::cmd_list(void) :
 {
     add_option(build_root_option);
     add_option(kyuafile_option);
+    add_option(metadata_filter_option);
+    add_option(shard_option);
     add_option(cmdline::bool_option('v', "verbose", "Show properties"));
+    add_option(cmdline::string_option(
+        "format", "Output format: text, nulsep or json", "format", "text"));
+    add_option(cmdline::bool_option(
+        "completion-order", "Print the test cases of each test program as "
+        "soon as it is listed instead of in Kyuafile order"));
+    add_option(cmdline::bool_option(
+        "stats", "Print how long the listing of each test program took"));
+    add_option(cmdline::bool_option(
+        "kyuafile-profile", "Print how long the evaluation of each Kyuafile "
+        "took"));
 }
 
 
@@ -151,10 +412,18 @@ int
 cli::cmd_list::run(cmdline::ui* ui, const cmdline::parsed_cmdline& cmdline,
                    const config::tree& user_config)
 {
-    progress_hooks hooks(ui, cmdline.has_option("verbose"));
+    progress_hooks hooks(ui, cmdline.has_option("verbose"),
+                         get_format(cmdline));
     const drivers::list_tests::result result = drivers::list_tests::drive(
         kyuafile_path(cmdline), build_root_path(cmdline),
-        parse_filters(cmdline.arguments()), user_config, hooks);
+        parse_filters(cmdline.arguments()), get_shard(cmdline),
+        get_metadata_filters(cmdline), user_config,
+        cmdline.has_option("completion-order"), hooks,
+        cmdline.has_option("kyuafile-profile"));
+    if (cmdline.has_option("stats"))
+        hooks.print_stats();
+    if (cmdline.has_option("kyuafile-profile"))
+        print_kyuafile_profile(ui, result.kyuafile_profile);
 
     return report_unused_filters(result.unused_filters, ui) ?
         EXIT_FAILURE : EXIT_SUCCESS;
@@ -33,11 +33,13 @@
 #include <cstdlib>
 #include <map>
 #include <ostream>
+#include <set>
 #include <string>
 #include <vector>
 
 #include "cli/common.ipp"
 #include "drivers/scan_results.hpp"
+#include "engine/filters.hpp"
 #include "model/context.hpp"
 #include "model/metadata.hpp"
 #include "model/test_case.hpp"
@@ -45,7 +47,9 @@
 #include "model/test_result.hpp"
 #include "model/types.hpp"
 #include "store/layout.hpp"
+#include "store/read_backend.hpp"
 #include "store/read_transaction.hpp"
+#include "store/trends.hpp"
 #include "utils/cmdline/exceptions.hpp"
 #include "utils/cmdline/options.hpp"
 #include "utils/cmdline/parser.ipp"
@@ -53,7 +57,9 @@
 #include "utils/datetime.hpp"
 #include "utils/defs.hpp"
 #include "utils/format/macros.hpp"
+#include "utils/fs/operations.hpp"
 #include "utils/fs/path.hpp"
+#include "utils/logging/macros.hpp"
 #include "utils/optional.ipp"
 #include "utils/sanity.hpp"
 #include "utils/stream.hpp"
@@ -73,6 +79,92 @@ using utils::optional;
 namespace {
 
 
+/// Time to wait between polls of the results file when following it.
+static const datetime::delta follow_poll_interval(1, 0);
+
+
+/// Number of runs, including the reported one, to compare durations against.
+static const std::size_t slowdown_runs = 10;
+
+
+/// Maximum number of slowed down test cases to include in the report.
+static const std::size_t slowdown_limit = 10;
+
+
+/// Finds the test cases that got slower in the run of a results file.
+///
+/// The results file is added to the trends index along with any other results
+/// files of the test suite of the current directory that are missing from it.
+///
+/// \param results_file The results file being reported.
+/// \param threshold Fraction of the previous mean duration by which a test
+///     case must have slowed down to be reported.
+///
+/// \return The test cases that got slower, sorted by decreasing slowdown.
+///
+/// \throw store::error If the trends index cannot be updated or queried.
+static store::case_trends_vector
+find_slowdowns(const fs::path& results_file, const double threshold)
+{
+    const std::string test_suite = layout::test_suite_for_path(
+        fs::current_path());
+
+    const fs::path trends_file = layout::query_trends_file();
+    fs::mkdir_p(trends_file.branch_path(), 0755);
+    store::trends_index index = store::trends_index::open_rw(trends_file);
+    const std::size_t added = index.sync(test_suite);
+    LI(F("Added %s results files to the trends index") % added);
+    index.add_run(test_suite, results_file);
+    const store::case_trends_vector trends = index.slowdowns_in(
+        results_file, slowdown_runs, slowdown_limit, threshold);
+    index.close();
+    return trends;
+}
+
+
+/// Loads the stored aggregates of the results in a results file.
+///
+/// \param results_file The results file to read.
+///
+/// \return The summary of all the results in the file.
+///
+/// \throw store::error If the results file cannot be read.
+static store::results_summary
+load_summary(const fs::path& results_file)
+{
+    store::read_backend db = store::read_backend::open_ro(results_file);
+    store::read_transaction tx = db.start_read();
+    const store::results_summary summary = tx.get_summary();
+    tx.finish();
+    db.close();
+    return summary;
+}
+
+
+/// Time spent by the execution slots in each activity, keyed by its name.
+typedef std::map< std::string, datetime::delta > slot_usage_map;
+
+
+/// Loads the use of the execution slots recorded in a results file.
+///
+/// \param results_file The results file to read.
+///
+/// \return The time spent by the slots in each activity; empty if the run did
+/// not record it.
+///
+/// \throw store::error If the results file cannot be read.
+static slot_usage_map
+load_slot_usage(const fs::path& results_file)
+{
+    store::read_backend db = store::read_backend::open_ro(results_file);
+    store::read_transaction tx = db.start_read();
+    const slot_usage_map usage = tx.get_slot_usage();
+    tx.finish();
+    db.close();
+    return usage;
+}
+
+
 /// Generates a plain-text report intended to be printed to the console.
 class report_console_hooks : public drivers::scan_results::base_hooks {
     /// Stream to which to write the report.
@@ -81,12 +173,26 @@ class report_console_hooks : public drivers::scan_results::base_hooks {
     /// Whether to include details in the report or not.
     const bool _verbose;
 
+    /// Whether to print results as they are received or not.
+    const bool _follow;
+
     /// Collection of result types to include in the report.
     const cli::result_types& _results_filters;
 
     /// Path to the results file being read.
     const fs::path& _results_file;
 
+    /// Test cases that got slower compared to previous runs.
+    const store::case_trends_vector& _slowdowns;
+
+    /// Stored aggregates of all results, if the summary can be based on them.
+    ///
+    /// If present, only the results of the types to be printed are scanned.
+    const optional< store::results_summary > _summary;
+
+    /// Use of the execution slots to report; none to not report it.
+    const optional< slot_usage_map > _slot_usage;
+
     /// The start time of the first test.
     optional< utils::datetime::timestamp > _start_time;
 
@@ -227,10 +333,19 @@ class report_console_hooks : public drivers::scan_results::base_hooks {
         }
     }
 
-    /// Counts how many results of a given type have been received.
+    /// Counts how many results of a given type are in the summary.
     std::size_t
     count_results(const model::test_result_type type)
     {
+        if (_summary) {
+            const std::map< model::test_result_type, std::size_t >&
+                counts = _summary.get().counts;
+            const std::map< model::test_result_type,
+                            std::size_t >::const_iterator iter =
+                counts.find(type);
+            return iter == counts.end() ? 0 : (*iter).second;
+        }
+
         const std::map< model::test_result_type,
                         std::vector< result_data > >::const_iterator iter =
             _results.find(type);
@@ -240,6 +355,17 @@ class report_console_hooks : public drivers::scan_results::base_hooks {
             return (*iter).second.size();
     }
 
+    /// Prints a single result in the summary format.
+    ///
+    /// \param data The result to print.
+    void
+    print_result(const result_data& data)
+    {
+        _output << F("%s:%s  ->  %s  [%s]\n") % data.binary_path %
+            data.test_case_name % cli::format_result(data.result) %
+            cli::format_delta(data.duration);
+    }
+
     /// Prints a set of results.
     void
     print_results(const model::test_result_type type,
@@ -255,10 +381,7 @@ class report_console_hooks : public drivers::scan_results::base_hooks {
         _output << F("===> %s\n") % title;
         for (std::vector< result_data >::const_iterator iter = all.begin();
              iter != all.end(); iter++) {
-            _output << F("%s:%s  ->  %s  [%s]\n") % (*iter).binary_path %
-                (*iter).test_case_name %
-                cli::format_result((*iter).result) %
-                cli::format_delta((*iter).duration);
+            print_result(*iter);
         }
     }
 
@@ -267,18 +390,65 @@ public:
     ///
     /// \param [out] output_ Stream to which to write the report.
     /// \param verbose_ Whether to include details in the output or not.
+    /// \param follow_ Whether to print results as they are received instead
+    ///     of grouping them at the end.
     /// \param results_filters_ The result types to include in the report.
     ///     Cannot be empty.
     /// \param results_file_ Path to the results file being read.
+    /// \param slowdowns_ Test cases that got slower compared to previous runs.
+    /// \param summary_ Stored aggregates of all the results to be scanned, if
+    ///     any.  Cannot be used when following.
+    /// \param slot_usage_ Use of the execution slots to report, if any.
     report_console_hooks(std::ostream& output_, const bool verbose_,
+                         const bool follow_,
                          const cli::result_types& results_filters_,
-                         const fs::path& results_file_) :
+                         const fs::path& results_file_,
+                         const store::case_trends_vector& slowdowns_,
+                         const optional< store::results_summary >& summary_,
+                         const optional< slot_usage_map >& slot_usage_) :
         _output(output_),
         _verbose(verbose_),
+        _follow(follow_),
         _results_filters(results_filters_),
-        _results_file(results_file_)
+        _results_file(results_file_),
+        _slowdowns(slowdowns_),
+        _summary(summary_),
+        _slot_usage(slot_usage_)
     {
         PRE(!results_filters_.empty());
+        PRE(!follow_ || !summary_);
+    }
+
+    /// Describes the data needed by the hooks.
+    ///
+    /// Without a stored summary, the summary includes all result types, so all
+    /// results are requested.  Otherwise, only the results to be printed are.
+    /// In both cases, their output is only loaded when it will be printed.
+    ///
+    /// \return A filter for the results to scan.
+    store::results_filter
+    wanted_results(void) const
+    {
+        store::results_filter filter;
+        if (_summary) {
+            for (cli::result_types::const_iterator
+                     iter = _results_filters.begin();
+                 iter != _results_filters.end(); ++iter)
+                filter.add_result_type(*iter);
+        }
+        if (!_verbose)
+            filter.without_files();
+        return filter;
+    }
+
+    /// Checks whether the environment variables of the context are needed.
+    ///
+    /// \return True if the report is verbose, as only then is the context
+    /// printed.
+    bool
+    wants_env_vars(void) const
+    {
+        return _verbose;
     }
 
     /// Callback executed when the context is loaded.
@@ -310,14 +480,57 @@ public:
             result_data(iter.test_program()->relative_path(),
                         iter.test_case_name(), iter.result(), duration));
 
+        // TODO(jmmv): _results_filters is a list and is small enough for
+        // std::find to not be an expensive operation here (probably).  But we
+        // should be using a std::set instead.
+        const bool wanted = std::find(_results_filters.begin(),
+                                      _results_filters.end(),
+                                      result.type()) != _results_filters.end();
         if (_verbose) {
-            // TODO(jmmv): _results_filters is a list and is small enough for
-            // std::find to not be an expensive operation here (probably).  But
-            // we should be using a std::set instead.
-            if (std::find(_results_filters.begin(), _results_filters.end(),
-                          iter.result().type()) != _results_filters.end()) {
+            if (wanted)
                 print_test_case_and_result(iter);
-            }
+        } else if (_follow) {
+            if (wanted)
+                print_result(_results[result.type()].back());
+        }
+        if (_follow)
+            _output.flush();
+    }
+
+    /// Prints the use of the execution slots.
+    ///
+    /// \param usage The time spent by the slots in each activity.
+    void
+    print_slot_usage(const slot_usage_map& usage)
+    {
+        static const char* const activities[][2] = {
+            { "test", "Running tests" },
+            { "list", "Listing test programs" },
+            { "spawn", "Spawning subprocesses" },
+            { "store", "Storing results" },
+            { "cleanup", "Cleaning up" },
+            { "exclusive", "Running exclusive tests" },
+            { "idle", "Idle" },
+        };
+
+        _output << "===> Slot usage\n";
+        int64_t total = 0;
+        for (slot_usage_map::const_iterator iter = usage.begin();
+             iter != usage.end(); ++iter)
+            total += (*iter).second.to_microseconds();
+        if (total == 0) {
+            _output << "Not recorded\n";
+            return;
+        }
+        for (std::size_t i = 0; i < sizeof(activities) / sizeof(activities[0]);
+             ++i) {
+            const slot_usage_map::const_iterator iter = usage.find(
+                activities[i][0]);
+            const datetime::delta time = iter == usage.end() ?
+                datetime::delta() : (*iter).second;
+            _output << F("%s: %s (%.1s%%)\n") % activities[i][1] %
+                cli::format_delta(time) %
+                (time.to_microseconds() * 100.0 / total);
         }
     }
 
@@ -336,14 +549,26 @@ public:
         titles[model::test_result_passed] = "Passed tests";
         titles[model::test_result_skipped] = "Skipped tests";
 
+        // When following, the results have already been printed as they
+        // were received.
         for (cli::result_types::const_iterator iter = _results_filters.begin();
-             iter != _results_filters.end(); ++iter) {
+             !_follow && iter != _results_filters.end(); ++iter) {
             const types_map::const_iterator match = titles.find(*iter);
             INV_MSG(match != titles.end(), "Conditional does not match user "
                     "input validation in parse_types()");
             print_results((*match).first, (*match).second);
         }
 
+        if (!_slowdowns.empty()) {
+            _output << "===> Slowed down tests\n";
+            for (store::case_trends_vector::const_iterator iter =
+                     _slowdowns.begin(); iter != _slowdowns.end(); ++iter)
+                _output << cli::format_trend(*iter) << "\n";
+        }
+
+        if (_slot_usage)
+            print_slot_usage(_slot_usage.get());
+
         const std::size_t broken = count_results(model::test_result_broken);
         const std::size_t failed = count_results(model::test_result_failed);
         const std::size_t passed = count_results(model::test_result_passed);
@@ -352,19 +577,28 @@ public:
             model::test_result_expected_failure);
         const std::size_t total = broken + failed + passed + skipped + xfail;
 
+        optional< datetime::timestamp > start_time = _start_time;
+        optional< datetime::timestamp > end_time = _end_time;
+        datetime::delta runtime = _runtime;
+        if (_summary) {
+            start_time = _summary.get().start_time;
+            end_time = _summary.get().end_time;
+            runtime = _summary.get().total_duration;
+        }
+
         _output << "===> Summary\n";
         _output << F("Results read from %s\n") % _results_file;
         _output << F("Test cases: %s total, %s skipped, %s expected failures, "
                      "%s broken, %s failed\n") %
             total % skipped % xfail % broken % failed;
-        if (_verbose && _start_time) {
-            INV(_end_time);
+        if (_verbose && start_time) {
+            INV(end_time);
             _output << F("Start time: %s\n") %
-                    _start_time.get().to_iso8601_in_utc();
+                    start_time.get().to_iso8601_in_utc();
             _output << F("End time:   %s\n") %
-                    _end_time.get().to_iso8601_in_utc();
+                    end_time.get().to_iso8601_in_utc();
         }
-        _output << F("Total time: %s\n") % cli::format_delta(_runtime);
+        _output << F("Total time: %s\n") % cli::format_delta(runtime);
     }
 };
 
@@ -384,6 +618,18 @@ cmd_report::cmd_report(void) : cli_command(
     add_option(cmdline::path_option("output", "Path to the output file", "path",
                                     "/dev/stdout"));
     add_option(results_filter_option);
+    add_option(cmdline::bool_option(
+        "follow", "Keep reading the results file and print new results as "
+        "they are stored by a concurrent test run"));
+    add_option(cmdline::int_option(
+        "follow-timeout", "When following, seconds without new results after "
+        "which to stop; 0 to never stop", "seconds", "0"));
+    add_option(cmdline::int_option(
+        "slowdown-threshold", "Report the test cases whose duration exceeds "
+        "their mean over previous runs by more than this percentage",
+        "percent"));
+    add_option(cmdline::bool_option(
+        "stats", "Include how the execution slots were used during the run"));
 }
 
 
@@ -406,11 +652,54 @@ cmd_report::run(cmdline::ui* ui,
     const fs::path results_file = layout::find_results(
         results_file_open(cmdline));
 
+    const int follow_timeout = cmdline.get_option< cmdline::int_option >(
+        "follow-timeout");
+    if (follow_timeout < 0)
+        throw cmdline::usage_error(F("Invalid value for --follow-timeout: %s; "
+                                     "must be positive or 0") %
+                                   follow_timeout);
+    const bool follow = cmdline.has_option("follow");
+
+    store::case_trends_vector slowdowns;
+    if (cmdline.has_option("slowdown-threshold")) {
+        const int threshold = cmdline.get_option< cmdline::int_option >(
+            "slowdown-threshold");
+        if (threshold < 0)
+            throw cmdline::usage_error(F("Invalid value for "
+                                         "--slowdown-threshold: %s; must be "
+                                         "positive or 0") % threshold);
+        if (follow)
+            throw cmdline::usage_error("--slowdown-threshold cannot be used "
+                                       "with --follow");
+        slowdowns = find_slowdowns(results_file, threshold / 100.0);
+    }
+
+    const std::set< engine::test_filter > filters = parse_filters(
+        cmdline.arguments());
+
+    // The stored aggregates cover all results, so they only match the report
+    // when the results are not restricted to some test cases.  They are also
+    // incomplete while the results file is still being written to.
+    optional< store::results_summary > summary;
+    if (filters.empty() && !follow)
+        summary = load_summary(results_file);
+
+    optional< slot_usage_map > slot_usage;
+    if (cmdline.has_option("stats")) {
+        if (follow)
+            throw cmdline::usage_error("--stats cannot be used with --follow");
+        slot_usage = load_slot_usage(results_file);
+    }
+
     const result_types types = get_result_types(cmdline);
     report_console_hooks hooks(*output.get(), cmdline.has_option("verbose"),
-                               types, results_file);
-    const drivers::scan_results::result result = drivers::scan_results::drive(
-        results_file, parse_filters(cmdline.arguments()), hooks);
+                               follow, types, results_file, slowdowns,
+                               summary, slot_usage);
+    const drivers::scan_results::result result = follow ?
+        drivers::scan_results::follow(results_file, filters, hooks,
+                                      follow_poll_interval,
+                                      datetime::delta(follow_timeout, 0)) :
+        drivers::scan_results::drive(results_file, filters, hooks);
 
     return report_unused_filters(result.unused_filters, ui) ?
         EXIT_FAILURE : EXIT_SUCCESS;
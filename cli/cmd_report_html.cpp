@@ -31,8 +31,16 @@
 #include <algorithm>
 #include <cerrno>
 #include <cstdlib>
+#include <deque>
+#include <fstream>
 #include <set>
 #include <stdexcept>
+#include <utility>
+#include <vector>
+
+extern "C" {
+#include <unistd.h>
+}
 
 #include "cli/common.ipp"
 #include "drivers/scan_results.hpp"
@@ -54,6 +62,11 @@
 #include "utils/fs/operations.hpp"
 #include "utils/fs/path.hpp"
 #include "utils/optional.ipp"
+#include "utils/process/child.ipp"
+#include "utils/process/status.hpp"
+#include "utils/shared_ptr.hpp"
+#include "utils/stream.hpp"
+#include "utils/text/exceptions.hpp"
 #include "utils/text/templates.hpp"
 
 namespace cmdline = utils::cmdline;
@@ -61,8 +74,10 @@ namespace config = utils::config;
 namespace datetime = utils::datetime;
 namespace fs = utils::fs;
 namespace layout = store::layout;
+namespace process = utils::process;
 namespace text = utils::text;
 
+using utils::none;
 using utils::optional;
 
 
@@ -141,6 +156,98 @@ add_map(text::templates_def& templates, const config::properties_map& props,
 }
 
 
+/// Number of test case pages to hand to every rendering subprocess.
+///
+/// Each subprocess renders a whole batch to amortize the cost of the fork.
+static const std::size_t pages_per_batch = 64;
+
+
+/// Maximum number of bytes of each output of a test case to show in its page.
+///
+/// Larger outputs are cut so that a few huge logs do not bloat the report nor
+/// the pages held in memory until they are rendered.
+static const std::size_t max_output_length = 1024 * 1024;
+
+
+/// Loads an output of a test case for its page, truncating it if necessary.
+///
+/// \param iter The iterator positioned at the test case.
+/// \param is_stdout Whether to load the stdout or the stderr of the test case.
+///
+/// \return The contents of the output, ending in a note of the bytes omitted
+/// if it is too large, or none if the test case did not print anything.
+static optional< std::string >
+load_output(store::results_iterator& iter, const bool is_stdout)
+{
+    const std::size_t size = is_stdout ? iter.stdout_size() :
+        iter.stderr_size();
+    if (size == 0)
+        return none;
+
+    std::string text = is_stdout ? iter.stdout_read(0, max_output_length) :
+        iter.stderr_read(0, max_output_length);
+    if (size > text.length())
+        text += F("\n[%s more bytes of output omitted]\n") %
+            (size - text.length());
+    return utils::make_optional(text);
+}
+
+
+/// Collection of pages to render, as their templates and output files.
+typedef std::vector< std::pair< text::templates_def, fs::path > > pages_vector;
+
+
+/// Applies a set of templates to a compiled template and writes an output file.
+///
+/// \param templates The templates to use.
+/// \param compiled The compiled template to apply.
+/// \param output_path The path to the file into which to write the output.
+///
+/// \throw text::error If the output file cannot be opened.
+/// \throw text::syntax_error If there is any problem processing the input.
+static void
+render(const text::templates_def& templates,
+       const text::compiled_template& compiled, const fs::path& output_path)
+{
+    std::ofstream output(output_path.c_str());
+    if (!output)
+        throw text::error(F("Failed to open %s for write") % output_path);
+    text::instantiate(templates, compiled, output);
+}
+
+
+/// Functor to render a batch of pages in a subprocess.
+class render_pages {
+    /// The compiled template to apply to all pages.
+    const text::compiled_template& _compiled;
+
+    /// The pages to render.
+    const pages_vector& _pages;
+
+public:
+    /// Constructor.
+    ///
+    /// \param compiled The compiled template to apply.
+    /// \param pages The pages to render.
+    render_pages(const text::compiled_template& compiled,
+                 const pages_vector& pages) :
+        _compiled(compiled),
+        _pages(pages)
+    {
+    }
+
+    /// Body of the subprocess.
+    void
+    operator()(void)
+    {
+        for (pages_vector::const_iterator iter = _pages.begin();
+             iter != _pages.end(); ++iter)
+            render((*iter).first, _compiled, (*iter).second);
+        ::_exit(EXIT_SUCCESS);
+    }
+};
+
+
 /// Generates an HTML report.
 class html_hooks : public drivers::scan_results::base_hooks {
     /// User interface object where to report progress.
@@ -150,7 +257,7 @@ class html_hooks : public drivers::scan_results::base_hooks {
     fs::path _directory;
 
     /// Collection of result types to include in the report.
-    const cli::result_types& _results_filters;
+    const cli::result_types _results_filters;
 
     /// The start time of the first test.
     optional< utils::datetime::timestamp > _start_time;
@@ -168,6 +275,18 @@ class html_hooks : public drivers::scan_results::base_hooks {
     /// Mapping of result types to the amount of tests with such result.
     std::map< model::test_result_type, std::size_t > _types_count;
 
+    /// Maximum number of subprocesses rendering test case pages at once.
+    const std::size_t _parallelism;
+
+    /// Templates loaded and compiled so far, by template name.
+    std::map< std::string, text::compiled_template > _compiled_templates;
+
+    /// Test case pages waiting to be handed to a subprocess.
+    pages_vector _pending_pages;
+
+    /// Subprocesses rendering test case pages, oldest first.
+    std::deque< std::shared_ptr< process::child > > _renderers;
+
     /// Generates a common set of templates for all of our files.
     ///
     /// \return A new templates object with common parameters.
@@ -249,15 +368,89 @@ class html_hooks : public drivers::scan_results::base_hooks {
     void
     generate(const text::templates_def& templates,
              const std::string& template_name,
-             const std::string& output_name) const
+             const std::string& output_name)
     {
-        const fs::path miscdir(utils::getenv_with_default(
-             "KYUA_MISCDIR", KYUA_MISCDIR));
-        const fs::path template_file = miscdir / template_name;
         const fs::path output_path(_directory / output_name);
 
         _ui->out(F("Generating %s") % output_path);
-        text::instantiate(templates, template_file, output_path);
+        render(templates, load_template(template_name), output_path);
+    }
+
+    /// Loads a template, reading and compiling it only the first time.
+    ///
+    /// \param template_name The name of the template.  This is automatically
+    ///     searched for in the installed directory, so do not provide a path.
+    ///
+    /// \return The compiled template.
+    ///
+    /// \throw text::error If the template cannot be read or is invalid.
+    const text::compiled_template&
+    load_template(const std::string& template_name)
+    {
+        std::map< std::string, text::compiled_template >::const_iterator iter =
+            _compiled_templates.find(template_name);
+        if (iter == _compiled_templates.end()) {
+            const fs::path miscdir(utils::getenv_with_default(
+                 "KYUA_MISCDIR", KYUA_MISCDIR));
+            const fs::path template_file = miscdir / template_name;
+
+            std::ifstream input(template_file.c_str());
+            if (!input)
+                throw text::error(F("Failed to open %s for read") %
+                                  template_file);
+            iter = _compiled_templates.insert(std::make_pair(
+                template_name, text::compile(input))).first;
+        }
+        return (*iter).second;
+    }
+
+    /// Waits for the oldest subprocess rendering test case pages.
+    ///
+    /// \throw std::runtime_error If the subprocess failed to render its pages.
+    void
+    wait_oldest_renderer(void)
+    {
+        PRE(!_renderers.empty());
+        const std::shared_ptr< process::child > child = _renderers.front();
+        _renderers.pop_front();
+
+        std::string output = utils::read_stream(child->output());
+        const process::status status = child->wait();
+        if (!status.exited() || status.exitstatus() != EXIT_SUCCESS) {
+            output.erase(output.find_last_not_of('\n') + 1);
+            throw std::runtime_error(F("Failed to generate test case pages: "
+                                       "%s") % output);
+        }
+    }
+
+    /// Renders the pending test case pages.
+    ///
+    /// The pages are rendered by a subprocess in the background unless no
+    /// parallelism was requested, in which case they are rendered right away.
+    ///
+    /// \throw std::runtime_error If a previous subprocess failed to render
+    ///     its pages.
+    void
+    flush_pending_pages(void)
+    {
+        if (_pending_pages.empty())
+            return;
+
+        const text::compiled_template& compiled = load_template(
+            "test_result.html");
+        if (_parallelism == 1) {
+            for (pages_vector::const_iterator iter = _pending_pages.begin();
+                 iter != _pending_pages.end(); ++iter)
+                render((*iter).first, compiled, (*iter).second);
+        } else {
+            while (_renderers.size() >= _parallelism)
+                wait_oldest_renderer();
+            _renderers.push_back(std::shared_ptr< process::child >(
+                process::child::fork_capture(
+                    render_pages(compiled, _pending_pages))
+                .release()));
+        }
+        _pending_pages.clear();
     }
 
     /// Gets the number of tests with a given result type.
@@ -284,14 +477,19 @@ public:
     /// \param directory_ The directory in which to create the HTML files.
     /// \param results_filters_ The result types to include in the report.
     ///     Cannot be empty.
+    /// \param parallelism_ Maximum number of subprocesses to render the test
+    ///     case pages with.
     html_hooks(cmdline::ui* ui_, const fs::path& directory_,
-               const cli::result_types& results_filters_) :
+               const cli::result_types& results_filters_,
+               const std::size_t parallelism_) :
         _ui(ui_),
         _directory(directory_),
         _results_filters(results_filters_),
-        _summary_templates(common_templates())
+        _summary_templates(common_templates()),
+        _parallelism(parallelism_)
     {
         PRE(!results_filters_.empty());
+        PRE(parallelism_ >= 1);
 
         // Keep in sync with add_to_summary().
         _summary_templates.add_vector("broken_test_cases");
@@ -363,27 +561,35 @@ public:
                 "metadata_var", "metadata_value");
 
         {
-            const std::string stdout_text = iter.stdout_contents();
-            if (!stdout_text.empty())
-                templates.add_variable("stdout", stdout_text);
+            const optional< std::string > stdout_text = load_output(iter, true);
+            if (stdout_text)
+                templates.add_variable("stdout", stdout_text.get());
         }
         {
-            const std::string stderr_text = iter.stderr_contents();
-            if (!stderr_text.empty())
-                templates.add_variable("stderr", stderr_text);
+            const optional< std::string > stderr_text = load_output(iter,
+                                                                    false);
+            if (stderr_text)
+                templates.add_variable("stderr", stderr_text.get());
         }
 
-        generate(templates, "test_result.html",
-                 test_case_filename(*test_program, test_case_name));
+        const fs::path output_path(
+            _directory / test_case_filename(*test_program, test_case_name));
+        _ui->out(F("Generating %s") % output_path);
+        _pending_pages.push_back(std::make_pair(templates, output_path));
+        if (_pending_pages.size() >= pages_per_batch)
+            flush_pending_pages();
     }
 
     /// Writes the index.html file in the output directory.
     ///
-    /// This should only be called once all the processing has been done;
-    /// i.e. when the scan_results driver returns.
+    /// \param unused_r A structure with all results computed by the driver.
     void
-    write_summary(void)
+    end(const drivers::scan_results::result& UTILS_UNUSED_PARAM(r))
     {
+        flush_pending_pages();
+        while (!_renderers.empty())
+            wait_oldest_renderer();
+
         const std::size_t n_passed = get_count(model::test_result_passed);
         const std::size_t n_failed = get_count(model::test_result_failed);
         const std::size_t n_skipped = get_count(model::test_result_skipped);
@@ -426,6 +632,35 @@ public:
 }  // anonymous namespace
 
 
+/// Creates the hooks to generate an HTML report.
+///
+/// The report includes the pages of the test cases with the default result
+/// types of the report-html command.
+///
+/// \param ui Object to interact with the I/O of the program.
+/// \param directory The directory in which to create the HTML files.  Must not
+///     exist yet.
+/// \param user_config The runtime configuration of the program.
+///
+/// \return The hooks to feed the results of a test suite run to.
+///
+/// \throw std::runtime_error If the output directory already exists.
+std::auto_ptr< drivers::scan_results::base_hooks >
+cli::new_html_hooks(cmdline::ui* ui, const fs::path& directory,
+                    const config::tree& user_config)
+{
+    result_types types;
+    types.push_back(model::test_result_skipped);
+    types.push_back(model::test_result_expected_failure);
+    types.push_back(model::test_result_broken);
+    types.push_back(model::test_result_failed);
+    create_top_directory(directory, false);
+    return std::auto_ptr< drivers::scan_results::base_hooks >(
+        new html_hooks(ui, directory, types,
+                       subprocess_parallelism(user_config)));
+}
+
+
 /// Default constructor for cmd_report_html.
 cli::cmd_report_html::cmd_report_html(void) : cli_command(
     "report-html", "", 0, 0,
@@ -448,14 +683,14 @@ cli::cmd_report_html::cmd_report_html(void) : cli_command(
 ///
 /// \param ui Object to interact with the I/O of the program.
 /// \param cmdline Representation of the command line to the subcommand.
-/// \param unused_user_config The runtime configuration of the program.
+/// \param user_config The runtime configuration of the program.
 ///
 /// \return 0 if everything is OK, 1 if the statement is invalid or if there is
 /// any other problem.
 int
 cli::cmd_report_html::run(cmdline::ui* ui,
                           const cmdline::parsed_cmdline& cmdline,
-                          const config::tree& UTILS_UNUSED_PARAM(user_config))
+                          const config::tree& user_config)
 {
     const result_types types = get_result_types(cmdline);
 
@@ -465,11 +700,11 @@ cli::cmd_report_html::run(cmdline::ui* ui,
     const fs::path directory =
         cmdline.get_option< cmdline::path_option >("output");
     create_top_directory(directory, cmdline.has_option("force"));
-    html_hooks hooks(ui, directory, types);
+    html_hooks hooks(ui, directory, types,
+                     subprocess_parallelism(user_config));
     drivers::scan_results::drive(results_file,
                                  std::set< engine::test_filter >(),
                                  hooks);
-    hooks.write_summary();
 
     return EXIT_SUCCESS;
 }
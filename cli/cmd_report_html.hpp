@@ -32,8 +32,13 @@
 #if !defined(CLI_CMD_REPORT_HTML_HPP)
 #define CLI_CMD_REPORT_HTML_HPP
 
+#include <memory>
+
 #include "cli/common.hpp"
+#include "drivers/scan_results.hpp"
 #include "utils/cmdline/ui_fwd.hpp"
+#include "utils/config/tree_fwd.hpp"
+#include "utils/fs/path_fwd.hpp"
 
 namespace cli {
 
@@ -49,6 +54,10 @@ public:
 };
 
 
+std::auto_ptr< drivers::scan_results::base_hooks > new_html_hooks(
+    utils::cmdline::ui*, const utils::fs::path&, const utils::config::tree&);
+
+
 }  // namespace cli
 
 
@@ -0,0 +1,142 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "cli/cmd_report_json.hpp"
+
+#include <cstddef>
+#include <cstdlib>
+#include <ostream>
+#include <set>
+#include <stdexcept>
+#include <vector>
+
+#include "cli/common.ipp"
+#include "drivers/report_json.hpp"
+#include "drivers/scan_results.hpp"
+#include "engine/filters.hpp"
+#include "store/layout.hpp"
+#include "utils/cmdline/exceptions.hpp"
+#include "utils/cmdline/options.hpp"
+#include "utils/cmdline/parser.ipp"
+#include "utils/defs.hpp"
+#include "utils/format/macros.hpp"
+#include "utils/fs/path.hpp"
+#include "utils/optional.ipp"
+#include "utils/shared_ptr.hpp"
+#include "utils/stream.hpp"
+#include "utils/units.hpp"
+
+namespace cmdline = utils::cmdline;
+namespace config = utils::config;
+namespace fs = utils::fs;
+namespace layout = store::layout;
+namespace units = utils::units;
+
+using cli::cmd_report_json;
+using utils::optional;
+
+
+/// Default constructor for cmd_report.
+cmd_report_json::cmd_report_json(void) : cli_command(
+    "report-json", "", 0, 0,
+    "Generates a newline-delimited JSON report with the result of a test "
+    "suite run")
+{
+    add_option(results_file_open_option);
+    add_option(cmdline::path_option("output", "Path to the output file", "path",
+                                    "/dev/stdout"));
+    add_option(cmdline::int_option(
+        "shards", "Number of files to split the report into; requires "
+        "--output", "count", "1"));
+    add_option(cmdline::bool_option(
+        "with-output", "Include the stdout and stderr of every test case"));
+    add_option(cmdline::string_option(
+        "output-limit", "Maximum amount of stdout and stderr to include for "
+        "every test case; 0 for no limit", "bytes", "0"));
+}
+
+
+/// Entry point for the "report-json" subcommand.
+///
+/// \param unused_ui Object to interact with the I/O of the program.
+/// \param cmdline Representation of the command line to the subcommand.
+/// \param unused_user_config The runtime configuration of the program.
+///
+/// \return 0 if everything is OK, 1 if the statement is invalid or if there is
+/// any other problem.
+int
+cmd_report_json::run(cmdline::ui* UTILS_UNUSED_PARAM(ui),
+                     const cmdline::parsed_cmdline& cmdline,
+                     const config::tree& UTILS_UNUSED_PARAM(user_config))
+{
+    const fs::path results_file = layout::find_results(
+        results_file_open(cmdline));
+
+    const fs::path output_path = cmdline.get_option< cmdline::path_option >(
+        "output");
+
+    const int shards = cmdline.get_option< cmdline::int_option >("shards");
+    if (shards < 1)
+        throw cmdline::usage_error(F("Invalid value for --shards: %s; must be "
+                                     "positive") % shards);
+    if (shards > 1 && output_path == fs::path("/dev/stdout"))
+        throw cmdline::usage_error("--shards requires --output to be set to "
+                                   "a file");
+
+    units::bytes output_limit;
+    try {
+        output_limit = units::bytes::parse(
+            cmdline.get_option< cmdline::string_option >("output-limit"));
+    } catch (const std::runtime_error& e) {
+        throw cmdline::usage_error(F("Invalid value for --output-limit: %s") %
+                                   e.what());
+    }
+
+    std::vector< std::shared_ptr< std::ostream > > outputs;
+    std::vector< std::ostream* > streams;
+    if (shards == 1) {
+        outputs.push_back(std::shared_ptr< std::ostream >(
+            utils::open_ostream(output_path).release()));
+    } else {
+        for (int i = 0; i < shards; ++i)
+            outputs.push_back(std::shared_ptr< std::ostream >(
+                utils::open_ostream(fs::path(
+                    F("%s.%s") % output_path.str() % i)).release()));
+    }
+    for (std::vector< std::shared_ptr< std::ostream > >::const_iterator
+             iter = outputs.begin(); iter != outputs.end(); ++iter)
+        streams.push_back((*iter).get());
+
+    drivers::report_json_hooks hooks(
+        streams, cmdline.has_option("with-output"), output_limit);
+    drivers::scan_results::drive(results_file,
+                                 std::set< engine::test_filter >(),
+                                 hooks);
+
+    return EXIT_SUCCESS;
+}
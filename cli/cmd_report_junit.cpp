@@ -30,23 +30,26 @@
 
 #include <cstddef>
 #include <cstdlib>
-#include <set>
+#include <stdexcept>
 
 #include "cli/common.ipp"
 #include "drivers/report_junit.hpp"
 #include "drivers/scan_results.hpp"
-#include "engine/filters.hpp"
 #include "store/layout.hpp"
+#include "utils/cmdline/exceptions.hpp"
 #include "utils/cmdline/options.hpp"
 #include "utils/cmdline/parser.ipp"
 #include "utils/defs.hpp"
+#include "utils/format/macros.hpp"
 #include "utils/optional.ipp"
 #include "utils/stream.hpp"
+#include "utils/units.hpp"
 
 namespace cmdline = utils::cmdline;
 namespace config = utils::config;
 namespace fs = utils::fs;
 namespace layout = store::layout;
+namespace units = utils::units;
 
 using cli::cmd_report_junit;
 using utils::optional;
@@ -60,6 +63,9 @@ cmd_report_junit::cmd_report_junit(void) : cli_command(
     add_option(results_file_open_option);
     add_option(cmdline::path_option("output", "Path to the output file", "path",
                                     "/dev/stdout"));
+    add_option(cmdline::string_option(
+        "output-limit", "Maximum amount of stdout and stderr to include for "
+        "every test case; 0 for no limit", "bytes", "0"));
 }
 
 
@@ -67,25 +73,33 @@ cmd_report_junit::cmd_report_junit(void) : cli_command(
 ///
 /// \param unused_ui Object to interact with the I/O of the program.
 /// \param cmdline Representation of the command line to the subcommand.
-/// \param unused_user_config The runtime configuration of the program.
+/// \param user_config The runtime configuration of the program.
 ///
 /// \return 0 if everything is OK, 1 if the statement is invalid or if there is
 /// any other problem.
 int
 cmd_report_junit::run(cmdline::ui* UTILS_UNUSED_PARAM(ui),
                       const cmdline::parsed_cmdline& cmdline,
-                      const config::tree& UTILS_UNUSED_PARAM(user_config))
+                      const config::tree& user_config)
 {
     const fs::path results_file = layout::find_results(
         results_file_open(cmdline));
 
+    units::bytes output_limit;
+    try {
+        output_limit = units::bytes::parse(
+            cmdline.get_option< cmdline::string_option >("output-limit"));
+    } catch (const std::runtime_error& e) {
+        throw cmdline::usage_error(F("Invalid value for --output-limit: %s") %
+                                   e.what());
+    }
+
     std::auto_ptr< std::ostream > output = utils::open_ostream(
         cmdline.get_option< cmdline::path_option >("output"));
 
-    drivers::report_junit_hooks hooks(*output.get());
-    drivers::scan_results::drive(results_file,
-                                 std::set< engine::test_filter >(),
-                                 hooks);
+    drivers::report_junit_hooks hooks(*output.get(), output_limit);
+    drivers::scan_results::drive_partitioned(
+        results_file, hooks, cli::subprocess_parallelism(user_config));
 
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,197 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "cli/cmd_report_summary.hpp"
+
+#include <cstddef>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "cli/common.ipp"
+#include "model/test_result.hpp"
+#include "store/exceptions.hpp"
+#include "store/layout.hpp"
+#include "store/read_transaction.hpp"
+#include "store/snapshot.hpp"
+#include "utils/cmdline/exceptions.hpp"
+#include "utils/cmdline/options.hpp"
+#include "utils/cmdline/parser.ipp"
+#include "utils/cmdline/ui.hpp"
+#include "utils/datetime.hpp"
+#include "utils/defs.hpp"
+#include "utils/format/macros.hpp"
+#include "utils/fs/operations.hpp"
+#include "utils/fs/path.hpp"
+
+namespace cmdline = utils::cmdline;
+namespace config = utils::config;
+namespace datetime = utils::datetime;
+namespace fs = utils::fs;
+namespace layout = store::layout;
+
+using cli::cmd_report_summary;
+
+
+namespace {
+
+
+/// Gets the number of results of a type in a summary.
+///
+/// \param summary The summary to query.
+/// \param type The type of the results to count.
+///
+/// \return The number of results of the given type.
+static std::size_t
+count(const store::results_summary& summary,
+      const model::test_result_type type)
+{
+    const std::map< model::test_result_type, std::size_t >::const_iterator
+        iter = summary.counts.find(type);
+    return iter == summary.counts.end() ? 0 : (*iter).second;
+}
+
+
+/// Formats the counts of the results of a summary.
+///
+/// \param summary The summary to format.
+///
+/// \return A textual representation of the counts.
+static std::string
+format_counts(const store::results_summary& summary)
+{
+    std::size_t total = 0;
+    for (std::map< model::test_result_type, std::size_t >::const_iterator
+             iter = summary.counts.begin(); iter != summary.counts.end();
+         ++iter)
+        total += (*iter).second;
+    return F("%s total, %s skipped, %s expected failures, %s broken, "
+             "%s failed") % total %
+        count(summary, model::test_result_skipped) %
+        count(summary, model::test_result_expected_failure) %
+        count(summary, model::test_result_broken) %
+        count(summary, model::test_result_failed);
+}
+
+
+/// Adds the results of a summary to another one.
+///
+/// \param total The summary to add to.
+/// \param summary The summary to add.
+static void
+accumulate(store::results_summary& total,
+           const store::results_summary& summary)
+{
+    for (std::map< model::test_result_type, std::size_t >::const_iterator
+             iter = summary.counts.begin(); iter != summary.counts.end();
+         ++iter)
+        total.counts[(*iter).first] += (*iter).second;
+    total.total_duration += summary.total_duration;
+}
+
+
+}  // anonymous namespace
+
+
+/// Default constructor for cmd_report_summary.
+cmd_report_summary::cmd_report_summary(void) : cli_command(
+    "report-summary", "", 0, 0,
+    "Summarizes the results of the most recent test suite runs")
+{
+    add_option(cmdline::string_option(
+        "test-suite", "Identifier of the test suite to query; defaults to "
+        "the one of the current directory", "id"));
+    add_option(cmdline::int_option(
+        "runs", "Number of most recent runs to summarize", "count", "10"));
+}
+
+
+/// Entry point for the "report-summary" subcommand.
+///
+/// \param ui Object to interact with the I/O of the program.
+/// \param cmdline Representation of the command line to the subcommand.
+/// \param unused_user_config The runtime configuration of the program.
+///
+/// \return 0 if everything is OK, 1 if any results file cannot be read.
+int
+cmd_report_summary::run(cmdline::ui* ui,
+                        const cmdline::parsed_cmdline& cmdline,
+                        const config::tree& UTILS_UNUSED_PARAM(user_config))
+{
+    const int runs = cmdline.get_option< cmdline::int_option >("runs");
+    if (runs < 1)
+        throw cmdline::usage_error(F("Invalid value for --runs: %s; must be "
+                                     "at least 1") % runs);
+    const std::string test_suite = cmdline.has_option("test-suite") ?
+        cmdline.get_option< cmdline::string_option >("test-suite") :
+        layout::test_suite_for_path(fs::current_path());
+
+    const std::vector< fs::path > files = layout::list_results(test_suite);
+    if (files.empty()) {
+        ui->out(F("No results files found for test suite %s") % test_suite);
+        return EXIT_SUCCESS;
+    }
+    const std::size_t first = files.size() > static_cast< std::size_t >(runs) ?
+        files.size() - static_cast< std::size_t >(runs) : 0;
+
+    const fs::path snapshots_dir = layout::query_snapshots_dir();
+    fs::mkdir_p(snapshots_dir, 0755);
+
+    bool ok = true;
+    std::size_t summarized = 0;
+    store::results_summary total;
+    ui->out("===> Runs");
+    for (std::vector< fs::path >::const_iterator iter = files.begin() + first;
+         iter != files.end(); ++iter) {
+        const fs::path snapshot = snapshots_dir / (F("%s.snapshot") %
+            (*iter).leaf_name()).str();
+        try {
+            const store::results_summary summary =
+                store::results_snapshot::open_or_create(
+                    *iter, snapshot).summarize();
+            ui->out(F("%s: %s; took %s") % (*iter).leaf_name() %
+                    format_counts(summary) %
+                    cli::format_delta(summary.total_duration));
+            accumulate(total, summary);
+            ++summarized;
+        } catch (const store::error& e) {
+            cmdline::print_warning(ui, F("Cannot summarize %s: %s") %
+                                   (*iter).leaf_name() % e.what());
+            ok = false;
+        }
+    }
+
+    ui->out("===> Summary");
+    ui->out(F("Runs: %s") % summarized);
+    ui->out(F("Test cases: %s") % format_counts(total));
+    ui->out(F("Total time: %s") % cli::format_delta(total.total_duration));
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,143 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "cli/cmd_report_trends.hpp"
+
+#include <cstddef>
+#include <cstdlib>
+#include <string>
+
+#include "cli/common.ipp"
+#include "store/layout.hpp"
+#include "store/trends.hpp"
+#include "utils/cmdline/exceptions.hpp"
+#include "utils/cmdline/options.hpp"
+#include "utils/cmdline/parser.ipp"
+#include "utils/cmdline/ui.hpp"
+#include "utils/datetime.hpp"
+#include "utils/defs.hpp"
+#include "utils/format/macros.hpp"
+#include "utils/fs/operations.hpp"
+#include "utils/fs/path.hpp"
+#include "utils/logging/macros.hpp"
+
+namespace cmdline = utils::cmdline;
+namespace config = utils::config;
+namespace datetime = utils::datetime;
+namespace fs = utils::fs;
+namespace layout = store::layout;
+
+using cli::cmd_report_trends;
+
+
+namespace {
+
+
+/// Gets the value of a numeric option that must be at least a given value.
+///
+/// \param cmdline Representation of the command line to the subcommand.
+/// \param name The name of the option to query.
+/// \param minimum The smallest valid value for the option.
+///
+/// \return The value of the option.
+///
+/// \throw cmdline::usage_error If the value is too small.
+static std::size_t
+get_count(const cmdline::parsed_cmdline& cmdline, const char* name,
+          const int minimum)
+{
+    const int value = cmdline.get_option< cmdline::int_option >(name);
+    if (value < minimum)
+        throw cmdline::usage_error(F("Invalid value for --%s: %s; must be at "
+                                     "least %s") % name % value % minimum);
+    return static_cast< std::size_t >(value);
+}
+
+
+}  // anonymous namespace
+
+
+/// Default constructor for cmd_report_trends.
+cmd_report_trends::cmd_report_trends(void) : cli_command(
+    "report-trends", "", 0, 0,
+    "Shows the test cases that got slower across recent test suite runs")
+{
+    add_option(cmdline::string_option(
+        "test-suite", "Identifier of the test suite to query; defaults to "
+        "the one of the current directory", "id"));
+    add_option(cmdline::int_option(
+        "runs", "Number of most recent runs to consider", "count", "10"));
+    add_option(cmdline::int_option(
+        "limit", "Maximum number of test cases to show", "count", "10"));
+    add_option(cmdline::int_option(
+        "threshold", "Percentage by which the latest duration must exceed "
+        "the previous mean to report a test case", "percent", "0"));
+}
+
+
+/// Entry point for the "report-trends" subcommand.
+///
+/// \param ui Object to interact with the I/O of the program.
+/// \param cmdline Representation of the command line to the subcommand.
+/// \param unused_user_config The runtime configuration of the program.
+///
+/// \return 0 if everything is OK, 1 if the statement is invalid or if there is
+/// any other problem.
+int
+cmd_report_trends::run(cmdline::ui* ui,
+                       const cmdline::parsed_cmdline& cmdline,
+                       const config::tree& UTILS_UNUSED_PARAM(user_config))
+{
+    const std::size_t runs = get_count(cmdline, "runs", 2);
+    const std::size_t limit = get_count(cmdline, "limit", 1);
+    const std::size_t threshold = get_count(cmdline, "threshold", 0);
+    const std::string test_suite = cmdline.has_option("test-suite") ?
+        cmdline.get_option< cmdline::string_option >("test-suite") :
+        layout::test_suite_for_path(fs::current_path());
+
+    const fs::path trends_file = layout::query_trends_file();
+    fs::mkdir_p(trends_file.branch_path(), 0755);
+    store::trends_index index = store::trends_index::open_rw(trends_file);
+    const std::size_t added = index.sync(test_suite);
+    LI(F("Added %s results files to the trends index") % added);
+    const store::case_trends_vector trends = index.slowdowns(
+        test_suite, runs, limit, threshold / 100.0);
+    index.close();
+
+    if (trends.empty()) {
+        ui->out(F("No test cases got slower over the last %s runs") % runs);
+        return EXIT_SUCCESS;
+    }
+
+    ui->out(F("===> Test cases that got slower over the last %s runs") % runs);
+    for (store::case_trends_vector::const_iterator iter = trends.begin();
+         iter != trends.end(); ++iter)
+        ui->out(cli::format_trend(*iter));
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,104 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "cli/cmd_serve_results.hpp"
+
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+
+#include "cli/common.ipp"
+#include "drivers/serve_results.hpp"
+#include "utils/cmdline/exceptions.hpp"
+#include "utils/cmdline/options.hpp"
+#include "utils/cmdline/parser.ipp"
+#include "utils/defs.hpp"
+#include "utils/format/macros.hpp"
+#include "utils/logging/macros.hpp"
+#include "utils/units.hpp"
+
+namespace cmdline = utils::cmdline;
+namespace config = utils::config;
+namespace units = utils::units;
+
+using cli::cmd_serve_results;
+
+
+/// Default constructor for cmd_serve_results.
+cmd_serve_results::cmd_serve_results(void) : cli_command(
+    "serve-results", "", 0, 0,
+    "Serves newline-delimited JSON reports of results files requested on "
+    "stdin")
+{
+    add_option(cmdline::int_option(
+        "max-open", "Maximum number of results files to keep open across "
+        "requests", "count", "16"));
+    add_option(cmdline::bool_option(
+        "with-output", "Include the stdout and stderr of every test case"));
+    add_option(cmdline::string_option(
+        "output-limit", "Maximum amount of stdout and stderr to include for "
+        "every test case; 0 for no limit", "bytes", "0"));
+}
+
+
+/// Entry point for the "serve-results" subcommand.
+///
+/// \param unused_ui Object to interact with the I/O of the program.
+/// \param cmdline Representation of the command line to the subcommand.
+/// \param unused_user_config The runtime configuration of the program.
+///
+/// \return 0 once the input is exhausted.
+int
+cmd_serve_results::run(cmdline::ui* UTILS_UNUSED_PARAM(ui),
+                       const cmdline::parsed_cmdline& cmdline,
+                       const config::tree& UTILS_UNUSED_PARAM(user_config))
+{
+    const int max_open = cmdline.get_option< cmdline::int_option >(
+        "max-open");
+    if (max_open < 1)
+        throw cmdline::usage_error(F("Invalid value for --max-open: %s; must "
+                                     "be positive") % max_open);
+
+    units::bytes output_limit;
+    try {
+        output_limit = units::bytes::parse(
+            cmdline.get_option< cmdline::string_option >("output-limit"));
+    } catch (const std::runtime_error& e) {
+        throw cmdline::usage_error(F("Invalid value for --output-limit: %s") %
+                                   e.what());
+    }
+
+    const drivers::serve_results::result result =
+        drivers::serve_results::drive(std::cin, std::cout, max_open,
+                                      cmdline.has_option("with-output"),
+                                      output_limit);
+    LI(F("Served %s requests opening results files %s times") %
+       result.requests % result.opened);
+
+    return EXIT_SUCCESS;
+}
@@ -28,33 +28,580 @@
 
 #include "cli/cmd_test.hpp"
 
+extern "C" {
+#include <sys/stat.h>
+
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+}
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstddef>
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
 
+#include "cli/cmd_report_html.hpp"
 #include "cli/common.ipp"
+#include "cli/config.hpp"
+#include "drivers/report_json.hpp"
+#include "drivers/report_junit.hpp"
 #include "drivers/run_tests.hpp"
+#include "drivers/scan_results.hpp"
+#include "engine/config.hpp"
+#include "engine/filters.hpp"
+#include "engine/scheduler.hpp"
 #include "model/test_program.hpp"
 #include "model/test_result.hpp"
+#include "store/exceptions.hpp"
 #include "store/layout.hpp"
+#include "store/trends.hpp"
+#include "utils/cmdline/exceptions.hpp"
 #include "utils/cmdline/options.hpp"
 #include "utils/cmdline/parser.ipp"
 #include "utils/cmdline/ui.hpp"
 #include "utils/config/tree.ipp"
 #include "utils/datetime.hpp"
+#include "utils/defs.hpp"
 #include "utils/format/macros.hpp"
+#include "utils/fs/exceptions.hpp"
+#include "utils/fs/operations.hpp"
 #include "utils/fs/path.hpp"
+#include "utils/latency_histogram.hpp"
+#include "utils/logging/macros.hpp"
+#include "utils/noncopyable.hpp"
+#include "utils/optional.ipp"
+#include "utils/signals/exceptions.hpp"
+#include "utils/signals/interrupts.hpp"
+#include "utils/signals/programmer.hpp"
+#include "utils/stream.hpp"
+#include "utils/units.hpp"
 
 namespace cmdline = utils::cmdline;
 namespace config = utils::config;
 namespace datetime = utils::datetime;
 namespace fs = utils::fs;
 namespace layout = store::layout;
+namespace signals = utils::signals;
+namespace units = utils::units;
 
 using cli::cmd_test;
+using utils::none;
+using utils::optional;
 
 
 namespace {
 
 
+/// Formats a duration as a number of seconds for the metrics file.
+///
+/// \param delta The duration to format.
+///
+/// \return The duration in seconds with microsecond precision.
+static std::string
+format_seconds(const datetime::delta& delta)
+{
+    return F("%.6s") % (delta.seconds + (delta.useconds / 1000000.0));
+}
+
+
+/// Formats the metrics of a run in the OpenMetrics text format.
+///
+/// \param metrics The metrics to format.
+///
+/// \return The contents of the metrics file.
+static std::string
+format_metrics(const drivers::run_tests::metrics& metrics)
+{
+    static const model::test_result_type types[] = {
+        model::test_result_broken,
+        model::test_result_expected_failure,
+        model::test_result_failed,
+        model::test_result_passed,
+        model::test_result_skipped,
+    };
+
+    std::ostringstream output;
+
+    output << "# TYPE kyua_tests_started counter\n";
+    output << "# HELP kyua_tests_started Test cases whose processing began.\n";
+    output << F("kyua_tests_started_total %s\n") % metrics.started;
+
+    output << "# TYPE kyua_tests_finished counter\n";
+    output << "# HELP kyua_tests_finished Test cases with a result.\n";
+    for (std::size_t i = 0; i < sizeof(types) / sizeof(types[0]); ++i) {
+        const std::map< model::test_result_type, std::size_t >::const_iterator
+            iter = metrics.results.find(types[i]);
+        output << F("kyua_tests_finished_total{result=\"%s\"} %s\n") %
+            cli::format_result(model::test_result(types[i], "")) %
+            (iter == metrics.results.end() ? 0 : (*iter).second);
+    }
+
+    output << "# TYPE kyua_running gauge\n";
+    output << "# HELP kyua_running Test cases and listings in execution.\n";
+    output << F("kyua_running %s\n") % metrics.running;
+
+    output << "# TYPE kyua_pending_test_programs gauge\n";
+    output << "# HELP kyua_pending_test_programs Test programs not yet "
+        "listed.\n";
+    output << F("kyua_pending_test_programs %s\n") %
+        metrics.pending_test_programs;
+
+    output << "# TYPE kyua_queued_test_cases gauge\n";
+    output << "# HELP kyua_queued_test_cases Known test cases not yet "
+        "started.\n";
+    output << F("kyua_queued_test_cases %s\n") % metrics.queued_test_cases;
+
+    output << "# TYPE kyua_predicted_remaining_seconds gauge\n";
+    output << "# HELP kyua_predicted_remaining_seconds Predicted time until "
+        "the tests complete.\n";
+    output << F("kyua_predicted_remaining_seconds %s\n") %
+        format_seconds(metrics.predicted_remaining);
+
+    output << "# TYPE kyua_spawn_seconds summary\n";
+    output << "# HELP kyua_spawn_seconds Time taken to start subprocesses.\n";
+    output << F("kyua_spawn_seconds_count %s\n") %
+        metrics.spawn_latency.count();
+    output << F("kyua_spawn_seconds_sum %s\n") %
+        format_seconds(metrics.spawn_latency.total());
+
+    output << "# TYPE kyua_checkpoint_seconds summary\n";
+    output << "# HELP kyua_checkpoint_seconds Time taken to commit the "
+        "results file.\n";
+    output << F("kyua_checkpoint_seconds_count %s\n") %
+        metrics.checkpoint_latency.count();
+    output << F("kyua_checkpoint_seconds_sum %s\n") %
+        format_seconds(metrics.checkpoint_latency.total());
+
+    output << "# TYPE kyua_output_bytes counter\n";
+    output << "# HELP kyua_output_bytes Test case output stored.\n";
+    output << F("kyua_output_bytes_total %s\n") %
+        static_cast< uint64_t >(metrics.output_size);
+
+    output << "# TYPE kyua_last_update_seconds gauge\n";
+    output << "# HELP kyua_last_update_seconds Time of this snapshot.\n";
+    output << F("kyua_last_update_seconds %s\n") % format_seconds(
+        metrics.timestamp - datetime::timestamp::from_microseconds(0));
+
+    output << "# EOF\n";
+    return output.str();
+}
+
+
+/// Atomically replaces the metrics file with the current metrics of a run.
+///
+/// Errors are only logged: monitoring must not get in the way of the tests.
+///
+/// \param path The metrics file to write.
+/// \param metrics The metrics to write.
+static void
+write_metrics(const fs::path& path, const drivers::run_tests::metrics& metrics)
+{
+    const fs::path temp(path.str() + ".tmp");
+    {
+        std::ofstream output(temp.c_str());
+        if (output)
+            output << format_metrics(metrics);
+        if (!output) {
+            LW(F("Cannot write metrics file %s") % temp);
+            ::unlink(temp.c_str());
+            return;
+        }
+    }
+    if (std::rename(temp.c_str(), path.c_str()) == -1) {
+        const int original_errno = errno;
+        ::unlink(temp.c_str());
+        LW(F("Cannot rename %s to %s: %s") % temp % path %
+           std::strerror(original_errno));
+    }
+}
+
+
+/// Minimum predicted run time for which to look for a critical path.
+static const datetime::delta critical_path_minimum(10, 0);
+
+
+/// Minimum time between two updates of the output in compact mode.
+static const datetime::delta compact_interval(0, 100000);
+
+
+/// Time between two checks of the files watched by --watch.
+static const datetime::delta watch_period(0, 500000);
+
+
+/// Prints the output of some test cases while they run.
+///
+/// The test cases keep writing their output to their files, which end up in the
+/// results file as usual, and this tails those files from the event loop of the
+/// driver: complete lines are printed as soon as they show up, prefixed by the
+/// identifier of their test case.  Nothing here blocks the test cases, which is
+/// why this reads the files instead of sitting on pipes between the test cases
+/// and their files.
+class output_streamer : public engine::scheduler::observer {
+    /// Read position in an output file.
+    struct stream {
+        /// The file being tailed.
+        fs::path file;
+
+        /// Number of bytes of the file already consumed.
+        off_t offset;
+
+        /// Trailing bytes of the file not yet terminated by a newline.
+        std::string partial;
+
+        /// Constructor.
+        ///
+        /// \param file_ The file to tail.
+        /// \param offset_ Number of bytes of the file to skip.
+        stream(const fs::path& file_, const off_t offset_) :
+            file(file_), offset(offset_)
+        {
+        }
+    };
+
+    /// Output of a running subprocess.
+    struct tailed {
+        /// Prefix for the lines of the subprocess.
+        std::string prefix;
+
+        /// The stdout of the subprocess.
+        stream out;
+
+        /// The stderr of the subprocess.
+        stream err;
+
+        /// Constructor.
+        ///
+        /// \param prefix_ Prefix for the lines of the subprocess.
+        /// \param out_ The stdout of the subprocess.
+        /// \param err_ The stderr of the subprocess.
+        tailed(const std::string& prefix_, const stream& out_,
+               const stream& err_) :
+            prefix(prefix_), out(out_), err(err_)
+        {
+        }
+    };
+
+    /// Object to interact with the I/O of the program.
+    cmdline::ui* _ui;
+
+    /// Test cases whose output to print.
+    engine::test_filter _filter;
+
+    /// Subprocesses being tailed, keyed by their PID.
+    std::map< int, tailed > _running;
+
+    /// Consumed bytes of the output of the test bodies that have terminated,
+    /// keyed by their stdout file.
+    ///
+    /// Cleanup routines append to the files of their bodies, so they resume
+    /// from here instead of printing the output of the bodies again.
+    std::map< fs::path, std::pair< off_t, off_t > > _exited;
+
+    /// Prints the new lines of an output file.
+    ///
+    /// \param prefix Prefix for the printed lines.
+    /// \param [in,out] s The file to tail.
+    /// \param is_stderr Whether the file holds a stderr.
+    /// \param final Whether the subprocess has terminated, in which case any
+    ///     partial line is printed too.
+    void
+    drain(const std::string& prefix, stream& s, const bool is_stderr,
+          const bool final)
+    {
+        struct ::stat sb;
+        if (::stat(s.file.c_str(), &sb) == -1)
+            return;
+        if (sb.st_size < s.offset)
+            s.offset = sb.st_size;  // Truncated under us.
+
+        if (sb.st_size > s.offset) {
+            std::ifstream input(s.file.c_str(), std::ios::binary);
+            input.seekg(s.offset);
+            std::vector< char > buffer(
+                static_cast< std::size_t >(sb.st_size - s.offset));
+            input.read(&buffer[0], buffer.size());
+            s.offset += input.gcount();
+            s.partial.append(&buffer[0], input.gcount());
+        }
+
+        std::string::size_type start = 0, end;
+        while ((end = s.partial.find('\n', start)) != std::string::npos) {
+            print(prefix + s.partial.substr(start, end - start), is_stderr);
+            start = end + 1;
+        }
+        s.partial.erase(0, start);
+        if (final && !s.partial.empty()) {
+            print(prefix + s.partial, is_stderr);
+            s.partial.clear();
+        }
+    }
+
+    /// Prints a line of output.
+    ///
+    /// \param line The line to print, without a trailing newline.
+    /// \param is_stderr Whether the line comes from a stderr.
+    void
+    print(const std::string& line, const bool is_stderr)
+    {
+        if (is_stderr)
+            _ui->err(line);
+        else
+            _ui->out(line);
+    }
+
+public:
+    /// Constructor.
+    ///
+    /// \param ui_ Object to interact with the I/O of the program.
+    /// \param filter_ Test cases whose output to print.
+    output_streamer(cmdline::ui* ui_, const engine::test_filter& filter_) :
+        _ui(ui_), _filter(filter_)
+    {
+    }
+
+    /// Starts or stops tailing the output of a subprocess.
+    ///
+    /// The output left by a terminated subprocess is printed right away
+    /// because its files go away once the subprocess is cleaned up.
+    ///
+    /// \param event The event reported by the scheduler.
+    void
+    got_event(const engine::scheduler::event& event)
+    {
+        if (event.type == engine::scheduler::test_spawned_event ||
+            event.type == engine::scheduler::cleanup_spawned_event) {
+            if (!event.stdout_file || !_filter.matches_test_case(
+                    event.test_program->relative_path(), event.test_case_name))
+                return;
+
+            std::pair< off_t, off_t > offsets(0, 0);
+            const std::map< fs::path, std::pair< off_t, off_t > >::iterator
+                iter = _exited.find(event.stdout_file.get());
+            if (iter != _exited.end()) {
+                if (event.type == engine::scheduler::cleanup_spawned_event)
+                    offsets = (*iter).second;
+                _exited.erase(iter);
+            }
+
+            _running.insert(std::make_pair(event.pid, tailed(
+                F("[%s] ") % cli::format_test_case_id(*event.test_program,
+                                                      event.test_case_name),
+                stream(event.stdout_file.get(), offsets.first),
+                stream(event.stderr_file.get(), offsets.second))));
+        } else if (event.type == engine::scheduler::exited_event ||
+                   event.type == engine::scheduler::timed_out_event) {
+            const std::map< int, tailed >::iterator iter =
+                _running.find(event.pid);
+            if (iter == _running.end())
+                return;
+
+            tailed& data = (*iter).second;
+            drain(data.prefix, data.out, false, true);
+            drain(data.prefix, data.err, true, true);
+            _exited[data.out.file] = std::make_pair(data.out.offset,
+                                                    data.err.offset);
+            _running.erase(iter);
+        }
+    }
+
+    /// Prints the new output of all running subprocesses.
+    void
+    poll(void)
+    {
+        for (std::map< int, tailed >::iterator iter = _running.begin();
+             iter != _running.end(); ++iter) {
+            tailed& data = (*iter).second;
+            drain(data.prefix, data.out, false, false);
+            drain(data.prefix, data.err, true, false);
+        }
+    }
+};
+
+
+/// Reader of the paths of the test programs produced by a running build.
+///
+/// The build writes the path of every test program it links to a file
+/// descriptor, one per line, and closes it once it completes.  The paths are
+/// taken either absolute or relative to the root of the test suite.  Errors
+/// reading the paths end the feed, as it is not worth failing the run: the
+/// driver then runs all the test programs not fed yet.
+class input_watcher : utils::noncopyable {
+    /// The file descriptor to read the paths from.
+    const int _fd;
+
+    /// Trailing bytes read so far not yet terminated by a newline.
+    std::string _partial;
+
+    /// Whether the end of the paths has been reached.
+    bool _eof;
+
+    /// Extracts the complete lines read so far.
+    ///
+    /// \param [out] paths The paths to which to append the lines.
+    ///
+    /// \return The number of paths appended.
+    std::size_t
+    split_lines(std::vector< fs::path >& paths)
+    {
+        std::size_t count = 0;
+        std::string::size_type start = 0;
+        std::string::size_type end;
+        while ((end = _partial.find('\n', start)) != std::string::npos) {
+            const std::string line = _partial.substr(start, end - start);
+            if (!line.empty()) {
+                paths.push_back(fs::path(line));
+                ++count;
+            }
+            start = end + 1;
+        }
+        _partial.erase(0, start);
+        return count;
+    }
+
+public:
+    /// Constructor.
+    ///
+    /// \param fd_ The file descriptor to read the paths from.
+    explicit input_watcher(const int fd_) : _fd(fd_), _eof(false)
+    {
+    }
+
+    /// Reads the paths available so far.
+    ///
+    /// \param [out] paths The paths to which to append the new ones.
+    /// \param wait Whether to block until there is any path or the input ends.
+    ///
+    /// \return False once the input has ended; true otherwise.
+    ///
+    /// \throw signals::interrupted_error If a signal that requests the run to
+    ///     stop arrives while waiting for the input.
+    bool
+    read(std::vector< fs::path >& paths, const bool wait)
+    {
+        std::size_t count = 0;
+        while (!_eof) {
+            struct ::pollfd poll_fd;
+            poll_fd.fd = _fd;
+            poll_fd.events = POLLIN;
+            poll_fd.revents = 0;
+            const int ready = ::poll(&poll_fd, 1, wait && count == 0 ? -1 : 0);
+            if (ready == -1 && errno == EINTR) {
+                signals::check_interrupt();
+                continue;
+            }
+            if (ready == 0)
+                break;
+
+            char buffer[4096];
+            const ssize_t length = ready == -1 ? -1 :
+                ::read(_fd, buffer, sizeof(buffer));
+            if (length == -1 && errno == EINTR) {
+                signals::check_interrupt();
+                continue;
+            }
+            if (length == -1) {
+                LW(F("Cannot read the paths of the test programs: %s") %
+                   std::strerror(errno));
+                _eof = true;
+            } else if (length == 0) {
+                _eof = true;
+            } else {
+                _partial.append(buffer, length);
+                count += split_lines(paths);
+            }
+        }
+
+        if (_eof && !_partial.empty()) {
+            _partial += '\n';
+            (void)split_lines(paths);
+        }
+        return !_eof;
+    }
+};
+
+
+/// Whether SIGUSR1 was received since the configuration was last reloaded.
+static volatile std::sig_atomic_t reload_requested = 0;
+
+
+/// Handler for SIGUSR1 to request the reload of the configuration.
+///
+/// \param unused_signo The signal that caused this handler to be called.
+static void
+reload_handler(const int UTILS_UNUSED_PARAM(signo))
+{
+    reload_requested = 1;
+}
+
+
+/// Reloads the configuration file upon reception of SIGUSR1.
+///
+/// This lets long runs pick up changes to kyua.conf, such as a different
+/// parallelism when other jobs start or finish on the machine, without having
+/// to restart them.  The same file and overrides given on the command line are
+/// loaded again.  Errors in the file are logged and keep the current
+/// configuration so that a typo cannot abort an ongoing run.
+class config_reloader : utils::noncopyable {
+    /// Handler of SIGUSR1 while the reloader is alive.
+    signals::programmer _programmer;
+
+public:
+    /// Constructor.
+    config_reloader(void) :
+        _programmer(SIGUSR1, reload_handler)
+    {
+        reload_requested = 0;
+    }
+
+    /// Destructor.
+    ~config_reloader(void)
+    {
+        try {
+            _programmer.unprogram();
+        } catch (const signals::system_error& e) {
+            LW(F("Failed to unprogram the SIGUSR1 handler: %s") % e.what());
+        }
+    }
+
+    /// Reloads the configuration file if requested since the last call.
+    ///
+    /// \param [out] user_config The reloaded configuration.
+    ///
+    /// \return True if user_config was replaced.
+    bool
+    reload(config::tree& user_config)
+    {
+        if (reload_requested == 0)
+            return false;
+        reload_requested = 0;
+
+        try {
+            user_config = cli::reload_config();
+            LI("Reloaded the configuration upon SIGUSR1");
+            return true;
+        } catch (const std::runtime_error& e) {
+            LW(F("Keeping the current configuration; reload failed: %s") %
+               e.what());
+            return false;
+        }
+    }
+};
+
+
 /// Hooks to print a progress report of the execution of the tests.
 class print_hooks : public drivers::run_tests::base_hooks {
     /// Object to interact with the I/O of the program.
@@ -63,6 +610,144 @@ class print_hooks : public drivers::run_tests::base_hooks {
     /// Whether the tests are executed in parallel or not.
     bool _parallel;
 
+    /// Whether to count the results of every test case separately.
+    bool _per_test_case;
+
+    /// Whether to only print the bad results along with a status line.
+    bool _compact;
+
+    /// File to which to write the metrics of the run; none to not write them.
+    optional< fs::path > _metrics_file;
+
+    /// Printer of the output of the running test cases; NULL if disabled.
+    std::auto_ptr< output_streamer > _streamer;
+
+    /// Reader of the test programs fed on stdin; NULL if disabled.
+    std::auto_ptr< input_watcher > _watcher;
+
+    /// Reloader of the configuration upon request; NULL if disabled.
+    config_reloader* _reloader;
+
+    /// Time at which the run started.
+    datetime::timestamp _start;
+
+    /// Most recent metrics of the run.
+    drivers::run_tests::metrics _metrics;
+
+    /// Bad results not yet printed in compact mode.
+    std::vector< std::string > _pending_lines;
+
+    /// Time at which the output was last updated in compact mode.
+    optional< datetime::timestamp > _last_update;
+
+    /// Length of the status line currently on the screen; 0 if there is none.
+    std::string::size_type _status_length;
+
+    /// Whether the first prediction of the run time has been checked already.
+    bool _predicted;
+
+    /// Warns if a single test case is predicted to dominate the run time.
+    ///
+    /// Only the first prediction is checked: it covers the whole run, whereas
+    /// any test case eventually dominates the time left near the end.
+    ///
+    /// \param metrics The metrics of the run so far.
+    void
+    check_critical_path(const drivers::run_tests::metrics& metrics)
+    {
+        if (_predicted || metrics.critical_test_case.empty())
+            return;
+        _predicted = true;
+
+        const int64_t total = metrics.predicted_remaining.to_microseconds();
+        const int64_t critical = metrics.critical_duration.to_microseconds();
+        if (metrics.predicted_remaining < critical_path_minimum ||
+            critical * 10 < total * 9)
+            return;
+        cmdline::print_warning(_ui, F("Test case %s is expected to take %ss "
+                                      "of the predicted %ss of this run; "
+                                      "splitting it would shorten the run") %
+                               metrics.critical_test_case %
+                               metrics.critical_duration.seconds %
+                               metrics.predicted_remaining.seconds);
+    }
+
+    /// Formats the status line of the compact mode.
+    ///
+    /// \param now The current time.
+    ///
+    /// \return The text of the status line.
+    std::string
+    format_status(const datetime::timestamp& now) const
+    {
+        const unsigned long done = good_count + bad_count;
+        const datetime::delta elapsed = now - _start;
+        const double seconds = elapsed.seconds +
+            (elapsed.useconds / 1000000.0);
+        const double rate = seconds > 0 ? done / seconds : 0;
+
+        std::string status = F("%s done, %s failed, %s running [%.1s/s")
+            % done % bad_count % _metrics.running % rate;
+        // Prefer the prediction from the durations of the previous run, if
+        // any.  Otherwise, extrapolate from the throughput so far, although
+        // the remaining work is only known once all test programs are listed.
+        if (_metrics.predicted_remaining != datetime::delta()) {
+            const int64_t left =
+                _metrics.predicted_remaining.to_microseconds() -
+                (now - _metrics.timestamp).to_microseconds();
+            status += F(", ETA %ss") % ((std::max(left, int64_t(0)) +
+                                         500000) / 1000000);
+        } else if (rate > 0 && _metrics.pending_test_programs == 0 &&
+            _metrics.timestamp != datetime::timestamp::from_microseconds(0)) {
+            const std::size_t remaining = _metrics.queued_test_cases +
+                _metrics.running;
+            status += F(", ETA %ss") %
+                static_cast< unsigned long >(remaining / rate + 0.5);
+        }
+        status += "]";
+        return status;
+    }
+
+    /// Updates the output of the compact mode.
+    ///
+    /// Writes are batched: the pending bad results and the new status line
+    /// are printed at most every compact_interval, unless forced.
+    ///
+    /// \param force Whether to update the output regardless of when it was
+    ///     last updated.
+    /// \param final Whether this is the last update, in which case the status
+    ///     line is cleared instead of redrawn.
+    void
+    update_compact(const bool force, const bool final)
+    {
+        const datetime::timestamp now = datetime::timestamp::now();
+        if (!force && _last_update &&
+            now - _last_update.get() < compact_interval)
+            return;
+        _last_update = now;
+
+        const optional< std::size_t > width = _ui->screen_width();
+        if (_status_length > 0 && (final || !_pending_lines.empty())) {
+            _ui->out("\r" + std::string(_status_length, ' ') + "\r", false);
+            _status_length = 0;
+        }
+        _ui->out_lines(_pending_lines);
+        _pending_lines.clear();
+
+        // Redrawing in place only makes sense on a terminal, which is where
+        // the width of the screen is known.
+        if (final || !width)
+            return;
+        std::string status = format_status(now);
+        if (status.length() >= width.get())
+            status = status.substr(0, width.get() - 1);
+        const std::string::size_type length = status.length();
+        if (length < _status_length)
+            status += std::string(_status_length - length, ' ');
+        _ui->out("\r" + status, false);
+        _status_length = length;
+    }
+
 public:
     /// The amount of positive test results found so far.
     unsigned long good_count;
@@ -70,13 +755,45 @@ public:
     /// The amount of negative test results found so far.
     unsigned long bad_count;
 
+    /// Positive and negative results of every test case, keyed by test case
+    /// identifier.  The identifier carries the variant of the test program,
+    /// so every variant gets its own counts.  Only tracked when the run
+    /// repeats the test cases.
+    std::map< std::string, std::pair< unsigned long, unsigned long > >
+        per_test_case;
+
     /// Constructor for the hooks.
     ///
     /// \param ui_ Object to interact with the I/O of the program.
     /// \param parallel_ True if we are executing more than one test at once.
-    print_hooks(cmdline::ui* ui_, const bool parallel_) :
+    /// \param per_test_case_ True to count the results of every test case
+    ///     separately.
+    /// \param compact_ True to only print the bad results and a status line.
+    /// \param metrics_file_ File to which to write the metrics of the run, if
+    ///     any.
+    /// \param stream_filter_ Test cases whose output to print while they run,
+    ///     if any.
+    /// \param watch_inputs_ True to only run the test programs once their
+    ///     paths are read from stdin, or once stdin is closed.
+    /// \param reloader_ Reloader of the configuration for the driver to poll;
+    ///     NULL if the configuration cannot change during the run.
+    print_hooks(cmdline::ui* ui_, const bool parallel_,
+                const bool per_test_case_, const bool compact_,
+                const optional< fs::path >& metrics_file_,
+                const optional< engine::test_filter >& stream_filter_,
+                const bool watch_inputs_, config_reloader* reloader_) :
         _ui(ui_),
         _parallel(parallel_),
+        _per_test_case(per_test_case_),
+        _compact(compact_),
+        _metrics_file(metrics_file_),
+        _streamer(stream_filter_ ?
+                  new output_streamer(ui_, stream_filter_.get()) : NULL),
+        _watcher(watch_inputs_ ? new input_watcher(STDIN_FILENO) : NULL),
+        _reloader(reloader_),
+        _start(datetime::timestamp::now()),
+        _status_length(0),
+        _predicted(false),
         good_count(0),
         bad_count(0)
     {
@@ -90,7 +807,9 @@ public:
     got_test_case(const model::test_program& test_program,
                   const std::string& test_case_name)
     {
-        if (!_parallel) {
+        // The output of the test case would be printed in the middle of the
+        // line otherwise.
+        if (!_parallel && !_compact && _streamer.get() == NULL) {
             _ui->out(F("%s  ->  ") %
                      cli::format_test_case_id(test_program, test_case_name),
                      false);
@@ -109,31 +828,910 @@ public:
                const model::test_result& result,
                const datetime::delta& duration)
     {
-        if (_parallel) {
-            _ui->out(F("%s  ->  ") %
-                     cli::format_test_case_id(test_program, test_case_name),
-                     false);
+        if (_compact) {
+            if (!result.good())
+                _pending_lines.push_back(
+                    F("%s  ->  %s  [%s]") %
+                    cli::format_test_case_id(test_program, test_case_name) %
+                    cli::format_result(result) % cli::format_delta(duration));
+        } else {
+            if (_parallel || _streamer.get() != NULL) {
+                _ui->out(F("%s  ->  ") %
+                         cli::format_test_case_id(test_program,
+                                                  test_case_name),
+                         false);
+            }
+            _ui->out(F("%s  [%s]") % cli::format_result(result) %
+                cli::format_delta(duration));
         }
-        _ui->out(F("%s  [%s]") % cli::format_result(result) %
-            cli::format_delta(duration));
         if (result.good())
             good_count++;
         else
             bad_count++;
+
+        if (_per_test_case) {
+            std::pair< unsigned long, unsigned long >& counts = per_test_case[
+                cli::format_test_case_id(test_program, test_case_name)];
+            if (result.good())
+                counts.first++;
+            else
+                counts.second++;
+        }
+
+        if (_compact)
+            update_compact(false, false);
+    }
+
+    /// Called periodically with the metrics of the run, and once at its end.
+    ///
+    /// \param metrics The metrics of the run so far.
+    virtual void
+    got_metrics(const drivers::run_tests::metrics& metrics)
+    {
+        _metrics = metrics;
+        if (_parallel)
+            check_critical_path(metrics);
+        if (_metrics_file)
+            write_metrics(_metrics_file.get(), metrics);
+        if (_compact)
+            update_compact(false, false);
+    }
+
+    /// Provides the receiver of the events of the scheduler.
+    ///
+    /// \return The printer of the output of the running test cases, if any.
+    virtual engine::scheduler::observer*
+    scheduler_observer(void)
+    {
+        return _streamer.get();
+    }
+
+    /// Checks whether poll() has to be called periodically.
+    ///
+    /// \return True if the output of the running test cases is printed.
+    virtual bool
+    wants_polling(void)
+    {
+        return _streamer.get() != NULL;
+    }
+
+    /// Prints the new output of the running test cases.
+    virtual void
+    poll(void)
+    {
+        _streamer->poll();
+    }
+
+    /// Checks whether the test programs are fed on stdin.
+    ///
+    /// \return True if the paths of the test programs are read from stdin.
+    virtual bool
+    feeds_test_programs(void)
+    {
+        return _watcher.get() != NULL;
+    }
+
+    /// Reads the paths of the test programs fed on stdin.
+    ///
+    /// \param [out] paths The paths to the fed test programs.
+    /// \param wait Whether to block until there is any path.
+    ///
+    /// \return False once stdin is closed; true otherwise.
+    virtual bool
+    feed_test_programs(std::vector< fs::path >& paths, const bool wait)
+    {
+        return _watcher->read(paths, wait);
+    }
+
+    /// Reloads the configuration if requested by the user.
+    ///
+    /// \param [out] user_config The reloaded configuration.
+    ///
+    /// \return True if user_config was replaced.
+    virtual bool
+    reload_config(config::tree& user_config)
+    {
+        return _reloader != NULL && _reloader->reload(user_config);
+    }
+
+    /// Prints any pending output and clears the status line of compact mode.
+    void
+    finish(void)
+    {
+        if (_compact)
+            update_compact(true, true);
+    }
+};
+
+
+/// Prints the fraction of failed runs of every test case that failed at least
+/// once.
+///
+/// \param ui Object to interact with the I/O of the program.
+/// \param per_test_case Positive and negative results of every test case,
+///     keyed by the identifier of the test case including its variant.
+static void
+print_flake_rates(
+    cmdline::ui* ui,
+    const std::map< std::string, std::pair< unsigned long, unsigned long > >&
+        per_test_case)
+{
+    bool header = false;
+    for (std::map< std::string, std::pair< unsigned long, unsigned long > >::
+             const_iterator iter = per_test_case.begin();
+         iter != per_test_case.end(); ++iter) {
+        const unsigned long good = (*iter).second.first;
+        const unsigned long bad = (*iter).second.second;
+        if (bad == 0)
+            continue;
+
+        if (!header) {
+            ui->out("");
+            ui->out("Flake rates:");
+            header = true;
+        }
+        ui->out(F("  %s  ->  %s/%s failed (%s%%)") % (*iter).first % bad %
+                (good + bad) % (bad * 100 / (good + bad)));
+    }
+}
+
+
+/// Prints the location of the results file of a run.
+///
+/// \param ui Interface to use for printing.
+/// \param results The identifier and path of the results file, or none if the
+///     results were only kept in memory.
+static void
+print_results_file(cmdline::ui* ui,
+                   const optional< layout::results_id_file_pair >& results)
+{
+    if (!results) {
+        ui->out("Results not saved");
+        return;
+    }
+    if (!results.get().first.empty()) {
+        ui->out(F("Results file id is %s") % results.get().first);
+    }
+    ui->out(F("Results saved to %s") % results.get().second);
+}
+
+
+/// Adds the results of a completed run to the trends index.
+///
+/// The index is only an accelerator for kyua report-trends, so problems
+/// updating it are logged instead of failing the run.
+///
+/// \param test_suite The test suite that was run.
+/// \param results_file The results file of the run.
+static void
+update_trends(const std::string& test_suite, const fs::path& results_file)
+{
+    const fs::path trends_file = layout::query_trends_file();
+    try {
+        fs::mkdir_p(trends_file.branch_path(), 0755);
+        store::trends_index index = store::trends_index::open_rw(trends_file);
+        index.add_run(test_suite, results_file);
+        index.close();
+    } catch (const fs::error& e) {
+        LW(F("Cannot update the trends index %s: %s") % trends_file %
+           e.what());
+    } catch (const store::error& e) {
+        LW(F("Cannot update the trends index %s: %s") % trends_file %
+           e.what());
+    }
+}
+
+
+/// Prints the latencies of the phases of the run.
+///
+/// \param ui Object to interact with the I/O of the program.
+/// \param latencies The histograms of the latencies, keyed by phase name.
+static void
+print_latencies(cmdline::ui* ui,
+                const utils::latency_histograms_map& latencies)
+{
+    ui->out("");
+    ui->out("Phase latencies:");
+    for (utils::latency_histograms_map::const_iterator iter =
+             latencies.begin(); iter != latencies.end(); ++iter) {
+        const utils::latency_histogram& histogram = (*iter).second;
+        if (histogram.count() == 0)
+            continue;
+        ui->out(F("    %s: count=%s, mean=%s, p50=%s, p90=%s, p99=%s, "
+                  "max=%s") % (*iter).first % histogram.count() %
+                cli::format_delta(histogram.mean()) %
+                cli::format_delta(histogram.percentile(50)) %
+                cli::format_delta(histogram.percentile(90)) %
+                cli::format_delta(histogram.percentile(99)) %
+                cli::format_delta(histogram.max()));
+    }
+}
+
+
+/// Reads the files that have changed.
+///
+/// \param file The file that lists the changed files, one per line.  Relative
+///     paths are relative to the current directory.
+///
+/// \return The absolute paths to the changed files.
+///
+/// \throw cmdline::option_argument_value_error If the file cannot be read.
+static model::paths_set
+read_changed_files(const fs::path& file)
+{
+    std::ifstream input(file.c_str());
+    if (!input)
+        throw cmdline::option_argument_value_error(
+            "--changed-files", file.str(), "Cannot open file");
+
+    model::paths_set changed_files;
+    std::string line;
+    while (std::getline(input, line)) {
+        if (line.empty() || line[0] == '#')
+            continue;
+        const fs::path changed_file(line);
+        changed_files.insert(changed_file.is_absolute() ?
+                             changed_file : changed_file.to_absolute());
+    }
+    return changed_files;
+}
+
+
+/// Reads the dependencies of the test programs generated by the build.
+///
+/// \param file The dependency manifest, which uses the syntax of the
+///     dependency files generated by compilers for make: every rule names a
+///     test program, relative to the directory of the Kyuafile, followed by a
+///     colon and the files it was built from, relative to the directory of the
+///     manifest.  Long rules can be split by ending their lines in a backslash.
+///
+/// \return The absolute paths to the dependencies of every test program.
+///
+/// \throw cmdline::option_argument_value_error If the file cannot be read or
+///     is invalid.
+static engine::change_filter::dependencies_map
+read_dependency_manifest(const fs::path& file)
+{
+    std::ifstream input(file.c_str());
+    if (!input)
+        throw cmdline::option_argument_value_error(
+            "--dependency-manifest", file.str(), "Cannot open file");
+    const fs::path directory = file.is_absolute() ?
+        file.branch_path() : file.branch_path().to_absolute();
+
+    engine::change_filter::dependencies_map dependencies;
+    std::string rule;
+    std::string line;
+    while (std::getline(input, line)) {
+        if (!line.empty() && line[line.length() - 1] == '\\') {
+            rule += line.substr(0, line.length() - 1) + " ";
+            continue;
+        }
+        rule += line;
+        const std::string::size_type start = rule.find_first_not_of(" \t");
+        if (start == std::string::npos || rule[start] == '#') {
+            rule.clear();
+            continue;
+        }
+
+        const std::string::size_type colon = rule.find(':');
+        if (colon == std::string::npos)
+            throw cmdline::option_argument_value_error(
+                "--dependency-manifest", file.str(),
+                F("Invalid rule '%s'; must be of the form "
+                  "program: file ...") % rule);
+        std::istringstream targets(rule.substr(0, colon));
+        std::istringstream prerequisites(rule.substr(colon + 1));
+        rule.clear();
+
+        model::paths_set files;
+        std::string word;
+        while (prerequisites >> word) {
+            const fs::path prerequisite(word);
+            files.insert(prerequisite.is_absolute() ?
+                         prerequisite : directory / prerequisite);
+        }
+        while (targets >> word)
+            dependencies[fs::path(word)].insert(files.begin(), files.end());
+    }
+    return dependencies;
+}
+
+
+/// Gets the changed files that the test cases to run must be affected by.
+///
+/// \param cmdline The parsed command line.
+///
+/// \return The change filter, if --changed-files was given; none otherwise.
+///
+/// \throw cmdline::usage_error If the options are invalid.
+static optional< engine::change_filter >
+get_changes(const cmdline::parsed_cmdline& cmdline)
+{
+    if (!cmdline.has_option("changed-files")) {
+        if (cmdline.has_option("dependency-manifest"))
+            throw cmdline::usage_error("--dependency-manifest requires "
+                                       "--changed-files");
+        return none;
+    }
+
+    engine::change_filter::dependencies_map dependencies;
+    if (cmdline.has_option("dependency-manifest"))
+        dependencies = read_dependency_manifest(
+            cmdline.get_option< cmdline::path_option >("dependency-manifest"));
+    return utils::make_optional(engine::change_filter(
+        read_changed_files(cmdline.get_option< cmdline::path_option >(
+                               "changed-files")),
+        dependencies));
+}
+
+
+/// Reports to generate from the results of the run, as given by --report.
+///
+/// All the reports are fed from a single pass over the results, done through
+/// the same database connection used to store them.
+class reports_set : utils::noncopyable {
+    /// Streams to which the file-based reports are written.
+    std::vector< std::shared_ptr< std::ostream > > _outputs;
+
+    /// Hooks of the individual reports.
+    std::vector< std::shared_ptr< drivers::scan_results::base_hooks > > _hooks;
+
+    /// Hooks that forward the results to all reports; NULL if there are none.
+    std::auto_ptr< drivers::scan_results::tee_hooks > _tee;
+
+    /// Opens the output file of a report.
+    ///
+    /// \param path The path to the file to create.
+    ///
+    /// \return The opened stream, owned by this object.
+    std::ostream&
+    open_output(const fs::path& path)
+    {
+        _outputs.push_back(std::shared_ptr< std::ostream >(
+            utils::open_ostream(path).release()));
+        return *_outputs.back();
+    }
+
+public:
+    /// Sets up the reports.
+    ///
+    /// The output files and directories are created upfront so that problems
+    /// with them are detected before running any test.
+    ///
+    /// \param ui Object to interact with the I/O of the program.
+    /// \param specs The values given to --report, of the form format:path.
+    /// \param user_config The runtime configuration of the program.
+    ///
+    /// \throw cmdline::usage_error If any of the specifications is invalid.
+    reports_set(cmdline::ui* ui, const std::vector< std::string >& specs,
+                const config::tree& user_config)
+    {
+        std::vector< drivers::scan_results::base_hooks* > hooks;
+        for (std::vector< std::string >::const_iterator iter = specs.begin();
+             iter != specs.end(); ++iter) {
+            const std::string::size_type colon = (*iter).find(':');
+            if (colon == std::string::npos || colon == 0 ||
+                colon == (*iter).length() - 1)
+                throw cmdline::usage_error(F("Invalid value for --report: %s; "
+                                             "must be of the form "
+                                             "format:path") % *iter);
+            const std::string format = (*iter).substr(0, colon);
+            const fs::path path((*iter).substr(colon + 1));
+
+            if (format == "html") {
+                _hooks.push_back(std::shared_ptr<
+                    drivers::scan_results::base_hooks >(
+                        cli::new_html_hooks(ui, path, user_config).release()));
+            } else if (format == "json") {
+                std::vector< std::ostream* > streams;
+                streams.push_back(&open_output(path));
+                _hooks.push_back(std::shared_ptr<
+                    drivers::scan_results::base_hooks >(
+                        new drivers::report_json_hooks(streams, false,
+                                                       units::bytes(0))));
+            } else if (format == "junit") {
+                _hooks.push_back(std::shared_ptr<
+                    drivers::scan_results::base_hooks >(
+                        new drivers::report_junit_hooks(open_output(path))));
+            } else {
+                throw cmdline::usage_error(F("Invalid value for --report: %s; "
+                                             "unknown format '%s'") % *iter %
+                                           format);
+            }
+            hooks.push_back(_hooks.back().get());
+        }
+        if (!hooks.empty())
+            _tee.reset(new drivers::scan_results::tee_hooks(hooks));
+    }
+
+    /// Gets the hooks to feed the results of the run to.
+    ///
+    /// \return The hooks, or NULL if no reports were requested.
+    drivers::scan_results::base_hooks*
+    hooks(void)
+    {
+        return _tee.get();
     }
 };
 
 
+/// Computes the identity of a watched file.
+///
+/// \param file The file to query.
+///
+/// \return A textual representation of the identity of the file, which
+/// changes whenever the file is rewritten or replaced, or an empty string if
+/// the file cannot be stat'ed.
+static std::string
+file_identity(const fs::path& file)
+{
+    struct ::stat sb;
+    if (::stat(file.c_str(), &sb) == -1)
+        return "";
+    return F("%s:%s:%s:%s") % sb.st_dev % sb.st_ino % sb.st_size %
+        fs::format_mtime(sb);
+}
+
+
+/// Sleeps until the next check of the watched files.
+static void
+sleep_watch_period(void)
+{
+    struct ::timespec remaining;
+    remaining.tv_sec = watch_period.seconds;
+    remaining.tv_nsec = watch_period.useconds * 1000;
+    while (::nanosleep(&remaining, &remaining) == -1 && errno == EINTR) {
+        // Retry with the remaining time.
+    }
+}
+
+
 }  // anonymous namespace
 
 
+/// Maximum number of results held back by --ordered-output.
+const std::size_t cli::detail::reorder_capacity = 256;
+
+
+/// Internal implementation of the ordered_hooks.
+struct cli::detail::ordered_hooks::impl : utils::noncopyable {
+    /// A test case that started and its result, if known.
+    struct entry {
+        /// The test program containing the test case.
+        model::test_program test_program;
+
+        /// The name of the test case.
+        std::string test_case_name;
+
+        /// The result of the test case and the time it took to run.
+        optional< std::pair< model::test_result, datetime::delta > > result;
+
+        /// Constructor.
+        ///
+        /// \param test_program_ The test program containing the test case.
+        /// \param test_case_name_ The name of the test case.
+        entry(const model::test_program& test_program_,
+              const std::string& test_case_name_) :
+            test_program(test_program_), test_case_name(test_case_name_)
+        {
+        }
+    };
+
+    /// The hooks to forward to.
+    drivers::run_tests::base_hooks& hooks;
+
+    /// The test cases that started and have not been forwarded yet, in order.
+    std::deque< entry > entries;
+
+    /// Number of entries in entries with a result.
+    std::size_t held;
+
+    /// Constructor.
+    ///
+    /// \param hooks_ The hooks to forward to.
+    explicit impl(drivers::run_tests::base_hooks& hooks_) :
+        hooks(hooks_), held(0)
+    {
+    }
+
+    /// Forwards a test case and its result.
+    ///
+    /// \param e The entry to forward; must have a result.
+    void
+    forward(const entry& e)
+    {
+        hooks.got_test_case(e.test_program, e.test_case_name);
+        hooks.got_result(e.test_program, e.test_case_name,
+                         e.result.get().first, e.result.get().second);
+    }
+
+    /// Forwards the results that are ready.
+    ///
+    /// \param all Whether to forward all the known results even if some
+    ///     earlier test cases have not completed yet.
+    void
+    release(const bool all)
+    {
+        while (!entries.empty() && entries.front().result) {
+            forward(entries.front());
+            entries.pop_front();
+            --held;
+        }
+
+        if (all || held >= reorder_capacity) {
+            std::deque< entry > pending;
+            for (std::deque< entry >::const_iterator iter = entries.begin();
+                 iter != entries.end(); ++iter) {
+                if ((*iter).result)
+                    forward(*iter);
+                else
+                    pending.push_back(*iter);
+            }
+            entries.swap(pending);
+            held = 0;
+        }
+    }
+};
+
+
+/// Constructor.
+///
+/// \param hooks_ The hooks to forward to.
+cli::detail::ordered_hooks::ordered_hooks(
+    drivers::run_tests::base_hooks& hooks_) :
+    _pimpl(new impl(hooks_))
+{
+}
+
+
+/// Destructor.
+cli::detail::ordered_hooks::~ordered_hooks(void)
+{
+}
+
+
+/// Called when the processing of a test case begins.
+///
+/// \param test_program The test program containing the test case.
+/// \param test_case_name The name of the test case being executed.
+void
+cli::detail::ordered_hooks::got_test_case(
+    const model::test_program& test_program,
+    const std::string& test_case_name)
+{
+    _pimpl->entries.push_back(impl::entry(test_program, test_case_name));
+}
+
+
+/// Called when a result of a test case becomes available.
+///
+/// \param test_program The test program containing the test case.
+/// \param test_case_name The name of the test case being executed.
+/// \param result The result of the execution of the test case.
+/// \param duration The time it took to run the test.
+void
+cli::detail::ordered_hooks::got_result(
+    const model::test_program& test_program,
+    const std::string& test_case_name,
+    const model::test_result& result,
+    const datetime::delta& duration)
+{
+    std::deque< impl::entry >::iterator iter = _pimpl->entries.begin();
+    while (iter != _pimpl->entries.end() &&
+           ((*iter).result || (*iter).test_case_name != test_case_name ||
+            (*iter).test_program.relative_path() !=
+                test_program.relative_path()))
+        ++iter;
+    if (iter == _pimpl->entries.end()) {
+        // The driver did not announce this test case; report it as is.
+        _pimpl->hooks.got_test_case(test_program, test_case_name);
+        _pimpl->hooks.got_result(test_program, test_case_name, result,
+                                 duration);
+        return;
+    }
+
+    (*iter).result = std::make_pair(result, duration);
+    ++_pimpl->held;
+    _pimpl->release(false);
+}
+
+
+/// Provides the receiver of the events of the scheduler.
+///
+/// \return The observer of the forwarded hooks.
+engine::scheduler::observer*
+cli::detail::ordered_hooks::scheduler_observer(void)
+{
+    return _pimpl->hooks.scheduler_observer();
+}
+
+
+/// Called periodically with the metrics of the run, and once at its end.
+///
+/// \param metrics The metrics of the run so far.
+void
+cli::detail::ordered_hooks::got_metrics(
+    const drivers::run_tests::metrics& metrics)
+{
+    _pimpl->hooks.got_metrics(metrics);
+}
+
+
+/// Checks whether poll() has to be called periodically.
+///
+/// \return Whether the forwarded hooks want to be polled.
+bool
+cli::detail::ordered_hooks::wants_polling(void)
+{
+    return _pimpl->hooks.wants_polling();
+}
+
+
+/// Lets the forwarded hooks do periodic work.
+void
+cli::detail::ordered_hooks::poll(void)
+{
+    _pimpl->hooks.poll();
+}
+
+
+/// Checks whether the forwarded hooks feed the test programs.
+///
+/// \return Whether the forwarded hooks feed the test programs.
+bool
+cli::detail::ordered_hooks::feeds_test_programs(void)
+{
+    return _pimpl->hooks.feeds_test_programs();
+}
+
+
+/// Collects the test programs fed by the forwarded hooks.
+///
+/// \param [out] paths The paths to the fed test programs.
+/// \param wait Whether to block until there is any path.
+///
+/// \return False once the feed has ended; true otherwise.
+bool
+cli::detail::ordered_hooks::feed_test_programs(std::vector< fs::path >& paths,
+                                               const bool wait)
+{
+    return _pimpl->hooks.feed_test_programs(paths, wait);
+}
+
+
+/// Checks whether the forwarded hooks changed the configuration.
+///
+/// \param [out] user_config The new configuration.
+///
+/// \return Whether the forwarded hooks replaced user_config.
+bool
+cli::detail::ordered_hooks::reload_config(config::tree& user_config)
+{
+    return _pimpl->hooks.reload_config(user_config);
+}
+
+
+/// Forwards all the results still held back.
+void
+cli::detail::ordered_hooks::finish(void)
+{
+    _pimpl->release(true);
+}
+
+
+/// Internal implementation of the change_watcher.
+struct cli::detail::change_watcher::impl : utils::noncopyable {
+    /// Test programs affected by every watched file.
+    std::map< fs::path, std::set< fs::path > > programs;
+
+    /// Identity of every watched file as of the last check; empty if missing.
+    std::map< fs::path, std::string > identities;
+};
+
+
+/// Constructor.
+cli::detail::change_watcher::change_watcher(void) :
+    _pimpl(new impl())
+{
+}
+
+
+/// Destructor.
+cli::detail::change_watcher::~change_watcher(void)
+{
+}
+
+
+/// Records the files read by the test programs of a run.
+///
+/// Files that are already watched keep the identity of the last check, so that
+/// any changes made while the run was in progress are not missed.
+///
+/// \param inputs The files read by the test programs that ran.
+void
+cli::detail::change_watcher::update(
+    const drivers::run_tests::inputs_map& inputs)
+{
+    std::map< fs::path, std::set< fs::path > >& programs = _pimpl->programs;
+    for (drivers::run_tests::inputs_map::const_iterator iter = inputs.begin();
+         iter != inputs.end(); ++iter) {
+        for (std::map< fs::path, std::set< fs::path > >::iterator iter2 =
+                 programs.begin(); iter2 != programs.end(); ++iter2)
+            (*iter2).second.erase((*iter).first);
+        for (std::set< fs::path >::const_iterator iter2 =
+                 (*iter).second.begin(); iter2 != (*iter).second.end();
+             ++iter2)
+            programs[*iter2].insert((*iter).first);
+    }
+
+    std::map< fs::path, std::set< fs::path > >::iterator iter =
+        programs.begin();
+    while (iter != programs.end()) {
+        if ((*iter).second.empty()) {
+            _pimpl->identities.erase((*iter).first);
+            programs.erase(iter++);
+        } else {
+            if (_pimpl->identities.find((*iter).first) ==
+                _pimpl->identities.end())
+                _pimpl->identities[(*iter).first] = file_identity(
+                    (*iter).first);
+            ++iter;
+        }
+    }
+}
+
+
+/// Counts the watched files.
+///
+/// \return The number of files being watched.
+std::size_t
+cli::detail::change_watcher::size(void) const
+{
+    return _pimpl->identities.size();
+}
+
+
+/// Checks the watched files and records their new identities.
+///
+/// \return The relative paths of the test programs affected by the files that
+/// changed since the last check.
+std::set< fs::path >
+cli::detail::change_watcher::check(void)
+{
+    std::set< fs::path > affected;
+    for (std::map< fs::path, std::string >::iterator iter =
+             _pimpl->identities.begin(); iter != _pimpl->identities.end();
+         ++iter) {
+        const std::string current = file_identity((*iter).first);
+        if (current == (*iter).second)
+            continue;
+        LD(F("Watched file %s changed") % (*iter).first);
+        (*iter).second = current;
+        const std::set< fs::path >& programs =
+            _pimpl->programs[(*iter).first];
+        affected.insert(programs.begin(), programs.end());
+    }
+    return affected;
+}
+
+
+/// Waits until any watched file changes.
+///
+/// Once a change is seen, this keeps waiting until the files settle down so
+/// that a build that rewrites several of them triggers a single run.
+///
+/// \return The relative paths of the test programs affected by the files that
+/// changed.
+std::set< fs::path >
+cli::detail::change_watcher::wait(void)
+{
+    std::set< fs::path > affected;
+    do {
+        sleep_watch_period();
+        affected = check();
+    } while (affected.empty());
+
+    for (;;) {
+        sleep_watch_period();
+        const std::set< fs::path > more = check();
+        if (more.empty())
+            break;
+        affected.insert(more.begin(), more.end());
+    }
+    return affected;
+}
+
+
+/// Narrows the filters of the user down to the test programs that changed.
+///
+/// \param user_filters The filters provided by the user; may be empty.
+/// \param programs The relative paths of the test programs that changed.
+///
+/// \return The filters that select the test cases of the changed test
+/// programs that the user filters selected.
+std::set< engine::test_filter >
+cli::detail::affected_filters(
+    const std::set< engine::test_filter >& user_filters,
+    const std::set< fs::path >& programs)
+{
+    std::set< engine::test_filter > filters;
+    for (std::set< fs::path >::const_iterator iter = programs.begin();
+         iter != programs.end(); ++iter) {
+        if (user_filters.empty()) {
+            filters.insert(engine::test_filter(*iter, ""));
+            continue;
+        }
+        for (std::set< engine::test_filter >::const_iterator iter2 =
+                 user_filters.begin(); iter2 != user_filters.end(); ++iter2) {
+            const engine::test_filter& filter = *iter2;
+            if (filter.test_case.empty()) {
+                if (filter.matches_test_program(*iter))
+                    filters.insert(engine::test_filter(*iter, ""));
+            } else if (filter.test_program == *iter) {
+                filters.insert(filter);
+            }
+        }
+    }
+    return filters;
+}
+
+
 /// Default constructor for cmd_test.
 cmd_test::cmd_test(void) : cli_command(
     "test", "[test-program ...]", 0, -1, "Run tests")
 {
     add_option(build_root_option);
     add_option(kyuafile_option);
+    add_option(metadata_filter_option);
     add_option(results_file_create_option);
+    add_option(shard_option);
+    add_option(cmdline::path_option(
+        "changed-files", "Only run the test cases affected by the files "
+        "listed in this file, one per line", "file"));
+    add_option(cmdline::bool_option(
+        "compact", "Only print the test cases that do not pass, along with a "
+        "status line that updates in place"));
+    add_option(cmdline::path_option(
+        "dependency-manifest", "Dependencies of the test programs generated "
+        "by the build, used along with --changed-files", "file"));
+    add_option(cmdline::bool_option(
+        "failed-first", "Run the test cases that failed in the previous run "
+        "first, followed by the new test cases"));
+    add_option(cmdline::bool_option(
+        "fail-fast", "Stop the run after the first failed test case; same as "
+        "--max-failures=1"));
+    add_option(cmdline::int_option(
+        "max-failures", "Stop the run after this number of failed test cases",
+        "count"));
+    add_option(cmdline::path_option(
+        "metrics-file", "Keep this file up to date with the progress of the "
+        "run in the OpenMetrics text format", "file"));
+    add_option(cmdline::bool_option(
+        "ordered-output", "Print the results in the order in which the test "
+        "cases started instead of as they complete"));
+    add_option(cmdline::int_option(
+        "repeat", "Run every test case this number of times and report the "
+        "flake rate of those that fail; unlimited with --until-fail", "count"));
+    add_option(cmdline::path_option(
+        "resume", "Continue the interrupted run recorded in this results "
+        "file, skipping the test cases it already ran", "file"));
+    add_option(cmdline::string_option(
+        "report", "Generate a report from the results once the run completes, "
+        "in the html, json or junit format; can be repeated", "format:path"));
+    add_option(cmdline::bool_option(
+        "stats", "Print the latencies of the phases of the run"));
+    add_option(cmdline::string_option(
+        "stream-output", "Print the output of the test cases matching this "
+        "filter while they run", "filter"));
+    add_option(cmdline::bool_option(
+        "until-fail", "Repeat the test cases until one of them fails"));
+    add_option(cmdline::bool_option(
+        "watch", "Keep running, and rerun the test programs whose binaries or "
+        "required files change"));
+    add_option(cmdline::bool_option(
+        "watch-inputs", "Run every test program once its path is read from "
+        "stdin, and all others once stdin is closed"));
 }
 
 
@@ -148,39 +1746,173 @@ int
 cmd_test::run(cmdline::ui* ui, const cmdline::parsed_cmdline& cmdline,
               const config::tree& user_config)
 {
-    const layout::results_id_file_pair results = layout::new_db(
-        results_file_create(cmdline), kyuafile_path(cmdline).branch_path());
+    // An automatic parallelism is 0, which may grow past 1.  So may a fixed
+    // parallelism if a reload of the configuration raises it up to
+    // parallelism_max.
+    const bool parallel = (user_config.lookup< engine::parallelism_node >(
+                               "parallelism") != 1) ||
+        (user_config.is_set("parallelism_max") &&
+         user_config.lookup< config::positive_int_node >(
+             "parallelism_max") > 1);
 
-    const bool parallel = (user_config.lookup< config::positive_int_node >(
-                               "parallelism") > 1);
+    // The previous results provide the durations used to schedule parallel
+    // runs, the failures to rerun first and the results to reuse when result
+    // caching is enabled.
+    const bool cache_results = user_config.is_set("cache_results") &&
+        user_config.lookup< config::bool_node >("cache_results");
+    const bool failed_first = cmdline.has_option("failed-first");
+    const optional< engine::change_filter > changes = get_changes(cmdline);
 
-    print_hooks hooks(ui, parallel);
-    const drivers::run_tests::result result = drivers::run_tests::drive(
-        kyuafile_path(cmdline), build_root_path(cmdline), results.second,
-        parse_filters(cmdline.arguments()), user_config, hooks);
+    optional< std::size_t > max_failures;
+    if (cmdline.has_option("max-failures")) {
+        const int value = cmdline.get_option< cmdline::int_option >(
+            "max-failures");
+        if (value < 1)
+            throw cmdline::usage_error(F("Invalid value for --max-failures: "
+                                         "%s; must be positive") % value);
+        max_failures = static_cast< std::size_t >(value);
+    } else if (cmdline.has_option("fail-fast")) {
+        max_failures = static_cast< std::size_t >(1);
+    }
 
-    int exit_code;
-    if (hooks.good_count > 0 || hooks.bad_count > 0) {
-        ui->out("");
-        if (!results.first.empty()) {
-            ui->out(F("Results file id is %s") % results.first);
-        }
-        ui->out(F("Results saved to %s") % results.second);
-        ui->out("");
+    const bool until_fail = cmdline.has_option("until-fail");
+    std::size_t repeat = until_fail ? 0 : 1;
+    if (cmdline.has_option("repeat")) {
+        const int value = cmdline.get_option< cmdline::int_option >("repeat");
+        if (value < 1)
+            throw cmdline::usage_error(F("Invalid value for --repeat: %s; "
+                                         "must be positive") % value);
+        repeat = static_cast< std::size_t >(value);
+    }
 
-        ui->out(F("%s/%s passed (%s failed)") % hooks.good_count %
-                (hooks.good_count + hooks.bad_count) % hooks.bad_count);
+    const std::set< engine::test_filter > user_filters = parse_filters(
+        cmdline.arguments());
+    const bool watch = cmdline.has_option("watch");
+    if (watch) {
+        const std::string results_file = results_file_create(cmdline);
+        if (results_file != layout::results_auto_create_name &&
+            results_file != layout::results_in_memory_name)
+            throw cmdline::usage_error("--watch requires a new results file "
+                                       "for every run; cannot use an explicit "
+                                       "--results-file");
+    }
+
+    optional< fs::path > resume;
+    if (cmdline.has_option("resume")) {
+        if (watch)
+            throw cmdline::usage_error("--resume cannot be combined with "
+                                       "--watch");
+        if (repeat != 1)
+            throw cmdline::usage_error("--resume cannot be combined with "
+                                       "--repeat or --until-fail");
+        if (cmdline.get_option< cmdline::string_option >(
+                cli::results_file_create_option.long_name()) !=
+            cli::results_file_create_option.default_value())
+            throw cmdline::usage_error("--resume appends to the given results "
+                                       "file; cannot use --results-file");
+        resume = cmdline.get_option< cmdline::path_option >("resume");
+    }
 
-        exit_code = (hooks.bad_count == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
-    } else {
-        // TODO(jmmv): Delete created empty file; it's useless!
-        if (!results.first.empty()) {
-            ui->out(F("Results file id is %s") % results.first);
+    optional< engine::test_filter > stream_filter;
+    if (cmdline.has_option("stream-output")) {
+        try {
+            stream_filter = engine::test_filter::parse(
+                cmdline.get_option< cmdline::string_option >("stream-output"));
+        } catch (const std::runtime_error& e) {
+            throw cmdline::usage_error(F("Invalid value for --stream-output: "
+                                         "%s") % e.what());
         }
-        ui->out(F("Results saved to %s") % results.second);
-        exit_code = EXIT_SUCCESS;
     }
 
-    return report_unused_filters(result.unused_filters, ui) ?
-        EXIT_FAILURE : exit_code;
+    std::set< engine::test_filter > filters = user_filters;
+    detail::change_watcher watcher;
+    config_reloader reloader;
+    for (;;) {
+        reports_set reports(
+            ui, cmdline.has_option("report") ?
+            cmdline.get_multi_option< cmdline::string_option >("report") :
+            std::vector< std::string >(), user_config);
+
+        optional< fs::path > previous_results;
+        if (parallel || cache_results || failed_first) {
+            try {
+                previous_results = layout::find_results(
+                    layout::test_suite_for_path(
+                        kyuafile_path(cmdline).branch_path()));
+            } catch (const store::error& e) {
+                LI(F("No previous results available: %s") % e.what());
+            }
+        }
+
+        const std::string results_file = results_file_create(cmdline);
+        optional< layout::results_id_file_pair > results;
+        if (resume)
+            results = layout::results_id_file_pair("", resume.get());
+        else if (results_file != layout::results_in_memory_name)
+            results = layout::new_db(results_file,
+                                     kyuafile_path(cmdline).branch_path());
+
+        print_hooks hooks(ui, parallel, repeat != 1,
+                          cmdline.has_option("compact"),
+                          cmdline.has_option("metrics-file") ?
+                          utils::make_optional(
+                              cmdline.get_option< cmdline::path_option >(
+                                  "metrics-file")) : none,
+                          stream_filter, cmdline.has_option("watch-inputs"),
+                          &reloader);
+        detail::ordered_hooks ordered(hooks);
+        drivers::run_tests::base_hooks& driver_hooks =
+            cmdline.has_option("ordered-output") ?
+            static_cast< drivers::run_tests::base_hooks& >(ordered) : hooks;
+        const drivers::run_tests::result result = drivers::run_tests::drive(
+            kyuafile_path(cmdline), build_root_path(cmdline),
+            results ? utils::make_optional(results.get().second) : none,
+            static_cast< bool >(resume), previous_results, filters,
+            get_shard(cmdline), get_metadata_filters(cmdline), changes,
+            failed_first,
+            max_failures, repeat, until_fail, user_config, driver_hooks,
+            reports.hooks());
+        ordered.finish();
+        hooks.finish();
+
+        if (results && user_config.is_set("store_trends_index") &&
+            user_config.lookup< config::bool_node >("store_trends_index"))
+            update_trends(layout::test_suite_for_path(
+                              kyuafile_path(cmdline).branch_path()),
+                          results.get().second);
+
+        int exit_code;
+        if (hooks.good_count > 0 || hooks.bad_count > 0) {
+            ui->out("");
+            print_results_file(ui, results);
+            ui->out("");
+
+            ui->out(F("%s/%s passed (%s failed)") % hooks.good_count %
+                    (hooks.good_count + hooks.bad_count) % hooks.bad_count);
+            if (max_failures && hooks.bad_count >= max_failures.get())
+                ui->out("Stopped after reaching the maximum number of "
+                        "failures");
+            print_flake_rates(ui, hooks.per_test_case);
+
+            exit_code = (hooks.bad_count == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+        } else {
+            // TODO(jmmv): Delete created empty file; it's useless!
+            print_results_file(ui, results);
+            exit_code = EXIT_SUCCESS;
+        }
+
+        if (cmdline.has_option("stats"))
+            print_latencies(ui, result.latencies);
+
+        const bool unused_filters = report_unused_filters(
+            result.unused_filters, ui);
+        if (!watch)
+            return unused_filters ? EXIT_FAILURE : exit_code;
+
+        watcher.update(result.inputs);
+        ui->out("");
+        ui->out(F("Watching %s files for changes") % watcher.size());
+        filters = detail::affected_filters(user_filters, watcher.wait());
+        ui->out("");
+    }
 }
@@ -32,11 +32,99 @@
 #if !defined(CLI_CMD_TEST_HPP)
 #define CLI_CMD_TEST_HPP
 
+#include <cstddef>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
 #include "cli/common.hpp"
+#include "drivers/run_tests.hpp"
+#include "engine/filters_fwd.hpp"
+#include "engine/scheduler_fwd.hpp"
+#include "model/test_program_fwd.hpp"
+#include "model/test_result_fwd.hpp"
+#include "utils/config/tree_fwd.hpp"
+#include "utils/datetime_fwd.hpp"
+#include "utils/fs/path_fwd.hpp"
+#include "utils/noncopyable.hpp"
 
 namespace cli {
 
 
+namespace detail {
+
+
+extern const std::size_t reorder_capacity;
+
+
+/// Hooks that forward the results in the order in which the tests started.
+///
+/// The driver reports the results as the test cases complete, which varies
+/// from run to run when they execute in parallel.  These hooks hold back the
+/// results of the test cases that complete before others that started earlier,
+/// so only the results waiting for slower test cases are kept in memory.  If
+/// more than reorder_capacity results pile up behind a slow test case, they
+/// are forwarded right away and the slow test case is reported once it
+/// completes.
+class ordered_hooks : public drivers::run_tests::base_hooks,
+                      utils::noncopyable {
+    struct impl;
+
+    /// Pointer to the internal implementation.
+    std::auto_ptr< impl > _pimpl;
+
+public:
+    explicit ordered_hooks(drivers::run_tests::base_hooks&);
+    ~ordered_hooks(void);
+
+    void got_test_case(const model::test_program&, const std::string&);
+    void got_result(const model::test_program&, const std::string&,
+                    const model::test_result&, const utils::datetime::delta&);
+    engine::scheduler::observer* scheduler_observer(void);
+    void got_metrics(const drivers::run_tests::metrics&);
+    bool wants_polling(void);
+    void poll(void);
+    bool feeds_test_programs(void);
+    bool feed_test_programs(std::vector< utils::fs::path >&, const bool);
+    bool reload_config(utils::config::tree&);
+
+    void finish(void);
+};
+
+
+/// Watches the files read by the test programs for changes between runs.
+///
+/// The files are polled and compared by their device, inode, size and
+/// modification time with subsecond precision, as the list cache does for the
+/// binaries: this works the same on all platforms and file systems, and a test
+/// suite has few enough files for this to be cheap.  Files that appear or
+/// disappear count as changed too.
+class change_watcher : utils::noncopyable {
+    struct impl;
+
+    /// Pointer to the internal implementation.
+    std::auto_ptr< impl > _pimpl;
+
+public:
+    change_watcher(void);
+    ~change_watcher(void);
+
+    void update(const drivers::run_tests::inputs_map&);
+    std::size_t size(void) const;
+    std::set< utils::fs::path > check(void);
+    std::set< utils::fs::path > wait(void);
+};
+
+
+std::set< engine::test_filter > affected_filters(
+    const std::set< engine::test_filter >&,
+    const std::set< utils::fs::path >&);
+
+
+}  // namespace detail
+
+
 /// Implementation of the "test" subcommand.
 class cmd_test : public cli_command
 {
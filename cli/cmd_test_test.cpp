@@ -28,16 +28,213 @@
 
 #include "cli/cmd_test.hpp"
 
+#if defined(HAVE_CONFIG_H)
+#   include "config.h"
+#endif
+
+extern "C" {
+#include <sys/time.h>
+}
+
+#include <set>
+#include <string>
+#include <vector>
+
 #include <atf-c++.hpp>
 
 #include "cli/common.ipp"
+#include "drivers/run_tests.hpp"
 #include "engine/config.hpp"
+#include "engine/filters.hpp"
+#include "model/metadata.hpp"
+#include "model/test_program.hpp"
+#include "model/test_result.hpp"
 #include "utils/cmdline/exceptions.hpp"
 #include "utils/cmdline/parser.hpp"
 #include "utils/cmdline/ui_mock.hpp"
 #include "utils/config/tree.ipp"
+#include "utils/datetime.hpp"
+#include "utils/defs.hpp"
+#include "utils/format/macros.hpp"
+#include "utils/fs/operations.hpp"
+#include "utils/fs/path.hpp"
 
 namespace cmdline = utils::cmdline;
+namespace datetime = utils::datetime;
+namespace fs = utils::fs;
+
+
+namespace {
+
+
+/// Hooks that record the names of the test cases they receive.
+class capture_hooks : public drivers::run_tests::base_hooks {
+public:
+    /// The names of the test cases given to got_test_case, in order.
+    std::vector< std::string > test_cases;
+
+    /// The names of the test cases given to got_result, in order.
+    std::vector< std::string > results;
+
+    /// Records the start of a test case.
+    ///
+    /// \param test_case_name The name of the test case.
+    void
+    got_test_case(const model::test_program& UTILS_UNUSED_PARAM(test_program),
+                  const std::string& test_case_name)
+    {
+        test_cases.push_back(test_case_name);
+    }
+
+    /// Records the result of a test case.
+    ///
+    /// \param test_case_name The name of the test case.
+    void
+    got_result(const model::test_program& UTILS_UNUSED_PARAM(test_program),
+               const std::string& test_case_name,
+               const model::test_result& UTILS_UNUSED_PARAM(result),
+               const datetime::delta& UTILS_UNUSED_PARAM(duration))
+    {
+        results.push_back(test_case_name);
+    }
+};
+
+
+/// Builds a fake test program for the tests of the ordered_hooks.
+///
+/// \return A test program.
+static model::test_program
+fake_test_program(void)
+{
+    return model::test_program_builder(
+        "mock", fs::path("the-program"), fs::path("/root"), "the-suite")
+        .build();
+}
+
+
+/// Reports the result of a test case to some hooks.
+///
+/// \param hooks The hooks to report the result to.
+/// \param program The test program containing the test case.
+/// \param test_case_name The name of the test case.
+static void
+report_result(drivers::run_tests::base_hooks& hooks,
+              const model::test_program& program,
+              const std::string& test_case_name)
+{
+    hooks.got_result(program, test_case_name,
+                     model::test_result(model::test_result_passed),
+                     datetime::delta());
+}
+
+
+}  // anonymous namespace
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(ordered_hooks__in_order);
+ATF_TEST_CASE_BODY(ordered_hooks__in_order)
+{
+    const model::test_program program = fake_test_program();
+    capture_hooks capture;
+    cli::detail::ordered_hooks ordered(capture);
+
+    ordered.got_test_case(program, "a");
+    ordered.got_test_case(program, "b");
+    report_result(ordered, program, "a");
+    ATF_REQUIRE_EQ(1, capture.results.size());
+    report_result(ordered, program, "b");
+    ordered.finish();
+
+    std::vector< std::string > exp;
+    exp.push_back("a");
+    exp.push_back("b");
+    ATF_REQUIRE(exp == capture.test_cases);
+    ATF_REQUIRE(exp == capture.results);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(ordered_hooks__out_of_order);
+ATF_TEST_CASE_BODY(ordered_hooks__out_of_order)
+{
+    const model::test_program program = fake_test_program();
+    capture_hooks capture;
+    cli::detail::ordered_hooks ordered(capture);
+
+    ordered.got_test_case(program, "a");
+    ordered.got_test_case(program, "b");
+    ordered.got_test_case(program, "c");
+    ordered.got_test_case(program, "d");
+    report_result(ordered, program, "c");
+    report_result(ordered, program, "b");
+    ATF_REQUIRE(capture.results.empty());
+    report_result(ordered, program, "a");
+    report_result(ordered, program, "d");
+    ordered.finish();
+
+    std::vector< std::string > exp;
+    exp.push_back("a");
+    exp.push_back("b");
+    exp.push_back("c");
+    exp.push_back("d");
+    ATF_REQUIRE(exp == capture.test_cases);
+    ATF_REQUIRE(exp == capture.results);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(ordered_hooks__unannounced);
+ATF_TEST_CASE_BODY(ordered_hooks__unannounced)
+{
+    const model::test_program program = fake_test_program();
+    capture_hooks capture;
+    cli::detail::ordered_hooks ordered(capture);
+
+    ordered.got_test_case(program, "a");
+    report_result(ordered, program, "unknown");
+    report_result(ordered, program, "a");
+    ordered.finish();
+
+    std::vector< std::string > exp;
+    exp.push_back("unknown");
+    exp.push_back("a");
+    ATF_REQUIRE(exp == capture.results);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(ordered_hooks__over_capacity);
+ATF_TEST_CASE_BODY(ordered_hooks__over_capacity)
+{
+    const model::test_program program = fake_test_program();
+    capture_hooks capture;
+    cli::detail::ordered_hooks ordered(capture);
+
+    ordered.got_test_case(program, "slow");
+    for (std::size_t i = 0; i < cli::detail::reorder_capacity + 1; ++i)
+        ordered.got_test_case(program, F("fast-%s") % i);
+
+    for (std::size_t i = 0; i < cli::detail::reorder_capacity - 1; ++i)
+        report_result(ordered, program, F("fast-%s") % i);
+    ATF_REQUIRE(capture.results.empty());
+
+    // Reaching the capacity forwards the results held so far even though the
+    // earliest test case has not completed yet.
+    report_result(ordered, program, F("fast-%s") %
+                  (cli::detail::reorder_capacity - 1));
+    ATF_REQUIRE_EQ(cli::detail::reorder_capacity, capture.results.size());
+    for (std::size_t i = 0; i < cli::detail::reorder_capacity; ++i)
+        ATF_REQUIRE_EQ((F("fast-%s") % i).str(), capture.results[i]);
+
+    report_result(ordered, program, "slow");
+    ATF_REQUIRE_EQ(cli::detail::reorder_capacity + 1, capture.results.size());
+    ATF_REQUIRE_EQ("slow", capture.results.back());
+
+    report_result(ordered, program, F("fast-%s") %
+                  cli::detail::reorder_capacity);
+    ordered.finish();
+    ATF_REQUIRE_EQ(cli::detail::reorder_capacity + 2, capture.results.size());
+    ATF_REQUIRE_EQ((F("fast-%s") % cli::detail::reorder_capacity).str(),
+                   capture.results.back());
+    ATF_REQUIRE(capture.test_cases == capture.results);
+}
 
 
 ATF_TEST_CASE_WITHOUT_HEAD(invalid_filter);
@@ -57,7 +254,222 @@ ATF_TEST_CASE_BODY(invalid_filter)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(dependency_manifest_without_changed_files);
+ATF_TEST_CASE_BODY(dependency_manifest_without_changed_files)
+{
+    cmdline::args_vector args;
+    args.push_back("test");
+    args.push_back("--dependency-manifest=deps.mk");
+
+    cli::cmd_test cmd;
+    cmdline::ui_mock ui;
+    ATF_REQUIRE_THROW_RE(cmdline::usage_error, "requires --changed-files",
+                         cmd.main(&ui, args, engine::default_config()));
+    ATF_REQUIRE(ui.out_log().empty());
+    ATF_REQUIRE(ui.err_log().empty());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(invalid_report);
+ATF_TEST_CASE_BODY(invalid_report)
+{
+    const char* const specs[] = { "junit", "junit:", ":out.xml", "xml:out.xml",
+                                  NULL };
+    for (const char* const* spec = specs; *spec != NULL; ++spec) {
+        cmdline::args_vector args;
+        args.push_back("test");
+        args.push_back(F("--report=%s") % *spec);
+
+        cli::cmd_test cmd;
+        cmdline::ui_mock ui;
+        ATF_REQUIRE_THROW_RE(cmdline::usage_error, "Invalid value for --report",
+                             cmd.main(&ui, args, engine::default_config()));
+        ATF_REQUIRE(ui.out_log().empty());
+        ATF_REQUIRE(ui.err_log().empty());
+    }
+    ATF_REQUIRE(!fs::exists(fs::path("out.xml")));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(change_watcher__no_changes);
+ATF_TEST_CASE_BODY(change_watcher__no_changes)
+{
+    atf::utils::create_file("input1", "");
+    atf::utils::create_file("input2", "");
+
+    drivers::run_tests::inputs_map inputs;
+    inputs[fs::path("program1")].insert(fs::path("input1"));
+    inputs[fs::path("program1")].insert(fs::path("input2"));
+    inputs[fs::path("program2")].insert(fs::path("input2"));
+
+    cli::detail::change_watcher watcher;
+    watcher.update(inputs);
+    ATF_REQUIRE_EQ(2, watcher.size());
+    ATF_REQUIRE(watcher.check().empty());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(change_watcher__modified);
+ATF_TEST_CASE_BODY(change_watcher__modified)
+{
+    atf::utils::create_file("input1", "");
+    atf::utils::create_file("input2", "");
+
+    drivers::run_tests::inputs_map inputs;
+    inputs[fs::path("program1")].insert(fs::path("input1"));
+    inputs[fs::path("program2")].insert(fs::path("input1"));
+    inputs[fs::path("program2")].insert(fs::path("input2"));
+    inputs[fs::path("program3")].insert(fs::path("input2"));
+
+    cli::detail::change_watcher watcher;
+    watcher.update(inputs);
+
+    atf::utils::create_file("input1", "more contents");
+    std::set< fs::path > exp_programs;
+    exp_programs.insert(fs::path("program1"));
+    exp_programs.insert(fs::path("program2"));
+    ATF_REQUIRE(exp_programs == watcher.check());
+    ATF_REQUIRE(watcher.check().empty());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(change_watcher__modified__same_second);
+ATF_TEST_CASE_BODY(change_watcher__modified__same_second)
+{
+#if !defined(HAVE_STRUCT_STAT_ST_MTIM) && \
+    !defined(HAVE_STRUCT_STAT_ST_MTIMESPEC)
+    skip("Modification times have a granularity of seconds");
+#endif
+    atf::utils::create_file("input", "");
+    struct ::timeval times[2];
+    times[0].tv_sec = times[1].tv_sec = 1000000000;
+    times[0].tv_usec = times[1].tv_usec = 1000;
+    ATF_REQUIRE(::utimes("input", times) != -1);
+
+    drivers::run_tests::inputs_map inputs;
+    inputs[fs::path("program")].insert(fs::path("input"));
+
+    cli::detail::change_watcher watcher;
+    watcher.update(inputs);
+
+    // A rewrite within the same second that keeps the inode and the size.
+    times[0].tv_usec = times[1].tv_usec = 2000;
+    ATF_REQUIRE(::utimes("input", times) != -1);
+    std::set< fs::path > exp_programs;
+    exp_programs.insert(fs::path("program"));
+    ATF_REQUIRE(exp_programs == watcher.check());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(change_watcher__appear_and_disappear);
+ATF_TEST_CASE_BODY(change_watcher__appear_and_disappear)
+{
+    drivers::run_tests::inputs_map inputs;
+    inputs[fs::path("program")].insert(fs::path("input"));
+
+    cli::detail::change_watcher watcher;
+    watcher.update(inputs);
+    ATF_REQUIRE_EQ(1, watcher.size());
+    ATF_REQUIRE(watcher.check().empty());
+
+    std::set< fs::path > exp_programs;
+    exp_programs.insert(fs::path("program"));
+
+    atf::utils::create_file("input", "");
+    ATF_REQUIRE(exp_programs == watcher.check());
+
+    fs::unlink(fs::path("input"));
+    ATF_REQUIRE(exp_programs == watcher.check());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(change_watcher__update);
+ATF_TEST_CASE_BODY(change_watcher__update)
+{
+    atf::utils::create_file("input1", "");
+    atf::utils::create_file("input2", "");
+
+    drivers::run_tests::inputs_map inputs;
+    inputs[fs::path("program1")].insert(fs::path("input1"));
+    inputs[fs::path("program2")].insert(fs::path("input2"));
+
+    cli::detail::change_watcher watcher;
+    watcher.update(inputs);
+    ATF_REQUIRE_EQ(2, watcher.size());
+
+    // A change made while the next run is in progress is still reported.
+    atf::utils::create_file("input2", "more contents");
+
+    // program1 no longer reads input1, so the file stops being watched.
+    drivers::run_tests::inputs_map new_inputs;
+    new_inputs[fs::path("program1")].insert(fs::path("input2"));
+    new_inputs[fs::path("program2")].insert(fs::path("input2"));
+    watcher.update(new_inputs);
+    ATF_REQUIRE_EQ(1, watcher.size());
+
+    atf::utils::create_file("input1", "more contents");
+    std::set< fs::path > exp_programs;
+    exp_programs.insert(fs::path("program1"));
+    exp_programs.insert(fs::path("program2"));
+    ATF_REQUIRE(exp_programs == watcher.check());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(affected_filters__no_user_filters);
+ATF_TEST_CASE_BODY(affected_filters__no_user_filters)
+{
+    std::set< fs::path > programs;
+    programs.insert(fs::path("dir/program1"));
+    programs.insert(fs::path("program2"));
+
+    std::set< engine::test_filter > exp_filters;
+    exp_filters.insert(engine::test_filter(fs::path("dir/program1"), ""));
+    exp_filters.insert(engine::test_filter(fs::path("program2"), ""));
+    ATF_REQUIRE(exp_filters == cli::detail::affected_filters(
+                    std::set< engine::test_filter >(), programs));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(affected_filters__user_filters);
+ATF_TEST_CASE_BODY(affected_filters__user_filters)
+{
+    std::set< engine::test_filter > user_filters;
+    user_filters.insert(engine::test_filter(fs::path("dir"), ""));
+    user_filters.insert(engine::test_filter(fs::path("program2"), "case1"));
+    user_filters.insert(engine::test_filter(fs::path("program2"), "case2"));
+    user_filters.insert(engine::test_filter(fs::path("program3"), ""));
+
+    std::set< fs::path > programs;
+    programs.insert(fs::path("dir/program1"));
+    programs.insert(fs::path("program2"));
+    programs.insert(fs::path("program4"));
+
+    std::set< engine::test_filter > exp_filters;
+    exp_filters.insert(engine::test_filter(fs::path("dir/program1"), ""));
+    exp_filters.insert(engine::test_filter(fs::path("program2"), "case1"));
+    exp_filters.insert(engine::test_filter(fs::path("program2"), "case2"));
+    ATF_REQUIRE(exp_filters == cli::detail::affected_filters(user_filters,
+                                                             programs));
+}
+
+
 ATF_INIT_TEST_CASES(tcs)
 {
     ATF_ADD_TEST_CASE(tcs, invalid_filter);
+    ATF_ADD_TEST_CASE(tcs, dependency_manifest_without_changed_files);
+    ATF_ADD_TEST_CASE(tcs, invalid_report);
+
+    ATF_ADD_TEST_CASE(tcs, ordered_hooks__in_order);
+    ATF_ADD_TEST_CASE(tcs, ordered_hooks__out_of_order);
+    ATF_ADD_TEST_CASE(tcs, ordered_hooks__unannounced);
+    ATF_ADD_TEST_CASE(tcs, ordered_hooks__over_capacity);
+
+    ATF_ADD_TEST_CASE(tcs, change_watcher__no_changes);
+    ATF_ADD_TEST_CASE(tcs, change_watcher__modified);
+    ATF_ADD_TEST_CASE(tcs, change_watcher__modified__same_second);
+    ATF_ADD_TEST_CASE(tcs, change_watcher__appear_and_disappear);
+    ATF_ADD_TEST_CASE(tcs, change_watcher__update);
+
+    ATF_ADD_TEST_CASE(tcs, affected_filters__no_user_filters);
+    ATF_ADD_TEST_CASE(tcs, affected_filters__user_filters);
 }
@@ -33,14 +33,17 @@
 #include <iostream>
 #include <stdexcept>
 
+#include "engine/config.hpp"
 #include "engine/filters.hpp"
 #include "model/test_program.hpp"
 #include "model/test_result.hpp"
 #include "store/layout.hpp"
+#include "store/trends.hpp"
 #include "utils/cmdline/exceptions.hpp"
 #include "utils/cmdline/options.hpp"
 #include "utils/cmdline/parser.ipp"
 #include "utils/cmdline/ui.hpp"
+#include "utils/config/tree.ipp"
 #include "utils/datetime.hpp"
 #include "utils/env.hpp"
 #include "utils/format/macros.hpp"
@@ -48,6 +51,7 @@
 #include "utils/fs/exceptions.hpp"
 #include "utils/fs/operations.hpp"
 #include "utils/fs/path.hpp"
+#include "utils/load.hpp"
 #include "utils/optional.ipp"
 #include "utils/sanity.hpp"
 
@@ -56,6 +60,7 @@
 #endif
 
 namespace cmdline = utils::cmdline;
+namespace config = utils::config;
 namespace datetime = utils::datetime;
 namespace fs = utils::fs;
 namespace layout = store::layout;
@@ -79,12 +84,24 @@ const cmdline::path_option cli::kyuafile_option(
     "file", "Kyuafile");
 
 
+/// Standard definition of the option to select test cases by their metadata.
+const cmdline::string_option cli::metadata_filter_option(
+    "metadata-filter", "Only process the test cases whose metadata satisfies "
+    "the given condition; can be repeated", "property<op>value");
+
+
 /// Standard definition of the option to specify filters on test results.
 const cmdline::list_option cli::results_filter_option(
     "results-filter", "Comma-separated list of result types to include in "
     "the report", "types", "skipped,xfail,broken,failed");
 
 
+/// Standard definition of the option to select a shard of the test cases.
+const cmdline::string_option cli::shard_option(
+    "shard", "Only process the test cases of the given shard, in a split of "
+    "the test suite into count deterministic parts", "index/count");
+
+
 /// Standard definition of the option to specify the results file.
 ///
 /// TODO(jmmv): Should support a git-like syntax to go back in time, like
@@ -286,6 +303,81 @@ cli::get_result_types(const utils::cmdline::parsed_cmdline& cmdline)
 }
 
 
+/// Gets the shard of the test cases to process.
+///
+/// \param cmdline The parsed command line.
+///
+/// \return The shard, if specified; none otherwise.
+///
+/// \throw cmdline::option_argument_value_error If the shard is invalid.
+optional< engine::test_shard >
+cli::get_shard(const cmdline::parsed_cmdline& cmdline)
+{
+    if (!cmdline.has_option(shard_option.long_name()))
+        return none;
+
+    const std::string& value = cmdline.get_option< cmdline::string_option >(
+        shard_option.long_name());
+    try {
+        return utils::make_optional(engine::test_shard::parse(value));
+    } catch (const std::runtime_error& e) {
+        throw cmdline::option_argument_value_error(
+            F("--%s") % shard_option.long_name(), value, e.what());
+    }
+}
+
+
+/// Gets the predicates on the metadata of the test cases to process.
+///
+/// \param cmdline The parsed command line.
+///
+/// \return The metadata filters in the order in which they were given.
+///
+/// \throw cmdline::option_argument_value_error If any filter is invalid.
+std::vector< engine::metadata_filter >
+cli::get_metadata_filters(const cmdline::parsed_cmdline& cmdline)
+{
+    std::vector< engine::metadata_filter > filters;
+    if (!cmdline.has_option(metadata_filter_option.long_name()))
+        return filters;
+
+    const std::vector< std::string > values =
+        cmdline.get_multi_option< cmdline::string_option >(
+            metadata_filter_option.long_name());
+    for (std::vector< std::string >::const_iterator iter = values.begin();
+         iter != values.end(); ++iter) {
+        try {
+            filters.push_back(engine::metadata_filter::parse(*iter));
+        } catch (const std::runtime_error& e) {
+            throw cmdline::option_argument_value_error(
+                F("--%s") % metadata_filter_option.long_name(), *iter,
+                e.what());
+        }
+    }
+    return filters;
+}
+
+
+/// Computes the number of subprocesses to split background work across.
+///
+/// \param user_config The runtime configuration of the program.
+///
+/// \return The configured parallelism or, if automatic, its upper bound.
+std::size_t
+cli::subprocess_parallelism(const config::tree& user_config)
+{
+    const std::size_t parallelism =
+        user_config.lookup< engine::parallelism_node >("parallelism");
+    if (parallelism > 0)
+        return parallelism;
+    else if (user_config.is_set("parallelism_max"))
+        return user_config.lookup< config::positive_int_node >(
+            "parallelism_max");
+    else
+        return utils::usable_cpus();
+}
+
+
 /// Parses a set of command-line arguments to construct test filters.
 ///
 /// \param args The command-line arguments representing test filters.
@@ -375,6 +467,9 @@ cli::format_result(const model::test_result& result)
 
 /// Formats the identifier of a test case for user presentation.
 ///
+/// Test programs that run as one of several Kyuafile-defined variants carry
+/// the name of the variant in brackets after their path.
+///
 /// \param test_program The test program containing the test case.
 /// \param test_case_name The name of the test case.
 ///
@@ -383,7 +478,11 @@ std::string
 cli::format_test_case_id(const model::test_program& test_program,
                          const std::string& test_case_name)
 {
-    return F("%s:%s") % test_program.relative_path() % test_case_name;
+    if (test_program.variant().empty())
+        return F("%s:%s") % test_program.relative_path() % test_case_name;
+    else
+        return F("%s[%s]:%s") % test_program.relative_path() %
+            test_program.variant() % test_case_name;
 }
 
 
@@ -399,6 +498,41 @@ cli::format_test_case_id(const engine::test_filter& test_filter)
 }
 
 
+/// Formats the identifier of the test case of a trend.
+///
+/// \param trend The trend to format.
+///
+/// \return A string representing the test case uniquely within a test suite.
+std::string
+cli::format_test_case_id(const store::case_trend& trend)
+{
+    if (trend.variant.empty())
+        return F("%s:%s") % trend.test_program % trend.test_case;
+    else
+        return F("%s[%s]:%s") % trend.test_program % trend.variant %
+            trend.test_case;
+}
+
+
+/// Formats the durations of a test case across runs for user presentation.
+///
+/// \param trend The trend to format.
+///
+/// \return A single line with the latest duration of the test case followed by
+/// the statistics of its previous durations.
+std::string
+cli::format_trend(const store::case_trend& trend)
+{
+    return F("%s  ->  %s  [previous mean: %s, p50: %s, p95: %s, stddev: %s; "
+             "failed in %s of %s runs]") %
+        format_test_case_id(trend) % format_delta(trend.latest_duration) %
+        format_delta(trend.mean_duration) %
+        format_delta(trend.median_duration) %
+        format_delta(trend.p95_duration) %
+        format_delta(trend.stddev_duration) % trend.failures % trend.runs;
+}
+
+
 /// Prints the version header information to the interface output.
 ///
 /// \param ui Interface to which to write the version details.
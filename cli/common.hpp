@@ -32,6 +32,7 @@
 #if !defined(CLI_COMMON_HPP)
 #define CLI_COMMON_HPP
 
+#include <cstddef>
 #include <memory>
 #include <set>
 #include <vector>
@@ -39,6 +40,7 @@
 #include "engine/filters_fwd.hpp"
 #include "model/test_program_fwd.hpp"
 #include "model/test_result.hpp"
+#include "store/trends_fwd.hpp"
 #include "utils/cmdline/base_command.hpp"
 #include "utils/cmdline/options_fwd.hpp"
 #include "utils/cmdline/parser_fwd.hpp"
@@ -53,9 +55,11 @@ namespace cli {
 
 extern const utils::cmdline::path_option build_root_option;
 extern const utils::cmdline::path_option kyuafile_option;
+extern const utils::cmdline::string_option metadata_filter_option;
 extern const utils::cmdline::string_option results_file_create_option;
 extern const utils::cmdline::string_option results_file_open_option;
 extern const utils::cmdline::list_option results_filter_option;
+extern const utils::cmdline::string_option shard_option;
 extern const utils::cmdline::property_option variable_option;
 
 
@@ -84,6 +88,11 @@ utils::fs::path kyuafile_path(const utils::cmdline::parsed_cmdline&);
 std::string results_file_create(const utils::cmdline::parsed_cmdline&);
 std::string results_file_open(const utils::cmdline::parsed_cmdline&);
 result_types get_result_types(const utils::cmdline::parsed_cmdline&);
+utils::optional< engine::test_shard > get_shard(
+    const utils::cmdline::parsed_cmdline&);
+std::vector< engine::metadata_filter > get_metadata_filters(
+    const utils::cmdline::parsed_cmdline&);
+std::size_t subprocess_parallelism(const utils::config::tree&);
 
 std::set< engine::test_filter > parse_filters(
     const utils::cmdline::args_vector&);
@@ -94,6 +103,8 @@ std::string format_delta(const utils::datetime::delta&);
 std::string format_result(const model::test_result&);
 std::string format_test_case_id(const model::test_program&, const std::string&);
 std::string format_test_case_id(const engine::test_filter&);
+std::string format_test_case_id(const store::case_trend&);
+std::string format_trend(const store::case_trend&);
 
 
 void write_version_header(utils::cmdline::ui*);
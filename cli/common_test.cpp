@@ -32,6 +32,7 @@
 
 #include <atf-c++.hpp>
 
+#include "engine/config.hpp"
 #include "engine/exceptions.hpp"
 #include "engine/filters.hpp"
 #include "model/metadata.hpp"
@@ -43,6 +44,7 @@
 #include "utils/cmdline/options.hpp"
 #include "utils/cmdline/parser.ipp"
 #include "utils/cmdline/ui_mock.hpp"
+#include "utils/config/tree.ipp"
 #include "utils/datetime.hpp"
 #include "utils/env.hpp"
 #include "utils/format/macros.hpp"
@@ -197,6 +199,103 @@ ATF_TEST_CASE_BODY(result_types__explicit__invalid)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(get_shard__default);
+ATF_TEST_CASE_BODY(get_shard__default)
+{
+    std::map< std::string, std::vector< std::string > > options;
+    const cmdline::parsed_cmdline mock_cmdline(options, cmdline::args_vector());
+
+    ATF_REQUIRE(!cli::get_shard(mock_cmdline));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(get_shard__explicit);
+ATF_TEST_CASE_BODY(get_shard__explicit)
+{
+    std::map< std::string, std::vector< std::string > > options;
+    options["shard"].push_back("2/5");
+    const cmdline::parsed_cmdline mock_cmdline(options, cmdline::args_vector());
+
+    ATF_REQUIRE(cli::get_shard(mock_cmdline));
+    ATF_REQUIRE_EQ(engine::test_shard(2, 5),
+                   cli::get_shard(mock_cmdline).get());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(get_shard__invalid);
+ATF_TEST_CASE_BODY(get_shard__invalid)
+{
+    std::map< std::string, std::vector< std::string > > options;
+    options["shard"].push_back("6/5");
+    const cmdline::parsed_cmdline mock_cmdline(options, cmdline::args_vector());
+
+    ATF_REQUIRE_THROW_RE(cmdline::option_argument_value_error,
+                         "--shard.*6/5.*between",
+                         cli::get_shard(mock_cmdline));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(get_metadata_filters__default);
+ATF_TEST_CASE_BODY(get_metadata_filters__default)
+{
+    std::map< std::string, std::vector< std::string > > options;
+    const cmdline::parsed_cmdline mock_cmdline(options, cmdline::args_vector());
+
+    ATF_REQUIRE(cli::get_metadata_filters(mock_cmdline).empty());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(get_metadata_filters__explicit);
+ATF_TEST_CASE_BODY(get_metadata_filters__explicit)
+{
+    std::map< std::string, std::vector< std::string > > options;
+    options["metadata-filter"].push_back("timeout<60");
+    options["metadata-filter"].push_back("custom.tier=smoke");
+    const cmdline::parsed_cmdline mock_cmdline(options, cmdline::args_vector());
+
+    std::vector< engine::metadata_filter > exp_filters;
+    exp_filters.push_back(engine::metadata_filter(
+        "timeout", engine::metadata_filter::less, "60"));
+    exp_filters.push_back(engine::metadata_filter(
+        "custom.tier", engine::metadata_filter::equal, "smoke"));
+    ATF_REQUIRE(exp_filters == cli::get_metadata_filters(mock_cmdline));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(get_metadata_filters__invalid);
+ATF_TEST_CASE_BODY(get_metadata_filters__invalid)
+{
+    std::map< std::string, std::vector< std::string > > options;
+    options["metadata-filter"].push_back("timeout<abc");
+    const cmdline::parsed_cmdline mock_cmdline(options, cmdline::args_vector());
+
+    ATF_REQUIRE_THROW_RE(cmdline::option_argument_value_error,
+                         "--metadata-filter.*timeout<abc",
+                         cli::get_metadata_filters(mock_cmdline));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(subprocess_parallelism__explicit);
+ATF_TEST_CASE_BODY(subprocess_parallelism__explicit)
+{
+    config::tree user_config = engine::default_config();
+    ATF_REQUIRE_EQ(1, cli::subprocess_parallelism(user_config));
+    user_config.set< engine::parallelism_node >("parallelism", 3);
+    ATF_REQUIRE_EQ(3, cli::subprocess_parallelism(user_config));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(subprocess_parallelism__automatic);
+ATF_TEST_CASE_BODY(subprocess_parallelism__automatic)
+{
+    config::tree user_config = engine::default_config();
+    user_config.set< engine::parallelism_node >("parallelism", 0);
+    ATF_REQUIRE(cli::subprocess_parallelism(user_config) >= 1);
+    user_config.set< config::positive_int_node >("parallelism_max", 5);
+    ATF_REQUIRE_EQ(5, cli::subprocess_parallelism(user_config));
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(results_file_create__default__new);
 ATF_TEST_CASE_BODY(results_file_create__default__new)
 {
@@ -421,6 +520,22 @@ ATF_TEST_CASE_BODY(format_test_case_id__test_case)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(format_test_case_id__variant);
+ATF_TEST_CASE_BODY(format_test_case_id__variant)
+{
+    config::properties_map vars;
+    vars["mode"] = "fast";
+    const model::test_program test_program = model::test_program_builder(
+        "mock", fs::path("foo/bar/baz"), fs::path("unused-root"),
+        "unused-suite-name")
+        .add_test_case("abc")
+        .set_variant("fast", vars)
+        .build();
+    ATF_REQUIRE_EQ("foo/bar/baz[fast]:abc",
+                   cli::format_test_case_id(test_program, "abc"));
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(format_test_case_id__test_filter);
 ATF_TEST_CASE_BODY(format_test_case_id__test_filter)
 {
@@ -454,6 +569,17 @@ ATF_INIT_TEST_CASES(tcs)
     ATF_ADD_TEST_CASE(tcs, result_types__explicit__some);
     ATF_ADD_TEST_CASE(tcs, result_types__explicit__invalid);
 
+    ATF_ADD_TEST_CASE(tcs, get_shard__default);
+    ATF_ADD_TEST_CASE(tcs, get_shard__explicit);
+    ATF_ADD_TEST_CASE(tcs, get_shard__invalid);
+
+    ATF_ADD_TEST_CASE(tcs, get_metadata_filters__default);
+    ATF_ADD_TEST_CASE(tcs, get_metadata_filters__explicit);
+    ATF_ADD_TEST_CASE(tcs, get_metadata_filters__invalid);
+
+    ATF_ADD_TEST_CASE(tcs, subprocess_parallelism__explicit);
+    ATF_ADD_TEST_CASE(tcs, subprocess_parallelism__automatic);
+
     ATF_ADD_TEST_CASE(tcs, results_file_create__default__new);
     ATF_ADD_TEST_CASE(tcs, results_file_create__default__historical);
     ATF_ADD_TEST_CASE(tcs, results_file_create__explicit);
@@ -476,6 +602,7 @@ ATF_INIT_TEST_CASES(tcs)
     ATF_ADD_TEST_CASE(tcs, format_result__with_reason);
 
     ATF_ADD_TEST_CASE(tcs, format_test_case_id__test_case);
+    ATF_ADD_TEST_CASE(tcs, format_test_case_id__variant);
     ATF_ADD_TEST_CASE(tcs, format_test_case_id__test_filter);
 
     ATF_ADD_TEST_CASE(tcs, write_version_header);
@@ -60,6 +60,13 @@ static const char* config_basename = "kyua.conf";
 static const char* none_config = "none";
 
 
+/// Command line of the last call to cli::load_config(), if any.
+///
+/// This lets cli::reload_config() locate the same configuration file and apply
+/// the same overrides again.
+static optional< cmdline::parsed_cmdline > last_cmdline;
+
+
 /// Textual description of the default configuration files.
 ///
 /// This is just an auxiliary string required to define the option below, which
@@ -209,6 +216,7 @@ config::tree
 cli::load_config(const cmdline::parsed_cmdline& cmdline,
                  const bool required)
 {
+    last_cmdline = cmdline;
     try {
         return load_required_config(cmdline);
     } catch (const engine::error& e) {
@@ -221,3 +229,22 @@ cli::load_config(const cmdline::parsed_cmdline& cmdline,
         }
     }
 }
+
+
+/// Loads the configuration file for this session again.
+///
+/// This honors the same command-line options as the last call to
+/// load_config(), so that long-running commands can pick up changes to the
+/// configuration file.
+///
+/// \return The loaded configuration file data.
+///
+/// \throw engine::error If the configuration was never loaded before or if the
+///     parsing of the configuration file fails.
+config::tree
+cli::reload_config(void)
+{
+    if (!last_cmdline)
+        throw engine::error("The configuration has not been loaded yet");
+    return load_required_config(last_cmdline.get());
+}
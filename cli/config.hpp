@@ -48,6 +48,7 @@ extern const utils::cmdline::property_option variable_option;
 
 utils::config::tree load_config(const utils::cmdline::parsed_cmdline&,
                                 const bool);
+utils::config::tree reload_config(void);
 
 
 }  // namespace cli
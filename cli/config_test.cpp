@@ -334,6 +334,55 @@ ATF_TEST_CASE_BODY(load_config__overrides__fail)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(reload_config__ok);
+ATF_TEST_CASE_BODY(reload_config__ok)
+{
+    atf::utils::create_file(
+        "config",
+        "syntax(2)\n"
+        "architecture = 'do not see me'\n"
+        "platform = 'first'\n");
+
+    std::map< std::string, std::vector< std::string > > options;
+    options["config"].push_back("config");
+    options["variable"].push_back("architecture=overriden");
+    {
+        const cmdline::parsed_cmdline mock_cmdline(options,
+                                                   cmdline::args_vector());
+        const config::tree user_config = cli::load_config(mock_cmdline, true);
+        ATF_REQUIRE_EQ("first",
+                       user_config.lookup< config::string_node >("platform"));
+    }
+
+    atf::utils::create_file(
+        "config",
+        "syntax(2)\n"
+        "architecture = 'do not see me'\n"
+        "platform = 'second'\n");
+
+    const config::tree user_config = cli::reload_config();
+    ATF_REQUIRE_EQ("overriden",
+                   user_config.lookup< config::string_node >("architecture"));
+    ATF_REQUIRE_EQ("second",
+                   user_config.lookup< config::string_node >("platform"));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(reload_config__fail);
+ATF_TEST_CASE_BODY(reload_config__fail)
+{
+    ATF_REQUIRE_THROW_RE(engine::error, "not been loaded",
+                         cli::reload_config());
+
+    std::map< std::string, std::vector< std::string > > options;
+    options["config"].push_back("none");
+    const cmdline::parsed_cmdline mock_cmdline(options, cmdline::args_vector());
+    require_eq(engine::default_config(),
+               cli::load_config(mock_cmdline, true));
+    require_eq(engine::default_config(), cli::reload_config());
+}
+
+
 ATF_INIT_TEST_CASES(tcs)
 {
     ATF_ADD_TEST_CASE(tcs, load_config__none);
@@ -348,4 +397,7 @@ ATF_INIT_TEST_CASES(tcs)
     ATF_ADD_TEST_CASE(tcs, load_config__overrides__no);
     ATF_ADD_TEST_CASE(tcs, load_config__overrides__yes);
     ATF_ADD_TEST_CASE(tcs, load_config__overrides__fail);
+
+    ATF_ADD_TEST_CASE(tcs, reload_config__ok);
+    ATF_ADD_TEST_CASE(tcs, reload_config__fail);
 }
@@ -37,26 +37,38 @@ extern "C" {
 #include <unistd.h>
 }
 
+#include <cstddef>
 #include <cstdlib>
+#include <fstream>
 #include <iostream>
+#include <memory>
 #include <string>
 #include <utility>
 
 #include "cli/cmd_about.hpp"
 #include "cli/cmd_config.hpp"
+#include "cli/cmd_db_compact.hpp"
 #include "cli/cmd_db_exec.hpp"
+#include "cli/cmd_db_merge.hpp"
 #include "cli/cmd_db_migrate.hpp"
+#include "cli/cmd_db_prune.hpp"
 #include "cli/cmd_debug.hpp"
 #include "cli/cmd_help.hpp"
 #include "cli/cmd_list.hpp"
 #include "cli/cmd_report.hpp"
 #include "cli/cmd_report_html.hpp"
+#include "cli/cmd_report_json.hpp"
 #include "cli/cmd_report_junit.hpp"
+#include "cli/cmd_report_summary.hpp"
+#include "cli/cmd_report_trace.hpp"
+#include "cli/cmd_report_trends.hpp"
+#include "cli/cmd_serve_results.hpp"
 #include "cli/cmd_test.hpp"
 #include "cli/common.ipp"
 #include "cli/config.hpp"
 #include "engine/atf.hpp"
 #include "engine/plain.hpp"
+#include "engine/server.hpp"
 #include "engine/scheduler.hpp"
 #include "engine/tap.hpp"
 #include "store/exceptions.hpp"
@@ -67,18 +79,22 @@ extern "C" {
 #include "utils/cmdline/parser.ipp"
 #include "utils/cmdline/ui.hpp"
 #include "utils/config/tree.ipp"
+#include "utils/datetime.hpp"
 #include "utils/env.hpp"
 #include "utils/format/macros.hpp"
 #include "utils/fs/operations.hpp"
 #include "utils/fs/path.hpp"
 #include "utils/logging/macros.hpp"
 #include "utils/logging/operations.hpp"
+#include "utils/noncopyable.hpp"
 #include "utils/optional.ipp"
+#include "utils/profiler.hpp"
 #include "utils/sanity.hpp"
 #include "utils/signals/exceptions.hpp"
 
 namespace cmdline = utils::cmdline;
 namespace config = utils::config;
+namespace datetime = utils::datetime;
 namespace fs = utils::fs;
 namespace logging = utils::logging;
 namespace signals = utils::signals;
@@ -91,6 +107,57 @@ using utils::optional;
 namespace {
 
 
+/// Amount of log data to buffer in memory before writing it to the log file.
+static const std::size_t log_buffer_size = 64 * 1024;
+
+
+/// CPU time between the samples taken by --profile.
+static const datetime::delta profile_interval =
+    datetime::delta::from_microseconds(5000);
+
+
+/// Profiles the program and writes the results when going out of scope.
+///
+/// The results are written from the destructor so that a profile is available
+/// even if the command fails or is interrupted.
+class profile_writer : utils::noncopyable {
+    /// The running profiler.
+    utils::profiler _profiler;
+
+    /// Path to the file into which to write the profile.
+    const fs::path _output;
+
+public:
+    /// Starts profiling the program.
+    ///
+    /// \param output Path to the file into which to write the profile.
+    ///
+    /// \throw std::runtime_error If the profiler cannot be started.
+    explicit profile_writer(const fs::path& output) :
+        _profiler(profile_interval), _output(output)
+    {
+    }
+
+    /// Stops the profiler and writes its results.
+    ///
+    /// Errors are logged but not reported otherwise because they must not
+    /// change the outcome of the command.
+    ~profile_writer(void)
+    {
+        _profiler.stop();
+        std::ofstream output(_output.c_str());
+        if (output)
+            _profiler.write_folded(output);
+        if (!output) {
+            LW(F("Failed to write profile to %s") % _output);
+            return;
+        }
+        LI(F("Wrote profile of %s samples to %s") % _profiler.samples() %
+           _output);
+    }
+};
+
+
 /// Registers all valid scheduler interfaces.
 ///
 /// This is part of Kyua's setup but it is a bit strange to find it here.  I am
@@ -105,6 +172,9 @@ register_scheduler_interfaces(void)
     scheduler::register_interface(
         "plain", std::shared_ptr< scheduler::interface >(
             new engine::plain_interface()));
+    scheduler::register_interface(
+        "server", std::shared_ptr< scheduler::interface >(
+            new engine::server_interface()));
     scheduler::register_interface(
         "tap", std::shared_ptr< scheduler::interface >(
             new engine::tap_interface()));
@@ -180,13 +250,20 @@ safe_main(cmdline::ui* ui, int argc, const char* const argv[],
         "logfile", "Path to the log file", "file",
         cli::detail::default_log_name().c_str());
     options.push_back(&logfile_option);
+    const cmdline::path_option profile_option(
+        "profile", "Path to the file into which to write a profile of the "
+        "CPU time of kyua itself, in the folded stacks format", "file");
+    options.push_back(&profile_option);
 
     cmdline::commands_map< cli::cli_command > commands;
 
     commands.insert(new cli::cmd_about());
     commands.insert(new cli::cmd_config());
+    commands.insert(new cli::cmd_db_compact());
     commands.insert(new cli::cmd_db_exec());
+    commands.insert(new cli::cmd_db_merge());
     commands.insert(new cli::cmd_db_migrate());
+    commands.insert(new cli::cmd_db_prune());
     commands.insert(new cli::cmd_help(&options, &commands));
 
     commands.insert(new cli::cmd_debug(), "Workspace");
@@ -195,7 +272,12 @@ safe_main(cmdline::ui* ui, int argc, const char* const argv[],
 
     commands.insert(new cli::cmd_report(), "Reporting");
     commands.insert(new cli::cmd_report_html(), "Reporting");
+    commands.insert(new cli::cmd_report_json(), "Reporting");
     commands.insert(new cli::cmd_report_junit(), "Reporting");
+    commands.insert(new cli::cmd_report_summary(), "Reporting");
+    commands.insert(new cli::cmd_report_trace(), "Reporting");
+    commands.insert(new cli::cmd_report_trends(), "Reporting");
+    commands.insert(new cli::cmd_serve_results(), "Reporting");
 
     if (mock_command.get() != NULL)
         commands.insert(mock_command);
@@ -209,11 +291,21 @@ safe_main(cmdline::ui* ui, int argc, const char* const argv[],
     utils::install_crash_handlers(logfile.str());
     try {
         logging::set_persistency(cmdline.get_option< cmdline::string_option >(
-            "loglevel"), logfile);
+            "loglevel"), logfile, log_buffer_size);
     } catch (const std::range_error& e) {
         throw cmdline::usage_error(e.what());
     }
 
+    std::auto_ptr< profile_writer > profile;
+    if (cmdline.has_option("profile")) {
+        try {
+            profile.reset(new profile_writer(
+                cmdline.get_option< cmdline::path_option >("profile")));
+        } catch (const std::runtime_error& e) {
+            throw cmdline::usage_error(F("Cannot profile: %s") % e.what());
+        }
+    }
+
     if (cmdline.arguments().empty())
         throw cmdline::usage_error("No command provided");
     const std::string cmdname = cmdline.arguments()[0];
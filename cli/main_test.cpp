@@ -51,6 +51,7 @@ extern "C" {
 #include "utils/logging/operations.hpp"
 #include "utils/process/child.ipp"
 #include "utils/process/status.hpp"
+#include "utils/profiler.hpp"
 #include "utils/test_utils.ipp"
 
 namespace cmdline = utils::cmdline;
@@ -378,6 +379,33 @@ ATF_TEST_CASE_BODY(main__loglevel__error)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(main__profile);
+ATF_TEST_CASE_BODY(main__profile)
+{
+    logging::set_inmemory();
+    cmdline::init("progname");
+
+    const int argc = 4;
+    const char* const argv[] = {"progname", "--logfile=test.log",
+                                "--profile=test.prof", "mock_write", NULL};
+
+    cmdline::ui_mock ui;
+    if (utils::profiler::supported) {
+        ATF_REQUIRE_EQ(EXIT_FAILURE,
+                       cli::main(&ui, argc, argv,
+                                 cli::cli_command_ptr(new cmd_mock_write())));
+        ATF_REQUIRE(fs::exists(fs::path("test.prof")));
+    } else {
+        ATF_REQUIRE_EQ(3,
+                       cli::main(&ui, argc, argv,
+                                 cli::cli_command_ptr(new cmd_mock_write())));
+        ATF_REQUIRE(atf::utils::grep_collection("Usage error.*not supported",
+                                                ui.err_log()));
+        ATF_REQUIRE(!fs::exists(fs::path("test.prof")));
+    }
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(main__subcommand__ok);
 ATF_TEST_CASE_BODY(main__subcommand__ok)
 {
@@ -494,6 +522,7 @@ ATF_INIT_TEST_CASES(tcs)
     ATF_ADD_TEST_CASE(tcs, main__loglevel__higher);
     ATF_ADD_TEST_CASE(tcs, main__loglevel__lower);
     ATF_ADD_TEST_CASE(tcs, main__loglevel__error);
+    ATF_ADD_TEST_CASE(tcs, main__profile);
     ATF_ADD_TEST_CASE(tcs, main__subcommand__ok);
     ATF_ADD_TEST_CASE(tcs, main__subcommand__invalid_args);
     ATF_ADD_TEST_CASE(tcs, main__subcommand__runtime_error);
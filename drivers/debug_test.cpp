@@ -28,9 +28,11 @@
 
 #include "drivers/debug_test.hpp"
 
+#include <map>
 #include <stdexcept>
 #include <utility>
 
+#include "engine/config.hpp"
 #include "engine/filters.hpp"
 #include "engine/kyuafile.hpp"
 #include "engine/scanner.hpp"
@@ -38,10 +40,13 @@
 #include "model/test_case.hpp"
 #include "model/test_program.hpp"
 #include "model/test_result.hpp"
+#include "utils/config/tree.ipp"
 #include "utils/defs.hpp"
 #include "utils/format/macros.hpp"
 #include "utils/fs/auto_cleaners.hpp"
+#include "utils/load.hpp"
 #include "utils/optional.ipp"
+#include "utils/sanity.hpp"
 
 namespace config = utils::config;
 namespace fs = utils::fs;
@@ -50,6 +55,75 @@ namespace scheduler = engine::scheduler;
 using utils::optional;
 
 
+namespace {
+
+
+/// Locates the single test case matched by a filter.
+///
+/// \param kyuafile The loaded Kyuafile.
+/// \param filter The test case filter to locate the test to debug.
+///
+/// \return The test program and the name of the matched test case.
+///
+/// \throw std::runtime_error If the filter matches no test case or more than
+///     one test case.
+static engine::scan_result
+find_test_case(const engine::kyuafile& kyuafile,
+               const engine::test_filter& filter)
+{
+    std::set< engine::test_filter > filters;
+    filters.insert(filter);
+
+    engine::scanner scanner(kyuafile.test_programs(), filters);
+    optional< engine::scan_result > match;
+    while (!match && !scanner.done()) {
+        match = scanner.yield();
+    }
+    if (!match) {
+        throw std::runtime_error(F("Unknown test case '%s'") % filter.str());
+    } else if (!scanner.done()) {
+        throw std::runtime_error(F("The filter '%s' matches more than one test "
+                                 "case") % filter.str());
+    }
+    INV(match && scanner.done());
+    return match.get();
+}
+
+
+/// Computes the number of iterations to run concurrently.
+///
+/// \param user_config The end-user configuration properties.
+/// \param parallel Whether to run the iterations in parallel or not.
+///
+/// \return The configured parallelism if parallel is true, or the upper bound
+/// of the automatic parallelism if it is not fixed; 1 otherwise.
+static std::size_t
+compute_slots(const config::tree& user_config, const bool parallel)
+{
+    if (!parallel)
+        return 1;
+
+    const std::size_t parallelism =
+        user_config.lookup< engine::parallelism_node >("parallelism");
+    if (parallelism > 0)
+        return parallelism;
+    else if (user_config.is_set("parallelism_max"))
+        return user_config.lookup< config::positive_int_node >(
+            "parallelism_max");
+    else
+        return utils::usable_cpus();
+}
+
+
+}  // anonymous namespace
+
+
+/// Pure abstract destructor.
+drivers::debug_test::repeat_hooks::~repeat_hooks(void)
+{
+}
+
+
 /// Executes the operation.
 ///
 /// \param kyuafile_path The path to the Kyuafile to be loaded.
@@ -74,23 +148,9 @@ drivers::debug_test::drive(const fs::path& kyuafile_path,
 
     const engine::kyuafile kyuafile = engine::kyuafile::load(
         kyuafile_path, build_root, user_config, handle);
-    std::set< engine::test_filter > filters;
-    filters.insert(filter);
-
-    engine::scanner scanner(kyuafile.test_programs(), filters);
-    optional< engine::scan_result > match;
-    while (!match && !scanner.done()) {
-        match = scanner.yield();
-    }
-    if (!match) {
-        throw std::runtime_error(F("Unknown test case '%s'") % filter.str());
-    } else if (!scanner.done()) {
-        throw std::runtime_error(F("The filter '%s' matches more than one test "
-                                 "case") % filter.str());
-    }
-    INV(match && scanner.done());
-    const model::test_program_ptr test_program = match.get().first;
-    const std::string& test_case_name = match.get().second;
+    const engine::scan_result match = find_test_case(kyuafile, filter);
+    const model::test_program_ptr test_program = match.first;
+    const std::string& test_case_name = match.second;
 
     scheduler::result_handle_ptr result_handle = handle.debug_test(
         test_program, test_case_name, user_config,
@@ -107,3 +167,83 @@ drivers::debug_test::drive(const fs::path& kyuafile_path,
     return result(engine::test_filter(
         test_program->relative_path(), test_case_name), test_result);
 }
+
+
+/// Executes a test case repeatedly.
+///
+/// Every iteration runs in its own scheduler slot, just like the test cases
+/// run by the run_tests driver, so that flaky tests can be exercised under
+/// the same conditions in which they fail.
+///
+/// \param kyuafile_path The path to the Kyuafile to be loaded.
+/// \param build_root If not none, path to the built test programs.
+/// \param filter The test case filter to locate the test to debug.
+/// \param user_config The end-user configuration properties.
+/// \param iterations Number of times to run the test case.
+/// \param parallel Whether to run the iterations concurrently according to
+///     the configured parallelism or one after the other.
+/// \param hooks Hooks to report the result of every iteration.
+///
+/// \returns A structure with all results computed by this driver.
+drivers::debug_test::repeat_result
+drivers::debug_test::drive_repeated(const fs::path& kyuafile_path,
+                                    const optional< fs::path > build_root,
+                                    const engine::test_filter& filter,
+                                    const config::tree& user_config,
+                                    const std::size_t iterations,
+                                    const bool parallel,
+                                    repeat_hooks& hooks)
+{
+    PRE(iterations > 0);
+
+    scheduler::scheduler_handle handle = scheduler::setup();
+
+    const engine::kyuafile kyuafile = engine::kyuafile::load(
+        kyuafile_path, build_root, user_config, handle);
+    const engine::scan_result match = find_test_case(kyuafile, filter);
+    const model::test_program_ptr test_program = match.first;
+    const std::string& test_case_name = match.second;
+
+    const std::size_t slots = compute_slots(user_config, parallel);
+
+    std::map< scheduler::exec_handle, std::size_t > in_flight;
+    std::size_t next = 0;
+    std::size_t passed = 0;
+    std::size_t failed = 0;
+    while (next < iterations || !in_flight.empty()) {
+        while (next < iterations && in_flight.size() < slots) {
+            const scheduler::exec_handle exec_handle = handle.spawn_test(
+                test_program, test_case_name, user_config);
+            in_flight.insert(std::make_pair(exec_handle, next));
+            ++next;
+        }
+
+        handle.check_interrupt();
+        scheduler::result_handle_ptr result_handle = handle.wait_any();
+        const std::map< scheduler::exec_handle, std::size_t >::iterator iter =
+            in_flight.find(result_handle->original_pid());
+        INV(iter != in_flight.end());
+        const std::size_t iteration = (*iter).second;
+        in_flight.erase(iter);
+
+        const scheduler::test_result_handle* test_result_handle =
+            dynamic_cast< const scheduler::test_result_handle* >(
+                result_handle.get());
+        const model::test_result& test_result =
+            test_result_handle->test_result();
+        if (test_result.good())
+            ++passed;
+        else
+            ++failed;
+        hooks.got_result(iteration, test_result,
+                         result_handle->stdout_file(),
+                         result_handle->stderr_file());
+        result_handle->cleanup();
+    }
+
+    handle.check_interrupt();
+    handle.cleanup();
+
+    return repeat_result(engine::test_filter(
+        test_program->relative_path(), test_case_name), passed, failed);
+}
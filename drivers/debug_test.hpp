@@ -36,6 +36,8 @@
 #if !defined(DRIVERS_DEBUG_TEST_HPP)
 #define DRIVERS_DEBUG_TEST_HPP
 
+#include <cstddef>
+
 #include "engine/filters.hpp"
 #include "model/test_result.hpp"
 #include "utils/config/tree_fwd.hpp"
@@ -68,9 +70,62 @@ public:
 };
 
 
+/// Tuple containing the results of a repeated execution of a test case.
+class repeat_result {
+public:
+    /// A filter matching the executed test case only.
+    engine::test_filter test_case;
+
+    /// Number of iterations that yielded a good result.
+    std::size_t passed;
+
+    /// Number of iterations that yielded a bad result.
+    std::size_t failed;
+
+    /// Initializer for the tuple's fields.
+    ///
+    /// \param test_case_ The matched test case.
+    /// \param passed_ Number of iterations that yielded a good result.
+    /// \param failed_ Number of iterations that yielded a bad result.
+    repeat_result(const engine::test_filter& test_case_,
+                  const std::size_t passed_, const std::size_t failed_) :
+        test_case(test_case_),
+        passed(passed_),
+        failed(failed_)
+    {
+    }
+};
+
+
+/// Abstract definition of the hooks for a repeated execution.
+class repeat_hooks {
+public:
+    virtual ~repeat_hooks(void) = 0;
+
+    /// Called when an iteration of the test case completes.
+    ///
+    /// The files holding the output of the iteration are only valid for the
+    /// duration of this call.
+    ///
+    /// \param iteration Zero-based number of the iteration.
+    /// \param test_result The result of the iteration.
+    /// \param stdout_file File holding the stdout of the iteration.
+    /// \param stderr_file File holding the stderr of the iteration.
+    virtual void got_result(const std::size_t iteration,
+                            const model::test_result& test_result,
+                            const utils::fs::path& stdout_file,
+                            const utils::fs::path& stderr_file) = 0;
+};
+
+
 result drive(const utils::fs::path&, const utils::optional< utils::fs::path >,
              const engine::test_filter&, const utils::config::tree&,
              const utils::fs::path&, const utils::fs::path&);
+repeat_result drive_repeated(const utils::fs::path&,
+                             const utils::optional< utils::fs::path >,
+                             const engine::test_filter&,
+                             const utils::config::tree&, const std::size_t,
+                             const bool, repeat_hooks&);
 
 
 }  // namespace debug_test
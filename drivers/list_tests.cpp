@@ -28,57 +28,245 @@
 
 #include "drivers/list_tests.hpp"
 
+#include <algorithm>
+#include <iterator>
+
+#include "engine/config.hpp"
 #include "engine/exceptions.hpp"
 #include "engine/filters.hpp"
 #include "engine/kyuafile.hpp"
+#include "engine/kyuafile_cache.hpp"
+#include "engine/list_cache.hpp"
 #include "engine/scanner.hpp"
 #include "engine/scheduler.hpp"
+#include "model/test_case.hpp"
 #include "model/test_program.hpp"
+#include "store/layout.hpp"
+#include "utils/config/tree.ipp"
+#include "utils/load.hpp"
 #include "utils/optional.ipp"
 
 namespace config = utils::config;
 namespace fs = utils::fs;
 namespace scheduler = engine::scheduler;
 
+using utils::none;
 using utils::optional;
 
 
+namespace {
+
+
+/// Computes the number of test programs to list concurrently.
+///
+/// \param user_config The end-user configuration properties.
+///
+/// \return The configured parallelism or, if automatic, its upper bound.
+static std::size_t
+listing_parallelism(const config::tree& user_config)
+{
+    const std::size_t parallelism =
+        user_config.lookup< engine::parallelism_node >("parallelism");
+    if (parallelism > 0)
+        return parallelism;
+    else if (user_config.is_set("parallelism_max"))
+        return user_config.lookup< config::positive_int_node >(
+            "parallelism_max");
+    else
+        return utils::usable_cpus();
+}
+
+
+/// Reports the test cases of the test programs as their listings complete.
+class streaming_hooks : public scheduler::list_hooks {
+    /// The test programs being listed.
+    const model::test_programs_vector& _test_programs;
+
+    /// The test case filters as provided by the user.
+    const std::set< engine::test_filter >& _filters;
+
+    /// Subset of the test cases to report, if any.
+    const optional< engine::test_shard >& _shard;
+
+    /// Predicates that the metadata of the reported test cases must satisfy.
+    const std::vector< engine::metadata_filter >& _metadata_filters;
+
+    /// Whether to report test programs as soon as they are listed.
+    ///
+    /// If false, the test programs are reported in their input order, each
+    /// of them as soon as it and all the ones before it have been listed.
+    const bool _completion_order;
+
+    /// The hooks to which to report the test cases.
+    drivers::list_tests::base_hooks& _hooks;
+
+    /// Whether each test program has been listed already.
+    std::vector< bool > _listed;
+
+    /// Position of the next test program to report in input order.
+    std::size_t _next;
+
+    /// Filters that did not match any of the test cases reported so far.
+    std::set< engine::test_filter > _unused_filters;
+
+    /// Reports the test cases of a test program.
+    ///
+    /// \param index Position of the test program to report.
+    void
+    report(const std::size_t index)
+    {
+        model::test_programs_vector one;
+        one.push_back(_test_programs[index]);
+        engine::scanner scanner(one, _filters, engine::durations_map(),
+                                _shard, none, _metadata_filters);
+        while (!scanner.done()) {
+            const optional< engine::scan_result > result = scanner.yield();
+            INV(result);
+            _hooks.got_test_case(*result.get().first, result.get().second);
+        }
+
+        // A filter is unused only if no test program used it.
+        const std::set< engine::test_filter > unused =
+            scanner.unused_filters();
+        std::set< engine::test_filter > still_unused;
+        std::set_intersection(
+            _unused_filters.begin(), _unused_filters.end(),
+            unused.begin(), unused.end(),
+            std::inserter(still_unused, still_unused.begin()));
+        _unused_filters.swap(still_unused);
+    }
+
+public:
+    /// Constructor.
+    ///
+    /// \param test_programs_ The test programs being listed.
+    /// \param filters_ The test case filters as provided by the user.
+    /// \param shard_ Subset of the test cases to report, if any.
+    /// \param metadata_filters_ Predicates that the metadata of the reported
+    ///     test cases must satisfy.
+    /// \param completion_order_ Whether to report the test programs in the
+    ///     order in which their listings complete.
+    /// \param hooks_ The hooks to which to report the test cases.
+    streaming_hooks(
+        const model::test_programs_vector& test_programs_,
+        const std::set< engine::test_filter >& filters_,
+        const optional< engine::test_shard >& shard_,
+        const std::vector< engine::metadata_filter >& metadata_filters_,
+        const bool completion_order_,
+        drivers::list_tests::base_hooks& hooks_) :
+        _test_programs(test_programs_), _filters(filters_), _shard(shard_),
+        _metadata_filters(metadata_filters_),
+        _completion_order(completion_order_), _hooks(hooks_),
+        _listed(test_programs_.size(), false), _next(0),
+        _unused_filters(filters_)
+    {
+    }
+
+    /// Reports the test cases of a test program once it is listed.
+    ///
+    /// \param index Position of the listed test program.
+    void
+    got_test_cases(const std::size_t index)
+    {
+        if (_completion_order) {
+            report(index);
+        } else {
+            _listed[index] = true;
+            while (_next < _listed.size() && _listed[_next])
+                report(_next++);
+        }
+    }
+
+    /// Gets the filters that did not match any reported test case.
+    ///
+    /// \return A collection of filters.
+    const std::set< engine::test_filter >&
+    unused_filters(void) const
+    {
+        return _unused_filters;
+    }
+};
+
+
+}  // anonymous namespace
+
+
 /// Pure abstract destructor.
 drivers::list_tests::base_hooks::~base_hooks(void)
 {
 }
 
 
+/// Called once all test programs are listed with the statistics of each.
+///
+/// The default implementation ignores the statistics.
+void
+drivers::list_tests::base_hooks::got_listing(
+    const model::test_program& /* test_program */,
+    const scheduler::listing_stats& /* stats */)
+{
+}
+
+
 /// Executes the operation.
 ///
 /// \param kyuafile_path The path to the Kyuafile to be loaded.
 /// \param build_root If not none, path to the built test programs.
 /// \param filters The test case filters as provided by the user.
+/// \param shard If not none, subset of the test cases to list.
+/// \param metadata_filters Predicates that the metadata of the listed test
+///     cases must satisfy.
 /// \param user_config The end-user configuration properties.
+/// \param completion_order Whether to report the test programs as soon as
+///     they are listed instead of in the order of the Kyuafile.
 /// \param hooks The hooks for this execution.
+/// \param profile_kyuafiles Whether to measure the cost of the evaluation of
+///     every Kyuafile, which bypasses the Kyuafile cache.
 ///
 /// \returns A structure with all results computed by this driver.
 drivers::list_tests::result
 drivers::list_tests::drive(const fs::path& kyuafile_path,
                            const optional< fs::path > build_root,
                            const std::set< engine::test_filter >& filters,
+                           const optional< engine::test_shard >& shard,
+                           const std::vector< engine::metadata_filter >&
+                               metadata_filters,
                            const config::tree& user_config,
-                           base_hooks& hooks)
+                           const bool completion_order,
+                           base_hooks& hooks,
+                           const bool profile_kyuafiles)
 {
     scheduler::scheduler_handle handle = scheduler::setup();
+    handle.set_list_cache(engine::list_cache(
+        store::layout::query_list_cache_dir()));
 
+    engine::kyuafile_profile kyuafile_profile;
     const engine::kyuafile kyuafile = engine::kyuafile::load(
-        kyuafile_path, build_root, user_config, handle);
-
-    engine::scanner scanner(kyuafile.test_programs(), filters);
+        kyuafile_path, build_root, user_config, handle,
+        engine::kyuafile_cache(store::layout::query_kyuafile_cache_dir()),
+        profile_kyuafiles ? &kyuafile_profile : NULL);
 
-    while (!scanner.done()) {
-        const optional< engine::scan_result > result = scanner.yield();
-        INV(result);
-        hooks.got_test_case(*result.get().first, result.get().second);
+    // List the selected test programs concurrently and report the test cases
+    // of each of them as soon as possible instead of after all listings.
+    const engine::test_filters matcher(filters);
+    model::test_programs_vector to_list;
+    for (model::test_programs_vector::const_iterator
+             iter = kyuafile.test_programs().begin();
+         iter != kyuafile.test_programs().end(); ++iter) {
+        if (matcher.match_test_program((*iter)->relative_path()))
+            to_list.push_back(*iter);
     }
+    streaming_hooks streaming(to_list, filters, shard, metadata_filters,
+                              completion_order, hooks);
+    std::vector< scheduler::listing_stats > stats;
+    (void)handle.list_tests_batch(to_list, user_config,
+                                  listing_parallelism(user_config),
+                                  &streaming, &stats);
+    for (std::vector< scheduler::listing_stats >::size_type i = 0;
+         i < stats.size(); ++i)
+        hooks.got_listing(*to_list[i], stats[i]);
 
     handle.cleanup();
 
-    return result(scanner.unused_filters());
+    return result(streaming.unused_filters(), kyuafile_profile);
 }
@@ -37,8 +37,11 @@
 
 #include <set>
 #include <string>
+#include <vector>
 
 #include "engine/filters_fwd.hpp"
+#include "engine/kyuafile.hpp"
+#include "engine/scheduler_fwd.hpp"
 #include "model/test_program_fwd.hpp"
 #include "utils/config/tree_fwd.hpp"
 #include "utils/fs/path_fwd.hpp"
@@ -59,6 +62,9 @@ public:
     /// \param test_case_name The name of the located test case.
     virtual void got_test_case(const model::test_program& test_program,
                                const std::string& test_case_name) = 0;
+
+    virtual void got_listing(const model::test_program&,
+                             const engine::scheduler::listing_stats&);
 };
 
 
@@ -71,11 +77,18 @@ public:
     /// test filter does not match any test case, it is probably a typo.
     std::set< engine::test_filter > unused_filters;
 
+    /// Costs of the evaluation of the Kyuafiles, if requested.
+    engine::kyuafile_profile kyuafile_profile;
+
     /// Initializer for the tuple's fields.
     ///
     /// \param unused_filters_ The filters that did not match any test case.
-    result(const std::set< engine::test_filter >& unused_filters_) :
-        unused_filters(unused_filters_)
+    /// \param kyuafile_profile_ The costs of the evaluation of the Kyuafiles.
+    result(const std::set< engine::test_filter >& unused_filters_,
+           const engine::kyuafile_profile& kyuafile_profile_ =
+               engine::kyuafile_profile()) :
+        unused_filters(unused_filters_),
+        kyuafile_profile(kyuafile_profile_)
     {
     }
 };
@@ -83,7 +96,10 @@ public:
 
 result drive(const utils::fs::path&, const utils::optional< utils::fs::path >,
              const std::set< engine::test_filter >&,
-             const utils::config::tree&, base_hooks&);
+             const utils::optional< engine::test_shard >&,
+             const std::vector< engine::metadata_filter >&,
+             const utils::config::tree&, const bool, base_hooks&,
+             const bool = false);
 
 
 }  // namespace list_tests
@@ -37,6 +37,7 @@ extern "C" {
 #include <map>
 #include <set>
 #include <string>
+#include <vector>
 
 #include <atf-c++.hpp>
 
@@ -53,6 +54,8 @@ extern "C" {
 #include "utils/config/tree.ipp"
 #include "utils/env.hpp"
 #include "utils/format/macros.hpp"
+#include "utils/fs/operations.hpp"
+#include "utils/fs/path.hpp"
 #include "utils/optional.ipp"
 #include "utils/test_utils.ipp"
 
@@ -89,6 +92,9 @@ public:
     /// Set of the listed test cases in a program:test_case form.
     std::map< std::string, model::metadata > metadatas;
 
+    /// Statistics of the listing of every test program, keyed by its path.
+    std::map< std::string, scheduler::listing_stats > listings;
+
     /// Called when a test case is identified in a test suite.
     ///
     /// \param test_program The test program containing the test case.
@@ -104,6 +110,18 @@ public:
         metadatas.insert(std::map< std::string, model::metadata >::value_type(
             ident, test_program.find(test_case_name).get_metadata()));
     }
+
+    /// Called with the statistics of the listing of a test program.
+    ///
+    /// \param test_program The listed test program.
+    /// \param stats The statistics of the listing.
+    virtual void
+    got_listing(const model::test_program& test_program,
+                const scheduler::listing_stats& stats)
+    {
+        listings.insert(std::map< std::string, scheduler::listing_stats >::
+                        value_type(test_program.relative_path().str(), stats));
+    }
 };
 
 
@@ -172,7 +190,9 @@ run_helpers(const fs::path& source_root,
     }
 
     return drivers::list_tests::drive(source_root / "Kyuafile", build_root,
-                                      filters, user_config, hooks);
+                                      filters, none,
+                                      std::vector< engine::metadata_filter >(),
+                                      user_config, false, hooks);
 }
 
 
@@ -272,6 +292,36 @@ ATF_TEST_CASE_BODY(crash)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(listing_stats);
+ATF_TEST_CASE_BODY(listing_stats)
+{
+    utils::setenv("HOME", fs::current_path().str());
+    utils::setenv("TESTS", "no_properties some_properties");
+    create_helpers(this, fs::path("root"), fs::path("root"));
+
+    {
+        capture_hooks hooks;
+        run_helpers(fs::path("root"), none, hooks);
+        ATF_REQUIRE_EQ(1, hooks.listings.size());
+        const scheduler::listing_stats& stats =
+            hooks.listings.find("dir/program")->second;
+        ATF_REQUIRE_EQ(scheduler::listing_executed, stats.source);
+        ATF_REQUIRE_EQ(2, stats.test_cases);
+    }
+
+    {
+        capture_hooks hooks;
+        run_helpers(fs::path("root"), none, hooks);
+        ATF_REQUIRE_EQ(1, hooks.listings.size());
+        const scheduler::listing_stats& stats =
+            hooks.listings.find("dir/program")->second;
+        ATF_REQUIRE_EQ(scheduler::listing_cached, stats.source);
+        ATF_REQUIRE(stats.cached_duration);
+        ATF_REQUIRE_EQ(2, stats.test_cases);
+    }
+}
+
+
 ATF_INIT_TEST_CASES(tcs)
 {
     scheduler::register_interface(
@@ -284,4 +334,5 @@ ATF_INIT_TEST_CASES(tcs)
     ATF_ADD_TEST_CASE(tcs, build_root);
     ATF_ADD_TEST_CASE(tcs, config_in_head);
     ATF_ADD_TEST_CASE(tcs, crash);
+    ATF_ADD_TEST_CASE(tcs, listing_stats);
 }
@@ -0,0 +1,286 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "drivers/report_json.hpp"
+
+extern "C" {
+#include <stdint.h>
+}
+
+#include <sstream>
+
+#include "model/context.hpp"
+#include "model/test_program.hpp"
+#include "model/test_result.hpp"
+#include "store/read_transaction.hpp"
+#include "utils/datetime.hpp"
+#include "utils/format/macros.hpp"
+#include "utils/sanity.hpp"
+#include "utils/units.hpp"
+#include "utils/text/operations.hpp"
+
+namespace datetime = utils::datetime;
+namespace text = utils::text;
+namespace units = utils::units;
+
+
+namespace {
+
+
+/// File hooks to write the contents of a stored file as a JSON string.
+///
+/// The file is escaped chunk by chunk as it is read from the database, so the
+/// memory used is independent of the size of the file.
+class json_file_hooks : public store::file_hooks {
+    /// Stream to which to write the file.
+    std::ostream& _output;
+
+    /// Maximum number of bytes of the file to write, or zero for no limit.
+    const uint64_t _limit;
+
+    /// Number of bytes of the file written so far.
+    uint64_t _length;
+
+    /// Whether the file was larger than the limit.
+    bool _truncated;
+
+public:
+    /// Constructor.
+    ///
+    /// \param output_ Stream to which to write the file.
+    /// \param limit_ Maximum number of bytes of the file to write.
+    json_file_hooks(std::ostream& output_, const units::bytes& limit_) :
+        _output(output_), _limit(limit_), _length(0), _truncated(false)
+    {
+    }
+
+    /// Writes a chunk of the file.
+    ///
+    /// \param data The contents of the chunk.
+    /// \param size The length of data in bytes.
+    ///
+    /// \return False once the limit has been exceeded; true otherwise.
+    bool
+    got_chunk(const char* data, const std::size_t size)
+    {
+        std::size_t length = size;
+        if (_limit != 0 && _length + length > _limit) {
+            length = static_cast< std::size_t >(_limit - _length);
+            _truncated = true;
+        }
+        text::escape_json(data, length, _output);
+        _length += length;
+        return !_truncated;
+    }
+
+    /// Checks whether the file was larger than the limit.
+    ///
+    /// \return True if the written contents are incomplete.
+    bool
+    truncated(void) const
+    {
+        return _truncated;
+    }
+};
+
+
+/// Formats a timestamp for the report.
+///
+/// \param timestamp The timestamp to format.
+///
+/// \return The timestamp as a quoted JSON string.
+static std::string
+json_timestamp(const datetime::timestamp& timestamp)
+{
+    return F("\"%s\"") % timestamp.to_iso8601_in_utc();
+}
+
+
+/// Formats a boolean for the report.
+///
+/// \param value The value to format.
+///
+/// \return The JSON representation of the boolean.
+static const char*
+json_bool(const bool value)
+{
+    return value ? "true" : "false";
+}
+
+
+}  // anonymous namespace
+
+
+/// Gets the name of a result type for the report.
+///
+/// \param type The type to convert.
+///
+/// \return The name of the type, which matches the one used in results files.
+const char*
+drivers::json_result_type(const model::test_result_type type)
+{
+    switch (type) {
+    case model::test_result_broken:
+        return "broken";
+
+    case model::test_result_expected_failure:
+        return "expected_failure";
+
+    case model::test_result_failed:
+        return "failed";
+
+    case model::test_result_passed:
+        return "passed";
+
+    case model::test_result_skipped:
+        return "skipped";
+    }
+    UNREACHABLE;
+}
+
+
+/// Constructor for the hooks.
+///
+/// \param outputs_ Streams to which to write the report; one per shard.
+/// \param with_output_ Whether to include the stdout and stderr of the test
+///     cases in the report.
+/// \param output_limit_ Maximum number of bytes of stdout and stderr to include
+///     for every test case, or zero for no limit.
+drivers::report_json_hooks::report_json_hooks(
+    const std::vector< std::ostream* >& outputs_, const bool with_output_,
+    const units::bytes& output_limit_) :
+    _outputs(outputs_),
+    _with_output(with_output_),
+    _output_limit(output_limit_)
+{
+    PRE(!_outputs.empty());
+}
+
+
+/// Gets the output to which to write the results of a test program.
+///
+/// \param test_program The test program the result belongs to.
+///
+/// \return The stream for the shard assigned to the test program.
+std::ostream&
+drivers::report_json_hooks::output_for(const model::test_program& test_program)
+{
+    const std::string key = test_program.relative_path().str() + "[" +
+        test_program.variant() + "]";
+    std::map< std::string, std::size_t >::const_iterator iter =
+        _shards.find(key);
+    if (iter == _shards.end())
+        iter = _shards.insert(std::make_pair(
+            key, _shards.size() % _outputs.size())).first;
+    return *_outputs[(*iter).second];
+}
+
+
+/// Tells the driver which results to load.
+///
+/// \return A filter that skips loading files unless they are to be reported.
+store::results_filter
+drivers::report_json_hooks::wanted_results(void) const
+{
+    store::results_filter filter;
+    if (!_with_output)
+        filter.without_files();
+    return filter;
+}
+
+
+/// Callback executed when the context is loaded.
+///
+/// \param context The context loaded from the database.
+void
+drivers::report_json_hooks::got_context(const model::context& context)
+{
+    std::ostringstream record;
+    record << F("{\"record\":\"context\",\"cwd\":\"%s\",\"env\":{")
+        % text::escape_json(context.cwd().str());
+    for (model::properties_map::const_iterator iter = context.env().begin();
+         iter != context.env().end(); ++iter) {
+        if (iter != context.env().begin())
+            record << ',';
+        record << F("\"%s\":\"%s\"") % text::escape_json((*iter).first)
+            % text::escape_json((*iter).second);
+    }
+    record << "}}\n";
+
+    for (std::vector< std::ostream* >::const_iterator iter = _outputs.begin();
+         iter != _outputs.end(); ++iter)
+        **iter << record.str();
+}
+
+
+/// Callback executed when a test results is found.
+///
+/// The stdout and stderr of the test case, if requested, are streamed from
+/// the database, so arbitrarily large outputs do not need to fit in memory.
+///
+/// \param iter Container for the test result's data.
+void
+drivers::report_json_hooks::got_result(store::results_iterator& iter)
+{
+    const model::test_program_ptr test_program = iter.test_program();
+    const model::test_result result = iter.result();
+    const datetime::timestamp start_time = iter.start_time();
+    const datetime::timestamp end_time = iter.end_time();
+    const datetime::delta duration = end_time - start_time;
+
+    std::ostream& output = output_for(*test_program);
+    output << F("{\"record\":\"result\",\"program\":\"%s\","
+                "\"variant\":\"%s\",\"case\":\"%s\",\"result\":\"%s\","
+                "\"reason\":\"%s\",\"attempt\":%s,\"start_time\":%s,"
+                "\"end_time\":%s,\"duration\":%.6s")
+        % text::escape_json(test_program->relative_path().str())
+        % text::escape_json(test_program->variant())
+        % text::escape_json(iter.test_case_name())
+        % json_result_type(result.type())
+        % text::escape_json(result.reason())
+        % iter.attempt()
+        % json_timestamp(start_time)
+        % json_timestamp(end_time)
+        % (duration.seconds + (duration.useconds / 1000000.0));
+
+    if (_with_output) {
+        output << ",\"stdout\":\"";
+        json_file_hooks stdout_hooks(output, _output_limit);
+        iter.read_stdout(stdout_hooks);
+        output << F("\",\"stdout_truncated\":%s")
+            % json_bool(stdout_hooks.truncated());
+
+        output << ",\"stderr\":\"";
+        json_file_hooks stderr_hooks(output, _output_limit);
+        iter.read_stderr(stderr_hooks);
+        output << F("\",\"stderr_truncated\":%s")
+            % json_bool(stderr_hooks.truncated());
+    }
+
+    output << "}\n";
+}
@@ -0,0 +1,92 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// \file drivers/report_json.hpp
+/// Generates a JSON report out of a test suite execution.
+
+#if !defined(DRIVERS_REPORT_JSON_HPP)
+#define DRIVERS_REPORT_JSON_HPP
+
+#include <cstddef>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "drivers/scan_results.hpp"
+#include "model/test_program_fwd.hpp"
+#include "model/test_result_fwd.hpp"
+#include "utils/units.hpp"
+
+namespace drivers {
+
+
+const char* json_result_type(const model::test_result_type);
+
+
+/// Hooks for the scan_results driver to generate a JSON report.
+///
+/// The report is written as newline-delimited JSON: every line is a
+/// self-contained JSON object, so consumers can process the report one record
+/// at a time.  Each output starts with a record describing the context of the
+/// execution, followed by one record per test result.
+///
+/// The report can be sharded across various outputs.  All the results of a
+/// test program go to the same output, and test programs are distributed
+/// across the outputs in a round-robin manner.
+class report_json_hooks : public drivers::scan_results::base_hooks {
+    /// Streams to which to write the report.
+    const std::vector< std::ostream* > _outputs;
+
+    /// Whether to include the stdout and stderr of the test cases.
+    const bool _with_output;
+
+    /// Maximum number of bytes of stdout and stderr to include per test case.
+    ///
+    /// Zero means no limit.
+    const utils::units::bytes _output_limit;
+
+    /// Mapping of test program identifiers to the output they are written to.
+    std::map< std::string, std::size_t > _shards;
+
+    std::ostream& output_for(const model::test_program&);
+
+public:
+    report_json_hooks(const std::vector< std::ostream* >&, const bool,
+                      const utils::units::bytes&);
+
+    store::results_filter wanted_results(void) const;
+
+    void got_context(const model::context&);
+    void got_result(store::results_iterator&);
+};
+
+
+}  // namespace drivers
+
+#endif  // !defined(DRIVERS_REPORT_JSON_HPP)
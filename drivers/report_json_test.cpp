@@ -0,0 +1,320 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "drivers/report_json.hpp"
+
+#include <map>
+#include <sstream>
+#include <vector>
+
+#include <atf-c++.hpp>
+
+#include "drivers/scan_results.hpp"
+#include "engine/filters.hpp"
+#include "model/context.hpp"
+#include "model/metadata.hpp"
+#include "model/test_program.hpp"
+#include "model/test_result.hpp"
+#include "store/write_backend.hpp"
+#include "store/write_transaction.hpp"
+#include "utils/datetime.hpp"
+#include "utils/format/macros.hpp"
+#include "utils/fs/path.hpp"
+#include "utils/units.hpp"
+
+namespace datetime = utils::datetime;
+namespace fs = utils::fs;
+namespace units = utils::units;
+
+
+namespace {
+
+
+/// Populates the context of the given database.
+///
+/// \param tx Transaction to use for the writes to the database.
+/// \param env_vars Number of environment variables to add to the context.
+static void
+add_context(store::write_transaction& tx, const std::size_t env_vars)
+{
+    std::map< std::string, std::string > env;
+    for (std::size_t i = 0; i < env_vars; i++)
+        env[F("VAR%s") % i] = F("Value %s") % i;
+    const model::context context(fs::path("/root"), env);
+    (void)tx.put_context(context);
+}
+
+
+/// Adds a new test program with various test cases to the given database.
+///
+/// \param tx Transaction to use for the writes to the database.
+/// \param prog Test program name.
+/// \param results Collection of results for the added test cases.  The size of
+///     this vector indicates the number of tests in the test program.
+/// \param with_output Whether to add stdout/stderr messages to the test cases.
+static void
+add_tests(store::write_transaction& tx,
+          const char* prog,
+          const std::vector< model::test_result >& results,
+          const bool with_output)
+{
+    model::test_program_builder test_program_builder(
+        "plain", fs::path(prog), fs::path("/root"), "suite");
+
+    for (std::size_t j = 0; j < results.size(); j++)
+        test_program_builder.add_test_case(F("t%s") % j);
+
+    const model::test_program test_program = test_program_builder.build();
+    const int64_t tp_id = tx.put_test_program(test_program);
+
+    for (std::size_t j = 0; j < results.size(); j++) {
+        const int64_t tc_id = tx.put_test_case(test_program, F("t%s") % j,
+                                               tp_id);
+        const datetime::timestamp start =
+            datetime::timestamp::from_microseconds(0);
+        const datetime::timestamp end =
+            datetime::timestamp::from_microseconds(j * 1000000 + 500000);
+        tx.put_result(results[j], tc_id, start, end);
+
+        if (with_output) {
+            atf::utils::create_file("fake-out", F("stdout \"file\" %s") % j);
+            tx.put_test_case_file("__STDOUT__", fs::path("fake-out"), tc_id);
+            atf::utils::create_file("fake-err", F("stderr\nfile %s") % j);
+            tx.put_test_case_file("__STDERR__", fs::path("fake-err"), tc_id);
+        }
+    }
+}
+
+
+/// Creates a database with a couple of test programs.
+///
+/// \param with_output Whether to add stdout/stderr messages to the test cases.
+static void
+create_db(const bool with_output)
+{
+    std::vector< model::test_result > results1;
+    results1.push_back(model::test_result(
+        model::test_result_broken, "Broken"));
+    results1.push_back(model::test_result(
+        model::test_result_failed, "Failed \"quoted\""));
+    std::vector< model::test_result > results2;
+    results2.push_back(model::test_result(
+        model::test_result_passed));
+
+    store::write_backend backend = store::write_backend::open_rw(
+        fs::path("test.db"));
+    store::write_transaction tx = backend.start_write();
+    add_context(tx, 2);
+    add_tests(tx, "dir/prog-1", results1, with_output);
+    add_tests(tx, "dir/sub/prog-2", results2, with_output);
+    tx.commit();
+    backend.close();
+}
+
+
+/// Runs the JSON report on the test.db database.
+///
+/// \param outputs Streams to which to write the report; one per shard.
+/// \param with_output Whether to include the stdout and stderr of the tests.
+/// \param output_limit Maximum number of bytes of stdout/stderr to include.
+static void
+run_report(std::vector< std::ostringstream* > outputs, const bool with_output,
+           const units::bytes& output_limit = units::bytes(0))
+{
+    std::vector< std::ostream* > streams(outputs.begin(), outputs.end());
+    drivers::report_json_hooks hooks(streams, with_output, output_limit);
+    drivers::scan_results::drive(fs::path("test.db"),
+                                 std::set< engine::test_filter >(),
+                                 hooks);
+}
+
+
+/// Expected context record for databases created by create_db.
+static const char* const context_record =
+    "{\"record\":\"context\",\"cwd\":\"/root\","
+    "\"env\":{\"VAR0\":\"Value 0\",\"VAR1\":\"Value 1\"}}\n";
+
+
+/// Common fields of the first result in databases created by create_db.
+static const char* const result_1_0 =
+    "{\"record\":\"result\",\"program\":\"dir/prog-1\",\"variant\":\"\","
+    "\"case\":\"t0\",\"result\":\"broken\",\"reason\":\"Broken\","
+    "\"attempt\":1,\"start_time\":\"1970-01-01T00:00:00.000000Z\","
+    "\"end_time\":\"1970-01-01T00:00:00.500000Z\",\"duration\":0.500000";
+
+
+/// Common fields of the second result in databases created by create_db.
+static const char* const result_1_1 =
+    "{\"record\":\"result\",\"program\":\"dir/prog-1\",\"variant\":\"\","
+    "\"case\":\"t1\",\"result\":\"failed\","
+    "\"reason\":\"Failed \\\"quoted\\\"\","
+    "\"attempt\":1,\"start_time\":\"1970-01-01T00:00:00.000000Z\","
+    "\"end_time\":\"1970-01-01T00:00:01.500000Z\",\"duration\":1.500000";
+
+
+/// Common fields of the third result in databases created by create_db.
+static const char* const result_2_0 =
+    "{\"record\":\"result\",\"program\":\"dir/sub/prog-2\",\"variant\":\"\","
+    "\"case\":\"t0\",\"result\":\"passed\",\"reason\":\"\","
+    "\"attempt\":1,\"start_time\":\"1970-01-01T00:00:00.000000Z\","
+    "\"end_time\":\"1970-01-01T00:00:00.500000Z\",\"duration\":0.500000";
+
+
+}  // anonymous namespace
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(json_result_type);
+ATF_TEST_CASE_BODY(json_result_type)
+{
+    ATF_REQUIRE_EQ(std::string("broken"),
+                   drivers::json_result_type(model::test_result_broken));
+    ATF_REQUIRE_EQ(std::string("expected_failure"),
+                   drivers::json_result_type(
+                       model::test_result_expected_failure));
+    ATF_REQUIRE_EQ(std::string("failed"),
+                   drivers::json_result_type(model::test_result_failed));
+    ATF_REQUIRE_EQ(std::string("passed"),
+                   drivers::json_result_type(model::test_result_passed));
+    ATF_REQUIRE_EQ(std::string("skipped"),
+                   drivers::json_result_type(model::test_result_skipped));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(report_json_hooks__minimal);
+ATF_TEST_CASE_BODY(report_json_hooks__minimal)
+{
+    store::write_backend backend = store::write_backend::open_rw(
+        fs::path("test.db"));
+    store::write_transaction tx = backend.start_write();
+    add_context(tx, 0);
+    tx.commit();
+    backend.close();
+
+    std::ostringstream output;
+    run_report(std::vector< std::ostringstream* >(1, &output), false);
+
+    ATF_REQUIRE_EQ("{\"record\":\"context\",\"cwd\":\"/root\",\"env\":{}}\n",
+                   output.str());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(report_json_hooks__some_tests);
+ATF_TEST_CASE_BODY(report_json_hooks__some_tests)
+{
+    create_db(true);
+
+    std::ostringstream output;
+    run_report(std::vector< std::ostringstream* >(1, &output), false);
+
+    const std::string expected = std::string() +
+        context_record +
+        result_1_0 + "}\n" +
+        result_1_1 + "}\n" +
+        result_2_0 + "}\n";
+    ATF_REQUIRE_EQ(expected, output.str());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(report_json_hooks__with_output);
+ATF_TEST_CASE_BODY(report_json_hooks__with_output)
+{
+    create_db(true);
+
+    std::ostringstream output;
+    run_report(std::vector< std::ostringstream* >(1, &output), true);
+
+    const std::string expected = std::string() +
+        context_record +
+        result_1_0 +
+        ",\"stdout\":\"stdout \\\"file\\\" 0\",\"stdout_truncated\":false"
+        ",\"stderr\":\"stderr\\nfile 0\",\"stderr_truncated\":false}\n" +
+        result_1_1 +
+        ",\"stdout\":\"stdout \\\"file\\\" 1\",\"stdout_truncated\":false"
+        ",\"stderr\":\"stderr\\nfile 1\",\"stderr_truncated\":false}\n" +
+        result_2_0 +
+        ",\"stdout\":\"stdout \\\"file\\\" 0\",\"stdout_truncated\":false"
+        ",\"stderr\":\"stderr\\nfile 0\",\"stderr_truncated\":false}\n";
+    ATF_REQUIRE_EQ(expected, output.str());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(report_json_hooks__output_limit);
+ATF_TEST_CASE_BODY(report_json_hooks__output_limit)
+{
+    create_db(true);
+
+    std::ostringstream output;
+    run_report(std::vector< std::ostringstream* >(1, &output), true,
+               units::bytes(8));
+
+    const std::string expected = std::string() +
+        context_record +
+        result_1_0 +
+        ",\"stdout\":\"stdout \\\"\",\"stdout_truncated\":true"
+        ",\"stderr\":\"stderr\\nf\",\"stderr_truncated\":true}\n" +
+        result_1_1 +
+        ",\"stdout\":\"stdout \\\"\",\"stdout_truncated\":true"
+        ",\"stderr\":\"stderr\\nf\",\"stderr_truncated\":true}\n" +
+        result_2_0 +
+        ",\"stdout\":\"stdout \\\"\",\"stdout_truncated\":true"
+        ",\"stderr\":\"stderr\\nf\",\"stderr_truncated\":true}\n";
+    ATF_REQUIRE_EQ(expected, output.str());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(report_json_hooks__shards);
+ATF_TEST_CASE_BODY(report_json_hooks__shards)
+{
+    create_db(false);
+
+    std::ostringstream output1, output2, output3;
+    std::vector< std::ostringstream* > outputs;
+    outputs.push_back(&output1);
+    outputs.push_back(&output2);
+    outputs.push_back(&output3);
+    run_report(outputs, false);
+
+    ATF_REQUIRE_EQ(std::string() + context_record +
+                   result_1_0 + "}\n" + result_1_1 + "}\n",
+                   output1.str());
+    ATF_REQUIRE_EQ(std::string() + context_record + result_2_0 + "}\n",
+                   output2.str());
+    ATF_REQUIRE_EQ(context_record, output3.str());
+}
+
+
+ATF_INIT_TEST_CASES(tcs)
+{
+    ATF_ADD_TEST_CASE(tcs, json_result_type);
+
+    ATF_ADD_TEST_CASE(tcs, report_json_hooks__minimal);
+    ATF_ADD_TEST_CASE(tcs, report_json_hooks__some_tests);
+    ATF_ADD_TEST_CASE(tcs, report_json_hooks__with_output);
+    ATF_ADD_TEST_CASE(tcs, report_json_hooks__output_limit);
+    ATF_ADD_TEST_CASE(tcs, report_json_hooks__shards);
+}
@@ -28,7 +28,12 @@
 
 #include "drivers/report_junit.hpp"
 
+extern "C" {
+#include <stdint.h>
+}
+
 #include <algorithm>
+#include <cstddef>
 
 #include "model/context.hpp"
 #include "model/metadata.hpp"
@@ -45,18 +50,103 @@
 namespace config = utils::config;
 namespace datetime = utils::datetime;
 namespace text = utils::text;
+namespace units = utils::units;
+
+
+namespace {
+
+
+/// File hooks to write the contents of a stored file as escaped XML.
+///
+/// The file is escaped chunk by chunk as it is read from the database, so the
+/// memory used is independent of the size of the file.
+class xml_file_hooks : public store::file_hooks {
+    /// Stream to which to write the file.
+    std::ostream& _output;
+
+    /// Text to write verbatim before the first chunk, if any.
+    const char* _prefix;
+
+    /// Maximum number of bytes of the file to write, or zero for no limit.
+    const uint64_t _limit;
+
+    /// Number of bytes of the file written so far.
+    uint64_t _length;
+
+    /// Whether the file was larger than the limit.
+    bool _truncated;
+
+public:
+    /// Constructor.
+    ///
+    /// \param output_ Stream to which to write the file.
+    /// \param prefix_ Text to write verbatim before the first chunk, if any.
+    /// \param limit_ Maximum number of bytes of the file to write.
+    xml_file_hooks(std::ostream& output_, const char* prefix_,
+                   const units::bytes& limit_) :
+        _output(output_), _prefix(prefix_), _limit(limit_), _length(0),
+        _truncated(false)
+    {
+    }
+
+    /// Writes a chunk of the file.
+    ///
+    /// \param data The contents of the chunk.
+    /// \param size The length of data in bytes.
+    ///
+    /// \return False once the limit has been exceeded; true otherwise.
+    bool
+    got_chunk(const char* data, const std::size_t size)
+    {
+        if (_length == 0)
+            _output << _prefix;
+
+        std::size_t length = size;
+        if (_limit != 0 && _length + length > _limit) {
+            length = static_cast< std::size_t >(_limit - _length);
+            _truncated = true;
+        }
+        text::escape_xml(data, length, _output);
+        _length += length;
+        return !_truncated;
+    }
+
+    /// Checks whether any chunk was received.
+    ///
+    /// \return True if the file was empty or missing.
+    bool
+    empty(void) const
+    {
+        return _length == 0;
+    }
+
+    /// Records the truncation of the file, if any.
+    void
+    finish(void)
+    {
+        if (_truncated)
+            _output << text::escape_xml(F("\n[... output truncated by kyua "
+                                          "after %s bytes ...]\n") % _limit);
+    }
+};
+
+
+}  // anonymous namespace
 
 
 /// Converts a test program name into a class-like name.
 ///
 /// \param test_program Test program from which to extract the name.
 ///
-/// \return A class-like representation of the test program's identifier.
+/// \return A class-like representation of the test program's identifier,
+/// followed by the name of its variant in brackets if it has one.
 std::string
 drivers::junit_classname(const model::test_program& test_program)
 {
     std::string classname = test_program.relative_path().str();
     std::replace(classname.begin(), classname.end(), '/', '.');
+    if (!test_program.variant().empty())
+        classname += "[" + test_program.variant() + "]";
     return classname;
 }
 
@@ -147,8 +237,12 @@ drivers::junit_timing(const datetime::timestamp& start_time,
 /// Constructor for the hooks.
 ///
 /// \param [out] output_ Stream to which to write the report.
-drivers::report_junit_hooks::report_junit_hooks(std::ostream& output_) :
-    _output(output_)
+/// \param output_limit_ Maximum number of bytes of stdout and stderr to include
+///     for every test case, or zero for no limit.
+drivers::report_junit_hooks::report_junit_hooks(
+    std::ostream& output_, const units::bytes& output_limit_) :
+    _output(output_),
+    _output_limit(output_limit_)
 {
 }
 
@@ -165,11 +259,17 @@ drivers::report_junit_hooks::got_context(const model::context& context)
     _output << "<properties>\n";
     _output << F("<property name=\"cwd\" value=\"%s\"/>\n")
         % text::escape_xml(context.cwd().str());
+    // Escape the variables straight into the output: the environment of a CI
+    // run can be large and there is no need to hold copies of it.
     for (model::properties_map::const_iterator iter =
              context.env().begin(); iter != context.env().end(); ++iter) {
-        _output << F("<property name=\"env.%s\" value=\"%s\"/>\n")
-            % text::escape_xml((*iter).first)
-            % text::escape_xml((*iter).second);
+        const std::string& name = (*iter).first;
+        const std::string& value = (*iter).second;
+        _output << "<property name=\"env.";
+        text::escape_xml(name.data(), name.length(), _output);
+        _output << "\" value=\"";
+        text::escape_xml(value.data(), value.length(), _output);
+        _output << "\"/>\n";
     }
     _output << "</properties>\n";
 }
@@ -177,6 +277,9 @@ drivers::report_junit_hooks::got_context(const model::context& context)
 
 /// Callback executed when a test results is found.
 ///
+/// The stdout and stderr of the test case are streamed from the database, so
+/// arbitrarily large outputs do not need to fit in memory.
+///
 /// \param iter Container for the test result's data.
 void
 drivers::report_junit_hooks::got_result(store::results_iterator& iter)
@@ -222,10 +325,13 @@ drivers::report_junit_hooks::got_result(store::results_iterator& iter)
             % text::escape_xml(result.reason());
     }
 
-    const std::string stdout_contents = iter.stdout_contents();
-    if (!stdout_contents.empty()) {
-        _output << F("<system-out>%s</system-out>\n")
-            % text::escape_xml(stdout_contents);
+    {
+        xml_file_hooks stdout_hooks(_output, "<system-out>", _output_limit);
+        iter.read_stdout(stdout_hooks);
+        if (!stdout_hooks.empty()) {
+            stdout_hooks.finish();
+            _output << "</system-out>\n";
+        }
     }
 
     {
@@ -234,22 +340,48 @@ drivers::report_junit_hooks::got_result(store::results_iterator& iter)
         stderr_contents += junit_metadata(test_case.get_metadata());
     }
     stderr_contents += junit_timing(iter.start_time(), iter.end_time());
+    stderr_contents += junit_stderr_header;
+    _output << "<system-err>" << text::escape_xml(stderr_contents);
     {
-        stderr_contents += junit_stderr_header;
-        const std::string real_stderr_contents = iter.stderr_contents();
-        if (real_stderr_contents.empty()) {
-            stderr_contents += "<EMPTY>\n";
+        xml_file_hooks stderr_hooks(_output, "", _output_limit);
+        iter.read_stderr(stderr_hooks);
+        if (stderr_hooks.empty()) {
+            _output << text::escape_xml("<EMPTY>\n");
         } else {
-            stderr_contents += real_stderr_contents;
+            stderr_hooks.finish();
         }
     }
-    _output << "<system-err>" << text::escape_xml(stderr_contents)
-            << "</system-err>\n";
+    _output << "</system-err>\n";
 
     _output << "</testcase>\n";
 }
 
 
+/// Creates the hooks to render a partition of the test cases.
+///
+/// \param output Stream to which to write the test cases of the partition.
+///
+/// \return Hooks with the same settings as these that write to output.
+std::auto_ptr< drivers::scan_results::base_hooks >
+drivers::report_junit_hooks::partition_hooks(std::ostream& output)
+{
+    return std::auto_ptr< drivers::scan_results::base_hooks >(
+        new report_junit_hooks(output, _output_limit));
+}
+
+
+/// Appends the test cases rendered for a partition to the report.
+///
+/// \param input Stream with the test cases of the partition.
+void
+drivers::report_junit_hooks::got_partition(std::istream& input)
+{
+    // Inserting an empty buffer would flag the output stream as failed.
+    if (input.peek() != std::istream::traits_type::eof())
+        _output << input.rdbuf();
+}
+
+
 /// Finalizes the report.
 ///
 /// \param unused_r The result of the driver execution.
@@ -32,6 +32,8 @@
 #if !defined(ENGINE_REPORT_JUNIT_HPP)
 #define ENGINE_REPORT_JUNIT_HPP
 
+#include <istream>
+#include <memory>
 #include <ostream>
 #include <string>
 
@@ -39,6 +41,7 @@
 #include "model/metadata_fwd.hpp"
 #include "model/test_program_fwd.hpp"
 #include "utils/datetime_fwd.hpp"
+#include "utils/units.hpp"
 
 namespace drivers {
 
@@ -56,16 +59,29 @@ std::string junit_timing(const utils::datetime::timestamp&,
 
 
 /// Hooks for the scan_results driver to generate a JUnit report.
-class report_junit_hooks : public drivers::scan_results::base_hooks {
+///
+/// The test cases are independent elements of the report, so they can also be
+/// rendered in partitions with scan_results::drive_partitioned().
+class report_junit_hooks : public drivers::scan_results::partitioned_hooks {
     /// Stream to which to write the report.
     std::ostream& _output;
 
+    /// Maximum number of bytes of stdout and stderr to include per test case.
+    ///
+    /// Zero means no limit.
+    const utils::units::bytes _output_limit;
+
 public:
-    report_junit_hooks(std::ostream&);
+    report_junit_hooks(std::ostream&,
+                       const utils::units::bytes& = utils::units::bytes(0));
 
     void got_context(const model::context&);
     void got_result(store::results_iterator&);
 
+    std::auto_ptr< drivers::scan_results::base_hooks > partition_hooks(
+        std::ostream&);
+    void got_partition(std::istream&);
+
     void end(const drivers::scan_results::result&);
 };
 
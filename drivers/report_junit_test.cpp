@@ -42,12 +42,14 @@
 #include "model/test_result.hpp"
 #include "store/write_backend.hpp"
 #include "store/write_transaction.hpp"
+#include "utils/config/tree.ipp"
 #include "utils/datetime.hpp"
 #include "utils/format/macros.hpp"
 #include "utils/fs/path.hpp"
 #include "utils/optional.ipp"
 #include "utils/units.hpp"
 
+namespace config = utils::config;
 namespace datetime = utils::datetime;
 namespace fs = utils::fs;
 namespace units = utils::units;
@@ -63,9 +65,16 @@ static const char* const default_metadata =
     "allowed_architectures is empty\n"
     "allowed_platforms is empty\n"
     "description is empty\n"
+    "exclusive_group is empty\n"
+    "fixtures is empty\n"
     "has_cleanup = false\n"
     "is_exclusive = false\n"
+    "is_idempotent = false\n"
+    "max_output_size = 0\n"
+    "max_retries = 0\n"
+    "priority = normal\n"
     "required_configs is empty\n"
+    "required_cpus = 0\n"
     "required_disk_space = 0\n"
     "required_files is empty\n"
     "required_memory = 0\n"
@@ -80,9 +89,16 @@ static const char* const overriden_metadata =
     "allowed_architectures is empty\n"
     "allowed_platforms is empty\n"
     "description = Textual description\n"
+    "exclusive_group is empty\n"
+    "fixtures is empty\n"
     "has_cleanup = false\n"
     "is_exclusive = false\n"
+    "is_idempotent = false\n"
+    "max_output_size = 0\n"
+    "max_retries = 0\n"
+    "priority = normal\n"
     "required_configs is empty\n"
+    "required_cpus = 0\n"
     "required_disk_space = 0\n"
     "required_files is empty\n"
     "required_memory = 0\n"
@@ -168,6 +184,21 @@ ATF_TEST_CASE_BODY(junit_classname)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(junit_classname__variant);
+ATF_TEST_CASE_BODY(junit_classname__variant)
+{
+    config::properties_map vars;
+    vars["mode"] = "fast";
+    const model::test_program test_program = model::test_program_builder(
+        "plain", fs::path("dir1/dir2/program"), fs::path("/root"), "suite")
+        .set_variant("fast", vars)
+        .build();
+
+    ATF_REQUIRE_EQ("dir1.dir2.program[fast]",
+                   drivers::junit_classname(test_program));
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(junit_duration);
 ATF_TEST_CASE_BODY(junit_duration)
 {
@@ -199,9 +230,16 @@ ATF_TEST_CASE_BODY(junit_metadata__overrides)
         .add_allowed_architecture("arch1")
         .add_allowed_platform("platform1")
         .set_description("This is a test")
+        .set_exclusive_group("group1")
+        .add_fixture(fs::path("fixture1"))
         .set_has_cleanup(true)
         .set_is_exclusive(true)
+        .set_is_idempotent(true)
+        .set_max_output_size(units::bytes(4096))
+        .set_max_retries(2)
+        .set_priority("low")
         .add_required_config("config1")
+        .set_required_cpus(4)
         .set_required_disk_space(units::bytes(456))
         .add_required_file(fs::path("file1"))
         .set_required_memory(units::bytes(123))
@@ -215,9 +253,16 @@ ATF_TEST_CASE_BODY(junit_metadata__overrides)
         + "allowed_architectures = arch1\n"
         + "allowed_platforms = platform1\n"
         + "description = This is a test\n"
+        + "exclusive_group = group1\n"
+        + "fixtures = fixture1\n"
         + "has_cleanup = true\n"
         + "is_exclusive = true\n"
+        + "is_idempotent = true\n"
+        + "max_output_size = 4.00K\n"
+        + "max_retries = 2\n"
+        + "priority = low\n"
         + "required_configs = config1\n"
+        + "required_cpus = 4\n"
         + "required_disk_space = 456\n"
         + "required_files = file1\n"
         + "required_memory = 123\n"
@@ -399,9 +444,60 @@ ATF_TEST_CASE_BODY(report_junit_hooks__some_tests)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(report_junit_hooks__output_limit);
+ATF_TEST_CASE_BODY(report_junit_hooks__output_limit)
+{
+    std::vector< model::test_result > results;
+    results.push_back(model::test_result(model::test_result_passed));
+
+    store::write_backend backend = store::write_backend::open_rw(
+        fs::path("test.db"));
+    store::write_transaction tx = backend.start_write();
+    add_context(tx, 0);
+    add_tests(tx, "prog", results, false, true);
+    tx.commit();
+    backend.close();
+
+    std::ostringstream output;
+
+    drivers::report_junit_hooks hooks(output, units::bytes(8));
+    drivers::scan_results::drive(fs::path("test.db"),
+                                 std::set< engine::test_filter >(),
+                                 hooks);
+
+    const std::string expected = std::string() +
+        "<?xml version=\"1.0\" encoding=\"iso-8859-1\"?>\n"
+        "<testsuite>\n"
+        "<properties>\n"
+        "<property name=\"cwd\" value=\"/root\"/>\n"
+        "</properties>\n"
+
+        "<testcase classname=\"prog\" name=\"t0\" time=\"0.500\">\n"
+        "<system-out>stdout f\n"
+        "[... output truncated by kyua after 8 bytes ...]\n"
+        "</system-out>\n"
+        "<system-err>"
+        + drivers::junit_metadata_header +
+        default_metadata
+        + drivers::junit_timing_header +
+        "Start time: 1970-01-01T00:00:00.000000Z\n"
+        "End time:   1970-01-01T00:00:00.500000Z\n"
+        "Duration:   0.500s\n"
+        + drivers::junit_stderr_header +
+        "stderr f\n"
+        "[... output truncated by kyua after 8 bytes ...]\n"
+        "</system-err>\n"
+        "</testcase>\n"
+
+        "</testsuite>\n";
+    ATF_REQUIRE_EQ(expected, output.str());
+}
+
+
 ATF_INIT_TEST_CASES(tcs)
 {
     ATF_ADD_TEST_CASE(tcs, junit_classname);
+    ATF_ADD_TEST_CASE(tcs, junit_classname__variant);
 
     ATF_ADD_TEST_CASE(tcs, junit_duration);
 
@@ -412,4 +508,5 @@ ATF_INIT_TEST_CASES(tcs)
 
     ATF_ADD_TEST_CASE(tcs, report_junit_hooks__minimal);
     ATF_ADD_TEST_CASE(tcs, report_junit_hooks__some_tests);
+    ATF_ADD_TEST_CASE(tcs, report_junit_hooks__output_limit);
 }
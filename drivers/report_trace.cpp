@@ -0,0 +1,188 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "drivers/report_trace.hpp"
+
+extern "C" {
+#include <stdint.h>
+}
+
+#include <cstddef>
+#include <vector>
+
+#include "store/read_transaction.hpp"
+#include "utils/datetime.hpp"
+#include "utils/format/macros.hpp"
+#include "utils/optional.ipp"
+#include "utils/sanity.hpp"
+#include "utils/text/operations.hpp"
+
+namespace datetime = utils::datetime;
+namespace text = utils::text;
+
+
+namespace {
+
+
+/// Assigns the events that run in subprocesses to execution slots.
+///
+/// The store does not record the slot that ran each subprocess, but the
+/// subprocesses in a slot never overlap, so the slots are reconstructed by
+/// giving every event the lowest-numbered slot that is free at its start time.
+/// This yields as many slots as the peak parallelism of the run.
+///
+/// \param events The events to assign, sorted by their start time.
+///
+/// \return The slot of every event, in the same order as the events.  Events
+/// that do not run in a subprocess get none.
+static std::vector< utils::optional< std::size_t > >
+assign_slots(const std::vector< store::run_event >& events)
+{
+    std::vector< utils::optional< std::size_t > > slots;
+    std::vector< datetime::timestamp > busy_until;
+    for (std::vector< store::run_event >::const_iterator iter =
+             events.begin(); iter != events.end(); ++iter) {
+        if (!drivers::runs_in_slot(*iter)) {
+            slots.push_back(utils::none);
+            continue;
+        }
+
+        std::size_t slot = 0;
+        while (slot < busy_until.size() &&
+               (*iter).start_time < busy_until[slot])
+            ++slot;
+        if (slot == busy_until.size())
+            busy_until.push_back((*iter).end_time);
+        else
+            busy_until[slot] = (*iter).end_time;
+        slots.push_back(utils::make_optional(slot));
+    }
+    return slots;
+}
+
+
+/// Computes the offset of a timestamp from the start of the trace.
+///
+/// \param origin The start of the trace.
+/// \param time The timestamp to convert.
+///
+/// \return The number of microseconds from origin to time; zero if time
+/// precedes origin, which happens if the wall clock was adjusted.
+static int64_t
+offset_of(const datetime::timestamp& origin, const datetime::timestamp& time)
+{
+    if (time < origin)
+        return 0;
+    return (time - origin).to_microseconds();
+}
+
+
+/// Writes the metadata record that names a track of the trace.
+///
+/// \param output The stream to write the record to.
+/// \param tid The identifier of the track.
+/// \param name The name of the track.
+static void
+write_thread_name(std::ostream& output, const std::size_t tid,
+                  const std::string& name)
+{
+    output << F(",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+                "\"tid\":%s,\"args\":{\"name\":\"%s\"}}")
+        % tid % text::escape_json(name);
+}
+
+
+}  // anonymous namespace
+
+
+/// Checks whether an event corresponds to a subprocess that takes up a slot.
+///
+/// \param event The event to check.
+///
+/// \return True for the executions of test cases and listings of test
+/// programs; false for the operations done by kyua itself.
+bool
+drivers::runs_in_slot(const store::run_event& event)
+{
+    return event.pid && (event.kind == "test" || event.kind == "list");
+}
+
+
+/// Writes the timeline of an execution in the Trace Event Format.
+///
+/// The output can be loaded into timeline viewers such as Perfetto or the
+/// trace viewer of Chrome.  The events that run in subprocesses are laid out
+/// in one track per execution slot, and the operations done by kyua itself,
+/// such as spawning the subprocesses or cleaning up after them, in a separate
+/// track.  Timestamps are relative to the start of the earliest event.
+///
+/// \param events The events of the execution, sorted by their start time.
+/// \param output The stream to write the trace to.
+void
+drivers::write_trace(const std::vector< store::run_event >& events,
+                     std::ostream& output)
+{
+    const std::vector< utils::optional< std::size_t > > slots =
+        assign_slots(events);
+    INV(slots.size() == events.size());
+
+    std::size_t nslots = 0;
+    for (std::size_t i = 0; i < slots.size(); ++i) {
+        if (slots[i] && slots[i].get() + 1 > nslots)
+            nslots = slots[i].get() + 1;
+    }
+
+    output << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    output << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,"
+        "\"tid\":0,\"args\":{\"name\":\"kyua\"}}";
+    write_thread_name(output, 0, "kyua");
+    for (std::size_t i = 0; i < nslots; ++i)
+        write_thread_name(output, i + 1, F("slot %s") % i);
+
+    const datetime::timestamp origin = events.empty() ?
+        datetime::timestamp::from_microseconds(0) : events[0].start_time;
+    for (std::size_t i = 0; i < events.size(); ++i) {
+        const store::run_event& event = events[i];
+        const int64_t start = offset_of(origin, event.start_time);
+        const int64_t end = offset_of(origin, event.end_time);
+
+        output << F(",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\","
+                    "\"ts\":%s,\"dur\":%s,\"pid\":1,\"tid\":%s")
+            % text::escape_json(event.name) % text::escape_json(event.kind)
+            % start % (end > start ? end - start : 0)
+            % (slots[i] ? slots[i].get() + 1 : 0);
+        if (event.pid) {
+            output << F(",\"args\":{\"pid\":%s") % event.pid.get();
+            if (slots[i])
+                output << F(",\"slot\":%s") % slots[i].get();
+            output << "}";
+        }
+        output << "}";
+    }
+    output << "\n]}\n";
+}
@@ -0,0 +1,152 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "drivers/report_trace.hpp"
+
+#include <sstream>
+#include <vector>
+
+#include <atf-c++.hpp>
+
+#include "store/read_transaction.hpp"
+#include "utils/datetime.hpp"
+#include "utils/optional.ipp"
+
+namespace datetime = utils::datetime;
+
+using utils::none;
+
+
+namespace {
+
+
+/// Constructs a timestamp relative to a fixed origin.
+///
+/// \param usecs Number of microseconds after the origin.
+///
+/// \return A timestamp.
+static datetime::timestamp
+at(const int64_t usecs)
+{
+    return datetime::timestamp::from_values(2026, 10, 14, 12, 0, 0, 0) +
+        datetime::delta::from_microseconds(usecs);
+}
+
+
+/// Constructs an event that runs in a subprocess.
+///
+/// \param kind Type of the event.
+/// \param name Subject of the event.
+/// \param pid Subprocess of the event.
+/// \param start Start time of the event, in microseconds after the origin.
+/// \param end End time of the event, in microseconds after the origin.
+///
+/// \return The event.
+static store::run_event
+subprocess_event(const char* kind, const char* name, const int pid,
+                 const int64_t start, const int64_t end)
+{
+    return store::run_event(kind, name, utils::make_optional(pid), at(start),
+                            at(end));
+}
+
+
+}  // anonymous namespace
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(runs_in_slot);
+ATF_TEST_CASE_BODY(runs_in_slot)
+{
+    ATF_REQUIRE(drivers::runs_in_slot(subprocess_event("test", "a", 1, 0, 1)));
+    ATF_REQUIRE(drivers::runs_in_slot(subprocess_event("list", "a", 1, 0, 1)));
+    ATF_REQUIRE(!drivers::runs_in_slot(
+        store::run_event("cleanup", "a", none, at(0), at(1))));
+    ATF_REQUIRE(!drivers::runs_in_slot(
+        store::run_event("test", "a", none, at(0), at(1))));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(write_trace__empty);
+ATF_TEST_CASE_BODY(write_trace__empty)
+{
+    std::ostringstream output;
+    drivers::write_trace(std::vector< store::run_event >(), output);
+
+    ATF_REQUIRE_EQ(
+        "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"
+        "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,"
+        "\"args\":{\"name\":\"kyua\"}},\n"
+        "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,"
+        "\"args\":{\"name\":\"kyua\"}}\n"
+        "]}\n",
+        output.str());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(write_trace__slots);
+ATF_TEST_CASE_BODY(write_trace__slots)
+{
+    std::vector< store::run_event > events;
+    events.push_back(subprocess_event("list", "dir/prog", 10, 0, 100));
+    events.push_back(subprocess_event("test", "dir/prog:a", 11, 50, 300));
+    events.push_back(store::run_event("cleanup", "dir/prog:\"b\"", none,
+                                      at(100), at(120)));
+    events.push_back(subprocess_event("test", "dir/prog:b", 12, 100, 200));
+
+    std::ostringstream output;
+    drivers::write_trace(events, output);
+
+    ATF_REQUIRE_EQ(
+        "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"
+        "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,"
+        "\"args\":{\"name\":\"kyua\"}},\n"
+        "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,"
+        "\"args\":{\"name\":\"kyua\"}},\n"
+        "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,"
+        "\"args\":{\"name\":\"slot 0\"}},\n"
+        "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,"
+        "\"args\":{\"name\":\"slot 1\"}},\n"
+        "{\"name\":\"dir/prog\",\"cat\":\"list\",\"ph\":\"X\",\"ts\":0,"
+        "\"dur\":100,\"pid\":1,\"tid\":1,\"args\":{\"pid\":10,\"slot\":0}},\n"
+        "{\"name\":\"dir/prog:a\",\"cat\":\"test\",\"ph\":\"X\",\"ts\":50,"
+        "\"dur\":250,\"pid\":1,\"tid\":2,\"args\":{\"pid\":11,\"slot\":1}},\n"
+        "{\"name\":\"dir/prog:\\\"b\\\"\",\"cat\":\"cleanup\",\"ph\":\"X\","
+        "\"ts\":100,\"dur\":20,\"pid\":1,\"tid\":0},\n"
+        "{\"name\":\"dir/prog:b\",\"cat\":\"test\",\"ph\":\"X\",\"ts\":100,"
+        "\"dur\":100,\"pid\":1,\"tid\":1,\"args\":{\"pid\":12,\"slot\":0}}\n"
+        "]}\n",
+        output.str());
+}
+
+
+ATF_INIT_TEST_CASES(tcs)
+{
+    ATF_ADD_TEST_CASE(tcs, runs_in_slot);
+    ATF_ADD_TEST_CASE(tcs, write_trace__empty);
+    ATF_ADD_TEST_CASE(tcs, write_trace__slots);
+}
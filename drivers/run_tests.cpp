@@ -28,214 +28,3545 @@
 
 #include "drivers/run_tests.hpp"
 
+extern "C" {
+#include <sys/stat.h>
+
+#include <time.h>
+}
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <deque>
+#include <map>
+#include <memory>
+#include <set>
+#include <stdexcept>
 #include <utility>
+#include <vector>
+
+#include "engine/config.hpp"
+#include "engine/exceptions.hpp"
+#include "engine/filters.hpp"
+#include "engine/kyuafile.hpp"
+#include "engine/kyuafile_cache.hpp"
+#include "engine/list_cache.hpp"
+#include "engine/result_cache.hpp"
+#include "engine/scanner.hpp"
+#include "engine/scheduler.hpp"
+#include "model/context.hpp"
+#include "model/metadata.hpp"
+#include "model/test_case.hpp"
+#include "model/test_program.hpp"
+#include "model/test_result.hpp"
+#include "store/exceptions.hpp"
+#include "store/layout.hpp"
+#include "store/read_backend.hpp"
+#include "store/read_transaction.hpp"
+#include "store/trends.hpp"
+#include "store/upload.hpp"
+#include "store/write_backend.hpp"
+#include "store/write_transaction.hpp"
+#include "utils/config/tree.ipp"
+#include "utils/datetime.hpp"
+#include "utils/defs.hpp"
+#include "utils/format/macros.hpp"
+#include "utils/fs/exceptions.hpp"
+#include "utils/fs/operations.hpp"
+#include "utils/fs/path.hpp"
+#include "utils/latency_histogram.hpp"
+#include "utils/load.hpp"
+#include "utils/logging/macros.hpp"
+#include "utils/memory.hpp"
+#include "utils/noncopyable.hpp"
+#include "utils/optional.ipp"
+#include "utils/passwd.hpp"
+#include "utils/process/resource_usage.hpp"
+#include "utils/sanity.hpp"
+#include "utils/text/exceptions.hpp"
+#include "utils/text/operations.ipp"
+#include "utils/units.hpp"
+
+namespace config = utils::config;
+namespace datetime = utils::datetime;
+namespace fs = utils::fs;
+namespace passwd = utils::passwd;
+namespace scheduler = engine::scheduler;
+namespace text = utils::text;
+namespace units = utils::units;
+
+using utils::none;
+using utils::optional;
+
+
+namespace {
+
+
+/// Map of test program identifiers (relative paths and variant names) to their
+/// identifiers in the database.  We need to keep this in memory because test
+/// programs can be returned by the scanner in any order, and we only want to
+/// put each test program once.
+typedef std::map< std::pair< fs::path, std::string >, int64_t > path_to_id_map;
+
+
+/// Map of in-flight PIDs to their corresponding test case IDs.
+typedef std::map< int, int64_t > pid_to_id_map;
+
+
+/// Pair of PID to a test case ID.
+typedef pid_to_id_map::value_type pid_and_id_pair;
+
+
+/// Collection of PIDs of in-flight test program listings.
+typedef std::set< int > pids_set;
+
+
+/// Pair of a completed test's result handle and its test case ID.
+typedef std::pair< scheduler::result_handle_ptr, int64_t > finished_test_pair;
+
+
+/// Collection of completed tests whose results have not been stored yet.
+typedef std::vector< finished_test_pair > finished_tests_vector;
+
+
+/// Time between checkpoints if the results are uploaded and the user did not
+/// say when to checkpoint.
+static const datetime::delta default_upload_interval(60, 0);
+
+
+/// Cleans up the scheduler on scope exit unless it was done explicitly.
+///
+/// The run can fail half-way through, for example if the results cannot be
+/// stored, and the work directories of the test cases and the state of the
+/// interfaces must be released even then.
+class scheduler_cleaner : utils::noncopyable {
+    /// The scheduler to clean up; NULL once cleaned up.
+    scheduler::scheduler_handle* _handle;
+
+public:
+    /// Constructor.
+    ///
+    /// \param handle_ The scheduler to clean up.
+    explicit scheduler_cleaner(scheduler::scheduler_handle& handle_) :
+        _handle(&handle_)
+    {
+    }
+
+    /// Destructor; cleans up the scheduler if not yet done, ignoring errors.
+    ~scheduler_cleaner(void)
+    {
+        if (_handle != NULL) {
+            try {
+                _handle->cleanup();
+            } catch (const std::runtime_error& e) {
+                LW(F("Scheduler cleanup failed: %s") % e.what());
+            }
+        }
+    }
+
+    /// Cleans up the scheduler.
+    ///
+    /// \throw engine::error If the cleanup fails.
+    void
+    cleanup(void)
+    {
+        PRE(_handle != NULL);
+        scheduler::scheduler_handle* handle = _handle;
+        _handle = NULL;
+        handle->cleanup();
+    }
+};
+
+
+/// Commits the stored results periodically during long runs.
+///
+/// Checkpointing keeps the size of the store journal bounded, lets readers
+/// look at partial results while the run is still going, and limits the
+/// amount of results lost if the run is interrupted.  Every checkpoint is also
+/// the point at which the results get uploaded, if requested.
+class checkpointer : utils::noncopyable {
+    /// The database being written to.
+    store::write_backend& _db;
+
+    /// The transaction to checkpoint.
+    store::write_transaction& _tx;
+
+    /// The uploader of the results file; NULL if not uploading.
+    store::uploader* _uploader;
+
+    /// Number of results after which to checkpoint; 0 to disable.
+    std::size_t _max_results;
+
+    /// Time after which to checkpoint; zero to disable.
+    datetime::delta _max_delta;
+
+    /// Number of results stored since the last checkpoint.
+    std::size_t _pending;
+
+    /// Time of the last checkpoint.
+    datetime::timestamp _last;
+
+    /// Time taken by the checkpoints so far.
+    utils::latency_histogram _latency;
+
+public:
+    /// Constructor.
+    ///
+    /// \param db_ The database being written to.
+    /// \param tx_ The transaction to checkpoint.
+    /// \param uploader_ The uploader to feed at every checkpoint, or NULL.
+    /// \param user_config The end-user configuration properties, which
+    ///     specify when to checkpoint.
+    checkpointer(store::write_backend& db_, store::write_transaction& tx_,
+                 store::uploader* uploader_, const config::tree& user_config) :
+        _db(db_),
+        _tx(tx_),
+        _uploader(uploader_),
+        _max_results(0),
+        _pending(0),
+        _last(datetime::timestamp::now())
+    {
+        if (user_config.is_set("store_checkpoint_results"))
+            _max_results = user_config.lookup< config::positive_int_node >(
+                "store_checkpoint_results");
+        if (user_config.is_set("store_checkpoint_seconds"))
+            _max_delta = datetime::delta(
+                user_config.lookup< config::positive_int_node >(
+                    "store_checkpoint_seconds"), 0);
+        if (_uploader != NULL && _max_results == 0 &&
+            _max_delta == datetime::delta())
+            _max_delta = default_upload_interval;
+    }
+
+    /// Accounts for a stored result and checkpoints if necessary.
+    ///
+    /// \throw store::error If the checkpoint fails.
+    void
+    got_result(void)
+    {
+        ++_pending;
+        if (_max_results == 0 && _max_delta == datetime::delta())
+            return;
+
+        const datetime::timestamp now = datetime::timestamp::now();
+        if ((_max_results > 0 && _pending >= _max_results) ||
+            (_max_delta != datetime::delta() && now - _last >= _max_delta)) {
+            LD(F("Checkpointing store after %s results") % _pending);
+            _tx.checkpoint();
+            const datetime::timestamp end = datetime::timestamp::now();
+            _tx.put_run_event("checkpoint", F("%s results") % _pending, none,
+                              now, end);
+            _latency.record_interval(now, end);
+            _pending = 0;
+            _last = now;
+
+            if (_uploader != NULL) {
+                try {
+                    (void)_uploader->checkpoint(_db.database());
+                } catch (const store::error& e) {
+                    LW(F("Failed to upload checkpoint: %s") % e.what());
+                }
+            }
+        }
+    }
+
+    /// Gets the time taken by the checkpoints so far.
+    ///
+    /// \return A histogram of the duration of the checkpoints.
+    const utils::latency_histogram&
+    latency(void) const
+    {
+        return _latency;
+    }
+};
+
+
+/// Minimum time between two consecutive reports of the metrics of a run.
+static const datetime::delta metrics_interval(1, 0);
+
+
+/// Hooks that track the metrics of the run before delegating to the caller's.
+class metrics_tracker : public drivers::run_tests::base_hooks,
+                        utils::noncopyable {
+    /// The hooks provided by the caller of the driver.
+    drivers::run_tests::base_hooks& _hooks;
+
+    /// Metrics collected so far.
+    drivers::run_tests::metrics _metrics;
+
+    /// Size of the test case output stored so far, in bytes.
+    uint64_t _output_size;
+
+    /// Time of the last report of the metrics; none if there has been none.
+    optional< datetime::timestamp > _last_report;
+
+    /// Start times of the test cases whose processing has begun and that have
+    /// no result yet.
+    std::map< engine::test_case_id, datetime::timestamp > _running_since;
+
+    /// Predicts the time until all test cases complete.
+    ///
+    /// \param slots The number of test cases that can run concurrently.
+    /// \param scanner The scanner yielding the test cases to run.
+    /// \param exclusive The exclusive test cases deferred to the end.
+    /// \param next_exclusive Index of the first exclusive test case of the
+    ///     current round that has not started yet.
+    /// \param now The current time.
+    void
+    predict(std::size_t slots, const engine::scanner& scanner,
+            const std::vector< engine::scan_result >& exclusive,
+            const std::size_t next_exclusive, const datetime::timestamp& now)
+    {
+        _metrics.predicted_remaining = datetime::delta();
+        _metrics.critical_test_case.clear();
+        _metrics.critical_duration = datetime::delta();
+
+        std::vector< datetime::delta > running;
+        for (std::map< engine::test_case_id, datetime::timestamp >::
+                 const_iterator iter = _running_since.begin();
+             iter != _running_since.end(); ++iter) {
+            const optional< datetime::delta > expected =
+                scanner.expected_duration((*iter).first);
+            if (!expected)
+                continue;
+            const datetime::delta elapsed = now - (*iter).second;
+            const datetime::delta remaining = elapsed < expected.get() ?
+                datetime::delta::from_microseconds(
+                    expected.get().to_microseconds() -
+                    elapsed.to_microseconds()) : datetime::delta();
+            running.push_back(remaining);
+            account_critical((*iter).first, remaining);
+        }
+
+        std::vector< datetime::delta > queued;
+        const engine::durations_map durations = scanner.remaining_durations();
+        for (engine::durations_map::const_iterator iter = durations.begin();
+             iter != durations.end(); ++iter) {
+            queued.push_back((*iter).second);
+            account_critical((*iter).first, (*iter).second);
+        }
+
+        // Exclusive test cases run one at a time once everything else is done.
+        datetime::delta sequential;
+        for (std::size_t i = next_exclusive; i < exclusive.size(); ++i) {
+            const engine::test_case_id id(
+                exclusive[i].first->relative_path(), exclusive[i].second);
+            const optional< datetime::delta > expected =
+                scanner.expected_duration(id);
+            if (!expected)
+                continue;
+            sequential += expected.get();
+            account_critical(id, expected.get());
+        }
+
+        if (slots < running.size())
+            slots = running.size();
+        _metrics.predicted_remaining = engine::predict_makespan(
+            slots, running, queued) + sequential;
+    }
+
+    /// Records a test case as the critical one if it is the longest so far.
+    ///
+    /// \param id The test case to account for.
+    /// \param remaining The expected remaining time of the test case.
+    void
+    account_critical(const engine::test_case_id& id,
+                     const datetime::delta& remaining)
+    {
+        if (_metrics.critical_duration < remaining) {
+            _metrics.critical_test_case = F("%s:%s") % id.first % id.second;
+            _metrics.critical_duration = remaining;
+        }
+    }
+
+public:
+    /// Constructor.
+    ///
+    /// \param hooks_ The hooks provided by the caller of the driver.
+    explicit metrics_tracker(drivers::run_tests::base_hooks& hooks_) :
+        _hooks(hooks_),
+        _output_size(0)
+    {
+    }
+
+    /// Called when the processing of a test case begins.
+    ///
+    /// \param test_program The test program containing the test case.
+    /// \param test_case_name The name of the test case being executed.
+    void
+    got_test_case(const model::test_program& test_program,
+                  const std::string& test_case_name)
+    {
+        ++_metrics.started;
+        const engine::test_case_id id(test_program.relative_path(),
+                                      test_case_name);
+        _running_since.erase(id);
+        _running_since.insert(std::make_pair(id, datetime::timestamp::now()));
+        _hooks.got_test_case(test_program, test_case_name);
+    }
+
+    /// Called when a result of a test case becomes available.
+    ///
+    /// \param test_program The test program containing the test case.
+    /// \param test_case_name The name of the executed test case.
+    /// \param result The result of the execution of the test case.
+    /// \param duration The time it took to run the test.
+    void
+    got_result(const model::test_program& test_program,
+               const std::string& test_case_name,
+               const model::test_result& result,
+               const datetime::delta& duration)
+    {
+        ++_metrics.results[result.type()];
+        _running_since.erase(engine::test_case_id(test_program.relative_path(),
+                                                  test_case_name));
+        _hooks.got_result(test_program, test_case_name, result, duration);
+    }
+
+    /// Provides the receiver of the events of the scheduler.
+    ///
+    /// \return The observer of the caller's hooks.
+    engine::scheduler::observer*
+    scheduler_observer(void)
+    {
+        return _hooks.scheduler_observer();
+    }
+
+    /// Checks whether the caller's hooks want to be polled while waiting.
+    ///
+    /// \return True if poll() has to be called periodically.
+    bool
+    wants_polling(void)
+    {
+        return _hooks.wants_polling();
+    }
+
+    /// Lets the caller's hooks do periodic work while waiting for tests.
+    void
+    poll(void)
+    {
+        _hooks.poll();
+    }
+
+    /// Checks whether the caller's hooks feed the test programs to run.
+    ///
+    /// \return True if the test programs have to wait to be fed.
+    bool
+    feeds_test_programs(void)
+    {
+        return _hooks.feeds_test_programs();
+    }
+
+    /// Collects the test programs fed by the caller's hooks.
+    ///
+    /// \param [out] paths The paths to the fed test programs.
+    /// \param wait Whether to block until there is any path.
+    ///
+    /// \return False once the feed has ended; true otherwise.
+    bool
+    feed_test_programs(std::vector< fs::path >& paths, const bool wait)
+    {
+        return _hooks.feed_test_programs(paths, wait);
+    }
+
+    /// Checks whether the caller's hooks changed the configuration.
+    ///
+    /// \param [out] user_config The new end-user configuration properties.
+    ///
+    /// \return True if user_config was replaced.
+    bool
+    reload_config(config::tree& user_config)
+    {
+        return _hooks.reload_config(user_config);
+    }
+
+    /// Accounts for the output of a test case stored in the results file.
+    ///
+    /// \param size The size of the output.
+    void
+    got_output(const uint64_t size)
+    {
+        _output_size += size;
+    }
+
+    /// Reports the metrics to the caller's hooks if it is time to do so.
+    ///
+    /// \param handle The scheduler handle running the tests.
+    /// \param running Number of test cases and listings currently running.
+    /// \param slots The number of test cases that can run concurrently.
+    /// \param scanner The scanner yielding the test cases to run.
+    /// \param exclusive The exclusive test cases deferred to the end.
+    /// \param next_exclusive Index of the first exclusive test case of the
+    ///     current round that has not started yet.
+    /// \param checkpoints Tracker of the checkpoints of the results file.
+    /// \param force Whether to report the metrics regardless of the time
+    ///     elapsed since the last report.
+    void
+    report(const scheduler::scheduler_handle& handle,
+           const std::size_t running,
+           const std::size_t slots,
+           const engine::scanner& scanner,
+           const std::vector< engine::scan_result >& exclusive,
+           const std::size_t next_exclusive,
+           const checkpointer& checkpoints,
+           const bool force)
+    {
+        const datetime::timestamp now = datetime::timestamp::now();
+        if (!force && _last_report &&
+            now - _last_report.get() < metrics_interval)
+            return;
+        _last_report = now;
+
+        _metrics.timestamp = now;
+        _metrics.running = running;
+        _metrics.pending_test_programs = scanner.pending_test_programs();
+        _metrics.queued_test_cases = scanner.queued_test_cases();
+        const utils::latency_histograms_map& latencies = handle.latencies();
+        const utils::latency_histograms_map::const_iterator spawn =
+            latencies.find("spawn");
+        if (spawn != latencies.end())
+            _metrics.spawn_latency = (*spawn).second;
+        _metrics.checkpoint_latency = checkpoints.latency();
+        _metrics.output_size = units::bytes(_output_size);
+        predict(slots, scanner, exclusive, next_exclusive, now);
+        _hooks.got_metrics(_metrics);
+    }
+};
+
+
+/// Accounts for the use of the execution slots over the run.
+///
+/// The run is split in intervals during which the number of busy slots and
+/// the activity of the driver are constant.  The busy slots are accounted for
+/// as running tests or listings, and the idle slots as spent in the activity
+/// of the driver, which is what they are waiting for.  During the exclusive
+/// phase, all but one of the slots are idle because of the exclusive tests.
+class slot_usage : utils::noncopyable {
+    /// Number of slots available to the run.
+    const std::size_t _slots;
+
+    /// Time at which the current interval started.
+    datetime::timestamp _since;
+
+    /// Activity of the driver during the current interval.
+    std::string _activity;
+
+    /// Number of slots running tests during the current interval.
+    std::size_t _tests;
+
+    /// Number of slots running listings during the current interval.
+    std::size_t _lists;
+
+    /// Whether the exclusive tests are running.
+    bool _exclusive;
+
+    /// Time spent by all the slots in each activity so far.
+    std::map< std::string, datetime::delta > _usage;
+
+    /// Accounts for the current interval and starts a new one.
+    void
+    close(void)
+    {
+        const datetime::timestamp now = datetime::timestamp::now();
+        const datetime::delta elapsed = now - _since;
+        _since = now;
+
+        std::size_t idle = _slots - std::min(_slots, _tests + _lists);
+        if (_tests > 0)
+            _usage["test"] += elapsed * _tests;
+        if (_lists > 0)
+            _usage["list"] += elapsed * _lists;
+        if (_exclusive && idle > 0) {
+            const std::size_t blocked = std::min(idle, _slots - 1);
+            if (blocked > 0)
+                _usage["exclusive"] += elapsed * blocked;
+            idle -= blocked;
+        }
+        if (idle > 0)
+            _usage[_activity] += elapsed * idle;
+    }
+
+public:
+    /// Constructor.
+    ///
+    /// \param slots_ Number of slots available to the run.
+    explicit slot_usage(const std::size_t slots_) :
+        _slots(slots_),
+        _since(datetime::timestamp::now()),
+        _activity("idle"),
+        _tests(0),
+        _lists(0),
+        _exclusive(false)
+    {
+    }
+
+    /// Records a change in the activity of the driver.
+    ///
+    /// \param activity The new activity, such as "store" or "cleanup".
+    ///
+    /// \return The previous activity.
+    std::string
+    enter(const std::string& activity)
+    {
+        close();
+        const std::string previous = _activity;
+        _activity = activity;
+        return previous;
+    }
+
+    /// Records a change in the number of busy slots.
+    ///
+    /// \param tests Number of slots running tests.
+    /// \param lists Number of slots running listings.
+    void
+    set_busy(const std::size_t tests, const std::size_t lists)
+    {
+        close();
+        _tests = tests;
+        _lists = lists;
+    }
+
+    /// Records the start of the exclusive phase of the run.
+    void
+    start_exclusive(void)
+    {
+        close();
+        _exclusive = true;
+    }
+
+    /// Gets the use of the slots up to now.
+    ///
+    /// \return The time spent by all the slots in each activity.
+    const std::map< std::string, datetime::delta >&
+    usage(void)
+    {
+        close();
+        return _usage;
+    }
+};
+
+
+/// Tracks the failed test cases to stop the run once there are too many.
+class failures_limit : utils::noncopyable {
+    /// Number of failed test cases after which to stop; none for no limit.
+    const optional< std::size_t > _max_failures;
+
+    /// Number of failed test cases so far.
+    std::size_t _failures;
+
+public:
+    /// Constructor.
+    ///
+    /// \param max_failures_ Number of failed test cases after which to stop;
+    ///     none to run all test cases regardless of their results.
+    explicit failures_limit(const optional< std::size_t >& max_failures_) :
+        _max_failures(max_failures_),
+        _failures(0)
+    {
+        PRE(!_max_failures || _max_failures.get() > 0);
+    }
+
+    /// Accounts for the result of a test case.
+    ///
+    /// \param result The result of the test case.
+    void
+    got_result(const model::test_result& result)
+    {
+        if (result.good())
+            return;
+        ++_failures;
+        if (_max_failures && _failures == _max_failures.get())
+            LI(F("Reached the limit of %s failed test cases; stopping") %
+               _failures);
+    }
+
+    /// Checks whether the run has to stop.
+    ///
+    /// \return True if no more test cases have to be started.
+    bool
+    reached(void) const
+    {
+        return _max_failures && _failures >= _max_failures.get();
+    }
+};
+
+
+/// Tracks the test programs whose test cases keep breaking in the same way.
+///
+/// A test program that is unusable as a whole, for example because it cannot
+/// load a shared library, breaks in every one of its test cases for the same
+/// reason.  Once enough consecutive test cases of a program have broken with an
+/// identical reason, the rest of them are deemed broken without running them.
+class broken_programs : utils::noncopyable {
+    /// Consecutive broken results of a test program with the same reason.
+    struct streak {
+        /// The reason of the broken results.
+        std::string reason;
+
+        /// Number of consecutive results with the reason.
+        std::size_t count;
+
+        /// Constructor.
+        streak(void) : count(0) {}
+    };
+
+    /// Length of the streak that trips a test program; none to never trip.
+    optional< std::size_t > _threshold;
+
+    /// Current streak of each test program that has broken results.
+    std::map< model::test_program_ptr, streak > _streaks;
+
+public:
+    /// Constructor.
+    ///
+    /// \param user_config The end-user configuration properties.
+    explicit broken_programs(const config::tree& user_config)
+    {
+        if (user_config.is_set("max_consecutive_broken"))
+            _threshold = user_config.lookup< config::positive_int_node >(
+                "max_consecutive_broken");
+    }
+
+    /// Accounts for the result of a test case.
+    ///
+    /// \param test_program The test program containing the test case.
+    /// \param result The result of the test case.
+    void
+    got_result(const model::test_program_ptr& test_program,
+               const model::test_result& result)
+    {
+        if (!_threshold)
+            return;
+
+        if (result.type() != model::test_result_broken) {
+            _streaks.erase(test_program);
+            return;
+        }
+
+        streak& current = _streaks[test_program];
+        if (current.count > 0 && current.reason == result.reason()) {
+            ++current.count;
+        } else {
+            current.reason = result.reason();
+            current.count = 1;
+        }
+        if (current.count == _threshold.get())
+            LI(F("%s consecutive test cases of %s broke; deeming the rest "
+                 "broken") % current.count % test_program->relative_path());
+    }
+
+    /// Checks whether the test cases of a test program have to be run.
+    ///
+    /// \param test_program The test program to check.
+    ///
+    /// \return The broken result for the remaining test cases of the program,
+    /// or none if they have to run.
+    optional< model::test_result >
+    result_for(const model::test_program_ptr& test_program) const
+    {
+        if (!_threshold)
+            return none;
+
+        const std::map< model::test_program_ptr, streak >::const_iterator
+            iter = _streaks.find(test_program);
+        if (iter == _streaks.end() || (*iter).second.count < _threshold.get())
+            return none;
+        return utils::make_optional(model::test_result(
+            model::test_result_broken,
+            F("Not run; the previous %s test cases of the test program broke "
+              "with: %s") % (*iter).second.count % (*iter).second.reason));
+    }
+};
+
+
+/// Warms up the files of the test programs that are going to run next.
+///
+/// Executing a test program from slow storage, such as a network file system,
+/// can take long enough the first time to inflate the duration of its first
+/// test case or to even make it time out.  Reading the binaries and the
+/// required files of the upcoming test programs ahead of time hides this
+/// latency behind the tests that are already running.
+class program_prefetcher : utils::noncopyable {
+    /// Number of upcoming test programs to prefetch; none to disable.
+    optional< std::size_t > _depth;
+
+    /// Test programs whose files have already been prefetched.
+    std::set< model::test_program_ptr > _prefetched;
+
+public:
+    /// Constructor.
+    ///
+    /// \param user_config The end-user configuration properties.
+    explicit program_prefetcher(const config::tree& user_config)
+    {
+        if (user_config.is_set("prefetch_programs"))
+            _depth = user_config.lookup< config::positive_int_node >(
+                "prefetch_programs");
+    }
+
+    /// Prefetches the files of the test programs that are going to run next.
+    ///
+    /// \param scanner The scanner yielding the test cases to run.
+    void
+    look_ahead(const engine::scanner& scanner)
+    {
+        if (!_depth)
+            return;
+
+        const model::test_programs_vector upcoming =
+            scanner.upcoming_test_programs(_depth.get());
+        for (model::test_programs_vector::const_iterator iter =
+                 upcoming.begin(); iter != upcoming.end(); ++iter) {
+            if (!_prefetched.insert(*iter).second)
+                continue;
+
+            (void)fs::prefetch((*iter)->absolute_path());
+            const model::paths_set& required_files =
+                (*iter)->get_metadata().required_files();
+            for (model::paths_set::const_iterator iter2 =
+                     required_files.begin(); iter2 != required_files.end();
+                 ++iter2)
+                (void)fs::prefetch(*iter2);
+        }
+    }
+};
+
+
+/// Releases the test cases of the test programs that are done.
+///
+/// The test programs of a test suite, and the lists of test cases that they
+/// load, are kept alive for the whole run.  With huge test suites, these lists
+/// can take gigabytes of memory, so this releases them as soon as every test
+/// case of a test program has been dispatched and its final result stored.
+/// The store only needs the identifiers of the test programs afterwards, which
+/// test_ids_cache keeps by path.
+class test_cases_releaser : utils::noncopyable {
+    /// Whether to release the test cases at all.
+    bool _enabled;
+
+    /// The scanner yielding the test cases to run.
+    const engine::scanner& _scanner;
+
+    /// Number of test cases of every test program still awaiting a result.
+    std::map< model::test_program_ptr, std::size_t > _remaining;
+
+public:
+    /// Constructor.
+    ///
+    /// \param user_config The end-user configuration properties.
+    /// \param scanner_ The scanner yielding the test cases to run.
+    /// \param repeating Whether the test cases are going to run again once the
+    ///     scanner is done, in which case their test programs are needed until
+    ///     the end of the run.
+    test_cases_releaser(const config::tree& user_config,
+                        const engine::scanner& scanner_,
+                        const bool repeating) :
+        _enabled(!repeating && user_config.is_set("release_test_cases") &&
+                 user_config.lookup< config::bool_node >(
+                     "release_test_cases")),
+        _scanner(scanner_)
+    {
+    }
+
+    /// Accounts for a test case yielded by the scanner.
+    ///
+    /// \param match The test program and the test case yielded.
+    void
+    yielded(const engine::scan_result& match)
+    {
+        if (!_enabled || _remaining.find(match.first) != _remaining.end())
+            return;
+        // The first test case of a test program tells how many more the
+        // scanner is going to yield, as all of them are queued by then.
+        _remaining[match.first] =
+            1 + _scanner.queued_test_cases(match.first).size();
+    }
+
+    /// Accounts for a test case that does not need its test program any more.
+    ///
+    /// \param test_program The test program of the test case.
+    void
+    done(const model::test_program_ptr& test_program)
+    {
+        if (!_enabled)
+            return;
+
+        const std::map< model::test_program_ptr, std::size_t >::iterator iter =
+            _remaining.find(test_program);
+        PRE(iter != _remaining.end() && (*iter).second > 0);
+        if (--(*iter).second > 0)
+            return;
+        _remaining.erase(iter);
+
+        const scheduler::lazy_test_program* lazy =
+            dynamic_cast< const scheduler::lazy_test_program* >(
+                test_program.get());
+        if (lazy != NULL) {
+            LD(F("Releasing the test cases of %s") %
+               test_program->relative_path());
+            lazy->release_test_cases();
+        }
+    }
+};
+
+
+/// Schedules the further rounds of the test cases when repeating the run.
+///
+/// Every test case that gets to run in the first round, which is driven by the
+/// scanner, is recorded here and run again in every further round.  Rounds go
+/// through all of the recorded test cases in order before starting over, so
+/// the repetitions of a test case are interleaved with those of the others
+/// across the execution slots instead of running back to back: this maximizes
+/// the contention that makes flaky tests fail.
+class repeats_queue : utils::noncopyable {
+    /// Total number of rounds to run; 0 for no limit.
+    const std::size_t _rounds;
+
+    /// Whether to stop starting repetitions after the first bad result.
+    const bool _until_fail;
+
+    /// Whether a bad result has stopped the repetitions.
+    bool _stopped;
+
+    /// Test cases to run in every round.
+    std::vector< engine::scan_result > _tests;
+
+    /// Number of rounds that have been fully scheduled so far.
+    std::size_t _round;
+
+    /// Index into _tests of the next test case to run within the round.
+    std::size_t _next;
+
+public:
+    /// Constructor.
+    ///
+    /// \param rounds_ Number of times to run every test case; 0 for no limit.
+    /// \param until_fail_ Whether to stop starting repetitions after the first
+    ///     test case that does not pass.
+    repeats_queue(const std::size_t rounds_, const bool until_fail_) :
+        _rounds(rounds_),
+        _until_fail(until_fail_),
+        _stopped(false),
+        _round(1),
+        _next(0)
+    {
+        PRE(_rounds > 0 || _until_fail);
+    }
+
+    /// Checks whether the test cases have to be run more than once.
+    ///
+    /// \return True if repeating; false for a regular run.
+    bool
+    enabled(void) const
+    {
+        return _rounds != 1;
+    }
+
+    /// Records a test case started by the first round.
+    ///
+    /// \param match Test program and test case that started.
+    void
+    add(const engine::scan_result& match)
+    {
+        if (enabled())
+            _tests.push_back(match);
+    }
+
+    /// Accounts for the result of a test case.
+    ///
+    /// \param result The result of the test case.
+    void
+    got_result(const model::test_result& result)
+    {
+        if (_until_fail && !result.good() && !_stopped) {
+            LI("Got a bad result; not starting any further repetitions");
+            _stopped = true;
+        }
+    }
+
+    /// Checks whether a given round of the exclusive test cases has to run.
+    ///
+    /// The first round always runs to completion, even after a bad result:
+    /// --until-fail only stops the repetitions, and the exclusive test cases
+    /// must get to run at least once like every other test case.
+    ///
+    /// \param round Zero-based number of the round.
+    ///
+    /// \return True if the round has to run.
+    bool
+    wants_round(const std::size_t round) const
+    {
+        return round == 0 || (!_stopped && (_rounds == 0 || round < _rounds));
+    }
+
+    /// Checks whether any repetitions are waiting to start.
+    ///
+    /// \return True if next() can be called.
+    bool
+    has_pending(void) const
+    {
+        return !_tests.empty() && wants_round(_round);
+    }
+
+    /// Gets the next repetition to start.
+    ///
+    /// \pre has_pending() must be true.
+    ///
+    /// \return Test program and test case to run.
+    engine::scan_result
+    next(void)
+    {
+        PRE(has_pending());
+        const engine::scan_result match = _tests[_next];
+        ++_next;
+        if (_next == _tests.size()) {
+            _next = 0;
+            ++_round;
+        }
+        return match;
+    }
+};
+
+
+/// Decides how many test cases can run concurrently.
+///
+/// With a fixed parallelism, the number of execution slots never changes.  With
+/// the automatic parallelism, the number of slots starts at the configured
+/// minimum and is reconsidered as tests complete, at most once per sampling
+/// period: a slot is added while all slots are busy and the host has spare CPU
+/// capacity, and a slot is removed while the host is overloaded.  Removing a
+/// slot never interrupts running tests; it just delays starting new ones.
+///
+/// The load of the host comes from the CPU pressure stall information where
+/// available, as it reacts within seconds, and from the 1-minute load average
+/// relative to the number of CPUs otherwise.
+///
+/// The parallelism settings can be reconfigured while the run progresses,
+/// within the capacity the run started with: parallelism_max if set, or the
+/// initial number of slots otherwise.  Lowering the number of slots drains the
+/// extra ones as their tests complete, and raising it fills the new ones as
+/// soon as the driver gets to spawn tests again.
+class parallelism_controller : utils::noncopyable {
+    /// Minimum time between two adjustments of the number of slots.
+    static const datetime::delta sampling_period;
+
+    /// Largest number of slots that the run can ever use.
+    std::size_t _capacity;
+
+    /// Fewest number of slots to use.
+    std::size_t _min;
+
+    /// Largest number of slots to use.
+    std::size_t _max;
+
+    /// Current number of slots.
+    std::size_t _slots;
+
+    /// Time of the last adjustment.
+    datetime::timestamp _last;
+
+    /// Computes the direction in which to adjust the number of slots.
+    ///
+    /// \return A positive number if the host has spare CPU capacity, a negative
+    /// number if the host is overloaded, or 0 otherwise or if the load of the
+    /// host is unknown.
+    static int
+    sample_host(void)
+    {
+        const optional< double > pressure = utils::cpu_pressure();
+        if (pressure) {
+            LD(F("CPU pressure is %s%%") % pressure.get());
+            if (pressure.get() < 5.0)
+                return 1;
+            else if (pressure.get() > 25.0)
+                return -1;
+            else
+                return 0;
+        }
+
+        const optional< double > load = utils::load_average();
+        if (load) {
+            const double per_cpu = load.get() / utils::online_cpus();
+            LD(F("Load average is %s per CPU") % per_cpu);
+            if (per_cpu < 0.75)
+                return 1;
+            else if (per_cpu > 1.25)
+                return -1;
+            else
+                return 0;
+        }
+
+        return 0;
+    }
+
+    /// Sets the bounds of the number of slots from the configuration.
+    ///
+    /// \param user_config The end-user configuration properties, which
+    ///     specify the parallelism and, if automatic, its bounds.
+    void
+    configure(const config::tree& user_config)
+    {
+        const std::size_t parallelism =
+            user_config.lookup< engine::parallelism_node >("parallelism");
+        if (parallelism > 0) {
+            _min = _max = parallelism;
+        } else {
+            _min = user_config.is_set("parallelism_min") ?
+                user_config.lookup< config::positive_int_node >(
+                    "parallelism_min") : 1;
+            _max = user_config.is_set("parallelism_max") ?
+                user_config.lookup< config::positive_int_node >(
+                    "parallelism_max") : utils::usable_cpus();
+            if (_max < _min) {
+                LW(F("parallelism_max (%s) is lower than parallelism_min "
+                     "(%s); using the latter") % _max % _min);
+                _max = _min;
+            }
+            LI(F("Using automatic parallelism between %s and %s slots") %
+               _min % _max);
+        }
+    }
+
+public:
+    /// Constructor.
+    ///
+    /// \param user_config The end-user configuration properties, which
+    ///     specify the parallelism and, if automatic, its bounds.
+    explicit parallelism_controller(const config::tree& user_config) :
+        _last(datetime::timestamp::now())
+    {
+        configure(user_config);
+        _capacity = _max;
+        if (user_config.is_set("parallelism_max"))
+            _capacity = std::max(_capacity, static_cast< std::size_t >(
+                user_config.lookup< config::positive_int_node >(
+                    "parallelism_max")));
+        _slots = _min;
+        INV(_min >= 1 && _min <= _max && _max <= _capacity);
+    }
+
+    /// Gets the largest number of slots that may ever be used.
+    ///
+    /// \return A number of slots.
+    std::size_t
+    max(void) const
+    {
+        return _capacity;
+    }
+
+    /// Gets the number of slots to fill right now.
+    ///
+    /// \return A number of slots.
+    std::size_t
+    slots(void) const
+    {
+        return _slots;
+    }
+
+    /// Reconsiders the number of slots after some tests completed.
+    ///
+    /// \param busy Number of slots in use before the tests completed.
+    void
+    adjust(const std::size_t busy)
+    {
+        if (_min == _max)
+            return;
+
+        const datetime::timestamp now = datetime::timestamp::now();
+        if (now - _last < sampling_period)
+            return;
+        _last = now;
+
+        const int direction = sample_host();
+        if (direction > 0 && busy >= _slots && _slots < _max) {
+            ++_slots;
+            LD(F("Growing parallelism to %s slots") % _slots);
+        } else if (direction < 0 && _slots > _min) {
+            --_slots;
+            LD(F("Shrinking parallelism to %s slots") % _slots);
+        }
+    }
+
+    /// Applies new parallelism settings to the rest of the run.
+    ///
+    /// Bounds above the capacity of the run are lowered to it.  The running
+    /// tests are never interrupted: if the number of slots goes down, the
+    /// extra slots just stop being refilled.
+    ///
+    /// \param user_config The new end-user configuration properties.
+    void
+    reconfigure(const config::tree& user_config)
+    {
+        configure(user_config);
+        if (_max > _capacity) {
+            LW(F("Cannot grow the parallelism past %s slots during the run; "
+                 "set parallelism_max to raise this limit") % _capacity);
+            _max = _capacity;
+            _min = std::min(_min, _capacity);
+        }
+        const std::size_t old_slots = _slots;
+        _slots = std::max(_min, std::min(_slots, _max));
+        if (_slots != old_slots)
+            LI(F("Changing parallelism from %s to %s slots") % old_slots %
+               _slots);
+        INV(_min >= 1 && _min <= _max && _max <= _capacity);
+    }
+};
+
+
+const datetime::delta parallelism_controller::sampling_period(1, 0);
+
+
+/// Gets the number of execution slots that a test occupies.
+///
+/// \param match The test to query.
+///
+/// \return The number of CPUs declared by the test, or 1 if it declares none.
+static std::size_t
+required_slots(const engine::scan_result& match)
+{
+    const int cpus = match.first->find(match.second).get_metadata()
+        .required_cpus();
+    return cpus > 1 ? static_cast< std::size_t >(cpus) : 1;
+}
+
+
+/// Pins the execution slots to disjoint sets of CPUs.
+///
+/// Slots are spread round-robin across the NUMA nodes of the host and the CPUs
+/// of each node are split evenly among the slots assigned to it, so that
+/// concurrent tests neither compete for the same processors nor bounce between
+/// the caches and the memory of different nodes.  Slots share CPUs only if
+/// there are more slots than CPUs in a node.
+///
+/// Every test takes the lowest free slots when it starts, as many as the CPUs
+/// it declares, and gives them back when it completes.  If CPU affinity is
+/// disabled, no slots exist and tests run on any CPU.
+class cpu_slots : utils::noncopyable {
+    /// Properties of an execution slot.
+    struct slot {
+        /// NUMA node the CPUs of the slot belong to.
+        int numa_node;
+
+        /// CPUs assigned to the slot.
+        std::set< int > cpus;
+    };
+
+    /// All the slots, indexed by their number.
+    std::vector< slot > _slots;
+
+    /// Numbers of the slots not in use.
+    std::set< std::size_t > _free;
+
+    /// Slots taken by the test being started, if any.
+    optional< std::vector< std::size_t > > _starting;
+
+    /// Slots held by the in-flight tests, keyed by their PID.
+    std::map< int, std::vector< std::size_t > > _in_flight;
+
+public:
+    /// Constructor.
+    ///
+    /// \param user_config The end-user configuration properties, which enable
+    ///     CPU affinity.
+    /// \param count Largest number of tests that may run concurrently.
+    cpu_slots(const config::tree& user_config, const std::size_t count)
+    {
+        PRE(count > 0);
+
+        if (!user_config.is_set("cpu_affinity") ||
+            !user_config.lookup< config::bool_node >("cpu_affinity"))
+            return;
+
+        const std::map< int, std::set< int > > nodes = utils::numa_nodes();
+        INV(!nodes.empty());
+        std::vector< std::map< int, std::set< int > >::const_iterator >
+            by_index;
+        for (std::map< int, std::set< int > >::const_iterator iter =
+                 nodes.begin(); iter != nodes.end(); ++iter)
+            by_index.push_back(iter);
+
+        _slots.resize(count);
+        for (std::size_t i = 0; i < by_index.size(); ++i) {
+            const std::vector< int > cpus(by_index[i]->second.begin(),
+                                          by_index[i]->second.end());
+            const std::size_t node_slots =
+                (count - i + by_index.size() - 1) / by_index.size();
+            for (std::size_t j = 0; j < node_slots; ++j) {
+                const std::size_t first = j * cpus.size() / node_slots;
+                const std::size_t last = std::max(
+                    first + 1, (j + 1) * cpus.size() / node_slots);
+                slot& s = _slots[i + j * by_index.size()];
+                s.numa_node = by_index[i]->first;
+                s.cpus.insert(cpus.begin() + first, cpus.begin() + last);
+            }
+        }
+
+        for (std::size_t i = 0; i < count; ++i) {
+            LI(F("Execution slot %s runs on NUMA node %s, CPUs %s") % i %
+               _slots[i].numa_node % utils::format_cpu_list(_slots[i].cpus));
+            _free.insert(i);
+        }
+    }
+
+    /// Takes free slots for a test that is about to start.
+    ///
+    /// The test gets fewer slots than requested if not enough are free, which
+    /// can only happen if the number of slots was reduced during the run.  The
+    /// slot recorded in the store is the first one taken.
+    ///
+    /// \param test_case_id Identifier of the test case in the store.
+    /// \param [in,out] tx Writable transaction to record the slot in.
+    /// \param count Number of slots the test needs.
+    ///
+    /// \return The CPUs on which to run the test; empty if CPU affinity is
+    /// disabled.
+    std::set< int >
+    acquire(const int64_t test_case_id, store::write_transaction& tx,
+            const std::size_t count)
+    {
+        PRE(!_starting);
+        PRE(count > 0);
+        if (_slots.empty())
+            return std::set< int >();
+
+        INV_MSG(!_free.empty(), "Ran out of execution slots");
+        std::vector< std::size_t > numbers;
+        std::set< int > cpus;
+        while (numbers.size() < count && !_free.empty()) {
+            const std::size_t number = *_free.begin();
+            _free.erase(_free.begin());
+            numbers.push_back(number);
+            cpus.insert(_slots[number].cpus.begin(),
+                        _slots[number].cpus.end());
+        }
+        _starting = numbers;
+
+        tx.put_cpu_affinity(static_cast< int >(numbers[0]),
+                            _slots[numbers[0]].numa_node, cpus, test_case_id);
+        return cpus;
+    }
+
+    /// Records the PID of the test that took the last acquired slots.
+    ///
+    /// \param pid PID of the test subprocess.
+    void
+    started(const int pid)
+    {
+        if (!_starting)
+            return;
+        _in_flight[pid] = _starting.get();
+        _starting = none;
+    }
+
+    /// Gives back the slots held by a test once it completes.
+    ///
+    /// \param pid PID of the test subprocess.
+    void
+    release(const int pid)
+    {
+        const std::map< int, std::vector< std::size_t > >::iterator iter =
+            _in_flight.find(pid);
+        if (iter == _in_flight.end())
+            return;
+        _free.insert((*iter).second.begin(), (*iter).second.end());
+        _in_flight.erase(iter);
+    }
+};
+
+
+/// Admits tests for execution based on their declared resource requirements.
+///
+/// Each test case may declare the memory and disk space it needs.  This class
+/// keeps track of the requirements of the in-flight tests and only admits new
+/// tests while the sum of all requirements fits in the configured budgets, so
+/// that running many heavy tests in parallel does not exhaust the machine.
+///
+/// Test cases may also declare the number of CPUs they use, in which case they
+/// occupy as many execution slots as CPUs while they run.  The extra slots are
+/// reserved here and count as busy for the caller.
+///
+/// Tests that do not fit are deferred and admitted in the order in which they
+/// were deferred; tests with no requirements are not deferred unless a test
+/// that waits for execution slots is at the front of the queue, as otherwise
+/// they would keep taking the slots as soon as they are freed.  A test whose
+/// requirements exceed the budget on their own is admitted once nothing else
+/// is running, as otherwise it would never run.
+class resources_budget : utils::noncopyable {
+    /// Requirements of a single test.
+    struct requirements_set {
+        /// Amount of memory needed by the test.
+        units::bytes memory;
+
+        /// Amount of disk space needed by the test.
+        units::bytes disk_space;
+
+        /// Execution slots needed by the test in addition to its own.
+        std::size_t extra_slots;
+
+        /// Checks if the test needs anything at all.
+        ///
+        /// \return True if the test has no requirements.
+        bool
+        empty(void) const
+        {
+            return memory == 0 && disk_space == 0 && extra_slots == 0;
+        }
+    };
+
+    /// Maximum amount of memory to hand out; zero for unlimited.
+    units::bytes _memory;
+
+    /// Maximum amount of disk space to hand out; zero for unlimited.
+    units::bytes _disk_space;
+
+    /// Amount of memory held by the in-flight tests.
+    uint64_t _used_memory;
+
+    /// Amount of disk space held by the in-flight tests.
+    uint64_t _used_disk_space;
+
+    /// Execution slots reserved by the in-flight tests beyond their own.
+    std::size_t _used_slots;
+
+    /// Current number of execution slots.
+    std::size_t _total_slots;
+
+    /// Execution slots not in use by the in-flight tests nor reserved.
+    std::size_t _free_slots;
+
+    /// Requirements of the in-flight tests, keyed by their PID.
+    std::map< int, requirements_set > _in_flight;
+
+    /// Tests waiting for resources to become available.
+    std::deque< engine::scan_result > _deferred;
+
+    /// Gets the requirements of a test, restricted to the enabled budgets.
+    ///
+    /// The number of slots is capped to the current number of slots so that
+    /// tests that declare more CPUs than available can still run.
+    ///
+    /// \param match The test to query.
+    ///
+    /// \return The requirements of the test.
+    requirements_set
+    requirements(const engine::scan_result& match) const
+    {
+        const model::metadata& md = match.first->find(
+            match.second).get_metadata();
+        requirements_set reqs;
+        reqs.memory = _memory == 0 ? units::bytes() : md.required_memory();
+        reqs.disk_space = _disk_space == 0 ? units::bytes() :
+            md.required_disk_space();
+        reqs.extra_slots = std::min(required_slots(match),
+                                    std::max(_total_slots,
+                                             std::size_t(1))) - 1;
+        return reqs;
+    }
+
+    /// Checks if a test fits in the remaining budget.
+    ///
+    /// \param match The test to check.
+    ///
+    /// \return True if the test can be started now.
+    bool
+    fits(const engine::scan_result& match) const
+    {
+        const requirements_set reqs = requirements(match);
+        if (reqs.extra_slots >= _free_slots)
+            return false;
+        if (_in_flight.empty())
+            return true;
+        return (_memory == 0 || _used_memory + reqs.memory <= _memory) &&
+            (_disk_space == 0 ||
+             _used_disk_space + reqs.disk_space <= _disk_space);
+    }
+
+    /// Checks if the test at the front of the queue waits for slots.
+    ///
+    /// \return True if light tests have to queue behind the deferred ones.
+    bool
+    waiting_for_slots(void) const
+    {
+        return !_deferred.empty() &&
+            requirements(_deferred.front()).extra_slots > 0;
+    }
+
+public:
+    /// Constructor.
+    ///
+    /// \param user_config The end-user configuration properties, which
+    ///     specify the budgets.  If no memory budget is configured, the
+    ///     physical memory of the machine is used.
+    explicit resources_budget(const config::tree& user_config) :
+        _memory(utils::physical_memory()),
+        _used_memory(0),
+        _used_disk_space(0),
+        _used_slots(0),
+        _total_slots(1),
+        _free_slots(1)
+    {
+        if (user_config.is_set("memory_budget"))
+            _memory = user_config.lookup< engine::bytes_node >(
+                "memory_budget");
+        if (user_config.is_set("disk_budget"))
+            _disk_space = user_config.lookup< engine::bytes_node >(
+                "disk_budget");
+        LD(F("Resources budget: memory %s, disk space %s") %
+           (_memory == 0 ? "unlimited" : _memory.format()) %
+           (_disk_space == 0 ? "unlimited" : _disk_space.format()));
+    }
+
+    /// Updates the number of execution slots available to new tests.
+    ///
+    /// \param free Number of slots neither running a test or listing nor
+    ///     reserved by a test.
+    /// \param total Current number of slots.
+    void
+    set_free_slots(const std::size_t free, const std::size_t total)
+    {
+        _free_slots = free;
+        _total_slots = total;
+    }
+
+    /// Gets the number of slots reserved by the in-flight tests.
+    ///
+    /// \return The slots taken by the in-flight tests beyond one per test.
+    std::size_t
+    reserved_slots(void) const
+    {
+        return _used_slots;
+    }
+
+    /// Checks whether any tests are waiting for resources.
+    ///
+    /// \return True if there are deferred tests.
+    bool
+    has_deferred(void) const
+    {
+        return !_deferred.empty();
+    }
+
+    /// Offers a test for admission.
+    ///
+    /// \param match The test to admit.
+    ///
+    /// \return True if the test can be started now; false if it has been
+    /// deferred until next_deferred() returns it.
+    bool
+    admit(const engine::scan_result& match)
+    {
+        const requirements_set reqs = requirements(match);
+        if (reqs.empty() && !waiting_for_slots())
+            return true;
+        if (_deferred.empty() && fits(match))
+            return true;
+        LD(F("Deferring test %s:%s until resources are available") %
+           match.first->relative_path() % match.second);
+        _deferred.push_back(match);
+        return false;
+    }
+
+    /// Checks if a test can start now without going through the queue.
+    ///
+    /// \param match The test to check.
+    ///
+    /// \return True if the test has no requirements or if it fits in the
+    /// remaining budget.
+    bool
+    can_start(const engine::scan_result& match) const
+    {
+        return requirements(match).empty() || fits(match);
+    }
+
+    /// Gets the next deferred test if it fits in the budget now.
+    ///
+    /// \return The test to start, if any.
+    optional< engine::scan_result >
+    next_deferred(void)
+    {
+        if (_deferred.empty() || !fits(_deferred.front()))
+            return none;
+        const engine::scan_result match = _deferred.front();
+        _deferred.pop_front();
+        return utils::make_optional(match);
+    }
+
+    /// Accounts for a started test.
+    ///
+    /// \param pid The PID of the test, used to release its resources later.
+    /// \param match The started test.
+    void
+    acquire(const int pid, const engine::scan_result& match)
+    {
+        const requirements_set reqs = requirements(match);
+        if (reqs.empty())
+            return;
+        _used_memory += reqs.memory;
+        _used_disk_space += reqs.disk_space;
+        _used_slots += reqs.extra_slots;
+        _in_flight.insert(std::make_pair(pid, reqs));
+    }
+
+    /// Accounts for a completed test.
+    ///
+    /// \param pid The PID of the test; may not have been acquired.
+    void
+    release(const int pid)
+    {
+        const std::map< int, requirements_set >::iterator iter =
+            _in_flight.find(pid);
+        if (iter == _in_flight.end())
+            return;
+        _used_memory -= (*iter).second.memory;
+        _used_disk_space -= (*iter).second.disk_space;
+        _used_slots -= (*iter).second.extra_slots;
+        _in_flight.erase(iter);
+    }
+};
+
+
+/// Name of the test suite variable that limits its concurrency.
+static const char* const max_parallel_variable = "max_parallel";
+
+
+/// Holds back the tests that conflict with other in-flight tests.
+///
+/// Tests that set the exclusive_group metadata property conflict only with the
+/// other tests in the same group, so they can run concurrently with any other
+/// tests.  Similarly, the tests of a test suite that sets the max_parallel
+/// variable in the configuration can only run that many at once, no matter
+/// the global parallelism.  This class keeps track of the groups and the
+/// suite slots that are in use and holds back the tests that do not fit until
+/// the current holders complete.
+class concurrency_limits : utils::noncopyable {
+    /// Maximum number of tests to run at once for the limited test suites.
+    std::map< std::string, std::size_t > _suite_limits;
+
+    /// Groups held by a test, either in flight or waiting for other resources.
+    std::set< std::string > _busy_groups;
+
+    /// Number of tests holding a slot of each limited test suite, either in
+    /// flight or waiting for other resources.
+    std::map< std::string, std::size_t > _busy_suites;
+
+    /// Tests in flight that hold a group or a suite slot, keyed by their PID.
+    std::map< int, engine::scan_result > _in_flight;
+
+    /// Tests waiting for their group or their test suite to become available.
+    std::deque< engine::scan_result > _waiting;
+
+    /// Gets the exclusive group of a test.
+    ///
+    /// \param match The test to query.
+    ///
+    /// \return The name of the group; empty if the test has none.
+    static const std::string&
+    group_of(const engine::scan_result& match)
+    {
+        return match.first->find(match.second).get_metadata()
+            .exclusive_group();
+    }
+
+    /// Checks whether a test can run next to the in-flight tests.
+    ///
+    /// \param match The test to check.
+    ///
+    /// \return True if neither the group nor the test suite of the test are
+    /// at their limit.
+    bool
+    fits(const engine::scan_result& match) const
+    {
+        const std::string& group = group_of(match);
+        if (!group.empty() && _busy_groups.find(group) != _busy_groups.end())
+            return false;
+
+        const std::map< std::string, std::size_t >::const_iterator limit =
+            _suite_limits.find(match.first->test_suite_name());
+        if (limit == _suite_limits.end())
+            return true;
+        const std::map< std::string, std::size_t >::const_iterator busy =
+            _busy_suites.find((*limit).first);
+        return busy == _busy_suites.end() || (*busy).second < (*limit).second;
+    }
+
+    /// Takes the group and the suite slot of a test.
+    ///
+    /// \param match The test, which must fit.
+    void
+    hold(const engine::scan_result& match)
+    {
+        PRE(fits(match));
+        const std::string& group = group_of(match);
+        if (!group.empty())
+            _busy_groups.insert(group);
+        if (has_suite_limit(match))
+            ++_busy_suites[match.first->test_suite_name()];
+    }
+
+public:
+    /// Constructor.
+    ///
+    /// \param test_programs The test programs of the run, whose test suites
+    ///     to look up the limits for.
+    /// \param user_config The end-user configuration properties, which hold the
+    ///     max_parallel variables of the test suites.
+    ///
+    /// \throw engine::error If the max_parallel variable of any test suite is
+    ///     not a positive integer.
+    concurrency_limits(const model::test_programs_vector& test_programs,
+                       const config::tree& user_config)
+    {
+        for (model::test_programs_vector::const_iterator iter =
+                 test_programs.begin(); iter != test_programs.end(); ++iter) {
+            const std::string& suite = (*iter)->test_suite_name();
+            const std::string key = F("test_suites.%s.%s") % suite %
+                max_parallel_variable;
+            if (_suite_limits.find(suite) != _suite_limits.end() ||
+                !user_config.is_set(key))
+                continue;
+
+            const std::string value = user_config.lookup_string(key);
+            int limit;
+            try {
+                limit = text::to_type< int >(value);
+            } catch (const text::value_error& unused_error) {
+                limit = 0;
+            }
+            if (limit <= 0)
+                throw engine::error(F("Invalid value '%s' for %s; must be a "
+                                      "positive integer") % value % key);
+            LI(F("Running at most %s test cases of test suite %s at once") %
+               limit % suite);
+            _suite_limits[suite] = static_cast< std::size_t >(limit);
+        }
+    }
+
+    /// Checks whether the test suite of a test limits its concurrency.
+    ///
+    /// \param match The test to query.
+    ///
+    /// \return True if the test suite sets max_parallel.
+    bool
+    has_suite_limit(const engine::scan_result& match) const
+    {
+        return _suite_limits.find(match.first->test_suite_name()) !=
+            _suite_limits.end();
+    }
+
+    /// Checks whether any tests are waiting for their group or test suite.
+    ///
+    /// \return True if there are waiting tests.
+    bool
+    has_waiting(void) const
+    {
+        return !_waiting.empty();
+    }
+
+    /// Claims the group and the suite slot of a test.
+    ///
+    /// \param match The test that wants to run.
+    ///
+    /// \return True if the test fits, in which case its group and suite slot
+    /// are now held by the test; false if the test has been queued until
+    /// next_unblocked() returns it.
+    bool
+    claim(const engine::scan_result& match)
+    {
+        if (fits(match)) {
+            hold(match);
+            return true;
+        }
+        LD(F("Deferring test %s:%s until its group or test suite is free") %
+           match.first->relative_path() % match.second);
+        _waiting.push_back(match);
+        return false;
+    }
+
+    /// Claims the group and the suite slot of a test without queuing it.
+    ///
+    /// \param match The test that wants to run.
+    ///
+    /// \return True if the test fits, in which case its group and suite slot
+    /// are now held by the test; false otherwise.
+    bool
+    try_claim(const engine::scan_result& match)
+    {
+        if (!fits(match))
+            return false;
+        hold(match);
+        return true;
+    }
+
+    /// Gets the oldest waiting test that now fits.
+    ///
+    /// \return The test to run, which now holds its group and suite slot, if
+    /// any.
+    optional< engine::scan_result >
+    next_unblocked(void)
+    {
+        for (std::deque< engine::scan_result >::iterator iter =
+                 _waiting.begin(); iter != _waiting.end(); ++iter) {
+            if (fits(*iter)) {
+                const engine::scan_result match = *iter;
+                _waiting.erase(iter);
+                hold(match);
+                return utils::make_optional(match);
+            }
+        }
+        return none;
+    }
+
+    /// Accounts for a started test.
+    ///
+    /// \param pid The PID of the test, used to release its group and suite
+    ///     slot later.
+    /// \param match The started test, which must have claimed them.
+    void
+    started(const int pid, const engine::scan_result& match)
+    {
+        if (group_of(match).empty() && !has_suite_limit(match))
+            return;
+        INV(group_of(match).empty() ||
+            _busy_groups.find(group_of(match)) != _busy_groups.end());
+        _in_flight.insert(std::make_pair(pid, match));
+    }
+
+    /// Accounts for a completed test.
+    ///
+    /// \param pid The PID of the test; may not hold anything.
+    void
+    release(const int pid)
+    {
+        const std::map< int, engine::scan_result >::iterator iter =
+            _in_flight.find(pid);
+        if (iter == _in_flight.end())
+            return;
+        const engine::scan_result& match = (*iter).second;
+        const std::string& group = group_of(match);
+        if (!group.empty())
+            _busy_groups.erase(group);
+        if (has_suite_limit(match)) {
+            std::size_t& busy = _busy_suites[match.first->test_suite_name()];
+            INV(busy > 0);
+            --busy;
+        }
+        _in_flight.erase(iter);
+    }
+};
+
+
+/// Reruns the test cases that fail, up to a limit, to paper over flakiness.
+///
+/// The number of retries of a test case comes from its max_retries metadata
+/// property or, if that is zero, from the max_retries configuration variable.
+/// Only failed and broken results are retried.  Each attempt but the last is
+/// recorded separately from the final result of the test case, which is the
+/// result of its last attempt.
+///
+/// Test cases that need another attempt wait in a queue until there is a free
+/// slot for them, so retries never hold back the tests that have not run yet
+/// for longer than a single test does.
+class retries_queue : utils::noncopyable {
+public:
+    /// A test case that is waiting for another attempt.
+    struct pending {
+        /// Test program and test case to rerun.
+        engine::scan_result match;
+
+        /// Identifier of the test case in the database.
+        int64_t test_case_id;
+
+        /// Number of the attempt that produced last_result.
+        int last_attempt;
+
+        /// Result of the previous attempt.
+        model::test_result last_result;
+
+        /// Start time of the previous attempt.
+        datetime::timestamp last_start_time;
+
+        /// End time of the previous attempt.
+        datetime::timestamp last_end_time;
+
+        /// Constructor.
+        ///
+        /// \param match_ Test program and test case to rerun.
+        /// \param test_case_id_ Identifier of the test case in the database.
+        /// \param last_attempt_ Number of the attempt that just completed.
+        /// \param last_result_ Result of the attempt that just completed.
+        /// \param last_start_time_ Start time of the completed attempt.
+        /// \param last_end_time_ End time of the completed attempt.
+        pending(const engine::scan_result& match_,
+                const int64_t test_case_id_,
+                const int last_attempt_,
+                const model::test_result& last_result_,
+                const datetime::timestamp& last_start_time_,
+                const datetime::timestamp& last_end_time_) :
+            match(match_),
+            test_case_id(test_case_id_),
+            last_attempt(last_attempt_),
+            last_result(last_result_),
+            last_start_time(last_start_time_),
+            last_end_time(last_end_time_)
+        {
+        }
+    };
+
+private:
+    /// Number of retries for test cases that do not set their own; 0 for none.
+    int _default_max_retries;
+
+    /// Attempt numbers of the in-flight retries, keyed by test case ID.
+    std::map< int64_t, int > _attempts;
+
+    /// Test cases waiting for another attempt.
+    std::deque< pending > _pending;
+
+public:
+    /// Constructor.
+    ///
+    /// \param user_config The end-user configuration properties, which
+    ///     specify the default number of retries.
+    explicit retries_queue(const config::tree& user_config) :
+        _default_max_retries(0)
+    {
+        if (user_config.is_set("max_retries"))
+            _default_max_retries = user_config.lookup<
+                config::positive_int_node >("max_retries");
+    }
+
+    /// Gets the number of the attempt of an in-flight test case.
+    ///
+    /// \param test_case_id Identifier of the test case in the database.
+    ///
+    /// \return The attempt number, starting at 1.
+    int
+    attempt_of(const int64_t test_case_id) const
+    {
+        const std::map< int64_t, int >::const_iterator iter = _attempts.find(
+            test_case_id);
+        return iter == _attempts.end() ? 1 : (*iter).second;
+    }
+
+    /// Offers the result of an attempt for a retry.
+    ///
+    /// \param match Test program and test case that completed.
+    /// \param test_case_id Identifier of the test case in the database.
+    /// \param result Result of the attempt.
+    /// \param start_time Start time of the attempt.
+    /// \param end_time End time of the attempt.
+    ///
+    /// \return True if the test case has been queued for another attempt, in
+    /// which case result is not final; false otherwise.
+    bool
+    offer(const engine::scan_result& match, const int64_t test_case_id,
+          const model::test_result& result,
+          const datetime::timestamp& start_time,
+          const datetime::timestamp& end_time)
+    {
+        const int attempt = attempt_of(test_case_id);
+        if (result.type() != model::test_result_failed &&
+            result.type() != model::test_result_broken) {
+            _attempts.erase(test_case_id);
+            return false;
+        }
+
+        int max_retries = match.first->find(match.second).get_metadata()
+            .max_retries();
+        if (max_retries == 0)
+            max_retries = _default_max_retries;
+        if (attempt > max_retries) {
+            _attempts.erase(test_case_id);
+            return false;
+        }
+
+        LI(F("Attempt %s of %s:%s did not pass (%s); retrying") % attempt %
+           match.first->relative_path() % match.second % result);
+        _pending.push_back(pending(match, test_case_id, attempt, result,
+                                   start_time, end_time));
+        return true;
+    }
+
+    /// Checks whether any test cases are waiting for another attempt.
+    ///
+    /// \return True if there are pending retries.
+    bool
+    has_pending(void) const
+    {
+        return !_pending.empty();
+    }
+
+    /// Gets the oldest test case waiting for another attempt.
+    ///
+    /// \pre has_pending() must be true.
+    ///
+    /// \return The pending retry.
+    const pending&
+    front(void) const
+    {
+        PRE(!_pending.empty());
+        return _pending.front();
+    }
+
+    /// Removes the oldest pending retry and accounts for its new attempt.
+    ///
+    /// \pre has_pending() must be true.
+    void
+    started_front(void)
+    {
+        PRE(!_pending.empty());
+        const pending& retry = _pending.front();
+        _attempts[retry.test_case_id] = retry.last_attempt + 1;
+        _pending.pop_front();
+    }
+
+    /// Gives up on all pending retries.
+    ///
+    /// The result of the last attempt of each pending test case becomes its
+    /// final result.
+    ///
+    /// \param [in,out] tx Writable transaction where to store the results.
+    /// \param hooks The hooks for this execution.
+    void
+    abandon(store::write_transaction& tx,
+            drivers::run_tests::base_hooks& hooks)
+    {
+        for (std::deque< pending >::const_iterator iter = _pending.begin();
+             iter != _pending.end(); ++iter) {
+            tx.put_result((*iter).last_result, (*iter).test_case_id,
+                          (*iter).last_start_time, (*iter).last_end_time,
+                          (*iter).last_attempt);
+            hooks.got_result(*(*iter).match.first, (*iter).match.second,
+                             (*iter).last_result,
+                             (*iter).last_end_time - (*iter).last_start_time);
+        }
+        _pending.clear();
+    }
+};
+
+
+/// Shares the test cases of a run among several concurrent kyua instances.
+///
+/// When the claims_directory configuration variable is set, every test case
+/// must be claimed before it runs by creating a directory for it under the
+/// claims directory.  Because mkdir(2) is atomic, even on network file systems,
+/// exactly one of the instances that point to the same claims directory runs
+/// each test case.  Instances get new test cases only as their slots free up,
+/// so faster or less loaded machines end up running more of them, which
+/// balances the run much better than partitioning the test suite in advance.
+class work_claims : utils::noncopyable {
+    /// Directory holding the claims; none if claiming is disabled.
+    optional< fs::path > _directory;
+
+    /// Escapes a name so that it can be used as a single path component.
+    ///
+    /// \param name The name to escape.
+    ///
+    /// \return The escaped name, with slashes and percent signs encoded.
+    static std::string
+    escape(const std::string& name)
+    {
+        std::string escaped;
+        for (std::string::const_iterator iter = name.begin();
+             iter != name.end(); ++iter) {
+            if (*iter == '%')
+                escaped += "%25";
+            else if (*iter == '/')
+                escaped += "%2F";
+            else
+                escaped += *iter;
+        }
+        return escaped;
+    }
+
+public:
+    /// Constructor.
+    ///
+    /// \param user_config The end-user configuration properties, which
+    ///     specify the claims directory, if any.
+    explicit work_claims(const config::tree& user_config)
+    {
+        if (user_config.is_set("claims_directory"))
+            _directory = fs::path(user_config.lookup< config::string_node >(
+                "claims_directory"));
+    }
+
+    /// Checks whether claiming is enabled.
+    ///
+    /// \return True if other instances may run some of the test cases.
+    bool
+    enabled(void) const
+    {
+        return static_cast< bool >(_directory);
+    }
+
+    /// Claims a test case for this instance.
+    ///
+    /// \param match The test case that is about to run.
+    ///
+    /// \return True if claiming is disabled or if this instance now owns the
+    /// test case; false if another instance claimed it first.
+    ///
+    /// \throw fs::error If the claim cannot be recorded.
+    bool
+    claim(const engine::scan_result& match)
+    {
+        if (!_directory)
+            return true;
+
+        const fs::path program_directory =
+            _directory.get() / match.first->relative_path();
+        std::string claim_name = escape(match.second);
+        if (!match.first->variant().empty())
+            claim_name += "[" + escape(match.first->variant()) + "]";
+        fs::mkdir_p(program_directory, 0755);
+        try {
+            fs::mkdir(program_directory / claim_name, 0755);
+        } catch (const fs::system_error& e) {
+            if (e.original_errno() != EEXIST)
+                throw;
+            LD(F("Test %s:%s already claimed by another instance") %
+               match.first->relative_path() % match.second);
+            return false;
+        }
+        return true;
+    }
+};
+
+
+/// Number of most recent runs from which to take the durations of a test case.
+static const std::size_t adaptive_timeout_runs = 10;
+
+
+/// Minimum number of runs of a test case to derive its timeout from them.
+static const std::size_t adaptive_timeout_min_runs = 3;
+
+
+/// Shortest timeout that the adaptive timeouts ever arm.
+///
+/// Very short tests have durations dominated by noise, such as the time to
+/// fork and exec them, so deriving small multiples from them is not reliable.
+static const datetime::delta adaptive_timeout_floor(10, 0);
+
+
+/// Derives the timeouts of the test cases from their historical durations.
+///
+/// When the adaptive_timeout configuration variable is set, the timeout of a
+/// test case becomes the smaller of its declared timeout and its 99th
+/// percentile duration over recent runs multiplied by the configured factor
+/// and by a host-speed factor.  This way, hung tests free their slot long
+/// before their declared timeout expires.
+///
+/// The historical durations come from the trends index and may have been
+/// measured on a faster machine or under less load.  To account for this, the
+/// host-speed factor is the geometric mean of the ratios between the durations
+/// of the test cases that passed in this run and their historical medians.  It
+/// is never below 1 so that timeouts are only loosened by this adjustment.
+class adaptive_timeouts : utils::noncopyable {
+    /// Multiplier of the historical durations; 0 if disabled.
+    std::size_t _factor;
+
+    /// 99th percentile duration of every test case with enough history.
+    store::case_durations_map _p99;
+
+    /// Median duration of every test case with enough history.
+    store::case_durations_map _p50;
+
+    /// Sum of the logarithms of the observed duration ratios.
+    double _log_ratios;
+
+    /// Number of observed duration ratios.
+    std::size_t _observations;
+
+    /// Computes the identifier of a test case in the trends index.
+    ///
+    /// \param test_program The test program containing the test case.
+    /// \param test_case_name The name of the test case.
+    ///
+    /// \return The identifier to look up the history of the test case.
+    static store::trend_case_id
+    id_of(const model::test_program& test_program,
+          const std::string& test_case_name)
+    {
+        return store::trend_case_id(test_program.relative_path(),
+                                    test_program.variant(), test_case_name);
+    }
+
+public:
+    /// Constructor.
+    ///
+    /// \param kyuafile_path Path to the Kyuafile of the test suite, used to
+    ///     determine the test suite whose history to load.
+    /// \param user_config The end-user configuration properties, which
+    ///     specify the adaptive timeout factor, if any.
+    adaptive_timeouts(const fs::path& kyuafile_path,
+                      const config::tree& user_config) :
+        _factor(0), _log_ratios(0.0), _observations(0)
+    {
+        if (!user_config.is_set("adaptive_timeout"))
+            return;
+
+        const std::string test_suite = store::layout::test_suite_for_path(
+            kyuafile_path.branch_path());
+        const fs::path trends_file = store::layout::query_trends_file();
+        try {
+            fs::mkdir_p(trends_file.branch_path(), 0755);
+            store::trends_index index = store::trends_index::open_rw(
+                trends_file);
+            (void)index.sync(test_suite);
+            _p99 = index.percentiles(test_suite, adaptive_timeout_runs,
+                                     adaptive_timeout_min_runs, 99);
+            _p50 = index.percentiles(test_suite, adaptive_timeout_runs,
+                                     adaptive_timeout_min_runs, 50);
+            index.close();
+        } catch (const fs::error& e) {
+            LW(F("Cannot load the history of %s; not adapting timeouts: %s") %
+               test_suite % e.what());
+            return;
+        } catch (const store::error& e) {
+            LW(F("Cannot load the history of %s; not adapting timeouts: %s") %
+               test_suite % e.what());
+            return;
+        }
+        _factor = user_config.lookup< config::positive_int_node >(
+            "adaptive_timeout");
+        LI(F("Loaded the durations of %s test cases to adapt timeouts") %
+           _p99.size());
+    }
+
+    /// Accounts for the duration of a test case that passed.
+    ///
+    /// \param test_program The test program containing the test case.
+    /// \param test_case_name The name of the test case.
+    /// \param duration The duration of the test case.
+    void
+    observe(const model::test_program& test_program,
+            const std::string& test_case_name,
+            const datetime::delta& duration)
+    {
+        const store::case_durations_map::const_iterator iter = _p50.find(
+            id_of(test_program, test_case_name));
+        if (iter == _p50.end() || (*iter).second.to_microseconds() == 0 ||
+            duration.to_microseconds() == 0)
+            return;
+        _log_ratios += std::log(
+            static_cast< double >(duration.to_microseconds()) /
+            static_cast< double >((*iter).second.to_microseconds()));
+        ++_observations;
+    }
+
+    /// Computes the host-speed factor.
+    ///
+    /// \return How much slower this run is compared to the history, at least 1.
+    double
+    host_factor(void) const
+    {
+        if (_observations == 0)
+            return 1.0;
+        return std::max(1.0, std::exp(
+            _log_ratios / static_cast< double >(_observations)));
+    }
+
+    /// Computes the timeout to arm for a test case.
+    ///
+    /// \param test_program The test program containing the test case.
+    /// \param test_case_name The name of the test case.
+    ///
+    /// \return The adaptive timeout for the test case, or none if there is no
+    /// history for it.  The scheduler ignores the adaptive timeout if it is
+    /// not shorter than the declared one.
+    optional< datetime::delta >
+    timeout_for(const model::test_program& test_program,
+                const std::string& test_case_name) const
+    {
+        if (_factor == 0)
+            return none;
+
+        const store::case_durations_map::const_iterator iter = _p99.find(
+            id_of(test_program, test_case_name));
+        if (iter == _p99.end())
+            return none;
+
+        const double micros = static_cast< double >(
+            (*iter).second.to_microseconds()) *
+            static_cast< double >(_factor) * host_factor();
+        return utils::make_optional(std::max(
+            adaptive_timeout_floor,
+            datetime::delta::from_microseconds(static_cast< int64_t >(
+                std::min(micros, 1e15)))));
+    }
+};
+
+
+/// Puts the test programs and test cases in the store and tracks their IDs.
+///
+/// The first time that a test case of a test program is put, the test program
+/// is put along with all of its test cases that the scanner has queued, using
+/// multi-row insertions.  The following test cases of the test program then
+/// only need to look up their identifiers, which keeps the database writes off
+/// the path that spawns them.
+class test_ids_cache : utils::noncopyable {
+    /// Identifiers of the test programs already put.
+    path_to_id_map _test_programs;
+
+    /// Identifiers of the test cases put in advance that are not in use yet.
+    std::map< std::pair< path_to_id_map::key_type, std::string >,
+              int64_t > _test_cases;
+
+    /// The scanner yielding the test cases to put.
+    const engine::scanner& _scanner;
+
+    /// Whether to put the queued test cases in advance.
+    ///
+    /// This must be false if the test cases might not run, as otherwise the
+    /// store would record test cases that never get a result.
+    const bool _in_advance;
+
+public:
+    /// Constructor.
+    ///
+    /// \param scanner_ The scanner yielding the test cases to put.
+    /// \param in_advance_ Whether to put the test cases queued by the scanner
+    ///     in advance, which is only valid if all of them will run.
+    test_ids_cache(const engine::scanner& scanner_, const bool in_advance_) :
+        _scanner(scanner_), _in_advance(in_advance_)
+    {
+    }
+
+    /// Puts a test case in the store and returns its identifier.
+    ///
+    /// Every call yields a new identifier, even for test cases that were put
+    /// before, such as repetitions.
+    ///
+    /// \param match The test program and the test case being put.
+    /// \param [in,out] tx Writable transaction on the store.
+    ///
+    /// \return A test case identifier.
+    int64_t
+    put_test_case(const engine::scan_result& match,
+                  store::write_transaction& tx)
+    {
+        const model::test_program_ptr test_program = match.first;
+        const std::string& test_case_name = match.second;
+        const path_to_id_map::key_type key(test_program->relative_path(),
+                                           test_program->variant());
+
+        const path_to_id_map::const_iterator iter = _test_programs.find(key);
+        if (iter == _test_programs.end()) {
+            std::vector< std::string > names;
+            if (_in_advance)
+                names = _scanner.queued_test_cases(test_program);
+            names.insert(names.begin(), test_case_name);
+
+            const std::pair< int64_t, store::test_case_ids_map > ids =
+                tx.put_test_program_with_cases(*test_program, names);
+            _test_programs.insert(std::make_pair(key, ids.first));
+            for (store::test_case_ids_map::const_iterator iter2 =
+                     ids.second.begin(); iter2 != ids.second.end(); ++iter2) {
+                if ((*iter2).first != test_case_name)
+                    _test_cases.insert(std::make_pair(
+                        std::make_pair(key, (*iter2).first), (*iter2).second));
+            }
+            LD(F("Put test program %s with %s test cases") %
+               test_program->relative_path() % names.size());
+            return (*ids.second.find(test_case_name)).second;
+        }
+
+        const std::pair< path_to_id_map::key_type, std::string > case_key(
+            key, test_case_name);
+        const std::map< std::pair< path_to_id_map::key_type, std::string >,
+                        int64_t >::iterator iter2 = _test_cases.find(case_key);
+        if (iter2 != _test_cases.end()) {
+            const int64_t id = (*iter2).second;
+            _test_cases.erase(iter2);
+            return id;
+        }
+        return tx.put_test_case(*test_program, test_case_name,
+                                (*iter).second);
+    }
+};
+
+
+/// Gets the size of a file.
+///
+/// \param path The file to query.
+///
+/// \return The size of the file in bytes, or 0 if it cannot be queried.
+static uint64_t
+file_size(const fs::path& path)
+{
+    struct ::stat sb;
+    if (::stat(path.c_str(), &sb) == -1)
+        return 0;
+    return sb.st_size;
+}
+
+
+/// Stores the result of an execution in the database.
+///
+/// \param test_case_id Identifier of the test case in the database.
+/// \param result The result of the execution.
+/// \param test_result The result of the test case to store, which may differ
+///     from the one in result if the driver overrides it.
+/// \param attempt Number of the attempt that produced the result.
+/// \param store_sub_results Whether to also store the results of the
+///     individual checks of the test case, if its interface reports them.
+/// \param [in,out] tx Writable transaction where to store the result data.
+///
+/// \return The size of the output of the test case, in bytes.
+static uint64_t
+put_test_result(const int64_t test_case_id,
+                const scheduler::test_result_handle& result,
+                const model::test_result& test_result,
+                const int attempt,
+                const bool store_sub_results,
+                store::write_transaction& tx)
+{
+    tx.put_result(test_result, test_case_id,
+                  result.start_time(), result.end_time(), attempt);
+    if (result.usage())
+        tx.put_resource_usage(result.usage().get(), test_case_id);
+    if (store_sub_results)
+        tx.put_sub_results(result.sub_results(), test_case_id);
+    tx.put_test_case_file("__STDOUT__", result.stdout_file(), test_case_id);
+    tx.put_test_case_file("__STDERR__", result.stderr_file(), test_case_id);
+    return file_size(result.stdout_file()) + file_size(result.stderr_file());
+}
+
+
+/// Cleans up a test case and folds any errors into the test result.
+///
+/// \param handle The result handle for the test.
+///
+/// \return The test result if the cleanup succeeds; a broken test result
+/// otherwise.
+model::test_result
+safe_cleanup(scheduler::test_result_handle handle) throw()
+{
+    try {
+        handle.cleanup();
+        return handle.test_result();
+    } catch (const std::exception& e) {
+        return model::test_result(
+            model::test_result_broken,
+            F("Failed to clean up test case's work directory %s: %s") %
+            handle.work_directory() % e.what());
+    }
+}
+
+
+/// Computes the cache key of a test case if result caching is enabled.
+///
+/// \param cache The cache of previous results; none if caching is disabled.
+/// \param match Test program and test case to compute the key for.
+/// \param user_config The end-user configuration properties.
+///
+/// \return The cache key of the test case, or none if caching is disabled or
+/// if the inputs of the test case cannot be read.
+static optional< std::string >
+get_cache_key(const optional< engine::result_cache >& cache,
+              const engine::scan_result& match,
+              const config::tree& user_config)
+{
+    if (!cache)
+        return none;
+    return cache.get().compute_key(*match.first, match.second, user_config);
+}
+
+
+/// Records a test case that passed previously without running it again.
+///
+/// \param match Test program and test case to record.
+/// \param cache_key The cache key of the test case, which matches the key of
+///     its previous passing execution.
+/// \param [in,out] tx Writable transaction where to store the result.
+/// \param [in,out] ids_cache Cache of already-put test cases.
+/// \param hooks The hooks for this execution.
+static void
+put_cached_result(const engine::scan_result& match,
+                  const std::string& cache_key,
+                  store::write_transaction& tx,
+                  test_ids_cache& ids_cache,
+                  drivers::run_tests::base_hooks& hooks)
+{
+    const model::test_program_ptr test_program = match.first;
+    const std::string& test_case_name = match.second;
+
+    LD(F("Reusing previous result of %s:%s") % test_program->relative_path() %
+       test_case_name);
+    hooks.got_test_case(*test_program, test_case_name);
+
+    const int64_t test_case_id = ids_cache.put_test_case(match, tx);
+
+    const model::test_result result(model::test_result_passed);
+    const datetime::timestamp now = datetime::timestamp::now();
+    tx.put_result(result, test_case_id, now, now);
+    tx.put_cache_key(cache_key, test_case_id);
+
+    hooks.got_result(*test_program, test_case_name, result, datetime::delta());
+}
+
+
+/// Records the result of a test case that does not need to run.
+///
+/// This is used for the test cases whose requirements are not met and for
+/// those of the test programs that keep breaking.
+///
+/// \param match Test program and test case to record.
+/// \param result The result of the test case.
+/// \param [in,out] tx Writable transaction where to store the result.
+/// \param [in,out] ids_cache Cache of already-put test cases.
+/// \param hooks The hooks for this execution.
+static void
+put_unrun_result(const engine::scan_result& match,
+                 const model::test_result& result,
+                 store::write_transaction& tx,
+                 test_ids_cache& ids_cache,
+                 drivers::run_tests::base_hooks& hooks)
+{
+    const model::test_program_ptr test_program = match.first;
+    const std::string& test_case_name = match.second;
+
+    LD(F("Recording %s:%s without spawning it: %s") %
+       test_program->relative_path() % test_case_name % result);
+    hooks.got_test_case(*test_program, test_case_name);
+
+    const int64_t test_case_id = ids_cache.put_test_case(match, tx);
+
+    const datetime::timestamp now = datetime::timestamp::now();
+    tx.put_result(result, test_case_id, now, now);
+
+    hooks.got_result(*test_program, test_case_name, result, datetime::delta());
+}
+
+
+/// Constructs the name of a test case for the timeline of the execution.
+///
+/// \param test_program The test program containing the test case.
+/// \param test_case_name The name of the test case.
+///
+/// \return The name of the test case qualified by its test program.
+static std::string
+event_name(const model::test_program& test_program,
+           const std::string& test_case_name)
+{
+    return F("%s:%s") % test_program.relative_path() % test_case_name;
+}
+
+
+/// Starts a test asynchronously.
+///
+/// \param handle Scheduler handle.
+/// \param match Test program and test case to start.
+/// \param cache_key If not none, the cache key to record for the test case.
+/// \param [in,out] tx Writable transaction to obtain test IDs.
+/// \param [in,out] ids_cache Cache of already-put test cases.
+/// \param [in,out] slots The CPUs to pin the test to.
+/// \param timeouts The adaptive timeouts of the test cases.
+/// \param user_config The end-user configuration properties.
+/// \param hooks The hooks for this execution.
+///
+/// \returns The PID for the started test and the test case's identifier in the
+/// store.
+pid_and_id_pair
+start_test(scheduler::scheduler_handle& handle,
+           const engine::scan_result& match,
+           const optional< std::string >& cache_key,
+           store::write_transaction& tx,
+           test_ids_cache& ids_cache,
+           cpu_slots& slots,
+           const adaptive_timeouts& timeouts,
+           const config::tree& user_config,
+           drivers::run_tests::base_hooks& hooks)
+{
+    const model::test_program_ptr test_program = match.first;
+    const std::string& test_case_name = match.second;
+
+    hooks.got_test_case(*test_program, test_case_name);
+
+    const int64_t test_case_id = ids_cache.put_test_case(match, tx);
+    if (cache_key)
+        tx.put_cache_key(cache_key.get(), test_case_id);
+
+    const std::set< int > cpus = slots.acquire(test_case_id, tx,
+                                               required_slots(match));
+    const datetime::timestamp start = datetime::timestamp::now();
+    const scheduler::exec_handle exec_handle = handle.spawn_test(
+        test_program, test_case_name, user_config, cpus,
+        timeouts.timeout_for(*test_program, test_case_name));
+    tx.put_run_event("spawn", event_name(*test_program, test_case_name),
+                     none, start, datetime::timestamp::now());
+    slots.started(exec_handle);
+    return std::make_pair(exec_handle, test_case_id);
+}
+
+
+/// Starts another attempt of a test that failed before.
+///
+/// The previous attempt is recorded in the database at this point, not when it
+/// completed, so that abandoning the retry can store it as the final result.
+///
+/// \param handle Scheduler handle.
+/// \param retry The test case to rerun.
+/// \param [in,out] tx Writable transaction to put the previous attempt.
+/// \param [in,out] slots The CPUs to pin the test to.
+/// \param timeouts The adaptive timeouts of the test cases.
+/// \param user_config The end-user configuration properties.
+///
+/// \returns The PID for the started test and the test case's identifier in the
+/// store.
+pid_and_id_pair
+start_retry(scheduler::scheduler_handle& handle,
+            const retries_queue::pending& retry,
+            store::write_transaction& tx,
+            cpu_slots& slots,
+            const adaptive_timeouts& timeouts,
+            const config::tree& user_config)
+{
+    tx.put_retried_result(retry.last_result, retry.test_case_id,
+                          retry.last_attempt, retry.last_start_time,
+                          retry.last_end_time);
+
+    const std::set< int > cpus = slots.acquire(
+        retry.test_case_id, tx, required_slots(retry.match));
+    const datetime::timestamp start = datetime::timestamp::now();
+    const scheduler::exec_handle exec_handle = handle.spawn_test(
+        retry.match.first, retry.match.second, user_config, cpus,
+        timeouts.timeout_for(*retry.match.first, retry.match.second));
+    tx.put_run_event("spawn", event_name(*retry.match.first,
+                                         retry.match.second),
+                     none, start, datetime::timestamp::now());
+    slots.started(exec_handle);
+    return std::make_pair(exec_handle, retry.test_case_id);
+}
+
+
+/// How often to look for stragglers while waiting for the in-flight tests.
+static const datetime::delta straggler_poll_period(0, 10000);
+
+
+/// Runs copies of the idempotent tests that take longer than usual.
+///
+/// When the speculative_idle_slots configuration variable is set and the run
+/// is down to its last tests, the idle slots are used to start a second copy
+/// of every idempotent test that has been running for longer than its 95th
+/// percentile duration over recent runs, adjusted by the host-speed factor.
+/// Whichever copy completes first provides the result of the test and the
+/// other one is terminated and discarded, so that a test slowed down by a
+/// noisy neighbor does not extend the run on its own.
+class speculative_runs : utils::noncopyable {
+    /// Properties of an in-flight test that may get a copy.
+    struct candidate {
+        /// The running test.
+        engine::scan_result match;
+
+        /// Time after which the test is considered a straggler.
+        datetime::monotonic_time deadline;
+
+        /// Constructor.
+        ///
+        /// \param match_ The running test.
+        /// \param deadline_ Time after which the test is a straggler.
+        candidate(const engine::scan_result& match_,
+                  const datetime::monotonic_time& deadline_) :
+            match(match_), deadline(deadline_)
+        {
+        }
+    };
+
+    /// Minimum number of idle slots to start copies; 0 if disabled.
+    std::size_t _idle_slots;
+
+    /// 95th percentile duration of every test case with enough history.
+    store::case_durations_map _p95;
+
+    /// In-flight tests that may get a copy, keyed by their PID.
+    std::map< int, candidate > _candidates;
+
+    /// The other copy of every test that runs twice, keyed by PID.
+    std::map< int, int > _partners;
+
+    /// Copies that lost and are being terminated.
+    pids_set _losers;
+
+public:
+    /// Constructor.
+    ///
+    /// \param kyuafile_path Path to the Kyuafile of the test suite, used to
+    ///     determine the test suite whose history to load.
+    /// \param user_config The end-user configuration properties, which
+    ///     enable the speculative copies.
+    speculative_runs(const fs::path& kyuafile_path,
+                     const config::tree& user_config) :
+        _idle_slots(0)
+    {
+        if (!user_config.is_set("speculative_idle_slots"))
+            return;
+
+        const std::string test_suite = store::layout::test_suite_for_path(
+            kyuafile_path.branch_path());
+        const fs::path trends_file = store::layout::query_trends_file();
+        try {
+            fs::mkdir_p(trends_file.branch_path(), 0755);
+            store::trends_index index = store::trends_index::open_rw(
+                trends_file);
+            (void)index.sync(test_suite);
+            _p95 = index.percentiles(test_suite, adaptive_timeout_runs,
+                                     adaptive_timeout_min_runs, 95);
+            index.close();
+        } catch (const fs::error& e) {
+            LW(F("Cannot load the history of %s; not speculating: %s") %
+               test_suite % e.what());
+            return;
+        } catch (const store::error& e) {
+            LW(F("Cannot load the history of %s; not speculating: %s") %
+               test_suite % e.what());
+            return;
+        }
+        _idle_slots = user_config.lookup< config::positive_int_node >(
+            "speculative_idle_slots");
+        LI(F("Loaded the durations of %s test cases to detect stragglers") %
+           _p95.size());
+    }
+
+    /// Accounts for a started test.
+    ///
+    /// \param pid The PID of the test.
+    /// \param match The started test.
+    /// \param timeouts The adaptive timeouts, which provide the host-speed
+    ///     factor.
+    /// \param limits The concurrency limits of the tests.  The tests of the
+    ///     test suites that limit their concurrency never get a copy, as it
+    ///     would go past the limit.
+    void
+    started(const int pid, const engine::scan_result& match,
+            const adaptive_timeouts& timeouts,
+            const concurrency_limits& limits)
+    {
+        if (_idle_slots == 0 ||
+            !match.first->find(match.second).get_metadata().is_idempotent() ||
+            limits.has_suite_limit(match))
+            return;
+
+        const store::case_durations_map::const_iterator iter = _p95.find(
+            store::trend_case_id(match.first->relative_path(),
+                                 match.first->variant(), match.second));
+        if (iter == _p95.end())
+            return;
+
+        const double micros = static_cast< double >(
+            (*iter).second.to_microseconds()) * timeouts.host_factor();
+        _candidates.insert(std::make_pair(pid, candidate(
+            match, datetime::monotonic_time::now() +
+            datetime::delta::from_microseconds(static_cast< int64_t >(
+                std::min(micros, 1e15))))));
+    }
+
+    /// Gets the time at which the next test becomes a straggler.
+    ///
+    /// \param idle Number of idle slots.
+    ///
+    /// \return The earliest deadline of the tests that may get a copy, or none
+    /// if there are none or if there are not enough idle slots for them.
+    optional< datetime::monotonic_time >
+    next_deadline(const std::size_t idle) const
+    {
+        if (_candidates.empty() || idle < _idle_slots)
+            return none;
+        datetime::monotonic_time deadline = (*_candidates.begin()).second
+            .deadline;
+        for (std::map< int, candidate >::const_iterator iter =
+                 _candidates.begin(); iter != _candidates.end(); ++iter)
+            deadline = std::min(deadline, (*iter).second.deadline);
+        return utils::make_optional(deadline);
+    }
+
+    /// Starts a copy of the stragglers while there are enough idle slots.
+    ///
+    /// \param [in,out] handle Scheduler handle.
+    /// \param idle Number of idle slots.
+    /// \param [in,out] in_flight The in-flight tests.  Gets the copies added
+    ///     with the test case identifiers of their originals.
+    /// \param [in,out] tx Writable transaction to record the copies in.
+    /// \param timeouts The adaptive timeouts of the test cases.
+    /// \param user_config The end-user configuration properties.
+    void
+    launch(scheduler::scheduler_handle& handle, std::size_t idle,
+           pid_to_id_map& in_flight, store::write_transaction& tx,
+           const adaptive_timeouts& timeouts,
+           const config::tree& user_config)
+    {
+        const datetime::monotonic_time now = datetime::monotonic_time::now();
+        std::map< int, candidate >::iterator iter = _candidates.begin();
+        while (idle >= _idle_slots && iter != _candidates.end()) {
+            if ((*iter).second.deadline > now) {
+                ++iter;
+                continue;
+            }
+
+            const engine::scan_result& match = (*iter).second.match;
+            const datetime::timestamp start = datetime::timestamp::now();
+            const scheduler::exec_handle exec_handle = handle.spawn_test(
+                match.first, match.second, user_config, std::set< int >(),
+                timeouts.timeout_for(*match.first, match.second));
+            tx.put_run_event("speculate",
+                             event_name(*match.first, match.second),
+                             none, start, datetime::timestamp::now());
+            LI(F("Started a copy of straggler %s:%s") %
+               match.first->relative_path() % match.second);
+
+            const pid_to_id_map::const_iterator original = in_flight.find(
+                (*iter).first);
+            INV(original != in_flight.end());
+            INV_MSG(in_flight.find(exec_handle) == in_flight.end(),
+                    F("Spawned test has PID of still-tracked process %s") %
+                    exec_handle);
+            in_flight.insert(pid_and_id_pair(exec_handle,
+                                             (*original).second));
+            _partners[(*iter).first] = exec_handle;
+            _partners[exec_handle] = (*iter).first;
+            _candidates.erase(iter++);
+            --idle;
+        }
+    }
+
+    /// Accounts for a completed test.
+    ///
+    /// If the test has another copy running, the copy is terminated.
+    ///
+    /// \param pid The PID of the test.
+    /// \param [in,out] handle Scheduler handle to terminate the other copy.
+    /// \param [in,out] terminated The subprocesses terminated so far.  Gets
+    ///     the other copy added, if any, and the test removed if it lost.
+    ///
+    /// \return True if the test lost to its other copy and its result has to
+    /// be discarded.
+    bool
+    completed(const int pid, scheduler::scheduler_handle& handle,
+              pids_set& terminated)
+    {
+        _candidates.erase(pid);
+        if (_losers.erase(pid) > 0) {
+            terminated.erase(pid);
+            return true;
+        }
+
+        const std::map< int, int >::iterator iter = _partners.find(pid);
+        if (iter == _partners.end())
+            return false;
+        const int partner = (*iter).second;
+        _partners.erase(iter);
+        _partners.erase(partner);
+        _losers.insert(partner);
+        if (terminated.insert(partner).second)
+            handle.terminate(partner);
+        return false;
+    }
+};
+
+
+/// Processes the completion of a test.
+///
+/// \param [in,out] result_handle The completion handle of the test subprocess.
+/// \param test_case_id Identifier of the test case as returned by start_test().
+/// \param terminated Whether the driver terminated the test before it
+///     completed, in which case its failure is reported as a skip: the test
+///     case did not get a chance to finish.
+/// \param store_sub_results Whether to store the results of the individual
+///     checks of the test case.
+/// \param [in,out] tx Writable transaction to put the test results.
+/// \param [in,out] retries The tests waiting for another attempt.  Gets the
+///     test added if it has to be retried.
+/// \param [in,out] latencies Histograms where to record the time taken to
+///     store the result of the test and to clean it up.
+/// \param [in,out] timeouts The adaptive timeouts of the test cases.  Gets
+///     the duration of the test accounted for if it passed.
+/// \param [in,out] breakers The test programs that keep breaking.  Gets the
+///     result of the test accounted for.
+/// \param [in,out] usage The use of the execution slots, to account for the
+///     cleanup of the test.
+/// \param hooks The hooks for this execution.
+///
+/// \return The result of the test case as stored in the database, or none if
+/// the test case has been queued for another attempt.
+///
+/// \post result_handle is cleaned up.  The caller cannot clean it up again.
+optional< model::test_result >
+finish_test(scheduler::result_handle_ptr result_handle,
+            const int64_t test_case_id,
+            const bool terminated,
+            const bool store_sub_results,
+            store::write_transaction& tx,
+            retries_queue& retries,
+            utils::latency_histograms_map& latencies,
+            adaptive_timeouts& timeouts,
+            broken_programs& breakers,
+            slot_usage& usage,
+            metrics_tracker& hooks)
+{
+    const scheduler::test_result_handle* test_result_handle =
+        dynamic_cast< const scheduler::test_result_handle* >(
+            result_handle.get());
+
+    const std::string name = event_name(*test_result_handle->test_program(),
+                                        test_result_handle->test_case_name());
+    tx.put_run_event("test", name, utils::make_optional(
+                         result_handle->original_pid()),
+                     result_handle->start_time(), result_handle->end_time());
+
+    const int attempt = retries.attempt_of(test_case_id);
+    model::test_result result = test_result_handle->test_result();
+    if (terminated && !result.good()) {
+        result = model::test_result(
+            model::test_result_skipped,
+            "Terminated after reaching the maximum number of failures");
+    } else if (retries.offer(
+                   engine::scan_result(test_result_handle->test_program(),
+                                       test_result_handle->test_case_name()),
+                   test_case_id, result, result_handle->start_time(),
+                   result_handle->end_time())) {
+        const std::string activity = usage.enter("cleanup");
+        const datetime::timestamp cleanup_start = datetime::timestamp::now();
+        (void)safe_cleanup(*test_result_handle);
+        tx.put_run_event("cleanup", name, none, cleanup_start,
+                         datetime::timestamp::now());
+        usage.enter(activity);
+        return none;
+    }
+    const datetime::timestamp put_start = datetime::timestamp::now();
+    hooks.got_output(put_test_result(test_case_id, *test_result_handle, result,
+                                     attempt, store_sub_results, tx));
+    const datetime::timestamp cleanup_start = datetime::timestamp::now();
+    latencies["put_result"].record_interval(put_start, cleanup_start);
+    tx.put_run_event("put_result", name, none, put_start, cleanup_start);
+
+    const std::string activity = usage.enter("cleanup");
+    const model::test_result test_result = safe_cleanup(*test_result_handle);
+    usage.enter(activity);
+    const datetime::timestamp cleanup_end = datetime::timestamp::now();
+    latencies["cleanup"].record_interval(cleanup_start, cleanup_end);
+    tx.put_run_event("cleanup", name, none, cleanup_start, cleanup_end);
+    if (result.good())
+        timeouts.observe(*test_result_handle->test_program(),
+                         test_result_handle->test_case_name(),
+                         result_handle->end_time() -
+                         result_handle->start_time());
+    breakers.got_result(test_result_handle->test_program(), result);
+    hooks.got_result(
+        *test_result_handle->test_program(),
+        test_result_handle->test_case_name(),
+        result,
+        result_handle->end_time() - result_handle->start_time());
+    return utils::make_optional(result);
+}
+
+
+/// Processes the completion of a collection of tests.
+///
+/// \param [in,out] finished The completed tests to process.  Emptied on return.
+/// \param [in,out] terminated The tests terminated by the driver.  Entries for
+///     the processed tests are removed.
+/// \param store_sub_results Whether to store the results of the individual
+///     checks of the test cases.
+/// \param [in,out] tx Writable transaction to put the test results.
+/// \param [in,out] checkpoints Tracker of the checkpoints of tx.
+/// \param [in,out] failures Tracker of the failed test cases.
+/// \param [in,out] repeats The repetitions of the test cases.
+/// \param [in,out] retries The tests waiting for another attempt.
+/// \param [in,out] latencies Histograms where to record the time taken to
+///     store the results of the tests and to clean them up.
+/// \param [in,out] timeouts The adaptive timeouts of the test cases.
+/// \param [in,out] breakers The test programs that keep breaking.
+/// \param [in,out] usage The use of the execution slots.
+/// \param [in,out] releaser The releaser of the test cases that are done.
+/// \param hooks The hooks for this execution.
+static void
+finish_tests(finished_tests_vector& finished,
+             pids_set& terminated,
+             const bool store_sub_results,
+             store::write_transaction& tx,
+             checkpointer& checkpoints,
+             failures_limit& failures,
+             repeats_queue& repeats,
+             retries_queue& retries,
+             utils::latency_histograms_map& latencies,
+             adaptive_timeouts& timeouts,
+             broken_programs& breakers,
+             slot_usage& usage,
+             test_cases_releaser& releaser,
+             metrics_tracker& hooks)
+{
+    if (finished.empty())
+        return;
+
+    const std::string activity = usage.enter("store");
+    for (finished_tests_vector::const_iterator iter = finished.begin();
+         iter != finished.end(); ++iter) {
+        const bool was_terminated = terminated.erase(
+            (*iter).first->original_pid()) > 0;
+        const optional< model::test_result > result = finish_test(
+            (*iter).first, (*iter).second, was_terminated, store_sub_results,
+            tx, retries, latencies, timeouts, breakers, usage, hooks);
+        if (result) {
+            failures.got_result(result.get());
+            repeats.got_result(result.get());
+            checkpoints.got_result();
+            releaser.done(dynamic_cast< const scheduler::test_result_handle& >(
+                              *(*iter).first).test_program());
+        }
+    }
+    finished.clear();
+    usage.enter(activity);
+}
+
+
+/// Terminates all in-flight tests and test program listings.
+///
+/// The terminated subprocesses are still collected as usual, so the cleanup
+/// routines of the tests that already finished their body still run.
+///
+/// \param [in,out] handle The scheduler handle that spawned the subprocesses.
+/// \param in_flight The in-flight tests.
+/// \param in_flight_lists The in-flight test program listings.
+/// \param [in,out] terminated The subprocesses terminated so far.  Gets the
+///     newly-terminated subprocesses added.
+static void
+terminate_in_flight(scheduler::scheduler_handle& handle,
+                    const pid_to_id_map& in_flight,
+                    const pids_set& in_flight_lists,
+                    pids_set& terminated)
+{
+    for (pid_to_id_map::const_iterator iter = in_flight.begin();
+         iter != in_flight.end(); ++iter) {
+        if (terminated.insert((*iter).first).second)
+            handle.terminate((*iter).first);
+    }
+    for (pids_set::const_iterator iter = in_flight_lists.begin();
+         iter != in_flight_lists.end(); ++iter) {
+        if (terminated.insert(*iter).second)
+            handle.terminate(*iter);
+    }
+}
 
-#include "engine/config.hpp"
-#include "engine/filters.hpp"
-#include "engine/kyuafile.hpp"
-#include "engine/scanner.hpp"
-#include "engine/scheduler.hpp"
-#include "model/context.hpp"
-#include "model/metadata.hpp"
-#include "model/test_case.hpp"
-#include "model/test_program.hpp"
-#include "model/test_result.hpp"
-#include "store/write_backend.hpp"
-#include "store/write_transaction.hpp"
-#include "utils/config/tree.ipp"
-#include "utils/datetime.hpp"
-#include "utils/defs.hpp"
-#include "utils/format/macros.hpp"
-#include "utils/logging/macros.hpp"
-#include "utils/noncopyable.hpp"
-#include "utils/optional.ipp"
-#include "utils/passwd.hpp"
-#include "utils/text/operations.ipp"
 
-namespace config = utils::config;
-namespace datetime = utils::datetime;
-namespace fs = utils::fs;
-namespace passwd = utils::passwd;
-namespace scheduler = engine::scheduler;
-namespace text = utils::text;
+/// Extracts the keys of a pid_to_id_map and returns them as a string.
+///
+/// \param map The PID to test ID map from which to get the PIDs.
+///
+/// \return A user-facing string with the collection of PIDs.
+static std::string
+format_pids(const pid_to_id_map& map)
+{
+    std::set< pid_to_id_map::key_type > pids;
+    for (pid_to_id_map::const_iterator iter = map.begin(); iter != map.end();
+         ++iter) {
+        pids.insert(iter->first);
+    }
+    return text::join(pids, ",");
+}
 
-using utils::none;
-using utils::optional;
 
+/// Computes the number of execution slots not in use.
+///
+/// \param parallelism The controller of the number of slots.
+/// \param in_flight The in-flight tests.
+/// \param in_flight_lists The in-flight test program listings.
+/// \param budget The resources held by the in-flight tests.
+///
+/// \return The number of idle slots.
+static std::size_t
+idle_slots(const parallelism_controller& parallelism,
+           const pid_to_id_map& in_flight,
+           const pids_set& in_flight_lists,
+           const resources_budget& budget)
+{
+    const std::size_t busy = in_flight.size() + in_flight_lists.size() +
+        budget.reserved_slots();
+    return busy < parallelism.slots() ? parallelism.slots() - busy : 0;
+}
 
-namespace {
 
+/// Suspends the execution of the process.
+///
+/// \param period The amount of time to sleep for.
+static void
+sleep_for(const datetime::delta& period)
+{
+    struct ::timespec remaining;
+    remaining.tv_sec = period.seconds;
+    remaining.tv_nsec = period.useconds * 1000;
+    while (::nanosleep(&remaining, &remaining) == -1 && errno == EINTR) {
+        // Retry with the remaining time.
+    }
+}
 
-/// Map of test program identifiers (relative paths) to their identifiers in the
-/// database.  We need to keep this in memory because test programs can be
-/// returned by the scanner in any order, and we only want to put each test
-/// program once.
-typedef std::map< fs::path, int64_t > path_to_id_map;
 
+/// Collects the files that affect the results of the selected test programs.
+///
+/// \param test_programs The test programs of the test suite.
+/// \param filters The filters selecting the test programs.
+///
+/// \return The binaries of the test programs that match the filters and the
+/// files required by their test cases.  The test cases of the test programs
+/// that were not listed during the run are unknown, so only their binaries
+/// are included; listing them here would defeat the purpose of the filters.
+static drivers::run_tests::inputs_map
+collect_inputs(const model::test_programs_vector& test_programs,
+               const std::set< engine::test_filter >& filters)
+{
+    const engine::filters_state state(filters);
+    drivers::run_tests::inputs_map inputs;
+    for (model::test_programs_vector::const_iterator iter =
+             test_programs.begin(); iter != test_programs.end(); ++iter) {
+        const model::test_program& test_program = **iter;
+        if (!state.match_test_program(test_program.relative_path()))
+            continue;
 
-/// Map of in-flight PIDs to their corresponding test case IDs.
-typedef std::map< int, int64_t > pid_to_id_map;
+        std::set< fs::path >& files = inputs[test_program.relative_path()];
+        files.insert(test_program.absolute_path());
 
+        const scheduler::lazy_test_program* lazy =
+            dynamic_cast< const scheduler::lazy_test_program* >(&test_program);
+        if (lazy != NULL && !lazy->loaded())
+            continue;
+        const model::test_cases_map& test_cases = test_program.test_cases();
+        for (model::test_cases_map::const_iterator iter2 = test_cases.begin();
+             iter2 != test_cases.end(); ++iter2) {
+            const model::paths_set& required =
+                (*iter2).second.get_metadata().required_files();
+            files.insert(required.begin(), required.end());
+        }
+    }
+    return inputs;
+}
 
-/// Pair of PID to a test case ID.
-typedef pid_to_id_map::value_type pid_and_id_pair;
+
+/// Releases the test programs of the scanner as the hooks feed them.
+///
+/// This lets the tests of a test program start as soon as the build produces
+/// its binary, instead of after the whole build completes.  All the test
+/// programs are held until fed, and those not fed by the time the feed ends
+/// are released then: their binaries were already up to date.
+class test_programs_feed : utils::noncopyable {
+    /// The scanner holding the test programs.
+    engine::scanner& _scanner;
+
+    /// The hooks feeding the test programs.
+    metrics_tracker& _hooks;
+
+    /// Whether the feed may still provide test programs.
+    bool _open;
+
+public:
+    /// Constructor.
+    ///
+    /// \param scanner_ The scanner holding the test programs.  If the hooks
+    ///     feed test programs, all of them are held from now on.
+    /// \param hooks_ The hooks feeding the test programs.
+    test_programs_feed(engine::scanner& scanner_, metrics_tracker& hooks_) :
+        _scanner(scanner_), _hooks(hooks_),
+        _open(hooks_.feeds_test_programs())
+    {
+        if (_open)
+            _scanner.hold();
+    }
+
+    /// Checks whether the feed may still provide test programs.
+    ///
+    /// \return True if the test programs are still being fed.
+    bool
+    open(void) const
+    {
+        return _open;
+    }
+
+    /// Releases the test programs fed since the last call.
+    ///
+    /// \param wait Whether to block until the hooks feed any test program or
+    ///     the feed ends.
+    ///
+    /// \return True if any test program was released.
+    bool
+    pull(const bool wait)
+    {
+        if (!_open)
+            return false;
+
+        std::vector< fs::path > paths;
+        _open = _hooks.feed_test_programs(paths, wait);
+        std::size_t released = 0;
+        for (std::vector< fs::path >::const_iterator iter = paths.begin();
+             iter != paths.end(); ++iter) {
+            const std::size_t count = _scanner.release(*iter);
+            if (count == 0)
+                LD(F("Ignoring fed path %s: not a pending test program") %
+                   *iter);
+            released += count;
+        }
+        if (!_open) {
+            LI(F("Test programs feed ended; releasing the %s not fed") %
+               _scanner.held_test_programs());
+            released += _scanner.held_test_programs();
+            _scanner.release_all();
+        }
+        return released > 0;
+    }
+};
 
 
-/// Puts a test program in the store and returns its identifier.
+/// Waits for the completion of any subprocess, giving up at a deadline.
 ///
-/// This function is idempotent: we maintain a side cache of already-put test
-/// programs so that we can return their identifiers without having to put them
-/// again.
-/// TODO(jmmv): It's possible that the store module should offer this
-/// functionality and not have to do this ourselves here.
+/// If the hooks want to be polled, the wait never blocks for longer than the
+/// polling period so that the hooks get to run in between.  The same goes for
+/// the feed of test programs, and the wait ends as soon as the feed releases
+/// any test program so that its tests can start.
 ///
-/// \param test_program The test program being put.
-/// \param [in,out] tx Writable transaction on the store.
-/// \param [in,out] ids_cache Cache of already-put test programs.
+/// \param [in,out] handle Scheduler handle.
+/// \param deadline Time at which to stop waiting; none to wait for as long as
+///     needed.
+/// \param [in,out] hooks The hooks to poll while waiting.
+/// \param [in,out] feed The feed of test programs to poll while waiting, if
+///     any.
 ///
-/// \return A test program identifier.
-static int64_t
-find_test_program_id(const model::test_program_ptr test_program,
-                     store::write_transaction& tx,
-                     path_to_id_map& ids_cache)
+/// \return The result of the completed subprocess, or none if the deadline
+/// passed or the feed released a test program before any completed.
+static optional< scheduler::result_handle_ptr >
+wait_for_completion(scheduler::scheduler_handle& handle,
+                    const optional< datetime::monotonic_time >& deadline,
+                    metrics_tracker& hooks, test_programs_feed* feed)
 {
-    const fs::path& key = test_program->relative_path();
-    std::map< fs::path, int64_t >::const_iterator iter = ids_cache.find(key);
-    if (iter == ids_cache.end()) {
-        const int64_t id = tx.put_test_program(*test_program);
-        ids_cache.insert(std::make_pair(key, id));
-        return id;
-    } else {
-        return (*iter).second;
+    const bool polling = hooks.wants_polling();
+    const bool feeding = feed != NULL && feed->open();
+    if (!deadline && !polling && !feeding)
+        return utils::make_optional(handle.wait_any());
+
+    for (;;) {
+        const optional< scheduler::result_handle_ptr > result_handle =
+            handle.poll_any();
+        if (result_handle ||
+            (deadline && datetime::monotonic_time::now() >= deadline.get()))
+            return result_handle;
+        if (feeding && feed->pull(false))
+            return none;
+        if (polling)
+            hooks.poll();
+        sleep_for(straggler_poll_period);
     }
 }
 
 
-/// Stores the result of an execution in the database.
+/// Accounts for the completion of a subprocess spawned by the driver.
 ///
-/// \param test_case_id Identifier of the test case in the database.
-/// \param result The result of the execution.
-/// \param [in,out] tx Writable transaction where to store the result data.
+/// Listings are done once their result handle is cleaned up because the
+/// scheduler has already handed the test cases to the listed test program, so
+/// the scanner will pick them up.  Completed tests are queued for later
+/// processing by finish_test(), except for the copies of the stragglers that
+/// lost, which are discarded.  The scheduler stops tracking the subprocess as
+/// soon as it returns its result, so the queued tests do not keep their PIDs
+/// reserved while further tests are spawned: only the storage of their results
+/// and the cleanup of their work directories are deferred.
+///
+/// \param result_handle The completion handle of the subprocess.
+/// \param [in,out] in_flight The in-flight tests.
+/// \param [in,out] in_flight_lists The in-flight test program listings.
+/// \param [in,out] finished The completed tests pending processing.
+/// \param [in,out] budget The resources held by the in-flight tests.
+/// \param [in,out] limits The groups and suite slots held by the in-flight
+///     tests.
+/// \param [in,out] slots The execution slots held by the in-flight tests.
+/// \param [in,out] speculation The copies of the stragglers.
+/// \param [in,out] handle Scheduler handle to terminate the losing copies.
+/// \param [in,out] terminated The tests terminated by the driver.
+/// \param [in,out] tx Writable transaction to record the listings in.
 static void
-put_test_result(const int64_t test_case_id,
-                const scheduler::test_result_handle& result,
-                store::write_transaction& tx)
+record_completion(scheduler::result_handle_ptr result_handle,
+                  pid_to_id_map& in_flight,
+                  pids_set& in_flight_lists,
+                  finished_tests_vector& finished,
+                  resources_budget& budget,
+                  concurrency_limits& limits,
+                  cpu_slots& slots,
+                  speculative_runs& speculation,
+                  scheduler::scheduler_handle& handle,
+                  pids_set& terminated,
+                  store::write_transaction& tx)
 {
-    tx.put_result(result.test_result(), test_case_id,
-                  result.start_time(), result.end_time());
-    tx.put_test_case_file("__STDOUT__", result.stdout_file(), test_case_id);
-    tx.put_test_case_file("__STDERR__", result.stderr_file(), test_case_id);
+    const pids_set::iterator list_iter = in_flight_lists.find(
+        result_handle->original_pid());
+    if (list_iter != in_flight_lists.end()) {
+        const scheduler::list_result_handle* list_result_handle =
+            dynamic_cast< const scheduler::list_result_handle* >(
+                result_handle.get());
+        INV(list_result_handle != NULL);
+        tx.put_run_event(
+            "list", list_result_handle->test_program()->relative_path().str(),
+            utils::make_optional(result_handle->original_pid()),
+            result_handle->start_time(), result_handle->end_time());
+        in_flight_lists.erase(list_iter);
+        result_handle->cleanup();
+        return;
+    }
 
+    const pid_to_id_map::iterator iter = in_flight.find(
+        result_handle->original_pid());
+    INV_MSG(iter != in_flight.end(),
+            F("Lost track of in-flight PID %s; tracking %s") %
+            result_handle->original_pid() % format_pids(in_flight));
+    if (speculation.completed((*iter).first, handle, terminated)) {
+        LD(F("Discarding the copy of a test with PID %s that lost") %
+           (*iter).first);
+        (void)safe_cleanup(*dynamic_cast< const scheduler::test_result_handle* >(
+                               result_handle.get()));
+    } else
+        finished.push_back(finished_test_pair(result_handle, (*iter).second));
+    budget.release((*iter).first);
+    limits.release((*iter).first);
+    slots.release((*iter).first);
+    in_flight.erase(iter);
 }
 
 
-/// Cleans up a test case and folds any errors into the test result.
+/// Constructs the SQLite settings for the store from the configuration.
 ///
-/// \param handle The result handle for the test.
+/// \param user_config The end-user configuration properties.
 ///
-/// \return The test result if the cleanup succeeds; a broken test result
-/// otherwise.
-model::test_result
-safe_cleanup(scheduler::test_result_handle handle) throw()
+/// \return The profile to open the store with; unset configuration variables
+/// leave the corresponding settings unset.
+static store::write_profile
+get_store_profile(const config::tree& user_config)
+{
+    store::write_profile profile;
+    if (user_config.is_set("store_journal_mode"))
+        profile.journal_mode = user_config.lookup< config::string_node >(
+            "store_journal_mode");
+    if (user_config.is_set("store_synchronous"))
+        profile.synchronous = user_config.lookup< config::string_node >(
+            "store_synchronous");
+    if (user_config.is_set("store_cache_size"))
+        profile.cache_size = user_config.lookup< config::int_node >(
+            "store_cache_size");
+    if (user_config.is_set("store_mmap_size"))
+        profile.mmap_size = user_config.lookup< config::int_node >(
+            "store_mmap_size");
+    if (user_config.is_set("store_page_size"))
+        profile.page_size = user_config.lookup< config::int_node >(
+            "store_page_size");
+    return profile;
+}
+
+
+/// Loads the outcome of the test cases recorded in a previous run.
+///
+/// \param results_file Path to the results file of the previous run.
+/// \param [out] durations The duration of every test case in the results file.
+/// \param [out] failed The test cases whose result was a failure; may be NULL
+///     if the caller does not care about them.
+///
+/// Both collections are left empty if the file cannot be read.  A missing
+/// history only affects the order in which tests run, so this is not fatal.
+static void
+load_history(const fs::path& results_file, engine::durations_map& durations,
+             engine::test_case_ids_set* failed)
 {
     try {
-        handle.cleanup();
-        return handle.test_result();
-    } catch (const std::exception& e) {
-        return model::test_result(
-            model::test_result_broken,
-            F("Failed to clean up test case's work directory %s: %s") %
-            handle.work_directory() % e.what());
+        store::read_backend db = store::read_backend::open_ro(results_file);
+        store::read_transaction tx = db.start_read();
+        for (store::results_iterator iter = tx.get_results(
+                 store::results_filter().without_files()); iter; ++iter) {
+            const engine::test_case_id id(
+                iter.test_program()->relative_path(), iter.test_case_name());
+            durations[id] = iter.end_time() - iter.start_time();
+            if (failed != NULL && !iter.result().good())
+                failed->insert(id);
+        }
+        LI(F("Loaded %s test case durations from %s") % durations.size() %
+           results_file);
+    } catch (const store::error& e) {
+        LW(F("Cannot load test case durations from %s: %s") % results_file %
+           e.what());
+        durations.clear();
+        if (failed != NULL)
+            failed->clear();
     }
 }
 
 
-/// Starts a test asynchronously.
+/// Loads the test cases that already have a result in a results file.
 ///
-/// \param handle Scheduler handle.
-/// \param match Test program and test case to start.
-/// \param [in,out] tx Writable transaction to obtain test IDs.
-/// \param [in,out] ids_cache Cache of already-put test cases.
-/// \param user_config The end-user configuration properties.
-/// \param hooks The hooks for this execution.
+/// \param db The results file of the interrupted run to resume.
 ///
-/// \returns The PID for the started test and the test case's identifier in the
-/// store.
-pid_and_id_pair
-start_test(scheduler::scheduler_handle& handle,
-           const engine::scan_result& match,
-           store::write_transaction& tx,
-           path_to_id_map& ids_cache,
-           const config::tree& user_config,
-           drivers::run_tests::base_hooks& hooks)
+/// \return The identifiers of the test cases with a result, qualified by the
+/// variant of their test program.
+///
+/// \throw store::error If the results file cannot be read.  The run cannot
+///     be resumed without knowing what it ran already, so this is fatal.
+static engine::variant_test_case_ids_set
+load_completed(store::write_backend& db)
 {
-    const model::test_program_ptr test_program = match.first;
-    const std::string& test_case_name = match.second;
+    engine::variant_test_case_ids_set completed;
+    store::read_backend reader = store::read_backend::from_database(
+        db.database());
+    store::read_transaction tx = reader.start_read();
+    for (store::results_iterator iter = tx.get_results(
+             store::results_filter().without_files()); iter; ++iter)
+        completed.insert(engine::variant_test_case_id(
+            engine::test_case_id(iter.test_program()->relative_path(),
+                                 iter.test_case_name()),
+            iter.test_program()->variant()));
+    tx.finish();
+    LI(F("Resuming run with %s test cases already done") % completed.size());
+    return completed;
+}
 
-    hooks.got_test_case(*test_program, test_case_name);
 
-    const int64_t test_program_id = find_test_program_id(
-        test_program, tx, ids_cache);
-    const int64_t test_case_id = tx.put_test_case(
-        *test_program, test_case_name, test_program_id);
+/// Loads the cache keys of the test cases that passed in a previous run.
+///
+/// \param results_file Path to the results file of the previous run.
+/// \param [in,out] cache The cache into which to load the keys.  Test cases
+///     that are not found in the cache simply run, so a results file that
+///     cannot be read is not fatal.
+static void
+load_cache_keys(const fs::path& results_file, engine::result_cache& cache)
+{
+    try {
+        store::read_backend db = store::read_backend::open_ro(results_file);
+        store::read_transaction tx = db.start_read();
+        std::size_t count = 0;
+        for (store::results_iterator iter = tx.get_results(
+                 store::results_filter()
+                 .add_result_type(model::test_result_passed)
+                 .without_files()); iter; ++iter) {
+            const optional< std::string > cache_key = iter.cache_key();
+            if (cache_key) {
+                cache.add_passed(iter.test_program()->relative_path(),
+                                 iter.test_case_name(), cache_key.get());
+                ++count;
+            }
+        }
+        LI(F("Loaded %s cached test case results from %s") % count %
+           results_file);
+    } catch (const store::error& e) {
+        LW(F("Cannot load cached test case results from %s: %s") %
+           results_file % e.what());
+    }
+}
+
 
-    const scheduler::exec_handle exec_handle = handle.spawn_test(
-        test_program, test_case_name, user_config);
-    return std::make_pair(exec_handle, test_case_id);
+}  // anonymous namespace
+
+
+/// Pure abstract destructor.
+drivers::run_tests::base_hooks::~base_hooks(void)
+{
 }
 
 
-/// Processes the completion of a test.
+/// Provides the receiver of the events of the scheduler.
 ///
-/// \param [in,out] result_handle The completion handle of the test subprocess.
-/// \param test_case_id Identifier of the test case as returned by start_test().
-/// \param [in,out] tx Writable transaction to put the test results.
-/// \param hooks The hooks for this execution.
+/// The default implementation does not observe the scheduler.
 ///
-/// \post result_handle is cleaned up.  The caller cannot clean it up again.
+/// \return An observer that must outlive the driver, or NULL for none.
+engine::scheduler::observer*
+drivers::run_tests::base_hooks::scheduler_observer(void)
+{
+    return NULL;
+}
+
+
+/// Called periodically with the metrics of the run, and once at its end.
+///
+/// The default implementation ignores the metrics.
 void
-finish_test(scheduler::result_handle_ptr result_handle,
-            const int64_t test_case_id,
-            store::write_transaction& tx,
-            drivers::run_tests::base_hooks& hooks)
+drivers::run_tests::base_hooks::got_metrics(const metrics& /* metrics */)
 {
-    const scheduler::test_result_handle* test_result_handle =
-        dynamic_cast< const scheduler::test_result_handle* >(
-            result_handle.get());
+}
 
-    put_test_result(test_case_id, *test_result_handle, tx);
 
-    const model::test_result test_result = safe_cleanup(*test_result_handle);
-    hooks.got_result(
-        *test_result_handle->test_program(),
-        test_result_handle->test_case_name(),
-        test_result_handle->test_result(),
-        result_handle->end_time() - result_handle->start_time());
+/// Checks whether poll() has to be called periodically while waiting for tests.
+///
+/// The default implementation does not want to be polled.
+///
+/// \return True to be polled; false to let the driver block.
+bool
+drivers::run_tests::base_hooks::wants_polling(void)
+{
+    return false;
 }
 
 
-/// Extracts the keys of a pid_to_id_map and returns them as a string.
+/// Called periodically while the driver waits for tests to complete.
 ///
-/// \param map The PID to test ID map from which to get the PIDs.
+/// This is only called if wants_polling() returns true.  The default
+/// implementation does nothing.
+void
+drivers::run_tests::base_hooks::poll(void)
+{
+}
+
+
+/// Checks whether the test programs to run are fed while the run progresses.
 ///
-/// \return A user-facing string with the collection of PIDs.
-static std::string
-format_pids(const pid_to_id_map& map)
+/// If so, the driver holds all the test programs until feed_test_programs()
+/// provides them, e.g. as the build produces their binaries, and runs those
+/// not provided once the feed ends.  The default implementation does not feed
+/// any test program.
+///
+/// \return True to feed the test programs; false to run them right away.
+bool
+drivers::run_tests::base_hooks::feeds_test_programs(void)
 {
-    std::set< pid_to_id_map::key_type > pids;
-    for (pid_to_id_map::const_iterator iter = map.begin(); iter != map.end();
-         ++iter) {
-        pids.insert(iter->first);
-    }
-    return text::join(pids, ",");
+    return false;
 }
 
 
-}  // anonymous namespace
+/// Collects the test programs that became available to run.
+///
+/// This is only called if feeds_test_programs() returns true.  The default
+/// implementation ends the feed right away.
+///
+/// \param [out] unused_paths The paths to the available test programs, either
+///     absolute or relative to the root of the test suite.
+/// \param unused_wait Whether to block until there is any path to add or the
+///     feed ends; if false, only the paths already available are added.
+///
+/// \return False once the feed has ended; true otherwise.
+bool
+drivers::run_tests::base_hooks::feed_test_programs(
+    std::vector< fs::path >& UTILS_UNUSED_PARAM(paths),
+    const bool UTILS_UNUSED_PARAM(wait))
+{
+    return false;
+}
 
 
-/// Pure abstract destructor.
-drivers::run_tests::base_hooks::~base_hooks(void)
+/// Checks whether the configuration has to change for the rest of the run.
+///
+/// This is called between the spawns of tests, so a change takes effect once
+/// the driver is done waiting for the running tests.  Only the parallelism
+/// settings of the new configuration are applied to the ongoing run.  The
+/// default implementation never changes the configuration.
+///
+/// \param [out] unused_user_config The new end-user configuration properties.
+///
+/// \return True if user_config was replaced; false to keep the current
+/// configuration.
+bool
+drivers::run_tests::base_hooks::reload_config(
+    config::tree& UTILS_UNUSED_PARAM(user_config))
+{
+    return false;
+}
+
+
+/// Constructor with all the metrics set to zero.
+drivers::run_tests::metrics::metrics(void) :
+    timestamp(datetime::timestamp::from_microseconds(0)),
+    started(0),
+    running(0),
+    pending_test_programs(0),
+    queued_test_cases(0),
+    output_size(0)
 {
 }
 
@@ -244,101 +3575,552 @@ drivers::run_tests::base_hooks::~base_hooks(void)
 ///
 /// \param kyuafile_path The path to the Kyuafile to be loaded.
 /// \param build_root If not none, path to the built test programs.
-/// \param store_path The path to the store to be used.
+/// \param store_path The path to the store to be used, or none to keep the
+///     results in memory only.  If the store_in_memory configuration variable
+///     is set, the results are also kept in memory during the run and are only
+///     written to this path once it completes.
+/// \param resume Whether store_path holds the results of an interrupted run
+///     to continue.  If so, the test cases that have a result in it are not
+///     run again and the new results are appended to it.
+/// \param previous_results If not none, path to the results of a previous run
+///     of the same test suite.  When running tests in parallel, the durations
+///     recorded in this file are used to start the longest test cases first.
+///     When result caching is enabled, the test cases that passed in this run
+///     are not run again if their inputs did not change.
 /// \param filters The test case filters as provided by the user.
+/// \param shard If not none, subset of the test cases to run.
+/// \param metadata_filters Predicates that the metadata of the test cases to
+///     run must satisfy.
+/// \param changes If not none, changed files that the test cases to run must
+///     be affected by.
+/// \param failed_first Whether to run the test cases that failed in the
+///     previous run first, followed by the test cases that did not exist in
+///     it.
+/// \param max_failures If not none, number of failed test cases after which
+///     to stop the run.  No further test cases are started and the in-flight
+///     ones are terminated, which stores them as skipped.
+/// \param repeat Number of times to run every test case; 0 to repeat them
+///     until until_fail stops the run.  Every repetition is stored as a
+///     separate test case and result caching is disabled.
+/// \param until_fail Whether to stop starting repetitions once a test case
+///     does not pass.
 /// \param user_config The end-user configuration properties.
-/// \param hooks The hooks for this execution.
+/// \param user_hooks The hooks for this execution.
+/// \param report_hooks If not NULL, hooks to feed the stored results to once
+///     the run completes.  The results are read back through the connection
+///     used to write them, so this works for in-memory stores too and does not
+///     require opening the results file again.
 ///
 /// \returns A structure with all results computed by this driver.
 drivers::run_tests::result
 drivers::run_tests::drive(const fs::path& kyuafile_path,
                           const optional< fs::path > build_root,
-                          const fs::path& store_path,
+                          const optional< fs::path >& store_path,
+                          const bool resume,
+                          const optional< fs::path >& previous_results,
                           const std::set< engine::test_filter >& filters,
+                          const optional< engine::test_shard >& shard,
+                          const std::vector< engine::metadata_filter >&
+                              metadata_filters,
+                          const optional< engine::change_filter >& changes,
+                          const bool failed_first,
+                          const optional< std::size_t >& max_failures,
+                          const std::size_t repeat,
+                          const bool until_fail,
                           const config::tree& user_config,
-                          base_hooks& hooks)
+                          base_hooks& user_hooks,
+                          scan_results::base_hooks* report_hooks)
 {
+    PRE(repeat > 0 || until_fail);
+    PRE(!resume || (store_path && repeat == 1));
+
+    metrics_tracker hooks(user_hooks);
+
     scheduler::scheduler_handle handle = scheduler::setup();
+    scheduler_cleaner cleaner(handle);
+    handle.set_list_cache(engine::list_cache(
+        store::layout::query_list_cache_dir()));
+    handle.set_observer(hooks.scheduler_observer());
+    if (user_config.is_set("tmpfs_work_directory") &&
+        user_config.lookup< config::bool_node >("tmpfs_work_directory")) {
+        try {
+            handle.mount_root_tmpfs();
+        } catch (const fs::error& e) {
+            LW(F("Cannot mount tmpfs on the work directory; continuing on "
+                 "disk: %s") % e.what());
+        }
+    }
+    bool work_namespace = false;
+    if (user_config.is_set("tmpfs_work_namespace") &&
+        user_config.lookup< config::bool_node >("tmpfs_work_namespace")) {
+        try {
+            handle.isolate_work_mounts(
+                user_config.is_set("tmpfs_work_size") ?
+                user_config.lookup< engine::bytes_node >("tmpfs_work_size") :
+                units::bytes(0));
+            work_namespace = true;
+        } catch (const fs::error& e) {
+            LW(F("Cannot isolate work directories in mount namespaces; "
+                 "continuing without them: %s") % e.what());
+        }
+    }
+    if (!work_namespace && user_config.is_set("tmpfs_work_size")) {
+        try {
+            handle.mount_work_tmpfs(
+                user_config.lookup< engine::bytes_node >("tmpfs_work_size"));
+        } catch (const fs::error& e) {
+            LW(F("Cannot mount tmpfs on each work directory; continuing "
+                 "without them: %s") % e.what());
+        }
+    }
 
     const engine::kyuafile kyuafile = engine::kyuafile::load(
-        kyuafile_path, build_root, user_config, handle);
-    store::write_backend db = store::write_backend::open_rw(store_path);
+        kyuafile_path, build_root, user_config, handle,
+        engine::kyuafile_cache(store::layout::query_kyuafile_cache_dir()));
+    // The history has to be loaded before creating the results file of this
+    // run, or else the trends index would pick up the run as an empty one.
+    adaptive_timeouts timeouts(kyuafile_path, user_config);
+    speculative_runs speculation(kyuafile_path, user_config);
+    concurrency_limits limits(kyuafile.test_programs(), user_config);
+    // A resumed run has to append to its results file as it goes, or else
+    // another interruption would lose its progress again.
+    const bool in_memory = !store_path ||
+        (!resume && user_config.is_set("store_in_memory") &&
+         user_config.lookup< config::bool_node >("store_in_memory"));
+    // Do not find out that the results cannot be saved after running all the
+    // tests.
+    if (in_memory && store_path)
+        store::write_backend::check_save(store_path.get());
+    store::write_backend db = in_memory ?
+        store::write_backend::open_in_memory() : resume ?
+        store::write_backend::open_append(store_path.get(),
+                                          get_store_profile(user_config)) :
+        store::write_backend::open_rw(store_path.get(),
+                                      get_store_profile(user_config));
+    engine::variant_test_case_ids_set completed;
+    if (resume)
+        completed = load_completed(db);
     store::write_transaction tx = db.start_write();
+    tx.set_compression_level(user_config.lookup< config::int_node >(
+        "store_compression_level"));
+    if (user_config.is_set("store_segment_threshold"))
+        tx.set_segment_threshold(static_cast< std::size_t >(
+            user_config.lookup< engine::bytes_node >(
+                "store_segment_threshold")));
+    const bool store_sub_results =
+        user_config.is_set("store_sub_results") &&
+        user_config.lookup< config::bool_node >("store_sub_results");
 
-    {
+    if (resume) {
+        // The context was stored when the run started.
+        const std::size_t discarded = tx.discard_pending_test_cases();
+        LI(F("Discarded %s test cases left without a result") % discarded);
+    } else {
         const model::context context = scheduler::current_context();
         (void)tx.put_context(context);
     }
 
-    engine::scanner scanner(kyuafile.test_programs(), filters);
+    parallelism_controller parallelism(user_config);
+    slot_usage usage(parallelism.max());
+
+    // The order of the tests only matters when they run in parallel, unless
+    // the user asked to rerun previous failures first: starting the longest
+    // ones first prevents them from extending the run on their own once
+    // everything else is done.
+    engine::durations_map durations;
+    optional< engine::test_case_ids_set > failed;
+    if (failed_first)
+        failed = engine::test_case_ids_set();
+    if ((parallelism.max() > 1 || failed_first) && previous_results)
+        load_history(previous_results.get(), durations,
+                     failed ? &failed.get() : NULL);
+    const bool program_affinity =
+        user_config.is_set("program_affinity") &&
+        user_config.lookup< config::bool_node >("program_affinity");
+    engine::scanner scanner(kyuafile.test_programs(), filters, durations,
+                            shard, failed, metadata_filters, changes,
+                            program_affinity);
+    if (!completed.empty())
+        scanner.skip(completed);
 
-    path_to_id_map ids_cache;
+    repeats_queue repeats(repeat, until_fail);
+
+    // Repetitions are meant to run the test cases for real, so they would make
+    // no sense if cached results could stand in for them.
+    optional< engine::result_cache > cache;
+    if (!repeats.enabled() && user_config.is_set("cache_results") &&
+        user_config.lookup< config::bool_node >("cache_results")) {
+        cache = engine::result_cache();
+        if (previous_results)
+            load_cache_keys(previous_results.get(), cache.get());
+    }
+
+    // Uploads need a file to end up in.
+    std::auto_ptr< store::uploader > uploader;
+    if (store_path && user_config.is_set("store_upload_command"))
+        uploader.reset(new store::uploader(
+            fs::path(user_config.lookup< config::string_node >(
+                "store_upload_command")), store_path.get()));
+    checkpointer checkpoints(db, tx, uploader.get(), user_config);
+    resources_budget budget(user_config);
+    cpu_slots slots(user_config, parallelism.max());
+    work_claims claims(user_config);
+    // Test cases can only be put in advance if this instance is going to run
+    // all of them.
+    test_ids_cache ids_cache(scanner, !claims.enabled() && !max_failures);
     pid_to_id_map in_flight;
+    pids_set in_flight_lists;
+    finished_tests_vector finished;
     std::vector< engine::scan_result > exclusive_tests;
+    failures_limit failures(max_failures);
+    broken_programs breakers(user_config);
+    program_prefetcher prefetcher(user_config);
+    test_cases_releaser releaser(user_config, scanner, repeats.enabled());
+    retries_queue retries(user_config);
+    pids_set terminated;
+    utils::latency_histograms_map latencies;
+    test_programs_feed feed(scanner, hooks);
+    bool scanned = false;
 
-    const std::size_t slots = user_config.lookup< config::positive_int_node >(
-        "parallelism");
-    INV(slots >= 1);
     do {
-        INV(in_flight.size() <= slots);
+        INV(in_flight.size() + in_flight_lists.size() +
+            budget.reserved_slots() <= parallelism.max());
+
+        {
+            config::tree new_config(false);
+            if (hooks.reload_config(new_config))
+                parallelism.reconfigure(new_config);
+        }
+
+        // In sequential mode, the hooks expect the result of a test case to be
+        // reported before the next test case starts.  There is nothing to
+        // overlap in this mode anyway.
+        if (parallelism.max() == 1)
+            finish_tests(finished, terminated, store_sub_results, tx,
+                         checkpoints, failures, repeats, retries, latencies,
+                         timeouts, breakers, usage, releaser, hooks);
 
         // Spawn as many jobs as needed to fill our execution slots.  We do this
         // first with the assumption that the spawning is faster than any single
         // job, so we want to keep as many jobs in the background as possible.
-        while (in_flight.size() < slots) {
-            optional< engine::scan_result > match = scanner.yield();
-            if (!match)
+        //
+        // Test cases of already-listed test programs take precedence.  Only if
+        // there are none available do we use the free slots to list further
+        // test programs, which happens asynchronously so that the listings run
+        // concurrently with each other and with any in-flight tests.
+        //
+        // Retries of failed tests go before anything else so that their final
+        // results are not delayed until the end of the run.  They do not queue
+        // for resources, for their exclusive group or for their test suite, so
+        // they never hold back other tests.  Next come the tests waiting for
+        // any of these so that they are not starved by tests yielded later.
+        // Repetitions only start once the scanner is done so that they run in
+        // rounds over the whole set of test cases.  Tests that declare several
+        // CPUs occupy as many slots.
+        usage.enter("spawn");
+        (void)feed.pull(false);
+        for (;;) {
+            const std::size_t busy = in_flight.size() + in_flight_lists.size() +
+                budget.reserved_slots();
+            if (failures.reached() || busy >= parallelism.slots())
                 break;
-            const model::test_program_ptr test_program = match.get().first;
-            const std::string& test_case_name = match.get().second;
-
-            const model::test_case& test_case = test_program->find(
-                test_case_name);
-            if (test_case.get_metadata().is_exclusive()) {
-                // Exclusive tests get processed later, separately.
-                exclusive_tests.push_back(match.get());
-                continue;
+            budget.set_free_slots(parallelism.slots() - busy,
+                                  parallelism.slots());
+
+            if (retries.has_pending()) {
+                const retries_queue::pending& retry = retries.front();
+                if (budget.can_start(retry.match) &&
+                    limits.try_claim(retry.match)) {
+                    const pid_and_id_pair pid_id = start_retry(
+                        handle, retry, tx, slots, timeouts, user_config);
+                    INV_MSG(in_flight.find(pid_id.first) == in_flight.end(),
+                            F("Spawned test has PID of still-tracked "
+                              "process %s") % pid_id.first);
+                    budget.acquire(pid_id.first, retry.match);
+                    limits.started(pid_id.first, retry.match);
+                    in_flight.insert(pid_id);
+                    speculation.started(pid_id.first, retry.match, timeouts,
+                                        limits);
+                    retries.started_front();
+                    continue;
+                }
+            }
+
+            optional< engine::scan_result > match = budget.next_deferred();
+            if (!match) {
+                match = limits.next_unblocked();
+                if (match && !budget.admit(match.get()))
+                    continue;
+            }
+            if (!match && scanned && repeats.has_pending()) {
+                match = repeats.next();
+                if (!limits.claim(match.get()) || !budget.admit(match.get()))
+                    continue;
+            }
+            if (!match) {
+                match = scanner.try_yield();
+                if (match)
+                    releaser.yielded(match.get());
+                if (!match) {
+                    const optional< model::test_program_ptr > test_program =
+                        scanner.yield_unlisted();
+                    if (!test_program) {
+                        if (!scanned && scanner.done()) {
+                            scanned = true;
+                            continue;
+                        }
+                        break;
+                    }
+                    if (handle.load_cached_list(test_program.get(),
+                                                user_config))
+                        continue;
+                    const datetime::timestamp start =
+                        datetime::timestamp::now();
+                    const scheduler::exec_handle exec_handle =
+                        handle.spawn_list(test_program.get(), user_config);
+                    tx.put_run_event(
+                        "spawn", test_program.get()->relative_path().str(),
+                        none, start, datetime::timestamp::now());
+                    in_flight_lists.insert(exec_handle);
+                    continue;
+                }
+
+                // Claims are never given back, so only claim tests that
+                // this instance is committed to run.
+                if (!claims.claim(match.get())) {
+                    releaser.done(match.get().first);
+                    continue;
+                }
+
+                // Skipped tests need not occupy a slot nor hold back any
+                // exclusive or grouped tests, so record them right away.  This
+                // comes before the result cache lookup because computing the
+                // cache key requires hashing the test program.
+                const std::string skip_reason = handle.check_requirements(
+                    match.get().first, match.get().second, user_config);
+                if (!skip_reason.empty()) {
+                    put_unrun_result(match.get(), model::test_result(
+                                         model::test_result_skipped,
+                                         skip_reason),
+                                     tx, ids_cache, hooks);
+                    checkpoints.got_result();
+                    releaser.done(match.get().first);
+                    continue;
+                }
+
+                // Neither are the tests of programs that keep breaking, which
+                // would only break once more.
+                const optional< model::test_result > broken_result =
+                    breakers.result_for(match.get().first);
+                if (broken_result) {
+                    put_unrun_result(match.get(), broken_result.get(), tx,
+                                     ids_cache, hooks);
+                    failures.got_result(broken_result.get());
+                    checkpoints.got_result();
+                    releaser.done(match.get().first);
+                    continue;
+                }
+
+                const optional< std::string > cache_key = get_cache_key(
+                    cache, match.get(), user_config);
+                if (cache_key && cache.get().has_passed(
+                        match.get().first->relative_path(),
+                        match.get().second, cache_key.get())) {
+                    put_cached_result(match.get(), cache_key.get(), tx,
+                                      ids_cache, hooks);
+                    checkpoints.got_result();
+                    releaser.done(match.get().first);
+                    continue;
+                }
+
+                const model::test_case& test_case = match.get().first->find(
+                    match.get().second);
+                if (test_case.get_metadata().is_exclusive()) {
+                    // Exclusive tests get processed later, separately.
+                    exclusive_tests.push_back(match.get());
+                    continue;
+                }
+
+                repeats.add(match.get());
+                if (!limits.claim(match.get()) || !budget.admit(match.get()))
+                    continue;
             }
 
             const pid_and_id_pair pid_id = start_test(
-                handle, match.get(), tx, ids_cache, user_config, hooks);
+                handle, match.get(),
+                get_cache_key(cache, match.get(), user_config), tx,
+                ids_cache, slots, timeouts, user_config, hooks);
             INV_MSG(in_flight.find(pid_id.first) == in_flight.end(),
                     F("Spawned test has PID of still-tracked process %s") %
                     pid_id.first);
+            budget.acquire(pid_id.first, match.get());
+            limits.started(pid_id.first, match.get());
             in_flight.insert(pid_id);
+            speculation.started(pid_id.first, match.get(), timeouts, limits);
         }
 
-        // If there are any used slots, consume any at random and return the
-        // result.  We consume slots one at a time to give preference to the
-        // spawning of new tests as detailed above.
-        if (!in_flight.empty()) {
-            scheduler::result_handle_ptr result_handle = handle.wait_any();
+        // Once there is nothing else left to start, the idle slots can run
+        // copies of the tests that are taking much longer than usual.
+        const bool tail = scanned && !failures.reached() &&
+            !retries.has_pending() && !repeats.has_pending() &&
+            !budget.has_deferred() && !limits.has_waiting();
+        if (tail)
+            speculation.launch(handle, idle_slots(parallelism, in_flight,
+                                                  in_flight_lists, budget),
+                               in_flight, tx, timeouts, user_config);
+        usage.set_busy(in_flight.size() + budget.reserved_slots(),
+                       in_flight_lists.size());
+        usage.enter("idle");
+
+        // Warm up the test programs that are going to fill the slots next
+        // while the current ones run, and prepare the spawns of their tests
+        // so that they start as soon as the slots free up.
+        prefetcher.look_ahead(scanner);
+        handle.prepare_spawns(
+            scanner.upcoming_test_programs(parallelism.slots()), user_config,
+            parallelism.slots());
+
+        // Now that the slots are busy again, store the results of the tests
+        // that completed during the previous iteration.  Doing this after
+        // refilling the slots overlaps the database writes and the cleanup of
+        // the work directories with the execution of further tests.
+        finish_tests(finished, terminated, store_sub_results, tx, checkpoints,
+                     failures, repeats, retries, latencies, timeouts,
+                     breakers, usage, releaser, hooks);
 
-            const pid_to_id_map::iterator iter = in_flight.find(
-                result_handle->original_pid());
-            INV_MSG(iter != in_flight.end(),
-                    F("Lost track of in-flight PID %s; tracking %s") %
-                    result_handle->original_pid() % format_pids(in_flight));
-            const int64_t test_case_id = (*iter).second;
-            in_flight.erase(iter);
+        // Once there are too many failures, there is no point in waiting for
+        // the in-flight tests: their results would not change the outcome.
+        if (failures.reached())
+            terminate_in_flight(handle, in_flight, in_flight_lists,
+                                terminated);
 
-            finish_test(result_handle, test_case_id, tx, hooks);
+        hooks.report(handle, in_flight.size() + in_flight_lists.size() +
+                     budget.reserved_slots(),
+                     parallelism.slots(), scanner, exclusive_tests, 0,
+                     checkpoints, false);
+
+        // If there are any used slots, wait for at least one of them to
+        // complete and then collect any others that have completed in the
+        // meantime, so that all freed slots can be refilled at once.  Any idle
+        // slots are waiting for the listings, if there are any, as otherwise
+        // there would be test cases to start.  The wait ends early when an
+        // in-flight test becomes a straggler so that it can get a copy.
+        if (!in_flight.empty() || !in_flight_lists.empty()) {
+            const std::size_t busy = in_flight.size() + in_flight_lists.size() +
+                budget.reserved_slots();
+            usage.enter(in_flight_lists.empty() ? "idle" : "list");
+            optional< scheduler::result_handle_ptr > result_handle =
+                wait_for_completion(handle, tail ? speculation.next_deadline(
+                    idle_slots(parallelism, in_flight, in_flight_lists,
+                               budget)) : none, hooks, &feed);
+            while (result_handle) {
+                record_completion(result_handle.get(), in_flight,
+                                  in_flight_lists, finished, budget, limits,
+                                  slots, speculation, handle, terminated, tx);
+                if (in_flight.empty() && in_flight_lists.empty())
+                    break;
+                result_handle = handle.poll_any();
+            }
+            usage.set_busy(in_flight.size() + budget.reserved_slots(),
+                           in_flight_lists.size());
+            parallelism.adjust(busy);
+        } else if (feed.open() && !failures.reached()) {
+            // Nothing else can start until the build provides another test
+            // program or completes.
+            (void)feed.pull(true);
         }
-    } while (!in_flight.empty() || !scanner.done());
+    } while (!in_flight.empty() || !in_flight_lists.empty() ||
+             !finished.empty() ||
+             (!failures.reached() && (retries.has_pending() ||
+                                      repeats.has_pending() ||
+                                      budget.has_deferred() ||
+                                      limits.has_waiting() ||
+                                      !scanner.done())));
 
-    // Run any exclusive tests that we spotted earlier sequentially.
-    for (std::vector< engine::scan_result >::const_iterator
-             iter = exclusive_tests.begin(); iter != exclusive_tests.end();
-             ++iter) {
-        const pid_and_id_pair data = start_test(
-            handle, *iter, tx, ids_cache, user_config, hooks);
-        scheduler::result_handle_ptr result_handle = handle.wait_any();
-        finish_test(result_handle, data.second, tx, hooks);
+    // Run any exclusive tests that we spotted earlier sequentially, in as many
+    // rounds as requested.
+    usage.start_exclusive();
+    for (std::size_t round = 0;
+         !exclusive_tests.empty() && repeats.wants_round(round); ++round) {
+        for (std::vector< engine::scan_result >::const_iterator
+                 iter = exclusive_tests.begin();
+             !failures.reached() && repeats.wants_round(round) &&
+                 iter != exclusive_tests.end(); ++iter) {
+            usage.enter("spawn");
+            const pid_and_id_pair data = start_test(
+                handle, *iter, get_cache_key(cache, *iter, user_config), tx,
+                ids_cache, slots, timeouts, user_config, hooks);
+            usage.set_busy(1, 0);
+            usage.enter("idle");
+            hooks.report(handle, 1, 1, scanner, exclusive_tests,
+                         iter - exclusive_tests.begin() + 1, checkpoints,
+                         false);
+            int pid = data.first;
+            optional< model::test_result > result;
+            for (;;) {
+                const scheduler::result_handle_ptr result_handle =
+                    wait_for_completion(handle, none, hooks, NULL).get();
+                usage.set_busy(0, 0);
+                usage.enter("store");
+                result = finish_test(result_handle, data.second, false,
+                                     store_sub_results, tx, retries, latencies,
+                                     timeouts, breakers, usage, hooks);
+                if (result)
+                    break;
+                slots.release(pid);
+                usage.enter("spawn");
+                pid = start_retry(handle, retries.front(), tx, slots,
+                                  timeouts, user_config).first;
+                retries.started_front();
+                usage.set_busy(1, 0);
+                usage.enter("idle");
+            }
+            slots.release(pid);
+            failures.got_result(result.get());
+            repeats.got_result(result.get());
+            checkpoints.got_result();
+            releaser.done((*iter).first);
+        }
     }
 
+    // Any retries still pending when the run stops early keep the result of
+    // their last attempt.
+    usage.enter("store");
+    retries.abandon(tx, hooks);
+    hooks.report(handle, 0, 1, scanner, exclusive_tests,
+                 exclusive_tests.size(), checkpoints, true);
+
+    const utils::latency_histograms_map& scheduler_latencies =
+        handle.latencies();
+    for (utils::latency_histograms_map::const_iterator iter =
+             scheduler_latencies.begin(); iter != scheduler_latencies.end();
+         ++iter)
+        latencies[(*iter).first].merge((*iter).second);
+    if (checkpoints.latency().count() > 0)
+        latencies["checkpoint"].merge(checkpoints.latency());
+    tx.put_latencies(latencies);
+    tx.put_slot_usage(usage.usage());
+
     tx.commit();
+    if (in_memory && store_path)
+        db.save(store_path.get());
+    if (uploader.get() != NULL)
+        uploader->finish();
+
+    if (report_hooks != NULL) {
+        store::read_backend results = store::read_backend::from_database(
+            db.database());
+        (void)scan_results::drive(results, std::set< engine::test_filter >(),
+                                  *report_hooks);
+    }
 
-    handle.cleanup();
+    cleaner.cleanup();
 
-    return result(scanner.unused_filters());
+    // The filters may not have had a chance to match anything if the run
+    // stopped early, so do not report them as unused.
+    const drivers::run_tests::inputs_map inputs = collect_inputs(
+        kyuafile.test_programs(), filters);
+    if (failures.reached())
+        return result(std::set< engine::test_filter >(), latencies, inputs);
+    return result(scanner.unused_filters(), latencies, inputs);
 }
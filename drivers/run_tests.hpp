@@ -36,21 +36,75 @@
 #if !defined(DRIVERS_RUN_TESTS_HPP)
 #define DRIVERS_RUN_TESTS_HPP
 
+#include <cstddef>
+#include <map>
 #include <set>
 #include <string>
+#include <vector>
 
+#include "drivers/scan_results.hpp"
 #include "engine/filters.hpp"
+#include "engine/scheduler_fwd.hpp"
 #include "model/test_program.hpp"
 #include "model/test_result_fwd.hpp"
 #include "utils/config/tree_fwd.hpp"
-#include "utils/datetime_fwd.hpp"
+#include "utils/datetime.hpp"
 #include "utils/fs/path_fwd.hpp"
+#include "utils/latency_histogram.hpp"
 #include "utils/optional_fwd.hpp"
+#include "utils/units.hpp"
 
 namespace drivers {
 namespace run_tests {
 
 
+/// Snapshot of the progress of a run for monitoring purposes.
+class metrics {
+public:
+    /// Moment at which the snapshot was taken.
+    utils::datetime::timestamp timestamp;
+
+    /// Number of test cases whose processing has begun.
+    std::size_t started;
+
+    /// Number of results reported so far, keyed by their type.
+    std::map< model::test_result_type, std::size_t > results;
+
+    /// Number of test cases and listings currently running.
+    std::size_t running;
+
+    /// Number of test programs whose test cases are not known yet.
+    std::size_t pending_test_programs;
+
+    /// Number of known test cases waiting to be started by the scanner.
+    std::size_t queued_test_cases;
+
+    /// Time taken to spawn subprocesses.
+    utils::latency_histogram spawn_latency;
+
+    /// Time taken by the checkpoints of the results file.
+    utils::latency_histogram checkpoint_latency;
+
+    /// Size of the test case output stored so far.
+    utils::units::bytes output_size;
+
+    /// Predicted time until all test cases complete; zero if unknown.
+    ///
+    /// The prediction is based on the durations of the test cases in the
+    /// previous run and only accounts for the test cases that existed in it.
+    utils::datetime::delta predicted_remaining;
+
+    /// Test case expected to take the longest to complete, formatted as
+    /// program:name; empty if unknown.
+    std::string critical_test_case;
+
+    /// Remaining time of critical_test_case.
+    utils::datetime::delta critical_duration;
+
+    metrics(void);
+};
+
+
 /// Abstract definition of the hooks for this driver.
 class base_hooks {
 public:
@@ -73,9 +127,26 @@ public:
                             const std::string& test_case_name,
                             const model::test_result& result,
                             const utils::datetime::delta& duration) = 0;
+
+    virtual engine::scheduler::observer* scheduler_observer(void);
+    virtual void got_metrics(const metrics&);
+    virtual bool wants_polling(void);
+    virtual void poll(void);
+    virtual bool feeds_test_programs(void);
+    virtual bool feed_test_programs(std::vector< utils::fs::path >&,
+                                    const bool);
+    virtual bool reload_config(utils::config::tree&);
 };
 
 
+/// Files that affect the results of the test programs.
+///
+/// The keys are the relative paths of the test programs and the values are the
+/// absolute paths of their binaries and of the files required by their test
+/// cases.
+typedef std::map< utils::fs::path, std::set< utils::fs::path > > inputs_map;
+
+
 /// Tuple containing the results of this driver.
 class result {
 public:
@@ -85,19 +156,36 @@ public:
     /// test filter does not match any test case, it is probably a typo.
     std::set< engine::test_filter > unused_filters;
 
+    /// Latencies of the phases of the execution, keyed by phase name.
+    utils::latency_histograms_map latencies;
+
+    /// Files read by the test programs that matched the filters.
+    inputs_map inputs;
+
     /// Initializer for the tuple's fields.
     ///
     /// \param unused_filters_ The filters that did not match any test case.
-    result(const std::set< engine::test_filter >& unused_filters_) :
-        unused_filters(unused_filters_)
+    /// \param latencies_ The latencies of the phases of the execution.
+    /// \param inputs_ The files read by the test programs.
+    result(const std::set< engine::test_filter >& unused_filters_,
+           const utils::latency_histograms_map& latencies_,
+           const inputs_map& inputs_) :
+        unused_filters(unused_filters_), latencies(latencies_), inputs(inputs_)
     {
     }
 };
 
 
 result drive(const utils::fs::path&, const utils::optional< utils::fs::path >,
-             const utils::fs::path&, const std::set< engine::test_filter >&,
-             const utils::config::tree&, base_hooks&);
+             const utils::optional< utils::fs::path >&, const bool,
+             const utils::optional< utils::fs::path >&,
+             const std::set< engine::test_filter >&,
+             const utils::optional< engine::test_shard >&,
+             const std::vector< engine::metadata_filter >&,
+             const utils::optional< engine::change_filter >&, const bool,
+             const utils::optional< std::size_t >&, const std::size_t,
+             const bool, const utils::config::tree&, base_hooks&,
+             scan_results::base_hooks*);
 
 
 }  // namespace run_tests
@@ -0,0 +1,259 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "drivers/run_tests.hpp"
+
+extern "C" {
+#include <sys/stat.h>
+}
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include <atf-c++.hpp>
+
+#include "engine/config.hpp"
+#include "engine/filters.hpp"
+#include "engine/plain.hpp"
+#include "engine/scheduler.hpp"
+#include "model/test_program.hpp"
+#include "model/test_result.hpp"
+#include "store/exceptions.hpp"
+#include "store/write_backend.hpp"
+#include "utils/config/tree.ipp"
+#include "utils/datetime.hpp"
+#include "utils/env.hpp"
+#include "utils/format/macros.hpp"
+#include "utils/fs/operations.hpp"
+#include "utils/fs/path.hpp"
+#include "utils/optional.ipp"
+
+namespace config = utils::config;
+namespace datetime = utils::datetime;
+namespace fs = utils::fs;
+namespace scheduler = engine::scheduler;
+
+using utils::none;
+using utils::optional;
+
+
+namespace {
+
+
+/// Hooks to record the execution of the test cases.
+class capture_hooks : public drivers::run_tests::base_hooks {
+public:
+    /// Started test cases in program:test_case form, in order.
+    std::vector< std::string > started;
+
+    /// Results of the test cases in "program:test_case good|bad" form.
+    std::set< std::string > results;
+
+    /// Called when the processing of a test case begins.
+    ///
+    /// \param test_program The test program containing the test case.
+    /// \param test_case_name The name of the test case being executed.
+    virtual void
+    got_test_case(const model::test_program& test_program,
+                  const std::string& test_case_name)
+    {
+        started.push_back(F("%s:%s") % test_program.relative_path() %
+                          test_case_name);
+    }
+
+    /// Called when a result of a test case becomes available.
+    ///
+    /// \param test_program The test program containing the test case.
+    /// \param test_case_name The name of the executed test case.
+    /// \param result The result of the execution of the test case.
+    virtual void
+    got_result(const model::test_program& test_program,
+               const std::string& test_case_name,
+               const model::test_result& result,
+               const datetime::delta& /* duration */)
+    {
+        results.insert(F("%s:%s %s") % test_program.relative_path() %
+                       test_case_name % (result.good() ? "good" : "bad"));
+    }
+};
+
+
+/// Hooks that feed the test programs to run one at a time.
+class feed_hooks : public capture_hooks {
+    /// Paths of the test programs still to feed.
+    std::vector< fs::path > _pending;
+
+public:
+    /// Number of test cases started when every test program was fed.
+    std::vector< std::size_t > started_when_fed;
+
+    /// Constructor.
+    ///
+    /// \param pending_ Paths of the test programs to feed, in order.
+    explicit feed_hooks(const std::vector< fs::path >& pending_) :
+        _pending(pending_)
+    {
+    }
+
+    /// Checks whether the hooks feed the test programs to run.
+    ///
+    /// \return Always true.
+    virtual bool
+    feeds_test_programs(void)
+    {
+        return true;
+    }
+
+    /// Provides the next test program to run.
+    ///
+    /// \param [out] paths The paths to which to append the fed test program.
+    ///
+    /// \return True while there are test programs left to feed.
+    virtual bool
+    feed_test_programs(std::vector< fs::path >& paths, const bool /* wait */)
+    {
+        started_when_fed.push_back(started.size());
+        if (_pending.empty())
+            return false;
+        paths.push_back(_pending.front());
+        _pending.erase(_pending.begin());
+        return true;
+    }
+};
+
+
+/// Creates a plain test program that exits with a given code.
+///
+/// \param path The path to the test program to create.
+/// \param exit_code The exit code of the test program.
+static void
+create_test_program(const fs::path& path, const int exit_code)
+{
+    atf::utils::create_file(path.str(),
+                            F("#! /bin/sh\nexit %s\n") % exit_code);
+    ATF_REQUIRE(::chmod(path.c_str(), 0755) != -1);
+}
+
+
+/// Runs the test programs of the Kyuafile in the current directory.
+///
+/// \param user_config The configuration for the run.
+/// \param hooks The hooks for the run.
+///
+/// \return The result data of the driver.
+static drivers::run_tests::result
+run_kyuafile(const config::tree& user_config,
+             drivers::run_tests::base_hooks& hooks)
+{
+    return drivers::run_tests::drive(
+        fs::path("Kyuafile"), none, none, false, none,
+        std::set< engine::test_filter >(), none,
+        std::vector< engine::metadata_filter >(), none, false, none, 1, false,
+        user_config, hooks, NULL);
+}
+
+
+}  // anonymous namespace
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(feed_test_programs);
+ATF_TEST_CASE_BODY(feed_test_programs)
+{
+    utils::setenv("HOME", fs::current_path().str());
+    atf::utils::create_file(
+        "Kyuafile",
+        "syntax(2)\n"
+        "test_suite('suite')\n"
+        "plain_test_program{name='first'}\n"
+        "plain_test_program{name='second'}\n"
+        "plain_test_program{name='third'}\n");
+    create_test_program(fs::path("first"), 0);
+    create_test_program(fs::path("second"), 0);
+    create_test_program(fs::path("third"), 1);
+
+    std::vector< fs::path > pending;
+    pending.push_back(fs::path("third"));
+    pending.push_back(fs::path("first"));
+    feed_hooks hooks(pending);
+    config::tree user_config = engine::default_config();
+    user_config.set_string("parallelism", "1");
+    run_kyuafile(user_config, hooks);
+
+    // Nothing runs until it is fed, and the test programs never fed only run
+    // once the feed ends.
+    ATF_REQUIRE_EQ(3, hooks.started_when_fed.size());
+    ATF_REQUIRE_EQ(0, hooks.started_when_fed[0]);
+    ATF_REQUIRE_EQ(3, hooks.started.size());
+    ATF_REQUIRE(hooks.started_when_fed[2] <= 2);
+    ATF_REQUIRE_EQ("second:main", hooks.started[2]);
+
+    std::set< std::string > exp_results;
+    exp_results.insert("first:main good");
+    exp_results.insert("second:main good");
+    exp_results.insert("third:main bad");
+    ATF_REQUIRE(exp_results == hooks.results);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(store_in_memory__results_file_exists);
+ATF_TEST_CASE_BODY(store_in_memory__results_file_exists)
+{
+    utils::setenv("HOME", fs::current_path().str());
+    atf::utils::create_file(
+        "Kyuafile",
+        "syntax(2)\n"
+        "test_suite('suite')\n"
+        "plain_test_program{name='first'}\n");
+    create_test_program(fs::path("first"), 0);
+    store::write_backend::open_rw(fs::path("results.db")).close();
+
+    capture_hooks hooks;
+    config::tree user_config = engine::default_config();
+    user_config.set_string("store_in_memory", "true");
+    ATF_REQUIRE_THROW_RE(
+        store::error, "results.db already exists",
+        drivers::run_tests::drive(
+            fs::path("Kyuafile"), none, utils::make_optional(
+                fs::path("results.db")), false, none,
+            std::set< engine::test_filter >(), none,
+            std::vector< engine::metadata_filter >(), none, false, none, 1,
+            false, user_config, hooks, NULL));
+    ATF_REQUIRE(hooks.started.empty());
+}
+
+
+ATF_INIT_TEST_CASES(tcs)
+{
+    scheduler::register_interface(
+        "plain", std::shared_ptr< scheduler::interface >(
+            new engine::plain_interface()));
+
+    ATF_ADD_TEST_CASE(tcs, feed_test_programs);
+    ATF_ADD_TEST_CASE(tcs, store_in_memory__results_file_exists);
+}
@@ -28,15 +28,252 @@
 
 #include "drivers/scan_results.hpp"
 
+extern "C" {
+#include <time.h>
+#include <unistd.h>
+}
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
 #include "engine/filters.hpp"
 #include "model/context.hpp"
 #include "model/test_case.hpp"
 #include "model/test_program.hpp"
+#include "model/test_result.hpp"
 #include "store/read_backend.hpp"
 #include "store/read_transaction.hpp"
+#include "utils/datetime.hpp"
 #include "utils/defs.hpp"
+#include "utils/format/macros.hpp"
+#include "utils/fs/operations.hpp"
+#include "utils/fs/path.hpp"
+#include "utils/logging/macros.hpp"
+#include "utils/optional.ipp"
+#include "utils/process/child.ipp"
+#include "utils/process/status.hpp"
+#include "utils/sanity.hpp"
+#include "utils/stream.hpp"
 
+namespace datetime = utils::datetime;
 namespace fs = utils::fs;
+namespace process = utils::process;
+
+using utils::optional;
+
+
+namespace {
+
+
+/// Constructs the filter to push down to the store.
+///
+/// Only the test program part of the user filters is pushed down: this lets
+/// the database discard most unwanted results while keeping the matching
+/// semantics in engine::filters_state, which the callers still use to apply
+/// the test case part of the filters and to track unused filters.
+///
+/// \param raw_filters The test case filters as provided by the user.
+/// \param hooks The hooks for this execution.
+///
+/// \return The filter for the results to scan.
+static store::results_filter
+get_results_filter(const std::set< engine::test_filter >& raw_filters,
+                   const drivers::scan_results::base_hooks& hooks)
+{
+    store::results_filter results_filter = hooks.wanted_results();
+    for (std::set< engine::test_filter >::const_iterator iter =
+             raw_filters.begin(); iter != raw_filters.end(); ++iter)
+        results_filter.add_test_program((*iter).test_program);
+    return results_filter;
+}
+
+
+/// Feeds the results that match the user filters to the hooks.
+///
+/// \param [in,out] iter The results to scan.  Consumed on return.
+/// \param [in,out] filters The user filters and their usage tracking.
+/// \param hooks The hooks for this execution.
+///
+/// \return The number of results passed to the hooks.
+static std::size_t
+scan(store::results_iterator& iter, engine::filters_state& filters,
+     drivers::scan_results::base_hooks& hooks)
+{
+    std::size_t count = 0;
+    while (iter) {
+        const model::test_program_ptr test_program = iter.test_program();
+        if (filters.match_test_program(test_program->relative_path())) {
+            const model::test_case& test_case = test_program->find(
+                iter.test_case_name());
+            if (filters.match_test_case(test_program->relative_path(),
+                                        test_case.name())) {
+                hooks.got_result(iter);
+                ++count;
+            }
+        }
+        ++iter;
+    }
+    return count;
+}
+
+
+/// Minimum number of results to render in every partition.
+///
+/// Reports with fewer results than this are rendered by the calling process:
+/// spawning a subprocess and connecting it to the database costs more than
+/// what it would save.
+static const std::size_t min_results_per_partition = 256;
+
+
+/// Counts the results that a filter can match according to a summary.
+///
+/// \param summary The summary of all the results in the database.
+/// \param filter The filter of the results to scan.  Only its result types are
+///     taken into account, so the count is an upper bound.
+///
+/// \return The number of results.
+static std::size_t
+count_results(const store::results_summary& summary,
+              const store::results_filter& filter)
+{
+    const std::set< model::test_result_type >& types = filter.result_types();
+    std::size_t count = 0;
+    for (std::map< model::test_result_type, std::size_t >::const_iterator
+             iter = summary.counts.begin(); iter != summary.counts.end();
+         ++iter) {
+        if (types.empty() || types.find((*iter).first) != types.end())
+            count += (*iter).second;
+    }
+    return count;
+}
+
+
+/// Functor to render a partition of the results in a subprocess.
+class render_partition {
+    /// The path to the database store.
+    const fs::path& _store_path;
+
+    /// The filter of the results of the partition.
+    const store::results_filter& _filter;
+
+    /// The hooks of the scan.
+    drivers::scan_results::partitioned_hooks& _hooks;
+
+public:
+    /// Constructor.
+    ///
+    /// \param store_path The path to the database store.
+    /// \param filter The filter of the results of the partition.
+    /// \param hooks The hooks of the scan.
+    render_partition(const fs::path& store_path,
+                     const store::results_filter& filter,
+                     drivers::scan_results::partitioned_hooks& hooks) :
+        _store_path(store_path),
+        _filter(filter),
+        _hooks(hooks)
+    {
+    }
+
+    /// Body of the subprocess.
+    ///
+    /// The part of the report is written to the stdout of the subprocess.
+    void
+    operator()(void)
+    {
+        // The connection of the parent cannot be shared across the fork.
+        store::read_backend db = store::read_backend::open_ro(_store_path);
+        store::read_transaction tx = db.start_read();
+        std::auto_ptr< drivers::scan_results::base_hooks > hooks =
+            _hooks.partition_hooks(std::cout);
+        engine::filters_state filters((std::set< engine::test_filter >()));
+        {
+            store::results_iterator iter = tx.get_results(_filter);
+            (void)scan(iter, filters, *hooks);
+        }
+        tx.finish();
+        std::cout.flush();
+        ::_exit(std::cout ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+};
+
+
+/// Renders the results in partitions and feeds the parts to the hooks.
+///
+/// \param store_path The path to the database store.
+/// \param work_directory Directory in which to store the parts of the report.
+/// \param filter The filter of the results to scan.
+/// \param hooks The hooks of the scan.
+/// \param partitions The number of partitions, and thus of subprocesses.
+/// \param per_partition The number of results in every partition but the
+///     last, which gets all of the remaining ones.
+///
+/// \throw std::runtime_error If any partition fails to be rendered.
+static void
+render_partitions(const fs::path& store_path, const fs::path& work_directory,
+                  const store::results_filter& filter,
+                  drivers::scan_results::partitioned_hooks& hooks,
+                  const std::size_t partitions,
+                  const std::size_t per_partition)
+{
+    std::vector< std::shared_ptr< process::child > > children;
+    for (std::size_t i = 0; i < partitions; ++i) {
+        const store::results_filter partition_filter =
+            store::results_filter(filter).slice(
+                i * per_partition, i == partitions - 1 ? 0 : per_partition);
+        children.push_back(std::shared_ptr< process::child >(
+            process::child::fork_files(
+                render_partition(store_path, partition_filter, hooks),
+                work_directory / (F("part.%s") % i).str(),
+                work_directory / (F("part.%s.err") % i).str()).release()));
+    }
+
+    // Wait for all subprocesses before looking at their parts so that none is
+    // left behind on failure.
+    std::vector< process::status > statuses;
+    for (std::size_t i = 0; i < partitions; ++i)
+        statuses.push_back(children[i]->wait());
+
+    for (std::size_t i = 0; i < partitions; ++i) {
+        if (!statuses[i].exited() ||
+            statuses[i].exitstatus() != EXIT_SUCCESS) {
+            std::ifstream error_input(
+                (work_directory / (F("part.%s.err") % i).str()).c_str());
+            std::string message = utils::read_stream(error_input);
+            message.erase(message.find_last_not_of('\n') + 1);
+            throw std::runtime_error(F("Failed to scan the results: %s") %
+                                     message);
+        }
+
+        std::ifstream input(
+            (work_directory / (F("part.%s") % i).str()).c_str());
+        if (!input)
+            throw std::runtime_error(F("Failed to open part %s of the report")
+                                     % i);
+        hooks.got_partition(input);
+    }
+}
+
+
+/// Suspends the execution of the process.
+///
+/// \param period The amount of time to sleep for.
+static void
+sleep_for(const datetime::delta& period)
+{
+    struct ::timespec remaining;
+    remaining.tv_sec = period.seconds;
+    remaining.tv_nsec = period.useconds * 1000;
+    while (::nanosleep(&remaining, &remaining) == -1 && errno == EINTR) {
+        // Retry with the remaining time.
+    }
+}
+
+
+}  // anonymous namespace
 
 
 /// Pure abstract destructor.
@@ -52,6 +289,35 @@ drivers::scan_results::base_hooks::begin(void)
 }
 
 
+/// Describes the results and data that the hooks need to be given.
+///
+/// The driver pushes this filter down to the store so that the data that the
+/// hooks will never look at is not loaded.  The default implementation asks
+/// for everything.  Implementations need not restrict the test programs: the
+/// driver does so on its own based on the user-provided filters.
+///
+/// \return A filter for the results to scan.
+store::results_filter
+drivers::scan_results::base_hooks::wanted_results(void) const
+{
+    return store::results_filter();
+}
+
+
+/// Checks whether the hooks need the environment variables of the context.
+///
+/// The environment of a run can be large, so the driver does not load it for
+/// hooks that will never look at it.  The default implementation asks for it.
+///
+/// \return True if got_context() must receive the environment variables; false
+/// if it can receive an empty environment instead.
+bool
+drivers::scan_results::base_hooks::wants_env_vars(void) const
+{
+    return true;
+}
+
+
 /// Callback executed after all operations are performed.
 ///
 /// \param unused_r A structure with all results computed by this driver.  Note
@@ -62,6 +328,116 @@ drivers::scan_results::base_hooks::end(const result& UTILS_UNUSED_PARAM(r))
 }
 
 
+/// Constructor.
+///
+/// \param hooks_ The hooks to forward the calls to, in the order in which to
+///     call them.  They must outlive this object.
+drivers::scan_results::tee_hooks::tee_hooks(
+    const std::vector< base_hooks* >& hooks_) :
+    _hooks(hooks_)
+{
+    for (std::vector< base_hooks* >::const_iterator iter = _hooks.begin();
+         iter != _hooks.end(); ++iter)
+        _types.push_back((*iter)->wanted_results().result_types());
+}
+
+
+/// Callback executed before any operation is performed.
+void
+drivers::scan_results::tee_hooks::begin(void)
+{
+    for (std::vector< base_hooks* >::iterator iter = _hooks.begin();
+         iter != _hooks.end(); ++iter)
+        (*iter)->begin();
+}
+
+
+/// Describes the results and data that any of the hooks need to be given.
+///
+/// \return A filter for the union of the results wanted by all the hooks.
+store::results_filter
+drivers::scan_results::tee_hooks::wanted_results(void) const
+{
+    bool all_types = false;
+    bool with_files = false;
+    std::set< model::test_result_type > types;
+    for (std::vector< base_hooks* >::const_iterator iter = _hooks.begin();
+         iter != _hooks.end(); ++iter) {
+        const store::results_filter filter = (*iter)->wanted_results();
+        if (filter.result_types().empty())
+            all_types = true;
+        else
+            types.insert(filter.result_types().begin(),
+                         filter.result_types().end());
+        if (filter.with_files())
+            with_files = true;
+    }
+
+    store::results_filter filter;
+    if (!all_types) {
+        for (std::set< model::test_result_type >::const_iterator iter =
+                 types.begin(); iter != types.end(); ++iter)
+            filter.add_result_type(*iter);
+    }
+    if (!with_files)
+        filter.without_files();
+    return filter;
+}
+
+
+/// Checks whether any of the hooks need the environment variables.
+///
+/// \return True if any of the hooks wants the environment variables.
+bool
+drivers::scan_results::tee_hooks::wants_env_vars(void) const
+{
+    for (std::vector< base_hooks* >::const_iterator iter = _hooks.begin();
+         iter != _hooks.end(); ++iter) {
+        if ((*iter)->wants_env_vars())
+            return true;
+    }
+    return false;
+}
+
+
+/// Callback executed when the context is loaded.
+///
+/// \param context The context loaded from the database.
+void
+drivers::scan_results::tee_hooks::got_context(const model::context& context)
+{
+    for (std::vector< base_hooks* >::iterator iter = _hooks.begin();
+         iter != _hooks.end(); ++iter)
+        (*iter)->got_context(context);
+}
+
+
+/// Callback executed when a test results is found.
+///
+/// \param iter Container for the test result's data.
+void
+drivers::scan_results::tee_hooks::got_result(store::results_iterator& iter)
+{
+    const model::test_result_type type = iter.result().type();
+    for (std::vector< base_hooks* >::size_type i = 0; i < _hooks.size(); ++i) {
+        if (_types[i].empty() || _types[i].find(type) != _types[i].end())
+            _hooks[i]->got_result(iter);
+    }
+}
+
+
+/// Callback executed after all operations are performed.
+///
+/// \param r A structure with all results computed by this driver.
+void
+drivers::scan_results::tee_hooks::end(const result& r)
+{
+    for (std::vector< base_hooks* >::iterator iter = _hooks.begin();
+         iter != _hooks.end(); ++iter)
+        (*iter)->end(r);
+}
+
+
 /// Executes the operation.
 ///
 /// \param store_path The path to the database store.
@@ -73,35 +449,187 @@ drivers::scan_results::result
 drivers::scan_results::drive(const fs::path& store_path,
                              const std::set< engine::test_filter >& raw_filters,
                              base_hooks& hooks)
+{
+    store::read_backend db = store::read_backend::open_ro(store_path);
+    return drive(db, raw_filters, hooks);
+}
+
+
+/// Executes the operation on an already-open database.
+///
+/// This allows callers that process various requests on the same database to
+/// keep its connection open across them.  The database is read within a single
+/// transaction that is finished before returning, so the next call sees any
+/// results committed in the meantime.
+///
+/// \param db The database store.
+/// \param raw_filters The test case filters as provided by the user.
+/// \param hooks The hooks for this execution.
+///
+/// \returns A structure with all results computed by this driver.
+drivers::scan_results::result
+drivers::scan_results::drive(store::read_backend& db,
+                             const std::set< engine::test_filter >& raw_filters,
+                             base_hooks& hooks)
 {
     engine::filters_state filters(raw_filters);
 
-    store::read_backend db = store::read_backend::open_ro(store_path);
     store::read_transaction tx = db.start_read();
 
     hooks.begin();
 
-    const model::context context = tx.get_context();
+    const model::context context = tx.get_context(hooks.wants_env_vars());
     hooks.got_context(context);
 
-    store::results_iterator iter = tx.get_results();
-    while (iter) {
-        // TODO(jmmv): We should be filtering at the test case level for
-        // efficiency, but that means we would need to execute more than one
-        // query on the database and our current interfaces don't support that.
-        //
-        // Reuse engine::filters_state for the time being because it is simpler
-        // and we get tracking of unmatched filters "for free".
-        const model::test_program_ptr test_program = iter.test_program();
-        if (filters.match_test_program(test_program->relative_path())) {
-            const model::test_case& test_case = test_program->find(
-                iter.test_case_name());
-            if (filters.match_test_case(test_program->relative_path(),
-                                        test_case.name())) {
-                hooks.got_result(iter);
+    {
+        store::results_iterator iter = tx.get_results(
+            get_results_filter(raw_filters, hooks));
+        (void)scan(iter, filters, hooks);
+    }
+    tx.finish();
+
+    result r(filters.unused());
+    hooks.end(r);
+    return r;
+}
+
+
+/// Executes the operation by splitting the results across subprocesses.
+///
+/// This is like drive() for hooks whose rendering of the results is expensive:
+/// up to parallelism subprocesses render a contiguous partition of the
+/// results each, and the hooks then receive the rendered parts in order.
+/// Small databases are scanned by this process alone.  User filters are not
+/// supported.
+///
+/// \param store_path The path to the database store.
+/// \param hooks The hooks for this execution.
+/// \param parallelism Maximum number of subprocesses to spawn.
+///
+/// \returns A structure with all results computed by this driver.
+///
+/// \throw std::runtime_error If any partition fails to be rendered.
+drivers::scan_results::result
+drivers::scan_results::drive_partitioned(const fs::path& store_path,
+                                         partitioned_hooks& hooks,
+                                         const std::size_t parallelism)
+{
+    PRE(parallelism >= 1);
+
+    const std::set< engine::test_filter > no_filters;
+    const store::results_filter results_filter = hooks.wanted_results();
+
+    store::read_backend db = store::read_backend::open_ro(store_path);
+
+    hooks.begin();
+
+    std::size_t partitions;
+    std::size_t per_partition;
+    {
+        store::read_transaction tx = db.start_read();
+        hooks.got_context(tx.get_context(hooks.wants_env_vars()));
+
+        const std::size_t count = count_results(tx.get_summary(),
+                                                results_filter);
+        partitions = std::min(parallelism, count / min_results_per_partition);
+        per_partition = partitions > 1 ? (count + partitions - 1) / partitions :
+            count;
+        if (partitions <= 1) {
+            engine::filters_state filters(no_filters);
+            store::results_iterator iter = tx.get_results(results_filter);
+            (void)scan(iter, filters, hooks);
+        }
+        tx.finish();
+    }
+
+    if (partitions > 1) {
+        LD(F("Scanning the results in %s partitions of %s") % partitions %
+           per_partition);
+        const fs::path work_directory = fs::mkdtemp_public(
+            "kyua.scan.XXXXXX");
+        try {
+            render_partitions(store_path, work_directory, results_filter,
+                              hooks, partitions, per_partition);
+        } catch (...) {
+            fs::rm_r(work_directory);
+            throw;
+        }
+        fs::rm_r(work_directory);
+    }
+
+    result r(no_filters);
+    hooks.end(r);
+    return r;
+}
+
+
+/// Executes the operation on a database that is being written to.
+///
+/// This is like drive() but, after processing the results that are already in
+/// the database, keeps polling it for new results as they are committed by a
+/// concurrent "kyua test" run.  Each poll only reads the results that are new
+/// since the previous one, and polls are skipped altogether if the database has
+/// not been modified.
+///
+/// \param store_path The path to the database store.
+/// \param raw_filters The test case filters as provided by the user.
+/// \param hooks The hooks for this execution.
+/// \param poll_interval The time to wait between polls.
+/// \param idle_timeout The time after which to stop polling if no new results
+///     have been seen.  Zero to poll forever.
+///
+/// \returns A structure with all results computed by this driver.
+drivers::scan_results::result
+drivers::scan_results::follow(const fs::path& store_path,
+                              const std::set< engine::test_filter >& raw_filters,
+                              base_hooks& hooks,
+                              const datetime::delta& poll_interval,
+                              const datetime::delta& idle_timeout)
+{
+    engine::filters_state filters(raw_filters);
+
+    store::read_backend db = store::read_backend::open_ro(store_path);
+
+    hooks.begin();
+
+    {
+        store::read_transaction tx = db.start_read();
+        hooks.got_context(tx.get_context(hooks.wants_env_vars()));
+        tx.finish();
+    }
+
+    const store::results_filter results_filter = get_results_filter(
+        raw_filters, hooks);
+    store::results_watermark watermark;
+    optional< int64_t > last_version;
+    datetime::timestamp last_activity = datetime::timestamp::now();
+    for (;;) {
+        const int64_t version = db.data_version();
+        if (!last_version || version != last_version.get()) {
+            last_version = version;
+
+            // Keep the read transaction short: while it is open, the writer
+            // cannot commit.
+            store::read_transaction tx = db.start_read();
+            std::size_t count;
+            {
+                store::results_iterator iter = tx.get_results(
+                    store::results_filter(results_filter).after(watermark));
+                count = scan(iter, filters, hooks);
             }
+            watermark = tx.get_watermark(watermark);
+            tx.finish();
+
+            LD(F("Followed %s new results; %s test cases pending") % count %
+               watermark.pending_test_case_ids().size());
+            if (count > 0)
+                last_activity = datetime::timestamp::now();
         }
-        ++iter;
+
+        if (idle_timeout != datetime::delta() &&
+            datetime::timestamp::now() - last_activity >= idle_timeout)
+            break;
+        sleep_for(poll_interval);
     }
 
     result r(filters.unused());
@@ -41,10 +41,17 @@ extern "C" {
 #include <stdint.h>
 }
 
+#include <cstddef>
+#include <istream>
+#include <memory>
+#include <ostream>
 #include <set>
+#include <vector>
 
 #include "engine/filters.hpp"
 #include "model/context_fwd.hpp"
+#include "model/test_result_fwd.hpp"
+#include "store/read_backend_fwd.hpp"
 #include "store/read_transaction_fwd.hpp"
 #include "utils/datetime_fwd.hpp"
 #include "utils/fs/path_fwd.hpp"
@@ -79,6 +86,9 @@ public:
 
     virtual void begin(void);
 
+    virtual store::results_filter wanted_results(void) const;
+    virtual bool wants_env_vars(void) const;
+
     /// Callback executed when the context is loaded.
     ///
     /// \param context The context loaded from the database.
@@ -95,8 +105,64 @@ public:
 };
 
 
+/// Hooks that forward the scan of the results to various other hooks.
+///
+/// This allows generating several reports in a single pass over the results.
+/// Every hook only receives the results of the types it asks for.
+class tee_hooks : public base_hooks {
+    /// The hooks to forward the calls to.
+    std::vector< base_hooks* > _hooks;
+
+    /// The result types wanted by every hook; empty if it wants all of them.
+    std::vector< std::set< model::test_result_type > > _types;
+
+public:
+    tee_hooks(const std::vector< base_hooks* >&);
+
+    void begin(void);
+    store::results_filter wanted_results(void) const;
+    bool wants_env_vars(void) const;
+    void got_context(const model::context&);
+    void got_result(store::results_iterator&);
+    void end(const result&);
+};
+
+
+/// Abstract definition of the hooks for a scan split across subprocesses.
+///
+/// The results are split in contiguous partitions, each of which is rendered
+/// into a part of the report by a subprocess with its own connection to the
+/// database.  The parts are then handed back to these hooks in the order of
+/// the results.
+class partitioned_hooks : public base_hooks {
+public:
+    /// Creates the hooks to render a partition of the results.
+    ///
+    /// This is called in the subprocess that renders the partition.  Only the
+    /// got_result() method of the returned hooks is called.
+    ///
+    /// \param output Stream to which to write the part of the report.
+    ///
+    /// \return The hooks to feed the results of the partition to.
+    virtual std::auto_ptr< base_hooks > partition_hooks(
+        std::ostream& output) = 0;
+
+    /// Callback executed when the part of the report of a partition is ready.
+    ///
+    /// \param input Stream with the part of the report.
+    virtual void got_partition(std::istream& input) = 0;
+};
+
+
 result drive(const utils::fs::path&, const std::set< engine::test_filter >&,
              base_hooks&);
+result drive(store::read_backend&, const std::set< engine::test_filter >&,
+             base_hooks&);
+result drive_partitioned(const utils::fs::path&, partitioned_hooks&,
+                         const std::size_t);
+result follow(const utils::fs::path&, const std::set< engine::test_filter >&,
+              base_hooks&, const utils::datetime::delta&,
+              const utils::datetime::delta&);
 
 
 }  // namespace scan_results
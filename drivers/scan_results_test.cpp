@@ -28,7 +28,13 @@
 
 #include "drivers/scan_results.hpp"
 
+#include <cstddef>
+#include <istream>
+#include <memory>
+#include <ostream>
 #include <set>
+#include <string>
+#include <vector>
 
 #include <atf-c++.hpp>
 
@@ -43,6 +49,7 @@
 #include "store/write_backend.hpp"
 #include "store/write_transaction.hpp"
 #include "utils/datetime.hpp"
+#include "utils/defs.hpp"
 #include "utils/format/containers.ipp"
 #include "utils/format/macros.hpp"
 #include "utils/optional.ipp"
@@ -73,9 +80,13 @@ public:
     /// The captured results, flattened as "program:test_case:result".
     std::set< std::string > _results;
 
+    /// The number of times got_result() was called.
+    std::size_t _results_count;
+
     /// Constructor.
     capture_hooks(void) :
-        _begin_called(false)
+        _begin_called(false),
+        _results_count(0)
     {
     }
 
@@ -119,6 +130,7 @@ public:
             UNREACHABLE_MSG("Formatting unimplemented");
         }
         const datetime::delta duration = iter.end_time() - iter.start_time();
+        ++_results_count;
         _results.insert(F("%s:%s:%s:%s:%s:%s") %
                         iter.test_program()->absolute_path() %
                         iter.test_case_name() % type % iter.result().reason() %
@@ -127,6 +139,126 @@ public:
 };
 
 
+/// Hooks that do not want the environment variables of the context.
+class no_env_hooks : public capture_hooks {
+public:
+    /// Checks whether the hooks need the environment variables.
+    ///
+    /// \return Always false.
+    bool
+    wants_env_vars(void) const
+    {
+        return false;
+    }
+};
+
+
+/// Hooks that only want results of a specific type.
+class type_hooks : public capture_hooks {
+    /// The type of the results to request.
+    model::test_result_type _type;
+
+public:
+    /// Constructor.
+    ///
+    /// \param type_ The type of the results to request.
+    type_hooks(const model::test_result_type type_) :
+        _type(type_)
+    {
+    }
+
+    /// Describes the results to scan.
+    ///
+    /// \return A filter for the results of the requested type.
+    store::results_filter
+    wanted_results(void) const
+    {
+        return store::results_filter().add_result_type(_type).without_files();
+    }
+};
+
+
+/// Hooks that record the test cases in order and can render partitions.
+class lines_hooks : public drivers::scan_results::partitioned_hooks {
+    /// Stream to which to write the test cases, if rendering a partition.
+    std::ostream* _output;
+
+public:
+    /// The names of the test cases, in the order in which they were received.
+    std::vector< std::string > _lines;
+
+    /// The number of times got_partition() was called.
+    std::size_t _partitions;
+
+    /// Whether end() was called or not.
+    bool _end_called;
+
+    /// Constructor.
+    ///
+    /// \param output_ Stream to which to write the test cases instead of
+    ///     recording them, if any.
+    lines_hooks(std::ostream* output_ = NULL) :
+        _output(output_), _partitions(0), _end_called(false)
+    {
+    }
+
+    /// Callback executed when the context is loaded.
+    ///
+    /// \param unused_context The context loaded from the database.
+    void
+    got_context(const model::context& UTILS_UNUSED_PARAM(context))
+    {
+    }
+
+    /// Callback executed when a test results is found.
+    ///
+    /// \param iter Container for the test result's data.
+    void
+    got_result(store::results_iterator& iter)
+    {
+        const std::string line = F("%s:%s") %
+            iter.test_program()->relative_path() % iter.test_case_name();
+        if (_output != NULL)
+            (*_output) << line << '\n';
+        else
+            _lines.push_back(line);
+    }
+
+    /// Creates the hooks to render a partition of the results.
+    ///
+    /// \param output Stream to which to write the test cases.
+    ///
+    /// \return The new hooks.
+    std::auto_ptr< drivers::scan_results::base_hooks >
+    partition_hooks(std::ostream& output)
+    {
+        return std::auto_ptr< drivers::scan_results::base_hooks >(
+            new lines_hooks(&output));
+    }
+
+    /// Records the test cases rendered for a partition.
+    ///
+    /// \param input Stream with the test cases of the partition.
+    void
+    got_partition(std::istream& input)
+    {
+        ++_partitions;
+        std::string line;
+        while (std::getline(input, line))
+            _lines.push_back(line);
+    }
+
+    /// Callback executed after all operations are performed.
+    ///
+    /// \param unused_r A structure with all results computed by this driver.
+    void
+    end(const drivers::scan_results::result& UTILS_UNUSED_PARAM(r))
+    {
+        _end_called = true;
+    }
+};
+
+
 /// Populates a results file.
 ///
 /// It is not OK to call this function multiple times on the same file.
@@ -207,6 +339,22 @@ ATF_TEST_CASE_BODY(ok__all)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(ok__without_env_vars);
+ATF_TEST_CASE_BODY(ok__without_env_vars)
+{
+    populate_results_file("test.db", 2);
+
+    no_env_hooks hooks;
+    (void)drivers::scan_results::drive(
+        fs::path("test.db"), std::set< engine::test_filter >(), hooks);
+
+    const model::context context(fs::path("/root"),
+                                 std::map< std::string, std::string >());
+    ATF_REQUIRE(context == hooks._context.get());
+    ATF_REQUIRE_EQ(4, hooks._results_count);
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(ok__filters);
 ATF_TEST_CASE_BODY(ok__filters)
 {
@@ -238,6 +386,185 @@ ATF_TEST_CASE_BODY(ok__filters)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(ok__wanted_results);
+ATF_TEST_CASE_BODY(ok__wanted_results)
+{
+    populate_results_file("test.db", 2);
+
+    std::set< engine::test_filter > filters;
+    filters.insert(engine::test_filter(fs::path("dir/prog_0"), ""));
+    filters.insert(engine::test_filter(fs::path("dir/prog_1"), "case_0"));
+
+    {
+        type_hooks hooks(model::test_result_passed);
+        const drivers::scan_results::result result =
+            drivers::scan_results::drive(fs::path("test.db"), filters, hooks);
+        ATF_REQUIRE(hooks._context);
+        ATF_REQUIRE(hooks._results.empty());
+        ATF_REQUIRE_EQ(filters, result.unused_filters);
+    }
+
+    {
+        type_hooks hooks(model::test_result_skipped);
+        const drivers::scan_results::result result =
+            drivers::scan_results::drive(fs::path("test.db"), filters, hooks);
+        ATF_REQUIRE(result.unused_filters.empty());
+
+        std::set< std::string > results;
+        results.insert("/root/dir/prog_0:case_0:skipped:Count 0:4:10");
+        results.insert("/root/dir/prog_0:case_1:skipped:Count 1:4:11");
+        results.insert("/root/dir/prog_1:case_0:skipped:Count 0:4:11");
+        ATF_REQUIRE_EQ(results, hooks._results);
+    }
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(tee_hooks__wanted_results);
+ATF_TEST_CASE_BODY(tee_hooks__wanted_results)
+{
+    type_hooks passed(model::test_result_passed);
+    type_hooks skipped(model::test_result_skipped);
+    capture_hooks all;
+
+    {
+        std::vector< drivers::scan_results::base_hooks* > hooks;
+        hooks.push_back(&passed);
+        hooks.push_back(&skipped);
+        const store::results_filter filter =
+            drivers::scan_results::tee_hooks(hooks).wanted_results();
+        std::set< model::test_result_type > types;
+        types.insert(model::test_result_passed);
+        types.insert(model::test_result_skipped);
+        ATF_REQUIRE(types == filter.result_types());
+        ATF_REQUIRE(!filter.with_files());
+    }
+
+    {
+        std::vector< drivers::scan_results::base_hooks* > hooks;
+        hooks.push_back(&passed);
+        hooks.push_back(&all);
+        const store::results_filter filter =
+            drivers::scan_results::tee_hooks(hooks).wanted_results();
+        ATF_REQUIRE(filter.result_types().empty());
+        ATF_REQUIRE(filter.with_files());
+    }
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(tee_hooks__wants_env_vars);
+ATF_TEST_CASE_BODY(tee_hooks__wants_env_vars)
+{
+    no_env_hooks no_env1, no_env2;
+    capture_hooks all;
+
+    std::vector< drivers::scan_results::base_hooks* > hooks;
+    hooks.push_back(&no_env1);
+    hooks.push_back(&no_env2);
+    ATF_REQUIRE(!drivers::scan_results::tee_hooks(hooks).wants_env_vars());
+    hooks.push_back(&all);
+    ATF_REQUIRE(drivers::scan_results::tee_hooks(hooks).wants_env_vars());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(tee_hooks__drive);
+ATF_TEST_CASE_BODY(tee_hooks__drive)
+{
+    populate_results_file("test.db", 2);
+
+    type_hooks passed(model::test_result_passed);
+    capture_hooks all;
+    std::vector< drivers::scan_results::base_hooks* > hooks;
+    hooks.push_back(&passed);
+    hooks.push_back(&all);
+    drivers::scan_results::tee_hooks tee(hooks);
+    (void)drivers::scan_results::drive(
+        fs::path("test.db"), std::set< engine::test_filter >(), tee);
+
+    ATF_REQUIRE(passed._begin_called);
+    ATF_REQUIRE(passed._context);
+    ATF_REQUIRE(passed._results.empty());
+    ATF_REQUIRE(passed._end_result);
+
+    ATF_REQUIRE(all._begin_called);
+    ATF_REQUIRE(all._context);
+    ATF_REQUIRE_EQ(4, all._results_count);
+    ATF_REQUIRE(all._end_result);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(follow__idle_timeout);
+ATF_TEST_CASE_BODY(follow__idle_timeout)
+{
+    populate_results_file("test.db", 2);
+
+    std::set< engine::test_filter > filters;
+    filters.insert(engine::test_filter(fs::path("dir/prog_1"), ""));
+    filters.insert(engine::test_filter(fs::path("dir/prog_3"), ""));
+
+    capture_hooks hooks;
+    const drivers::scan_results::result result =
+        drivers::scan_results::follow(fs::path("test.db"), filters, hooks,
+                                      datetime::delta(0, 10000),
+                                      datetime::delta(0, 100000));
+    ATF_REQUIRE(hooks._begin_called);
+    ATF_REQUIRE(hooks._end_result);
+    ATF_REQUIRE(hooks._context);
+
+    std::set< engine::test_filter > unused_filters;
+    unused_filters.insert(engine::test_filter(fs::path("dir/prog_3"), ""));
+    ATF_REQUIRE_EQ(unused_filters, result.unused_filters);
+
+    // The results must be reported exactly once regardless of the number of
+    // polls that happened until the timeout.
+    std::set< std::string > results;
+    results.insert("/root/dir/prog_1:case_0:skipped:Count 0:4:11");
+    results.insert("/root/dir/prog_1:case_1:skipped:Count 1:4:12");
+    ATF_REQUIRE_EQ(results, hooks._results);
+    ATF_REQUIRE_EQ(2, hooks._results_count);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(drive_partitioned__small);
+ATF_TEST_CASE_BODY(drive_partitioned__small)
+{
+    populate_results_file("test.db", 2);
+
+    lines_hooks hooks;
+    const drivers::scan_results::result result =
+        drivers::scan_results::drive_partitioned(fs::path("test.db"), hooks, 4);
+    ATF_REQUIRE(result.unused_filters.empty());
+    ATF_REQUIRE(hooks._end_called);
+    ATF_REQUIRE_EQ(0, hooks._partitions);
+
+    std::vector< std::string > lines;
+    lines.push_back("dir/prog_0:case_0");
+    lines.push_back("dir/prog_0:case_1");
+    lines.push_back("dir/prog_1:case_0");
+    lines.push_back("dir/prog_1:case_1");
+    ATF_REQUIRE_EQ(lines, hooks._lines);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(drive_partitioned__many);
+ATF_TEST_CASE_BODY(drive_partitioned__many)
+{
+    populate_results_file("test.db", 23);
+
+    lines_hooks serial_hooks;
+    (void)drivers::scan_results::drive_partitioned(fs::path("test.db"),
+                                                   serial_hooks, 1);
+    ATF_REQUIRE_EQ(0, serial_hooks._partitions);
+    ATF_REQUIRE_EQ(23 * 23, serial_hooks._lines.size());
+
+    lines_hooks hooks;
+    (void)drivers::scan_results::drive_partitioned(fs::path("test.db"),
+                                                   hooks, 4);
+    ATF_REQUIRE(hooks._end_called);
+    ATF_REQUIRE_EQ(2, hooks._partitions);
+    ATF_REQUIRE_EQ(serial_hooks._lines, hooks._lines);
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(missing_db);
 ATF_TEST_CASE_BODY(missing_db)
 {
@@ -253,6 +580,14 @@ ATF_TEST_CASE_BODY(missing_db)
 ATF_INIT_TEST_CASES(tcs)
 {
     ATF_ADD_TEST_CASE(tcs, ok__all);
+    ATF_ADD_TEST_CASE(tcs, ok__without_env_vars);
     ATF_ADD_TEST_CASE(tcs, ok__filters);
+    ATF_ADD_TEST_CASE(tcs, ok__wanted_results);
+    ATF_ADD_TEST_CASE(tcs, tee_hooks__wanted_results);
+    ATF_ADD_TEST_CASE(tcs, tee_hooks__wants_env_vars);
+    ATF_ADD_TEST_CASE(tcs, tee_hooks__drive);
+    ATF_ADD_TEST_CASE(tcs, follow__idle_timeout);
+    ATF_ADD_TEST_CASE(tcs, drive_partitioned__small);
+    ATF_ADD_TEST_CASE(tcs, drive_partitioned__many);
     ATF_ADD_TEST_CASE(tcs, missing_db);
 }
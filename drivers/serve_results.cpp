@@ -0,0 +1,231 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "drivers/serve_results.hpp"
+
+#include <list>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "drivers/report_json.hpp"
+#include "drivers/scan_results.hpp"
+#include "engine/filters.hpp"
+#include "store/layout.hpp"
+#include "store/read_backend.hpp"
+#include "utils/format/macros.hpp"
+#include "utils/fs/path.hpp"
+#include "utils/logging/macros.hpp"
+#include "utils/noncopyable.hpp"
+#include "utils/sanity.hpp"
+#include "utils/text/operations.ipp"
+
+namespace fs = utils::fs;
+namespace layout = store::layout;
+namespace text = utils::text;
+namespace units = utils::units;
+
+
+namespace {
+
+
+/// Collection of open results files, reused across requests.
+///
+/// The connections to the least recently used files are closed once there are
+/// more open files than the configured limit.  Every request reads a file in
+/// its own transaction, so keeping a connection open never hides the results
+/// committed to the file after it was opened.
+class backend_pool : utils::noncopyable {
+    /// Maximum number of results files to keep open.
+    const std::size_t _max_open;
+
+    /// Open results files, most recently used first.
+    std::list< std::pair< fs::path, store::read_backend > > _backends;
+
+    /// Number of times a results file has been opened.
+    std::size_t _opened;
+
+public:
+    /// Constructor.
+    ///
+    /// \param max_open_ Maximum number of results files to keep open.
+    explicit backend_pool(const std::size_t max_open_) :
+        _max_open(max_open_),
+        _opened(0)
+    {
+        PRE(_max_open > 0);
+    }
+
+    /// Gets the connection to a results file, opening it if necessary.
+    ///
+    /// \param path The path to the results file.
+    ///
+    /// \return The connection, valid until the next call to this method.
+    ///
+    /// \throw store::error If the results file cannot be opened.
+    store::read_backend&
+    get(const fs::path& path)
+    {
+        for (std::list< std::pair< fs::path, store::read_backend > >::iterator
+                 iter = _backends.begin(); iter != _backends.end(); ++iter) {
+            if ((*iter).first == path) {
+                _backends.splice(_backends.begin(), _backends, iter);
+                return _backends.front().second;
+            }
+        }
+
+        LI(F("Opening results file %s") % path);
+        _backends.push_front(std::make_pair(
+            path, store::read_backend::open_ro(path)));
+        ++_opened;
+        if (_backends.size() > _max_open) {
+            LI(F("Closing results file %s") % _backends.back().first);
+            _backends.back().second.close();
+            _backends.pop_back();
+        }
+        return _backends.front().second;
+    }
+
+    /// Gets the number of times a results file has been opened.
+    ///
+    /// \return A counter.
+    std::size_t
+    opened(void) const
+    {
+        return _opened;
+    }
+};
+
+
+/// Serves a single request.
+///
+/// \param request The words of the request line: the identifier of the
+///     results file followed by the test filters, if any.
+/// \param pool The open results files.
+/// \param with_output Whether to include the stdout and stderr of the test
+///     cases in the report.
+/// \param output_limit Maximum number of bytes of stdout and stderr to include
+///     for every test case, or zero for no limit.
+/// \param output Stream to which to write the response.
+///
+/// \throw std::runtime_error If the request is invalid or cannot be served.
+static void
+serve_one(const std::vector< std::string >& request, backend_pool& pool,
+          const bool with_output, const units::bytes& output_limit,
+          std::ostream& output)
+{
+    PRE(!request.empty());
+
+    std::set< engine::test_filter > filters;
+    for (std::vector< std::string >::const_iterator iter = request.begin() + 1;
+         iter != request.end(); ++iter)
+        filters.insert(engine::test_filter::parse(*iter));
+    engine::check_disjoint_filters(filters);
+
+    store::read_backend& backend = pool.get(layout::find_results(request[0]));
+
+    std::vector< std::ostream* > outputs;
+    outputs.push_back(&output);
+    drivers::report_json_hooks hooks(outputs, with_output, output_limit);
+    const drivers::scan_results::result result =
+        drivers::scan_results::drive(backend, filters, hooks);
+
+    std::vector< std::string > unused;
+    for (std::set< engine::test_filter >::const_iterator
+             iter = result.unused_filters.begin();
+         iter != result.unused_filters.end(); ++iter)
+        unused.push_back("\"" + text::escape_json((*iter).str()) + "\"");
+    output << F("{\"record\":\"end\",\"unused_filters\":[%s]}\n") %
+        text::join(unused, ",");
+}
+
+
+}  // anonymous namespace
+
+
+/// Executes the operation.
+///
+/// Every line read from the input is a request made of whitespace-separated
+/// words.  The first word identifies the results file to report on, as
+/// accepted by the --results-file flag of the report commands, and any other
+/// words are test filters to restrict the report to.  Empty lines are ignored.
+///
+/// The response to a request is the same newline-delimited JSON report that
+/// report_json_hooks generates, terminated by an end record that lists the
+/// unused filters.  If the request fails, the response is terminated by an
+/// error record instead, possibly after a partial report.  The output is
+/// flushed after every response, so the client can wait for it.
+///
+/// \param input Stream from which to read the requests.
+/// \param output Stream to which to write the responses.
+/// \param max_open Maximum number of results files to keep open.
+/// \param with_output Whether to include the stdout and stderr of the test
+///     cases in the reports.
+/// \param output_limit Maximum number of bytes of stdout and stderr to include
+///     for every test case, or zero for no limit.
+///
+/// \return A structure with all results computed by this driver.
+drivers::serve_results::result
+drivers::serve_results::drive(std::istream& input, std::ostream& output,
+                              const std::size_t max_open,
+                              const bool with_output,
+                              const units::bytes& output_limit)
+{
+    backend_pool pool(max_open);
+
+    std::size_t requests = 0;
+    std::string line;
+    while (std::getline(input, line).good() || !line.empty()) {
+        std::vector< std::string > request;
+        {
+            std::istringstream words(line);
+            std::string word;
+            while (words >> word)
+                request.push_back(word);
+        }
+        line.clear();
+        if (request.empty())
+            continue;
+
+        ++requests;
+        try {
+            serve_one(request, pool, with_output, output_limit, output);
+        } catch (const std::runtime_error& e) {
+            LW(F("Request '%s' failed: %s") % text::join(request, " ") %
+               e.what());
+            output << F("{\"record\":\"error\",\"reason\":\"%s\"}\n") %
+                text::escape_json(e.what());
+        }
+        output.flush();
+    }
+
+    return result(requests, pool.opened());
+}
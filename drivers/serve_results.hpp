@@ -0,0 +1,78 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// \file drivers/serve_results.hpp
+/// Driver to serve reports of results files to a long-lived client.
+///
+/// This driver module implements a simple line-based protocol to generate JSON
+/// reports of any number of results files within a single process.  This lets
+/// programs such as dashboards that query the same results files repeatedly
+/// avoid the cost of starting kyua and of opening the files on every query.
+
+#if !defined(DRIVERS_SERVE_RESULTS_HPP)
+#define DRIVERS_SERVE_RESULTS_HPP
+
+#include <cstddef>
+#include <istream>
+#include <ostream>
+
+#include "utils/units.hpp"
+
+namespace drivers {
+namespace serve_results {
+
+
+/// Tuple containing the results of this driver.
+class result {
+public:
+    /// Number of requests processed, including those that failed.
+    std::size_t requests;
+
+    /// Number of times a results file had to be opened to serve requests.
+    std::size_t opened;
+
+    /// Initializer for the tuple's fields.
+    ///
+    /// \param requests_ Number of requests processed.
+    /// \param opened_ Number of times a results file had to be opened.
+    result(const std::size_t requests_, const std::size_t opened_) :
+        requests(requests_),
+        opened(opened_)
+    {
+    }
+};
+
+
+result drive(std::istream&, std::ostream&, const std::size_t, const bool,
+             const utils::units::bytes&);
+
+
+}  // namespace serve_results
+}  // namespace drivers
+
+#endif  // !defined(DRIVERS_SERVE_RESULTS_HPP)
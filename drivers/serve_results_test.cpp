@@ -0,0 +1,215 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "drivers/serve_results.hpp"
+
+#include <sstream>
+#include <string>
+
+#include <atf-c++.hpp>
+
+#include "model/context.hpp"
+#include "model/test_program.hpp"
+#include "model/test_result.hpp"
+#include "model/types.hpp"
+#include "store/write_backend.hpp"
+#include "store/write_transaction.hpp"
+#include "utils/datetime.hpp"
+#include "utils/fs/path.hpp"
+#include "utils/units.hpp"
+
+namespace datetime = utils::datetime;
+namespace fs = utils::fs;
+namespace units = utils::units;
+
+
+namespace {
+
+
+/// Creates a database with a single passing test case.
+///
+/// \param file Path to the database to create.
+/// \param program Relative path to the test program to put in the database.
+static void
+create_db(const char* file, const char* program)
+{
+    store::write_backend backend = store::write_backend::open_rw(
+        fs::path(file));
+    store::write_transaction tx = backend.start_write();
+    (void)tx.put_context(model::context(fs::path("/root"),
+                                        model::properties_map()));
+
+    const model::test_program test_program = model::test_program_builder(
+        "plain", fs::path(program), fs::path("/root"), "suite")
+        .add_test_case("main").build();
+    const int64_t tp_id = tx.put_test_program(test_program);
+    const int64_t tc_id = tx.put_test_case(test_program, "main", tp_id);
+    tx.put_result(model::test_result(model::test_result_passed), tc_id,
+                  datetime::timestamp::from_microseconds(0),
+                  datetime::timestamp::from_microseconds(1000000));
+    tx.commit();
+    backend.close();
+}
+
+
+/// Expected context record for databases created by create_db.
+static const char* const context_record =
+    "{\"record\":\"context\",\"cwd\":\"/root\",\"env\":{}}\n";
+
+
+/// Computes the expected result record for databases created by create_db.
+///
+/// \param program Relative path to the test program in the database.
+///
+/// \return The JSON record of the only result in the database.
+static std::string
+result_record(const char* program)
+{
+    return std::string("{\"record\":\"result\",\"program\":\"") + program +
+        "\",\"variant\":\"\",\"case\":\"main\",\"result\":\"passed\","
+        "\"reason\":\"\",\"attempt\":1,"
+        "\"start_time\":\"1970-01-01T00:00:00.000000Z\","
+        "\"end_time\":\"1970-01-01T00:00:01.000000Z\","
+        "\"duration\":1.000000}\n";
+}
+
+
+/// Expected end record for requests without unused filters.
+static const char* const end_record =
+    "{\"record\":\"end\",\"unused_filters\":[]}\n";
+
+
+}  // anonymous namespace
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(drive__one_request);
+ATF_TEST_CASE_BODY(drive__one_request)
+{
+    create_db("test.db", "dir/prog");
+
+    std::istringstream input("test.db\n");
+    std::ostringstream output;
+    const drivers::serve_results::result result =
+        drivers::serve_results::drive(input, output, 4, false,
+                                      units::bytes(0));
+
+    ATF_REQUIRE_EQ(std::string(context_record) + result_record("dir/prog") +
+                   end_record, output.str());
+    ATF_REQUIRE_EQ(1, result.requests);
+    ATF_REQUIRE_EQ(1, result.opened);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(drive__reuses_open_files);
+ATF_TEST_CASE_BODY(drive__reuses_open_files)
+{
+    create_db("test.db", "dir/prog");
+
+    std::istringstream input("test.db\n\n  test.db   dir/prog:main \ntest.db");
+    std::ostringstream output;
+    const drivers::serve_results::result result =
+        drivers::serve_results::drive(input, output, 4, false,
+                                      units::bytes(0));
+
+    const std::string response = std::string(context_record) +
+        result_record("dir/prog") + end_record;
+    ATF_REQUIRE_EQ(response + response + response, output.str());
+    ATF_REQUIRE_EQ(3, result.requests);
+    ATF_REQUIRE_EQ(1, result.opened);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(drive__closes_least_recently_used);
+ATF_TEST_CASE_BODY(drive__closes_least_recently_used)
+{
+    create_db("a.db", "a");
+    create_db("b.db", "b");
+    create_db("c.db", "c");
+
+    std::istringstream input("a.db\nb.db\na.db\nc.db\nb.db\na.db\n");
+    std::ostringstream output;
+    const drivers::serve_results::result result =
+        drivers::serve_results::drive(input, output, 2, false,
+                                      units::bytes(0));
+
+    ATF_REQUIRE_EQ(6, result.requests);
+    ATF_REQUIRE_EQ(5, result.opened);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(drive__unused_filters);
+ATF_TEST_CASE_BODY(drive__unused_filters)
+{
+    create_db("test.db", "dir/prog");
+
+    std::istringstream input("test.db other \"quoted\"\n");
+    std::ostringstream output;
+    (void)drivers::serve_results::drive(input, output, 4, false,
+                                        units::bytes(0));
+
+    ATF_REQUIRE_EQ(std::string(context_record) +
+                   "{\"record\":\"end\",\"unused_filters\":"
+                   "[\"\\\"quoted\\\"\",\"other\"]}\n", output.str());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(drive__errors);
+ATF_TEST_CASE_BODY(drive__errors)
+{
+    create_db("test.db", "dir/prog");
+
+    std::istringstream input("./missing.db\ntest.db :bad\ntest.db\n");
+    std::ostringstream output;
+    const drivers::serve_results::result result =
+        drivers::serve_results::drive(input, output, 4, false,
+                                      units::bytes(0));
+
+    const std::string text = output.str();
+    const std::string::size_type first = text.find('\n');
+    ATF_REQUIRE(first != std::string::npos);
+    ATF_REQUIRE_MATCH("^\\{\"record\":\"error\",\"reason\":\".+\"\\}$",
+                      text.substr(0, first));
+    const std::string::size_type second = text.find('\n', first + 1);
+    ATF_REQUIRE(second != std::string::npos);
+    ATF_REQUIRE_MATCH("^\\{\"record\":\"error\",\"reason\":\".*empty.*\"\\}$",
+                      text.substr(first + 1, second - first - 1));
+    ATF_REQUIRE_EQ(std::string(context_record) + result_record("dir/prog") +
+                   end_record, text.substr(second + 1));
+    ATF_REQUIRE_EQ(3, result.requests);
+    ATF_REQUIRE_EQ(1, result.opened);
+}
+
+
+ATF_INIT_TEST_CASES(tcs)
+{
+    ATF_ADD_TEST_CASE(tcs, drive__one_request);
+    ATF_ADD_TEST_CASE(tcs, drive__reuses_open_files);
+    ATF_ADD_TEST_CASE(tcs, drive__closes_least_recently_used);
+    ATF_ADD_TEST_CASE(tcs, drive__unused_filters);
+    ATF_ADD_TEST_CASE(tcs, drive__errors);
+}
@@ -29,6 +29,9 @@
 #include "engine/atf.hpp"
 
 extern "C" {
+#include <sys/stat.h>
+
+#include <fcntl.h>
 #include <unistd.h>
 }
 
@@ -45,18 +48,21 @@ extern "C" {
 #include "utils/defs.hpp"
 #include "utils/env.hpp"
 #include "utils/format/macros.hpp"
+#include "utils/fs/operations.hpp"
 #include "utils/fs/path.hpp"
 #include "utils/logging/macros.hpp"
 #include "utils/optional.ipp"
 #include "utils/process/exceptions.hpp"
 #include "utils/process/operations.hpp"
 #include "utils/process/status.hpp"
+#include "utils/sanity.hpp"
 #include "utils/stream.hpp"
 
 namespace config = utils::config;
 namespace fs = utils::fs;
 namespace process = utils::process;
 
+using utils::none;
 using utils::optional;
 
 
@@ -67,6 +73,10 @@ namespace {
 static const char* result_name = "result.atf";
 
 
+/// Suffix of the file that can provide the test cases list of a test program.
+static const char* sidecar_suffix = ".tp-list";
+
+
 /// Magic numbers returned by exec_list when exec(2) fails.
 enum list_exit_code {
     exit_eacces = 90,
@@ -78,6 +88,51 @@ enum list_exit_code {
 }  // anonymous namespace
 
 
+/// Computes the test cases list of a test program without executing it.
+///
+/// Build systems may record the test cases list of an ATF test program, as
+/// printed by its -l flag, in a sidecar file named after the binary with a
+/// .tp-list suffix.  If such a file exists and is not older than the binary,
+/// it is used instead of executing the test program.
+///
+/// \param test_program The test program to list.
+///
+/// \return The test cases in the sidecar file, or none if there is no usable
+/// sidecar and the test program has to be executed.
+optional< model::test_cases_map >
+engine::atf_interface::static_list(
+    const model::test_program& test_program) const
+{
+    const fs::path program = test_program.absolute_path();
+    const fs::path sidecar(program.str() + sidecar_suffix);
+
+    struct ::stat sidecar_sb;
+    if (::stat(sidecar.c_str(), &sidecar_sb) == -1)
+        return none;
+
+    // If the binary cannot be stat'ed, let exec_list() report the problem.
+    struct ::stat program_sb;
+    if (::stat(program.c_str(), &program_sb) == -1)
+        return none;
+    if (sidecar_sb.st_mtime < program_sb.st_mtime) {
+        LI(F("Ignoring stale test cases list %s") % sidecar);
+        return none;
+    }
+
+    std::ifstream input(sidecar.c_str());
+    if (!input) {
+        LW(F("Cannot open test cases list %s") % sidecar);
+        return none;
+    }
+    try {
+        return utils::make_optional(parse_atf_list(input));
+    } catch (const engine::error& e) {
+        LW(F("Ignoring invalid test cases list %s: %s") % sidecar % e.what());
+        return none;
+    }
+}
+
+
 /// Executes a test program's list operation.
 ///
 /// This method is intended to be called within a subprocess and is expected
@@ -163,6 +218,59 @@ engine::atf_interface::parse_list(const optional< process::status >& status,
 }
 
 
+/// Describes how to execute the test cases of a test program.
+///
+/// \param test_program The test program to execute.
+/// \param vars User-provided variables to pass to the test program.
+///
+/// \return The execution plan of the test program, which is always available.
+optional< engine::scheduler::exec_plan >
+engine::atf_interface::plan_test(const model::test_program& test_program,
+                                 const config::properties_map& vars) const
+{
+    scheduler::exec_plan plan(test_program.absolute_path());
+    plan.environment["__RUNNING_INSIDE_ATF_RUN"] = "internal-yes-value";
+    for (config::properties_map::const_iterator iter = vars.begin();
+         iter != vars.end(); ++iter) {
+        plan.args.push_back(F("-v%s=%s") % (*iter).first % (*iter).second);
+    }
+    return utils::make_optional(plan);
+}
+
+
+/// Executes a test case of the test program following a plan.
+///
+/// This method is intended to be called within a subprocess and is expected
+/// to terminate execution either by exec(2)ing the test program or by
+/// exiting with a failure.
+///
+/// \param plan The plan returned by plan_test().
+/// \param test_case_name Name of the test case to invoke.
+/// \param control_directory Directory where the interface may place control
+///     files.
+void
+engine::atf_interface::exec_planned_test(
+    const scheduler::exec_plan& plan,
+    const std::string& test_case_name,
+    const fs::path& control_directory) const
+{
+    process::args_vector args;
+
+    // The test program reopens its results file by name, so the result pipe
+    // can only be used if the system exposes it under /dev/fd.
+    const fs::path result_fd_path(F("/dev/fd/%s") % scheduler::result_fd);
+    if (::fcntl(scheduler::result_fd, F_GETFD) != -1 &&
+        fs::exists(result_fd_path)) {
+        args.push_back(F("-r%s") % result_fd_path);
+    } else {
+        (void)::close(scheduler::result_fd);
+        args.push_back(F("-r%s") % (control_directory / result_name));
+    }
+    args.push_back(test_case_name);
+    plan.exec(args);
+}
+
+
 /// Executes a test case of the test program.
 ///
 /// This method is intended to be called within a subprocess and is expected
@@ -180,17 +288,9 @@ engine::atf_interface::exec_test(const model::test_program& test_program,
                                  const config::properties_map& vars,
                                  const fs::path& control_directory) const
 {
-    utils::setenv("__RUNNING_INSIDE_ATF_RUN", "internal-yes-value");
-
-    process::args_vector args;
-    for (config::properties_map::const_iterator iter = vars.begin();
-         iter != vars.end(); ++iter) {
-        args.push_back(F("-v%s=%s") % (*iter).first % (*iter).second);
-    }
-
-    args.push_back(F("-r%s") % (control_directory / result_name));
-    args.push_back(test_case_name);
-    process::exec(test_program.absolute_path(), args);
+    exec_planned_test(plan_test(test_program, vars).get(), test_case_name,
+                      control_directory);
+    UNREACHABLE;
 }
 
 
@@ -246,3 +346,41 @@ engine::atf_interface::compute_result(
 {
     return calculate_atf_result(status, control_directory / result_name);
 }
+
+
+/// Checks whether the test cases can send their results through a pipe.
+///
+/// \return True, as ATF test programs can write their results to any path.
+bool
+engine::atf_interface::accepts_result_pipe(void) const
+{
+    return true;
+}
+
+
+/// Computes the result of a test case that had a result pipe.
+///
+/// \param status The termination status of the subprocess used to execute
+///     the exec_test() method or none if the test timed out.
+/// \param control_directory Directory where the interface may have placed
+///     control files.
+/// \param unused_stdout_path Path to the file containing the stdout of the
+///     test.
+/// \param unused_stderr_path Path to the file containing the stderr of the
+///     test.
+/// \param piped_result The data sent by the test case through the result
+///     pipe.  The results file is used instead if this is empty, as happens
+///     when the pipe was not reachable by the test program.
+///
+/// \return A test result.
+model::test_result
+engine::atf_interface::compute_piped_result(
+    const optional< process::status >& status,
+    const fs::path& control_directory,
+    const fs::path& UTILS_UNUSED_PARAM(stdout_path),
+    const fs::path& UTILS_UNUSED_PARAM(stderr_path),
+    const std::string& piped_result) const
+{
+    return calculate_atf_result(status, control_directory / result_name,
+                                piped_result);
+}
@@ -40,6 +40,9 @@ namespace engine {
 /// Implementation of the scheduler interface for atf test programs.
 class atf_interface : public engine::scheduler::interface {
 public:
+    utils::optional< model::test_cases_map > static_list(
+        const model::test_program&) const;
+
     void exec_list(const model::test_program&,
                    const utils::config::properties_map&) const UTILS_NORETURN;
 
@@ -48,6 +51,14 @@ public:
         const utils::fs::path&,
         const utils::fs::path&) const;
 
+    utils::optional< engine::scheduler::exec_plan > plan_test(
+        const model::test_program&,
+        const utils::config::properties_map&) const;
+
+    void exec_planned_test(const engine::scheduler::exec_plan&,
+                           const std::string&,
+                           const utils::fs::path&) const UTILS_NORETURN;
+
     void exec_test(const model::test_program&, const std::string&,
                    const utils::config::properties_map&,
                    const utils::fs::path&) const
@@ -63,6 +74,15 @@ public:
         const utils::fs::path&,
         const utils::fs::path&,
         const utils::fs::path&) const;
+
+    bool accepts_result_pipe(void) const;
+
+    model::test_result compute_piped_result(
+        const utils::optional< utils::process::status >&,
+        const utils::fs::path&,
+        const utils::fs::path&,
+        const utils::fs::path&,
+        const std::string&) const;
 };
 
 
@@ -28,70 +28,297 @@
 
 #include "engine/atf_list.hpp"
 
-#include <fstream>
+#include <cstring>
+#include <sstream>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "engine/exceptions.hpp"
 #include "model/metadata.hpp"
 #include "model/test_case.hpp"
 #include "utils/config/exceptions.hpp"
 #include "utils/format/macros.hpp"
+#include "utils/optional.ipp"
 
 namespace config = utils::config;
 namespace fs = utils::fs;
 
+using utils::optional;
+
 
 namespace {
 
 
-/// Splits a property line of the form "name: word1 [... wordN]".
+/// Mapping of ATF property names to the metadata properties they set.
+static const struct {
+    /// Name of the property in the ATF test case list.
+    const char* atf_name;
+
+    /// Name of the metadata property to set through metadata_builder.
+    const char* property_name;
+} atf_properties[] = {
+    { "descr", "description" },
+    { "has.cleanup", "has_cleanup" },
+    { "require.arch", "allowed_architectures" },
+    { "require.config", "required_configs" },
+    { "require.files", "required_files" },
+    { "require.machine", "allowed_platforms" },
+    { "require.memory", "required_memory" },
+    { "require.progs", "required_programs" },
+    { "require.user", "required_user" },
+    { "timeout", "timeout" },
+};
+
+
+/// Prefix of the names of the ATF properties that hold custom metadata.
+static const char custom_prefix[] = "X-";
+
+
+/// Stores a single ATF property into a metadata builder.
+///
+/// \param name Pointer to the name of the property.  Need not be terminated.
+/// \param length Length of the name of the property.
+/// \param value The value of the property.
+/// \param [in,out] mdbuilder The builder in which to store the property.
+///
+/// \throw engine::format_error If the property is unknown.
+/// \throw config::error If the value of the property is invalid.
+static void
+set_atf_property(const char* name, const std::size_t length,
+                 const std::string& value, model::metadata_builder& mdbuilder)
+{
+    for (std::size_t i = 0;
+         i < sizeof(atf_properties) / sizeof(atf_properties[0]); ++i) {
+        const char* atf_name = atf_properties[i].atf_name;
+        if (std::strlen(atf_name) == length &&
+            std::memcmp(atf_name, name, length) == 0) {
+            mdbuilder.set_string(atf_properties[i].property_name, value);
+            return;
+        }
+    }
+
+    const std::size_t prefix_length = sizeof(custom_prefix) - 1;
+    if (length > prefix_length &&
+        std::memcmp(name, custom_prefix, prefix_length) == 0) {
+        mdbuilder.add_custom(std::string(name + prefix_length,
+                                         length - prefix_length), value);
+    } else {
+        throw engine::format_error(F("Unknown test case metadata "
+                                     "property '%s'") %
+                                   std::string(name, length));
+    }
+}
+
+
+/// Iterator over the lines of a buffer.
+///
+/// Lines are returned as ranges of the buffer, so they are never copied.  Only
+/// the lines terminated by a newline character are returned: a trailing line
+/// without one, which is what std::getline reports as not good, is ignored.
+class line_reader {
+    /// The buffer to iterate over.
+    const std::string& _buffer;
+
+    /// Position of the first character of the next line.
+    std::string::size_type _pos;
+
+public:
+    /// Constructor.
+    ///
+    /// \param buffer The buffer to iterate over.  Must outlive this object.
+    explicit line_reader(const std::string& buffer) :
+        _buffer(buffer), _pos(0)
+    {
+    }
+
+    /// Gets the next line.
+    ///
+    /// \param [out] out_start Position of the first character of the line.
+    /// \param [out] out_length Length of the line, without the newline.
+    ///
+    /// \return True if a line was found; false if the end of the input
+    /// was reached.
+    bool
+    next(std::string::size_type& out_start, std::string::size_type& out_length)
+    {
+        const std::string::size_type end = _buffer.find('\n', _pos);
+        if (end == std::string::npos)
+            return false;
+        out_start = _pos;
+        out_length = end - _pos;
+        _pos = end + 1;
+        return true;
+    }
+
+    /// Gets the position of the next line.
+    ///
+    /// \return The position of the first character of the next line.
+    std::string::size_type
+    position(void) const
+    {
+        return _pos;
+    }
+
+    /// Gets the contents of the buffer not yet returned as a line.
+    ///
+    /// \return A copy of the unterminated trailing line, if any.
+    std::string
+    remainder(void) const
+    {
+        return _buffer.substr(_pos);
+    }
+};
+
+
+/// Locates the separator of a property line of the form "name: value".
 ///
-/// \param line The line to parse.
+/// \param buffer The buffer containing the line.
+/// \param start Position of the first character of the line.
+/// \param length Length of the line.
 ///
-/// \return A (property_name, property_value) pair.
+/// \return The position of the separator within the buffer.
 ///
-/// \throw format_error If the value of line is invalid.
-static std::pair< std::string, std::string >
-split_prop_line(const std::string& line)
+/// \throw format_error If the line is not a property line.
+static std::string::size_type
+find_prop_separator(const std::string& buffer,
+                    const std::string::size_type start,
+                    const std::string::size_type length)
 {
-    const std::string::size_type pos = line.find(": ");
-    if (pos == std::string::npos)
+    // The separator cannot span a line boundary because a newline is not a
+    // space, so any match past the line means there is none in it.
+    const std::string::size_type pos = buffer.find(": ", start);
+    if (pos == std::string::npos || pos >= start + length)
         throw engine::format_error("Invalid property line; expecting line of "
                                    "the form 'name: value'");
-    return std::make_pair(line.substr(0, pos), line.substr(pos + 2));
+    return pos;
 }
 
 
-/// Parses a set of consecutive property lines.
+/// Parses a set of consecutive property lines into a metadata object.
 ///
 /// Processing stops when an empty line or the end of file is reached.  None of
 /// these conditions indicate errors.
 ///
-/// \param input The stream to read the lines from.
+/// \param buffer The buffer containing the lines.
+/// \param [in,out] reader The reader of the lines of buffer.
+/// \param [in,out] seen Scratch space to detect duplicate properties, kept by
+///     the caller to reuse its storage across test cases.
+/// \param [out] end Position right past the last property line.
 ///
-/// \return The parsed property lines.
+/// \return The parsed metadata.
 ///
-/// throw format_error If the input stream has an invalid format.
-static model::properties_map
-parse_properties(std::istream& input)
+/// \throw format_error If the input has an invalid format.
+static model::metadata
+parse_properties(const std::string& buffer, line_reader& reader,
+                 std::vector< std::pair< std::string::size_type,
+                                         std::string::size_type > >& seen,
+                 std::string::size_type& end)
 {
-    model::properties_map properties;
-
-    std::string line;
-    while (std::getline(input, line).good() && !line.empty()) {
-        const std::pair< std::string, std::string > property = split_prop_line(
-            line);
-        if (properties.find(property.first) != properties.end())
-            throw engine::format_error("Duplicate value for property " +
-                                       property.first);
-        properties.insert(property);
+    model::metadata_builder mdbuilder;
+    seen.clear();
+
+    std::string::size_type start, length;
+    end = reader.position();
+    while (reader.next(start, length) && length > 0) {
+        end = start + length + 1;
+        const std::string::size_type pos = find_prop_separator(
+            buffer, start, length);
+        const std::string::size_type name_length = pos - start;
+
+        for (std::vector< std::pair< std::string::size_type,
+                                     std::string::size_type > >::const_iterator
+                 iter = seen.begin(); iter != seen.end(); ++iter) {
+            if ((*iter).second == name_length &&
+                buffer.compare((*iter).first, name_length,
+                               buffer, start, name_length) == 0)
+                throw engine::format_error(
+                    "Duplicate value for property " +
+                    buffer.substr(start, name_length));
+        }
+        seen.push_back(std::make_pair(start, name_length));
+
+        try {
+            set_atf_property(buffer.data() + start, name_length,
+                             buffer.substr(pos + 2, start + length - pos - 2),
+                             mdbuilder);
+        } catch (const config::error& e) {
+            throw engine::format_error(e.what());
+        }
     }
 
-    return properties;
+    return mdbuilder.build();
 }
 
 
+/// Metadata of the last test case parsed from a list.
+///
+/// The test cases of a test program tend to declare the same properties, so
+/// this shares a single metadata object among consecutive test cases whose
+/// property lines are identical, which saves parsing them and allocating their
+/// contents again.  The lines are compared in place in the buffer, so test
+/// cases with different properties do not pay for any copies.
+class last_metadata {
+    /// The buffer containing the test case list.
+    const std::string& _buffer;
+
+    /// Position of the property lines of the last test case.
+    std::string::size_type _start;
+
+    /// Length of the property lines of the last test case.
+    std::string::size_type _length;
+
+    /// Metadata of the last test case, if any.
+    optional< model::metadata > _metadata;
+
+public:
+    /// Constructor.
+    ///
+    /// \param buffer The buffer containing the test case list.  Must outlive
+    ///     this object.
+    explicit last_metadata(const std::string& buffer) :
+        _buffer(buffer), _start(0), _length(0)
+    {
+    }
+
+    /// Parses the properties of the next test case.
+    ///
+    /// \param [in,out] reader The reader of the lines of the buffer, pointing
+    ///     to the first property line of the test case.
+    /// \param [in,out] seen Scratch space to detect duplicate properties.
+    ///
+    /// \return The metadata of the test case.
+    ///
+    /// \throw format_error If the input has an invalid format.
+    model::metadata
+    parse(line_reader& reader,
+          std::vector< std::pair< std::string::size_type,
+                                  std::string::size_type > >& seen)
+    {
+        const std::string::size_type start = reader.position();
+        const std::string::size_type end = start + _length;
+        // The properties also have to end in the same place: either at an
+        // empty line or at the end of the complete lines of the buffer.
+        if (_metadata && _buffer.compare(start, _length, _buffer, _start,
+                                         _length) == 0 &&
+            (_buffer.find('\n', end) == std::string::npos ||
+             _buffer[end] == '\n')) {
+            std::string::size_type line_start, line_length;
+            while (reader.position() < end)
+                (void)reader.next(line_start, line_length);
+            (void)reader.next(line_start, line_length);
+            return _metadata.get();
+        }
+
+        std::string::size_type parsed_end;
+        _metadata = parse_properties(_buffer, reader, seen, parsed_end);
+        _start = start;
+        _length = parsed_end - start;
+        return _metadata.get();
+    }
+};
+
+
 }  // anonymous namespace
 
 
@@ -113,34 +340,8 @@ engine::parse_atf_metadata(const model::properties_map& props)
         for (model::properties_map::const_iterator iter = props.begin();
              iter != props.end(); iter++) {
             const std::string& name = (*iter).first;
-            const std::string& value = (*iter).second;
-
-            if (name == "descr") {
-                mdbuilder.set_string("description", value);
-            } else if (name == "has.cleanup") {
-                mdbuilder.set_string("has_cleanup", value);
-            } else if (name == "require.arch") {
-                mdbuilder.set_string("allowed_architectures", value);
-            } else if (name == "require.config") {
-                mdbuilder.set_string("required_configs", value);
-            } else if (name == "require.files") {
-                mdbuilder.set_string("required_files", value);
-            } else if (name == "require.machine") {
-                mdbuilder.set_string("allowed_platforms", value);
-            } else if (name == "require.memory") {
-                mdbuilder.set_string("required_memory", value);
-            } else if (name == "require.progs") {
-                mdbuilder.set_string("required_programs", value);
-            } else if (name == "require.user") {
-                mdbuilder.set_string("required_user", value);
-            } else if (name == "timeout") {
-                mdbuilder.set_string("timeout", value);
-            } else if (name.length() > 2 && name.substr(0, 2) == "X-") {
-                mdbuilder.add_custom(name.substr(2), value);
-            } else {
-                throw engine::format_error(F("Unknown test case metadata "
-                                             "property '%s'") % name);
-            }
+            set_atf_property(name.data(), name.length(), (*iter).second,
+                             mdbuilder);
         }
     } catch (const config::error& e) {
         throw engine::format_error(e.what());
@@ -160,32 +361,51 @@ engine::parse_atf_metadata(const model::properties_map& props)
 model::test_cases_map
 engine::parse_atf_list(std::istream& input)
 {
-    std::string line;
+    // Slurp the whole list so that its lines can be parsed in place.
+    std::ostringstream contents;
+    contents << input.rdbuf();
+    const std::string buffer = contents.str();
+    line_reader reader(buffer);
 
-    std::getline(input, line);
-    if (line != "Content-Type: application/X-atf-tp; version=\"1\""
-        || !input.good())
+    std::string::size_type start, length;
+
+    static const char header[] =
+        "Content-Type: application/X-atf-tp; version=\"1\"";
+    if (!reader.next(start, length) ||
+        buffer.compare(start, length, header) != 0) {
+        const std::string line = buffer.substr(0, buffer.find('\n'));
         throw format_error(F("Invalid header for test case list; expecting "
                              "Content-Type for application/X-atf-tp version 1, "
                              "got '%s'") % line);
+    }
 
-    std::getline(input, line);
-    if (!line.empty() || !input.good())
+    const bool terminated = reader.next(start, length);
+    if (!terminated || length > 0) {
+        const std::string line = terminated ?
+            buffer.substr(start, length) : reader.remainder();
         throw format_error(F("Invalid header for test case list; expecting "
                              "a blank line, got '%s'") % line);
+    }
 
-    model::test_cases_map_builder test_cases_builder;
-    while (std::getline(input, line).good()) {
-        const std::pair< std::string, std::string > ident = split_prop_line(
-            line);
-        if (ident.first != "ident" or ident.second.empty())
+    // The test cases are inserted in the map directly, instead of through a
+    // test_cases_map_builder, to not copy the whole map once it is complete.
+    model::test_cases_map test_cases;
+    last_metadata metadata(buffer);
+    std::vector< std::pair< std::string::size_type, std::string::size_type > >
+        seen;
+    while (reader.next(start, length)) {
+        const std::string::size_type pos = find_prop_separator(
+            buffer, start, length);
+        if (buffer.compare(start, pos - start, "ident") != 0 ||
+            pos + 2 == start + length)
             throw format_error("Invalid test case definition; must be "
                                "preceeded by the identifier");
+        const std::string ident = buffer.substr(pos + 2,
+                                                start + length - pos - 2);
 
-        const model::properties_map props = parse_properties(input);
-        test_cases_builder.add(ident.second, parse_atf_metadata(props));
+        test_cases.insert(model::test_cases_map::value_type(
+            ident, model::test_case(ident, metadata.parse(reader, seen))));
     }
-    const model::test_cases_map test_cases = test_cases_builder.build();
     if (test_cases.empty()) {
         // The scheduler interface also checks for the presence of at least one
         // test case.  However, because the atf format itself requires one test
@@ -0,0 +1,114 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// \file engine/atf_list_bench.cpp
+/// Benchmarks for the parser of the test case lists of ATF test programs.
+
+#include "engine/atf_list.hpp"
+
+#include <cstddef>
+#include <sstream>
+#include <string>
+
+#include <atf-c++.hpp>
+
+#include "model/test_case.hpp"
+#include "utils/datetime.hpp"
+#include "utils/test_utils.ipp"
+
+namespace datetime = utils::datetime;
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(parse_atf_list__many_test_cases);
+ATF_TEST_CASE_BODY(parse_atf_list__many_test_cases)
+{
+    utils::require_run_benchmarks(this);
+    const std::size_t iterations = utils::benchmark_iterations(this, 100);
+
+    const std::size_t test_cases = 1000;
+    std::ostringstream text;
+    text << "Content-Type: application/X-atf-tp; version=\"1\"\n";
+    for (std::size_t i = 0; i < test_cases; ++i) {
+        text << "\n"
+             << "ident: test_case_" << i << "\n"
+             << "descr: Description of test case " << i << "\n"
+             << "require.progs: /bin/sh\n"
+             << "timeout: 30\n"
+             << "X-custom: value\n";
+    }
+    const std::string contents = text.str();
+
+    std::size_t parsed = 0;
+    const datetime::timestamp start = datetime::timestamp::now();
+    for (std::size_t i = 0; i < iterations; ++i) {
+        std::istringstream input(contents);
+        parsed += engine::parse_atf_list(input).size();
+    }
+    utils::report_benchmark(this, iterations,
+                            datetime::timestamp::now() - start);
+
+    ATF_REQUIRE_EQ(iterations * test_cases, parsed);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(parse_atf_list__repeated_properties);
+ATF_TEST_CASE_BODY(parse_atf_list__repeated_properties)
+{
+    utils::require_run_benchmarks(this);
+    const std::size_t iterations = utils::benchmark_iterations(this, 100);
+
+    const std::size_t test_cases = 1000;
+    std::ostringstream text;
+    text << "Content-Type: application/X-atf-tp; version=\"1\"\n";
+    for (std::size_t i = 0; i < test_cases; ++i) {
+        text << "\n"
+             << "ident: test_case_" << i << "\n"
+             << "require.progs: /bin/sh\n"
+             << "timeout: 30\n"
+             << "X-custom: value\n";
+    }
+    const std::string contents = text.str();
+
+    std::size_t parsed = 0;
+    const datetime::timestamp start = datetime::timestamp::now();
+    for (std::size_t i = 0; i < iterations; ++i) {
+        std::istringstream input(contents);
+        parsed += engine::parse_atf_list(input).size();
+    }
+    utils::report_benchmark(this, iterations,
+                            datetime::timestamp::now() - start);
+
+    ATF_REQUIRE_EQ(iterations * test_cases, parsed);
+}
+
+
+ATF_INIT_TEST_CASES(tcs)
+{
+    ATF_ADD_TEST_CASE(tcs, parse_atf_list__many_test_cases);
+    ATF_ADD_TEST_CASE(tcs, parse_atf_list__repeated_properties);
+}
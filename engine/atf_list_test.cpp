@@ -230,6 +230,56 @@ ATF_TEST_CASE_BODY(parse_atf_list__one_test_case_invalid_properties)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(parse_atf_list__one_test_case_invalid_line);
+ATF_TEST_CASE_BODY(parse_atf_list__one_test_case_invalid_line)
+{
+    const std::string text =
+        "Content-Type: application/X-atf-tp; version=\"1\"\n\n"
+        "ident: first\n"
+        "descr:no space\n"
+        "timeout: 10\n";
+    std::istringstream input(text);
+    ATF_REQUIRE_THROW_RE(engine::format_error, "Invalid property line",
+        engine::parse_atf_list(input));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(parse_atf_list__one_test_case_duplicate_property);
+ATF_TEST_CASE_BODY(parse_atf_list__one_test_case_duplicate_property)
+{
+    const std::string text =
+        "Content-Type: application/X-atf-tp; version=\"1\"\n\n"
+        "ident: first\n"
+        "X-foo: a\n"
+        "descr: Some text\n"
+        "X-foo: b\n";
+    std::istringstream input(text);
+    ATF_REQUIRE_THROW_RE(engine::format_error,
+                         "Duplicate value for property X-foo",
+                         engine::parse_atf_list(input));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(parse_atf_list__unterminated_line);
+ATF_TEST_CASE_BODY(parse_atf_list__unterminated_line)
+{
+    const std::string text =
+        "Content-Type: application/X-atf-tp; version=\"1\"\n\n"
+        "ident: first\n"
+        "X-foo: bar\n"
+        "X-baz: ignored";
+    std::istringstream input(text);
+    const model::test_cases_map tests = engine::parse_atf_list(input);
+
+    const model::test_cases_map exp_tests = model::test_cases_map_builder()
+        .add("first", model::metadata_builder()
+             .add_custom("foo", "bar")
+             .build())
+        .build();
+    ATF_REQUIRE_EQ(exp_tests, tests);
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(parse_atf_list__many_test_cases);
 ATF_TEST_CASE_BODY(parse_atf_list__many_test_cases)
 {
@@ -261,6 +311,52 @@ ATF_TEST_CASE_BODY(parse_atf_list__many_test_cases)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(parse_atf_list__repeated_properties);
+ATF_TEST_CASE_BODY(parse_atf_list__repeated_properties)
+{
+    const std::string text =
+        "Content-Type: application/X-atf-tp; version=\"1\"\n"
+        "\n"
+        "ident: first\n"
+        "\n"
+        "ident: second\n"
+        "\n"
+        "ident: third\n"
+        "timeout: 500\n"
+        "\n"
+        "ident: fourth\n"
+        "timeout: 500\n"
+        "\n"
+        "ident: fifth\n"
+        "timeout: 500\n"
+        "descr: Longer\n"
+        "\n"
+        "ident: sixth\n"
+        "timeout: 500\n"
+        "descr: Longer\n"
+        "X-baz: ignored";
+    std::istringstream input(text);
+    const model::test_cases_map tests = engine::parse_atf_list(input);
+
+    const model::metadata timeout = model::metadata_builder()
+        .set_timeout(datetime::delta(500, 0))
+        .build();
+    const model::metadata longer = model::metadata_builder()
+        .set_description("Longer")
+        .set_timeout(datetime::delta(500, 0))
+        .build();
+    const model::test_cases_map exp_tests = model::test_cases_map_builder()
+        .add("first")
+        .add("second")
+        .add("third", timeout)
+        .add("fourth", timeout)
+        .add("fifth", longer)
+        .add("sixth", longer)
+        .build();
+    ATF_REQUIRE_EQ(exp_tests, tests);
+}
+
+
 ATF_INIT_TEST_CASES(tcs)
 {
     ATF_ADD_TEST_CASE(tcs, parse_atf_metadata__defaults);
@@ -274,5 +370,9 @@ ATF_INIT_TEST_CASES(tcs)
     ATF_ADD_TEST_CASE(tcs, parse_atf_list__one_test_case_complex);
     ATF_ADD_TEST_CASE(tcs, parse_atf_list__one_test_case_invalid_syntax);
     ATF_ADD_TEST_CASE(tcs, parse_atf_list__one_test_case_invalid_properties);
+    ATF_ADD_TEST_CASE(tcs, parse_atf_list__one_test_case_invalid_line);
+    ATF_ADD_TEST_CASE(tcs, parse_atf_list__one_test_case_duplicate_property);
+    ATF_ADD_TEST_CASE(tcs, parse_atf_list__unterminated_line);
     ATF_ADD_TEST_CASE(tcs, parse_atf_list__many_test_cases);
+    ATF_ADD_TEST_CASE(tcs, parse_atf_list__repeated_properties);
 }
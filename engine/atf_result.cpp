@@ -30,6 +30,8 @@
 
 #include <cstdlib>
 #include <fstream>
+#include <sstream>
+#include <string>
 #include <utility>
 
 #include "engine/exceptions.hpp"
@@ -344,6 +346,35 @@ engine::atf_result::load(const fs::path& file)
 }
 
 
+/// Parses the latest of the test case results sent through a pipe.
+///
+/// ATF test programs rewrite their results file whenever they learn more about
+/// the outcome of the test case: for example, expecting a timeout records a
+/// provisional result in case the test case gets killed, and the result is
+/// replaced if the test case does not hang after all.  When the results "file"
+/// is a pipe, these rewrites are appended instead, so the last result sent is
+/// the one that a regular file would hold.
+///
+/// \param data The data received through the pipe.
+///
+/// \return The parsed test case result if all goes well.
+///
+/// \throw engine::format_error If the latest result is bogus.
+engine::atf_result
+engine::atf_result::parse_latest(const std::string& data)
+{
+    std::string::size_type start = 0;
+    if (data.length() > 1) {
+        const std::string::size_type last_newline = data.rfind(
+            '\n', data.length() - 2);
+        if (last_newline != std::string::npos)
+            start = last_newline + 1;
+    }
+    std::istringstream input(data.substr(start));
+    return parse(input);
+}
+
+
 /// Gets the type of the result.
 ///
 /// \return A result type.
@@ -618,12 +649,34 @@ engine::operator<<(std::ostream& output, const atf_result& object)
 model::test_result
 engine::calculate_atf_result(const optional< process::status >& body_status,
                              const fs::path& results_file)
+{
+    return calculate_atf_result(body_status, results_file, "");
+}
+
+
+/// Calculates the user-visible result of a test case that had a result pipe.
+///
+/// \param body_status The termination status of the process that executed
+///     the body of the test.  None if the body timed out.
+/// \param results_file The path to the results file that the test case body
+///     created if it could not use the pipe.
+/// \param piped_result The data that the test case body sent through the
+///     result pipe.  If empty, the result is loaded from results_file.
+///
+/// \return The calculated test case result.
+model::test_result
+engine::calculate_atf_result(const optional< process::status >& body_status,
+                             const fs::path& results_file,
+                             const std::string& piped_result)
 {
     using engine::atf_result;
 
     atf_result result(atf_result::broken, "Unknown result");
     try {
-        result = atf_result::load(results_file);
+        if (piped_result.empty())
+            result = atf_result::load(results_file);
+        else
+            result = atf_result::parse_latest(piped_result);
     } catch (const engine::format_error& error) {
         result = atf_result(atf_result::broken, error.what());
     } catch (const std::runtime_error& error) {
@@ -87,6 +87,7 @@ public:
 
     static atf_result parse(std::istream&);
     static atf_result load(const utils::fs::path&);
+    static atf_result parse_latest(const std::string&);
 
     types type(void) const;
     const utils::optional< int >& argument(void) const;
@@ -107,6 +108,9 @@ std::ostream& operator<<(std::ostream&, const atf_result&);
 model::test_result calculate_atf_result(
     const utils::optional< utils::process::status >&,
     const utils::fs::path&);
+model::test_result calculate_atf_result(
+    const utils::optional< utils::process::status >&,
+    const utils::fs::path&, const std::string&);
 
 
 }  // namespace engine
@@ -0,0 +1,92 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// \file engine/atf_result_bench.cpp
+/// Benchmarks for the parser of the results of ATF test cases.
+
+#include "engine/atf_result.hpp"
+
+#include <cstddef>
+#include <sstream>
+
+#include <atf-c++.hpp>
+
+#include "utils/datetime.hpp"
+#include "utils/test_utils.ipp"
+
+namespace datetime = utils::datetime;
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(parse__passed);
+ATF_TEST_CASE_BODY(parse__passed)
+{
+    utils::require_run_benchmarks(this);
+    const std::size_t iterations = utils::benchmark_iterations(this, 100000);
+
+    std::size_t passed = 0;
+    const datetime::timestamp start = datetime::timestamp::now();
+    for (std::size_t i = 0; i < iterations; ++i) {
+        std::istringstream input("passed\n");
+        if (engine::atf_result::parse(input).type() ==
+            engine::atf_result::passed)
+            ++passed;
+    }
+    utils::report_benchmark(this, iterations,
+                            datetime::timestamp::now() - start);
+
+    ATF_REQUIRE_EQ(iterations, passed);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(parse__failed_with_reason);
+ATF_TEST_CASE_BODY(parse__failed_with_reason)
+{
+    utils::require_run_benchmarks(this);
+    const std::size_t iterations = utils::benchmark_iterations(this, 100000);
+
+    std::size_t failed = 0;
+    const datetime::timestamp start = datetime::timestamp::now();
+    for (std::size_t i = 0; i < iterations; ++i) {
+        std::istringstream input(
+            "failed: Some check failed at some_test.cpp:123\n");
+        if (engine::atf_result::parse(input).type() ==
+            engine::atf_result::failed)
+            ++failed;
+    }
+    utils::report_benchmark(this, iterations,
+                            datetime::timestamp::now() - start);
+
+    ATF_REQUIRE_EQ(iterations, failed);
+}
+
+
+ATF_INIT_TEST_CASES(tcs)
+{
+    ATF_ADD_TEST_CASE(tcs, parse__passed);
+    ATF_ADD_TEST_CASE(tcs, parse__failed_with_reason);
+}
@@ -276,6 +276,36 @@ ATF_TEST_CASE_BODY(atf_result__load__format_error)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(atf_result__parse_latest__one);
+ATF_TEST_CASE_BODY(atf_result__parse_latest__one)
+{
+    const engine::atf_result result = engine::atf_result::parse_latest(
+        "failed: Some reason\n");
+    ATF_REQUIRE(engine::atf_result::failed == result.type());
+    ATF_REQUIRE_EQ("Some reason", result.reason().get());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(atf_result__parse_latest__many);
+ATF_TEST_CASE_BODY(atf_result__parse_latest__many)
+{
+    const engine::atf_result result = engine::atf_result::parse_latest(
+        "expected_timeout: Will hang\n"
+        "expected_failure: Known bug\n");
+    ATF_REQUIRE(engine::atf_result::expected_failure == result.type());
+    ATF_REQUIRE_EQ("Known bug", result.reason().get());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(atf_result__parse_latest__no_newline);
+ATF_TEST_CASE_BODY(atf_result__parse_latest__no_newline)
+{
+    ATF_REQUIRE_THROW_RE(engine::format_error, "no new line",
+                         engine::atf_result::parse_latest(
+                             "passed\nskipped: Truncated"));
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(atf_result__apply__broken__ok);
 ATF_TEST_CASE_BODY(atf_result__apply__broken__ok)
 {
@@ -714,6 +744,35 @@ ATF_TEST_CASE_BODY(calculate_atf_result__body_bad)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(calculate_atf_result__piped);
+ATF_TEST_CASE_BODY(calculate_atf_result__piped)
+{
+    using process::status;
+
+    atf::utils::create_file("result.txt", "passed\n");
+    const status body_status = status::fake_exited(EXIT_SUCCESS);
+    ATF_REQUIRE_EQ(
+        model::test_result(model::test_result_skipped, "Something"),
+        engine::calculate_atf_result(utils::make_optional(body_status),
+                                     fs::path("result.txt"),
+                                     "skipped: Something\n"));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(calculate_atf_result__piped_empty);
+ATF_TEST_CASE_BODY(calculate_atf_result__piped_empty)
+{
+    using process::status;
+
+    atf::utils::create_file("result.txt", "skipped: Something\n");
+    const status body_status = status::fake_exited(EXIT_SUCCESS);
+    ATF_REQUIRE_EQ(
+        model::test_result(model::test_result_skipped, "Something"),
+        engine::calculate_atf_result(utils::make_optional(body_status),
+                                     fs::path("result.txt"), ""));
+}
+
+
 ATF_INIT_TEST_CASES(tcs)
 {
     ATF_ADD_TEST_CASE(tcs, atf_result__parse__empty);
@@ -751,6 +810,10 @@ ATF_INIT_TEST_CASES(tcs)
     ATF_ADD_TEST_CASE(tcs, atf_result__load__missing_file);
     ATF_ADD_TEST_CASE(tcs, atf_result__load__format_error);
 
+    ATF_ADD_TEST_CASE(tcs, atf_result__parse_latest__one);
+    ATF_ADD_TEST_CASE(tcs, atf_result__parse_latest__many);
+    ATF_ADD_TEST_CASE(tcs, atf_result__parse_latest__no_newline);
+
     ATF_ADD_TEST_CASE(tcs, atf_result__apply__broken__ok);
     ATF_ADD_TEST_CASE(tcs, atf_result__apply__timed_out);
     ATF_ADD_TEST_CASE(tcs, atf_result__apply__expected_death__ok);
@@ -785,4 +848,6 @@ ATF_INIT_TEST_CASES(tcs)
     ATF_ADD_TEST_CASE(tcs, calculate_atf_result__bad_file);
     ATF_ADD_TEST_CASE(tcs, calculate_atf_result__body_ok);
     ATF_ADD_TEST_CASE(tcs, calculate_atf_result__body_bad);
+    ATF_ADD_TEST_CASE(tcs, calculate_atf_result__piped);
+    ATF_ADD_TEST_CASE(tcs, calculate_atf_result__piped_empty);
 }
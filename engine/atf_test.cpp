@@ -32,6 +32,7 @@ extern "C" {
 #include <sys/stat.h>
 
 #include <signal.h>
+#include <utime.h>
 }
 
 #include <atf-c++.hpp>
@@ -295,6 +296,92 @@ ATF_TEST_CASE_BODY(list__stderr_not_quiet)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(list__sidecar);
+ATF_TEST_CASE_BODY(list__sidecar)
+{
+    // The binary cannot be executed, so the list must come from the sidecar.
+    atf::utils::create_file("not-valid", "garbage\n");
+    ATF_REQUIRE(::chmod("not-valid", 0755) != -1);
+    atf::utils::create_file(
+        "not-valid.tp-list",
+        "Content-Type: application/X-atf-tp; version=\"1\"\n"
+        "\n"
+        "ident: first\n"
+        "descr: The first test\n"
+        "\n"
+        "ident: second\n");
+
+    const model::test_cases_map test_cases = list_one(
+        "not-valid", fs::current_path());
+
+    const model::test_cases_map exp_test_cases = model::test_cases_map_builder()
+        .add("first", model::metadata_builder()
+             .set_description("The first test")
+             .build())
+        .add("second")
+        .build();
+    ATF_REQUIRE_EQ(exp_test_cases, test_cases);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(list__sidecar_stale);
+ATF_TEST_CASE_BODY(list__sidecar_stale)
+{
+    atf::utils::create_file(
+        "not-valid.tp-list",
+        "Content-Type: application/X-atf-tp; version=\"1\"\n"
+        "\n"
+        "ident: first\n");
+    struct ::utimbuf times;
+    times.actime = times.modtime = 1000000000;
+    ATF_REQUIRE(::utime("not-valid.tp-list", &times) != -1);
+    atf::utils::create_file("not-valid", "garbage\n");
+    ATF_REQUIRE(::chmod("not-valid", 0755) != -1);
+
+    check_list_one_fail("Invalid test program format", "not-valid",
+                        fs::current_path());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(list__sidecar_invalid);
+ATF_TEST_CASE_BODY(list__sidecar_invalid)
+{
+    atf::utils::create_file("not-valid", "garbage\n");
+    ATF_REQUIRE(::chmod("not-valid", 0755) != -1);
+    atf::utils::create_file("not-valid.tp-list", "ident: first\n");
+
+    check_list_one_fail("Invalid test program format", "not-valid",
+                        fs::current_path());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(plan_test);
+ATF_TEST_CASE_BODY(plan_test)
+{
+    const model::test_program program = model::test_program_builder(
+        "atf", fs::path("dir/program"), fs::path("/the/root"), "the-suite")
+        .build();
+
+    config::properties_map vars;
+    vars["first"] = "value 1";
+    vars["second"] = "value2";
+
+    const utils::optional< scheduler::exec_plan > plan =
+        engine::atf_interface().plan_test(program, vars);
+    ATF_REQUIRE(plan);
+    ATF_REQUIRE_EQ(fs::path("/the/root/dir/program"), plan.get().program);
+
+    std::vector< std::string > exp_args;
+    exp_args.push_back("-vfirst=value 1");
+    exp_args.push_back("-vsecond=value2");
+    ATF_REQUIRE_EQ(exp_args, plan.get().args);
+
+    std::map< std::string, std::string > exp_environment;
+    exp_environment["__RUNNING_INSIDE_ATF_RUN"] = "internal-yes-value";
+    ATF_REQUIRE_EQ(exp_environment, plan.get().environment);
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(test__body_only__passes);
 ATF_TEST_CASE_BODY(test__body_only__passes)
 {
@@ -436,6 +523,11 @@ ATF_INIT_TEST_CASES(tcs)
     ATF_ADD_TEST_CASE(tcs, list__abort);
     ATF_ADD_TEST_CASE(tcs, list__empty);
     ATF_ADD_TEST_CASE(tcs, list__stderr_not_quiet);
+    ATF_ADD_TEST_CASE(tcs, list__sidecar);
+    ATF_ADD_TEST_CASE(tcs, list__sidecar_stale);
+    ATF_ADD_TEST_CASE(tcs, list__sidecar_invalid);
+
+    ATF_ADD_TEST_CASE(tcs, plan_test);
 
     ATF_ADD_TEST_CASE(tcs, test__body_only__passes);
     ATF_ADD_TEST_CASE(tcs, test__body_only__crashes);
@@ -38,6 +38,7 @@
 #include "utils/config/exceptions.hpp"
 #include "utils/config/parser.hpp"
 #include "utils/config/tree.ipp"
+#include "utils/format/macros.hpp"
 #include "utils/passwd.hpp"
 #include "utils/text/exceptions.hpp"
 #include "utils/text/operations.ipp"
@@ -46,6 +47,7 @@ namespace config = utils::config;
 namespace fs = utils::fs;
 namespace passwd = utils::passwd;
 namespace text = utils::text;
+namespace units = utils::units;
 
 
 namespace {
@@ -58,9 +60,44 @@ namespace {
 static void
 init_tree(config::tree& tree)
 {
+    tree.define< config::positive_int_node >("adaptive_timeout");
     tree.define< config::string_node >("architecture");
-    tree.define< config::positive_int_node >("parallelism");
+    tree.define< config::bool_node >("atf_result_pipe");
+    tree.define< config::bool_node >("cache_results");
+    tree.define< config::string_node >("claims_directory");
+    tree.define< config::bool_node >("cpu_affinity");
+    tree.define< engine::bytes_node >("disk_budget");
+    tree.define< config::bool_node >("enforce_required_memory");
+    tree.define< config::positive_int_node >("max_consecutive_broken");
+    tree.define< engine::bytes_node >("max_core_size");
+    tree.define< config::positive_int_node >("max_cpu_time");
+    tree.define< engine::bytes_node >("max_output_size");
+    tree.define< config::positive_int_node >("max_retries");
+    tree.define< engine::bytes_node >("memory_budget");
+    tree.define< engine::parallelism_node >("parallelism");
+    tree.define< config::positive_int_node >("parallelism_max");
+    tree.define< config::positive_int_node >("parallelism_min");
     tree.define< config::string_node >("platform");
+    tree.define< config::positive_int_node >("prefetch_programs");
+    tree.define< config::bool_node >("program_affinity");
+    tree.define< config::bool_node >("release_test_cases");
+    tree.define< config::positive_int_node >("speculative_idle_slots");
+    tree.define< config::int_node >("store_cache_size");
+    tree.define< config::positive_int_node >("store_checkpoint_results");
+    tree.define< config::positive_int_node >("store_checkpoint_seconds");
+    tree.define< config::int_node >("store_compression_level");
+    tree.define< config::bool_node >("store_in_memory");
+    tree.define< config::string_node >("store_journal_mode");
+    tree.define< config::int_node >("store_mmap_size");
+    tree.define< config::int_node >("store_page_size");
+    tree.define< engine::bytes_node >("store_segment_threshold");
+    tree.define< config::bool_node >("store_sub_results");
+    tree.define< config::string_node >("store_synchronous");
+    tree.define< config::bool_node >("store_trends_index");
+    tree.define< config::string_node >("store_upload_command");
+    tree.define< config::bool_node >("tmpfs_work_directory");
+    tree.define< config::bool_node >("tmpfs_work_namespace");
+    tree.define< engine::bytes_node >("tmpfs_work_size");
     tree.define< engine::user_node >("unprivileged_user");
     tree.define_dynamic("test_suites");
 }
@@ -77,8 +114,9 @@ set_defaults(config::tree& tree)
     // TODO(jmmv): Automatically derive this from the number of CPUs in the
     // machine and forcibly set to a value greater than 1.  Still testing
     // the new parallel implementation as of 2015-02-27 though.
-    tree.set< config::positive_int_node >("parallelism", 1);
+    tree.set< engine::parallelism_node >("parallelism", 1);
     tree.set< config::string_node >("platform", KYUA_PLATFORM);
+    tree.set< config::int_node >("store_compression_level", 0);
 }
 
 
@@ -198,6 +236,150 @@ engine::user_node::to_string(void) const
 }
 
 
+/// Copies the node.
+///
+/// \return A dynamically-allocated node.
+config::detail::base_node*
+engine::bytes_node::deep_copy(void) const
+{
+    std::auto_ptr< bytes_node > new_node(new bytes_node());
+    new_node->_value = _value;
+    return new_node.release();
+}
+
+
+/// Pushes the node's value onto the Lua stack.
+///
+/// \param state The Lua state onto which to push the value.
+void
+engine::bytes_node::push_lua(lutok::state& state) const
+{
+    state.push_string(to_string());
+}
+
+
+/// Sets the value of the node from an entry in the Lua stack.
+///
+/// \param state The Lua state from which to get the value.
+/// \param value_index The stack index in which the value resides.
+///
+/// \throw value_error If the value in state(value_index) cannot be
+///     processed by this node.
+void
+engine::bytes_node::set_lua(lutok::state& state, const int value_index)
+{
+    if (state.is_number(value_index)) {
+        const int value = state.to_integer(value_index);
+        if (value < 0)
+            throw config::value_error("Bytes quantity cannot be negative");
+        config::typed_leaf_node< units::bytes >::set(units::bytes(value));
+    } else if (state.is_string(value_index)) {
+        set_string(state.to_string(value_index));
+    } else
+        throw config::value_error("Invalid bytes quantity");
+}
+
+
+void
+engine::bytes_node::set_string(const std::string& raw_value)
+{
+    try {
+        config::typed_leaf_node< units::bytes >::set(
+            units::bytes::parse(raw_value));
+    } catch (const std::runtime_error& e) {
+        throw config::value_error(e.what());
+    }
+}
+
+
+std::string
+engine::bytes_node::to_string(void) const
+{
+    return F("%s") % uint64_t(config::typed_leaf_node< units::bytes >::value());
+}
+
+
+/// Copies the node.
+///
+/// \return A dynamically-allocated node.
+config::detail::base_node*
+engine::parallelism_node::deep_copy(void) const
+{
+    std::auto_ptr< parallelism_node > new_node(new parallelism_node());
+    new_node->_value = _value;
+    return new_node.release();
+}
+
+
+/// Pushes the node's value onto the Lua stack.
+///
+/// \param state The Lua state onto which to push the value.
+void
+engine::parallelism_node::push_lua(lutok::state& state) const
+{
+    const std::size_t parallelism =
+        config::typed_leaf_node< std::size_t >::value();
+    if (parallelism == 0)
+        state.push_string("auto");
+    else
+        state.push_integer(static_cast< int >(parallelism));
+}
+
+
+/// Sets the value of the node from an entry in the Lua stack.
+///
+/// \param state The Lua state from which to get the value.
+/// \param value_index The stack index in which the value resides.
+///
+/// \throw value_error If the value in state(value_index) cannot be
+///     processed by this node.
+void
+engine::parallelism_node::set_lua(lutok::state& state, const int value_index)
+{
+    if (state.is_number(value_index)) {
+        const int value = state.to_integer(value_index);
+        if (value <= 0)
+            throw config::value_error("Must be a positive integer or 'auto'");
+        config::typed_leaf_node< std::size_t >::set(value);
+    } else if (state.is_string(value_index)) {
+        set_string(state.to_string(value_index));
+    } else
+        throw config::value_error("Must be a positive integer or 'auto'");
+}
+
+
+void
+engine::parallelism_node::set_string(const std::string& raw_value)
+{
+    if (raw_value == "auto") {
+        config::typed_leaf_node< std::size_t >::set(0);
+        return;
+    }
+
+    int value;
+    try {
+        value = text::to_type< int >(raw_value);
+    } catch (const text::value_error& e) {
+        throw config::value_error("Must be a positive integer or 'auto'");
+    }
+    if (value <= 0)
+        throw config::value_error("Must be a positive integer or 'auto'");
+    config::typed_leaf_node< std::size_t >::set(value);
+}
+
+
+std::string
+engine::parallelism_node::to_string(void) const
+{
+    const std::size_t parallelism =
+        config::typed_leaf_node< std::size_t >::value();
+    if (parallelism == 0)
+        return "auto";
+    else
+        return F("%s") % parallelism;
+}
+
+
 /// Constructs a config with the built-in settings.
 config::tree
 engine::default_config(void)
@@ -34,10 +34,13 @@
 
 #include "engine/config_fwd.hpp"
 
+#include <cstddef>
+
 #include "utils/config/nodes.hpp"
 #include "utils/config/tree_fwd.hpp"
 #include "utils/fs/path_fwd.hpp"
 #include "utils/passwd_fwd.hpp"
+#include "utils/units.hpp"
 
 namespace engine {
 
@@ -55,6 +58,39 @@ public:
 };
 
 
+/// Tree node to hold a quantity of bytes.
+///
+/// Values can be given either as plain integers or as strings with a unit
+/// suffix, such as "512M".
+class bytes_node : public utils::config::typed_leaf_node< utils::units::bytes > {
+public:
+    virtual base_node* deep_copy(void) const;
+
+    void push_lua(lutok::state&) const;
+    void set_lua(lutok::state&, const int);
+
+    void set_string(const std::string&);
+    std::string to_string(void) const;
+};
+
+
+/// Tree node to hold the number of test cases to run concurrently.
+///
+/// Values can be given either as positive integers or as the "auto" string,
+/// which is represented as 0 and lets the runner pick the parallelism based on
+/// the load of the host.
+class parallelism_node : public utils::config::typed_leaf_node< std::size_t > {
+public:
+    virtual base_node* deep_copy(void) const;
+
+    void push_lua(lutok::state&) const;
+    void set_lua(lutok::state&, const int);
+
+    void set_string(const std::string&);
+    std::string to_string(void) const;
+};
+
+
 utils::config::tree default_config(void);
 utils::config::tree empty_config(void);
 utils::config::tree load_config(const utils::fs::path&);
@@ -42,10 +42,12 @@
 #include "utils/cmdline/parser.hpp"
 #include "utils/config/tree.ipp"
 #include "utils/passwd.hpp"
+#include "utils/units.hpp"
 
 namespace config = utils::config;
 namespace fs = utils::fs;
 namespace passwd = utils::passwd;
+namespace units = utils::units;
 
 using utils::none;
 using utils::optional;
@@ -80,12 +82,16 @@ validate_defaults(const config::tree& config)
 
     ATF_REQUIRE_EQ(
         1,
-        config.lookup< config::positive_int_node >("parallelism"));
+        config.lookup< engine::parallelism_node >("parallelism"));
 
     ATF_REQUIRE_EQ(
         KYUA_PLATFORM,
         config.lookup< config::string_node >("platform"));
 
+    ATF_REQUIRE_EQ(
+        0,
+        config.lookup< config::int_node >("store_compression_level"));
+
     ATF_REQUIRE(!config.is_set("unprivileged_user"));
 
     ATF_REQUIRE(config.all_properties("test_suites").empty());
@@ -108,12 +114,65 @@ ATF_TEST_CASE_BODY(config__set__parallelism)
 {
     config::tree user_config = engine::default_config();
     user_config.set_string("parallelism", "8");
+    ATF_REQUIRE_EQ(8, user_config.lookup< engine::parallelism_node >(
+                          "parallelism"));
     ATF_REQUIRE_THROW_RE(
         config::error, "parallelism.*Must be a positive integer",
         user_config.set_string("parallelism", "0"));
     ATF_REQUIRE_THROW_RE(
         config::error, "parallelism.*Must be a positive integer",
         user_config.set_string("parallelism", "-1"));
+    ATF_REQUIRE_THROW_RE(
+        config::error, "parallelism.*Must be a positive integer or 'auto'",
+        user_config.set_string("parallelism", "many"));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(config__set__parallelism__auto);
+ATF_TEST_CASE_BODY(config__set__parallelism__auto)
+{
+    config::tree user_config = engine::default_config();
+    ATF_REQUIRE(!user_config.is_set("parallelism_min"));
+    ATF_REQUIRE(!user_config.is_set("parallelism_max"));
+
+    user_config.set_string("parallelism", "auto");
+    ATF_REQUIRE_EQ(0, user_config.lookup< engine::parallelism_node >(
+                          "parallelism"));
+    ATF_REQUIRE_EQ("auto", user_config.lookup_string("parallelism"));
+
+    user_config.set_string("parallelism_min", "2");
+    user_config.set_string("parallelism_max", "6");
+    ATF_REQUIRE_EQ(2, user_config.lookup< config::positive_int_node >(
+                          "parallelism_min"));
+    ATF_REQUIRE_EQ(6, user_config.lookup< config::positive_int_node >(
+                          "parallelism_max"));
+    ATF_REQUIRE_THROW_RE(
+        config::error, "parallelism_max.*Must be a positive integer",
+        user_config.set_string("parallelism_max", "0"));
+
+    const config::tree copy = user_config.deep_copy();
+    ATF_REQUIRE_EQ("auto", copy.lookup_string("parallelism"));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(config__set__budgets);
+ATF_TEST_CASE_BODY(config__set__budgets)
+{
+    config::tree user_config = engine::default_config();
+    ATF_REQUIRE(!user_config.is_set("disk_budget"));
+    ATF_REQUIRE(!user_config.is_set("memory_budget"));
+
+    user_config.set_string("disk_budget", "1024");
+    user_config.set_string("memory_budget", "2k");
+    ATF_REQUIRE_EQ(units::bytes(1024),
+                   user_config.lookup< engine::bytes_node >("disk_budget"));
+    ATF_REQUIRE_EQ(units::bytes(2048),
+                   user_config.lookup< engine::bytes_node >("memory_budget"));
+    ATF_REQUIRE_EQ("2048", user_config.lookup_string("memory_budget"));
+
+    ATF_REQUIRE_THROW_RE(
+        config::error, "memory_budget.*Invalid bytes quantity",
+        user_config.set_string("memory_budget", "lots"));
 }
 
 
@@ -195,6 +254,8 @@ ATF_INIT_TEST_CASES(tcs)
 {
     ATF_ADD_TEST_CASE(tcs, config__defaults);
     ATF_ADD_TEST_CASE(tcs, config__set__parallelism);
+    ATF_ADD_TEST_CASE(tcs, config__set__parallelism__auto);
+    ATF_ADD_TEST_CASE(tcs, config__set__budgets);
     ATF_ADD_TEST_CASE(tcs, config__load__defaults);
     ATF_ADD_TEST_CASE(tcs, config__load__overrides);
     ATF_ADD_TEST_CASE(tcs, config__load__lua_error);
@@ -28,21 +28,126 @@
 
 #include "engine/filters.hpp"
 
+extern "C" {
+#include <stdint.h>
+}
+
 #include <algorithm>
 #include <stdexcept>
 
+#include "model/metadata.hpp"
+#include "model/test_case.hpp"
+#include "model/test_program.hpp"
+#include "utils/fnv.hpp"
 #include "utils/format/macros.hpp"
 #include "utils/fs/exceptions.hpp"
 #include "utils/logging/macros.hpp"
 #include "utils/optional.ipp"
 #include "utils/sanity.hpp"
+#include "utils/text/exceptions.hpp"
+#include "utils/text/operations.ipp"
 
 namespace fs = utils::fs;
+namespace text = utils::text;
 
 using utils::none;
 using utils::optional;
 
 
+namespace {
+
+
+/// Textual representations of the metadata_filter comparisons.
+///
+/// The two-character operators must go before any of their prefixes so that
+/// parsing can pick the first match.
+static const struct {
+    /// The operator as provided by the user.
+    const char* text;
+    /// The comparison represented by the operator.
+    engine::metadata_filter::comparison_type comparison;
+} comparisons[] = {
+    { "!=", engine::metadata_filter::not_equal },
+    { "<=", engine::metadata_filter::less_equal },
+    { ">=", engine::metadata_filter::greater_equal },
+    { "=", engine::metadata_filter::equal },
+    { "<", engine::metadata_filter::less },
+    { ">", engine::metadata_filter::greater },
+};
+
+
+/// Finds the filter that matches a test program or a test case.
+///
+/// Instead of checking every filter against the test program, which would be
+/// too slow when the user provides many filters, this only looks up the few
+/// filters that can possibly match: those that name the test program itself
+/// and those that name any of its parent directories.
+///
+/// \param filters The collection of filters to look up.
+/// \param test_program The test program to match.
+/// \param test_case The test case to match, or NULL to match any test case in
+///     the test program.
+///
+/// \return The first filter, in sorting order, that matches the test program
+/// or the test case; none if there is no such filter.
+static optional< engine::test_filter >
+find_match(const std::set< engine::test_filter >& filters,
+           const fs::path& test_program, const std::string* test_case)
+{
+    typedef std::set< engine::test_filter >::const_iterator iterator;
+
+    optional< engine::test_filter > found = none;
+
+    // Filters on the test program itself sort before any other filters on the
+    // same program because their test case is empty.
+    iterator iter = filters.lower_bound(engine::test_filter(test_program, ""));
+    if (iter != filters.end() && (*iter).test_program == test_program) {
+        if (test_case == NULL || (*iter).test_case.empty() ||
+            (*iter).test_case == *test_case) {
+            found = *iter;
+        } else {
+            iter = filters.find(engine::test_filter(test_program, *test_case));
+            if (iter != filters.end())
+                found = *iter;
+        }
+    }
+
+    // This must match the behavior of fs::path::is_parent_of, which never
+    // considers the current or root directories to be parents.
+    fs::path parent = test_program.branch_path();
+    while (parent != fs::path(".") && parent != fs::path("/")) {
+        iter = filters.find(engine::test_filter(parent, ""));
+        if (iter != filters.end() && (!found || *iter < found.get()))
+            found = *iter;
+        parent = parent.branch_path();
+    }
+
+    return found;
+}
+
+
+/// Checks if any of the given files has changed.
+///
+/// \param files The absolute paths to the files to check.
+/// \param changed_files The absolute paths to the files that have changed.
+///
+/// \return True if the two sets are not disjoint.
+static bool
+any_changed(const model::paths_set& files,
+            const model::paths_set& changed_files)
+{
+    for (model::paths_set::const_iterator iter = files.begin();
+         iter != files.end(); ++iter) {
+        if (changed_files.find(*iter) != changed_files.end())
+            return true;
+    }
+    return false;
+}
+
+
+}  // anonymous namespace
+
+
 /// Constructs a filter.
 ///
 /// \param test_program_ The name of the test program or of the subdirectory to
@@ -252,12 +357,7 @@ engine::test_filters::match_test_program(const fs::path& name) const
     if (_filters.empty())
         return true;
 
-    bool matches = false;
-    for (std::set< test_filter >::const_iterator iter = _filters.begin();
-         !matches && iter != _filters.end(); iter++) {
-        matches = (*iter).matches_test_program(name);
-    }
-    return matches;
+    return static_cast< bool >(find_match(_filters, name, NULL));
 }
 
 
@@ -278,12 +378,9 @@ engine::test_filters::match_test_case(const fs::path& test_program,
         return match(true, none);
     }
 
-    optional< test_filter > found = none;
-    for (std::set< test_filter >::const_iterator iter = _filters.begin();
-         !found && iter != _filters.end(); iter++) {
-        if ((*iter).matches_test_case(test_program, test_case))
-            found = *iter;
-    }
+    const optional< test_filter > found = find_match(_filters, test_program,
+                                                     &test_case);
+    INV(!found || found.get().matches_test_case(test_program, test_case));
     INV(!found || match_test_program(test_program));
     return match(static_cast< bool >(found), found);
 }
@@ -387,3 +484,320 @@ engine::filters_state::unused(void) const
 {
     return _filters.difference(_used_filters);
 }
+
+
+/// Constructs a shard.
+///
+/// \param index_ The 1-based index of the shard.
+/// \param count_ The total number of shards.
+engine::test_shard::test_shard(const std::size_t index_,
+                               const std::size_t count_) :
+    index(index_),
+    count(count_)
+{
+    PRE(index >= 1 && index <= count);
+}
+
+
+/// Parses a user-provided shard specification.
+///
+/// \param str The user-provided string representing the shard.  Must be of the
+///     form &lt;index&gt;/&lt;count&gt;, with the index between 1 and count.
+///
+/// \return The parsed shard.
+///
+/// \throw std::runtime_error If the provided shard is invalid.
+engine::test_shard
+engine::test_shard::parse(const std::string& str)
+{
+    const std::string::size_type pos = str.find('/');
+    if (pos == std::string::npos)
+        throw std::runtime_error(F("Invalid shard '%s'; must be of the form "
+                                   "index/count") % str);
+
+    std::size_t index_, count_;
+    try {
+        index_ = text::to_type< std::size_t >(str.substr(0, pos));
+        count_ = text::to_type< std::size_t >(str.substr(pos + 1));
+    } catch (const text::value_error& e) {
+        throw std::runtime_error(F("Invalid shard '%s': %s") % str % e.what());
+    }
+    if (count_ == 0 || index_ == 0 || index_ > count_)
+        throw std::runtime_error(F("Invalid shard '%s'; the index must be "
+                                   "between 1 and the number of shards") % str);
+    return test_shard(index_, count_);
+}
+
+
+/// Formats a shard for user presentation.
+///
+/// \return A user-friendly string representing the shard.
+std::string
+engine::test_shard::str(void) const
+{
+    return F("%s/%s") % index % count;
+}
+
+
+/// Checks if this shard contains a given test case.
+///
+/// \param test_program The test program to check for.
+/// \param test_case The test case to check for.
+///
+/// \return True if the test case belongs to this shard.
+bool
+engine::test_shard::matches_test_case(const fs::path& test_program,
+                                      const std::string& test_case) const
+{
+    // FNV-1a over the test case identifier: cheap and, unlike std::hash-like
+    // facilities, guaranteed to yield the same value on every machine.
+    const uint64_t hash = utils::fnv1a64(test_program.str() + ":" + test_case);
+    return hash % count == index - 1;
+}
+
+
+/// Equality comparator.
+///
+/// \param other The other object to compare this one to.
+///
+/// \return True if this shard is equal to other.
+bool
+engine::test_shard::operator==(const test_shard& other) const
+{
+    return index == other.index && count == other.count;
+}
+
+
+/// Non-equality comparator.
+///
+/// \param other The other object to compare this one to.
+///
+/// \return True if this shard is different than other.
+bool
+engine::test_shard::operator!=(const test_shard& other) const
+{
+    return !(*this == other);
+}
+
+
+/// Injects the object into a stream.
+///
+/// \param output The stream into which to inject the object.
+/// \param object The object to format.
+///
+/// \return The output stream.
+std::ostream&
+engine::operator<<(std::ostream& output, const test_shard& object)
+{
+    output << F("test_shard{index=%s, count=%s}") % object.index % object.count;
+    return output;
+}
+
+
+/// Constructs a metadata filter.
+///
+/// \param property_ The name of the metadata property to compare.
+/// \param comparison_ The comparison to perform.
+/// \param value_ The value to compare the property to.  Must be an integer if
+///     the comparison is an ordering one.
+engine::metadata_filter::metadata_filter(const std::string& property_,
+                                         const comparison_type comparison_,
+                                         const std::string& value_) :
+    property(property_),
+    comparison(comparison_),
+    value(value_)
+{
+}
+
+
+/// Parses a user-provided metadata filter.
+///
+/// \param str The user-provided string representing the filter.  Must be of
+///     the form &lt;property&gt;&lt;operator&gt;&lt;value&gt;, where the
+///     operator is one of =, !=, &lt;, &lt;=, &gt; and &gt;=.
+///
+/// \return The parsed filter.
+///
+/// \throw std::runtime_error If the provided filter is invalid.
+engine::metadata_filter
+engine::metadata_filter::parse(const std::string& str)
+{
+    const std::string::size_type pos = str.find_first_of("!<=>");
+    if (pos == std::string::npos)
+        throw std::runtime_error(F("Invalid metadata filter '%s'; must be of "
+                                   "the form property<operator>value") % str);
+    if (pos == 0)
+        throw std::runtime_error(F("Property name in '%s' is empty") % str);
+
+    const std::string property_ = str.substr(0, pos);
+    const model::properties_map defaults =
+        model::metadata_builder().build().to_properties();
+    if (property_.find("custom.") != 0 &&
+        defaults.find(property_) == defaults.end())
+        throw std::runtime_error(F("Unknown metadata property '%s' in '%s'") %
+                                 property_ % str);
+
+    for (std::size_t i = 0; i < sizeof(comparisons) / sizeof(comparisons[0]);
+         ++i) {
+        const std::string op = comparisons[i].text;
+        if (str.compare(pos, op.length(), op) != 0)
+            continue;
+
+        const std::string value_ = str.substr(pos + op.length());
+        const comparison_type comparison_ = comparisons[i].comparison;
+        if (comparison_ != equal && comparison_ != not_equal) {
+            try {
+                (void)text::to_type< long long >(value_);
+            } catch (const text::value_error& e) {
+                throw std::runtime_error(F("Invalid value in '%s': %s") % str %
+                                         e.what());
+            }
+        }
+        return metadata_filter(property_, comparison_, value_);
+    }
+    throw std::runtime_error(F("Invalid comparison operator in '%s'") % str);
+}
+
+
+/// Formats a metadata filter for user presentation.
+///
+/// \return A user-friendly string representing the filter.
+std::string
+engine::metadata_filter::str(void) const
+{
+    for (std::size_t i = 0; i < sizeof(comparisons) / sizeof(comparisons[0]);
+         ++i) {
+        if (comparisons[i].comparison == comparison)
+            return property + comparisons[i].text + value;
+    }
+    UNREACHABLE;
+}
+
+
+/// Checks if this filter matches the metadata of a test case.
+///
+/// \param properties The metadata properties of the test case, as returned by
+///     model::metadata::to_properties().
+///
+/// \return True if the property satisfies the comparison.  A property that is
+/// not defined only satisfies the not_equal comparison, and a property that is
+/// not an integer does not satisfy any ordering comparison.
+bool
+engine::metadata_filter::matches(
+    const model::properties_map& properties) const
+{
+    const model::properties_map::const_iterator iter = properties.find(
+        property);
+    if (iter == properties.end())
+        return comparison == not_equal;
+
+    if (comparison == equal)
+        return (*iter).second == value;
+    else if (comparison == not_equal)
+        return (*iter).second != value;
+
+    long long actual;
+    try {
+        actual = text::to_type< long long >((*iter).second);
+    } catch (const text::value_error& unused_error) {
+        return false;
+    }
+    const long long expected = text::to_type< long long >(value);
+
+    switch (comparison) {
+    case less:
+        return actual < expected;
+
+    case less_equal:
+        return actual <= expected;
+
+    case greater:
+        return actual > expected;
+
+    case greater_equal:
+        return actual >= expected;
+
+    default:
+        UNREACHABLE;
+    }
+}
+
+
+/// Equality comparator.
+///
+/// \param other The other object to compare this one to.
+///
+/// \return True if this filter is equal to other.
+bool
+engine::metadata_filter::operator==(const metadata_filter& other) const
+{
+    return property == other.property && comparison == other.comparison &&
+        value == other.value;
+}
+
+
+/// Non-equality comparator.
+///
+/// \param other The other object to compare this one to.
+///
+/// \return True if this filter is different than other.
+bool
+engine::metadata_filter::operator!=(const metadata_filter& other) const
+{
+    return !(*this == other);
+}
+
+
+/// Injects the object into a stream.
+///
+/// \param output The stream into which to inject the object.
+/// \param object The object to format.
+///
+/// \return The output stream.
+std::ostream&
+engine::operator<<(std::ostream& output, const metadata_filter& object)
+{
+    output << F("metadata_filter{%s}") % object.str();
+    return output;
+}
+
+
+/// Constructs a change filter.
+///
+/// \param changed_files_ The absolute paths to the files that have changed.
+/// \param dependencies_ The absolute paths to the files that each test program
+///     depends on, keyed by the relative path of the test program.
+engine::change_filter::change_filter(
+    const model::paths_set& changed_files_,
+    const dependencies_map& dependencies_) :
+    changed_files(changed_files_),
+    dependencies(dependencies_)
+{
+}
+
+
+/// Checks if a test case is affected by the changed files.
+///
+/// \param test_program The test program the test case belongs to.
+/// \param test_case_name The name of the test case.
+///
+/// \return True if the test program, any of its dependencies or any of the
+/// files required by the test case have changed.
+bool
+engine::change_filter::matches_test_case(
+    const model::test_program& test_program,
+    const std::string& test_case_name) const
+{
+    if (changed_files.find(test_program.absolute_path()) !=
+        changed_files.end())
+        return true;
+
+    const dependencies_map::const_iterator iter = dependencies.find(
+        test_program.relative_path());
+    if (iter != dependencies.end() && any_changed((*iter).second,
+                                                  changed_files))
+        return true;
+
+    return any_changed(test_program.find(test_case_name).get_metadata().
+                       required_files(), changed_files);
+}
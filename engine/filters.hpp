@@ -38,11 +38,15 @@
 
 #include "engine/filters_fwd.hpp"
 
+#include <cstddef>
+#include <map>
 #include <ostream>
 #include <string>
 #include <set>
 #include <utility>
 
+#include "model/test_program_fwd.hpp"
+#include "model/types.hpp"
 #include "utils/fs/path.hpp"
 #include "utils/optional.ipp"
 
@@ -129,6 +133,107 @@ public:
 };
 
 
+/// Deterministic subset of the test cases of a test suite.
+///
+/// A test suite can be split into a number of shards so that each of them runs
+/// on a different machine.  Test cases are assigned to the shards by a stable
+/// hash of their identifiers, so every invocation that uses the same number of
+/// shards agrees on the assignment without any coordination.
+class test_shard {
+public:
+    /// The 1-based index of this shard.
+    std::size_t index;
+
+    /// The total number of shards.
+    std::size_t count;
+
+    test_shard(const std::size_t, const std::size_t);
+    static test_shard parse(const std::string&);
+
+    std::string str(void) const;
+
+    bool matches_test_case(const utils::fs::path&, const std::string&) const;
+
+    bool operator==(const test_shard&) const;
+    bool operator!=(const test_shard&) const;
+};
+
+
+std::ostream& operator<<(std::ostream&, const test_shard&);
+
+
+/// Predicate on the metadata of test cases.
+///
+/// A metadata filter compares the value of one metadata property of a test case
+/// against a user-provided value.  Equality comparisons are textual and apply
+/// to any property; ordering comparisons are numerical and thus only apply to
+/// properties that hold integers, like the timeout.
+class metadata_filter {
+public:
+    /// Comparisons supported by a metadata filter.
+    enum comparison_type {
+        /// The property is equal to the value.
+        equal,
+        /// The property is not equal to the value, or is not defined.
+        not_equal,
+        /// The property is numerically lower than the value.
+        less,
+        /// The property is numerically lower than or equal to the value.
+        less_equal,
+        /// The property is numerically greater than the value.
+        greater,
+        /// The property is numerically greater than or equal to the value.
+        greater_equal,
+    };
+
+    /// The name of the metadata property to compare.
+    std::string property;
+
+    /// The comparison to perform.
+    comparison_type comparison;
+
+    /// The value to compare the metadata property to.
+    std::string value;
+
+    metadata_filter(const std::string&, const comparison_type,
+                    const std::string&);
+    static metadata_filter parse(const std::string&);
+
+    std::string str(void) const;
+
+    bool matches(const model::properties_map&) const;
+
+    bool operator==(const metadata_filter&) const;
+    bool operator!=(const metadata_filter&) const;
+};
+
+
+std::ostream& operator<<(std::ostream&, const metadata_filter&);
+
+
+/// Selection of the test cases affected by a set of changed files.
+///
+/// A test case is affected by a change if the binary of its test program, any
+/// of the files that the dependency manifest lists for the test program or any
+/// of the files listed in its required_files property has changed.
+class change_filter {
+public:
+    /// Collection of dependencies keyed by test program relative path.
+    typedef std::map< utils::fs::path, model::paths_set > dependencies_map;
+
+    /// The absolute paths to the files that have changed.
+    model::paths_set changed_files;
+
+    /// The absolute paths to the files that each test program depends on.
+    dependencies_map dependencies;
+
+    change_filter(const model::paths_set&, const dependencies_map&);
+
+    bool matches_test_case(const model::test_program&,
+                           const std::string&) const;
+};
+
+
 }  // namespace engine
 
 #endif  // !defined(ENGINE_FILTERS_HPP)
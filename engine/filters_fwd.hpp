@@ -35,9 +35,12 @@
 namespace engine {
 
 
+class change_filter;
 class filters_state;
+class metadata_filter;
 class test_filter;
 class test_filters;
+class test_shard;
 
 
 }  // namespace engine
@@ -28,10 +28,16 @@
 
 #include "engine/filters.hpp"
 
+#include <sstream>
 #include <stdexcept>
+#include <vector>
 
 #include <atf-c++.hpp>
 
+#include "model/metadata.hpp"
+#include "model/test_program.hpp"
+#include "utils/format/macros.hpp"
+
 namespace fs = utils::fs;
 
 
@@ -377,6 +383,63 @@ ATF_TEST_CASE_BODY(test_filters__match_test_case__some_filters)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(test_filters__match_test_case__overlapping_filters)
+ATF_TEST_CASE_BODY(test_filters__match_test_case__overlapping_filters)
+{
+    std::set< engine::test_filter > raw_filters;
+    raw_filters.insert(mkfilter("dir", ""));
+    raw_filters.insert(mkfilter("dir/sub", ""));
+    raw_filters.insert(mkfilter("dir/sub/a_test", "foo"));
+    raw_filters.insert(mkfilter("other/a_test", ""));
+    raw_filters.insert(mkfilter("other/a_test", "foo"));
+
+    const engine::test_filters filters(raw_filters);
+    engine::test_filters::match match;
+
+    match = filters.match_test_case(fs::path("dir/sub/a_test"), "foo");
+    ATF_REQUIRE(match.first);
+    ATF_REQUIRE_EQ("dir", match.second.get().str());
+
+    match = filters.match_test_case(fs::path("other/a_test"), "foo");
+    ATF_REQUIRE(match.first);
+    ATF_REQUIRE_EQ("other/a_test", match.second.get().str());
+
+    match = filters.match_test_case(fs::path("other/b_test"), "foo");
+    ATF_REQUIRE(!match.first);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(test_filters__match_test_case__many_filters)
+ATF_TEST_CASE_BODY(test_filters__match_test_case__many_filters)
+{
+    std::set< engine::test_filter > raw_filters;
+    for (int i = 0; i < 1000; ++i) {
+        raw_filters.insert(engine::test_filter(
+            fs::path(F("dir%s/a_test") % i), ""));
+        raw_filters.insert(engine::test_filter(
+            fs::path(F("dir%s/b_test") % i), F("tc%s") % i));
+    }
+
+    const engine::test_filters filters(raw_filters);
+    engine::test_filters::match match;
+
+    match = filters.match_test_case(fs::path("dir500/a_test"), "foo");
+    ATF_REQUIRE(match.first);
+    ATF_REQUIRE_EQ("dir500/a_test", match.second.get().str());
+
+    match = filters.match_test_case(fs::path("dir500/b_test"), "tc500");
+    ATF_REQUIRE(match.first);
+    ATF_REQUIRE_EQ("dir500/b_test:tc500", match.second.get().str());
+
+    match = filters.match_test_case(fs::path("dir500/b_test"), "tc501");
+    ATF_REQUIRE(!match.first);
+
+    ATF_REQUIRE(filters.match_test_program(fs::path("dir999/b_test")));
+    ATF_REQUIRE(!filters.match_test_program(fs::path("dir1000/a_test")));
+    ATF_REQUIRE(!filters.match_test_program(fs::path("dir500")));
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(test_filters__match_test_program__no_filters)
 ATF_TEST_CASE_BODY(test_filters__match_test_program__no_filters)
 {
@@ -552,6 +615,308 @@ ATF_TEST_CASE_BODY(filters_state__unused__some)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(test_shard__public_fields);
+ATF_TEST_CASE_BODY(test_shard__public_fields)
+{
+    const engine::test_shard shard(2, 5);
+    ATF_REQUIRE_EQ(2, shard.index);
+    ATF_REQUIRE_EQ(5, shard.count);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(test_shard__parse__ok);
+ATF_TEST_CASE_BODY(test_shard__parse__ok)
+{
+    ATF_REQUIRE_EQ(engine::test_shard(1, 1), engine::test_shard::parse("1/1"));
+    ATF_REQUIRE_EQ(engine::test_shard(3, 8), engine::test_shard::parse("3/8"));
+    ATF_REQUIRE_EQ(engine::test_shard(8, 8), engine::test_shard::parse("8/8"));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(test_shard__parse__bad_format);
+ATF_TEST_CASE_BODY(test_shard__parse__bad_format)
+{
+    ATF_REQUIRE_THROW_RE(std::runtime_error, "'3'.*index/count",
+                         engine::test_shard::parse("3"));
+    ATF_REQUIRE_THROW_RE(std::runtime_error, "Invalid shard 'a/3'",
+                         engine::test_shard::parse("a/3"));
+    ATF_REQUIRE_THROW_RE(std::runtime_error, "Invalid shard '1/'",
+                         engine::test_shard::parse("1/"));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(test_shard__parse__bad_range);
+ATF_TEST_CASE_BODY(test_shard__parse__bad_range)
+{
+    ATF_REQUIRE_THROW_RE(std::runtime_error, "'0/3'.*between",
+                         engine::test_shard::parse("0/3"));
+    ATF_REQUIRE_THROW_RE(std::runtime_error, "'4/3'.*between",
+                         engine::test_shard::parse("4/3"));
+    ATF_REQUIRE_THROW_RE(std::runtime_error, "'0/0'.*between",
+                         engine::test_shard::parse("0/0"));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(test_shard__str);
+ATF_TEST_CASE_BODY(test_shard__str)
+{
+    ATF_REQUIRE_EQ("4/7", engine::test_shard(4, 7).str());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(test_shard__matches_test_case__one);
+ATF_TEST_CASE_BODY(test_shard__matches_test_case__one)
+{
+    const engine::test_shard shard(1, 1);
+    ATF_REQUIRE(shard.matches_test_case(fs::path("foo"), "bar"));
+    ATF_REQUIRE(shard.matches_test_case(fs::path("a/b/c"), "main"));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(test_shard__matches_test_case__partition);
+ATF_TEST_CASE_BODY(test_shard__matches_test_case__partition)
+{
+    const std::size_t count = 4;
+    std::vector< std::size_t > sizes(count, 0);
+    for (int i = 0; i < 1000; ++i) {
+        const fs::path program(F("dir%s/program%s") % (i % 7) % (i / 10));
+        const std::string test_case = F("case%s") % i;
+
+        std::size_t matches = 0;
+        for (std::size_t index = 1; index <= count; ++index) {
+            if (engine::test_shard(index, count).matches_test_case(
+                    program, test_case)) {
+                ++matches;
+                ++sizes[index - 1];
+            }
+        }
+        ATF_REQUIRE_EQ(1, matches);
+    }
+
+    // The hash is not perfect but must spread the test cases reasonably.
+    for (std::size_t index = 0; index < count; ++index)
+        ATF_REQUIRE(sizes[index] > 150 && sizes[index] < 350);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(test_shard__matches_test_case__stable);
+ATF_TEST_CASE_BODY(test_shard__matches_test_case__stable)
+{
+    // The assignment must not depend on the machine or on the build, as
+    // otherwise independent invocations would not agree on it.
+    const fs::path program("some/program");
+    ATF_REQUIRE(engine::test_shard(3, 3).matches_test_case(program, "a"));
+    ATF_REQUIRE(engine::test_shard(1, 3).matches_test_case(program, "b"));
+    ATF_REQUIRE(engine::test_shard(2, 3).matches_test_case(program, "c"));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(test_shard__operators_eq_and_ne);
+ATF_TEST_CASE_BODY(test_shard__operators_eq_and_ne)
+{
+    ATF_REQUIRE(engine::test_shard(1, 2) == engine::test_shard(1, 2));
+    ATF_REQUIRE(!(engine::test_shard(1, 2) != engine::test_shard(1, 2)));
+    ATF_REQUIRE(engine::test_shard(1, 2) != engine::test_shard(2, 2));
+    ATF_REQUIRE(engine::test_shard(1, 2) != engine::test_shard(1, 3));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(test_shard__output);
+ATF_TEST_CASE_BODY(test_shard__output)
+{
+    std::ostringstream str;
+    str << engine::test_shard(2, 9);
+    ATF_REQUIRE_EQ("test_shard{index=2, count=9}", str.str());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(metadata_filter__public_fields);
+ATF_TEST_CASE_BODY(metadata_filter__public_fields)
+{
+    const engine::metadata_filter filter(
+        "timeout", engine::metadata_filter::less, "60");
+    ATF_REQUIRE_EQ("timeout", filter.property);
+    ATF_REQUIRE(engine::metadata_filter::less == filter.comparison);
+    ATF_REQUIRE_EQ("60", filter.value);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(metadata_filter__parse__ok);
+ATF_TEST_CASE_BODY(metadata_filter__parse__ok)
+{
+    ATF_REQUIRE_EQ(engine::metadata_filter("is_exclusive",
+                                           engine::metadata_filter::equal,
+                                           "false"),
+                   engine::metadata_filter::parse("is_exclusive=false"));
+    ATF_REQUIRE_EQ(engine::metadata_filter("custom.tier",
+                                           engine::metadata_filter::not_equal,
+                                           "a=b"),
+                   engine::metadata_filter::parse("custom.tier!=a=b"));
+    ATF_REQUIRE_EQ(engine::metadata_filter("description",
+                                           engine::metadata_filter::equal, ""),
+                   engine::metadata_filter::parse("description="));
+    ATF_REQUIRE_EQ(engine::metadata_filter("timeout",
+                                           engine::metadata_filter::less,
+                                           "60"),
+                   engine::metadata_filter::parse("timeout<60"));
+    ATF_REQUIRE_EQ(engine::metadata_filter(
+                       "timeout", engine::metadata_filter::less_equal, "60"),
+                   engine::metadata_filter::parse("timeout<=60"));
+    ATF_REQUIRE_EQ(engine::metadata_filter("timeout",
+                                           engine::metadata_filter::greater,
+                                           "-1"),
+                   engine::metadata_filter::parse("timeout>-1"));
+    ATF_REQUIRE_EQ(engine::metadata_filter(
+                       "timeout", engine::metadata_filter::greater_equal, "1"),
+                   engine::metadata_filter::parse("timeout>=1"));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(metadata_filter__parse__bad_format);
+ATF_TEST_CASE_BODY(metadata_filter__parse__bad_format)
+{
+    ATF_REQUIRE_THROW_RE(std::runtime_error, "form property<operator>value",
+                         engine::metadata_filter::parse("timeout"));
+    ATF_REQUIRE_THROW_RE(std::runtime_error, "Property name.*empty",
+                         engine::metadata_filter::parse("=foo"));
+    ATF_REQUIRE_THROW_RE(std::runtime_error, "Invalid comparison operator",
+                         engine::metadata_filter::parse("timeout!60"));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(metadata_filter__parse__unknown_property);
+ATF_TEST_CASE_BODY(metadata_filter__parse__unknown_property)
+{
+    ATF_REQUIRE_THROW_RE(std::runtime_error,
+                         "Unknown metadata property 'timout'",
+                         engine::metadata_filter::parse("timout<60"));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(metadata_filter__parse__bad_number);
+ATF_TEST_CASE_BODY(metadata_filter__parse__bad_number)
+{
+    ATF_REQUIRE_THROW_RE(std::runtime_error, "Invalid value in 'timeout<abc'",
+                         engine::metadata_filter::parse("timeout<abc"));
+    ATF_REQUIRE_THROW_RE(std::runtime_error, "Invalid value in 'timeout>='",
+                         engine::metadata_filter::parse("timeout>="));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(metadata_filter__str);
+ATF_TEST_CASE_BODY(metadata_filter__str)
+{
+    ATF_REQUIRE_EQ("custom.tier=smoke",
+                   engine::metadata_filter::parse("custom.tier=smoke").str());
+    ATF_REQUIRE_EQ("timeout>=60",
+                   engine::metadata_filter::parse("timeout>=60").str());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(metadata_filter__matches);
+ATF_TEST_CASE_BODY(metadata_filter__matches)
+{
+    model::properties_map properties;
+    properties["custom.tier"] = "smoke";
+    properties["is_exclusive"] = "false";
+    properties["timeout"] = "30";
+
+    using engine::metadata_filter;
+    ATF_REQUIRE(metadata_filter::parse("custom.tier=smoke")
+                .matches(properties));
+    ATF_REQUIRE(!metadata_filter::parse("custom.tier!=smoke")
+                .matches(properties));
+    ATF_REQUIRE(!metadata_filter::parse("custom.other=smoke")
+                .matches(properties));
+    ATF_REQUIRE(metadata_filter::parse("custom.other!=smoke")
+                .matches(properties));
+    ATF_REQUIRE(metadata_filter::parse("is_exclusive!=true")
+                .matches(properties));
+
+    ATF_REQUIRE(metadata_filter::parse("timeout<60").matches(properties));
+    ATF_REQUIRE(!metadata_filter::parse("timeout<30").matches(properties));
+    ATF_REQUIRE(metadata_filter::parse("timeout<=30").matches(properties));
+    ATF_REQUIRE(!metadata_filter::parse("timeout>30").matches(properties));
+    ATF_REQUIRE(metadata_filter::parse("timeout>=30").matches(properties));
+    ATF_REQUIRE(!metadata_filter::parse("custom.tier>1").matches(properties));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(metadata_filter__output);
+ATF_TEST_CASE_BODY(metadata_filter__output)
+{
+    std::ostringstream str;
+    str << engine::metadata_filter::parse("timeout<60");
+    ATF_REQUIRE_EQ("metadata_filter{timeout<60}", str.str());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(change_filter__public_fields);
+ATF_TEST_CASE_BODY(change_filter__public_fields)
+{
+    model::paths_set changed_files;
+    changed_files.insert(fs::path("/src/a.c"));
+    engine::change_filter::dependencies_map dependencies;
+    dependencies[fs::path("dir/program")].insert(fs::path("/src/b.c"));
+
+    const engine::change_filter filter(changed_files, dependencies);
+    ATF_REQUIRE(changed_files == filter.changed_files);
+    ATF_REQUIRE(dependencies == filter.dependencies);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(change_filter__matches_test_case);
+ATF_TEST_CASE_BODY(change_filter__matches_test_case)
+{
+    model::paths_set required_files;
+    required_files.insert(fs::path("/data/input.txt"));
+
+    const model::test_program program = model::test_program_builder(
+        "plain", fs::path("dir/program"), fs::path("/build"), "suite")
+        .add_test_case("plain")
+        .add_test_case("with_files", model::metadata_builder()
+                       .set_required_files(required_files).build())
+        .build();
+
+    engine::change_filter::dependencies_map dependencies;
+    dependencies[fs::path("dir/program")].insert(fs::path("/src/program.c"));
+    dependencies[fs::path("dir/other")].insert(fs::path("/src/other.c"));
+
+    {
+        model::paths_set changed_files;
+        changed_files.insert(fs::path("/src/unrelated.c"));
+        changed_files.insert(fs::path("/src/other.c"));
+        const engine::change_filter filter(changed_files, dependencies);
+        ATF_REQUIRE(!filter.matches_test_case(program, "plain"));
+        ATF_REQUIRE(!filter.matches_test_case(program, "with_files"));
+    }
+
+    {
+        model::paths_set changed_files;
+        changed_files.insert(fs::path("/build/dir/program"));
+        const engine::change_filter filter(changed_files, dependencies);
+        ATF_REQUIRE(filter.matches_test_case(program, "plain"));
+        ATF_REQUIRE(filter.matches_test_case(program, "with_files"));
+    }
+
+    {
+        model::paths_set changed_files;
+        changed_files.insert(fs::path("/src/program.c"));
+        const engine::change_filter filter(changed_files, dependencies);
+        ATF_REQUIRE(filter.matches_test_case(program, "plain"));
+        ATF_REQUIRE(filter.matches_test_case(program, "with_files"));
+    }
+
+    {
+        model::paths_set changed_files;
+        changed_files.insert(fs::path("/data/input.txt"));
+        const engine::change_filter filter(changed_files, dependencies);
+        ATF_REQUIRE(!filter.matches_test_case(program, "plain"));
+        ATF_REQUIRE(filter.matches_test_case(program, "with_files"));
+    }
+}
+
+
 ATF_INIT_TEST_CASES(tcs)
 {
     ATF_ADD_TEST_CASE(tcs, test_filter__public_fields);
@@ -573,6 +938,8 @@ ATF_INIT_TEST_CASES(tcs)
 
     ATF_ADD_TEST_CASE(tcs, test_filters__match_test_case__no_filters);
     ATF_ADD_TEST_CASE(tcs, test_filters__match_test_case__some_filters);
+    ATF_ADD_TEST_CASE(tcs, test_filters__match_test_case__overlapping_filters);
+    ATF_ADD_TEST_CASE(tcs, test_filters__match_test_case__many_filters);
     ATF_ADD_TEST_CASE(tcs, test_filters__match_test_program__no_filters);
     ATF_ADD_TEST_CASE(tcs, test_filters__match_test_program__some_filters);
     ATF_ADD_TEST_CASE(tcs, test_filters__difference__no_filters);
@@ -586,4 +953,27 @@ ATF_INIT_TEST_CASES(tcs)
     ATF_ADD_TEST_CASE(tcs, filters_state__match_test_case);
     ATF_ADD_TEST_CASE(tcs, filters_state__unused__none);
     ATF_ADD_TEST_CASE(tcs, filters_state__unused__some);
+
+    ATF_ADD_TEST_CASE(tcs, test_shard__public_fields);
+    ATF_ADD_TEST_CASE(tcs, test_shard__parse__ok);
+    ATF_ADD_TEST_CASE(tcs, test_shard__parse__bad_format);
+    ATF_ADD_TEST_CASE(tcs, test_shard__parse__bad_range);
+    ATF_ADD_TEST_CASE(tcs, test_shard__str);
+    ATF_ADD_TEST_CASE(tcs, test_shard__matches_test_case__one);
+    ATF_ADD_TEST_CASE(tcs, test_shard__matches_test_case__partition);
+    ATF_ADD_TEST_CASE(tcs, test_shard__matches_test_case__stable);
+    ATF_ADD_TEST_CASE(tcs, test_shard__operators_eq_and_ne);
+    ATF_ADD_TEST_CASE(tcs, test_shard__output);
+
+    ATF_ADD_TEST_CASE(tcs, metadata_filter__public_fields);
+    ATF_ADD_TEST_CASE(tcs, metadata_filter__parse__ok);
+    ATF_ADD_TEST_CASE(tcs, metadata_filter__parse__bad_format);
+    ATF_ADD_TEST_CASE(tcs, metadata_filter__parse__unknown_property);
+    ATF_ADD_TEST_CASE(tcs, metadata_filter__parse__bad_number);
+    ATF_ADD_TEST_CASE(tcs, metadata_filter__str);
+    ATF_ADD_TEST_CASE(tcs, metadata_filter__matches);
+    ATF_ADD_TEST_CASE(tcs, metadata_filter__output);
+
+    ATF_ADD_TEST_CASE(tcs, change_filter__public_fields);
+    ATF_ADD_TEST_CASE(tcs, change_filter__matches_test_case);
 }
@@ -30,6 +30,8 @@
 
 #include <algorithm>
 #include <iterator>
+#include <map>
+#include <set>
 #include <stdexcept>
 
 #include <lutok/exceptions.hpp>
@@ -38,6 +40,7 @@
 #include <lutok/state.ipp>
 
 #include "engine/exceptions.hpp"
+#include "engine/kyuafile_cache.hpp"
 #include "engine/scheduler.hpp"
 #include "model/metadata.hpp"
 #include "model/test_program.hpp"
@@ -88,6 +91,11 @@ static int lua_syntax(lutok::state&);
 static int lua_test_suite(lutok::state&);
 
 
+/// Collection of variants of a test program, keyed by their names, along with
+/// the test suite configuration variables that each of them overrides.
+typedef std::map< std::string, config::properties_map > variants_map;
+
+
 /// Concatenates two paths while avoiding paths to start with './'.
 ///
 /// \param root Path to the directory containing the file.
@@ -124,6 +132,30 @@ class parser : utils::noncopyable {
     /// Name of the Kyuafile to load relative to _source_root.
     const fs::path _relative_filename;
 
+    /// Absolute path to the Kyuafile to load.
+    ///
+    /// This is resolved once by the caller instead of on every use because
+    /// doing so requires querying the current directory.
+    const fs::path _abs_kyuafile;
+
+    /// Accumulator for the absolute paths of all the evaluated Kyuafiles.
+    std::set< fs::path >& _loaded_files;
+
+    /// Accumulator for the directories inspected by the fs module.
+    std::set< fs::path >& _inspected_dirs;
+
+    /// Accumulator for the costs of the evaluated Kyuafiles; may be NULL.
+    engine::kyuafile_profile* _profile;
+
+    /// Number of operations on the file system done by this Kyuafile.
+    std::size_t _fs_operations;
+
+    /// Number of test programs declared by this Kyuafile.
+    std::size_t _declared;
+
+    /// Time spent evaluating the files included by this Kyuafile.
+    datetime::delta _includes_duration;
+
     /// Version of the Kyuafile file format requested by the parsed file.
     ///
     /// This is set once the Kyuafile invokes the syntax() call.
@@ -176,17 +208,32 @@ public:
     /// \param build_root_ The root directory of the test programs.
     /// \param relative_filename_ Name of the Kyuafile to load relative to
     ///     source_root_.
+    /// \param abs_kyuafile_ Absolute path to the Kyuafile to load.
     /// \param user_config User configuration holding any test suite properties
     ///     to be passed to the list operation.
     /// \param scheduler_handle The scheduler context to use for loading the
     ///     test case lists.
+    /// \param loaded_files_ Set into which to record the absolute paths of the
+    ///     evaluated Kyuafiles, including any included ones.
+    /// \param inspected_dirs_ Set into which to record the directories whose
+    ///     contents are inspected by the Kyuafiles.
+    /// \param profile_ If not NULL, collection into which to record the costs
+    ///     of the evaluated Kyuafiles, including any included ones.
     parser(const fs::path& source_root_, const fs::path& build_root_,
            const fs::path& relative_filename_,
+           const fs::path& abs_kyuafile_,
            const config::tree& user_config,
-           scheduler::scheduler_handle& scheduler_handle) :
+           scheduler::scheduler_handle& scheduler_handle,
+           std::set< fs::path >& loaded_files_,
+           std::set< fs::path >& inspected_dirs_,
+           engine::kyuafile_profile* profile_) :
         _source_root(source_root_), _build_root(build_root_),
-        _relative_filename(relative_filename_)
+        _relative_filename(relative_filename_), _abs_kyuafile(abs_kyuafile_),
+        _loaded_files(loaded_files_), _inspected_dirs(inspected_dirs_),
+        _profile(profile_), _fs_operations(0), _declared(0)
     {
+        PRE(_abs_kyuafile.is_absolute());
+
         lutok::stack_cleaner cleaner(_state);
 
         _state.push_cxx_function(lua_syntax);
@@ -224,7 +271,8 @@ public:
         _state.open_base();
         _state.open_string();
         _state.open_table();
-        fs::open_fs(_state, callback_current_kyuafile().branch_path());
+        fs::open_fs(_state, _abs_kyuafile.branch_path(),
+                    &_inspected_dirs, &_fs_operations);
     }
 
     /// Destructor.
@@ -248,14 +296,10 @@ public:
     /// Callback for the Kyuafile current_kyuafile() function.
     ///
     /// \return Returns the absolute path to the current Kyuafile.
-    fs::path
+    const fs::path&
     callback_current_kyuafile(void) const
     {
-        const fs::path file = relativize(_source_root, _relative_filename);
-        if (file.is_absolute())
-            return file;
-        else
-            return file.to_absolute();
+        return _abs_kyuafile;
     }
 
     /// Callback for the Kyuafile include() function.
@@ -274,9 +318,13 @@ public:
     {
         const fs::path file = relativize(_relative_filename.branch_path(),
                                          raw_file);
+        const datetime::monotonic_time start = datetime::monotonic_time::now();
         const model::test_programs_vector subtps =
-            parser(_source_root, _build_root, file, user_config,
-                   scheduler_handle).parse();
+            parser(_source_root, _build_root, file,
+                   relativize(_abs_kyuafile.branch_path(), raw_file),
+                   user_config, scheduler_handle, _loaded_files,
+                   _inspected_dirs, _profile).parse();
+        _includes_duration += datetime::monotonic_time::now() - start;
 
         std::copy(subtps.begin(), subtps.end(),
                   std::back_inserter(_test_programs));
@@ -315,6 +363,9 @@ public:
     /// \param test_suite_override Name of the test suite this test program
     ///     belongs to, if explicitly defined at the test program level.
     /// \param metadata Metadata variables passed to the test program.
+    /// \param variants Variants of the test program, keyed by their names, with
+    ///     the test suite configuration variables that each of them overrides.
+    ///     If not empty, the test program is defined once per variant.
     /// \param user_config User configuration holding any test suite properties
     ///     to be passed to the list operation.
     /// \param scheduler_handle Scheduler context to run test programs in.
@@ -326,6 +377,7 @@ public:
                           const fs::path& raw_path,
                           const std::string& test_suite_override,
                           const model::metadata& metadata,
+                          const variants_map& variants,
                           const config::tree& user_config,
                           scheduler::scheduler_handle& scheduler_handle)
     {
@@ -344,11 +396,30 @@ public:
                                      path);
 
         const std::string test_suite = get_test_suite(test_suite_override);
+        ++_declared;
+
+        if (variants.empty()) {
+            _test_programs.push_back(model::test_program_ptr(
+                new scheduler::lazy_test_program(interface, path, _build_root,
+                                                 test_suite, metadata,
+                                                 user_config,
+                                                 scheduler_handle)));
+            return;
+        }
 
-        _test_programs.push_back(model::test_program_ptr(
+        // All variants share a single listing of the test program.
+        variants_map::const_iterator iter = variants.begin();
+        const std::shared_ptr< scheduler::lazy_test_program > first(
             new scheduler::lazy_test_program(interface, path, _build_root,
                                              test_suite, metadata, user_config,
-                                             scheduler_handle)));
+                                             scheduler_handle, (*iter).first,
+                                             (*iter).second));
+        _test_programs.push_back(first);
+        for (++iter; iter != variants.end(); ++iter) {
+            _test_programs.push_back(model::test_program_ptr(
+                new scheduler::lazy_test_program(*first, (*iter).first,
+                                                 (*iter).second)));
+        }
     }
 
     /// Callback for the Kyuafile test_suite() function.
@@ -379,6 +450,15 @@ public:
         PRE(_test_programs.empty());
 
         const fs::path load_path = relativize(_source_root, _relative_filename);
+        _loaded_files.insert(_abs_kyuafile);
+
+        // Reserve the entry of this file before evaluating it so that the
+        // profile lists the files in the order in which they are included.
+        const std::size_t profile_index =
+            _profile == NULL ? 0 : _profile->size();
+        if (_profile != NULL)
+            _profile->push_back(engine::kyuafile_stats(_relative_filename));
+        const datetime::monotonic_time start = datetime::monotonic_time::now();
         try {
             lutok::do_file(_state, load_path.str(), 0, 0, 0);
         } catch (const std::runtime_error& e) {
@@ -394,11 +474,107 @@ public:
         if (!_version)
             throw engine::load_error(load_path, "syntax() never called");
 
+        if (_profile != NULL) {
+            engine::kyuafile_stats& stats = (*_profile)[profile_index];
+            stats.duration = datetime::monotonic_time::now() - start;
+            stats.self_duration = datetime::delta::from_microseconds(
+                stats.duration.to_microseconds() -
+                _includes_duration.to_microseconds());
+            stats.fs_operations = _fs_operations;
+            stats.test_programs = _declared;
+        }
+
         return _test_programs;
     }
 };
 
 
+/// Converts the value at the top of the Lua stack to a property string.
+///
+/// \param state The Lua state holding the value.
+///
+/// \return The string representation of the value, or none if the value is not
+/// a boolean, a number or a string.
+static optional< std::string >
+to_property_string(lutok::state& state)
+{
+    if (state.is_boolean(-1)) {
+        const std::string value = F("%s") % state.to_boolean(-1);
+        return utils::make_optional(value);
+    } else if (state.is_number(-1)) {
+        const std::string value = F("%s") % state.to_integer(-1);
+        return utils::make_optional(value);
+    } else if (state.is_string(-1)) {
+        return utils::make_optional(state.to_string(-1));
+    } else {
+        return none;
+    }
+}
+
+
+/// Extracts the variants of a test program from its definition.
+///
+/// \pre state(-1) A table with the arguments that define the test program.
+///
+/// \param state The Lua state that holds the definition.
+/// \param path Path to the test program, for error reporting purposes.
+///
+/// \return The variants of the test program; empty if it has none.
+///
+/// \throw std::runtime_error If the variants property is invalid.
+static variants_map
+get_variants(lutok::state& state, const fs::path& path)
+{
+    lutok::stack_cleaner cleaner(state);
+
+    variants_map variants;
+    state.push_string("variants");
+    state.get_table(-2);
+    if (state.is_nil(-1))
+        return variants;
+    if (!state.is_table(-1))
+        throw std::runtime_error(F("The variants property of test program "
+                                   "'%s' must be a table") % path);
+
+    state.push_nil();
+    while (state.next(-2)) {
+        if (!state.is_string(-2) || !state.is_table(-1))
+            throw std::runtime_error(F("Variants of test program '%s' must be "
+                                       "tables keyed by their names") % path);
+        const std::string name = state.to_string(-2);
+        if (name.empty())
+            throw std::runtime_error(F("Found variant with an empty name in "
+                                       "test program '%s'") % path);
+
+        config::properties_map vars;
+        state.push_nil();
+        while (state.next(-2)) {
+            if (!state.is_string(-2))
+                throw std::runtime_error(
+                    F("Found non-string variable name in variant '%s' of "
+                      "test program '%s'") % name % path);
+            const std::string var = state.to_string(-2);
+            const optional< std::string > value = to_property_string(state);
+            if (!value)
+                throw std::runtime_error(
+                    F("Variable '%s' in variant '%s' of test program '%s' "
+                      "cannot be converted to a string") % var % name % path);
+            vars[var] = value.get();
+            state.pop(1);
+        }
+        variants[name] = vars;
+
+        state.pop(1);
+    }
+
+    if (variants.empty())
+        throw std::runtime_error(F("The variants property of test program "
+                                   "'%s' must define at least one variant") %
+                                 path);
+    return variants;
+}
+
+
 /// Glue to invoke parser::callback_test_program() from Lua.
 ///
 /// This is a helper function for the various *_test_program() calls, as they
@@ -406,7 +582,9 @@ public:
 ///
 /// \pre state(-1) A table with the arguments that define the test program.  The
 /// special argument 'test_suite' provides an override to the global test suite
-/// name.  The rest of the arguments are part of the test program metadata.
+/// name, and the special argument 'variants' holds a table of named tables of
+/// test suite configuration variables with which to run the test program.  The
+/// rest of the arguments are part of the test program metadata.
 /// \pre state(upvalue 1) String with the name of the interface.
 /// \pre state(upvalue 2) User configuration with the per-test suite settings.
 /// \pre state(upvalue 3) Scheduler context to run test programs in.
@@ -467,6 +645,8 @@ lua_generic_test_program(lutok::state& state)
     }
     state.pop(1);
 
+    const variants_map variants = get_variants(state, path);
+
     model::metadata_builder mdbuilder;
     state.push_nil();
     while (state.next(-2)) {
@@ -476,28 +656,22 @@ lua_generic_test_program(lutok::state& state)
                                      path);
         const std::string property = state.to_string(-2);
 
-        if (property != "name" && property != "test_suite") {
-            std::string value;
-            if (state.is_boolean(-1)) {
-                value = F("%s") % state.to_boolean(-1);
-            } else if (state.is_number(-1)) {
-                value = F("%s") % state.to_integer(-1);
-            } else if (state.is_string(-1)) {
-                value = state.to_string(-1);
-            } else {
+        if (property != "name" && property != "test_suite" &&
+            property != "variants") {
+            const optional< std::string > value = to_property_string(state);
+            if (!value)
                 throw std::runtime_error(
                     F("Metadata property '%s' in test program '%s' cannot be "
                       "converted to a string") % property % path);
-            }
 
-            mdbuilder.set_string(property, value);
+            mdbuilder.set_string(property, value.get());
         }
 
         state.pop(1);
     }
 
     parser::get_from_state(state)->callback_test_program(
-        interface, path, test_suite, mdbuilder.build(), *user_config,
+        interface, path, test_suite, mdbuilder.build(), variants, *user_config,
         *scheduler_handle);
     return 0;
 }
@@ -592,9 +766,129 @@ lua_test_suite(lutok::state& state)
 }
 
 
+/// Instantiates the test programs recorded in a Kyuafile cache entry.
+///
+/// Consecutive variants of the same test program share a single listing of
+/// their test cases, as they would if the Kyuafile had been evaluated.
+///
+/// \param definitions The test programs defined by the Kyuafile.
+/// \param user_config User configuration holding any test suite properties
+///     to be passed to the list operation.
+/// \param scheduler_handle The scheduler context to use for loading the test
+///     case lists.
+///
+/// \return The collection of lazy test programs.
+static model::test_programs_vector
+instantiate_test_programs(const model::test_programs_vector& definitions,
+                          const config::tree& user_config,
+                          scheduler::scheduler_handle& scheduler_handle)
+{
+    model::test_programs_vector test_programs;
+    std::shared_ptr< scheduler::lazy_test_program > previous;
+    for (model::test_programs_vector::const_iterator iter = definitions.begin();
+         iter != definitions.end(); ++iter) {
+        const model::test_program& definition = **iter;
+
+        std::shared_ptr< scheduler::lazy_test_program > test_program;
+        if (previous.get() != NULL && !definition.variant().empty() &&
+            !previous->variant().empty() &&
+            previous->interface_name() == definition.interface_name() &&
+            previous->relative_path() == definition.relative_path() &&
+            previous->test_suite_name() == definition.test_suite_name() &&
+            previous->get_metadata() == definition.get_metadata()) {
+            test_program.reset(new scheduler::lazy_test_program(
+                *previous, definition.variant(), definition.variant_vars()));
+        } else {
+            test_program.reset(new scheduler::lazy_test_program(
+                definition.interface_name(), definition.relative_path(),
+                definition.root(), definition.test_suite_name(),
+                definition.get_metadata(), user_config, scheduler_handle,
+                definition.variant(), definition.variant_vars()));
+        }
+        test_programs.push_back(test_program);
+        previous = test_program;
+    }
+    return test_programs;
+}
+
+
+/// Loads a Kyuafile, optionally through a cache.
+///
+/// \param file The file to parse.
+/// \param user_build_root If not none, specifies a path to a directory
+///     containing the test programs themselves.
+/// \param user_config User configuration holding any test suite properties
+///     to be passed to the list operation.
+/// \param scheduler_handle The scheduler context to use for loading the test
+///     case lists.
+/// \param cache The cache of previously-loaded Kyuafiles, or NULL to always
+///     evaluate the Kyuafile.
+/// \param [out] profile If not NULL, receives the costs of the evaluation of
+///     every Kyuafile.  The cache is not consulted in this case, so that the
+///     Kyuafiles are always evaluated, but it is still updated.
+///
+/// \return High-level representation of the configuration file.
+///
+/// \throw load_error If there is any problem loading the file.
+static engine::kyuafile
+load_kyuafile(const fs::path& file,
+              const optional< fs::path > user_build_root,
+              const config::tree& user_config,
+              scheduler::scheduler_handle& scheduler_handle,
+              const engine::kyuafile_cache* cache,
+              engine::kyuafile_profile* profile)
+{
+    const fs::path source_root_ = file.branch_path();
+    const fs::path build_root_ = user_build_root ?
+        user_build_root.get() : source_root_;
+
+    // test_program.absolute_path() uses the current work directory and that
+    // fails to resolve the correct path once we have used chdir to enter the
+    // test work directory.  To prevent this causing issues down the road,
+    // force the build root to be absolute so that absolute_path() does not
+    // need to rely on the current work directory.
+    const fs::path abs_build_root = build_root_.is_absolute() ?
+        build_root_ : build_root_.to_absolute();
+
+    const fs::path abs_file = file.is_absolute() ? file : file.to_absolute();
+    if (cache != NULL && profile == NULL) {
+        const optional< model::test_programs_vector > definitions =
+            cache->lookup(abs_file, abs_build_root);
+        if (definitions)
+            return engine::kyuafile(
+                source_root_, build_root_,
+                instantiate_test_programs(definitions.get(), user_config,
+                                          scheduler_handle));
+    }
+
+    std::set< fs::path > loaded_files;
+    std::set< fs::path > inspected_dirs;
+    const model::test_programs_vector test_programs =
+        parser(source_root_, abs_build_root, fs::path(file.leaf_name()),
+               abs_file, user_config, scheduler_handle, loaded_files,
+               inspected_dirs, profile).parse();
+    if (cache != NULL)
+        cache->store(abs_file, abs_build_root, test_programs, loaded_files,
+                     inspected_dirs);
+    return engine::kyuafile(source_root_, build_root_, test_programs);
+}
+
+
 }  // anonymous namespace
 
 
+/// Constructor for the stats of a Kyuafile not evaluated yet.
+///
+/// \param file_ Path to the Kyuafile, relative to the directory of the loaded
+///     one.
+engine::kyuafile_stats::kyuafile_stats(const fs::path& file_) :
+    file(file_),
+    fs_operations(0),
+    test_programs(0)
+{
+}
+
+
 /// Constructs a kyuafile form initialized data.
 ///
 /// Use load() to parse a test suite configuration file and construct a
@@ -645,22 +939,43 @@ engine::kyuafile::load(const fs::path& file,
                        const config::tree& user_config,
                        scheduler::scheduler_handle& scheduler_handle)
 {
-    const fs::path source_root_ = file.branch_path();
-    const fs::path build_root_ = user_build_root ?
-        user_build_root.get() : source_root_;
+    return load_kyuafile(file, user_build_root, user_config, scheduler_handle,
+                         NULL, NULL);
+}
 
-    // test_program.absolute_path() uses the current work directory and that
-    // fails to resolve the correct path once we have used chdir to enter the
-    // test work directory.  To prevent this causing issues down the road,
-    // force the build root to be absolute so that absolute_path() does not
-    // need to rely on the current work directory.
-    const fs::path abs_build_root = build_root_.is_absolute() ?
-        build_root_ : build_root_.to_absolute();
 
-    return kyuafile(source_root_, build_root_,
-                    parser(source_root_, abs_build_root,
-                           fs::path(file.leaf_name()), user_config,
-                           scheduler_handle).parse());
+/// Parses a test suite configuration file, reusing previous results if valid.
+///
+/// This is the same as the other load() but consults the given cache first.
+/// The Kyuafile is only evaluated if the cache does not hold a valid entry for
+/// it, in which case the results of the evaluation are stored in the cache.
+///
+/// \param file The file to parse.
+/// \param user_build_root If not none, specifies a path to a directory
+///     containing the test programs themselves.
+/// \param user_config User configuration holding any test suite properties
+///     to be passed to the list operation.
+/// \param scheduler_handle The scheduler context to use for loading the test
+///     case lists.
+/// \param cache The cache of previously-loaded Kyuafiles.
+/// \param [out] profile If not NULL, receives the costs of the evaluation of
+///     every Kyuafile, in which case the Kyuafiles are evaluated even if the
+///     cache holds a valid entry for them.
+///
+/// \return High-level representation of the configuration file.
+///
+/// \throw load_error If there is any problem loading the file.  This includes
+///     file access errors and syntax errors.
+engine::kyuafile
+engine::kyuafile::load(const fs::path& file,
+                       const optional< fs::path > user_build_root,
+                       const config::tree& user_config,
+                       scheduler::scheduler_handle& scheduler_handle,
+                       const kyuafile_cache& cache,
+                       kyuafile_profile* profile)
+{
+    return load_kyuafile(file, user_build_root, user_config, scheduler_handle,
+                         &cache, profile);
 }
 
 
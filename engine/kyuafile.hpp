@@ -34,20 +34,48 @@
 
 #include "engine/kyuafile_fwd.hpp"
 
+#include <cstddef>
 #include <string>
 #include <vector>
 
 #include <lutok/state.hpp>
 
+#include "engine/kyuafile_cache_fwd.hpp"
 #include "engine/scheduler_fwd.hpp"
 #include "model/test_program_fwd.hpp"
 #include "utils/config/tree_fwd.hpp"
+#include "utils/datetime.hpp"
 #include "utils/fs/path.hpp"
 #include "utils/optional_fwd.hpp"
 
 namespace engine {
 
 
+/// Cost of the evaluation of a single Kyuafile.
+struct kyuafile_stats {
+    /// Path to the Kyuafile, relative to the directory of the loaded one.
+    utils::fs::path file;
+
+    /// Time it took to evaluate the Kyuafile, including any included files.
+    utils::datetime::delta duration;
+
+    /// Time it took to evaluate the Kyuafile, excluding any included files.
+    utils::datetime::delta self_duration;
+
+    /// Number of operations on the file system done by the fs module.
+    std::size_t fs_operations;
+
+    /// Number of test programs declared by the Kyuafile itself.
+    std::size_t test_programs;
+
+    explicit kyuafile_stats(const utils::fs::path&);
+};
+
+
+/// Costs of the evaluation of Kyuafiles, in evaluation order.
+typedef std::vector< kyuafile_stats > kyuafile_profile;
+
+
 /// Representation of the configuration of a test suite.
 ///
 /// Test suites are collections of related test programs.  They are described by
@@ -84,6 +112,11 @@ public:
                          const utils::optional< utils::fs::path >,
                          const utils::config::tree&,
                          scheduler::scheduler_handle&);
+    static kyuafile load(const utils::fs::path&,
+                         const utils::optional< utils::fs::path >,
+                         const utils::config::tree&,
+                         scheduler::scheduler_handle&,
+                         const kyuafile_cache&, kyuafile_profile* = NULL);
 
     const utils::fs::path& source_root(void) const;
     const utils::fs::path& build_root(void) const;
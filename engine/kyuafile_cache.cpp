@@ -0,0 +1,513 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "engine/kyuafile_cache.hpp"
+
+extern "C" {
+#include <sys/stat.h>
+
+#include <unistd.h>
+}
+
+#include <cerrno>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include "model/metadata.hpp"
+#include "model/test_program.hpp"
+#include "model/types.hpp"
+#include "utils/config/tree_fwd.hpp"
+#include "utils/fnv.hpp"
+#include "utils/format/macros.hpp"
+#include "utils/fs/directory.hpp"
+#include "utils/fs/exceptions.hpp"
+#include "utils/fs/operations.hpp"
+#include "utils/logging/macros.hpp"
+#include "utils/noncopyable.hpp"
+#include "utils/optional.ipp"
+#include "utils/sanity.hpp"
+#include "utils/stream.hpp"
+
+namespace config = utils::config;
+namespace fs = utils::fs;
+
+using utils::none;
+using utils::optional;
+
+
+namespace {
+
+
+/// Header of the cache entry files; bump on format changes.
+static const char* entry_magic = "Kyua Kyuafile cache v1";
+
+
+/// Placeholder recorded as the contents of a missing file or directory.
+static const char* missing_contents = "missing";
+
+
+/// Escapes a string so that it can be stored in a single key=value line.
+///
+/// \param str The string to escape.
+///
+/// \return The escaped string, which contains neither newlines nor '='.
+static std::string
+escape(const std::string& str)
+{
+    std::string result;
+    for (std::string::const_iterator iter = str.begin(); iter != str.end();
+         ++iter) {
+        switch (*iter) {
+        case '\\': result += "\\\\"; break;
+        case '\n': result += "\\n"; break;
+        case '=': result += "\\e"; break;
+        default: result += *iter; break;
+        }
+    }
+    return result;
+}
+
+
+/// Reverses the escaping done by escape().
+///
+/// \param str The string to unescape.
+///
+/// \return The original string.
+///
+/// \throw std::runtime_error If the input string is malformed.
+static std::string
+unescape(const std::string& str)
+{
+    std::string result;
+    for (std::string::size_type i = 0; i < str.length(); ++i) {
+        if (str[i] != '\\') {
+            result += str[i];
+            continue;
+        }
+        if (i + 1 == str.length())
+            throw std::runtime_error("Dangling escape character");
+        ++i;
+        if (str[i] == '\\')
+            result += '\\';
+        else if (str[i] == 'n')
+            result += '\n';
+        else if (str[i] == 'e')
+            result += '=';
+        else
+            throw std::runtime_error(F("Invalid escape sequence \\%s") %
+                                     str[i]);
+    }
+    return result;
+}
+
+
+/// Computes a 64-bit FNV-1a hash of a string.
+///
+/// \param data The string to hash.
+///
+/// \return The hash in hexadecimal form.
+static std::string
+hash(const std::string& data)
+{
+    return utils::fnv1a64_hex(utils::fnv1a64(data));
+}
+
+
+/// Computes the digest of the contents of a file.
+///
+/// \param file The file to digest.
+///
+/// \return A hash of the contents of the file, or a special value if the file
+/// does not exist.
+///
+/// \throw std::runtime_error If the file exists but cannot be read.
+static std::string
+file_digest(const fs::path& file)
+{
+    if (!fs::exists(file))
+        return missing_contents;
+    return hash(utils::read_file(file));
+}
+
+
+/// Computes the digest of the listing of a directory.
+///
+/// \param directory The directory to digest.
+///
+/// \return A hash of the names, types and permissions of the entries in the
+/// directory, or a special value if the directory does not exist.  The types
+/// and permissions matter because the Kyuafile may only pick the entries that
+/// are executable files, as in the case of a glob over the test programs.
+///
+/// \throw std::runtime_error If the directory exists but cannot be read.
+static std::string
+directory_digest(const fs::path& directory)
+{
+    if (!fs::exists(directory))
+        return missing_contents;
+
+    const std::set< fs::directory_entry > entries = fs::scan_directory(
+        directory);
+    std::string names;
+    for (std::set< fs::directory_entry >::const_iterator iter =
+             entries.begin(); iter != entries.end(); ++iter) {
+        const fs::path entry = directory / (*iter).name;
+        struct ::stat sb;
+        // Report dangling symbolic links by the type of the link itself.
+        if (::stat(entry.c_str(), &sb) == -1 &&
+            ::lstat(entry.c_str(), &sb) == -1)
+            sb.st_mode = 0;
+        names += (*iter).name;
+        names += '\0';
+        names += (F("%s") % static_cast< unsigned long >(sb.st_mode)).str();
+        names += '\0';
+    }
+    return hash(names);
+}
+
+
+/// Computes the path to the cache entry for a Kyuafile.
+///
+/// Entries are named after a hash of the paths to the Kyuafile and the build
+/// root.  Collisions are harmless because the entry records both paths, which
+/// are validated on lookup.
+///
+/// \param directory The directory holding the cache entries.
+/// \param kyuafile Absolute path to the top-level Kyuafile.
+/// \param build_root Absolute path to the build root.
+///
+/// \return The path to the cache entry.
+static fs::path
+entry_path(const fs::path& directory, const fs::path& kyuafile,
+           const fs::path& build_root)
+{
+    return directory / (hash(kyuafile.str() + '\0' + build_root.str()) +
+                        ".kyuafile");
+}
+
+
+/// Splits a cache entry line into its key and its value.
+///
+/// \param line The line to split.
+///
+/// \return The key and the unescaped value.
+///
+/// \throw std::runtime_error If the line is malformed.
+static std::pair< std::string, std::string >
+split_line(const std::string& line)
+{
+    const std::string::size_type pos = line.find('=');
+    if (pos == std::string::npos)
+        throw std::runtime_error(F("Invalid line '%s'") % line);
+    return std::make_pair(line.substr(0, pos), unescape(line.substr(pos + 1)));
+}
+
+
+/// Checks whether a dependency recorded in a cache entry is still valid.
+///
+/// \param value The recorded dependency, in the form "digest path".
+/// \param directory Whether the dependency is a directory or a file.
+///
+/// \return True if the digest of the path matches the recorded one.
+///
+/// \throw std::runtime_error If the dependency is malformed.
+static bool
+dependency_valid(const std::string& value, const bool directory)
+{
+    const std::string::size_type pos = value.find(' ');
+    if (pos == std::string::npos)
+        throw std::runtime_error(F("Invalid dependency '%s'") % value);
+    const fs::path path(value.substr(pos + 1));
+    const std::string digest = directory ?
+        directory_digest(path) : file_digest(path);
+    return value.substr(0, pos) == digest;
+}
+
+
+/// Reads a cache entry from disk.
+///
+/// \param input The stream from which to read the entry.
+/// \param kyuafile Absolute path to the expected top-level Kyuafile.
+/// \param build_root Absolute path to the expected build root.
+///
+/// \return The test programs in the entry, or none if the entry is stale.
+///
+/// \throw std::runtime_error If the entry is malformed.
+static optional< model::test_programs_vector >
+read_entry(std::istream& input, const fs::path& kyuafile,
+           const fs::path& build_root)
+{
+    std::string line;
+    if (!std::getline(input, line) || line != entry_magic)
+        return none;
+
+    if (!std::getline(input, line) ||
+        split_line(line) != std::make_pair(std::string("kyuafile"),
+                                           kyuafile.str()))
+        return none;
+    if (!std::getline(input, line) ||
+        split_line(line) != std::make_pair(std::string("build_root"),
+                                           build_root.str()))
+        return none;
+
+    model::test_programs_vector test_programs;
+    optional< fs::path > relative_path;
+    std::string interface, test_suite, variant;
+    config::properties_map variant_vars;
+    std::auto_ptr< model::metadata_builder > mdbuilder;
+    bool done = false;
+    while (!done && std::getline(input, line)) {
+        if (line == "end") {
+            if (!relative_path)
+                throw std::runtime_error("Unexpected end of test program");
+            if (!fs::exists(build_root / relative_path.get()))
+                return none;
+            model::test_program_builder builder(
+                interface, relative_path.get(), build_root, test_suite);
+            builder.set_metadata(mdbuilder->build());
+            if (!variant.empty())
+                builder.set_variant(variant, variant_vars);
+            test_programs.push_back(builder.build_ptr());
+            relative_path = none;
+            continue;
+        } else if (line == "eof") {
+            done = true;
+            continue;
+        }
+
+        const std::pair< std::string, std::string > field = split_line(line);
+        const std::string& key = field.first;
+        const std::string& value = field.second;
+        if (key == "file" || key == "dir") {
+            if (relative_path)
+                throw std::runtime_error("Dependency within a test program");
+            if (!dependency_valid(value, key == "dir"))
+                return none;
+        } else if (key == "test_program") {
+            if (relative_path)
+                throw std::runtime_error("Unterminated test program");
+            relative_path = fs::path(value);
+            interface.clear();
+            test_suite.clear();
+            variant.clear();
+            variant_vars.clear();
+            mdbuilder.reset(new model::metadata_builder());
+        } else if (!relative_path) {
+            throw std::runtime_error("Property outside of a test program");
+        } else if (key == "interface") {
+            interface = value;
+        } else if (key == "test_suite") {
+            test_suite = value;
+        } else if (key == "variant") {
+            variant = value;
+        } else if (key.find("var.") == 0) {
+            variant_vars[unescape(key.substr(4))] = value;
+        } else if (key.find("md.") == 0) {
+            mdbuilder->set_string(unescape(key.substr(3)), value);
+        } else {
+            throw std::runtime_error(F("Unknown key '%s'") % key);
+        }
+    }
+    if (!done || relative_path)
+        throw std::runtime_error("Truncated entry");
+    return utils::make_optional(test_programs);
+}
+
+
+/// Writes the definition of a test program to a cache entry.
+///
+/// \param output The stream into which to write the definition.
+/// \param test_program The test program to write.
+static void
+write_test_program(std::ostream& output,
+                   const model::test_program& test_program)
+{
+    output << "test_program=" << escape(test_program.relative_path().str())
+           << '\n'
+           << "interface=" << escape(test_program.interface_name()) << '\n'
+           << "test_suite=" << escape(test_program.test_suite_name()) << '\n';
+
+    if (!test_program.variant().empty()) {
+        output << "variant=" << escape(test_program.variant()) << '\n';
+        const config::properties_map& vars = test_program.variant_vars();
+        for (config::properties_map::const_iterator iter = vars.begin();
+             iter != vars.end(); ++iter) {
+            output << "var." << escape((*iter).first) << '='
+                   << escape((*iter).second) << '\n';
+        }
+    }
+
+    const model::properties_map props =
+        test_program.get_metadata().to_properties();
+    for (model::properties_map::const_iterator iter = props.begin();
+         iter != props.end(); ++iter) {
+        output << "md." << escape((*iter).first) << '='
+               << escape((*iter).second) << '\n';
+    }
+
+    output << "end\n";
+}
+
+
+}  // anonymous namespace
+
+
+/// Internal implementation for the kyuafile_cache class.
+struct engine::kyuafile_cache::impl : utils::noncopyable {
+    /// Directory holding the cache entries.
+    fs::path directory;
+
+    /// Constructor.
+    ///
+    /// \param directory_ Directory holding the cache entries.
+    impl(const fs::path& directory_) : directory(directory_)
+    {
+    }
+};
+
+
+/// Constructs a new cache handle.
+///
+/// \param directory The directory holding the cache entries.  Does not need
+///     to exist: it is created on the first store() if necessary.
+engine::kyuafile_cache::kyuafile_cache(const fs::path& directory) :
+    _pimpl(new impl(directory))
+{
+}
+
+
+/// Destructor.
+engine::kyuafile_cache::~kyuafile_cache(void)
+{
+}
+
+
+/// Looks up the cached test programs defined by a Kyuafile.
+///
+/// \param kyuafile Absolute path to the top-level Kyuafile.
+/// \param build_root Absolute path to the build root.
+///
+/// \return The definitions of the test programs, without any test cases, or
+/// none if there is no valid entry for the current state of the files that
+/// the Kyuafile depends on.
+optional< model::test_programs_vector >
+engine::kyuafile_cache::lookup(const fs::path& kyuafile,
+                               const fs::path& build_root) const
+{
+    PRE(kyuafile.is_absolute());
+    PRE(build_root.is_absolute());
+
+    const fs::path entry = entry_path(_pimpl->directory, kyuafile, build_root);
+    try {
+        std::ifstream input(entry.c_str());
+        if (!input)
+            return none;
+
+        const optional< model::test_programs_vector > test_programs =
+            read_entry(input, kyuafile, build_root);
+        if (test_programs)
+            LD(F("Kyuafile cache hit for %s") % kyuafile);
+        else
+            LD(F("Stale Kyuafile cache entry for %s") % kyuafile);
+        return test_programs;
+    } catch (const std::runtime_error& e) {
+        LW(F("Ignoring invalid Kyuafile cache entry %s: %s") % entry %
+           e.what());
+        return none;
+    }
+}
+
+
+/// Records the test programs defined by a Kyuafile.
+///
+/// The entry is first written to a temporary file and then moved into place
+/// so that concurrent readers never observe partial entries.
+///
+/// \param kyuafile Absolute path to the top-level Kyuafile.
+/// \param build_root Absolute path to the build root.
+/// \param test_programs The test programs defined by the Kyuafile.  Only their
+///     definitions are recorded, not their test cases.
+/// \param files The Kyuafiles that were evaluated to load kyuafile.
+/// \param directories The directories whose contents the Kyuafiles inspected.
+void
+engine::kyuafile_cache::store(const fs::path& kyuafile,
+                              const fs::path& build_root,
+                              const model::test_programs_vector& test_programs,
+                              const std::set< fs::path >& files,
+                              const std::set< fs::path >& directories) const
+{
+    PRE(kyuafile.is_absolute());
+    PRE(build_root.is_absolute());
+
+    const fs::path entry = entry_path(_pimpl->directory, kyuafile, build_root);
+    const fs::path temp(F("%s.%s") % entry % ::getpid());
+    try {
+        fs::mkdir_p(_pimpl->directory, 0755);
+
+        std::ofstream output(temp.c_str());
+        if (!output)
+            throw std::runtime_error(F("Cannot create %s") % temp);
+
+        output << entry_magic << '\n'
+               << "kyuafile=" << escape(kyuafile.str()) << '\n'
+               << "build_root=" << escape(build_root.str()) << '\n';
+        for (std::set< fs::path >::const_iterator iter = files.begin();
+             iter != files.end(); ++iter) {
+            output << "file=" << file_digest(*iter) << ' '
+                   << escape((*iter).str()) << '\n';
+        }
+        for (std::set< fs::path >::const_iterator iter = directories.begin();
+             iter != directories.end(); ++iter) {
+            output << "dir=" << directory_digest(*iter) << ' '
+                   << escape((*iter).str()) << '\n';
+        }
+        for (model::test_programs_vector::const_iterator iter =
+                 test_programs.begin(); iter != test_programs.end(); ++iter) {
+            write_test_program(output, **iter);
+        }
+        output << "eof\n";
+        output.close();
+        if (!output)
+            throw std::runtime_error(F("Failed to write %s") % temp);
+
+        if (std::rename(temp.c_str(), entry.c_str()) == -1) {
+            const int original_errno = errno;
+            throw fs::system_error(F("Cannot rename %s to %s") % temp % entry,
+                                   original_errno);
+        }
+        LD(F("Stored Kyuafile cache entry for %s") % kyuafile);
+    } catch (const std::runtime_error& e) {
+        LW(F("Failed to store Kyuafile cache entry for %s: %s") % kyuafile %
+           e.what());
+        ::unlink(temp.c_str());
+    }
+}
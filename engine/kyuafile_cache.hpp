@@ -0,0 +1,84 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// \file engine/kyuafile_cache.hpp
+/// Persistent cache of the test programs defined by Kyuafiles.
+///
+/// Loading a Kyuafile requires evaluating it and all the files it includes,
+/// which is costly for large test suites with thousands of Kyuafiles.  This
+/// module keeps the test program definitions resulting from previous loads on
+/// disk so that unmodified trees need not be evaluated again.
+///
+/// Cache entries are keyed by the absolute paths to the top-level Kyuafile and
+/// the build root.  Each entry records the contents of every Kyuafile that was
+/// evaluated and the listings of every directory that the Kyuafiles inspected
+/// through the fs module.  Any change to these invalidates the entry, as does
+/// the disappearance of any of the test programs.
+
+#if !defined(ENGINE_KYUAFILE_CACHE_HPP)
+#define ENGINE_KYUAFILE_CACHE_HPP
+
+#include "engine/kyuafile_cache_fwd.hpp"
+
+#include <set>
+
+#include "model/test_program_fwd.hpp"
+#include "utils/fs/path.hpp"
+#include "utils/optional_fwd.hpp"
+#include "utils/shared_ptr.hpp"
+
+namespace engine {
+
+
+/// Handle to an on-disk cache of loaded Kyuafiles.
+///
+/// All operations on the cache are best-effort: errors while reading or
+/// writing entries are logged and treated as cache misses, as the cache is
+/// only an optimization and must never cause a Kyuafile to fail to load.
+class kyuafile_cache {
+    struct impl;
+
+    /// Pointer to the shared internal implementation.
+    std::shared_ptr< impl > _pimpl;
+
+public:
+    explicit kyuafile_cache(const utils::fs::path&);
+    ~kyuafile_cache(void);
+
+    utils::optional< model::test_programs_vector > lookup(
+        const utils::fs::path&, const utils::fs::path&) const;
+    void store(const utils::fs::path&, const utils::fs::path&,
+               const model::test_programs_vector&,
+               const std::set< utils::fs::path >&,
+               const std::set< utils::fs::path >&) const;
+};
+
+
+}  // namespace engine
+
+#endif  // !defined(ENGINE_KYUAFILE_CACHE_HPP)
@@ -0,0 +1,341 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "engine/kyuafile_cache.hpp"
+
+extern "C" {
+#include <sys/stat.h>
+}
+
+#include <fstream>
+#include <set>
+#include <string>
+
+#include <atf-c++.hpp>
+
+#include "model/metadata.hpp"
+#include "model/test_program.hpp"
+#include "utils/config/tree.hpp"
+#include "utils/datetime.hpp"
+#include "utils/fs/directory.hpp"
+#include "utils/fs/operations.hpp"
+#include "utils/fs/path.hpp"
+#include "utils/optional.ipp"
+#include "utils/stream.hpp"
+
+namespace config = utils::config;
+namespace datetime = utils::datetime;
+namespace fs = utils::fs;
+
+using utils::optional;
+
+
+namespace {
+
+
+/// Collection of paths.
+typedef std::set< fs::path > paths_set;
+
+
+/// Creates a sample tree of Kyuafiles and test programs.
+///
+/// \post The current directory contains a Kyuafile that includes
+/// subdir/Kyuafile, and the test programs program1 and subdir/program2.
+static void
+create_tree(void)
+{
+    atf::utils::create_file("Kyuafile",
+                            "syntax(2)\ninclude('subdir/Kyuafile')\n");
+    atf::utils::create_file("program1", "");
+    fs::mkdir(fs::path("subdir"), 0755);
+    atf::utils::create_file("subdir/Kyuafile", "syntax(2)\n");
+    atf::utils::create_file("subdir/program2", "");
+}
+
+
+/// Gets the Kyuafiles of the tree created by create_tree().
+///
+/// \return The absolute paths to the Kyuafiles.
+static paths_set
+tree_files(void)
+{
+    paths_set files;
+    files.insert(fs::current_path() / "Kyuafile");
+    files.insert(fs::current_path() / "subdir/Kyuafile");
+    return files;
+}
+
+
+/// Gets the inspected directories of the tree created by create_tree().
+///
+/// \return The absolute paths to the directories.
+static paths_set
+tree_dirs(void)
+{
+    paths_set dirs;
+    dirs.insert(fs::current_path() / "subdir");
+    return dirs;
+}
+
+
+/// Constructs the test programs defined by the tree created by create_tree().
+///
+/// \return A collection of test program definitions with non-trivial metadata
+/// and variants.
+static model::test_programs_vector
+tree_test_programs(void)
+{
+    config::properties_map vars;
+    vars["var1"] = "value=1";
+    vars["var\n2"] = "value\\2";
+
+    model::test_programs_vector test_programs;
+    test_programs.push_back(
+        model::test_program_builder(
+            "mock", fs::path("program1"), fs::current_path(), "suite-a")
+        .set_metadata(model::metadata_builder()
+                      .set_description("Multi-line\ndescription")
+                      .set_timeout(datetime::delta(15, 0))
+                      .add_custom("foo", "bar = baz")
+                      .build())
+        .build_ptr());
+    test_programs.push_back(
+        model::test_program_builder(
+            "mock", fs::path("subdir/program2"), fs::current_path(), "suite-b")
+        .set_variant("first", vars)
+        .build_ptr());
+    test_programs.push_back(
+        model::test_program_builder(
+            "mock", fs::path("subdir/program2"), fs::current_path(), "suite-b")
+        .set_variant("second", config::properties_map())
+        .build_ptr());
+    return test_programs;
+}
+
+
+/// Stores the tree created by create_tree() in a cache.
+///
+/// \param cache The cache in which to store the tree.
+static void
+store_tree(const engine::kyuafile_cache& cache)
+{
+    cache.store(fs::current_path() / "Kyuafile", fs::current_path(),
+                tree_test_programs(), tree_files(), tree_dirs());
+}
+
+
+/// Looks up the tree created by create_tree() in a cache.
+///
+/// \param cache The cache in which to look up the tree.
+///
+/// \return The result of the lookup.
+static optional< model::test_programs_vector >
+lookup_tree(const engine::kyuafile_cache& cache)
+{
+    return cache.lookup(fs::current_path() / "Kyuafile", fs::current_path());
+}
+
+
+}  // anonymous namespace
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(lookup__missing);
+ATF_TEST_CASE_BODY(lookup__missing)
+{
+    create_tree();
+    const engine::kyuafile_cache cache(fs::path("cache"));
+    ATF_REQUIRE(!lookup_tree(cache));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(store_and_lookup);
+ATF_TEST_CASE_BODY(store_and_lookup)
+{
+    create_tree();
+    const engine::kyuafile_cache cache(fs::path("cache/sub"));
+    store_tree(cache);
+    ATF_REQUIRE(fs::exists(fs::path("cache/sub")));
+
+    const optional< model::test_programs_vector > test_programs =
+        lookup_tree(cache);
+    ATF_REQUIRE(test_programs);
+
+    const model::test_programs_vector exp_test_programs = tree_test_programs();
+    ATF_REQUIRE_EQ(exp_test_programs.size(), test_programs.get().size());
+    for (model::test_programs_vector::size_type i = 0;
+         i < exp_test_programs.size(); ++i) {
+        ATF_REQUIRE_EQ(*exp_test_programs[i], *test_programs.get()[i]);
+    }
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(lookup__kyuafile_changed);
+ATF_TEST_CASE_BODY(lookup__kyuafile_changed)
+{
+    create_tree();
+    const engine::kyuafile_cache cache(fs::path("cache"));
+    store_tree(cache);
+    ATF_REQUIRE(lookup_tree(cache));
+
+    atf::utils::create_file("subdir/Kyuafile", "syntax(2)\n-- Changed\n");
+    ATF_REQUIRE(!lookup_tree(cache));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(lookup__kyuafile_removed);
+ATF_TEST_CASE_BODY(lookup__kyuafile_removed)
+{
+    create_tree();
+    const engine::kyuafile_cache cache(fs::path("cache"));
+    store_tree(cache);
+    ATF_REQUIRE(lookup_tree(cache));
+
+    fs::unlink(fs::path("subdir/Kyuafile"));
+    ATF_REQUIRE(!lookup_tree(cache));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(lookup__directory_changed);
+ATF_TEST_CASE_BODY(lookup__directory_changed)
+{
+    create_tree();
+    const engine::kyuafile_cache cache(fs::path("cache"));
+    store_tree(cache);
+    ATF_REQUIRE(lookup_tree(cache));
+
+    // Changes to the contents of files in an inspected directory are
+    // irrelevant; only the names of the entries matter.
+    atf::utils::create_file("subdir/program2", "modified");
+    ATF_REQUIRE(lookup_tree(cache));
+
+    fs::mkdir(fs::path("subdir/other"), 0755);
+    ATF_REQUIRE(!lookup_tree(cache));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(lookup__directory_mode_changed);
+ATF_TEST_CASE_BODY(lookup__directory_mode_changed)
+{
+    create_tree();
+    const engine::kyuafile_cache cache(fs::path("cache"));
+    store_tree(cache);
+    ATF_REQUIRE(lookup_tree(cache));
+
+    // Whether an entry is executable decides whether it can be a test
+    // program, so its permissions are part of the listing.
+    ATF_REQUIRE(::chmod("subdir/program2", 0755) != -1);
+    ATF_REQUIRE(!lookup_tree(cache));
+    store_tree(cache);
+    ATF_REQUIRE(lookup_tree(cache));
+
+    // The same goes for its type.
+    fs::unlink(fs::path("subdir/program2"));
+    fs::mkdir(fs::path("subdir/program2"), 0755);
+    ATF_REQUIRE(!lookup_tree(cache));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(lookup__directory_appears);
+ATF_TEST_CASE_BODY(lookup__directory_appears)
+{
+    create_tree();
+    const engine::kyuafile_cache cache(fs::path("cache"));
+    paths_set dirs = tree_dirs();
+    dirs.insert(fs::current_path() / "missing");
+    cache.store(fs::current_path() / "Kyuafile", fs::current_path(),
+                tree_test_programs(), tree_files(), dirs);
+    ATF_REQUIRE(lookup_tree(cache));
+
+    fs::mkdir(fs::path("missing"), 0755);
+    ATF_REQUIRE(!lookup_tree(cache));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(lookup__test_program_removed);
+ATF_TEST_CASE_BODY(lookup__test_program_removed)
+{
+    create_tree();
+    const engine::kyuafile_cache cache(fs::path("cache"));
+    store_tree(cache);
+    ATF_REQUIRE(lookup_tree(cache));
+
+    fs::unlink(fs::path("program1"));
+    ATF_REQUIRE(!lookup_tree(cache));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(lookup__other_build_root);
+ATF_TEST_CASE_BODY(lookup__other_build_root)
+{
+    create_tree();
+    const engine::kyuafile_cache cache(fs::path("cache"));
+    store_tree(cache);
+
+    ATF_REQUIRE(!cache.lookup(fs::current_path() / "Kyuafile",
+                              fs::current_path() / "subdir"));
+    ATF_REQUIRE(!cache.lookup(fs::current_path() / "subdir/Kyuafile",
+                              fs::current_path()));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(lookup__corrupt);
+ATF_TEST_CASE_BODY(lookup__corrupt)
+{
+    create_tree();
+    const engine::kyuafile_cache cache(fs::path("cache"));
+    store_tree(cache);
+
+    const std::set< fs::directory_entry > files = fs::scan_directory(
+        fs::path("cache"));
+    for (std::set< fs::directory_entry >::const_iterator iter = files.begin();
+         iter != files.end(); ++iter) {
+        if ((*iter).name == "." || (*iter).name == "..")
+            continue;
+        const fs::path entry = fs::path("cache") / (*iter).name;
+        const std::string contents = utils::read_file(entry);
+        std::ofstream output(entry.c_str());
+        output << contents.substr(0, contents.length() - 10);
+    }
+
+    ATF_REQUIRE(!lookup_tree(cache));
+}
+
+
+ATF_INIT_TEST_CASES(tcs)
+{
+    ATF_ADD_TEST_CASE(tcs, lookup__missing);
+    ATF_ADD_TEST_CASE(tcs, store_and_lookup);
+    ATF_ADD_TEST_CASE(tcs, lookup__kyuafile_changed);
+    ATF_ADD_TEST_CASE(tcs, lookup__kyuafile_removed);
+    ATF_ADD_TEST_CASE(tcs, lookup__directory_changed);
+    ATF_ADD_TEST_CASE(tcs, lookup__directory_mode_changed);
+    ATF_ADD_TEST_CASE(tcs, lookup__directory_appears);
+    ATF_ADD_TEST_CASE(tcs, lookup__test_program_removed);
+    ATF_ADD_TEST_CASE(tcs, lookup__other_build_root);
+    ATF_ADD_TEST_CASE(tcs, lookup__corrupt);
+}
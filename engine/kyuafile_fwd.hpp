@@ -32,10 +32,17 @@
 #if !defined(ENGINE_KYUAFILE_FWD_HPP)
 #define ENGINE_KYUAFILE_FWD_HPP
 
+#include <vector>
+
 namespace engine {
 
 
 class kyuafile;
+struct kyuafile_stats;
+
+
+/// Costs of the evaluation of Kyuafiles, in evaluation order.
+typedef std::vector< kyuafile_stats > kyuafile_profile;
 
 
 }  // namespace engine
@@ -42,6 +42,7 @@ extern "C" {
 
 #include "engine/atf.hpp"
 #include "engine/exceptions.hpp"
+#include "engine/kyuafile_cache.hpp"
 #include "engine/plain.hpp"
 #include "engine/scheduler.hpp"
 #include "engine/tap.hpp"
@@ -239,6 +240,53 @@ ATF_TEST_CASE_BODY(kyuafile__load__metadata)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(kyuafile__load__variants);
+ATF_TEST_CASE_BODY(kyuafile__load__variants)
+{
+    scheduler::scheduler_handle handle = scheduler::setup();
+
+    atf::utils::create_file(
+        "config",
+        "syntax(2)\n"
+        "test_suite('the-suite')\n"
+        "atf_test_program{name='1st', timeout=15,"
+        " variants={fast={mode='fast'}, slow={mode='slow', level=3}}}\n");
+    atf::utils::create_file("1st", "");
+
+    const engine::kyuafile suite = engine::kyuafile::load(
+        fs::path("config"), none, config::tree(), handle);
+    ATF_REQUIRE_EQ(2, suite.test_programs().size());
+
+    const model::metadata md = model::metadata_builder()
+        .set_timeout(datetime::delta(15, 0))
+        .build();
+
+    const model::test_program_ptr fast = suite.test_programs()[0];
+    ATF_REQUIRE_EQ(fs::path("1st"), fast->relative_path());
+    ATF_REQUIRE_EQ(md, fast->get_metadata());
+    ATF_REQUIRE_EQ("fast", fast->variant());
+    config::properties_map fast_vars;
+    fast_vars["mode"] = "fast";
+    ATF_REQUIRE(fast_vars == fast->variant_vars());
+
+    const model::test_program_ptr slow = suite.test_programs()[1];
+    ATF_REQUIRE_EQ(fs::path("1st"), slow->relative_path());
+    ATF_REQUIRE_EQ(md, slow->get_metadata());
+    ATF_REQUIRE_EQ("slow", slow->variant());
+    config::properties_map slow_vars;
+    slow_vars["level"] = "3";
+    slow_vars["mode"] = "slow";
+    ATF_REQUIRE(slow_vars == slow->variant_vars());
+
+    ATF_REQUIRE(dynamic_cast< const scheduler::lazy_test_program& >(*fast)
+                .shares_test_cases_with(
+                    dynamic_cast< const scheduler::lazy_test_program& >(
+                        *slow)));
+
+    handle.cleanup();
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(kyuafile__load__current_directory);
 ATF_TEST_CASE_BODY(kyuafile__load__current_directory)
 {
@@ -442,6 +490,150 @@ ATF_TEST_CASE_BODY(kyuafile__load__fs_calls_are_relative)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(kyuafile__load__cache__hit);
+ATF_TEST_CASE_BODY(kyuafile__load__cache__hit)
+{
+    scheduler::scheduler_handle handle = scheduler::setup();
+
+    atf::utils::create_file(
+        "Kyuafile",
+        "syntax(2)\n"
+        "test_suite('the-suite')\n"
+        "plain_test_program{name='one', timeout=15}\n"
+        "include('dir/Kyuafile')\n");
+    atf::utils::create_file("one", "");
+    fs::mkdir(fs::path("dir"), 0755);
+    atf::utils::create_file(
+        "dir/Kyuafile",
+        "syntax(2)\n"
+        "atf_test_program{name='two', test_suite='other',"
+        " variants={fast={mode='fast'}, slow={mode='slow'}}}\n");
+    atf::utils::create_file("dir/two", "");
+
+    const engine::kyuafile_cache cache(fs::path("cache"));
+    const engine::kyuafile suite1 = engine::kyuafile::load(
+        fs::path("Kyuafile"), none, config::tree(), handle, cache);
+    ATF_REQUIRE(cache.lookup(fs::current_path() / "Kyuafile",
+                             fs::current_path()));
+    const engine::kyuafile suite2 = engine::kyuafile::load(
+        fs::path("Kyuafile"), none, config::tree(), handle, cache);
+
+    ATF_REQUIRE_EQ(suite1.source_root(), suite2.source_root());
+    ATF_REQUIRE_EQ(suite1.build_root(), suite2.build_root());
+    ATF_REQUIRE_EQ(3, suite2.test_programs().size());
+    for (model::test_programs_vector::size_type i = 0; i < 3; ++i) {
+        const model::test_program& tp1 = *suite1.test_programs()[i];
+        const model::test_program& tp2 = *suite2.test_programs()[i];
+        ATF_REQUIRE_EQ(tp1.interface_name(), tp2.interface_name());
+        ATF_REQUIRE_EQ(tp1.absolute_path(), tp2.absolute_path());
+        ATF_REQUIRE_EQ(tp1.test_suite_name(), tp2.test_suite_name());
+        ATF_REQUIRE_EQ(tp1.get_metadata(), tp2.get_metadata());
+        ATF_REQUIRE_EQ(tp1.variant(), tp2.variant());
+        ATF_REQUIRE(tp1.variant_vars() == tp2.variant_vars());
+    }
+
+    ATF_REQUIRE(dynamic_cast< const scheduler::lazy_test_program& >(
+                    *suite2.test_programs()[1])
+                .shares_test_cases_with(
+                    dynamic_cast< const scheduler::lazy_test_program& >(
+                        *suite2.test_programs()[2])));
+
+    handle.cleanup();
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(kyuafile__load__profile);
+ATF_TEST_CASE_BODY(kyuafile__load__profile)
+{
+    scheduler::scheduler_handle handle = scheduler::setup();
+
+    atf::utils::create_file(
+        "Kyuafile",
+        "syntax(2)\n"
+        "test_suite('the-suite')\n"
+        "plain_test_program{name='one'}\n"
+        "if fs.exists('dir/Kyuafile') then include('dir/Kyuafile') end\n");
+    atf::utils::create_file("one", "");
+    fs::mkdir(fs::path("dir"), 0755);
+    atf::utils::create_file(
+        "dir/Kyuafile",
+        "syntax(2)\n"
+        "plain_test_program{name='two'}\n"
+        "plain_test_program{name='three'}\n");
+    atf::utils::create_file("dir/two", "");
+    atf::utils::create_file("dir/three", "");
+
+    const engine::kyuafile_cache cache(fs::path("cache"));
+    engine::kyuafile_profile profile;
+    for (int i = 0; i < 2; ++i) {
+        profile.clear();
+        const engine::kyuafile suite = engine::kyuafile::load(
+            fs::path("Kyuafile"), none, config::tree(), handle, cache,
+            &profile);
+        ATF_REQUIRE_EQ(3, suite.test_programs().size());
+    }
+
+    ATF_REQUIRE_EQ(2, profile.size());
+    ATF_REQUIRE_EQ(fs::path("Kyuafile"), profile[0].file);
+    ATF_REQUIRE_EQ(1, profile[0].fs_operations);
+    ATF_REQUIRE_EQ(1, profile[0].test_programs);
+    ATF_REQUIRE(profile[0].self_duration <= profile[0].duration);
+    ATF_REQUIRE_EQ(fs::path("dir/Kyuafile"), profile[1].file);
+    ATF_REQUIRE_EQ(0, profile[1].fs_operations);
+    ATF_REQUIRE_EQ(2, profile[1].test_programs);
+    ATF_REQUIRE(profile[1].duration <= profile[0].duration);
+
+    handle.cleanup();
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(kyuafile__load__cache__invalidated);
+ATF_TEST_CASE_BODY(kyuafile__load__cache__invalidated)
+{
+    scheduler::scheduler_handle handle = scheduler::setup();
+
+    atf::utils::create_file(
+        "Kyuafile",
+        "syntax(2)\n"
+        "test_suite('the-suite')\n"
+        "for file in fs.files('dir') do\n"
+        "    local kyuafile = fs.join('dir', fs.join(file, 'Kyuafile'))\n"
+        "    if file ~= '.' and file ~= '..' and fs.exists(kyuafile) then\n"
+        "        include(kyuafile)\n"
+        "    end\n"
+        "end\n");
+    fs::mkdir(fs::path("dir"), 0755);
+    fs::mkdir(fs::path("dir/one"), 0755);
+    fs::mkdir(fs::path("dir/two"), 0755);
+    atf::utils::create_file(
+        "dir/one/Kyuafile",
+        "syntax(2)\n"
+        "plain_test_program{name='program', test_suite='the-suite'}\n");
+    atf::utils::create_file("dir/one/program", "");
+    atf::utils::create_file("dir/two/program", "");
+
+    const engine::kyuafile_cache cache(fs::path("cache"));
+    ATF_REQUIRE_EQ(1, engine::kyuafile::load(
+        fs::path("Kyuafile"), none, config::tree(), handle, cache)
+                   .test_programs().size());
+
+    atf::utils::create_file(
+        "dir/two/Kyuafile",
+        "syntax(2)\n"
+        "plain_test_program{name='program', test_suite='the-suite'}\n");
+    ATF_REQUIRE_EQ(2, engine::kyuafile::load(
+        fs::path("Kyuafile"), none, config::tree(), handle, cache)
+                   .test_programs().size());
+
+    atf::utils::create_file("dir/one/Kyuafile", "syntax(2)\n");
+    ATF_REQUIRE_EQ(1, engine::kyuafile::load(
+        fs::path("Kyuafile"), none, config::tree(), handle, cache)
+                   .test_programs().size());
+
+    handle.cleanup();
+}
+
+
 /// Verifies that load raises a load_error on a given input.
 ///
 /// \param file Name of the file to load.
@@ -472,6 +664,34 @@ ATF_TEST_CASE_BODY(kyuafile__load__test_program_not_basename)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(kyuafile__load__variants__invalid);
+ATF_TEST_CASE_BODY(kyuafile__load__variants__invalid)
+{
+    atf::utils::create_file("one", "");
+
+    atf::utils::create_file(
+        "config",
+        "syntax(2)\n"
+        "test_suite('abc')\n"
+        "atf_test_program{name='one', variants='fast'}\n");
+    do_load_error_test("config", "variants property.*must be a table");
+
+    atf::utils::create_file(
+        "config",
+        "syntax(2)\n"
+        "test_suite('abc')\n"
+        "atf_test_program{name='one', variants={}}\n");
+    do_load_error_test("config", "at least one variant");
+
+    atf::utils::create_file(
+        "config",
+        "syntax(2)\n"
+        "test_suite('abc')\n"
+        "atf_test_program{name='one', variants={{mode='fast'}}}\n");
+    do_load_error_test("config", "tables keyed by their names");
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(kyuafile__load__lua_error);
 ATF_TEST_CASE_BODY(kyuafile__load__lua_error)
 {
@@ -588,12 +808,17 @@ ATF_INIT_TEST_CASES(tcs)
     ATF_ADD_TEST_CASE(tcs, kyuafile__load__real_interfaces);
     ATF_ADD_TEST_CASE(tcs, kyuafile__load__mock_interfaces);
     ATF_ADD_TEST_CASE(tcs, kyuafile__load__metadata);
+    ATF_ADD_TEST_CASE(tcs, kyuafile__load__variants);
     ATF_ADD_TEST_CASE(tcs, kyuafile__load__current_directory);
     ATF_ADD_TEST_CASE(tcs, kyuafile__load__other_directory);
     ATF_ADD_TEST_CASE(tcs, kyuafile__load__build_directory);
     ATF_ADD_TEST_CASE(tcs, kyuafile__load__absolute_paths_are_stable);
     ATF_ADD_TEST_CASE(tcs, kyuafile__load__fs_calls_are_relative);
+    ATF_ADD_TEST_CASE(tcs, kyuafile__load__cache__hit);
+    ATF_ADD_TEST_CASE(tcs, kyuafile__load__cache__invalidated);
+    ATF_ADD_TEST_CASE(tcs, kyuafile__load__profile);
     ATF_ADD_TEST_CASE(tcs, kyuafile__load__test_program_not_basename);
+    ATF_ADD_TEST_CASE(tcs, kyuafile__load__variants__invalid);
     ATF_ADD_TEST_CASE(tcs, kyuafile__load__lua_error);
     ATF_ADD_TEST_CASE(tcs, kyuafile__load__syntax__not_called);
     ATF_ADD_TEST_CASE(tcs, kyuafile__load__syntax__deprecated_format);
@@ -0,0 +1,405 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "engine/list_cache.hpp"
+
+extern "C" {
+#include <sys/stat.h>
+
+#include <stdint.h>
+#include <unistd.h>
+}
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#include "model/exceptions.hpp"
+#include "model/metadata.hpp"
+#include "model/test_case.hpp"
+#include "model/test_program.hpp"
+#include "model/types.hpp"
+#include "utils/datetime.hpp"
+#include "utils/fnv.hpp"
+#include "utils/format/macros.hpp"
+#include "utils/fs/exceptions.hpp"
+#include "utils/fs/operations.hpp"
+#include "utils/fs/path.hpp"
+#include "utils/logging/macros.hpp"
+#include "utils/optional.ipp"
+#include "utils/noncopyable.hpp"
+#include "utils/sanity.hpp"
+#include "utils/text/operations.ipp"
+
+namespace config = utils::config;
+namespace datetime = utils::datetime;
+namespace fs = utils::fs;
+namespace text = utils::text;
+
+using utils::none;
+using utils::optional;
+
+
+namespace {
+
+
+/// Header of the cache entry files; bump on format changes.
+static const char* entry_magic = "Kyua list cache v3";
+
+
+/// Escapes a string so that it can be stored in a single line.
+///
+/// \param str The string to escape.
+///
+/// \return The escaped string.
+static std::string
+escape(const std::string& str)
+{
+    return text::replace_all(text::replace_all(str, "\\", "\\\\"),
+                             "\n", "\\n");
+}
+
+
+/// Reverses the escaping done by escape().
+///
+/// \param str The string to unescape.
+///
+/// \return The original string.
+///
+/// \throw std::runtime_error If the input string is malformed.
+static std::string
+unescape(const std::string& str)
+{
+    std::string result;
+    for (std::string::size_type i = 0; i < str.length(); ++i) {
+        if (str[i] != '\\') {
+            result += str[i];
+            continue;
+        }
+        if (i + 1 == str.length())
+            throw std::runtime_error("Dangling escape character");
+        ++i;
+        if (str[i] == '\\')
+            result += '\\';
+        else if (str[i] == 'n')
+            result += '\n';
+        else
+            throw std::runtime_error(F("Invalid escape sequence \\%s") %
+                                     str[i]);
+    }
+    return result;
+}
+
+
+/// Computes a digest of the configuration variables of a test suite.
+///
+/// \param vars The configuration variables to digest.
+///
+/// \return A textual representation of the digest.
+static std::string
+vars_digest(const config::properties_map& vars)
+{
+    uint64_t hash = utils::fnv1a64_basis;
+    for (config::properties_map::const_iterator iter = vars.begin();
+         iter != vars.end(); ++iter) {
+        // Include the terminating NUL characters to delimit the strings.
+        hash = utils::fnv1a64_update(hash, (*iter).first.c_str(),
+                                     (*iter).first.length() + 1);
+        hash = utils::fnv1a64_update(hash, (*iter).second.c_str(),
+                                     (*iter).second.length() + 1);
+    }
+    return F("%s-%s") % utils::fnv1a64_hex(hash) % vars.size();
+}
+
+
+/// Computes the identity of a test program binary.
+///
+/// \param test_program The test program to query.
+/// \param vars The configuration variables passed to the test program when
+///     listing it.
+///
+/// \return A textual representation of the identity of the binary, suitable to
+/// be compared for equality against the identity of a previous cache entry.
+///
+/// \throw fs::system_error If the binary cannot be stat'ed.
+static std::string
+binary_identity(const model::test_program& test_program,
+                const config::properties_map& vars)
+{
+    const fs::path program = test_program.absolute_path();
+
+    struct ::stat sb;
+    if (::stat(program.c_str(), &sb) == -1) {
+        const int original_errno = errno;
+        throw fs::system_error(F("Cannot get information of %s") % program,
+                               original_errno);
+    }
+
+    std::ostringstream output;
+    output << "path=" << escape(program.str()) << '\n'
+           << "interface=" << escape(test_program.interface_name()) << '\n'
+           << "device=" << sb.st_dev << '\n'
+           << "inode=" << sb.st_ino << '\n'
+           << "size=" << sb.st_size << '\n'
+           << "mtime=" << fs::format_mtime(sb) << '\n'
+           << "vars=" << vars_digest(vars) << '\n';
+    return output.str();
+}
+
+
+/// Number of lines emitted by binary_identity().
+static const int identity_lines = 7;
+
+
+/// Computes the path to the cache entry for a test program.
+///
+/// Entries are named after a hash of the path and the interface of the test
+/// program.  Collisions are harmless because the entry records the full
+/// identity of the binary, which is validated on lookup.
+///
+/// \param directory The directory holding the cache entries.
+/// \param test_program The test program to compute the entry for.
+///
+/// \return The path to the cache entry.
+static fs::path
+entry_path(const fs::path& directory, const model::test_program& test_program)
+{
+    const std::string key = test_program.absolute_path().str() + '\0' +
+        test_program.interface_name();
+    return directory / (utils::fnv1a64_hex(utils::fnv1a64(key)) + ".list");
+}
+
+
+/// Reads a cache entry from disk.
+///
+/// \param input The stream from which to read the entry.
+/// \param identity The expected identity of the test program binary.
+/// \param [out] duration Receives the time the listing took, if recorded.
+///
+/// \return The test cases in the entry, or none if the entry is stale.
+///
+/// \throw std::runtime_error If the entry is malformed.
+static optional< model::test_cases_map >
+read_entry(std::istream& input, const std::string& identity,
+           optional< datetime::delta >& duration)
+{
+    std::string line;
+    if (!std::getline(input, line) || line != entry_magic)
+        return none;
+
+    std::string stored_identity;
+    for (int i = 0; i < identity_lines; ++i) {
+        if (!std::getline(input, line))
+            throw std::runtime_error("Truncated entry");
+        stored_identity += line + '\n';
+    }
+    if (stored_identity != identity)
+        return none;
+
+    model::test_cases_map test_cases;
+    optional< std::string > name;
+    std::auto_ptr< model::metadata_builder > mdbuilder;
+    bool done = false;
+    while (!done && std::getline(input, line)) {
+        if (line.find("test_case=") == 0) {
+            if (name)
+                throw std::runtime_error("Unterminated test case");
+            name = unescape(line.substr(std::strlen("test_case=")));
+            mdbuilder.reset(new model::metadata_builder());
+        } else if (line == "end") {
+            if (!name)
+                throw std::runtime_error("Unexpected end of test case");
+            test_cases.insert(model::test_cases_map::value_type(
+                name.get(), model::test_case(name.get(), mdbuilder->build())));
+            name = none;
+        } else if (line == "eof") {
+            done = true;
+        } else if (!name && line.find("duration=") == 0) {
+            duration = datetime::delta::from_microseconds(
+                text::to_type< int64_t >(line.substr(
+                    std::strlen("duration="))));
+        } else {
+            if (!name)
+                throw std::runtime_error("Property outside of a test case");
+            const std::string::size_type pos = line.find('=');
+            if (pos == std::string::npos)
+                throw std::runtime_error(F("Invalid property line '%s'") %
+                                         line);
+            mdbuilder->set_string(line.substr(0, pos),
+                                  unescape(line.substr(pos + 1)));
+        }
+    }
+    if (!done || name)
+        throw std::runtime_error("Truncated entry");
+    if (test_cases.empty())
+        throw std::runtime_error("Empty test cases list");
+    return utils::make_optional(test_cases);
+}
+
+
+}  // anonymous namespace
+
+
+/// Internal implementation for the list_cache class.
+struct engine::list_cache::impl : utils::noncopyable {
+    /// Directory holding the cache entries.
+    fs::path directory;
+
+    /// Constructor.
+    ///
+    /// \param directory_ Directory holding the cache entries.
+    impl(const fs::path& directory_) : directory(directory_)
+    {
+    }
+};
+
+
+/// Constructs a new cache handle.
+///
+/// \param directory The directory holding the cache entries.  Does not need
+///     to exist: it is created on the first store() if necessary.
+engine::list_cache::list_cache(const fs::path& directory) :
+    _pimpl(new impl(directory))
+{
+}
+
+
+/// Destructor.
+engine::list_cache::~list_cache(void)
+{
+}
+
+
+/// Looks up the cached list of test cases of a test program.
+///
+/// \param test_program The test program to look up.
+/// \param vars The configuration variables that would be passed to the test
+///     program to list it.
+/// \param [out] duration If not NULL, receives the time that the listing
+///     stored in the entry took, or none if it was not recorded.
+///
+/// \return The cached list of test cases, or none if there is no valid entry
+/// for the current version of the test program binary and variables.
+optional< model::test_cases_map >
+engine::list_cache::lookup(const model::test_program& test_program,
+                           const config::properties_map& vars,
+                           optional< datetime::delta >* duration) const
+{
+    const fs::path entry = entry_path(_pimpl->directory, test_program);
+    try {
+        std::ifstream input(entry.c_str());
+        if (!input)
+            return none;
+
+        optional< datetime::delta > stored_duration;
+        const optional< model::test_cases_map > test_cases = read_entry(
+            input, binary_identity(test_program, vars), stored_duration);
+        if (test_cases && duration != NULL)
+            *duration = stored_duration;
+        if (test_cases)
+            LD(F("List cache hit for %s") % test_program.absolute_path());
+        else
+            LD(F("Stale list cache entry for %s") %
+               test_program.absolute_path());
+        return test_cases;
+    } catch (const std::runtime_error& e) {
+        LW(F("Ignoring invalid list cache entry %s: %s") % entry % e.what());
+        return none;
+    }
+}
+
+
+/// Records the list of test cases of a test program.
+///
+/// The entry is first written to a temporary file and then moved into place
+/// so that concurrent readers never observe partial entries.
+///
+/// \param test_program The test program whose test cases to record.
+/// \param vars The configuration variables passed to the test program to
+///     list it.
+/// \param test_cases The test cases returned by the listing of the program.
+///     Must be the raw result of the interface's parse_list(), before any
+///     test program metadata defaults are applied.
+/// \param duration The time that the listing took, if known.
+void
+engine::list_cache::store(const model::test_program& test_program,
+                          const config::properties_map& vars,
+                          const model::test_cases_map& test_cases,
+                          const optional< datetime::delta >& duration) const
+{
+    PRE(!test_cases.empty());
+
+    const fs::path entry = entry_path(_pimpl->directory, test_program);
+    const fs::path temp(F("%s.%s") % entry % ::getpid());
+    try {
+        const std::string identity = binary_identity(test_program, vars);
+
+        fs::mkdir_p(_pimpl->directory, 0755);
+
+        std::ofstream output(temp.c_str());
+        if (!output)
+            throw std::runtime_error(F("Cannot create %s") % temp);
+
+        output << entry_magic << '\n' << identity;
+        if (duration)
+            output << "duration=" << duration.get().to_microseconds() << '\n';
+        for (model::test_cases_map::const_iterator iter = test_cases.begin();
+             iter != test_cases.end(); ++iter) {
+            const model::test_case& test_case = (*iter).second;
+            output << "test_case=" << escape(test_case.name()) << '\n';
+            const model::properties_map props =
+                test_case.get_raw_metadata().to_properties();
+            for (model::properties_map::const_iterator iter2 = props.begin();
+                 iter2 != props.end(); ++iter2) {
+                output << (*iter2).first << '=' << escape((*iter2).second)
+                       << '\n';
+            }
+            output << "end\n";
+        }
+        output << "eof\n";
+        output.close();
+        if (!output)
+            throw std::runtime_error(F("Failed to write %s") % temp);
+
+        if (std::rename(temp.c_str(), entry.c_str()) == -1) {
+            const int original_errno = errno;
+            throw fs::system_error(F("Cannot rename %s to %s") % temp % entry,
+                                   original_errno);
+        }
+        LD(F("Stored list cache entry for %s") % test_program.absolute_path());
+    } catch (const std::runtime_error& e) {
+        LW(F("Failed to store list cache entry for %s: %s") %
+           test_program.absolute_path() % e.what());
+        ::unlink(temp.c_str());
+    }
+}
@@ -0,0 +1,87 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// \file engine/list_cache.hpp
+/// Persistent cache of the test cases listed by test programs.
+///
+/// Listing the test cases of a test program requires executing the program,
+/// which is costly when done for every test program of a large test suite on
+/// every run.  This module keeps the results of previous listings on disk so
+/// that unmodified binaries need not be executed again.
+///
+/// Cache entries are keyed by the identity of the test program binary: its
+/// absolute path, its interface, and the device, inode, size and modification
+/// time of the file.  The configuration variables of the test suite, which are
+/// passed to the program when listing it, are part of the key too.  Any change
+/// to these invalidates the entry.
+
+#if !defined(ENGINE_LIST_CACHE_HPP)
+#define ENGINE_LIST_CACHE_HPP
+
+#include "engine/list_cache_fwd.hpp"
+
+#include "model/test_case_fwd.hpp"
+#include "model/test_program_fwd.hpp"
+#include "utils/config/tree_fwd.hpp"
+#include "utils/datetime_fwd.hpp"
+#include "utils/fs/path_fwd.hpp"
+#include "utils/optional.hpp"
+#include "utils/shared_ptr.hpp"
+
+namespace engine {
+
+
+/// Handle to an on-disk cache of test case listings.
+///
+/// All operations on the cache are best-effort: errors while reading or
+/// writing entries are logged and treated as cache misses, as the cache is
+/// only an optimization and must never cause a test run to fail.
+class list_cache {
+    struct impl;
+
+    /// Pointer to the shared internal implementation.
+    std::shared_ptr< impl > _pimpl;
+
+public:
+    explicit list_cache(const utils::fs::path&);
+    ~list_cache(void);
+
+    utils::optional< model::test_cases_map > lookup(
+        const model::test_program&, const utils::config::properties_map&,
+        utils::optional< utils::datetime::delta >* = NULL) const;
+    void store(const model::test_program&,
+               const utils::config::properties_map&,
+               const model::test_cases_map&,
+               const utils::optional< utils::datetime::delta >& =
+                   utils::none) const;
+};
+
+
+}  // namespace engine
+
+#endif  // !defined(ENGINE_LIST_CACHE_HPP)
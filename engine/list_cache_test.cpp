@@ -0,0 +1,280 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "engine/list_cache.hpp"
+
+#if defined(HAVE_CONFIG_H)
+#   include "config.h"
+#endif
+
+extern "C" {
+#include <sys/stat.h>
+#include <sys/time.h>
+}
+
+#include <fstream>
+#include <set>
+#include <string>
+
+#include <atf-c++.hpp>
+
+#include "model/metadata.hpp"
+#include "model/test_case.hpp"
+#include "model/test_program.hpp"
+#include "utils/config/tree_fwd.hpp"
+#include "utils/datetime.hpp"
+#include "utils/fs/directory.hpp"
+#include "utils/fs/operations.hpp"
+#include "utils/fs/path.hpp"
+#include "utils/optional.ipp"
+#include "utils/stream.hpp"
+
+namespace config = utils::config;
+namespace datetime = utils::datetime;
+namespace fs = utils::fs;
+
+using utils::optional;
+
+
+namespace {
+
+
+/// Configuration variables of a test suite that defines none.
+static const config::properties_map no_vars;
+
+
+/// Creates a test program backed by a file in the current directory.
+///
+/// \param interface Name of the interface of the test program.
+/// \param contents Contents of the fake binary.
+///
+/// \return The new test program, without any test cases.
+static model::test_program
+new_program(const char* interface, const char* contents)
+{
+    atf::utils::create_file("program", contents);
+    return model::test_program(interface, fs::path("program"),
+                               fs::current_path(), "the-suite",
+                               model::metadata_builder().build(),
+                               model::test_cases_map());
+}
+
+
+/// Constructs a sample list of test cases.
+///
+/// \return A list of test cases with non-trivial metadata.
+static model::test_cases_map
+sample_test_cases(void)
+{
+    model::test_cases_map test_cases;
+    test_cases.insert(model::test_cases_map::value_type(
+        "first", model::test_case("first",
+                                  model::metadata_builder().build())));
+    test_cases.insert(model::test_cases_map::value_type(
+        "second", model::test_case(
+            "second",
+            model::metadata_builder()
+            .set_description("Multi-line\ndescription with \\ escapes")
+            .set_has_cleanup(true)
+            .set_timeout(datetime::delta(15, 0))
+            .add_required_file(fs::path("/some/file"))
+            .add_custom("foo", "bar baz")
+            .build())));
+    return test_cases;
+}
+
+
+}  // anonymous namespace
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(lookup__missing);
+ATF_TEST_CASE_BODY(lookup__missing)
+{
+    const model::test_program program = new_program("mock", "binary");
+    const engine::list_cache cache(fs::path("cache"));
+    ATF_REQUIRE(!cache.lookup(program, no_vars));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(store_and_lookup);
+ATF_TEST_CASE_BODY(store_and_lookup)
+{
+    const model::test_program program = new_program("mock", "binary");
+    const engine::list_cache cache(fs::path("cache/sub"));
+    cache.store(program, no_vars, sample_test_cases());
+    ATF_REQUIRE(fs::exists(fs::path("cache/sub")));
+
+    const optional< model::test_cases_map > test_cases = cache.lookup(
+        program, no_vars);
+    ATF_REQUIRE(test_cases);
+    ATF_REQUIRE(sample_test_cases() == test_cases.get());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(store_and_lookup__duration);
+ATF_TEST_CASE_BODY(store_and_lookup__duration)
+{
+    const model::test_program program = new_program("mock", "binary");
+    const engine::list_cache cache(fs::path("cache"));
+
+    optional< datetime::delta > duration;
+    cache.store(program, no_vars, sample_test_cases());
+    ATF_REQUIRE(cache.lookup(program, no_vars, &duration));
+    ATF_REQUIRE(!duration);
+
+    cache.store(program, no_vars, sample_test_cases(),
+                utils::make_optional(datetime::delta(3, 250)));
+    const optional< model::test_cases_map > test_cases = cache.lookup(
+        program, no_vars, &duration);
+    ATF_REQUIRE(test_cases);
+    ATF_REQUIRE(sample_test_cases() == test_cases.get());
+    ATF_REQUIRE(duration);
+    ATF_REQUIRE_EQ(datetime::delta(3, 250), duration.get());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(lookup__stale);
+ATF_TEST_CASE_BODY(lookup__stale)
+{
+    const model::test_program program = new_program("mock", "binary");
+    const engine::list_cache cache(fs::path("cache"));
+    cache.store(program, no_vars, sample_test_cases());
+    ATF_REQUIRE(cache.lookup(program, no_vars));
+
+    atf::utils::create_file("program", "a different binary");
+    ATF_REQUIRE(!cache.lookup(program, no_vars));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(lookup__stale__same_second);
+ATF_TEST_CASE_BODY(lookup__stale__same_second)
+{
+#if !defined(HAVE_STRUCT_STAT_ST_MTIM) && \
+    !defined(HAVE_STRUCT_STAT_ST_MTIMESPEC)
+    skip("Modification times have a granularity of seconds");
+#endif
+    const model::test_program program = new_program("mock", "binary");
+    struct ::timeval times[2];
+    times[0].tv_sec = times[1].tv_sec = 1000000000;
+    times[0].tv_usec = times[1].tv_usec = 1000;
+    ATF_REQUIRE(::utimes("program", times) != -1);
+
+    const engine::list_cache cache(fs::path("cache"));
+    cache.store(program, no_vars, sample_test_cases());
+    ATF_REQUIRE(cache.lookup(program, no_vars));
+
+    times[0].tv_usec = times[1].tv_usec = 2000;
+    ATF_REQUIRE(::utimes("program", times) != -1);
+    struct ::stat sb;
+    ATF_REQUIRE(::stat("program", &sb) != -1);
+    if (sb.st_mtime != 1000000000)
+        fail("Failed to set the modification time");
+    ATF_REQUIRE(!cache.lookup(program, no_vars));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(lookup__other_vars);
+ATF_TEST_CASE_BODY(lookup__other_vars)
+{
+    const model::test_program program = new_program("mock", "binary");
+    const engine::list_cache cache(fs::path("cache"));
+
+    config::properties_map vars;
+    vars["foo"] = "bar";
+    cache.store(program, vars, sample_test_cases());
+    ATF_REQUIRE(cache.lookup(program, vars));
+    ATF_REQUIRE(!cache.lookup(program, no_vars));
+
+    vars["foo"] = "baz";
+    ATF_REQUIRE(!cache.lookup(program, vars));
+
+    config::properties_map split_vars;
+    split_vars["fo"] = "obar";
+    ATF_REQUIRE(!cache.lookup(program, split_vars));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(lookup__other_interface);
+ATF_TEST_CASE_BODY(lookup__other_interface)
+{
+    const model::test_program program = new_program("mock", "binary");
+    const engine::list_cache cache(fs::path("cache"));
+    cache.store(program, no_vars, sample_test_cases());
+
+    const model::test_program other = new_program("other", "binary");
+    ATF_REQUIRE(!cache.lookup(other, no_vars));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(lookup__corrupt);
+ATF_TEST_CASE_BODY(lookup__corrupt)
+{
+    const model::test_program program = new_program("mock", "binary");
+    const engine::list_cache cache(fs::path("cache"));
+    cache.store(program, no_vars, sample_test_cases());
+
+    const std::set< fs::directory_entry > files = fs::scan_directory(
+        fs::path("cache"));
+    for (std::set< fs::directory_entry >::const_iterator iter = files.begin();
+         iter != files.end(); ++iter) {
+        if ((*iter).name == "." || (*iter).name == "..")
+            continue;
+        const fs::path entry = fs::path("cache") / (*iter).name;
+        const std::string contents = utils::read_file(entry);
+        std::ofstream output(entry.c_str());
+        output << contents.substr(0, contents.length() - 10);
+    }
+
+    ATF_REQUIRE(!cache.lookup(program, no_vars));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(store__missing_binary);
+ATF_TEST_CASE_BODY(store__missing_binary)
+{
+    const model::test_program program = new_program("mock", "binary");
+    fs::unlink(fs::path("program"));
+
+    const engine::list_cache cache(fs::path("cache"));
+    cache.store(program, no_vars, sample_test_cases());
+    ATF_REQUIRE(!cache.lookup(program, no_vars));
+}
+
+
+ATF_INIT_TEST_CASES(tcs)
+{
+    ATF_ADD_TEST_CASE(tcs, lookup__missing);
+    ATF_ADD_TEST_CASE(tcs, store_and_lookup);
+    ATF_ADD_TEST_CASE(tcs, store_and_lookup__duration);
+    ATF_ADD_TEST_CASE(tcs, lookup__stale);
+    ATF_ADD_TEST_CASE(tcs, lookup__stale__same_second);
+    ATF_ADD_TEST_CASE(tcs, lookup__other_vars);
+    ATF_ADD_TEST_CASE(tcs, lookup__other_interface);
+    ATF_ADD_TEST_CASE(tcs, lookup__corrupt);
+    ATF_ADD_TEST_CASE(tcs, store__missing_binary);
+}
@@ -38,7 +38,6 @@ extern "C" {
 #include "model/test_program.hpp"
 #include "model/test_result.hpp"
 #include "utils/defs.hpp"
-#include "utils/env.hpp"
 #include "utils/format/macros.hpp"
 #include "utils/fs/path.hpp"
 #include "utils/optional.ipp"
@@ -53,6 +52,23 @@ namespace process = utils::process;
 using utils::optional;
 
 
+/// Computes the test cases list of a test program without executing it.
+///
+/// Plain test programs always expose a single test case named "main", so
+/// there is no need to spawn them to find out.
+///
+/// \param unused_test_program The test program to list.
+///
+/// \return A list of test cases.
+optional< model::test_cases_map >
+engine::plain_interface::static_list(
+    const model::test_program& UTILS_UNUSED_PARAM(test_program)) const
+{
+    return utils::make_optional(
+        model::test_cases_map_builder().add("main").build());
+}
+
+
 /// Executes a test program's list operation.
 ///
 /// This method is intended to be called within a subprocess and is expected
@@ -90,6 +106,26 @@ engine::plain_interface::parse_list(
 }
 
 
+/// Describes how to execute the test cases of a test program.
+///
+/// \param test_program The test program to execute.
+/// \param vars User-provided variables to pass to the test program.
+///
+/// \return The execution plan of the test program, which is always available.
+optional< engine::scheduler::exec_plan >
+engine::plain_interface::plan_test(
+    const model::test_program& test_program,
+    const config::properties_map& vars) const
+{
+    scheduler::exec_plan plan(test_program.absolute_path());
+    for (config::properties_map::const_iterator iter = vars.begin();
+         iter != vars.end(); ++iter) {
+        plan.environment[F("TEST_ENV_%s") % (*iter).first] = (*iter).second;
+    }
+    return utils::make_optional(plan);
+}
+
+
 /// Executes a test case of the test program.
 ///
 /// This method is intended to be called within a subprocess and is expected
@@ -110,13 +146,7 @@ engine::plain_interface::exec_test(
 {
     PRE(test_case_name == "main");
 
-    for (config::properties_map::const_iterator iter = vars.begin();
-         iter != vars.end(); ++iter) {
-        utils::setenv(F("TEST_ENV_%s") % (*iter).first, (*iter).second);
-    }
-
-    process::args_vector args;
-    process::exec(test_program.absolute_path(), args);
+    plan_test(test_program, vars).get().exec(process::args_vector());
 }
 
 
@@ -124,6 +124,27 @@ test_fail(void)
 }
 
 
+/// A test case that writes lots of output to stdout and stderr.
+///
+/// The amount of output, in bytes, comes from the output_size configuration
+/// variable and defaults to 1MB.
+static void
+test_large_output(void)
+{
+    std::size_t size = 1024 * 1024;
+    const optional< std::string > size_env = utils::getenv(
+        "TEST_ENV_output_size");
+    if (size_env)
+        size = std::strtoul(size_env.get().c_str(), NULL, 10);
+
+    const std::string line(79, 'x');
+    for (std::size_t i = 0; i < size; i += line.length() + 1) {
+        std::cout << line << '\n';
+        std::cerr << line << '\n';
+    }
+}
+
+
 /// A test case that passes.
 static void
 test_pass(void)
@@ -221,6 +242,8 @@ main(int argc, char** argv)
         test_crash();
     else if (test_case == "fail")
         test_fail();
+    else if (test_case == "large_output")
+        test_large_output();
     else if (test_case == "pass")
         test_pass();
     else if (test_case == "spawn_blocking_child")
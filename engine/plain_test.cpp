@@ -55,6 +55,7 @@ namespace fs = utils::fs;
 namespace scheduler = engine::scheduler;
 
 using utils::none;
+using utils::optional;
 
 
 namespace {
@@ -112,6 +113,22 @@ run_one(const atf::tests::tc* tc, const char* test_case_name,
 }  // anonymous namespace
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(static_list);
+ATF_TEST_CASE_BODY(static_list)
+{
+    const model::test_program program = model::test_program_builder(
+        "plain", fs::path("non-existent"), fs::path("."), "unused-suite")
+        .build();
+
+    const optional< model::test_cases_map > test_cases =
+        engine::plain_interface().static_list(program);
+    ATF_REQUIRE(test_cases);
+    const model::test_cases_map exp_test_cases = model::test_cases_map_builder()
+        .add("main").build();
+    ATF_REQUIRE_EQ(exp_test_cases, test_cases.get());
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(list);
 ATF_TEST_CASE_BODY(list)
 {
@@ -197,6 +214,7 @@ ATF_INIT_TEST_CASES(tcs)
         "plain", std::shared_ptr< scheduler::interface >(
             new engine::plain_interface()));
 
+    ATF_ADD_TEST_CASE(tcs, static_list);
     ATF_ADD_TEST_CASE(tcs, list);
 
     ATF_ADD_TEST_CASE(tcs, test__exit_success_is_pass);
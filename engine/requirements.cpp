@@ -28,14 +28,19 @@
 
 #include "engine/requirements.hpp"
 
+#include <map>
+
 #include "model/metadata.hpp"
 #include "model/types.hpp"
+#include "utils/config/keys.hpp"
 #include "utils/config/nodes.ipp"
 #include "utils/config/tree.ipp"
 #include "utils/format/macros.hpp"
 #include "utils/fs/operations.hpp"
 #include "utils/fs/path.hpp"
 #include "utils/memory.hpp"
+#include "utils/noncopyable.hpp"
+#include "utils/optional.ipp"
 #include "utils/passwd.hpp"
 #include "utils/sanity.hpp"
 #include "utils/units.hpp"
@@ -45,10 +50,25 @@ namespace fs = utils::fs;
 namespace passwd = utils::passwd;
 namespace units = utils::units;
 
+using utils::none;
+using utils::optional;
+
 
 namespace {
 
 
+/// Key of the architecture configuration variable.
+static const config::key_handle architecture_key("architecture");
+
+
+/// Key of the platform configuration variable.
+static const config::key_handle platform_key("platform");
+
+
+/// Key of the unprivileged_user configuration variable.
+static const config::key_handle unprivileged_user_key("unprivileged_user");
+
+
 /// Checks if all required configuration variables are present.
 ///
 /// \param required_configs Set of required variable names.
@@ -65,12 +85,14 @@ check_required_configs(const model::strings_set& required_configs,
          iter != required_configs.end(); iter++) {
         std::string property;
         // TODO(jmmv): All this rewrite logic belongs in the ATF interface.
+        bool is_set;
         if ((*iter) == "unprivileged-user" || (*iter) == "unprivileged_user")
-            property = "unprivileged_user";
+            is_set = user_config.is_set(unprivileged_user_key);
         else
-            property = F("test_suites.%s.%s") % test_suite_name % (*iter);
+            is_set = user_config.is_set(
+                F("test_suites.%s.%s") % test_suite_name % (*iter));
 
-        if (!user_config.is_set(property))
+        if (!is_set)
             return F("Required configuration property '%s' not defined") %
                 (*iter);
     }
@@ -91,7 +113,7 @@ check_allowed_architectures(const model::strings_set& allowed_architectures,
 {
     if (!allowed_architectures.empty()) {
         const std::string architecture =
-            user_config.lookup< config::string_node >("architecture");
+            user_config.lookup< config::string_node >(architecture_key);
         if (allowed_architectures.find(architecture) ==
             allowed_architectures.end())
             return F("Current architecture '%s' not supported") % architecture;
@@ -113,7 +135,7 @@ check_allowed_platforms(const model::strings_set& allowed_platforms,
 {
     if (!allowed_platforms.empty()) {
         const std::string platform =
-            user_config.lookup< config::string_node >("platform");
+            user_config.lookup< config::string_node >(platform_key);
         if (allowed_platforms.find(platform) == allowed_platforms.end())
             return F("Current platform '%s' not supported") % platform;
     }
@@ -125,21 +147,25 @@ check_allowed_platforms(const model::strings_set& allowed_platforms,
 ///
 /// \param required_user Name of the required user category.
 /// \param user_config Runtime user configuration.
+/// \param [in,out] is_root Whether the current user is root, if known.  Set
+///     on return if it had to be queried.
 ///
 /// \return Empty if the current user fits the required user characteristics or
 /// an error message otherwise.
 static std::string
 check_required_user(const std::string& required_user,
-                    const config::tree& user_config)
+                    const config::tree& user_config,
+                    optional< bool >& is_root)
 {
     if (!required_user.empty()) {
-        const passwd::user user = passwd::current_user();
+        if (!is_root)
+            is_root = passwd::current_user().is_root();
         if (required_user == "root") {
-            if (!user.is_root())
+            if (!is_root.get())
                 return "Requires root privileges";
         } else if (required_user == "unprivileged") {
-            if (user.is_root())
-                if (!user_config.is_set("unprivileged_user"))
+            if (is_root.get())
+                if (!user_config.is_set(unprivileged_user_key))
                     return "Requires an unprivileged user but the "
                         "unprivileged-user configuration variable is not "
                         "defined";
@@ -153,15 +179,22 @@ check_required_user(const std::string& required_user,
 /// Checks if all required files exist.
 ///
 /// \param required_files Set of paths.
+/// \param [in,out] found Whether each path exists, for the paths already
+///     checked.  Gets the newly-checked paths added.
 ///
 /// \return Empty if the required files all exist or an error message otherwise.
 static std::string
-check_required_files(const model::paths_set& required_files)
+check_required_files(const model::paths_set& required_files,
+                     std::map< fs::path, bool >& found)
 {
     for (model::paths_set::const_iterator iter = required_files.begin();
          iter != required_files.end(); iter++) {
         INV((*iter).is_absolute());
-        if (!fs::exists(*iter))
+        std::map< fs::path, bool >::const_iterator known = found.find(*iter);
+        if (known == found.end())
+            known = found.insert(std::make_pair(
+                *iter, fs::exists(*iter))).first;
+        if (!(*known).second)
             return F("Required file '%s' not found") % *iter;
     }
     return "";
@@ -171,19 +204,27 @@ check_required_files(const model::paths_set& required_files)
 /// Checks if all required programs exist.
 ///
 /// \param required_programs Set of paths.
+/// \param [in,out] found Whether each program exists, for the programs already
+///     checked.  Gets the newly-checked programs added.
 ///
 /// \return Empty if the required programs all exist or an error message
 /// otherwise.
 static std::string
-check_required_programs(const model::paths_set& required_programs)
+check_required_programs(const model::paths_set& required_programs,
+                        std::map< fs::path, bool >& found)
 {
     for (model::paths_set::const_iterator iter = required_programs.begin();
          iter != required_programs.end(); iter++) {
-        if ((*iter).is_absolute()) {
-            if (!fs::exists(*iter))
+        std::map< fs::path, bool >::const_iterator known = found.find(*iter);
+        if (known == found.end()) {
+            const bool exists = (*iter).is_absolute() ?
+                fs::exists(*iter) : bool(fs::find_in_path((*iter).c_str()));
+            known = found.insert(std::make_pair(*iter, exists)).first;
+        }
+        if (!(*known).second) {
+            if ((*iter).is_absolute())
                 return F("Required program '%s' not found") % *iter;
-        } else {
-            if (!fs::find_in_path((*iter).c_str()))
+            else
                 return F("Required program '%s' not found in PATH") % *iter;
         }
     }
@@ -195,18 +236,23 @@ check_required_programs(const model::paths_set& required_programs)
 ///
 /// \param required_memory Amount of required physical memory, or zero if not
 ///     applicable.
+/// \param [in,out] physical_memory The physical memory of the system, if
+///     known.  Set on return if it had to be queried.
 ///
 /// \return Empty if the current system has the required amount of memory or an
 /// error message otherwise.
 static std::string
-check_required_memory(const units::bytes& required_memory)
+check_required_memory(const units::bytes& required_memory,
+                      optional< units::bytes >& physical_memory)
 {
     if (required_memory > 0) {
-        const units::bytes physical_memory = utils::physical_memory();
-        if (physical_memory > 0 && physical_memory < required_memory)
+        if (!physical_memory)
+            physical_memory = utils::physical_memory();
+        const units::bytes& available = physical_memory.get();
+        if (available > 0 && available < required_memory)
             return F("Requires %s bytes of physical memory but only %s "
                      "available") %
-                required_memory.format() % physical_memory.format();
+                required_memory.format() % available.format();
     }
     return "";
 }
@@ -239,19 +285,51 @@ check_required_disk_space(const units::bytes& required_disk_space,
 }  // anonymous namespace
 
 
-/// Checks if all the requirements specified by the test case are met.
+/// Internal implementation of the requirements cache.
+struct engine::requirements_cache::impl : utils::noncopyable {
+    /// Whether each required file exists.
+    std::map< fs::path, bool > files;
+
+    /// Whether each required program exists.
+    std::map< fs::path, bool > programs;
+
+    /// Whether the current user is root; none until first needed.
+    optional< bool > is_root;
+
+    /// Physical memory of the system; none until first needed.
+    optional< units::bytes > physical_memory;
+};
+
+
+/// Constructs a new empty cache.
+engine::requirements_cache::requirements_cache(void) :
+    _pimpl(new impl())
+{
+}
+
+
+/// Destructor.
+engine::requirements_cache::~requirements_cache(void)
+{
+}
+
+
+/// Checks if the requirements of the test case not tied to its work directory
+/// are met.
+///
+/// The checks that only depend on the configuration come first so that they
+/// can reject a test case before any lookup of the system is done.
 ///
 /// \param md The test metadata.
 /// \param cfg The engine configuration.
 /// \param test_suite Name of the test suite the test belongs to.
-/// \param work_directory Path to where the test case will be run.
 ///
 /// \return A string describing the reason for skipping the test, or empty if
 /// the test should be executed.
 std::string
-engine::check_reqs(const model::metadata& md, const config::tree& cfg,
-                   const std::string& test_suite,
-                   const fs::path& work_directory)
+engine::requirements_cache::check(const model::metadata& md,
+                                  const config::tree& cfg,
+                                  const std::string& test_suite)
 {
     std::string reason;
 
@@ -267,27 +345,64 @@ engine::check_reqs(const model::metadata& md, const config::tree& cfg,
     if (!reason.empty())
         return reason;
 
-    reason = check_required_user(md.required_user(), cfg);
-    if (!reason.empty())
-        return reason;
-
-    reason = check_required_files(md.required_files());
+    reason = check_required_user(md.required_user(), cfg, _pimpl->is_root);
     if (!reason.empty())
         return reason;
 
-    reason = check_required_programs(md.required_programs());
+    reason = check_required_files(md.required_files(), _pimpl->files);
     if (!reason.empty())
         return reason;
 
-    reason = check_required_memory(md.required_memory());
+    reason = check_required_programs(md.required_programs(),
+                                     _pimpl->programs);
     if (!reason.empty())
         return reason;
 
-    reason = check_required_disk_space(md.required_disk_space(),
-                                       work_directory);
+    reason = check_required_memory(md.required_memory(),
+                                   _pimpl->physical_memory);
     if (!reason.empty())
         return reason;
 
     INV(reason.empty());
     return reason;
 }
+
+
+/// Checks if the requirements of the test case tied to its work directory are
+/// met.
+///
+/// \param md The test metadata.
+/// \param work_directory Path to where the test case will be run.
+///
+/// \return A string describing the reason for skipping the test, or empty if
+/// the test should be executed.
+std::string
+engine::check_work_directory_reqs(const model::metadata& md,
+                                  const fs::path& work_directory)
+{
+    return check_required_disk_space(md.required_disk_space(), work_directory);
+}
+
+
+/// Checks if all the requirements specified by the test case are met.
+///
+/// Nothing is memoized across calls; see requirements_cache to do so.
+///
+/// \param md The test metadata.
+/// \param cfg The engine configuration.
+/// \param test_suite Name of the test suite the test belongs to.
+/// \param work_directory Path to where the test case will be run.
+///
+/// \return A string describing the reason for skipping the test, or empty if
+/// the test should be executed.
+std::string
+engine::check_reqs(const model::metadata& md, const config::tree& cfg,
+                   const std::string& test_suite,
+                   const fs::path& work_directory)
+{
+    const std::string reason = requirements_cache().check(md, cfg,
+                                                          test_suite);
+    if (!reason.empty())
+        return reason;
+    return check_work_directory_reqs(md, work_directory);
+}
@@ -37,10 +37,41 @@
 #include "model/metadata_fwd.hpp"
 #include "utils/config/tree_fwd.hpp"
 #include "utils/fs/path_fwd.hpp"
+#include "utils/shared_ptr.hpp"
 
 namespace engine {
 
 
+/// Memoizes the checks of test case requirements that query the system.
+///
+/// The test cases of a test suite tend to declare the same requirements, so
+/// checking them for every test case repeats the same lookups of files and
+/// programs and the same queries of the current user and of the physical
+/// memory.  The answers to these are remembered for the lifetime of the cache,
+/// which should thus not outlive a single run.
+///
+/// Requirements that depend on the work directory of the test case are not
+/// evaluated by the cache because they can only be checked once the work
+/// directory exists; see check_work_directory_reqs().
+///
+/// Copies of a cache share their contents.
+class requirements_cache {
+    struct impl;
+
+    /// Pointer to the shared internal implementation.
+    std::shared_ptr< impl > _pimpl;
+
+public:
+    requirements_cache(void);
+    ~requirements_cache(void);
+
+    std::string check(const model::metadata&, const utils::config::tree&,
+                      const std::string&);
+};
+
+
+std::string check_work_directory_reqs(const model::metadata&,
+                                      const utils::fs::path&);
 std::string check_reqs(const model::metadata&, const utils::config::tree&,
                        const std::string&, const utils::fs::path&);
 
@@ -478,6 +478,64 @@ ATF_TEST_CASE_BODY(check_reqs__required_programs__fail_relative)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(requirements_cache__files_memoized);
+ATF_TEST_CASE_BODY(requirements_cache__files_memoized)
+{
+    const model::metadata md = model::metadata_builder()
+        .add_required_file(fs::current_path() / "test-file")
+        .build();
+
+    engine::requirements_cache cache;
+    ATF_REQUIRE_MATCH("'.*/test-file' not found$",
+                      cache.check(md, engine::empty_config(), ""));
+
+    atf::utils::create_file("test-file", "");
+    ATF_REQUIRE_MATCH("'.*/test-file' not found$",
+                      cache.check(md, engine::empty_config(), ""));
+    ATF_REQUIRE(engine::requirements_cache().check(
+        md, engine::empty_config(), "").empty());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(requirements_cache__programs_memoized);
+ATF_TEST_CASE_BODY(requirements_cache__programs_memoized)
+{
+    const model::metadata md = model::metadata_builder()
+        .add_required_program(fs::path("foo"))
+        .build();
+
+    fs::mkdir(fs::path("bin"), 0755);
+    atf::utils::create_file("bin/foo", "");
+    utils::setenv("PATH", (fs::current_path() / "bin").str());
+
+    engine::requirements_cache cache;
+    ATF_REQUIRE(cache.check(md, engine::empty_config(), "").empty());
+
+    utils::setenv("PATH", "/non-existent");
+    ATF_REQUIRE(cache.check(md, engine::empty_config(), "").empty());
+    ATF_REQUIRE_MATCH("'foo' not found in PATH$",
+                      engine::requirements_cache().check(
+                          md, engine::empty_config(), ""));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(requirements_cache__config_not_memoized);
+ATF_TEST_CASE_BODY(requirements_cache__config_not_memoized)
+{
+    const model::metadata md = model::metadata_builder()
+        .add_required_config("my-var")
+        .build();
+
+    engine::requirements_cache cache;
+    ATF_REQUIRE_MATCH("Required configuration property 'my-var' not defined",
+                      cache.check(md, engine::empty_config(), "suite"));
+
+    config::tree user_config = engine::default_config();
+    user_config.set_string("test_suites.suite.my-var", "value");
+    ATF_REQUIRE(cache.check(md, user_config, "suite").empty());
+}
+
+
 ATF_INIT_TEST_CASES(tcs)
 {
     ATF_ADD_TEST_CASE(tcs, check_reqs__none);
@@ -508,4 +566,8 @@ ATF_INIT_TEST_CASES(tcs)
     ATF_ADD_TEST_CASE(tcs, check_reqs__required_programs__ok);
     ATF_ADD_TEST_CASE(tcs, check_reqs__required_programs__fail_absolute);
     ATF_ADD_TEST_CASE(tcs, check_reqs__required_programs__fail_relative);
+
+    ATF_ADD_TEST_CASE(tcs, requirements_cache__files_memoized);
+    ATF_ADD_TEST_CASE(tcs, requirements_cache__programs_memoized);
+    ATF_ADD_TEST_CASE(tcs, requirements_cache__config_not_memoized);
 }
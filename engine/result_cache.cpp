@@ -0,0 +1,270 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "engine/result_cache.hpp"
+
+extern "C" {
+#include <stdint.h>
+}
+
+#include <fstream>
+#include <map>
+#include <set>
+#include <utility>
+
+#include "engine/config.hpp"
+#include "engine/scheduler.hpp"
+#include "model/metadata.hpp"
+#include "model/test_case.hpp"
+#include "model/test_program.hpp"
+#include "model/types.hpp"
+#include "utils/config/tree.ipp"
+#include "utils/fnv.hpp"
+#include "utils/format/macros.hpp"
+#include "utils/fs/path.hpp"
+#include "utils/logging/macros.hpp"
+#include "utils/noncopyable.hpp"
+#include "utils/optional.ipp"
+
+namespace config = utils::config;
+namespace fs = utils::fs;
+namespace scheduler = engine::scheduler;
+
+using utils::none;
+using utils::optional;
+
+
+namespace {
+
+
+/// Size of the chunks in which the files are read to compute their digests.
+static const std::size_t read_chunk_size = 64 * 1024;
+
+
+/// Formats a hash and the length of the data it covers.
+///
+/// \param hash The hash to format.
+/// \param length The length of the hashed data.
+///
+/// \return A textual representation of the digest.
+static std::string
+format_digest(const uint64_t hash, const uint64_t length)
+{
+    return F("%s-%s") % utils::fnv1a64_hex(hash) % length;
+}
+
+
+/// Computes the digest of the contents of a file.
+///
+/// \param file The file to read.
+///
+/// \return The digest of the file, or none if the file cannot be read.
+static optional< std::string >
+file_digest(const fs::path& file)
+{
+    std::ifstream input(file.c_str(), std::ios::binary);
+    if (!input) {
+        LD(F("Cannot open %s to compute its digest") % file);
+        return none;
+    }
+
+    uint64_t hash = utils::fnv1a64_basis;
+    uint64_t length = 0;
+    char buffer[read_chunk_size];
+    while (input.read(buffer, sizeof(buffer)) || input.gcount() > 0) {
+        hash = utils::fnv1a64_update(hash, buffer, input.gcount());
+        length += input.gcount();
+    }
+    if (input.bad()) {
+        LD(F("Failed to read %s to compute its digest") % file);
+        return none;
+    }
+    return utils::make_optional(format_digest(hash, length));
+}
+
+
+/// Appends a named field to the serialized inputs of a test case.
+///
+/// Fields are prefixed with their lengths so that no combination of names and
+/// values can produce the same serialization as a different combination.
+///
+/// \param [in,out] data The serialized inputs to extend.
+/// \param name The name of the field.
+/// \param value The value of the field.
+static void
+add_field(std::string& data, const std::string& name, const std::string& value)
+{
+    data += F("%s:%s%s:%s\n") % name.length() % name % value.length() % value;
+}
+
+
+}  // anonymous namespace
+
+
+/// Internal implementation of a result_cache.
+struct engine::result_cache::impl : utils::noncopyable {
+    /// Identifies a test case: the relative path of its test program and its
+    /// name.
+    typedef std::pair< fs::path, std::string > test_case_id;
+
+    /// Cache keys of the test cases that passed previously.
+    ///
+    /// A test case may have passed with several keys if its test program runs
+    /// in several variants, as each variant has its own configuration.
+    std::set< std::pair< test_case_id, std::string > > passed;
+
+    /// Digests of the files read so far; none for unreadable files.
+    std::map< fs::path, optional< std::string > > digests;
+
+    /// Computes the digest of a file, remembering it for later calls.
+    ///
+    /// \param file The file to read.
+    ///
+    /// \return The digest of the file, or none if the file cannot be read.
+    const optional< std::string >&
+    digest(const fs::path& file)
+    {
+        std::map< fs::path, optional< std::string > >::const_iterator iter =
+            digests.find(file);
+        if (iter == digests.end())
+            iter = digests.insert(std::make_pair(file, file_digest(file)))
+                .first;
+        return (*iter).second;
+    }
+};
+
+
+/// Constructs an empty cache.
+engine::result_cache::result_cache(void) :
+    _pimpl(new impl())
+{
+}
+
+
+/// Destructor.
+engine::result_cache::~result_cache(void)
+{
+}
+
+
+/// Computes the cache key of a test case.
+///
+/// \param test_program The test program that contains the test case.
+/// \param test_case_name The name of the test case.
+/// \param user_config The end-user configuration properties.
+///
+/// \return The cache key, or none if any of the inputs of the test case cannot
+/// be read, in which case the test case must always run.
+optional< std::string >
+engine::result_cache::compute_key(const model::test_program& test_program,
+                                  const std::string& test_case_name,
+                                  const config::tree& user_config) const
+{
+    const model::test_case& test_case = test_program.find(test_case_name);
+    const model::metadata& md = test_case.get_metadata();
+
+    std::string data;
+    add_field(data, "interface", test_program.interface_name());
+    add_field(data, "test_case", test_case_name);
+
+    const optional< std::string >& binary = _pimpl->digest(
+        test_program.absolute_path());
+    if (!binary)
+        return none;
+    add_field(data, "binary", binary.get());
+
+    // Fixtures can be whole directory hierarchies, which we do not digest, so
+    // test cases that stage any must always run.
+    if (!md.fixtures().empty())
+        return none;
+
+    const model::paths_set& required_files = md.required_files();
+    for (model::paths_set::const_iterator iter = required_files.begin();
+         iter != required_files.end(); ++iter) {
+        const optional< std::string >& file = _pimpl->digest(*iter);
+        if (!file)
+            return none;
+        add_field(data, "file." + (*iter).str(), file.get());
+    }
+
+    const model::properties_map props = md.to_properties();
+    for (model::properties_map::const_iterator iter = props.begin();
+         iter != props.end(); ++iter)
+        add_field(data, "metadata." + (*iter).first, (*iter).second);
+
+    // The architecture and platform determine whether the requirements of the
+    // test case are met, so they are as relevant as the test-suite variables.
+    const char* const host_vars[] = { "architecture", "platform" };
+    for (std::size_t i = 0; i < sizeof(host_vars) / sizeof(host_vars[0]); ++i) {
+        if (user_config.is_set(host_vars[i]))
+            add_field(data, host_vars[i],
+                      user_config.lookup< config::string_node >(host_vars[i]));
+    }
+    const config::properties_map vars = scheduler::generate_config(
+        scheduler::variant_config(user_config, test_program),
+        test_program.test_suite_name());
+    for (config::properties_map::const_iterator iter = vars.begin();
+         iter != vars.end(); ++iter)
+        add_field(data, "config." + (*iter).first, (*iter).second);
+
+    return utils::make_optional(format_digest(utils::fnv1a64(data),
+                                              data.length()));
+}
+
+
+/// Records a test case that passed with the given cache key.
+///
+/// \param relative_path The relative path to the test program.
+/// \param test_case_name The name of the test case.
+/// \param key The cache key of the test case when it passed.
+void
+engine::result_cache::add_passed(const fs::path& relative_path,
+                                 const std::string& test_case_name,
+                                 const std::string& key)
+{
+    _pimpl->passed.insert(std::make_pair(
+        impl::test_case_id(relative_path, test_case_name), key));
+}
+
+
+/// Checks if a test case passed previously with the same inputs.
+///
+/// \param relative_path The relative path to the test program.
+/// \param test_case_name The name of the test case.
+/// \param key The current cache key of the test case.
+///
+/// \return True if the test case passed with the same cache key.
+bool
+engine::result_cache::has_passed(const fs::path& relative_path,
+                                 const std::string& test_case_name,
+                                 const std::string& key) const
+{
+    return _pimpl->passed.find(std::make_pair(
+        impl::test_case_id(relative_path, test_case_name), key)) !=
+        _pimpl->passed.end();
+}
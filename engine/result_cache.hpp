@@ -0,0 +1,83 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// \file engine/result_cache.hpp
+/// Detection of test cases whose inputs did not change since they passed.
+///
+/// Test cases are identified by a cache key that summarizes all the inputs
+/// that can affect their outcome: the contents of the test program binary and
+/// of the files required by the test case, the metadata of the test case, and
+/// the configuration variables passed to it.  A test case whose key matches
+/// the key recorded for a passing execution in a previous run need not run
+/// again.
+
+#if !defined(ENGINE_RESULT_CACHE_HPP)
+#define ENGINE_RESULT_CACHE_HPP
+
+#include "engine/result_cache_fwd.hpp"
+
+#include <string>
+
+#include "model/test_program_fwd.hpp"
+#include "utils/config/tree_fwd.hpp"
+#include "utils/fs/path_fwd.hpp"
+#include "utils/optional_fwd.hpp"
+#include "utils/shared_ptr.hpp"
+
+namespace engine {
+
+
+/// Collection of the cache keys of the test cases that passed previously.
+///
+/// The digests of the files read to compute the keys are remembered for the
+/// lifetime of the object, so the binary of a test program is only read once
+/// regardless of how many test cases it contains.
+class result_cache {
+    struct impl;
+
+    /// Pointer to the shared internal implementation.
+    std::shared_ptr< impl > _pimpl;
+
+public:
+    result_cache(void);
+    ~result_cache(void);
+
+    utils::optional< std::string > compute_key(
+        const model::test_program&, const std::string&,
+        const utils::config::tree&) const;
+
+    void add_passed(const utils::fs::path&, const std::string&,
+                    const std::string&);
+    bool has_passed(const utils::fs::path&, const std::string&,
+                    const std::string&) const;
+};
+
+
+}  // namespace engine
+
+#endif  // !defined(ENGINE_RESULT_CACHE_HPP)
@@ -0,0 +1,244 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "engine/result_cache.hpp"
+
+#include <string>
+
+#include <atf-c++.hpp>
+
+#include "engine/config.hpp"
+#include "model/metadata.hpp"
+#include "model/test_program.hpp"
+#include "utils/config/tree.ipp"
+#include "utils/fs/operations.hpp"
+#include "utils/fs/path.hpp"
+#include "utils/optional.ipp"
+
+namespace config = utils::config;
+namespace fs = utils::fs;
+
+using utils::optional;
+
+
+namespace {
+
+
+/// Creates a test program backed by a file in the current directory.
+///
+/// \param contents Contents of the fake binary.
+/// \param md Metadata of the only test case in the program, named "main".
+///
+/// \return The new test program.
+static model::test_program
+new_program(const char* contents,
+            const model::metadata& md = model::metadata_builder().build())
+{
+    atf::utils::create_file("program", contents);
+    return model::test_program_builder(
+        "plain", fs::path("program"), fs::current_path(), "the-suite")
+        .add_test_case("main", md)
+        .build();
+}
+
+
+/// Computes the cache key of the "main" test case with a fresh cache.
+///
+/// \param program The test program to compute the key for.
+/// \param user_config The end-user configuration properties.
+///
+/// \return The cache key of the test case.
+static optional< std::string >
+key_of(const model::test_program& program,
+       const config::tree& user_config = engine::default_config())
+{
+    return engine::result_cache().compute_key(program, "main", user_config);
+}
+
+
+}  // anonymous namespace
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(compute_key__stable);
+ATF_TEST_CASE_BODY(compute_key__stable)
+{
+    const model::test_program program = new_program("binary");
+    const optional< std::string > key = key_of(program);
+    ATF_REQUIRE(key);
+    ATF_REQUIRE_EQ(key, key_of(program));
+
+    const model::test_program same_program = new_program("binary");
+    ATF_REQUIRE_EQ(key, key_of(same_program));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(compute_key__binary_changes);
+ATF_TEST_CASE_BODY(compute_key__binary_changes)
+{
+    const optional< std::string > key1 = key_of(new_program("binary 1"));
+    const optional< std::string > key2 = key_of(new_program("binary 2"));
+    ATF_REQUIRE(key1);
+    ATF_REQUIRE(key2);
+    ATF_REQUIRE(key1 != key2);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(compute_key__binary_missing);
+ATF_TEST_CASE_BODY(compute_key__binary_missing)
+{
+    const model::test_program program = new_program("binary");
+    fs::unlink(fs::path("program"));
+    ATF_REQUIRE(!key_of(program));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(compute_key__digests_are_remembered);
+ATF_TEST_CASE_BODY(compute_key__digests_are_remembered)
+{
+    const model::test_program program = new_program("binary 1");
+    const engine::result_cache cache;
+    const optional< std::string > key = cache.compute_key(
+        program, "main", engine::default_config());
+
+    new_program("binary 2");
+    ATF_REQUIRE_EQ(key, cache.compute_key(program, "main",
+                                          engine::default_config()));
+    ATF_REQUIRE(key != key_of(program));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(compute_key__required_files);
+ATF_TEST_CASE_BODY(compute_key__required_files)
+{
+    const model::metadata md = model::metadata_builder()
+        .add_required_file(fs::current_path() / "data")
+        .build();
+
+    ATF_REQUIRE(!key_of(new_program("binary", md)));
+
+    atf::utils::create_file("data", "contents 1");
+    const optional< std::string > key1 = key_of(new_program("binary", md));
+    ATF_REQUIRE(key1);
+    atf::utils::create_file("data", "contents 2");
+    const optional< std::string > key2 = key_of(new_program("binary", md));
+    ATF_REQUIRE(key2);
+    ATF_REQUIRE(key1 != key2);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(compute_key__metadata_changes);
+ATF_TEST_CASE_BODY(compute_key__metadata_changes)
+{
+    const optional< std::string > key1 = key_of(new_program(
+        "binary", model::metadata_builder().build()));
+    const optional< std::string > key2 = key_of(new_program(
+        "binary", model::metadata_builder().add_custom("foo", "bar").build()));
+    ATF_REQUIRE(key1 != key2);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(compute_key__config_changes);
+ATF_TEST_CASE_BODY(compute_key__config_changes)
+{
+    const model::test_program program = new_program("binary");
+
+    config::tree user_config = engine::default_config();
+    const optional< std::string > key1 = key_of(program, user_config);
+
+    user_config.set_string("test_suites.other-suite.var", "value");
+    ATF_REQUIRE_EQ(key1, key_of(program, user_config));
+
+    user_config.set_string("test_suites.the-suite.var", "value 1");
+    const optional< std::string > key2 = key_of(program, user_config);
+    ATF_REQUIRE(key1 != key2);
+
+    user_config.set_string("test_suites.the-suite.var", "value 2");
+    const optional< std::string > key3 = key_of(program, user_config);
+    ATF_REQUIRE(key2 != key3);
+
+    user_config.set_string("platform", "some-other-platform");
+    ATF_REQUIRE(key3 != key_of(program, user_config));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(compute_key__variant_changes);
+ATF_TEST_CASE_BODY(compute_key__variant_changes)
+{
+    atf::utils::create_file("program", "binary");
+    config::properties_map vars1;
+    vars1["var"] = "value 1";
+    config::properties_map vars2;
+    vars2["var"] = "value 2";
+
+    const optional< std::string > key1 = key_of(model::test_program_builder(
+        "plain", fs::path("program"), fs::current_path(), "the-suite")
+        .add_test_case("main").set_variant("first", vars1).build());
+    const optional< std::string > key2 = key_of(model::test_program_builder(
+        "plain", fs::path("program"), fs::current_path(), "the-suite")
+        .add_test_case("main").set_variant("second", vars2).build());
+    ATF_REQUIRE(key1);
+    ATF_REQUIRE(key2);
+    ATF_REQUIRE(key1 != key2);
+
+    config::tree user_config = engine::default_config();
+    user_config.set_string("test_suites.the-suite.var", "value 1");
+    ATF_REQUIRE_EQ(key1, key_of(new_program("binary"), user_config));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(has_passed);
+ATF_TEST_CASE_BODY(has_passed)
+{
+    engine::result_cache cache;
+    ATF_REQUIRE(!cache.has_passed(fs::path("dir/program"), "main", "key"));
+
+    cache.add_passed(fs::path("dir/program"), "main", "key");
+    ATF_REQUIRE(cache.has_passed(fs::path("dir/program"), "main", "key"));
+    ATF_REQUIRE(!cache.has_passed(fs::path("dir/program"), "main", "other"));
+    ATF_REQUIRE(!cache.has_passed(fs::path("dir/program"), "other", "key"));
+    ATF_REQUIRE(!cache.has_passed(fs::path("program"), "main", "key"));
+
+    cache.add_passed(fs::path("dir/program"), "main", "other");
+    ATF_REQUIRE(cache.has_passed(fs::path("dir/program"), "main", "key"));
+    ATF_REQUIRE(cache.has_passed(fs::path("dir/program"), "main", "other"));
+}
+
+
+ATF_INIT_TEST_CASES(tcs)
+{
+    ATF_ADD_TEST_CASE(tcs, compute_key__stable);
+    ATF_ADD_TEST_CASE(tcs, compute_key__binary_changes);
+    ATF_ADD_TEST_CASE(tcs, compute_key__binary_missing);
+    ATF_ADD_TEST_CASE(tcs, compute_key__digests_are_remembered);
+    ATF_ADD_TEST_CASE(tcs, compute_key__required_files);
+    ATF_ADD_TEST_CASE(tcs, compute_key__metadata_changes);
+    ATF_ADD_TEST_CASE(tcs, compute_key__config_changes);
+
+    ATF_ADD_TEST_CASE(tcs, compute_key__variant_changes);
+    ATF_ADD_TEST_CASE(tcs, has_passed);
+}
@@ -28,16 +28,29 @@
 
 #include "engine/scanner.hpp"
 
+#include <algorithm>
 #include <deque>
+#include <functional>
+#include <list>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "engine/filters.hpp"
+#include "engine/scheduler.hpp"
+#include "model/metadata.hpp"
 #include "model/test_case.hpp"
 #include "model/test_program.hpp"
+#include "utils/fs/operations.hpp"
+#include "utils/fs/path.hpp"
 #include "utils/noncopyable.hpp"
 #include "utils/optional.ipp"
 #include "utils/sanity.hpp"
 
+namespace datetime = utils::datetime;
+namespace fs = utils::fs;
+namespace scheduler = engine::scheduler;
+
 using utils::none;
 using utils::optional;
 
@@ -45,108 +58,707 @@ using utils::optional;
 namespace {
 
 
-/// Extracts the keys of a map as a deque.
+/// Checks whether the test cases of a test program are already in memory.
 ///
-/// \tparam KeyType The type of the map keys.
-/// \tparam ValueType The type of the map values.
-/// \param map The input map.
+/// \param test_program The test program to check.
 ///
-/// \return A deque with the keys of the map.
-template< typename KeyType, typename ValueType >
-static std::deque< KeyType >
-map_keys(const std::map< KeyType, ValueType >& map)
+/// \return True if querying the test cases of the test program does not
+/// require executing the test program; false otherwise.
+static bool
+is_loaded(const model::test_program_ptr& test_program)
 {
-    std::deque< KeyType > keys;
-    for (typename std::map< KeyType, ValueType >::const_iterator iter =
-             map.begin(); iter != map.end(); ++iter) {
-        keys.push_back((*iter).first);
+    const scheduler::lazy_test_program* lazy =
+        dynamic_cast< const scheduler::lazy_test_program* >(
+            test_program.get());
+    return lazy == NULL || lazy->loaded();
+}
+
+
+/// A test program along with the names of its test cases not yet scanned.
+typedef std::pair< model::test_program_ptr, std::deque< std::string > >
+    loaded_test_program;
+
+
+/// Scheduling priority of a test case.
+///
+/// Test cases are ordered first by their tier and then by decreasing expected
+/// duration, so that the longest test cases of each tier start first.  The
+/// tiers of every priority class come before those of the next class.
+class test_case_priority {
+    /// Tier of the test case; lower tiers are returned first.
+    int _tier;
+
+    /// Expected duration of the test case; zero if unknown.
+    datetime::delta _duration;
+
+public:
+    /// Constructor.
+    ///
+    /// \param tier_ Tier of the test case; lower tiers are returned first.
+    /// \param duration_ Expected duration of the test case.
+    test_case_priority(const int tier_, const datetime::delta& duration_) :
+        _tier(tier_), _duration(duration_)
+    {
+    }
+
+    /// Gets the tier of the test case.
+    ///
+    /// \return The tier of the test case; lower tiers are returned first.
+    int
+    tier(void) const
+    {
+        return _tier;
     }
-    return keys;
+
+    /// Gets the expected duration of the test case.
+    ///
+    /// \return The expected duration of the test case; zero if unknown.
+    const datetime::delta&
+    duration(void) const
+    {
+        return _duration;
+    }
+
+    /// Checks if this test case has to be returned before another one.
+    ///
+    /// \param other The other test case.
+    ///
+    /// \return True if this test case goes first.
+    bool
+    operator<(const test_case_priority& other) const
+    {
+        if (_tier != other._tier)
+            return _tier < other._tier;
+        return other._duration < _duration;
+    }
+};
+
+
+/// Tier of the test cases that failed in the previous run.
+static const int failed_tier = 0;
+
+
+/// Tier of the test cases that did not exist in the previous run.
+static const int new_tier = 1;
+
+
+/// Tier of all other test cases.
+static const int default_tier = 2;
+
+
+/// Number of tiers within every priority class.
+static const int tiers_per_class = 3;
+
+
+/// Computes the offset of the tiers of the test cases of a test program.
+///
+/// \param test_program The test program to query.
+///
+/// \return The number of tiers that go before those of the priority class of
+/// the test program.
+static int
+class_offset(const model::test_program& test_program)
+{
+    const std::string& priority = test_program.get_metadata().priority();
+    if (priority == "high")
+        return 0;
+    else if (priority == "low")
+        return 2 * tiers_per_class;
+    else
+        return tiers_per_class;
 }
 
 
+/// Checks whether any test program has a priority class other than normal.
+///
+/// \param test_programs The test programs to check.
+///
+/// \return True if the priority classes distinguish some test programs.
+static bool
+has_priority_classes(const model::test_programs_vector& test_programs)
+{
+    for (model::test_programs_vector::const_iterator iter =
+             test_programs.begin(); iter != test_programs.end(); ++iter) {
+        if ((*iter)->get_metadata().priority() != "normal")
+            return true;
+    }
+    return false;
+}
+
+
+/// Computes the scheduling priorities of test cases from a previous run.
+class priorities : utils::noncopyable {
+    /// Expected durations of the test cases; may be empty.
+    const engine::durations_map _durations;
+
+    /// Test cases to return first; none to ignore the previous failures.
+    const optional< engine::test_case_ids_set > _failed;
+
+    /// Whether the test programs have different priority classes.
+    const bool _classes;
+
+    /// Best priority of the known test cases of each test program.
+    std::map< fs::path, test_case_priority > _best;
+
+    /// Accounts for a test case in the best priority of its test program.
+    ///
+    /// \param id The test case to account for.
+    void
+    update_best(const engine::test_case_id& id)
+    {
+        const test_case_priority priority = of_id(id);
+        const std::map< fs::path, test_case_priority >::iterator iter =
+            _best.find(id.first);
+        if (iter == _best.end())
+            _best.insert(std::make_pair(id.first, priority));
+        else if (priority < (*iter).second)
+            (*iter).second = priority;
+    }
+
+public:
+    /// Constructor.
+    ///
+    /// \param durations_ Expected durations of the test cases.
+    /// \param failed_ Test cases that failed in the previous run, if they have
+    ///     to be returned first.
+    /// \param classes_ Whether the test programs have different priority
+    ///     classes.
+    priorities(const engine::durations_map& durations_,
+               const optional< engine::test_case_ids_set >& failed_,
+               const bool classes_) :
+        _durations(durations_), _failed(failed_), _classes(classes_)
+    {
+        for (engine::durations_map::const_iterator iter = _durations.begin();
+             iter != _durations.end(); ++iter)
+            update_best((*iter).first);
+        if (_failed) {
+            for (engine::test_case_ids_set::const_iterator iter =
+                     _failed.get().begin(); iter != _failed.get().end(); ++iter)
+                update_best(*iter);
+        }
+    }
+
+    /// Checks whether the test cases have any particular order.
+    ///
+    /// \return True if the known information distinguishes test cases.
+    bool
+    enabled(void) const
+    {
+        return !_durations.empty() || _failed || _classes;
+    }
+
+    /// Checks whether the test cases are split in tiers.
+    ///
+    /// \return True if the previous failures have to be returned first or if
+    /// the test programs have different priority classes.
+    bool
+    tiered(void) const
+    {
+        return _failed || _classes;
+    }
+
+    /// Gets the priority of a test case ignoring its priority class.
+    ///
+    /// \param id The test case to query.
+    ///
+    /// \return The priority of the test case within its priority class.
+    test_case_priority
+    of_id(const engine::test_case_id& id) const
+    {
+        const engine::durations_map::const_iterator iter = _durations.find(id);
+        const datetime::delta duration =
+            iter == _durations.end() ? datetime::delta() : (*iter).second;
+
+        int tier = default_tier;
+        if (_failed) {
+            if (_failed.get().find(id) != _failed.get().end())
+                tier = failed_tier;
+            else if (iter == _durations.end())
+                tier = new_tier;
+        }
+        return test_case_priority(tier, duration);
+    }
+
+    /// Gets the priority of a test case.
+    ///
+    /// \param test_program The test program the test case belongs to.
+    /// \param test_case_name The name of the test case.
+    ///
+    /// \return The priority of the test case.
+    test_case_priority
+    of(const model::test_program& test_program,
+       const std::string& test_case_name) const
+    {
+        const test_case_priority priority = of_id(engine::test_case_id(
+            test_program.relative_path(), test_case_name));
+        return test_case_priority(
+            priority.tier() + class_offset(test_program), priority.duration());
+    }
+
+    /// Gets the expected duration of a test case.
+    ///
+    /// \param id The test case to query.
+    ///
+    /// \return The duration of the test case in the previous run, or none if
+    /// it is unknown.
+    optional< datetime::delta >
+    duration_of(const engine::test_case_id& id) const
+    {
+        const engine::durations_map::const_iterator iter = _durations.find(id);
+        if (iter == _durations.end())
+            return none;
+        return utils::make_optional((*iter).second);
+    }
+
+    /// Collects the expected durations of all the test cases of a program.
+    ///
+    /// \param test_program The relative path to the test program.
+    /// \param [in,out] durations The collection to add the durations to.
+    void
+    add_durations_of(const fs::path& test_program,
+                     engine::durations_map& durations) const
+    {
+        for (engine::durations_map::const_iterator iter =
+                 _durations.lower_bound(engine::test_case_id(test_program, ""));
+             iter != _durations.end() && (*iter).first.first == test_program;
+             ++iter)
+            durations.insert(*iter);
+    }
+
+    /// Gets the best priority that a test case of a test program may have.
+    ///
+    /// \param test_program The test program to query.
+    ///
+    /// \return The priority of the most important test case of the test
+    /// program known from the previous run.  When returning failures first,
+    /// any test program may also contain new test cases, so the result is
+    /// never worse than the priority of a new test case.
+    test_case_priority
+    of_test_program(const model::test_program& test_program) const
+    {
+        const int offset = class_offset(test_program);
+        const test_case_priority unknown(
+            (_failed ? new_tier : default_tier) + offset, datetime::delta());
+        const std::map< fs::path, test_case_priority >::const_iterator iter =
+            _best.find(test_program.relative_path());
+        if (iter == _best.end())
+            return unknown;
+        const test_case_priority best((*iter).second.tier() + offset,
+                                      (*iter).second.duration());
+        return unknown < best ? unknown : best;
+    }
+};
+
+
+/// Sorts the test cases of a test program by priority.
+class test_case_first {
+    /// The priorities of the test cases.
+    const priorities& _priorities;
+
+    /// The test program the test cases belong to.
+    const model::test_program& _test_program;
+
+public:
+    /// Constructor.
+    ///
+    /// \param priorities_ The priorities of the test cases.
+    /// \param test_program_ The test program the test cases belong to.
+    test_case_first(const priorities& priorities_,
+                    const model::test_program& test_program_) :
+        _priorities(priorities_), _test_program(test_program_)
+    {
+    }
+
+    /// Compares two test cases.
+    ///
+    /// \param a The name of the first test case.
+    /// \param b The name of the second test case.
+    ///
+    /// \return True if a has to be returned before b.
+    bool
+    operator()(const std::string& a, const std::string& b) const
+    {
+        return _priorities.of(_test_program, a) <
+            _priorities.of(_test_program, b);
+    }
+};
+
+
+/// Sorts test programs by the priority of their most important test case.
+class test_program_first {
+    /// The priorities of the test cases.
+    const priorities& _priorities;
+
+public:
+    /// Constructor.
+    ///
+    /// \param priorities_ The priorities of the test cases.
+    explicit test_program_first(const priorities& priorities_) :
+        _priorities(priorities_)
+    {
+    }
+
+    /// Compares two test programs.
+    ///
+    /// \param a The first test program.
+    /// \param b The second test program.
+    ///
+    /// \return True if a may have a more important test case than b.
+    bool
+    operator()(const model::test_program_ptr& a,
+               const model::test_program_ptr& b) const
+    {
+        return _priorities.of_test_program(*a) <
+            _priorities.of_test_program(*b);
+    }
+};
+
+
+/// Orders loaded test programs as a heap keyed by their next test case.
+class next_test_case_later {
+    /// The priorities of the test cases.
+    const priorities& _priorities;
+
+public:
+    /// Constructor.
+    ///
+    /// \param priorities_ The priorities of the test cases.
+    explicit next_test_case_later(const priorities& priorities_) :
+        _priorities(priorities_)
+    {
+    }
+
+    /// Compares two loaded test programs.
+    ///
+    /// \param a The first test program; must have test cases left.
+    /// \param b The second test program; must have test cases left.
+    ///
+    /// \return True if the next test case of a has to be returned after the
+    /// next test case of b, which places b closer to the top of the heap.
+    bool
+    operator()(const loaded_test_program& a,
+               const loaded_test_program& b) const
+    {
+        return _priorities.of(*b.first, b.second.front()) <
+            _priorities.of(*a.first, a.second.front());
+    }
+};
+
+
 }  // anonymous namespace
 
 
 /// Internal implementation for the scanner class.
 struct engine::scanner::impl : utils::noncopyable {
-    /// Collection of test programs not yet scanned.
+    /// Collection of test programs not yet processed in any way.
     ///
-    /// The first element in this deque is the "active" test program when
-    /// first_test_cases is defined.
+    /// This only holds the test programs that match the filters.
     std::deque< model::test_program_ptr > pending_test_programs;
 
+    /// Test programs that match the filters but that cannot be processed yet.
+    std::list< model::test_program_ptr > held_test_programs;
+
+    /// Test programs handed out by yield_unlisted() and not yet loaded.
+    std::list< model::test_program_ptr > unlisted_test_programs;
+
+    /// Test programs whose test cases are known, along with the test cases not
+    /// yet scanned, which all match the filters and the shard.
+    ///
+    /// The first element in this deque is the "active" test program.  If the
+    /// test cases have priorities, the deque is a heap of the test programs
+    /// keyed by the priority of their next test case, whose top is the active
+    /// test program.  Test programs are removed as soon as they have no test
+    /// cases left.
+    std::deque< loaded_test_program > loaded_test_programs;
+
     /// Current state of the provided filters.
     engine::filters_state filters;
 
-    /// Collection of test cases not yet scanned.
-    ///
-    /// These are the test cases for the first test program in
-    /// pending_test_programs when such test program is active.
-    optional< std::deque< std::string > > first_test_cases;
+    /// Predicates that the metadata of the returned test cases must satisfy.
+    const std::vector< engine::metadata_filter > metadata_filters;
+
+    /// Subset of the test cases to return; none to return all of them.
+    optional< engine::test_shard > shard;
+
+    /// Changed files that the returned test cases must be affected by; none to
+    /// return all of them.
+    const optional< engine::change_filter > changes;
+
+    /// Test cases not to return, such as those that already ran.  Each
+    /// variant of a test program is skipped separately.
+    engine::variant_test_case_ids_set skipped;
+
+    /// Scheduling priorities of the test cases.
+    const priorities order;
+
+    /// Whether to keep returning the test cases of the same test program.
+    const bool program_affinity;
+
+    /// Test program of the last returned test case, if any.
+    optional< model::test_program_ptr > last_test_program;
 
     /// Constructor.
     ///
     /// \param test_programs_ Collection of test programs to scan through.
     /// \param filters_ List of scan filters as provided by the user.
+    /// \param durations_ Expected durations of the test cases.
+    /// \param shard_ Subset of the test cases to return, if any.
+    /// \param failed_first_ Test cases to return first, if any.
+    /// \param metadata_filters_ Predicates on the metadata of the test cases.
+    /// \param changes_ Changed files that the test cases must be affected by.
+    /// \param program_affinity_ Whether to keep returning the test cases of
+    ///     the same test program.
     impl(const model::test_programs_vector& test_programs_,
-         const std::set< engine::test_filter >& filters_) :
-        pending_test_programs(test_programs_.begin(), test_programs_.end()),
-        filters(filters_)
+         const std::set< engine::test_filter >& filters_,
+         const engine::durations_map& durations_,
+         const optional< engine::test_shard >& shard_,
+         const optional< engine::test_case_ids_set >& failed_first_,
+         const std::vector< engine::metadata_filter >& metadata_filters_,
+         const optional< engine::change_filter >& changes_,
+         const bool program_affinity_) :
+        filters(filters_),
+        metadata_filters(metadata_filters_),
+        shard(shard_),
+        changes(changes_),
+        order(durations_, failed_first_,
+              has_priority_classes(test_programs_)),
+        program_affinity(program_affinity_)
     {
+        // Discard the test programs that cannot match the filters upfront so
+        // that no code path ever loads their test cases list.
+        for (model::test_programs_vector::const_iterator iter =
+                 test_programs_.begin(); iter != test_programs_.end(); ++iter) {
+            if (filters.match_test_program((*iter)->relative_path()))
+                pending_test_programs.push_back(*iter);
+        }
+
+        if (order.enabled()) {
+            // List the test programs with the most important test cases first
+            // so that these test cases become available as early as possible.
+            std::stable_sort(pending_test_programs.begin(),
+                             pending_test_programs.end(),
+                             test_program_first(order));
+        }
     }
 
-    /// Positions the internal state to return the next element if any.
+    /// Checks whether a test case should be returned.
     ///
-    /// \post If there are more elements to read, returns true and
-    /// pending_test_programs[0] points to the active test program and
-    /// first_test_cases[0] has the test case to be returned.
+    /// \param test_program The test program the test case belongs to.
+    /// \param test_case_name The name of the test case.
     ///
-    /// \return True if there is one more result available.
+    /// \return True if the test case matches the filters, the metadata filters,
+    /// the shard and the changed files.
     bool
-    advance(void)
+    wanted(const model::test_program_ptr& test_program,
+           const std::string& test_case_name)
     {
-        for (;;) {
-            if (first_test_cases) {
-                if (first_test_cases.get().empty()) {
-                    pending_test_programs.pop_front();
-                    first_test_cases = none;
-                }
-            }
-            if (pending_test_programs.empty()) {
-                break;
+        const fs::path& path = test_program->relative_path();
+        // Match the filters first so that filters that only select test cases
+        // of other shards are not reported as unused.
+        if (!filters.match_test_case(path, test_case_name))
+            return false;
+        if (!skipped.empty() &&
+            skipped.find(engine::variant_test_case_id(
+                engine::test_case_id(path, test_case_name),
+                test_program->variant())) != skipped.end())
+            return false;
+        if (!metadata_filters.empty()) {
+            const model::properties_map properties = test_program->find(
+                test_case_name).get_metadata().to_properties();
+            for (std::vector< engine::metadata_filter >::const_iterator iter =
+                     metadata_filters.begin(); iter != metadata_filters.end();
+                 ++iter) {
+                if (!(*iter).matches(properties))
+                    return false;
             }
+        }
+        if (shard && !shard.get().matches_test_case(path, test_case_name))
+            return false;
+        return !changes || changes.get().matches_test_case(*test_program,
+                                                           test_case_name);
+    }
 
-            model::test_program_ptr test_program = pending_test_programs[0];
-            if (!first_test_cases) {
-                if (!filters.match_test_program(
-                        test_program->relative_path())) {
-                    pending_test_programs.pop_front();
-                    continue;
-                }
+    /// Records the test cases of a test program for later scanning.
+    ///
+    /// \param test_program The test program to process.  If the test program
+    ///     has not been loaded yet, this loads it synchronously.
+    void
+    add_loaded(const model::test_program_ptr& test_program)
+    {
+        std::deque< std::string > test_cases;
+        const model::test_cases_map& all_test_cases =
+            test_program->test_cases();
+        for (model::test_cases_map::const_iterator iter =
+                 all_test_cases.begin(); iter != all_test_cases.end(); ++iter) {
+            if (wanted(test_program, (*iter).first))
+                test_cases.push_back((*iter).first);
+        }
+        if (test_cases.empty())
+            return;
 
-                first_test_cases = utils::make_optional(
-                    map_keys(test_program->test_cases()));
-            }
+        if (order.enabled())
+            std::stable_sort(test_cases.begin(), test_cases.end(),
+                             test_case_first(order, *test_program));
+        loaded_test_programs.push_back(loaded_test_program(test_program,
+                                                           test_cases));
+        if (order.enabled())
+            std::push_heap(loaded_test_programs.begin(),
+                           loaded_test_programs.end(),
+                           next_test_case_later(order));
+    }
 
-            if (!first_test_cases.get().empty()) {
-                std::deque< std::string >::iterator iter =
-                    first_test_cases.get().begin();
-                const std::string test_case_name = *iter;
-                if (!filters.match_test_case(test_program->relative_path(),
-                                             test_case_name)) {
-                    first_test_cases.get().erase(iter);
-                    continue;
-                }
-                return true;
+    /// Moves the asynchronously-listed test programs that are now loaded.
+    ///
+    /// \return True if any test program was moved; false otherwise.
+    bool
+    collect_listed(void)
+    {
+        bool collected = false;
+        std::list< model::test_program_ptr >::iterator iter =
+            unlisted_test_programs.begin();
+        while (iter != unlisted_test_programs.end()) {
+            if (is_loaded(*iter)) {
+                add_loaded(*iter);
+                iter = unlisted_test_programs.erase(iter);
+                collected = true;
             } else {
-                pending_test_programs.pop_front();
-                first_test_cases = none;
+                ++iter;
             }
         }
+        return collected;
+    }
+
+    /// Checks if the listing of another variant of a test program is pending.
+    ///
+    /// \param test_program The test program to check, which must have been
+    ///     added to unlisted_test_programs already.
+    ///
+    /// \return True if any other test program in unlisted_test_programs shares
+    /// its test cases list with test_program.
+    bool
+    sibling_is_unlisted(const model::test_program_ptr& test_program) const
+    {
+        const scheduler::lazy_test_program* lazy =
+            dynamic_cast< const scheduler::lazy_test_program* >(
+                test_program.get());
+        if (lazy == NULL)
+            return false;
+        for (std::list< model::test_program_ptr >::const_iterator iter =
+                 unlisted_test_programs.begin();
+             iter != unlisted_test_programs.end(); ++iter) {
+            if ((*iter) == test_program)
+                continue;
+            const scheduler::lazy_test_program* other =
+                dynamic_cast< const scheduler::lazy_test_program* >(
+                    (*iter).get());
+            if (other != NULL && lazy->shares_test_cases_with(*other))
+                return true;
+        }
         return false;
     }
 
+    /// Checks if the next pending test program may preempt the active one.
+    ///
+    /// Only the tiers of failed and new test cases and the priority classes
+    /// justify loading more test programs upfront; the durations alone are
+    /// only a best effort.
+    ///
+    /// \return True if the next pending test program may contain a test case
+    /// that has to be returned before the next test case of the active test
+    /// program; false otherwise or if the test cases are not split in tiers.
+    bool
+    pending_goes_first(void) const
+    {
+        if (!order.tiered() || pending_test_programs.empty())
+            return false;
+        const loaded_test_program& active = loaded_test_programs.front();
+        return order.of_test_program(*pending_test_programs[0]) <
+            order.of(*active.first, active.second.front());
+    }
+
+    /// Positions the internal state to return the next element if any.
+    ///
+    /// \param load Whether to synchronously load the test cases list of any
+    ///     pending test program when there are no other test cases available,
+    ///     or when the test program may contain more important test cases
+    ///     than the loaded ones.  Test programs handed out by yield_unlisted()
+    ///     are never loaded.
+    ///
+    /// \post If there are more elements to read, returns true and
+    /// loaded_test_programs[0] points to the active test program and to the
+    /// test case to be returned.
+    ///
+    /// \return True if there is one more result available.
+    bool
+    advance(const bool load)
+    {
+        for (;;) {
+            if (order.enabled())
+                collect_listed();
+
+            if (!loaded_test_programs.empty() && !pending_goes_first())
+                return true;
+
+            if (!order.enabled() && collect_listed())
+                continue;
+
+            if (pending_test_programs.empty())
+                break;
+
+            const model::test_program_ptr test_program =
+                pending_test_programs[0];
+            if (!load && !is_loaded(test_program))
+                break;
+            pending_test_programs.pop_front();
+            add_loaded(test_program);
+        }
+        return !loaded_test_programs.empty();
+    }
+
+    /// Looks for the loaded test program that has to stay active.
+    ///
+    /// With program affinity, the test program of the last returned test case
+    /// keeps going as long as its next test case is in the same tier as the
+    /// most important loaded one, so that its test cases run close together
+    /// in time instead of interleaved with those of other test programs.
+    ///
+    /// \return The position of the test program in loaded_test_programs, or
+    /// none if the top of the heap has to be returned.
+    optional< std::size_t >
+    find_affine(void) const
+    {
+        if (!program_affinity || !last_test_program)
+            return none;
+        const loaded_test_program& top = loaded_test_programs.front();
+        if (top.first == last_test_program.get())
+            return none;
+        for (std::size_t i = 0; i < loaded_test_programs.size(); ++i) {
+            const loaded_test_program& candidate = loaded_test_programs[i];
+            if (candidate.first != last_test_program.get())
+                continue;
+            if (order.of(*candidate.first, candidate.second.front()).tier() !=
+                order.of(*top.first, top.second.front()).tier())
+                return none;
+            return utils::make_optional(i);
+        }
+        return none;
+    }
+
+    /// Records the scan result being returned.
+    ///
+    /// \param result The scan result to return.
+    ///
+    /// \return The scan result.
+    engine::scan_result
+    returned(const engine::scan_result& result)
+    {
+        if (program_affinity && (!last_test_program ||
+                                 last_test_program.get() != result.first))
+            (void)fs::prefetch(result.first->absolute_path());
+        last_test_program = result.first;
+        return result;
+    }
+
     /// Extracts the current element.
     ///
     /// \pre Must be called only if advance() returns true, and immediately
@@ -156,9 +768,49 @@ struct engine::scanner::impl : utils::noncopyable {
     engine::scan_result
     consume(void)
     {
-        const std::string test_case_name = first_test_cases.get()[0];
-        first_test_cases.get().pop_front();
-        return scan_result(pending_test_programs[0], test_case_name);
+        if (!order.enabled()) {
+            loaded_test_program& active = loaded_test_programs.front();
+            const engine::scan_result result(active.first,
+                                             active.second.front());
+            active.second.pop_front();
+            if (active.second.empty())
+                loaded_test_programs.pop_front();
+            return returned(result);
+        }
+
+        const optional< std::size_t > affine = find_affine();
+        if (affine) {
+            // The test program is somewhere in the middle of the heap and its
+            // priority changes once its next test case is consumed, so the
+            // heap has to be rebuilt; there are few loaded test programs.
+            loaded_test_program& active = loaded_test_programs[affine.get()];
+            const engine::scan_result result(active.first,
+                                             active.second.front());
+            active.second.pop_front();
+            if (active.second.empty())
+                loaded_test_programs.erase(loaded_test_programs.begin() +
+                                           affine.get());
+            std::make_heap(loaded_test_programs.begin(),
+                           loaded_test_programs.end(),
+                           next_test_case_later(order));
+            return returned(result);
+        }
+
+        // Move the active test program out of the heap, as its priority
+        // changes once its next test case is consumed, and put it back if it
+        // still has test cases left.
+        std::pop_heap(loaded_test_programs.begin(), loaded_test_programs.end(),
+                      next_test_case_later(order));
+        loaded_test_program& active = loaded_test_programs.back();
+        const engine::scan_result result(active.first, active.second.front());
+        active.second.pop_front();
+        if (active.second.empty())
+            loaded_test_programs.pop_back();
+        else
+            std::push_heap(loaded_test_programs.begin(),
+                           loaded_test_programs.end(),
+                           next_test_case_later(order));
+        return returned(result);
     }
 };
 
@@ -167,9 +819,33 @@ struct engine::scanner::impl : utils::noncopyable {
 ///
 /// \param test_programs Collection of test programs to scan through.
 /// \param filters List of scan filters as provided by the user.
-engine::scanner::scanner(const model::test_programs_vector& test_programs,
-                         const std::set< engine::test_filter >& filters) :
-    _pimpl(new impl(test_programs, filters))
+/// \param durations Expected durations of the test cases, used to return the
+///     longest test cases first.  Test cases not in here are assumed to be
+///     quick.
+/// \param shard If not none, subset of the test cases to return.
+/// \param failed_first If not none, test cases that failed in the previous run
+///     and that have to be returned before any other test case.  Test cases
+///     not in durations are considered new and are returned right after these.
+/// \param metadata_filters Predicates that the metadata of the returned test
+///     cases must all satisfy.
+/// \param changes If not none, changed files that the returned test cases must
+///     be affected by.
+/// \param program_affinity Whether to return the test cases of the same test
+///     program one after the other even if the durations of the test cases
+///     suggest otherwise, and to hint the kernel to prefetch the binary of
+///     every test program that becomes active.  The tiers of previous
+///     failures and new test cases are still honored.
+engine::scanner::scanner(
+    const model::test_programs_vector& test_programs,
+    const std::set< engine::test_filter >& filters,
+    const durations_map& durations,
+    const optional< test_shard >& shard,
+    const optional< test_case_ids_set >& failed_first,
+    const std::vector< metadata_filter >& metadata_filters,
+    const optional< change_filter >& changes,
+    const bool program_affinity) :
+    _pimpl(new impl(test_programs, filters, durations, shard, failed_first,
+                    metadata_filters, changes, program_affinity))
 {
 }
 
@@ -182,12 +858,31 @@ engine::scanner::~scanner(void)
 
 /// Returns the next scan result.
 ///
+/// This loads the test cases list of the test programs synchronously as
+/// necessary, except for those handed out by yield_unlisted().
+///
 /// \return A scan result if there are still pending test cases to be processed,
-/// or none otherwise.
+/// or none otherwise.  Note that none is also returned if the only test cases
+/// left belong to test programs being listed asynchronously.
 optional< engine::scan_result >
 engine::scanner::yield(void)
 {
-    if (_pimpl->advance()) {
+    if (_pimpl->advance(true)) {
+        return utils::make_optional(_pimpl->consume());
+    } else {
+        return none;
+    }
+}
+
+
+/// Returns the next scan result without loading any test program.
+///
+/// \return A scan result if there are test cases available in test programs
+/// whose test cases list is already loaded, or none otherwise.
+optional< engine::scan_result >
+engine::scanner::try_yield(void)
+{
+    if (_pimpl->advance(false)) {
         return utils::make_optional(_pimpl->consume());
     } else {
         return none;
@@ -195,14 +890,274 @@ engine::scanner::yield(void)
 }
 
 
+/// Returns the next test program that needs its test cases list loaded.
+///
+/// The caller is responsible for loading the test cases list of the returned
+/// test program (e.g. via scheduler::scheduler_handle::spawn_list()).  Once
+/// loaded, its test cases are returned by subsequent calls to yield() or
+/// try_yield().  Until then, the test program prevents done() from returning
+/// true.
+///
+/// \return A test program that matches the filters and whose test cases list
+/// has not been loaded yet, or none if there are no more such test programs.
+optional< model::test_program_ptr >
+engine::scanner::yield_unlisted(void)
+{
+    while (!_pimpl->pending_test_programs.empty()) {
+        const model::test_program_ptr test_program =
+            _pimpl->pending_test_programs[0];
+        _pimpl->pending_test_programs.pop_front();
+
+        if (is_loaded(test_program)) {
+            _pimpl->add_loaded(test_program);
+            continue;
+        }
+
+        _pimpl->unlisted_test_programs.push_back(test_program);
+        if (_pimpl->sibling_is_unlisted(test_program)) {
+            // The listing of another variant of this test program will load
+            // this one as well, so there is no need to list it again.
+            continue;
+        }
+        return utils::make_optional(test_program);
+    }
+    return none;
+}
+
+
+/// Excludes some test cases from the scan.
+///
+/// The skipped test cases still count as matches of the filters, so filters
+/// that only select skipped test cases are not reported as unused.  This has
+/// to be called before any test case is returned.
+///
+/// \param test_cases The test cases not to return, e.g. because a previous
+///     session of the same run already executed them.  Only the given
+///     variant of their test programs is skipped.
+void
+engine::scanner::skip(const variant_test_case_ids_set& test_cases)
+{
+    PRE(_pimpl->loaded_test_programs.empty());
+    _pimpl->skipped.insert(test_cases.begin(), test_cases.end());
+}
+
+
+/// Holds back all the test programs whose test cases list is not loaded yet.
+///
+/// The held test programs are not returned until release() or release_all()
+/// lets them go, e.g. once the build has produced their binaries.
+void
+engine::scanner::hold(void)
+{
+    _pimpl->held_test_programs.insert(_pimpl->held_test_programs.end(),
+                                      _pimpl->pending_test_programs.begin(),
+                                      _pimpl->pending_test_programs.end());
+    _pimpl->pending_test_programs.clear();
+}
+
+
+/// Lets the held test programs of a binary be processed.
+///
+/// \param path The path to the binary of the test programs, either absolute
+///     or relative to the root of the test suite.
+///
+/// \return The number of test programs released, which can be more than one
+/// if the binary has several variants or zero if it is not held.
+std::size_t
+engine::scanner::release(const fs::path& path)
+{
+    std::size_t released = 0;
+    std::list< model::test_program_ptr >::iterator iter =
+        _pimpl->held_test_programs.begin();
+    while (iter != _pimpl->held_test_programs.end()) {
+        const fs::path candidate = path.is_absolute() ?
+            (*iter)->absolute_path() : (*iter)->relative_path();
+        if (candidate == path) {
+            _pimpl->pending_test_programs.push_back(*iter);
+            iter = _pimpl->held_test_programs.erase(iter);
+            ++released;
+        } else {
+            ++iter;
+        }
+    }
+
+    if (released > 0 && _pimpl->order.enabled())
+        std::stable_sort(_pimpl->pending_test_programs.begin(),
+                         _pimpl->pending_test_programs.end(),
+                         test_program_first(_pimpl->order));
+    return released;
+}
+
+
+/// Lets all the held test programs be processed.
+void
+engine::scanner::release_all(void)
+{
+    _pimpl->pending_test_programs.insert(
+        _pimpl->pending_test_programs.end(),
+        _pimpl->held_test_programs.begin(), _pimpl->held_test_programs.end());
+    _pimpl->held_test_programs.clear();
+
+    if (_pimpl->order.enabled())
+        std::stable_sort(_pimpl->pending_test_programs.begin(),
+                         _pimpl->pending_test_programs.end(),
+                         test_program_first(_pimpl->order));
+}
+
+
+/// Counts the test programs held back by hold().
+///
+/// \return The number of test programs not released yet.
+std::size_t
+engine::scanner::held_test_programs(void) const
+{
+    return _pimpl->held_test_programs.size();
+}
+
+
 /// Checks whether the scan is finished.
 ///
 /// \return True if the scan is finished, in which case yield() will return
-/// none; false otherwise.
+/// none; false otherwise.  The scan is never finished while there are held
+/// test programs.
 bool
 engine::scanner::done(void)
 {
-    return !_pimpl->advance();
+    return !_pimpl->advance(true) && _pimpl->unlisted_test_programs.empty() &&
+        _pimpl->held_test_programs.empty();
+}
+
+
+/// Counts the test programs whose test cases are not known yet.
+///
+/// \return The number of test programs not yet loaded, including those handed
+/// out by yield_unlisted() whose listing is still in progress and those held
+/// back by hold().
+std::size_t
+engine::scanner::pending_test_programs(void) const
+{
+    return _pimpl->pending_test_programs.size() +
+        _pimpl->unlisted_test_programs.size() +
+        _pimpl->held_test_programs.size();
+}
+
+
+/// Counts the test cases that are ready to be yielded.
+///
+/// \return The number of test cases of the loaded test programs that match the
+/// filters and have not been yielded yet.
+std::size_t
+engine::scanner::queued_test_cases(void) const
+{
+    std::size_t count = 0;
+    for (std::deque< loaded_test_program >::const_iterator iter =
+             _pimpl->loaded_test_programs.begin();
+         iter != _pimpl->loaded_test_programs.end(); ++iter)
+        count += (*iter).second.size();
+    return count;
+}
+
+
+/// Gets the test cases of a test program that are ready to be yielded.
+///
+/// \param test_program The test program to query.
+///
+/// \return The names of the test cases of the test program that match the
+/// filters and have not been yielded yet, or an empty list if the test program
+/// is not loaded.
+std::vector< std::string >
+engine::scanner::queued_test_cases(
+    const model::test_program_ptr& test_program) const
+{
+    for (std::deque< loaded_test_program >::const_iterator iter =
+             _pimpl->loaded_test_programs.begin();
+         iter != _pimpl->loaded_test_programs.end(); ++iter) {
+        if ((*iter).first == test_program)
+            return std::vector< std::string >((*iter).second.begin(),
+                                              (*iter).second.end());
+    }
+    return std::vector< std::string >();
+}
+
+
+/// Gets the test programs whose test cases are going to be yielded next.
+///
+/// \param max The maximum number of test programs to return.
+///
+/// \return The loaded test programs with test cases left, starting with the
+/// active one, followed by the test programs whose test cases list has not
+/// been loaded yet in the order in which they are going to be loaded.  The
+/// test programs being listed asynchronously are not included, as they are
+/// already being executed.
+model::test_programs_vector
+engine::scanner::upcoming_test_programs(const std::size_t max) const
+{
+    model::test_programs_vector test_programs;
+    for (std::deque< loaded_test_program >::const_iterator iter =
+             _pimpl->loaded_test_programs.begin();
+         iter != _pimpl->loaded_test_programs.end() &&
+             test_programs.size() < max; ++iter)
+        test_programs.push_back((*iter).first);
+    for (std::deque< model::test_program_ptr >::const_iterator iter =
+             _pimpl->pending_test_programs.begin();
+         iter != _pimpl->pending_test_programs.end() &&
+             test_programs.size() < max; ++iter)
+        test_programs.push_back(*iter);
+    return test_programs;
+}
+
+
+/// Gets the duration of a test case in the previous run.
+///
+/// \param id The test case to query.
+///
+/// \return The expected duration of the test case, or none if it is unknown.
+optional< datetime::delta >
+engine::scanner::expected_duration(const test_case_id& id) const
+{
+    return _pimpl->order.duration_of(id);
+}
+
+
+/// Gets the expected durations of the test cases not yielded yet.
+///
+/// The test cases of the test programs that are not loaded yet are not known,
+/// so this assumes that they are the same as in the previous run, regardless
+/// of the filters.
+///
+/// \return The durations of the remaining test cases that existed in the
+/// previous run.
+engine::durations_map
+engine::scanner::remaining_durations(void) const
+{
+    durations_map durations;
+    for (std::deque< loaded_test_program >::const_iterator iter =
+             _pimpl->loaded_test_programs.begin();
+         iter != _pimpl->loaded_test_programs.end(); ++iter) {
+        const fs::path& test_program = (*iter).first->relative_path();
+        for (std::deque< std::string >::const_iterator iter2 =
+                 (*iter).second.begin(); iter2 != (*iter).second.end();
+             ++iter2) {
+            const test_case_id id(test_program, *iter2);
+            const optional< datetime::delta > duration =
+                _pimpl->order.duration_of(id);
+            if (duration)
+                durations.insert(std::make_pair(id, duration.get()));
+        }
+    }
+    for (std::deque< model::test_program_ptr >::const_iterator iter =
+             _pimpl->pending_test_programs.begin();
+         iter != _pimpl->pending_test_programs.end(); ++iter)
+        _pimpl->order.add_durations_of((*iter)->relative_path(), durations);
+    for (std::list< model::test_program_ptr >::const_iterator iter =
+             _pimpl->unlisted_test_programs.begin();
+         iter != _pimpl->unlisted_test_programs.end(); ++iter)
+        _pimpl->order.add_durations_of((*iter)->relative_path(), durations);
+    for (std::list< model::test_program_ptr >::const_iterator iter =
+             _pimpl->held_test_programs.begin();
+         iter != _pimpl->held_test_programs.end(); ++iter)
+        _pimpl->order.add_durations_of((*iter)->relative_path(), durations);
+    return durations;
 }
 
 
@@ -214,3 +1169,48 @@ engine::scanner::unused_filters(void) const
 {
     return _pimpl->filters.unused();
 }
+
+
+/// Predicts the time needed to run a collection of tests.
+///
+/// This simulates a scheduler that always starts the longest remaining test in
+/// the least busy slot, which is what the scanner attempts when the expected
+/// durations of the test cases are known.
+///
+/// \param slots The number of tests that can run concurrently.
+/// \param running The remaining time of the tests already running; may have
+///     fewer entries than slots, but not more.
+/// \param pending The expected durations of the tests still to be started.
+///
+/// \return The predicted time until all tests complete.
+datetime::delta
+engine::predict_makespan(const std::size_t slots,
+                         const std::vector< datetime::delta >& running,
+                         const std::vector< datetime::delta >& pending)
+{
+    PRE(slots > 0);
+    PRE(running.size() <= slots);
+
+    std::vector< int64_t > loads;
+    for (std::vector< datetime::delta >::const_iterator iter = running.begin();
+         iter != running.end(); ++iter)
+        loads.push_back((*iter).to_microseconds());
+    loads.resize(slots, 0);
+    std::make_heap(loads.begin(), loads.end(), std::greater< int64_t >());
+
+    std::vector< int64_t > durations;
+    for (std::vector< datetime::delta >::const_iterator iter = pending.begin();
+         iter != pending.end(); ++iter)
+        durations.push_back((*iter).to_microseconds());
+    std::sort(durations.begin(), durations.end(), std::greater< int64_t >());
+
+    for (std::vector< int64_t >::const_iterator iter = durations.begin();
+         iter != durations.end(); ++iter) {
+        std::pop_heap(loads.begin(), loads.end(), std::greater< int64_t >());
+        loads.back() += *iter;
+        std::push_heap(loads.begin(), loads.end(), std::greater< int64_t >());
+    }
+
+    return datetime::delta::from_microseconds(
+        *std::max_element(loads.begin(), loads.end()));
+}
@@ -34,17 +34,46 @@
 
 #include "engine/scanner_fwd.hpp"
 
+#include <cstddef>
+#include <map>
 #include <memory>
 #include <set>
+#include <string>
+#include <utility>
+#include <vector>
 
 #include "engine/filters_fwd.hpp"
 #include "model/test_program_fwd.hpp"
-#include "utils/optional_fwd.hpp"
+#include "utils/datetime.hpp"
+#include "utils/fs/path.hpp"
+#include "utils/optional.hpp"
 #include "utils/shared_ptr.hpp"
 
 namespace engine {
 
 
+/// Identifier of a test case: the relative path to its test program and its
+/// name.
+typedef std::pair< utils::fs::path, std::string > test_case_id;
+
+
+/// Expected durations of test cases.
+typedef std::map< test_case_id, utils::datetime::delta > durations_map;
+
+
+/// Collection of test case identifiers.
+typedef std::set< test_case_id > test_case_ids_set;
+
+
+/// Identifier of a test case within one variant of its test program: the
+/// identifier of the test case and the name of the variant, empty if none.
+typedef std::pair< test_case_id, std::string > variant_test_case_id;
+
+
+/// Collection of identifiers of test cases within variants.
+typedef std::set< variant_test_case_id > variant_test_case_ids_set;
+
+
 /// Scans a list of test programs, yielding one test case at a time.
 ///
 /// This class contains the state necessary to process a collection of test
@@ -53,24 +82,95 @@ namespace engine {
 ///
 /// The scanning algorithm guarantees that test programs are initialized
 /// dynamically, should they need to load their list of test cases from disk.
+/// Test programs that do not match the filters are discarded upfront and their
+/// list of test cases is never loaded.
+///
+/// Callers that want to overlap the loading of test case lists with other work
+/// can use try_yield() and yield_unlisted() instead of yield().  The former
+/// only returns test cases from test programs that are already loaded and the
+/// latter hands out the test programs that still need to be listed so that the
+/// caller can list them asynchronously (e.g. via scheduler::spawn_list()).
+/// Test programs handed out by yield_unlisted() are never loaded synchronously
+/// by the scanner.
 ///
-/// The order of the extraction is not guaranteed.
+/// If metadata filters are provided, only the test cases whose metadata
+/// satisfies all of them are returned.  If a shard is provided, only the test
+/// cases that belong to it are returned, after they have been matched against
+/// the filters.
+///
+/// The order of the extraction is not guaranteed.  If the expected durations of
+/// the test cases are known, the scanner makes a best effort to return the
+/// longest test cases first: when running tests in parallel, starting the
+/// longest tests last would otherwise make them extend the total run time.
+///
+/// If the test cases that failed in a previous run are provided, the scanner
+/// instead returns these first, then the test cases that did not exist in that
+/// run, and then everything else, to report regressions as early as possible.
+/// The longest test cases still go first within each of these groups.  The
+/// scanner keeps the loaded test programs in a priority queue keyed by their
+/// next test case, so this ordering only applies among the test programs
+/// whose test cases are known at any given time.
+///
+/// Regardless of all of the above, the test cases of test programs with the
+/// high priority class go before those with the normal class, which in turn
+/// go before those with the low class.
+///
+/// With program affinity, the scanner instead keeps returning the test cases
+/// of the same test program within each of these groups, so that consecutive
+/// executions of a binary find it in the page cache.
+///
+/// Callers that resume an interrupted run can skip() the test cases that
+/// already ran, which are then never returned.
+///
+/// Callers that run the tests while their binaries are still being built can
+/// hold() the test programs and release() them one at a time as they become
+/// available.  Held test programs are neither loaded nor returned, and they
+/// prevent done() from returning true until they are released.
 class scanner {
     struct impl;
     /// Pointer to the internal implementation data.
     std::shared_ptr< impl > _pimpl;
 
 public:
-    scanner(const model::test_programs_vector&, const std::set< test_filter >&);
+    scanner(const model::test_programs_vector&, const std::set< test_filter >&,
+            const durations_map& = durations_map(),
+            const utils::optional< test_shard >& = utils::none,
+            const utils::optional< test_case_ids_set >& = utils::none,
+            const std::vector< metadata_filter >& =
+                std::vector< metadata_filter >(),
+            const utils::optional< change_filter >& = utils::none,
+            const bool = false);
     ~scanner(void);
 
     bool done(void);
     utils::optional< scan_result > yield(void);
+    utils::optional< scan_result > try_yield(void);
+    utils::optional< model::test_program_ptr > yield_unlisted(void);
+
+    void skip(const variant_test_case_ids_set&);
+    void hold(void);
+    std::size_t release(const utils::fs::path&);
+    void release_all(void);
+    std::size_t held_test_programs(void) const;
+
+    std::size_t pending_test_programs(void) const;
+    std::size_t queued_test_cases(void) const;
+    std::vector< std::string > queued_test_cases(
+        const model::test_program_ptr&) const;
+    model::test_programs_vector upcoming_test_programs(const std::size_t) const;
+    utils::optional< utils::datetime::delta > expected_duration(
+        const test_case_id&) const;
+    durations_map remaining_durations(void) const;
 
     std::set< test_filter > unused_filters(void) const;
 };
 
 
+utils::datetime::delta predict_makespan(
+    const std::size_t, const std::vector< utils::datetime::delta >&,
+    const std::vector< utils::datetime::delta >&);
+
+
 }  // namespace engine
 
 
@@ -31,6 +31,9 @@
 #include <cstdarg>
 #include <cstddef>
 #include <typeinfo>
+#include <string>
+#include <utility>
+#include <vector>
 
 #include <atf-c++.hpp>
 
@@ -38,12 +41,17 @@
 #include "model/metadata.hpp"
 #include "model/test_case.hpp"
 #include "model/test_program.hpp"
+#include "utils/config/tree.ipp"
+#include "utils/datetime.hpp"
 #include "utils/format/containers.ipp"
 #include "utils/fs/path.hpp"
 #include "utils/optional.ipp"
 
+namespace config = utils::config;
+namespace datetime = utils::datetime;
 namespace fs = utils::fs;
 
+using utils::none;
 using utils::optional;
 
 
@@ -332,6 +340,251 @@ ATF_TEST_CASE_BODY(scanner__no_filters__verify_lazy_loads)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(scanner__try_yield__loaded_programs);
+ATF_TEST_CASE_BODY(scanner__try_yield__loaded_programs)
+{
+    const model::test_program_ptr test_program1 = new_test_program(
+        "dir/program1", "foo_test", "bar_test", NULL);
+    const model::test_program_ptr test_program2 = new_test_program(
+        "program2", "lone_test", NULL);
+
+    model::test_programs_vector test_programs;
+    test_programs.push_back(test_program1);
+    test_programs.push_back(test_program2);
+
+    const std::set< engine::test_filter > filters;
+
+    std::set< engine::scan_result > exp_results;
+    exp_results.insert(engine::scan_result(test_program1, "foo_test"));
+    exp_results.insert(engine::scan_result(test_program1, "bar_test"));
+    exp_results.insert(engine::scan_result(test_program2, "lone_test"));
+
+    engine::scanner scanner(test_programs, filters);
+    ATF_REQUIRE_EQ(2, scanner.pending_test_programs());
+    ATF_REQUIRE_EQ(0, scanner.queued_test_cases());
+    ATF_REQUIRE(!scanner.yield_unlisted());
+    std::set< engine::scan_result > results;
+    for (int i = 0; i < 3; ++i) {
+        const optional< engine::scan_result > result = scanner.try_yield();
+        ATF_REQUIRE(result);
+        results.insert(result.get());
+        ATF_REQUIRE_EQ(0, scanner.pending_test_programs());
+        ATF_REQUIRE_EQ(std::size_t(2 - i), scanner.queued_test_cases());
+    }
+    ATF_REQUIRE(!scanner.try_yield());
+    ATF_REQUIRE(!scanner.yield_unlisted());
+    ATF_REQUIRE(scanner.done());
+    ATF_REQUIRE_EQ(0, scanner.pending_test_programs());
+    ATF_REQUIRE_EQ(0, scanner.queued_test_cases());
+
+    ATF_REQUIRE_EQ(exp_results, results);
+    ATF_REQUIRE(scanner.unused_filters().empty());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(scanner__queued_test_cases__of_program);
+ATF_TEST_CASE_BODY(scanner__queued_test_cases__of_program)
+{
+    const model::test_program_ptr test_program1 = new_test_program(
+        "dir/program1", "foo_test", "bar_test", "baz_test", NULL);
+    const model::test_program_ptr test_program2 = new_test_program(
+        "program2", "lone_test", NULL);
+
+    model::test_programs_vector test_programs;
+    test_programs.push_back(test_program1);
+    test_programs.push_back(test_program2);
+
+    std::set< engine::test_filter > filters;
+    filters.insert(engine::test_filter(fs::path("dir/program1"), "foo_test"));
+    filters.insert(engine::test_filter(fs::path("dir/program1"), "baz_test"));
+    filters.insert(engine::test_filter(fs::path("program2"), ""));
+
+    engine::scanner scanner(test_programs, filters);
+    ATF_REQUIRE(scanner.queued_test_cases(test_program1).empty());
+
+    const optional< engine::scan_result > result = scanner.try_yield();
+    ATF_REQUIRE(result);
+    ATF_REQUIRE(result.get().first == test_program1);
+
+    // Only the test cases matching the filters and not yielded yet count.
+    const std::vector< std::string > queued = scanner.queued_test_cases(
+        test_program1);
+    ATF_REQUIRE_EQ(1, queued.size());
+    ATF_REQUIRE(queued[0] != result.get().second);
+    ATF_REQUIRE(queued[0] == "foo_test" || queued[0] == "baz_test");
+
+    ATF_REQUIRE(scanner.try_yield());
+    ATF_REQUIRE(scanner.queued_test_cases(test_program1).empty());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(scanner__upcoming_test_programs);
+ATF_TEST_CASE_BODY(scanner__upcoming_test_programs)
+{
+    const model::test_program_ptr test_program1 = new_test_program(
+        "program1", "a", "b", NULL);
+    const model::test_program_ptr test_program2 = new_test_program(
+        "program2", "c", NULL);
+    const model::test_program_ptr test_program3 = new_test_program(
+        "program3", "d", NULL);
+
+    model::test_programs_vector test_programs;
+    test_programs.push_back(test_program1);
+    test_programs.push_back(test_program2);
+    test_programs.push_back(test_program3);
+
+    engine::scanner scanner(test_programs, std::set< engine::test_filter >());
+    ATF_REQUIRE_EQ(2, scanner.upcoming_test_programs(2).size());
+    ATF_REQUIRE(test_program1 == scanner.upcoming_test_programs(2)[0]);
+    ATF_REQUIRE(test_program2 == scanner.upcoming_test_programs(2)[1]);
+
+    ATF_REQUIRE(engine::scan_result(test_program1, "a") ==
+                scanner.yield().get());
+    ATF_REQUIRE(test_programs == scanner.upcoming_test_programs(10));
+
+    ATF_REQUIRE(engine::scan_result(test_program1, "b") ==
+                scanner.yield().get());
+    ATF_REQUIRE_EQ(2, scanner.upcoming_test_programs(10).size());
+    ATF_REQUIRE(test_program2 == scanner.upcoming_test_programs(10)[0]);
+    ATF_REQUIRE(test_program3 == scanner.upcoming_test_programs(10)[1]);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(scanner__skip);
+ATF_TEST_CASE_BODY(scanner__skip)
+{
+    const model::test_program_ptr test_program1 = new_test_program(
+        "dir/program1", "foo_test", "bar_test", NULL);
+    const model::test_program_ptr test_program2 = new_test_program(
+        "program2", "baz_test", NULL);
+
+    model::test_programs_vector test_programs;
+    test_programs.push_back(test_program1);
+    test_programs.push_back(test_program2);
+
+    std::set< engine::test_filter > filters;
+    filters.insert(engine::test_filter(fs::path("dir/program1"), ""));
+    filters.insert(engine::test_filter(fs::path("program2"), "baz_test"));
+
+    engine::variant_test_case_ids_set skipped;
+    skipped.insert(engine::variant_test_case_id(
+        engine::test_case_id(fs::path("dir/program1"), "foo_test"), ""));
+    skipped.insert(engine::variant_test_case_id(
+        engine::test_case_id(fs::path("program2"), "baz_test"), ""));
+
+    engine::scanner scanner(test_programs, filters);
+    scanner.skip(skipped);
+    ATF_REQUIRE(engine::scan_result(test_program1, "bar_test") ==
+                scanner.yield().get());
+    ATF_REQUIRE(!scanner.yield());
+    ATF_REQUIRE(scanner.done());
+
+    // Filters that only match skipped test cases were still used.
+    ATF_REQUIRE(scanner.unused_filters().empty());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(scanner__skip__variants);
+ATF_TEST_CASE_BODY(scanner__skip__variants)
+{
+    const model::test_program_ptr fast = model::test_program_builder(
+        "unused-interface", fs::path("program"), fs::path("unused-root"),
+        "unused-suite")
+        .add_test_case("foo_test")
+        .set_variant("fast", config::properties_map())
+        .build_ptr();
+    const model::test_program_ptr slow = model::test_program_builder(
+        "unused-interface", fs::path("program"), fs::path("unused-root"),
+        "unused-suite")
+        .add_test_case("foo_test")
+        .set_variant("slow", config::properties_map())
+        .build_ptr();
+
+    model::test_programs_vector test_programs;
+    test_programs.push_back(fast);
+    test_programs.push_back(slow);
+
+    engine::variant_test_case_ids_set skipped;
+    skipped.insert(engine::variant_test_case_id(
+        engine::test_case_id(fs::path("program"), "foo_test"), "fast"));
+
+    engine::scanner scanner(test_programs, std::set< engine::test_filter >());
+    scanner.skip(skipped);
+    const optional< engine::scan_result > result = scanner.yield();
+    ATF_REQUIRE(result);
+    ATF_REQUIRE_EQ("slow", result.get().first->variant());
+    ATF_REQUIRE_EQ("foo_test", result.get().second);
+    ATF_REQUIRE(!scanner.yield());
+    ATF_REQUIRE(scanner.done());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(scanner__hold__release);
+ATF_TEST_CASE_BODY(scanner__hold__release)
+{
+    const model::test_program_ptr test_program1 = new_test_program(
+        "dir/program1", "foo_test", NULL);
+    const model::test_program_ptr test_program2 = new_test_program(
+        "program2", "bar_test", NULL);
+
+    model::test_programs_vector test_programs;
+    test_programs.push_back(test_program1);
+    test_programs.push_back(test_program2);
+
+    engine::scanner scanner(test_programs, std::set< engine::test_filter >());
+    scanner.hold();
+    ATF_REQUIRE_EQ(2, scanner.held_test_programs());
+    ATF_REQUIRE_EQ(2, scanner.pending_test_programs());
+    ATF_REQUIRE(!scanner.yield());
+    ATF_REQUIRE(!scanner.yield_unlisted());
+    ATF_REQUIRE(!scanner.done());
+
+    ATF_REQUIRE_EQ(0, scanner.release(fs::path("program1")));
+    ATF_REQUIRE_EQ(1, scanner.release(fs::path("program2")));
+    ATF_REQUIRE_EQ(0, scanner.release(fs::path("program2")));
+    ATF_REQUIRE_EQ(1, scanner.held_test_programs());
+    ATF_REQUIRE(engine::scan_result(test_program2, "bar_test") ==
+                scanner.yield().get());
+    ATF_REQUIRE(!scanner.yield());
+    ATF_REQUIRE(!scanner.done());
+
+    ATF_REQUIRE_EQ(1, scanner.release(test_program1->absolute_path()));
+    ATF_REQUIRE_EQ(0, scanner.held_test_programs());
+    ATF_REQUIRE(engine::scan_result(test_program1, "foo_test") ==
+                scanner.yield().get());
+    ATF_REQUIRE(scanner.done());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(scanner__hold__release_all);
+ATF_TEST_CASE_BODY(scanner__hold__release_all)
+{
+    const model::test_program_ptr test_program1 = new_test_program(
+        "program1", "foo_test", NULL);
+    const model::test_program_ptr test_program2 = new_test_program(
+        "program2", "bar_test", NULL);
+
+    model::test_programs_vector test_programs;
+    test_programs.push_back(test_program1);
+    test_programs.push_back(test_program2);
+
+    std::set< engine::test_filter > filters;
+    filters.insert(engine::test_filter(fs::path("program2"), ""));
+
+    std::set< engine::scan_result > exp_results;
+    exp_results.insert(engine::scan_result(test_program2, "bar_test"));
+
+    engine::scanner scanner(test_programs, filters);
+    scanner.hold();
+    // Test programs excluded by the filters are never held.
+    ATF_REQUIRE_EQ(1, scanner.held_test_programs());
+    ATF_REQUIRE(!scanner.done());
+    scanner.release_all();
+    ATF_REQUIRE_EQ(0, scanner.held_test_programs());
+    ATF_REQUIRE_EQ(exp_results, yield_all(scanner));
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(scanner__with_filters__no_tests);
 ATF_TEST_CASE_BODY(scanner__with_filters__no_tests)
 {
@@ -460,6 +713,594 @@ ATF_TEST_CASE_BODY(scanner__with_filters__verify_lazy_loads)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(scanner__with_filters__never_load_excluded);
+ATF_TEST_CASE_BODY(scanner__with_filters__never_load_excluded)
+{
+    const model::test_program_ptr test_program1(new mock_test_program(
+        fs::path("first")));
+    const mock_test_program* mock_program1 =
+        dynamic_cast< const mock_test_program* >(test_program1.get());
+    const model::test_program_ptr test_program2(new mock_test_program(
+        fs::path("second")));
+    const mock_test_program* mock_program2 =
+        dynamic_cast< const mock_test_program* >(test_program2.get());
+
+    model::test_programs_vector test_programs;
+    test_programs.push_back(test_program2);
+    test_programs.push_back(test_program1);
+
+    std::set< engine::test_filter > filters;
+    filters.insert(engine::test_filter(fs::path("first"), "two"));
+
+    engine::scanner scanner(test_programs, filters);
+    ATF_REQUIRE(!scanner.yield_unlisted());
+    ATF_REQUIRE_EQ(1, mock_program1->num_calls());
+    ATF_REQUIRE_EQ(0, mock_program2->num_calls());
+
+    const optional< engine::scan_result > result = scanner.try_yield();
+    ATF_REQUIRE(result);
+    ATF_REQUIRE(engine::scan_result(test_program1, "two") == result.get());
+    ATF_REQUIRE(!scanner.try_yield());
+    ATF_REQUIRE(scanner.done());
+    ATF_REQUIRE(scanner.unused_filters().empty());
+
+    ATF_REQUIRE_EQ(1, mock_program1->num_calls());
+    ATF_REQUIRE_EQ(0, mock_program2->num_calls());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(scanner__metadata_filters);
+ATF_TEST_CASE_BODY(scanner__metadata_filters)
+{
+    model::properties_map smoke;
+    smoke["tier"] = "smoke";
+
+    const model::test_program_ptr test_program = model::test_program_builder(
+        "unused-interface", fs::path("program"), fs::path("unused-root"),
+        "unused-suite")
+        .add_test_case("fast", model::metadata_builder()
+                       .set_timeout(datetime::delta(10, 0)).build())
+        .add_test_case("exclusive", model::metadata_builder()
+                       .set_timeout(datetime::delta(10, 0))
+                       .set_is_exclusive(true).build())
+        .add_test_case("slow", model::metadata_builder()
+                       .set_custom(smoke).build())
+        .add_test_case("smoke", model::metadata_builder()
+                       .set_timeout(datetime::delta(10, 0))
+                       .set_custom(smoke).build())
+        .build_ptr();
+
+    model::test_programs_vector test_programs;
+    test_programs.push_back(test_program);
+
+    const std::set< engine::test_filter > filters;
+    std::vector< engine::metadata_filter > metadata_filters;
+    metadata_filters.push_back(engine::metadata_filter::parse("timeout<60"));
+    metadata_filters.push_back(engine::metadata_filter::parse(
+        "is_exclusive=false"));
+
+    {
+        engine::scanner scanner(test_programs, filters,
+                                engine::durations_map(), none, none,
+                                metadata_filters);
+        std::set< engine::scan_result > exp_results;
+        exp_results.insert(engine::scan_result(test_program, "fast"));
+        exp_results.insert(engine::scan_result(test_program, "smoke"));
+        ATF_REQUIRE_EQ(exp_results, yield_all(scanner));
+    }
+
+    metadata_filters.push_back(engine::metadata_filter::parse(
+        "custom.tier=smoke"));
+    {
+        engine::scanner scanner(test_programs, filters,
+                                engine::durations_map(), none, none,
+                                metadata_filters);
+        std::set< engine::scan_result > exp_results;
+        exp_results.insert(engine::scan_result(test_program, "smoke"));
+        ATF_REQUIRE_EQ(exp_results, yield_all(scanner));
+    }
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(scanner__changes);
+ATF_TEST_CASE_BODY(scanner__changes)
+{
+    model::paths_set required_files;
+    required_files.insert(fs::path("/data/input.txt"));
+
+    const model::test_program_ptr test_program1 = model::test_program_builder(
+        "unused-interface", fs::path("first"), fs::path("/root"),
+        "unused-suite")
+        .add_test_case("plain")
+        .add_test_case("with_files", model::metadata_builder()
+                       .set_required_files(required_files).build())
+        .build_ptr();
+    const model::test_program_ptr test_program2 = new_test_program(
+        "second", "a", "b", NULL);
+    const model::test_program_ptr test_program3 = new_test_program(
+        "third", "c", NULL);
+
+    model::test_programs_vector test_programs;
+    test_programs.push_back(test_program1);
+    test_programs.push_back(test_program2);
+    test_programs.push_back(test_program3);
+
+    model::paths_set changed_files;
+    changed_files.insert(fs::path("/data/input.txt"));
+    changed_files.insert(fs::path("/src/third.c"));
+    engine::change_filter::dependencies_map dependencies;
+    dependencies[fs::path("second")].insert(fs::path("/src/second.c"));
+    dependencies[fs::path("third")].insert(fs::path("/src/third.c"));
+
+    engine::scanner scanner(test_programs, std::set< engine::test_filter >(),
+                            engine::durations_map(), none, none,
+                            std::vector< engine::metadata_filter >(),
+                            utils::make_optional(engine::change_filter(
+                                changed_files, dependencies)));
+    std::set< engine::scan_result > exp_results;
+    exp_results.insert(engine::scan_result(test_program1, "with_files"));
+    exp_results.insert(engine::scan_result(test_program3, "c"));
+    ATF_REQUIRE_EQ(exp_results, yield_all(scanner));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(scanner__durations__longest_first);
+ATF_TEST_CASE_BODY(scanner__durations__longest_first)
+{
+    const model::test_program_ptr test_program1 = new_test_program(
+        "first", "a", "b", "c", NULL);
+    const model::test_program_ptr test_program2 = new_test_program(
+        "second", "d", "e", NULL);
+    const model::test_program_ptr test_program3 = new_test_program(
+        "third", "f", NULL);
+
+    model::test_programs_vector test_programs;
+    test_programs.push_back(test_program1);
+    test_programs.push_back(test_program2);
+    test_programs.push_back(test_program3);
+
+    std::set< engine::test_filter > filters;
+    filters.insert(engine::test_filter(fs::path("first"), ""));
+    filters.insert(engine::test_filter(fs::path("second"), ""));
+    filters.insert(engine::test_filter(fs::path("third"), "f"));
+
+    engine::durations_map durations;
+    durations[std::make_pair(fs::path("first"), "b")] =
+        datetime::delta(10, 0);
+    durations[std::make_pair(fs::path("first"), "c")] =
+        datetime::delta(30, 0);
+    durations[std::make_pair(fs::path("second"), "d")] =
+        datetime::delta(20, 0);
+    durations[std::make_pair(fs::path("second"), "e")] =
+        datetime::delta(40, 0);
+
+    // Test programs are loaded one at a time, in order of their longest
+    // test case, and unknown test cases come last.
+    engine::scanner scanner(test_programs, filters, durations);
+    ATF_REQUIRE(engine::scan_result(test_program2, "e") ==
+                scanner.yield().get());
+    ATF_REQUIRE(engine::scan_result(test_program2, "d") ==
+                scanner.yield().get());
+    ATF_REQUIRE(engine::scan_result(test_program1, "c") ==
+                scanner.yield().get());
+    ATF_REQUIRE(engine::scan_result(test_program1, "b") ==
+                scanner.yield().get());
+    ATF_REQUIRE(engine::scan_result(test_program1, "a") ==
+                scanner.yield().get());
+    ATF_REQUIRE(engine::scan_result(test_program3, "f") ==
+                scanner.yield().get());
+    ATF_REQUIRE(!scanner.yield());
+    ATF_REQUIRE(scanner.done());
+    ATF_REQUIRE(scanner.unused_filters().empty());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(scanner__durations__remaining);
+ATF_TEST_CASE_BODY(scanner__durations__remaining)
+{
+    const model::test_program_ptr test_program1 = new_test_program(
+        "first", "a", "b", NULL);
+    const model::test_program_ptr test_program2 = new_test_program(
+        "second", "c", "d", NULL);
+
+    model::test_programs_vector test_programs;
+    test_programs.push_back(test_program1);
+    test_programs.push_back(test_program2);
+
+    engine::durations_map durations;
+    durations[std::make_pair(fs::path("first"), "a")] =
+        datetime::delta(10, 0);
+    durations[std::make_pair(fs::path("first"), "gone")] =
+        datetime::delta(5, 0);
+    durations[std::make_pair(fs::path("second"), "c")] =
+        datetime::delta(20, 0);
+
+    engine::scanner scanner(test_programs, std::set< engine::test_filter >(),
+                            durations);
+    ATF_REQUIRE(!scanner.expected_duration(
+        std::make_pair(fs::path("first"), "b")));
+    ATF_REQUIRE_EQ(datetime::delta(20, 0), scanner.expected_duration(
+        std::make_pair(fs::path("second"), "c")).get());
+
+    // The test cases of the test programs not loaded yet come from history.
+    ATF_REQUIRE(durations == scanner.remaining_durations());
+
+    ATF_REQUIRE(engine::scan_result(test_program2, "c") ==
+                scanner.yield().get());
+    engine::durations_map exp_durations;
+    exp_durations[std::make_pair(fs::path("first"), "a")] =
+        datetime::delta(10, 0);
+    exp_durations[std::make_pair(fs::path("first"), "gone")] =
+        datetime::delta(5, 0);
+    ATF_REQUIRE(exp_durations == scanner.remaining_durations());
+
+    // Once loaded, only the test cases that still exist are accounted for.
+    ATF_REQUIRE(engine::scan_result(test_program2, "d") ==
+                scanner.yield().get());
+    ATF_REQUIRE(engine::scan_result(test_program1, "a") ==
+                scanner.yield().get());
+    ATF_REQUIRE(scanner.remaining_durations().empty());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(predict_makespan__sequential);
+ATF_TEST_CASE_BODY(predict_makespan__sequential)
+{
+    std::vector< datetime::delta > running;
+    running.push_back(datetime::delta(3, 0));
+    std::vector< datetime::delta > pending;
+    pending.push_back(datetime::delta(1, 0));
+    pending.push_back(datetime::delta(5, 500000));
+
+    ATF_REQUIRE_EQ(datetime::delta(9, 500000),
+                   engine::predict_makespan(1, running, pending));
+    ATF_REQUIRE_EQ(datetime::delta(), engine::predict_makespan(
+        1, std::vector< datetime::delta >(), std::vector< datetime::delta >()));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(predict_makespan__parallel);
+ATF_TEST_CASE_BODY(predict_makespan__parallel)
+{
+    std::vector< datetime::delta > running;
+    running.push_back(datetime::delta(4, 0));
+    std::vector< datetime::delta > pending;
+    pending.push_back(datetime::delta(2, 0));
+    pending.push_back(datetime::delta(3, 0));
+    pending.push_back(datetime::delta(3, 0));
+
+    // The longest pending tests go to the idle slots, leaving the shortest
+    // one for the first slot to become free.
+    ATF_REQUIRE_EQ(datetime::delta(6, 0),
+                   engine::predict_makespan(2, running, pending));
+    ATF_REQUIRE_EQ(datetime::delta(4, 0),
+                   engine::predict_makespan(4, running, pending));
+
+    // A single long test dominates regardless of the number of slots.
+    pending.push_back(datetime::delta(60, 0));
+    ATF_REQUIRE_EQ(datetime::delta(60, 0),
+                   engine::predict_makespan(4, running, pending));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(scanner__failed_first__tiers);
+ATF_TEST_CASE_BODY(scanner__failed_first__tiers)
+{
+    const model::test_program_ptr test_program1 = new_test_program(
+        "first", "a", "b", "c", NULL);
+    const model::test_program_ptr test_program2 = new_test_program(
+        "second", "d", "e", NULL);
+    const model::test_program_ptr test_program3 = new_test_program(
+        "third", "f", NULL);
+
+    model::test_programs_vector test_programs;
+    test_programs.push_back(test_program3);
+    test_programs.push_back(test_program2);
+    test_programs.push_back(test_program1);
+
+    engine::durations_map durations;
+    durations[std::make_pair(fs::path("first"), "a")] =
+        datetime::delta(10, 0);
+    durations[std::make_pair(fs::path("first"), "b")] =
+        datetime::delta(5, 0);
+    durations[std::make_pair(fs::path("second"), "d")] =
+        datetime::delta(20, 0);
+    durations[std::make_pair(fs::path("second"), "e")] =
+        datetime::delta(1, 0);
+
+    engine::test_case_ids_set failed;
+    failed.insert(std::make_pair(fs::path("first"), "b"));
+    failed.insert(std::make_pair(fs::path("second"), "e"));
+
+    // Previous failures go first, then the test cases that did not exist in
+    // the previous run, and then the rest; the longest first in each tier.
+    engine::scanner scanner(test_programs, std::set< engine::test_filter >(),
+                            durations, none, utils::make_optional(failed));
+    ATF_REQUIRE(engine::scan_result(test_program1, "b") ==
+                scanner.yield().get());
+    ATF_REQUIRE(engine::scan_result(test_program2, "e") ==
+                scanner.yield().get());
+    const engine::scan_result new1 = scanner.yield().get();
+    const engine::scan_result new2 = scanner.yield().get();
+    ATF_REQUIRE((new1 == engine::scan_result(test_program1, "c") &&
+                 new2 == engine::scan_result(test_program3, "f")) ||
+                (new1 == engine::scan_result(test_program3, "f") &&
+                 new2 == engine::scan_result(test_program1, "c")));
+    ATF_REQUIRE(engine::scan_result(test_program2, "d") ==
+                scanner.yield().get());
+    ATF_REQUIRE(engine::scan_result(test_program1, "a") ==
+                scanner.yield().get());
+    ATF_REQUIRE(!scanner.yield());
+    ATF_REQUIRE(scanner.done());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(scanner__priority_classes);
+ATF_TEST_CASE_BODY(scanner__priority_classes)
+{
+    const model::test_program_ptr low = model::test_program_builder(
+        "unused-interface", fs::path("low"), fs::path("unused-root"),
+        "unused-suite")
+        .add_test_case("a").add_test_case("b")
+        .set_metadata(model::metadata_builder().set_priority("low").build())
+        .build_ptr();
+    const model::test_program_ptr normal = new_test_program(
+        "normal", "c", NULL);
+    const model::test_program_ptr high = model::test_program_builder(
+        "unused-interface", fs::path("high"), fs::path("unused-root"),
+        "unused-suite")
+        .add_test_case("d").add_test_case("e")
+        .set_metadata(model::metadata_builder().set_priority("high").build())
+        .build_ptr();
+
+    model::test_programs_vector test_programs;
+    test_programs.push_back(low);
+    test_programs.push_back(normal);
+    test_programs.push_back(high);
+
+    engine::durations_map durations;
+    durations[std::make_pair(fs::path("low"), "b")] = datetime::delta(30, 0);
+    durations[std::make_pair(fs::path("normal"), "c")] = datetime::delta(20, 0);
+    durations[std::make_pair(fs::path("high"), "e")] = datetime::delta(1, 0);
+
+    engine::test_case_ids_set failed;
+    failed.insert(std::make_pair(fs::path("low"), "a"));
+
+    // The priority classes go before the previous failures and the durations,
+    // which still order the test cases within each class.
+    engine::scanner scanner(test_programs, std::set< engine::test_filter >(),
+                            durations, none, utils::make_optional(failed));
+    ATF_REQUIRE(engine::scan_result(high, "d") == scanner.yield().get());
+    ATF_REQUIRE(engine::scan_result(high, "e") == scanner.yield().get());
+    ATF_REQUIRE(engine::scan_result(normal, "c") == scanner.yield().get());
+    ATF_REQUIRE(engine::scan_result(low, "a") == scanner.yield().get());
+    ATF_REQUIRE(engine::scan_result(low, "b") == scanner.yield().get());
+    ATF_REQUIRE(!scanner.yield());
+    ATF_REQUIRE(scanner.done());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(scanner__failed_first__filters);
+ATF_TEST_CASE_BODY(scanner__failed_first__filters)
+{
+    const model::test_program_ptr test_program1 = new_test_program(
+        "first", "a", "b", NULL);
+    const model::test_program_ptr test_program2 = new_test_program(
+        "second", "c", "d", NULL);
+
+    model::test_programs_vector test_programs;
+    test_programs.push_back(test_program1);
+    test_programs.push_back(test_program2);
+
+    std::set< engine::test_filter > filters;
+    filters.insert(engine::test_filter(fs::path("first"), "a"));
+    filters.insert(engine::test_filter(fs::path("second"), ""));
+    filters.insert(engine::test_filter(fs::path("third"), ""));
+
+    engine::durations_map durations;
+    durations[std::make_pair(fs::path("first"), "a")] =
+        datetime::delta(1, 0);
+    durations[std::make_pair(fs::path("first"), "b")] =
+        datetime::delta(1, 0);
+    durations[std::make_pair(fs::path("second"), "c")] =
+        datetime::delta(1, 0);
+    durations[std::make_pair(fs::path("second"), "d")] =
+        datetime::delta(1, 0);
+
+    engine::test_case_ids_set failed;
+    failed.insert(std::make_pair(fs::path("first"), "b"));
+    failed.insert(std::make_pair(fs::path("second"), "d"));
+
+    engine::scanner scanner(test_programs, filters, durations, none,
+                            utils::make_optional(failed));
+    ATF_REQUIRE(engine::scan_result(test_program2, "d") ==
+                scanner.yield().get());
+    const engine::scan_result rest1 = scanner.yield().get();
+    const engine::scan_result rest2 = scanner.yield().get();
+    ATF_REQUIRE((rest1 == engine::scan_result(test_program1, "a") &&
+                 rest2 == engine::scan_result(test_program2, "c")) ||
+                (rest1 == engine::scan_result(test_program2, "c") &&
+                 rest2 == engine::scan_result(test_program1, "a")));
+    ATF_REQUIRE(!scanner.yield());
+    ATF_REQUIRE(scanner.done());
+
+    std::set< engine::test_filter > exp_filters;
+    exp_filters.insert(engine::test_filter(fs::path("third"), ""));
+    ATF_REQUIRE_EQ(exp_filters, scanner.unused_filters());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(scanner__program_affinity__durations);
+ATF_TEST_CASE_BODY(scanner__program_affinity__durations)
+{
+    const model::test_program_ptr test_program1 = new_test_program(
+        "first", "a", "b", NULL);
+    const model::test_program_ptr test_program2 = new_test_program(
+        "second", "c", "d", NULL);
+
+    model::test_programs_vector test_programs;
+    test_programs.push_back(test_program1);
+    test_programs.push_back(test_program2);
+
+    engine::durations_map durations;
+    durations[std::make_pair(fs::path("first"), "a")] =
+        datetime::delta(30, 0);
+    durations[std::make_pair(fs::path("first"), "b")] =
+        datetime::delta(10, 0);
+    durations[std::make_pair(fs::path("second"), "c")] =
+        datetime::delta(20, 0);
+    durations[std::make_pair(fs::path("second"), "d")] =
+        datetime::delta(5, 0);
+
+    {
+        engine::scanner scanner(test_programs,
+                                std::set< engine::test_filter >(), durations);
+        ATF_REQUIRE(!scanner.yield_unlisted());
+        ATF_REQUIRE(engine::scan_result(test_program1, "a") ==
+                    scanner.yield().get());
+        ATF_REQUIRE(engine::scan_result(test_program2, "c") ==
+                    scanner.yield().get());
+        ATF_REQUIRE(engine::scan_result(test_program1, "b") ==
+                    scanner.yield().get());
+        ATF_REQUIRE(engine::scan_result(test_program2, "d") ==
+                    scanner.yield().get());
+        ATF_REQUIRE(!scanner.yield());
+    }
+
+    {
+        engine::scanner scanner(test_programs,
+                                std::set< engine::test_filter >(), durations,
+                                none, none,
+                                std::vector< engine::metadata_filter >(), none,
+                                true);
+        ATF_REQUIRE(!scanner.yield_unlisted());
+        ATF_REQUIRE(engine::scan_result(test_program1, "a") ==
+                    scanner.yield().get());
+        ATF_REQUIRE(engine::scan_result(test_program1, "b") ==
+                    scanner.yield().get());
+        ATF_REQUIRE(engine::scan_result(test_program2, "c") ==
+                    scanner.yield().get());
+        ATF_REQUIRE(engine::scan_result(test_program2, "d") ==
+                    scanner.yield().get());
+        ATF_REQUIRE(!scanner.yield());
+        ATF_REQUIRE(scanner.done());
+    }
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(scanner__program_affinity__tiers);
+ATF_TEST_CASE_BODY(scanner__program_affinity__tiers)
+{
+    const model::test_program_ptr test_program1 = new_test_program(
+        "first", "a", "b", NULL);
+    const model::test_program_ptr test_program2 = new_test_program(
+        "second", "c", "d", "e", NULL);
+
+    model::test_programs_vector test_programs;
+    test_programs.push_back(test_program1);
+    test_programs.push_back(test_program2);
+
+    engine::durations_map durations;
+    durations[std::make_pair(fs::path("first"), "a")] =
+        datetime::delta(1, 0);
+    durations[std::make_pair(fs::path("first"), "b")] =
+        datetime::delta(10, 0);
+    durations[std::make_pair(fs::path("second"), "c")] =
+        datetime::delta(2, 0);
+    durations[std::make_pair(fs::path("second"), "d")] =
+        datetime::delta(20, 0);
+    durations[std::make_pair(fs::path("second"), "e")] =
+        datetime::delta(5, 0);
+
+    engine::test_case_ids_set failed;
+    failed.insert(std::make_pair(fs::path("first"), "a"));
+    failed.insert(std::make_pair(fs::path("second"), "c"));
+
+    // The affinity never lets a test program skip ahead of the previous
+    // failures of other test programs.
+    engine::scanner scanner(test_programs, std::set< engine::test_filter >(),
+                            durations, none, utils::make_optional(failed),
+                            std::vector< engine::metadata_filter >(), none,
+                            true);
+    ATF_REQUIRE(!scanner.yield_unlisted());
+    ATF_REQUIRE(engine::scan_result(test_program2, "c") ==
+                scanner.yield().get());
+    ATF_REQUIRE(engine::scan_result(test_program1, "a") ==
+                scanner.yield().get());
+    ATF_REQUIRE(engine::scan_result(test_program1, "b") ==
+                scanner.yield().get());
+    ATF_REQUIRE(engine::scan_result(test_program2, "d") ==
+                scanner.yield().get());
+    ATF_REQUIRE(engine::scan_result(test_program2, "e") ==
+                scanner.yield().get());
+    ATF_REQUIRE(!scanner.yield());
+    ATF_REQUIRE(scanner.done());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(scanner__shard__partition);
+ATF_TEST_CASE_BODY(scanner__shard__partition)
+{
+    model::test_programs_vector test_programs;
+    test_programs.push_back(new_test_program(
+        "dir/program1", "a", "b", "c", "d", "e", "f", NULL));
+    test_programs.push_back(new_test_program(
+        "program2", "g", "h", "i", "j", NULL));
+
+    engine::scanner all_scanner(test_programs,
+                                std::set< engine::test_filter >());
+    const std::set< engine::scan_result > all_results = yield_all(all_scanner);
+
+    std::set< engine::scan_result > union_results;
+    std::size_t total = 0;
+    for (std::size_t index = 1; index <= 3; ++index) {
+        const engine::test_shard shard(index, 3);
+        engine::scanner scanner(test_programs,
+                                std::set< engine::test_filter >(),
+                                engine::durations_map(),
+                                utils::make_optional(shard));
+        const std::set< engine::scan_result > results = yield_all(scanner);
+        for (std::set< engine::scan_result >::const_iterator
+                 iter = results.begin(); iter != results.end(); ++iter) {
+            ATF_REQUIRE(shard.matches_test_case((*iter).first->relative_path(),
+                                                (*iter).second));
+        }
+        total += results.size();
+        union_results.insert(results.begin(), results.end());
+    }
+    ATF_REQUIRE_EQ(all_results.size(), total);
+    ATF_REQUIRE_EQ(all_results, union_results);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(scanner__shard__filters_in_other_shards);
+ATF_TEST_CASE_BODY(scanner__shard__filters_in_other_shards)
+{
+    const model::test_program_ptr test_program = new_test_program(
+        "program", "a", "b", "c", NULL);
+    model::test_programs_vector test_programs;
+    test_programs.push_back(test_program);
+
+    std::set< engine::test_filter > filters;
+    filters.insert(engine::test_filter(fs::path("program"), "a"));
+    filters.insert(engine::test_filter(fs::path("program"), "b"));
+
+    const engine::test_shard shard(1, 2);
+    engine::scanner scanner(test_programs, filters, engine::durations_map(),
+                            utils::make_optional(shard));
+    const std::set< engine::scan_result > results = yield_all(scanner);
+    for (std::set< engine::scan_result >::const_iterator
+             iter = results.begin(); iter != results.end(); ++iter) {
+        ATF_REQUIRE((*iter).second == "a" || (*iter).second == "b");
+        ATF_REQUIRE(shard.matches_test_case(fs::path("program"),
+                                            (*iter).second));
+    }
+
+    // Filters that matched test cases of another shard were still used.
+    ATF_REQUIRE(scanner.unused_filters().empty());
+}
+
+
 ATF_INIT_TEST_CASES(tcs)
 {
     ATF_ADD_TEST_CASE(tcs, scanner__no_filters__no_tests);
@@ -468,9 +1309,33 @@ ATF_INIT_TEST_CASES(tcs)
     ATF_ADD_TEST_CASE(tcs, scanner__no_filters__many_tests_in_one_program);
     ATF_ADD_TEST_CASE(tcs, scanner__no_filters__many_tests_per_many_programs);
     ATF_ADD_TEST_CASE(tcs, scanner__no_filters__verify_lazy_loads);
+    ATF_ADD_TEST_CASE(tcs, scanner__try_yield__loaded_programs);
+    ATF_ADD_TEST_CASE(tcs, scanner__queued_test_cases__of_program);
+    ATF_ADD_TEST_CASE(tcs, scanner__upcoming_test_programs);
+    ATF_ADD_TEST_CASE(tcs, scanner__skip);
+    ATF_ADD_TEST_CASE(tcs, scanner__skip__variants);
+    ATF_ADD_TEST_CASE(tcs, scanner__hold__release);
+    ATF_ADD_TEST_CASE(tcs, scanner__hold__release_all);
 
     ATF_ADD_TEST_CASE(tcs, scanner__with_filters__no_tests);
     ATF_ADD_TEST_CASE(tcs, scanner__with_filters__no_matches);
     ATF_ADD_TEST_CASE(tcs, scanner__with_filters__some_matches);
     ATF_ADD_TEST_CASE(tcs, scanner__with_filters__verify_lazy_loads);
+    ATF_ADD_TEST_CASE(tcs, scanner__with_filters__never_load_excluded);
+    ATF_ADD_TEST_CASE(tcs, scanner__metadata_filters);
+    ATF_ADD_TEST_CASE(tcs, scanner__changes);
+
+    ATF_ADD_TEST_CASE(tcs, scanner__durations__longest_first);
+    ATF_ADD_TEST_CASE(tcs, scanner__durations__remaining);
+    ATF_ADD_TEST_CASE(tcs, scanner__failed_first__tiers);
+    ATF_ADD_TEST_CASE(tcs, scanner__failed_first__filters);
+    ATF_ADD_TEST_CASE(tcs, scanner__priority_classes);
+    ATF_ADD_TEST_CASE(tcs, scanner__program_affinity__durations);
+    ATF_ADD_TEST_CASE(tcs, scanner__program_affinity__tiers);
+
+    ATF_ADD_TEST_CASE(tcs, scanner__shard__partition);
+    ATF_ADD_TEST_CASE(tcs, scanner__shard__filters_in_other_shards);
+
+    ATF_ADD_TEST_CASE(tcs, predict_makespan__sequential);
+    ATF_ADD_TEST_CASE(tcs, predict_makespan__parallel);
 }
@@ -29,22 +29,35 @@
 #include "engine/scheduler.hpp"
 
 extern "C" {
+#include <sys/stat.h>
+
+#include <fcntl.h>
+#include <poll.h>
 #include <unistd.h>
 }
 
+#include <algorithm>
+#include <cerrno>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <deque>
 #include <fstream>
+#include <map>
 #include <stdexcept>
+#include <utility>
+#include <vector>
 
 #include "engine/config.hpp"
 #include "engine/exceptions.hpp"
+#include "engine/list_cache.hpp"
 #include "engine/requirements.hpp"
 #include "model/context.hpp"
 #include "model/metadata.hpp"
 #include "model/test_case.hpp"
 #include "model/test_program.hpp"
 #include "model/test_result.hpp"
+#include "utils/config/keys.hpp"
 #include "utils/config/tree.ipp"
 #include "utils/datetime.hpp"
 #include "utils/defs.hpp"
@@ -54,17 +67,22 @@ extern "C" {
 #include "utils/fs/exceptions.hpp"
 #include "utils/fs/operations.hpp"
 #include "utils/fs/path.hpp"
+#include "utils/latency_histogram.hpp"
 #include "utils/logging/macros.hpp"
 #include "utils/noncopyable.hpp"
 #include "utils/optional.ipp"
 #include "utils/passwd.hpp"
 #include "utils/process/executor.ipp"
+#include "utils/process/isolation.hpp"
+#include "utils/process/operations.hpp"
+#include "utils/process/resource_usage.hpp"
 #include "utils/process/status.hpp"
 #include "utils/sanity.hpp"
 #include "utils/shared_ptr.hpp"
 #include "utils/stacktrace.hpp"
 #include "utils/stream.hpp"
 #include "utils/text/operations.ipp"
+#include "utils/units.hpp"
 
 namespace config = utils::config;
 namespace datetime = utils::datetime;
@@ -75,6 +93,7 @@ namespace passwd = utils::passwd;
 namespace process = utils::process;
 namespace scheduler = engine::scheduler;
 namespace text = utils::text;
+namespace units = utils::units;
 
 using utils::none;
 using utils::optional;
@@ -94,25 +113,98 @@ datetime::delta scheduler::cleanup_timeout(60, 0);
 datetime::delta scheduler::list_timeout(300, 0);
 
 
+/// Maximum number of stacktraces of crashed subprocesses to gather at once.
+///
+/// Each stacktrace runs GDB, which can take a long time on large cores, so
+/// this bounds the load caused by many simultaneous crashes.  Crashes that
+/// exceed the limit wait for a previous stacktrace to complete.
+std::size_t scheduler::max_stacktrace_jobs = 2;
+
+
+/// Descriptor where exec_test() finds the write end of the result pipe.
+///
+/// The number is high so that it does not collide with the descriptors that
+/// test programs open for themselves, such as those used by shell scripts.
+const int scheduler::result_fd = 100;
+
+
 namespace {
 
 
 /// Magic exit status to indicate that the test case was probably skipped.
 ///
 /// The test case was only skipped if and only if we return this exit code and
-/// we find the skipped_cookie file on disk.
+/// we know the skip reason: either because the parent computed it before
+/// spawning the test, or because the child sent it through the status pipe or
+/// left it in the skipped_cookie file.
 static const int exit_skipped = 84;
 
 
 /// Text file containing the skip reason for the test case.
 ///
-/// This will only be present within unique_work_directory if the test case
-/// exited with the exit_skipped code.  However, there is no guarantee that the
-/// file is there (say if the test really decided to exit with code exit_skipped
-/// on its own).
+/// This is only used as a fallback when no status pipe could be set up for the
+/// test case.  It will only be present within unique_work_directory if the test
+/// case exited with the exit_skipped code.  However, there is no guarantee that
+/// the file is there (say if the test really decided to exit with code
+/// exit_skipped on its own).
 static const char* skipped_cookie = "skipped.txt";
 
 
+/// Magic exit status to indicate that the test case could not be set up.
+///
+/// Like exit_skipped, this only denotes a broken test case if the child sent
+/// the reason through the status pipe or left it in the broken_cookie file.
+static const int exit_broken = 85;
+
+
+/// Text file containing the reason for which the test case is broken.
+///
+/// This is only used as a fallback when no status pipe could be set up for the
+/// test case, just like skipped_cookie.
+static const char* broken_cookie = "broken.txt";
+
+
+/// Key of the atf_result_pipe configuration variable.
+static const config::key_handle atf_result_pipe_key("atf_result_pipe");
+
+
+/// Time to wait for data in the result pipes before checking for exits.
+///
+/// A child is usually noticed as soon as it terminates because that closes its
+/// result pipe; this only bounds the delay for those whose pipe is still held
+/// open by someone else.
+static const int result_pipes_poll_msec = 10;
+
+
+/// Key of the enforce_required_memory configuration variable.
+static const config::key_handle enforce_required_memory_key(
+    "enforce_required_memory");
+
+
+/// Key of the max_core_size configuration variable.
+static const config::key_handle max_core_size_key("max_core_size");
+
+
+/// Key of the max_cpu_time configuration variable.
+static const config::key_handle max_cpu_time_key("max_cpu_time");
+
+
+/// Key of the max_output_size configuration variable.
+static const config::key_handle max_output_size_key("max_output_size");
+
+
+/// Key of the unprivileged_user configuration variable.
+static const config::key_handle unprivileged_user_key("unprivileged_user");
+
+
+/// Immutable set of configuration variables shared by the tests of a suite.
+typedef std::shared_ptr< const config::properties_map > properties_map_ptr;
+
+
+/// Shared pointer to the execution plan of a test program.
+typedef std::shared_ptr< const scheduler::exec_plan > exec_plan_ptr;
+
+
 /// Mapping of interface names to interface definitions.
 typedef std::map< std::string, std::shared_ptr< scheduler::interface > >
     interfaces_map;
@@ -158,6 +250,240 @@ append_files_listing(const fs::path& dir_path, const fs::path& output_file)
 }
 
 
+/// Formats a time delta as a number of seconds for a result reason.
+///
+/// \param delta The time delta to format.
+///
+/// \return A user-friendly representation of the delta.
+static std::string
+format_seconds(const datetime::delta& delta)
+{
+    return F("%.3ss") % (delta.seconds + (delta.useconds / 1000000.0));
+}
+
+
+/// Computes the maximum size of the output files of a test case.
+///
+/// \param test_case The test case being executed.
+/// \param user_config User-provided configuration variables.
+///
+/// \return The number of bytes to keep of each output file, or 0 if the
+/// output is not bounded.
+static units::bytes
+output_limit(const model::test_case& test_case,
+             const config::tree& user_config)
+{
+    const units::bytes limit = test_case.get_metadata().max_output_size();
+    if (limit > units::bytes(0))
+        return limit;
+    else if (user_config.is_set(max_output_size_key))
+        return user_config.lookup< engine::bytes_node >(max_output_size_key);
+    else
+        return units::bytes(0);
+}
+
+
+/// Imposes the configured resource limits on the current process.
+///
+/// The declared required_memory of the test case becomes a hard limit on its
+/// address space if enforce_required_memory is set, max_cpu_time bounds the
+/// CPU time it can consume and max_core_size caps the cores it dumps.  All of
+/// them are inherited by the test program.
+///
+/// \param test_case The test case about to be executed.
+/// \param user_config User-provided configuration variables.
+static void
+limit_test_resources(const model::test_case& test_case,
+                     const config::tree& user_config)
+{
+    optional< units::bytes > max_memory;
+    if (user_config.is_set(enforce_required_memory_key) &&
+        user_config.lookup< config::bool_node >(enforce_required_memory_key)) {
+        const units::bytes required =
+            test_case.get_metadata().required_memory();
+        if (required > units::bytes(0))
+            max_memory = required;
+    }
+
+    optional< datetime::delta > max_cpu_time;
+    if (user_config.is_set(max_cpu_time_key))
+        max_cpu_time = datetime::delta(
+            user_config.lookup< config::positive_int_node >(max_cpu_time_key),
+            0);
+
+    process::limit_resources(max_memory, max_cpu_time);
+
+    if (user_config.is_set(max_core_size_key))
+        (void)utils::limit_core_size(
+            user_config.lookup< engine::bytes_node >(max_core_size_key));
+}
+
+
+/// Copies the fixtures of a test case into its work directory.
+///
+/// Each fixture is staged under its basename at the top of the work directory.
+/// Relative fixture paths are resolved against the directory that contains
+/// the test program.
+///
+/// \param test_program The test program that contains the test case; must
+///     have absolute paths.
+/// \param test_case The test case about to be executed.
+/// \param work_directory Path to where the test case will be run.
+///
+/// \throw fs::error If any of the fixtures cannot be copied.
+static void
+stage_fixtures(const model::test_program& test_program,
+               const model::test_case& test_case,
+               const fs::path& work_directory)
+{
+    const model::paths_set& fixtures = test_case.get_metadata().fixtures();
+    for (model::paths_set::const_iterator iter = fixtures.begin();
+         iter != fixtures.end(); ++iter) {
+        const fs::path source = (*iter).is_absolute() ? *iter :
+            test_program.absolute_path().branch_path() / *iter;
+        fs::copy_tree(source, work_directory / (*iter).leaf_name());
+    }
+}
+
+
+/// Shrinks an output file to its head and tail if it exceeds a limit.
+///
+/// The first and last halves of the limit are kept, with a marker line in
+/// between that records how large the file originally was.  The contents are
+/// moved in place in bounded chunks so that memory usage is independent of the
+/// size of the file.
+///
+/// \param output_file The file to shrink.
+/// \param limit Maximum number of bytes of the original contents to keep, or 0
+///     to keep the file untouched.
+///
+/// \throw engine::error If there are problems shrinking the file.
+static void
+truncate_output(const fs::path& output_file, const units::bytes& limit)
+{
+    if (limit == units::bytes(0))
+        return;
+
+    const int fd = ::open(output_file.c_str(), O_RDWR);
+    if (fd == -1) {
+        throw engine::error(F("Failed to open output file %s: %s")
+                            % output_file % std::strerror(errno));
+    }
+    try {
+        struct ::stat sb;
+        if (::fstat(fd, &sb) == -1)
+            throw engine::error(F("Failed to stat output file %s: %s")
+                                % output_file % std::strerror(errno));
+        const uint64_t size = sb.st_size;
+
+        const uint64_t head = limit / 2;
+        const uint64_t tail = limit - head;
+        const std::string marker = F("\n[... %s bytes of output truncated by "
+                                     "kyua; %s bytes in total ...]\n") %
+            (size - std::min(size, head + tail)) % size;
+        // Only shrink the file if this yields a smaller one; this also
+        // guarantees that the tail never overlaps the marker we write in front
+        // of it so we can move it with forward copies.
+        if (size <= head + marker.length() + tail) {
+            ::close(fd);
+            return;
+        }
+        LI(F("Truncating output file %s from %s bytes") % output_file % size);
+
+        if (::pwrite(fd, marker.c_str(), marker.length(), head) !=
+            static_cast< ssize_t >(marker.length()))
+            throw engine::error(F("Failed to write to output file %s")
+                                % output_file);
+
+        char buffer[64 * 1024];
+        uint64_t src = size - tail;
+        uint64_t dst = head + marker.length();
+        while (src < size) {
+            const std::size_t chunk = static_cast< std::size_t >(
+                std::min(static_cast< uint64_t >(sizeof(buffer)), size - src));
+            if (::pread(fd, buffer, chunk, src) !=
+                static_cast< ssize_t >(chunk) ||
+                ::pwrite(fd, buffer, chunk, dst) !=
+                static_cast< ssize_t >(chunk))
+                throw engine::error(F("Failed to move the tail of output file "
+                                      "%s") % output_file);
+            src += chunk;
+            dst += chunk;
+        }
+
+        if (::ftruncate(fd, dst) == -1)
+            throw engine::error(F("Failed to truncate output file %s: %s")
+                                % output_file % std::strerror(errno));
+    } catch (...) {
+        ::close(fd);
+        throw;
+    }
+    ::close(fd);
+}
+
+
+/// Creates the status pipe through which a test child reports back.
+///
+/// Both ends are closed on exec so that the test programs never see them, and
+/// the read end is non-blocking so that the parent can drain it once the child
+/// has terminated even if other children still hold copies of the write end.
+///
+/// \return The read and write ends of the pipe, or none if the pipe could not
+/// be created; in that case callers must fall back to the skipped_cookie.
+static optional< std::pair< int, int > >
+open_status_pipe(void)
+{
+    int fds[2];
+    if (::pipe(fds) == -1) {
+        const int original_errno = errno;
+        LW(F("Failed to create status pipe: %s; falling back to files") %
+           std::strerror(original_errno));
+        return none;
+    }
+    (void)::fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    (void)::fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+    (void)::fcntl(fds[0], F_SETFL, ::fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+    return utils::make_optional(std::make_pair(fds[0], fds[1]));
+}
+
+
+/// Reads the data currently available in the read end of a status pipe.
+///
+/// \param fd The non-blocking read end of the status pipe.
+/// \param [in,out] data Buffer to which to append the read data.
+///
+/// \return True if all the writers have closed the pipe; false if the pipe is
+/// merely empty for now.
+static bool
+read_status_pipe(const int fd, std::string& data)
+{
+    char buffer[4096];
+    for (;;) {
+        const ssize_t length = ::read(fd, buffer, sizeof(buffer));
+        if (length > 0)
+            data.append(buffer, length);
+        else if (length == -1 && errno == EINTR)
+            continue;
+        else
+            return length == 0;
+    }
+}
+
+
+/// Reads all the data sent by a terminated child through its status pipe.
+///
+/// \param fd The read end of the status pipe.
+///
+/// \return The sent data, which is empty if the child sent nothing.
+static std::string
+drain_status_pipe(const int fd)
+{
+    std::string data;
+    (void)read_status_pipe(fd, data);
+    return data;
+}
+
+
 /// Maintenance data held while a test is being executed.
 ///
 /// This data structure exists from the moment when a test is executed via
@@ -200,6 +526,9 @@ struct test_exec_data : public exec_data {
     /// routine (if any).
     const config::tree user_config;
 
+    /// Configuration variables passed to the test, reused by its cleanup.
+    const properties_map_ptr vars;
+
     /// Whether this test case still needs to have its cleanup routine executed.
     ///
     /// This is set externally when the cleanup routine is actually invoked to
@@ -213,21 +542,161 @@ struct test_exec_data : public exec_data {
     /// as indicated by needs_cleanup.
     optional< executor::exit_handle > exit_handle;
 
+    /// Maximum size of each output file of the test, or 0 if unbounded.
+    units::bytes max_output_size;
+
+    /// Reason to skip the test with, as determined before spawning it.
+    ///
+    /// If not empty, the child terminates with exit_skipped without running
+    /// the test and without reporting anything back.
+    const std::string skip_reason;
+
+    /// Read end of the status pipe of the child, or -1 if there is none.
+    int status_fd;
+
+    /// Whether the child reports its result through a pipe.
+    const bool has_result_pipe;
+
+    /// Read end of the result pipe of the child, or -1 if there is none or if
+    /// the child has already closed its end.
+    int result_fd;
+
+    /// Data received so far through the result pipe.
+    std::string piped_result;
+
+    /// Timeout armed for the body in place of the declared one, if any.
+    const optional< datetime::delta > adaptive_timeout;
+
     /// Constructor.
     ///
     /// \param test_program_ Test program data for this test case.
-    /// \param test_case_name_ Name of the test case.
+    /// \param test_case The test case, as already resolved by the caller.
     /// \param interface_ Test program-specific execution interface.
     /// \param user_config_ User configuration passed to the test.
+    /// \param vars_ Configuration variables passed to the test.
+    /// \param skip_reason_ Reason to skip the test with; empty to run it.
+    /// \param status_fd_ Read end of the status pipe, or -1 if none.  The new
+    ///     object takes ownership of the descriptor.
+    /// \param result_fd_ Read end of the result pipe, or -1 if none.  The new
+    ///     object takes ownership of the descriptor.
+    /// \param adaptive_timeout_ Timeout armed for the body if it is shorter
+    ///     than the declared one; none otherwise.
     test_exec_data(const model::test_program_ptr test_program_,
-                   const std::string& test_case_name_,
+                   const model::test_case& test_case,
                    const std::shared_ptr< scheduler::interface > interface_,
-                   const config::tree& user_config_) :
-        exec_data(test_program_, test_case_name_),
-        interface(interface_), user_config(user_config_)
+                   const config::tree& user_config_,
+                   const properties_map_ptr vars_,
+                   const std::string& skip_reason_,
+                   const int status_fd_,
+                   const int result_fd_,
+                   const optional< datetime::delta >& adaptive_timeout_) :
+        exec_data(test_program_, test_case.name()),
+        interface(interface_), user_config(user_config_), vars(vars_),
+        skip_reason(skip_reason_), status_fd(status_fd_),
+        has_result_pipe(result_fd_ != -1), result_fd(result_fd_),
+        adaptive_timeout(adaptive_timeout_)
     {
-        const model::test_case& test_case = test_program->find(test_case_name);
         needs_cleanup = test_case.get_metadata().has_cleanup();
+        max_output_size = output_limit(test_case, user_config);
+    }
+
+    /// Destructor.
+    ~test_exec_data(void)
+    {
+        if (status_fd != -1)
+            ::close(status_fd);
+        if (result_fd != -1)
+            ::close(result_fd);
+    }
+
+    /// Computes the result of the terminated child.
+    ///
+    /// \param handle The exit handle of the child.
+    ///
+    /// \return The result as computed by the interface of the test program.
+    model::test_result
+    compute_result(const executor::exit_handle& handle)
+    {
+        if (!has_result_pipe)
+            return interface->compute_result(
+                handle.status(), handle.control_directory(),
+                handle.stdout_file(), handle.stderr_file());
+
+        if (result_fd != -1) {
+            // Subprocesses of the test may still hold the write end, so do not
+            // wait for the pipe to be closed.
+            (void)read_status_pipe(result_fd, piped_result);
+            ::close(result_fd);
+            result_fd = -1;
+        }
+        return interface->compute_piped_result(
+            handle.status(), handle.control_directory(),
+            handle.stdout_file(), handle.stderr_file(), piped_result);
+    }
+
+    /// Reads the data that the running child has sent through its result pipe.
+    ///
+    /// The pipe has a limited capacity, so it must be drained while the child
+    /// runs: otherwise, a child with a large result would block forever.
+    void
+    read_result_pipe(void)
+    {
+        if (result_fd != -1 && read_status_pipe(result_fd, piped_result)) {
+            ::close(result_fd);
+            result_fd = -1;
+        }
+    }
+
+    /// Computes the reason for which the terminated child skipped the test.
+    ///
+    /// \param control_directory Control directory of the child, where the
+    ///     skipped_cookie lives if there was no status pipe.
+    ///
+    /// \return The skip reason, or none if the child did not skip the test.
+    optional< std::string >
+    child_skip_reason(const fs::path& control_directory)
+    {
+        if (!skip_reason.empty())
+            return utils::make_optional(skip_reason);
+
+        return read_reason(control_directory / skipped_cookie);
+    }
+
+    /// Computes the reason for which the terminated child broke the test.
+    ///
+    /// \param control_directory Control directory of the child, where the
+    ///     broken_cookie lives if there was no status pipe.
+    ///
+    /// \return The reason, or none if the child did not report any.
+    optional< std::string >
+    child_broken_reason(const fs::path& control_directory)
+    {
+        return read_reason(control_directory / broken_cookie);
+    }
+
+private:
+    /// Reads the reason sent by the terminated child.
+    ///
+    /// \param cookie_path File where the child leaves the reason if there was
+    ///     no status pipe.
+    ///
+    /// \return The reason, or none if the child did not send any.
+    optional< std::string >
+    read_reason(const fs::path& cookie_path)
+    {
+        if (status_fd != -1) {
+            const std::string reason = drain_status_pipe(status_fd);
+            ::close(status_fd);
+            status_fd = -1;
+            if (reason.empty())
+                return none;
+            return utils::make_optional(reason);
+        }
+
+        std::ifstream input(cookie_path.c_str());
+        if (!input)
+            return none;
+        return utils::make_optional(utils::read_stream(input));
     }
 };
 
@@ -247,6 +716,9 @@ struct cleanup_exec_data : public exec_data {
     /// routine is used if it has failed.
     model::test_result body_result;
 
+    /// Maximum size of each output file of the test, or 0 if unbounded.
+    units::bytes max_output_size;
+
     /// Constructor.
     ///
     /// \param test_program_ Test program data for this test case.
@@ -255,12 +727,65 @@ struct cleanup_exec_data : public exec_data {
     ///     corresponding to the cleanup routine represented by this exec_data.
     /// \param body_result_ If not none, result of the body corresponding to the
     ///     cleanup routine represented by this exec_data.
+    /// \param max_output_size_ Maximum size of each output file of the test,
+    ///     shared by the body and the cleanup routine.
     cleanup_exec_data(const model::test_program_ptr test_program_,
                       const std::string& test_case_name_,
                       const executor::exit_handle& body_exit_handle_,
-                      const model::test_result& body_result_) :
+                      const model::test_result& body_result_,
+                      const units::bytes& max_output_size_) :
+        exec_data(test_program_, test_case_name_),
+        body_exit_handle(body_exit_handle_), body_result(body_result_),
+        max_output_size(max_output_size_)
+    {
+    }
+};
+
+
+/// Maintenance data held while a test program is being listed.
+///
+/// Instances of this object are only created for asynchronous listings issued
+/// via scheduler::spawn_list(), and they carry an empty test case name.
+struct list_exec_data : public exec_data {
+    /// Test program-specific execution interface.
+    const std::shared_ptr< scheduler::interface > interface;
+
+    /// Configuration variables passed to the test program.
+    const properties_map_ptr vars;
+
+    /// Constructor.
+    ///
+    /// \param test_program_ Test program data for this test program.
+    /// \param interface_ Test program-specific execution interface.
+    /// \param vars_ Configuration variables passed to the test program.
+    list_exec_data(const model::test_program_ptr test_program_,
+                   const std::shared_ptr< scheduler::interface > interface_,
+                   const properties_map_ptr vars_) :
+        exec_data(test_program_, ""), interface(interface_), vars(vars_)
+    {
+    }
+};
+
+
+/// Maintenance data held while the stacktrace of a crashed subprocess is being
+/// gathered.
+///
+/// Instances of this object are related to a previous exec_data of any kind,
+/// whose processing is resumed once GDB terminates.
+struct stacktrace_exec_data : public exec_data {
+    /// The exit handle of the crashed subprocess.
+    executor::exit_handle crashed_exit_handle;
+
+    /// Constructor.
+    ///
+    /// \param test_program_ Test program data of the crashed subprocess.
+    /// \param test_case_name_ Name of the test case of the crashed subprocess.
+    /// \param crashed_exit_handle_ Exit handle of the crashed subprocess.
+    stacktrace_exec_data(const model::test_program_ptr test_program_,
+                         const std::string& test_case_name_,
+                         const executor::exit_handle& crashed_exit_handle_) :
         exec_data(test_program_, test_case_name_),
-        body_exit_handle(body_exit_handle_), body_result(body_result_)
+        crashed_exit_handle(crashed_exit_handle_)
     {
     }
 };
@@ -289,23 +814,58 @@ typedef std::map< int, exec_data_ptr > exec_data_map;
 /// its "current_path" view at program startup time; or maybe by grabbing the
 /// current path at test_program creation time; or maybe something else.
 ///
-/// \param program The test program to modify.
+/// Copying a test program is not cheap, as it involves copying and
+/// reprocessing all of its test cases, so this is a no-op for the test programs
+/// loaded from a Kyuafile: their root is made absolute upfront.
 ///
-/// \return A new test program whose internal paths are absolute.
-static model::test_program
+/// \param program The test program to check.  This is taken by value, which
+///     is cheap because test programs share their internals, to never trigger
+///     the lazy loading of the test cases of a lazy_test_program.
+///
+/// \return A new test program whose internal paths are absolute, or NULL if the
+/// paths of the given test program are already absolute.
+static model::test_program_ptr
 force_absolute_paths(const model::test_program program)
 {
+    if (program.root().is_absolute())
+        return model::test_program_ptr();
+
     const std::string& relative = program.relative_path().str();
     const std::string absolute = program.absolute_path().str();
 
     const std::string root = absolute.substr(
         0, absolute.length() - relative.length());
 
-    return model::test_program(
+    return model::test_program_ptr(new model::test_program(
         program.interface_name(),
         program.relative_path(), fs::path(root),
         program.test_suite_name(),
-        program.get_metadata(), program.test_cases());
+        program.get_metadata(), program.test_cases(),
+        program.variant(), program.variant_vars()));
+}
+
+
+/// Creates the fake test cases list that represents a failed listing.
+///
+/// TODO(jmmv): This is a very ugly workaround for the fact that we cannot
+/// report failures at the test-program level.
+///
+/// \param reason The reason for the failure of the listing.
+///
+/// \return A test cases list with a single test case that carries a broken
+/// result with the given reason.
+static model::test_cases_map
+fake_test_cases_list(const std::string& reason)
+{
+    LW(F("Failed to load test cases list: %s") % reason);
+    model::test_cases_map fake_test_cases;
+    fake_test_cases.insert(model::test_cases_map::value_type(
+        "__test_cases_list__",
+        model::test_case(
+            "__test_cases_list__",
+            "Represents the correct processing of the test cases list",
+            model::test_result(model::test_result_broken, reason))));
+    return fake_test_cases;
 }
 
 
@@ -314,25 +874,32 @@ class list_test_cases {
     /// Interface of the test program to execute.
     std::shared_ptr< scheduler::interface > _interface;
 
+    /// Copy of the test program with absolute paths, if it needed one.
+    const model::test_program_ptr _absolute_copy;
+
     /// Test program to execute.
-    const model::test_program _test_program;
+    ///
+    /// This is either the caller's test program, which outlives the spawned
+    /// process, or _absolute_copy.
+    const model::test_program& _test_program;
 
-    /// User-provided configuration variables.
-    const config::tree& _user_config;
+    /// Configuration variables to pass to the test program.
+    const properties_map_ptr _vars;
 
 public:
     /// Constructor.
     ///
     /// \param interface Interface of the test program to execute.
     /// \param test_program Test program to execute.
-    /// \param user_config User-provided configuration variables.
+    /// \param vars Configuration variables to pass to the test program.
     list_test_cases(
         const std::shared_ptr< scheduler::interface > interface,
         const model::test_program* test_program,
-        const config::tree& user_config) :
+        const properties_map_ptr vars) :
         _interface(interface),
-        _test_program(force_absolute_paths(*test_program)),
-        _user_config(user_config)
+        _absolute_copy(force_absolute_paths(*test_program)),
+        _test_program(_absolute_copy ? *_absolute_copy : *test_program),
+        _vars(vars)
     {
     }
 
@@ -340,9 +907,7 @@ public:
     void
     operator()(const fs::path& UTILS_UNUSED_PARAM(control_directory))
     {
-        const config::properties_map vars = scheduler::generate_config(
-            _user_config, _test_program.test_suite_name());
-        _interface->exec_list(_test_program, vars);
+        _interface->exec_list(_test_program, *_vars);
     }
 };
 
@@ -352,8 +917,11 @@ class run_test_program {
     /// Interface of the test program to execute.
     std::shared_ptr< scheduler::interface > _interface;
 
-    /// Test program to execute.
-    const model::test_program _test_program;
+    /// Copy of the test program with absolute paths, if it needed one.
+    const model::test_program_ptr _absolute_copy;
+
+    /// Test program to execute; either the caller's one or _absolute_copy.
+    const model::test_program& _test_program;
 
     /// Name of the test case to execute.
     const std::string& _test_case_name;
@@ -361,41 +929,87 @@ class run_test_program {
     /// User-provided configuration variables.
     const config::tree& _user_config;
 
-    /// Verifies if the test case needs to be skipped or not.
-    ///
-    /// We could very well run this on the scheduler parent process before
-    /// issuing the fork.  However, doing this here in the child process is
-    /// better for two reasons: first, it allows us to continue using the simple
-    /// spawn/wait abstraction of the scheduler; and, second, we parallelize the
-    /// requirements checks among tests.
-    ///
-    /// \post If the test's preconditions are not met, the caller process is
-    /// terminated with a special exit code and a "skipped cookie" is written to
-    /// the disk with the reason for the failure.
+    /// Configuration variables to pass to the test program.
+    const properties_map_ptr _vars;
+
+    /// CPUs to run the test case on; empty to not restrict them.
+    const std::set< int > _cpus;
+
+    /// Reason to skip the test case with; empty if the requirements checked
+    /// by the parent process are met.
+    const std::string _skip_reason;
+
+    /// Write end of the status pipe, or -1 to use the skipped_cookie instead.
+    const int _status_fd;
+
+    /// Write end of the result pipe, or -1 if there is none.
+    const int _result_fd;
+
+    /// Execution plan of the test program, or null to use exec_test().
+    const exec_plan_ptr _plan;
+
+    /// Sends the reason for not running the test case to the parent.
     ///
-    /// \param skipped_cookie_path File to create with the skip reason details
-    ///     if this test is skipped.
+    /// \param cookie_path File to create with the reason if there is no status
+    ///     pipe.
+    /// \param reason The reason to send.
     void
-    do_requirements_check(const fs::path& skipped_cookie_path)
+    send_reason(const fs::path& cookie_path, const std::string& reason)
     {
-        const model::test_case& test_case = _test_program.find(
-            _test_case_name);
-
-        const std::string skip_reason = engine::check_reqs(
-            test_case.get_metadata(), _user_config,
-            _test_program.test_suite_name(),
-            fs::current_path());
-        if (skip_reason.empty())
+        if (_status_fd != -1) {
+            const char* data = reason.c_str();
+            std::size_t pending = reason.length();
+            while (pending > 0) {
+                const ssize_t length = ::write(_status_fd, data, pending);
+                if (length == -1) {
+                    if (errno == EINTR)
+                        continue;
+                    std::perror("Failed to write to the status pipe");
+                    std::abort();
+                }
+                data += length;
+                pending -= length;
+            }
             return;
+        }
 
-        std::ofstream output(skipped_cookie_path.c_str());
+        std::ofstream output(cookie_path.c_str());
         if (!output) {
             std::perror((F("Failed to open %s for write") %
-                         skipped_cookie_path).str().c_str());
+                         cookie_path).str().c_str());
             std::abort();
         }
-        output << skip_reason;
+        output << reason;
         output.close();
+    }
+
+    /// Skips the test case if its requirements are not met.
+    ///
+    /// Most requirements are evaluated by the scheduler parent process before
+    /// issuing the fork so that the lookups they need can be memoized across
+    /// test cases; only those that depend on the work directory are checked
+    /// here.  The skipping itself happens here in all cases so that we can
+    /// continue using the simple spawn/wait abstraction of the scheduler.
+    ///
+    /// \post If the test's preconditions are not met, the caller process is
+    /// terminated with a special exit code.  If the reason was determined
+    /// here, it is sent to the parent through the status pipe or, if there is
+    /// none, written to the disk as a "skipped cookie".
+    ///
+    /// \param skipped_cookie_path File to create with the skip reason details
+    ///     if this test is skipped and there is no status pipe.
+    void
+    do_requirements_check(const fs::path& skipped_cookie_path)
+    {
+        if (_skip_reason.empty()) {
+            const model::test_case& test_case = _test_program.find(
+                _test_case_name);
+            const std::string skip_reason = engine::check_work_directory_reqs(
+                test_case.get_metadata(), fs::current_path());
+            if (skip_reason.empty())
+                return;
+            send_reason(skipped_cookie_path, skip_reason);
+        }
 
         // Abruptly terminate the process.  We don't want to run any destructors
         // inherited from the parent process by mistake, which could, for
@@ -410,16 +1024,44 @@ public:
     /// \param test_program Test program to execute.
     /// \param test_case_name Name of the test case to execute.
     /// \param user_config User-provided configuration variables.
+    /// \param vars Configuration variables to pass to the test program.
+    /// \param cpus CPUs to run the test case on; empty to not restrict them.
+    /// \param skip_reason Reason to skip the test case with; empty to run it
+    ///     if the requirements tied to its work directory are met.
+    /// \param status_fd Write end of the status pipe, or -1 if there is none.
+    /// \param result_fd Write end of the result pipe, or -1 if there is none.
+    /// \param plan Execution plan of the test program, or null to use
+    ///     exec_test().
     run_test_program(
         const std::shared_ptr< scheduler::interface > interface,
         const model::test_program_ptr test_program,
         const std::string& test_case_name,
-        const config::tree& user_config) :
+        const config::tree& user_config,
+        const properties_map_ptr vars,
+        const std::set< int >& cpus,
+        const std::string& skip_reason,
+        const int status_fd,
+        const int result_fd,
+        const exec_plan_ptr plan) :
         _interface(interface),
-        _test_program(force_absolute_paths(*test_program)),
+        _absolute_copy(force_absolute_paths(*test_program)),
+        _test_program(_absolute_copy ? *_absolute_copy : *test_program),
         _test_case_name(test_case_name),
-        _user_config(user_config)
+        _user_config(user_config),
+        _vars(vars),
+        _cpus(cpus),
+        _skip_reason(skip_reason),
+        _status_fd(status_fd),
+        _result_fd(result_fd),
+        _plan(plan)
+    {
+    }
+
+    /// Lets the interface prepare the execution before the subprocess starts.
+    void
+    prepare(void) const
     {
+        _interface->prepare_test(_test_program, *_vars);
     }
 
     /// Body of the subprocess.
@@ -432,10 +1074,37 @@ public:
             ::_exit(EXIT_SUCCESS);
 
         do_requirements_check(control_directory / skipped_cookie);
+        try {
+            stage_fixtures(_test_program, test_case, fs::current_path());
+        } catch (const fs::error& e) {
+            // Exceptions must not escape the child, where they would abort
+            // it and leave a core behind as if the test had crashed.
+            send_reason(control_directory / broken_cookie,
+                        F("Failed to stage fixtures: %s") % e.what());
+            ::_exit(exit_broken);
+        }
+        limit_test_resources(test_case, _user_config);
+        if (!_cpus.empty())
+            (void)process::set_cpu_affinity(_cpus);
+        if (test_case.get_metadata().priority() == "low")
+            (void)process::lower_priority();
+        utils::setup_crash_handler(control_directory);
+
+        // Leave the result pipe, and nothing else, at the descriptor where the
+        // interface expects it.  dup2(2) clears the close-on-exec flag of the
+        // new descriptor, which must be done by hand if it is already there.
+        if (_interface->accepts_result_pipe()) {
+            if (_result_fd == scheduler::result_fd)
+                (void)::fcntl(_result_fd, F_SETFD, 0);
+            else if (_result_fd == -1 ||
+                     ::dup2(_result_fd, scheduler::result_fd) == -1)
+                (void)::close(scheduler::result_fd);
+        }
 
-        const config::properties_map vars = scheduler::generate_config(
-            _user_config, _test_program.test_suite_name());
-        _interface->exec_test(_test_program, _test_case_name, vars,
+        if (_plan)
+            _interface->exec_planned_test(*_plan, _test_case_name,
+                                          control_directory);
+        _interface->exec_test(_test_program, _test_case_name, *_vars,
                               control_directory);
     }
 };
@@ -446,14 +1115,17 @@ class run_test_cleanup {
     /// Interface of the test program to execute.
     std::shared_ptr< scheduler::interface > _interface;
 
-    /// Test program to execute.
-    const model::test_program _test_program;
+    /// Copy of the test program with absolute paths, if it needed one.
+    const model::test_program_ptr _absolute_copy;
+
+    /// Test program to execute; either the caller's one or _absolute_copy.
+    const model::test_program& _test_program;
 
     /// Name of the test case to execute.
     const std::string& _test_case_name;
 
-    /// User-provided configuration variables.
-    const config::tree& _user_config;
+    /// Configuration variables to pass to the test program.
+    const properties_map_ptr _vars;
 
 public:
     /// Constructor.
@@ -461,16 +1133,17 @@ public:
     /// \param interface Interface of the test program to execute.
     /// \param test_program Test program to execute.
     /// \param test_case_name Name of the test case to execute.
-    /// \param user_config User-provided configuration variables.
+    /// \param vars Configuration variables to pass to the test program.
     run_test_cleanup(
         const std::shared_ptr< scheduler::interface > interface,
         const model::test_program_ptr test_program,
         const std::string& test_case_name,
-        const config::tree& user_config) :
+        const properties_map_ptr vars) :
         _interface(interface),
-        _test_program(force_absolute_paths(*test_program)),
+        _absolute_copy(force_absolute_paths(*test_program)),
+        _test_program(_absolute_copy ? *_absolute_copy : *test_program),
         _test_case_name(test_case_name),
-        _user_config(user_config)
+        _vars(vars)
     {
     }
 
@@ -478,9 +1151,7 @@ public:
     void
     operator()(const fs::path& control_directory)
     {
-        const config::properties_map vars = scheduler::generate_config(
-            _user_config, _test_program.test_suite_name());
-        _interface->exec_cleanup(_test_program, _test_case_name, vars,
+        _interface->exec_cleanup(_test_program, _test_case_name, *_vars,
                                  control_directory);
     }
 };
@@ -500,44 +1171,316 @@ find_interface(const std::string& name)
 }
 
 
-}  // anonymous namespace
+/// Mapping of in-flight listings to the index of their test program.
+typedef std::map< scheduler::exec_handle, std::size_t > listings_map;
 
 
-void
-scheduler::interface::exec_cleanup(
-    const model::test_program& UTILS_UNUSED_PARAM(test_program),
-    const std::string& UTILS_UNUSED_PARAM(test_case_name),
-    const utils::config::properties_map& UTILS_UNUSED_PARAM(vars),
-    const utils::fs::path& UTILS_UNUSED_PARAM(control_directory)) const
+/// Checks if a test program shares its test cases with an in-flight listing.
+///
+/// \param test_program The test program to check.
+/// \param test_programs The test programs indexed by in_flight.
+/// \param in_flight The listings currently in flight.
+///
+/// \return True if test_program is a variant of a test program being listed.
+static bool
+has_sibling_in_flight(const model::test_program_ptr& test_program,
+                      const model::test_programs_vector& test_programs,
+                      const listings_map& in_flight)
 {
-    // Most test interfaces do not support standalone cleanup routines so
-    // provide a default implementation that does nothing.
-    UNREACHABLE_MSG("exec_cleanup not implemented for an interface that "
-                    "supports standalone cleanup routines");
+    const scheduler::lazy_test_program* lazy =
+        dynamic_cast< const scheduler::lazy_test_program* >(
+            test_program.get());
+    if (lazy == NULL)
+        return false;
+
+    for (listings_map::const_iterator iter = in_flight.begin();
+         iter != in_flight.end(); ++iter) {
+        const scheduler::lazy_test_program* other =
+            dynamic_cast< const scheduler::lazy_test_program* >(
+                test_programs[(*iter).second].get());
+        if (other != NULL && lazy->shares_test_cases_with(*other))
+            return true;
+    }
+    return false;
 }
 
 
-/// Internal implementation of a lazy_test_program.
-struct engine::scheduler::lazy_test_program::impl : utils::noncopyable {
-    /// Whether the test cases list has been yet loaded or not.
-    bool _loaded;
+/// Populates a lazy test program without executing it and times the attempt.
+///
+/// \param handle The scheduler handle to load the test program with.
+/// \param test_program The test program to load.
+/// \param user_config User-provided configuration variables.
+/// \param [out] stats Receives the statistics of the listing if the test
+///     program is now loaded.
+///
+/// \return True if the test program is now loaded; false otherwise.
+static bool
+load_cached(scheduler::scheduler_handle& handle,
+            const model::test_program_ptr& test_program,
+            const config::tree& user_config,
+            scheduler::listing_stats& stats)
+{
+    const datetime::timestamp start = datetime::timestamp::now();
+    if (!handle.load_cached_list(test_program, user_config, &stats))
+        return false;
+    stats.duration = datetime::timestamp::now() - start;
+    stats.test_cases = test_program->test_cases().size();
+    return true;
+}
 
-    /// User configuration to pass to the test program list operation.
-    config::tree _user_config;
 
-    /// Scheduler context to use to load test cases.
-    scheduler::scheduler_handle& _scheduler_handle;
+}  // anonymous namespace
+
+
+/// Constructor.
+///
+/// \param program_ The binary to execute.
+scheduler::exec_plan::exec_plan(const fs::path& program_) :
+    program(program_)
+{
+}
+
+
+/// Executes the plan.
+///
+/// This is intended to be called within a subprocess and does not return.
+///
+/// \param extra_args Arguments specific to the test case to execute, which are
+///     passed after the leading arguments of the plan.
+void
+scheduler::exec_plan::exec(const process::args_vector& extra_args) const
+{
+    for (std::map< std::string, std::string >::const_iterator
+             iter = environment.begin(); iter != environment.end(); ++iter)
+        utils::setenv((*iter).first, (*iter).second);
+
+    if (extra_args.empty())
+        process::exec(program, args);
+
+    process::args_vector all_args;
+    all_args.reserve(args.size() + extra_args.size());
+    all_args.insert(all_args.end(), args.begin(), args.end());
+    all_args.insert(all_args.end(), extra_args.begin(), extra_args.end());
+    process::exec(program, all_args);
+}
+
+
+optional< scheduler::exec_plan >
+scheduler::interface::plan_test(
+    const model::test_program& UTILS_UNUSED_PARAM(test_program),
+    const utils::config::properties_map& UTILS_UNUSED_PARAM(vars)) const
+{
+    // Most test interfaces can be migrated to plans over time, so provide a
+    // default implementation that keeps using exec_test().
+    return none;
+}
+
+
+void
+scheduler::interface::exec_planned_test(
+    const exec_plan& plan,
+    const std::string& UTILS_UNUSED_PARAM(test_case_name),
+    const utils::fs::path& UTILS_UNUSED_PARAM(control_directory)) const
+{
+    plan.exec(process::args_vector());
+}
+
+
+void
+scheduler::interface::exec_cleanup(
+    const model::test_program& UTILS_UNUSED_PARAM(test_program),
+    const std::string& UTILS_UNUSED_PARAM(test_case_name),
+    const utils::config::properties_map& UTILS_UNUSED_PARAM(vars),
+    const utils::fs::path& UTILS_UNUSED_PARAM(control_directory)) const
+{
+    // Most test interfaces do not support standalone cleanup routines so
+    // provide a default implementation that does nothing.
+    UNREACHABLE_MSG("exec_cleanup not implemented for an interface that "
+                    "supports standalone cleanup routines");
+}
+
+
+optional< model::test_cases_map >
+scheduler::interface::static_list(
+    const model::test_program& UTILS_UNUSED_PARAM(test_program)) const
+{
+    // Most test interfaces have to query the test program for its test cases
+    // so provide a default implementation that defers to exec_list().
+    return none;
+}
+
+
+bool
+scheduler::interface::accepts_result_pipe(void) const
+{
+    // Most test interfaces learn the result of a test case from its exit
+    // status or its output, so they have no use for a result pipe.
+    return false;
+}
+
+
+model::test_result
+scheduler::interface::compute_piped_result(
+    const optional< process::status >& UTILS_UNUSED_PARAM(status),
+    const fs::path& UTILS_UNUSED_PARAM(control_directory),
+    const fs::path& UTILS_UNUSED_PARAM(stdout_path),
+    const fs::path& UTILS_UNUSED_PARAM(stderr_path),
+    const std::string& UTILS_UNUSED_PARAM(piped_result)) const
+{
+    UNREACHABLE_MSG("compute_piped_result not implemented for an interface "
+                    "that accepts a result pipe");
+}
+
+
+std::vector< model::test_result >
+scheduler::interface::compute_sub_results(
+    const utils::fs::path& UTILS_UNUSED_PARAM(stdout_path)) const
+{
+    // Most test interfaces cannot report individual checks so provide a
+    // default implementation that reports none.
+    return std::vector< model::test_result >();
+}
+
+
+void
+scheduler::interface::prepare_test(
+    const model::test_program& UTILS_UNUSED_PARAM(test_program),
+    const utils::config::properties_map& UTILS_UNUSED_PARAM(vars)) const
+{
+    // Most test interfaces spawn a fresh test program for every test case and
+    // thus have nothing to prepare.
+}
+
+
+void
+scheduler::interface::finalize(void) const
+{
+    // Most test interfaces do not keep any state across test cases.
+}
+
+
+/// Internal implementation of a lazy_test_program.
+struct engine::scheduler::lazy_test_program::impl : utils::noncopyable {
+    /// Whether the test cases list has been yet loaded or not.
+    bool _loaded;
+
+    /// Test cases list shared by all the variants of the test program.
+    ///
+    /// This is none until any of the variants is loaded, at which point the
+    /// others pick it up without executing the test program again.
+    std::shared_ptr< optional< model::test_cases_map > > _shared_test_cases;
+
+    /// User configuration to pass to the test program list operation.
+    config::tree _user_config;
+
+    /// Scheduler context to use to load test cases.
+    scheduler::scheduler_handle& _scheduler_handle;
 
     /// Constructor.
-    impl(const config::tree& user_config_,
+    ///
+    /// \param shared_test_cases_ Test cases list shared with other variants.
+    /// \param user_config_ User configuration to pass to the list operation.
+    /// \param scheduler_handle_ Scheduler context to use to load test cases.
+    impl(std::shared_ptr< optional< model::test_cases_map > >
+             shared_test_cases_,
+         const config::tree& user_config_,
          scheduler::scheduler_handle& scheduler_handle_) :
-        _loaded(false), _user_config(user_config_),
-        _scheduler_handle(scheduler_handle_)
+        _loaded(false), _shared_test_cases(shared_test_cases_),
+        _user_config(user_config_), _scheduler_handle(scheduler_handle_)
     {
     }
 };
 
 
+/// Pure abstract destructor.
+scheduler::list_hooks::~list_hooks(void)
+{
+}
+
+
+/// Constructor for an empty listing.
+scheduler::listing_stats::listing_stats(void) :
+    source(listing_known),
+    test_cases(0)
+{
+}
+
+
+/// Constructor.
+///
+/// \param type_ The type of the event.
+/// \param pid_ The identifier of the subprocess the event refers to.
+/// \param test_program_ The test program the subprocess belongs to.
+/// \param test_case_name_ The name of the test case; empty for listings.
+/// \param timestamp_ The moment the event happened.
+/// \param running_ Number of subprocesses running right after the event.
+scheduler::event::event(const event_type type_, const int pid_,
+                        const model::test_program_ptr test_program_,
+                        const std::string& test_case_name_,
+                        const datetime::timestamp& timestamp_,
+                        const std::size_t running_) :
+    type(type_),
+    pid(pid_),
+    test_program(test_program_),
+    test_case_name(test_case_name_),
+    timestamp(timestamp_),
+    running(running_)
+{
+}
+
+
+/// Pure abstract destructor.
+scheduler::observer::~observer(void)
+{
+}
+
+
+/// Constructor.
+///
+/// \param capacity Maximum number of events to buffer.  Must be positive.
+scheduler::event_queue::event_queue(const std::size_t capacity) :
+    _capacity(capacity), _dropped(0)
+{
+    PRE(capacity > 0);
+}
+
+
+/// Buffers an event, discarding the oldest one if the queue is full.
+///
+/// \param event The event to buffer.
+void
+scheduler::event_queue::got_event(const event& event)
+{
+    if (_events.size() == _capacity) {
+        _events.pop_front();
+        ++_dropped;
+    }
+    _events.push_back(event);
+}
+
+
+/// Takes all the buffered events out of the queue.
+///
+/// \return The events in the order in which they happened.
+std::vector< scheduler::event >
+scheduler::event_queue::drain(void)
+{
+    const std::vector< event > events(_events.begin(), _events.end());
+    _events.clear();
+    return events;
+}
+
+
+/// Gets the number of events discarded so far due to the queue being full.
+///
+/// \return A count of events.
+std::size_t
+scheduler::event_queue::dropped(void) const
+{
+    return _dropped;
+}
+
+
 /// Constructs a new test program.
 ///
 /// \param interface_name_ Name of the test program interface.
@@ -547,6 +1490,9 @@ struct engine::scheduler::lazy_test_program::impl : utils::noncopyable {
 /// \param md_ Metadata of the test program.
 /// \param user_config_ User configuration to pass to the scheduler.
 /// \param scheduler_handle_ Scheduler context to use to load test cases.
+/// \param variant_ Name of the variant of the test program; empty if none.
+/// \param variant_vars_ Test suite configuration variables that the variant
+///     overrides.
 scheduler::lazy_test_program::lazy_test_program(
     const std::string& interface_name_,
     const fs::path& binary_,
@@ -554,11 +1500,106 @@ scheduler::lazy_test_program::lazy_test_program(
     const std::string& test_suite_name_,
     const model::metadata& md_,
     const config::tree& user_config_,
-    scheduler::scheduler_handle& scheduler_handle_) :
+    scheduler::scheduler_handle& scheduler_handle_,
+    const std::string& variant_,
+    const config::properties_map& variant_vars_) :
     test_program(interface_name_, binary_, root_, test_suite_name_, md_,
-                 model::test_cases_map()),
-    _pimpl(new impl(user_config_, scheduler_handle_))
+                 model::test_cases_map(), variant_, variant_vars_),
+    _pimpl(new impl(std::shared_ptr< optional< model::test_cases_map > >(
+                        new optional< model::test_cases_map >()),
+                    user_config_, scheduler_handle_))
+{
+}
+
+
+/// Constructs another variant of a test program.
+///
+/// The new test program shares the test cases list with the original one, so
+/// the test program is only executed once to list the test cases of all its
+/// variants.  Listing happens with the configuration of the test suite and
+/// without any of the variables overridden by the variants.
+///
+/// \param sibling The test program to create a variant of.
+/// \param variant_ Name of the new variant.  Cannot be empty.
+/// \param variant_vars_ Test suite configuration variables that the variant
+///     overrides.
+scheduler::lazy_test_program::lazy_test_program(
+    const lazy_test_program& sibling,
+    const std::string& variant_,
+    const config::properties_map& variant_vars_) :
+    test_program(sibling.interface_name(), sibling.relative_path(),
+                 sibling.root(), sibling.test_suite_name(),
+                 sibling.get_metadata(), model::test_cases_map(), variant_,
+                 variant_vars_),
+    _pimpl(new impl(sibling._pimpl->_shared_test_cases,
+                    sibling._pimpl->_user_config,
+                    sibling._pimpl->_scheduler_handle))
 {
+    PRE(!variant_.empty());
+
+    // The sibling does not keep a copy of its list of test cases if it was
+    // loaded while it had no variants.  Its own test cases are valid input for
+    // set_test_cases() because the latter applies the defaults of this test
+    // program to the metadata of the test cases themselves.
+    if (sibling._pimpl->_loaded && !*_pimpl->_shared_test_cases)
+        *_pimpl->_shared_test_cases = sibling.test_program::test_cases();
+}
+
+
+/// Checks whether the list of test cases has already been loaded.
+///
+/// \return True if test_cases() can return without executing the test program.
+bool
+scheduler::lazy_test_program::loaded(void) const
+{
+    if (!_pimpl->_loaded && *_pimpl->_shared_test_cases) {
+        // Due to the restrictions on when set_test_cases() may be called (as a
+        // way to lazily initialize the test cases list before it is ever
+        // returned), this cast is valid.
+        const_cast< scheduler::lazy_test_program* >(this)->set_test_cases(
+            _pimpl->_shared_test_cases->get());
+        _pimpl->_loaded = true;
+    }
+    return _pimpl->_loaded;
+}
+
+
+/// Checks whether two test programs are variants that share their test cases.
+///
+/// \param other The test program to compare to.
+///
+/// \return True if loading either of the test programs loads the other one.
+bool
+scheduler::lazy_test_program::shares_test_cases_with(
+    const lazy_test_program& other) const
+{
+    return _pimpl->_shared_test_cases == other._pimpl->_shared_test_cases;
+}
+
+
+/// Sets the list of test cases as obtained by an asynchronous listing.
+///
+/// \pre The test cases list must not have been loaded yet.
+///
+/// \param test_cases The list of test cases provided by the test program.
+void
+scheduler::lazy_test_program::set_loaded_test_cases(
+    const model::test_cases_map& test_cases) const
+{
+    PRE(!_pimpl->_loaded);
+
+    // Due to the restrictions on when set_test_cases() may be called (as a way
+    // to lazily initialize the test cases list before it is ever returned),
+    // this cast is valid.
+    const_cast< scheduler::lazy_test_program* >(this)->set_test_cases(
+        test_cases);
+    // Keeping a copy of the list is only necessary if there are variants that
+    // may pick it up; variants created later seed it from this test program.
+    if (!*_pimpl->_shared_test_cases &&
+        _pimpl->_shared_test_cases.use_count() > 1)
+        *_pimpl->_shared_test_cases = test_cases;
+
+    _pimpl->_loaded = true;
 }
 
 
@@ -570,16 +1611,10 @@ scheduler::lazy_test_program::test_cases(void) const
 {
     _pimpl->_scheduler_handle.check_interrupt();
 
-    if (!_pimpl->_loaded) {
+    if (!loaded()) {
         const model::test_cases_map tcs = _pimpl->_scheduler_handle.list_tests(
             this, _pimpl->_user_config);
-
-        // Due to the restrictions on when set_test_cases() may be called (as a
-        // way to lazily initialize the test cases list before it is ever
-        // returned), this cast is valid.
-        const_cast< scheduler::lazy_test_program* >(this)->set_test_cases(tcs);
-
-        _pimpl->_loaded = true;
+        set_loaded_test_cases(tcs);
 
         _pimpl->_scheduler_handle.check_interrupt();
     }
@@ -589,34 +1624,35 @@ scheduler::lazy_test_program::test_cases(void) const
 }
 
 
+/// Releases the memory taken by the list of test cases.
+///
+/// The test program stops sharing its list of test cases with its variants,
+/// which is released once all of them have released theirs too.  Any later
+/// call to test_cases() executes the test program again to load the list, so
+/// this is only meant for test programs that are not going to be used any
+/// more, such as those whose test cases have all run.
+void
+scheduler::lazy_test_program::release_test_cases(void) const
+{
+    // The same restrictions as in set_loaded_test_cases() apply, and the caller
+    // is responsible for not holding references to the released test cases.
+    const_cast< scheduler::lazy_test_program* >(this)->clear_test_cases();
+    _pimpl->_shared_test_cases.reset(new optional< model::test_cases_map >());
+    _pimpl->_loaded = false;
+}
+
+
 /// Internal implementation for the result_handle class.
 struct engine::scheduler::result_handle::bimpl : utils::noncopyable {
     /// Generic executor exit handle for this result handle.
     executor::exit_handle generic;
 
-    /// Mutable pointer to the corresponding scheduler state.
-    ///
-    /// This object references a member of the scheduler_handle that yielded
-    /// this result_handle instance.  We need this direct access to clean up
-    /// after ourselves when the result is destroyed.
-    exec_data_map& all_exec_data;
-
     /// Constructor.
     ///
     /// \param generic_ Generic executor exit handle for this result handle.
-    /// \param [in,out] all_exec_data_ Global object keeping track of all active
-    ///     executions for an scheduler.  This is a pointer to a member of the
-    ///     scheduler_handle object.
-    bimpl(const executor::exit_handle generic_, exec_data_map& all_exec_data_) :
-        generic(generic_), all_exec_data(all_exec_data_)
-    {
-    }
-
-    /// Destructor.
-    ~bimpl(void)
+    explicit bimpl(const executor::exit_handle generic_) :
+        generic(generic_)
     {
-        LD(F("Removing %s from all_exec_data") % generic.original_pid());
-        all_exec_data.erase(generic.original_pid());
     }
 };
 
@@ -681,6 +1717,16 @@ scheduler::result_handle::end_time(void) const
 }
 
 
+/// Returns the resources consumed by the test body.
+///
+/// \return The resource usage of the test, or none if unknown.
+const optional< process::resource_usage >&
+scheduler::result_handle::usage(void) const
+{
+    return _pbimpl->generic.usage();
+}
+
+
 /// Returns the path to the test-specific work directory.
 ///
 /// This is guaranteed to be clear of files created by the scheduler.
@@ -787,6 +1833,85 @@ scheduler::test_result_handle::test_result(void) const
 }
 
 
+/// Computes the results of the individual checks of the test execution.
+///
+/// \pre The handle must not have been cleaned up yet, as this parses the
+/// stdout file of the test.
+///
+/// \return The results reported by the interface of the test program, which
+/// are empty for interfaces that do not report individual checks.
+std::vector< model::test_result >
+scheduler::test_result_handle::sub_results(void) const
+{
+    const std::shared_ptr< scheduler::interface > interface = find_interface(
+        _pimpl->test_program->interface_name());
+    return interface->compute_sub_results(stdout_file());
+}
+
+
+/// Internal implementation for the list_result_handle class.
+struct engine::scheduler::list_result_handle::impl : utils::noncopyable {
+    /// Test program that was listed.
+    model::test_program_ptr test_program;
+
+    /// The test cases list yielded by the test program.
+    model::test_cases_map test_cases;
+
+    /// Constructor.
+    ///
+    /// \param test_program_ Test program that was listed.
+    /// \param [in,out] test_cases_ The test cases list yielded by the test
+    ///     program.  Its contents are taken over without copying them, so it
+    ///     is empty on return.
+    impl(const model::test_program_ptr test_program_,
+         model::test_cases_map& test_cases_) :
+        test_program(test_program_)
+    {
+        test_cases.swap(test_cases_);
+    }
+};
+
+
+/// Constructor.
+///
+/// \param pbimpl Constructed internal implementation for the base object.
+/// \param pimpl Constructed internal implementation.
+scheduler::list_result_handle::list_result_handle(
+    std::shared_ptr< bimpl > pbimpl, std::shared_ptr< impl > pimpl) :
+    result_handle(pbimpl), _pimpl(pimpl)
+{
+}
+
+
+/// Destructor.
+scheduler::list_result_handle::~list_result_handle(void)
+{
+}
+
+
+/// Returns the test program that was listed.
+///
+/// \return A test program.
+const model::test_program_ptr
+scheduler::list_result_handle::test_program(void) const
+{
+    return _pimpl->test_program;
+}
+
+
+/// Returns the test cases list yielded by the test program.
+///
+/// If the listing failed, this contains a single fake test case that
+/// represents the failure, just like list_tests() does.
+///
+/// \return A collection of test cases.
+const model::test_cases_map&
+scheduler::list_result_handle::test_cases(void) const
+{
+    return _pimpl->test_cases;
+}
+
+
 /// Internal implementation for the scheduler_handle.
 struct engine::scheduler::scheduler_handle::impl : utils::noncopyable {
     /// Generic executor instance encapsulated by this one.
@@ -795,11 +1920,56 @@ struct engine::scheduler::scheduler_handle::impl : utils::noncopyable {
     /// Mapping of exec handles to the data required at run time.
     exec_data_map all_exec_data;
 
+    /// Cache of test case listings; none if caching is disabled.
+    optional< engine::list_cache > list_cache;
+
+    /// Receiver of the events of the scheduler; NULL if there is none.
+    scheduler::observer* observer;
+
+    /// Number of subprocesses started and not yet terminated.
+    std::size_t running;
+
+    /// Memoized checks of the requirements of the test cases.
+    engine::requirements_cache requirements;
+
+    /// Latencies of the phases of the execution, keyed by phase name.
+    utils::latency_histograms_map latencies;
+
+    /// User configuration from which vars_cache was generated.
+    config::tree vars_config;
+
+    /// Configuration variables of each test suite, keyed by suite name.
+    std::map< std::string, properties_map_ptr > vars_cache;
+
+    /// Execution plans of the test programs, null for those without one.
+    ///
+    /// Generated from vars_config and discarded along with vars_cache.
+    std::map< model::test_program_ptr, exec_plan_ptr > plans_cache;
+
+    /// Configurations of the test programs that have variant variables.
+    ///
+    /// Generated from vars_config and discarded along with vars_cache.
+    std::map< model::test_program_ptr, config::tree > configs_cache;
+
+    /// Number of stacktraces currently being gathered in the background.
+    std::size_t active_stacktraces;
+
+    /// Crashed subprocesses waiting for a stacktrace slot to become free.
+    std::deque< executor::exit_handle > pending_stacktraces;
+
+    /// Terminated subprocesses whose processing the caller has not seen yet.
+    ///
+    /// These are crashed subprocesses for which the stacktrace could not be
+    /// started after having been queued.
+    std::deque< executor::exit_handle > ready_exits;
+
     /// Collection of test_exec_data objects.
     typedef std::vector< const test_exec_data* > test_exec_data_vector;
 
     /// Constructor.
-    impl(void) : generic(executor::setup())
+    impl(void) :
+        generic(executor::setup()), observer(NULL), running(0),
+        active_stacktraces(0)
     {
     }
 
@@ -807,25 +1977,182 @@ struct engine::scheduler::scheduler_handle::impl : utils::noncopyable {
     ///
     /// This runs any pending cleanup routines, which should only happen if the
     /// scheduler is abruptly terminated (aka if a signal is received).
+    ///
+    /// All cleanup routines are spawned before waiting for any of them so that
+    /// they run concurrently: otherwise, an interrupted run with many pending
+    /// cleanups could take up to cleanup_timeout for each of them to exit.
     ~impl(void)
     {
+        // The observer may be gone by now and it would not learn about the
+        // termination of these cleanups anyway.
+        observer = NULL;
+
         const test_exec_data_vector tests_data = tests_needing_cleanup();
 
+        std::vector< std::pair< executor::exec_handle,
+                                const test_exec_data* > > cleanups;
         for (test_exec_data_vector::const_iterator iter = tests_data.begin();
              iter != tests_data.end(); ++iter) {
             const test_exec_data* test_data = *iter;
 
             try {
-                sync_cleanup(test_data);
+                cleanups.push_back(std::make_pair(
+                    spawn_abrupt_cleanup(test_data), test_data));
+            } catch (const std::runtime_error& e) {
+                warn_cleanup_failure(test_data);
+            }
+        }
+
+        for (std::vector< std::pair< executor::exec_handle,
+                                     const test_exec_data* > >::const_iterator
+                 iter = cleanups.begin(); iter != cleanups.end(); ++iter) {
+            try {
+                generic.wait((*iter).first);
             } catch (const std::runtime_error& e) {
-                LW(F("Failed to run cleanup routine for %s:%s on abrupt "
-                     "termination")
-                   % test_data->test_program->relative_path()
-                   % test_data->test_case_name);
+                warn_cleanup_failure((*iter).second);
             }
         }
     }
 
+    /// Discards the cached data if the caller switched configurations.
+    ///
+    /// \param user_config User-provided configuration variables.
+    void
+    sync_config(const config::tree& user_config)
+    {
+        if (vars_config != user_config) {
+            vars_cache.clear();
+            plans_cache.clear();
+            configs_cache.clear();
+            vars_config = user_config;
+        }
+    }
+
+    /// Gets the configuration variables of a test suite.
+    ///
+    /// The variables of each test suite are generated once and shared by all
+    /// the test programs in it, as the spawn of every test case needs them and
+    /// walking the configuration tree is not free.  The cache is discarded if
+    /// the caller switches to a different configuration.
+    ///
+    /// \param user_config User-provided configuration variables.
+    /// \param test_suite The name of the test suite.
+    ///
+    /// \return The configuration variables for the test suite.
+    properties_map_ptr
+    test_suite_vars(const config::tree& user_config,
+                    const std::string& test_suite)
+    {
+        sync_config(user_config);
+
+        std::map< std::string, properties_map_ptr >::const_iterator iter =
+            vars_cache.find(test_suite);
+        if (iter == vars_cache.end()) {
+            const properties_map_ptr vars(new config::properties_map(
+                scheduler::generate_config(user_config, test_suite)));
+            iter = vars_cache.insert(std::make_pair(test_suite, vars)).first;
+        }
+        return (*iter).second;
+    }
+
+    /// Gets the configuration variables to pass to a test case.
+    ///
+    /// \param user_config User-provided configuration variables, without the
+    ///     overrides of the variant of the test program.
+    /// \param test_program The test program to be executed.
+    ///
+    /// \return The configuration variables of the test suite of the program
+    /// with the values of its variant, if any, applied on top.
+    properties_map_ptr
+    test_program_vars(const config::tree& user_config,
+                      const model::test_program& test_program)
+    {
+        const properties_map_ptr suite_vars = test_suite_vars(
+            user_config, test_program.test_suite_name());
+
+        const config::properties_map& variant_vars =
+            test_program.variant_vars();
+        if (variant_vars.empty())
+            return suite_vars;
+
+        std::shared_ptr< config::properties_map > vars(
+            new config::properties_map(*suite_vars));
+        for (config::properties_map::const_iterator var = variant_vars.begin();
+             var != variant_vars.end(); ++var)
+            (*vars)[(*var).first] = (*var).second;
+        return vars;
+    }
+
+    /// Gets the configuration to run the test cases of a test program with.
+    ///
+    /// The deep copy that variant_config() makes for the test programs with
+    /// variant variables is done once per test program, as both the check of
+    /// the requirements and the spawn of every test case need it.
+    ///
+    /// \param user_config User-provided configuration variables, without the
+    ///     overrides of the variant of the test program.
+    /// \param test_program The test program to be executed.
+    ///
+    /// \return The configuration with the values of the variant, if any.
+    config::tree
+    test_program_config(const config::tree& user_config,
+                        const model::test_program_ptr test_program)
+    {
+        if (test_program->variant_vars().empty())
+            return user_config;
+
+        sync_config(user_config);
+        std::map< model::test_program_ptr, config::tree >::const_iterator
+            iter = configs_cache.find(test_program);
+        if (iter == configs_cache.end())
+            iter = configs_cache.insert(std::make_pair(
+                test_program,
+                scheduler::variant_config(user_config, *test_program))).first;
+        return (*iter).second;
+    }
+
+    /// Gets the execution plan of a test program.
+    ///
+    /// Plans are computed once per test program, as they only depend on the
+    /// test program and its configuration variables.  The caller must have
+    /// obtained vars through test_program_vars() so that the cache is in sync
+    /// with the configuration.
+    ///
+    /// \param interface The interface of the test program.
+    /// \param test_program The test program to be executed.
+    /// \param vars The configuration variables of the test program.
+    ///
+    /// \return The execution plan, or null if the interface has none.
+    exec_plan_ptr
+    test_program_plan(const std::shared_ptr< scheduler::interface > interface,
+                      const model::test_program_ptr test_program,
+                      const properties_map_ptr vars)
+    {
+        std::map< model::test_program_ptr, exec_plan_ptr >::const_iterator
+            iter = plans_cache.find(test_program);
+        if (iter == plans_cache.end()) {
+            const model::test_program_ptr absolute_copy =
+                force_absolute_paths(*test_program);
+            const optional< exec_plan > plan = interface->plan_test(
+                absolute_copy ? *absolute_copy : *test_program, *vars);
+            iter = plans_cache.insert(std::make_pair(
+                test_program, plan ? exec_plan_ptr(new exec_plan(plan.get()))
+                                   : exec_plan_ptr())).first;
+        }
+        return (*iter).second;
+    }
+
+    /// Reports that the cleanup of a test could not be run.
+    ///
+    /// \param test_data The data of the test case whose cleanup failed.
+    static void
+    warn_cleanup_failure(const test_exec_data* test_data)
+    {
+        LW(F("Failed to run cleanup routine for %s:%s on abrupt termination")
+           % test_data->test_program->relative_path()
+           % test_data->test_case_name);
+    }
+
     /// Finds any pending exec_datas that correspond to tests needing cleanup.
     ///
     /// \return The collection of test_exec_data objects that have their
@@ -854,12 +2181,15 @@ struct engine::scheduler::scheduler_handle::impl : utils::noncopyable {
         return tests_data;
     }
 
-    /// Cleans up a single test case synchronously.
+    /// Starts the cleanup of a test case on abrupt termination.
     ///
     /// \param test_data The data of the previously executed test case to be
     ///     cleaned up.
-    void
-    sync_cleanup(const test_exec_data* test_data)
+    ///
+    /// \return A handle for the background operation, to be waited for with
+    /// executor::executor_handle::wait().
+    executor::exec_handle
+    spawn_abrupt_cleanup(const test_exec_data* test_data)
     {
         // The message in this result should never be seen by the user, but use
         // something reasonable just in case it leaks and we need to pinpoint
@@ -867,11 +2197,111 @@ struct engine::scheduler::scheduler_handle::impl : utils::noncopyable {
         model::test_result result(model::test_result_broken,
                                   "Test case died abruptly");
 
-        const executor::exec_handle cleanup_handle = spawn_cleanup(
-            test_data->test_program, test_data->test_case_name,
-            test_data->user_config, test_data->exit_handle.get(),
-            result);
-        generic.wait(cleanup_handle);
+        return spawn_cleanup(
+            test_data->test_program, test_data->test_case_name,
+            test_data->user_config, test_data->vars,
+            test_data->exit_handle.get(), result);
+    }
+
+    /// Reports an event to the observer, if any.
+    ///
+    /// \param type The type of the event.
+    /// \param pid The identifier of the subprocess the event refers to.
+    /// \param test_program The test program the subprocess belongs to.
+    /// \param test_case_name The name of the test case; empty for listings.
+    /// \param handle If not none, the subprocess whose output files to report.
+    void
+    notify(const event_type type, const int pid,
+           const model::test_program_ptr test_program,
+           const std::string& test_case_name,
+           const optional< executor::exec_handle >& handle = none)
+    {
+        if (observer == NULL)
+            return;
+
+        event new_event(type, pid, test_program, test_case_name,
+                        datetime::timestamp::now(), running);
+        if (handle) {
+            new_event.stdout_file = handle.get().stdout_file();
+            new_event.stderr_file = handle.get().stderr_file();
+        }
+        observer->got_event(new_event);
+    }
+
+    /// Accounts for the start of a subprocess.
+    ///
+    /// \param type The type of the event to report.
+    /// \param pid The identifier of the subprocess.
+    /// \param test_program The test program the subprocess belongs to.
+    /// \param test_case_name The name of the test case; empty for listings.
+    /// \param handle If not none, the subprocess whose output files to report.
+    void
+    spawned(const event_type type, const int pid,
+            const model::test_program_ptr test_program,
+            const std::string& test_case_name,
+            const optional< executor::exec_handle >& handle = none)
+    {
+        ++running;
+        notify(type, pid, test_program, test_case_name, handle);
+    }
+
+    /// Accounts for the termination of a subprocess.
+    ///
+    /// This must be called exactly once for every subprocess returned by the
+    /// executor, before processing it.
+    ///
+    /// \param handle The exit handle of the terminated subprocess.
+    void
+    exited(const executor::exit_handle& handle)
+    {
+        PRE(running > 0);
+        --running;
+
+        const exec_data_ptr data = (*all_exec_data.find(
+            handle.original_pid())).second;
+        if (dynamic_cast< const stacktrace_exec_data* >(data.get()) != NULL)
+            return;
+        notify(handle.status() ? exited_event : timed_out_event,
+               handle.original_pid(), data->test_program,
+               data->test_case_name);
+    }
+
+    /// Reads the data sent so far by the running tests through their pipes.
+    ///
+    /// \param timeout Milliseconds to wait for any data to arrive; 0 to not
+    ///     block.
+    ///
+    /// \return False if no test has an open result pipe, in which case the
+    /// caller can block waiting for the subprocesses to terminate instead.
+    bool
+    read_result_pipes(const int timeout)
+    {
+        std::vector< struct ::pollfd > fds;
+        std::vector< test_exec_data* > tests;
+        for (exec_data_map::const_iterator iter = all_exec_data.begin();
+             iter != all_exec_data.end(); ++iter) {
+            test_exec_data* test_data = dynamic_cast< test_exec_data* >(
+                (*iter).second.get());
+            if (test_data == NULL || test_data->result_fd == -1)
+                continue;
+
+            struct ::pollfd fd;
+            fd.fd = test_data->result_fd;
+            fd.events = POLLIN;
+            fd.revents = 0;
+            fds.push_back(fd);
+            tests.push_back(test_data);
+        }
+        if (fds.empty())
+            return false;
+
+        if (::poll(&fds[0], fds.size(), timeout) > 0) {
+            for (std::size_t i = 0; i < fds.size(); ++i) {
+                if (fds[i].revents != 0)
+                    tests[i]->read_result_pipe();
+            }
+        }
+        return true;
     }
 
     /// Forks and executes a test case cleanup routine asynchronously.
@@ -879,6 +2309,7 @@ struct engine::scheduler::scheduler_handle::impl : utils::noncopyable {
     /// \param test_program The container test program.
     /// \param test_case_name The name of the test case to run.
     /// \param user_config User-provided configuration variables.
+    /// \param vars Configuration variables passed to the body of the test.
     /// \param body_handle The exit handle of the test case's corresponding
     ///     body.  The cleanup will be executed in the same context.
     /// \param body_result The result of the test case's corresponding body.
@@ -889,6 +2320,7 @@ struct engine::scheduler::scheduler_handle::impl : utils::noncopyable {
     spawn_cleanup(const model::test_program_ptr test_program,
                   const std::string& test_case_name,
                   const config::tree& user_config,
+                  const properties_map_ptr vars,
                   const executor::exit_handle& body_handle,
                   const model::test_result& body_result)
     {
@@ -901,20 +2333,98 @@ struct engine::scheduler::scheduler_handle::impl : utils::noncopyable {
            test_case_name);
 
         const executor::exec_handle handle = generic.spawn_followup(
-            run_test_cleanup(interface, test_program, test_case_name,
-                             user_config),
+            run_test_cleanup(interface, test_program, test_case_name, vars),
             body_handle, cleanup_timeout);
 
         const exec_data_ptr data(new cleanup_exec_data(
-            test_program, test_case_name, body_handle, body_result));
+            test_program, test_case_name, body_handle, body_result,
+            output_limit(test_program->find(test_case_name), user_config)));
         LD(F("Inserting %s into all_exec_data (cleanup)") % handle.pid());
         INV_MSG(all_exec_data.find(handle.pid()) == all_exec_data.end(),
                 F("PID %s already in all_exec_data; not properly cleaned "
                   "up or reused too fast") % handle.pid());;
         all_exec_data.insert(exec_data_map::value_type(handle.pid(), data));
+        spawned(cleanup_spawned_event, handle.pid(), test_program,
+                test_case_name, utils::make_optional(handle));
 
         return handle;
     }
+
+    /// Spawns GDB to gather the stacktrace of a crashed subprocess.
+    ///
+    /// \param handle The exit handle of the crashed subprocess.
+    ///
+    /// \return True if GDB is now running in the background; false if it could
+    /// not be started, in which case the subprocess can be processed right
+    /// away.
+    bool
+    spawn_stacktrace(const executor::exit_handle& handle)
+    {
+        const exec_data_ptr data = (*all_exec_data.find(
+            handle.original_pid())).second;
+
+        const optional< executor::exec_handle > gdb_handle =
+            utils::start_stacktrace(data->test_program->absolute_path(),
+                                    generic, handle);
+        if (!gdb_handle)
+            return false;
+
+        const exec_data_ptr gdb_data(new stacktrace_exec_data(
+            data->test_program, data->test_case_name, handle));
+        LD(F("Inserting %s into all_exec_data (stacktrace)") %
+           gdb_handle.get().pid());
+        INV_MSG(all_exec_data.find(gdb_handle.get().pid()) ==
+                all_exec_data.end(),
+                F("PID %s already in all_exec_data; not properly cleaned "
+                  "up or reused too fast") % gdb_handle.get().pid());
+        all_exec_data.insert(exec_data_map::value_type(gdb_handle.get().pid(),
+                                                       gdb_data));
+        ++running;
+        ++active_stacktraces;
+        return true;
+    }
+
+    /// Starts gathering the stacktrace of a subprocess if it crashed.
+    ///
+    /// If there are max_stacktrace_jobs stacktraces in progress already, the
+    /// subprocess is queued until one of them finishes.
+    ///
+    /// \param handle The exit handle of the terminated subprocess.
+    ///
+    /// \return True if the processing of the subprocess has been deferred until
+    /// its stacktrace is complete; false otherwise.
+    bool
+    defer_for_stacktrace(const executor::exit_handle& handle)
+    {
+        const optional< process::status >& status = handle.status();
+        if (!status || !status.get().signaled())
+            return false;
+
+        if (active_stacktraces >= std::max(max_stacktrace_jobs,
+                                           std::size_t(1))) {
+            LD(F("Queuing stacktrace of %s") % handle.original_pid());
+            pending_stacktraces.push_back(handle);
+            return true;
+        }
+        return spawn_stacktrace(handle);
+    }
+
+    /// Accounts for the completion of a stacktrace and starts a queued one.
+    void
+    stacktrace_done(void)
+    {
+        PRE(active_stacktraces > 0);
+        --active_stacktraces;
+
+        while (!pending_stacktraces.empty() &&
+               active_stacktraces < std::max(max_stacktrace_jobs,
+                                             std::size_t(1))) {
+            const executor::exit_handle handle = pending_stacktraces.front();
+            pending_stacktraces.pop_front();
+            if (!spawn_stacktrace(handle))
+                ready_exits.push_back(handle);
+        }
+    }
 };
 
 
@@ -940,6 +2450,59 @@ scheduler::scheduler_handle::root_work_directory(void) const
 }
 
 
+/// Backs the root work directory with a tmpfs file system.
+///
+/// \pre No tests have been spawned yet.
+///
+/// \throw fs::error If the tmpfs cannot be mounted.
+void
+scheduler::scheduler_handle::mount_root_tmpfs(void)
+{
+    _pimpl->generic.mount_root_tmpfs();
+}
+
+
+/// Backs the work directory of every execution slot with its own tmpfs.
+///
+/// \pre No tests have been spawned yet.
+///
+/// \param size Maximum size of each file system; 0 for no limit.
+///
+/// \throw fs::error If the tmpfs cannot be mounted.
+void
+scheduler::scheduler_handle::mount_work_tmpfs(const units::bytes& size)
+{
+    _pimpl->generic.mount_work_tmpfs(size);
+}
+
+
+/// Runs every test in its own mount namespace with a tmpfs on its work
+/// directory.
+///
+/// \pre No tests have been spawned yet.
+///
+/// \param size Maximum size of each file system; 0 for no limit.
+///
+/// \throw fs::error If we lack the privileges to create mount namespaces.
+void
+scheduler::scheduler_handle::isolate_work_mounts(const units::bytes& size)
+{
+    _pimpl->generic.isolate_work_mounts(size);
+}
+
+
+/// Sets the destination of the output of the test cases and cleanup routines.
+///
+/// \param sink The sink to use, or NULL to write the output to files in the
+///     control directories.
+void
+scheduler::scheduler_handle::set_output_sink(
+    const std::shared_ptr< executor::output_sink > sink)
+{
+    _pimpl->generic.set_output_sink(sink);
+}
+
+
 /// Cleans up the scheduler state.
 ///
 /// This function should be called explicitly as it provides the means to
@@ -951,6 +2514,11 @@ void
 scheduler::scheduler_handle::cleanup(void)
 {
     _pimpl->generic.cleanup();
+
+    for (interfaces_map::const_iterator iter = interfaces.begin();
+         iter != interfaces.end(); ++iter) {
+        (*iter).second->finalize();
+    }
 }
 
 
@@ -1010,7 +2578,9 @@ scheduler::setup(void)
 
 /// Retrieves the list of test cases from a test program.
 ///
-/// This operation is currently synchronous.
+/// This operation is synchronous.  See spawn_list() for an asynchronous
+/// alternative.  Test programs whose interface provides a static test cases
+/// list are not executed.
 ///
 /// This operation should never throw.  Any errors during the processing of the
 /// test case list are subsumed into a single test case in the return value that
@@ -1031,9 +2601,32 @@ scheduler::scheduler_handle::list_tests(
     const std::shared_ptr< scheduler::interface > interface = find_interface(
         test_program->interface_name());
 
+    // The lists are swapped out of the optional objects below because
+    // returning their contents as is would copy them.
+    optional< model::test_cases_map > static_test_cases =
+        interface->static_list(*test_program);
+    if (static_test_cases) {
+        model::test_cases_map test_cases;
+        test_cases.swap(static_test_cases.get());
+        return test_cases;
+    }
+
+    const properties_map_ptr vars = _pimpl->test_suite_vars(
+        user_config, test_program->test_suite_name());
+
+    if (_pimpl->list_cache) {
+        optional< model::test_cases_map > cached =
+            _pimpl->list_cache.get().lookup(*test_program, *vars);
+        if (cached) {
+            model::test_cases_map test_cases;
+            test_cases.swap(cached.get());
+            return test_cases;
+        }
+    }
+
     try {
         const executor::exec_handle exec_handle = _pimpl->generic.spawn(
-            list_test_cases(interface, test_program, user_config),
+            list_test_cases(interface, test_program, vars),
             list_timeout, none);
         executor::exit_handle exit_handle = _pimpl->generic.wait(exec_handle);
 
@@ -1041,26 +2634,345 @@ scheduler::scheduler_handle::list_tests(
             exit_handle.status(),
             exit_handle.stdout_file(),
             exit_handle.stderr_file());
+        const datetime::delta duration =
+            exit_handle.end_time() - exit_handle.start_time();
 
         exit_handle.cleanup();
 
         if (test_cases.empty())
             throw std::runtime_error("Empty test cases list");
 
+        if (_pimpl->list_cache)
+            _pimpl->list_cache.get().store(*test_program, *vars, test_cases,
+                                           utils::make_optional(duration));
+
         return test_cases;
     } catch (const std::runtime_error& e) {
-        // TODO(jmmv): This is a very ugly workaround for the fact that we
-        // cannot report failures at the test-program level.
-        LW(F("Failed to load test cases list: %s") % e.what());
-        model::test_cases_map fake_test_cases;
-        fake_test_cases.insert(model::test_cases_map::value_type(
-            "__test_cases_list__",
-            model::test_case(
-                "__test_cases_list__",
-                "Represents the correct processing of the test cases list",
-                model::test_result(model::test_result_broken, e.what()))));
-        return fake_test_cases;
+        return fake_test_cases_list(e.what());
+    }
+}
+
+
+/// Lists the test cases of various test programs concurrently.
+///
+/// Up to parallelism listings run at once and each of them is collected as
+/// soon as it completes, so a test program that is slow to start does not
+/// delay the listing of the others.  Test programs whose listing is in the
+/// cache are not executed, and variants of a test program being listed wait
+/// for that listing instead of executing the test program again.  The
+/// test cases lists of any lazy_test_program objects are populated too.
+///
+/// \pre No other subprocesses may be in execution by the scheduler.
+///
+/// \param test_programs The test programs to list.
+/// \param user_config User-provided configuration variables.
+/// \param parallelism Maximum number of listings to run at once.
+/// \param hooks If not NULL, hooks to notify of every completed listing.
+/// \param [out] stats If not NULL, receives the statistics of the listing of
+///     every test program, in the same order as test_programs.
+///
+/// \return The test cases of every test program, in the same order as
+/// test_programs.  A failed listing yields a single fake test case that
+/// represents the failure, just like list_tests() does.
+std::vector< model::test_cases_map >
+scheduler::scheduler_handle::list_tests_batch(
+    const model::test_programs_vector& test_programs,
+    const config::tree& user_config,
+    const std::size_t parallelism,
+    list_hooks* hooks,
+    std::vector< listing_stats >* stats)
+{
+    PRE(parallelism >= 1);
+
+    std::vector< model::test_cases_map > results(test_programs.size());
+    std::vector< listing_stats > all_stats(test_programs.size());
+    listings_map in_flight;
+    std::vector< std::size_t > waiting;
+
+    std::size_t next = 0;
+    while (next < test_programs.size() || !in_flight.empty() ||
+           !waiting.empty()) {
+        // Variants whose sibling has been listed are now loaded; the others
+        // keep waiting until their sibling completes or a slot frees up.
+        std::vector< std::size_t > still_waiting;
+        for (std::vector< std::size_t >::const_iterator iter = waiting.begin();
+             iter != waiting.end(); ++iter) {
+            const model::test_program_ptr& test_program = test_programs[*iter];
+            if (load_cached(*this, test_program, user_config,
+                            all_stats[*iter])) {
+                results[*iter] = test_program->test_cases();
+                if (hooks != NULL)
+                    hooks->got_test_cases(*iter);
+            } else if (in_flight.size() >= parallelism ||
+                       has_sibling_in_flight(test_program, test_programs,
+                                             in_flight)) {
+                still_waiting.push_back(*iter);
+            } else {
+                in_flight[spawn_list(test_program, user_config)] = *iter;
+            }
+        }
+        waiting.swap(still_waiting);
+
+        while (next < test_programs.size() && in_flight.size() < parallelism) {
+            const model::test_program_ptr& test_program = test_programs[next];
+            if (load_cached(*this, test_program, user_config,
+                            all_stats[next])) {
+                results[next] = test_program->test_cases();
+                if (hooks != NULL)
+                    hooks->got_test_cases(next);
+            } else if (has_sibling_in_flight(test_program, test_programs,
+                                             in_flight)) {
+                waiting.push_back(next);
+            } else {
+                in_flight[spawn_list(test_program, user_config)] = next;
+            }
+            ++next;
+        }
+
+        if (in_flight.empty()) {
+            INV(waiting.empty());
+            continue;
+        }
+
+        result_handle_ptr result = wait_any();
+        const list_result_handle* list_result =
+            dynamic_cast< const list_result_handle* >(result.get());
+        INV_MSG(list_result != NULL, "Got a test result while only listing");
+        const listings_map::iterator iter = in_flight.find(
+            result->original_pid());
+        INV(iter != in_flight.end());
+        const std::size_t index = (*iter).second;
+        results[index] = list_result->test_cases();
+        all_stats[index].source = listing_executed;
+        all_stats[index].duration = result->end_time() - result->start_time();
+        all_stats[index].test_cases = results[index].size();
+        in_flight.erase(iter);
+        result->cleanup();
+        if (hooks != NULL)
+            hooks->got_test_cases(index);
+    }
+
+    if (stats != NULL)
+        stats->swap(all_stats);
+    return results;
+}
+
+
+/// Enables the caching of test case listings across runs.
+///
+/// Once enabled, list_tests() and load_cached_list() consult the cache before
+/// executing any test program, and any successful listing is recorded in it.
+///
+/// \param cache The cache to use.
+void
+scheduler::scheduler_handle::set_list_cache(const engine::list_cache& cache)
+{
+    _pimpl->list_cache = cache;
+}
+
+
+/// Sets the receiver of the events of the scheduler.
+///
+/// \param observer The observer to invoke on every event, which must outlive
+///     this handle; NULL to stop reporting events.
+void
+scheduler::scheduler_handle::set_observer(scheduler::observer* observer)
+{
+    _pimpl->observer = observer;
+}
+
+
+/// Populates a lazy test program without executing it, if possible.
+///
+/// This is meant to be called before spawn_list() to avoid executing test
+/// programs whose interface has a static test cases list or whose binaries
+/// have not changed since they were last listed.
+///
+/// \param test_program The test program to load.
+/// \param user_config User-provided configuration variables.
+/// \param [out] stats If not NULL and the test program is now loaded, receives
+///     how its test cases became known.  The duration and the number of test
+///     cases are left untouched.
+///
+/// \return True if the test program is now loaded; false if the caller must
+/// list it by other means.
+bool
+scheduler::scheduler_handle::load_cached_list(
+    const model::test_program_ptr test_program,
+    const config::tree& user_config,
+    listing_stats* stats)
+{
+    const lazy_test_program* lazy = dynamic_cast< const lazy_test_program* >(
+        test_program.get());
+    if (lazy == NULL || lazy->loaded()) {
+        if (stats != NULL)
+            stats->source = listing_known;
+        return true;
+    }
+
+    const optional< model::test_cases_map > static_test_cases =
+        find_interface(test_program->interface_name())->static_list(
+            *test_program);
+    if (static_test_cases) {
+        lazy->set_loaded_test_cases(static_test_cases.get());
+        if (stats != NULL)
+            stats->source = listing_known;
+        return true;
+    }
+
+    if (!_pimpl->list_cache)
+        return false;
+
+    optional< datetime::delta > cached_duration;
+    const optional< model::test_cases_map > cached =
+        _pimpl->list_cache.get().lookup(
+            *test_program,
+            *_pimpl->test_suite_vars(user_config,
+                                     test_program->test_suite_name()),
+            &cached_duration);
+    if (!cached)
+        return false;
+    lazy->set_loaded_test_cases(cached.get());
+    if (stats != NULL) {
+        stats->source = listing_cached;
+        stats->cached_duration = cached_duration;
+    }
+    return true;
+}
+
+
+/// Forks and lists the test cases of a test program asynchronously.
+///
+/// The completion of the listing is reported by wait_any() as a
+/// list_result_handle.  If the test program is a lazy_test_program, its test
+/// cases list is populated at that point too so that later calls to its
+/// test_cases() method do not execute the test program again.
+///
+/// \param test_program The test program from which to obtain the list of test
+///     cases.
+/// \param user_config User-provided configuration variables.
+///
+/// \return A handle for the background operation.  Used to match the result of
+/// the execution returned by wait_any() with this invocation.
+scheduler::exec_handle
+scheduler::scheduler_handle::spawn_list(
+    const model::test_program_ptr test_program,
+    const config::tree& user_config)
+{
+    _pimpl->generic.check_interrupt();
+
+    const datetime::timestamp start = datetime::timestamp::now();
+
+    const std::shared_ptr< scheduler::interface > interface = find_interface(
+        test_program->interface_name());
+
+    LI(F("Spawning %s (list)") % test_program->absolute_path());
+
+    const properties_map_ptr vars = _pimpl->test_suite_vars(
+        user_config, test_program->test_suite_name());
+    const executor::exec_handle handle = _pimpl->generic.spawn(
+        list_test_cases(interface, test_program.get(), vars),
+        list_timeout, none);
+
+    const exec_data_ptr data(new list_exec_data(test_program, interface,
+                                                vars));
+    LD(F("Inserting %s into all_exec_data (list)") % handle.pid());
+    INV_MSG(
+        _pimpl->all_exec_data.find(handle.pid()) == _pimpl->all_exec_data.end(),
+        F("PID %s already in all_exec_data; not cleaned up or reused too fast")
+        % handle.pid());;
+    _pimpl->all_exec_data.insert(exec_data_map::value_type(handle.pid(), data));
+    _pimpl->spawned(list_spawned_event, handle.pid(), test_program, "");
+
+    _pimpl->latencies["spawn"].record_interval(start,
+                                               datetime::timestamp::now());
+    return handle.pid();
+}
+
+
+/// Returns the latencies of the phases of the execution so far.
+///
+/// The "spawn" phase measures the time taken to start subprocesses, the "list"
+/// and "test" phases measure the lifetime of the listing and test case
+/// subprocesses respectively, "compute_result" measures the time taken to
+/// digest the outcome of a test case and "wait" measures the time the caller
+/// spent blocked in wait_any().
+///
+/// \return A collection of histograms keyed by phase name.
+const utils::latency_histograms_map&
+scheduler::scheduler_handle::latencies(void) const
+{
+    return _pimpl->latencies;
+}
+
+
+/// Checks whether a test case has to be skipped due to unmet requirements.
+///
+/// The checks are memoized in the scheduler so that it is cheap to call this
+/// ahead of spawn_test() to avoid spawning test cases that would only report
+/// themselves as skipped.  Requirements that depend on the work directory of
+/// the test case are not evaluated here, so spawned test cases may still end
+/// up skipped.
+///
+/// \param test_program The container test program.
+/// \param test_case_name The name of the test case to check.
+/// \param user_config User-provided configuration variables.
+///
+/// \return A string describing the reason for skipping the test, or empty if
+/// the test should be executed.
+std::string
+scheduler::scheduler_handle::check_requirements(
+    const model::test_program_ptr test_program,
+    const std::string& test_case_name,
+    const config::tree& user_config)
+{
+    const model::test_case& test_case = test_program->find(test_case_name);
+    if (test_case.fake_result())
+        return "";
+
+    return _pimpl->requirements.check(
+        test_case.get_metadata(),
+        _pimpl->test_program_config(user_config, test_program),
+        test_program->test_suite_name());
+}
+
+
+/// Prepares the spawn of the test cases that are going to run next.
+///
+/// The first spawn of a test case of each test program computes data that the
+/// rest reuse: the configuration of the variant of the test program, its
+/// configuration variables and its execution plan.  Spawns also need a
+/// control directory, which they take from those left behind by finished
+/// subprocesses or create anew.  Calling this while waiting for the running
+/// test cases does all of this in advance, so that a freed slot turns into a
+/// running test case with little more than a fork.
+///
+/// \param test_programs The test programs whose test cases are going to be
+///     spawned next.
+/// \param user_config User-provided configuration variables.
+/// \param count The number of test cases that are going to be spawned next.
+///
+/// \throw fs::error If the control directories cannot be created.
+void
+scheduler::scheduler_handle::prepare_spawns(
+    const model::test_programs_vector& test_programs,
+    const config::tree& user_config,
+    const std::size_t count)
+{
+    _pimpl->sync_config(user_config);
+    for (model::test_programs_vector::const_iterator iter =
+             test_programs.begin(); iter != test_programs.end(); ++iter) {
+        if (_pimpl->plans_cache.find(*iter) != _pimpl->plans_cache.end())
+            continue;
+
+        const std::shared_ptr< scheduler::interface > interface =
+            find_interface((*iter)->interface_name());
+        const properties_map_ptr vars = _pimpl->test_program_vars(user_config,
+                                                                  **iter);
+        (void)_pimpl->test_program_plan(interface, *iter, vars);
+        (void)_pimpl->test_program_config(user_config, *iter);
     }
+    _pimpl->generic.reserve_directories(count);
 }
 
 
@@ -1072,6 +2984,11 @@ scheduler::scheduler_handle::list_tests(
 /// \param test_program The container test program.
 /// \param test_case_name The name of the test case to run.
 /// \param user_config User-provided configuration variables.
+/// \param cpus CPUs to which to pin the body of the test case; empty to let
+///     it run on any CPU.
+/// \param timeout Timeout to arm for the body of the test case in place of
+///     the one declared in its metadata.  Only honored if shorter than the
+///     declared timeout.
 ///
 /// \return A handle for the background operation.  Used to match the result of
 /// the execution returned by wait_any() with this invocation.
@@ -1079,72 +2996,213 @@ scheduler::exec_handle
 scheduler::scheduler_handle::spawn_test(
     const model::test_program_ptr test_program,
     const std::string& test_case_name,
-    const config::tree& user_config)
+    const config::tree& user_config,
+    const std::set< int >& cpus,
+    const optional< datetime::delta >& timeout)
 {
     _pimpl->generic.check_interrupt();
 
+    const datetime::timestamp start = datetime::timestamp::now();
+
     const std::shared_ptr< scheduler::interface > interface = find_interface(
         test_program->interface_name());
 
     LI(F("Spawning %s:%s") % test_program->absolute_path() % test_case_name);
 
     const model::test_case& test_case = test_program->find(test_case_name);
+    const properties_map_ptr vars = _pimpl->test_program_vars(user_config,
+                                                              *test_program);
+    const config::tree test_config = _pimpl->test_program_config(
+        user_config, test_program);
+
+    optional< datetime::delta > adaptive_timeout;
+    if (timeout && timeout.get() < test_case.get_metadata().timeout()) {
+        LI(F("Arming adaptive timeout of %s for %s:%s") %
+           format_seconds(timeout.get()) % test_program->relative_path() %
+           test_case_name);
+        adaptive_timeout = timeout;
+    }
 
     optional< passwd::user > unprivileged_user;
-    if (user_config.is_set("unprivileged_user") &&
+    if (user_config.is_set(unprivileged_user_key) &&
         test_case.get_metadata().required_user() == "unprivileged") {
         unprivileged_user = user_config.lookup< engine::user_node >(
-            "unprivileged_user");
+            unprivileged_user_key);
     }
 
-    const executor::exec_handle handle = _pimpl->generic.spawn(
-        run_test_program(interface, test_program, test_case_name,
-                         user_config),
-        test_case.get_metadata().timeout(),
-        unprivileged_user);
+    const std::string skip_reason = test_case.fake_result() ? "" :
+        _pimpl->requirements.check(test_case.get_metadata(), test_config,
+                                   test_program->test_suite_name());
+
+    // Only the requirements tied to the work directory are checked by the
+    // child, so only those test cases need a channel to report back a skip.
+    optional< std::pair< int, int > > status_pipe;
+    if (skip_reason.empty() && !test_case.fake_result() &&
+        test_case.get_metadata().required_disk_space() > 0)
+        status_pipe = open_status_pipe();
+    const int status_read_fd = status_pipe ? status_pipe.get().first : -1;
+    const int status_write_fd = status_pipe ? status_pipe.get().second : -1;
+
+    optional< std::pair< int, int > > result_pipe;
+    if (skip_reason.empty() && !test_case.fake_result() &&
+        interface->accepts_result_pipe() &&
+        test_config.is_set(atf_result_pipe_key) &&
+        test_config.lookup< config::bool_node >(atf_result_pipe_key))
+        result_pipe = open_status_pipe();
+    const int result_read_fd = result_pipe ? result_pipe.get().first : -1;
+    const int result_write_fd = result_pipe ? result_pipe.get().second : -1;
+
+    optional< executor::exec_handle > handle;
+    try {
+        const run_test_program body(interface, test_program, test_case_name,
+                                    test_config, vars, cpus, skip_reason,
+                                    status_write_fd, result_write_fd,
+                                    _pimpl->test_program_plan(
+                                        interface, test_program, vars));
+        body.prepare();
+        handle = _pimpl->generic.spawn(
+            body,
+            adaptive_timeout ? adaptive_timeout.get() :
+                test_case.get_metadata().timeout(),
+            unprivileged_user);
+    } catch (...) {
+        if (status_pipe) {
+            ::close(status_read_fd);
+            ::close(status_write_fd);
+        }
+        if (result_pipe) {
+            ::close(result_read_fd);
+            ::close(result_write_fd);
+        }
+        throw;
+    }
+    if (status_pipe)
+        ::close(status_write_fd);
+    if (result_pipe)
+        ::close(result_write_fd);
 
     const exec_data_ptr data(new test_exec_data(
-        test_program, test_case_name, interface, user_config));
-    LD(F("Inserting %s into all_exec_data") % handle.pid());
+        test_program, test_case, interface, test_config, vars,
+        skip_reason, status_read_fd, result_read_fd, adaptive_timeout));
+    const int pid = handle.get().pid();
+    LD(F("Inserting %s into all_exec_data") % pid);
     INV_MSG(
-        _pimpl->all_exec_data.find(handle.pid()) == _pimpl->all_exec_data.end(),
+        _pimpl->all_exec_data.find(pid) == _pimpl->all_exec_data.end(),
         F("PID %s already in all_exec_data; not cleaned up or reused too fast")
-        % handle.pid());;
-    _pimpl->all_exec_data.insert(exec_data_map::value_type(handle.pid(), data));
-
-    return handle.pid();
+        % pid);;
+    _pimpl->all_exec_data.insert(exec_data_map::value_type(pid, data));
+    _pimpl->spawned(test_spawned_event, pid, test_program, test_case_name,
+                    handle);
+
+    _pimpl->latencies["spawn"].record_interval(start,
+                                               datetime::timestamp::now());
+    return pid;
 }
 
 
-/// Waits for completion of any forked test case.
+/// Processes the termination of a subprocess spawned by the scheduler.
 ///
 /// Note that if the terminated test case has a cleanup routine, this function
 /// is the one in charge of spawning the cleanup routine asynchronously.
 ///
-/// \return The result of the execution of a subprocess.  This is a dynamically
-/// allocated object because the scheduler can spawn subprocesses of various
-/// types and, at wait time, we don't know upfront what we are going to get.
+/// Similarly, if the subprocess dumped core, this spawns GDB asynchronously to
+/// gather a stacktrace and the processing of the subprocess resumes once GDB
+/// terminates.
+///
+/// \param handle The exit handle of the terminated subprocess.
+/// \param gather_stacktrace Whether to gather a stacktrace if the subprocess
+///     dumped core.  False if an attempt has already been made.
+///
+/// \return The result of the execution of the subprocess, or a null pointer if
+/// the termination is not visible to the caller (i.e. the body of a test case
+/// finished and its cleanup routine or its stacktrace collection was spawned
+/// in the background).
 scheduler::result_handle_ptr
-scheduler::scheduler_handle::wait_any(void)
+scheduler::scheduler_handle::process_exit(executor::exit_handle handle,
+                                          const bool gather_stacktrace)
 {
-    _pimpl->generic.check_interrupt();
+    exec_data_ptr data = (*_pimpl->all_exec_data.find(
+        handle.original_pid())).second;
+
+    const stacktrace_exec_data* stacktrace_data =
+        dynamic_cast< const stacktrace_exec_data* >(data.get());
+    if (stacktrace_data != NULL) {
+        LD(F("Got %s from all_exec_data (stacktrace)") %
+           handle.original_pid());
+        _pimpl->latencies["stacktrace"].record_interval(handle.start_time(),
+                                                        handle.end_time());
+        utils::finish_stacktrace(handle);
+
+        // Resume the processing of the crashed subprocess, which the caller
+        // has been waiting for, now that its stderr holds the stacktrace.
+        LD(F("Removing %s from all_exec_data (stacktrace) in favor of %s")
+           % handle.original_pid()
+           % stacktrace_data->crashed_exit_handle.original_pid());
+        const executor::exit_handle crashed_handle =
+            stacktrace_data->crashed_exit_handle;
+        _pimpl->all_exec_data.erase(handle.original_pid());
+        _pimpl->stacktrace_done();
+        handle = crashed_handle;
+        data = (*_pimpl->all_exec_data.find(handle.original_pid())).second;
+    } else if (gather_stacktrace && _pimpl->defer_for_stacktrace(handle)) {
+        // GDB may take a long time, so let the caller collect other
+        // subprocesses in the meantime instead of blocking here.
+        return result_handle_ptr();
+    }
 
-    executor::exit_handle handle = _pimpl->generic.wait_any();
+    const list_exec_data* list_data = dynamic_cast< const list_exec_data* >(
+        data.get());
+    if (list_data != NULL) {
+        LD(F("Got %s from all_exec_data (list)") % handle.original_pid());
+        _pimpl->latencies["list"].record_interval(handle.start_time(),
+                                                  handle.end_time());
+
+        model::test_cases_map test_cases;
+        try {
+            list_data->interface->parse_list(
+                handle.status(), handle.stdout_file(), handle.stderr_file())
+                .swap(test_cases);
+            if (test_cases.empty())
+                throw std::runtime_error("Empty test cases list");
+            if (_pimpl->list_cache)
+                _pimpl->list_cache.get().store(
+                    *list_data->test_program, *list_data->vars, test_cases,
+                    utils::make_optional(handle.end_time() -
+                                         handle.start_time()));
+        } catch (const std::runtime_error& e) {
+            fake_test_cases_list(e.what()).swap(test_cases);
+        }
+
+        const lazy_test_program* lazy =
+            dynamic_cast< const lazy_test_program* >(
+                list_data->test_program.get());
+        if (lazy != NULL && !lazy->loaded())
+            lazy->set_loaded_test_cases(test_cases);
 
-    const exec_data_map::iterator iter = _pimpl->all_exec_data.find(
-        handle.original_pid());
-    exec_data_ptr data = (*iter).second;
+        // The caller may hold onto the result for a while, but the PID of the
+        // subprocess is free for reuse already.
+        LD(F("Removing %s from all_exec_data (list)") % handle.original_pid());
+        _pimpl->all_exec_data.erase(handle.original_pid());
 
-    utils::dump_stacktrace_if_available(data->test_program->absolute_path(),
-                                        _pimpl->generic, handle);
+        std::shared_ptr< result_handle::bimpl > result_handle_bimpl(
+            new result_handle::bimpl(handle));
+        std::shared_ptr< list_result_handle::impl > list_result_handle_impl(
+            new list_result_handle::impl(list_data->test_program, test_cases));
+        return result_handle_ptr(new list_result_handle(
+            result_handle_bimpl, list_result_handle_impl));
+    }
 
     optional< model::test_result > result;
+    units::bytes max_output_size;
     try {
         test_exec_data* test_data = &dynamic_cast< test_exec_data& >(
             *data.get());
         LD(F("Got %s from all_exec_data") % handle.original_pid());
+        max_output_size = test_data->max_output_size;
 
         test_data->exit_handle = handle;
+        _pimpl->latencies["test"].record_interval(handle.start_time(),
+                                                  handle.end_time());
 
         const model::test_case& test_case = test_data->test_program->find(
             test_data->test_case_name);
@@ -1155,18 +3213,16 @@ scheduler::scheduler_handle::wait_any(void)
             handle.status().get().exitstatus() == exit_skipped) {
             // If the test's process terminated with our magic "exit_skipped"
             // status, there are two cases to handle.  The first is the case
-            // where the "skipped cookie" exists, in which case we never got to
+            // where we know of a skip reason, in which case we never got to
             // actually invoke the test program; if that's the case, handle it
             // here.  The second case is where the test case actually decided to
             // exit with the "exit_skipped" status; in that case, just fall back
             // to the regular status handling.
-            const fs::path skipped_cookie_path = handle.control_directory() /
-                skipped_cookie;
-            std::ifstream input(skipped_cookie_path.c_str());
-            if (input) {
+            const optional< std::string > skip_reason =
+                test_data->child_skip_reason(handle.control_directory());
+            if (skip_reason) {
                 result = model::test_result(model::test_result_skipped,
-                                            utils::read_stream(input));
-                input.close();
+                                            skip_reason.get());
 
                 // If we determined that the test needs to be skipped, we do not
                 // want to run the cleanup routine because doing so could result
@@ -1176,12 +3232,36 @@ scheduler::scheduler_handle::wait_any(void)
                 test_data->needs_cleanup = false;
             }
         }
+        if (!result && handle.status() && handle.status().get().exited() &&
+            handle.status().get().exitstatus() == exit_broken) {
+            // Same as above, but for a test case that could not be set up in
+            // the child.  The body did not run, so neither does its cleanup.
+            const optional< std::string > broken_reason =
+                test_data->child_broken_reason(handle.control_directory());
+            if (broken_reason) {
+                result = model::test_result(model::test_result_broken,
+                                            broken_reason.get());
+                test_data->needs_cleanup = false;
+            }
+        }
         if (!result) {
-            result = test_data->interface->compute_result(
-                handle.status(),
-                handle.control_directory(),
-                handle.stdout_file(),
-                handle.stderr_file());
+            const datetime::timestamp start = datetime::timestamp::now();
+            result = test_data->compute_result(handle);
+            _pimpl->latencies["compute_result"].record_interval(
+                start, datetime::timestamp::now());
+
+            if (!handle.status() && test_data->adaptive_timeout) {
+                // Make it clear that the test would have had more time had
+                // it not been for the adaptive timeout.
+                _pimpl->latencies["adaptive_timeout"].record_interval(
+                    handle.start_time(), handle.end_time());
+                result = model::test_result(
+                    result.get().type(),
+                    F("%s (adaptive timeout of %s; declared %s)") %
+                    result.get().reason() %
+                    format_seconds(test_data->adaptive_timeout.get()) %
+                    format_seconds(test_case.get_metadata().timeout()));
+            }
         }
         INV(result);
 
@@ -1197,15 +3277,13 @@ scheduler::scheduler_handle::wait_any(void)
             // completion.  The caller never knows about cleanup routines.
             _pimpl->spawn_cleanup(test_data->test_program,
                                   test_data->test_case_name,
-                                  test_data->user_config, handle, result.get());
+                                  test_data->user_config, test_data->vars,
+                                  handle, result.get());
             test_data->needs_cleanup = false;
 
-            // TODO(jmmv): Chaining this call is ugly.  We'd be better off by
-            // looping over terminated processes until we got a result suitable
-            // for user consumption.  For the time being this is good enough and
-            // not a problem because the call chain won't get big: the majority
-            // of test cases do not have cleanup routines.
-            return wait_any();
+            // The caller loops over terminated processes until it gets a
+            // result suitable for user consumption.
+            return result_handle_ptr();
         }
     } catch (const std::bad_cast& e) {
         const cleanup_exec_data* cleanup_data =
@@ -1218,6 +3296,8 @@ scheduler::scheduler_handle::wait_any(void)
         // because the caller wants to see the exact same exec_handle that was
         // returned by spawn_test.
 
+        max_output_size = cleanup_data->max_output_size;
+
         const model::test_result& body_result = cleanup_data->body_result;
         if (body_result.good()) {
             if (!handle.status()) {
@@ -1249,8 +3329,21 @@ scheduler::scheduler_handle::wait_any(void)
     }
     INV(result);
 
+    try {
+        truncate_output(handle.stdout_file(), max_output_size);
+        truncate_output(handle.stderr_file(), max_output_size);
+    } catch (const engine::error& e) {
+        LW(F("Cannot bound the output of the test: %s") % e.what());
+    }
+
+    // The caller may defer the cleanup of the result until after it has
+    // spawned further tests, but the PID of the subprocess is free for reuse
+    // already.
+    LD(F("Removing %s from all_exec_data") % handle.original_pid());
+    _pimpl->all_exec_data.erase(handle.original_pid());
+
     std::shared_ptr< result_handle::bimpl > result_handle_bimpl(
-        new result_handle::bimpl(handle, _pimpl->all_exec_data));
+        new result_handle::bimpl(handle));
     std::shared_ptr< test_result_handle::impl > test_result_handle_impl(
         new test_result_handle::impl(
             data->test_program, data->test_case_name, result.get()));
@@ -1259,6 +3352,104 @@ scheduler::scheduler_handle::wait_any(void)
 }
 
 
+/// Waits for completion of any forked test case.
+///
+/// \return The result of the execution of a subprocess.  This is a dynamically
+/// allocated object because the scheduler can spawn subprocesses of various
+/// types and, at wait time, we don't know upfront what we are going to get:
+/// test_result_handle for tests spawned by spawn_test() and list_result_handle
+/// for listings spawned by spawn_list().
+scheduler::result_handle_ptr
+scheduler::scheduler_handle::wait_any(void)
+{
+    for (;;) {
+        _pimpl->generic.check_interrupt();
+
+        if (!_pimpl->ready_exits.empty()) {
+            const executor::exit_handle handle = _pimpl->ready_exits.front();
+            _pimpl->ready_exits.pop_front();
+            const result_handle_ptr result = process_exit(handle, false);
+            if (result)
+                return result;
+            continue;
+        }
+
+        const datetime::timestamp start = datetime::timestamp::now();
+        optional< executor::exit_handle > handle;
+        while (!handle) {
+            // Tests that report their results through a pipe block once the
+            // pipe is full, so keep draining the pipes while waiting.
+            handle = _pimpl->generic.poll_any();
+            if (!handle && !_pimpl->read_result_pipes(result_pipes_poll_msec))
+                handle = _pimpl->generic.wait_any();
+        }
+        _pimpl->latencies["wait"].record_interval(start,
+                                                  datetime::timestamp::now());
+        _pimpl->exited(handle.get());
+
+        const result_handle_ptr result = process_exit(handle.get());
+        if (result)
+            return result;
+    }
+}
+
+
+/// Collects the result of any completed subprocess without blocking.
+///
+/// This is the non-blocking counterpart of wait_any(), which allows the caller
+/// to process all already-completed subprocesses and go back to doing other
+/// work before having to block.
+///
+/// \return The result of the execution of a subprocess, as in wait_any(), or
+/// none if no subprocess has completed yet.
+optional< scheduler::result_handle_ptr >
+scheduler::scheduler_handle::poll_any(void)
+{
+    for (;;) {
+        _pimpl->generic.check_interrupt();
+
+        bool gather_stacktrace = true;
+        optional< executor::exit_handle > handle;
+        if (!_pimpl->ready_exits.empty()) {
+            handle = _pimpl->ready_exits.front();
+            _pimpl->ready_exits.pop_front();
+            gather_stacktrace = false;
+        } else {
+            handle = _pimpl->generic.poll_any();
+            if (!handle) {
+                (void)_pimpl->read_result_pipes(0);
+                return none;
+            }
+            _pimpl->exited(handle.get());
+        }
+
+        const result_handle_ptr result = process_exit(handle.get(),
+                                                      gather_stacktrace);
+        if (result)
+            return utils::make_optional(result);
+    }
+}
+
+
+/// Forcibly terminates a spawned test case or listing before it completes.
+///
+/// The result of the subprocess must still be collected with wait_any() or
+/// poll_any() and it is reported as if the subprocess had crashed.  If the body
+/// of a test case has already finished, this does nothing: its cleanup routine,
+/// if any, is always allowed to run to completion so that it can undo any side
+/// effects of the body.  This also does nothing if the result has already been
+/// collected: the PID of the subprocess may have been reused by then.
+///
+/// \param exec_handle The handle returned by spawn_test() or spawn_list().
+void
+scheduler::scheduler_handle::terminate(const exec_handle exec_handle)
+{
+    if (_pimpl->all_exec_data.find(exec_handle) == _pimpl->all_exec_data.end())
+        return;
+    _pimpl->generic.terminate(exec_handle);
+}
+
+
 /// Forks and executes a test case synchronously for debugging.
 ///
 /// \pre No other processes should be in execution by the scheduler.
@@ -1352,11 +3543,38 @@ scheduler::generate_config(const config::tree& user_config,
 
     // TODO(jmmv): This is a hack that exists for the ATF interface only, so it
     // should be moved there.
-    if (user_config.is_set("unprivileged_user")) {
+    if (user_config.is_set(unprivileged_user_key)) {
         const passwd::user& user =
-            user_config.lookup< engine::user_node >("unprivileged_user");
+            user_config.lookup< engine::user_node >(unprivileged_user_key);
         props["unprivileged-user"] = user.name;
     }
 
     return props;
 }
+
+
+/// Applies the configuration variables of a test program variant.
+///
+/// \param user_config The configuration variables provided by the user.
+/// \param test_program The test program to run.
+///
+/// \return A copy of user_config in which the test suite variables overridden
+/// by the variant of the test program, if any, have their variant values.
+/// The copy is shallow if the test program has no variant variables.
+config::tree
+scheduler::variant_config(const config::tree& user_config,
+                          const model::test_program& test_program)
+{
+    const config::properties_map& vars = test_program.variant_vars();
+    if (vars.empty())
+        return user_config;
+
+    config::tree config = user_config.deep_copy();
+    for (config::properties_map::const_iterator iter = vars.begin();
+         iter != vars.end(); ++iter) {
+        config.set_string(F("test_suites.%s.%s") %
+                          test_program.test_suite_name() % (*iter).first,
+                          (*iter).second);
+    }
+    return config;
+}
@@ -57,27 +57,59 @@
 
 #include "engine/scheduler_fwd.hpp"
 
+#include <cstddef>
+#include <deque>
+#include <map>
 #include <set>
 #include <string>
+#include <vector>
 
+#include "engine/list_cache_fwd.hpp"
 #include "model/context_fwd.hpp"
 #include "model/metadata_fwd.hpp"
 #include "model/test_case_fwd.hpp"
 #include "model/test_program.hpp"
 #include "model/test_result_fwd.hpp"
 #include "utils/config/tree_fwd.hpp"
-#include "utils/datetime_fwd.hpp"
+#include "utils/datetime.hpp"
 #include "utils/defs.hpp"
 #include "utils/fs/path_fwd.hpp"
+#include "utils/latency_histogram_fwd.hpp"
 #include "utils/optional.hpp"
+#include "utils/fs/path.hpp"
 #include "utils/process/executor_fwd.hpp"
+#include "utils/process/operations_fwd.hpp"
+#include "utils/process/resource_usage_fwd.hpp"
 #include "utils/process/status_fwd.hpp"
 #include "utils/shared_ptr.hpp"
+#include "utils/units_fwd.hpp"
 
 namespace engine {
 namespace scheduler {
 
 
+/// Pre-built description of how to execute the test cases of a test program.
+///
+/// Interfaces that return one of these from interface::plan_test() have it
+/// computed once per test program in the scheduler process, so that the
+/// subprocess of every test case does not have to format the same arguments
+/// and environment again after forking.
+struct exec_plan {
+    /// The binary to execute.
+    utils::fs::path program;
+
+    /// Leading arguments to pass to the binary, without the program name.
+    utils::process::args_vector args;
+
+    /// Variables to add to the environment of the binary.
+    std::map< std::string, std::string > environment;
+
+    explicit exec_plan(const utils::fs::path&);
+
+    void exec(const utils::process::args_vector&) const UTILS_NORETURN;
+};
+
+
 /// Abstract interface of a test program scheduler interface.
 ///
 /// This interface defines the test program-specific operations that need to be
@@ -88,6 +120,19 @@ public:
     /// Destructor.
     virtual ~interface() {}
 
+    /// Computes the test cases list of a test program without executing it.
+    ///
+    /// Interfaces whose test programs always expose the same test cases can
+    /// return them here, in which case the scheduler does not spawn a
+    /// subprocess to invoke exec_list() and parse_list() at all.
+    ///
+    /// \param test_program The test program to list.
+    ///
+    /// \return The list of test cases, or none if the test program has to be
+    /// executed to obtain it.
+    virtual utils::optional< model::test_cases_map > static_list(
+        const model::test_program& test_program) const;
+
     /// Executes a test program's list operation.
     ///
     /// This method is intended to be called within a subprocess and is expected
@@ -130,6 +175,38 @@ public:
                            const utils::fs::path& control_directory)
         const UTILS_NORETURN = 0;
 
+    /// Describes how to execute the test cases of a test program.
+    ///
+    /// This method is called from the scheduler process the first time that a
+    /// test case of the program is spawned.  If it returns a plan, the
+    /// subprocesses of the test cases of the program invoke
+    /// exec_planned_test() with it in place of exec_test().
+    ///
+    /// \param test_program The test program to execute.
+    /// \param vars User-provided variables to pass to the test program.
+    ///
+    /// \return The execution plan of the test program, or none to have the
+    /// subprocesses invoke exec_test().
+    virtual utils::optional< exec_plan > plan_test(
+        const model::test_program& test_program,
+        const utils::config::properties_map& vars) const;
+
+    /// Executes a test case of the test program following a plan.
+    ///
+    /// This method is intended to be called within a subprocess and is expected
+    /// to terminate execution either by exec(2)ing the test program or by
+    /// exiting with a failure.  The default implementation executes the plan
+    /// as is, for interfaces whose test cases need no arguments of their own.
+    ///
+    /// \param plan The plan returned by plan_test().
+    /// \param test_case_name Name of the test case to invoke.
+    /// \param control_directory Directory where the interface may place control
+    ///     files.
+    virtual void exec_planned_test(const exec_plan& plan,
+                                   const std::string& test_case_name,
+                                   const utils::fs::path& control_directory)
+        const UTILS_NORETURN;
+
     /// Executes a test cleanup routine of the test program.
     ///
     /// This method is intended to be called within a subprocess and is expected
@@ -162,6 +239,199 @@ public:
         const utils::fs::path& control_directory,
         const utils::fs::path& stdout_path,
         const utils::fs::path& stderr_path) const = 0;
+
+    /// Checks whether the test cases can send their results through a pipe.
+    ///
+    /// If so, and if the atf_result_pipe configuration variable is enabled,
+    /// the scheduler sets up a pipe for every test case and exec_test() finds
+    /// its write end in the result_fd descriptor.  The data sent through it is
+    /// then handed to compute_piped_result() in place of compute_result().
+    /// Otherwise, result_fd is closed when exec_test() runs.
+    ///
+    /// \return True if the interface implements compute_piped_result().
+    virtual bool accepts_result_pipe(void) const;
+
+    /// Computes the result of a test case that had a result pipe.
+    ///
+    /// \param status The termination status of the subprocess used to execute
+    ///     the exec_test() method or none if the test timed out.
+    /// \param control_directory Directory where the interface may have placed
+    ///     control files.
+    /// \param stdout_path Path to the file containing the stdout of the test.
+    /// \param stderr_path Path to the file containing the stderr of the test.
+    /// \param piped_result The data that the test case sent through the result
+    ///     pipe, which is empty if it sent nothing.
+    ///
+    /// \return A test result.
+    virtual model::test_result compute_piped_result(
+        const utils::optional< utils::process::status >& status,
+        const utils::fs::path& control_directory,
+        const utils::fs::path& stdout_path,
+        const utils::fs::path& stderr_path,
+        const std::string& piped_result) const;
+
+    /// Computes the results of the individual checks of a test case.
+    ///
+    /// \param stdout_path Path to the file containing the stdout of the test.
+    ///
+    /// \return The results of the checks reported by the test case, in the
+    /// order in which they were reported, or an empty collection if the
+    /// interface does not report individual checks.
+    virtual std::vector< model::test_result > compute_sub_results(
+        const utils::fs::path& stdout_path) const;
+
+    /// Prepares the execution of a test case from the scheduler process.
+    ///
+    /// This method is called right before spawning the subprocess that will
+    /// invoke exec_test(), so any state set up here is visible to it.
+    ///
+    /// \param test_program The test program to execute.
+    /// \param vars User-provided variables to pass to the test program.
+    virtual void prepare_test(const model::test_program& test_program,
+                              const utils::config::properties_map& vars)
+        const;
+
+    /// Releases any resources kept by the interface across test cases.
+    ///
+    /// This method is called from the scheduler process when the scheduler is
+    /// cleaned up, once no more test cases will be executed.
+    virtual void finalize(void) const;
+};
+
+
+/// Hooks to follow the progress of scheduler_handle::list_tests_batch().
+class list_hooks {
+public:
+    virtual ~list_hooks(void) = 0;
+
+    /// Called when the test cases of a test program become known.
+    ///
+    /// This happens in completion order, not in the order of the input.
+    ///
+    /// \param index Position of the test program in the input of the batch.
+    virtual void got_test_cases(const std::size_t index) = 0;
+};
+
+
+/// Ways in which the test cases of a test program can become known.
+enum listing_source {
+    /// The test program was executed to list its test cases.
+    listing_executed,
+    /// The test cases were found in the list cache.
+    listing_cached,
+    /// The test cases were known without executing the test program, either
+    /// because its interface knows them statically or because they were
+    /// already loaded.
+    listing_known
+};
+
+
+/// Statistics about how the test cases of a test program became known.
+struct listing_stats {
+    /// How the test cases were obtained.
+    listing_source source;
+
+    /// Time it took to obtain the test cases in this run.
+    utils::datetime::delta duration;
+
+    /// Time that the execution of the test program took when its test cases
+    /// were stored in the list cache, if known.
+    utils::optional< utils::datetime::delta > cached_duration;
+
+    /// Number of test cases of the test program.
+    std::size_t test_cases;
+
+    listing_stats(void);
+};
+
+
+/// Types of the events reported to an observer.
+enum event_type {
+    /// A subprocess to list the test cases of a test program was started.
+    list_spawned_event,
+    /// A subprocess to run the body of a test case was started.
+    test_spawned_event,
+    /// A subprocess to run the cleanup routine of a test case was started.
+    cleanup_spawned_event,
+    /// A subprocess terminated before reaching its timeout.
+    exited_event,
+    /// A subprocess was killed for exceeding its timeout.
+    timed_out_event
+};
+
+
+/// Representation of something that happened within the scheduler.
+struct event {
+    /// The type of the event.
+    event_type type;
+
+    /// The identifier of the subprocess the event refers to.
+    int pid;
+
+    /// The test program the subprocess belongs to.
+    model::test_program_ptr test_program;
+
+    /// The name of the test case; empty for listings.
+    std::string test_case_name;
+
+    /// The moment the event happened.
+    utils::datetime::timestamp timestamp;
+
+    /// Number of subprocesses running right after the event.
+    std::size_t running;
+
+    /// File to which the subprocess writes its stdout.
+    ///
+    /// Only set for the events of test cases and cleanup routines being
+    /// spawned.  The file is only valid until the subprocess is cleaned up.
+    utils::optional< utils::fs::path > stdout_file;
+
+    /// File to which the subprocess writes its stderr; see stdout_file.
+    utils::optional< utils::fs::path > stderr_file;
+
+    event(const event_type, const int, const model::test_program_ptr,
+          const std::string&, const utils::datetime::timestamp&,
+          const std::size_t);
+};
+
+
+/// Receives the events of a scheduler_handle as they happen.
+///
+/// Observers are invoked synchronously from within the scheduler, so they must
+/// be cheap: anything that may block, such as I/O, should be deferred by
+/// recording the events in an event_queue and consuming them later.
+class observer {
+public:
+    virtual ~observer(void) = 0;
+
+    /// Called when an event happens.
+    ///
+    /// \param event The event.
+    virtual void got_event(const event& event) = 0;
+};
+
+
+/// Observer that buffers events for later consumption.
+///
+/// The queue is bounded so that an idle consumer cannot make it grow without
+/// limit: once full, the oldest events are discarded.
+class event_queue : public observer {
+    /// Maximum number of events to buffer.
+    std::size_t _capacity;
+
+    /// Buffered events, oldest first.
+    std::deque< event > _events;
+
+    /// Number of events discarded due to the queue being full.
+    std::size_t _dropped;
+
+public:
+    explicit event_queue(const std::size_t);
+
+    void got_event(const event&);
+
+    std::vector< event > drain(void);
+    std::size_t dropped(void) const;
 };
 
 
@@ -172,14 +442,25 @@ class lazy_test_program : public model::test_program {
     /// Pointer to the shared internal implementation.
     std::shared_ptr< impl > _pimpl;
 
+    friend class scheduler_handle;
+    void set_loaded_test_cases(const model::test_cases_map&) const;
+
 public:
     lazy_test_program(const std::string&, const utils::fs::path&,
                       const utils::fs::path&, const std::string&,
                       const model::metadata&,
                       const utils::config::tree&,
-                      scheduler_handle&);
-
+                      scheduler_handle&,
+                      const std::string& = "",
+                      const utils::config::properties_map& =
+                          utils::config::properties_map());
+    lazy_test_program(const lazy_test_program&, const std::string&,
+                      const utils::config::properties_map&);
+
+    bool loaded(void) const;
+    bool shares_test_cases_with(const lazy_test_program&) const;
     const model::test_cases_map& test_cases(void) const;
+    void release_test_cases(void) const;
 };
 
 
@@ -204,6 +485,7 @@ public:
     int original_pid(void) const;
     const utils::datetime::timestamp& start_time() const;
     const utils::datetime::timestamp& end_time() const;
+    const utils::optional< utils::process::resource_usage >& usage(void) const;
     utils::fs::path work_directory(void) const;
     const utils::fs::path& stdout_file(void) const;
     const utils::fs::path& stderr_file(void) const;
@@ -225,6 +507,24 @@ public:
     const model::test_program_ptr test_program(void) const;
     const std::string& test_case_name(void) const;
     const model::test_result& test_result(void) const;
+    std::vector< model::test_result > sub_results(void) const;
+};
+
+
+/// Container for the data of a test program listing and its cleanup operation.
+class list_result_handle : public result_handle {
+    struct impl;
+    /// Pointer to internal implementation.
+    std::shared_ptr< impl > _pimpl;
+
+    friend class scheduler_handle;
+    list_result_handle(std::shared_ptr< bimpl >, std::shared_ptr< impl >);
+
+public:
+    ~list_result_handle(void);
+
+    const model::test_program_ptr test_program(void) const;
+    const model::test_cases_map& test_cases(void) const;
 };
 
 
@@ -237,19 +537,48 @@ class scheduler_handle {
     friend scheduler_handle setup(void);
     scheduler_handle(void);
 
+    result_handle_ptr process_exit(utils::process::executor::exit_handle,
+                                   const bool = true);
+
 public:
     ~scheduler_handle(void);
 
     const utils::fs::path& root_work_directory(void) const;
 
+    void mount_root_tmpfs(void);
+    void mount_work_tmpfs(const utils::units::bytes&);
+    void isolate_work_mounts(const utils::units::bytes&);
+    void set_output_sink(
+        const std::shared_ptr< utils::process::executor::output_sink >);
     void cleanup(void);
 
     model::test_cases_map list_tests(const model::test_program*,
                                      const utils::config::tree&);
+    std::vector< model::test_cases_map > list_tests_batch(
+        const model::test_programs_vector&, const utils::config::tree&,
+        const std::size_t, list_hooks* = NULL,
+        std::vector< listing_stats >* = NULL);
+    void set_list_cache(const engine::list_cache&);
+    void set_observer(observer*);
+    bool load_cached_list(const model::test_program_ptr,
+                          const utils::config::tree&,
+                          listing_stats* = NULL);
+    exec_handle spawn_list(const model::test_program_ptr,
+                           const utils::config::tree&);
+    std::string check_requirements(const model::test_program_ptr,
+                                   const std::string&,
+                                   const utils::config::tree&);
+    void prepare_spawns(const model::test_programs_vector&,
+                        const utils::config::tree&, const std::size_t);
     exec_handle spawn_test(const model::test_program_ptr,
                            const std::string&,
-                           const utils::config::tree&);
+                           const utils::config::tree&,
+                           const std::set< int >& = std::set< int >(),
+                           const utils::optional< utils::datetime::delta >& =
+                               utils::none);
     result_handle_ptr wait_any(void);
+    utils::optional< result_handle_ptr > poll_any(void);
+    void terminate(const exec_handle);
 
     result_handle_ptr debug_test(const model::test_program_ptr,
                                  const std::string&,
@@ -258,11 +587,15 @@ public:
                                  const utils::fs::path&);
 
     void check_interrupt(void) const;
+
+    const utils::latency_histograms_map& latencies(void) const;
 };
 
 
 extern utils::datetime::delta cleanup_timeout;
 extern utils::datetime::delta list_timeout;
+extern std::size_t max_stacktrace_jobs;
+extern const int result_fd;
 
 
 void ensure_valid_interface(const std::string&);
@@ -273,6 +606,8 @@ scheduler_handle setup(void);
 model::context current_context(void);
 utils::config::properties_map generate_config(const utils::config::tree&,
                                               const std::string&);
+utils::config::tree variant_config(const utils::config::tree&,
+                                   const model::test_program&);
 
 
 }  // namespace scheduler
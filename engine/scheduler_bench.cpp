@@ -0,0 +1,280 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// \file engine/scheduler_bench.cpp
+/// Stress benchmarks for the scheduling of many test cases at once.
+
+#include "engine/scheduler.hpp"
+
+extern "C" {
+#include <unistd.h>
+}
+
+#include <cstddef>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <atf-c++.hpp>
+
+#include "engine/config.hpp"
+#include "model/test_case.hpp"
+#include "model/test_program.hpp"
+#include "model/test_result.hpp"
+#include "utils/config/tree.ipp"
+#include "utils/datetime.hpp"
+#include "utils/defs.hpp"
+#include "utils/format/macros.hpp"
+#include "utils/fs/operations.hpp"
+#include "utils/fs/path.hpp"
+#include "utils/latency_histogram.hpp"
+#include "utils/optional.ipp"
+#include "utils/process/status.hpp"
+#include "utils/sanity.hpp"
+#include "utils/test_utils.ipp"
+#include "utils/text/operations.ipp"
+
+namespace config = utils::config;
+namespace datetime = utils::datetime;
+namespace fs = utils::fs;
+namespace process = utils::process;
+namespace scheduler = engine::scheduler;
+namespace text = utils::text;
+
+using utils::optional;
+
+
+namespace {
+
+
+/// Mock interface whose test cases print some output and then sleep.
+///
+/// The name of each test case encodes its behavior as "<bytes>-<usecs>-<id>",
+/// where bytes is the amount of data to print to stdout, usecs is the time to
+/// sleep for afterwards and id makes the name unique.
+class stress_interface : public scheduler::interface {
+public:
+    /// Executes a test program's list operation.
+    void
+    exec_list(const model::test_program& UTILS_UNUSED_PARAM(test_program),
+              const config::properties_map& UTILS_UNUSED_PARAM(vars))
+        const UTILS_NORETURN
+    {
+        std::abort();
+    }
+
+    /// Computes the test cases list of a test program.
+    ///
+    /// \return Nothing; this is never called.
+    model::test_cases_map
+    parse_list(const optional< process::status >& UTILS_UNUSED_PARAM(status),
+               const fs::path& UTILS_UNUSED_PARAM(stdout_path),
+               const fs::path& UTILS_UNUSED_PARAM(stderr_path)) const
+    {
+        UNREACHABLE;
+    }
+
+    /// Executes a test case by printing and sleeping as its name says.
+    ///
+    /// \param test_case_name Name of the test case to invoke.
+    void
+    exec_test(const model::test_program& UTILS_UNUSED_PARAM(test_program),
+              const std::string& test_case_name,
+              const config::properties_map& UTILS_UNUSED_PARAM(vars),
+              const fs::path& UTILS_UNUSED_PARAM(control_directory)) const
+    {
+        const std::vector< std::string > words = text::split(
+            test_case_name, '-');
+        const std::size_t bytes = text::to_type< std::size_t >(words[0]);
+        const unsigned long usecs = text::to_type< unsigned long >(words[1]);
+
+        const std::string line(63, 'x');
+        for (std::size_t i = 0; i < bytes; i += line.length() + 1)
+            std::cout << line << '\n';
+        std::cout.flush();
+        ::usleep(usecs);
+
+        // Skip destructors: they would clear up the global scheduler state,
+        // which belongs to the parent process.
+        ::_exit(EXIT_SUCCESS);
+    }
+
+    /// Computes the result of a test case.
+    ///
+    /// \param status The termination status of the test case; none if it timed
+    ///     out.
+    ///
+    /// \return A passed result, or a broken result if the test case timed out.
+    model::test_result
+    compute_result(const optional< process::status >& status,
+                   const fs::path& UTILS_UNUSED_PARAM(control_directory),
+                   const fs::path& UTILS_UNUSED_PARAM(stdout_path),
+                   const fs::path& UTILS_UNUSED_PARAM(stderr_path)) const
+    {
+        if (!status)
+            return model::test_result(model::test_result_broken, "Timed out");
+        return model::test_result(model::test_result_passed);
+    }
+};
+
+
+/// Gets the number of test cases to keep running at once.
+///
+/// \param tc The calling test.
+///
+/// \return The value of the benchmark_concurrency configuration variable, or
+/// 500 if not set.
+static std::size_t
+benchmark_concurrency(const atf::tests::tc* tc)
+{
+    if (tc->has_config_var("benchmark_concurrency"))
+        return text::to_type< std::size_t >(
+            tc->get_config_var("benchmark_concurrency"));
+    else
+        return 500;
+}
+
+
+/// Spawns and reaps many test cases with randomized behaviors.
+///
+/// The scheduler is kept full: a new test case is spawned as soon as any other
+/// returns its result.  The behaviors of the test cases are drawn from a fixed
+/// seed so that consecutive runs are comparable.
+///
+/// \param tc The calling test.
+/// \param timeout_percent Percentage of the test cases whose timeout is
+///     shorter than their lifetime.
+static void
+run_stress(const atf::tests::tc* tc, const int timeout_percent)
+{
+    const std::size_t iterations = utils::benchmark_iterations(tc, 2000);
+    const std::size_t concurrency = benchmark_concurrency(tc);
+    std::srand(1);
+
+    std::vector< std::string > names;
+    std::vector< optional< datetime::delta > > timeouts;
+    model::test_program_builder builder(
+        "stress", fs::path("the-program"), fs::current_path(), "the-suite");
+    for (std::size_t i = 0; i < iterations; ++i) {
+        const unsigned long usecs = 2000 + std::rand() % 20000;
+        const std::size_t bytes = std::rand() % 65536;
+        const std::string name = F("%s-%s-%s") % bytes % usecs % i;
+        builder.add_test_case(name);
+        names.push_back(name);
+        if (std::rand() % 100 < timeout_percent)
+            timeouts.push_back(utils::make_optional(
+                datetime::delta::from_microseconds(usecs / 2)));
+        else
+            timeouts.push_back(utils::none);
+    }
+    const model::test_program_ptr program = builder.build_ptr();
+    const config::tree user_config = engine::empty_config();
+
+    utils::latency_histogram spawn_latencies;
+    utils::latency_histogram result_latencies;
+    std::map< int, datetime::timestamp > spawn_times;
+    std::size_t timed_out = 0;
+
+    scheduler::scheduler_handle handle = scheduler::setup();
+    const datetime::timestamp start = datetime::timestamp::now();
+    std::size_t spawned = 0;
+    std::size_t reaped = 0;
+    while (reaped < iterations) {
+        while (spawned < iterations && spawned - reaped < concurrency) {
+            const datetime::timestamp before = datetime::timestamp::now();
+            const scheduler::exec_handle exec_handle = handle.spawn_test(
+                program, names[spawned], user_config, std::set< int >(),
+                timeouts[spawned]);
+            spawn_latencies.record_interval(before,
+                                            datetime::timestamp::now());
+            spawn_times.insert(std::make_pair(exec_handle, before));
+            ++spawned;
+        }
+
+        scheduler::result_handle_ptr result_handle = handle.wait_any();
+        const std::map< int, datetime::timestamp >::iterator iter =
+            spawn_times.find(result_handle->original_pid());
+        ATF_REQUIRE(iter != spawn_times.end());
+        result_latencies.record_interval((*iter).second,
+                                         datetime::timestamp::now());
+        spawn_times.erase(iter);
+
+        const scheduler::test_result_handle* test_result_handle =
+            dynamic_cast< const scheduler::test_result_handle* >(
+                result_handle.get());
+        if (!test_result_handle->test_result().good())
+            ++timed_out;
+        result_handle->cleanup();
+        result_handle.reset();
+        ++reaped;
+    }
+    utils::report_benchmark(tc, iterations,
+                            datetime::timestamp::now() - start);
+    handle.cleanup();
+
+    std::cout << tc->get_md_var("ident") << ".concurrency = " << concurrency
+              << '\n';
+    std::cout << tc->get_md_var("ident") << ".timed_out = " << timed_out
+              << '\n';
+    utils::report_benchmark_latencies(tc, "spawn", spawn_latencies);
+    utils::report_benchmark_latencies(tc, "result", result_latencies);
+}
+
+
+}  // anonymous namespace
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(spawn_test__stress);
+ATF_TEST_CASE_BODY(spawn_test__stress)
+{
+    utils::require_run_benchmarks(this);
+    run_stress(this, 5);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(spawn_test__timeouts);
+ATF_TEST_CASE_BODY(spawn_test__timeouts)
+{
+    utils::require_run_benchmarks(this);
+    run_stress(this, 100);
+}
+
+
+ATF_INIT_TEST_CASES(tcs)
+{
+    scheduler::register_interface(
+        "stress", std::shared_ptr< scheduler::interface >(
+            new stress_interface()));
+
+    ATF_ADD_TEST_CASE(tcs, spawn_test__stress);
+    ATF_ADD_TEST_CASE(tcs, spawn_test__timeouts);
+}
@@ -46,7 +46,14 @@ typedef int exec_handle;
 
 
 class scheduler_handle;
+struct event;
+class event_queue;
+struct exec_plan;
 class interface;
+class list_hooks;
+class list_result_handle;
+struct listing_stats;
+class observer;
 class result_handle;
 class test_result_handle;
 
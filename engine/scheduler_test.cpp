@@ -30,15 +30,23 @@
 
 extern "C" {
 #include <sys/types.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
 
+#include <fcntl.h>
 #include <signal.h>
 #include <unistd.h>
 }
 
+#include <algorithm>
+#include <cstddef>
 #include <cstdlib>
 #include <fstream>
 #include <iostream>
+#include <map>
+#include <set>
 #include <string>
+#include <vector>
 
 #include <atf-c++.hpp>
 
@@ -55,10 +63,13 @@ extern "C" {
 #include "utils/env.hpp"
 #include "utils/format/containers.ipp"
 #include "utils/format/macros.hpp"
+#include "utils/fs/directory.hpp"
 #include "utils/fs/operations.hpp"
 #include "utils/fs/path.hpp"
+#include "utils/latency_histogram.hpp"
 #include "utils/optional.ipp"
 #include "utils/passwd.hpp"
+#include "utils/process/operations_fwd.hpp"
 #include "utils/process/status.hpp"
 #include "utils/sanity.hpp"
 #include "utils/stacktrace.hpp"
@@ -66,6 +77,7 @@ extern "C" {
 #include "utils/test_utils.ipp"
 #include "utils/text/exceptions.hpp"
 #include "utils/text/operations.ipp"
+#include "utils/units.hpp"
 
 namespace config = utils::config;
 namespace datetime = utils::datetime;
@@ -74,6 +86,7 @@ namespace passwd = utils::passwd;
 namespace process = utils::process;
 namespace scheduler = engine::scheduler;
 namespace text = utils::text;
+namespace units = utils::units;
 
 using utils::none;
 using utils::optional;
@@ -150,6 +163,27 @@ class mock_interface : public scheduler::interface {
         std::abort();
     }
 
+    /// Executes a test case that allocates more memory than it declares.
+    ///
+    /// The test case exits successfully if the allocation is rejected, which
+    /// is what happens when its required_memory is enforced as a limit.
+    void
+    exec_allocate(void) const UTILS_NORETURN
+    {
+        void* buffer = std::malloc(2048 * units::MB);
+        do_exit(buffer == NULL ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+
+    /// Executes a test case that prints the fixtures staged in its work
+    /// directory.
+    void
+    exec_cat_fixtures(void) const UTILS_NORETURN
+    {
+        std::cout << utils::read_file(fs::path("data/nested"))
+                  << utils::read_file(fs::path("single"));
+        do_exit(EXIT_SUCCESS);
+    }
+
     /// Executes a test case that deletes all files in the current directory.
     ///
     /// This is intended to validate that the test runs in an empty directory,
@@ -184,6 +218,15 @@ class mock_interface : public scheduler::interface {
         std::abort();
     }
 
+    /// Executes a test case that consumes CPU time until it is killed.
+    void
+    exec_spin(void) const UTILS_NORETURN
+    {
+        volatile unsigned long counter = 0;
+        for (;;)
+            ++counter;
+    }
+
     /// Executes a test case that prints all input parameters to the functor.
     ///
     /// \param test_program The test program to execute.
@@ -208,7 +251,49 @@ class mock_interface : public scheduler::interface {
         do_exit(EXIT_SUCCESS);
     }
 
+    /// Executes a test case that prints a lot of lines to its output.
+    ///
+    /// Each line reads "line N" followed by a newline, with N going from 0 to
+    /// 999, and is printed to both stdout and stderr.
+    void
+    exec_print_lots(void) const UTILS_NORETURN
+    {
+        for (int i = 0; i < 1000; ++i) {
+            std::cout << F("line %s\n") % i;
+            std::cerr << F("line %s\n") % i;
+        }
+
+        do_exit(EXIT_SUCCESS);
+    }
+
+    /// Executes a test case that prints its soft core size limit.
+    void
+    exec_print_core_limit(void) const UTILS_NORETURN
+    {
+        struct ::rlimit rl;
+        if (::getrlimit(RLIMIT_CORE, &rl) == -1)
+            do_exit(EXIT_FAILURE);
+        std::cout << F("%s\n") % rl.rlim_cur;
+        do_exit(EXIT_SUCCESS);
+    }
+
 public:
+    /// Computes the test cases list of a test program without executing it.
+    ///
+    /// \param test_program The test program to list.
+    ///
+    /// \return A list of test cases for the "static" test program; none for
+    /// any other, which must be executed to be listed.
+    optional< model::test_cases_map >
+    static_list(const model::test_program& test_program) const
+    {
+        if (test_program.absolute_path().leaf_name() == "static")
+            return utils::make_optional(
+                model::test_cases_map_builder().add("inline").build());
+        else
+            return none;
+    }
+
     /// Executes a test program's list operation.
     ///
     /// This method is intended to be called within a subprocess and is expected
@@ -323,7 +408,11 @@ public:
         control_file << test_case_name;
         control_file.close();
 
-        if (test_case_name == "check_i_exist") {
+        if (test_case_name == "allocate") {
+            exec_allocate();
+        } else if (test_case_name == "cat_fixtures") {
+            exec_cat_fixtures();
+        } else if (test_case_name == "check_i_exist") {
             do_exit(fs::exists(test_program.absolute_path()) ? 0 : 1);
         } else if (starts_with(test_case_name, "cleanup_timeout")) {
             exec_exit(EXIT_SUCCESS);
@@ -341,10 +430,16 @@ public:
             exec_fail();
         } else if (starts_with(test_case_name, "pass_body_fail_cleanup")) {
             exec_exit(EXIT_SUCCESS);
+        } else if (test_case_name == "print_core_limit") {
+            exec_print_core_limit();
+        } else if (starts_with(test_case_name, "print_lots")) {
+            exec_print_lots();
         } else if (starts_with(test_case_name, "print_params")) {
             exec_print_params(test_program, test_case_name, vars);
         } else if (starts_with(test_case_name, "skip_body_pass_cleanup")) {
             exec_exit(EXIT_SUCCESS);
+        } else if (test_case_name == "spin") {
+            exec_spin();
         } else {
             std::cerr << "Unknown test case " << test_case_name << '\n';
             std::abort();
@@ -460,9 +555,190 @@ public:
 };
 
 
+/// Mock interface that reports its results through the result pipe.
+class piped_interface : public scheduler::interface {
+public:
+    /// Executes a test program's list operation.
+    void
+    exec_list(const model::test_program& UTILS_UNUSED_PARAM(test_program),
+              const config::properties_map& UTILS_UNUSED_PARAM(vars))
+        const UTILS_NORETURN
+    {
+        std::abort();
+    }
+
+    /// Computes the test cases list of a test program.
+    ///
+    /// \return Nothing; this is never called.
+    model::test_cases_map
+    parse_list(const optional< process::status >& UTILS_UNUSED_PARAM(status),
+               const fs::path& UTILS_UNUSED_PARAM(stdout_path),
+               const fs::path& UTILS_UNUSED_PARAM(stderr_path)) const
+    {
+        UNREACHABLE;
+    }
+
+    /// Executes a test case by writing its name to the result pipe.
+    ///
+    /// Test cases named "large-<bytes>" write that many bytes instead.
+    ///
+    /// \param test_case_name Name of the test case to invoke.
+    void
+    exec_test(const model::test_program& UTILS_UNUSED_PARAM(test_program),
+              const std::string& test_case_name,
+              const config::properties_map& UTILS_UNUSED_PARAM(vars),
+              const fs::path& UTILS_UNUSED_PARAM(control_directory)) const
+    {
+        if (::fcntl(scheduler::result_fd, F_GETFD) == -1)
+            ::_exit(EXIT_FAILURE);
+
+        std::string data = test_case_name;
+        if (test_case_name.find("large-") == 0)
+            data = std::string(text::to_type< std::size_t >(
+                test_case_name.substr(6)), 'x');
+
+        const char* pos = data.c_str();
+        std::size_t pending = data.length();
+        while (pending > 0) {
+            const ssize_t length = ::write(scheduler::result_fd, pos, pending);
+            if (length == -1)
+                ::_exit(EXIT_FAILURE);
+            pos += length;
+            pending -= length;
+        }
+        ::_exit(EXIT_SUCCESS);
+    }
+
+    /// Checks whether the test cases can send their results through a pipe.
+    ///
+    /// \return True.
+    bool
+    accepts_result_pipe(void) const
+    {
+        return true;
+    }
+
+    /// Computes the result of a test case that had no result pipe.
+    ///
+    /// \param status The termination status of the test case.
+    ///
+    /// \return A passed result describing the exit status.
+    model::test_result
+    compute_result(const optional< process::status >& status,
+                   const fs::path& UTILS_UNUSED_PARAM(control_directory),
+                   const fs::path& UTILS_UNUSED_PARAM(stdout_path),
+                   const fs::path& UTILS_UNUSED_PARAM(stderr_path)) const
+    {
+        return model::test_result(model::test_result_passed,
+                                  F("No pipe; exit %s") %
+                                  status.get().exitstatus());
+    }
+
+    /// Computes the result of a test case that had a result pipe.
+    ///
+    /// \param status The termination status of the test case.
+    /// \param piped_result The data sent by the test case through the pipe.
+    ///
+    /// \return A passed result describing what was received.
+    model::test_result
+    compute_piped_result(
+        const optional< process::status >& status,
+        const fs::path& UTILS_UNUSED_PARAM(control_directory),
+        const fs::path& UTILS_UNUSED_PARAM(stdout_path),
+        const fs::path& UTILS_UNUSED_PARAM(stderr_path),
+        const std::string& piped_result) const
+    {
+        return model::test_result(model::test_result_passed,
+                                  F("Piped '%s'; exit %s") % piped_result %
+                                  status.get().exitstatus());
+    }
+};
+
+
+/// Mock interface that executes its test cases through an execution plan.
+class planned_interface : public piped_interface {
+public:
+    /// Number of times that plan_test() has been called.
+    mutable int plans;
+
+    /// Constructor.
+    planned_interface(void) : plans(0)
+    {
+    }
+
+    /// Checks whether the test cases can send their results through a pipe.
+    ///
+    /// \return False.
+    bool
+    accepts_result_pipe(void) const
+    {
+        return false;
+    }
+
+    /// Describes how to execute the test cases of a test program.
+    ///
+    /// \return A plan that prints its environment and arguments.
+    optional< scheduler::exec_plan >
+    plan_test(const model::test_program& UTILS_UNUSED_PARAM(test_program),
+              const config::properties_map& UTILS_UNUSED_PARAM(vars)) const
+    {
+        ++plans;
+        scheduler::exec_plan plan(fs::path("/bin/sh"));
+        plan.args.push_back("-c");
+        plan.args.push_back("echo \"${PLANNED_VAR}\" \"$@\"");
+        plan.args.push_back("sh");
+        plan.environment["PLANNED_VAR"] = "planned";
+        return utils::make_optional(plan);
+    }
+
+    /// Executes a test case of the test program following a plan.
+    ///
+    /// \param plan The plan returned by plan_test().
+    /// \param test_case_name Name of the test case to invoke.
+    void
+    exec_planned_test(const scheduler::exec_plan& plan,
+                      const std::string& test_case_name,
+                      const fs::path& UTILS_UNUSED_PARAM(control_directory))
+        const
+    {
+        process::args_vector args;
+        args.push_back(test_case_name);
+        plan.exec(args);
+    }
+
+    /// Computes the result of a test case.
+    ///
+    /// \param stdout_path Path to the file containing the stdout of the test.
+    ///
+    /// \return A passed result with the output of the test case.
+    model::test_result
+    compute_result(const optional< process::status >& UTILS_UNUSED_PARAM(status),
+                   const fs::path& UTILS_UNUSED_PARAM(control_directory),
+                   const fs::path& stdout_path,
+                   const fs::path& UTILS_UNUSED_PARAM(stderr_path)) const
+    {
+        return model::test_result(model::test_result_passed,
+                                  utils::read_file(stdout_path));
+    }
+};
+
+
 }  // anonymous namespace
 
 
+/// Checks if a directory exists and is empty.
+///
+/// \param directory The directory to check.
+///
+/// \return True if the directory has no entries other than "." and "..".
+static bool
+is_empty_directory(const fs::path& directory)
+{
+    return fs::is_directory(directory) &&
+        fs::scan_directory(directory).size() == 2;
+}
+
+
 /// Runs list_tests on the scheduler and returns the results.
 ///
 /// \param test_name The name of the test supported by our exec_list function.
@@ -563,165 +839,1093 @@ ATF_TEST_CASE_BODY(integration__list_empty)
 }
 
 
-ATF_TEST_CASE_WITHOUT_HEAD(integration__run_one);
-ATF_TEST_CASE_BODY(integration__run_one)
+ATF_TEST_CASE_WITHOUT_HEAD(integration__list_static);
+ATF_TEST_CASE_BODY(integration__list_static)
 {
-    const model::test_program_ptr program = model::test_program_builder(
-        "mock", fs::path("the-program"), fs::current_path(), "the-suite")
-        .add_test_case("exit 41").build_ptr();
+    // The mock exec_list() aborts for this test program, so getting its
+    // test cases proves that it was never executed.
+    const model::test_cases_map test_cases = check_integration_list(
+        "static", fs::path("."));
 
-    const config::tree user_config = engine::empty_config();
+    const model::test_cases_map exp_test_cases = model::test_cases_map_builder()
+        .add("inline").build();
+    ATF_REQUIRE_EQ(exp_test_cases, test_cases);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(integration__spawn_list);
+ATF_TEST_CASE_BODY(integration__spawn_list)
+{
+    config::tree user_config = engine::empty_config();
+    user_config.set_string("test_suites.the-suite.first", "test");
 
     scheduler::scheduler_handle handle = scheduler::setup();
 
-    const scheduler::exec_handle exec_handle = handle.spawn_test(
-        program, "exit 41", user_config);
+    const model::test_program_ptr vars_program(
+        new scheduler::lazy_test_program(
+            "mock", fs::path("vars"), fs::current_path(), "the-suite",
+            model::metadata_builder().build(), user_config, handle));
+    const model::test_program_ptr misbehave_program(
+        new scheduler::lazy_test_program(
+            "mock", fs::path("misbehave"), fs::current_path(), "the-suite",
+            model::metadata_builder().build(), user_config, handle));
+
+    std::map< scheduler::exec_handle, model::test_program_ptr > exp_programs;
+    exp_programs[handle.spawn_list(vars_program, user_config)] = vars_program;
+    exp_programs[handle.spawn_list(misbehave_program, user_config)] =
+        misbehave_program;
+
+    for (std::size_t i = 0; i < 2; ++i) {
+        scheduler::result_handle_ptr result_handle = handle.wait_any();
+        const scheduler::list_result_handle* list_result_handle =
+            dynamic_cast< const scheduler::list_result_handle* >(
+                result_handle.get());
+        ATF_REQUIRE(list_result_handle != NULL);
+        ATF_REQUIRE_EQ(exp_programs[result_handle->original_pid()],
+                       list_result_handle->test_program());
+        result_handle->cleanup();
+        result_handle.reset();
+    }
+
+    const scheduler::lazy_test_program* lazy_vars =
+        dynamic_cast< const scheduler::lazy_test_program* >(
+            vars_program.get());
+    ATF_REQUIRE(lazy_vars->loaded());
+    const model::test_cases_map exp_test_cases = model::test_cases_map_builder()
+        .add("first_test").build();
+    ATF_REQUIRE_EQ(exp_test_cases, vars_program->test_cases());
+
+    const scheduler::lazy_test_program* lazy_misbehave =
+        dynamic_cast< const scheduler::lazy_test_program* >(
+            misbehave_program.get());
+    ATF_REQUIRE(lazy_misbehave->loaded());
+    const model::test_cases_map& test_cases = misbehave_program->test_cases();
+    ATF_REQUIRE_EQ(1, test_cases.size());
+    const model::test_case& test_case = test_cases.begin()->second;
+    ATF_REQUIRE_EQ("__test_cases_list__", test_case.name());
+    ATF_REQUIRE_EQ(model::test_result(model::test_result_broken,
+                                      "misbehaved in parse_list"),
+                   test_case.fake_result().get());
+
+    handle.cleanup();
+}
 
+
+ATF_TEST_CASE_WITHOUT_HEAD(integration__spawn_list__variants_share);
+ATF_TEST_CASE_BODY(integration__spawn_list__variants_share)
+{
+    config::tree user_config = engine::empty_config();
+    user_config.set_string("test_suites.the-suite.first", "test");
+
+    scheduler::scheduler_handle handle = scheduler::setup();
+
+    config::properties_map fast_vars;
+    fast_vars["mode"] = "fast";
+    scheduler::lazy_test_program* fast = new scheduler::lazy_test_program(
+        "mock", fs::path("vars"), fs::current_path(), "the-suite",
+        model::metadata_builder().build(), user_config, handle, "fast",
+        fast_vars);
+    const model::test_program_ptr fast_program(fast);
+
+    config::properties_map slow_vars;
+    slow_vars["mode"] = "slow";
+    scheduler::lazy_test_program* slow = new scheduler::lazy_test_program(
+        *fast, "slow", slow_vars);
+    const model::test_program_ptr slow_program(slow);
+
+    ATF_REQUIRE(fast->shares_test_cases_with(*slow));
+    ATF_REQUIRE(fast_program->relative_path() == slow_program->relative_path());
+    ATF_REQUIRE(*fast_program != *slow_program);
+    ATF_REQUIRE(!slow->loaded());
+
+    handle.spawn_list(fast_program, user_config);
     scheduler::result_handle_ptr result_handle = handle.wait_any();
-    const scheduler::test_result_handle* test_result_handle =
-        dynamic_cast< const scheduler::test_result_handle* >(
-            result_handle.get());
-    ATF_REQUIRE_EQ(exec_handle, result_handle->original_pid());
-    ATF_REQUIRE_EQ(model::test_result(model::test_result_passed, "Exit 41"),
-                   test_result_handle->test_result());
     result_handle->cleanup();
     result_handle.reset();
 
+    ATF_REQUIRE(fast->loaded());
+    ATF_REQUIRE(slow->loaded());
+    const model::test_cases_map exp_test_cases = model::test_cases_map_builder()
+        .add("first_test").build();
+    ATF_REQUIRE_EQ(exp_test_cases, slow_program->test_cases());
+
     handle.cleanup();
 }
 
 
-ATF_TEST_CASE_WITHOUT_HEAD(integration__run_many);
-ATF_TEST_CASE_BODY(integration__run_many)
+ATF_TEST_CASE_WITHOUT_HEAD(integration__spawn_list__late_variant);
+ATF_TEST_CASE_BODY(integration__spawn_list__late_variant)
 {
-    static const std::size_t num_test_programs = 30;
+    config::tree user_config = engine::empty_config();
+    user_config.set_string("test_suites.the-suite.first", "test");
 
-    const config::tree user_config = engine::empty_config();
+    scheduler::scheduler_handle handle = scheduler::setup();
+
+    config::properties_map fast_vars;
+    fast_vars["mode"] = "fast";
+    scheduler::lazy_test_program* fast = new scheduler::lazy_test_program(
+        "mock", fs::path("vars"), fs::current_path(), "the-suite",
+        model::metadata_builder().set_timeout(datetime::delta(5, 0)).build(),
+        user_config, handle, "fast", fast_vars);
+    const model::test_program_ptr fast_program(fast);
+
+    handle.spawn_list(fast_program, user_config);
+    scheduler::result_handle_ptr result_handle = handle.wait_any();
+    result_handle->cleanup();
+    result_handle.reset();
+    ATF_REQUIRE(fast->loaded());
+
+    config::properties_map slow_vars;
+    slow_vars["mode"] = "slow";
+    scheduler::lazy_test_program* slow = new scheduler::lazy_test_program(
+        *fast, "slow", slow_vars);
+    const model::test_program_ptr slow_program(slow);
+
+    ATF_REQUIRE(slow->loaded());
+    ATF_REQUIRE(fast->shares_test_cases_with(*slow));
+    ATF_REQUIRE_EQ(fast_program->test_cases(), slow_program->test_cases());
+    ATF_REQUIRE_EQ(datetime::delta(5, 0),
+                   slow_program->find("first_test").get_metadata().timeout());
+
+    handle.cleanup();
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(integration__release_test_cases);
+ATF_TEST_CASE_BODY(integration__release_test_cases)
+{
+    config::tree user_config = engine::empty_config();
+    user_config.set_string("test_suites.the-suite.first", "test");
 
     scheduler::scheduler_handle handle = scheduler::setup();
 
-    // We mess around with the "current time" below, so make sure the tests do
-    // not spuriously exceed their deadline by bumping it to a large number.
-    const model::metadata infinite_timeout = model::metadata_builder()
-        .set_timeout(datetime::delta(1000000L, 0)).build();
+    config::properties_map fast_vars;
+    fast_vars["mode"] = "fast";
+    scheduler::lazy_test_program* fast = new scheduler::lazy_test_program(
+        "mock", fs::path("vars"), fs::current_path(), "the-suite",
+        model::metadata_builder().build(), user_config, handle, "fast",
+        fast_vars);
+    const model::test_program_ptr fast_program(fast);
 
-    std::size_t total_tests = 0;
-    std::map< scheduler::exec_handle, model::test_program_ptr >
-        exp_test_programs;
-    std::map< scheduler::exec_handle, std::string > exp_test_case_names;
-    std::map< scheduler::exec_handle, datetime::timestamp > exp_start_times;
-    std::map< scheduler::exec_handle, int > exp_exit_statuses;
-    for (std::size_t i = 0; i < num_test_programs; ++i) {
-        const std::string test_case_0 = F("exit %s") % (i * 3 + 0);
-        const std::string test_case_1 = F("exit %s") % (i * 3 + 1);
-        const std::string test_case_2 = F("exit %s") % (i * 3 + 2);
+    config::properties_map slow_vars;
+    slow_vars["mode"] = "slow";
+    scheduler::lazy_test_program* slow = new scheduler::lazy_test_program(
+        *fast, "slow", slow_vars);
+    const model::test_program_ptr slow_program(slow);
 
-        const model::test_program_ptr program = model::test_program_builder(
-            "mock", fs::path(F("program-%s") % i),
-            fs::current_path(), "the-suite")
-            .set_metadata(infinite_timeout)
-            .add_test_case(test_case_0)
-            .add_test_case(test_case_1)
-            .add_test_case(test_case_2)
-            .build_ptr();
+    const model::test_cases_map exp_test_cases = model::test_cases_map_builder()
+        .add("first_test").build();
+    ATF_REQUIRE_EQ(exp_test_cases, fast_program->test_cases());
+    ATF_REQUIRE(slow->loaded());
 
-        const datetime::timestamp start_time = datetime::timestamp::from_values(
-            2014, 12, 8, 9, 40, 0, i);
+    fast->release_test_cases();
+    ATF_REQUIRE(!fast->loaded());
+    ATF_REQUIRE(!fast->shares_test_cases_with(*slow));
+    ATF_REQUIRE(slow->loaded());
+    ATF_REQUIRE_EQ(exp_test_cases, slow_program->test_cases());
 
-        scheduler::exec_handle exec_handle;
+    // The released test program loads its test cases again on demand.
+    ATF_REQUIRE_EQ(exp_test_cases, fast_program->test_cases());
+    ATF_REQUIRE(fast->loaded());
 
-        datetime::set_mock_now(start_time);
-        exec_handle = handle.spawn_test(program, test_case_0, user_config);
-        exp_test_programs.insert(std::make_pair(exec_handle, program));
-        exp_test_case_names.insert(std::make_pair(exec_handle, test_case_0));
-        exp_start_times.insert(std::make_pair(exec_handle, start_time));
-        exp_exit_statuses.insert(std::make_pair(exec_handle, i * 3));
-        ++total_tests;
+    handle.cleanup();
+}
 
-        datetime::set_mock_now(start_time);
-        exec_handle = handle.spawn_test(program, test_case_1, user_config);
-        exp_test_programs.insert(std::make_pair(exec_handle, program));
-        exp_test_case_names.insert(std::make_pair(exec_handle, test_case_1));
-        exp_start_times.insert(std::make_pair(exec_handle, start_time));
-        exp_exit_statuses.insert(std::make_pair(exec_handle, i * 3 + 1));
-        ++total_tests;
 
-        datetime::set_mock_now(start_time);
-        exec_handle = handle.spawn_test(program, test_case_2, user_config);
-        exp_test_programs.insert(std::make_pair(exec_handle, program));
-        exp_test_case_names.insert(std::make_pair(exec_handle, test_case_2));
-        exp_start_times.insert(std::make_pair(exec_handle, start_time));
-        exp_exit_statuses.insert(std::make_pair(exec_handle, i * 3 + 2));
-        ++total_tests;
+ATF_TEST_CASE_WITHOUT_HEAD(integration__list_tests_batch);
+ATF_TEST_CASE_BODY(integration__list_tests_batch)
+{
+    config::tree user_config = engine::empty_config();
+    user_config.set_string("test_suites.the-suite.first", "test");
+
+    scheduler::scheduler_handle handle = scheduler::setup();
+
+    model::test_programs_vector test_programs;
+    test_programs.push_back(model::test_program_ptr(
+        new scheduler::lazy_test_program(
+            "mock", fs::path("misbehave"), fs::current_path(), "the-suite",
+            model::metadata_builder().build(), user_config, handle)));
+    test_programs.push_back(model::test_program_builder(
+        "mock", fs::path("the-program"), fs::current_path(), "the-suite")
+        .add_test_case("exit 41").build_ptr());
+    for (std::size_t i = 0; i < 3; ++i)
+        test_programs.push_back(model::test_program_ptr(
+            new scheduler::lazy_test_program(
+                "mock", fs::path("vars"), fs::current_path(), "the-suite",
+                model::metadata_builder().build(), user_config, handle)));
+
+    const std::vector< model::test_cases_map > results =
+        handle.list_tests_batch(test_programs, user_config, 2);
+    ATF_REQUIRE_EQ(5, results.size());
+
+    ATF_REQUIRE_EQ(1, results[0].size());
+    ATF_REQUIRE_EQ("__test_cases_list__", results[0].begin()->second.name());
+    ATF_REQUIRE(results[0].begin()->second.fake_result());
+
+    ATF_REQUIRE_EQ(test_programs[1]->test_cases(), results[1]);
+
+    const model::test_cases_map exp_test_cases = model::test_cases_map_builder()
+        .add("first_test").build();
+    for (std::size_t i = 2; i < 5; ++i) {
+        ATF_REQUIRE_EQ(exp_test_cases, results[i]);
+        ATF_REQUIRE(dynamic_cast< const scheduler::lazy_test_program* >(
+                        test_programs[i].get())->loaded());
     }
 
-    for (std::size_t i = 0; i < total_tests; ++i) {
-        const datetime::timestamp end_time = datetime::timestamp::from_values(
-            2014, 12, 8, 9, 50, 10, i);
-        datetime::set_mock_now(end_time);
-        scheduler::result_handle_ptr result_handle = handle.wait_any();
-        const scheduler::test_result_handle* test_result_handle =
-            dynamic_cast< const scheduler::test_result_handle* >(
-                result_handle.get());
+    handle.cleanup();
+}
 
-        const scheduler::exec_handle exec_handle =
-            result_handle->original_pid();
 
-        const model::test_program_ptr test_program = exp_test_programs.find(
-            exec_handle)->second;
+/// Hooks for list_tests_batch() that record the completed listings.
+class recording_list_hooks : public scheduler::list_hooks {
+    /// The test programs being listed.
+    const model::test_programs_vector& _test_programs;
+
+public:
+    /// Indexes of the completed listings, in completion order.
+    std::vector< std::size_t > indexes;
+
+    /// Constructor.
+    ///
+    /// \param test_programs_ The test programs being listed.
+    recording_list_hooks(const model::test_programs_vector& test_programs_) :
+        _test_programs(test_programs_)
+    {
+    }
+
+    /// Records a completed listing.
+    ///
+    /// \param index Position of the listed test program.
+    void
+    got_test_cases(const std::size_t index)
+    {
+        ATF_REQUIRE(!_test_programs[index]->test_cases().empty());
+        indexes.push_back(index);
+    }
+};
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(integration__list_tests_batch__hooks);
+ATF_TEST_CASE_BODY(integration__list_tests_batch__hooks)
+{
+    config::tree user_config = engine::empty_config();
+    user_config.set_string("test_suites.the-suite.first", "test");
+
+    scheduler::scheduler_handle handle = scheduler::setup();
+
+    model::test_programs_vector test_programs;
+    for (std::size_t i = 0; i < 3; ++i)
+        test_programs.push_back(model::test_program_ptr(
+            new scheduler::lazy_test_program(
+                "mock", fs::path("vars"), fs::current_path(), "the-suite",
+                model::metadata_builder().build(), user_config, handle)));
+    test_programs.push_back(model::test_program_builder(
+        "mock", fs::path("the-program"), fs::current_path(), "the-suite")
+        .add_test_case("exit 41").build_ptr());
+
+    recording_list_hooks hooks(test_programs);
+    (void)handle.list_tests_batch(test_programs, user_config, 2, &hooks);
+
+    std::vector< std::size_t > indexes = hooks.indexes;
+    std::sort(indexes.begin(), indexes.end());
+    ATF_REQUIRE_EQ(4, indexes.size());
+    for (std::size_t i = 0; i < 4; ++i)
+        ATF_REQUIRE_EQ(i, indexes[i]);
+
+    handle.cleanup();
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(integration__list_tests_batch__static);
+ATF_TEST_CASE_BODY(integration__list_tests_batch__static)
+{
+    const config::tree user_config = engine::empty_config();
+
+    scheduler::scheduler_handle handle = scheduler::setup();
+
+    model::test_programs_vector test_programs;
+    for (std::size_t i = 0; i < 3; ++i)
+        test_programs.push_back(model::test_program_ptr(
+            new scheduler::lazy_test_program(
+                "mock", fs::path("static"), fs::current_path(), "the-suite",
+                model::metadata_builder().build(), user_config, handle)));
+
+    recording_list_hooks hooks(test_programs);
+    const std::vector< model::test_cases_map > results =
+        handle.list_tests_batch(test_programs, user_config, 1, &hooks);
+    ATF_REQUIRE_EQ(3, hooks.indexes.size());
+
+    const model::test_cases_map exp_test_cases = model::test_cases_map_builder()
+        .add("inline").build();
+    for (std::size_t i = 0; i < 3; ++i) {
+        ATF_REQUIRE_EQ(exp_test_cases, results[i]);
+        ATF_REQUIRE(dynamic_cast< const scheduler::lazy_test_program* >(
+                        test_programs[i].get())->loaded());
+    }
+
+    handle.cleanup();
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(integration__list_tests_batch__variants_share);
+ATF_TEST_CASE_BODY(integration__list_tests_batch__variants_share)
+{
+    config::tree user_config = engine::empty_config();
+    user_config.set_string("test_suites.the-suite.first", "test");
+
+    scheduler::scheduler_handle handle = scheduler::setup();
+
+    scheduler::lazy_test_program* fast = new scheduler::lazy_test_program(
+        "mock", fs::path("vars"), fs::current_path(), "the-suite",
+        model::metadata_builder().build(), user_config, handle, "fast",
+        config::properties_map());
+    model::test_programs_vector test_programs;
+    test_programs.push_back(model::test_program_ptr(fast));
+    test_programs.push_back(model::test_program_ptr(
+        new scheduler::lazy_test_program(*fast, "slow",
+                                         config::properties_map())));
+
+    const std::vector< model::test_cases_map > results =
+        handle.list_tests_batch(test_programs, user_config, 4);
+
+    const model::test_cases_map exp_test_cases = model::test_cases_map_builder()
+        .add("first_test").build();
+    ATF_REQUIRE_EQ(2, results.size());
+    ATF_REQUIRE_EQ(exp_test_cases, results[0]);
+    ATF_REQUIRE_EQ(exp_test_cases, results[1]);
+
+    handle.cleanup();
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(integration__run_one);
+ATF_TEST_CASE_BODY(integration__run_one)
+{
+    const model::test_program_ptr program = model::test_program_builder(
+        "mock", fs::path("the-program"), fs::current_path(), "the-suite")
+        .add_test_case("exit 41").build_ptr();
+
+    const config::tree user_config = engine::empty_config();
+
+    scheduler::scheduler_handle handle = scheduler::setup();
+
+    const scheduler::exec_handle exec_handle = handle.spawn_test(
+        program, "exit 41", user_config);
+
+    scheduler::result_handle_ptr result_handle = handle.wait_any();
+    const scheduler::test_result_handle* test_result_handle =
+        dynamic_cast< const scheduler::test_result_handle* >(
+            result_handle.get());
+    ATF_REQUIRE_EQ(exec_handle, result_handle->original_pid());
+    ATF_REQUIRE_EQ(model::test_result(model::test_result_passed, "Exit 41"),
+                   test_result_handle->test_result());
+    result_handle->cleanup();
+    result_handle.reset();
+
+    handle.cleanup();
+}
+
+
+/// Runs a single test case of the piped interface.
+///
+/// \param user_config The user configuration that controls the pipe.
+/// \param test_case_name The name of the test case to run, which determines
+///     what it writes to the pipe.
+///
+/// \return The result of the test case.
+static model::test_result
+run_piped_test(const config::tree& user_config,
+               const std::string& test_case_name = "the-case")
+{
+    scheduler::register_interface(
+        "piped", std::shared_ptr< scheduler::interface >(
+            new piped_interface()));
+
+    const model::test_program_ptr program = model::test_program_builder(
+        "piped", fs::path("the-program"), fs::current_path(), "the-suite")
+        .add_test_case(test_case_name, model::metadata_builder()
+                       .set_timeout(datetime::delta(30, 0)).build())
+        .build_ptr();
+
+    scheduler::scheduler_handle handle = scheduler::setup();
+    (void)handle.spawn_test(program, test_case_name, user_config);
+
+    scheduler::result_handle_ptr result_handle = handle.wait_any();
+    const scheduler::test_result_handle* test_result_handle =
+        dynamic_cast< const scheduler::test_result_handle* >(
+            result_handle.get());
+    const model::test_result result = test_result_handle->test_result();
+    result_handle->cleanup();
+    result_handle.reset();
+
+    handle.cleanup();
+    return result;
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(integration__result_pipe__enabled);
+ATF_TEST_CASE_BODY(integration__result_pipe__enabled)
+{
+    config::tree user_config = engine::empty_config();
+    user_config.set_string("atf_result_pipe", "true");
+
+    ATF_REQUIRE_EQ(model::test_result(model::test_result_passed,
+                                      "Piped 'the-case'; exit 0"),
+                   run_piped_test(user_config));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(integration__result_pipe__larger_than_pipe);
+ATF_TEST_CASE_BODY(integration__result_pipe__larger_than_pipe)
+{
+    config::tree user_config = engine::empty_config();
+    user_config.set_string("atf_result_pipe", "true");
+
+    // Much larger than the capacity of a pipe on any system, so the test case
+    // can only terminate if the scheduler drains the pipe while it runs.
+    const std::size_t size = 1024 * 1024;
+    const model::test_result result = run_piped_test(
+        user_config, F("large-%s") % size);
+    ATF_REQUIRE(result == model::test_result(
+        model::test_result_passed,
+        F("Piped '%s'; exit 0") % std::string(size, 'x')));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(integration__result_pipe__disabled);
+ATF_TEST_CASE_BODY(integration__result_pipe__disabled)
+{
+    ATF_REQUIRE_EQ(model::test_result(model::test_result_passed,
+                                      "No pipe; exit 1"),
+                   run_piped_test(engine::empty_config()));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(integration__exec_plan);
+ATF_TEST_CASE_BODY(integration__exec_plan)
+{
+    planned_interface* interface = new planned_interface();
+    scheduler::register_interface(
+        "planned", std::shared_ptr< scheduler::interface >(interface));
+
+    const model::test_program_ptr program = model::test_program_builder(
+        "planned", fs::path("the-program"), fs::current_path(), "the-suite")
+        .add_test_case("first").add_test_case("second").build_ptr();
+
+    const config::tree user_config = engine::empty_config();
+
+    scheduler::scheduler_handle handle = scheduler::setup();
+    (void)handle.spawn_test(program, "first", user_config);
+    (void)handle.spawn_test(program, "second", user_config);
+
+    std::set< std::string > outputs;
+    for (int i = 0; i < 2; ++i) {
+        scheduler::result_handle_ptr result_handle = handle.wait_any();
+        const scheduler::test_result_handle* test_result_handle =
+            dynamic_cast< const scheduler::test_result_handle* >(
+                result_handle.get());
+        outputs.insert(test_result_handle->test_result().reason());
+        result_handle->cleanup();
+    }
+
+    handle.cleanup();
+
+    std::set< std::string > exp_outputs;
+    exp_outputs.insert("planned first\n");
+    exp_outputs.insert("planned second\n");
+    ATF_REQUIRE_EQ(exp_outputs, outputs);
+    ATF_REQUIRE_EQ(1, interface->plans);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(integration__prepare_spawns);
+ATF_TEST_CASE_BODY(integration__prepare_spawns)
+{
+    planned_interface* interface = new planned_interface();
+    scheduler::register_interface(
+        "planned", std::shared_ptr< scheduler::interface >(interface));
+
+    const model::test_program_ptr program = model::test_program_builder(
+        "planned", fs::path("the-program"), fs::current_path(), "the-suite")
+        .add_test_case("first").add_test_case("second").build_ptr();
+    model::test_programs_vector programs;
+    programs.push_back(program);
+
+    const config::tree user_config = engine::empty_config();
+
+    scheduler::scheduler_handle handle = scheduler::setup();
+    handle.prepare_spawns(programs, user_config, 2);
+    ATF_REQUIRE_EQ(1, interface->plans);
+    handle.prepare_spawns(programs, user_config, 2);
+    ATF_REQUIRE_EQ(1, interface->plans);
+
+    (void)handle.spawn_test(program, "first", user_config);
+    (void)handle.spawn_test(program, "second", user_config);
+
+    std::set< std::string > outputs;
+    for (int i = 0; i < 2; ++i) {
+        scheduler::result_handle_ptr result_handle = handle.wait_any();
+        const scheduler::test_result_handle* test_result_handle =
+            dynamic_cast< const scheduler::test_result_handle* >(
+                result_handle.get());
+        outputs.insert(test_result_handle->test_result().reason());
+        result_handle->cleanup();
+    }
+
+    handle.cleanup();
+
+    std::set< std::string > exp_outputs;
+    exp_outputs.insert("planned first\n");
+    exp_outputs.insert("planned second\n");
+    ATF_REQUIRE_EQ(exp_outputs, outputs);
+    ATF_REQUIRE_EQ(1, interface->plans);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(integration__run_many);
+ATF_TEST_CASE_BODY(integration__run_many)
+{
+    static const std::size_t num_test_programs = 30;
+
+    const config::tree user_config = engine::empty_config();
+
+    scheduler::scheduler_handle handle = scheduler::setup();
+
+    // We mess around with the "current time" below, so make sure the tests do
+    // not spuriously exceed their deadline by bumping it to a large number.
+    const model::metadata infinite_timeout = model::metadata_builder()
+        .set_timeout(datetime::delta(1000000L, 0)).build();
+
+    std::size_t total_tests = 0;
+    std::map< scheduler::exec_handle, model::test_program_ptr >
+        exp_test_programs;
+    std::map< scheduler::exec_handle, std::string > exp_test_case_names;
+    std::map< scheduler::exec_handle, datetime::timestamp > exp_start_times;
+    std::map< scheduler::exec_handle, int > exp_exit_statuses;
+    for (std::size_t i = 0; i < num_test_programs; ++i) {
+        const std::string test_case_0 = F("exit %s") % (i * 3 + 0);
+        const std::string test_case_1 = F("exit %s") % (i * 3 + 1);
+        const std::string test_case_2 = F("exit %s") % (i * 3 + 2);
+
+        const model::test_program_ptr program = model::test_program_builder(
+            "mock", fs::path(F("program-%s") % i),
+            fs::current_path(), "the-suite")
+            .set_metadata(infinite_timeout)
+            .add_test_case(test_case_0)
+            .add_test_case(test_case_1)
+            .add_test_case(test_case_2)
+            .build_ptr();
+
+        const datetime::timestamp start_time = datetime::timestamp::from_values(
+            2014, 12, 8, 9, 40, 0, i);
+
+        scheduler::exec_handle exec_handle;
+
+        datetime::set_mock_now(start_time);
+        exec_handle = handle.spawn_test(program, test_case_0, user_config);
+        exp_test_programs.insert(std::make_pair(exec_handle, program));
+        exp_test_case_names.insert(std::make_pair(exec_handle, test_case_0));
+        exp_start_times.insert(std::make_pair(exec_handle, start_time));
+        exp_exit_statuses.insert(std::make_pair(exec_handle, i * 3));
+        ++total_tests;
+
+        datetime::set_mock_now(start_time);
+        exec_handle = handle.spawn_test(program, test_case_1, user_config);
+        exp_test_programs.insert(std::make_pair(exec_handle, program));
+        exp_test_case_names.insert(std::make_pair(exec_handle, test_case_1));
+        exp_start_times.insert(std::make_pair(exec_handle, start_time));
+        exp_exit_statuses.insert(std::make_pair(exec_handle, i * 3 + 1));
+        ++total_tests;
+
+        datetime::set_mock_now(start_time);
+        exec_handle = handle.spawn_test(program, test_case_2, user_config);
+        exp_test_programs.insert(std::make_pair(exec_handle, program));
+        exp_test_case_names.insert(std::make_pair(exec_handle, test_case_2));
+        exp_start_times.insert(std::make_pair(exec_handle, start_time));
+        exp_exit_statuses.insert(std::make_pair(exec_handle, i * 3 + 2));
+        ++total_tests;
+    }
+
+    for (std::size_t i = 0; i < total_tests; ++i) {
+        const datetime::timestamp end_time = datetime::timestamp::from_values(
+            2014, 12, 8, 9, 50, 10, i);
+        datetime::set_mock_now(end_time);
+        scheduler::result_handle_ptr result_handle = handle.wait_any();
+        const scheduler::test_result_handle* test_result_handle =
+            dynamic_cast< const scheduler::test_result_handle* >(
+                result_handle.get());
+
+        const scheduler::exec_handle exec_handle =
+            result_handle->original_pid();
+
+        const model::test_program_ptr test_program = exp_test_programs.find(
+            exec_handle)->second;
         const std::string& test_case_name = exp_test_case_names.find(
             exec_handle)->second;
         const datetime::timestamp& start_time = exp_start_times.find(
             exec_handle)->second;
         const int exit_status = exp_exit_statuses.find(exec_handle)->second;
 
-        ATF_REQUIRE_EQ(model::test_result(model::test_result_passed,
-                                          F("Exit %s") % exit_status),
-                       test_result_handle->test_result());
+        ATF_REQUIRE_EQ(model::test_result(model::test_result_passed,
+                                          F("Exit %s") % exit_status),
+                       test_result_handle->test_result());
+
+        ATF_REQUIRE_EQ(test_program, test_result_handle->test_program());
+        ATF_REQUIRE_EQ(test_case_name, test_result_handle->test_case_name());
+
+        ATF_REQUIRE_EQ(start_time, result_handle->start_time());
+        ATF_REQUIRE_EQ(end_time, result_handle->end_time());
+
+        result_handle->cleanup();
+
+        ATF_REQUIRE(!atf::utils::file_exists(
+                        result_handle->stdout_file().str()));
+        ATF_REQUIRE(!atf::utils::file_exists(
+                        result_handle->stderr_file().str()));
+        ATF_REQUIRE(is_empty_directory(result_handle->work_directory()));
+
+        result_handle.reset();
+    }
+
+    handle.cleanup();
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(integration__run_many__deferred_cleanup);
+ATF_TEST_CASE_BODY(integration__run_many__deferred_cleanup)
+{
+    static const std::size_t num_rounds = 5;
+    static const std::size_t num_tests = 4;
+
+    const model::test_program_ptr program = model::test_program_builder(
+        "mock", fs::path("the-program"), fs::current_path(), "the-suite")
+        .add_test_case("exit 0").add_test_case("exit 1")
+        .add_test_case("exit 2").add_test_case("exit 3")
+        .build_ptr();
+
+    const config::tree user_config = engine::empty_config();
+
+    scheduler::scheduler_handle handle = scheduler::setup();
+
+    // Like the run-tests driver, only clean up the results of each round after
+    // the tests of the next round have been spawned.
+    std::vector< scheduler::result_handle_ptr > pending;
+    for (std::size_t round = 0; round <= num_rounds; ++round) {
+        std::set< scheduler::exec_handle > exec_handles;
+        if (round < num_rounds) {
+            for (std::size_t i = 0; i < num_tests; ++i)
+                exec_handles.insert(handle.spawn_test(
+                    program, F("exit %s") % i, user_config));
+        }
+
+        for (std::vector< scheduler::result_handle_ptr >::iterator iter =
+                 pending.begin(); iter != pending.end(); ++iter) {
+            scheduler::result_handle_ptr result_handle = *iter;
+            ATF_REQUIRE(exec_handles.find(result_handle->original_pid()) ==
+                        exec_handles.end());
+
+            // The results of the previous round are still on disk and do not
+            // interfere with the new tests.
+            handle.terminate(result_handle->original_pid());
+            ATF_REQUIRE(atf::utils::file_exists(
+                            result_handle->stdout_file().str()));
+            result_handle->cleanup();
+            ATF_REQUIRE(is_empty_directory(result_handle->work_directory()));
+        }
+        pending.clear();
+
+        for (std::size_t i = 0; i < exec_handles.size(); ++i) {
+            scheduler::result_handle_ptr result_handle = handle.wait_any();
+            ATF_REQUIRE(exec_handles.find(result_handle->original_pid()) !=
+                        exec_handles.end());
+            const scheduler::test_result_handle* test_result_handle =
+                dynamic_cast< const scheduler::test_result_handle* >(
+                    result_handle.get());
+            ATF_REQUIRE_EQ(model::test_result_passed,
+                           test_result_handle->test_result().type());
+            pending.push_back(result_handle);
+        }
+    }
+
+    handle.cleanup();
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(integration__run_check_paths);
+ATF_TEST_CASE_BODY(integration__run_check_paths)
+{
+    fs::mkdir_p(fs::path("dir1/dir2/dir3"), 0755);
+    atf::utils::create_file("dir1/dir2/dir3/program", "");
+
+    const model::test_program_ptr program = model::test_program_builder(
+        "mock", fs::path("dir2/dir3/program"), fs::path("dir1"), "the-suite")
+        .add_test_case("check_i_exist").build_ptr();
+
+    scheduler::scheduler_handle handle = scheduler::setup();
+
+    (void)handle.spawn_test(program, "check_i_exist", engine::default_config());
+    scheduler::result_handle_ptr result_handle = handle.wait_any();
+    const scheduler::test_result_handle* test_result_handle =
+        dynamic_cast< const scheduler::test_result_handle* >(
+            result_handle.get());
+
+    ATF_REQUIRE_EQ(model::test_result(model::test_result_passed, "Exit 0"),
+                   test_result_handle->test_result());
+
+    result_handle->cleanup();
+    result_handle.reset();
+
+    handle.cleanup();
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(integration__parameters_and_output);
+ATF_TEST_CASE_BODY(integration__parameters_and_output)
+{
+    const model::test_program_ptr program = model::test_program_builder(
+        "mock", fs::path("the-program"), fs::current_path(), "the-suite")
+        .add_test_case("print_params").build_ptr();
+
+    config::tree user_config = engine::empty_config();
+    user_config.set_string("test_suites.the-suite.one", "first variable");
+    user_config.set_string("test_suites.the-suite.two", "second variable");
+
+    scheduler::scheduler_handle handle = scheduler::setup();
+
+    const scheduler::exec_handle exec_handle = handle.spawn_test(
+        program, "print_params", user_config);
+
+    scheduler::result_handle_ptr result_handle = handle.wait_any();
+    const scheduler::test_result_handle* test_result_handle =
+        dynamic_cast< const scheduler::test_result_handle* >(
+            result_handle.get());
+
+    ATF_REQUIRE_EQ(exec_handle, result_handle->original_pid());
+    ATF_REQUIRE_EQ(program, test_result_handle->test_program());
+    ATF_REQUIRE_EQ("print_params", test_result_handle->test_case_name());
+    ATF_REQUIRE_EQ(model::test_result(model::test_result_passed, "Exit 0"),
+                   test_result_handle->test_result());
+
+    const fs::path stdout_file = result_handle->stdout_file();
+    ATF_REQUIRE(atf::utils::compare_file(
+        stdout_file.str(),
+        "Test program: the-program\n"
+        "Test case: print_params\n"
+        "one=first variable\n"
+        "two=second variable\n"));
+    const fs::path stderr_file = result_handle->stderr_file();
+    ATF_REQUIRE(atf::utils::compare_file(
+        stderr_file.str(), "stderr: print_params\n"));
+
+    result_handle->cleanup();
+    ATF_REQUIRE(!fs::exists(stdout_file));
+    ATF_REQUIRE(!fs::exists(stderr_file));
+    result_handle.reset();
+
+    handle.cleanup();
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(integration__parameters__variant);
+ATF_TEST_CASE_BODY(integration__parameters__variant)
+{
+    config::properties_map variant_vars;
+    variant_vars["two"] = "variant variable";
+    variant_vars["three"] = "new variable";
+    const model::test_program_ptr program = model::test_program_builder(
+        "mock", fs::path("the-program"), fs::current_path(), "the-suite")
+        .add_test_case("print_params")
+        .set_variant("the-variant", variant_vars).build_ptr();
+
+    config::tree user_config = engine::empty_config();
+    user_config.set_string("test_suites.the-suite.one", "first variable");
+    user_config.set_string("test_suites.the-suite.two", "second variable");
+
+    scheduler::scheduler_handle handle = scheduler::setup();
+
+    (void)handle.spawn_test(program, "print_params", user_config);
+
+    scheduler::result_handle_ptr result_handle = handle.wait_any();
+    ATF_REQUIRE(atf::utils::compare_file(
+        result_handle->stdout_file().str(),
+        "Test program: the-program\n"
+        "Test case: print_params\n"
+        "one=first variable\n"
+        "three=new variable\n"
+        "two=variant variable\n"));
+    ATF_REQUIRE(!user_config.is_set("test_suites.the-suite.three"));
+
+    result_handle->cleanup();
+    result_handle.reset();
+
+    handle.cleanup();
+}
+
+
+/// Runs the print_params test case and returns its output.
+///
+/// \param handle The scheduler to run the test case with.
+/// \param program The test program containing print_params.
+/// \param user_config The configuration to run the test with.
+///
+/// \return The contents of the stdout of the test case.
+static std::string
+run_print_params(scheduler::scheduler_handle& handle,
+                 const model::test_program_ptr program,
+                 const config::tree& user_config)
+{
+    (void)handle.spawn_test(program, "print_params", user_config);
+    scheduler::result_handle_ptr result_handle = handle.wait_any();
+    const std::string output = utils::read_file(result_handle->stdout_file());
+    result_handle->cleanup();
+    return output;
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(integration__parameters__cached);
+ATF_TEST_CASE_BODY(integration__parameters__cached)
+{
+    config::properties_map variant_vars;
+    variant_vars["two"] = "variant variable";
+    const model::test_program_ptr variant = model::test_program_builder(
+        "mock", fs::path("the-program"), fs::current_path(), "the-suite")
+        .add_test_case("print_params")
+        .set_variant("the-variant", variant_vars).build_ptr();
+    const model::test_program_ptr plain = model::test_program_builder(
+        "mock", fs::path("the-program"), fs::current_path(), "the-suite")
+        .add_test_case("print_params").build_ptr();
+
+    config::tree user_config = engine::empty_config();
+    user_config.set_string("test_suites.the-suite.one", "first variable");
+    user_config.set_string("test_suites.the-suite.two", "second variable");
+
+    scheduler::scheduler_handle handle = scheduler::setup();
+
+    ATF_REQUIRE_EQ("Test program: the-program\n"
+                   "Test case: print_params\n"
+                   "one=first variable\n"
+                   "two=variant variable\n",
+                   run_print_params(handle, variant, user_config));
+    ATF_REQUIRE_EQ("Test program: the-program\n"
+                   "Test case: print_params\n"
+                   "one=first variable\n"
+                   "two=second variable\n",
+                   run_print_params(handle, plain, user_config));
+
+    config::tree other_config = engine::empty_config();
+    other_config.set_string("test_suites.the-suite.one", "other variable");
+    ATF_REQUIRE_EQ("Test program: the-program\n"
+                   "Test case: print_params\n"
+                   "one=other variable\n",
+                   run_print_params(handle, plain, other_config));
+
+    handle.cleanup();
+}
+
+
+/// Runs the print_lots test case and checks its bounded output.
+///
+/// \param program The test program containing print_lots.
+/// \param user_config The configuration to run the test with.
+/// \param exp_limit The expected number of kept bytes of each output file.
+static void
+check_max_output_size(const model::test_program_ptr program,
+                      const config::tree& user_config,
+                      const std::size_t exp_limit)
+{
+    std::string full_output;
+    for (int i = 0; i < 1000; ++i)
+        full_output += F("line %s\n") % i;
+
+    scheduler::scheduler_handle handle = scheduler::setup();
+    (void)handle.spawn_test(program, "print_lots", user_config);
+    scheduler::result_handle_ptr result_handle = handle.wait_any();
+
+    const std::size_t head = exp_limit / 2;
+    const std::size_t tail = exp_limit - head;
+    const std::string exp_output =
+        full_output.substr(0, head) +
+        (F("\n[... %s bytes of output truncated by kyua; %s bytes in total "
+           "...]\n") % (full_output.length() - exp_limit) %
+         full_output.length()).str() +
+        full_output.substr(full_output.length() - tail);
+    ATF_REQUIRE(atf::utils::compare_file(
+        result_handle->stdout_file().str(), exp_output));
+    ATF_REQUIRE(atf::utils::compare_file(
+        result_handle->stderr_file().str(), exp_output));
+
+    result_handle->cleanup();
+    result_handle.reset();
+    handle.cleanup();
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(integration__max_output_size__metadata);
+ATF_TEST_CASE_BODY(integration__max_output_size__metadata)
+{
+    const model::test_program_ptr program = model::test_program_builder(
+        "mock", fs::path("the-program"), fs::current_path(), "the-suite")
+        .add_test_case("print_lots", model::metadata_builder()
+                       .set_max_output_size(units::bytes(101)).build())
+        .build_ptr();
+
+    config::tree user_config = engine::empty_config();
+    user_config.set_string("max_output_size", "1000");
+    check_max_output_size(program, user_config, 101);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(integration__max_output_size__config);
+ATF_TEST_CASE_BODY(integration__max_output_size__config)
+{
+    const model::test_program_ptr program = model::test_program_builder(
+        "mock", fs::path("the-program"), fs::current_path(), "the-suite")
+        .add_test_case("print_lots").build_ptr();
+
+    config::tree user_config = engine::empty_config();
+    user_config.set_string("max_output_size", "1k");
+    check_max_output_size(program, user_config, 1024);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(integration__max_output_size__small_output);
+ATF_TEST_CASE_BODY(integration__max_output_size__small_output)
+{
+    const model::test_program_ptr program = model::test_program_builder(
+        "mock", fs::path("the-program"), fs::current_path(), "the-suite")
+        .add_test_case("print_params", model::metadata_builder()
+                       .set_max_output_size(units::bytes(10)).build())
+        .build_ptr();
+
+    scheduler::scheduler_handle handle = scheduler::setup();
+    (void)handle.spawn_test(program, "print_params", engine::empty_config());
+    scheduler::result_handle_ptr result_handle = handle.wait_any();
+
+    // The output is barely over the limit, so truncating it would only make
+    // it larger.
+    ATF_REQUIRE(atf::utils::compare_file(
+        result_handle->stdout_file().str(),
+        "Test program: the-program\n"
+        "Test case: print_params\n"));
+
+    result_handle->cleanup();
+    result_handle.reset();
+    handle.cleanup();
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(integration__enforce_required_memory);
+ATF_TEST_CASE_BODY(integration__enforce_required_memory)
+{
+    const model::test_program_ptr program = model::test_program_builder(
+        "mock", fs::path("the-program"), fs::current_path(), "the-suite")
+        .add_test_case("allocate", model::metadata_builder()
+                       .set_required_memory(units::bytes(512 * units::MB))
+                       .build())
+        .build_ptr();
+
+    config::tree user_config = engine::empty_config();
+    user_config.set_string("enforce_required_memory", "true");
+
+    scheduler::scheduler_handle handle = scheduler::setup();
+    (void)handle.spawn_test(program, "allocate", user_config);
+    scheduler::result_handle_ptr result_handle = handle.wait_any();
+    const scheduler::test_result_handle* test_result_handle =
+        dynamic_cast< const scheduler::test_result_handle* >(
+            result_handle.get());
+    if (test_result_handle->test_result().type() ==
+        model::test_result_skipped)
+        skip(test_result_handle->test_result().reason());
+    ATF_REQUIRE_EQ(model::test_result(model::test_result_passed, "Exit 0"),
+                   test_result_handle->test_result());
+    result_handle->cleanup();
+    result_handle.reset();
+
+    handle.cleanup();
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(integration__max_cpu_time);
+ATF_TEST_CASE_BODY(integration__max_cpu_time)
+{
+    const model::test_program_ptr program = model::test_program_builder(
+        "mock", fs::path("the-program"), fs::current_path(), "the-suite")
+        .add_test_case("spin").build_ptr();
+
+    config::tree user_config = engine::empty_config();
+    user_config.set_string("max_cpu_time", "1");
 
-        ATF_REQUIRE_EQ(test_program, test_result_handle->test_program());
-        ATF_REQUIRE_EQ(test_case_name, test_result_handle->test_case_name());
+    scheduler::scheduler_handle handle = scheduler::setup();
+    (void)handle.spawn_test(program, "spin", user_config);
+    scheduler::result_handle_ptr result_handle = handle.wait_any();
+    const scheduler::test_result_handle* test_result_handle =
+        dynamic_cast< const scheduler::test_result_handle* >(
+            result_handle.get());
+    ATF_REQUIRE_EQ(model::test_result(model::test_result_failed,
+                                      F("Signal %s") % SIGXCPU),
+                   test_result_handle->test_result());
+    result_handle->cleanup();
+    result_handle.reset();
 
-        ATF_REQUIRE_EQ(start_time, result_handle->start_time());
-        ATF_REQUIRE_EQ(end_time, result_handle->end_time());
+    handle.cleanup();
+}
 
-        result_handle->cleanup();
 
-        ATF_REQUIRE(!atf::utils::file_exists(
-                        result_handle->stdout_file().str()));
-        ATF_REQUIRE(!atf::utils::file_exists(
-                        result_handle->stderr_file().str()));
-        ATF_REQUIRE(!atf::utils::file_exists(
-                        result_handle->work_directory().str()));
+ATF_TEST_CASE_WITHOUT_HEAD(integration__max_core_size);
+ATF_TEST_CASE_BODY(integration__max_core_size)
+{
+    const model::test_program_ptr program = model::test_program_builder(
+        "mock", fs::path("the-program"), fs::current_path(), "the-suite")
+        .add_test_case("print_core_limit").build_ptr();
 
-        result_handle.reset();
-    }
+    config::tree user_config = engine::empty_config();
+    user_config.set_string("max_core_size", "0");
+
+    scheduler::scheduler_handle handle = scheduler::setup();
+    (void)handle.spawn_test(program, "print_core_limit", user_config);
+    scheduler::result_handle_ptr result_handle = handle.wait_any();
+    const scheduler::test_result_handle* test_result_handle =
+        dynamic_cast< const scheduler::test_result_handle* >(
+            result_handle.get());
+    ATF_REQUIRE_EQ(model::test_result(model::test_result_passed, "Exit 0"),
+                   test_result_handle->test_result());
+    ATF_REQUIRE(atf::utils::compare_file(
+        result_handle->stdout_file().str(), "0\n"));
+    result_handle->cleanup();
+    result_handle.reset();
 
     handle.cleanup();
 }
 
 
-ATF_TEST_CASE_WITHOUT_HEAD(integration__run_check_paths);
-ATF_TEST_CASE_BODY(integration__run_check_paths)
+ATF_TEST_CASE_WITHOUT_HEAD(integration__fixtures);
+ATF_TEST_CASE_BODY(integration__fixtures)
 {
-    fs::mkdir_p(fs::path("dir1/dir2/dir3"), 0755);
-    atf::utils::create_file("dir1/dir2/dir3/program", "");
+    fs::mkdir(fs::path("data"), 0755);
+    atf::utils::create_file("data/nested", "first\n");
+    atf::utils::create_file("single", "second\n");
 
     const model::test_program_ptr program = model::test_program_builder(
-        "mock", fs::path("dir2/dir3/program"), fs::path("dir1"), "the-suite")
-        .add_test_case("check_i_exist").build_ptr();
+        "mock", fs::path("the-program"), fs::current_path(), "the-suite")
+        .add_test_case("cat_fixtures",
+                       model::metadata_builder()
+                       .add_fixture(fs::path("data"))
+                       .add_fixture(fs::current_path() / "single")
+                       .build())
+        .build_ptr();
 
-    scheduler::scheduler_handle handle = scheduler::setup();
+    const config::tree user_config = engine::empty_config();
 
-    (void)handle.spawn_test(program, "check_i_exist", engine::default_config());
+    scheduler::scheduler_handle handle = scheduler::setup();
+    (void)handle.spawn_test(program, "cat_fixtures", user_config);
     scheduler::result_handle_ptr result_handle = handle.wait_any();
     const scheduler::test_result_handle* test_result_handle =
         dynamic_cast< const scheduler::test_result_handle* >(
             result_handle.get());
-
     ATF_REQUIRE_EQ(model::test_result(model::test_result_passed, "Exit 0"),
                    test_result_handle->test_result());
-
+    ATF_REQUIRE(atf::utils::compare_file(
+        result_handle->stdout_file().str(), "first\nsecond\n"));
     result_handle->cleanup();
     result_handle.reset();
 
@@ -729,49 +1933,91 @@ ATF_TEST_CASE_BODY(integration__run_check_paths)
 }
 
 
-ATF_TEST_CASE_WITHOUT_HEAD(integration__parameters_and_output);
-ATF_TEST_CASE_BODY(integration__parameters_and_output)
+ATF_TEST_CASE_WITHOUT_HEAD(integration__fixtures__missing);
+ATF_TEST_CASE_BODY(integration__fixtures__missing)
 {
     const model::test_program_ptr program = model::test_program_builder(
         "mock", fs::path("the-program"), fs::current_path(), "the-suite")
-        .add_test_case("print_params").build_ptr();
+        .add_test_case("cat_fixtures",
+                       model::metadata_builder()
+                       .add_fixture(fs::path("missing"))
+                       .build())
+        .build_ptr();
 
-    config::tree user_config = engine::empty_config();
-    user_config.set_string("test_suites.the-suite.one", "first variable");
-    user_config.set_string("test_suites.the-suite.two", "second variable");
+    const config::tree user_config = engine::empty_config();
 
     scheduler::scheduler_handle handle = scheduler::setup();
+    (void)handle.spawn_test(program, "cat_fixtures", user_config);
+    scheduler::result_handle_ptr result_handle = handle.wait_any();
+    const scheduler::test_result_handle* test_result_handle =
+        dynamic_cast< const scheduler::test_result_handle* >(
+            result_handle.get());
+    ATF_REQUIRE_EQ(model::test_result_broken,
+                   test_result_handle->test_result().type());
+    ATF_REQUIRE_MATCH("^Failed to stage fixtures: .*missing",
+                      test_result_handle->test_result().reason());
+    result_handle->cleanup();
+    result_handle.reset();
 
-    const scheduler::exec_handle exec_handle = handle.spawn_test(
-        program, "print_params", user_config);
+    handle.cleanup();
+}
 
+
+ATF_TEST_CASE_WITHOUT_HEAD(integration__adaptive_timeout);
+ATF_TEST_CASE_BODY(integration__adaptive_timeout)
+{
+    const model::test_program_ptr program = model::test_program_builder(
+        "mock", fs::path("the-program"), fs::current_path(), "the-suite")
+        .add_test_case("spin").build_ptr();
+
+    const config::tree user_config = engine::empty_config();
+
+    scheduler::scheduler_handle handle = scheduler::setup();
+    (void)handle.spawn_test(program, "spin", user_config, std::set< int >(),
+                            utils::make_optional(datetime::delta(1, 0)));
     scheduler::result_handle_ptr result_handle = handle.wait_any();
     const scheduler::test_result_handle* test_result_handle =
         dynamic_cast< const scheduler::test_result_handle* >(
             result_handle.get());
-
-    ATF_REQUIRE_EQ(exec_handle, result_handle->original_pid());
-    ATF_REQUIRE_EQ(program, test_result_handle->test_program());
-    ATF_REQUIRE_EQ("print_params", test_result_handle->test_case_name());
-    ATF_REQUIRE_EQ(model::test_result(model::test_result_passed, "Exit 0"),
+    ATF_REQUIRE_EQ(model::test_result(model::test_result_broken,
+                                      "Timed out (adaptive timeout of 1.000s; "
+                                      "declared 300.000s)"),
                    test_result_handle->test_result());
+    result_handle->cleanup();
+    result_handle.reset();
 
-    const fs::path stdout_file = result_handle->stdout_file();
-    ATF_REQUIRE(atf::utils::compare_file(
-        stdout_file.str(),
-        "Test program: the-program\n"
-        "Test case: print_params\n"
-        "one=first variable\n"
-        "two=second variable\n"));
-    const fs::path stderr_file = result_handle->stderr_file();
-    ATF_REQUIRE(atf::utils::compare_file(
-        stderr_file.str(), "stderr: print_params\n"));
+    const utils::latency_histograms_map& latencies = handle.latencies();
+    ATF_REQUIRE(latencies.find("adaptive_timeout") != latencies.end());
+    ATF_REQUIRE_EQ(1, (*latencies.find("adaptive_timeout")).second.count());
+
+    handle.cleanup();
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(integration__adaptive_timeout__longer);
+ATF_TEST_CASE_BODY(integration__adaptive_timeout__longer)
+{
+    const model::test_program_ptr program = model::test_program_builder(
+        "mock", fs::path("the-program"), fs::current_path(), "the-suite")
+        .add_test_case("exit 0").build_ptr();
+
+    const config::tree user_config = engine::empty_config();
 
+    scheduler::scheduler_handle handle = scheduler::setup();
+    (void)handle.spawn_test(program, "exit 0", user_config, std::set< int >(),
+                            utils::make_optional(datetime::delta(1000, 0)));
+    scheduler::result_handle_ptr result_handle = handle.wait_any();
+    const scheduler::test_result_handle* test_result_handle =
+        dynamic_cast< const scheduler::test_result_handle* >(
+            result_handle.get());
+    ATF_REQUIRE_EQ(model::test_result(model::test_result_passed, "Exit 0"),
+                   test_result_handle->test_result());
     result_handle->cleanup();
-    ATF_REQUIRE(!fs::exists(stdout_file));
-    ATF_REQUIRE(!fs::exists(stderr_file));
     result_handle.reset();
 
+    const utils::latency_histograms_map& latencies = handle.latencies();
+    ATF_REQUIRE(latencies.find("adaptive_timeout") == latencies.end());
+
     handle.cleanup();
 }
 
@@ -879,6 +2125,43 @@ do_cleanup_test(const char* test_case,
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(integration__skip__work_directory_reqs);
+ATF_TEST_CASE_BODY(integration__skip__work_directory_reqs)
+{
+    const model::test_program_ptr program = model::test_program_builder(
+        "mock", fs::path("the-program"), fs::current_path(), "the-suite")
+        .add_test_case("skip_me",
+                       model::metadata_builder()
+                       .set_required_disk_space(units::bytes::parse("1000t"))
+                       .set_has_cleanup(true)
+                       .build())
+        .build_ptr();
+
+    const config::tree user_config = engine::empty_config();
+
+    scheduler::scheduler_handle handle = scheduler::setup();
+
+    (void)handle.spawn_test(program, "skip_me", user_config);
+
+    scheduler::result_handle_ptr result_handle = handle.wait_any();
+    const scheduler::test_result_handle* test_result_handle =
+        dynamic_cast< const scheduler::test_result_handle* >(
+            result_handle.get());
+    ATF_REQUIRE_EQ(model::test_result_skipped,
+                   test_result_handle->test_result().type());
+    ATF_REQUIRE_MATCH("Requires 1000.00T bytes of free disk space",
+                      test_result_handle->test_result().reason());
+    ATF_REQUIRE(!fs::exists(result_handle->work_directory().branch_path() /
+                            "skipped.txt"));
+    ATF_REQUIRE(!atf::utils::grep_file("exec_cleanup was called",
+                                       result_handle->stdout_file().str()));
+    result_handle->cleanup();
+    result_handle.reset();
+
+    handle.cleanup();
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(integration__cleanup__body_skips);
 ATF_TEST_CASE_BODY(integration__cleanup__body_skips)
 {
@@ -927,6 +2210,168 @@ ATF_TEST_CASE_BODY(integration__cleanup__timeout)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(integration__poll_any);
+ATF_TEST_CASE_BODY(integration__poll_any)
+{
+    const model::test_program_ptr program = model::test_program_builder(
+        "mock", fs::path("the-program"), fs::current_path(), "the-suite")
+        .add_test_case("skip_body_pass_cleanup")
+        .set_metadata(model::metadata_builder().set_has_cleanup(true).build())
+        .build_ptr();
+
+    const config::tree user_config = engine::empty_config();
+
+    scheduler::scheduler_handle handle = scheduler::setup();
+
+    (void)handle.spawn_test(program, "skip_body_pass_cleanup", user_config);
+
+    // The completion of the body must not be reported to us: only the result
+    // of the test case after its cleanup routine runs.
+    optional< scheduler::result_handle_ptr > result_handle;
+    while (!(result_handle = handle.poll_any()))
+        ::usleep(1000);
+    const scheduler::test_result_handle* test_result_handle =
+        dynamic_cast< const scheduler::test_result_handle* >(
+            result_handle.get().get());
+    ATF_REQUIRE_EQ(model::test_result(model::test_result_skipped, "Exit 0"),
+                   test_result_handle->test_result());
+    ATF_REQUIRE(atf::utils::compare_file(
+        result_handle.get()->stdout_file().str(),
+        "exec_cleanup was called\n"));
+    result_handle.get()->cleanup();
+    result_handle = none;
+
+    handle.cleanup();
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(integration__observer);
+ATF_TEST_CASE_BODY(integration__observer)
+{
+    const model::test_program_ptr program = model::test_program_builder(
+        "mock", fs::path("the-program"), fs::current_path(), "the-suite")
+        .add_test_case("skip_body_pass_cleanup")
+        .set_metadata(model::metadata_builder().set_has_cleanup(true).build())
+        .add_test_case("spin")
+        .build_ptr();
+
+    const config::tree user_config = engine::empty_config();
+
+    scheduler::event_queue queue(100);
+    scheduler::scheduler_handle handle = scheduler::setup();
+    handle.set_observer(&queue);
+
+    const scheduler::exec_handle exec_handle = handle.spawn_test(
+        program, "skip_body_pass_cleanup", user_config);
+    scheduler::result_handle_ptr result_handle = handle.wait_any();
+    result_handle->cleanup();
+    result_handle.reset();
+
+    (void)handle.spawn_test(program, "spin", user_config, std::set< int >(),
+                            utils::make_optional(datetime::delta(1, 0)));
+    result_handle = handle.wait_any();
+    result_handle->cleanup();
+    result_handle.reset();
+
+    const std::vector< scheduler::event > events = queue.drain();
+    ATF_REQUIRE_EQ(8, events.size());
+
+    ATF_REQUIRE_EQ(scheduler::test_spawned_event, events[0].type);
+    ATF_REQUIRE_EQ(exec_handle, events[0].pid);
+    ATF_REQUIRE_EQ("skip_body_pass_cleanup", events[0].test_case_name);
+    ATF_REQUIRE_EQ(1, events[0].running);
+    ATF_REQUIRE(events[0].stdout_file);
+    ATF_REQUIRE(events[0].stderr_file);
+    ATF_REQUIRE_EQ(scheduler::exited_event, events[1].type);
+    ATF_REQUIRE_EQ(exec_handle, events[1].pid);
+    ATF_REQUIRE_EQ(0, events[1].running);
+    ATF_REQUIRE(!events[1].stdout_file);
+    ATF_REQUIRE_EQ(scheduler::cleanup_spawned_event, events[2].type);
+    ATF_REQUIRE_EQ("skip_body_pass_cleanup", events[2].test_case_name);
+    ATF_REQUIRE_EQ(1, events[2].running);
+    ATF_REQUIRE_EQ(events[0].stdout_file, events[2].stdout_file);
+    ATF_REQUIRE_EQ(events[0].stderr_file, events[2].stderr_file);
+    ATF_REQUIRE_EQ(scheduler::exited_event, events[3].type);
+    ATF_REQUIRE_EQ(events[2].pid, events[3].pid);
+    ATF_REQUIRE_EQ(0, events[3].running);
+
+    ATF_REQUIRE_EQ(scheduler::test_spawned_event, events[4].type);
+    ATF_REQUIRE_EQ("spin", events[4].test_case_name);
+    ATF_REQUIRE_EQ(scheduler::timed_out_event, events[5].type);
+    ATF_REQUIRE_EQ(events[4].pid, events[5].pid);
+    ATF_REQUIRE_EQ("spin", events[5].test_case_name);
+    ATF_REQUIRE_EQ(scheduler::cleanup_spawned_event, events[6].type);
+    ATF_REQUIRE_EQ(scheduler::exited_event, events[7].type);
+    ATF_REQUIRE_EQ(events[6].pid, events[7].pid);
+
+    for (std::size_t i = 1; i < events.size(); ++i)
+        ATF_REQUIRE(events[i - 1].timestamp <= events[i].timestamp);
+    ATF_REQUIRE(queue.drain().empty());
+
+    handle.cleanup();
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(event_queue__bounded);
+ATF_TEST_CASE_BODY(event_queue__bounded)
+{
+    const model::test_program_ptr program = model::test_program_builder(
+        "mock", fs::path("the-program"), fs::current_path(), "the-suite")
+        .add_test_case("foo").build_ptr();
+    const datetime::timestamp now = datetime::timestamp::from_microseconds(1);
+
+    scheduler::event_queue queue(2);
+    queue.got_event(scheduler::event(scheduler::test_spawned_event, 10,
+                                     program, "foo", now, 1));
+    queue.got_event(scheduler::event(scheduler::test_spawned_event, 20,
+                                     program, "foo", now, 2));
+    queue.got_event(scheduler::event(scheduler::exited_event, 10,
+                                     program, "foo", now, 1));
+    ATF_REQUIRE_EQ(1, queue.dropped());
+
+    const std::vector< scheduler::event > events = queue.drain();
+    ATF_REQUIRE_EQ(2, events.size());
+    ATF_REQUIRE_EQ(20, events[0].pid);
+    ATF_REQUIRE_EQ(scheduler::test_spawned_event, events[0].type);
+    ATF_REQUIRE_EQ(10, events[1].pid);
+    ATF_REQUIRE_EQ(scheduler::exited_event, events[1].type);
+    ATF_REQUIRE(queue.drain().empty());
+    ATF_REQUIRE_EQ(1, queue.dropped());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(integration__terminate);
+ATF_TEST_CASE_BODY(integration__terminate)
+{
+    const model::test_program_ptr program = model::test_program_builder(
+        "mock", fs::path("the-program"), fs::current_path(), "the-suite")
+        .add_test_case("spin").build_ptr();
+
+    const config::tree user_config = engine::empty_config();
+
+    scheduler::scheduler_handle handle = scheduler::setup();
+    const scheduler::exec_handle exec_handle = handle.spawn_test(
+        program, "spin", user_config);
+    handle.terminate(exec_handle);
+    scheduler::result_handle_ptr result_handle = handle.wait_any();
+    ATF_REQUIRE_EQ(exec_handle, result_handle->original_pid());
+    const scheduler::test_result_handle* test_result_handle =
+        dynamic_cast< const scheduler::test_result_handle* >(
+            result_handle.get());
+    ATF_REQUIRE_EQ(model::test_result(model::test_result_failed,
+                                      F("Signal %s") % SIGKILL),
+                   test_result_handle->test_result());
+
+    // The subprocess is gone, so terminating it again must not kill anyone
+    // else that may have reused its PID.
+    handle.terminate(exec_handle);
+    result_handle->cleanup();
+    result_handle.reset();
+
+    handle.cleanup();
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(integration__check_requirements);
 ATF_TEST_CASE_BODY(integration__check_requirements)
 {
@@ -991,6 +2436,54 @@ ATF_TEST_CASE_BODY(integration__stacktrace)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(integration__stacktrace__limit);
+ATF_TEST_CASE_BODY(integration__stacktrace__limit)
+{
+    utils::prepare_coredump_test(this);
+    scheduler::max_stacktrace_jobs = 1;
+
+    // Use a fake GDB and a placeholder core next to the program so that all
+    // crashes go through the asynchronous stacktrace collection.
+    atf::utils::create_file("fake-gdb", "#! /bin/sh\necho 'frame 1'\n");
+    ATF_REQUIRE(::chmod("fake-gdb", 0755) != -1);
+    const std::string gdb = (fs::current_path() / "fake-gdb").str();
+    utils::builtin_gdb = gdb.c_str();
+    atf::utils::create_file("the-program.core", "Invalid core, but not read");
+
+    const model::test_program_ptr program = model::test_program_builder(
+        "mock", fs::path("the-program"), fs::current_path(), "the-suite")
+        .add_test_case("unknown-dumps-core").build_ptr();
+
+    const config::tree user_config = engine::empty_config();
+
+    scheduler::scheduler_handle handle = scheduler::setup();
+
+    const std::size_t total_tests = 3;
+    for (std::size_t i = 0; i < total_tests; ++i)
+        (void)handle.spawn_test(program, "unknown-dumps-core", user_config);
+
+    for (std::size_t i = 0; i < total_tests; ++i) {
+        scheduler::result_handle_ptr result_handle = handle.wait_any();
+        const scheduler::test_result_handle* test_result_handle =
+            dynamic_cast< const scheduler::test_result_handle* >(
+                result_handle.get());
+        ATF_REQUIRE_EQ(model::test_result(model::test_result_failed,
+                                          F("Signal %s") % SIGABRT),
+                       test_result_handle->test_result());
+        ATF_REQUIRE(atf::utils::grep_file("attempting to gather stack trace",
+                                          result_handle->stderr_file().str()));
+        ATF_REQUIRE(atf::utils::grep_file("^frame 1$",
+                                          result_handle->stderr_file().str()));
+        ATF_REQUIRE(atf::utils::grep_file("GDB exited successfully",
+                                          result_handle->stderr_file().str()));
+        result_handle->cleanup();
+        result_handle.reset();
+    }
+
+    handle.cleanup();
+}
+
+
 /// Runs a test to verify the dumping of the list of existing files on failure.
 ///
 /// \param test_case The name of the test case to invoke.
@@ -1213,28 +2706,62 @@ ATF_INIT_TEST_CASES(tcs)
     ATF_ADD_TEST_CASE(tcs, integration__list_timeout);
     ATF_ADD_TEST_CASE(tcs, integration__list_fail);
     ATF_ADD_TEST_CASE(tcs, integration__list_empty);
+    ATF_ADD_TEST_CASE(tcs, integration__list_static);
+    ATF_ADD_TEST_CASE(tcs, integration__spawn_list);
+    ATF_ADD_TEST_CASE(tcs, integration__spawn_list__variants_share);
+    ATF_ADD_TEST_CASE(tcs, integration__spawn_list__late_variant);
+    ATF_ADD_TEST_CASE(tcs, integration__release_test_cases);
+    ATF_ADD_TEST_CASE(tcs, integration__list_tests_batch);
+    ATF_ADD_TEST_CASE(tcs, integration__list_tests_batch__hooks);
+    ATF_ADD_TEST_CASE(tcs, integration__list_tests_batch__static);
+    ATF_ADD_TEST_CASE(tcs, integration__list_tests_batch__variants_share);
 
     ATF_ADD_TEST_CASE(tcs, integration__run_one);
+    ATF_ADD_TEST_CASE(tcs, integration__result_pipe__enabled);
+    ATF_ADD_TEST_CASE(tcs, integration__result_pipe__larger_than_pipe);
+    ATF_ADD_TEST_CASE(tcs, integration__result_pipe__disabled);
+    ATF_ADD_TEST_CASE(tcs, integration__exec_plan);
+    ATF_ADD_TEST_CASE(tcs, integration__prepare_spawns);
     ATF_ADD_TEST_CASE(tcs, integration__run_many);
+    ATF_ADD_TEST_CASE(tcs, integration__run_many__deferred_cleanup);
 
     ATF_ADD_TEST_CASE(tcs, integration__run_check_paths);
     ATF_ADD_TEST_CASE(tcs, integration__parameters_and_output);
-
+    ATF_ADD_TEST_CASE(tcs, integration__parameters__variant);
+    ATF_ADD_TEST_CASE(tcs, integration__parameters__cached);
+
+    ATF_ADD_TEST_CASE(tcs, integration__max_output_size__metadata);
+    ATF_ADD_TEST_CASE(tcs, integration__max_output_size__config);
+    ATF_ADD_TEST_CASE(tcs, integration__max_output_size__small_output);
+    ATF_ADD_TEST_CASE(tcs, integration__enforce_required_memory);
+    ATF_ADD_TEST_CASE(tcs, integration__max_cpu_time);
+    ATF_ADD_TEST_CASE(tcs, integration__max_core_size);
+    ATF_ADD_TEST_CASE(tcs, integration__fixtures);
+    ATF_ADD_TEST_CASE(tcs, integration__fixtures__missing);
+    ATF_ADD_TEST_CASE(tcs, integration__adaptive_timeout);
+    ATF_ADD_TEST_CASE(tcs, integration__adaptive_timeout__longer);
     ATF_ADD_TEST_CASE(tcs, integration__fake_result);
     ATF_ADD_TEST_CASE(tcs, integration__cleanup__head_skips);
+    ATF_ADD_TEST_CASE(tcs, integration__skip__work_directory_reqs);
     ATF_ADD_TEST_CASE(tcs, integration__cleanup__body_skips);
     ATF_ADD_TEST_CASE(tcs, integration__cleanup__body_ok__cleanup_bad);
     ATF_ADD_TEST_CASE(tcs, integration__cleanup__body_bad__cleanup_ok);
     ATF_ADD_TEST_CASE(tcs, integration__cleanup__body_bad__cleanup_bad);
     ATF_ADD_TEST_CASE(tcs, integration__cleanup__timeout);
+    ATF_ADD_TEST_CASE(tcs, integration__poll_any);
+    ATF_ADD_TEST_CASE(tcs, integration__observer);
+    ATF_ADD_TEST_CASE(tcs, integration__terminate);
     ATF_ADD_TEST_CASE(tcs, integration__check_requirements);
     ATF_ADD_TEST_CASE(tcs, integration__stacktrace);
+    ATF_ADD_TEST_CASE(tcs, integration__stacktrace__limit);
     ATF_ADD_TEST_CASE(tcs, integration__list_files_on_failure__none);
     ATF_ADD_TEST_CASE(tcs, integration__list_files_on_failure__some);
     ATF_ADD_TEST_CASE(tcs, integration__prevent_clobbering_control_files);
 
     ATF_ADD_TEST_CASE(tcs, debug_test);
 
+    ATF_ADD_TEST_CASE(tcs, event_queue__bounded);
+
     ATF_ADD_TEST_CASE(tcs, ensure_valid_interface);
     ATF_ADD_TEST_CASE(tcs, registered_interface_names);
 
@@ -0,0 +1,880 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "engine/server.hpp"
+
+extern "C" {
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+}
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "engine/exceptions.hpp"
+#include "model/test_case.hpp"
+#include "model/test_program.hpp"
+#include "model/test_result.hpp"
+#include "utils/defs.hpp"
+#include "utils/env.hpp"
+#include "utils/format/macros.hpp"
+#include "utils/fs/exceptions.hpp"
+#include "utils/fs/operations.hpp"
+#include "utils/fs/path.hpp"
+#include "utils/logging/macros.hpp"
+#include "utils/noncopyable.hpp"
+#include "utils/optional.ipp"
+#include "utils/process/exceptions.hpp"
+#include "utils/process/operations.hpp"
+#include "utils/process/status.hpp"
+#include "utils/sanity.hpp"
+#include "utils/stream.hpp"
+
+namespace config = utils::config;
+namespace fs = utils::fs;
+namespace process = utils::process;
+
+using utils::none;
+using utils::optional;
+
+
+namespace {
+
+
+/// Name of the control file where the runner stores the reported result.
+static const char* result_name = "server_result";
+
+
+/// Name of the control file where the runner stores the PID of its server.
+static const char* server_pid_name = "server_pid";
+
+
+/// File descriptor on which test program servers write their replies.
+static const int replies_fileno = 3;
+
+
+/// Representation of a test program running in server mode.
+struct server {
+    /// PID of the server, which is also the leader of its process group.
+    pid_t pid;
+
+    /// Write end of the pipe connected to the stdin of the server.
+    int requests_fd;
+
+    /// Read end of the pipe connected to the replies descriptor of the server.
+    int replies_fd;
+
+    /// File to lock while a test case is being run by the server.
+    fs::path lock_file;
+
+    /// File that receives the stdout of the server.
+    fs::path stdout_file;
+
+    /// File that receives the stderr of the server.
+    fs::path stderr_file;
+
+    /// Constructor.
+    ///
+    /// \param directory_ Directory in which to place the files of the server.
+    /// \param id_ Unique identifier of the server within directory_.
+    server(const fs::path& directory_, const std::size_t id_) :
+        pid(-1), requests_fd(-1), replies_fd(-1),
+        lock_file(directory_ / (F("%s.lock") % id_).str()),
+        stdout_file(directory_ / (F("%s.out") % id_).str()),
+        stderr_file(directory_ / (F("%s.err") % id_).str())
+    {
+    }
+};
+
+
+/// Identifies the servers that can run the test cases of a test program.
+///
+/// Variants of a test program are given different configuration variables,
+/// which are fixed for the lifetime of the server, so they need their own.
+typedef std::pair< fs::path, config::properties_map > server_key;
+
+
+/// Collection of servers for a test program.
+typedef std::vector< server > servers_vector;
+
+
+/// Collection of servers for all test programs.
+typedef std::map< server_key, servers_vector > servers_map;
+
+
+/// Moves two file descriptors to fixed positions.
+///
+/// This is intended to be called in a subprocess that is about to exec the
+/// test program, and must cope with the sources overlapping the targets.
+///
+/// \param requests Descriptor to place on stdin.
+/// \param replies Descriptor to place on replies_fileno.
+///
+/// \return True if the descriptors were set up; false otherwise.
+static bool
+setup_server_fds(const int requests, const int replies)
+{
+    const int requests_copy = ::fcntl(requests, F_DUPFD, 10);
+    const int replies_copy = ::fcntl(replies, F_DUPFD, 10);
+    if (requests_copy == -1 || replies_copy == -1)
+        return false;
+    (void)::close(requests);
+    (void)::close(replies);
+
+    if (::dup2(requests_copy, STDIN_FILENO) == -1 ||
+        ::dup2(replies_copy, replies_fileno) == -1)
+        return false;
+    (void)::close(requests_copy);
+    (void)::close(replies_copy);
+    return true;
+}
+
+
+/// Executes a test program in server mode.
+///
+/// This is intended to be called in a subprocess and never returns.
+///
+/// \param program The test program to execute.
+/// \param vars User-provided variables to pass to the test program.
+static void
+exec_server(const fs::path& program, const config::properties_map& vars)
+    UTILS_NORETURN;
+static void
+exec_server(const fs::path& program, const config::properties_map& vars)
+{
+    for (config::properties_map::const_iterator iter = vars.begin();
+         iter != vars.end(); ++iter) {
+        utils::setenv(F("TEST_ENV_%s") % (*iter).first, (*iter).second);
+    }
+
+    process::args_vector args;
+    args.push_back("-s");
+    try {
+        process::exec_unsafe(program, args);
+    } catch (const process::system_error& e) {
+        std::cerr << F("Failed to execute %s: %s\n") % program % e.what();
+    }
+    ::_exit(EXIT_FAILURE);
+}
+
+
+/// Opens a file for writing and places it on a given descriptor.
+///
+/// \param file The file to open.
+/// \param fd The descriptor on which to place the open file.
+///
+/// \return True if the file was opened; false otherwise.
+static bool
+redirect_to(const fs::path& file, const int fd)
+{
+    const int new_fd = ::open(file.c_str(),
+                              O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    if (new_fd == -1)
+        return false;
+    if (new_fd != fd) {
+        if (::dup2(new_fd, fd) == -1)
+            return false;
+        (void)::close(new_fd);
+    }
+    return true;
+}
+
+
+/// Starts a test program in server mode in the background.
+///
+/// The server is detached from the current process so that its termination
+/// is never reported to the scheduler as that of one of its subprocesses.  It
+/// lives in its own session and exits once its requests pipe is closed.
+///
+/// \param program Absolute path to the test program to execute.
+/// \param vars User-provided variables to pass to the test program.
+/// \param directory Directory in which to run the server.
+/// \param id Unique identifier of the server within directory.
+///
+/// \return The representation of the new server.
+///
+/// \throw process::system_error If the server cannot be spawned.
+/// \throw engine::error If the server does not start correctly.
+static server
+start_server(const fs::path& program, const config::properties_map& vars,
+             const fs::path& directory, const std::size_t id)
+{
+    server new_server(directory, id);
+
+    int requests[2];
+    if (::pipe(requests) == -1)
+        throw process::system_error("pipe(2) failed", errno);
+    int replies[2];
+    if (::pipe(replies) == -1) {
+        const int original_errno = errno;
+        (void)::close(requests[0]);
+        (void)::close(requests[1]);
+        throw process::system_error("pipe(2) failed", original_errno);
+    }
+
+    const pid_t intermediate = ::fork();
+    if (intermediate == -1) {
+        const int original_errno = errno;
+        (void)::close(requests[0]);
+        (void)::close(requests[1]);
+        (void)::close(replies[0]);
+        (void)::close(replies[1]);
+        throw process::system_error("fork(2) failed", original_errno);
+    } else if (intermediate == 0) {
+        const pid_t pid = ::fork();
+        if (pid != 0) {
+            // Report the PID of the server, which is not our child, back to
+            // the scheduler over the pipe of the replies.
+            if (pid == -1 || ::write(replies[1], &pid, sizeof(pid)) !=
+                static_cast< ssize_t >(sizeof(pid)))
+                ::_exit(EXIT_FAILURE);
+            ::_exit(EXIT_SUCCESS);
+        }
+
+        (void)::close(requests[1]);
+        (void)::close(replies[0]);
+        if (::setsid() == -1 ||
+            !setup_server_fds(requests[0], replies[1]) ||
+            !redirect_to(new_server.stdout_file, STDOUT_FILENO) ||
+            !redirect_to(new_server.stderr_file, STDERR_FILENO) ||
+            ::chdir(directory.c_str()) == -1)
+            ::_exit(EXIT_FAILURE);
+        (void)::umask(0022);
+        exec_server(program, vars);
+    }
+
+    (void)::close(requests[0]);
+    (void)::close(replies[1]);
+    new_server.requests_fd = requests[1];
+    new_server.replies_fd = replies[0];
+    (void)::fcntl(new_server.requests_fd, F_SETFD, FD_CLOEXEC);
+    (void)::fcntl(new_server.replies_fd, F_SETFD, FD_CLOEXEC);
+
+    int stat_loc;
+    while (::waitpid(intermediate, &stat_loc, 0) == -1 && errno == EINTR) {}
+    if (!WIFEXITED(stat_loc) || WEXITSTATUS(stat_loc) != EXIT_SUCCESS ||
+        ::read(new_server.replies_fd, &new_server.pid,
+               sizeof(new_server.pid)) !=
+        static_cast< ssize_t >(sizeof(new_server.pid))) {
+        (void)::close(new_server.requests_fd);
+        (void)::close(new_server.replies_fd);
+        throw engine::error(F("Failed to start %s in server mode") % program);
+    }
+
+    return new_server;
+}
+
+
+/// Tries to lock the file that represents the use of a server.
+///
+/// \param lock_file The file to lock, which is created if missing.
+///
+/// \return The descriptor that holds the lock, or -1 if the server is busy.
+static int
+try_lock(const fs::path& lock_file)
+{
+    const int fd = ::open(lock_file.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd == -1)
+        return -1;
+    (void)::fcntl(fd, F_SETFD, FD_CLOEXEC);
+    if (::flock(fd, LOCK_EX | LOCK_NB) == -1) {
+        (void)::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+
+/// Checks if an unused server is ready to take a new request.
+///
+/// An unused server must not have anything to report, so any readable data
+/// or the closure of its replies pipe mean that it died or that it replied to
+/// a request after its runner gave up waiting for it.
+///
+/// \param candidate The server to check.
+///
+/// \return True if the server can be reused; false otherwise.
+static bool
+is_ready(const server& candidate)
+{
+    struct ::pollfd poll_fd;
+    poll_fd.fd = candidate.replies_fd;
+    poll_fd.events = POLLIN;
+    poll_fd.revents = 0;
+    return ::poll(&poll_fd, 1, 0) == 0;
+}
+
+
+/// Writes a string to a file descriptor.
+///
+/// \param fd The descriptor to write to.
+/// \param data The data to write.
+///
+/// \return True if all the data was written; false otherwise.
+static bool
+write_all(const int fd, const std::string& data)
+{
+    std::size_t done = 0;
+    while (done < data.length()) {
+        const ssize_t ret = ::write(fd, data.c_str() + done,
+                                    data.length() - done);
+        if (ret == -1) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        done += ret;
+    }
+    return true;
+}
+
+
+/// Reads a single line from a file descriptor.
+///
+/// The line is read one byte at a time so that nothing past it is consumed.
+///
+/// \param fd The descriptor to read from.
+///
+/// \return The line without its terminator, or none if the descriptor was
+/// closed before a complete line was received.
+static optional< std::string >
+read_line(const int fd)
+{
+    std::string line;
+    for (;;) {
+        char ch;
+        const ssize_t ret = ::read(fd, &ch, 1);
+        if (ret == -1 && errno == EINTR)
+            continue;
+        if (ret != 1)
+            return none;
+        if (ch == '\n')
+            return utils::make_optional(line);
+        line += ch;
+    }
+}
+
+
+/// Moves the contents of a server output file to a descriptor.
+///
+/// \param file The output file of the server.
+/// \param fd The descriptor to append the contents to.
+static void
+drain_output(const fs::path& file, const int fd)
+{
+    const int input = ::open(file.c_str(), O_RDWR);
+    if (input == -1)
+        return;
+
+    char buffer[4096];
+    ssize_t ret;
+    while ((ret = ::read(input, buffer, sizeof(buffer))) > 0) {
+        if (!write_all(fd, std::string(buffer, ret)))
+            break;
+    }
+    (void)::ftruncate(input, 0);
+    (void)::close(input);
+}
+
+
+/// Stores the result reported by a server for the scheduler to pick it up.
+///
+/// \param control_directory Directory where to place the control files.
+/// \param reply The result line reported by the server.
+static void
+write_result(const fs::path& control_directory, const std::string& reply)
+{
+    std::ofstream output((control_directory / result_name).c_str());
+    if (!output) {
+        std::cerr << "Failed to create the result file\n";
+        ::_exit(EXIT_FAILURE);
+    }
+    output << reply << '\n';
+}
+
+
+/// Runs a test case in a new test program that only serves this request.
+///
+/// This is intended to be called in the runner subprocess and never returns.
+///
+/// \param program The test program to execute.
+/// \param vars User-provided variables to pass to the test program.
+/// \param request The request to send to the test program.
+/// \param control_directory Directory where to place the control files.
+static void
+run_in_fresh_process(const fs::path& program,
+                     const config::properties_map& vars,
+                     const std::string& request,
+                     const fs::path& control_directory) UTILS_NORETURN;
+static void
+run_in_fresh_process(const fs::path& program,
+                     const config::properties_map& vars,
+                     const std::string& request,
+                     const fs::path& control_directory)
+{
+    int requests[2], replies[2];
+    if (::pipe(requests) == -1 || ::pipe(replies) == -1) {
+        std::perror("pipe(2) failed");
+        ::_exit(EXIT_FAILURE);
+    }
+
+    const pid_t pid = ::fork();
+    if (pid == -1) {
+        std::perror("fork(2) failed");
+        ::_exit(EXIT_FAILURE);
+    } else if (pid == 0) {
+        (void)::close(requests[1]);
+        (void)::close(replies[0]);
+        if (!setup_server_fds(requests[0], replies[1]))
+            ::_exit(EXIT_FAILURE);
+        exec_server(program, vars);
+    }
+    (void)::close(requests[0]);
+    (void)::close(replies[1]);
+
+    (void)write_all(requests[1], request);
+    (void)::close(requests[1]);
+    const optional< std::string > reply = read_line(replies[0]);
+    (void)::close(replies[0]);
+
+    int stat_loc;
+    while (::waitpid(pid, &stat_loc, 0) == -1 && errno == EINTR) {}
+
+    if (reply)
+        write_result(control_directory, reply.get());
+    else if (WIFSIGNALED(stat_loc))
+        write_result(control_directory,
+                     F("broken: Received signal %s") % WTERMSIG(stat_loc));
+    else
+        write_result(control_directory,
+                     "broken: Test program exited without reporting a result");
+    ::_exit(EXIT_SUCCESS);
+}
+
+
+/// Parses the result line reported by a server.
+///
+/// \param reply The line to parse.
+///
+/// \return The test result represented by the line.
+static model::test_result
+parse_reply(const std::string& reply)
+{
+    static const struct {
+        const char* prefix;
+        model::test_result_type type;
+    } types[] = {
+        { "broken: ", model::test_result_broken },
+        { "expected_failure: ", model::test_result_expected_failure },
+        { "failed: ", model::test_result_failed },
+        { "skipped: ", model::test_result_skipped },
+    };
+
+    if (reply == "passed")
+        return model::test_result(model::test_result_passed);
+    for (std::size_t i = 0; i < sizeof(types) / sizeof(types[0]); ++i) {
+        const std::size_t length = std::strlen(types[i].prefix);
+        if (reply.compare(0, length, types[i].prefix) == 0 &&
+            reply.length() > length)
+            return model::test_result(types[i].type, reply.substr(length));
+    }
+    return model::test_result(
+        model::test_result_broken,
+        F("Invalid result reported by the test program: %s") % reply);
+}
+
+
+}  // anonymous namespace
+
+
+/// Internal implementation of the server_interface.
+struct engine::server_interface::impl : utils::noncopyable {
+    /// Directory holding the files of the servers; none until needed.
+    optional< fs::path > directory;
+
+    /// Identifier of the last server started.
+    std::size_t last_id;
+
+    /// Running servers by test program.
+    servers_map servers;
+
+    /// Server to use by the next test case and the descriptor that locks it.
+    ///
+    /// The descriptor is inherited by the subprocess of the next test case and
+    /// thus the lock is held until it terminates, regardless of how it does.
+    optional< std::pair< server, int > > assigned;
+
+    /// Constructor.
+    impl(void) :
+        last_id(0)
+    {
+    }
+
+    /// Destructor.
+    ~impl(void)
+    {
+        shutdown();
+    }
+
+    /// Releases the server assigned to the last prepared test case, if any.
+    void
+    release_assigned(void)
+    {
+        if (assigned) {
+            (void)::close(assigned.get().second);
+            assigned = none;
+        }
+    }
+
+    /// Kills the server that was running a test case, if any.
+    ///
+    /// \param control_directory Directory where the runner of the test case
+    ///     placed its control files.
+    void
+    kill_server(const fs::path& control_directory)
+    {
+        std::ifstream input((control_directory / server_pid_name).c_str());
+        pid_t pid;
+        if (!(input >> pid))
+            return;
+
+        for (servers_map::iterator iter = servers.begin();
+             iter != servers.end(); ++iter) {
+            servers_vector& candidates = (*iter).second;
+            for (servers_vector::iterator iter2 = candidates.begin();
+                 iter2 != candidates.end(); ++iter2) {
+                if ((*iter2).pid == pid) {
+                    // The server is known to be alive because it is still
+                    // tracked, so its PID cannot have been reused yet.
+                    LI(F("Killing test program server %s") % pid);
+                    (void)::kill(-pid, SIGKILL);
+                    (void)::close((*iter2).requests_fd);
+                    (void)::close((*iter2).replies_fd);
+                    candidates.erase(iter2);
+                    return;
+                }
+            }
+        }
+    }
+
+    /// Stops all servers and removes their files.
+    void
+    shutdown(void)
+    {
+        release_assigned();
+
+        for (servers_map::const_iterator iter = servers.begin();
+             iter != servers.end(); ++iter) {
+            for (servers_vector::const_iterator iter2 = (*iter).second.begin();
+                 iter2 != (*iter).second.end(); ++iter2) {
+                // Closing the requests pipe is the request to exit.
+                (void)::close((*iter2).requests_fd);
+                (void)::close((*iter2).replies_fd);
+            }
+        }
+        servers.clear();
+
+        if (directory) {
+            try {
+                fs::rm_r(directory.get());
+            } catch (const fs::error& e) {
+                LW(F("Failed to remove %s: %s") % directory.get() % e.what());
+            }
+            directory = none;
+        }
+    }
+};
+
+
+/// Constructor.
+engine::server_interface::server_interface(void) :
+    _pimpl(new impl())
+{
+}
+
+
+/// Destructor.
+engine::server_interface::~server_interface(void)
+{
+}
+
+
+/// Executes a test program's list operation.
+///
+/// This method is intended to be called within a subprocess and is expected
+/// to terminate execution either by exec(2)ing the test program or by
+/// exiting with a failure.
+///
+/// \param test_program The test program to execute.
+/// \param vars User-provided variables to pass to the test program.
+void
+engine::server_interface::exec_list(const model::test_program& test_program,
+                                    const config::properties_map& vars) const
+{
+    for (config::properties_map::const_iterator iter = vars.begin();
+         iter != vars.end(); ++iter) {
+        utils::setenv(F("TEST_ENV_%s") % (*iter).first, (*iter).second);
+    }
+
+    process::args_vector args;
+    args.push_back("-l");
+    process::exec(test_program.absolute_path(), args);
+}
+
+
+/// Computes the test cases list of a test program.
+///
+/// \param status The termination status of the subprocess used to execute
+///     the exec_test() method or none if the test timed out.
+/// \param stdout_path Path to the file containing the stdout of the test.
+/// \param unused_stderr_path Path to the file containing the stderr of the
+///     test.
+///
+/// \return A list of test cases.
+///
+/// \throw error If there is a problem parsing the test case list.
+model::test_cases_map
+engine::server_interface::parse_list(
+    const optional< process::status >& status,
+    const fs::path& stdout_path,
+    const fs::path& UTILS_UNUSED_PARAM(stderr_path)) const
+{
+    if (!status)
+        throw engine::error("Test case list timed out");
+    if (!status.get().exited() || status.get().exitstatus() != EXIT_SUCCESS)
+        throw engine::error("Test program did not exit cleanly");
+
+    std::ifstream input(stdout_path.c_str());
+    if (!input)
+        throw engine::load_error(stdout_path, "Cannot open file for read");
+
+    model::test_cases_map_builder test_cases_builder;
+    std::string line;
+    while (std::getline(input, line)) {
+        if (line.empty())
+            throw engine::format_error("Invalid empty test case name");
+        test_cases_builder.add(line);
+    }
+    return test_cases_builder.build();
+}
+
+
+/// Executes a test case of the test program.
+///
+/// This method is intended to be called within a subprocess and is expected
+/// to terminate execution either by exec(2)ing the test program or by
+/// exiting with a failure.
+///
+/// The test case is sent to the server assigned by prepare_test(), if any.
+/// Otherwise, or if the subprocess switched to a different user than the one
+/// running the servers, a new test program is started just for this request.
+///
+/// \param test_program The test program to execute.
+/// \param test_case_name Name of the test case to invoke.
+/// \param vars User-provided variables to pass to the test program.
+/// \param control_directory Directory where the interface may place control
+///     files.
+void
+engine::server_interface::exec_test(const model::test_program& test_program,
+                                    const std::string& test_case_name,
+                                    const config::properties_map& vars,
+                                    const fs::path& control_directory) const
+{
+    const std::string request = F("%s\t%s\n") % test_case_name %
+        fs::current_path();
+
+    struct ::stat sb;
+    if (!_pimpl->assigned || !_pimpl->directory ||
+        ::stat(_pimpl->directory.get().c_str(), &sb) == -1 ||
+        sb.st_uid != ::geteuid())
+        run_in_fresh_process(test_program.absolute_path(), vars, request,
+                             control_directory);
+
+    const server& assigned = _pimpl->assigned.get().first;
+    {
+        std::ofstream output((control_directory / server_pid_name).c_str());
+        if (!output) {
+            std::cerr << "Failed to create the server PID file\n";
+            ::_exit(EXIT_FAILURE);
+        }
+        output << assigned.pid << '\n';
+    }
+
+    // A server that crashed must not take us down when we talk to it.
+    (void)::signal(SIGPIPE, SIG_IGN);
+
+    optional< std::string > reply;
+    if (write_all(assigned.requests_fd, request))
+        reply = read_line(assigned.replies_fd);
+    drain_output(assigned.stdout_file, STDOUT_FILENO);
+    drain_output(assigned.stderr_file, STDERR_FILENO);
+
+    if (reply)
+        write_result(control_directory, reply.get());
+    else
+        write_result(control_directory, "broken: Test program server exited "
+                     "while running the test case");
+    ::_exit(EXIT_SUCCESS);
+}
+
+
+/// Computes the result of a test case based on its termination status.
+///
+/// \param status The termination status of the subprocess used to execute
+///     the exec_test() method or none if the test timed out.
+/// \param control_directory Directory where the interface may have placed
+///     control files.
+/// \param unused_stdout_path Path to the file containing the stdout of the
+///     test.
+/// \param unused_stderr_path Path to the file containing the stderr of the
+///     test.
+///
+/// \return A test result.
+model::test_result
+engine::server_interface::compute_result(
+    const optional< process::status >& status,
+    const fs::path& control_directory,
+    const fs::path& UTILS_UNUSED_PARAM(stdout_path),
+    const fs::path& UTILS_UNUSED_PARAM(stderr_path)) const
+{
+    if (!status || !status.get().exited() ||
+        status.get().exitstatus() != EXIT_SUCCESS) {
+        // The server may still be busy with the test case; get rid of it so
+        // that the next test case starts with a fresh one.
+        _pimpl->kill_server(control_directory);
+    }
+
+    if (!status) {
+        return model::test_result(model::test_result_broken,
+                                  "Test case timed out");
+    } else if (!status.get().exited()) {
+        return model::test_result(
+            model::test_result_broken,
+            F("Received signal %s") % status.get().termsig());
+    } else if (status.get().exitstatus() != EXIT_SUCCESS) {
+        return model::test_result(
+            model::test_result_broken,
+            F("Returned non-success exit status %s") %
+            status.get().exitstatus());
+    }
+
+    std::ifstream input((control_directory / result_name).c_str());
+    std::string reply;
+    if (!std::getline(input, reply))
+        return model::test_result(model::test_result_broken,
+                                  "Test case did not report a result");
+    return parse_reply(reply);
+}
+
+
+/// Assigns a server to the test case that is about to be spawned.
+///
+/// An idle server of the test program is reused if there is one; otherwise, a
+/// new one is started.  Servers that died, either on their own or because a
+/// test case crashed them, are discarded along the way.  Failing to start a
+/// server is not fatal: the test case then runs in a fresh process.
+///
+/// \param test_program The test program to execute.
+/// \param vars User-provided variables to pass to the test program.
+void
+engine::server_interface::prepare_test(const model::test_program& test_program,
+                                       const config::properties_map& vars)
+    const
+{
+    _pimpl->release_assigned();
+
+    const fs::path program = test_program.absolute_path().is_absolute() ?
+        test_program.absolute_path() :
+        test_program.absolute_path().to_absolute();
+    try {
+        if (!_pimpl->directory)
+            _pimpl->directory = fs::mkdtemp_public("kyua.server.XXXXXX");
+    } catch (const fs::error& e) {
+        LW(F("Cannot create directory for test program servers: %s") %
+           e.what());
+        return;
+    }
+
+    servers_vector& servers = _pimpl->servers[server_key(program, vars)];
+    servers_vector::iterator iter = servers.begin();
+    while (iter != servers.end()) {
+        const int lock_fd = try_lock((*iter).lock_file);
+        if (lock_fd == -1) {
+            ++iter;
+            continue;
+        }
+
+        if (is_ready(*iter)) {
+            _pimpl->assigned = std::make_pair(*iter, lock_fd);
+            return;
+        }
+
+        // Closing the requests pipe makes the server exit if it is still
+        // alive.  Do not kill it: its PID may have been reused already.
+        LI(F("Discarding test program server %s") % (*iter).pid);
+        (void)::close(lock_fd);
+        (void)::close((*iter).requests_fd);
+        (void)::close((*iter).replies_fd);
+        iter = servers.erase(iter);
+    }
+
+    try {
+        const server new_server = start_server(
+            program, vars, _pimpl->directory.get(), ++_pimpl->last_id);
+        const int lock_fd = try_lock(new_server.lock_file);
+        INV(lock_fd != -1);
+        LI(F("Started test program server %s for %s") % new_server.pid %
+           program);
+        servers.push_back(new_server);
+        _pimpl->assigned = std::make_pair(new_server, lock_fd);
+    } catch (const std::runtime_error& e) {
+        LW(F("Cannot start %s in server mode; running the test case in a "
+             "fresh process: %s") % program % e.what());
+    }
+}
+
+
+/// Stops all the servers once no more test cases will be executed.
+void
+engine::server_interface::finalize(void) const
+{
+    _pimpl->shutdown();
+}
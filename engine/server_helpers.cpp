@@ -0,0 +1,294 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+extern "C" {
+#include <unistd.h>
+
+extern char** environ;
+}
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <set>
+#include <string>
+
+#include "utils/format/containers.ipp"
+#include "utils/format/macros.hpp"
+#include "utils/fs/path.hpp"
+#include "utils/test_utils.ipp"
+
+namespace fs = utils::fs;
+
+
+namespace {
+
+
+/// File descriptor on which to write the replies to the requests.
+static const int replies_fileno = 3;
+
+
+/// A test case that validates the TEST_ENV_* variables.
+///
+/// \return The result of the test case.
+static std::string
+test_check_configuration_variables(void)
+{
+    std::set< std::string > vars;
+    char** iter;
+    for (iter = environ; *iter != NULL; ++iter) {
+        if (std::strstr(*iter, "TEST_ENV_") == *iter) {
+            vars.insert(*iter);
+        }
+    }
+
+    std::set< std::string > exp_vars;
+    exp_vars.insert("TEST_ENV_first=some value");
+    exp_vars.insert("TEST_ENV_second=some other value");
+    if (vars == exp_vars)
+        return "passed";
+    else
+        return F("failed: Expected %s but found %s") % exp_vars % vars;
+}
+
+
+/// A test case that crashes the whole server.
+///
+/// \return Nothing; this never returns.
+static std::string
+test_crash(void)
+{
+    utils::abort_without_coredump();
+}
+
+
+/// A test case that fails.
+///
+/// \return The result of the test case.
+static std::string
+test_fail(void)
+{
+    return "failed: This is the failure message";
+}
+
+
+/// A test case that reports a malformed result.
+///
+/// \return The result of the test case.
+static std::string
+test_invalid_result(void)
+{
+    return "this is not a result";
+}
+
+
+/// A test case that writes to stdout and stderr.
+///
+/// \return The result of the test case.
+static std::string
+test_output(void)
+{
+    std::cout << "Message to stdout\n";
+    std::cerr << "Message to stderr\n";
+    return "passed";
+}
+
+
+/// A test case that passes.
+///
+/// \return The result of the test case.
+static std::string
+test_pass(void)
+{
+    return "passed";
+}
+
+
+/// A test case that prints the PID of the server.
+///
+/// \return The result of the test case.
+static std::string
+test_pid(void)
+{
+    std::cout << ::getpid() << '\n';
+    return "passed";
+}
+
+
+/// A test case that is skipped.
+///
+/// \return The result of the test case.
+static std::string
+test_skip(void)
+{
+    return "skipped: Not for today";
+}
+
+
+/// A test case that times out.
+///
+/// \return The result of the test case.
+static std::string
+test_timeout(void)
+{
+    ::sleep(10);
+    return "passed";
+}
+
+
+/// A test case that checks that it runs in the requested work directory.
+///
+/// \param work_directory The work directory given in the request.
+///
+/// \return The result of the test case.
+static std::string
+test_work_directory(const std::string& work_directory)
+{
+    char buffer[1024];
+    if (::getcwd(buffer, sizeof(buffer)) == NULL)
+        return "broken: getcwd(3) failed";
+    if (fs::path(buffer) != fs::path(work_directory))
+        return F("failed: Running in %s instead of %s") % buffer %
+            work_directory;
+    return "passed";
+}
+
+
+/// Table of the test cases of this program.
+static const char* test_cases[] = {
+    "check_configuration_variables",
+    "crash",
+    "fail",
+    "invalid_result",
+    "output",
+    "pass",
+    "pid",
+    "skip",
+    "timeout",
+    "work_directory",
+    NULL,
+};
+
+
+/// Runs a single test case.
+///
+/// \param name The name of the test case to run.
+/// \param work_directory The directory in which to run the test case.
+///
+/// \return The result line to reply with.
+static std::string
+run_test_case(const std::string& name, const std::string& work_directory)
+{
+    if (::chdir(work_directory.c_str()) == -1)
+        return F("broken: Cannot enter %s") % work_directory;
+    ::setenv("HOME", work_directory.c_str(), 1);
+    ::setenv("TMPDIR", work_directory.c_str(), 1);
+
+    if (name == "check_configuration_variables")
+        return test_check_configuration_variables();
+    else if (name == "crash")
+        return test_crash();
+    else if (name == "fail")
+        return test_fail();
+    else if (name == "invalid_result")
+        return test_invalid_result();
+    else if (name == "output")
+        return test_output();
+    else if (name == "pass")
+        return test_pass();
+    else if (name == "pid")
+        return test_pid();
+    else if (name == "skip")
+        return test_skip();
+    else if (name == "timeout")
+        return test_timeout();
+    else if (name == "work_directory")
+        return test_work_directory(work_directory);
+    else
+        return F("broken: Unknown test case %s") % name;
+}
+
+
+/// Serves the requests received over stdin until it is closed.
+///
+/// \return An exit code.
+static int
+serve(void)
+{
+    std::string request;
+    while (std::getline(std::cin, request)) {
+        const std::string::size_type tab = request.find('\t');
+        if (tab == std::string::npos) {
+            std::cerr << "Invalid request: " << request << '\n';
+            return EXIT_FAILURE;
+        }
+
+        const std::string result = run_test_case(request.substr(0, tab),
+                                                 request.substr(tab + 1));
+        std::cout.flush();
+        std::cerr.flush();
+
+        const std::string reply = result + '\n';
+        if (::write(replies_fileno, reply.c_str(), reply.length()) !=
+            static_cast< ssize_t >(reply.length())) {
+            std::cerr << "Failed to write reply\n";
+            return EXIT_FAILURE;
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+
+}  // anonymous namespace
+
+
+/// Entry point to the test program.
+///
+/// \param argc The number of CLI arguments.
+/// \param argv The CLI arguments themselves.
+///
+/// \return An exit code.
+int
+main(int argc, char** argv)
+{
+    if (argc != 2) {
+        std::cerr << "Usage: " << argv[0] << " -l | -s\n";
+        return EXIT_FAILURE;
+    }
+
+    if (std::strcmp(argv[1], "-l") == 0) {
+        for (const char** iter = test_cases; *iter != NULL; ++iter)
+            std::cout << *iter << '\n';
+        return EXIT_SUCCESS;
+    } else if (std::strcmp(argv[1], "-s") == 0) {
+        return serve();
+    } else {
+        std::cerr << "Unknown option " << argv[1] << '\n';
+        return EXIT_FAILURE;
+    }
+}
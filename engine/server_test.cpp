@@ -0,0 +1,296 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "engine/server.hpp"
+
+extern "C" {
+#include <signal.h>
+}
+
+#include <atf-c++.hpp>
+
+#include "engine/config.hpp"
+#include "engine/scheduler.hpp"
+#include "model/metadata.hpp"
+#include "model/test_case.hpp"
+#include "model/test_program.hpp"
+#include "model/test_result.hpp"
+#include "utils/config/tree.ipp"
+#include "utils/datetime.hpp"
+#include "utils/format/containers.ipp"
+#include "utils/format/macros.hpp"
+#include "utils/fs/operations.hpp"
+#include "utils/fs/path.hpp"
+#include "utils/optional.ipp"
+#include "utils/stream.hpp"
+
+namespace config = utils::config;
+namespace datetime = utils::datetime;
+namespace fs = utils::fs;
+namespace scheduler = engine::scheduler;
+
+
+namespace {
+
+
+/// Test cases of the server helpers program.
+static const char* helper_test_cases[] = {
+    "check_configuration_variables",
+    "crash",
+    "fail",
+    "invalid_result",
+    "output",
+    "pass",
+    "pid",
+    "skip",
+    "timeout",
+    "work_directory",
+    NULL,
+};
+
+
+/// Creates a test program that points to the server helpers program.
+///
+/// \param tc Pointer to the calling test case, to obtain srcdir.
+/// \param metadata The metadata of all test cases.
+///
+/// \return The new test program.
+static model::test_program_ptr
+helpers_program(const atf::tests::tc* tc,
+                const model::metadata& metadata =
+                    model::metadata_builder().build())
+{
+    model::test_program_builder builder(
+        "server", fs::path("server_helpers"),
+        fs::path(tc->get_config_var("srcdir")), "the-suite");
+    for (const char** iter = helper_test_cases; *iter != NULL; ++iter)
+        builder.add_test_case(*iter, metadata);
+    return builder.build_ptr();
+}
+
+
+/// Runs one test case of the server helpers program and checks its result.
+///
+/// \param handle The scheduler in which to run the test case.
+/// \param program The test program returned by helpers_program().
+/// \param test_case_name Name of the test case to run.
+/// \param exp_result The expected result.
+/// \param user_config User-provided configuration variables.
+/// \param [out] stdout_contents If not NULL, receives the stdout of the test.
+/// \param [out] stderr_contents If not NULL, receives the stderr of the test.
+static void
+run_one(scheduler::scheduler_handle& handle,
+        const model::test_program_ptr program,
+        const char* test_case_name,
+        const model::test_result& exp_result,
+        const config::tree& user_config = engine::empty_config(),
+        std::string* stdout_contents = NULL,
+        std::string* stderr_contents = NULL)
+{
+    (void)handle.spawn_test(program, test_case_name, user_config);
+
+    scheduler::result_handle_ptr result_handle = handle.wait_any();
+    const scheduler::test_result_handle* test_result_handle =
+        dynamic_cast< const scheduler::test_result_handle* >(
+            result_handle.get());
+    atf::utils::cat_file(result_handle->stdout_file().str(), "stdout: ");
+    atf::utils::cat_file(result_handle->stderr_file().str(), "stderr: ");
+    if (stdout_contents != NULL)
+        *stdout_contents = utils::read_file(result_handle->stdout_file());
+    if (stderr_contents != NULL)
+        *stderr_contents = utils::read_file(result_handle->stderr_file());
+    ATF_REQUIRE_EQ(exp_result, test_result_handle->test_result());
+    result_handle->cleanup();
+}
+
+
+}  // anonymous namespace
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(list);
+ATF_TEST_CASE_BODY(list)
+{
+    const model::test_program program = model::test_program_builder(
+        "server", fs::path("server_helpers"),
+        fs::path(get_config_var("srcdir")), "the-suite").build();
+
+    scheduler::scheduler_handle handle = scheduler::setup();
+    const model::test_cases_map test_cases = handle.list_tests(
+        &program, engine::empty_config());
+    handle.cleanup();
+
+    ATF_REQUIRE_EQ(helpers_program(this)->test_cases(), test_cases);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(test__results);
+ATF_TEST_CASE_BODY(test__results)
+{
+    const model::test_program_ptr program = helpers_program(this);
+
+    scheduler::scheduler_handle handle = scheduler::setup();
+    run_one(handle, program, "pass",
+            model::test_result(model::test_result_passed));
+    run_one(handle, program, "fail",
+            model::test_result(model::test_result_failed,
+                               "This is the failure message"));
+    run_one(handle, program, "skip",
+            model::test_result(model::test_result_skipped, "Not for today"));
+    run_one(handle, program, "work_directory",
+            model::test_result(model::test_result_passed));
+    handle.cleanup();
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(test__invalid_result_is_broken);
+ATF_TEST_CASE_BODY(test__invalid_result_is_broken)
+{
+    scheduler::scheduler_handle handle = scheduler::setup();
+    run_one(handle, helpers_program(this), "invalid_result",
+            model::test_result(model::test_result_broken,
+                               "Invalid result reported by the test program: "
+                               "this is not a result"));
+    handle.cleanup();
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(test__output);
+ATF_TEST_CASE_BODY(test__output)
+{
+    const model::test_program_ptr program = helpers_program(this);
+
+    scheduler::scheduler_handle handle = scheduler::setup();
+    for (int i = 0; i < 2; ++i) {
+        std::string stdout_contents, stderr_contents;
+        run_one(handle, program, "output",
+                model::test_result(model::test_result_passed),
+                engine::empty_config(), &stdout_contents, &stderr_contents);
+        ATF_REQUIRE_EQ("Message to stdout\n", stdout_contents);
+        ATF_REQUIRE_EQ("Message to stderr\n", stderr_contents);
+    }
+    handle.cleanup();
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(test__server_is_reused);
+ATF_TEST_CASE_BODY(test__server_is_reused)
+{
+    const model::test_program_ptr program = helpers_program(this);
+    const model::test_result passed(model::test_result_passed);
+
+    scheduler::scheduler_handle handle = scheduler::setup();
+    std::string first_pid, second_pid;
+    run_one(handle, program, "pid", passed, engine::empty_config(),
+            &first_pid);
+    run_one(handle, program, "pass", passed);
+    run_one(handle, program, "pid", passed, engine::empty_config(),
+            &second_pid);
+    handle.cleanup();
+
+    ATF_REQUIRE(!first_pid.empty());
+    ATF_REQUIRE_EQ(first_pid, second_pid);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(test__crash_restarts_server);
+ATF_TEST_CASE_BODY(test__crash_restarts_server)
+{
+    const model::test_program_ptr program = helpers_program(this);
+    const model::test_result passed(model::test_result_passed);
+
+    scheduler::scheduler_handle handle = scheduler::setup();
+    std::string first_pid, second_pid;
+    run_one(handle, program, "pid", passed, engine::empty_config(),
+            &first_pid);
+    run_one(handle, program, "crash",
+            model::test_result(model::test_result_broken,
+                               "Test program server exited while running the "
+                               "test case"));
+    run_one(handle, program, "pid", passed, engine::empty_config(),
+            &second_pid);
+    handle.cleanup();
+
+    ATF_REQUIRE(!first_pid.empty());
+    ATF_REQUIRE(!second_pid.empty());
+    ATF_REQUIRE(first_pid != second_pid);
+}
+
+
+ATF_TEST_CASE(test__timeout_is_broken);
+ATF_TEST_CASE_HEAD(test__timeout_is_broken)
+{
+    set_md_var("timeout", "60");
+}
+ATF_TEST_CASE_BODY(test__timeout_is_broken)
+{
+    const model::test_program_ptr program = helpers_program(
+        this, model::metadata_builder()
+        .set_timeout(datetime::delta(1, 0)).build());
+
+    scheduler::scheduler_handle handle = scheduler::setup();
+    run_one(handle, program, "timeout",
+            model::test_result(model::test_result_broken,
+                               "Test case timed out"));
+    run_one(handle, program, "pass",
+            model::test_result(model::test_result_passed));
+    handle.cleanup();
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(test__configuration_variables);
+ATF_TEST_CASE_BODY(test__configuration_variables)
+{
+    config::tree user_config = engine::empty_config();
+    user_config.set_string("test_suites.a-suite.first", "unused");
+    user_config.set_string("test_suites.the-suite.first", "some value");
+    user_config.set_string("test_suites.the-suite.second", "some other value");
+    user_config.set_string("test_suites.other-suite.first", "unused");
+
+    scheduler::scheduler_handle handle = scheduler::setup();
+    run_one(handle, helpers_program(this), "check_configuration_variables",
+            model::test_result(model::test_result_passed), user_config);
+    handle.cleanup();
+}
+
+
+ATF_INIT_TEST_CASES(tcs)
+{
+    scheduler::register_interface(
+        "server", std::shared_ptr< scheduler::interface >(
+            new engine::server_interface()));
+
+    ATF_ADD_TEST_CASE(tcs, list);
+
+    ATF_ADD_TEST_CASE(tcs, test__results);
+    ATF_ADD_TEST_CASE(tcs, test__invalid_result_is_broken);
+    ATF_ADD_TEST_CASE(tcs, test__output);
+    ATF_ADD_TEST_CASE(tcs, test__server_is_reused);
+    ATF_ADD_TEST_CASE(tcs, test__crash_restarts_server);
+    ATF_ADD_TEST_CASE(tcs, test__timeout_is_broken);
+    ATF_ADD_TEST_CASE(tcs, test__configuration_variables);
+}
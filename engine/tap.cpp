@@ -33,6 +33,7 @@ extern "C" {
 }
 
 #include <cstdlib>
+#include <fstream>
 
 #include "engine/exceptions.hpp"
 #include "engine/tap_parser.hpp"
@@ -40,16 +41,17 @@ extern "C" {
 #include "model/test_program.hpp"
 #include "model/test_result.hpp"
 #include "utils/defs.hpp"
-#include "utils/env.hpp"
 #include "utils/format/macros.hpp"
 #include "utils/optional.ipp"
 #include "utils/process/operations.hpp"
 #include "utils/process/status.hpp"
 #include "utils/sanity.hpp"
+#include "utils/text/exceptions.hpp"
 
 namespace config = utils::config;
 namespace fs = utils::fs;
 namespace process = utils::process;
+namespace text = utils::text;
 
 using utils::optional;
 
@@ -97,9 +99,78 @@ tap_to_result(const engine::tap_summary& summary,
 }
 
 
+/// Feeds the valid prefix of the output of a test program to a TAP parser.
+///
+/// \param [in,out] parser The parser to feed.
+/// \param stdout_path Path to the file containing the stdout of the test.  A
+///     missing file or any invalid data in it just stops the parsing.
+static void
+consume_valid_output(engine::tap_parser& parser, const fs::path& stdout_path)
+{
+    std::ifstream input(stdout_path.str().c_str());
+    if (!input)
+        return;
+    try {
+        parser.consume(input);
+        // Processes any trailing line; the summary itself is not needed.
+        (void)parser.finish();
+    } catch (const engine::format_error& e) {
+        // Ignore; we only want the results seen until the bad data.
+    } catch (const text::error& e) {
+        // Ignore; we only want the results seen until the bad data.
+    }
+}
+
+
+/// Computes the reason of the result of a TAP test program that timed out.
+///
+/// The output of the test program is parsed up to the point where it was
+/// killed so that the progress made before the timeout can be reported.
+///
+/// \param stdout_path Path to the file containing the stdout of the test.
+///
+/// \return The reason for the broken result.
+static std::string
+timeout_reason(const fs::path& stdout_path)
+{
+    engine::tap_parser parser;
+    consume_valid_output(parser, stdout_path);
+
+    const std::size_t count = parser.ok_count() + parser.not_ok_count();
+    if (count == 0) {
+        return "Test case timed out";
+    } else if (parser.plan() &&
+               parser.plan().get() != engine::all_skipped_plan) {
+        const engine::tap_plan& plan = parser.plan().get();
+        return F("Test case timed out after %s of %s tests (%s failed)") %
+            count % (plan.second - plan.first + 1) % parser.not_ok_count();
+    } else {
+        return F("Test case timed out after %s tests (%s failed)") %
+            count % parser.not_ok_count();
+    }
+}
+
+
 }  // anonymous namespace
 
 
+/// Computes the test cases list of a test program without executing it.
+///
+/// TAP test programs always expose a single test case named "main", so
+/// there is no need to spawn them to find out.
+///
+/// \param unused_test_program The test program to list.
+///
+/// \return A list of test cases.
+optional< model::test_cases_map >
+engine::tap_interface::static_list(
+    const model::test_program& UTILS_UNUSED_PARAM(test_program)) const
+{
+    return utils::make_optional(
+        model::test_cases_map_builder().add("main").build());
+}
+
+
 /// Executes a test program's list operation.
 ///
 /// This method is intended to be called within a subprocess and is expected
@@ -137,6 +208,26 @@ engine::tap_interface::parse_list(
 }
 
 
+/// Describes how to execute the test cases of a test program.
+///
+/// \param test_program The test program to execute.
+/// \param vars User-provided variables to pass to the test program.
+///
+/// \return The execution plan of the test program, which is always available.
+optional< engine::scheduler::exec_plan >
+engine::tap_interface::plan_test(
+    const model::test_program& test_program,
+    const utils::config::properties_map& vars) const
+{
+    scheduler::exec_plan plan(test_program.absolute_path());
+    for (utils::config::properties_map::const_iterator iter = vars.begin();
+         iter != vars.end(); ++iter) {
+        plan.environment[F("TEST_ENV_%s") % (*iter).first] = (*iter).second;
+    }
+    return utils::make_optional(plan);
+}
+
+
 /// Executes a test case of the test program.
 ///
 /// This method is intended to be called within a subprocess and is expected
@@ -157,13 +248,7 @@ engine::tap_interface::exec_test(
 {
     PRE(test_case_name == "main");
 
-    for (utils::config::properties_map::const_iterator iter = vars.begin();
-         iter != vars.end(); ++iter) {
-        utils::setenv(F("TEST_ENV_%s") % (*iter).first, (*iter).second);
-    }
-
-    process::args_vector args;
-    process::exec(test_program.absolute_path(), args);
+    plan_test(test_program, vars).get().exec(process::args_vector());
 }
 
 
@@ -187,7 +272,7 @@ engine::tap_interface::compute_result(
 {
     if (!status) {
         return model::test_result(model::test_result_broken,
-                                  "Test case timed out");
+                                  timeout_reason(stdout_path));
     } else {
         if (status.get().signaled()) {
             return model::test_result(
@@ -205,3 +290,19 @@ engine::tap_interface::compute_result(
         }
     }
 }
+
+
+/// Computes the results of the individual test points of a test case.
+///
+/// \param stdout_path Path to the file containing the stdout of the test.
+///
+/// \return One result per TAP test point found in the output before any bail
+/// out, timeout or invalid data.
+std::vector< model::test_result >
+engine::tap_interface::compute_sub_results(const fs::path& stdout_path) const
+{
+    std::vector< model::test_result > results;
+    engine::tap_parser parser(&results);
+    consume_valid_output(parser, stdout_path);
+    return results;
+}
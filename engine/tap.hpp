@@ -40,6 +40,9 @@ namespace engine {
 /// Implementation of the scheduler interface for tap test programs.
 class tap_interface : public engine::scheduler::interface {
 public:
+    utils::optional< model::test_cases_map > static_list(
+        const model::test_program&) const;
+
     void exec_list(const model::test_program&,
                    const utils::config::properties_map&) const UTILS_NORETURN;
 
@@ -48,6 +51,10 @@ public:
         const utils::fs::path&,
         const utils::fs::path&) const;
 
+    utils::optional< engine::scheduler::exec_plan > plan_test(
+        const model::test_program&,
+        const utils::config::properties_map&) const;
+
     void exec_test(const model::test_program&, const std::string&,
                    const utils::config::properties_map&,
                    const utils::fs::path&) const
@@ -58,6 +65,9 @@ public:
         const utils::fs::path&,
         const utils::fs::path&,
         const utils::fs::path&) const;
+
+    std::vector< model::test_result > compute_sub_results(
+        const utils::fs::path&) const;
 };
 
 
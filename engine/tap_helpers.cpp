@@ -142,7 +142,7 @@ static void
 test_timeout(void)
 {
     std::cout << "1..2\n"
-              << "ok 1\n";
+              << "ok 1\n" << std::flush;
 
     ::sleep(10);
     const fs::path control_dir = fs::path(utils::getenv("CONTROL_DIR").get());
@@ -28,16 +28,18 @@
 
 #include "engine/tap_parser.hpp"
 
+#include <cctype>
+#include <cstring>
 #include <fstream>
+#include <vector>
 
 #include "engine/exceptions.hpp"
+#include "model/test_result.hpp"
 #include "utils/format/macros.hpp"
-#include "utils/noncopyable.hpp"
 #include "utils/optional.ipp"
 #include "utils/sanity.hpp"
 #include "utils/text/exceptions.hpp"
 #include "utils/text/operations.ipp"
-#include "utils/text/regex.hpp"
 
 namespace fs = utils::fs;
 namespace text = utils::text;
@@ -52,181 +54,144 @@ const engine::tap_plan engine::all_skipped_plan(1, 0);
 namespace {
 
 
-/// Implementation of the TAP parser.
-///
-/// This is a class only to simplify keeping global constant values around (like
-/// prebuilt regular expressions).
-class tap_parser : utils::noncopyable {
-    /// Regular expression to match plan lines.
-    text::regex _plan_regex;
-
-    /// Regular expression to match a TODO and extract the reason.
-    text::regex _todo_regex;
-
-    /// Regular expression to match a SKIP and extract the reason.
-    text::regex _skip_regex;
-
-    /// Regular expression to match a single test result.
-    text::regex _result_regex;
-
-    /// Checks if a line contains a TAP plan and extracts its data.
-    ///
-    /// \param line The line to try to parse.
-    /// \param [in,out] out_plan Used to store the found plan, if any.  The same
-    ///     output variable should be given to all calls to this function so
-    ///     that duplicate plan entries can be discovered.
-    /// \param [out] out_all_skipped_reason Used to store the reason for all
-    ///     tests being skipped, if any.  If this is set to a non-empty value,
-    ///     then the out_plan is set to 1..0.
-    ///
-    /// \return True if the line matched a plan; false otherwise.
-    ///
-    /// \throw engine::format_error If the input is invalid.
-    /// \throw text::error If the input is invalid.
-    bool
-    try_parse_plan(const std::string& line,
-                   optional< engine::tap_plan >& out_plan,
-                   std::string& out_all_skipped_reason)
-    {
-        const text::regex_matches plan_matches = _plan_regex.match(line);
-        if (!plan_matches)
-            return false;
-        const engine::tap_plan plan(
-            text::to_type< std::size_t >(plan_matches.get(1)),
-            text::to_type< std::size_t >(plan_matches.get(2)));
-
-        if (out_plan)
-            throw engine::format_error(
-                F("Found duplicate plan %s..%s (saw %s..%s earlier)") %
-                plan.first % plan.second %
-                out_plan.get().first % out_plan.get().second);
-
-        std::string all_skipped_reason;
-        const text::regex_matches skip_matches = _skip_regex.match(line);
-        if (skip_matches) {
-            if (plan != engine::all_skipped_plan) {
-                throw engine::format_error(F("Skipped plan must be %s..%s") %
-                                           engine::all_skipped_plan.first %
-                                           engine::all_skipped_plan.second);
-            }
-            all_skipped_reason = skip_matches.get(2);
-            if (all_skipped_reason.empty())
-                all_skipped_reason = "No reason specified";
-        } else {
-            if (plan.first > plan.second)
-                throw engine::format_error(F("Found reversed plan %s..%s") %
-                                           plan.first % plan.second);
-        }
+/// Size of the chunks in which to read the TAP output.
+const std::size_t read_chunk_size = 64 * 1024;
 
-        INV(!out_plan);
-        out_plan = plan;
-        out_all_skipped_reason = all_skipped_reason;
 
-        POST(out_plan);
-        POST(out_all_skipped_reason.empty() ||
-             out_plan.get() == engine::all_skipped_plan);
+/// Checks if a string starts with a given prefix.
+///
+/// \param line The string to check.
+/// \param prefix The prefix to look for.
+///
+/// \return True if line starts with prefix; false otherwise.
+static bool
+starts_with(const std::string& line, const char* prefix)
+{
+    return line.compare(0, std::strlen(prefix), prefix) == 0;
+}
 
-        return true;
-    }
 
-    /// Checks if a line contains a TAP test result and extracts its data.
-    ///
-    /// \param line The line to try to parse.
-    /// \param [in,out] out_ok_count Accumulator for 'ok' results.
-    /// \param [in,out] out_not_ok_count Accumulator for 'not ok' results.
-    /// \param [out] out_bailed_out Set to true if the test bailed out.
-    ///
-    /// \return True if the line matched a result; false otherwise.
-    ///
-    /// \throw engine::format_error If the input is invalid.
-    /// \throw text::error If the input is invalid.
-    bool
-    try_parse_result(const std::string& line, std::size_t& out_ok_count,
-                     std::size_t& out_not_ok_count, bool& out_bailed_out)
-    {
-        PRE(!out_bailed_out);
-
-        const text::regex_matches result_matches = _result_regex.match(line);
-        if (result_matches) {
-            if (result_matches.get(1) == "ok") {
-                ++out_ok_count;
-            } else {
-                INV(result_matches.get(1) == "not ok");
-                if (_todo_regex.match(line) || _skip_regex.match(line)) {
-                    ++out_ok_count;
-                } else {
-                    ++out_not_ok_count;
-                }
-            }
-            return true;
-        } else {
-            if (line.find("Bail out!") == 0) {
-                out_bailed_out = true;
-                return true;
-            } else {
-                return false;
-            }
-        }
-    }
+/// Checks if a character separates a test result from its number.
+///
+/// \param ch The character to check.
+///
+/// \return True if ch is a space, a tab or a dash.
+static bool
+is_result_separator(const char ch)
+{
+    return ch == ' ' || ch == '\t' || ch == '-';
+}
 
-public:
-    /// Sets up the TAP parser state.
-    tap_parser(void) :
-        _plan_regex(text::regex::compile("^([0-9]+)\\.\\.([0-9]+)", 2)),
-        _todo_regex(text::regex::compile("TODO[ \t]*(.*)$", 2, true)),
-        _skip_regex(text::regex::compile("(SKIP|Skipped:?)[ \t]*(.*)$", 2,
-                                         true)),
-        _result_regex(text::regex::compile("^(not ok|ok)[ \t-]+[0-9]*", 1))
-    {
+
+/// Locates the first case-insensitive occurrence of a word in a line.
+///
+/// \param line The line in which to look for the word.
+/// \param word The word to look for.  Must be in lowercase.
+/// \param start Position of the line at which to start looking.
+///
+/// \return The position of the word, or std::string::npos if not found.
+static std::string::size_type
+find_nocase(const std::string& line, const char* word,
+            const std::string::size_type start = 0)
+{
+    const std::size_t length = std::strlen(word);
+    for (std::string::size_type pos = start; pos + length <= line.length();
+         ++pos) {
+        std::size_t i = 0;
+        while (i < length && std::tolower(
+                   static_cast< unsigned char >(line[pos + i])) == word[i])
+            ++i;
+        if (i == length)
+            return pos;
     }
+    return std::string::npos;
+}
 
-    /// Parses an input file containing TAP output.
-    ///
-    /// \param input The stream to read from.
-    ///
-    /// \return The results of the parsing in the form of a tap_summary object.
-    ///
-    /// \throw engine::format_error If there are any syntax errors in the input.
-    /// \throw text::error If there are any syntax errors in the input.
-    engine::tap_summary
-    parse(std::ifstream& input)
-    {
-        optional< engine::tap_plan > plan;
-        std::string all_skipped_reason;
-        bool bailed_out = false;
-        std::size_t ok_count = 0, not_ok_count = 0;
 
-        std::string line;
-        while (!bailed_out && std::getline(input, line)) {
-            if (try_parse_result(line, ok_count, not_ok_count, bailed_out))
-                continue;
-            (void)try_parse_plan(line, plan, all_skipped_reason);
-        }
+/// Extracts the reason of a directive from the rest of its line.
+///
+/// \param line The line containing the directive.
+/// \param pos Position right after the directive keyword.
+///
+/// \return The text after pos with any leading whitespace removed.
+static std::string
+directive_reason(const std::string& line, std::string::size_type pos)
+{
+    while (pos < line.length() && (line[pos] == ' ' || line[pos] == '\t'))
+        ++pos;
+    return line.substr(pos);
+}
 
-        if (bailed_out) {
-            return engine::tap_summary::new_bailed_out();
-        } else {
-            if (!plan)
-                throw engine::format_error(
-                    "Output did not contain any TAP plan and the program did "
-                    "not bail out");
-
-            if (plan.get() == engine::all_skipped_plan) {
-                return engine::tap_summary::new_all_skipped(all_skipped_reason);
-            } else {
-                const std::size_t exp_count = plan.get().second -
-                    plan.get().first + 1;
-                const std::size_t actual_count = ok_count + not_ok_count;
-                if (exp_count != actual_count) {
-                    throw engine::format_error(
-                        "Reported plan differs from actual executed tests");
-                }
-                return engine::tap_summary::new_results(plan.get(), ok_count,
-                                                        not_ok_count);
-            }
-        }
+
+/// Looks for a TODO directive in a line.
+///
+/// \param line The line to check.
+///
+/// \return True if the line contains a TODO anywhere; false otherwise.
+static bool
+has_todo(const std::string& line)
+{
+    return find_nocase(line, "todo") != std::string::npos;
+}
+
+
+/// Looks for a SKIP directive in a line and extracts its reason.
+///
+/// The directive can be spelled as "SKIP", "Skipped" or "Skipped:", in any
+/// case, and the reason is the remainder of the line.
+///
+/// \param line The line to check.
+/// \param [out] out_reason Set to the reason of the directive, if found.
+///
+/// \return True if the line contains a SKIP anywhere; false otherwise.
+static bool
+find_skip(const std::string& line, std::string& out_reason)
+{
+    std::string::size_type pos = find_nocase(line, "skip");
+    if (pos == std::string::npos)
+        return false;
+    pos += 4;
+    if (find_nocase(line, "ped", pos) == pos) {
+        pos += 3;
+        if (pos < line.length() && line[pos] == ':')
+            ++pos;
     }
-};
+    out_reason = directive_reason(line, pos);
+    return true;
+}
+
+
+/// Extracts the description of a test point.
+///
+/// \param line The line containing the test point.
+/// \param pos Position right after the "ok" or "not ok" keyword.
+///
+/// \return The text after the keyword with any leading separators removed,
+/// which includes the number of the test point if any.
+static std::string
+point_description(const std::string& line, std::string::size_type pos)
+{
+    while (pos < line.length() && is_result_separator(line[pos]))
+        ++pos;
+    return line.substr(pos);
+}
+
+
+/// Extracts a run of digits from a line.
+///
+/// \param line The line to parse.
+/// \param [in,out] pos Position at which the digits start.  Updated to point
+///     to the first character after them.
+///
+/// \return The digits found, which may be empty.
+static std::string
+scan_digits(const std::string& line, std::string::size_type& pos)
+{
+    const std::string::size_type start = pos;
+    while (pos < line.length() && line[pos] >= '0' && line[pos] <= '9')
+        ++pos;
+    return line.substr(start, pos - start);
+}
 
 
 }  // anonymous namespace
@@ -413,6 +378,272 @@ engine::operator<<(std::ostream& output, const tap_summary& summary)
 }
 
 
+/// Sets up the TAP parser state.
+///
+/// \param results If not NULL, collection to which to append a test result
+///     for every test point found in the input, in the order in which they
+///     appear.  The reason of each result is the description of its point.
+engine::tap_parser::tap_parser(std::vector< model::test_result >* results) :
+    _bailed_out(false), _ok_count(0), _not_ok_count(0), _results(results)
+{
+}
+
+
+/// Checks if a line contains a TAP plan and extracts its data.
+///
+/// A plan line starts with "N..M".  If it contains a SKIP directive, then the
+/// plan must be 1..0 and the rest of the line is the reason for skipping all
+/// tests.
+///
+/// \param line The line to try to parse.
+///
+/// \return True if the line matched a plan; false otherwise.
+///
+/// \throw engine::format_error If the input is invalid.
+/// \throw text::error If the input is invalid.
+bool
+engine::tap_parser::try_parse_plan(const std::string& line)
+{
+    std::string::size_type pos = 0;
+    const std::string first = scan_digits(line, pos);
+    if (first.empty() || line.compare(pos, 2, "..") != 0)
+        return false;
+    pos += 2;
+    const std::string second = scan_digits(line, pos);
+    if (second.empty())
+        return false;
+
+    const engine::tap_plan plan(text::to_type< std::size_t >(first),
+                                text::to_type< std::size_t >(second));
+
+    if (_plan)
+        throw engine::format_error(
+            F("Found duplicate plan %s..%s (saw %s..%s earlier)") %
+            plan.first % plan.second %
+            _plan.get().first % _plan.get().second);
+
+    std::string all_skipped_reason;
+    if (find_skip(line, all_skipped_reason)) {
+        if (plan != engine::all_skipped_plan) {
+            throw engine::format_error(F("Skipped plan must be %s..%s") %
+                                       engine::all_skipped_plan.first %
+                                       engine::all_skipped_plan.second);
+        }
+        if (all_skipped_reason.empty())
+            all_skipped_reason = "No reason specified";
+    } else {
+        if (plan.first > plan.second)
+            throw engine::format_error(F("Found reversed plan %s..%s") %
+                                       plan.first % plan.second);
+    }
+
+    INV(!_plan);
+    _plan = plan;
+    _all_skipped_reason = all_skipped_reason;
+
+    POST(_plan);
+    POST(_all_skipped_reason.empty() ||
+         _plan.get() == engine::all_skipped_plan);
+
+    return true;
+}
+
+
+/// Checks if a line contains a TAP test result and extracts its data.
+///
+/// A result line starts with "ok" or "not ok" followed by a space, a tab or a
+/// dash.  'not ok' results carrying a TODO or SKIP directive count as 'ok'.
+///
+/// \param line The line to try to parse.
+///
+/// \return True if the line matched a result or a bail out; false otherwise.
+bool
+engine::tap_parser::try_parse_result(const std::string& line)
+{
+    PRE(!_bailed_out);
+
+    if (starts_with(line, "ok") && line.length() > 2 &&
+        is_result_separator(line[2])) {
+        ++_ok_count;
+        if (_results != NULL)
+            _results->push_back(model::test_result(
+                model::test_result_passed, point_description(line, 2)));
+        return true;
+    } else if (starts_with(line, "not ok") && line.length() > 6 &&
+               is_result_separator(line[6])) {
+        std::string unused_reason;
+        model::test_result_type type;
+        if (has_todo(line)) {
+            ++_ok_count;
+            type = model::test_result_expected_failure;
+        } else if (find_skip(line, unused_reason)) {
+            ++_ok_count;
+            type = model::test_result_skipped;
+        } else {
+            ++_not_ok_count;
+            type = model::test_result_failed;
+        }
+        if (_results != NULL)
+            _results->push_back(model::test_result(
+                type, point_description(line, 6)));
+        return true;
+    } else if (starts_with(line, "Bail out!")) {
+        _bailed_out = true;
+        return true;
+    } else {
+        return false;
+    }
+}
+
+
+/// Processes a single line of TAP output.
+///
+/// \param line The line to process, without its trailing newline.
+///
+/// \throw engine::format_error If the input is invalid.
+/// \throw text::error If the input is invalid.
+void
+engine::tap_parser::parse_line(const std::string& line)
+{
+    PRE(!_bailed_out);
+
+    if (try_parse_result(line))
+        return;
+    (void)try_parse_plan(line);
+}
+
+
+/// Processes a chunk of TAP output.
+///
+/// The chunk need not be aligned to line boundaries: any trailing fragment is
+/// kept until the rest of its line arrives or until finish() is called.  Any
+/// input after a bail out is ignored.
+///
+/// \param data Pointer to the chunk to process.
+/// \param length Length of the chunk.
+///
+/// \throw engine::format_error If the input is invalid.
+/// \throw text::error If the input is invalid.
+void
+engine::tap_parser::feed(const char* data, const std::size_t length)
+{
+    std::size_t start = 0;
+    while (!_bailed_out && start < length) {
+        const char* newline = static_cast< const char* >(
+            std::memchr(data + start, '\n', length - start));
+        if (newline == NULL) {
+            _partial_line.append(data + start, length - start);
+            break;
+        }
+
+        const std::size_t end = newline - data;
+        _partial_line.append(data + start, end - start);
+        std::string line;
+        line.swap(_partial_line);
+        parse_line(line);
+        start = end + 1;
+    }
+}
+
+
+/// Processes all the TAP output available in a stream.
+///
+/// \param input The stream to read from.  Reading stops early if the test
+///     program bailed out.
+///
+/// \throw engine::format_error If the input is invalid.
+/// \throw text::error If the input is invalid.
+void
+engine::tap_parser::consume(std::istream& input)
+{
+    std::vector< char > buffer(read_chunk_size);
+    while (!_bailed_out && input) {
+        input.read(&buffer[0], buffer.size());
+        feed(&buffer[0], static_cast< std::size_t >(input.gcount()));
+    }
+}
+
+
+/// Terminates the parsing and computes the summary of the TAP output.
+///
+/// \return The results of the parsing in the form of a tap_summary object.
+///
+/// \throw engine::format_error If there are any syntax errors in the input.
+/// \throw text::error If there are any syntax errors in the input.
+engine::tap_summary
+engine::tap_parser::finish(void)
+{
+    if (!_bailed_out && !_partial_line.empty()) {
+        std::string line;
+        line.swap(_partial_line);
+        parse_line(line);
+    }
+
+    if (_bailed_out) {
+        return engine::tap_summary::new_bailed_out();
+    } else {
+        if (!_plan)
+            throw engine::format_error(
+                "Output did not contain any TAP plan and the program did "
+                "not bail out");
+
+        if (_plan.get() == engine::all_skipped_plan) {
+            return engine::tap_summary::new_all_skipped(_all_skipped_reason);
+        } else {
+            const std::size_t exp_count = _plan.get().second -
+                _plan.get().first + 1;
+            const std::size_t actual_count = _ok_count + _not_ok_count;
+            if (exp_count != actual_count) {
+                throw engine::format_error(
+                    "Reported plan differs from actual executed tests");
+            }
+            return engine::tap_summary::new_results(_plan.get(), _ok_count,
+                                                    _not_ok_count);
+        }
+    }
+}
+
+
+/// Checks whether the test program has bailed out.
+///
+/// \return True if a bail out has been seen so far.
+bool
+engine::tap_parser::bailed_out(void) const
+{
+    return _bailed_out;
+}
+
+
+/// Gets the TAP plan, if already seen.
+///
+/// \return The TAP plan or none.
+const optional< engine::tap_plan >&
+engine::tap_parser::plan(void) const
+{
+    return _plan;
+}
+
+
+/// Gets the number of 'ok' test results seen so far.
+///
+/// \return A count of test results.
+std::size_t
+engine::tap_parser::ok_count(void) const
+{
+    return _ok_count;
+}
+
+
+/// Gets the number of 'not ok' test results seen so far.
+///
+/// \return A count of test results.
+std::size_t
+engine::tap_parser::not_ok_count(void) const
+{
+    return _not_ok_count;
+}
+
+
 /// Parses an input file containing the TAP output of a test program.
 ///
 /// \param filename Path to the file to parse.
@@ -429,7 +660,9 @@ engine::parse_tap_output(const utils::fs::path& filename)
         throw engine::load_error(filename, "Failed to open TAP output file");
 
     try {
-        return tap_summary(tap_parser().parse(input));
+        tap_parser parser;
+        parser.consume(input);
+        return parser.finish();
     } catch (const engine::format_error& e) {
         throw engine::load_error(filename, e.what());
     } catch (const text::error& e) {
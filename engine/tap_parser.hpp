@@ -35,10 +35,14 @@
 #include "engine/tap_parser_fwd.hpp"
 
 #include <cstddef>
+#include <istream>
 #include <ostream>
 #include <string>
+#include <vector>
 
+#include "model/test_result_fwd.hpp"
 #include "utils/fs/path_fwd.hpp"
+#include "utils/optional.hpp"
 
 namespace engine {
 
@@ -90,6 +94,51 @@ public:
 std::ostream& operator<<(std::ostream&, const tap_summary&);
 
 
+/// Incremental parser of TAP output.
+///
+/// The parser consumes the output of a test program in chunks of arbitrary
+/// size, so it can process the output while it is being produced and so that
+/// the results seen so far are available even if the output is incomplete.
+class tap_parser {
+    /// The TAP plan, if already found.
+    utils::optional< tap_plan > _plan;
+
+    /// If not empty, the reason why all tests were skipped.
+    std::string _all_skipped_reason;
+
+    /// Whether the test program bailed out or not.
+    bool _bailed_out;
+
+    /// Number of 'ok' test results seen so far.
+    std::size_t _ok_count;
+
+    /// Number of 'not ok' test results seen so far.
+    std::size_t _not_ok_count;
+
+    /// Trailing fragment of the input not yet terminated by a newline.
+    std::string _partial_line;
+
+    /// If not NULL, collection to which to append every test result seen.
+    std::vector< model::test_result >* _results;
+
+    bool try_parse_plan(const std::string&);
+    bool try_parse_result(const std::string&);
+    void parse_line(const std::string&);
+
+public:
+    explicit tap_parser(std::vector< model::test_result >* = NULL);
+
+    void feed(const char*, const std::size_t);
+    void consume(std::istream&);
+    tap_summary finish(void);
+
+    bool bailed_out(void) const;
+    const utils::optional< tap_plan >& plan(void) const;
+    std::size_t ok_count(void) const;
+    std::size_t not_ok_count(void) const;
+};
+
+
 tap_summary parse_tap_output(const utils::fs::path&);
 
 
@@ -0,0 +1,84 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// \file engine/tap_parser_bench.cpp
+/// Benchmarks for the parser of the TAP output.
+
+#include "engine/tap_parser.hpp"
+
+#include <cstddef>
+#include <fstream>
+
+#include <atf-c++.hpp>
+
+#include "utils/datetime.hpp"
+#include "utils/fs/path.hpp"
+#include "utils/test_utils.ipp"
+
+namespace datetime = utils::datetime;
+namespace fs = utils::fs;
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(parse_tap_output__many_results);
+ATF_TEST_CASE_BODY(parse_tap_output__many_results)
+{
+    utils::require_run_benchmarks(this);
+    const std::size_t iterations = utils::benchmark_iterations(this, 1000);
+
+    const std::size_t results = 1000;
+    {
+        std::ofstream output("tap.txt");
+        ATF_REQUIRE(output);
+        output << "1.." << results << "\n";
+        for (std::size_t i = 1; i <= results; ++i) {
+            if (i % 10 == 0)
+                output << "not ok " << i << " - failed check\n"
+                       << "# Some diagnostic message\n";
+            else
+                output << "ok " << i << " - passed check\n";
+        }
+    }
+
+    std::size_t failed = 0;
+    const datetime::timestamp start = datetime::timestamp::now();
+    for (std::size_t i = 0; i < iterations; ++i) {
+        const engine::tap_summary summary = engine::parse_tap_output(
+            fs::path("tap.txt"));
+        failed += summary.not_ok_count();
+    }
+    utils::report_benchmark(this, iterations,
+                            datetime::timestamp::now() - start);
+
+    ATF_REQUIRE_EQ(iterations * results / 10, failed);
+}
+
+
+ATF_INIT_TEST_CASES(tcs)
+{
+    ATF_ADD_TEST_CASE(tcs, parse_tap_output__many_results);
+}
@@ -28,6 +28,7 @@
 
 #include "engine/tap_parser.hpp"
 
+#include <cstring>
 #include <fstream>
 
 #include <atf-c++.hpp>
@@ -36,6 +37,7 @@
 #include "utils/format/containers.ipp"
 #include "utils/format/macros.hpp"
 #include "utils/fs/path.hpp"
+#include "utils/optional.ipp"
 
 namespace fs = utils::fs;
 
@@ -43,6 +45,17 @@ namespace fs = utils::fs;
 namespace {
 
 
+/// Feeds a C string to a TAP parser.
+///
+/// \param parser The parser to feed.
+/// \param data The text to pass to the parser.
+static void
+feed(engine::tap_parser& parser, const char* data)
+{
+    parser.feed(data, std::strlen(data));
+}
+
+
 /// Helper to execute parse_tap_output() on inline text contents.
 ///
 /// \param contents The TAP output to parse.
@@ -428,6 +441,18 @@ ATF_TEST_CASE_BODY(parse_tap_output__bail_out_wins_over_no_plan)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(parse_tap_output__skip_all_reason_variants);
+ATF_TEST_CASE_BODY(parse_tap_output__skip_all_reason_variants)
+{
+    ATF_REQUIRE_EQ(engine::tap_summary::new_all_skipped("Some reason"),
+                   do_parse("1..0 # Skipped: Some reason\n"));
+    ATF_REQUIRE_EQ(engine::tap_summary::new_all_skipped("Some reason"),
+                   do_parse("1..0 # skipped \tSome reason\n"));
+    ATF_REQUIRE_EQ(engine::tap_summary::new_all_skipped("Some reason"),
+                   do_parse("1..0 # skip Some reason"));
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(parse_tap_output__open_failure);
 ATF_TEST_CASE_BODY(parse_tap_output__open_failure)
 {
@@ -436,6 +461,55 @@ ATF_TEST_CASE_BODY(parse_tap_output__open_failure)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(tap_parser__split_lines);
+ATF_TEST_CASE_BODY(tap_parser__split_lines)
+{
+    engine::tap_parser parser;
+    feed(parser, "1.");
+    feed(parser, ".3\nok 1\nnot");
+    feed(parser, " ok 2 - ");
+    feed(parser, "failed\n");
+    feed(parser, "ok 3");
+
+    const engine::tap_summary exp_summary =
+        engine::tap_summary::new_results(engine::tap_plan(1, 3), 2, 1);
+    ATF_REQUIRE_EQ(exp_summary, parser.finish());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(tap_parser__progress);
+ATF_TEST_CASE_BODY(tap_parser__progress)
+{
+    engine::tap_parser parser;
+    ATF_REQUIRE(!parser.plan());
+    ATF_REQUIRE_EQ(0, parser.ok_count());
+    ATF_REQUIRE_EQ(0, parser.not_ok_count());
+
+    feed(parser, "1..5\nok 1\nnot ok 2\nok 3 # partial li");
+    ATF_REQUIRE(parser.plan());
+    ATF_REQUIRE_EQ(engine::tap_plan(1, 5), parser.plan().get());
+    ATF_REQUIRE_EQ(1, parser.ok_count());
+    ATF_REQUIRE_EQ(1, parser.not_ok_count());
+    ATF_REQUIRE(!parser.bailed_out());
+
+    ATF_REQUIRE_THROW_RE(engine::format_error, "plan differs",
+                         parser.finish());
+    ATF_REQUIRE_EQ(2, parser.ok_count());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(tap_parser__ignore_after_bail_out);
+ATF_TEST_CASE_BODY(tap_parser__ignore_after_bail_out)
+{
+    engine::tap_parser parser;
+    feed(parser, "ok 1\nBail out! Broken\n1..1\n1..1\nok 2\n");
+    ATF_REQUIRE(parser.bailed_out());
+    ATF_REQUIRE(!parser.plan());
+    ATF_REQUIRE_EQ(1, parser.ok_count());
+    ATF_REQUIRE_EQ(engine::tap_summary::new_bailed_out(), parser.finish());
+}
+
+
 ATF_INIT_TEST_CASES(tcs)
 {
     ATF_ADD_TEST_CASE(tcs, tap_summary__bailed_out);
@@ -461,5 +535,10 @@ ATF_INIT_TEST_CASES(tcs)
     ATF_ADD_TEST_CASE(tcs, parse_tap_output__reversed_plan);
     ATF_ADD_TEST_CASE(tcs, parse_tap_output__bail_out);
     ATF_ADD_TEST_CASE(tcs, parse_tap_output__bail_out_wins_over_no_plan);
+    ATF_ADD_TEST_CASE(tcs, parse_tap_output__skip_all_reason_variants);
     ATF_ADD_TEST_CASE(tcs, parse_tap_output__open_failure);
+
+    ATF_ADD_TEST_CASE(tcs, tap_parser__split_lines);
+    ATF_ADD_TEST_CASE(tcs, tap_parser__progress);
+    ATF_ADD_TEST_CASE(tcs, tap_parser__ignore_after_bail_out);
 }
@@ -32,6 +32,8 @@ extern "C" {
 #include <signal.h>
 }
 
+#include <vector>
+
 #include <atf-c++.hpp>
 
 #include "engine/config.hpp"
@@ -55,6 +57,7 @@ namespace fs = utils::fs;
 namespace scheduler = engine::scheduler;
 
 using utils::none;
+using utils::optional;
 
 
 namespace {
@@ -112,6 +115,22 @@ run_one(const atf::tests::tc* tc, const char* test_case_name,
 }  // anonymous namespace
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(static_list);
+ATF_TEST_CASE_BODY(static_list)
+{
+    const model::test_program program = model::test_program_builder(
+        "tap", fs::path("non-existent"), fs::path("."), "unused-suite")
+        .build();
+
+    const optional< model::test_cases_map > test_cases =
+        engine::tap_interface().static_list(program);
+    ATF_REQUIRE(test_cases);
+    const model::test_cases_map exp_test_cases = model::test_cases_map_builder()
+        .add("main").build();
+    ATF_REQUIRE_EQ(exp_test_cases, test_cases.get());
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(list);
 ATF_TEST_CASE_BODY(list)
 {
@@ -178,8 +197,9 @@ ATF_TEST_CASE_BODY(test__timeout_is_broken)
 
     const model::metadata metadata = model::metadata_builder()
         .set_timeout(datetime::delta(1, 0)).build();
-    const model::test_result exp_result(model::test_result_broken,
-                                        "Test case timed out");
+    const model::test_result exp_result(
+        model::test_result_broken,
+        "Test case timed out after 1 of 2 tests (0 failed)");
     run_one(this, "timeout", exp_result, metadata);
 
     ATF_REQUIRE(!atf::utils::file_exists("cookie"));
@@ -201,12 +221,58 @@ ATF_TEST_CASE_BODY(test__configuration_variables)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(compute_sub_results__some);
+ATF_TEST_CASE_BODY(compute_sub_results__some)
+{
+    atf::utils::create_file(
+        "stdout.txt",
+        "1..4\n"
+        "ok 1 - first\n"
+        "not ok 2 - second\n"
+        "# Some diagnostic message\n"
+        "not ok 3 # SKIP Not supported\n"
+        "ok");
+
+    std::vector< model::test_result > exp_results;
+    exp_results.push_back(model::test_result(model::test_result_passed,
+                                             "1 - first"));
+    exp_results.push_back(model::test_result(model::test_result_failed,
+                                             "2 - second"));
+    exp_results.push_back(model::test_result(model::test_result_skipped,
+                                             "3 # SKIP Not supported"));
+    ATF_REQUIRE_EQ(exp_results, engine::tap_interface().compute_sub_results(
+                       fs::path("stdout.txt")));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(compute_sub_results__invalid_data);
+ATF_TEST_CASE_BODY(compute_sub_results__invalid_data)
+{
+    atf::utils::create_file(
+        "stdout.txt",
+        "1..3\n"
+        "not ok 1 # TODO Not yet\n"
+        "1..3\n"
+        "ok 2\n");
+
+    std::vector< model::test_result > exp_results;
+    exp_results.push_back(model::test_result(
+        model::test_result_expected_failure, "1 # TODO Not yet"));
+    ATF_REQUIRE_EQ(exp_results, engine::tap_interface().compute_sub_results(
+                       fs::path("stdout.txt")));
+
+    ATF_REQUIRE(engine::tap_interface().compute_sub_results(
+                    fs::path("missing.txt")).empty());
+}
+
+
 ATF_INIT_TEST_CASES(tcs)
 {
     scheduler::register_interface(
         "tap", std::shared_ptr< scheduler::interface >(
             new engine::tap_interface()));
 
+    ATF_ADD_TEST_CASE(tcs, static_list);
     ATF_ADD_TEST_CASE(tcs, list);
 
     ATF_ADD_TEST_CASE(tcs, test__all_tests_pass);
@@ -215,4 +281,7 @@ ATF_INIT_TEST_CASES(tcs)
     ATF_ADD_TEST_CASE(tcs, test__signal_is_broken);
     ATF_ADD_TEST_CASE(tcs, test__timeout_is_broken);
     ATF_ADD_TEST_CASE(tcs, test__configuration_variables);
+
+    ATF_ADD_TEST_CASE(tcs, compute_sub_results__some);
+    ATF_ADD_TEST_CASE(tcs, compute_sub_results__invalid_data);
 }
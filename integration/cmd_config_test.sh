@@ -53,6 +53,7 @@ EOF
 architecture = my-architecture
 parallelism = 256
 platform = my-platform
+store_compression_level = 0
 test_suites.suite1.the_variable = value1
 test_suites.suite2.the_variable = value2
 unprivileged_user = $(id -u -n)
@@ -325,7 +326,7 @@ EOF
 utils_test_case variable_flag__invalid_value
 variable_flag__invalid_value_body() {
     cat >experr <<EOF
-kyua: E: Invalid value for property 'parallelism': Must be a positive integer.
+kyua: E: Invalid value for property 'parallelism': Must be a positive integer or 'auto'.
 EOF
     atf_check -s exit:2 -o empty -e file:experr kyua \
         -v "parallelism=0" config
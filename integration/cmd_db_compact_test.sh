@@ -0,0 +1,104 @@
+# Copyright 2026 The Kyua Authors.
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are
+# met:
+#
+# * Redistributions of source code must retain the above copyright
+#   notice, this list of conditions and the following disclaimer.
+# * Redistributions in binary form must reproduce the above copyright
+#   notice, this list of conditions and the following disclaimer in the
+#   documentation and/or other materials provided with the distribution.
+# * Neither the name of Google Inc. nor the names of its contributors
+#   may be used to endorse or promote products derived from this software
+#   without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+# "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+# LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+# A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+# OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+# SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+# LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+# DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+# THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+# OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+# Executes a mock test suite to generate data in the database.
+run_tests() {
+    cat >Kyuafile <<EOF
+syntax(2)
+test_suite("integration")
+atf_test_program{name="simple_all_pass"}
+EOF
+
+    utils_cp_helper simple_all_pass .
+    atf_check -s exit:0 -o ignore -e empty kyua test
+    rm Kyuafile simple_all_pass
+}
+
+
+utils_test_case default_test_suite
+default_test_suite_body() {
+    local test_suite="$(pwd | tr / _ | sed -e 's,^_,,')"
+    run_tests
+    run_tests
+    run_tests
+
+    atf_check -s exit:0 \
+        -o match:"Compacted 2 results files of test suite ${test_suite};" \
+        -e empty kyua db-compact
+    test -f "${HOME}/.kyua/store/trends.db" || atf_fail "Index not created"
+
+    atf_check -s exit:0 -o match:"===> Summary" -e empty kyua report
+}
+
+
+utils_test_case older_than
+older_than_body() {
+    run_tests
+    run_tests
+
+    atf_check -s exit:0 -o empty -e empty kyua db-compact --older-than=1
+    atf_check -s exit:0 -o match:"Compacted 1 results files" -e empty \
+        kyua db-compact
+}
+
+
+utils_test_case strip_passed_output
+strip_passed_output_head() {
+    atf_set require.progs kyua sqlite3
+}
+strip_passed_output_body() {
+    run_tests
+    run_tests
+
+    local oldest="$(ls ${HOME}/.kyua/store/results.*.db | head -n 1)"
+    atf_check -s exit:0 -o match:"Stripped 2 output files of passed" \
+        -e empty kyua db-compact --strip-passed-output
+    atf_check -s exit:0 -o inline:"0\n" -e empty \
+        sqlite3 "${oldest}" \
+        "SELECT COUNT(*) FROM test_case_files NATURAL JOIN test_results
+         WHERE result_type = 'passed'"
+}
+
+
+utils_test_case invalid_arguments
+invalid_arguments_body() {
+    atf_check -s exit:3 -o empty -e match:"Invalid value for --older-than" \
+        kyua db-compact --older-than=-1
+    atf_check -s exit:3 -o empty -e match:"Cannot specify test suites" \
+        kyua db-compact --all first
+}
+
+
+atf_init_test_cases() {
+    atf_add_test_case default_test_suite
+    atf_add_test_case older_than
+    atf_add_test_case strip_passed_output
+
+    atf_add_test_case invalid_arguments
+}
@@ -150,6 +150,91 @@ EOF
 }
 
 
+utils_test_case format_flag
+format_flag_body() {
+    create_empty_store
+
+    atf_check kyua db-exec "CREATE TABLE data (a INTEGER, b TEXT)"
+    atf_check kyua db-exec "INSERT INTO data VALUES (1, 'x,y')"
+    atf_check kyua db-exec "INSERT INTO data VALUES (2, NULL)"
+
+    cat >expout <<EOF
+a,b
+1,"x,y"
+2,
+EOF
+    atf_check -s exit:0 -o file:expout -e empty \
+        kyua db-exec --format=csv "SELECT * FROM data ORDER BY a"
+
+    printf 'a\tb\n1\tx,y\n2\t\n' >expout
+    atf_check -s exit:0 -o file:expout -e empty \
+        kyua db-exec --format=tsv "SELECT * FROM data ORDER BY a"
+
+    cat >expout <<EOF
+{"a":1,"b":"x,y"}
+{"a":2,"b":null}
+EOF
+    atf_check -s exit:0 -o file:expout -e empty \
+        kyua db-exec --format=ndjson "SELECT * FROM data ORDER BY a"
+}
+
+
+utils_test_case format_flag__invalid
+format_flag__invalid_body() {
+    atf_check -s exit:3 -o empty -e match:"Invalid value for --format: foo" \
+        kyua db-exec --format=foo "SELECT * FROM metadata"
+}
+
+
+utils_test_case script_flag
+script_flag_body() {
+    create_empty_store
+
+    cat >script.sql <<EOF
+CREATE TABLE data (a INTEGER);
+INSERT INTO data VALUES (3);  -- A comment.
+INSERT INTO data VALUES (4);
+SELECT a FROM data ORDER BY a;
+SELECT COUNT(*) AS total FROM data;
+EOF
+
+    cat >expout <<EOF
+a
+3
+4
+total
+2
+EOF
+    atf_check -s exit:0 -o file:expout -e empty \
+        kyua db-exec --format=csv --script=script.sql
+}
+
+
+utils_test_case script_flag__rollback
+script_flag__rollback_body() {
+    create_empty_store
+
+    cat >script.sql <<EOF
+CREATE TABLE data (a INTEGER);
+INSERT INTO data VALUES (3);
+INSERT INTO missing VALUES (4);
+EOF
+    atf_check -s exit:1 -o empty -e match:"SQLite error.*missing" \
+        kyua db-exec --script=script.sql
+    atf_check -s exit:1 -o empty -e match:"SQLite error.*data" \
+        kyua db-exec "SELECT * FROM data"
+}
+
+
+utils_test_case script_flag__invalid
+script_flag__invalid_body() {
+    atf_check -s exit:3 -o empty -e match:"Cannot provide both" \
+        kyua db-exec --script=script.sql "SELECT * FROM metadata"
+    atf_check -s exit:1 -o empty -e match:"Failed to open.*script.sql" \
+        kyua db-exec --script=script.sql
+}
+
+
 atf_init_test_cases() {
     atf_add_test_case one_arg
     atf_add_test_case many_args
@@ -162,4 +247,11 @@ atf_init_test_cases() {
     atf_add_test_case results_file__explicit__fail
 
     atf_add_test_case no_headers_flag
+
+    atf_add_test_case format_flag
+    atf_add_test_case format_flag__invalid
+
+    atf_add_test_case script_flag
+    atf_add_test_case script_flag__rollback
+    atf_add_test_case script_flag__invalid
 }
@@ -0,0 +1,119 @@
+# Copyright 2026 The Kyua Authors.
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are
+# met:
+#
+# * Redistributions of source code must retain the above copyright
+#   notice, this list of conditions and the following disclaimer.
+# * Redistributions in binary form must reproduce the above copyright
+#   notice, this list of conditions and the following disclaimer in the
+#   documentation and/or other materials provided with the distribution.
+# * Neither the name of Google Inc. nor the names of its contributors
+#   may be used to endorse or promote products derived from this software
+#   without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+# "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+# LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+# A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+# OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+# SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+# LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+# DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+# THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+# OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+# Executes a mock test suite to generate a results file.
+#
+# \param program The name of the helper test program to run.
+# \param dbfile_name File to which to write the path to the generated database
+#     file.
+run_tests() {
+    local program="${1}"; shift
+    local dbfile_name="${1}"; shift
+
+    cat >Kyuafile <<EOF
+syntax(2)
+test_suite("integration")
+atf_test_program{name="${program}"}
+EOF
+
+    utils_cp_helper "${program}" .
+    atf_check -s ignore -o save:stdout -e empty kyua test
+    grep '^Results saved to ' stdout | cut -d ' ' -f 4 >"${dbfile_name}"
+    rm stdout
+
+    # Ensure the results of 'report' come from the database.
+    rm Kyuafile "${program}"
+}
+
+
+utils_test_case merge__ok
+merge__ok_body() {
+    utils_install_times_wrapper
+
+    run_tests simple_all_pass dbfile_name1
+    run_tests simple_some_fail dbfile_name2
+
+    atf_check -s exit:0 -o inline:"Results saved to merged.db\n" -e empty \
+        kyua db-merge --results-file=merged.db \
+        "$(cat dbfile_name1)" "$(cat dbfile_name2)"
+
+    cat >expout <<EOF
+===> Skipped tests
+simple_all_pass:skip  ->  skipped: The reason for skipping is this  [S.UUUs]
+===> Failed tests
+simple_some_fail:fail  ->  failed: This fails on purpose  [S.UUUs]
+===> Summary
+Results read from $(pwd)/merged.db
+Test cases: 4 total, 1 skipped, 0 expected failures, 0 broken, 1 failed
+Total time: S.UUUs
+EOF
+    atf_check -s exit:0 -o file:expout -e empty \
+        kyua report --results-file=merged.db
+}
+
+
+utils_test_case merge__invalid_input
+merge__invalid_input_body() {
+    run_tests simple_all_pass dbfile_name1
+    echo "This is not a valid database" >invalid.db
+
+    atf_check -s exit:1 -o empty -e match:"Merge failed" \
+        kyua db-merge --results-file=merged.db "$(cat dbfile_name1)" \
+        ./invalid.db
+    [ ! -f merged.db ] || atf_fail "Partial results file not deleted"
+}
+
+
+utils_test_case merge__output_not_empty
+merge__output_not_empty_body() {
+    run_tests simple_all_pass dbfile_name1
+
+    atf_check -s exit:1 -o empty -e match:"Merge failed.*not empty" \
+        kyua db-merge --results-file="$(cat dbfile_name1)" \
+        "$(cat dbfile_name1)"
+}
+
+
+utils_test_case no_arguments
+no_arguments_body() {
+    cat >stderr <<EOF
+Usage error for command db-merge: Not enough arguments.
+Type 'kyua help db-merge' for usage information.
+EOF
+    atf_check -s exit:3 -o empty -e file:stderr kyua db-merge
+}
+
+
+atf_init_test_cases() {
+    atf_add_test_case merge__ok
+    atf_add_test_case merge__invalid_input
+    atf_add_test_case merge__output_not_empty
+
+    atf_add_test_case no_arguments
+}
@@ -66,7 +66,8 @@ upgrade__from_v1_head() {
 upgrade__from_v1_body() {
     create_historical_db "${KYUA_STORETESTDATADIR}/schema_v1.sql" \
         "${KYUA_STORETESTDATADIR}/testdata_v1.sql"
-    atf_check -s exit:0 -o empty -e empty kyua db-migrate
+    atf_check -s exit:0 -o inline:"Extracted 3 of 3 actions\n" -e empty \
+        kyua db-migrate
     for f in \
         "results.test_suite_root.20130108-111331-000000.db" \
         "results.usr_tests.20130108-123832-000000.db" \
@@ -91,7 +92,34 @@ upgrade__from_v2_head() {
 upgrade__from_v2_body() {
     create_historical_db "${KYUA_STORETESTDATADIR}/schema_v2.sql" \
         "${KYUA_STORETESTDATADIR}/testdata_v2.sql"
-    atf_check -s exit:0 -o empty -e empty kyua db-migrate
+    atf_check -s exit:0 -o inline:"Extracted 3 of 3 actions\n" -e empty \
+        kyua db-migrate
+    for f in \
+        "results.test_suite_root.20130108-111331-000000.db" \
+        "results.usr_tests.20130108-123832-000000.db" \
+        "results.usr_tests.20130108-112635-000000.db"
+    do
+        [ -f "${HOME}/.kyua/store/${f}" ] || atf_fail "Expected file ${f}" \
+            "was not created"
+    done
+    [ ! -f "${HOME}/.kyua/store.db" ] || atf_fail "Historical database not" \
+        "deleted"
+}
+
+
+utils_test_case upgrade__parallel
+upgrade__parallel_head() {
+    atf_set require.files \
+        "${KYUA_STORETESTDATADIR}/schema_v2.sql" \
+        "${KYUA_STORETESTDATADIR}/testdata_v2.sql" \
+        "${KYUA_STOREDIR}/migrate_v2_v3.sql"
+    atf_set require.progs "sqlite3"
+}
+upgrade__parallel_body() {
+    create_historical_db "${KYUA_STORETESTDATADIR}/schema_v2.sql" \
+        "${KYUA_STORETESTDATADIR}/testdata_v2.sql"
+    atf_check -s exit:0 -o inline:"Extracted 3 of 3 actions\n" -e empty \
+        kyua -v parallelism=2 db-migrate
     for f in \
         "results.test_suite_root.20130108-111331-000000.db" \
         "results.usr_tests.20130108-123832-000000.db" \
@@ -157,6 +185,7 @@ EOF
 atf_init_test_cases() {
     atf_add_test_case upgrade__from_v1
     atf_add_test_case upgrade__from_v2
+    atf_add_test_case upgrade__parallel
     atf_add_test_case already_up_to_date
     atf_add_test_case need_upgrade
 
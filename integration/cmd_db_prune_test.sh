@@ -0,0 +1,146 @@
+# Copyright 2026 The Kyua Authors.
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are
+# met:
+#
+# * Redistributions of source code must retain the above copyright
+#   notice, this list of conditions and the following disclaimer.
+# * Redistributions in binary form must reproduce the above copyright
+#   notice, this list of conditions and the following disclaimer in the
+#   documentation and/or other materials provided with the distribution.
+# * Neither the name of Google Inc. nor the names of its contributors
+#   may be used to endorse or promote products derived from this software
+#   without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+# "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+# LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+# A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+# OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+# SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+# LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+# DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+# THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+# OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+# Creates empty results files for a test suite in the store.
+#
+# \param test_suite Identifier of the test suite.
+# \param ... Timestamps of the results files to create.
+create_results() {
+    local test_suite="${1}"; shift
+
+    mkdir -p "${HOME}/.kyua/store"
+    for timestamp in "${@}"; do
+        touch "${HOME}/.kyua/store/results.${test_suite}.${timestamp}.db"
+    done
+}
+
+
+utils_test_case default_test_suite
+default_test_suite_body() {
+    local test_suite="$(pwd | tr / _ | sed -e 's,^_,,')"
+    create_results "${test_suite}" 20140613-194515-000000 \
+        20140614-194515-000000 20140615-194515-000000
+    create_results other 20140613-194515-000000
+
+    atf_check -s exit:0 \
+        -o inline:"Pruned 1 results files of test suite ${test_suite}\n" \
+        -e empty kyua db-prune --keep=2
+
+    local base="${HOME}/.kyua/store/results.${test_suite}"
+    test ! -f "${base}.20140613-194515-000000.db" || atf_fail "Not pruned"
+    test -f "${base}.20140614-194515-000000.db" || atf_fail "Pruned too much"
+    test -f "${base}.20140615-194515-000000.db" || atf_fail "Pruned too much"
+    test -f "${HOME}/.kyua/store/results.other.20140613-194515-000000.db" \
+        || atf_fail "Pruned unrelated test suite"
+}
+
+
+utils_test_case explicit_test_suites
+explicit_test_suites_body() {
+    create_results first 20140613-194515-000000 20140614-194515-000000
+    create_results second 20140613-194515-000000 20140614-194515-000000
+    create_results third 20140613-194515-000000 20140614-194515-000000
+
+    cat >expout <<EOF
+Pruned 1 results files of test suite first
+Pruned 1 results files of test suite third
+EOF
+    atf_check -s exit:0 -o file:expout -e empty \
+        kyua db-prune --keep=1 third first
+
+    atf_check -s exit:0 -o inline:"4\n" -e empty \
+        sh -c "ls ${HOME}/.kyua/store | wc -l | tr -d ' '"
+}
+
+
+utils_test_case all_test_suites
+all_test_suites_body() {
+    create_results first 20140613-194515-000000 20140614-194515-000000
+    create_results second 20140613-194515-000000
+    create_results with.dots 20140613-194515-000000 20140614-194515-000000
+    touch "${HOME}/.kyua/store/results.first.db"
+
+    cat >expout <<EOF
+Pruned 1 results files of test suite first
+Pruned 1 results files of test suite with.dots
+EOF
+    atf_check -s exit:0 -o file:expout -e empty kyua db-prune --all --keep=1
+
+    local store="${HOME}/.kyua/store"
+    test -f "${store}/results.first.20140614-194515-000000.db" \
+        || atf_fail "Pruned the latest results file"
+    test -f "${store}/results.first.db" || atf_fail "Pruned unrelated file"
+    test -f "${store}/results.with.dots.20140614-194515-000000.db" \
+        || atf_fail "Pruned the latest results file"
+}
+
+
+utils_test_case latest_link
+latest_link_body() {
+    cat >Kyuafile <<EOF
+syntax(2)
+test_suite("integration")
+atf_test_program{name="simple_all_pass"}
+EOF
+    utils_cp_helper simple_all_pass .
+
+    atf_check -s exit:0 -o ignore -e empty kyua test
+    atf_check -s exit:0 -o save:stdout -e empty kyua test
+    local latest="$(grep '^Results saved to ' stdout | cut -d ' ' -f 4)"
+
+    local test_suite="$(pwd | tr / _ | sed -e 's,^_,,')"
+    local link="${HOME}/.kyua/store/results.${test_suite}.latest"
+    test -h "${link}" || atf_fail "Latest link not created"
+    atf_check -s exit:0 -o inline:"$(basename "${latest}")\n" -e empty \
+        readlink "${link}"
+
+    atf_check -s exit:0 -o ignore -e empty kyua db-prune --keep=1
+    atf_check -s exit:0 -o match:"Results read from ${latest}" -e empty \
+        kyua report
+}
+
+
+utils_test_case invalid_arguments
+invalid_arguments_body() {
+    atf_check -s exit:3 -o empty -e match:"Invalid value for --keep" \
+        kyua db-prune --keep=0
+    atf_check -s exit:3 -o empty -e match:"Cannot specify test suites" \
+        kyua db-prune --all first
+}
+
+
+atf_init_test_cases() {
+    atf_add_test_case default_test_suite
+    atf_add_test_case explicit_test_suites
+    atf_add_test_case all_test_suites
+
+    atf_add_test_case latest_link
+
+    atf_add_test_case invalid_arguments
+}
@@ -205,6 +205,72 @@ EOF
 }
 
 
+utils_test_case repeat_flag__ok
+repeat_flag__ok_body() {
+    cat >Kyuafile <<EOF
+syntax(2)
+test_suite("integration")
+atf_test_program{name="first"}
+EOF
+    utils_cp_helper simple_all_pass first
+
+    cat >expout <<EOF
+first:pass  ->  3 passed, 0 failed
+EOF
+    atf_check -s exit:0 -o file:expout -e empty kyua debug --repeat=3 \
+        first:pass
+}
+
+
+utils_test_case repeat_flag__fail
+repeat_flag__fail_body() {
+    cat >Kyuafile <<EOF
+syntax(2)
+test_suite("integration")
+atf_test_program{name="first"}
+EOF
+    utils_cp_helper simple_some_fail first
+
+    cat >expout <<EOF
+This is the stdout of fail
+first:fail (iteration 1)  ->  failed: This fails on purpose
+This is the stdout of fail
+first:fail (iteration 2)  ->  failed: This fails on purpose
+first:fail  ->  0 passed, 2 failed
+EOF
+    cat >experr <<EOF
+This is the stderr of fail
+This is the stderr of fail
+EOF
+    atf_check -s exit:1 -o file:expout -e file:experr kyua debug --repeat=2 \
+        first:fail
+}
+
+
+utils_test_case repeat_flag__parallel
+repeat_flag__parallel_body() {
+    cat >Kyuafile <<EOF
+syntax(2)
+test_suite("integration")
+atf_test_program{name="first"}
+EOF
+    utils_cp_helper simple_all_pass first
+
+    cat >expout <<EOF
+first:pass  ->  8 passed, 0 failed
+EOF
+    atf_check -s exit:0 -o file:expout -e empty kyua \
+        -v parallelism=4 debug --repeat=8 --parallel first:pass
+}
+
+
+utils_test_case repeat_flag__invalid
+repeat_flag__invalid_body() {
+    atf_check -s exit:3 -o empty -e match:"Invalid value for --repeat: 0" \
+        kyua debug --repeat=0 first:pass
+}
+
+
 utils_test_case args_are_relative
 args_are_relative_body() {
     mkdir root
@@ -407,6 +473,11 @@ atf_init_test_cases() {
 
     atf_add_test_case stdout_stderr_flags
 
+    atf_add_test_case repeat_flag__ok
+    atf_add_test_case repeat_flag__fail
+    atf_add_test_case repeat_flag__parallel
+    atf_add_test_case repeat_flag__invalid
+
     atf_add_test_case args_are_relative
 
     atf_add_test_case only_load_used_test_programs
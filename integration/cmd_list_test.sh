@@ -434,6 +434,113 @@ EOF
 }
 
 
+utils_test_case format_flag__nulsep
+format_flag__nulsep_body() {
+    cat >Kyuafile <<EOF
+syntax(2)
+test_suite("integration")
+atf_test_program{name="simple_all_pass"}
+EOF
+    utils_cp_helper simple_all_pass .
+
+    printf 'simple_all_pass:pass\0simple_all_pass:skip\0' >expout
+    atf_check -s exit:0 -o file:expout -e empty kyua list --format=nulsep
+}
+
+
+utils_test_case format_flag__json
+format_flag__json_body() {
+    cat >Kyuafile <<EOF
+syntax(2)
+test_suite("integration")
+plain_test_program{name="i_am_plain", timeout=654}
+EOF
+    touch i_am_plain
+
+    atf_check -s exit:0 -o save:stdout -e empty kyua list --format=json
+    atf_check -s exit:0 -o match:'^\{"program":"i_am_plain","case":"main",' \
+        -o match:'"test_suite":"integration"' \
+        -o match:'"timeout":"654"' cat stdout
+}
+
+
+utils_test_case format_flag__invalid
+format_flag__invalid_body() {
+    cat >Kyuafile <<EOF
+syntax(2)
+test_suite("integration")
+atf_test_program{name="simple_all_pass"}
+EOF
+    utils_cp_helper simple_all_pass .
+
+    atf_check -s exit:3 -o empty -e match:"Invalid value for --format: xml" \
+        kyua list --format=xml
+    atf_check -s exit:3 -o empty \
+        -e match:"--verbose cannot be used with --format=json" \
+        kyua list --format=json --verbose
+}
+
+
+utils_test_case completion_order_flag
+completion_order_flag_body() {
+    cat >Kyuafile <<EOF
+syntax(2)
+test_suite("integration")
+atf_test_program{name="metadata"}
+atf_test_program{name="simple_all_pass"}
+atf_test_program{name="simple_some_fail"}
+EOF
+    utils_cp_helper metadata .
+    utils_cp_helper simple_all_pass .
+    utils_cp_helper simple_some_fail .
+
+    atf_check -s exit:0 -o save:ordered -e empty kyua list
+    atf_check -s exit:0 -o save:unordered -e empty \
+        kyua list --completion-order
+
+    sort ordered >expout
+    atf_check -s exit:0 -o file:expout -e empty sort unordered
+}
+
+
+utils_test_case shard_flag__ok
+shard_flag__ok_body() {
+    cat >Kyuafile <<EOF
+syntax(2)
+test_suite("integration")
+atf_test_program{name="metadata"}
+atf_test_program{name="simple_all_pass"}
+atf_test_program{name="simple_some_fail"}
+EOF
+    utils_cp_helper metadata .
+    utils_cp_helper simple_all_pass .
+    utils_cp_helper simple_some_fail .
+
+    atf_check -s exit:0 -o save:all -e empty kyua list
+    atf_check -s exit:0 -o save:shard1 -e empty kyua list --shard=1/3
+    atf_check -s exit:0 -o save:shard2 -e empty kyua list --shard=2/3
+    atf_check -s exit:0 -o save:shard3 -e empty kyua list --shard=3/3
+
+    sort all >expout
+    cat shard1 shard2 shard3 | sort >union
+    atf_check -s exit:0 -o file:expout -e empty cat union
+}
+
+
+utils_test_case shard_flag__invalid
+shard_flag__invalid_body() {
+    cat >Kyuafile <<EOF
+syntax(2)
+test_suite("integration")
+atf_test_program{name="simple_all_pass"}
+EOF
+    utils_cp_helper simple_all_pass .
+
+    atf_check -s exit:3 -o empty -e match:"Invalid.*--shard.*between" \
+        kyua list --shard=0/3
+}
+
+
 utils_test_case no_test_program_match
 no_test_program_match_body() {
     cat >Kyuafile <<EOF
@@ -587,6 +694,15 @@ atf_init_test_cases() {
 
     atf_add_test_case verbose_flag
 
+    atf_add_test_case format_flag__nulsep
+    atf_add_test_case format_flag__json
+    atf_add_test_case format_flag__invalid
+
+    atf_add_test_case completion_order_flag
+
+    atf_add_test_case shard_flag__ok
+    atf_add_test_case shard_flag__invalid
+
     atf_add_test_case no_test_program_match
     atf_add_test_case no_test_case_match
 
@@ -0,0 +1,197 @@
+# Copyright 2026 The Kyua Authors.
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are
+# met:
+#
+# * Redistributions of source code must retain the above copyright
+#   notice, this list of conditions and the following disclaimer.
+# * Redistributions in binary form must reproduce the above copyright
+#   notice, this list of conditions and the following disclaimer in the
+#   documentation and/or other materials provided with the distribution.
+# * Neither the name of Google Inc. nor the names of its contributors
+#   may be used to endorse or promote products derived from this software
+#   without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+# "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+# LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+# A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+# OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+# SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+# LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+# DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+# THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+# OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+# Executes a mock test suite to generate data in the database.
+#
+# \param mock_env The value to store in a MOCK variable in the environment.
+#     Use this to be able to differentiate executions by inspecting the
+#     context of the output.
+# \param dbfile_name File to which to write the path to the generated database
+#     file.
+run_tests() {
+    local mock_env="${1}"; shift
+    local dbfile_name="${1}"; shift
+
+    cat >Kyuafile <<EOF
+syntax(2)
+test_suite("integration")
+atf_test_program{name="simple_all_pass"}
+EOF
+
+    utils_cp_helper simple_all_pass .
+    atf_check -s exit:0 -o save:stdout -e empty env MOCK="${mock_env}" kyua test
+    grep '^Results saved to ' stdout | cut -d ' ' -f 4 >"${dbfile_name}"
+    rm stdout
+
+    # Ensure the results of 'report-json' come from the database.
+    rm Kyuafile simple_all_pass
+}
+
+
+# Replaces the context record and the timing information in stdout with
+# fixed strings.
+# CHECK_STYLE_DISABLE
+strip_variable='sed -E \
+    -e "s,^\{\"record\":\"context\".*\}$,CONTEXT STRIPPED BY TEST," \
+    -e "s,\"[0-9]{4}-[0-9]{2}-[0-9]{2}T[0-9]{2}:[0-9]{2}:[0-9]{2}\.[0-9]{6}Z\",\"YYYY-MM-DDTHH:MM:SS.ssssssZ\",g" \
+    -e "s,\"duration\":[0-9]+\.[0-9]{6},\"duration\":S.UUUUUU,g"'
+
+
+# Common prefix of the record for the pass test case.
+pass_record='{"record":"result","program":"simple_all_pass","variant":"","case":"pass","result":"passed","reason":"","attempt":1,"start_time":"YYYY-MM-DDTHH:MM:SS.ssssssZ","end_time":"YYYY-MM-DDTHH:MM:SS.ssssssZ","duration":S.UUUUUU'
+
+
+# Common prefix of the record for the skip test case.
+skip_record='{"record":"result","program":"simple_all_pass","variant":"","case":"skip","result":"skipped","reason":"The reason for skipping is this","attempt":1,"start_time":"YYYY-MM-DDTHH:MM:SS.ssssssZ","end_time":"YYYY-MM-DDTHH:MM:SS.ssssssZ","duration":S.UUUUUU'
+# CHECK_STYLE_ENABLE
+
+
+utils_test_case default_behavior__ok
+default_behavior__ok_body() {
+    run_tests "mock1" unused_dbfile_name
+
+    cat >expout <<EOF
+CONTEXT STRIPPED BY TEST
+${pass_record}}
+${skip_record}}
+EOF
+    atf_check -s exit:0 -o file:expout -e empty -x "kyua report-json" \
+        "| ${strip_variable}"
+}
+
+
+utils_test_case default_behavior__no_store
+default_behavior__no_store_body() {
+    echo 'kyua: E: No previous results file found for test suite' \
+        "$(utils_test_suite_id)." >experr
+    atf_check -s exit:2 -o empty -e file:experr kyua report-json
+}
+
+
+utils_test_case results_file__explicit
+results_file__explicit_body() {
+    run_tests "mock1" dbfile_name1
+    run_tests "mock2" dbfile_name2
+
+    atf_check -s exit:0 -o match:'"MOCK":"mock1"' -o not-match:'mock2' \
+        -e empty kyua report-json --results-file="$(cat dbfile_name1)"
+    atf_check -s exit:0 -o not-match:'mock1' -o match:'"MOCK":"mock2"' \
+        -e empty kyua report-json --results-file="$(cat dbfile_name2)"
+}
+
+
+utils_test_case results_file__not_found
+results_file__not_found_body() {
+    atf_check -s exit:2 -o empty -e match:"kyua: E: No previous results.*foo" \
+        kyua report-json --results-file=foo
+}
+
+
+utils_test_case with_output
+with_output_body() {
+    run_tests unused_mock unused_dbfile_name
+
+# CHECK_STYLE_DISABLE
+    cat >expout <<EOF
+CONTEXT STRIPPED BY TEST
+${pass_record},"stdout":"This is the stdout of pass\\n","stdout_truncated":false,"stderr":"This is the stderr of pass\\n","stderr_truncated":false}
+${skip_record},"stdout":"This is the stdout of skip\\n","stdout_truncated":false,"stderr":"This is the stderr of skip\\n","stderr_truncated":false}
+EOF
+# CHECK_STYLE_ENABLE
+    atf_check -s exit:0 -o file:expout -e empty -x \
+        "kyua report-json --with-output | ${strip_variable}"
+
+# CHECK_STYLE_DISABLE
+    cat >expout <<EOF
+CONTEXT STRIPPED BY TEST
+${pass_record},"stdout":"This","stdout_truncated":true,"stderr":"This","stderr_truncated":true}
+${skip_record},"stdout":"This","stdout_truncated":true,"stderr":"This","stderr_truncated":true}
+EOF
+# CHECK_STYLE_ENABLE
+    atf_check -s exit:0 -o file:expout -e empty -x \
+        "kyua report-json --with-output --output-limit=4 | ${strip_variable}"
+}
+
+
+utils_test_case output__explicit
+output__explicit_body() {
+    run_tests unused_mock unused_dbfile_name
+
+    cat >report <<EOF
+CONTEXT STRIPPED BY TEST
+${pass_record}}
+${skip_record}}
+EOF
+
+    atf_check -s exit:0 -o empty -e empty kyua report-json --output=my-file
+    atf_check -s exit:0 -o file:report -x cat my-file "| ${strip_variable}"
+}
+
+
+utils_test_case shards
+shards_body() {
+    run_tests unused_mock unused_dbfile_name
+
+    atf_check -s exit:0 -o empty -e empty kyua report-json --shards=2 \
+        --output=my-file
+
+    cat >expout <<EOF
+CONTEXT STRIPPED BY TEST
+${pass_record}}
+${skip_record}}
+EOF
+    atf_check -s exit:0 -o file:expout -x cat my-file.0 "| ${strip_variable}"
+
+    echo "CONTEXT STRIPPED BY TEST" >expout
+    atf_check -s exit:0 -o file:expout -x cat my-file.1 "| ${strip_variable}"
+}
+
+
+utils_test_case shards__invalid
+shards__invalid_body() {
+    atf_check -s exit:3 -o empty -e match:"Invalid value for --shards" \
+        kyua report-json --shards=0 --output=my-file
+    atf_check -s exit:3 -o empty -e match:"--shards requires --output" \
+        kyua report-json --shards=2
+}
+
+
+atf_init_test_cases() {
+    atf_add_test_case default_behavior__ok
+    atf_add_test_case default_behavior__no_store
+
+    atf_add_test_case results_file__explicit
+    atf_add_test_case results_file__not_found
+
+    atf_add_test_case with_output
+
+    atf_add_test_case output__explicit
+
+    atf_add_test_case shards
+    atf_add_test_case shards__invalid
+}
@@ -97,9 +97,16 @@ CONTENTS STRIPPED BY TEST
 allowed_architectures is empty
 allowed_platforms is empty
 description is empty
+exclusive_group is empty
+fixtures is empty
 has_cleanup = false
 is_exclusive = false
+is_idempotent = false
+max_output_size = 0
+max_retries = 0
+priority = normal
 required_configs is empty
+required_cpus = 0
 required_disk_space = 0
 required_files is empty
 required_memory = 0
@@ -135,9 +142,16 @@ Test case metadata
 allowed_architectures is empty
 allowed_platforms is empty
 description is empty
+exclusive_group is empty
+fixtures is empty
 has_cleanup = false
 is_exclusive = false
+is_idempotent = false
+max_output_size = 0
+max_retries = 0
+priority = normal
 required_configs is empty
+required_cpus = 0
 required_disk_space = 0
 required_files is empty
 required_memory = 0
@@ -211,9 +225,16 @@ CONTENTS STRIPPED BY TEST
 allowed_architectures is empty
 allowed_platforms is empty
 description is empty
+exclusive_group is empty
+fixtures is empty
 has_cleanup = false
 is_exclusive = false
+is_idempotent = false
+max_output_size = 0
+max_retries = 0
+priority = normal
 required_configs is empty
+required_cpus = 0
 required_disk_space = 0
 required_files is empty
 required_memory = 0
@@ -249,9 +270,16 @@ Test case metadata
 allowed_architectures is empty
 allowed_platforms is empty
 description is empty
+exclusive_group is empty
+fixtures is empty
 has_cleanup = false
 is_exclusive = false
+is_idempotent = false
+max_output_size = 0
+max_retries = 0
+priority = normal
 required_configs is empty
+required_cpus = 0
 required_disk_space = 0
 required_files is empty
 required_memory = 0
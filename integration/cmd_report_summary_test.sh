@@ -0,0 +1,123 @@
+# Copyright 2026 The Kyua Authors.
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are
+# met:
+#
+# * Redistributions of source code must retain the above copyright
+#   notice, this list of conditions and the following disclaimer.
+# * Redistributions in binary form must reproduce the above copyright
+#   notice, this list of conditions and the following disclaimer in the
+#   documentation and/or other materials provided with the distribution.
+# * Neither the name of Google Inc. nor the names of its contributors
+#   may be used to endorse or promote products derived from this software
+#   without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+# "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+# LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+# A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+# OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+# SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+# LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+# DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+# THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+# OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+# Executes a mock test suite to generate data in the database.
+#
+# \param ... Additional arguments to kyua test.
+run_tests() {
+    cat >Kyuafile <<EOF
+syntax(2)
+test_suite("integration")
+atf_test_program{name="simple_some_fail"}
+EOF
+
+    utils_cp_helper simple_some_fail .
+    atf_check -s exit:1 -o ignore -e empty kyua "${@}" test
+    rm Kyuafile simple_some_fail
+}
+
+
+utils_test_case default_behavior__no_runs
+default_behavior__no_runs_body() {
+    atf_check -s exit:0 -o match:"No results files found" -e empty \
+        kyua report-summary
+}
+
+
+utils_test_case default_behavior__some_runs
+default_behavior__some_runs_body() {
+    run_tests
+    run_tests
+
+    atf_check -s exit:0 -o save:stdout -e empty kyua report-summary
+    atf_check -s exit:0 -o ignore -e empty grep '^===> Runs$' stdout
+    atf_check -s exit:0 -o inline:"2\n" -e empty \
+        grep -c ': 2 total, 0 skipped, 0 expected failures, 0 broken, 1 failed;' \
+        stdout
+    atf_check -s exit:0 -o ignore -e empty grep '^Runs: 2$' stdout
+    atf_check -s exit:0 -o ignore -e empty \
+        grep '^Test cases: 4 total, 0 skipped, 0 expected failures, 0 broken, 2 failed$' \
+        stdout
+    test -d "${HOME}/.kyua/store/snapshots" || atf_fail "Snapshots not created"
+}
+
+
+utils_test_case snapshot_reuse
+snapshot_reuse_body() {
+    run_tests
+
+    atf_check -s exit:0 -o save:first -e empty kyua report-summary
+    atf_check -s exit:0 -o save:second -e empty kyua report-summary
+    atf_check -s exit:0 -o empty -e empty cmp first second
+
+    for snapshot in "${HOME}/.kyua/store/snapshots"/*; do
+        echo "garbage" >"${snapshot}"
+    done
+    atf_check -s exit:0 -o file:first -e empty kyua report-summary
+}
+
+
+utils_test_case runs__limit
+runs__limit_body() {
+    run_tests
+    run_tests
+    run_tests
+
+    atf_check -s exit:0 -o match:"^Runs: 1$" -e empty \
+        kyua report-summary --runs=1
+}
+
+
+utils_test_case test_suite__explicit
+test_suite__explicit_body() {
+    run_tests
+
+    atf_check -s exit:0 -o match:"No results files found" -e empty \
+        kyua report-summary --test-suite=unknown
+}
+
+
+utils_test_case invalid_runs
+invalid_runs_body() {
+    atf_check -s exit:3 -o empty -e match:"Invalid value for --runs" \
+        kyua report-summary --runs=0
+}
+
+
+atf_init_test_cases() {
+    atf_add_test_case default_behavior__no_runs
+    atf_add_test_case default_behavior__some_runs
+
+    atf_add_test_case snapshot_reuse
+
+    atf_add_test_case runs__limit
+
+    atf_add_test_case test_suite__explicit
+
+    atf_add_test_case invalid_runs
+}
@@ -251,9 +251,16 @@ Metadata:
     allowed_architectures is empty
     allowed_platforms is empty
     description is empty
+    exclusive_group is empty
+    fixtures is empty
     has_cleanup = false
     is_exclusive = false
+    is_idempotent = false
+    max_output_size = 0
+    max_retries = 0
+    priority = normal
     required_configs is empty
+    required_cpus = 0
     required_disk_space = 0
     required_files is empty
     required_memory = 0
@@ -359,6 +366,53 @@ EOF
 }
 
 
+utils_test_case slowdown_threshold__ok
+slowdown_threshold__ok_head() {
+    atf_set require.progs sqlite3
+}
+slowdown_threshold__ok_body() {
+    run_tests "mock1" dbfile_name1
+    run_tests "mock2" dbfile_name2
+
+    atf_check -s exit:0 -o match:"===> Summary" -e empty kyua report \
+        --slowdown-threshold=0
+    atf_check -s exit:0 -o not-match:"Slowed down tests" -e empty \
+        kyua report --slowdown-threshold=1000000
+    atf_check -s exit:0 -o match:"simple_all_pass:pass" -e empty \
+        sqlite3 "${HOME}/.kyua/store/trends.db" \
+        "SELECT test_program || ':' || test_case FROM trend_results"
+}
+
+
+utils_test_case slowdown_threshold__invalid
+slowdown_threshold__invalid_body() {
+    run_tests "mock1" unused_dbfile_name
+
+    atf_check -s exit:3 -o empty \
+        -e match:"Invalid value for --slowdown-threshold" \
+        kyua report --slowdown-threshold=-1
+    atf_check -s exit:3 -o empty \
+        -e match:"--slowdown-threshold cannot be used with --follow" \
+        kyua report --slowdown-threshold=10 --follow
+}
+
+
+utils_test_case stats__ok
+stats__ok_body() {
+    run_tests "mock1" unused_dbfile_name
+
+    atf_check -s exit:0 -o save:stdout -e empty kyua report --stats
+    for line in '===> Slot usage' 'Running tests: ' 'Listing test programs: ' \
+        'Storing results: ' 'Cleaning up: ' 'Idle: '
+    do
+        atf_check -s exit:0 -o ignore -e empty grep "^${line}" stdout
+    done
+    atf_check -s exit:3 -o empty \
+        -e match:"--stats cannot be used with --follow" \
+        kyua report --stats --follow
+}
+
+
 atf_init_test_cases() {
     atf_add_test_case default_behavior__ok
     atf_add_test_case default_behavior__no_store
@@ -378,4 +432,9 @@ atf_init_test_cases() {
     atf_add_test_case results_filter__one
     atf_add_test_case results_filter__multiple_all_match
     atf_add_test_case results_filter__multiple_some_match
+
+    atf_add_test_case slowdown_threshold__ok
+    atf_add_test_case slowdown_threshold__invalid
+
+    atf_add_test_case stats__ok
 }
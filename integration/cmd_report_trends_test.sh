@@ -0,0 +1,112 @@
+# Copyright 2026 The Kyua Authors.
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are
+# met:
+#
+# * Redistributions of source code must retain the above copyright
+#   notice, this list of conditions and the following disclaimer.
+# * Redistributions in binary form must reproduce the above copyright
+#   notice, this list of conditions and the following disclaimer in the
+#   documentation and/or other materials provided with the distribution.
+# * Neither the name of Google Inc. nor the names of its contributors
+#   may be used to endorse or promote products derived from this software
+#   without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+# "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+# LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+# A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+# OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+# SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+# LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+# DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+# THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+# OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+# Executes a mock test suite to generate data in the database.
+#
+# \param ... Additional arguments to kyua test.
+run_tests() {
+    cat >Kyuafile <<EOF
+syntax(2)
+test_suite("integration")
+atf_test_program{name="simple_all_pass"}
+EOF
+
+    utils_cp_helper simple_all_pass .
+    atf_check -s exit:0 -o ignore -e empty kyua "${@}" test
+    rm Kyuafile simple_all_pass
+}
+
+
+utils_test_case default_behavior__no_runs
+default_behavior__no_runs_body() {
+    echo "No test cases got slower over the last 10 runs" >expout
+    atf_check -s exit:0 -o file:expout -e empty kyua report-trends
+    test -f "${HOME}/.kyua/store/trends.db" || atf_fail "Index not created"
+}
+
+
+utils_test_case default_behavior__some_runs
+default_behavior__some_runs_head() {
+    atf_set require.progs kyua sqlite3
+}
+default_behavior__some_runs_body() {
+    run_tests
+    run_tests
+
+    atf_check -s exit:0 -o match:"(No test cases got slower|->)" -e empty \
+        kyua report-trends
+    atf_check -s exit:0 -o match:"simple_all_pass:pass" -e empty \
+        sqlite3 "${HOME}/.kyua/store/trends.db" \
+        "SELECT test_program || ':' || test_case FROM trend_results"
+}
+
+
+utils_test_case store_trends_index
+store_trends_index_head() {
+    atf_set require.progs kyua sqlite3
+}
+store_trends_index_body() {
+    run_tests -v store_trends_index=true
+
+    atf_check -s exit:0 -o inline:"2\n" -e empty \
+        sqlite3 "${HOME}/.kyua/store/trends.db" \
+        "SELECT COUNT(*) FROM trend_results"
+}
+
+
+utils_test_case test_suite__explicit
+test_suite__explicit_body() {
+    run_tests
+    run_tests
+
+    atf_check -s exit:0 -o match:"No test cases got slower" -e empty \
+        kyua report-trends --test-suite=unknown
+}
+
+
+utils_test_case invalid_counts
+invalid_counts_body() {
+    atf_check -s exit:3 -o empty -e match:"Invalid value for --runs" \
+        kyua report-trends --runs=1
+    atf_check -s exit:3 -o empty -e match:"Invalid value for --limit" \
+        kyua report-trends --limit=0
+    atf_check -s exit:3 -o empty -e match:"Invalid value for --threshold" \
+        kyua report-trends --threshold=-1
+}
+
+
+atf_init_test_cases() {
+    atf_add_test_case default_behavior__no_runs
+    atf_add_test_case default_behavior__some_runs
+
+    atf_add_test_case store_trends_index
+
+    atf_add_test_case test_suite__explicit
+
+    atf_add_test_case invalid_counts
+}
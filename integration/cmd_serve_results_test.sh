@@ -0,0 +1,100 @@
+# Copyright 2026 The Kyua Authors.
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are
+# met:
+#
+# * Redistributions of source code must retain the above copyright
+#   notice, this list of conditions and the following disclaimer.
+# * Redistributions in binary form must reproduce the above copyright
+#   notice, this list of conditions and the following disclaimer in the
+#   documentation and/or other materials provided with the distribution.
+# * Neither the name of Google Inc. nor the names of its contributors
+#   may be used to endorse or promote products derived from this software
+#   without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+# "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+# LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+# A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+# OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+# SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+# LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+# DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+# THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+# OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+# Executes a mock test suite to generate data in the database.
+#
+# \param dbfile_name File to which to write the path to the generated database
+#     file.
+run_tests() {
+    local dbfile_name="${1}"; shift
+
+    cat >Kyuafile <<EOF
+syntax(2)
+test_suite("integration")
+atf_test_program{name="simple_all_pass"}
+EOF
+
+    utils_cp_helper simple_all_pass .
+    atf_check -s exit:0 -o save:stdout -e empty kyua test
+    grep '^Results saved to ' stdout | cut -d ' ' -f 4 >"${dbfile_name}"
+    rm stdout
+}
+
+
+utils_test_case no_requests
+no_requests_body() {
+    atf_check -s exit:0 -o empty -e empty kyua serve-results </dev/null
+}
+
+
+utils_test_case several_requests
+several_requests_body() {
+    run_tests dbfile_name
+    local dbfile="$(cat dbfile_name)"
+
+    printf '%s\n\n%s simple_all_pass:skip\n' "${dbfile}" "${dbfile}" >input
+    atf_check -s exit:0 -o save:stdout -e empty kyua serve-results <input
+
+    atf_check -s exit:0 -o match:'^2$' -e empty \
+        grep -c '^{"record":"context",' stdout
+    atf_check -s exit:0 -o match:'^3$' -e empty \
+        grep -c '^{"record":"result",' stdout
+    atf_check -s exit:0 -o match:'^2$' -e empty \
+        grep -c '^{"record":"end","unused_filters":\[\]}$' stdout
+}
+
+
+utils_test_case request_errors
+request_errors_body() {
+    run_tests dbfile_name
+    local dbfile="$(cat dbfile_name)"
+
+    printf './missing.db\n%s\n' "${dbfile}" >input
+    atf_check -s exit:0 -o save:stdout -e empty kyua serve-results <input
+
+    atf_check -s exit:0 -o match:'^{"record":"error","reason":".*missing' \
+        -e empty head -n 1 stdout
+    atf_check -s exit:0 -o match:'^{"record":"end","unused_filters":\[\]}$' \
+        -e empty tail -n 1 stdout
+}
+
+
+utils_test_case max_open__invalid
+max_open__invalid_body() {
+    atf_check -s exit:3 -o empty -e match:"Invalid value for --max-open" \
+        kyua serve-results --max-open=0 </dev/null
+}
+
+
+atf_init_test_cases() {
+    atf_add_test_case no_requests
+    atf_add_test_case several_requests
+    atf_add_test_case request_errors
+
+    atf_add_test_case max_open__invalid
+}
@@ -680,6 +680,98 @@ EOF
 }
 
 
+utils_test_case results_file__in_memory
+results_file__in_memory_body() {
+    cat >Kyuafile <<EOF
+syntax(2)
+atf_test_program{name="simple_all_pass", test_suite="integration"}
+EOF
+    utils_cp_helper simple_all_pass .
+
+    atf_check -s exit:0 -o match:"Results not saved" -e empty \
+        kyua test --results-file=:memory:
+    test ! -f :memory: || atf_fail "In-memory results saved to a file"
+    atf_check -s exit:0 -o empty -e empty find "${HOME}" -name 'results.*.db'
+}
+
+
+utils_test_case store_in_memory
+store_in_memory_head() {
+    atf_set require.progs sqlite3
+}
+store_in_memory_body() {
+    cat >Kyuafile <<EOF
+syntax(2)
+atf_test_program{name="simple_all_pass", test_suite="integration"}
+EOF
+    utils_cp_helper simple_all_pass .
+
+    atf_check -s exit:0 -o match:"Results saved to .*results.db" -e empty \
+        kyua -v store_in_memory=true test -r results.db
+    atf_check -s exit:0 -o inline:"2\n" -e empty \
+        sqlite3 results.db "SELECT COUNT(*) FROM test_cases"
+
+    atf_check -s exit:2 -o ignore -e match:"results.db already exists" \
+        kyua -v store_in_memory=true test -r results.db
+}
+
+
+utils_test_case report__several
+report__several_body() {
+    cat >Kyuafile <<EOF
+syntax(2)
+atf_test_program{name="simple_all_pass", test_suite="integration"}
+EOF
+    utils_cp_helper simple_all_pass .
+
+    atf_check -s exit:0 -o save:stdout -e empty kyua test -r results.db \
+        --report=junit:report.xml --report=json:report.json \
+        --report=html:html
+    grep 'Results saved to' stdout >/dev/null || atf_fail "No results file"
+
+    atf_check -s exit:0 -o empty -e empty kyua report-junit \
+        --results-file=results.db --output=expected.xml
+    atf_check -s exit:0 -o empty -e empty cmp expected.xml report.xml
+
+    atf_check -s exit:0 -o inline:"2\n" -e empty \
+        grep -c '"record":"result"' report.json
+    test -f html/index.html || atf_fail "HTML report not generated"
+}
+
+
+utils_test_case report__in_memory
+report__in_memory_body() {
+    cat >Kyuafile <<EOF
+syntax(2)
+atf_test_program{name="simple_all_pass", test_suite="integration"}
+EOF
+    utils_cp_helper simple_all_pass .
+
+    atf_check -s exit:0 -o match:"Results not saved" -e empty \
+        kyua test --results-file=:memory: --report=junit:report.xml
+    atf_check -s exit:0 -o match:'testcase.*name="pass"' -e empty \
+        cat report.xml
+    atf_check -s exit:0 -o match:'testcase.*name="skip"' -e empty \
+        cat report.xml
+}
+
+
+utils_test_case report__invalid
+report__invalid_body() {
+    cat >Kyuafile <<EOF
+syntax(2)
+atf_test_program{name="simple_all_pass", test_suite="integration"}
+EOF
+    utils_cp_helper simple_all_pass .
+
+    atf_check -s exit:3 -o empty -e match:"Invalid value for --report" \
+        kyua test --report=junit
+    atf_check -s exit:3 -o empty -e match:"unknown format 'xml'" \
+        kyua test --report=xml:report.xml
+    test ! -f report.xml || atf_fail "Report created for an unknown format"
+}
+
+
 utils_test_case build_root_flag
 build_root_flag_body() {
     utils_install_stable_test_wrapper
@@ -854,6 +946,761 @@ EOF
 }
 
 
+utils_test_case exclusive_group_tests
+exclusive_group_tests_body() {
+    cat >Kyuafile <<EOF
+syntax(2)
+test_suite("integration")
+EOF
+    for i in $(seq 100); do
+        echo 'plain_test_program{name="race", exclusive_group="shared"}' \
+            >>Kyuafile
+    done
+    utils_cp_helper race .
+
+    atf_check \
+        -s exit:0 \
+        -o match:"100/100 passed" \
+        kyua \
+        -v parallelism=20 \
+        -v test_suites.integration.shared_file="$(pwd)/shared_file" \
+        test
+}
+
+
+utils_test_case max_parallel
+max_parallel_body() {
+    cat >Kyuafile <<EOF
+syntax(2)
+test_suite("integration")
+EOF
+    for i in $(seq 100); do
+        echo 'plain_test_program{name="race"}' >>Kyuafile
+    done
+    utils_cp_helper race .
+
+    atf_check \
+        -s exit:0 \
+        -o match:"100/100 passed" \
+        kyua \
+        -v parallelism=20 \
+        -v test_suites.integration.max_parallel=1 \
+        -v test_suites.integration.shared_file="$(pwd)/shared_file" \
+        test
+}
+
+
+utils_test_case max_parallel__invalid
+max_parallel__invalid_body() {
+    cat >Kyuafile <<EOF
+syntax(2)
+test_suite("integration")
+plain_test_program{name="race"}
+EOF
+    utils_cp_helper race .
+
+    atf_check -s exit:2 -o ignore \
+        -e match:"Invalid value '0' for test_suites.integration.max_parallel" \
+        kyua -v test_suites.integration.max_parallel=0 test
+}
+
+
+utils_test_case required_cpus
+required_cpus_body() {
+    cat >Kyuafile <<EOF
+syntax(2)
+test_suite("integration")
+EOF
+    for i in $(seq 20); do
+        echo 'plain_test_program{name="race", required_cpus=4}' >>Kyuafile
+    done
+    echo 'plain_test_program{name="race", required_cpus=8}' >>Kyuafile
+    utils_cp_helper race .
+
+    atf_check \
+        -s exit:0 \
+        -o match:"21/21 passed" \
+        kyua \
+        -v parallelism=4 \
+        -v test_suites.integration.shared_file="$(pwd)/shared_file" \
+        test
+}
+
+
+utils_test_case parallelism__auto
+parallelism__auto_body() {
+    cat >Kyuafile <<EOF
+syntax(2)
+test_suite("integration")
+EOF
+    for i in $(seq 20); do
+        echo 'plain_test_program{name="race", exclusive_group="shared"}' \
+            >>Kyuafile
+    done
+    utils_cp_helper race .
+
+    atf_check \
+        -s exit:0 \
+        -o match:"20/20 passed" \
+        kyua \
+        -v parallelism=auto \
+        -v parallelism_min=2 \
+        -v parallelism_max=8 \
+        -v test_suites.integration.shared_file="$(pwd)/shared_file" \
+        test
+}
+
+
+utils_test_case cpu_affinity
+cpu_affinity_body() {
+    cat >Kyuafile <<EOF
+syntax(2)
+test_suite("integration")
+atf_test_program{name="simple_all_pass"}
+EOF
+    utils_cp_helper simple_all_pass .
+
+    atf_check -s exit:0 -o match:"2/2 passed" -e empty \
+        kyua -v cpu_affinity=true -v parallelism=2 test
+    atf_check -s exit:0 -o inline:"2\n" -e empty kyua db-exec --no-headers \
+        "SELECT COUNT(*) FROM test_cpu_affinities WHERE cpus <> ''"
+
+    atf_check -s exit:0 -o match:"2/2 passed" -e empty kyua test
+    atf_check -s exit:0 -o inline:"0\n" -e empty kyua db-exec --no-headers \
+        "SELECT COUNT(*) FROM test_cpu_affinities"
+}
+
+
+utils_test_case claims_directory__skip_claimed
+claims_directory__skip_claimed_body() {
+    utils_install_stable_test_wrapper
+
+    cat >Kyuafile <<EOF
+syntax(2)
+test_suite("integration")
+atf_test_program{name="simple_all_pass"}
+EOF
+    utils_cp_helper simple_all_pass .
+
+    mkdir -p claims/simple_all_pass/skip
+
+    cat >expout <<EOF
+simple_all_pass:pass  ->  passed  [S.UUUs]
+
+Results file id is $(utils_results_id)
+Results saved to $(utils_results_file)
+
+1/1 passed (0 failed)
+EOF
+    atf_check -s exit:0 -o file:expout -e empty kyua \
+        -v claims_directory="$(pwd)/claims" test
+    test -d claims/simple_all_pass/pass || atf_fail "Test case not claimed"
+}
+
+
+utils_test_case claims_directory__shared_run
+claims_directory__shared_run_body() {
+    cat >Kyuafile <<EOF
+syntax(2)
+test_suite("integration")
+EOF
+    for i in $(seq 20); do
+        echo "atf_test_program{name=\"simple_all_pass${i}\"}" >>Kyuafile
+        utils_cp_helper simple_all_pass "simple_all_pass${i}"
+    done
+
+    kyua -v claims_directory="$(pwd)/claims" -v parallelism=4 test \
+        --results-file=first.db >first.out 2>first.err &
+    pid=${!}
+    atf_check -s exit:0 -o save:second.out -e empty kyua \
+        -v claims_directory="$(pwd)/claims" -v parallelism=4 test \
+        --results-file=second.db
+    wait "${pid}" || atf_fail "First instance failed"
+
+    first=$(grep -c -- '->' first.out)
+    second=$(grep -c -- '->' second.out)
+    [ $((first + second)) -eq 40 ] || \
+        atf_fail "Expected 40 test cases in total; got ${first} + ${second}"
+}
+
+
+utils_test_case cache_results__skip_unchanged
+cache_results__skip_unchanged_body() {
+    cat >Kyuafile <<EOF
+syntax(2)
+test_suite("integration")
+atf_test_program{name="simple_all_pass"}
+EOF
+    utils_cp_helper simple_all_pass .
+
+    atf_check -s exit:0 -o ignore -e empty kyua -v cache_results=true test
+    atf_check -s exit:0 -o match:"This is the stdout of pass" \
+        -o match:"This is the stdout of skip" -e empty \
+        kyua report --verbose --results-filter=passed,skipped
+
+    # Only passed test cases are taken from the cache.
+    atf_check -s exit:0 -o ignore -e empty kyua -v cache_results=true test
+    atf_check -s exit:0 -o not-match:"This is the stdout of pass" \
+        -o match:"This is the stdout of skip" -e empty \
+        kyua report --verbose --results-filter=passed,skipped
+
+    # Any change to the binary invalidates the cached results.
+    echo "trailing garbage" >>simple_all_pass
+    atf_check -s exit:0 -o ignore -e empty kyua -v cache_results=true test
+    atf_check -s exit:0 -o match:"This is the stdout of pass" \
+        -o match:"This is the stdout of skip" -e empty \
+        kyua report --verbose --results-filter=passed,skipped
+}
+
+
+utils_test_case cache_results__disabled
+cache_results__disabled_body() {
+    cat >Kyuafile <<EOF
+syntax(2)
+test_suite("integration")
+atf_test_program{name="simple_all_pass"}
+EOF
+    utils_cp_helper simple_all_pass .
+
+    atf_check -s exit:0 -o ignore -e empty kyua test
+    atf_check -s exit:0 -o ignore -e empty kyua -v cache_results=true test
+    atf_check -s exit:0 -o match:"This is the stdout of pass" -e empty \
+        kyua report --verbose --results-filter=passed
+}
+
+
+utils_test_case failed_first
+failed_first_body() {
+    cat >Kyuafile <<EOF
+syntax(2)
+test_suite("integration")
+atf_test_program{name="first"}
+atf_test_program{name="second"}
+EOF
+    utils_cp_helper simple_all_pass first
+    utils_cp_helper simple_some_fail second
+
+    atf_check -s exit:1 -o ignore -e empty kyua test
+    atf_check -s exit:1 -o save:stdout -e empty kyua test --failed-first
+    grep -- '->' stdout | head -n 1 >first_result
+    atf_check -s exit:0 -o ignore -e empty grep '^second:fail' first_result
+    atf_check -s exit:0 -o ignore -e empty grep '3/4 passed (1 failed)' stdout
+}
+
+
+utils_test_case fail_fast
+fail_fast_body() {
+    cat >Kyuafile <<EOF
+syntax(2)
+test_suite("integration")
+atf_test_program{name="first"}
+atf_test_program{name="second"}
+EOF
+    utils_cp_helper simple_some_fail first
+    utils_cp_helper simple_all_pass second
+
+    atf_check -s exit:1 -o save:stdout -e empty kyua test --fail-fast
+    atf_check -s exit:0 -o ignore -e empty grep '^first:fail' stdout
+    atf_check -s exit:1 -o empty -e empty grep '^second:' stdout
+    atf_check -s exit:0 -o ignore -e empty \
+        grep 'Stopped after reaching the maximum number of failures' stdout
+
+    atf_check -s exit:1 -o save:stdout -e empty kyua test --max-failures=2
+    atf_check -s exit:0 -o ignore -e empty grep '^second:pass' stdout
+    atf_check -s exit:1 -o empty -e empty grep 'Stopped after' stdout
+}
+
+
+utils_test_case resume
+resume_body() {
+    cat >Kyuafile <<EOF
+syntax(2)
+test_suite("integration")
+atf_test_program{name="first"}
+atf_test_program{name="second"}
+EOF
+    utils_cp_helper simple_all_pass first
+    utils_cp_helper simple_some_fail second
+
+    # Simulate a run that got interrupted after the first test program.
+    atf_check -s exit:0 -o ignore -e empty \
+        kyua test --results-file=results.db first
+
+    atf_check -s exit:1 -o save:stdout -e empty kyua test --resume=results.db
+    atf_check -s exit:1 -o empty -e empty grep '^first:' stdout
+    atf_check -s exit:0 -o ignore -e empty grep '^second:fail' stdout
+    atf_check -s exit:0 -o ignore -e empty \
+        grep 'Results saved to .*results.db' stdout
+
+    atf_check -s exit:0 -o match:'^COUNT\(\*\)$' -o match:'^4$' -e empty \
+        kyua db-exec --results-file=results.db \
+        "SELECT COUNT(*) FROM test_results"
+
+    atf_check -s exit:0 -o ignore -e empty kyua test --resume=results.db
+    atf_check -s exit:3 -o empty -e match:'cannot be combined with --repeat' \
+        kyua test --resume=results.db --repeat=2
+}
+
+
+utils_test_case upload
+upload_body() {
+    cat >Kyuafile <<EOF
+syntax(2)
+test_suite("integration")
+atf_test_program{name="simple_all_pass"}
+EOF
+    utils_cp_helper simple_all_pass .
+
+    cat >sink <<EOF
+#! /bin/sh
+echo "\${1}" >>$(pwd)/sink.log
+[ "\${1}" = results ] && cp "\${2}" $(pwd)/uploaded.db
+exit 0
+EOF
+    chmod +x sink
+
+    atf_check -s exit:0 -o ignore -e empty kyua \
+        -v store_upload_command="$(pwd)/sink" \
+        -v store_checkpoint_results=1 \
+        test --results-file=results.db
+    atf_check -s exit:0 -o ignore -e empty grep '^snapshot$' sink.log
+    atf_check -s exit:0 -o inline:'results\n' -e empty tail -n 1 sink.log
+    test ! -f results.db-snapshot || atf_fail "Snapshot not deleted"
+
+    atf_check -s exit:0 -o match:'^COUNT\(\*\)$' -o match:'^2$' -e empty \
+        kyua db-exec --results-file=uploaded.db \
+        "SELECT COUNT(*) FROM test_results"
+}
+
+
+utils_test_case stats
+stats_body() {
+    cat >Kyuafile <<EOF
+syntax(2)
+test_suite("integration")
+atf_test_program{name="simple_all_pass"}
+EOF
+    utils_cp_helper simple_all_pass .
+
+    atf_check -s exit:0 -o not-match:'Phase latencies' -e empty kyua test
+    atf_check -s exit:0 -o save:stdout -e empty kyua test --stats
+    atf_check -s exit:0 -o ignore -e empty grep '^Phase latencies:$' stdout
+    atf_check -s exit:0 -o ignore -e empty \
+        grep -E '^    test: count=2, mean=[0-9]+\.[0-9]{3}s, ' stdout
+    atf_check -s exit:0 -o ignore -e empty \
+        grep -E '^    put_result: count=2, ' stdout
+}
+
+
+utils_test_case compact
+compact_body() {
+    utils_install_stable_test_wrapper
+
+    cat >Kyuafile <<EOF
+syntax(2)
+test_suite("integration")
+atf_test_program{name="simple_some_fail"}
+EOF
+
+    cat >expout <<EOF
+simple_some_fail:fail  ->  failed: This fails on purpose  [S.UUUs]
+
+Results file id is $(utils_results_id)
+Results saved to $(utils_results_file)
+
+1/2 passed (1 failed)
+EOF
+
+    utils_cp_helper simple_some_fail .
+    unset COLUMNS
+    atf_check -s exit:1 -o file:expout -e empty kyua test --compact
+
+    COLUMNS=80 atf_check -s exit:1 -o save:stdout -e empty kyua test --compact
+    atf_check -s exit:0 -o ignore -e empty \
+        grep -E '[0-9]+ done, [0-9]+ failed, [0-9]+ running \[[0-9.]+/s' stdout
+    atf_check -s exit:0 -o ignore -e empty \
+        grep '^1/2 passed (1 failed)$' stdout
+}
+
+
+utils_test_case ordered_output
+ordered_output_body() {
+    utils_install_stable_test_wrapper
+
+    cat >Kyuafile <<EOF
+syntax(2)
+test_suite("integration")
+plain_test_program{name="a_slow"}
+plain_test_program{name="b_fast"}
+EOF
+    printf '#! /bin/sh\nsleep 2\n' >a_slow; chmod +x a_slow
+    printf '#! /bin/sh\nexit 0\n' >b_fast; chmod +x b_fast
+
+    cat >expout <<EOF
+a_slow:main  ->  passed  [S.UUUs]
+b_fast:main  ->  passed  [S.UUUs]
+
+Results file id is $(utils_results_id)
+Results saved to $(utils_results_file)
+
+2/2 passed (0 failed)
+EOF
+    atf_check -s exit:0 -o file:expout -e empty \
+        kyua -v parallelism=2 test --ordered-output
+}
+
+
+utils_test_case stream_output
+stream_output_body() {
+    cat >Kyuafile <<EOF
+syntax(2)
+test_suite("integration")
+atf_test_program{name="simple_all_pass"}
+EOF
+    utils_cp_helper simple_all_pass .
+
+    atf_check -s exit:0 -o save:stdout -e save:stderr \
+        kyua test --stream-output=simple_all_pass:pass
+    atf_check -s exit:0 -o ignore -e empty \
+        grep '^\[simple_all_pass:pass\] This is the stdout of pass$' stdout
+    atf_check -s exit:0 -o ignore -e empty \
+        grep '^simple_all_pass:pass  ->  passed  \[' stdout
+    atf_check -s exit:1 -o empty -e empty grep 'stdout of skip' stdout
+    atf_check -s exit:0 -o ignore -e empty \
+        grep '^\[simple_all_pass:pass\] This is the stderr of pass$' stderr
+
+    atf_check -s exit:0 -o match:'This is the stdout of pass' -e empty \
+        kyua report --verbose --results-filter=passed
+
+    atf_check -s exit:3 -o empty -e match:'Invalid value for --stream-output' \
+        kyua test --stream-output=:foo
+}
+
+
+utils_test_case metrics_file
+metrics_file_body() {
+    cat >Kyuafile <<EOF
+syntax(2)
+test_suite("integration")
+atf_test_program{name="simple_all_pass"}
+EOF
+    utils_cp_helper simple_all_pass .
+
+    atf_check -s exit:0 -o ignore -e empty kyua test --metrics-file=metrics
+    test ! -f metrics.tmp || atf_fail "Temporary metrics file left behind"
+    for line in \
+        'kyua_tests_started_total 2' \
+        'kyua_tests_finished_total{result="passed"} 1' \
+        'kyua_tests_finished_total{result="skipped"} 1' \
+        'kyua_tests_finished_total{result="failed"} 0' \
+        'kyua_running 0' \
+        'kyua_queued_test_cases 0' \
+        '# EOF'
+    do
+        atf_check -s exit:0 -o ignore -e empty grep -F -x "${line}" metrics
+    done
+    atf_check -s exit:0 -o ignore -e empty \
+        grep -E '^kyua_spawn_seconds_count [1-9][0-9]*$' metrics
+    atf_check -s exit:0 -o ignore -e empty \
+        grep -E '^kyua_output_bytes_total [0-9]+$' metrics
+    atf_check -s exit:0 -o ignore -e empty \
+        grep -E '^kyua_predicted_remaining_seconds [0-9.]+$' metrics
+}
+
+
+utils_test_case changed_files
+changed_files_body() {
+    utils_install_stable_test_wrapper
+
+    cat >Kyuafile <<EOF
+syntax(2)
+test_suite("integration")
+atf_test_program{name="first"}
+atf_test_program{name="second"}
+EOF
+    utils_cp_helper simple_all_pass first
+    utils_cp_helper simple_all_pass second
+
+    cat >deps.mk <<EOF
+# Generated by the build.
+first: src/first.c src/common.h
+second: src/second.c \\
+    src/common.h
+EOF
+
+    echo src/second.c >changed
+    cat >expout <<EOF
+second:pass  ->  passed  [S.UUUs]
+second:skip  ->  skipped: The reason for skipping is this  [S.UUUs]
+
+Results file id is $(utils_results_id)
+Results saved to $(utils_results_file)
+
+2/2 passed (0 failed)
+EOF
+    atf_check -s exit:0 -o file:expout -e empty kyua test \
+        --changed-files=changed --dependency-manifest=deps.mk
+
+    echo first >changed
+    sed -e 's,^second:,first:,' expout >expout.first
+    atf_check -s exit:0 -o file:expout.first -e empty kyua test \
+        --changed-files=changed
+
+    echo src/common.h >changed
+    atf_check -s exit:0 -o match:'^4/4 passed' -e empty kyua test \
+        --changed-files=changed --dependency-manifest=deps.mk
+
+    echo README >changed
+    atf_check -s exit:0 -o not-match:'passed' -e empty kyua test \
+        --changed-files=changed --dependency-manifest=deps.mk
+}
+
+
+utils_test_case changed_files__invalid
+changed_files__invalid_body() {
+    cat >Kyuafile <<EOF
+syntax(2)
+test_suite("integration")
+EOF
+
+    cat >experr <<EOF
+Usage error for command test: Invalid argument 'missing' for option --changed-files: Cannot open file.
+Type 'kyua help test' for usage information.
+EOF
+    atf_check -s exit:3 -o empty -e file:experr kyua test \
+        --changed-files=missing
+
+    touch changed
+    echo "no rule here" >deps.mk
+    atf_check -s exit:3 -o empty -e match:"Invalid rule 'no rule here'" \
+        kyua test --changed-files=changed --dependency-manifest=deps.mk
+}
+
+
+utils_test_case max_failures__invalid
+max_failures__invalid_body() {
+    cat >Kyuafile <<EOF
+syntax(2)
+test_suite("integration")
+EOF
+
+    cat >experr <<EOF
+Usage error for command test: Invalid value for --max-failures: 0; must be positive.
+Type 'kyua help test' for usage information.
+EOF
+    atf_check -s exit:3 -o empty -e file:experr kyua test --max-failures=0
+}
+
+
+utils_test_case repeat_flag__ok
+repeat_flag__ok_body() {
+    cat >Kyuafile <<EOF
+syntax(2)
+test_suite("integration")
+atf_test_program{name="simple_all_pass"}
+EOF
+    utils_cp_helper simple_all_pass .
+
+    atf_check -s exit:0 -o save:stdout -e empty kyua test --repeat=3
+    atf_check -s exit:0 -o match:'^3$' -e empty -x \
+        "grep -c '^simple_all_pass:pass  ->  passed' stdout"
+    atf_check -s exit:0 -o ignore -e empty grep '^6/6 passed (0 failed)$' \
+        stdout
+    atf_check -s exit:1 -o empty -e empty grep 'Flake rates' stdout
+
+    atf_check -s exit:0 -o match:'^6$' -e empty \
+        kyua db-exec --no-headers "SELECT COUNT(*) FROM test_cases"
+}
+
+
+utils_test_case repeat_flag__flake_rates
+repeat_flag__flake_rates_body() {
+    cat >Kyuafile <<EOF
+syntax(2)
+test_suite("integration")
+atf_test_program{name="simple_some_fail"}
+EOF
+    utils_cp_helper simple_some_fail .
+
+    atf_check -s exit:1 -o save:stdout -e empty kyua test --repeat=2
+    atf_check -s exit:0 -o ignore -e empty grep '^2/4 passed (2 failed)$' \
+        stdout
+    atf_check -s exit:0 -o ignore -e empty grep '^Flake rates:$' stdout
+    atf_check -s exit:0 -o ignore -e empty \
+        grep '^  simple_some_fail:fail  ->  2/2 failed (100%)$' stdout
+    atf_check -s exit:1 -o empty -e empty \
+        grep 'simple_some_fail:pass  ->  .*/' stdout
+}
+
+
+utils_test_case repeat_flag__flake_rates_variants
+repeat_flag__flake_rates_variants_body() {
+    cat >Kyuafile <<EOF
+syntax(2)
+test_suite("integration")
+plain_test_program{name="fail",
+                   variants={one={mode='one'}, two={mode='two'}}}
+EOF
+    printf '#! /bin/sh\nexit 1\n' >fail
+    chmod +x fail
+
+    atf_check -s exit:1 -o save:stdout -e empty kyua test --repeat=2
+    atf_check -s exit:0 -o ignore -e empty \
+        grep '^  fail\[one\]:main  ->  2/2 failed (100%)$' stdout
+    atf_check -s exit:0 -o ignore -e empty \
+        grep '^  fail\[two\]:main  ->  2/2 failed (100%)$' stdout
+}
+
+
+utils_test_case repeat_flag__invalid
+repeat_flag__invalid_body() {
+    cat >Kyuafile <<EOF
+syntax(2)
+test_suite("integration")
+EOF
+
+    atf_check -s exit:3 -o empty -e match:'Invalid value for --repeat: 0' \
+        kyua test --repeat=0
+}
+
+
+utils_test_case until_fail_flag
+until_fail_flag_body() {
+    cat >Kyuafile <<EOF
+syntax(2)
+test_suite("integration")
+atf_test_program{name="simple_some_fail"}
+EOF
+    utils_cp_helper simple_some_fail .
+
+    atf_check -s exit:1 -o save:stdout -e empty kyua -v parallelism=1 test \
+        --until-fail
+    atf_check -s exit:0 -o match:'^1$' -e empty -x \
+        "grep -c '^simple_some_fail:fail  ->  failed' stdout"
+    atf_check -s exit:0 -o ignore -e empty \
+        grep '^  simple_some_fail:fail  ->  1/1 failed (100%)$' stdout
+}
+
+
+utils_test_case until_fail_flag__exclusive
+until_fail_flag__exclusive_body() {
+    cat >Kyuafile <<EOF
+syntax(2)
+test_suite("integration")
+plain_test_program{name="fail"}
+plain_test_program{name="exclusive", is_exclusive=true}
+EOF
+    printf '#! /bin/sh\nexit 1\n' >fail
+    printf '#! /bin/sh\nexit 0\n' >exclusive
+    chmod +x fail exclusive
+
+    atf_check -s exit:1 -o save:stdout -e empty kyua test --until-fail
+    atf_check -s exit:0 -o match:'^1$' -e empty -x \
+        "grep -c '^fail:main  ->  failed' stdout"
+    atf_check -s exit:0 -o match:'^1$' -e empty -x \
+        "grep -c '^exclusive:main  ->  passed' stdout"
+}
+
+
+utils_test_case watch_inputs_flag
+watch_inputs_flag_body() {
+    cat >Kyuafile <<EOF
+syntax(2)
+test_suite("integration")
+plain_test_program{name="first"}
+plain_test_program{name="second"}
+EOF
+    for name in first second; do
+        printf '#! /bin/sh\nexit 0\n' >"${name}"
+        chmod +x "${name}"
+    done
+
+    # The test program that is not fed only runs once the input is closed.
+    atf_check -s exit:0 -o save:stdout -e empty -x \
+        "{ echo second; sleep 1; } | kyua -v parallelism=1 test --watch-inputs"
+    atf_check -s exit:0 -o inline:"second:main\nfirst:main\n" -e empty \
+        grep -o '^[a-z]*:main' stdout
+    atf_check -s exit:0 -o ignore -e empty grep '^2/2 passed (0 failed)$' \
+        stdout
+}
+
+
+utils_test_case retries
+retries_body() {
+    cat >Kyuafile <<EOF
+syntax(2)
+test_suite("integration")
+plain_test_program{name="flaky", max_retries=2}
+plain_test_program{name="failing"}
+EOF
+    cat >flaky <<EOF
+#! /bin/sh
+attempts=\$(cat "$(pwd)/attempts" 2>/dev/null || echo 0)
+echo \$((attempts + 1)) >"$(pwd)/attempts"
+[ \${attempts} -ge 2 ]
+EOF
+    chmod +x flaky
+    echo '#! /bin/sh' >failing
+    echo 'exit 1' >>failing
+    chmod +x failing
+
+    atf_check -s exit:1 -o save:stdout -e empty kyua test
+    atf_check -s exit:0 -o ignore -e empty grep '^flaky:main  ->  passed' stdout
+    atf_check -s exit:0 -o ignore -e empty grep '^failing:main  ->  failed' \
+        stdout
+    atf_check -s exit:0 -o inline:"3\n" -e empty cat attempts
+    atf_check -s exit:0 -o inline:"3\n" -e empty kyua db-exec --no-headers \
+        "SELECT MAX(attempt) FROM test_results"
+    atf_check -s exit:0 -o inline:"2\n" -e empty kyua db-exec --no-headers \
+        "SELECT COUNT(*) FROM test_retried_results"
+
+    rm attempts
+    atf_check -s exit:1 -o save:stdout -e empty kyua -v max_retries=1 test
+    atf_check -s exit:0 -o ignore -e empty grep '^flaky:main  ->  passed' stdout
+    atf_check -s exit:0 -o inline:"3\n" -e empty kyua db-exec --no-headers \
+        "SELECT COUNT(*) FROM test_retried_results"
+}
+
+
+utils_test_case max_consecutive_broken
+max_consecutive_broken_body() {
+    cat >Kyuafile <<EOF
+syntax(2)
+test_suite("integration")
+atf_test_program{name="broken"}
+atf_test_program{name="fine"}
+EOF
+    cat >broken <<EOF
+#! /bin/sh
+if [ "\${1}" = -l ]; then
+    echo 'Content-Type: application/X-atf-tp; version="1"'
+    for name in first second third fourth; do
+        echo
+        echo "ident: \${name}"
+    done
+    exit 0
+fi
+echo run >>"$(pwd)/runs"
+exit 1
+EOF
+    chmod +x broken
+    utils_cp_helper simple_all_pass fine
+
+    atf_check -s exit:1 -o save:stdout -e empty kyua -v parallelism=1 test
+    atf_check -s exit:0 -o inline:"4\n" -e empty -x \
+        "grep -c '^broken:.*  ->  broken: Premature exit' stdout"
+    atf_check -s exit:0 -o ignore -e empty grep '^fine:pass  ->  passed' stdout
+
+    rm runs
+    atf_check -s exit:1 -o save:stdout -e empty kyua -v parallelism=1 \
+        -v max_consecutive_broken=2 test
+    atf_check -s exit:0 -o inline:"2\n" -e empty -x "wc -l <runs | tr -d ' '"
+    atf_check -s exit:0 -o inline:"2\n" -e empty -x \
+        "grep -c '^broken:.*  ->  broken: Not run; the previous 2 test cases' stdout"
+    atf_check -s exit:0 -o ignore -e empty grep '^fine:pass  ->  passed' stdout
+}
+
+
 utils_test_case no_test_program_match
 no_test_program_match_body() {
     utils_install_stable_test_wrapper
@@ -1047,6 +1894,11 @@ atf_init_test_cases() {
     atf_add_test_case results_file__ok
     atf_add_test_case results_file__fail
     atf_add_test_case results_file__reuse
+    atf_add_test_case results_file__in_memory
+    atf_add_test_case store_in_memory
+    atf_add_test_case report__several
+    atf_add_test_case report__in_memory
+    atf_add_test_case report__invalid
 
     atf_add_test_case build_root_flag
 
@@ -1056,6 +1908,39 @@ atf_init_test_cases() {
     atf_add_test_case interrupt
 
     atf_add_test_case exclusive_tests
+    atf_add_test_case exclusive_group_tests
+    atf_add_test_case max_parallel
+    atf_add_test_case max_parallel__invalid
+    atf_add_test_case required_cpus
+    atf_add_test_case parallelism__auto
+    atf_add_test_case cpu_affinity
+
+    atf_add_test_case claims_directory__skip_claimed
+    atf_add_test_case claims_directory__shared_run
+
+    atf_add_test_case cache_results__skip_unchanged
+    atf_add_test_case cache_results__disabled
+    atf_add_test_case failed_first
+    atf_add_test_case fail_fast
+    atf_add_test_case resume
+    atf_add_test_case upload
+    atf_add_test_case max_failures__invalid
+    atf_add_test_case repeat_flag__ok
+    atf_add_test_case repeat_flag__flake_rates
+    atf_add_test_case repeat_flag__flake_rates_variants
+    atf_add_test_case repeat_flag__invalid
+    atf_add_test_case until_fail_flag
+    atf_add_test_case until_fail_flag__exclusive
+    atf_add_test_case watch_inputs_flag
+    atf_add_test_case stats
+    atf_add_test_case compact
+    atf_add_test_case ordered_output
+    atf_add_test_case stream_output
+    atf_add_test_case metrics_file
+    atf_add_test_case changed_files
+    atf_add_test_case changed_files__invalid
+    atf_add_test_case retries
+    atf_add_test_case max_consecutive_broken
 
     atf_add_test_case no_test_program_match
     atf_add_test_case no_test_case_match
@@ -0,0 +1,69 @@
+dnl Copyright 2026 The Kyua Authors.
+dnl All rights reserved.
+dnl
+dnl Redistribution and use in source and binary forms, with or without
+dnl modification, are permitted provided that the following conditions are
+dnl met:
+dnl
+dnl * Redistributions of source code must retain the above copyright
+dnl   notice, this list of conditions and the following disclaimer.
+dnl * Redistributions in binary form must reproduce the above copyright
+dnl   notice, this list of conditions and the following disclaimer in the
+dnl   documentation and/or other materials provided with the distribution.
+dnl * Neither the name of Google Inc. nor the names of its contributors
+dnl   may be used to endorse or promote products derived from this software
+dnl   without specific prior written permission.
+dnl
+dnl THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+dnl "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+dnl LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+dnl A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+dnl OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+dnl SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+dnl LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+dnl DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+dnl THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+dnl (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+dnl OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+dnl \file m4/crash-handler.m4
+dnl
+dnl Macros to configure the build of utils/crash_handler.so.
+
+
+dnl Detects if the preloadable crash handler can be built.
+dnl
+dnl The crash handler needs backtrace(3) and backtrace_symbols_fd(3), which
+dnl live in libc on glibc-based systems and in libexecinfo elsewhere.
+dnl
+dnl Defines the WITH_CRASH_HANDLER conditional and substitutes
+dnl CRASH_HANDLER_LIBS with the libraries needed to link the handler.
+AC_DEFUN([KYUA_CRASH_HANDLER], [
+    AC_CHECK_HEADERS([execinfo.h])
+
+    crash_handler_libs=none
+    if test "${ac_cv_header_execinfo_h}" = yes; then
+        kyua_save_LIBS="${LIBS}"
+        for lib in "" "-lexecinfo"; do
+            LIBS="${kyua_save_LIBS} ${lib}"
+            AC_LINK_IFELSE([AC_LANG_PROGRAM([#include <execinfo.h>], [
+    void* frames[[4]];
+    backtrace_symbols_fd(frames, backtrace(frames, 4), 2);
+])], [crash_handler_libs="${lib}"; break], [])
+        done
+        LIBS="${kyua_save_LIBS}"
+    fi
+
+    AC_MSG_CHECKING([whether to build the crash handler])
+    if test "${crash_handler_libs}" = none; then
+        AC_MSG_RESULT([no])
+        AC_MSG_WARN([backtrace(3) not found; stack traces will need GDB])
+        CRASH_HANDLER_LIBS=
+    else
+        AC_MSG_RESULT([yes])
+        CRASH_HANDLER_LIBS="${crash_handler_libs}"
+    fi
+    AC_SUBST([CRASH_HANDLER_LIBS])
+    AM_CONDITIONAL([WITH_CRASH_HANDLER],
+                   [test "${crash_handler_libs}" != none])
+])
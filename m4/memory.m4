@@ -34,7 +34,8 @@ dnl Macros to configure the utils::memory module.
 dnl Entry point to detect all features needed by utils::memory.
 dnl
 dnl This looks for a mechanism to check the available physical memory in the
-dnl system.
+dnl system: a sysctl(3) MIB on the BSDs and Darwin, or the _SC_PHYS_PAGES
+dnl sysconf(3) variable available on Linux and Solaris otherwise.
 AC_DEFUN([KYUA_MEMORY], [
     memory_query=unknown
     memory_mib=none
@@ -52,6 +53,10 @@ AC_DEFUN([KYUA_MEMORY], [
         fi
     fi
 
+    if test "${memory_query}" = unknown; then
+        _KYUA_SYSCONF_PHYS_PAGES([memory_query=sysconf], [])
+    fi
+
     if test "${memory_query}" = unknown; then
         AC_MSG_WARN([Don't know how to query the amount of physical memory])
         AC_MSG_WARN([The test case's require.memory property will not work])
@@ -76,6 +81,34 @@ AC_DEFUN([_KYUA_SYSCTLBYNAME], [
 ])
 
 
+dnl Detects the availability of the _SC_PHYS_PAGES sysconf(3) variable.
+dnl
+dnl \param action_if_found Code to run if the variable is found.
+dnl \param action_if_not_found Code to run if the variable is not found.
+AC_DEFUN([_KYUA_SYSCONF_PHYS_PAGES], [
+    AC_CACHE_CHECK(
+        [for the _SC_PHYS_PAGES sysconf variable],
+        [kyua_cv_sysconf_phys_pages], [
+        AC_RUN_IFELSE([AC_LANG_PROGRAM([
+#include <stdlib.h>
+#include <unistd.h>
+], [
+    if (sysconf(_SC_PHYS_PAGES) <= 0 || sysconf(_SC_PAGESIZE) <= 0)
+        return EXIT_FAILURE;
+    else
+        return EXIT_SUCCESS;
+])],
+        [kyua_cv_sysconf_phys_pages=yes],
+        [kyua_cv_sysconf_phys_pages=no])
+    ])
+    if test "${kyua_cv_sysconf_phys_pages}" = yes; then
+        m4_default([$1], [:])
+    else
+        m4_default([$2], [:])
+    fi
+])
+
+
 dnl Looks for a specific sysctl MIB.
 dnl
 dnl \pre sysctlbyname(3) must be present in the system.
@@ -0,0 +1,70 @@
+dnl Copyright 2026 The Kyua Authors.
+dnl All rights reserved.
+dnl
+dnl Redistribution and use in source and binary forms, with or without
+dnl modification, are permitted provided that the following conditions are
+dnl met:
+dnl
+dnl * Redistributions of source code must retain the above copyright
+dnl   notice, this list of conditions and the following disclaimer.
+dnl * Redistributions in binary form must reproduce the above copyright
+dnl   notice, this list of conditions and the following disclaimer in the
+dnl   documentation and/or other materials provided with the distribution.
+dnl * Neither the name of Google Inc. nor the names of its contributors
+dnl   may be used to endorse or promote products derived from this software
+dnl   without specific prior written permission.
+dnl
+dnl THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+dnl "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+dnl LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+dnl A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+dnl OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+dnl SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+dnl LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+dnl DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+dnl THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+dnl (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+dnl OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+dnl \file m4/profiler.m4
+dnl
+dnl Macros to configure the built-in profiler of kyua.
+
+
+dnl Detects if the built-in profiler can be built.
+dnl
+dnl The profiler walks the stack with backtrace(3), so it depends on the same
+dnl libraries as the crash handler, and symbolizes the frames with dladdr(3),
+dnl which lives in libdl on older glibc-based systems.  KYUA_CRASH_HANDLER must
+dnl have been called before this.
+dnl
+dnl Defines HAVE_PROFILER and substitutes PROFILER_LIBS with the libraries
+dnl needed to link the profiler.
+AC_DEFUN([KYUA_PROFILER], [
+    AC_REQUIRE([KYUA_CRASH_HANDLER])
+
+    profiler_libs=none
+    if test "${crash_handler_libs}" != none; then
+        kyua_save_LIBS="${LIBS}"
+        for lib in "" "-ldl"; do
+            LIBS="${kyua_save_LIBS} ${crash_handler_libs} ${lib}"
+            AC_LINK_IFELSE([AC_LANG_PROGRAM([#include <dlfcn.h>], [
+    Dl_info info;
+    return dladdr((void*)0, &info);
+])], [profiler_libs="${crash_handler_libs} ${lib}"; break], [])
+        done
+        LIBS="${kyua_save_LIBS}"
+    fi
+
+    AC_MSG_CHECKING([whether to build the profiler])
+    if test "${profiler_libs}" = none; then
+        AC_MSG_RESULT([no])
+        PROFILER_LIBS=
+    else
+        AC_MSG_RESULT([yes])
+        AC_DEFINE([HAVE_PROFILER], [1],
+                  [Define to 1 if the built-in profiler can be built])
+        PROFILER_LIBS="${profiler_libs}"
+    fi
+    AC_SUBST([PROFILER_LIBS])
+])
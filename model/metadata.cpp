@@ -28,20 +28,20 @@
 
 #include "model/metadata.hpp"
 
+#include <cstddef>
+#include <cstring>
 #include <memory>
 
 #include "model/exceptions.hpp"
 #include "model/types.hpp"
 #include "utils/config/exceptions.hpp"
 #include "utils/config/nodes.ipp"
-#include "utils/config/tree.ipp"
 #include "utils/datetime.hpp"
 #include "utils/defs.hpp"
 #include "utils/format/macros.hpp"
 #include "utils/fs/exceptions.hpp"
 #include "utils/fs/path.hpp"
 #include "utils/noncopyable.hpp"
-#include "utils/optional.ipp"
 #include "utils/sanity.hpp"
 #include "utils/text/exceptions.hpp"
 #include "utils/text/operations.hpp"
@@ -53,19 +53,10 @@ namespace fs = utils::fs;
 namespace text = utils::text;
 namespace units = utils::units;
 
-using utils::optional;
-
 
 namespace {
 
 
-/// Global instance of defaults.
-///
-/// This exists so that the getters in metadata can return references instead
-/// of object copies.  Use get_defaults() to query.
-static optional< config::tree > defaults;
-
-
 /// A leaf node that holds a bytes quantity.
 class bytes_node : public config::native_leaf_node< units::bytes > {
 public:
@@ -166,6 +157,33 @@ public:
 };
 
 
+/// A leaf node that holds a non-negative count.
+class count_node : public config::int_node {
+    /// Copies the node.
+    ///
+    /// \return A dynamically-allocated node.
+    virtual base_node*
+    deep_copy(void) const
+    {
+        std::auto_ptr< count_node > new_node(new count_node());
+        new_node->_value = _value;
+        return new_node.release();
+    }
+
+    /// Checks a given count for validity.
+    ///
+    /// \param count The value to validate.
+    ///
+    /// \throw config::value_error If the value is not valid.
+    void
+    validate(const value_type& count) const
+    {
+        if (count < 0)
+            throw config::value_error("Must be a non-negative integer");
+    }
+};
+
+
 /// A leaf node that holds a "required user" property.
 ///
 /// This node is just a string, but it provides validation of the only allowed
@@ -196,6 +214,33 @@ class user_node : public config::string_node {
 };
 
 
+/// A leaf node that holds the priority class of a test.
+class priority_node : public config::string_node {
+    /// Copies the node.
+    ///
+    /// \return A dynamically-allocated node.
+    virtual base_node*
+    deep_copy(void) const
+    {
+        std::auto_ptr< priority_node > new_node(new priority_node());
+        new_node->_value = _value;
+        return new_node.release();
+    }
+
+    /// Checks a given priority class textual representation for validity.
+    ///
+    /// \param priority The value to validate.
+    ///
+    /// \throw config::value_error If the value is not valid.
+    void
+    validate(const value_type& priority) const
+    {
+        if (priority != "high" && priority != "normal" && priority != "low")
+            throw config::value_error("Invalid priority value");
+    }
+};
+
+
 /// A leaf node that holds a set of paths.
 ///
 /// This node type is used to represent the value of the required files and
@@ -249,116 +294,151 @@ class paths_set_node : public config::base_set_node< fs::path > {
 };
 
 
-/// Initializes a tree to hold test case requirements.
-///
-/// \param [in,out] tree The tree to initialize.
-static void
-init_tree(config::tree& tree)
-{
-    tree.define< config::strings_set_node >("allowed_architectures");
-    tree.define< config::strings_set_node >("allowed_platforms");
-    tree.define_dynamic("custom");
-    tree.define< config::string_node >("description");
-    tree.define< config::bool_node >("has_cleanup");
-    tree.define< config::bool_node >("is_exclusive");
-    tree.define< config::strings_set_node >("required_configs");
-    tree.define< bytes_node >("required_disk_space");
-    tree.define< paths_set_node >("required_files");
-    tree.define< bytes_node >("required_memory");
-    tree.define< paths_set_node >("required_programs");
-    tree.define< user_node >("required_user");
-    tree.define< delta_node >("timeout");
-}
+/// Identifiers of the metadata properties other than the custom ones.
+///
+/// These are used as bit indexes to track which properties have been
+/// explicitly set in a metadata object.
+enum property_id {
+    allowed_architectures_id,
+    allowed_platforms_id,
+    description_id,
+    exclusive_group_id,
+    fixtures_id,
+    has_cleanup_id,
+    is_exclusive_id,
+    is_idempotent_id,
+    max_output_size_id,
+    max_retries_id,
+    priority_id,
+    required_configs_id,
+    required_cpus_id,
+    required_disk_space_id,
+    required_files_id,
+    required_memory_id,
+    required_programs_id,
+    required_user_id,
+    timeout_id,
+};
 
 
-/// Sets default values on a tree object.
-///
-/// \param [in,out] tree The tree to configure.
-static void
-set_defaults(config::tree& tree)
-{
-    tree.set< config::strings_set_node >("allowed_architectures",
-                                         model::strings_set());
-    tree.set< config::strings_set_node >("allowed_platforms",
-                                         model::strings_set());
-    tree.set< config::string_node >("description", "");
-    tree.set< config::bool_node >("has_cleanup", false);
-    tree.set< config::bool_node >("is_exclusive", false);
-    tree.set< config::strings_set_node >("required_configs",
-                                         model::strings_set());
-    tree.set< bytes_node >("required_disk_space", units::bytes(0));
-    tree.set< paths_set_node >("required_files", model::paths_set());
-    tree.set< bytes_node >("required_memory", units::bytes(0));
-    tree.set< paths_set_node >("required_programs", model::paths_set());
-    tree.set< user_node >("required_user", "");
-    // TODO(jmmv): We shouldn't be setting a default timeout like this.  See
-    // Issue 5 for details.
-    tree.set< delta_node >("timeout", datetime::delta(300, 0));
-}
+/// Names of the metadata properties, indexed by their property_id.
+static const char* const property_names[] = {
+    "allowed_architectures",
+    "allowed_platforms",
+    "description",
+    "exclusive_group",
+    "fixtures",
+    "has_cleanup",
+    "is_exclusive",
+    "is_idempotent",
+    "max_output_size",
+    "max_retries",
+    "priority",
+    "required_configs",
+    "required_cpus",
+    "required_disk_space",
+    "required_files",
+    "required_memory",
+    "required_programs",
+    "required_user",
+    "timeout",
+};
+
+
+/// Number of entries in property_names.
+static const std::size_t num_properties =
+    sizeof(property_names) / sizeof(property_names[0]);
+
 
+/// Prefix of the names of the user-defined properties.
+static const char* const custom_prefix = "custom.";
 
-/// Queries the global defaults tree object with lazy initialization.
+
+/// Looks up the identifier of a metadata property.
+///
+/// \param key The name of the property.
 ///
-/// \return A metadata tree.  This object is statically allocated so it is
-/// acceptable to obtain references to it and its members.
-const config::tree&
-get_defaults(void)
+/// \return The identifier of the property.
+///
+/// \throw model::format_error If the key is not known.
+static property_id
+find_property(const std::string& key)
 {
-    if (!defaults) {
-        config::tree props;
-        init_tree(props);
-        set_defaults(props);
-        defaults = props;
+    for (std::size_t i = 0; i < num_properties; ++i) {
+        if (key == property_names[i])
+            return static_cast< property_id >(i);
     }
-    return defaults.get();
+    throw model::format_error(F("Unknown metadata property %s") % key);
 }
 
 
-/// Looks up a value in a tree with error rewriting.
+/// Checks the value of a property for validity.
+///
+/// This relies on the validation rules of the node types that describe
+/// properties in configuration trees, so that the metadata of a test is
+/// subject to the same rules as the rest of the configuration.
 ///
-/// \tparam NodeType The type of the node.
-/// \param tree The tree in which to insert the value.
-/// \param key The key to set.
+/// \tparam NodeType The type of the node describing the property.
+/// \param id The property to check.
+/// \param value The value to check.
 ///
-/// \return A read-write reference to the value in the node.
+/// \return The value, for convenience.
 ///
-/// \throw model::error If the key is not known or if the value is not valid.
+/// \throw model::error If the value is not valid.
 template< class NodeType >
-typename NodeType::value_type&
-lookup_rw(config::tree& tree, const std::string& key)
+const typename NodeType::value_type&
+validate(const property_id id, const typename NodeType::value_type& value)
 {
+    NodeType node;
     try {
-        return tree.lookup_rw< NodeType >(key);
-    } catch (const config::unknown_key_error& e) {
-        throw model::error(F("Unknown metadata property %s") % key);
+        node.set(value);
     } catch (const config::value_error& e) {
         throw model::error(F("Invalid value for metadata property %s: %s") %
-                            key % e.what());
+                           property_names[id] % e.what());
     }
+    return value;
 }
 
 
-/// Sets a value in a tree with error rewriting.
+/// Parses the textual representation of the value of a property.
 ///
-/// \tparam NodeType The type of the node.
-/// \param tree The tree in which to insert the value.
-/// \param key The key to set.
-/// \param value The value to set the node to.
+/// \tparam NodeType The type of the node describing the property.
+/// \param id The property to parse.
+/// \param raw_value The textual representation of the value.
 ///
-/// \throw model::error If the key is not known or if the value is not valid.
+/// \return The parsed value.
+///
+/// \throw config::invalid_key_value If the value is not valid.  This is the
+///     same error that setting the property in a configuration tree raises,
+///     which callers parsing external data rely on.
 template< class NodeType >
-void
-set(config::tree& tree, const std::string& key,
-    const typename NodeType::value_type& value)
+typename NodeType::value_type
+parse(const property_id id, const std::string& raw_value)
 {
+    NodeType node;
     try {
-        tree.set< NodeType >(key, value);
-    } catch (const config::unknown_key_error& e) {
-        throw model::error(F("Unknown metadata property %s") % key);
+        node.set_string(raw_value);
     } catch (const config::value_error& e) {
-        throw model::error(F("Invalid value for metadata property %s: %s") %
-                            key % e.what());
+        throw config::invalid_key_value(
+            config::detail::tree_key(1, property_names[id]), e.what());
     }
+    return node.value();
+}
+
+
+/// Formats the value of a property as text.
+///
+/// \tparam NodeType The type of the node describing the property.
+/// \param value The value to format.
+///
+/// \return The textual representation of the value, which parse() accepts.
+template< class NodeType >
+std::string
+format(const typename NodeType::value_type& value)
+{
+    NodeType node;
+    node.set(value);
+    return node.to_string();
 }
 
 
@@ -366,37 +446,202 @@ set(config::tree& tree, const std::string& key,
 
 
 /// Internal implementation of the metadata class.
-struct model::metadata::impl : utils::noncopyable {
-    /// Metadata properties.
-    config::tree props;
+///
+/// Properties are held in plain fields, which start with their default values,
+/// instead of in a configuration tree: a test suite carries one of these per
+/// test case and a tree needs a dynamically-allocated node per property.
+struct model::metadata::impl {
+    /// Bitmask of the properties explicitly set, indexed by property_id.
+    ///
+    /// Only these properties take effect when this object is used to override
+    /// the properties of another one.
+    unsigned long set_properties;
 
-    /// Constructor.
+    /// Architectures allowed by the test.
+    model::strings_set allowed_architectures;
+
+    /// Platforms allowed by the test.
+    model::strings_set allowed_platforms;
+
+    /// User-defined properties, without their custom_prefix.
+    model::properties_map custom;
+
+    /// Textual description of the test.
+    std::string description;
+
+    /// Name of the resource the test needs exclusive access to.
+    std::string exclusive_group;
+
+    /// Files and directories to copy into the work directory of the test.
+    model::paths_set fixtures;
+
+    /// Whether the test has a cleanup part.
+    bool has_cleanup;
+
+    /// Whether the test has to run on its own.
+    bool is_exclusive;
+
+    /// Whether the test can run more than once concurrently.
+    bool is_idempotent;
+
+    /// Maximum size of each of the output files of the test.
+    units::bytes max_output_size;
+
+    /// Number of times to rerun the test if it fails.
+    int max_retries;
+
+    /// Priority class of the test.
+    std::string priority;
+
+    /// Configuration variables needed by the test.
+    model::strings_set required_configs;
+
+    /// Number of CPUs kept busy by the test.
+    int required_cpus;
+
+    /// Amount of free disk space required by the test.
+    units::bytes required_disk_space;
+
+    /// Files needed by the test.
+    model::paths_set required_files;
+
+    /// Amount of memory required by the test.
+    units::bytes required_memory;
+
+    /// Programs needed by the test.
+    model::paths_set required_programs;
+
+    /// User required by the test.
+    std::string required_user;
+
+    /// Timeout of the test.
+    datetime::delta timeout;
+
+    /// Constructor for an object with all properties set to their defaults.
+    impl(void) :
+        set_properties(0),
+        has_cleanup(false),
+        is_exclusive(false),
+        is_idempotent(false),
+        max_output_size(0),
+        max_retries(0),
+        priority("normal"),
+        required_cpus(0),
+        required_disk_space(0),
+        required_memory(0),
+        // TODO(jmmv): We shouldn't be setting a default timeout like this.
+        // See Issue 5 for details.
+        timeout(300, 0)
+    {
+    }
+
+    /// Checks whether a property has been explicitly set.
+    ///
+    /// \param id The property to check.
     ///
-    /// \param props_ Metadata properties of the test.
-    impl(const utils::config::tree& props_) :
-        props(props_)
+    /// \return True if the property has been set.
+    bool
+    is_set(const property_id id) const
     {
+        return (set_properties & (1UL << id)) != 0;
+    }
+
+    /// Marks a property as explicitly set.
+    ///
+    /// \param id The property to mark.
+    void
+    mark_set(const property_id id)
+    {
+        set_properties |= 1UL << id;
+    }
+
+    /// Checks whether no property has been explicitly set.
+    ///
+    /// \return True if all properties have their default values.
+    bool
+    is_default(void) const
+    {
+        return set_properties == 0 && custom.empty();
+    }
+
+    /// Overrides the properties of this object with another one's.
+    ///
+    /// \param other The object whose explicitly-set properties to apply.
+    void
+    apply(const impl& other)
+    {
+#define APPLY(name) \
+        if (other.is_set(name ## _id)) \
+            name = other.name
+
+        APPLY(allowed_architectures);
+        APPLY(allowed_platforms);
+        APPLY(description);
+        APPLY(exclusive_group);
+        APPLY(fixtures);
+        APPLY(has_cleanup);
+        APPLY(is_exclusive);
+        APPLY(is_idempotent);
+        APPLY(max_output_size);
+        APPLY(max_retries);
+        APPLY(priority);
+        APPLY(required_configs);
+        APPLY(required_cpus);
+        APPLY(required_disk_space);
+        APPLY(required_files);
+        APPLY(required_memory);
+        APPLY(required_programs);
+        APPLY(required_user);
+        APPLY(timeout);
+
+#undef APPLY
+
+        for (model::properties_map::const_iterator iter = other.custom.begin();
+             iter != other.custom.end(); ++iter)
+            custom[(*iter).first] = (*iter).second;
+        set_properties |= other.set_properties;
     }
 
     /// Equality comparator.
     ///
     /// \param other The other object to compare this one to.
     ///
-    /// \return True if this object and other are equal; false otherwise.
+    /// \return True if the values of all the properties of this object and
+    /// other are equal, regardless of whether they were explicitly set or not;
+    /// false otherwise.
     bool
     operator==(const impl& other) const
     {
-        return (get_defaults().combine(props) ==
-                get_defaults().combine(other.props));
+        return (allowed_architectures == other.allowed_architectures &&
+                allowed_platforms == other.allowed_platforms &&
+                custom == other.custom &&
+                description == other.description &&
+                exclusive_group == other.exclusive_group &&
+                fixtures == other.fixtures &&
+                has_cleanup == other.has_cleanup &&
+                is_exclusive == other.is_exclusive &&
+                is_idempotent == other.is_idempotent &&
+                max_output_size == other.max_output_size &&
+                max_retries == other.max_retries &&
+                priority == other.priority &&
+                required_configs == other.required_configs &&
+                required_cpus == other.required_cpus &&
+                required_disk_space == other.required_disk_space &&
+                required_files == other.required_files &&
+                required_memory == other.required_memory &&
+                required_programs == other.required_programs &&
+                required_user == other.required_user &&
+                timeout == other.timeout);
     }
 };
 
 
 /// Constructor.
 ///
-/// \param props Metadata properties of the test.
-model::metadata::metadata(const utils::config::tree& props) :
-    _pimpl(new impl(props))
+/// \param pimpl_ Metadata properties of the test, which may be shared with
+///     other metadata objects.
+model::metadata::metadata(const std::shared_ptr< impl >& pimpl_) :
+    _pimpl(pimpl_)
 {
 }
 
@@ -416,7 +661,12 @@ model::metadata::~metadata(void)
 model::metadata
 model::metadata::apply_overrides(const metadata& overrides) const
 {
-    return metadata(_pimpl->props.combine(overrides._pimpl->props));
+    if (overrides._pimpl->is_default())
+        return *this;
+
+    std::shared_ptr< impl > combined(new impl(*_pimpl));
+    combined->apply(*overrides._pimpl);
+    return metadata(combined);
 }
 
 
@@ -426,13 +676,7 @@ model::metadata::apply_overrides(const metadata& overrides) const
 const model::strings_set&
 model::metadata::allowed_architectures(void) const
 {
-    if (_pimpl->props.is_set("allowed_architectures")) {
-        return _pimpl->props.lookup< config::strings_set_node >(
-            "allowed_architectures");
-    } else {
-        return get_defaults().lookup< config::strings_set_node >(
-            "allowed_architectures");
-    }
+    return _pimpl->allowed_architectures;
 }
 
 
@@ -442,13 +686,7 @@ model::metadata::allowed_architectures(void) const
 const model::strings_set&
 model::metadata::allowed_platforms(void) const
 {
-    if (_pimpl->props.is_set("allowed_platforms")) {
-        return _pimpl->props.lookup< config::strings_set_node >(
-            "allowed_platforms");
-    } else {
-        return get_defaults().lookup< config::strings_set_node >(
-            "allowed_platforms");
-    }
+    return _pimpl->allowed_platforms;
 }
 
 
@@ -458,7 +696,7 @@ model::metadata::allowed_platforms(void) const
 model::properties_map
 model::metadata::custom(void) const
 {
-    return _pimpl->props.all_properties("custom", true);
+    return _pimpl->custom;
 }
 
 
@@ -468,11 +706,30 @@ model::metadata::custom(void) const
 const std::string&
 model::metadata::description(void) const
 {
-    if (_pimpl->props.is_set("description")) {
-        return _pimpl->props.lookup< config::string_node >("description");
-    } else {
-        return get_defaults().lookup< config::string_node >("description");
-    }
+    return _pimpl->description;
+}
+
+
+/// Returns the name of the exclusive group of the test.
+///
+/// \return The name of a resource that the test needs exclusive access to: no
+/// two tests with the same group run concurrently.  Empty if the test can run
+/// concurrently with any other.
+const std::string&
+model::metadata::exclusive_group(void) const
+{
+    return _pimpl->exclusive_group;
+}
+
+
+/// Returns the fixtures to stage into the work directory of the test.
+///
+/// \return Set of files and directories; relative paths are relative to the
+/// directory containing the test program.
+const model::paths_set&
+model::metadata::fixtures(void) const
+{
+    return _pimpl->fixtures;
 }
 
 
@@ -482,11 +739,7 @@ model::metadata::description(void) const
 bool
 model::metadata::has_cleanup(void) const
 {
-    if (_pimpl->props.is_set("has_cleanup")) {
-        return _pimpl->props.lookup< config::bool_node >("has_cleanup");
-    } else {
-        return get_defaults().lookup< config::bool_node >("has_cleanup");
-    }
+    return _pimpl->has_cleanup;
 }
 
 
@@ -497,11 +750,50 @@ model::metadata::has_cleanup(void) const
 bool
 model::metadata::is_exclusive(void) const
 {
-    if (_pimpl->props.is_set("is_exclusive")) {
-        return _pimpl->props.lookup< config::bool_node >("is_exclusive");
-    } else {
-        return get_defaults().lookup< config::bool_node >("is_exclusive");
-    }
+    return _pimpl->is_exclusive;
+}
+
+
+/// Returns whether the test is idempotent or not.
+///
+/// \return True if the test can be run several times concurrently, with any
+/// of the runs standing for the others; false otherwise.
+bool
+model::metadata::is_idempotent(void) const
+{
+    return _pimpl->is_idempotent;
+}
+
+
+/// Returns the maximum size of each of the output files of the test.
+///
+/// \return Number of bytes of stdout and of stderr to keep, or 0 to use the
+/// limit configured by the user.
+const units::bytes&
+model::metadata::max_output_size(void) const
+{
+    return _pimpl->max_output_size;
+}
+
+
+/// Returns the number of times to rerun the test if it fails.
+///
+/// \return Number of extra attempts to give to a failed or broken test, or 0
+/// to use the limit configured by the user.
+int
+model::metadata::max_retries(void) const
+{
+    return _pimpl->max_retries;
+}
+
+
+/// Returns the priority class of the test.
+///
+/// \return One of high, normal or low.
+const std::string&
+model::metadata::priority(void) const
+{
+    return _pimpl->priority;
 }
 
 
@@ -511,13 +803,17 @@ model::metadata::is_exclusive(void) const
 const model::strings_set&
 model::metadata::required_configs(void) const
 {
-    if (_pimpl->props.is_set("required_configs")) {
-        return _pimpl->props.lookup< config::strings_set_node >(
-            "required_configs");
-    } else {
-        return get_defaults().lookup< config::strings_set_node >(
-            "required_configs");
-    }
+    return _pimpl->required_configs;
+}
+
+
+/// Returns the number of CPUs kept busy by the test.
+///
+/// \return Number of CPUs, or 0 if this does not apply.
+int
+model::metadata::required_cpus(void) const
+{
+    return _pimpl->required_cpus;
 }
 
 
@@ -527,11 +823,7 @@ model::metadata::required_configs(void) const
 const units::bytes&
 model::metadata::required_disk_space(void) const
 {
-    if (_pimpl->props.is_set("required_disk_space")) {
-        return _pimpl->props.lookup< bytes_node >("required_disk_space");
-    } else {
-        return get_defaults().lookup< bytes_node >("required_disk_space");
-    }
+    return _pimpl->required_disk_space;
 }
 
 
@@ -541,11 +833,7 @@ model::metadata::required_disk_space(void) const
 const model::paths_set&
 model::metadata::required_files(void) const
 {
-    if (_pimpl->props.is_set("required_files")) {
-        return _pimpl->props.lookup< paths_set_node >("required_files");
-    } else {
-        return get_defaults().lookup< paths_set_node >("required_files");
-    }
+    return _pimpl->required_files;
 }
 
 
@@ -555,11 +843,7 @@ model::metadata::required_files(void) const
 const units::bytes&
 model::metadata::required_memory(void) const
 {
-    if (_pimpl->props.is_set("required_memory")) {
-        return _pimpl->props.lookup< bytes_node >("required_memory");
-    } else {
-        return get_defaults().lookup< bytes_node >("required_memory");
-    }
+    return _pimpl->required_memory;
 }
 
 
@@ -569,11 +853,7 @@ model::metadata::required_memory(void) const
 const model::paths_set&
 model::metadata::required_programs(void) const
 {
-    if (_pimpl->props.is_set("required_programs")) {
-        return _pimpl->props.lookup< paths_set_node >("required_programs");
-    } else {
-        return get_defaults().lookup< paths_set_node >("required_programs");
-    }
+    return _pimpl->required_programs;
 }
 
 
@@ -583,11 +863,7 @@ model::metadata::required_programs(void) const
 const std::string&
 model::metadata::required_user(void) const
 {
-    if (_pimpl->props.is_set("required_user")) {
-        return _pimpl->props.lookup< user_node >("required_user");
-    } else {
-        return get_defaults().lookup< user_node >("required_user");
-    }
+    return _pimpl->required_user;
 }
 
 
@@ -598,11 +874,7 @@ model::metadata::required_user(void) const
 const datetime::delta&
 model::metadata::timeout(void) const
 {
-    if (_pimpl->props.is_set("timeout")) {
-        return _pimpl->props.lookup< delta_node >("timeout");
-    } else {
-        return get_defaults().lookup< delta_node >("timeout");
-    }
+    return _pimpl->timeout;
 }
 
 
@@ -612,8 +884,43 @@ model::metadata::timeout(void) const
 model::properties_map
 model::metadata::to_properties(void) const
 {
-    const config::tree fully_specified = get_defaults().combine(_pimpl->props);
-    return fully_specified.all_properties();
+    const impl& props = *_pimpl;
+
+    model::properties_map properties;
+    properties["allowed_architectures"] = format< config::strings_set_node >(
+        props.allowed_architectures);
+    properties["allowed_platforms"] = format< config::strings_set_node >(
+        props.allowed_platforms);
+    properties["description"] = props.description;
+    properties["exclusive_group"] = props.exclusive_group;
+    properties["fixtures"] = format< paths_set_node >(props.fixtures);
+    properties["has_cleanup"] = format< config::bool_node >(
+        props.has_cleanup);
+    properties["is_exclusive"] = format< config::bool_node >(
+        props.is_exclusive);
+    properties["is_idempotent"] = format< config::bool_node >(
+        props.is_idempotent);
+    properties["max_output_size"] = format< bytes_node >(
+        props.max_output_size);
+    properties["max_retries"] = format< count_node >(props.max_retries);
+    properties["priority"] = props.priority;
+    properties["required_configs"] = format< config::strings_set_node >(
+        props.required_configs);
+    properties["required_cpus"] = format< count_node >(props.required_cpus);
+    properties["required_disk_space"] = format< bytes_node >(
+        props.required_disk_space);
+    properties["required_files"] = format< paths_set_node >(
+        props.required_files);
+    properties["required_memory"] = format< bytes_node >(
+        props.required_memory);
+    properties["required_programs"] = format< paths_set_node >(
+        props.required_programs);
+    properties["required_user"] = props.required_user;
+    properties["timeout"] = format< delta_node >(props.timeout);
+    for (model::properties_map::const_iterator iter = props.custom.begin();
+         iter != props.custom.end(); ++iter)
+        properties[custom_prefix + (*iter).first] = (*iter).second;
+    return properties;
 }
 
 
@@ -671,7 +978,7 @@ model::operator<<(std::ostream& output, const metadata& object)
 /// Internal implementation of the metadata_builder class.
 struct model::metadata_builder::impl : utils::noncopyable {
     /// Collection of requirements.
-    config::tree props;
+    model::metadata::impl props;
 
     /// Whether we have created a metadata object or not.
     bool built;
@@ -680,12 +987,11 @@ struct model::metadata_builder::impl : utils::noncopyable {
     impl(void) :
         built(false)
     {
-        init_tree(props);
     }
 
     /// Constructor.
     impl(const model::metadata& base) :
-        props(base._pimpl->props.deep_copy()),
+        props(*base._pimpl),
         built(false)
     {
     }
@@ -722,14 +1028,8 @@ model::metadata_builder::~metadata_builder(void)
 model::metadata_builder&
 model::metadata_builder::add_allowed_architecture(const std::string& arch)
 {
-    if (!_pimpl->props.is_set("allowed_architectures")) {
-        _pimpl->props.set< config::strings_set_node >(
-            "allowed_architectures",
-            get_defaults().lookup< config::strings_set_node >(
-                "allowed_architectures"));
-    }
-    lookup_rw< config::strings_set_node >(
-        _pimpl->props, "allowed_architectures").insert(arch);
+    _pimpl->props.allowed_architectures.insert(arch);
+    _pimpl->props.mark_set(allowed_architectures_id);
     return *this;
 }
 
@@ -744,14 +1044,8 @@ model::metadata_builder::add_allowed_architecture(const std::string& arch)
 model::metadata_builder&
 model::metadata_builder::add_allowed_platform(const std::string& platform)
 {
-    if (!_pimpl->props.is_set("allowed_platforms")) {
-        _pimpl->props.set< config::strings_set_node >(
-            "allowed_platforms",
-            get_defaults().lookup< config::strings_set_node >(
-                "allowed_platforms"));
-    }
-    lookup_rw< config::strings_set_node >(
-        _pimpl->props, "allowed_platforms").insert(platform);
+    _pimpl->props.allowed_platforms.insert(platform);
+    _pimpl->props.mark_set(allowed_platforms_id);
     return *this;
 }
 
@@ -768,7 +1062,23 @@ model::metadata_builder&
 model::metadata_builder::add_custom(const std::string& key,
                                      const std::string& value)
 {
-    _pimpl->props.set_string(F("custom.%s") % key, value);
+    _pimpl->props.custom[key] = value;
+    return *this;
+}
+
+
+/// Accumulates an additional fixture.
+///
+/// \param path The path to the file or directory.
+///
+/// \return A reference to this builder.
+///
+/// \throw model::error If the value is invalid.
+model::metadata_builder&
+model::metadata_builder::add_fixture(const fs::path& path)
+{
+    _pimpl->props.fixtures.insert(path);
+    _pimpl->props.mark_set(fixtures_id);
     return *this;
 }
 
@@ -783,14 +1093,8 @@ model::metadata_builder::add_custom(const std::string& key,
 model::metadata_builder&
 model::metadata_builder::add_required_config(const std::string& var)
 {
-    if (!_pimpl->props.is_set("required_configs")) {
-        _pimpl->props.set< config::strings_set_node >(
-            "required_configs",
-            get_defaults().lookup< config::strings_set_node >(
-                "required_configs"));
-    }
-    lookup_rw< config::strings_set_node >(
-        _pimpl->props, "required_configs").insert(var);
+    _pimpl->props.required_configs.insert(var);
+    _pimpl->props.mark_set(required_configs_id);
     return *this;
 }
 
@@ -805,12 +1109,8 @@ model::metadata_builder::add_required_config(const std::string& var)
 model::metadata_builder&
 model::metadata_builder::add_required_file(const fs::path& path)
 {
-    if (!_pimpl->props.is_set("required_files")) {
-        _pimpl->props.set< paths_set_node >(
-            "required_files",
-            get_defaults().lookup< paths_set_node >("required_files"));
-    }
-    lookup_rw< paths_set_node >(_pimpl->props, "required_files").insert(path);
+    _pimpl->props.required_files.insert(path);
+    _pimpl->props.mark_set(required_files_id);
     return *this;
 }
 
@@ -825,13 +1125,8 @@ model::metadata_builder::add_required_file(const fs::path& path)
 model::metadata_builder&
 model::metadata_builder::add_required_program(const fs::path& path)
 {
-    if (!_pimpl->props.is_set("required_programs")) {
-        _pimpl->props.set< paths_set_node >(
-            "required_programs",
-            get_defaults().lookup< paths_set_node >("required_programs"));
-    }
-    lookup_rw< paths_set_node >(_pimpl->props,
-                                "required_programs").insert(path);
+    _pimpl->props.required_programs.insert(path);
+    _pimpl->props.mark_set(required_programs_id);
     return *this;
 }
 
@@ -847,7 +1142,9 @@ model::metadata_builder&
 model::metadata_builder::set_allowed_architectures(
     const model::strings_set& as)
 {
-    set< config::strings_set_node >(_pimpl->props, "allowed_architectures", as);
+    _pimpl->props.allowed_architectures = validate< config::strings_set_node >(
+        allowed_architectures_id, as);
+    _pimpl->props.mark_set(allowed_architectures_id);
     return *this;
 }
 
@@ -862,7 +1159,9 @@ model::metadata_builder::set_allowed_architectures(
 model::metadata_builder&
 model::metadata_builder::set_allowed_platforms(const model::strings_set& ps)
 {
-    set< config::strings_set_node >(_pimpl->props, "allowed_platforms", ps);
+    _pimpl->props.allowed_platforms = validate< config::strings_set_node >(
+        allowed_platforms_id, ps);
+    _pimpl->props.mark_set(allowed_platforms_id);
     return *this;
 }
 
@@ -879,8 +1178,7 @@ model::metadata_builder::set_custom(const model::properties_map& props)
 {
     for (model::properties_map::const_iterator iter = props.begin();
          iter != props.end(); ++iter)
-        _pimpl->props.set_string(F("custom.%s") % (*iter).first,
-                                 (*iter).second);
+        _pimpl->props.custom[(*iter).first] = (*iter).second;
     return *this;
 }
 
@@ -895,7 +1193,43 @@ model::metadata_builder::set_custom(const model::properties_map& props)
 model::metadata_builder&
 model::metadata_builder::set_description(const std::string& description)
 {
-    set< config::string_node >(_pimpl->props, "description", description);
+    _pimpl->props.description = validate< config::string_node >(
+        description_id, description);
+    _pimpl->props.mark_set(description_id);
+    return *this;
+}
+
+
+/// Sets the name of the exclusive group of the test.
+///
+/// \param group Name of the resource that the test needs exclusive access to,
+///     or empty if none.
+///
+/// \return A reference to this builder.
+///
+/// \throw model::error If the value is invalid.
+model::metadata_builder&
+model::metadata_builder::set_exclusive_group(const std::string& group)
+{
+    _pimpl->props.exclusive_group = validate< config::string_node >(
+        exclusive_group_id, group);
+    _pimpl->props.mark_set(exclusive_group_id);
+    return *this;
+}
+
+
+/// Sets the fixtures to stage into the work directory of the test.
+///
+/// \param paths Set of files and directories.
+///
+/// \return A reference to this builder.
+///
+/// \throw model::error If the value is invalid.
+model::metadata_builder&
+model::metadata_builder::set_fixtures(const model::paths_set& paths)
+{
+    _pimpl->props.fixtures = validate< paths_set_node >(fixtures_id, paths);
+    _pimpl->props.mark_set(fixtures_id);
     return *this;
 }
 
@@ -910,7 +1244,9 @@ model::metadata_builder::set_description(const std::string& description)
 model::metadata_builder&
 model::metadata_builder::set_has_cleanup(const bool cleanup)
 {
-    set< config::bool_node >(_pimpl->props, "has_cleanup", cleanup);
+    _pimpl->props.has_cleanup = validate< config::bool_node >(
+        has_cleanup_id, cleanup);
+    _pimpl->props.mark_set(has_cleanup_id);
     return *this;
 }
 
@@ -925,7 +1261,76 @@ model::metadata_builder::set_has_cleanup(const bool cleanup)
 model::metadata_builder&
 model::metadata_builder::set_is_exclusive(const bool exclusive)
 {
-    set< config::bool_node >(_pimpl->props, "is_exclusive", exclusive);
+    _pimpl->props.is_exclusive = validate< config::bool_node >(
+        is_exclusive_id, exclusive);
+    _pimpl->props.mark_set(is_exclusive_id);
+    return *this;
+}
+
+
+/// Sets whether the test is idempotent or not.
+///
+/// \param idempotent True if the test is idempotent; false otherwise.
+///
+/// \return A reference to this builder.
+///
+/// \throw model::error If the value is invalid.
+model::metadata_builder&
+model::metadata_builder::set_is_idempotent(const bool idempotent)
+{
+    _pimpl->props.is_idempotent = validate< config::bool_node >(
+        is_idempotent_id, idempotent);
+    _pimpl->props.mark_set(is_idempotent_id);
+    return *this;
+}
+
+
+/// Sets the maximum size of each of the output files of the test.
+///
+/// \param bytes Number of bytes, or 0 to use the limit configured by the user.
+///
+/// \return A reference to this builder.
+///
+/// \throw model::error If the value is invalid.
+model::metadata_builder&
+model::metadata_builder::set_max_output_size(const units::bytes& bytes)
+{
+    _pimpl->props.max_output_size = validate< bytes_node >(
+        max_output_size_id, bytes);
+    _pimpl->props.mark_set(max_output_size_id);
+    return *this;
+}
+
+
+/// Sets the number of times to rerun the test if it fails.
+///
+/// \param retries Number of extra attempts, or 0 to use the limit configured
+///     by the user.
+///
+/// \return A reference to this builder.
+///
+/// \throw model::error If the value is invalid.
+model::metadata_builder&
+model::metadata_builder::set_max_retries(const int retries)
+{
+    _pimpl->props.max_retries = validate< count_node >(max_retries_id, retries);
+    _pimpl->props.mark_set(max_retries_id);
+    return *this;
+}
+
+
+/// Sets the priority class of the test.
+///
+/// \param priority One of high, normal or low.
+///
+/// \return A reference to this builder.
+///
+/// \throw model::error If the value is invalid.
+model::metadata_builder&
+model::metadata_builder::set_priority(const std::string& priority)
+{
+    _pimpl->props.priority = validate< priority_node >(priority_id, priority);
+    _pimpl->props.mark_set(priority_id);
     return *this;
 }
 
@@ -940,7 +1345,26 @@ model::metadata_builder::set_is_exclusive(const bool exclusive)
 model::metadata_builder&
 model::metadata_builder::set_required_configs(const model::strings_set& vars)
 {
-    set< config::strings_set_node >(_pimpl->props, "required_configs", vars);
+    _pimpl->props.required_configs = validate< config::strings_set_node >(
+        required_configs_id, vars);
+    _pimpl->props.mark_set(required_configs_id);
+    return *this;
+}
+
+
+/// Sets the number of CPUs kept busy by the test.
+///
+/// \param cpus Number of CPUs, or 0 if this does not apply.
+///
+/// \return A reference to this builder.
+///
+/// \throw model::error If the value is invalid.
+model::metadata_builder&
+model::metadata_builder::set_required_cpus(const int cpus)
+{
+    _pimpl->props.required_cpus = validate< count_node >(required_cpus_id,
+                                                         cpus);
+    _pimpl->props.mark_set(required_cpus_id);
     return *this;
 }
 
@@ -955,7 +1379,9 @@ model::metadata_builder::set_required_configs(const model::strings_set& vars)
 model::metadata_builder&
 model::metadata_builder::set_required_disk_space(const units::bytes& bytes)
 {
-    set< bytes_node >(_pimpl->props, "required_disk_space", bytes);
+    _pimpl->props.required_disk_space = validate< bytes_node >(
+        required_disk_space_id, bytes);
+    _pimpl->props.mark_set(required_disk_space_id);
     return *this;
 }
 
@@ -970,7 +1396,9 @@ model::metadata_builder::set_required_disk_space(const units::bytes& bytes)
 model::metadata_builder&
 model::metadata_builder::set_required_files(const model::paths_set& files)
 {
-    set< paths_set_node >(_pimpl->props, "required_files", files);
+    _pimpl->props.required_files = validate< paths_set_node >(
+        required_files_id, files);
+    _pimpl->props.mark_set(required_files_id);
     return *this;
 }
 
@@ -985,7 +1413,9 @@ model::metadata_builder::set_required_files(const model::paths_set& files)
 model::metadata_builder&
 model::metadata_builder::set_required_memory(const units::bytes& bytes)
 {
-    set< bytes_node >(_pimpl->props, "required_memory", bytes);
+    _pimpl->props.required_memory = validate< bytes_node >(
+        required_memory_id, bytes);
+    _pimpl->props.mark_set(required_memory_id);
     return *this;
 }
 
@@ -1000,7 +1430,9 @@ model::metadata_builder::set_required_memory(const units::bytes& bytes)
 model::metadata_builder&
 model::metadata_builder::set_required_programs(const model::paths_set& progs)
 {
-    set< paths_set_node >(_pimpl->props, "required_programs", progs);
+    _pimpl->props.required_programs = validate< paths_set_node >(
+        required_programs_id, progs);
+    _pimpl->props.mark_set(required_programs_id);
     return *this;
 }
 
@@ -1015,7 +1447,8 @@ model::metadata_builder::set_required_programs(const model::paths_set& progs)
 model::metadata_builder&
 model::metadata_builder::set_required_user(const std::string& user)
 {
-    set< user_node >(_pimpl->props, "required_user", user);
+    _pimpl->props.required_user = validate< user_node >(required_user_id, user);
+    _pimpl->props.mark_set(required_user_id);
     return *this;
 }
 
@@ -1027,19 +1460,103 @@ model::metadata_builder::set_required_user(const std::string& user)
 ///
 /// \return A reference to this builder.
 ///
-/// \throw model::error If the value is invalid or the key does not exist.
+/// \throw model::format_error If the key does not exist.
+/// \throw utils::config::invalid_key_value If the value is invalid.
 model::metadata_builder&
 model::metadata_builder::set_string(const std::string& key,
                                     const std::string& value)
 {
-    try {
-        _pimpl->props.set_string(key, value);
-    } catch (const config::unknown_key_error& e) {
-        throw model::format_error(F("Unknown metadata property %s") % key);
-    } catch (const config::value_error& e) {
-        throw model::format_error(
-            F("Invalid value for metadata property %s: %s") % key % e.what());
+    if (key.compare(0, std::strlen(custom_prefix), custom_prefix) == 0) {
+        const std::string name = key.substr(std::strlen(custom_prefix));
+        if (name.empty())
+            throw model::format_error(F("Unknown metadata property %s") % key);
+        _pimpl->props.custom[name] = value;
+        return *this;
+    }
+
+    model::metadata::impl& props = _pimpl->props;
+    const property_id id = find_property(key);
+    switch (id) {
+    case allowed_architectures_id:
+        props.allowed_architectures = parse< config::strings_set_node >(
+            id, value);
+        break;
+
+    case allowed_platforms_id:
+        props.allowed_platforms = parse< config::strings_set_node >(
+            id, value);
+        break;
+
+    case description_id:
+        props.description = parse< config::string_node >(id, value);
+        break;
+
+    case exclusive_group_id:
+        props.exclusive_group = parse< config::string_node >(id, value);
+        break;
+
+    case fixtures_id:
+        props.fixtures = parse< paths_set_node >(id, value);
+        break;
+
+    case has_cleanup_id:
+        props.has_cleanup = parse< config::bool_node >(id, value);
+        break;
+
+    case is_exclusive_id:
+        props.is_exclusive = parse< config::bool_node >(id, value);
+        break;
+
+    case is_idempotent_id:
+        props.is_idempotent = parse< config::bool_node >(id, value);
+        break;
+
+    case max_output_size_id:
+        props.max_output_size = parse< bytes_node >(id, value);
+        break;
+
+    case max_retries_id:
+        props.max_retries = parse< count_node >(id, value);
+        break;
+
+    case priority_id:
+        props.priority = parse< priority_node >(id, value);
+        break;
+
+    case required_configs_id:
+        props.required_configs = parse< config::strings_set_node >(
+            id, value);
+        break;
+
+    case required_cpus_id:
+        props.required_cpus = parse< count_node >(id, value);
+        break;
+
+    case required_disk_space_id:
+        props.required_disk_space = parse< bytes_node >(id, value);
+        break;
+
+    case required_files_id:
+        props.required_files = parse< paths_set_node >(id, value);
+        break;
+
+    case required_memory_id:
+        props.required_memory = parse< bytes_node >(id, value);
+        break;
+
+    case required_programs_id:
+        props.required_programs = parse< paths_set_node >(id, value);
+        break;
+
+    case required_user_id:
+        props.required_user = parse< user_node >(id, value);
+        break;
+
+    case timeout_id:
+        props.timeout = parse< delta_node >(id, value);
+        break;
     }
+    props.mark_set(id);
     return *this;
 }
 
@@ -1054,7 +1571,8 @@ model::metadata_builder::set_string(const std::string& key,
 model::metadata_builder&
 model::metadata_builder::set_timeout(const datetime::delta& timeout)
 {
-    set< delta_node >(_pimpl->props, "timeout", timeout);
+    _pimpl->props.timeout = validate< delta_node >(timeout_id, timeout);
+    _pimpl->props.mark_set(timeout_id);
     return *this;
 }
 
@@ -1062,10 +1580,8 @@ model::metadata_builder::set_timeout(const datetime::delta& timeout)
 /// Creates a new metadata object.
 ///
 /// \pre This has not yet been called.  We only support calling this function
-/// once due to the way the internal tree works: we pass around references, not
-/// deep copies, so if we allowed a second build, we'd encourage reusing the
-/// same builder to construct different metadata objects, and this could have
-/// unintended consequences.
+/// once to discourage reusing the same builder to construct different metadata
+/// objects, which could have unintended consequences.
 ///
 /// \return The constructed metadata object.
 model::metadata
@@ -1074,5 +1590,12 @@ model::metadata_builder::build(void) const
     PRE(!_pimpl->built);
     _pimpl->built = true;
 
-    return metadata(_pimpl->props);
+    // Most test cases do not set any property, so share a single object with
+    // the defaults among all of them.
+    static const std::shared_ptr< metadata::impl > defaults(
+        new metadata::impl());
+    if (_pimpl->props.is_default())
+        return metadata(defaults);
+    return metadata(std::shared_ptr< metadata::impl >(
+        new metadata::impl(_pimpl->props)));
 }
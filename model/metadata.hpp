@@ -39,7 +39,6 @@
 #include <string>
 
 #include "model/types.hpp"
-#include "utils/config/tree_fwd.hpp"
 #include "utils/datetime_fwd.hpp"
 #include "utils/fs/path_fwd.hpp"
 #include "utils/noncopyable.hpp"
@@ -58,8 +57,9 @@ class metadata {
 
     friend class metadata_builder;
 
+    explicit metadata(const std::shared_ptr< impl >&);
+
 public:
-    metadata(const utils::config::tree&);
     ~metadata(void);
 
     metadata apply_overrides(const metadata&) const;
@@ -68,9 +68,16 @@ public:
     const strings_set& allowed_platforms(void) const;
     model::properties_map custom(void) const;
     const std::string& description(void) const;
+    const std::string& exclusive_group(void) const;
+    const paths_set& fixtures(void) const;
     bool has_cleanup(void) const;
     bool is_exclusive(void) const;
+    bool is_idempotent(void) const;
+    const utils::units::bytes& max_output_size(void) const;
+    int max_retries(void) const;
+    const std::string& priority(void) const;
     const strings_set& required_configs(void) const;
+    int required_cpus(void) const;
     const utils::units::bytes& required_disk_space(void) const;
     const paths_set& required_files(void) const;
     const utils::units::bytes& required_memory(void) const;
@@ -103,6 +110,7 @@ public:
     metadata_builder& add_allowed_architecture(const std::string&);
     metadata_builder& add_allowed_platform(const std::string&);
     metadata_builder& add_custom(const std::string&, const std::string&);
+    metadata_builder& add_fixture(const utils::fs::path&);
     metadata_builder& add_required_config(const std::string&);
     metadata_builder& add_required_file(const utils::fs::path&);
     metadata_builder& add_required_program(const utils::fs::path&);
@@ -111,9 +119,16 @@ public:
     metadata_builder& set_allowed_platforms(const strings_set&);
     metadata_builder& set_custom(const model::properties_map&);
     metadata_builder& set_description(const std::string&);
+    metadata_builder& set_exclusive_group(const std::string&);
+    metadata_builder& set_fixtures(const paths_set&);
     metadata_builder& set_has_cleanup(const bool);
     metadata_builder& set_is_exclusive(const bool);
+    metadata_builder& set_is_idempotent(const bool);
+    metadata_builder& set_max_output_size(const utils::units::bytes&);
+    metadata_builder& set_max_retries(const int);
+    metadata_builder& set_priority(const std::string&);
     metadata_builder& set_required_configs(const strings_set&);
+    metadata_builder& set_required_cpus(const int);
     metadata_builder& set_required_disk_space(const utils::units::bytes&);
     metadata_builder& set_required_files(const paths_set&);
     metadata_builder& set_required_memory(const utils::units::bytes&);
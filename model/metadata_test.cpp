@@ -32,7 +32,9 @@
 
 #include <atf-c++.hpp>
 
+#include "model/exceptions.hpp"
 #include "model/types.hpp"
+#include "utils/config/exceptions.hpp"
 #include "utils/datetime.hpp"
 #include "utils/format/containers.ipp"
 #include "utils/fs/path.hpp"
@@ -52,9 +54,16 @@ ATF_TEST_CASE_BODY(defaults)
     ATF_REQUIRE(md.allowed_platforms().empty());
     ATF_REQUIRE(md.custom().empty());
     ATF_REQUIRE(md.description().empty());
+    ATF_REQUIRE(md.exclusive_group().empty());
+    ATF_REQUIRE(md.fixtures().empty());
     ATF_REQUIRE(!md.has_cleanup());
     ATF_REQUIRE(!md.is_exclusive());
+    ATF_REQUIRE(!md.is_idempotent());
+    ATF_REQUIRE_EQ(units::bytes(0), md.max_output_size());
+    ATF_REQUIRE_EQ(0, md.max_retries());
+    ATF_REQUIRE_EQ("normal", md.priority());
     ATF_REQUIRE(md.required_configs().empty());
+    ATF_REQUIRE_EQ(0, md.required_cpus());
     ATF_REQUIRE_EQ(units::bytes(0), md.required_disk_space());
     ATF_REQUIRE(md.required_files().empty());
     ATF_REQUIRE_EQ(units::bytes(0), md.required_memory());
@@ -87,6 +96,10 @@ ATF_TEST_CASE_BODY(add)
     files.insert(fs::path("1-file"));
     files.insert(fs::path("2-file"));
 
+    model::paths_set fixtures;
+    fixtures.insert(fs::path("1-fixture"));
+    fixtures.insert(fs::path("2-fixture"));
+
     model::paths_set programs;
     programs.insert(fs::path("1-program"));
     programs.insert(fs::path("2-program"));
@@ -96,11 +109,13 @@ ATF_TEST_CASE_BODY(add)
         .add_allowed_platform("1-platform")
         .add_custom("1-custom", "first")
         .add_custom("2-custom", "second")
+        .add_fixture(fs::path("1-fixture"))
         .add_required_config("1-config")
         .add_required_file(fs::path("1-file"))
         .add_required_program(fs::path("1-program"))
         .add_allowed_architecture("2-architecture")
         .add_allowed_platform("2-platform")
+        .add_fixture(fs::path("2-fixture"))
         .add_required_config("2-config")
         .add_required_file(fs::path("2-file"))
         .add_required_program(fs::path("2-program"))
@@ -109,6 +124,7 @@ ATF_TEST_CASE_BODY(add)
     ATF_REQUIRE(architectures == md.allowed_architectures());
     ATF_REQUIRE(platforms == md.allowed_platforms());
     ATF_REQUIRE(custom == md.custom());
+    ATF_REQUIRE(fixtures == md.fixtures());
     ATF_REQUIRE(configs == md.required_configs());
     ATF_REQUIRE(files == md.required_files());
     ATF_REQUIRE(programs == md.required_programs());
@@ -167,6 +183,32 @@ ATF_TEST_CASE_BODY(apply_overrides)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(apply_overrides__custom);
+ATF_TEST_CASE_BODY(apply_overrides__custom)
+{
+    const model::metadata md1 = model::metadata_builder()
+        .add_custom("first", "1")
+        .add_custom("shared", "1")
+        .build();
+
+    const model::metadata md2 = model::metadata_builder()
+        .add_custom("second", "2")
+        .add_custom("shared", "2")
+        .set_max_retries(3)
+        .build();
+
+    const model::metadata merge_1_2 = model::metadata_builder()
+        .add_custom("first", "1")
+        .add_custom("second", "2")
+        .add_custom("shared", "2")
+        .set_max_retries(3)
+        .build();
+    ATF_REQUIRE_EQ(merge_1_2, md1.apply_overrides(md2));
+
+    ATF_REQUIRE_EQ(md1, md1.apply_overrides(model::metadata_builder().build()));
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(override_all_with_setters);
 ATF_TEST_CASE_BODY(override_all_with_setters)
 {
@@ -204,9 +246,16 @@ ATF_TEST_CASE_BODY(override_all_with_setters)
         .set_allowed_platforms(platforms)
         .set_custom(custom)
         .set_description(description)
+        .set_exclusive_group("network")
+        .set_fixtures(files)
         .set_has_cleanup(true)
         .set_is_exclusive(true)
+        .set_is_idempotent(true)
+        .set_max_output_size(units::bytes(8192))
+        .set_max_retries(3)
+        .set_priority("high")
         .set_required_configs(configs)
+        .set_required_cpus(8)
         .set_required_disk_space(disk_space)
         .set_required_files(files)
         .set_required_memory(memory)
@@ -219,9 +268,16 @@ ATF_TEST_CASE_BODY(override_all_with_setters)
     ATF_REQUIRE(platforms == md.allowed_platforms());
     ATF_REQUIRE(custom == md.custom());
     ATF_REQUIRE_EQ(description, md.description());
+    ATF_REQUIRE_EQ("network", md.exclusive_group());
+    ATF_REQUIRE(files == md.fixtures());
     ATF_REQUIRE(md.has_cleanup());
     ATF_REQUIRE(md.is_exclusive());
+    ATF_REQUIRE(md.is_idempotent());
+    ATF_REQUIRE_EQ(units::bytes(8192), md.max_output_size());
+    ATF_REQUIRE_EQ(3, md.max_retries());
+    ATF_REQUIRE_EQ("high", md.priority());
     ATF_REQUIRE(configs == md.required_configs());
+    ATF_REQUIRE_EQ(8, md.required_cpus());
     ATF_REQUIRE_EQ(disk_space, md.required_disk_space());
     ATF_REQUIRE(files == md.required_files());
     ATF_REQUIRE_EQ(memory, md.required_memory());
@@ -272,9 +328,16 @@ ATF_TEST_CASE_BODY(override_all_with_set_string)
         .set_string("allowed_platforms", "p1 p2")
         .set_string("custom.user-defined", "the-value")
         .set_string("description", "Another long text")
+        .set_string("exclusive_group", "network")
+        .set_string("fixtures", "plain /absolute/path")
         .set_string("has_cleanup", "true")
         .set_string("is_exclusive", "true")
+        .set_string("is_idempotent", "true")
+        .set_string("max_output_size", "16k")
+        .set_string("max_retries", "2")
+        .set_string("priority", "low")
         .set_string("required_configs", "config-var")
+        .set_string("required_cpus", "4")
         .set_string("required_disk_space", "16G")
         .set_string("required_files", "plain /absolute/path")
         .set_string("required_memory", "1M")
@@ -287,9 +350,16 @@ ATF_TEST_CASE_BODY(override_all_with_set_string)
     ATF_REQUIRE(platforms == md.allowed_platforms());
     ATF_REQUIRE(custom == md.custom());
     ATF_REQUIRE_EQ(description, md.description());
+    ATF_REQUIRE_EQ("network", md.exclusive_group());
+    ATF_REQUIRE(files == md.fixtures());
     ATF_REQUIRE(md.has_cleanup());
     ATF_REQUIRE(md.is_exclusive());
+    ATF_REQUIRE(md.is_idempotent());
+    ATF_REQUIRE_EQ(units::bytes(16 * 1024), md.max_output_size());
+    ATF_REQUIRE_EQ(2, md.max_retries());
+    ATF_REQUIRE_EQ("low", md.priority());
     ATF_REQUIRE(configs == md.required_configs());
+    ATF_REQUIRE_EQ(4, md.required_cpus());
     ATF_REQUIRE_EQ(disk_space, md.required_disk_space());
     ATF_REQUIRE(files == md.required_files());
     ATF_REQUIRE_EQ(memory, md.required_memory());
@@ -315,9 +385,16 @@ ATF_TEST_CASE_BODY(to_properties)
     props["allowed_platforms"] = "";
     props["custom.foo"] = "bar";
     props["description"] = "";
+    props["exclusive_group"] = "";
+    props["fixtures"] = "";
     props["has_cleanup"] = "false";
     props["is_exclusive"] = "false";
+    props["is_idempotent"] = "false";
+    props["max_output_size"] = "0";
+    props["max_retries"] = "0";
+    props["priority"] = "normal";
     props["required_configs"] = "";
+    props["required_cpus"] = "0";
     props["required_disk_space"] = "0";
     props["required_files"] = "bar foo";
     props["required_memory"] = "1.00K";
@@ -406,8 +483,11 @@ ATF_TEST_CASE_BODY(output__defaults)
     std::ostringstream str;
     str << model::metadata_builder().build();
     ATF_REQUIRE_EQ("metadata{allowed_architectures='', allowed_platforms='', "
-                   "description='', has_cleanup='false', is_exclusive='false', "
-                   "required_configs='', "
+                   "description='', exclusive_group='', fixtures='', "
+                   "has_cleanup='false', is_exclusive='false', "
+                   "is_idempotent='false', max_output_size='0', "
+                   "max_retries='0', priority='normal', "
+                   "required_configs='', required_cpus='0', "
                    "required_disk_space='0', required_files='', "
                    "required_memory='0', "
                    "required_programs='', required_user='', timeout='300'}",
@@ -428,8 +508,9 @@ ATF_TEST_CASE_BODY(output__some_values)
         .build();
     ATF_REQUIRE_EQ(
         "metadata{allowed_architectures='abc', allowed_platforms='', "
-        "description='', has_cleanup='false', is_exclusive='true', "
-        "required_configs='', "
+        "description='', exclusive_group='', fixtures='', has_cleanup='false', "
+        "is_exclusive='true', is_idempotent='false', max_output_size='0', "
+        "max_retries='0', priority='normal', required_configs='', required_cpus='0', "
         "required_disk_space='0', required_files='bar foo', "
         "required_memory='1.00K', "
         "required_programs='', required_user='', timeout='300'}",
@@ -437,12 +518,66 @@ ATF_TEST_CASE_BODY(output__some_values)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(set_string__unknown_key);
+ATF_TEST_CASE_BODY(set_string__unknown_key)
+{
+    model::metadata_builder builder;
+    ATF_REQUIRE_THROW_RE(model::format_error,
+                         "Unknown metadata property foo",
+                         builder.set_string("foo", "bar"));
+    ATF_REQUIRE_THROW_RE(model::format_error,
+                         "Unknown metadata property custom.",
+                         builder.set_string("custom.", "bar"));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(set_string__invalid_value);
+ATF_TEST_CASE_BODY(set_string__invalid_value)
+{
+    model::metadata_builder builder;
+    ATF_REQUIRE_THROW_RE(utils::config::invalid_key_value,
+                         "'has_cleanup'",
+                         builder.set_string("has_cleanup", "maybe"));
+    ATF_REQUIRE_THROW_RE(utils::config::invalid_key_value,
+                         "'max_retries'.*non-negative",
+                         builder.set_string("max_retries", "-1"));
+    ATF_REQUIRE_THROW_RE(utils::config::invalid_key_value,
+                         "'priority'.*Invalid priority",
+                         builder.set_string("priority", "urgent"));
+    ATF_REQUIRE_THROW_RE(utils::config::invalid_key_value,
+                         "'required_files'.*Relative path 'a/b'",
+                         builder.set_string("required_files", "/c a/b"));
+    ATF_REQUIRE_THROW_RE(utils::config::invalid_key_value,
+                         "'timeout'.*Invalid time delta",
+                         builder.set_string("timeout", "abc"));
+    ATF_REQUIRE_EQ(model::metadata_builder().build(), builder.build());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(setters__invalid_value);
+ATF_TEST_CASE_BODY(setters__invalid_value)
+{
+    model::metadata_builder builder;
+    ATF_REQUIRE_THROW_RE(model::error,
+                         "metadata property max_retries.*non-negative",
+                         builder.set_max_retries(-2));
+    ATF_REQUIRE_THROW_RE(model::error,
+                         "metadata property priority.*Invalid",
+                         builder.set_priority("idle"));
+    ATF_REQUIRE_THROW_RE(model::error,
+                         "metadata property required_user.*Invalid",
+                         builder.set_required_user("nobody"));
+    ATF_REQUIRE_EQ(model::metadata_builder().build(), builder.build());
+}
+
+
 ATF_INIT_TEST_CASES(tcs)
 {
     ATF_ADD_TEST_CASE(tcs, defaults);
     ATF_ADD_TEST_CASE(tcs, add);
     ATF_ADD_TEST_CASE(tcs, copy);
     ATF_ADD_TEST_CASE(tcs, apply_overrides);
+    ATF_ADD_TEST_CASE(tcs, apply_overrides__custom);
     ATF_ADD_TEST_CASE(tcs, override_all_with_setters);
     ATF_ADD_TEST_CASE(tcs, override_all_with_set_string);
     ATF_ADD_TEST_CASE(tcs, to_properties);
@@ -456,6 +591,7 @@ ATF_INIT_TEST_CASES(tcs)
     ATF_ADD_TEST_CASE(tcs, output__defaults);
     ATF_ADD_TEST_CASE(tcs, output__some_values);
 
-    // TODO(jmmv): Add tests for error conditions (invalid keys and invalid
-    // values).
+    ATF_ADD_TEST_CASE(tcs, set_string__unknown_key);
+    ATF_ADD_TEST_CASE(tcs, set_string__invalid_value);
+    ATF_ADD_TEST_CASE(tcs, setters__invalid_value);
 }
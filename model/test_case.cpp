@@ -60,6 +60,12 @@ struct model::test_case::impl : utils::noncopyable {
     /// Fake result to return instead of running the test case.
     optional< model::test_result > fake_result;
 
+    /// Combination of md_defaults and md, computed on first use.
+    ///
+    /// Combining the metadata objects allocates a new one, and the metadata of
+    /// a test case is queried at every stage of its execution.
+    mutable optional< model::metadata > combined_md;
+
     /// Constructor.
     ///
     /// \param name_ The name of the test case within the test program.
@@ -88,7 +94,9 @@ struct model::test_case::impl : utils::noncopyable {
     get_metadata(void) const
     {
         if (md_defaults != NULL) {
-            return md_defaults->apply_overrides(md);
+            if (!combined_md)
+                combined_md = md_defaults->apply_overrides(md);
+            return combined_md.get();
         } else {
             return md;
         }
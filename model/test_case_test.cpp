@@ -200,9 +200,13 @@ ATF_TEST_CASE_BODY(test_case__output)
     ATF_REQUIRE_EQ(
         "test_case{name='the-name', "
         "metadata=metadata{allowed_architectures='', allowed_platforms='foo', "
-        "custom.bar='baz', description='', has_cleanup='false', "
-        "is_exclusive='false', "
-        "required_configs='', required_disk_space='0', required_files='', "
+        "custom.bar='baz', description='', exclusive_group='', "
+        "fixtures='', has_cleanup='false', "
+        "is_exclusive='false', is_idempotent='false', "
+        "max_output_size='0', max_retries='0', "
+        "priority='normal', "
+        "required_configs='', required_cpus='0', required_disk_space='0', "
+        "required_files='', "
         "required_memory='0', "
         "required_programs='', required_user='', timeout='300'}}",
         str.str());
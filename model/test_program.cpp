@@ -65,11 +65,25 @@ struct model::test_program::impl : utils::noncopyable {
     /// Metadata of the test program.
     model::metadata md;
 
+    /// Name of the variant of the test program; empty if it has none.
+    std::string variant;
+
+    /// Test suite configuration variables that the variant overrides.
+    utils::config::properties_map variant_vars;
+
     /// List of test cases in the test program.
     ///
     /// Must be queried via the test_program::test_cases() method.
     model::test_cases_map test_cases;
 
+    /// Test case returned by the last call to find(); end() if none.
+    ///
+    /// The same test case is usually looked up several times in a row, as it
+    /// gets spawned and its result processed, and the test cases are usually
+    /// run in the order of their names, so remembering the last one avoids
+    /// most string comparisons in the lookups of large test programs.
+    model::test_cases_map::const_iterator last_found;
+
     /// Constructor.
     ///
     /// \param interface_name_ Name of the test program interface.
@@ -79,15 +93,24 @@ struct model::test_program::impl : utils::noncopyable {
     ///     belongs to.
     /// \param md_ Metadata of the test program.
     /// \param test_cases_ The collection of test cases in the test program.
+    /// \param variant_ Name of the variant of the test program.
+    /// \param variant_vars_ Configuration variables overridden by the variant.
     impl(const std::string& interface_name_, const fs::path& binary_,
          const fs::path& root_, const std::string& test_suite_name_,
-         const model::metadata& md_, const model::test_cases_map& test_cases_) :
+         const model::metadata& md_, const model::test_cases_map& test_cases_,
+         const std::string& variant_,
+         const utils::config::properties_map& variant_vars_) :
         interface_name(interface_name_),
         binary(binary_),
         root(root_),
         test_suite_name(test_suite_name_),
-        md(md_)
+        md(md_),
+        variant(variant_),
+        variant_vars(variant_vars_)
     {
+        PRE_MSG(!variant.empty() || variant_vars.empty(),
+                F("The program '%s' has variant variables but no variant "
+                  "name") % binary);
         PRE_MSG(!binary.is_absolute(),
                 F("The program '%s' must be relative to the root of the test "
                   "suite '%s'") % binary % root);
@@ -114,6 +137,34 @@ struct model::test_program::impl : utils::noncopyable {
                 name, test_case.apply_metadata_defaults(&md)));
         }
         INV(test_cases.size() == test_cases_.size());
+        last_found = test_cases.end();
+    }
+
+    /// Looks up a test case, starting with the last one found and its
+    /// successor.
+    ///
+    /// \param name The name of the test case to locate.
+    ///
+    /// \return The position of the test case; end() if not found.
+    model::test_cases_map::const_iterator
+    find(const std::string& name)
+    {
+        if (last_found != test_cases.end()) {
+            if ((*last_found).first == name)
+                return last_found;
+            model::test_cases_map::const_iterator next = last_found;
+            ++next;
+            if (next != test_cases.end() && (*next).first == name) {
+                last_found = next;
+                return last_found;
+            }
+        }
+
+        const model::test_cases_map::const_iterator iter =
+            test_cases.find(name);
+        if (iter != test_cases.end())
+            last_found = iter;
+        return iter;
     }
 };
 
@@ -126,14 +177,21 @@ struct model::test_program::impl : utils::noncopyable {
 /// \param test_suite_name_ The name of the test suite this program belongs to.
 /// \param md_ Metadata of the test program.
 /// \param test_cases_ The collection of test cases in the test program.
-model::test_program::test_program(const std::string& interface_name_,
-                                  const fs::path& binary_,
-                                  const fs::path& root_,
-                                  const std::string& test_suite_name_,
-                                  const model::metadata& md_,
-                                  const model::test_cases_map& test_cases_) :
+/// \param variant_ Name of the variant of the test program, if the test program
+///     runs once per set of configuration variables; empty otherwise.
+/// \param variant_vars_ Test suite configuration variables that the variant
+///     overrides.
+model::test_program::test_program(
+    const std::string& interface_name_,
+    const fs::path& binary_,
+    const fs::path& root_,
+    const std::string& test_suite_name_,
+    const model::metadata& md_,
+    const model::test_cases_map& test_cases_,
+    const std::string& variant_,
+    const utils::config::properties_map& variant_vars_) :
     _pimpl(new impl(interface_name_, binary_, root_, test_suite_name_, md_,
-                    test_cases_))
+                    test_cases_, variant_, variant_vars_))
 {
 }
 
@@ -205,6 +263,26 @@ model::test_program::get_metadata(void) const
 }
 
 
+/// Gets the name of the variant of the test program.
+///
+/// \return The name of the variant, or empty if the test program has none.
+const std::string&
+model::test_program::variant(void) const
+{
+    return _pimpl->variant;
+}
+
+
+/// Gets the test suite configuration variables overridden by the variant.
+///
+/// \return The variable names and their values for this variant.
+const utils::config::properties_map&
+model::test_program::variant_vars(void) const
+{
+    return _pimpl->variant_vars;
+}
+
+
 /// Gets a test case by its name.
 ///
 /// \param name The name of the test case to locate.
@@ -218,7 +296,10 @@ model::test_program::find(const std::string& name) const
 {
     const test_cases_map& tcs = test_cases();
 
-    const test_cases_map::const_iterator iter = tcs.find(name);
+    // Derived classes may provide their test cases from elsewhere, in which
+    // case there is nothing to speed up.
+    const test_cases_map::const_iterator iter = &tcs == &_pimpl->test_cases ?
+        _pimpl->find(name) : tcs.find(name);
     if (iter == tcs.end())
         throw not_found_error(F("Unknown test case %s in test program %s") %
                               name % relative_path());
@@ -252,6 +333,20 @@ model::test_program::set_test_cases(const model::test_cases_map& test_cases_)
 }
 
 
+/// Discards the list of test cases of the test program.
+///
+/// This is meant for lazily-loaded test programs to release the memory of a
+/// list of test cases that is not needed any longer, after which
+/// set_test_cases() may be called again.  Any references to the test cases
+/// previously returned by test_cases() or find() become invalid.
+void
+model::test_program::clear_test_cases(void)
+{
+    model::test_cases_map().swap(_pimpl->test_cases);
+    _pimpl->last_found = _pimpl->test_cases.end();
+}
+
+
 /// Equality comparator.
 ///
 /// \param other The other object to compare this one to.
@@ -266,6 +361,8 @@ model::test_program::operator==(const test_program& other) const
         _pimpl->root == other._pimpl->root &&
         _pimpl->test_suite_name == other._pimpl->test_suite_name &&
         _pimpl->md == other._pimpl->md &&
+        _pimpl->variant == other._pimpl->variant &&
+        _pimpl->variant_vars == other._pimpl->variant_vars &&
         test_cases() == other.test_cases());
 }
 
@@ -285,9 +382,10 @@ model::test_program::operator!=(const test_program& other) const
 /// Less-than comparator.
 ///
 /// A test program is considered to be less than another if and only if the
-/// former's absolute path is less than the absolute path of the latter.  In
-/// other words, the absolute path is used here as the test program's
-/// identifier.
+/// former's absolute path is less than the absolute path of the latter, or if
+/// they are variants of the same test program and the former's variant name
+/// sorts first.  In other words, the absolute path and the variant name are
+/// used here as the test program's identifier.
 ///
 /// This simplistic less-than operator overload is provided so that test
 /// programs can be held in sets and other containers.
@@ -298,7 +396,11 @@ model::test_program::operator!=(const test_program& other) const
 bool
 model::test_program::operator<(const test_program& other) const
 {
-    return absolute_path() < other.absolute_path();
+    const fs::path path = absolute_path();
+    const fs::path other_path = other.absolute_path();
+    if (path == other_path)
+        return _pimpl->variant < other._pimpl->variant;
+    return path < other_path;
 }
 
 
@@ -311,12 +413,17 @@ model::test_program::operator<(const test_program& other) const
 std::ostream&
 model::operator<<(std::ostream& output, const test_program& object)
 {
-    output << F("test_program{interface=%s, binary=%s, root=%s, test_suite=%s, "
-                "metadata=%s, test_cases=%s}")
+    output << F("test_program{interface=%s, binary=%s, root=%s, "
+                "test_suite=%s, ")
         % text::quote(object.interface_name(), '\'')
         % text::quote(object.relative_path().str(), '\'')
         % text::quote(object.root().str(), '\'')
-        % text::quote(object.test_suite_name(), '\'')
+        % text::quote(object.test_suite_name(), '\'');
+    if (!object.variant().empty())
+        output << F("variant=%s, variant_vars=%s, ")
+            % text::quote(object.variant(), '\'')
+            % object.variant_vars();
+    output << F("metadata=%s, test_cases=%s}")
         % object.get_metadata()
         % object.test_cases();
     return output;
@@ -331,6 +438,12 @@ struct model::test_program_builder::impl : utils::noncopyable {
     /// Optional metadata for the test program.
     model::metadata metadata;
 
+    /// Name of the variant of the test program; empty if it has none.
+    std::string variant;
+
+    /// Configuration variables overridden by the variant.
+    utils::config::properties_map variant_vars;
+
     /// Collection of test cases.
     model::test_cases_map test_cases;
 
@@ -414,6 +527,25 @@ model::test_program_builder::set_metadata(const model::metadata& metadata)
 }
 
 
+/// Sets the variant of the test program.
+///
+/// \param variant Name of the variant.  Cannot be empty.
+/// \param variant_vars Test suite configuration variables that the variant
+///     overrides.
+///
+/// \return A reference to this builder.
+model::test_program_builder&
+model::test_program_builder::set_variant(
+    const std::string& variant,
+    const utils::config::properties_map& variant_vars)
+{
+    PRE(!variant.empty());
+    _pimpl->variant = variant;
+    _pimpl->variant_vars = variant_vars;
+    return *this;
+}
+
+
 /// Creates a new test_program object.
 ///
 /// \pre This has not yet been called.  We only support calling this function
@@ -431,7 +563,9 @@ model::test_program_builder::build(void) const
                         _pimpl->prototype.root(),
                         _pimpl->prototype.test_suite_name(),
                         _pimpl->metadata,
-                        _pimpl->test_cases);
+                        _pimpl->test_cases,
+                        _pimpl->variant,
+                        _pimpl->variant_vars);
 }
 
 
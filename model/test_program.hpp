@@ -34,12 +34,14 @@
 
 #include "model/test_program_fwd.hpp"
 
+#include <map>
 #include <ostream>
 #include <string>
 #include <vector>
 
 #include "model/metadata_fwd.hpp"
 #include "model/test_case_fwd.hpp"
+#include "utils/config/tree_fwd.hpp"
 #include "utils/fs/path_fwd.hpp"
 #include "utils/noncopyable.hpp"
 #include "utils/shared_ptr.hpp"
@@ -56,11 +58,15 @@ class test_program {
 
 protected:
     void set_test_cases(const model::test_cases_map&);
+    void clear_test_cases(void);
 
 public:
     test_program(const std::string&, const utils::fs::path&,
                  const utils::fs::path&, const std::string&,
-                 const model::metadata&, const model::test_cases_map&);
+                 const model::metadata&, const model::test_cases_map&,
+                 const std::string& = "",
+                 const utils::config::properties_map& =
+                     utils::config::properties_map());
     virtual ~test_program(void);
 
     const std::string& interface_name(void) const;
@@ -69,6 +75,8 @@ public:
     const utils::fs::path absolute_path(void) const;
     const std::string& test_suite_name(void) const;
     const model::metadata& get_metadata(void) const;
+    const std::string& variant(void) const;
+    const utils::config::properties_map& variant_vars(void) const;
 
     const model::test_case& find(const std::string&) const;
     virtual const model::test_cases_map& test_cases(void) const;
@@ -99,6 +107,8 @@ public:
                                         const model::metadata&);
 
     test_program_builder& set_metadata(const model::metadata&);
+    test_program_builder& set_variant(const std::string&,
+                                      const utils::config::properties_map&);
 
     test_program build(void) const;
     test_program_ptr build_ptr(void) const;
@@ -34,6 +34,7 @@ extern "C" {
 #include <signal.h>
 }
 
+#include <cstddef>
 #include <set>
 #include <sstream>
 
@@ -185,6 +186,26 @@ check_find_ok(void)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(find__repeated);
+ATF_TEST_CASE_BODY(find__repeated)
+{
+    const model::test_program test_program(
+        "mock", fs::path("non-existent"), fs::path("."), "suite-name",
+        model::metadata_builder().build(),
+        model::test_cases_map_builder().add("a").add("b").add("c").add("d")
+        .build());
+
+    const char* const lookups[] = { "a", "a", "b", "c", "c", "a", "d", "b" };
+    for (std::size_t i = 0; i < sizeof(lookups) / sizeof(lookups[0]); ++i)
+        ATF_REQUIRE_EQ(lookups[i], test_program.find(lookups[i]).name());
+
+    ATF_REQUIRE_THROW(model::not_found_error, test_program.find("e"));
+    ATF_REQUIRE_EQ("b", test_program.find("b").name());
+    ATF_REQUIRE_THROW(model::not_found_error, test_program.find("bb"));
+    ATF_REQUIRE_EQ("c", test_program.find("c").name());
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(find__ok);
 ATF_TEST_CASE_BODY(find__ok)
 {
@@ -544,8 +565,12 @@ check_output__no_test_cases(void)
         "test_program{interface='plain', binary='binary/path', "
         "root='/the/root', test_suite='suite-name', "
         "metadata=metadata{allowed_architectures='a', allowed_platforms='', "
-        "description='', has_cleanup='false', is_exclusive='false', "
-        "required_configs='', required_disk_space='0', required_files='', "
+        "description='', exclusive_group='', fixtures='', has_cleanup='false', "
+        "is_exclusive='false', is_idempotent='false', "
+        "max_output_size='0', max_retries='0', "
+        "priority='normal', "
+        "required_configs='', required_cpus='0', required_disk_space='0', "
+        "required_files='', "
         "required_memory='0', "
         "required_programs='', required_user='', timeout='300'}, "
         "test_cases=map()}",
@@ -593,22 +618,34 @@ check_output__some_test_cases(void)
         "test_program{interface='plain', binary='binary/path', "
         "root='/the/root', test_suite='suite-name', "
         "metadata=metadata{allowed_architectures='a', allowed_platforms='', "
-        "description='', has_cleanup='false', is_exclusive='false', "
-        "required_configs='', required_disk_space='0', required_files='', "
+        "description='', exclusive_group='', fixtures='', has_cleanup='false', "
+        "is_exclusive='false', is_idempotent='false', "
+        "max_output_size='0', max_retries='0', "
+        "priority='normal', "
+        "required_configs='', required_cpus='0', required_disk_space='0', "
+        "required_files='', "
         "required_memory='0', "
         "required_programs='', required_user='', timeout='300'}, "
         "test_cases=map("
         "another-name=test_case{name='another-name', "
         "metadata=metadata{allowed_architectures='a', allowed_platforms='', "
-        "description='', has_cleanup='false', is_exclusive='false', "
-        "required_configs='', required_disk_space='0', required_files='', "
+        "description='', exclusive_group='', fixtures='', has_cleanup='false', "
+        "is_exclusive='false', is_idempotent='false', "
+        "max_output_size='0', max_retries='0', "
+        "priority='normal', "
+        "required_configs='', required_cpus='0', required_disk_space='0', "
+        "required_files='', "
         "required_memory='0', "
         "required_programs='', required_user='', timeout='300'}}, "
         "the-name=test_case{name='the-name', "
         "metadata=metadata{allowed_architectures='a', allowed_platforms='foo', "
-        "custom.bar='baz', description='', has_cleanup='false', "
-        "is_exclusive='false', "
-        "required_configs='', required_disk_space='0', required_files='', "
+        "custom.bar='baz', description='', exclusive_group='', "
+        "fixtures='', has_cleanup='false', "
+        "is_exclusive='false', is_idempotent='false', "
+        "max_output_size='0', max_retries='0', "
+        "priority='normal', "
+        "required_configs='', required_cpus='0', required_disk_space='0', "
+        "required_files='', "
         "required_memory='0', "
         "required_programs='', required_user='', timeout='300'}})}",
         str.str());
@@ -629,6 +666,81 @@ ATF_TEST_CASE_BODY(derived__output__some_test_cases)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(variant__getters);
+ATF_TEST_CASE_BODY(variant__getters)
+{
+    utils::config::properties_map vars;
+    vars["backend"] = "sqlite";
+
+    const model::test_program plain(
+        "mock", fs::path("binary"), fs::path("root"), "suite-name",
+        model::metadata_builder().build(), model::test_cases_map());
+    ATF_REQUIRE(plain.variant().empty());
+    ATF_REQUIRE(plain.variant_vars().empty());
+
+    const model::test_program variant(
+        "mock", fs::path("binary"), fs::path("root"), "suite-name",
+        model::metadata_builder().build(), model::test_cases_map(),
+        "sqlite", vars);
+    ATF_REQUIRE_EQ("sqlite", variant.variant());
+    ATF_REQUIRE(vars == variant.variant_vars());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(variant__operators);
+ATF_TEST_CASE_BODY(variant__operators)
+{
+    utils::config::properties_map vars1;
+    vars1["backend"] = "a";
+    utils::config::properties_map vars2;
+    vars2["backend"] = "b";
+
+    const model::test_program plain(
+        "mock", fs::path("binary"), fs::path("root"), "suite-name",
+        model::metadata_builder().build(), model::test_cases_map());
+    const model::test_program variant1(
+        "mock", fs::path("binary"), fs::path("root"), "suite-name",
+        model::metadata_builder().build(), model::test_cases_map(),
+        "a", vars1);
+    const model::test_program variant2(
+        "mock", fs::path("binary"), fs::path("root"), "suite-name",
+        model::metadata_builder().build(), model::test_cases_map(),
+        "b", vars2);
+    const model::test_program variant2_other_vars(
+        "mock", fs::path("binary"), fs::path("root"), "suite-name",
+        model::metadata_builder().build(), model::test_cases_map(),
+        "b", vars1);
+
+    ATF_REQUIRE(plain != variant1);
+    ATF_REQUIRE(variant1 != variant2);
+    ATF_REQUIRE(variant2 != variant2_other_vars);
+
+    ATF_REQUIRE(plain < variant1);
+    ATF_REQUIRE(variant1 < variant2);
+    ATF_REQUIRE(!(variant2 < variant1));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(variant__output);
+ATF_TEST_CASE_BODY(variant__output)
+{
+    utils::config::properties_map vars;
+    vars["backend"] = "sqlite";
+
+    const model::test_program test_program = model::test_program_builder(
+        "plain", fs::path("binary/path"), fs::path("/the/root"), "suite-name")
+        .set_variant("sqlite", vars)
+        .build();
+
+    std::ostringstream str;
+    str << test_program;
+    ATF_REQUIRE_MATCH(
+        "^test_program\\{interface='plain', binary='binary/path', "
+        "root='/the/root', test_suite='suite-name', variant='sqlite', "
+        "variant_vars=map\\(backend=sqlite\\), metadata=", str.str());
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(builder__defaults);
 ATF_TEST_CASE_BODY(builder__defaults)
 {
@@ -687,6 +799,7 @@ ATF_INIT_TEST_CASES(tcs)
 {
     ATF_ADD_TEST_CASE(tcs, ctor_and_getters);
     ATF_ADD_TEST_CASE(tcs, find__ok);
+    ATF_ADD_TEST_CASE(tcs, find__repeated);
     ATF_ADD_TEST_CASE(tcs, find__missing);
     ATF_ADD_TEST_CASE(tcs, metadata_inheritance);
     ATF_ADD_TEST_CASE(tcs, operators_eq_and_ne__copy);
@@ -705,6 +818,10 @@ ATF_INIT_TEST_CASES(tcs)
     ATF_ADD_TEST_CASE(tcs, derived__output__no_test_cases);
     ATF_ADD_TEST_CASE(tcs, derived__output__some_test_cases);
 
+    ATF_ADD_TEST_CASE(tcs, variant__getters);
+    ATF_ADD_TEST_CASE(tcs, variant__operators);
+    ATF_ADD_TEST_CASE(tcs, variant__output);
+
     ATF_ADD_TEST_CASE(tcs, builder__defaults);
     ATF_ADD_TEST_CASE(tcs, builder__overrides);
     ATF_ADD_TEST_CASE(tcs, builder__ptr);
@@ -28,6 +28,9 @@
 
 #include "model/test_result.hpp"
 
+#include <cstddef>
+#include <set>
+
 #include "utils/format/macros.hpp"
 #include "utils/sanity.hpp"
 #include "utils/text/operations.ipp"
@@ -35,6 +38,78 @@
 namespace text = utils::text;
 
 
+namespace {
+
+
+/// Shared immutable string.
+typedef std::shared_ptr< const std::string > shared_string;
+
+
+/// Orders shared strings by their contents.
+struct shared_string_less {
+    /// Compares two shared strings.
+    ///
+    /// \param a The first string.
+    /// \param b The second string.
+    ///
+    /// \return True if a sorts before b.
+    bool
+    operator()(const shared_string& a, const shared_string& b) const
+    {
+        return *a < *b;
+    }
+};
+
+
+/// Collection of interned strings.
+typedef std::set< shared_string, shared_string_less > shared_strings_set;
+
+
+/// Maximum number of distinct reasons to keep interned.
+///
+/// Reasons that embed details of each failure are rarely repeated, so this
+/// bounds the memory that they can pin in the pool.
+const std::size_t max_interned_reasons = 1024;
+
+
+/// Gets the shared copy of a reason.
+///
+/// \param reason The reason to intern.
+///
+/// \return A string with the contents of reason that is shared with all other
+/// results that carry the same reason, unless the pool is full.
+static shared_string
+intern_reason(const std::string& reason)
+{
+    static shared_strings_set interned;
+
+    // Use a non-owning pointer to the caller's string so that finding an
+    // already-interned reason does not allocate memory.
+    const shared_string key(shared_string(), &reason);
+    const shared_strings_set::const_iterator iter = interned.find(key);
+    if (iter != interned.end())
+        return *iter;
+
+    const shared_string copy(new std::string(reason));
+    if (interned.size() >= max_interned_reasons) {
+        // Forget the reasons that no result references any longer.
+        shared_strings_set::iterator iter2 = interned.begin();
+        while (iter2 != interned.end()) {
+            if ((*iter2).use_count() == 1)
+                interned.erase(iter2++);
+            else
+                ++iter2;
+        }
+    }
+    if (interned.size() < max_interned_reasons)
+        interned.insert(copy);
+    return copy;
+}
+
+
+}  // anonymous namespace
+
+
 /// Constructs a base result.
 ///
 /// \param type_ The type of the result.
@@ -43,7 +118,7 @@ namespace text = utils::text;
 model::test_result::test_result(const test_result_type type_,
                                 const std::string& reason_) :
     _type(type_),
-    _reason(reason_)
+    _reason(intern_reason(reason_))
 {
 }
 
@@ -64,7 +139,7 @@ model::test_result::type(void) const
 const std::string&
 model::test_result::reason(void) const
 {
-    return _reason;
+    return *_reason;
 }
 
 
@@ -96,7 +171,8 @@ model::test_result::good(void) const
 bool
 model::test_result::operator==(const test_result& other) const
 {
-    return _type == other._type && _reason == other._reason;
+    return _type == other._type &&
+        (_reason == other._reason || *_reason == *other._reason);
 }
 
 
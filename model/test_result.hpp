@@ -37,6 +37,8 @@
 #include <ostream>
 #include <string>
 
+#include "utils/shared_ptr.hpp"
+
 namespace model {
 
 
@@ -51,12 +53,16 @@ namespace model {
 /// special-case this with a very complex class hierarchy, but it proved to
 /// result in an extremely-complex to maintain code base that provided no
 /// benefits.  As a result, we allow any test type to carry a reason.
+///
+/// Reasons are immutable and interned: copies of a result share its reason
+/// and so do results constructed with the same reason, which is common for
+/// the many skipped test cases of a suite that lack the same requirement.
 class test_result {
     /// The type of the result.
     test_result_type _type;
 
-    /// A description of the result; may be empty.
-    std::string _reason;
+    /// A description of the result; may be empty.  Never NULL.
+    std::shared_ptr< const std::string > _reason;
 
 public:
     test_result(const test_result_type, const std::string& = "");
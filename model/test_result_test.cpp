@@ -163,6 +163,24 @@ ATF_TEST_CASE_BODY(operator_ne)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(reason__shared);
+ATF_TEST_CASE_BODY(reason__shared)
+{
+    const model::test_result result1(model::test_result_skipped,
+                                     "Required program 'foo' not found");
+    const model::test_result result2(model::test_result_skipped,
+                                     std::string("Required program 'foo' ") +
+                                     "not found");
+    const model::test_result result3(result1);
+    const model::test_result result4(model::test_result_skipped, "Other");
+
+    ATF_REQUIRE_EQ(&result1.reason(), &result2.reason());
+    ATF_REQUIRE_EQ(&result1.reason(), &result3.reason());
+    ATF_REQUIRE(&result1.reason() != &result4.reason());
+    ATF_REQUIRE_EQ("Required program 'foo' not found", result2.reason());
+}
+
+
 ATF_INIT_TEST_CASES(tcs)
 {
     ATF_ADD_TEST_CASE(tcs, broken__getters);
@@ -182,4 +200,5 @@ ATF_INIT_TEST_CASES(tcs)
     ATF_ADD_TEST_CASE(tcs, skipped__output);
     ATF_ADD_TEST_CASE(tcs, operator_eq);
     ATF_ADD_TEST_CASE(tcs, operator_ne);
+    ATF_ADD_TEST_CASE(tcs, reason__shared);
 }
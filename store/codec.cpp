@@ -0,0 +1,276 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "store/codec.hpp"
+
+extern "C" {
+#include <zlib.h>
+}
+
+#include "store/exceptions.hpp"
+#include "store/read_transaction.hpp"
+#include "utils/format/macros.hpp"
+#include "utils/sanity.hpp"
+
+
+/// Name of the codec for files stored verbatim.
+const char* const store::detail::codec_none = "none";
+
+
+/// Name of the codec for files compressed with zlib.
+const char* const store::detail::codec_zlib = "zlib";
+
+
+namespace {
+
+
+/// Size of the chunks in which data is fed to and drained from zlib.
+static const std::size_t chunk_size = 64 * 1024;
+
+
+/// File hooks to accumulate the contents of a file in memory.
+class string_hooks : public store::file_hooks {
+    /// The accumulated contents.
+    std::string& _contents;
+
+public:
+    /// Constructor.
+    ///
+    /// \param contents_ The string into which to accumulate the contents.
+    string_hooks(std::string& contents_) : _contents(contents_)
+    {
+    }
+
+    /// Appends a chunk to the contents.
+    ///
+    /// \param data The contents of the chunk.
+    /// \param size The length of data in bytes.
+    ///
+    /// \return Always true.
+    bool
+    got_chunk(const char* data, const std::size_t size)
+    {
+        _contents.append(data, size);
+        return true;
+    }
+};
+
+
+}  // anonymous namespace
+
+
+/// Compresses the contents of a stream with zlib.
+///
+/// The input is consumed in chunks so that only the compressed output is held
+/// in memory.
+///
+/// \param input The stream to compress, which is read until EOF.
+/// \param level The zlib compression level, from 1 to 9.
+///
+/// \return The compressed data.
+///
+/// \throw store::error If the input cannot be read or zlib fails.
+std::string
+store::detail::compress_zlib(std::istream& input, const int level)
+{
+    PRE(level >= 1 && level <= 9);
+
+    z_stream stream;
+    stream.zalloc = Z_NULL;
+    stream.zfree = Z_NULL;
+    stream.opaque = Z_NULL;
+    if (::deflateInit(&stream, level) != Z_OK)
+        throw store::error(F("Failed to initialize zlib: %s") %
+                           (stream.msg != NULL ? stream.msg : "unknown error"));
+
+    std::string output;
+    char in_buffer[chunk_size];
+    char out_buffer[chunk_size];
+    int flush;
+    do {
+        input.read(in_buffer, sizeof(in_buffer));
+        if (input.bad()) {
+            ::deflateEnd(&stream);
+            throw store::error("Failed to read file");
+        }
+        flush = input.eof() ? Z_FINISH : Z_NO_FLUSH;
+
+        stream.next_in = reinterpret_cast< Bytef* >(in_buffer);
+        stream.avail_in = static_cast< uInt >(input.gcount());
+        do {
+            stream.next_out = reinterpret_cast< Bytef* >(out_buffer);
+            stream.avail_out = sizeof(out_buffer);
+            const int ret = ::deflate(&stream, flush);
+            INV(ret != Z_STREAM_ERROR);
+            output.append(out_buffer, sizeof(out_buffer) - stream.avail_out);
+        } while (stream.avail_out == 0);
+        INV(stream.avail_in == 0);
+    } while (flush != Z_FINISH);
+
+    ::deflateEnd(&stream);
+    return output;
+}
+
+
+/// Internal implementation for the decoder.
+struct store::detail::decoder::impl : utils::noncopyable {
+    /// Whether the data is compressed with zlib or stored verbatim.
+    bool compressed;
+
+    /// The zlib state; only valid if compressed is true.
+    z_stream stream;
+
+    /// Whether zlib has seen the end of the compressed data.
+    bool done;
+
+    /// Constructor.
+    ///
+    /// \param codec The name of the codec with which the file was stored.
+    ///
+    /// \throw store::integrity_error If the codec is unknown.
+    impl(const std::string& codec) : compressed(false), done(false)
+    {
+        if (codec == codec_none)
+            return;
+        else if (codec != codec_zlib)
+            throw store::integrity_error(F("Unknown codec '%s'") % codec);
+
+        stream.zalloc = Z_NULL;
+        stream.zfree = Z_NULL;
+        stream.opaque = Z_NULL;
+        stream.next_in = Z_NULL;
+        stream.avail_in = 0;
+        if (::inflateInit(&stream) != Z_OK)
+            throw store::integrity_error("Failed to initialize zlib");
+        compressed = true;
+    }
+
+    /// Destructor.
+    ~impl(void)
+    {
+        if (compressed)
+            ::inflateEnd(&stream);
+    }
+};
+
+
+/// Constructs a new decoder.
+///
+/// \param codec The name of the codec with which the file was stored.
+///
+/// \throw store::integrity_error If the codec is unknown.
+store::detail::decoder::decoder(const std::string& codec) :
+    _pimpl(new impl(codec))
+{
+}
+
+
+/// Destructor.
+store::detail::decoder::~decoder(void)
+{
+}
+
+
+/// Decodes a chunk of the stored representation of a file.
+///
+/// \param data The chunk of stored data.
+/// \param size The length of data in bytes.
+/// \param hooks The callbacks to pass the decoded contents to.
+///
+/// \return False if the hooks requested to stop reading; true otherwise.
+///
+/// \throw store::integrity_error If the data cannot be decoded.
+bool
+store::detail::decoder::feed(const void* data, const std::size_t size,
+                             file_hooks& hooks)
+{
+    if (!_pimpl->compressed)
+        return size == 0 || hooks.got_chunk(static_cast< const char* >(data),
+                                            size);
+
+    z_stream& stream = _pimpl->stream;
+    stream.next_in = static_cast< Bytef* >(const_cast< void* >(data));
+    stream.avail_in = static_cast< uInt >(size);
+    char out_buffer[chunk_size];
+    while (!_pimpl->done) {
+        stream.next_out = reinterpret_cast< Bytef* >(out_buffer);
+        stream.avail_out = sizeof(out_buffer);
+        const int ret = ::inflate(&stream, Z_NO_FLUSH);
+        if (ret == Z_BUF_ERROR)
+            break;  // All input consumed and no pending output.
+        else if (ret != Z_OK && ret != Z_STREAM_END)
+            throw store::integrity_error(F("Cannot decode zlib data: %s") %
+                (stream.msg != NULL ? stream.msg : "truncated data"));
+        _pimpl->done = ret == Z_STREAM_END;
+
+        const std::size_t length = sizeof(out_buffer) - stream.avail_out;
+        if (length > 0 && !hooks.got_chunk(out_buffer, length))
+            return false;
+        if (stream.avail_out != 0 && stream.avail_in == 0)
+            break;
+    }
+    return true;
+}
+
+
+/// Checks that the whole stored representation of a file has been decoded.
+///
+/// \throw store::integrity_error If the stored data was truncated.
+void
+store::detail::decoder::finish(void)
+{
+    if (_pimpl->compressed && !_pimpl->done)
+        throw store::integrity_error("Cannot decode zlib data: truncated "
+                                     "data");
+}
+
+
+/// Decodes the contents of a stored file.
+///
+/// \param codec The name of the codec with which the file was stored.
+/// \param data The stored representation of the file.
+/// \param size The length of data in bytes.
+///
+/// \return The original contents of the file.
+///
+/// \throw store::integrity_error If the codec is unknown or if the data cannot
+///     be decoded.
+std::string
+store::detail::decode_contents(const std::string& codec, const void* data,
+                               const std::size_t size)
+{
+    if (codec == codec_none)
+        return std::string(static_cast< const char* >(data), size);
+
+    std::string output;
+    string_hooks hooks(output);
+    decoder file_decoder(codec);
+    file_decoder.feed(data, size, hooks);
+    file_decoder.finish();
+    return output;
+}
@@ -0,0 +1,82 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// \file store/codec.hpp
+/// Encoding and decoding of the contents of stored files.
+
+#if !defined(STORE_CODEC_HPP)
+#define STORE_CODEC_HPP
+
+#include <cstddef>
+#include <istream>
+#include <memory>
+#include <string>
+
+#include "store/read_transaction_fwd.hpp"
+#include "utils/noncopyable.hpp"
+
+namespace store {
+
+
+namespace detail {
+
+
+extern const char* const codec_none;
+extern const char* const codec_zlib;
+
+
+std::string compress_zlib(std::istream&, const int);
+std::string decode_contents(const std::string&, const void*,
+                            const std::size_t);
+
+
+/// Incremental decoder of the contents of a stored file.
+///
+/// The stored representation of the file is fed in arbitrary chunks and the
+/// original contents are passed to a file_hooks object as they are decoded.
+class decoder : utils::noncopyable {
+    struct impl;
+
+    /// Pointer to the internal implementation.
+    std::auto_ptr< impl > _pimpl;
+
+public:
+    explicit decoder(const std::string&);
+    ~decoder(void);
+
+    bool feed(const void*, const std::size_t, file_hooks&);
+    void finish(void);
+};
+
+
+}  // namespace detail
+
+
+}  // namespace store
+
+#endif  // !defined(STORE_CODEC_HPP)
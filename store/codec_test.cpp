@@ -0,0 +1,238 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "store/codec.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <sstream>
+#include <string>
+
+#include <atf-c++.hpp>
+
+#include "store/exceptions.hpp"
+#include "store/read_transaction.hpp"
+
+
+namespace {
+
+
+/// File hooks that record the chunks they receive.
+class chunks_hooks : public store::file_hooks {
+    /// Number of chunks to accept before requesting to stop.
+    const std::size_t _max_chunks;
+
+public:
+    /// The concatenation of all received chunks.
+    std::string contents;
+
+    /// Number of received chunks.
+    std::size_t chunks;
+
+    /// Constructor.
+    ///
+    /// \param max_chunks_ Number of chunks after which to stop reading.
+    chunks_hooks(const std::size_t max_chunks_) :
+        _max_chunks(max_chunks_), chunks(0)
+    {
+    }
+
+    /// Records a chunk.
+    ///
+    /// \param data The contents of the chunk.
+    /// \param size The length of data in bytes.
+    ///
+    /// \return Whether to keep reading.
+    bool
+    got_chunk(const char* data, const std::size_t size)
+    {
+        ATF_REQUIRE(size > 0);
+        contents.append(data, size);
+        return ++chunks < _max_chunks;
+    }
+};
+
+
+/// Generates a string that spans multiple chunks of the internal buffers.
+///
+/// \return The generated contents.
+static std::string
+large_contents(void)
+{
+    std::string contents;
+    for (int i = 0; i < 300000; ++i)
+        contents += static_cast< char >('a' + (i * 7) % 26);
+    return contents;
+}
+
+
+}  // anonymous namespace
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(decode_contents__none);
+ATF_TEST_CASE_BODY(decode_contents__none)
+{
+    const char data[] = "abc\0def";
+    ATF_REQUIRE_EQ(std::string(data, sizeof(data) - 1),
+                   store::detail::decode_contents("none", data,
+                                                  sizeof(data) - 1));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(decode_contents__unknown_codec);
+ATF_TEST_CASE_BODY(decode_contents__unknown_codec)
+{
+    ATF_REQUIRE_THROW_RE(store::integrity_error, "Unknown codec 'foo'",
+                         store::detail::decode_contents("foo", "abc", 3));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(zlib__round_trip__small);
+ATF_TEST_CASE_BODY(zlib__round_trip__small)
+{
+    std::istringstream input("Some text\n");
+    const std::string compressed = store::detail::compress_zlib(input, 1);
+    ATF_REQUIRE_EQ("Some text\n", store::detail::decode_contents(
+        "zlib", compressed.c_str(), compressed.length()));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(zlib__round_trip__large);
+ATF_TEST_CASE_BODY(zlib__round_trip__large)
+{
+    // Use a size that spans multiple chunks of the internal buffers.
+    std::string contents;
+    for (int i = 0; i < 300000; ++i)
+        contents += static_cast< char >('a' + (i * 7) % 26);
+
+    std::istringstream input(contents);
+    const std::string compressed = store::detail::compress_zlib(input, 9);
+    ATF_REQUIRE(compressed.length() < contents.length());
+    ATF_REQUIRE_EQ(contents, store::detail::decode_contents(
+        "zlib", compressed.c_str(), compressed.length()));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(zlib__decode__truncated);
+ATF_TEST_CASE_BODY(zlib__decode__truncated)
+{
+    std::istringstream input("Some text that will be truncated\n");
+    const std::string compressed = store::detail::compress_zlib(input, 6);
+    ATF_REQUIRE_THROW_RE(store::integrity_error, "Cannot decode zlib data",
+                         store::detail::decode_contents(
+                             "zlib", compressed.c_str(),
+                             compressed.length() / 2));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(zlib__decode__garbage);
+ATF_TEST_CASE_BODY(zlib__decode__garbage)
+{
+    ATF_REQUIRE_THROW_RE(store::integrity_error, "Cannot decode zlib data",
+                         store::detail::decode_contents("zlib", "garbage", 7));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(decoder__none);
+ATF_TEST_CASE_BODY(decoder__none)
+{
+    chunks_hooks hooks(10);
+    store::detail::decoder decoder("none");
+    ATF_REQUIRE(decoder.feed("abc", 3, hooks));
+    ATF_REQUIRE(decoder.feed("", 0, hooks));
+    ATF_REQUIRE(decoder.feed("def", 3, hooks));
+    decoder.finish();
+    ATF_REQUIRE_EQ("abcdef", hooks.contents);
+    ATF_REQUIRE_EQ(2, hooks.chunks);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(decoder__zlib__small_input_chunks);
+ATF_TEST_CASE_BODY(decoder__zlib__small_input_chunks)
+{
+    const std::string contents = large_contents();
+    std::istringstream input(contents);
+    const std::string compressed = store::detail::compress_zlib(input, 9);
+
+    chunks_hooks hooks(1000);
+    store::detail::decoder decoder("zlib");
+    for (std::string::size_type i = 0; i < compressed.length(); i += 10)
+        ATF_REQUIRE(decoder.feed(compressed.c_str() + i,
+                                 std::min(std::string::size_type(10),
+                                          compressed.length() - i),
+                                 hooks));
+    decoder.finish();
+    ATF_REQUIRE(contents == hooks.contents);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(decoder__zlib__stop);
+ATF_TEST_CASE_BODY(decoder__zlib__stop)
+{
+    const std::string contents = large_contents();
+    std::istringstream input(contents);
+    const std::string compressed = store::detail::compress_zlib(input, 9);
+
+    chunks_hooks hooks(1);
+    store::detail::decoder decoder("zlib");
+    ATF_REQUIRE(!decoder.feed(compressed.c_str(), compressed.length(), hooks));
+    ATF_REQUIRE_EQ(1, hooks.chunks);
+    ATF_REQUIRE(hooks.contents.length() < contents.length());
+    ATF_REQUIRE(contents.substr(0, hooks.contents.length()) == hooks.contents);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(decoder__zlib__truncated);
+ATF_TEST_CASE_BODY(decoder__zlib__truncated)
+{
+    std::istringstream input("Some text that will be truncated\n");
+    const std::string compressed = store::detail::compress_zlib(input, 6);
+
+    chunks_hooks hooks(10);
+    store::detail::decoder decoder("zlib");
+    decoder.feed(compressed.c_str(), compressed.length() / 2, hooks);
+    ATF_REQUIRE_THROW_RE(store::integrity_error, "truncated data",
+                         decoder.finish());
+}
+
+
+ATF_INIT_TEST_CASES(tcs)
+{
+    ATF_ADD_TEST_CASE(tcs, decode_contents__none);
+    ATF_ADD_TEST_CASE(tcs, decode_contents__unknown_codec);
+
+    ATF_ADD_TEST_CASE(tcs, zlib__round_trip__small);
+    ATF_ADD_TEST_CASE(tcs, zlib__round_trip__large);
+    ATF_ADD_TEST_CASE(tcs, zlib__decode__truncated);
+    ATF_ADD_TEST_CASE(tcs, zlib__decode__garbage);
+
+    ATF_ADD_TEST_CASE(tcs, decoder__none);
+    ATF_ADD_TEST_CASE(tcs, decoder__zlib__small_input_chunks);
+    ATF_ADD_TEST_CASE(tcs, decoder__zlib__stop);
+    ATF_ADD_TEST_CASE(tcs, decoder__zlib__truncated);
+}
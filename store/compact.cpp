@@ -0,0 +1,221 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "store/compact.hpp"
+
+extern "C" {
+#include <sys/stat.h>
+}
+
+#include "store/exceptions.hpp"
+#include "store/read_backend.hpp"
+#include "store/segment.hpp"
+#include "utils/format/macros.hpp"
+#include "utils/fs/exceptions.hpp"
+#include "utils/fs/operations.hpp"
+#include "utils/fs/path.hpp"
+#include "utils/logging/macros.hpp"
+#include "utils/sanity.hpp"
+#include "utils/sqlite/database.hpp"
+#include "utils/sqlite/exceptions.hpp"
+#include "utils/sqlite/statement.ipp"
+#include "utils/sqlite/transaction.hpp"
+
+namespace fs = utils::fs;
+namespace sqlite = utils::sqlite;
+
+
+namespace {
+
+
+/// Queries a single integer PRAGMA of a database.
+///
+/// \param db The database to query.
+/// \param name The name of the pragma.
+///
+/// \return The value of the pragma.
+static int64_t
+query_pragma(sqlite::database& db, const char* name)
+{
+    sqlite::statement stmt = db.create_statement(F("PRAGMA %s") % name);
+    const bool has_row = stmt.step();
+    INV(has_row);
+    const int64_t value = stmt.column_int64(0);
+    stmt.step_without_results();
+    return value;
+}
+
+
+/// Computes the size of a database from its page count.
+///
+/// \param db The database to query.
+///
+/// \return The size of the database in bytes.
+static int64_t
+database_size(sqlite::database& db)
+{
+    return query_pragma(db, "page_count") * query_pragma(db, "page_size");
+}
+
+
+/// Computes the size of a file on disk.
+///
+/// \param file The file to query.
+///
+/// \return The size of the file in bytes, or 0 if it does not exist.
+static int64_t
+file_size(const fs::path& file)
+{
+    struct ::stat sb;
+    if (::stat(file.c_str(), &sb) == -1)
+        return 0;
+    return static_cast< int64_t >(sb.st_size);
+}
+
+
+/// Moves the contents of the files stored in a segment into the database.
+///
+/// \param db The results file to modify.
+/// \param segment The segment of the results file.
+///
+/// \return The number of moved files.
+static std::size_t
+fold_segment(sqlite::database& db, const fs::path& segment)
+{
+    sqlite::transaction tx = db.begin_transaction();
+    const std::size_t folded = store::detail::fold_segment(db, "main",
+                                                           segment, 0);
+    tx.commit();
+    return folded;
+}
+
+
+/// Detaches the stdout and stderr of all passed test cases.
+///
+/// The contents of the files are deleted only once no other test case
+/// references them, as identical outputs are shared across test cases.
+///
+/// \param db The results file to modify.
+///
+/// \return The number of detached files.
+static std::size_t
+strip_passed_output(sqlite::database& db)
+{
+    sqlite::transaction tx = db.begin_transaction();
+
+    const char* where =
+        "WHERE file_name IN ('__STDOUT__', '__STDERR__') "
+        "    AND test_case_id IN ("
+        "        SELECT test_case_id FROM test_results "
+        "        WHERE result_type = 'passed')";
+
+    sqlite::statement count = db.create_statement(
+        F("SELECT COUNT(*) FROM test_case_files %s") % where);
+    const bool has_row = count.step();
+    INV(has_row);
+    const std::size_t stripped = static_cast< std::size_t >(
+        count.column_int64(0));
+    count.step_without_results();
+
+    if (stripped > 0) {
+        db.exec(F("DELETE FROM test_case_files %s") % where);
+        db.exec("DELETE FROM files WHERE file_id NOT IN ("
+                "    SELECT file_id FROM test_case_files)");
+    }
+
+    tx.commit();
+    return stripped;
+}
+
+
+}  // anonymous namespace
+
+
+/// Reclaims the unused space of a results file.
+///
+/// The file is rebuilt in place with VACUUM, which drops its free pages and
+/// defragments its tables.  This is skipped if the file has no free pages to
+/// begin with, as happens for files that were never modified after their
+/// test run finished, so compacting an already-compact store is cheap.
+///
+/// If the test run appended the contents of its files to a segment next to
+/// the results file, these are moved back into the file first and the
+/// segment is deleted, so that the results file becomes self-contained.
+///
+/// \param file The results file to compact.
+/// \param strip_output Whether to delete the stdout and stderr of the test
+///     cases that passed before rebuilding the file.  The results themselves
+///     are kept.
+///
+/// \return The sizes of the file before and after compacting it.
+///
+/// \throw error If the file is not a valid results file or if the compaction
+///     fails.
+store::compact_stats
+store::compact_results(const fs::path& file, const bool strip_output)
+{
+    // Opening the file through the read backend validates its schema
+    // version; the compaction itself runs entirely within SQLite.
+    read_backend::open_ro(file).close();
+
+    const fs::path segment = detail::segment_path(file);
+    const bool has_segment = fs::exists(segment);
+
+    compact_stats stats;
+    sqlite::database db = detail::open_and_setup(file, sqlite::open_readwrite);
+    try {
+        stats.old_size = database_size(db) + file_size(segment);
+        stats.folded_files = has_segment ? fold_segment(db, segment) : 0;
+        stats.stripped_files = strip_output ? strip_passed_output(db) : 0;
+
+        if (stats.stripped_files > 0 ||
+            query_pragma(db, "freelist_count") > 0) {
+            LI(F("Vacuuming results file %s") % file);
+            // VACUUM cannot run within a transaction.
+            db.exec("VACUUM");
+        }
+
+        stats.new_size = database_size(db);
+        db.close();
+    } catch (const sqlite::error& e) {
+        db.close();
+        throw store::error(F("Failed to compact '%s': %s") % file % e.what());
+    } catch (const store::error& e) {
+        db.close();
+        throw store::error(F("Failed to compact '%s': %s") % file % e.what());
+    }
+
+    if (has_segment) {
+        try {
+            fs::unlink(segment);
+        } catch (const fs::error& e) {
+            LW(F("Failed to delete segment %s: %s") % segment % e.what());
+        }
+    }
+    return stats;
+}
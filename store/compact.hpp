@@ -0,0 +1,67 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// \file store/compact.hpp
+/// Utilities to reclaim the space used by old results files.
+
+#if !defined(STORE_COMPACT_HPP)
+#define STORE_COMPACT_HPP
+
+extern "C" {
+#include <stdint.h>
+}
+
+#include <cstddef>
+
+#include "utils/fs/path_fwd.hpp"
+
+namespace store {
+
+
+/// Summary of the work done by compact_results().
+struct compact_stats {
+    /// Size of the results file, in bytes, before it was compacted.
+    int64_t old_size;
+
+    /// Size of the results file, in bytes, after it was compacted.
+    int64_t new_size;
+
+    /// Number of files whose contents were moved in from a segment.
+    std::size_t folded_files;
+
+    /// Number of stdout and stderr files that were detached from test cases.
+    std::size_t stripped_files;
+};
+
+
+compact_stats compact_results(const utils::fs::path&, const bool);
+
+
+}  // namespace store
+
+#endif  // !defined(STORE_COMPACT_HPP)
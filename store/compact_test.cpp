@@ -0,0 +1,230 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "store/compact.hpp"
+
+#include <map>
+#include <string>
+
+#include <atf-c++.hpp>
+
+#include "model/context.hpp"
+#include "model/metadata.hpp"
+#include "model/test_program.hpp"
+#include "model/test_result.hpp"
+#include "store/exceptions.hpp"
+#include "store/read_backend.hpp"
+#include "store/read_transaction.hpp"
+#include "store/write_backend.hpp"
+#include "store/write_transaction.hpp"
+#include "utils/datetime.hpp"
+#include "utils/fs/operations.hpp"
+#include "utils/fs/path.hpp"
+#include "utils/logging/operations.hpp"
+#include "utils/optional.ipp"
+#include "utils/sqlite/database.hpp"
+#include "utils/sqlite/statement.ipp"
+
+namespace datetime = utils::datetime;
+namespace fs = utils::fs;
+namespace logging = utils::logging;
+namespace sqlite = utils::sqlite;
+
+
+namespace {
+
+
+/// Creates a results file with a passed and a failed test case.
+///
+/// Both test cases get the same stdout, so the contents are shared, and the
+/// failed one gets a stderr too.
+///
+/// \param file The results file to create.
+/// \param segment Whether to store the contents of the files in a segment.
+static void
+create_results(const char* file, const bool segment = false)
+{
+    store::write_backend backend = store::write_backend::open_rw(
+        fs::path(file));
+    store::write_transaction tx = backend.start_write();
+    if (segment)
+        tx.set_segment_threshold(0);
+
+    tx.put_context(model::context(fs::path("/the/cwd"),
+                                  std::map< std::string, std::string >()));
+
+    const model::test_program test_program = model::test_program_builder(
+        "plain", fs::path("prog"), fs::path("/the/root"), "suite")
+        .add_test_case("pass")
+        .add_test_case("fail")
+        .build();
+    const int64_t tp_id = tx.put_test_program(test_program);
+    const datetime::timestamp start =
+        datetime::timestamp::from_values(2015, 1, 2, 3, 4, 5, 0);
+    const datetime::timestamp end =
+        datetime::timestamp::from_values(2015, 1, 2, 3, 4, 6, 0);
+    atf::utils::create_file("stdout.txt", "shared stdout\n");
+    atf::utils::create_file("stderr.txt", "failure details\n");
+
+    const int64_t pass_id = tx.put_test_case(test_program, "pass", tp_id);
+    tx.put_test_case_file("__STDOUT__", fs::path("stdout.txt"), pass_id);
+    tx.put_result(model::test_result(model::test_result_passed), pass_id,
+                  start, end);
+
+    const int64_t fail_id = tx.put_test_case(test_program, "fail", tp_id);
+    tx.put_test_case_file("__STDOUT__", fs::path("stdout.txt"), fail_id);
+    tx.put_test_case_file("__STDERR__", fs::path("stderr.txt"), fail_id);
+    tx.put_result(model::test_result(model::test_result_failed, "Oops"),
+                  fail_id, start, end);
+
+    tx.commit();
+    backend.close();
+}
+
+
+/// Counts the rows in a table of a results file.
+///
+/// \param file The results file to query.
+/// \param table The name of the table.
+///
+/// \return The number of rows.
+static int64_t
+count_rows(const char* file, const char* table)
+{
+    sqlite::database db = sqlite::database::open(fs::path(file),
+                                                 sqlite::open_readonly);
+    sqlite::statement stmt = db.create_statement(
+        std::string("SELECT COUNT(*) FROM ") + table);
+    ATF_REQUIRE(stmt.step());
+    return stmt.column_int64(0);
+}
+
+
+}  // anonymous namespace
+
+
+ATF_TEST_CASE(compact_results__keep_output);
+ATF_TEST_CASE_HEAD(compact_results__keep_output)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(compact_results__keep_output)
+{
+    create_results("test.db");
+
+    const store::compact_stats stats = store::compact_results(
+        fs::path("test.db"), false);
+    ATF_REQUIRE_EQ(0U, stats.stripped_files);
+    ATF_REQUIRE(stats.new_size <= stats.old_size);
+    ATF_REQUIRE_EQ(3, count_rows("test.db", "test_case_files"));
+    ATF_REQUIRE_EQ(2, count_rows("test.db", "files"));
+    ATF_REQUIRE_EQ(2, count_rows("test.db", "test_results"));
+}
+
+
+ATF_TEST_CASE(compact_results__strip_passed_output);
+ATF_TEST_CASE_HEAD(compact_results__strip_passed_output)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(compact_results__strip_passed_output)
+{
+    create_results("test.db");
+
+    const store::compact_stats stats = store::compact_results(
+        fs::path("test.db"), true);
+    ATF_REQUIRE_EQ(1U, stats.stripped_files);
+    ATF_REQUIRE_EQ(2, count_rows("test.db", "test_case_files"));
+    // The stdout of the passed test case is shared with the failed one, so
+    // its contents must survive.
+    ATF_REQUIRE_EQ(2, count_rows("test.db", "files"));
+    ATF_REQUIRE_EQ(2, count_rows("test.db", "test_results"));
+
+    // The file must still be readable after compacting it.
+    store::read_backend::open_ro(fs::path("test.db")).close();
+
+    const store::compact_stats again = store::compact_results(
+        fs::path("test.db"), true);
+    ATF_REQUIRE_EQ(0U, again.stripped_files);
+    ATF_REQUIRE_EQ(again.old_size, again.new_size);
+}
+
+
+ATF_TEST_CASE(compact_results__fold_segment);
+ATF_TEST_CASE_HEAD(compact_results__fold_segment)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(compact_results__fold_segment)
+{
+    create_results("test.db", true);
+    ATF_REQUIRE(fs::exists(fs::path("test.db-files")));
+    ATF_REQUIRE_EQ(2, count_rows("test.db", "files"));
+
+    const store::compact_stats stats = store::compact_results(
+        fs::path("test.db"), false);
+    ATF_REQUIRE_EQ(2U, stats.folded_files);
+    ATF_REQUIRE(!fs::exists(fs::path("test.db-files")));
+    ATF_REQUIRE_EQ(2, count_rows("test.db", "files"));
+
+    store::read_backend backend = store::read_backend::open_ro(
+        fs::path("test.db"));
+    store::read_transaction tx = backend.start_read();
+    store::results_iterator iter = tx.get_results();
+    ATF_REQUIRE(iter);
+    ATF_REQUIRE_EQ("shared stdout\n", iter.stdout_contents());
+    ATF_REQUIRE_EQ("failure details\n", iter.stderr_contents());
+    ATF_REQUIRE(++iter);
+    ATF_REQUIRE_EQ("shared stdout\n", iter.stdout_contents());
+    ATF_REQUIRE(!++iter);
+}
+
+
+ATF_TEST_CASE(compact_results__invalid_file);
+ATF_TEST_CASE_HEAD(compact_results__invalid_file)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(compact_results__invalid_file)
+{
+    ATF_REQUIRE_THROW(store::error,
+                      store::compact_results(fs::path("missing.db"), false));
+}
+
+
+ATF_INIT_TEST_CASES(tcs)
+{
+    ATF_ADD_TEST_CASE(tcs, compact_results__keep_output);
+    ATF_ADD_TEST_CASE(tcs, compact_results__strip_passed_output);
+    ATF_ADD_TEST_CASE(tcs, compact_results__fold_segment);
+    ATF_ADD_TEST_CASE(tcs, compact_results__invalid_file);
+}
@@ -40,6 +40,37 @@ namespace datetime = utils::datetime;
 namespace sqlite = utils::sqlite;
 
 
+namespace {
+
+
+/// Queries a sequence of integer columns from a statement.
+///
+/// \param stmt The statement from which to get the columns.
+/// \param first_column The index of the first column to get.
+/// \param count The number of consecutive columns to get.
+/// \param [out] values Array of at least count elements to store the values
+///     in.
+/// \param what Description of the values, for error reporting purposes.
+///
+/// \throw integrity_error If any of the columns is not an integer.
+static void
+column_integers(sqlite::statement& stmt, const int first_column,
+                const std::size_t count, int64_t* values, const char* what)
+{
+    for (std::size_t i = 0; i < count; ++i) {
+        const int id = first_column + static_cast< int >(i);
+        if (stmt.column_type(id) != sqlite::type_integer)
+            throw store::integrity_error(F("%s in column %s is not an "
+                                           "integer") % what %
+                                         stmt.column_name(id));
+        values[i] = stmt.column_int64(id);
+    }
+}
+
+
+}  // anonymous namespace
+
+
 /// Binds a boolean value to a statement parameter.
 ///
 /// \param stmt The statement to which to bind the parameter.
@@ -93,26 +124,42 @@ store::bind_optional_string(sqlite::statement& stmt, const char* field,
 void
 store::bind_test_result_type(sqlite::statement& stmt, const char* field,
                              const model::test_result_type& type)
+{
+    const sqlite::parameter< std::string > parameter = {
+        stmt.bind_parameter_index(field), field };
+    bind_test_result_type(stmt, parameter, type);
+}
+
+
+/// Binds a test result type to a statement parameter by its position.
+///
+/// \param stmt The statement to which to bind the parameter.
+/// \param parameter The parameter; must exist.
+/// \param type The result type to bind.
+void
+store::bind_test_result_type(sqlite::statement& stmt,
+                             const sqlite::parameter< std::string >& parameter,
+                             const model::test_result_type& type)
 {
     switch (type) {
     case model::test_result_broken:
-        stmt.bind(field, "broken");
+        stmt.bind(parameter, "broken");
         break;
 
     case model::test_result_expected_failure:
-        stmt.bind(field, "expected_failure");
+        stmt.bind(parameter, "expected_failure");
         break;
 
     case model::test_result_failed:
-        stmt.bind(field, "failed");
+        stmt.bind(parameter, "failed");
         break;
 
     case model::test_result_passed:
-        stmt.bind(field, "passed");
+        stmt.bind(parameter, "passed");
         break;
 
     case model::test_result_skipped:
-        stmt.bind(field, "skipped");
+        stmt.bind(parameter, "skipped");
         break;
 
     default:
@@ -134,6 +181,20 @@ store::bind_timestamp(sqlite::statement& stmt, const char* field,
 }
 
 
+/// Binds a timestamp to a statement parameter by its position.
+///
+/// \param stmt The statement to which to bind the parameter.
+/// \param parameter The parameter; must exist.
+/// \param timestamp The value to bind.
+void
+store::bind_timestamp(sqlite::statement& stmt,
+                      const sqlite::parameter< int64_t >& parameter,
+                      const datetime::timestamp& timestamp)
+{
+    stmt.bind(parameter, timestamp.to_microseconds());
+}
+
+
 /// Queries a boolean value from a statement.
 ///
 /// \param stmt The statement from which to get the column.
@@ -178,6 +239,27 @@ store::column_delta(sqlite::statement& stmt, const char* column)
 }
 
 
+/// Queries a sequence of time deltas from a statement.
+///
+/// This is intended for readers that go over many rows and only need the raw
+/// values: the columns are located by index and the values are returned in
+/// microseconds, so no per-row name lookups nor objects are involved.
+///
+/// \param stmt The statement from which to get the columns.
+/// \param first_column The index of the first column holding a delta.
+/// \param count The number of consecutive columns holding deltas.
+/// \param [out] values Array of at least count elements to store the deltas
+///     in, in microseconds.
+///
+/// \throw integrity_error If the value in any of the columns is invalid.
+void
+store::column_deltas(sqlite::statement& stmt, const int first_column,
+                     const std::size_t count, int64_t* values)
+{
+    column_integers(stmt, first_column, count, values, "Time delta");
+}
+
+
 /// Queries an optional string from a statement.
 ///
 /// \param stmt The statement from which to get the column.
@@ -189,14 +271,34 @@ store::column_delta(sqlite::statement& stmt, const char* column)
 std::string
 store::column_optional_string(sqlite::statement& stmt, const char* column)
 {
-    const int id = stmt.column_id(column);
-    switch (stmt.column_type(id)) {
+    const sqlite::column< std::string > typed = {
+        stmt.column_id(column), column };
+    return column_optional_string(stmt, typed);
+}
+
+
+/// Queries an optional string from a statement by the position of its column.
+///
+/// \param stmt The statement from which to get the column.
+/// \param column The column holding the value.
+///
+/// \return The string value if not null, or an empty string.
+///
+/// \throw integrity_error If the type of the column is invalid.
+std::string
+store::column_optional_string(sqlite::statement& stmt,
+                              const sqlite::column< std::string >& column)
+{
+    PRE_MSG(stmt.column_name(column.index) == column.name,
+            F("Column index %s does not match its name") % column.index);
+    switch (stmt.column_type(column.index)) {
     case sqlite::type_text:
-        return stmt.column_text(id);
+        return stmt.column_text(column.index);
     case sqlite::type_null:
         return "";
     default:
-        throw integrity_error(F("Invalid string type in column %s") % column);
+        throw integrity_error(F("Invalid string type in column %s") %
+                              column.name);
     }
 }
 
@@ -212,11 +314,30 @@ store::column_optional_string(sqlite::statement& stmt, const char* column)
 model::test_result_type
 store::column_test_result_type(sqlite::statement& stmt, const char* column)
 {
-    const int id = stmt.column_id(column);
-    if (stmt.column_type(id) != sqlite::type_text)
+    const sqlite::column< std::string > typed = {
+        stmt.column_id(column), column };
+    return column_test_result_type(stmt, typed);
+}
+
+
+/// Queries a test result type from a statement by the position of its column.
+///
+/// \param stmt The statement from which to get the column.
+/// \param column The column holding the value.
+///
+/// \return The parsed value if all goes well.
+///
+/// \throw integrity_error If the value in the column is invalid.
+model::test_result_type
+store::column_test_result_type(sqlite::statement& stmt,
+                               const sqlite::column< std::string >& column)
+{
+    PRE_MSG(stmt.column_name(column.index) == column.name,
+            F("Column index %s does not match its name") % column.index);
+    if (stmt.column_type(column.index) != sqlite::type_text)
         throw store::integrity_error(F("Result type in column %s is not a "
-                                       "string") % column);
-    const std::string type = stmt.column_text(id);
+                                       "string") % column.name);
+    const std::string type = stmt.column_text(column.index);
     if (type == "passed") {
         return model::test_result_passed;
     } else if (type == "broken") {
@@ -244,13 +365,56 @@ store::column_test_result_type(sqlite::statement& stmt, const char* column)
 datetime::timestamp
 store::column_timestamp(sqlite::statement& stmt, const char* column)
 {
-    const int id = stmt.column_id(column);
-    if (stmt.column_type(id) != sqlite::type_integer)
+    const sqlite::column< int64_t > typed = { stmt.column_id(column), column };
+    return column_timestamp(stmt, typed);
+}
+
+
+/// Queries a timestamp from a statement by the position of its column.
+///
+/// \param stmt The statement from which to get the column.
+/// \param column The column holding the value.
+///
+/// \return The parsed value if all goes well.
+///
+/// \throw integrity_error If the value in the column is invalid.
+datetime::timestamp
+store::column_timestamp(sqlite::statement& stmt,
+                        const sqlite::column< int64_t >& column)
+{
+    PRE_MSG(stmt.column_name(column.index) == column.name,
+            F("Column index %s does not match its name") % column.index);
+    if (stmt.column_type(column.index) != sqlite::type_integer)
         throw store::integrity_error(F("Timestamp in column %s is not an "
-                                       "integer") % column);
-    const int64_t value = stmt.column_int64(id);
+                                       "integer") % column.name);
+    const int64_t value = stmt.column_int64(column.index);
     if (value < 0)
         throw store::integrity_error(F("Timestamp in column %s must be "
-                                       "positive") % column);
+                                       "positive") % column.name);
     return datetime::timestamp::from_microseconds(value);
 }
+
+
+/// Queries a sequence of timestamps from a statement.
+///
+/// This is the counterpart of column_deltas() for timestamps.
+///
+/// \param stmt The statement from which to get the columns.
+/// \param first_column The index of the first column holding a timestamp.
+/// \param count The number of consecutive columns holding timestamps.
+/// \param [out] values Array of at least count elements to store the
+///     timestamps in, in microseconds since the epoch.
+///
+/// \throw integrity_error If the value in any of the columns is invalid.
+void
+store::column_timestamps(sqlite::statement& stmt, const int first_column,
+                         const std::size_t count, int64_t* values)
+{
+    column_integers(stmt, first_column, count, values, "Timestamp");
+    for (std::size_t i = 0; i < count; ++i) {
+        if (values[i] < 0)
+            throw store::integrity_error(
+                F("Timestamp in column %s must be positive") %
+                stmt.column_name(first_column + static_cast< int >(i)));
+    }
+}
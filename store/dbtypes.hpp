@@ -38,6 +38,7 @@
 #endif  // !defined(STORE_DBTYPES_HPP)
 #define STORE_DBTYPES_HPP
 
+#include <cstddef>
 #include <string>
 
 #include "model/test_result_fwd.hpp"
@@ -54,15 +55,31 @@ void bind_optional_string(utils::sqlite::statement&, const char*,
                           const std::string&);
 void bind_test_result_type(utils::sqlite::statement&, const char*,
                            const model::test_result_type&);
+void bind_test_result_type(utils::sqlite::statement&,
+                           const utils::sqlite::parameter< std::string >&,
+                           const model::test_result_type&);
 void bind_timestamp(utils::sqlite::statement&, const char*,
                     const utils::datetime::timestamp&);
+void bind_timestamp(utils::sqlite::statement&,
+                    const utils::sqlite::parameter< int64_t >&,
+                    const utils::datetime::timestamp&);
 bool column_bool(utils::sqlite::statement&, const char*);
 utils::datetime::delta column_delta(utils::sqlite::statement&, const char*);
+void column_deltas(utils::sqlite::statement&, const int, const std::size_t,
+                   int64_t*);
 std::string column_optional_string(utils::sqlite::statement&, const char*);
+std::string column_optional_string(
+    utils::sqlite::statement&, const utils::sqlite::column< std::string >&);
 model::test_result_type column_test_result_type(
     utils::sqlite::statement&, const char*);
+model::test_result_type column_test_result_type(
+    utils::sqlite::statement&, const utils::sqlite::column< std::string >&);
 utils::datetime::timestamp column_timestamp(utils::sqlite::statement&,
                                             const char*);
+utils::datetime::timestamp column_timestamp(
+    utils::sqlite::statement&, const utils::sqlite::column< int64_t >&);
+void column_timestamps(utils::sqlite::statement&, const int,
+                       const std::size_t, int64_t*);
 
 
 }  // namespace store
@@ -140,6 +140,34 @@ ATF_TEST_CASE_BODY(delta__get_invalid_type)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(deltas__ok);
+ATF_TEST_CASE_BODY(deltas__ok)
+{
+    sqlite::database db = sqlite::database::in_memory();
+    sqlite::statement query = db.create_statement("SELECT 'x', 5, 0, 1234");
+    ATF_REQUIRE(query.step());
+    int64_t values[3];
+    store::column_deltas(query, 1, 3, values);
+    ATF_REQUIRE_EQ(5, values[0]);
+    ATF_REQUIRE_EQ(0, values[1]);
+    ATF_REQUIRE_EQ(1234, values[2]);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(deltas__get_invalid_type);
+ATF_TEST_CASE_BODY(deltas__get_invalid_type)
+{
+    sqlite::database db = sqlite::database::in_memory();
+    sqlite::statement query = db.create_statement(
+        "SELECT 5, 'x' AS second");
+    ATF_REQUIRE(query.step());
+    int64_t values[2];
+    ATF_REQUIRE_THROW_RE(store::integrity_error,
+                         "delta in column second is not an integer",
+                         store::column_deltas(query, 0, 2, values));
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(optional_string__ok);
 ATF_TEST_CASE_BODY(optional_string__ok)
 {
@@ -212,6 +240,59 @@ ATF_TEST_CASE_BODY(timestamp__get_invalid_value)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(timestamps__ok);
+ATF_TEST_CASE_BODY(timestamps__ok)
+{
+    const datetime::timestamp timestamp = datetime::timestamp::from_values(
+        2012, 2, 9, 23, 15, 51, 987654);
+
+    sqlite::database db = sqlite::database::in_memory();
+    db.exec("CREATE TABLE test (start_time DONTCARE, end_time DONTCARE)");
+    sqlite::statement insert = db.create_statement(
+        "INSERT INTO test VALUES (:start_time, :end_time)");
+    store::bind_timestamp(insert, ":start_time", timestamp);
+    store::bind_timestamp(insert, ":end_time",
+                          datetime::timestamp::from_microseconds(0));
+    insert.step_without_results();
+
+    sqlite::statement query = db.create_statement("SELECT * FROM test");
+    ATF_REQUIRE(query.step());
+    int64_t values[2];
+    store::column_timestamps(query, 0, 2, values);
+    ATF_REQUIRE_EQ(timestamp.to_microseconds(), values[0]);
+    ATF_REQUIRE_EQ(0, values[1]);
+    ATF_REQUIRE(!query.step());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(timestamps__get_invalid_type);
+ATF_TEST_CASE_BODY(timestamps__get_invalid_type)
+{
+    sqlite::database db = sqlite::database::in_memory();
+    sqlite::statement query = db.create_statement(
+        "SELECT 5, 35.6 AS second");
+    ATF_REQUIRE(query.step());
+    int64_t values[2];
+    ATF_REQUIRE_THROW_RE(store::integrity_error,
+                         "Timestamp in column second is not an integer",
+                         store::column_timestamps(query, 0, 2, values));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(timestamps__get_invalid_value);
+ATF_TEST_CASE_BODY(timestamps__get_invalid_value)
+{
+    sqlite::database db = sqlite::database::in_memory();
+    sqlite::statement query = db.create_statement(
+        "SELECT 5, -1234 AS second");
+    ATF_REQUIRE(query.step());
+    int64_t values[2];
+    ATF_REQUIRE_THROW_RE(store::integrity_error,
+                         "Timestamp in column second must be positive",
+                         store::column_timestamps(query, 0, 2, values));
+}
+
+
 ATF_INIT_TEST_CASES(tcs)
 {
     ATF_ADD_TEST_CASE(tcs, bool__ok);
@@ -220,6 +301,8 @@ ATF_INIT_TEST_CASES(tcs)
 
     ATF_ADD_TEST_CASE(tcs, delta__ok);
     ATF_ADD_TEST_CASE(tcs, delta__get_invalid_type);
+    ATF_ADD_TEST_CASE(tcs, deltas__ok);
+    ATF_ADD_TEST_CASE(tcs, deltas__get_invalid_type);
 
     ATF_ADD_TEST_CASE(tcs, optional_string__ok);
     ATF_ADD_TEST_CASE(tcs, optional_string__get_invalid_type);
@@ -231,4 +314,7 @@ ATF_INIT_TEST_CASES(tcs)
     ATF_ADD_TEST_CASE(tcs, timestamp__ok);
     ATF_ADD_TEST_CASE(tcs, timestamp__get_invalid_type);
     ATF_ADD_TEST_CASE(tcs, timestamp__get_invalid_value);
+    ATF_ADD_TEST_CASE(tcs, timestamps__ok);
+    ATF_ADD_TEST_CASE(tcs, timestamps__get_invalid_type);
+    ATF_ADD_TEST_CASE(tcs, timestamps__get_invalid_value);
 }
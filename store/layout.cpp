@@ -28,10 +28,19 @@
 
 #include "store/layout.hpp"
 
+extern "C" {
+#include <sys/param.h>
+
+#include <unistd.h>
+}
+
 #include <algorithm>
+#include <cerrno>
+#include <cstdio>
 #include <cstring>
 
 #include "store/exceptions.hpp"
+#include "store/segment.hpp"
 #include "utils/datetime.hpp"
 #include "utils/format/macros.hpp"
 #include "utils/fs/directory.hpp"
@@ -56,8 +65,98 @@ using utils::optional;
 namespace {
 
 
+/// Computes the path to the link to the latest results file of a test suite.
+///
+/// \param store_dir The store directory.
+/// \param test_suite Identifier of the test suite.
+///
+/// \return The path to the symbolic link.
+static fs::path
+latest_link(const fs::path& store_dir, const std::string& test_suite)
+{
+    return store_dir / (F("results.%s.latest") % test_suite);
+}
+
+
+/// Reads the link to the latest results file of a test suite.
+///
+/// The link is only a hint maintained by new_db(): it is ignored if it is
+/// missing, if it does not point to a results file of the suite or if such
+/// file does not exist (yet).
+///
+/// \param store_dir The store directory.
+/// \param test_suite Identifier of the test suite.
+///
+/// \return The path to the results file, if the link is valid.
+static optional< fs::path >
+read_latest_link(const fs::path& store_dir, const std::string& test_suite)
+{
+    const fs::path link = latest_link(store_dir, test_suite);
+
+    char buffer[MAXPATHLEN];
+    const ssize_t length = ::readlink(link.c_str(), buffer, sizeof(buffer));
+    if (length == -1 || length == sizeof(buffer))
+        return utils::none;
+    const std::string target(buffer, length);
+
+    const std::string prefix = F("results.%s.") % test_suite;
+    if (target.find('/') != std::string::npos ||
+        target.compare(0, prefix.length(), prefix) != 0) {
+        LW(F("Ignoring invalid link %s") % link);
+        return utils::none;
+    }
+
+    const fs::path file = store_dir / target;
+    if (!fs::exists(file))
+        return utils::none;
+    return utils::make_optional(file);
+}
+
+
+/// Points the link to the latest results file of a test suite to a new file.
+///
+/// The link is replaced atomically and is left untouched if it already points
+/// to a more recent file.  Failures are not fatal because find_latest() falls
+/// back to scanning the store directory.
+///
+/// \param store_dir The store directory.
+/// \param test_suite Identifier of the test suite.
+/// \param file The new results file; must live in store_dir.
+static void
+update_latest_link(const fs::path& store_dir, const std::string& test_suite,
+                   const fs::path& file)
+{
+    const fs::path link = latest_link(store_dir, test_suite);
+
+    char buffer[MAXPATHLEN];
+    const ssize_t length = ::readlink(link.c_str(), buffer, sizeof(buffer));
+    if (length != -1 && std::string(buffer, length) > file.leaf_name()) {
+        LD(F("Not updating %s; it points to a newer file") % link);
+        return;
+    }
+
+    const fs::path temp(F("%s.%s") % link % ::getpid());
+    ::unlink(temp.c_str());
+    if (::symlink(file.leaf_name().c_str(), temp.c_str()) == -1) {
+        const int original_errno = errno;
+        LW(F("Cannot create link %s: %s") % temp %
+           std::strerror(original_errno));
+        return;
+    }
+    if (std::rename(temp.c_str(), link.c_str()) == -1) {
+        const int original_errno = errno;
+        LW(F("Cannot rename %s to %s: %s") % temp % link %
+           std::strerror(original_errno));
+        ::unlink(temp.c_str());
+    }
+}
+
+
 /// Finds the results file for the latest run of the given test suite.
 ///
+/// The link maintained by new_db() is consulted first so that we do not have
+/// to scan store directories that hold many results files.
+///
 /// \param test_suite Identifier of the test suite to query.
 ///
 /// \return Path to the located database holding the most recent data for the
@@ -67,39 +166,16 @@ namespace {
 static fs::path
 find_latest(const std::string& test_suite)
 {
-    const fs::path store_dir = layout::query_store_dir();
-    try {
-        const text::regex preg = text::regex::compile(
-            F("^results.%s.[0-9]{8}-[0-9]{6}-[0-9]{6}.db$") % test_suite, 0);
-
-        std::string latest;
+    const optional< fs::path > latest = read_latest_link(
+        layout::query_store_dir(), test_suite);
+    if (latest)
+        return latest.get();
 
-        const fs::directory dir(store_dir);
-        for (fs::directory::const_iterator iter = dir.begin();
-             iter != dir.end(); ++iter) {
-            const text::regex_matches matches = preg.match(iter->name);
-            if (matches) {
-                if (latest.empty() || iter->name > latest) {
-                    latest = iter->name;
-                }
-            } else {
-                // Not a database file; skip.
-            }
-        }
-
-        if (latest.empty())
-            throw store::error(
-                F("No previous results file found for test suite %s")
-                % test_suite);
-
-        return store_dir / latest;
-    } catch (const fs::system_error& e) {
-        LW(F("Failed to open store dir %s: %s") % store_dir % e.what());
+    const std::vector< fs::path > files = layout::list_results(test_suite);
+    if (files.empty())
         throw store::error(F("No previous results file found for test suite %s")
                            % test_suite);
-    } catch (const text::regex_error& e) {
-        throw store::error(e.what());
-    }
+    return files.back();
 }
 
 
@@ -133,6 +209,12 @@ const char* layout::results_auto_create_name = "NEW";
 const char* layout::results_auto_open_name = "LATEST";
 
 
+/// Value to request that the results of a run are not stored in any file.
+///
+/// Callers must check for this value themselves before calling new_db().
+const char* layout::results_in_memory_name = ":memory:";
+
+
 /// Resolves the results file for the given identifier.
 ///
 /// \param id Identifier of the test suite to open.
@@ -172,6 +254,99 @@ layout::find_results(const std::string& id)
 }
 
 
+/// Lists the timestamped results files of all test suites in the store.
+///
+/// This needs a single scan of the store directory regardless of how many
+/// test suites it holds results for.
+///
+/// \return The results files of each test suite, from the oldest to the most
+/// recent one.  If the store directory cannot be read, this is empty.
+layout::results_map
+layout::list_all_results(void)
+{
+    const fs::path store_dir = query_store_dir();
+    try {
+        const text::regex preg = text::regex::compile_cached(
+            "^results\\.(.+)\\.[0-9]{8}-[0-9]{6}-[0-9]{6}\\.db$", 1);
+
+        std::map< std::string, std::vector< std::string > > names;
+
+        text::regex_matches matches;
+        const fs::directory dir(store_dir);
+        for (fs::directory::const_iterator iter = dir.begin();
+             iter != dir.end(); ++iter) {
+            if (preg.match(iter->name, matches)) {
+                names[matches.get(1)].push_back(iter->name);
+            } else {
+                // Not a database file; skip.
+            }
+        }
+
+        results_map files;
+        for (std::map< std::string, std::vector< std::string > >::iterator
+                 iter = names.begin(); iter != names.end(); ++iter) {
+            std::vector< std::string >& suite_names = (*iter).second;
+            std::sort(suite_names.begin(), suite_names.end());
+
+            std::vector< fs::path >& suite_files = files[(*iter).first];
+            for (std::vector< std::string >::const_iterator
+                     iter2 = suite_names.begin(); iter2 != suite_names.end();
+                 ++iter2)
+                suite_files.push_back(store_dir / *iter2);
+        }
+        return files;
+    } catch (const fs::system_error& e) {
+        LW(F("Failed to open store dir %s: %s") % store_dir % e.what());
+        return results_map();
+    }
+}
+
+
+/// Lists the timestamped results files of a test suite in the store directory.
+///
+/// \param test_suite Identifier of the test suite to query.
+///
+/// \return Paths to the results files of the test suite, from the oldest to
+/// the most recent one.  If the store directory cannot be read, this is
+/// empty.
+///
+/// \throw store::error If the test suite identifier is invalid.
+std::vector< fs::path >
+layout::list_results(const std::string& test_suite)
+{
+    const fs::path store_dir = query_store_dir();
+    try {
+        const text::regex preg = text::regex::compile_cached(
+            F("^results.%s.[0-9]{8}-[0-9]{6}-[0-9]{6}.db$") % test_suite, 0);
+
+        std::vector< std::string > names;
+
+        text::regex_matches matches;
+        const fs::directory dir(store_dir);
+        for (fs::directory::const_iterator iter = dir.begin();
+             iter != dir.end(); ++iter) {
+            if (preg.match(iter->name, matches)) {
+                names.push_back(iter->name);
+            } else {
+                // Not a database file; skip.
+            }
+        }
+        std::sort(names.begin(), names.end());
+
+        std::vector< fs::path > files;
+        for (std::vector< std::string >::const_iterator iter = names.begin();
+             iter != names.end(); ++iter)
+            files.push_back(store_dir / *iter);
+        return files;
+    } catch (const fs::system_error& e) {
+        LW(F("Failed to open store dir %s: %s") % store_dir % e.what());
+        return std::vector< fs::path >();
+    } catch (const text::regex_error& e) {
+        throw store::error(e.what());
+    }
+}
+
+
 /// Computes the path to a new database for the given test suite.
 ///
 /// \param id Identifier of the test suite to create.
@@ -187,10 +362,12 @@ layout::new_db(const std::string& id, const fs::path& root)
     optional< fs::path > path;
 
     if (id == results_auto_create_name) {
-        generated_id = new_id(test_suite_for_path(root),
-                              datetime::timestamp::now());
-        path = query_store_dir() / (F("results.%s.db") % generated_id);
-        fs::mkdir_p(path.get().branch_path(), 0755);
+        const std::string test_suite = test_suite_for_path(root);
+        generated_id = new_id(test_suite, datetime::timestamp::now());
+        const fs::path store_dir = query_store_dir();
+        path = store_dir / (F("results.%s.db") % generated_id);
+        fs::mkdir_p(store_dir, 0755);
+        update_latest_link(store_dir, test_suite, path.get());
     } else {
         path = fs::path(id);
     }
@@ -219,6 +396,84 @@ layout::new_db_for_migration(const fs::path& root,
 }
 
 
+/// Deletes all but the most recent results files of a test suite.
+///
+/// \param files The results files of the test suite, from the oldest to the
+///     most recent one, as returned by list_results().
+/// \param keep Number of most recent files to preserve; must be positive so
+///     that the file pointed to by the latest link is never removed.
+///
+/// The segments that hold the contents of the files of the deleted results
+/// files, if any, are deleted along with them.
+///
+/// \return The paths to the deleted files.
+///
+/// \throw store::error If any of the files cannot be deleted.
+std::vector< fs::path >
+layout::prune_results(const std::vector< fs::path >& files,
+                      const std::size_t keep)
+{
+    PRE(keep > 0);
+
+    std::vector< fs::path > removed;
+    if (files.size() <= keep)
+        return removed;
+
+    const std::size_t count = files.size() - keep;
+    for (std::size_t i = 0; i < count; ++i) {
+        try {
+            fs::unlink(files[i]);
+            const fs::path segment = store::detail::segment_path(files[i]);
+            if (fs::exists(segment))
+                fs::unlink(segment);
+        } catch (const fs::error& e) {
+            throw store::error(e.what());
+        }
+        LI(F("Pruned results file %s") % files[i]);
+        removed.push_back(files[i]);
+    }
+    return removed;
+}
+
+
+/// Gets the path to the directory holding the cache of loaded Kyuafiles.
+///
+/// Note that this function does not create the determined directory.
+///
+/// \return Path to the directory holding the Kyuafile cache entries.
+fs::path
+layout::query_kyuafile_cache_dir(void)
+{
+    return query_store_dir() / "kyuafiles";
+}
+
+
+/// Gets the path to the directory holding the cache of test case listings.
+///
+/// The cache lives within the store directory so that it shares its lifecycle
+/// with the results files.  Note that this function does not create the
+/// determined directory.
+///
+/// \return Path to the directory holding the list cache entries.
+fs::path
+layout::query_list_cache_dir(void)
+{
+    return query_store_dir() / "listings";
+}
+
+
+/// Gets the path to the directory holding the snapshots of results files.
+///
+/// Note that this function does not create the determined directory.
+///
+/// \return Path to the directory holding the snapshots.
+fs::path
+layout::query_snapshots_dir(void)
+{
+    return query_store_dir() / "snapshots";
+}
+
+
 /// Gets the path to the store directory.
 ///
 /// Note that this function does not create the determined directory.  It is the
@@ -243,6 +498,20 @@ layout::query_store_dir(void)
 }
 
 
+/// Gets the path to the index of test case trends across runs.
+///
+/// The index lives within the store directory so that it sits next to the
+/// results files it aggregates.  Note that this function does not create the
+/// store directory.
+///
+/// \return Path to the trends index database.
+fs::path
+layout::query_trends_file(void)
+{
+    return query_store_dir() / "trends.db";
+}
+
+
 /// Returns the test suite name for the current directory.
 ///
 /// \return The identifier of the current test suite.
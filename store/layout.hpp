@@ -58,7 +58,9 @@
 
 #include "store/layout_fwd.hpp"
 
+#include <cstddef>
 #include <string>
+#include <vector>
 
 #include "utils/datetime_fwd.hpp"
 #include "utils/fs/path_fwd.hpp"
@@ -69,12 +71,21 @@ namespace layout {
 
 extern const char* results_auto_create_name;
 extern const char* results_auto_open_name;
+extern const char* results_in_memory_name;
 
 utils::fs::path find_results(const std::string&);
+results_map list_all_results(void);
+std::vector< utils::fs::path > list_results(const std::string&);
 results_id_file_pair new_db(const std::string&, const utils::fs::path&);
 utils::fs::path new_db_for_migration(const utils::fs::path&,
                                      const utils::datetime::timestamp&);
+std::vector< utils::fs::path > prune_results(
+    const std::vector< utils::fs::path >&, const std::size_t);
+utils::fs::path query_kyuafile_cache_dir(void);
+utils::fs::path query_list_cache_dir(void);
+utils::fs::path query_snapshots_dir(void);
 utils::fs::path query_store_dir(void);
+utils::fs::path query_trends_file(void);
 std::string test_suite_for_path(const utils::fs::path&);
 
 
@@ -32,8 +32,10 @@
 #if !defined(STORE_LAYOUT_FWD_HPP)
 #define STORE_LAYOUT_FWD_HPP
 
+#include <map>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "utils/fs/path_fwd.hpp"
 
@@ -48,6 +50,10 @@ namespace layout {
 typedef std::pair< std::string, utils::fs::path > results_id_file_pair;
 
 
+/// Timestamped results files of each test suite, from oldest to newest.
+typedef std::map< std::string, std::vector< utils::fs::path > > results_map;
+
+
 }  // namespace layout
 }  // namespace store
 
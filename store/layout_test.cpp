@@ -33,6 +33,8 @@ extern "C" {
 }
 
 #include <iostream>
+#include <string>
+#include <vector>
 
 #include <atf-c++.hpp>
 
@@ -73,6 +75,47 @@ ATF_TEST_CASE_BODY(find_results__latest)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(find_results__latest_link);
+ATF_TEST_CASE_BODY(find_results__latest_link)
+{
+    const fs::path store_dir = layout::query_store_dir();
+    fs::mkdir_p(store_dir, 0755);
+
+    const std::string test_suite = layout::test_suite_for_path(
+        fs::current_path());
+    const std::string base = (store_dir / (
+        "results." + test_suite + ".")).str();
+
+    atf::utils::create_file(base + "20140613-194515-000000.db", "");
+    atf::utils::create_file(base + "20140614-194515-123456.db", "");
+    ATF_REQUIRE(::symlink(("results." + test_suite +
+                           ".20140613-194515-000000.db").c_str(),
+                          (base + "latest").c_str()) != -1);
+    ATF_REQUIRE_EQ(base + "20140613-194515-000000.db",
+                   layout::find_results("LATEST").str());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(find_results__latest_link_stale);
+ATF_TEST_CASE_BODY(find_results__latest_link_stale)
+{
+    const fs::path store_dir = layout::query_store_dir();
+    fs::mkdir_p(store_dir, 0755);
+
+    const std::string test_suite = layout::test_suite_for_path(
+        fs::current_path());
+    const std::string base = (store_dir / (
+        "results." + test_suite + ".")).str();
+
+    atf::utils::create_file(base + "20140613-194515-000000.db", "");
+    ATF_REQUIRE(::symlink(("results." + test_suite +
+                           ".20140614-194515-123456.db").c_str(),
+                          (base + "latest").c_str()) != -1);
+    ATF_REQUIRE_EQ(base + "20140613-194515-000000.db",
+                   layout::find_results("LATEST").str());
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(find_results__directory);
 ATF_TEST_CASE_BODY(find_results__directory)
 {
@@ -227,6 +270,70 @@ ATF_TEST_CASE_BODY(find_results__not_found)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(list_all_results__some);
+ATF_TEST_CASE_BODY(list_all_results__some)
+{
+    const fs::path store_dir = layout::query_store_dir();
+    fs::mkdir_p(store_dir, 0755);
+
+    const std::string base1 = (store_dir / "results.suite1.").str();
+    const std::string base2 = (store_dir / "results.suite.2.").str();
+    atf::utils::create_file(base1 + "20140614-194515-123456.db", "");
+    atf::utils::create_file(base2 + "20140615-111111-000000.db", "");
+    atf::utils::create_file(base1 + "20130614-194515-999999.db", "");
+    atf::utils::create_file(base1 + "invalid.db", "");
+    atf::utils::create_file((store_dir / "results.suite1.db").str(), "");
+
+    const layout::results_map files = layout::list_all_results();
+    ATF_REQUIRE_EQ(2, files.size());
+    const std::vector< fs::path >& files1 = files.find("suite1")->second;
+    ATF_REQUIRE_EQ(2, files1.size());
+    ATF_REQUIRE_EQ(base1 + "20130614-194515-999999.db", files1[0].str());
+    ATF_REQUIRE_EQ(base1 + "20140614-194515-123456.db", files1[1].str());
+    const std::vector< fs::path >& files2 = files.find("suite.2")->second;
+    ATF_REQUIRE_EQ(1, files2.size());
+    ATF_REQUIRE_EQ(base2 + "20140615-111111-000000.db", files2[0].str());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(list_all_results__none);
+ATF_TEST_CASE_BODY(list_all_results__none)
+{
+    utils::setenv("HOME", (fs::current_path() / "homedir").str());
+    ATF_REQUIRE(layout::list_all_results().empty());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(list_results__some);
+ATF_TEST_CASE_BODY(list_results__some)
+{
+    const fs::path store_dir = layout::query_store_dir();
+    fs::mkdir_p(store_dir, 0755);
+
+    const std::string base1 = (store_dir / "results.suite1.").str();
+    const std::string base2 = (store_dir / "results.suite2.").str();
+    atf::utils::create_file(base1 + "20140614-194515-123456.db", "");
+    atf::utils::create_file(base2 + "20140615-111111-000000.db", "");
+    atf::utils::create_file(base1 + "20130614-194515-999999.db", "");
+    atf::utils::create_file(base1 + "20140613-194515-000000.db", "");
+    atf::utils::create_file(base1 + "invalid.db", "");
+
+    const std::vector< fs::path > files = layout::list_results("suite1");
+    ATF_REQUIRE_EQ(3, files.size());
+    ATF_REQUIRE_EQ(base1 + "20130614-194515-999999.db", files[0].str());
+    ATF_REQUIRE_EQ(base1 + "20140613-194515-000000.db", files[1].str());
+    ATF_REQUIRE_EQ(base1 + "20140614-194515-123456.db", files[2].str());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(list_results__none);
+ATF_TEST_CASE_BODY(list_results__none)
+{
+    utils::setenv("HOME", (fs::current_path() / "homedir").str());
+    ATF_REQUIRE(layout::list_results("suite1").empty());
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(new_db__new);
 ATF_TEST_CASE_BODY(new_db__new)
 {
@@ -244,6 +351,41 @@ ATF_TEST_CASE_BODY(new_db__new)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(new_db__latest_link);
+ATF_TEST_CASE_BODY(new_db__latest_link)
+{
+    const fs::path link = layout::query_store_dir() /
+        "results.some_path_to_the_suite.latest";
+
+    datetime::set_mock_now(2014, 6, 13, 19, 45, 15, 5000);
+    const layout::results_id_file_pair results1 = layout::new_db(
+        "NEW", fs::path("/some/path/to/the/suite"));
+    atf::utils::create_file(results1.second.str(), "");
+    ATF_REQUIRE_EQ(results1.second, layout::find_results(
+        "some_path_to_the_suite"));
+
+    datetime::set_mock_now(2014, 6, 14, 19, 45, 15, 5000);
+    const layout::results_id_file_pair results2 = layout::new_db(
+        "NEW", fs::path("/some/path/to/the/suite"));
+    atf::utils::create_file(results2.second.str(), "");
+    ATF_REQUIRE_EQ(results2.second, layout::find_results(
+        "some_path_to_the_suite"));
+
+    // Files created with older timestamps must not move the link backwards.
+    datetime::set_mock_now(2014, 6, 12, 19, 45, 15, 5000);
+    const layout::results_id_file_pair results3 = layout::new_db(
+        "NEW", fs::path("/some/path/to/the/suite"));
+    atf::utils::create_file(results3.second.str(), "");
+    ATF_REQUIRE_EQ(results2.second, layout::find_results(
+        "some_path_to_the_suite"));
+
+    char buffer[1024];
+    const ssize_t length = ::readlink(link.c_str(), buffer, sizeof(buffer));
+    ATF_REQUIRE(length != -1);
+    ATF_REQUIRE_EQ(results2.second.leaf_name(), std::string(buffer, length));
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(new_db__explicit);
 ATF_TEST_CASE_BODY(new_db__explicit)
 {
@@ -275,6 +417,92 @@ ATF_TEST_CASE_BODY(new_db_for_migration)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(prune_results__some);
+ATF_TEST_CASE_BODY(prune_results__some)
+{
+    std::vector< fs::path > files;
+    files.push_back(fs::path("first.db"));
+    files.push_back(fs::path("second.db"));
+    files.push_back(fs::path("third.db"));
+    for (std::vector< fs::path >::const_iterator iter = files.begin();
+         iter != files.end(); ++iter)
+        atf::utils::create_file((*iter).str(), "");
+
+    const std::vector< fs::path > removed = layout::prune_results(files, 1);
+    ATF_REQUIRE_EQ(2, removed.size());
+    ATF_REQUIRE_EQ(fs::path("first.db"), removed[0]);
+    ATF_REQUIRE_EQ(fs::path("second.db"), removed[1]);
+    ATF_REQUIRE(!fs::exists(fs::path("first.db")));
+    ATF_REQUIRE(!fs::exists(fs::path("second.db")));
+    ATF_REQUIRE( fs::exists(fs::path("third.db")));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(prune_results__nothing);
+ATF_TEST_CASE_BODY(prune_results__nothing)
+{
+    std::vector< fs::path > files;
+    files.push_back(fs::path("first.db"));
+    atf::utils::create_file("first.db", "");
+
+    ATF_REQUIRE(layout::prune_results(files, 1).empty());
+    ATF_REQUIRE(layout::prune_results(files, 5).empty());
+    ATF_REQUIRE(fs::exists(fs::path("first.db")));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(prune_results__fail);
+ATF_TEST_CASE_BODY(prune_results__fail)
+{
+    std::vector< fs::path > files;
+    files.push_back(fs::path("missing.db"));
+    files.push_back(fs::path("latest.db"));
+
+    ATF_REQUIRE_THROW_RE(store::error, "missing.db",
+                         layout::prune_results(files, 1));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(query_kyuafile_cache_dir);
+ATF_TEST_CASE_BODY(query_kyuafile_cache_dir)
+{
+    const fs::path home = fs::current_path() / "homedir";
+    utils::setenv("HOME", home.str());
+    ATF_REQUIRE_EQ(home / ".kyua/store/kyuafiles",
+                   layout::query_kyuafile_cache_dir());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(query_list_cache_dir);
+ATF_TEST_CASE_BODY(query_list_cache_dir)
+{
+    const fs::path home = fs::current_path() / "homedir";
+    utils::setenv("HOME", home.str());
+    ATF_REQUIRE_EQ(home / ".kyua/store/listings",
+                   layout::query_list_cache_dir());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(query_snapshots_dir);
+ATF_TEST_CASE_BODY(query_snapshots_dir)
+{
+    const fs::path home = fs::current_path() / "homedir";
+    utils::setenv("HOME", home.str());
+    ATF_REQUIRE_EQ(home / ".kyua/store/snapshots",
+                   layout::query_snapshots_dir());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(query_trends_file);
+ATF_TEST_CASE_BODY(query_trends_file)
+{
+    const fs::path home = fs::current_path() / "homedir";
+    utils::setenv("HOME", home.str());
+    ATF_REQUIRE_EQ(home / ".kyua/store/trends.db",
+                   layout::query_trends_file());
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(query_store_dir__home_absolute);
 ATF_TEST_CASE_BODY(query_store_dir__home_absolute)
 {
@@ -330,17 +558,35 @@ ATF_TEST_CASE_BODY(test_suite_for_path__relative)
 ATF_INIT_TEST_CASES(tcs)
 {
     ATF_ADD_TEST_CASE(tcs, find_results__latest);
+    ATF_ADD_TEST_CASE(tcs, find_results__latest_link);
+    ATF_ADD_TEST_CASE(tcs, find_results__latest_link_stale);
     ATF_ADD_TEST_CASE(tcs, find_results__directory);
     ATF_ADD_TEST_CASE(tcs, find_results__file);
     ATF_ADD_TEST_CASE(tcs, find_results__id);
     ATF_ADD_TEST_CASE(tcs, find_results__id_with_timestamp);
     ATF_ADD_TEST_CASE(tcs, find_results__not_found);
 
+    ATF_ADD_TEST_CASE(tcs, list_all_results__some);
+    ATF_ADD_TEST_CASE(tcs, list_all_results__none);
+
+    ATF_ADD_TEST_CASE(tcs, list_results__some);
+    ATF_ADD_TEST_CASE(tcs, list_results__none);
+
     ATF_ADD_TEST_CASE(tcs, new_db__new);
+    ATF_ADD_TEST_CASE(tcs, new_db__latest_link);
     ATF_ADD_TEST_CASE(tcs, new_db__explicit);
 
     ATF_ADD_TEST_CASE(tcs, new_db_for_migration);
 
+    ATF_ADD_TEST_CASE(tcs, prune_results__some);
+    ATF_ADD_TEST_CASE(tcs, prune_results__nothing);
+    ATF_ADD_TEST_CASE(tcs, prune_results__fail);
+
+    ATF_ADD_TEST_CASE(tcs, query_kyuafile_cache_dir);
+    ATF_ADD_TEST_CASE(tcs, query_list_cache_dir);
+    ATF_ADD_TEST_CASE(tcs, query_snapshots_dir);
+    ATF_ADD_TEST_CASE(tcs, query_trends_file);
+
     ATF_ADD_TEST_CASE(tcs, query_store_dir__home_absolute);
     ATF_ADD_TEST_CASE(tcs, query_store_dir__home_relative);
     ATF_ADD_TEST_CASE(tcs, query_store_dir__no_home);
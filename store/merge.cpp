@@ -0,0 +1,362 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "store/merge.hpp"
+
+#include "store/exceptions.hpp"
+#include "store/read_backend.hpp"
+#include "store/segment.hpp"
+#include "store/write_backend.hpp"
+#include "utils/format/macros.hpp"
+#include "utils/fs/exceptions.hpp"
+#include "utils/fs/operations.hpp"
+#include "utils/fs/path.hpp"
+#include "utils/logging/macros.hpp"
+#include "utils/optional.ipp"
+#include "utils/sanity.hpp"
+#include "utils/sqlite/database.hpp"
+#include "utils/sqlite/exceptions.hpp"
+#include "utils/sqlite/statement.ipp"
+#include "utils/sqlite/transaction.hpp"
+
+namespace fs = utils::fs;
+namespace sqlite = utils::sqlite;
+
+
+namespace {
+
+
+/// Computes the offset to apply to the identifiers of a table being merged.
+///
+/// The returned value is larger than any identifier already in the table, so
+/// adding it to the (non-negative) identifiers of a source table yields
+/// identifiers that cannot clash with the existing ones.
+///
+/// \param db The output database.
+/// \param table The table in the main schema of db to query.
+/// \param column The identifier column in the table.
+///
+/// \return The offset to apply to incoming identifiers.
+static int64_t
+id_offset(sqlite::database& db, const char* table, const char* column)
+{
+    sqlite::statement stmt = db.create_statement(
+        F("SELECT COALESCE(MAX(%s), 0) + 1 FROM main.%s") % column % table);
+    const bool has_row = stmt.step();
+    INV(has_row);
+    const int64_t offset = stmt.column_int64(0);
+    stmt.step_without_results();
+    return offset;
+}
+
+
+/// Offsets to apply to the identifiers of an attached source database.
+struct id_offsets {
+    /// Offset for the metadatas.metadata_id column.
+    int64_t metadata;
+
+    /// Offset for the test_programs.test_program_id column.
+    int64_t test_program;
+
+    /// Offset for the test_cases.test_case_id column.
+    int64_t test_case;
+
+    /// Offset for the files.file_id column.
+    int64_t file;
+};
+
+
+/// Runs a single INSERT ... SELECT statement with the identifier offsets.
+///
+/// \param db The output database.
+/// \param sql The statement to run.  It may reference any of the
+///     :metadata_offset, :test_program_offset, :test_case_offset and
+///     :file_offset parameters.
+/// \param offsets The offsets to bind to the statement.
+static void
+copy_rows(sqlite::database& db, const std::string& sql,
+          const id_offsets& offsets)
+{
+    sqlite::statement stmt = db.create_statement(sql);
+    const struct {
+        const char* name;
+        int64_t value;
+    } params[] = {
+        { ":metadata_offset", offsets.metadata },
+        { ":test_program_offset", offsets.test_program },
+        { ":test_case_offset", offsets.test_case },
+        { ":file_offset", offsets.file },
+    };
+    for (std::size_t i = 0; i < sizeof(params) / sizeof(params[0]); ++i) {
+        if (sql.find(params[i].name) != std::string::npos)
+            stmt.bind(params[i].name, params[i].value);
+    }
+    stmt.step_without_results();
+}
+
+
+/// Copies the contents of the attached "source" database into main.
+///
+/// All identifiers are shifted past the ones already present in main so that
+/// the relations within the source are preserved.  Files with the same
+/// contents as a file already in main are not copied again; the references to
+/// them are redirected to the existing row instead.
+///
+/// Files whose contents live in the segment of the source are copied into the
+/// output database itself, so the output never depends on the segments of its
+/// inputs.
+///
+/// \param db The output database, with the input attached as "source".
+/// \param input Path to the input; used to locate its segment.
+/// \param with_context Whether to copy the execution context too.  Only one
+///     context can be stored per results file, so this is only done for the
+///     first input.
+///
+/// \throw store::integrity_error If the segment of the input is invalid.
+static void
+merge_attached(sqlite::database& db, const fs::path& input,
+               const bool with_context)
+{
+    id_offsets offsets;
+    offsets.metadata = id_offset(db, "metadatas", "metadata_id");
+    offsets.test_program = id_offset(db, "test_programs", "test_program_id");
+    offsets.test_case = id_offset(db, "test_cases", "test_case_id");
+    offsets.file = id_offset(db, "files", "file_id");
+
+    sqlite::transaction tx = db.begin_transaction();
+
+    if (with_context) {
+        db.exec("INSERT INTO main.contexts SELECT * FROM source.contexts; "
+                "INSERT INTO main.env_vars SELECT * FROM source.env_vars;");
+    }
+
+    copy_rows(db,
+              "INSERT INTO main.metadatas "
+              "SELECT metadata_id + :metadata_offset, property_name, "
+              "    property_value "
+              "FROM source.metadatas", offsets);
+    copy_rows(db,
+              "INSERT INTO main.test_programs "
+              "SELECT test_program_id + :test_program_offset, absolute_path, "
+              "    root, relative_path, test_suite_name, "
+              "    metadata_id + :metadata_offset, interface, variant "
+              "FROM source.test_programs", offsets);
+    copy_rows(db,
+              "INSERT INTO main.test_cases "
+              "SELECT test_case_id + :test_case_offset, "
+              "    test_program_id + :test_program_offset, name, "
+              "    metadata_id + :metadata_offset "
+              "FROM source.test_cases", offsets);
+    copy_rows(db,
+              "INSERT INTO main.test_results "
+              "SELECT test_case_id + :test_case_offset, result_type, "
+              "    result_reason, start_time, end_time, attempt "
+              "FROM source.test_results", offsets);
+    copy_rows(db,
+              "INSERT INTO main.test_retried_results "
+              "SELECT test_case_id + :test_case_offset, attempt, "
+              "    result_type, result_reason, start_time, end_time "
+              "FROM source.test_retried_results", offsets);
+    copy_rows(db,
+              "INSERT INTO main.test_resource_usage "
+              "SELECT test_case_id + :test_case_offset, user_time, "
+              "    system_time, max_rss, in_blocks, out_blocks, "
+              "    voluntary_switches, involuntary_switches "
+              "FROM source.test_resource_usage", offsets);
+    copy_rows(db,
+              "INSERT INTO main.test_cache_keys "
+              "SELECT test_case_id + :test_case_offset, cache_key "
+              "FROM source.test_cache_keys", offsets);
+    copy_rows(db,
+              "INSERT INTO main.test_cpu_affinities "
+              "SELECT test_case_id + :test_case_offset, slot, numa_node, "
+              "    cpus "
+              "FROM source.test_cpu_affinities", offsets);
+    copy_rows(db,
+              "INSERT INTO main.test_sub_results "
+              "SELECT test_case_id + :test_case_offset, position, "
+              "    result_type, result_reason "
+              "FROM source.test_sub_results", offsets);
+
+    // The latencies, the summaries and the slot usage are not tied to any test
+    // case, so the aggregates of all inputs are folded together by adding up
+    // their counts.
+    db.exec("INSERT OR REPLACE INTO main.phase_latencies "
+            "SELECT incoming.phase, incoming.upper_bound, "
+            "    incoming.count + COALESCE("
+            "        (SELECT existing.count "
+            "         FROM main.phase_latencies AS existing "
+            "         WHERE existing.phase = incoming.phase "
+            "             AND existing.upper_bound = incoming.upper_bound), 0) "
+            "FROM source.phase_latencies AS incoming");
+    db.exec("INSERT OR REPLACE INTO main.result_summaries "
+            "SELECT incoming.result_type, "
+            "    incoming.results_count + COALESCE(existing.results_count, 0), "
+            "    incoming.total_duration + "
+            "        COALESCE(existing.total_duration, 0), "
+            "    MIN(incoming.min_start_time, "
+            "        COALESCE(existing.min_start_time, "
+            "                 incoming.min_start_time)), "
+            "    MAX(incoming.max_end_time, "
+            "        COALESCE(existing.max_end_time, incoming.max_end_time)) "
+            "FROM source.result_summaries AS incoming "
+            "    LEFT JOIN main.result_summaries AS existing "
+            "    ON existing.result_type = incoming.result_type");
+    db.exec("INSERT OR REPLACE INTO main.slot_usage "
+            "SELECT incoming.activity, "
+            "    incoming.slot_time + COALESCE(existing.slot_time, 0) "
+            "FROM source.slot_usage AS incoming "
+            "    LEFT JOIN main.slot_usage AS existing "
+            "    ON existing.activity = incoming.activity");
+    db.exec("INSERT INTO main.run_events "
+            "    (kind, name, pid, start_time, end_time) "
+            "SELECT kind, name, pid, start_time, end_time "
+            "FROM source.run_events ORDER BY event_id");
+
+    // Map every incoming file to an identical file already in main, if any,
+    // or to a fresh identifier otherwise.  The hash narrows down the
+    // candidates through its index but the contents are always compared.
+    // Files in a segment never match, as main holds none of those.
+    db.exec("CREATE TEMPORARY TABLE merge_file_ids ("
+            "    old_id INTEGER PRIMARY KEY, "
+            "    new_id INTEGER NOT NULL)");
+    copy_rows(db,
+              "INSERT INTO temp.merge_file_ids "
+              "SELECT file_id, COALESCE("
+              "    (SELECT existing.file_id FROM main.files AS existing "
+              "     WHERE existing.contents_hash = incoming.contents_hash "
+              "         AND existing.codec = incoming.codec "
+              "         AND existing.contents = incoming.contents "
+              "     LIMIT 1), "
+              "    file_id + :file_offset) "
+              "FROM source.files AS incoming", offsets);
+    copy_rows(db,
+              "INSERT INTO main.files "
+              "SELECT new_id, contents, contents_hash, codec, size "
+              "FROM source.files JOIN temp.merge_file_ids "
+              "    ON file_id = old_id "
+              "WHERE new_id >= :file_offset", offsets);
+    copy_rows(db,
+              "INSERT INTO main.test_case_files "
+              "SELECT test_case_id + :test_case_offset, file_name, new_id "
+              "FROM source.test_case_files JOIN temp.merge_file_ids "
+              "    ON file_id = old_id", offsets);
+    db.exec("DROP TABLE temp.merge_file_ids");
+
+    (void)store::detail::fold_segment(db, "main",
+                                      store::detail::segment_path(input),
+                                      offsets.file);
+
+    tx.commit();
+}
+
+
+/// Merges a single input results file into the output database.
+///
+/// \param db The output database.
+/// \param input Path to the results file to merge.
+/// \param with_context Whether to copy the execution context of the input.
+///
+/// \throw store::error If the input is not a valid results file or if the
+///     merge fails.
+static void
+merge_one(sqlite::database& db, const fs::path& input, const bool with_context)
+{
+    LI(F("Merging results file %s") % input);
+
+    // Opening the input through the read backend validates its schema
+    // version; the merge itself runs entirely within SQLite.
+    store::read_backend::open_ro(input).close();
+
+    try {
+        // ATTACH cannot run within a transaction, so this happens outside of
+        // the one that merge_attached() uses to copy the data.
+        sqlite::statement attach = db.create_statement(
+            "ATTACH DATABASE :path AS source");
+        attach.bind(":path", input.str());
+        attach.step_without_results();
+    } catch (const sqlite::error& e) {
+        throw store::error(F("Cannot attach '%s': %s") % input % e.what());
+    }
+
+    try {
+        merge_attached(db, input, with_context);
+    } catch (const sqlite::error& e) {
+        db.exec("DETACH DATABASE source");
+        throw store::error(F("Failed to merge '%s': %s") % input % e.what());
+    } catch (const store::error& e) {
+        db.exec("DETACH DATABASE source");
+        throw store::error(F("Failed to merge '%s': %s") % input % e.what());
+    }
+    db.exec("DETACH DATABASE source");
+}
+
+
+}  // anonymous namespace
+
+
+/// Combines various results files into a new one.
+///
+/// The data is copied in bulk with INSERT ... SELECT statements on the
+/// attached inputs instead of being decoded and re-encoded through the
+/// transaction interfaces.  The output is fully rewritten in any case, so its
+/// writes are not synced to disk until the end; if anything fails, the
+/// partial output is deleted.
+///
+/// The execution context of the merged file is taken from the first input.
+///
+/// \param inputs The results files to merge.  Must not be empty.
+/// \param output The results file to create.  Must not exist or be empty.
+///
+/// \throw error If any of the inputs is invalid or if the merge fails.
+void
+store::merge_results(const std::vector< fs::path >& inputs,
+                     const fs::path& output)
+{
+    PRE(!inputs.empty());
+
+    write_profile profile;
+    profile.synchronous = "off";
+    write_backend backend = write_backend::open_rw(output, profile);
+    try {
+        for (std::vector< fs::path >::const_iterator iter = inputs.begin();
+             iter != inputs.end(); ++iter) {
+            merge_one(backend.database(), *iter, iter == inputs.begin());
+        }
+        backend.close();
+    } catch (const store::error& unused_error) {
+        backend.close();
+        try {
+            fs::unlink(output);
+        } catch (const fs::error& e) {
+            LW(F("Failed to delete partial results file %s: %s") % output %
+               e.what());
+        }
+        throw;
+    }
+}
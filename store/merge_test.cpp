@@ -0,0 +1,305 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "store/merge.hpp"
+
+#include <cstddef>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <atf-c++.hpp>
+
+#include "model/context.hpp"
+#include "model/metadata.hpp"
+#include "model/test_program.hpp"
+#include "model/test_result.hpp"
+#include "store/exceptions.hpp"
+#include "store/read_backend.hpp"
+#include "store/read_transaction.hpp"
+#include "store/write_backend.hpp"
+#include "store/write_transaction.hpp"
+#include "utils/datetime.hpp"
+#include "utils/fs/operations.hpp"
+#include "utils/fs/path.hpp"
+#include "utils/logging/operations.hpp"
+#include "utils/optional.ipp"
+#include "utils/sqlite/database.hpp"
+#include "utils/sqlite/statement.ipp"
+
+namespace datetime = utils::datetime;
+namespace fs = utils::fs;
+namespace logging = utils::logging;
+namespace sqlite = utils::sqlite;
+
+
+namespace {
+
+
+/// Creates a results file with a single test case.
+///
+/// \param file The results file to create.
+/// \param cwd The working directory to record in the context.
+/// \param program The relative path to the only test program.
+/// \param stdout_contents The stdout of the only test case.
+/// \param result The result of the only test case.
+static void
+create_results(const char* file, const char* cwd, const char* program,
+               const char* stdout_contents, const model::test_result& result)
+{
+    store::write_backend backend = store::write_backend::open_rw(
+        fs::path(file));
+    store::write_transaction tx = backend.start_write();
+
+    tx.put_context(model::context(fs::path(cwd),
+                                  std::map< std::string, std::string >()));
+
+    const model::test_program test_program = model::test_program_builder(
+        "plain", fs::path(program), fs::path("/the/root"), "suite")
+        .add_test_case("main")
+        .build();
+    const int64_t tp_id = tx.put_test_program(test_program);
+    const int64_t tc_id = tx.put_test_case(test_program, "main", tp_id);
+    atf::utils::create_file("stdout.txt", stdout_contents);
+    tx.put_test_case_file("__STDOUT__", fs::path("stdout.txt"), tc_id);
+    tx.put_result(result, tc_id,
+                  datetime::timestamp::from_values(2015, 1, 2, 3, 4, 5, 0),
+                  datetime::timestamp::from_values(2015, 1, 2, 3, 4, 6, 0));
+
+    tx.commit();
+    backend.close();
+}
+
+
+/// Counts the rows in a table of a results file.
+///
+/// \param file The results file to query.
+/// \param table The name of the table.
+///
+/// \return The number of rows.
+static int64_t
+count_rows(const char* file, const char* table)
+{
+    sqlite::database db = sqlite::database::open(fs::path(file),
+                                                 sqlite::open_readonly);
+    sqlite::statement stmt = db.create_statement(
+        std::string("SELECT COUNT(*) FROM ") + table);
+    ATF_REQUIRE(stmt.step());
+    return stmt.column_int64(0);
+}
+
+
+}  // anonymous namespace
+
+
+ATF_TEST_CASE(merge_results__many);
+ATF_TEST_CASE_HEAD(merge_results__many)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(merge_results__many)
+{
+    const model::test_result result_1(model::test_result_passed);
+    const model::test_result result_2(model::test_result_failed, "Oops");
+    const model::test_result result_3(model::test_result_skipped, "Meh");
+    create_results("a.db", "/first", "prog1", "shared stdout\n", result_1);
+    create_results("b.db", "/second", "prog2", "shared stdout\n", result_2);
+    create_results("c.db", "/third", "prog3", "unique stdout\n", result_3);
+
+    std::vector< fs::path > inputs;
+    inputs.push_back(fs::path("a.db"));
+    inputs.push_back(fs::path("b.db"));
+    inputs.push_back(fs::path("c.db"));
+    store::merge_results(inputs, fs::path("merged.db"));
+
+    {
+        store::read_backend backend = store::read_backend::open_ro(
+            fs::path("merged.db"));
+        store::read_transaction tx = backend.start_read();
+        ATF_REQUIRE_EQ(fs::path("/first"), tx.get_context().cwd());
+
+        store::results_iterator iter = tx.get_results();
+        ATF_REQUIRE(iter);
+        ATF_REQUIRE_EQ(fs::path("prog1"), iter.test_program()->relative_path());
+        ATF_REQUIRE_EQ("shared stdout\n", iter.stdout_contents());
+        ATF_REQUIRE_EQ(result_1, iter.result());
+        ATF_REQUIRE(++iter);
+        ATF_REQUIRE_EQ(fs::path("prog2"), iter.test_program()->relative_path());
+        ATF_REQUIRE_EQ("shared stdout\n", iter.stdout_contents());
+        ATF_REQUIRE_EQ(result_2, iter.result());
+        ATF_REQUIRE(++iter);
+        ATF_REQUIRE_EQ(fs::path("prog3"), iter.test_program()->relative_path());
+        ATF_REQUIRE_EQ("unique stdout\n", iter.stdout_contents());
+        ATF_REQUIRE_EQ(result_3, iter.result());
+        ATF_REQUIRE(!++iter);
+    }
+
+    ATF_REQUIRE_EQ(3, count_rows("merged.db", "test_case_files"));
+    ATF_REQUIRE_EQ(2, count_rows("merged.db", "files"));
+}
+
+
+ATF_TEST_CASE(merge_results__summaries);
+ATF_TEST_CASE_HEAD(merge_results__summaries)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(merge_results__summaries)
+{
+    const model::test_result passed(model::test_result_passed);
+    const model::test_result failed(model::test_result_failed, "Oops");
+    create_results("a.db", "/first", "prog1", "", passed);
+    create_results("b.db", "/second", "prog2", "", failed);
+    create_results("c.db", "/third", "prog3", "", passed);
+
+    std::vector< fs::path > inputs;
+    inputs.push_back(fs::path("a.db"));
+    inputs.push_back(fs::path("b.db"));
+    inputs.push_back(fs::path("c.db"));
+    store::merge_results(inputs, fs::path("merged.db"));
+
+    store::read_backend backend = store::read_backend::open_ro(
+        fs::path("merged.db"));
+    store::read_transaction tx = backend.start_read();
+    const store::results_summary summary = tx.get_summary();
+    tx.finish();
+
+    std::map< model::test_result_type, std::size_t > exp_counts;
+    exp_counts[model::test_result_failed] = 1;
+    exp_counts[model::test_result_passed] = 2;
+    ATF_REQUIRE(exp_counts == summary.counts);
+    ATF_REQUIRE_EQ(datetime::delta(3, 0), summary.total_duration);
+    ATF_REQUIRE_EQ(datetime::timestamp::from_values(2015, 1, 2, 3, 4, 5, 0),
+                   summary.start_time.get());
+    ATF_REQUIRE_EQ(datetime::timestamp::from_values(2015, 1, 2, 3, 4, 6, 0),
+                   summary.end_time.get());
+}
+
+
+ATF_TEST_CASE(merge_results__segment);
+ATF_TEST_CASE_HEAD(merge_results__segment)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(merge_results__segment)
+{
+    const model::test_result result(model::test_result_passed);
+    create_results("a.db", "/first", "prog1", "inline stdout\n", result);
+    {
+        store::write_backend backend = store::write_backend::open_rw(
+            fs::path("b.db"));
+        store::write_transaction tx = backend.start_write();
+        tx.set_segment_threshold(0);
+        tx.put_context(model::context(fs::path("/second"),
+                                      std::map< std::string, std::string >()));
+        const model::test_program test_program = model::test_program_builder(
+            "plain", fs::path("prog2"), fs::path("/the/root"), "suite")
+            .add_test_case("main")
+            .build();
+        const int64_t tp_id = tx.put_test_program(test_program);
+        const int64_t tc_id = tx.put_test_case(test_program, "main", tp_id);
+        atf::utils::create_file("stdout.txt", "segment stdout\n");
+        tx.put_test_case_file("__STDOUT__", fs::path("stdout.txt"), tc_id);
+        tx.put_result(result, tc_id,
+                      datetime::timestamp::from_values(2015, 1, 2, 3, 4, 5, 0),
+                      datetime::timestamp::from_values(2015, 1, 2, 3, 4, 6, 0));
+        tx.commit();
+        backend.close();
+    }
+    ATF_REQUIRE(fs::exists(fs::path("b.db-files")));
+
+    std::vector< fs::path > inputs;
+    inputs.push_back(fs::path("a.db"));
+    inputs.push_back(fs::path("b.db"));
+    store::merge_results(inputs, fs::path("merged.db"));
+    ATF_REQUIRE(!fs::exists(fs::path("merged.db-files")));
+
+    store::read_backend backend = store::read_backend::open_ro(
+        fs::path("merged.db"));
+    store::read_transaction tx = backend.start_read();
+    store::results_iterator iter = tx.get_results();
+    ATF_REQUIRE(iter);
+    ATF_REQUIRE_EQ("inline stdout\n", iter.stdout_contents());
+    ATF_REQUIRE(++iter);
+    ATF_REQUIRE_EQ("segment stdout\n", iter.stdout_contents());
+    ATF_REQUIRE(!++iter);
+}
+
+
+ATF_TEST_CASE(merge_results__invalid_input);
+ATF_TEST_CASE_HEAD(merge_results__invalid_input)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(merge_results__invalid_input)
+{
+    create_results("a.db", "/first", "prog1", "some stdout\n",
+                   model::test_result(model::test_result_passed));
+
+    std::vector< fs::path > inputs;
+    inputs.push_back(fs::path("a.db"));
+    inputs.push_back(fs::path("missing.db"));
+    ATF_REQUIRE_THROW(store::error,
+                      store::merge_results(inputs, fs::path("merged.db")));
+    ATF_REQUIRE(!fs::exists(fs::path("merged.db")));
+}
+
+
+ATF_TEST_CASE(merge_results__output_not_empty);
+ATF_TEST_CASE_HEAD(merge_results__output_not_empty)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(merge_results__output_not_empty)
+{
+    create_results("a.db", "/first", "prog1", "some stdout\n",
+                   model::test_result(model::test_result_passed));
+    create_results("b.db", "/second", "prog2", "some stdout\n",
+                   model::test_result(model::test_result_passed));
+
+    std::vector< fs::path > inputs;
+    inputs.push_back(fs::path("a.db"));
+    ATF_REQUIRE_THROW_RE(store::error, "not empty",
+                         store::merge_results(inputs, fs::path("b.db")));
+    ATF_REQUIRE_EQ(1, count_rows("b.db", "test_cases"));
+}
+
+
+ATF_INIT_TEST_CASES(tcs)
+{
+    ATF_ADD_TEST_CASE(tcs, merge_results__many);
+    ATF_ADD_TEST_CASE(tcs, merge_results__summaries);
+    ATF_ADD_TEST_CASE(tcs, merge_results__segment);
+    ATF_ADD_TEST_CASE(tcs, merge_results__invalid_input);
+    ATF_ADD_TEST_CASE(tcs, merge_results__output_not_empty);
+}
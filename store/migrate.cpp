@@ -28,7 +28,16 @@
 
 #include "store/migrate.hpp"
 
+extern "C" {
+#include <unistd.h>
+}
+
+#include <cstdlib>
+#include <deque>
+#include <set>
 #include <stdexcept>
+#include <utility>
+#include <vector>
 
 #include "store/dbtypes.hpp"
 #include "store/exceptions.hpp"
@@ -37,6 +46,7 @@
 #include "store/read_backend.hpp"
 #include "store/write_backend.hpp"
 #include "utils/datetime.hpp"
+#include "utils/defs.hpp"
 #include "utils/env.hpp"
 #include "utils/format/macros.hpp"
 #include "utils/fs/exceptions.hpp"
@@ -44,7 +54,10 @@
 #include "utils/fs/path.hpp"
 #include "utils/logging/macros.hpp"
 #include "utils/optional.ipp"
+#include "utils/process/child.ipp"
+#include "utils/process/status.hpp"
 #include "utils/sanity.hpp"
+#include "utils/shared_ptr.hpp"
 #include "utils/stream.hpp"
 #include "utils/sqlite/database.hpp"
 #include "utils/sqlite/exceptions.hpp"
@@ -53,6 +66,7 @@
 
 namespace datetime = utils::datetime;
 namespace fs = utils::fs;
+namespace process = utils::process;
 namespace sqlite = utils::sqlite;
 namespace text = utils::text;
 
@@ -136,76 +150,224 @@ migrate_schema_step(const fs::path& file,
 }
 
 
+/// Creates the results file of an action of a historical database.
+///
+/// \param old_file Path to the historical database.
+/// \param action_id Identifier of the action to extract.
+/// \param new_file Path to the results file to create.
+///
+/// \throw error If there is a problem creating the results file.
+static void
+extract_action(const fs::path& old_file, const int64_t action_id,
+               const fs::path& new_file)
+{
+    LI(F("Creating %s for previous action %s") % new_file % action_id);
+
+    fs::mkdir_p(new_file.branch_path(), 0755);
+    sqlite::database db = store::detail::open_and_setup(
+        new_file, sqlite::open_readwrite | sqlite::open_create);
+    store::detail::initialize(db);
+    db.close();
+    migrate_schema_step(new_file,
+                        first_chunked_schema_version - 1,
+                        first_chunked_schema_version,
+                        utils::make_optional(action_id),
+                        utils::make_optional(old_file));
+}
+
+
+/// Functor to extract an action of a historical database in a subprocess.
+class extract_action_child {
+    /// Path to the historical database.
+    const fs::path& _old_file;
+
+    /// Identifier of the action to extract.
+    const int64_t _action_id;
+
+    /// Path to the results file to create.
+    const fs::path& _new_file;
+
+public:
+    /// Constructor.
+    ///
+    /// \param old_file Path to the historical database.
+    /// \param action_id Identifier of the action to extract.
+    /// \param new_file Path to the results file to create.
+    extract_action_child(const fs::path& old_file, const int64_t action_id,
+                         const fs::path& new_file) :
+        _old_file(old_file), _action_id(action_id), _new_file(new_file)
+    {
+    }
+
+    /// Body of the subprocess.
+    void
+    operator()(void)
+    {
+        extract_action(_old_file, _action_id, _new_file);
+        ::_exit(EXIT_SUCCESS);
+    }
+};
+
+
+/// Action of a historical database to be extracted into a results file.
+struct pending_action {
+    /// Identifier of the action.
+    int64_t action_id;
+
+    /// Path to the results file to create.
+    fs::path new_file;
+
+    /// Constructor.
+    ///
+    /// \param action_id_ Identifier of the action.
+    /// \param new_file_ Path to the results file to create.
+    pending_action(const int64_t action_id_, const fs::path& new_file_) :
+        action_id(action_id_), new_file(new_file_)
+    {
+    }
+};
+
+
+/// Computes the results files to create out of a historical database.
+///
+/// The start times of all actions are fetched in a single query.  Actions
+/// without results and actions whose results file already exists are
+/// skipped.
+///
+/// \param old_file Path to the historical database.
+///
+/// \return The actions to extract, in the order of their identifiers.
+static std::vector< pending_action >
+plan_chunks(const fs::path& old_file)
+{
+    sqlite::database old_db = store::detail::open_and_setup(
+        old_file, sqlite::open_readonly);
+
+    std::vector< pending_action > actions;
+    std::set< fs::path > new_files;
+    {
+        sqlite::statement stmt = old_db.create_statement(
+            "SELECT actions.action_id AS action_id, contexts.cwd AS cwd, "
+            "    MIN(test_results.start_time) AS start_time "
+            "FROM actions "
+            "    JOIN contexts "
+            "        ON actions.context_id == contexts.context_id "
+            "    JOIN test_programs "
+            "        ON actions.action_id == test_programs.action_id "
+            "    JOIN test_cases "
+            "        ON test_programs.test_program_id == "
+            "            test_cases.test_program_id "
+            "    JOIN test_results "
+            "        ON test_cases.test_case_id == test_results.test_case_id "
+            "GROUP BY actions.action_id ORDER BY actions.action_id");
+
+        while (stmt.step()) {
+            const int64_t action_id = stmt.safe_column_int64("action_id");
+            const fs::path cwd(stmt.safe_column_text("cwd"));
+            const datetime::timestamp start_time = store::column_timestamp(
+                stmt, "start_time");
+
+            const fs::path new_file = store::layout::new_db_for_migration(
+                cwd, start_time);
+            if (fs::exists(new_file) ||
+                new_files.find(new_file) != new_files.end()) {
+                LI(F("Skipping action %s because %s already exists") %
+                   action_id % new_file);
+                continue;
+            }
+            new_files.insert(new_file);
+            actions.push_back(pending_action(action_id, new_file));
+        }
+    }
+    old_db.close();
+    return actions;
+}
+
+
+/// Waits for the oldest subprocess extracting an action.
+///
+/// A results file left behind by a failed subprocess is deleted.
+///
+/// \param [in,out] children The running subprocesses along with the actions
+///     they are extracting.  The oldest one is removed.
+static void
+wait_oldest_extractor(
+    std::deque< std::pair< std::shared_ptr< process::child >,
+                           pending_action > >& children)
+{
+    PRE(!children.empty());
+    const std::shared_ptr< process::child > child = children.front().first;
+    const pending_action action = children.front().second;
+    children.pop_front();
+
+    std::string output = utils::read_stream(child->output());
+    const process::status status = child->wait();
+    if (!status.exited() || status.exitstatus() != EXIT_SUCCESS) {
+        output.erase(output.find_last_not_of('\n') + 1);
+        LW(F("Failed to extract action %s: %s") % action.action_id % output);
+        if (fs::exists(action.new_file))
+            fs::unlink(action.new_file);
+    }
+}
+
+
 /// Given a historical database, chunks it up into results files.
 ///
 /// The given database is DELETED on success given that it will have been
 /// split up into various different files.
 ///
+/// Every action is extracted into its own file, so the extraction is split
+/// across subprocesses unless no parallelism was requested.  The historical
+/// database is only ever read, so this is safe.
+///
 /// \param old_file Path to the old database.
+/// \param parallelism Maximum number of actions to extract simultaneously.
+/// \param hooks Hooks to report the progress of the extraction to.
 static void
-chunk_database(const fs::path& old_file)
+chunk_database(const fs::path& old_file, const std::size_t parallelism,
+               store::migrate_hooks& hooks)
 {
     PRE(get_schema_version(old_file) == first_chunked_schema_version - 1);
+    PRE(parallelism >= 1);
 
     LI(F("Need to split %s into per-action files") % old_file);
 
-    sqlite::database old_db = store::detail::open_and_setup(
-        old_file, sqlite::open_readonly);
-
-    sqlite::statement actions_stmt = old_db.create_statement(
-        "SELECT action_id, cwd FROM actions NATURAL JOIN contexts");
-
-    sqlite::statement start_time_stmt = old_db.create_statement(
-        "SELECT test_results.start_time AS start_time "
-        "FROM test_programs "
-        "    JOIN test_cases "
-        "        ON test_programs.test_program_id == test_cases.test_program_id"
-        "    JOIN test_results "
-        "        ON test_cases.test_case_id == test_results.test_case_id "
-        "WHERE test_programs.action_id == :action_id "
-        "ORDER BY start_time LIMIT 1");
-
-    while (actions_stmt.step()) {
-        const int64_t action_id = actions_stmt.safe_column_int64("action_id");
-        const fs::path cwd(actions_stmt.safe_column_text("cwd"));
-
-        LI(F("Extracting action %s") % action_id);
-
-        start_time_stmt.reset();
-        start_time_stmt.bind(":action_id", action_id);
-        if (!start_time_stmt.step()) {
-            LI(F("Skipping empty action %s") % action_id);
-            continue;
-        }
-        const datetime::timestamp start_time = store::column_timestamp(
-            start_time_stmt, "start_time");
-        start_time_stmt.step_without_results();
-
-        const fs::path new_file = store::layout::new_db_for_migration(
-            cwd, start_time);
-        if (fs::exists(new_file)) {
-            LI(F("Skipping action because %s already exists") % new_file);
-            continue;
-        }
-
-        LI(F("Creating %s for previous action %s") % new_file % action_id);
-
-        try {
-            fs::mkdir_p(new_file.branch_path(), 0755);
-            sqlite::database db = store::detail::open_and_setup(
-                new_file, sqlite::open_readwrite | sqlite::open_create);
-            store::detail::initialize(db);
-            db.close();
-            migrate_schema_step(new_file,
-                                first_chunked_schema_version - 1,
-                                first_chunked_schema_version,
-                                utils::make_optional(action_id),
-                                utils::make_optional(old_file));
-        } catch (...) {
-            // TODO(jmmv): Handle this better.
-            fs::unlink(new_file);
+    const std::vector< pending_action > actions = plan_chunks(old_file);
+
+    std::deque< std::pair< std::shared_ptr< process::child >,
+                           pending_action > > children;
+    std::size_t done = 0;
+    for (std::vector< pending_action >::const_iterator iter = actions.begin();
+         iter != actions.end(); ++iter) {
+        LI(F("Extracting action %s") % (*iter).action_id);
+
+        if (parallelism == 1) {
+            try {
+                extract_action(old_file, (*iter).action_id, (*iter).new_file);
+            } catch (const std::exception& e) {
+                LW(F("Failed to extract action %s: %s") % (*iter).action_id %
+                   e.what());
+                if (fs::exists((*iter).new_file))
+                    fs::unlink((*iter).new_file);
+            }
+            hooks.extracted_action(++done, actions.size());
+        } else {
+            while (children.size() >= parallelism) {
+                wait_oldest_extractor(children);
+                hooks.extracted_action(++done, actions.size());
+            }
+            children.push_back(std::make_pair(
+                std::shared_ptr< process::child >(
+                    process::child::fork_capture(extract_action_child(
+                        old_file, (*iter).action_id, (*iter).new_file))
+                    .release()),
+                *iter));
         }
     }
+    while (!children.empty()) {
+        wait_oldest_extractor(children);
+        hooks.extracted_action(++done, actions.size());
+    }
 
     fs::unlink(old_file);
 }
@@ -214,6 +376,24 @@ chunk_database(const fs::path& old_file)
 }  // anonymous namespace
 
 
+/// Destructor.
+store::migrate_hooks::~migrate_hooks(void)
+{
+}
+
+
+/// Callback executed when an action of a historical database is processed.
+///
+/// \param unused_done Number of actions processed so far, including this one.
+/// \param unused_total Number of actions to process.
+void
+store::migrate_hooks::extracted_action(
+    const std::size_t UTILS_UNUSED_PARAM(done),
+    const std::size_t UTILS_UNUSED_PARAM(total))
+{
+}
+
+
 /// Calculates the path to a schema migration file.
 ///
 /// \param version_from The version from which the database is being upgraded.
@@ -261,11 +441,17 @@ store::detail::backup_database(const fs::path& source, const int old_version)
 /// arbitrary old databases.
 ///
 /// \param file The database whose schema to upgrade.
+/// \param parallelism Maximum number of subprocesses to split a historical
+///     database into results files with.
+/// \param hooks Hooks to report the progress of the migration to.
 ///
 /// \throw error If there is a problem with the migration.
 void
-store::migrate_schema(const utils::fs::path& file)
+store::migrate_schema(const utils::fs::path& file,
+                      const std::size_t parallelism, migrate_hooks& hooks)
 {
+    PRE(parallelism >= 1);
+
     const int version_from = get_schema_version(file);
     const int version_to = detail::current_schema_version;
     if (version_from == version_to) {
@@ -278,10 +464,18 @@ store::migrate_schema(const utils::fs::path& file)
 
     detail::backup_database(file, version_from);
 
-    int i;
-    for (i = version_from; i < first_chunked_schema_version - 1; ++i) {
-        migrate_schema_step(file, i, i + 1);
+    if (version_from < first_chunked_schema_version) {
+        int i;
+        for (i = version_from; i < first_chunked_schema_version - 1; ++i) {
+            migrate_schema_step(file, i, i + 1);
+        }
+        // The per-action files created by chunk_database() are initialized
+        // with the current schema, so there is nothing else to do.
+        chunk_database(file, parallelism, hooks);
+    } else {
+        int i;
+        for (i = version_from; i < version_to; ++i) {
+            migrate_schema_step(file, i, i + 1);
+        }
     }
-    chunk_database(file);
-    INV(version_to == first_chunked_schema_version);
 }
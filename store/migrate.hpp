@@ -32,6 +32,8 @@
 #if !defined(STORE_MIGRATE_HPP)
 #define STORE_MIGRATE_HPP
 
+#include <cstddef>
+
 #include "utils/fs/path_fwd.hpp"
 
 namespace store {
@@ -47,7 +49,17 @@ void backup_database(const utils::fs::path&, const int);
 }  // anonymous namespace
 
 
-void migrate_schema(const utils::fs::path&);
+/// Hooks to report the progress of a schema migration.
+class migrate_hooks {
+public:
+    virtual ~migrate_hooks(void);
+
+    virtual void extracted_action(const std::size_t, const std::size_t);
+};
+
+
+void migrate_schema(const utils::fs::path&, const std::size_t,
+                    migrate_hooks&);
 
 
 }  // namespace store
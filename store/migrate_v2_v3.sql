@@ -42,7 +42,8 @@
 ATTACH DATABASE "@OLD_DATABASE@" AS old_store;
 
 
--- New database already contains a record for v3.  Just import older entries.
+-- New database already contains a record for the current version.  Just import
+-- older entries.
 INSERT INTO metadata SELECT * FROM old_store.metadata;
 
 INSERT INTO contexts
@@ -72,7 +73,9 @@ INSERT INTO metadatas
             WHERE action_id == @ACTION_ID@
     );
 
-INSERT INTO test_programs
+INSERT INTO test_programs (test_program_id, absolute_path, root,
+                           relative_path, test_suite_name, metadata_id,
+                           interface)
     SELECT test_program_id, absolute_path, root, relative_path,
         test_suite_name, metadata_id, interface
     FROM old_store.test_programs
@@ -85,7 +88,8 @@ INSERT INTO test_cases
         ON test_cases.test_program_id == test_programs.test_program_id
     WHERE action_id == @ACTION_ID@;
 
-INSERT INTO test_results
+INSERT INTO test_results (test_case_id, result_type, result_reason,
+                          start_time, end_time)
     SELECT test_results.test_case_id, test_results.result_type,
     test_results.result_reason, test_results.start_time, test_results.end_time
     FROM old_store.test_results
@@ -95,7 +99,7 @@ INSERT INTO test_results
             ON test_cases.test_program_id == test_programs.test_program_id
     WHERE action_id == @ACTION_ID@;
 
-INSERT INTO files
+INSERT INTO files (file_id, contents)
     SELECT files.file_id, files.contents
     FROM old_store.files
         JOIN old_store.test_case_files
@@ -117,4 +121,12 @@ INSERT INTO test_case_files
     WHERE action_id == @ACTION_ID@;
 
 
+-- The new database has the current schema, whose result summaries are
+-- maintained as results are stored, so compute them for the imported ones.
+INSERT INTO result_summaries
+    SELECT result_type, COUNT(*), SUM(end_time - start_time),
+        MIN(start_time), MAX(end_time)
+    FROM test_results GROUP BY result_type;
+
+
 DETACH DATABASE old_store;
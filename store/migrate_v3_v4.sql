@@ -0,0 +1,207 @@
+-- Copyright 2026 The Kyua Authors.
+-- All rights reserved.
+--
+-- Redistribution and use in source and binary forms, with or without
+-- modification, are permitted provided that the following conditions are
+-- met:
+--
+-- * Redistributions of source code must retain the above copyright
+--   notice, this list of conditions and the following disclaimer.
+-- * Redistributions in binary form must reproduce the above copyright
+--   notice, this list of conditions and the following disclaimer in the
+--   documentation and/or other materials provided with the distribution.
+-- * Neither the name of Google Inc. nor the names of its contributors
+--   may be used to endorse or promote products derived from this software
+--   without specific prior written permission.
+--
+-- THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+-- "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+-- LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+-- A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+-- OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+-- SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+-- LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+-- DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+-- THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+-- (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+-- OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+-- \file store/v3-to-v4.sql
+-- Migration of a database with version 3 of the schema to version 4.
+--
+-- Version 4 introduced the following changes:
+--
+-- * Added the contents_hash column to the files table so that identical
+--   files (typically the stdout and stderr of test cases) can be stored
+--   only once.  Existing rows get a NULL hash and are therefore never
+--   considered for deduplication.
+--
+-- * Added an index on the new contents_hash column.
+--
+-- * Added the codec column to the files table so that the contents of
+--   files can optionally be stored compressed.  Existing rows are
+--   verbatim copies.
+--
+-- * Added the size column to the files table to record the length of the
+--   decoded contents.  Existing rows are verbatim copies, so their size is
+--   the length of their contents.
+--
+-- * Added indexes on test_programs, test_results and test_case_files to
+--   speed up the queries issued by the reporting commands.
+--
+-- * Added the test_resource_usage table to record the resources consumed
+--   by test cases.  Existing results have no such records.
+--
+-- * Added the test_cache_keys table to record the inputs of test cases so
+--   that unchanged test cases can be skipped.  Existing results have no
+--   such records.
+--
+-- * Added the attempt column to the test_results table to record which
+--   attempt of a retried test case yielded its result.  Existing results
+--   come from the first attempt.
+--
+-- * Added the test_retried_results table to record the results of the
+--   earlier attempts of test cases that were retried.  Existing results
+--   have no such records.
+--
+-- * Added the variant column to the test_programs table to record the
+--   Kyuafile-defined variant a test program ran as.  Existing test programs
+--   had no variants, so their variant is NULL.
+--
+-- * Added the test_cpu_affinities table to record the CPUs to which test
+--   cases were pinned.  Existing results have no such records.
+--
+-- * Added the test_sub_results table to record the results of the
+--   individual checks of test cases.  Existing results have no such
+--   records.
+--
+-- * Added the phase_latencies table to record the latencies of the phases
+--   of the execution.  Existing results have no such records.
+--
+-- * Added the run_events table to record the timeline of the execution.
+--   Existing results have no such records.
+--
+-- * Added the result_summaries table to record the aggregates of the
+--   results by type.  The table is populated from the existing results.
+--
+-- * Added the slot_usage table to record how the execution slots were used.
+--   Existing results have no such records.
+
+
+ALTER TABLE files ADD COLUMN contents_hash TEXT;
+
+ALTER TABLE files ADD COLUMN codec TEXT NOT NULL DEFAULT 'none';
+
+ALTER TABLE files ADD COLUMN size INTEGER
+    CHECK (size IS NULL OR size >= 0);
+
+UPDATE files SET size = length(contents);
+
+CREATE INDEX index_files_by_contents_hash
+    ON files (contents_hash);
+
+CREATE INDEX index_test_programs_by_relative_path
+    ON test_programs (relative_path);
+
+CREATE INDEX index_test_programs_by_absolute_path
+    ON test_programs (absolute_path);
+
+CREATE INDEX index_test_results_by_result_type
+    ON test_results (result_type);
+
+CREATE INDEX index_test_case_files_by_test_case_id
+    ON test_case_files (test_case_id, file_name, file_id);
+
+CREATE TABLE test_resource_usage (
+    test_case_id INTEGER PRIMARY KEY REFERENCES test_cases,
+
+    user_time INTEGER NOT NULL,
+    system_time INTEGER NOT NULL,
+    max_rss INTEGER NOT NULL,
+    in_blocks INTEGER NOT NULL,
+    out_blocks INTEGER NOT NULL,
+    voluntary_switches INTEGER NOT NULL,
+    involuntary_switches INTEGER NOT NULL
+);
+
+CREATE TABLE test_cache_keys (
+    test_case_id INTEGER PRIMARY KEY REFERENCES test_cases,
+    cache_key TEXT NOT NULL
+);
+
+ALTER TABLE test_results ADD COLUMN
+    attempt INTEGER NOT NULL DEFAULT 1 CHECK (attempt >= 1);
+
+ALTER TABLE test_programs ADD COLUMN variant TEXT;
+
+CREATE TABLE test_retried_results (
+    test_case_id INTEGER NOT NULL REFERENCES test_cases,
+    attempt INTEGER NOT NULL CHECK (attempt >= 1),
+    result_type TEXT NOT NULL,
+    result_reason TEXT,
+
+    start_time TIMESTAMP NOT NULL,
+    end_time TIMESTAMP NOT NULL,
+
+    PRIMARY KEY (test_case_id, attempt)
+);
+
+CREATE TABLE test_cpu_affinities (
+    test_case_id INTEGER PRIMARY KEY REFERENCES test_cases,
+    slot INTEGER NOT NULL CHECK (slot >= 0),
+    numa_node INTEGER NOT NULL CHECK (numa_node >= 0),
+    cpus TEXT NOT NULL
+);
+
+CREATE TABLE test_sub_results (
+    test_case_id INTEGER NOT NULL REFERENCES test_cases,
+    position INTEGER NOT NULL CHECK (position >= 1),
+    result_type TEXT NOT NULL,
+    result_reason TEXT,
+
+    PRIMARY KEY (test_case_id, position)
+);
+
+CREATE TABLE phase_latencies (
+    phase TEXT NOT NULL,
+    upper_bound INTEGER NOT NULL CHECK (upper_bound >= 0),
+    count INTEGER NOT NULL CHECK (count >= 1),
+
+    PRIMARY KEY (phase, upper_bound)
+);
+
+CREATE TABLE run_events (
+    event_id INTEGER PRIMARY KEY AUTOINCREMENT,
+    kind TEXT NOT NULL,
+    name TEXT NOT NULL,
+    pid INTEGER,
+    start_time TIMESTAMP NOT NULL,
+    end_time TIMESTAMP NOT NULL
+);
+
+CREATE TABLE result_summaries (
+    result_type TEXT PRIMARY KEY,
+    results_count INTEGER NOT NULL CHECK (results_count >= 1),
+    total_duration INTEGER NOT NULL,
+    min_start_time TIMESTAMP NOT NULL,
+    max_end_time TIMESTAMP NOT NULL
+);
+
+INSERT INTO result_summaries
+    SELECT result_type, COUNT(*), SUM(end_time - start_time),
+        MIN(start_time), MAX(end_time)
+    FROM test_results GROUP BY result_type;
+
+CREATE TABLE slot_usage (
+    activity TEXT PRIMARY KEY,
+    slot_time INTEGER NOT NULL CHECK (slot_time >= 0)
+);
+
+
+--
+-- Update the metadata version.
+--
+
+
+INSERT INTO metadata (timestamp, schema_version)
+    VALUES (strftime('%s', 'now'), 4);
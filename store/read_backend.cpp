@@ -37,11 +37,26 @@
 #include "utils/noncopyable.hpp"
 #include "utils/sqlite/database.hpp"
 #include "utils/sqlite/exceptions.hpp"
+#include "utils/sqlite/statement.ipp"
 
 namespace fs = utils::fs;
 namespace sqlite = utils::sqlite;
 
 
+namespace {
+
+
+/// Time in milliseconds to wait for a lock held by another connection.
+///
+/// A results file can be read by "kyua report --follow" while "kyua test" is
+/// still writing to it, so either side may briefly find the database locked
+/// by the other one when committing or checkpointing.
+static const int busy_timeout_msec = 10000;
+
+
+}  // anonymous namespace
+
+
 /// Opens a database and defines session pragmas.
 ///
 /// This auxiliary function ensures that, every time we open a SQLite database,
@@ -59,6 +74,7 @@ store::detail::open_and_setup(const fs::path& file, const int flags)
     try {
         sqlite::database database = sqlite::database::open(file, flags);
         database.exec("PRAGMA foreign_keys = ON");
+        database.exec(F("PRAGMA busy_timeout = %s") % busy_timeout_msec);
         return database;
     } catch (const sqlite::error& e) {
         throw store::error(F("Cannot open '%s': %s") % file % e.what());
@@ -117,8 +133,18 @@ store::read_backend::~read_backend(void)
 }
 
 
+/// Amount of a read-only database to access through memory-mapped I/O.
+///
+/// Reports scan large parts of the results files, so mapping them avoids
+/// copying every page into the private cache of the connection.  SQLite caps
+/// this at its compile-time maximum and ignores it where mmap is unsupported.
+static const int64_t read_only_mmap_size = 256 * 1024 * 1024;
+
+
 /// Opens a database in read-only mode.
 ///
+/// Memory-mapped I/O is enabled for the connection.
+///
 /// \param file The database file to be opened.
 ///
 /// \return The backend representation.
@@ -128,6 +154,30 @@ store::read_backend
 store::read_backend::open_ro(const fs::path& file)
 {
     sqlite::database db = detail::open_and_setup(file, sqlite::open_readonly);
+    try {
+        db.exec(F("PRAGMA mmap_size = %s") % read_only_mmap_size);
+    } catch (const sqlite::error& e) {
+        throw store::error(F("Cannot open '%s': %s") % file % e.what());
+    }
+    return read_backend(new impl(db, metadata::fetch_latest(db)));
+}
+
+
+/// Reads a database through a connection that is already open.
+///
+/// This allows reading back what a writer stored without opening a new
+/// connection to the same file, and is the only way to read a database
+/// created by write_backend::open_in_memory().  The caller must not have a
+/// transaction open on the connection while reading through the backend.
+///
+/// \param db The database connection to use.
+///
+/// \return The backend representation.
+///
+/// \throw store::error If the database does not contain a valid store.
+store::read_backend
+store::read_backend::from_database(sqlite::database& db)
+{
     return read_backend(new impl(db, metadata::fetch_latest(db)));
 }
 
@@ -150,6 +200,30 @@ store::read_backend::database(void)
 }
 
 
+/// Gets a value that changes whenever other connections modify the database.
+///
+/// This allows detecting cheaply whether there is anything new to read from a
+/// database that is being written to concurrently.  The value is only
+/// meaningful when compared to previous values returned by the same backend.
+///
+/// \return An opaque version number.
+///
+/// \throw store::error If there is a problem querying the database.
+int64_t
+store::read_backend::data_version(void)
+{
+    try {
+        sqlite::statement stmt = _pimpl->database.create_statement(
+            "PRAGMA data_version");
+        if (!stmt.step())
+            throw error("Cannot query the data version: no data");
+        return stmt.column_int64(0);
+    } catch (const sqlite::error& e) {
+        throw error(F("Cannot query the data version: %s") % e.what());
+    }
+}
+
+
 /// Opens a read-only transaction.
 ///
 /// \return A new transaction.
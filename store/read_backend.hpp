@@ -34,6 +34,10 @@
 
 #include "store/read_backend_fwd.hpp"
 
+extern "C" {
+#include <stdint.h>
+}
+
 #include "store/read_transaction_fwd.hpp"
 #include "utils/fs/path_fwd.hpp"
 #include "utils/shared_ptr.hpp"
@@ -64,9 +68,11 @@ public:
     ~read_backend(void);
 
     static read_backend open_ro(const utils::fs::path&);
+    static read_backend from_database(utils::sqlite::database&);
     void close(void);
 
     utils::sqlite::database& database(void);
+    int64_t data_version(void);
     read_transaction start_read(void);
 };
 
@@ -38,6 +38,7 @@
 #include "utils/logging/operations.hpp"
 #include "utils/sqlite/database.hpp"
 #include "utils/sqlite/exceptions.hpp"
+#include "utils/sqlite/statement.ipp"
 
 namespace fs = utils::fs;
 namespace logging = utils::logging;
@@ -62,6 +63,10 @@ ATF_TEST_CASE_BODY(detail__open_and_setup__ok)
     db.exec("INSERT INTO two (foo) VALUES (12);");
     ATF_REQUIRE_THROW(sqlite::error,
                       db.exec("INSERT INTO two (foo) VALUES (34);"));
+    // Ensure concurrent writers wait for each other.
+    sqlite::statement stmt = db.create_statement("PRAGMA busy_timeout");
+    ATF_REQUIRE(stmt.step());
+    ATF_REQUIRE(stmt.column_int(0) > 0);
 }
 
 
@@ -122,6 +127,65 @@ ATF_TEST_CASE_BODY(read_backend__open_ro__integrity_error)
 }
 
 
+ATF_TEST_CASE(read_backend__from_database__ok);
+ATF_TEST_CASE_HEAD(read_backend__from_database__ok)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(read_backend__from_database__ok)
+{
+    store::write_backend writer = store::write_backend::open_in_memory();
+    writer.database().exec("CREATE TABLE extra (col INTEGER)");
+
+    store::read_backend backend = store::read_backend::from_database(
+        writer.database());
+    backend.database().exec("SELECT * FROM extra");
+}
+
+
+ATF_TEST_CASE(read_backend__from_database__integrity_error);
+ATF_TEST_CASE_HEAD(read_backend__from_database__integrity_error)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(read_backend__from_database__integrity_error)
+{
+    sqlite::database db = sqlite::database::in_memory();
+    store::detail::initialize(db);
+    db.exec("DELETE FROM metadata");
+    ATF_REQUIRE_THROW_RE(store::integrity_error, "metadata.*empty",
+                         store::read_backend::from_database(db));
+}
+
+
+ATF_TEST_CASE(read_backend__data_version);
+ATF_TEST_CASE_HEAD(read_backend__data_version)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(read_backend__data_version)
+{
+    store::write_backend::open_rw(fs::path("test.db"));  // Create database.
+    store::read_backend backend = store::read_backend::open_ro(
+        fs::path("test.db"));
+
+    const int64_t version1 = backend.data_version();
+    ATF_REQUIRE_EQ(version1, backend.data_version());
+
+    {
+        sqlite::database db = sqlite::database::open(
+            fs::path("test.db"), sqlite::open_readwrite);
+        db.exec("DELETE FROM env_vars");
+    }
+    const int64_t version2 = backend.data_version();
+    ATF_REQUIRE(version1 != version2);
+    ATF_REQUIRE_EQ(version2, backend.data_version());
+}
+
+
 ATF_TEST_CASE(read_backend__close);
 ATF_TEST_CASE_HEAD(read_backend__close)
 {
@@ -148,5 +212,8 @@ ATF_INIT_TEST_CASES(tcs)
     ATF_ADD_TEST_CASE(tcs, read_backend__open_ro__ok);
     ATF_ADD_TEST_CASE(tcs, read_backend__open_ro__missing_file);
     ATF_ADD_TEST_CASE(tcs, read_backend__open_ro__integrity_error);
+    ATF_ADD_TEST_CASE(tcs, read_backend__from_database__ok);
+    ATF_ADD_TEST_CASE(tcs, read_backend__from_database__integrity_error);
+    ATF_ADD_TEST_CASE(tcs, read_backend__data_version);
     ATF_ADD_TEST_CASE(tcs, read_backend__close);
 }
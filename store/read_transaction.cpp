@@ -32,18 +32,24 @@ extern "C" {
 #include <stdint.h>
 }
 
+#include <algorithm>
 #include <map>
-#include <utility>
+#include <memory>
+#include <set>
+#include <vector>
 
 #include "model/context.hpp"
 #include "model/metadata.hpp"
 #include "model/test_case.hpp"
 #include "model/test_program.hpp"
 #include "model/test_result.hpp"
+#include "store/codec.hpp"
 #include "store/dbtypes.hpp"
 #include "store/exceptions.hpp"
 #include "store/read_backend.hpp"
+#include "store/segment.hpp"
 #include "utils/datetime.hpp"
+#include "utils/defs.hpp"
 #include "utils/format/macros.hpp"
 #include "utils/fs/path.hpp"
 #include "utils/logging/macros.hpp"
@@ -52,6 +58,7 @@ extern "C" {
 #include "utils/sanity.hpp"
 #include "utils/sqlite/database.hpp"
 #include "utils/sqlite/exceptions.hpp"
+#include "utils/sqlite/incremental_blob.hpp"
 #include "utils/sqlite/statement.ipp"
 #include "utils/sqlite/transaction.hpp"
 
@@ -59,6 +66,7 @@ namespace datetime = utils::datetime;
 namespace fs = utils::fs;
 namespace sqlite = utils::sqlite;
 
+using utils::none;
 using utils::optional;
 
 
@@ -90,18 +98,30 @@ get_env_vars(sqlite::database& db)
 }
 
 
+/// Collection of loaded metadata objects, keyed by their identifier.
+typedef std::map< int64_t, model::metadata > metadata_cache;
+
+
 /// Retrieves a metadata object.
 ///
 /// \param db The SQLite database.
 /// \param metadata_id The identifier of the metadata.
+/// \param [in,out] cache The metadata objects loaded so far from db.  Metadata
+///     identifiers are shared by all objects with the same metadata, so this
+///     avoids decoding the same properties over and over again.
 ///
-/// \return A new metadata object.
+/// \return A metadata object.
 static model::metadata
-get_metadata(sqlite::database& db, const int64_t metadata_id)
+get_metadata(sqlite::database& db, const int64_t metadata_id,
+             metadata_cache& cache)
 {
+    const metadata_cache::const_iterator cached = cache.find(metadata_id);
+    if (cached != cache.end())
+        return (*cached).second;
+
     model::metadata_builder builder;
 
-    sqlite::statement stmt = db.create_statement(
+    sqlite::statement stmt = db.cached_statement(
         "SELECT * FROM metadatas WHERE metadata_id == :metadata_id");
     stmt.bind(":metadata_id", metadata_id);
     while (stmt.step()) {
@@ -110,12 +130,67 @@ get_metadata(sqlite::database& db, const int64_t metadata_id)
         builder.set_string(name, value);
     }
 
-    return builder.build();
+    const model::metadata metadata = builder.build();
+    cache.insert(metadata_cache::value_type(metadata_id, metadata));
+    return metadata;
+}
+
+
+/// Opens the segment file of a database.
+///
+/// \param db The database whose segment to open.
+///
+/// \return A reader for the segment.
+///
+/// \throw integrity_error If the database has no segment or if the segment
+///     cannot be opened.
+static std::auto_ptr< store::detail::segment_reader >
+open_segment(sqlite::database& db)
+{
+    const optional< fs::path >& db_path = db.db_filename();
+    if (!db_path)
+        throw store::integrity_error("In-memory database references files in "
+                                     "a segment");
+    return std::auto_ptr< store::detail::segment_reader >(
+        new store::detail::segment_reader(
+            store::detail::segment_path(db_path.get())));
+}
+
+
+/// Gets the reference to the contents of a file stored in a segment.
+///
+/// \param db The database to query the file from.
+/// \param file_id The identifier of the file to be queried.
+///
+/// \return The reference to the contents of the file.
+///
+/// \throw integrity_error If there is any problem in the loaded data.
+static store::detail::segment_ref
+get_segment_ref(sqlite::database& db, const int64_t file_id)
+{
+    sqlite::statement stmt = db.cached_statement(
+        "SELECT contents FROM files WHERE file_id == :file_id");
+    stmt.bind(":file_id", file_id);
+    if (!stmt.step())
+        throw store::integrity_error(F("Cannot find referenced file %s") %
+                                     file_id);
+    try {
+        const sqlite::blob contents = stmt.safe_column_blob("contents");
+        const store::detail::segment_ref ref =
+            store::detail::parse_segment_ref(contents.memory, contents.size);
+        const bool more = stmt.step();
+        INV(!more);
+        return ref;
+    } catch (const sqlite::error& e) {
+        throw store::integrity_error(e.what());
+    }
 }
 
 
 /// Gets a file from the database.
 ///
+/// Files whose contents live in a segment are resolved transparently.
+///
 /// \param db The database to query the file from.
 /// \param file_id The identifier of the file to be queried.
 ///
@@ -126,8 +201,8 @@ get_metadata(sqlite::database& db, const int64_t metadata_id)
 static std::string
 get_file(sqlite::database& db, const int64_t file_id)
 {
-    sqlite::statement stmt = db.create_statement(
-        "SELECT contents FROM files WHERE file_id == :file_id");
+    sqlite::statement stmt = db.cached_statement(
+        "SELECT contents, codec FROM files WHERE file_id == :file_id");
     stmt.bind(":file_id", file_id);
     if (!stmt.step())
         throw store::integrity_error(F("Cannot find referenced file %s") %
@@ -135,122 +210,1064 @@ get_file(sqlite::database& db, const int64_t file_id)
 
     try {
         const sqlite::blob raw_contents = stmt.safe_column_blob("contents");
-        const std::string contents(
-            static_cast< const char *>(raw_contents.memory), raw_contents.size);
+        const std::string codec = stmt.safe_column_text("codec");
+        if (codec == store::detail::codec_segment) {
+            const store::detail::segment_ref ref =
+                store::detail::parse_segment_ref(raw_contents.memory,
+                                                 raw_contents.size);
+            const bool more = stmt.step();
+            INV(!more);
+
+            std::string encoded(static_cast< std::size_t >(ref.length), '\0');
+            if (!encoded.empty())
+                open_segment(db)->read(ref, 0, &encoded[0], encoded.length());
+            return store::detail::decode_contents(ref.codec, encoded.data(),
+                                                  encoded.length());
+        }
+        const std::string contents = store::detail::decode_contents(
+            codec, raw_contents.memory, raw_contents.size);
+
+        const bool more = stmt.step();
+        INV(!more);
+
+        return contents;
+    } catch (const sqlite::error& e) {
+        throw store::integrity_error(e.what());
+    }
+}
+
+
+/// Reads a file from the database in chunks.
+///
+/// \param db The database to query the file from.
+/// \param file_id The identifier of the file to be queried.
+/// \param hooks The callbacks to feed the decoded contents of the file to.
+///
+/// \throw integrity_error If there is any problem in the loaded data or if the
+///     file cannot be found.
+static void
+read_file(sqlite::database& db, const int64_t file_id,
+          store::file_hooks& hooks)
+{
+    std::string codec;
+    {
+        sqlite::statement stmt = db.cached_statement(
+            "SELECT codec FROM files WHERE file_id == :file_id");
+        stmt.bind(":file_id", file_id);
+        if (!stmt.step())
+            throw store::integrity_error(F("Cannot find referenced file %s") %
+                                         file_id);
+        codec = stmt.safe_column_text("codec");
+        const bool more = stmt.step();
+        INV(!more);
+    }
+
+    if (codec == store::detail::codec_segment) {
+        const store::detail::segment_ref ref = get_segment_ref(db, file_id);
+        std::auto_ptr< store::detail::segment_reader > segment =
+            open_segment(db);
+        store::detail::decoder file_decoder(ref.codec);
+
+        char buffer[64 * 1024];
+        for (int64_t offset = 0; offset < ref.length; ) {
+            const std::size_t length = static_cast< std::size_t >(
+                std::min(static_cast< int64_t >(sizeof(buffer)),
+                         ref.length - offset));
+            segment->read(ref, offset, buffer, length);
+            if (!file_decoder.feed(buffer, length, hooks))
+                return;
+            offset += length;
+        }
+        file_decoder.finish();
+        return;
+    }
+
+    try {
+        store::detail::decoder file_decoder(codec);
+        sqlite::incremental_blob blob = db.open_blob("files", "contents",
+                                                     file_id, false);
+        const int size = blob.size();
+
+        char buffer[64 * 1024];
+        for (int offset = 0; offset < size; ) {
+            const int length = std::min(static_cast< int >(sizeof(buffer)),
+                                        size - offset);
+            blob.read(offset, buffer, length);
+            if (!file_decoder.feed(buffer, length, hooks))
+                return;
+            offset += length;
+        }
+        file_decoder.finish();
+    } catch (const sqlite::error& e) {
+        throw store::integrity_error(e.what());
+    }
+}
+
+
+/// File hooks that count the length of the decoded contents of a file.
+class counting_hooks : public store::file_hooks {
+    /// Number of bytes seen so far.
+    std::size_t _size;
+
+public:
+    /// Constructor.
+    counting_hooks(void) : _size(0)
+    {
+    }
+
+    /// Accounts for a chunk of the file.
+    ///
+    /// \param unused_data The contents of the chunk.
+    /// \param size The length of the chunk in bytes.
+    ///
+    /// \return Always true, as the whole file has to be seen.
+    bool
+    got_chunk(const char* UTILS_UNUSED_PARAM(data), const std::size_t size)
+    {
+        _size += size;
+        return true;
+    }
+
+    /// Gets the number of bytes seen so far.
+    ///
+    /// \return A length in bytes.
+    std::size_t
+    size(void) const
+    {
+        return _size;
+    }
+};
+
+
+/// File hooks that collect a range of the decoded contents of a file.
+class range_hooks : public store::file_hooks {
+    /// Number of bytes still to be skipped before the range starts.
+    std::size_t _skip;
+
+    /// Maximum number of bytes still to be collected.
+    std::size_t _left;
+
+    /// The contents of the range collected so far.
+    std::string _contents;
+
+public:
+    /// Constructor.
+    ///
+    /// \param offset The position of the first byte of the range.
+    /// \param length The maximum length of the range.
+    range_hooks(const std::size_t offset, const std::size_t length) :
+        _skip(offset), _left(length)
+    {
+    }
+
+    /// Collects the part of a chunk that falls within the range.
+    ///
+    /// \param data The contents of the chunk.
+    /// \param size The length of the chunk in bytes.
+    ///
+    /// \return True while the end of the range has not been reached yet.
+    bool
+    got_chunk(const char* data, const std::size_t size)
+    {
+        if (_skip >= size) {
+            _skip -= size;
+            return _left > 0;
+        }
+        const std::size_t length = std::min(size - _skip, _left);
+        _contents.append(data + _skip, length);
+        _skip = 0;
+        _left -= length;
+        return _left > 0;
+    }
+
+    /// Gets the contents collected so far.
+    ///
+    /// \return The contents of the range.
+    const std::string&
+    contents(void) const
+    {
+        return _contents;
+    }
+};
+
 
+/// Gets the length of the decoded contents of a file.
+///
+/// The length is recorded alongside the file so this normally does not have
+/// to touch the contents at all.  Files stored without a length are measured
+/// instead, which for compressed files needs to decode them.
+///
+/// \param db The database to query the file from.
+/// \param file_id The identifier of the file to be queried.
+///
+/// \return The length of the file in bytes.
+///
+/// \throw integrity_error If there is any problem in the loaded data or if the
+///     file cannot be found.
+static std::size_t
+get_file_size(sqlite::database& db, const int64_t file_id)
+{
+    sqlite::statement stmt = db.cached_statement(
+        "SELECT size, codec, length(contents) AS raw_size "
+        "FROM files WHERE file_id == :file_id");
+    stmt.bind(":file_id", file_id);
+    if (!stmt.step())
+        throw store::integrity_error(F("Cannot find referenced file %s") %
+                                     file_id);
+
+    try {
+        if (stmt.column_type(stmt.column_id("size")) != sqlite::type_null) {
+            const int64_t size = stmt.safe_column_int64("size");
+            if (size < 0)
+                throw store::integrity_error(F("Invalid size %s for file %s")
+                                             % size % file_id);
+            return static_cast< std::size_t >(size);
+        }
+
+        const std::string codec = stmt.safe_column_text("codec");
+        const int64_t raw_size = stmt.safe_column_int64("raw_size");
         const bool more = stmt.step();
         INV(!more);
 
-        return contents;
-    } catch (const sqlite::error& e) {
-        throw store::integrity_error(e.what());
-    }
+        if (codec == store::detail::codec_none)
+            return static_cast< std::size_t >(raw_size);
+    } catch (const sqlite::error& e) {
+        throw store::integrity_error(e.what());
+    }
+
+    counting_hooks hooks;
+    read_file(db, file_id, hooks);
+    return hooks.size();
+}
+
+
+/// Reads a range of the decoded contents of a file.
+///
+/// Verbatim files are read directly at the requested position using
+/// incremental blob I/O.  Compressed files have to be decoded from their
+/// beginning, but decoding stops as soon as the range is complete.
+///
+/// \param db The database to query the file from.
+/// \param file_id The identifier of the file to be queried.
+/// \param offset The position of the first byte to read.
+/// \param length The maximum number of bytes to read.
+///
+/// \return The contents of the range, which is shorter than length if the
+/// file ends before.
+///
+/// \throw integrity_error If there is any problem in the loaded data or if the
+///     file cannot be found.
+static std::string
+read_file_range(sqlite::database& db, const int64_t file_id,
+                const std::size_t offset, const std::size_t length)
+{
+    std::string codec;
+    {
+        sqlite::statement stmt = db.cached_statement(
+            "SELECT codec FROM files WHERE file_id == :file_id");
+        stmt.bind(":file_id", file_id);
+        if (!stmt.step())
+            throw store::integrity_error(F("Cannot find referenced file %s") %
+                                         file_id);
+        codec = stmt.safe_column_text("codec");
+        const bool more = stmt.step();
+        INV(!more);
+    }
+
+    if (codec == store::detail::codec_segment) {
+        const store::detail::segment_ref ref = get_segment_ref(db, file_id);
+        if (ref.codec == store::detail::codec_none) {
+            const std::size_t size = static_cast< std::size_t >(ref.length);
+            if (offset >= size)
+                return "";
+            const std::size_t actual_length = std::min(length, size - offset);
+
+            std::string contents(actual_length, '\0');
+            if (actual_length > 0)
+                open_segment(db)->read(ref, static_cast< int64_t >(offset),
+                                       &contents[0], actual_length);
+            return contents;
+        }
+    }
+
+    if (codec != store::detail::codec_none) {
+        range_hooks hooks(offset, length);
+        if (length > 0)
+            read_file(db, file_id, hooks);
+        return hooks.contents();
+    }
+
+    try {
+        sqlite::incremental_blob blob = db.open_blob("files", "contents",
+                                                     file_id, false);
+        const std::size_t size = static_cast< std::size_t >(blob.size());
+        if (offset >= size)
+            return "";
+        const std::size_t actual_length = std::min(length, size - offset);
+
+        std::string contents(actual_length, '\0');
+        if (actual_length > 0)
+            blob.read(static_cast< int >(offset), &contents[0],
+                      static_cast< int >(actual_length));
+        return contents;
+    } catch (const sqlite::error& e) {
+        throw store::integrity_error(e.what());
+    }
+}
+
+
+/// Gets all the test cases within a particular test program.
+///
+/// \param db The database to query the information from.
+/// \param test_program_id The identifier of the test program whose test cases
+///     to query.
+/// \param [in,out] cache The metadata objects loaded so far from db.
+///
+/// \return The collection of loaded test cases.
+///
+/// \throw integrity_error If there is any problem in the loaded data.
+static model::test_cases_map
+get_test_cases(sqlite::database& db, const int64_t test_program_id,
+               metadata_cache& cache)
+{
+    model::test_cases_map_builder test_cases;
+
+    sqlite::statement stmt = db.cached_statement(
+        "SELECT name, metadata_id "
+        "FROM test_cases WHERE test_program_id == :test_program_id");
+    stmt.bind(":test_program_id", test_program_id);
+    while (stmt.step()) {
+        const std::string name = stmt.safe_column_text("name");
+        const int64_t metadata_id = stmt.safe_column_int64("metadata_id");
+
+        const model::metadata metadata = get_metadata(db, metadata_id, cache);
+        LD(F("Loaded test case '%s'") % name);
+        test_cases.add(name, metadata);
+    }
+
+    return test_cases.build();
+}
+
+
+/// Retrieves a result from the database.
+///
+/// \param stmt The statement with the data for the result to load.
+/// \param type_column The column containing the type of the result.
+/// \param reason_column The column containing the reason for the result, if
+///     any.
+///
+/// \return The loaded result.
+///
+/// \throw integrity_error If the data in the database is invalid.
+static model::test_result
+parse_result(sqlite::statement& stmt,
+             const sqlite::column< std::string >& type_column,
+             const sqlite::column< std::string >& reason_column)
+{
+    try {
+        const model::test_result_type type =
+            store::column_test_result_type(stmt, type_column);
+        if (type == model::test_result_passed) {
+            if (stmt.column_type(reason_column.index) != sqlite::type_null)
+                throw store::integrity_error("Result of type 'passed' has a "
+                                             "non-NULL reason");
+            return model::test_result(type);
+        } else {
+            return model::test_result(type, stmt.safe_column(reason_column));
+        }
+    } catch (const sqlite::error& e) {
+        throw store::integrity_error(e.what());
+    }
+}
+
+
+/// Extracts the variant name of a test program from a query row.
+///
+/// \param stmt The statement with the test_programs row to process.
+///
+/// \return The name of the variant, or the empty string if none.
+static std::string
+column_variant(sqlite::statement& stmt)
+{
+    const int column = stmt.column_id("variant");
+    if (stmt.column_type(column) == sqlite::type_null)
+        return "";
+    else
+        return stmt.safe_column_text("variant");
+}
+
+
+/// Loads a specific test program from the database.
+///
+/// \param db The database to query the information from.
+/// \param id The identifier of the test program to load.
+/// \param [in,out] cache The metadata objects loaded so far from db.
+///
+/// \return The instantiated test program.
+///
+/// \throw integrity_error If the data read from the database cannot be properly
+///     interpreted.
+static model::test_program_ptr
+load_test_program(sqlite::database& db, const int64_t id,
+                  metadata_cache& cache)
+{
+    model::test_program_ptr test_program;
+    sqlite::statement stmt = db.cached_statement(
+        "SELECT * FROM test_programs WHERE test_program_id == :id");
+    stmt.bind(":id", id);
+    stmt.step();
+    const std::string interface = stmt.safe_column_text("interface");
+    test_program.reset(new model::test_program(
+        interface,
+        fs::path(stmt.safe_column_text("relative_path")),
+        fs::path(stmt.safe_column_text("root")),
+        stmt.safe_column_text("test_suite_name"),
+        get_metadata(db, stmt.safe_column_int64("metadata_id"), cache),
+        get_test_cases(db, id, cache), column_variant(stmt)));
+    const bool more = stmt.step();
+    INV(!more);
+
+    LD(F("Loaded test program '%s'") % test_program->relative_path());
+    return test_program;
+}
+
+
+/// Collection of test programs, keyed by their identifier.
+typedef std::map< int64_t, model::test_program_ptr > test_programs_map;
+
+
+/// Constructs the SQL condition to select the test programs of a filter.
+///
+/// A test program matches a filter entry if its path is the same as the entry
+/// or if it lives in a subdirectory of the entry, which is the same semantics
+/// as those of fs::path::is_parent_of().  Subdirectories are matched with a
+/// range comparison instead of a LIKE pattern so that we need not escape any
+/// wildcards in the path and so that an index on the path can be used.
+///
+/// \param filter The filter describing the test programs to select.
+///
+/// \return An SQL expression to be placed in a WHERE clause.  The values it
+/// references must be bound with bind_test_programs_condition().
+static std::string
+test_programs_condition(const store::results_filter& filter)
+{
+    const std::set< fs::path >& test_programs = filter.test_programs();
+    if (test_programs.empty())
+        return "1";
+
+    std::string condition;
+    for (std::set< fs::path >::size_type i = 0; i < test_programs.size();
+         ++i) {
+        if (!condition.empty())
+            condition += " OR ";
+        condition += (F("test_programs.relative_path == :program_%s OR "
+                        "(test_programs.relative_path >= :program_lo_%s AND "
+                        "test_programs.relative_path < :program_hi_%s)") %
+                      i % i % i).str();
+    }
+    return "(" + condition + ")";
+}
+
+
+/// Binds the values referenced by test_programs_condition().
+///
+/// \param stmt The statement to bind the values to.
+/// \param filter The filter describing the test programs to select.
+static void
+bind_test_programs_condition(sqlite::statement& stmt,
+                             const store::results_filter& filter)
+{
+    const std::set< fs::path >& test_programs = filter.test_programs();
+    std::set< fs::path >::size_type i = 0;
+    for (std::set< fs::path >::const_iterator iter = test_programs.begin();
+         iter != test_programs.end(); ++iter, ++i) {
+        const std::string path = (*iter).str();
+        stmt.bind((F(":program_%s") % i).str().c_str(), path);
+        // '0' immediately follows '/' in ASCII, so the [path/, path0) range
+        // covers all paths with the path/ prefix.
+        stmt.bind((F(":program_lo_%s") % i).str().c_str(), path + "/");
+        stmt.bind((F(":program_hi_%s") % i).str().c_str(), path + "0");
+    }
+}
+
+
+/// Stores the pending test cases of a watermark in a temporary table.
+///
+/// The amount of test cases without a result can be as large as the amount of
+/// test cases in the database, so they are not passed as statement parameters:
+/// the statements that use watermark_condition() query this table instead.
+/// This must be called before preparing such statements and the table is
+/// shared by all of them, so they must all refer to the same watermark.
+///
+/// \param db The database to prepare.
+/// \param watermark The position after which to select test cases.
+static void
+prepare_watermark(sqlite::database& db,
+                  const store::results_watermark& watermark)
+{
+    const std::set< int64_t >& pending = watermark.pending_test_case_ids();
+    if (pending.empty())
+        return;
+
+    db.exec("CREATE TEMP TABLE IF NOT EXISTS watermark_pending ("
+            "    test_case_id INTEGER PRIMARY KEY)");
+    db.exec("DELETE FROM temp.watermark_pending");
+    sqlite::statement stmt = db.create_statement(
+        "INSERT INTO temp.watermark_pending (test_case_id) VALUES (:id)");
+    for (std::set< int64_t >::const_iterator iter = pending.begin();
+         iter != pending.end(); ++iter) {
+        stmt.bind(":id", *iter);
+        stmt.step_without_results();
+        stmt.reset();
+    }
+}
+
+
+/// Constructs the SQL condition to select the test cases after a watermark.
+///
+/// \param watermark The position after which to select test cases.
+///
+/// \return An SQL expression on test_cases.test_case_id to be placed in a
+/// WHERE clause.  The values it references must be bound with
+/// bind_watermark_condition() and the database must have been set up with
+/// prepare_watermark().
+static std::string
+watermark_condition(const store::results_watermark& watermark)
+{
+    const std::set< int64_t >& pending = watermark.pending_test_case_ids();
+    if (watermark.last_test_case_id() == 0 && pending.empty())
+        return "1";
+
+    std::string condition = "(test_cases.test_case_id > :watermark_last";
+    if (!pending.empty())
+        condition += " OR test_cases.test_case_id IN ("
+            "SELECT test_case_id FROM temp.watermark_pending)";
+    return condition + ")";
+}
+
+
+/// Binds the values referenced by watermark_condition().
+///
+/// \param stmt The statement to bind the values to.
+/// \param watermark The position after which to select test cases.
+static void
+bind_watermark_condition(sqlite::statement& stmt,
+                         const store::results_watermark& watermark)
+{
+    if (watermark.last_test_case_id() == 0 &&
+        watermark.pending_test_case_ids().empty())
+        return;
+
+    stmt.bind(":watermark_last", watermark.last_test_case_id());
+}
+
+
+/// Constructs the SQL condition to select the test programs to load.
+///
+/// \param filter The filter describing the results to be returned.
+///
+/// \return An SQL expression to be placed in a WHERE clause.  The values it
+/// references must be bound with bind_load_condition().
+static std::string
+load_condition(const store::results_filter& filter)
+{
+    std::string condition = test_programs_condition(filter);
+    const std::string watermark = watermark_condition(filter.watermark());
+    if (watermark != "1") {
+        // Only load the test programs that can have new results; otherwise,
+        // following the results of a database would load all test programs
+        // over and over again.
+        condition += " AND test_programs.test_program_id IN ("
+            "SELECT test_program_id FROM test_cases WHERE " + watermark + ")";
+    }
+    return condition;
+}
+
+
+/// Binds the values referenced by load_condition().
+///
+/// \param stmt The statement to bind the values to.
+/// \param filter The filter describing the results to be returned.
+static void
+bind_load_condition(sqlite::statement& stmt,
+                    const store::results_filter& filter)
+{
+    bind_test_programs_condition(stmt, filter);
+    bind_watermark_condition(stmt, filter.watermark());
+}
+
+
+/// Loads the metadata objects of the test programs that match a filter.
+///
+/// Following a database loads the test programs that have new results over
+/// and over again, so this only reads the metadata that those test programs
+/// and their test cases refer to instead of the whole table.
+///
+/// \param db The database to query the information from.
+/// \param filter The filter describing the test programs to load.
+/// \param [out] cache The container into which to store the loaded objects.
+///
+/// \throw integrity_error If there is any problem in the loaded data.
+static void
+load_all_metadata(sqlite::database& db, const store::results_filter& filter,
+                  metadata_cache& cache)
+{
+    const std::string condition = load_condition(filter);
+    std::string query =
+        "SELECT metadata_id, property_name, property_value FROM metadatas ";
+    if (condition != "1")
+        query +=
+            "WHERE metadata_id IN ("
+            "    SELECT test_cases.metadata_id "
+            "    FROM test_cases JOIN test_programs "
+            "        ON test_cases.test_program_id = "
+            "            test_programs.test_program_id "
+            "    WHERE " + condition + " "
+            "    UNION SELECT test_programs.metadata_id FROM test_programs "
+            "    WHERE " + condition + ") ";
+    query += "ORDER BY metadata_id";
+    sqlite::statement stmt = db.create_statement(query);
+    if (condition != "1")
+        bind_load_condition(stmt, filter);
+    const sqlite::column< int64_t > metadata_id_column = { 0, "metadata_id" };
+    const sqlite::column< std::string > name_column = { 1, "property_name" };
+    const sqlite::column< std::string > value_column = { 2, "property_value" };
+
+    std::auto_ptr< model::metadata_builder > builder;
+    int64_t current_id = 0;
+    while (stmt.step()) {
+        const int64_t metadata_id = stmt.safe_column(metadata_id_column);
+        if (builder.get() == NULL || metadata_id != current_id) {
+            if (builder.get() != NULL)
+                cache.insert(metadata_cache::value_type(current_id,
+                                                        builder->build()));
+            builder.reset(new model::metadata_builder());
+            current_id = metadata_id;
+        }
+        builder->set_string(stmt.safe_column(name_column),
+                            stmt.safe_column(value_column));
+    }
+    if (builder.get() != NULL)
+        cache.insert(metadata_cache::value_type(current_id, builder->build()));
+}
+
+
+/// Loads the test programs that match a filter from the database.
+///
+/// This issues a fixed number of queries regardless of the amount of test
+/// programs and test cases in the database, which is much cheaper than loading
+/// every test program individually with load_test_program().
+///
+/// \param db The database to query the information from.
+/// \param filter The filter describing the test programs to load.
+///
+/// \return The loaded test programs.
+///
+/// \throw integrity_error If there is any problem in the loaded data.
+static test_programs_map
+load_all_test_programs(sqlite::database& db,
+                       const store::results_filter& filter)
+{
+    metadata_cache metadatas;
+    load_all_metadata(db, filter, metadatas);
+
+    const std::string condition = load_condition(filter);
+
+    std::map< int64_t, model::test_cases_map > test_cases;
+    {
+        sqlite::statement stmt = db.create_statement(
+            "SELECT test_cases.test_program_id, test_cases.name, "
+            "    test_cases.metadata_id "
+            "FROM test_cases JOIN test_programs "
+            "    ON test_cases.test_program_id = test_programs.test_program_id "
+            "WHERE " + condition);
+        bind_load_condition(stmt, filter);
+        const sqlite::column< int64_t > test_program_id_column =
+            { 0, "test_program_id" };
+        const sqlite::column< std::string > name_column = { 1, "name" };
+        const sqlite::column< int64_t > metadata_id_column =
+            { 2, "metadata_id" };
+        while (stmt.step()) {
+            const int64_t test_program_id = stmt.safe_column(
+                test_program_id_column);
+            const std::string name = stmt.safe_column(name_column);
+            const model::metadata metadata = get_metadata(
+                db, stmt.safe_column(metadata_id_column), metadatas);
+            test_cases[test_program_id].insert(
+                model::test_cases_map::value_type(
+                    name, model::test_case(name, metadata)));
+        }
+    }
+
+    test_programs_map test_programs;
+    sqlite::statement stmt = db.create_statement(
+        "SELECT * FROM test_programs WHERE " + condition);
+    bind_load_condition(stmt, filter);
+    while (stmt.step()) {
+        const int64_t id = stmt.safe_column_int64("test_program_id");
+        const model::test_program_ptr test_program(new model::test_program(
+            stmt.safe_column_text("interface"),
+            fs::path(stmt.safe_column_text("relative_path")),
+            fs::path(stmt.safe_column_text("root")),
+            stmt.safe_column_text("test_suite_name"),
+            get_metadata(db, stmt.safe_column_int64("metadata_id"), metadatas),
+            test_cases[id], column_variant(stmt)));
+        test_programs.insert(test_programs_map::value_type(id, test_program));
+    }
+    LD(F("Loaded %s test programs") % test_programs.size());
+    return test_programs;
+}
+
+
+/// Columns of the query built by results_query().
+///
+/// The results iterator reads these for every row, so they are accessed by
+/// position instead of by name.  Keep them in sync with the query.
+static const sqlite::column< int64_t > results_test_program_id =
+    { 0, "test_program_id" };
+static const sqlite::column< std::string > results_name = { 3, "name" };
+static const sqlite::column< std::string > results_result_type =
+    { 4, "result_type" };
+static const sqlite::column< std::string > results_result_reason =
+    { 5, "result_reason" };
+static const sqlite::column< int64_t > results_start_time =
+    { 6, "start_time" };
+static const sqlite::column< int64_t > results_end_time = { 7, "end_time" };
+static const sqlite::column< int > results_attempt = { 8, "attempt" };
+static const sqlite::column< std::string > results_cache_key =
+    { 9, "cache_key" };
+static const sqlite::column< int64_t > results_stdout_file_id =
+    { 10, "stdout_file_id" };
+static const sqlite::column< int64_t > results_stderr_file_id =
+    { 11, "stderr_file_id" };
+
+
+/// Constructs the query to iterate over the results that match a filter.
+///
+/// \param filter The filter describing the results to select.
+///
+/// \return The SQL query.  The values it references must be bound with
+/// bind_results_query().
+static std::string
+results_query(const store::results_filter& filter)
+{
+    std::string query =
+        "SELECT test_programs.test_program_id, "
+        "    test_programs.interface, "
+        "    test_cases.test_case_id, test_cases.name, "
+        "    test_results.result_type, test_results.result_reason, "
+        "    test_results.start_time, test_results.end_time, "
+        "    test_results.attempt, test_cache_keys.cache_key";
+    if (filter.with_files())
+        query +=
+            ", stdout_files.file_id AS stdout_file_id, "
+            "    stderr_files.file_id AS stderr_file_id";
+    query +=
+        " FROM test_programs "
+        "    JOIN test_cases "
+        "    ON test_programs.test_program_id = test_cases.test_program_id "
+        "    JOIN test_results "
+        "    ON test_cases.test_case_id = test_results.test_case_id "
+        "    LEFT JOIN test_cache_keys "
+        "    ON test_cases.test_case_id = test_cache_keys.test_case_id ";
+    if (filter.with_files())
+        query +=
+            "    LEFT JOIN test_case_files AS stdout_files "
+            "    ON test_cases.test_case_id = stdout_files.test_case_id "
+            "        AND stdout_files.file_name = '__STDOUT__' "
+            "    LEFT JOIN test_case_files AS stderr_files "
+            "    ON test_cases.test_case_id = stderr_files.test_case_id "
+            "        AND stderr_files.file_name = '__STDERR__' ";
+
+    query += "WHERE " + test_programs_condition(filter);
+    query += " AND " + watermark_condition(filter.watermark());
+    const std::set< model::test_result_type >& types = filter.result_types();
+    if (!types.empty()) {
+        std::string types_list;
+        for (std::set< model::test_result_type >::size_type i = 0;
+             i < types.size(); ++i) {
+            if (!types_list.empty())
+                types_list += ", ";
+            types_list += (F(":result_type_%s") % i).str();
+        }
+        query += " AND test_results.result_type IN (" + types_list + ")";
+    }
+
+    // The identifier breaks ties between the variants of a test program, so
+    // that slices of the results are the same for every connection.
+    query += " ORDER BY test_programs.absolute_path, test_cases.name, "
+        "test_cases.test_case_id";
+    if (filter.slice_offset() > 0 || filter.slice_limit() > 0)
+        query += " LIMIT :slice_limit OFFSET :slice_offset";
+    return query;
+}
+
+
+/// Prepares the query to iterate over the results that match a filter.
+///
+/// \param db The database to query.
+/// \param filter The filter describing the results to select.
+///
+/// \return The statement for the query, with its values still unbound; see
+/// bind_results_query().
+static sqlite::statement
+create_results_statement(sqlite::database& db,
+                         const store::results_filter& filter)
+{
+    prepare_watermark(db, filter.watermark());
+    return db.create_statement(results_query(filter));
+}
+
+
+/// Binds the values referenced by results_query().
+///
+/// \param stmt The statement to bind the values to.
+/// \param filter The filter describing the results to select.
+static void
+bind_results_query(sqlite::statement& stmt,
+                   const store::results_filter& filter)
+{
+    bind_test_programs_condition(stmt, filter);
+    bind_watermark_condition(stmt, filter.watermark());
+
+    const std::set< model::test_result_type >& types = filter.result_types();
+    std::set< model::test_result_type >::size_type i = 0;
+    for (std::set< model::test_result_type >::const_iterator iter =
+             types.begin(); iter != types.end(); ++iter, ++i)
+        store::bind_test_result_type(
+            stmt, (F(":result_type_%s") % i).str().c_str(), *iter);
+
+    if (filter.slice_offset() > 0 || filter.slice_limit() > 0) {
+        stmt.bind(":slice_limit", filter.slice_limit() > 0 ?
+                  static_cast< int64_t >(filter.slice_limit()) : -1);
+        stmt.bind(":slice_offset",
+                  static_cast< int64_t >(filter.slice_offset()));
+    }
+}
+
+
+}  // anonymous namespace
+
+
+/// Loads a specific test program from the database.
+///
+/// \param backend_ The store backend we are dealing with.
+/// \param id The identifier of the test program to load.
+///
+/// \return The instantiated test program.
+///
+/// \throw integrity_error If the data read from the database cannot be properly
+///     interpreted.
+model::test_program_ptr
+store::detail::get_test_program(read_backend& backend_, const int64_t id)
+{
+    metadata_cache cache;
+    return load_test_program(backend_.database(), id, cache);
+}
+
+
+/// Destructor.
+store::file_hooks::~file_hooks(void)
+{
+}
+
+
+/// Constructs a watermark that precedes all results.
+store::results_watermark::results_watermark(void) :
+    _last_test_case_id(0)
+{
+}
+
+
+/// Constructs a watermark.
+///
+/// \param last_test_case_id_ Identifier of the last known test case.
+/// \param pending_test_case_ids_ Identifiers of the test cases up to
+///     last_test_case_id_ that did not have a result yet.
+store::results_watermark::results_watermark(
+    const int64_t last_test_case_id_,
+    const std::set< int64_t >& pending_test_case_ids_) :
+    _last_test_case_id(last_test_case_id_),
+    _pending_test_case_ids(pending_test_case_ids_)
+{
+}
+
+
+/// Gets the identifier of the last test case known at this position.
+///
+/// \return A test case identifier, or 0 if there were none.
+int64_t
+store::results_watermark::last_test_case_id(void) const
+{
+    return _last_test_case_id;
+}
+
+
+/// Gets the test cases that did not have a result at this position.
+///
+/// \return A collection of test case identifiers.
+const std::set< int64_t >&
+store::results_watermark::pending_test_case_ids(void) const
+{
+    return _pending_test_case_ids;
+}
+
+
+/// Constructs a filter that matches all results.
+store::results_filter::results_filter(void) :
+    _with_files(true),
+    _slice_offset(0),
+    _slice_limit(0)
+{
+}
+
+
+/// Restricts the results to those of a particular type.
+///
+/// Calling this more than once makes the filter match results of any of the
+/// given types.
+///
+/// \param type The type of the results to return.
+///
+/// \return A reference to this filter, to allow chaining calls.
+store::results_filter&
+store::results_filter::add_result_type(const model::test_result_type type)
+{
+    _result_types.insert(type);
+    return *this;
+}
+
+
+/// Restricts the results to those of a test program or directory.
+///
+/// Calling this more than once makes the filter match results of any of the
+/// given test programs.
+///
+/// \param test_program The relative path to a test program or to a directory
+///     containing test programs.
+///
+/// \return A reference to this filter, to allow chaining calls.
+store::results_filter&
+store::results_filter::add_test_program(const fs::path& test_program)
+{
+    _test_programs.insert(test_program);
+    return *this;
+}
+
+
+/// Skips loading the references to the stdout and stderr of test cases.
+///
+/// Iterators constructed with this filter cannot query them.
+///
+/// \return A reference to this filter, to allow chaining calls.
+store::results_filter&
+store::results_filter::without_files(void)
+{
+    _with_files = false;
+    return *this;
+}
+
+
+/// Restricts the results to those stored after a watermark.
+///
+/// \param watermark The position after which to return results, as returned
+///     by read_transaction::get_watermark().
+///
+/// \return A reference to this filter, to allow chaining calls.
+store::results_filter&
+store::results_filter::after(const results_watermark& watermark)
+{
+    _watermark = watermark;
+    return *this;
 }
 
 
-/// Gets all the test cases within a particular test program.
+/// Restricts the results to a contiguous range of those that match.
 ///
-/// \param db The database to query the information from.
-/// \param test_program_id The identifier of the test program whose test cases
-///     to query.
+/// The range is taken from the results in the order in which iterators return
+/// them, which is stable across connections to the same database.  This allows
+/// splitting a scan of the results into independent parts.
 ///
-/// \return The collection of loaded test cases.
+/// \param offset The number of matching results to skip.
+/// \param limit The maximum number of results to return; zero for no limit.
 ///
-/// \throw integrity_error If there is any problem in the loaded data.
-static model::test_cases_map
-get_test_cases(sqlite::database& db, const int64_t test_program_id)
+/// \return A reference to this filter, to allow chaining calls.
+store::results_filter&
+store::results_filter::slice(const std::size_t offset, const std::size_t limit)
 {
-    model::test_cases_map_builder test_cases;
-
-    sqlite::statement stmt = db.create_statement(
-        "SELECT name, metadata_id "
-        "FROM test_cases WHERE test_program_id == :test_program_id");
-    stmt.bind(":test_program_id", test_program_id);
-    while (stmt.step()) {
-        const std::string name = stmt.safe_column_text("name");
-        const int64_t metadata_id = stmt.safe_column_int64("metadata_id");
+    _slice_offset = offset;
+    _slice_limit = limit;
+    return *this;
+}
 
-        const model::metadata metadata = get_metadata(db, metadata_id);
-        LD(F("Loaded test case '%s'") % name);
-        test_cases.add(name, metadata);
-    }
 
-    return test_cases.build();
+/// Gets the types of the results to return.
+///
+/// \return A set of result types; if empty, all results are returned.
+const std::set< model::test_result_type >&
+store::results_filter::result_types(void) const
+{
+    return _result_types;
 }
 
 
-/// Retrieves a result from the database.
-///
-/// \param stmt The statement with the data for the result to load.
-/// \param type_column The name of the column containing the type of the result.
-/// \param reason_column The name of the column containing the reason for the
-///     result, if any.
-///
-/// \return The loaded result.
+/// Gets the test programs or directories to return results for.
 ///
-/// \throw integrity_error If the data in the database is invalid.
-static model::test_result
-parse_result(sqlite::statement& stmt, const char* type_column,
-             const char* reason_column)
+/// \return A set of relative paths; if empty, all results are returned.
+const std::set< fs::path >&
+store::results_filter::test_programs(void) const
 {
-    try {
-        const model::test_result_type type =
-            store::column_test_result_type(stmt, type_column);
-        if (type == model::test_result_passed) {
-            if (stmt.column_type(stmt.column_id(reason_column)) !=
-                sqlite::type_null)
-                throw store::integrity_error("Result of type 'passed' has a "
-                                             "non-NULL reason");
-            return model::test_result(type);
-        } else {
-            return model::test_result(type,
-                                      stmt.safe_column_text(reason_column));
-        }
-    } catch (const sqlite::error& e) {
-        throw store::integrity_error(e.what());
-    }
+    return _test_programs;
 }
 
 
-}  // anonymous namespace
+/// Checks whether the stdout and stderr of the test cases have to be loaded.
+///
+/// \return True if the files are loaded; false otherwise.
+bool
+store::results_filter::with_files(void) const
+{
+    return _with_files;
+}
 
 
-/// Loads a specific test program from the database.
+/// Gets the position after which to return results.
 ///
-/// \param backend_ The store backend we are dealing with.
-/// \param id The identifier of the test program to load.
-///
-/// \return The instantiated test program.
+/// \return A watermark; the default one if the results are not restricted.
+const store::results_watermark&
+store::results_filter::watermark(void) const
+{
+    return _watermark;
+}
+
+
+/// Gets the number of matching results to skip.
 ///
-/// \throw integrity_error If the data read from the database cannot be properly
-///     interpreted.
-model::test_program_ptr
-store::detail::get_test_program(read_backend& backend_, const int64_t id)
+/// \return A count of results; zero if none are skipped.
+std::size_t
+store::results_filter::slice_offset(void) const
 {
-    sqlite::database& db = backend_.database();
+    return _slice_offset;
+}
 
-    model::test_program_ptr test_program;
-    sqlite::statement stmt = db.create_statement(
-        "SELECT * FROM test_programs WHERE test_program_id == :id");
-    stmt.bind(":id", id);
-    stmt.step();
-    const std::string interface = stmt.safe_column_text("interface");
-    test_program.reset(new model::test_program(
-        interface,
-        fs::path(stmt.safe_column_text("relative_path")),
-        fs::path(stmt.safe_column_text("root")),
-        stmt.safe_column_text("test_suite_name"),
-        get_metadata(db, stmt.safe_column_int64("metadata_id")),
-        get_test_cases(db, id)));
-    const bool more = stmt.step();
-    INV(!more);
 
-    LD(F("Loaded test program '%s'") % test_program->relative_path());
-    return test_program;
+/// Gets the maximum number of results to return.
+///
+/// \return A count of results; zero if there is no limit.
+std::size_t
+store::results_filter::slice_limit(void) const
+{
+    return _slice_limit;
 }
 
 
 /// Internal implementation for a results iterator.
+/// Constructor for an empty summary.
+store::results_summary::results_summary(void)
+{
+}
+
+
 struct store::results_iterator::impl : utils::noncopyable {
     /// The store backend we are dealing with.
     store::read_backend _backend;
@@ -258,29 +1275,29 @@ struct store::results_iterator::impl : utils::noncopyable {
     /// The statement to iterate on.
     sqlite::statement _stmt;
 
-    /// A cache for the last loaded test program.
-    optional< std::pair< int64_t, model::test_program_ptr > >
-        _last_test_program;
+    /// All the test programs in the database, keyed by their identifier.
+    test_programs_map _test_programs;
+
+    /// Whether the stdout and stderr of the test cases can be queried.
+    bool _with_files;
 
     /// Whether the iterator is still valid or not.
     bool _valid;
 
     /// Constructor.
-    impl(store::read_backend& backend_) :
+    ///
+    /// All matching test programs are loaded upfront so that the iteration does
+    /// not need to issue any queries other than to fetch the contents of files.
+    ///
+    /// \param backend_ The store backend we are dealing with.
+    /// \param filter The filter describing the results to iterate over.
+    impl(store::read_backend& backend_, const store::results_filter& filter) :
         _backend(backend_),
-        _stmt(backend_.database().create_statement(
-            "SELECT test_programs.test_program_id, "
-            "    test_programs.interface, "
-            "    test_cases.test_case_id, test_cases.name, "
-            "    test_results.result_type, test_results.result_reason, "
-            "    test_results.start_time, test_results.end_time "
-            "FROM test_programs "
-            "    JOIN test_cases "
-            "    ON test_programs.test_program_id = test_cases.test_program_id "
-            "    JOIN test_results "
-            "    ON test_cases.test_case_id = test_results.test_case_id "
-            "ORDER BY test_programs.absolute_path, test_cases.name"))
+        _stmt(create_results_statement(backend_.database(), filter)),
+        _test_programs(load_all_test_programs(backend_.database(), filter)),
+        _with_files(filter.with_files())
     {
+        bind_results_query(_stmt, filter);
         _valid = _stmt.step();
     }
 };
@@ -328,15 +1345,13 @@ store::results_iterator::operator bool(void) const
 const model::test_program_ptr
 store::results_iterator::test_program(void) const
 {
-    const int64_t id = _pimpl->_stmt.safe_column_int64("test_program_id");
-    if (!_pimpl->_last_test_program ||
-        _pimpl->_last_test_program.get().first != id)
-    {
-        const model::test_program_ptr tp = detail::get_test_program(
-            _pimpl->_backend, id);
-        _pimpl->_last_test_program = std::make_pair(id, tp);
-    }
-    return _pimpl->_last_test_program.get().second;
+    const int64_t id = _pimpl->_stmt.safe_column(results_test_program_id);
+    const test_programs_map::const_iterator iter =
+        _pimpl->_test_programs.find(id);
+    // The iterator's query joins on test_programs, and we loaded all of those
+    // that match the same filter, so this cannot fail.
+    INV(iter != _pimpl->_test_programs.end());
+    return (*iter).second;
 }
 
 
@@ -349,7 +1364,7 @@ store::results_iterator::test_program(void) const
 std::string
 store::results_iterator::test_case_name(void) const
 {
-    return _pimpl->_stmt.safe_column_text("name");
+    return _pimpl->_stmt.safe_column(results_name);
 }
 
 
@@ -359,7 +1374,8 @@ store::results_iterator::test_case_name(void) const
 model::test_result
 store::results_iterator::result(void) const
 {
-    return parse_result(_pimpl->_stmt, "result_type", "result_reason");
+    return parse_result(_pimpl->_stmt, results_result_type,
+                        results_result_reason);
 }
 
 
@@ -369,7 +1385,7 @@ store::results_iterator::result(void) const
 datetime::timestamp
 store::results_iterator::start_time(void) const
 {
-    return column_timestamp(_pimpl->_stmt, "start_time");
+    return column_timestamp(_pimpl->_stmt, results_start_time);
 }
 
 
@@ -379,33 +1395,55 @@ store::results_iterator::start_time(void) const
 datetime::timestamp
 store::results_iterator::end_time(void) const
 {
-    return column_timestamp(_pimpl->_stmt, "end_time");
+    return column_timestamp(_pimpl->_stmt, results_end_time);
+}
+
+
+/// Gets the number of the attempt that yielded the result of the test case.
+///
+/// \return The attempt number, which is greater than 1 if the test case was
+/// retried after failing.
+int
+store::results_iterator::attempt(void) const
+{
+    return _pimpl->_stmt.safe_column(results_attempt);
+}
+
+
+/// Gets the cache key recorded for the test case.
+///
+/// \return The cache key, or none if the test case was run without result
+/// caching.
+optional< std::string >
+store::results_iterator::cache_key(void) const
+{
+    sqlite::statement& stmt = _pimpl->_stmt;
+    if (stmt.column_type(results_cache_key.index) == sqlite::type_null)
+        return none;
+    else
+        return utils::make_optional(stmt.safe_column(results_cache_key));
 }
 
 
 /// Gets a file from a test case.
 ///
 /// \param db The database to query the file from.
-/// \param test_case_id The identifier of the test case.
-/// \param filename The name of the file to be retrieved.
+/// \param stmt The statement of the iterator, positioned at the test case.
+/// \param column The column holding the file identifier.
 ///
-/// \return A textual representation of the file contents.
+/// \return A textual representation of the file contents, or an empty string
+/// if the test case did not record such a file.
 ///
 /// \throw integrity_error If there is any problem in the loaded data or if the
 ///     file cannot be found.
 static std::string
-get_test_case_file(sqlite::database& db, const int64_t test_case_id,
-                   const char* filename)
+get_test_case_file(sqlite::database& db, sqlite::statement& stmt,
+                   const sqlite::column< int64_t >& column)
 {
-    sqlite::statement stmt = db.create_statement(
-        "SELECT file_id FROM test_case_files "
-        "WHERE test_case_id == :test_case_id AND file_name == :file_name");
-    stmt.bind(":test_case_id", test_case_id);
-    stmt.bind(":file_name", filename);
-    if (stmt.step())
-        return get_file(db, stmt.safe_column_int64("file_id"));
-    else
+    if (stmt.column_type(column.index) == sqlite::type_null)
         return "";
+    else
+        return get_file(db, stmt.safe_column(column));
 }
 
 
@@ -413,12 +1451,14 @@ get_test_case_file(sqlite::database& db, const int64_t test_case_id,
 ///
 /// \return A textual representation of the stdout contents of the test case.
 /// This may of course be empty if the test case didn't print anything.
+///
+/// \pre The iterator must have been created with a filter that loads files.
 std::string
 store::results_iterator::stdout_contents(void) const
 {
-    return get_test_case_file(_pimpl->_backend.database(),
-                              _pimpl->_stmt.safe_column_int64("test_case_id"),
-                              "__STDOUT__");
+    PRE_MSG(_pimpl->_with_files, "Files were not requested in the filter");
+    return get_test_case_file(_pimpl->_backend.database(), _pimpl->_stmt,
+                              results_stdout_file_id);
 }
 
 
@@ -426,12 +1466,186 @@ store::results_iterator::stdout_contents(void) const
 ///
 /// \return A textual representation of the stderr contents of the test case.
 /// This may of course be empty if the test case didn't print anything.
+///
+/// \pre The iterator must have been created with a filter that loads files.
 std::string
 store::results_iterator::stderr_contents(void) const
 {
-    return get_test_case_file(_pimpl->_backend.database(),
-                              _pimpl->_stmt.safe_column_int64("test_case_id"),
-                              "__STDERR__");
+    PRE_MSG(_pimpl->_with_files, "Files were not requested in the filter");
+    return get_test_case_file(_pimpl->_backend.database(), _pimpl->_stmt,
+                              results_stderr_file_id);
+}
+
+
+/// Reads a file from a test case in chunks.
+///
+/// \param db The database to query the file from.
+/// \param stmt The statement of the iterator, positioned at the test case.
+/// \param column The column holding the file identifier.
+/// \param hooks The callbacks to feed the contents of the file to.  Nothing is
+///     fed if the test case did not record such a file.
+///
+/// \throw integrity_error If there is any problem in the loaded data or if the
+///     file cannot be found.
+static void
+read_test_case_file(sqlite::database& db, sqlite::statement& stmt,
+                    const sqlite::column< int64_t >& column,
+                    store::file_hooks& hooks)
+{
+    if (stmt.column_type(column.index) != sqlite::type_null)
+        read_file(db, stmt.safe_column(column), hooks);
+}
+
+
+/// Reads the contents of stdout of a test case in chunks.
+///
+/// Contrary to stdout_contents(), this never holds the whole file in memory.
+///
+/// \param hooks The callbacks to feed the contents of the file to.
+///
+/// \pre The iterator must have been created with a filter that loads files.
+void
+store::results_iterator::read_stdout(file_hooks& hooks) const
+{
+    PRE_MSG(_pimpl->_with_files, "Files were not requested in the filter");
+    read_test_case_file(_pimpl->_backend.database(), _pimpl->_stmt,
+                        results_stdout_file_id, hooks);
+}
+
+
+/// Reads the contents of stderr of a test case in chunks.
+///
+/// Contrary to stderr_contents(), this never holds the whole file in memory.
+///
+/// \param hooks The callbacks to feed the contents of the file to.
+///
+/// \pre The iterator must have been created with a filter that loads files.
+void
+store::results_iterator::read_stderr(file_hooks& hooks) const
+{
+    PRE_MSG(_pimpl->_with_files, "Files were not requested in the filter");
+    read_test_case_file(_pimpl->_backend.database(), _pimpl->_stmt,
+                        results_stderr_file_id, hooks);
+}
+
+
+/// Gets the size of a file from a test case.
+///
+/// \param db The database to query the file from.
+/// \param stmt The statement of the iterator, positioned at the test case.
+/// \param column The column holding the file identifier.
+///
+/// \return The length of the file in bytes, or 0 if the test case did not
+/// record such a file.
+///
+/// \throw integrity_error If there is any problem in the loaded data or if the
+///     file cannot be found.
+static std::size_t
+get_test_case_file_size(sqlite::database& db, sqlite::statement& stmt,
+                        const sqlite::column< int64_t >& column)
+{
+    if (stmt.column_type(column.index) == sqlite::type_null)
+        return 0;
+    else
+        return get_file_size(db, stmt.safe_column(column));
+}
+
+
+/// Reads a range of a file from a test case.
+///
+/// \param db The database to query the file from.
+/// \param stmt The statement of the iterator, positioned at the test case.
+/// \param column The column holding the file identifier.
+/// \param offset The position of the first byte to read.
+/// \param length The maximum number of bytes to read.
+///
+/// \return The contents of the range, or an empty string if the test case did
+/// not record such a file.
+///
+/// \throw integrity_error If there is any problem in the loaded data or if the
+///     file cannot be found.
+static std::string
+read_test_case_file_range(sqlite::database& db, sqlite::statement& stmt,
+                          const sqlite::column< int64_t >& column,
+                          const std::size_t offset, const std::size_t length)
+{
+    if (stmt.column_type(column.index) == sqlite::type_null)
+        return "";
+    else
+        return read_file_range(db, stmt.safe_column(column), offset,
+                               length);
+}
+
+
+/// Gets the length of the stdout of a test case.
+///
+/// This does not need to read the contents of the file.
+///
+/// \return The length of the stdout contents in bytes.
+///
+/// \pre The iterator must have been created with a filter that loads files.
+std::size_t
+store::results_iterator::stdout_size(void) const
+{
+    PRE_MSG(_pimpl->_with_files, "Files were not requested in the filter");
+    return get_test_case_file_size(_pimpl->_backend.database(), _pimpl->_stmt,
+                                   results_stdout_file_id);
+}
+
+
+/// Gets the length of the stderr of a test case.
+///
+/// This does not need to read the contents of the file.
+///
+/// \return The length of the stderr contents in bytes.
+///
+/// \pre The iterator must have been created with a filter that loads files.
+std::size_t
+store::results_iterator::stderr_size(void) const
+{
+    PRE_MSG(_pimpl->_with_files, "Files were not requested in the filter");
+    return get_test_case_file_size(_pimpl->_backend.database(), _pimpl->_stmt,
+                                   results_stderr_file_id);
+}
+
+
+/// Reads a range of the stdout of a test case.
+///
+/// \param offset The position of the first byte to read.
+/// \param length The maximum number of bytes to read.
+///
+/// \return The contents of the range, which is shorter than length if the
+/// output ends before.
+///
+/// \pre The iterator must have been created with a filter that loads files.
+std::string
+store::results_iterator::stdout_read(const std::size_t offset,
+                                     const std::size_t length) const
+{
+    PRE_MSG(_pimpl->_with_files, "Files were not requested in the filter");
+    return read_test_case_file_range(_pimpl->_backend.database(),
+                                     _pimpl->_stmt, results_stdout_file_id,
+                                     offset, length);
+}
+
+
+/// Reads a range of the stderr of a test case.
+///
+/// \param offset The position of the first byte to read.
+/// \param length The maximum number of bytes to read.
+///
+/// \return The contents of the range, which is shorter than length if the
+/// output ends before.
+///
+/// \pre The iterator must have been created with a filter that loads files.
+std::string
+store::results_iterator::stderr_read(const std::size_t offset,
+                                     const std::size_t length) const
+{
+    PRE_MSG(_pimpl->_with_files, "Files were not requested in the filter");
+    return read_test_case_file_range(_pimpl->_backend.database(),
+                                     _pimpl->_stmt, results_stderr_file_id,
+                                     offset, length);
 }
 
 
@@ -493,11 +1707,16 @@ store::read_transaction::finish(void)
 
 /// Retrieves an context from the database.
 ///
-/// \return The retrieved context.
+/// \param with_env Whether to load the environment variables of the context.
+///     They can be plentiful and large, so callers that do not look at them
+///     should skip them.
+///
+/// \return The retrieved context.  Its environment is empty if with_env is
+/// false.
 ///
 /// \throw error If there is a problem loading the context.
 model::context
-store::read_transaction::get_context(void)
+store::read_transaction::get_context(const bool with_env)
 {
     try {
         sqlite::statement stmt = _pimpl->_db.create_statement(
@@ -505,25 +1724,197 @@ store::read_transaction::get_context(void)
         if (!stmt.step())
             throw error("Error loading context: no data");
 
-        return model::context(fs::path(stmt.safe_column_text("cwd")),
-                              get_env_vars(_pimpl->_db));
+        const fs::path cwd(stmt.safe_column_text("cwd"));
+        if (with_env)
+            return model::context(cwd, get_env_vars(_pimpl->_db));
+        else
+            return model::context(cwd, std::map< std::string, std::string >());
     } catch (const sqlite::error& e) {
         throw error(F("Error loading context: %s") % e.what());
     }
 }
 
 
-/// Creates a new iterator to scan tests results.
+/// Creates a new iterator to scan all tests results.
 ///
 /// \return The constructed iterator.
 ///
 /// \throw error If there is any problem constructing the iterator.
 store::results_iterator
 store::read_transaction::get_results(void)
+{
+    return get_results(results_filter());
+}
+
+
+/// Creates a new iterator to scan the tests results that match a filter.
+///
+/// \param filter The filter describing the results to return.
+///
+/// \return The constructed iterator.
+///
+/// \throw error If there is any problem constructing the iterator.
+store::results_iterator
+store::read_transaction::get_results(const results_filter& filter)
 {
     try {
         return results_iterator(std::shared_ptr< results_iterator::impl >(
-           new results_iterator::impl(_pimpl->_backend)));
+           new results_iterator::impl(_pimpl->_backend, filter)));
+    } catch (const sqlite::error& e) {
+        throw error(e.what());
+    }
+}
+
+
+/// Loads the aggregates of all the results in the database.
+///
+/// The aggregates are maintained by the write transactions as results are
+/// stored, so this does not need to go over the results themselves.
+///
+/// \return The summary of the results.
+///
+/// \throw error If there is any problem talking to the database.
+/// \throw integrity_error If the stored aggregates are invalid.
+store::results_summary
+store::read_transaction::get_summary(void)
+{
+    try {
+        results_summary summary;
+        int64_t total_duration = 0;
+        optional< int64_t > start_time, end_time;
+        sqlite::statement stmt = _pimpl->_db.create_statement(
+            "SELECT result_type, results_count, total_duration, "
+            "    min_start_time, max_end_time FROM result_summaries");
+        while (stmt.step()) {
+            const int64_t count = stmt.safe_column_int64("results_count");
+            if (count < 1)
+                throw integrity_error(F("Invalid results count %s in the "
+                                        "results summary") % count);
+            summary.counts[column_test_result_type(stmt, "result_type")] =
+                static_cast< std::size_t >(count);
+
+            int64_t duration;
+            column_deltas(stmt, 2, 1, &duration);
+            total_duration += duration;
+
+            int64_t times[2];
+            column_timestamps(stmt, 3, 2, times);
+            if (!start_time || times[0] < start_time.get())
+                start_time = times[0];
+            if (!end_time || end_time.get() < times[1])
+                end_time = times[1];
+        }
+
+        summary.total_duration = datetime::delta::from_microseconds(
+            total_duration);
+        if (start_time)
+            summary.start_time = datetime::timestamp::from_microseconds(
+                start_time.get());
+        if (end_time)
+            summary.end_time = datetime::timestamp::from_microseconds(
+                end_time.get());
+        return summary;
+    } catch (const sqlite::error& e) {
+        throw error(e.what());
+    }
+}
+
+
+/// Computes the current position in the results of the database.
+///
+/// Results returned by get_results() with a filter restricted to be after()
+/// the returned watermark are those that appear after this call.  Combining
+/// both calls in the same transaction thus allows following the results of a
+/// database that is being written to concurrently without ever returning the
+/// same result twice.
+///
+/// \param previous The watermark previously returned by this function, or the
+///     default watermark on the first call.  This is used to only examine the
+///     test cases that may have changed since then.
+///
+/// \return The new watermark.
+///
+/// \throw error If there is any problem talking to the database.
+store::results_watermark
+store::read_transaction::get_watermark(const results_watermark& previous)
+{
+    try {
+        int64_t last = previous.last_test_case_id();
+        {
+            sqlite::statement stmt = _pimpl->_db.create_statement(
+                "SELECT MAX(test_case_id) AS last FROM test_cases");
+            if (stmt.step() &&
+                stmt.column_type(0) != sqlite::type_null)
+                last = stmt.safe_column_int64("last");
+        }
+
+        std::set< int64_t > pending;
+        prepare_watermark(_pimpl->_db, previous);
+        sqlite::statement stmt = _pimpl->_db.create_statement(
+            "SELECT test_cases.test_case_id "
+            "FROM test_cases LEFT JOIN test_results "
+            "    ON test_cases.test_case_id = test_results.test_case_id "
+            "WHERE " + watermark_condition(previous) + " "
+            "    AND test_cases.test_case_id <= :last "
+            "    AND test_results.test_case_id IS NULL");
+        bind_watermark_condition(stmt, previous);
+        stmt.bind(":last", last);
+        while (stmt.step())
+            pending.insert(stmt.safe_column_int64("test_case_id"));
+
+        return results_watermark(last, pending);
+    } catch (const sqlite::error& e) {
+        throw error(e.what());
+    }
+}
+
+
+/// Loads the timeline of the execution.
+///
+/// \return The recorded events, sorted by their start time.
+///
+/// \throw error If there is any problem talking to the database.
+std::vector< store::run_event >
+store::read_transaction::get_run_events(void)
+{
+    try {
+        std::vector< run_event > events;
+        sqlite::statement stmt = _pimpl->_db.create_statement(
+            "SELECT kind, name, pid, start_time, end_time FROM run_events "
+            "ORDER BY start_time, event_id");
+        while (stmt.step()) {
+            optional< int > pid;
+            if (stmt.column_type(stmt.column_id("pid")) != sqlite::type_null)
+                pid = stmt.safe_column_int("pid");
+            events.push_back(run_event(
+                stmt.safe_column_text("kind"), stmt.safe_column_text("name"),
+                pid, column_timestamp(stmt, "start_time"),
+                column_timestamp(stmt, "end_time")));
+        }
+        return events;
+    } catch (const sqlite::error& e) {
+        throw error(e.what());
+    }
+}
+
+
+/// Loads the use of the execution slots during the run.
+///
+/// \return The time that the slots spent in each activity, keyed by the name
+/// of the activity.  Empty if the run did not record it.
+///
+/// \throw error If there is any problem talking to the database.
+std::map< std::string, datetime::delta >
+store::read_transaction::get_slot_usage(void)
+{
+    try {
+        std::map< std::string, datetime::delta > usage;
+        sqlite::statement stmt = _pimpl->_db.create_statement(
+            "SELECT activity, slot_time FROM slot_usage");
+        while (stmt.step())
+            usage[stmt.safe_column_text("activity")] = column_delta(
+                stmt, "slot_time");
+        return usage;
     } catch (const sqlite::error& e) {
         throw error(e.what());
     }
@@ -38,14 +38,20 @@ extern "C" {
 #include <stdint.h>
 }
 
+#include <cstddef>
+#include <map>
+#include <set>
 #include <string>
+#include <vector>
 
 #include "model/context_fwd.hpp"
 #include "model/test_program_fwd.hpp"
 #include "model/test_result_fwd.hpp"
 #include "store/read_backend_fwd.hpp"
 #include "store/read_transaction_fwd.hpp"
-#include "utils/datetime_fwd.hpp"
+#include "utils/datetime.hpp"
+#include "utils/fs/path.hpp"
+#include "utils/optional.hpp"
 #include "utils/shared_ptr.hpp"
 
 namespace store {
@@ -60,6 +66,144 @@ model::test_program_ptr get_test_program(read_backend&, const int64_t);
 }  // namespace detail
 
 
+/// Interface to receive the contents of a stored file in chunks.
+///
+/// This allows processing files of arbitrary size with bounded memory.
+class file_hooks {
+public:
+    virtual ~file_hooks(void);
+
+    /// Processes a chunk of the file.
+    ///
+    /// \param data The contents of the chunk.
+    /// \param size The length of data in bytes; never zero.
+    ///
+    /// \return True to continue reading the file; false to stop.
+    virtual bool got_chunk(const char* data, const std::size_t size) = 0;
+};
+
+
+/// Position in the results of a database, to look for newer results only.
+///
+/// Results cannot be followed with a single increasing identifier because
+/// test cases are stored when they start and their results when they finish,
+/// possibly out of order when running tests in parallel.  A watermark thus
+/// records the last test case known at some point and the test cases that did
+/// not have a result yet back then.  A default-constructed watermark precedes
+/// all results.
+class results_watermark {
+    /// Identifier of the last test case known at this point.
+    int64_t _last_test_case_id;
+
+    /// Test cases up to _last_test_case_id that had no result at this point.
+    std::set< int64_t > _pending_test_case_ids;
+
+public:
+    results_watermark(void);
+    results_watermark(const int64_t, const std::set< int64_t >&);
+
+    int64_t last_test_case_id(void) const;
+    const std::set< int64_t >& pending_test_case_ids(void) const;
+};
+
+
+/// Restrictions on the test case results to be returned by get_results().
+///
+/// The conditions described by this class are pushed down to the database so
+/// that results that are not of interest to the caller are never loaded.  A
+/// default-constructed filter matches all results and fetches all their data.
+class results_filter {
+    /// Types of the results to return; if empty, return all of them.
+    std::set< model::test_result_type > _result_types;
+
+    /// Test programs or directories to return results for; if empty, return
+    /// results for all test programs.
+    std::set< utils::fs::path > _test_programs;
+
+    /// Whether the stdout and stderr of the test cases have to be available.
+    bool _with_files;
+
+    /// Position after which to return results.
+    results_watermark _watermark;
+
+    /// Number of matching results to skip before returning any.
+    std::size_t _slice_offset;
+
+    /// Maximum number of results to return; zero for no limit.
+    std::size_t _slice_limit;
+
+public:
+    results_filter(void);
+
+    results_filter& add_result_type(const model::test_result_type);
+    results_filter& add_test_program(const utils::fs::path&);
+    results_filter& without_files(void);
+    results_filter& after(const results_watermark&);
+    results_filter& slice(const std::size_t, const std::size_t);
+
+    const std::set< model::test_result_type >& result_types(void) const;
+    const std::set< utils::fs::path >& test_programs(void) const;
+    bool with_files(void) const;
+    const results_watermark& watermark(void) const;
+    std::size_t slice_offset(void) const;
+    std::size_t slice_limit(void) const;
+};
+
+
+/// Event of the timeline of an execution, as recorded in the database.
+class run_event {
+public:
+    /// Type of the operation, such as "test" or "list".
+    std::string kind;
+
+    /// Subject of the operation, such as the name of the test case.
+    std::string name;
+
+    /// Subprocess that carried out the operation, if any.
+    utils::optional< int > pid;
+
+    /// Time at which the operation started.
+    utils::datetime::timestamp start_time;
+
+    /// Time at which the operation finished.
+    utils::datetime::timestamp end_time;
+
+    /// Initializer for the tuple's fields.
+    ///
+    /// \param kind_ Type of the operation.
+    /// \param name_ Subject of the operation.
+    /// \param pid_ Subprocess that carried out the operation, if any.
+    /// \param start_time_ Time at which the operation started.
+    /// \param end_time_ Time at which the operation finished.
+    run_event(const std::string& kind_, const std::string& name_,
+              const utils::optional< int >& pid_,
+              const utils::datetime::timestamp& start_time_,
+              const utils::datetime::timestamp& end_time_) :
+        kind(kind_), name(name_), pid(pid_), start_time(start_time_),
+        end_time(end_time_)
+    {
+    }
+};
+
+
+/// Aggregated results of a run.
+struct results_summary {
+    /// Number of results of every type; types without results are missing.
+    std::map< model::test_result_type, std::size_t > counts;
+
+    /// Sum of the durations of all test cases.
+    utils::datetime::delta total_duration;
+
+    /// Start time of the earliest test case; none if there are no results.
+    utils::optional< utils::datetime::timestamp > start_time;
+
+    /// End time of the latest test case; none if there are no results.
+    utils::optional< utils::datetime::timestamp > end_time;
+
+    results_summary(void);
+};
+
+
 /// Iterator for the set of test case results that are part of an action.
 ///
 /// \todo Note that this is not a "standard" C++ iterator.  I have chosen to
@@ -86,9 +230,17 @@ public:
     model::test_result result(void) const;
     utils::datetime::timestamp start_time(void) const;
     utils::datetime::timestamp end_time(void) const;
+    int attempt(void) const;
+    utils::optional< std::string > cache_key(void) const;
 
     std::string stdout_contents(void) const;
     std::string stderr_contents(void) const;
+    void read_stdout(file_hooks&) const;
+    void read_stderr(file_hooks&) const;
+    std::size_t stdout_size(void) const;
+    std::size_t stderr_size(void) const;
+    std::string stdout_read(const std::size_t, const std::size_t) const;
+    std::string stderr_read(const std::size_t, const std::size_t) const;
 };
 
 
@@ -110,8 +262,13 @@ public:
 
     void finish(void);
 
-    model::context get_context(void);
+    model::context get_context(const bool = true);
     results_iterator get_results(void);
+    results_iterator get_results(const results_filter&);
+    results_summary get_summary(void);
+    results_watermark get_watermark(const results_watermark&);
+    std::vector< run_event > get_run_events(void);
+    std::map< std::string, utils::datetime::delta > get_slot_usage(void);
 };
 
 
@@ -35,8 +35,13 @@
 namespace store {
 
 
+class file_hooks;
 class read_transaction;
+class results_filter;
 class results_iterator;
+struct results_summary;
+class results_watermark;
+class run_event;
 
 
 }  // namespace store
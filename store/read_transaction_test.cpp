@@ -28,8 +28,10 @@
 
 #include "store/read_transaction.hpp"
 
+#include <cstddef>
 #include <map>
 #include <string>
+#include <vector>
 
 #include <atf-c++.hpp>
 
@@ -42,6 +44,7 @@
 #include "store/write_backend.hpp"
 #include "store/write_transaction.hpp"
 #include "utils/datetime.hpp"
+#include "utils/format/macros.hpp"
 #include "utils/fs/path.hpp"
 #include "utils/logging/operations.hpp"
 #include "utils/optional.ipp"
@@ -150,6 +153,40 @@ ATF_TEST_CASE_BODY(get_context__invalid_env_vars)
 }
 
 
+ATF_TEST_CASE(get_context__without_env);
+ATF_TEST_CASE_HEAD(get_context__without_env)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(get_context__without_env)
+{
+    {
+        store::write_backend backend = store::write_backend::open_rw(
+            fs::path("test.db"));
+        backend.database().exec("INSERT INTO contexts (cwd) "
+                                "VALUES ('/foo/bar')");
+        const char buffer[10] = "foo bar";
+
+        // An invalid variable detects whether the variables are loaded at all.
+        sqlite::statement stmt = backend.database().create_statement(
+            "INSERT INTO env_vars (var_name, var_value) "
+            "VALUES ('abc', :var_value)");
+        stmt.bind(":var_value", sqlite::blob(buffer, sizeof(buffer)));
+        stmt.step_without_results();
+    }
+
+    store::read_backend backend = store::read_backend::open_ro(
+        fs::path("test.db"));
+    store::read_transaction tx = backend.start_read();
+    const model::context context = tx.get_context(false);
+    ATF_REQUIRE_EQ(fs::path("/foo/bar"), context.cwd());
+    ATF_REQUIRE(context.env().empty());
+    ATF_REQUIRE_THROW_RE(store::error, "context: .*var_value.*not a string",
+                         tx.get_context(true));
+}
+
+
 ATF_TEST_CASE(get_results__none);
 ATF_TEST_CASE_HEAD(get_results__none)
 {
@@ -251,12 +288,1048 @@ ATF_TEST_CASE_BODY(get_results__many)
 }
 
 
-ATF_INIT_TEST_CASES(tcs)
+ATF_TEST_CASE(get_results__cache_key);
+ATF_TEST_CASE_HEAD(get_results__cache_key)
 {
-    ATF_ADD_TEST_CASE(tcs, get_context__missing);
-    ATF_ADD_TEST_CASE(tcs, get_context__invalid_cwd);
-    ATF_ADD_TEST_CASE(tcs, get_context__invalid_env_vars);
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(get_results__cache_key)
+{
+    store::write_backend backend = store::write_backend::open_rw(
+        fs::path("test.db"));
 
-    ATF_ADD_TEST_CASE(tcs, get_results__none);
-    ATF_ADD_TEST_CASE(tcs, get_results__many);
+    store::write_transaction tx = backend.start_write();
+
+    const model::context context(fs::path("/foo/bar"),
+                                 std::map< std::string, std::string >());
+    tx.put_context(context);
+
+    const datetime::timestamp start_time = datetime::timestamp::from_values(
+        2012, 01, 30, 22, 10, 00, 0);
+    const datetime::timestamp end_time = datetime::timestamp::from_values(
+        2012, 01, 30, 22, 15, 30, 1234);
+
+    const model::test_program test_program = model::test_program_builder(
+        "plain", fs::path("a/prog1"), fs::path("/the/root"), "suite1")
+        .add_test_case("with_key")
+        .add_test_case("without_key")
+        .build();
+    const model::test_result result(model::test_result_passed);
+    {
+        const int64_t tp_id = tx.put_test_program(test_program);
+        const int64_t tc_id1 = tx.put_test_case(test_program, "with_key",
+                                                tp_id);
+        tx.put_result(result, tc_id1, start_time, end_time);
+        tx.put_cache_key("the-key", tc_id1);
+        const int64_t tc_id2 = tx.put_test_case(test_program, "without_key",
+                                                tp_id);
+        tx.put_result(result, tc_id2, start_time, end_time);
+    }
+
+    tx.commit();
+    backend.close();
+
+    store::read_backend backend2 = store::read_backend::open_ro(
+        fs::path("test.db"));
+    store::read_transaction tx2 = backend2.start_read();
+    store::results_iterator iter = tx2.get_results(
+        store::results_filter().without_files());
+    ATF_REQUIRE(iter);
+    ATF_REQUIRE_EQ("with_key", iter.test_case_name());
+    ATF_REQUIRE_EQ("the-key", iter.cache_key().get());
+    ATF_REQUIRE(++iter);
+    ATF_REQUIRE_EQ("without_key", iter.test_case_name());
+    ATF_REQUIRE(!iter.cache_key());
+    ATF_REQUIRE(!++iter);
+}
+
+
+ATF_TEST_CASE(get_results__attempt);
+ATF_TEST_CASE_HEAD(get_results__attempt)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(get_results__attempt)
+{
+    store::write_backend backend = store::write_backend::open_rw(
+        fs::path("test.db"));
+
+    store::write_transaction tx = backend.start_write();
+
+    const model::context context(fs::path("/foo/bar"),
+                                 std::map< std::string, std::string >());
+    tx.put_context(context);
+
+    const datetime::timestamp start_time = datetime::timestamp::from_values(
+        2012, 01, 30, 22, 10, 00, 0);
+    const datetime::timestamp end_time = datetime::timestamp::from_values(
+        2012, 01, 30, 22, 15, 30, 1234);
+
+    const model::test_program test_program = model::test_program_builder(
+        "plain", fs::path("a/prog1"), fs::path("/the/root"), "suite1")
+        .add_test_case("first_try")
+        .add_test_case("retried")
+        .build();
+    const model::test_result result(model::test_result_passed);
+    {
+        const int64_t tp_id = tx.put_test_program(test_program);
+        const int64_t tc_id1 = tx.put_test_case(test_program, "first_try",
+                                                tp_id);
+        tx.put_result(result, tc_id1, start_time, end_time);
+        const int64_t tc_id2 = tx.put_test_case(test_program, "retried",
+                                                tp_id);
+        tx.put_retried_result(
+            model::test_result(model::test_result_failed, "Flaky"), tc_id2,
+            1, start_time, end_time);
+        tx.put_result(result, tc_id2, start_time, end_time, 2);
+    }
+
+    tx.commit();
+    backend.close();
+
+    store::read_backend backend2 = store::read_backend::open_ro(
+        fs::path("test.db"));
+    store::read_transaction tx2 = backend2.start_read();
+    store::results_iterator iter = tx2.get_results(
+        store::results_filter().without_files());
+    ATF_REQUIRE(iter);
+    ATF_REQUIRE_EQ("first_try", iter.test_case_name());
+    ATF_REQUIRE_EQ(1, iter.attempt());
+    ATF_REQUIRE(++iter);
+    ATF_REQUIRE_EQ("retried", iter.test_case_name());
+    ATF_REQUIRE_EQ(2, iter.attempt());
+    ATF_REQUIRE(result == iter.result());
+    ATF_REQUIRE(!++iter);
+}
+
+
+ATF_TEST_CASE(get_results__shared_test_program);
+ATF_TEST_CASE_HEAD(get_results__shared_test_program)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(get_results__shared_test_program)
+{
+    store::write_backend backend = store::write_backend::open_rw(
+        fs::path("test.db"));
+
+    store::write_transaction tx = backend.start_write();
+
+    const model::context context(fs::path("/foo/bar"),
+                                 std::map< std::string, std::string >());
+    tx.put_context(context);
+
+    const datetime::timestamp start_time = datetime::timestamp::from_values(
+        2012, 01, 30, 22, 10, 00, 0);
+    const datetime::timestamp end_time = datetime::timestamp::from_values(
+        2012, 01, 30, 22, 15, 30, 1234);
+
+    const model::metadata md = model::metadata_builder()
+        .add_custom("var1", "value1")
+        .build();
+    const model::test_program test_program = model::test_program_builder(
+        "plain", fs::path("a/prog1"), fs::path("/the/root"), "suite1")
+        .add_test_case("first")
+        .add_test_case("second", md)
+        .add_test_case("unused", md)
+        .build();
+    const model::test_result result(model::test_result_passed);
+    {
+        const int64_t tp_id = tx.put_test_program(test_program);
+        const int64_t tc1_id = tx.put_test_case(test_program, "first", tp_id);
+        const int64_t tc2_id = tx.put_test_case(test_program, "second", tp_id);
+        (void)tx.put_test_case(test_program, "unused", tp_id);
+        atf::utils::create_file("second.err", "stderr of second\n");
+        tx.put_test_case_file("__STDERR__", fs::path("second.err"), tc2_id);
+        tx.put_result(result, tc1_id, start_time, end_time);
+        tx.put_result(result, tc2_id, start_time, end_time);
+    }
+
+    tx.commit();
+    backend.close();
+
+    store::read_backend backend2 = store::read_backend::open_ro(
+        fs::path("test.db"));
+    store::read_transaction tx2 = backend2.start_read();
+    store::results_iterator iter = tx2.get_results();
+    ATF_REQUIRE(iter);
+    const model::test_program_ptr loaded_test_program = iter.test_program();
+    ATF_REQUIRE_EQ(test_program, *loaded_test_program);
+    ATF_REQUIRE_EQ("first", iter.test_case_name());
+    ATF_REQUIRE(iter.stdout_contents().empty());
+    ATF_REQUIRE(iter.stderr_contents().empty());
+    ATF_REQUIRE(++iter);
+    ATF_REQUIRE(loaded_test_program == iter.test_program());
+    ATF_REQUIRE_EQ("second", iter.test_case_name());
+    ATF_REQUIRE(iter.stdout_contents().empty());
+    ATF_REQUIRE_EQ("stderr of second\n", iter.stderr_contents());
+    ATF_REQUIRE(!++iter);
+}
+
+
+ATF_TEST_CASE(get_results__compressed_files);
+ATF_TEST_CASE_HEAD(get_results__compressed_files)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(get_results__compressed_files)
+{
+    store::write_backend backend = store::write_backend::open_rw(
+        fs::path("test.db"));
+
+    store::write_transaction tx = backend.start_write();
+    tx.set_compression_level(9);
+
+    const model::context context(fs::path("/foo/bar"),
+                                 std::map< std::string, std::string >());
+    tx.put_context(context);
+
+    const datetime::timestamp start_time = datetime::timestamp::from_values(
+        2012, 01, 30, 22, 10, 00, 0);
+    const datetime::timestamp end_time = datetime::timestamp::from_values(
+        2012, 01, 30, 22, 15, 30, 1234);
+
+    std::string long_output;
+    for (int i = 0; i < 10000; ++i)
+        long_output += "Repeated line of output\n";
+
+    const model::test_program test_program = model::test_program_builder(
+        "plain", fs::path("a/prog1"), fs::path("/the/root"), "suite1")
+        .add_test_case("main")
+        .build();
+    const model::test_result result(model::test_result_passed);
+    {
+        const int64_t tp_id = tx.put_test_program(test_program);
+        const int64_t tc_id = tx.put_test_case(test_program, "main", tp_id);
+        atf::utils::create_file("prog1.out", long_output);
+        atf::utils::create_file("prog1.err", "stderr of prog1\n");
+        tx.put_test_case_file("__STDOUT__", fs::path("prog1.out"), tc_id);
+        tx.put_test_case_file("__STDERR__", fs::path("prog1.err"), tc_id);
+        tx.put_result(result, tc_id, start_time, end_time);
+    }
+
+    tx.commit();
+    backend.close();
+
+    store::read_backend backend2 = store::read_backend::open_ro(
+        fs::path("test.db"));
+    store::read_transaction tx2 = backend2.start_read();
+    store::results_iterator iter = tx2.get_results();
+    ATF_REQUIRE(iter);
+    ATF_REQUIRE_EQ(long_output, iter.stdout_contents());
+    ATF_REQUIRE_EQ("stderr of prog1\n", iter.stderr_contents());
+    ATF_REQUIRE(!++iter);
+}
+
+
+ATF_TEST_CASE(get_results__unknown_codec);
+ATF_TEST_CASE_HEAD(get_results__unknown_codec)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(get_results__unknown_codec)
+{
+    store::write_backend backend = store::write_backend::open_rw(
+        fs::path("test.db"));
+
+    store::write_transaction tx = backend.start_write();
+    const model::context context(fs::path("/foo/bar"),
+                                 std::map< std::string, std::string >());
+    tx.put_context(context);
+
+    const model::test_program test_program = model::test_program_builder(
+        "plain", fs::path("a/prog1"), fs::path("/the/root"), "suite1")
+        .add_test_case("main")
+        .build();
+    {
+        const int64_t tp_id = tx.put_test_program(test_program);
+        const int64_t tc_id = tx.put_test_case(test_program, "main", tp_id);
+        atf::utils::create_file("prog1.out", "stdout of prog1\n");
+        tx.put_test_case_file("__STDOUT__", fs::path("prog1.out"), tc_id);
+        tx.put_result(model::test_result(model::test_result_passed), tc_id,
+                      datetime::timestamp::from_microseconds(1000),
+                      datetime::timestamp::from_microseconds(2000));
+    }
+    tx.commit();
+    backend.database().exec("UPDATE files SET codec = 'foo'");
+    backend.close();
+
+    store::read_backend backend2 = store::read_backend::open_ro(
+        fs::path("test.db"));
+    store::read_transaction tx2 = backend2.start_read();
+    store::results_iterator iter = tx2.get_results();
+    ATF_REQUIRE(iter);
+    ATF_REQUIRE_THROW_RE(store::integrity_error, "Unknown codec 'foo'",
+                         iter.stdout_contents());
+}
+
+
+namespace {
+
+
+/// File hooks that accumulate the contents they receive up to a limit.
+class limited_hooks : public store::file_hooks {
+    /// Number of bytes after which to stop reading.
+    const std::size_t _limit;
+
+public:
+    /// The received contents.
+    std::string contents;
+
+    /// Constructor.
+    ///
+    /// \param limit_ Number of bytes after which to stop reading.
+    limited_hooks(const std::size_t limit_) : _limit(limit_)
+    {
+    }
+
+    /// Records a chunk.
+    ///
+    /// \param data The contents of the chunk.
+    /// \param size The length of data in bytes.
+    ///
+    /// \return Whether to keep reading.
+    bool
+    got_chunk(const char* data, const std::size_t size)
+    {
+        contents.append(data, size);
+        return contents.length() < _limit;
+    }
+};
+
+
+/// Stores a single test case with a large stdout and a short stderr.
+///
+/// \param db_path The path to the database to create.
+/// \param compression_level The compression level for the files, or 0.
+/// \param stdout_contents The contents of the stdout of the test case.
+static void
+create_files_db(const fs::path& db_path, const int compression_level,
+                const std::string& stdout_contents)
+{
+    store::write_backend backend = store::write_backend::open_rw(db_path);
+    store::write_transaction tx = backend.start_write();
+    tx.set_compression_level(compression_level);
+    tx.put_context(model::context(fs::path("/foo/bar"),
+                                  std::map< std::string, std::string >()));
+
+    const model::test_program test_program = model::test_program_builder(
+        "plain", fs::path("a/prog1"), fs::path("/the/root"), "suite1")
+        .add_test_case("main")
+        .build();
+    const int64_t tp_id = tx.put_test_program(test_program);
+    const int64_t tc_id = tx.put_test_case(test_program, "main", tp_id);
+    atf::utils::create_file("prog1.out", stdout_contents);
+    tx.put_test_case_file("__STDOUT__", fs::path("prog1.out"), tc_id);
+    tx.put_result(model::test_result(model::test_result_passed), tc_id,
+                  datetime::timestamp::from_microseconds(1000),
+                  datetime::timestamp::from_microseconds(2000));
+
+    tx.commit();
+    backend.close();
+}
+
+
+/// Validates read_stdout() and read_stderr() on a database.
+///
+/// \param compression_level The compression level for the files, or 0.
+static void
+do_read_files_test(const int compression_level)
+{
+    std::string long_output;
+    for (int i = 0; i < 20000; ++i)
+        long_output += F("Line %s of output\n") % i;
+
+    create_files_db(fs::path("test.db"), compression_level, long_output);
+
+    store::read_backend backend = store::read_backend::open_ro(
+        fs::path("test.db"));
+    store::read_transaction tx = backend.start_read();
+    store::results_iterator iter = tx.get_results();
+    ATF_REQUIRE(iter);
+
+    limited_hooks all(long_output.length());
+    iter.read_stdout(all);
+    ATF_REQUIRE(long_output == all.contents);
+
+    limited_hooks some(10);
+    iter.read_stdout(some);
+    ATF_REQUIRE(some.contents.length() < long_output.length());
+    ATF_REQUIRE(long_output.substr(0, some.contents.length()) ==
+                some.contents);
+
+    limited_hooks none(10);
+    iter.read_stderr(none);
+    ATF_REQUIRE(none.contents.empty());
+}
+
+
+/// Validates the ranged accessors to the files of a test case.
+///
+/// \param compression_level The compression level for the files, or 0.
+/// \param forget_size Whether to clear the recorded size of the files, as
+///     happens with databases written by older versions.
+static void
+do_ranged_files_test(const int compression_level, const bool forget_size)
+{
+    std::string long_output;
+    for (int i = 0; i < 20000; ++i)
+        long_output += F("Line %s of output\n") % i;
+
+    create_files_db(fs::path("test.db"), compression_level, long_output);
+    if (forget_size) {
+        sqlite::database db = sqlite::database::open(fs::path("test.db"),
+                                                     sqlite::open_readwrite);
+        db.exec("UPDATE files SET size = NULL");
+        db.close();
+    }
+
+    store::read_backend backend = store::read_backend::open_ro(
+        fs::path("test.db"));
+    store::read_transaction tx = backend.start_read();
+    store::results_iterator iter = tx.get_results();
+    ATF_REQUIRE(iter);
+
+    ATF_REQUIRE_EQ(long_output.length(), iter.stdout_size());
+    ATF_REQUIRE_EQ(0, iter.stderr_size());
+
+    ATF_REQUIRE_EQ(long_output.substr(0, 20), iter.stdout_read(0, 20));
+    ATF_REQUIRE_EQ(long_output.substr(100000, 50),
+                   iter.stdout_read(100000, 50));
+    ATF_REQUIRE(long_output.substr(300000) ==
+                iter.stdout_read(300000, long_output.length()));
+    ATF_REQUIRE(long_output == iter.stdout_read(0, long_output.length() + 1));
+    ATF_REQUIRE(iter.stdout_read(10, 0).empty());
+    ATF_REQUIRE(iter.stdout_read(long_output.length(), 10).empty());
+    ATF_REQUIRE(iter.stdout_read(long_output.length() + 5, 10).empty());
+    ATF_REQUIRE(iter.stderr_read(0, 10).empty());
+}
+
+
+/// Creates a database with results for various test programs.
+///
+/// The test programs are a/prog1, a/b/prog2, a0/prog3 and ab/prog4, each with
+/// a single test case named "main".  a/prog1 and ab/prog4 have failed, and
+/// all other test programs have passed.  All test cases have a stdout file.
+///
+/// \param db_path The path to the database to create.
+static void
+create_filter_db(const fs::path& db_path)
+{
+    store::write_backend backend = store::write_backend::open_rw(db_path);
+    store::write_transaction tx = backend.start_write();
+
+    tx.put_context(model::context(fs::path("/foo/bar"),
+                                  std::map< std::string, std::string >()));
+
+    const datetime::timestamp start_time = datetime::timestamp::from_values(
+        2012, 01, 30, 22, 10, 00, 0);
+    const datetime::timestamp end_time = datetime::timestamp::from_values(
+        2012, 01, 30, 22, 15, 30, 1234);
+
+    const char* paths[] = { "a/prog1", "a/b/prog2", "a0/prog3", "ab/prog4",
+                            NULL };
+    for (const char** path = paths; *path != NULL; ++path) {
+        const model::test_program test_program = model::test_program_builder(
+            "plain", fs::path(*path), fs::path("/the/root"), "suite")
+            .add_test_case("main")
+            .build();
+        const int64_t tp_id = tx.put_test_program(test_program);
+        const int64_t tc_id = tx.put_test_case(test_program, "main", tp_id);
+        atf::utils::create_file("out.txt", F("stdout of %s\n") % *path);
+        tx.put_test_case_file("__STDOUT__", fs::path("out.txt"), tc_id);
+        const std::string name = fs::path(*path).leaf_name();
+        if (name == "prog1" || name == "prog4")
+            tx.put_result(model::test_result(model::test_result_failed, "Bad"),
+                          tc_id, start_time, end_time);
+        else
+            tx.put_result(model::test_result(model::test_result_passed),
+                          tc_id, start_time, end_time);
+    }
+
+    tx.commit();
+    backend.close();
+}
+
+
+/// Collects the relative paths of the test programs returned by an iterator.
+///
+/// \param iter The iterator to consume.
+///
+/// \return The paths, in iteration order, separated by spaces.
+static std::string
+collect_paths(store::results_iterator& iter)
+{
+    std::string paths;
+    for (; iter; ++iter) {
+        if (!paths.empty())
+            paths += " ";
+        paths += iter.test_program()->relative_path().str();
+    }
+    return paths;
+}
+
+
+}  // anonymous namespace
+
+
+ATF_TEST_CASE(get_results__read_files);
+ATF_TEST_CASE_HEAD(get_results__read_files)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(get_results__read_files)
+{
+    do_read_files_test(0);
+}
+
+
+ATF_TEST_CASE(get_results__read_files__compressed);
+ATF_TEST_CASE_HEAD(get_results__read_files__compressed)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(get_results__read_files__compressed)
+{
+    do_read_files_test(9);
+}
+
+
+ATF_TEST_CASE(get_results__ranged_files);
+ATF_TEST_CASE_HEAD(get_results__ranged_files)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(get_results__ranged_files)
+{
+    do_ranged_files_test(0, false);
+}
+
+
+ATF_TEST_CASE(get_results__ranged_files__compressed);
+ATF_TEST_CASE_HEAD(get_results__ranged_files__compressed)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(get_results__ranged_files__compressed)
+{
+    do_ranged_files_test(9, false);
+}
+
+
+ATF_TEST_CASE(get_results__ranged_files__without_size);
+ATF_TEST_CASE_HEAD(get_results__ranged_files__without_size)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(get_results__ranged_files__without_size)
+{
+    do_ranged_files_test(0, true);
+}
+
+
+ATF_TEST_CASE(get_results__ranged_files__compressed__without_size);
+ATF_TEST_CASE_HEAD(get_results__ranged_files__compressed__without_size)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(get_results__ranged_files__compressed__without_size)
+{
+    do_ranged_files_test(9, true);
+}
+
+
+ATF_TEST_CASE(get_results__filter__result_types);
+ATF_TEST_CASE_HEAD(get_results__filter__result_types)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(get_results__filter__result_types)
+{
+    create_filter_db(fs::path("test.db"));
+
+    store::read_backend backend = store::read_backend::open_ro(
+        fs::path("test.db"));
+    store::read_transaction tx = backend.start_read();
+
+    {
+        store::results_iterator iter = tx.get_results(
+            store::results_filter().add_result_type(
+                model::test_result_failed));
+        ATF_REQUIRE_EQ("a/prog1 ab/prog4", collect_paths(iter));
+    }
+    {
+        store::results_iterator iter = tx.get_results(
+            store::results_filter()
+            .add_result_type(model::test_result_failed)
+            .add_result_type(model::test_result_passed));
+        ATF_REQUIRE_EQ("a/b/prog2 a/prog1 a0/prog3 ab/prog4",
+                       collect_paths(iter));
+    }
+    {
+        store::results_iterator iter = tx.get_results(
+            store::results_filter().add_result_type(
+                model::test_result_skipped));
+        ATF_REQUIRE(!iter);
+    }
+}
+
+
+ATF_TEST_CASE(get_results__filter__test_programs);
+ATF_TEST_CASE_HEAD(get_results__filter__test_programs)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(get_results__filter__test_programs)
+{
+    create_filter_db(fs::path("test.db"));
+
+    store::read_backend backend = store::read_backend::open_ro(
+        fs::path("test.db"));
+    store::read_transaction tx = backend.start_read();
+
+    {
+        store::results_iterator iter = tx.get_results(
+            store::results_filter().add_test_program(fs::path("a")));
+        ATF_REQUIRE_EQ("a/b/prog2 a/prog1", collect_paths(iter));
+    }
+    {
+        store::results_iterator iter = tx.get_results(
+            store::results_filter()
+            .add_test_program(fs::path("a/prog1"))
+            .add_test_program(fs::path("a0")));
+        ATF_REQUIRE_EQ("a/prog1 a0/prog3", collect_paths(iter));
+    }
+    {
+        store::results_iterator iter = tx.get_results(
+            store::results_filter()
+            .add_test_program(fs::path("a"))
+            .add_result_type(model::test_result_failed));
+        ATF_REQUIRE(iter);
+        ATF_REQUIRE_EQ(fs::path("a/prog1"),
+                       iter.test_program()->relative_path());
+        ATF_REQUIRE_EQ("stdout of a/prog1\n", iter.stdout_contents());
+        ATF_REQUIRE(iter.stderr_contents().empty());
+        ATF_REQUIRE(!++iter);
+    }
+    {
+        store::results_iterator iter = tx.get_results(
+            store::results_filter().add_test_program(fs::path("a/prog")));
+        ATF_REQUIRE(!iter);
+    }
+}
+
+
+ATF_TEST_CASE(get_results__filter__without_files);
+ATF_TEST_CASE_HEAD(get_results__filter__without_files)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(get_results__filter__without_files)
+{
+    create_filter_db(fs::path("test.db"));
+
+    store::read_backend backend = store::read_backend::open_ro(
+        fs::path("test.db"));
+    store::read_transaction tx = backend.start_read();
+
+    store::results_iterator iter = tx.get_results(
+        store::results_filter().without_files());
+    ATF_REQUIRE(iter);
+    ATF_REQUIRE_EQ(fs::path("a/b/prog2"), iter.test_program()->relative_path());
+    ATF_REQUIRE_EQ("main", iter.test_case_name());
+    ATF_REQUIRE_EQ(model::test_result(model::test_result_passed),
+                   iter.result());
+    ++iter;
+    ATF_REQUIRE_EQ("a/prog1 a0/prog3 ab/prog4", collect_paths(iter));
+}
+
+
+ATF_TEST_CASE(get_results__filter__slice);
+ATF_TEST_CASE_HEAD(get_results__filter__slice)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(get_results__filter__slice)
+{
+    create_filter_db(fs::path("test.db"));
+
+    store::read_backend backend = store::read_backend::open_ro(
+        fs::path("test.db"));
+    store::read_transaction tx = backend.start_read();
+
+    {
+        store::results_iterator iter = tx.get_results(
+            store::results_filter().slice(0, 2));
+        ATF_REQUIRE_EQ("a/b/prog2 a/prog1", collect_paths(iter));
+    }
+    {
+        store::results_iterator iter = tx.get_results(
+            store::results_filter().slice(2, 0));
+        ATF_REQUIRE_EQ("a0/prog3 ab/prog4", collect_paths(iter));
+    }
+    {
+        store::results_iterator iter = tx.get_results(
+            store::results_filter()
+            .add_result_type(model::test_result_failed)
+            .slice(1, 1));
+        ATF_REQUIRE_EQ("ab/prog4", collect_paths(iter));
+    }
+    {
+        store::results_iterator iter = tx.get_results(
+            store::results_filter().slice(4, 10));
+        ATF_REQUIRE(!iter);
+    }
+}
+
+
+ATF_TEST_CASE(get_results__filter__after_watermark);
+ATF_TEST_CASE_HEAD(get_results__filter__after_watermark)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(get_results__filter__after_watermark)
+{
+    const datetime::timestamp start_time = datetime::timestamp::from_values(
+        2012, 01, 30, 22, 10, 00, 0);
+    const datetime::timestamp end_time = datetime::timestamp::from_values(
+        2012, 01, 30, 22, 15, 30, 1234);
+    const model::test_result result(model::test_result_passed);
+
+    const model::test_program prog1 = model::test_program_builder(
+        "plain", fs::path("prog1"), fs::path("/the/root"), "suite")
+        .add_test_case("first").add_test_case("second").build();
+    const model::test_program prog2 = model::test_program_builder(
+        "plain", fs::path("prog2"), fs::path("/the/root"), "suite")
+        .add_test_case("third").build();
+
+    store::write_backend backend = store::write_backend::open_rw(
+        fs::path("test.db"));
+    int64_t tc2_id;
+    {
+        store::write_transaction tx = backend.start_write();
+        tx.put_context(model::context(fs::path("/foo/bar"),
+                                      std::map< std::string, std::string >()));
+        const int64_t tp_id = tx.put_test_program(prog1);
+        const int64_t tc1_id = tx.put_test_case(prog1, "first", tp_id);
+        tc2_id = tx.put_test_case(prog1, "second", tp_id);
+        tx.put_result(result, tc1_id, start_time, end_time);
+        tx.commit();
+    }
+
+    store::read_backend read_backend = store::read_backend::open_ro(
+        fs::path("test.db"));
+
+    store::results_watermark watermark1;
+    {
+        store::read_transaction tx = read_backend.start_read();
+        store::results_iterator iter = tx.get_results(
+            store::results_filter().after(watermark1));
+        ATF_REQUIRE(iter);
+        ATF_REQUIRE_EQ("first", iter.test_case_name());
+        ATF_REQUIRE(!++iter);
+        watermark1 = tx.get_watermark(watermark1);
+        tx.finish();
+    }
+    ATF_REQUIRE_EQ(tc2_id, watermark1.last_test_case_id());
+    ATF_REQUIRE_EQ(1, watermark1.pending_test_case_ids().size());
+
+    {
+        store::read_transaction tx = read_backend.start_read();
+        store::results_iterator iter = tx.get_results(
+            store::results_filter().after(watermark1));
+        ATF_REQUIRE(!iter);
+        tx.finish();
+    }
+
+    {
+        store::write_transaction tx = backend.start_write();
+        const int64_t tp_id = tx.put_test_program(prog2);
+        const int64_t tc3_id = tx.put_test_case(prog2, "third", tp_id);
+        tx.put_result(result, tc3_id, start_time, end_time);
+        tx.put_result(result, tc2_id, start_time, end_time);
+        tx.commit();
+    }
+
+    store::results_watermark watermark2;
+    {
+        store::read_transaction tx = read_backend.start_read();
+        store::results_iterator iter = tx.get_results(
+            store::results_filter().after(watermark1));
+        ATF_REQUIRE(iter);
+        ATF_REQUIRE_EQ("second", iter.test_case_name());
+        ATF_REQUIRE(++iter);
+        ATF_REQUIRE_EQ("third", iter.test_case_name());
+        ATF_REQUIRE_EQ(prog2, *iter.test_program());
+        ATF_REQUIRE(!++iter);
+        watermark2 = tx.get_watermark(watermark1);
+        tx.finish();
+    }
+    ATF_REQUIRE(watermark2.pending_test_case_ids().empty());
+
+    {
+        store::read_transaction tx = read_backend.start_read();
+        store::results_iterator iter = tx.get_results(
+            store::results_filter().after(watermark2));
+        ATF_REQUIRE(!iter);
+        tx.finish();
+    }
+}
+
+
+ATF_TEST_CASE(get_results__filter__after_watermark__many_pending);
+ATF_TEST_CASE_HEAD(get_results__filter__after_watermark__many_pending)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(get_results__filter__after_watermark__many_pending)
+{
+    const datetime::timestamp start_time = datetime::timestamp::from_values(
+        2012, 01, 30, 22, 10, 00, 0);
+    const datetime::timestamp end_time = datetime::timestamp::from_values(
+        2012, 01, 30, 22, 15, 30, 1234);
+    const model::test_result result(model::test_result_passed);
+
+    // More pending test cases than parameters a SQLite statement can take.
+    const int count = 40000;
+    model::test_program_builder builder(
+        "plain", fs::path("prog"), fs::path("/the/root"), "suite");
+    for (int i = 0; i < count; ++i)
+        builder.add_test_case(F("case%s") % i);
+    const model::test_program program = builder.build();
+
+    store::write_backend backend = store::write_backend::open_rw(
+        fs::path("test.db"));
+    std::vector< int64_t > tc_ids;
+    {
+        store::write_transaction tx = backend.start_write();
+        tx.put_context(model::context(fs::path("/foo/bar"),
+                                      std::map< std::string, std::string >()));
+        const int64_t tp_id = tx.put_test_program(program);
+        for (int i = 0; i < count; ++i)
+            tc_ids.push_back(tx.put_test_case(program, F("case%s") % i,
+                                              tp_id));
+        tx.commit();
+    }
+
+    store::read_backend read_backend = store::read_backend::open_ro(
+        fs::path("test.db"));
+
+    store::results_watermark watermark;
+    {
+        store::read_transaction tx = read_backend.start_read();
+        watermark = tx.get_watermark(watermark);
+        tx.finish();
+    }
+    ATF_REQUIRE_EQ(count, watermark.pending_test_case_ids().size());
+
+    {
+        store::write_transaction tx = backend.start_write();
+        for (int i = 0; i < count; i += 2)
+            tx.put_result(result, tc_ids[i], start_time, end_time);
+        tx.commit();
+    }
+
+    {
+        store::read_transaction tx = read_backend.start_read();
+        store::results_iterator iter = tx.get_results(
+            store::results_filter().without_files().after(watermark));
+        int found = 0;
+        for (; iter; ++iter)
+            ++found;
+        ATF_REQUIRE_EQ(count / 2, found);
+        watermark = tx.get_watermark(watermark);
+        tx.finish();
+    }
+    ATF_REQUIRE_EQ(count / 2, watermark.pending_test_case_ids().size());
+}
+
+
+ATF_TEST_CASE(get_summary__empty);
+ATF_TEST_CASE_HEAD(get_summary__empty)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(get_summary__empty)
+{
+    store::write_backend::open_rw(fs::path("test.db"));  // Create database.
+    store::read_backend backend = store::read_backend::open_ro(
+        fs::path("test.db"));
+    store::read_transaction tx = backend.start_read();
+    const store::results_summary summary = tx.get_summary();
+    tx.finish();
+
+    ATF_REQUIRE(summary.counts.empty());
+    ATF_REQUIRE_EQ(datetime::delta(), summary.total_duration);
+    ATF_REQUIRE(!summary.start_time);
+    ATF_REQUIRE(!summary.end_time);
+}
+
+
+ATF_TEST_CASE(get_summary__some);
+ATF_TEST_CASE_HEAD(get_summary__some)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(get_summary__some)
+{
+    const datetime::timestamp time1 = datetime::timestamp::from_values(
+        2026, 10, 14, 12, 0, 0, 0);
+    const datetime::timestamp time2 = datetime::timestamp::from_values(
+        2026, 10, 14, 12, 0, 1, 500);
+    const datetime::timestamp time3 = datetime::timestamp::from_values(
+        2026, 10, 14, 12, 0, 3, 0);
+    {
+        store::write_backend backend = store::write_backend::open_rw(
+            fs::path("test.db"));
+        backend.database().exec("PRAGMA foreign_keys = OFF");
+        store::write_transaction tx = backend.start_write();
+        tx.put_result(model::test_result(model::test_result_skipped, "foo"),
+                      1, time2, time3);
+        tx.put_result(model::test_result(model::test_result_passed), 2,
+                      time1, time2);
+        tx.put_result(model::test_result(model::test_result_passed), 3,
+                      time1, time2);
+        tx.commit();
+    }
+
+    store::read_backend backend = store::read_backend::open_ro(
+        fs::path("test.db"));
+    store::read_transaction tx = backend.start_read();
+    const store::results_summary summary = tx.get_summary();
+    tx.finish();
+
+    std::map< model::test_result_type, std::size_t > exp_counts;
+    exp_counts[model::test_result_passed] = 2;
+    exp_counts[model::test_result_skipped] = 1;
+    ATF_REQUIRE(exp_counts == summary.counts);
+    ATF_REQUIRE_EQ((time2 - time1) + (time2 - time1) + (time3 - time2),
+                   summary.total_duration);
+    ATF_REQUIRE_EQ(time1, summary.start_time.get());
+    ATF_REQUIRE_EQ(time3, summary.end_time.get());
+}
+
+
+ATF_TEST_CASE(get_run_events);
+ATF_TEST_CASE_HEAD(get_run_events)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(get_run_events)
+{
+    const datetime::timestamp time1 = datetime::timestamp::from_values(
+        2026, 10, 14, 12, 0, 0, 0);
+    const datetime::timestamp time2 = datetime::timestamp::from_values(
+        2026, 10, 14, 12, 0, 1, 500);
+    const datetime::timestamp time3 = datetime::timestamp::from_values(
+        2026, 10, 14, 12, 0, 2, 0);
+    {
+        store::write_backend backend = store::write_backend::open_rw(
+            fs::path("test.db"));
+        store::write_transaction tx = backend.start_write();
+        tx.put_run_event("cleanup", "dir/prog:a", utils::none, time2, time3);
+        tx.put_run_event("test", "dir/prog:a", utils::make_optional(123),
+                         time1, time2);
+        tx.commit();
+    }
+
+    store::read_backend backend = store::read_backend::open_ro(
+        fs::path("test.db"));
+    store::read_transaction tx = backend.start_read();
+    const std::vector< store::run_event > events = tx.get_run_events();
+    tx.finish();
+
+    ATF_REQUIRE_EQ(2, events.size());
+    ATF_REQUIRE_EQ("test", events[0].kind);
+    ATF_REQUIRE_EQ("dir/prog:a", events[0].name);
+    ATF_REQUIRE(events[0].pid);
+    ATF_REQUIRE_EQ(123, events[0].pid.get());
+    ATF_REQUIRE_EQ(time1, events[0].start_time);
+    ATF_REQUIRE_EQ(time2, events[0].end_time);
+    ATF_REQUIRE_EQ("cleanup", events[1].kind);
+    ATF_REQUIRE(!events[1].pid);
+    ATF_REQUIRE_EQ(time2, events[1].start_time);
+    ATF_REQUIRE_EQ(time3, events[1].end_time);
+}
+
+
+ATF_TEST_CASE(get_slot_usage);
+ATF_TEST_CASE_HEAD(get_slot_usage)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(get_slot_usage)
+{
+    std::map< std::string, datetime::delta > usage;
+    usage["test"] = datetime::delta(30, 500);
+    usage["store"] = datetime::delta(0, 20);
+    {
+        store::write_backend backend = store::write_backend::open_rw(
+            fs::path("test.db"));
+        store::write_transaction tx = backend.start_write();
+        tx.put_slot_usage(usage);
+        tx.commit();
+    }
+
+    store::read_backend backend = store::read_backend::open_ro(
+        fs::path("test.db"));
+    store::read_transaction tx = backend.start_read();
+    ATF_REQUIRE(usage == tx.get_slot_usage());
+    tx.finish();
+}
+
+
+ATF_INIT_TEST_CASES(tcs)
+{
+    ATF_ADD_TEST_CASE(tcs, get_context__missing);
+    ATF_ADD_TEST_CASE(tcs, get_context__invalid_cwd);
+    ATF_ADD_TEST_CASE(tcs, get_context__invalid_env_vars);
+    ATF_ADD_TEST_CASE(tcs, get_context__without_env);
+
+    ATF_ADD_TEST_CASE(tcs, get_results__none);
+    ATF_ADD_TEST_CASE(tcs, get_results__many);
+    ATF_ADD_TEST_CASE(tcs, get_results__cache_key);
+    ATF_ADD_TEST_CASE(tcs, get_results__attempt);
+    ATF_ADD_TEST_CASE(tcs, get_results__shared_test_program);
+    ATF_ADD_TEST_CASE(tcs, get_results__compressed_files);
+    ATF_ADD_TEST_CASE(tcs, get_results__unknown_codec);
+    ATF_ADD_TEST_CASE(tcs, get_results__read_files);
+    ATF_ADD_TEST_CASE(tcs, get_results__read_files__compressed);
+    ATF_ADD_TEST_CASE(tcs, get_results__ranged_files);
+    ATF_ADD_TEST_CASE(tcs, get_results__ranged_files__compressed);
+    ATF_ADD_TEST_CASE(tcs, get_results__ranged_files__without_size);
+    ATF_ADD_TEST_CASE(tcs, get_results__ranged_files__compressed__without_size);
+    ATF_ADD_TEST_CASE(tcs, get_results__filter__result_types);
+    ATF_ADD_TEST_CASE(tcs, get_results__filter__test_programs);
+    ATF_ADD_TEST_CASE(tcs, get_results__filter__without_files);
+    ATF_ADD_TEST_CASE(tcs, get_results__filter__slice);
+    ATF_ADD_TEST_CASE(tcs, get_results__filter__after_watermark);
+    ATF_ADD_TEST_CASE(tcs, get_results__filter__after_watermark__many_pending);
+
+    ATF_ADD_TEST_CASE(tcs, get_summary__empty);
+    ATF_ADD_TEST_CASE(tcs, get_summary__some);
+
+    ATF_ADD_TEST_CASE(tcs, get_run_events);
+    ATF_ADD_TEST_CASE(tcs, get_slot_usage);
 }
@@ -26,7 +26,12 @@
 // (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 // OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
+#include <cstddef>
 #include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
 
 #include <atf-c++.hpp>
 
@@ -40,10 +45,14 @@
 #include "store/write_backend.hpp"
 #include "utils/datetime.hpp"
 #include "utils/env.hpp"
+#include "utils/format/containers.ipp"
 #include "utils/format/macros.hpp"
+#include "utils/fs/operations.hpp"
 #include "utils/fs/path.hpp"
 #include "utils/logging/operations.hpp"
+#include "utils/optional.ipp"
 #include "utils/sqlite/database.hpp"
+#include "utils/sqlite/statement.ipp"
 #include "utils/stream.hpp"
 #include "utils/units.hpp"
 
@@ -76,6 +85,55 @@ testdata_file(const std::string& name)
 }
 
 
+/// Gets the names of the explicitly-created indexes of a database.
+///
+/// \param dbpath The path to the database to query.
+///
+/// \return The names of the indexes, excluding those that SQLite creates
+/// automatically to implement constraints.
+static std::set< std::string >
+get_indexes(const fs::path& dbpath)
+{
+    sqlite::database db = sqlite::database::open(dbpath,
+                                                 sqlite::open_readonly);
+    std::set< std::string > indexes;
+    {
+        sqlite::statement stmt = db.create_statement(
+            "SELECT name FROM sqlite_master WHERE type = 'index' "
+            "    AND name NOT LIKE 'sqlite_autoindex_%'");
+        while (stmt.step())
+            indexes.insert(stmt.safe_column_text("name"));
+    }
+    db.close();
+    return indexes;
+}
+
+
+/// Validates that the stored summary of a database matches its results.
+///
+/// \param dbpath Path to the database to check.
+static void
+check_summary(const fs::path& dbpath)
+{
+    store::read_backend backend = store::read_backend::open_ro(dbpath);
+    store::read_transaction transaction = backend.start_read();
+
+    std::map< model::test_result_type, std::size_t > exp_counts;
+    datetime::delta exp_total_duration;
+    for (store::results_iterator iter = transaction.get_results(); iter;
+         ++iter) {
+        exp_counts[iter.result().type()]++;
+        exp_total_duration += iter.end_time() - iter.start_time();
+    }
+
+    const store::results_summary summary = transaction.get_summary();
+    ATF_REQUIRE(exp_counts == summary.counts);
+    ATF_REQUIRE_EQ(exp_total_duration, summary.total_duration);
+    ATF_REQUIRE_EQ(!exp_counts.empty(),
+                   static_cast< bool >(summary.start_time));
+}
+
+
 /// Validates the contents of the action with identifier 1.
 ///
 /// \param dbpath Path to the database in which to check the action contents.
@@ -467,7 +525,8 @@ CURRENT_SCHEMA_TEST(4);
         db.exec(utils::read_file(testdata_file(testdata))); \
         db.close(); \
         \
-        store::migrate_schema(fs::path("test.db")); \
+        store::migrate_hooks hooks; \
+        store::migrate_schema(fs::path("test.db"), 1, hooks); \
         \
         check_action_2(fs::path(".kyua/store/" \
             "results.test_suite_root.20130108-111331-000000.db")); \
@@ -475,11 +534,144 @@ CURRENT_SCHEMA_TEST(4);
             "results.usr_tests.20130108-123832-000000.db")); \
         check_action_4(fs::path(".kyua/store/" \
             "results.usr_tests.20130108-112635-000000.db")); \
+        check_summary(fs::path(".kyua/store/" \
+            "results.test_suite_root.20130108-111331-000000.db")); \
     }
 MIGRATE_SCHEMA_TEST(1);
 MIGRATE_SCHEMA_TEST(2);
 
 
+ATF_TEST_CASE(migrate_schema__from_v2__parallel);
+ATF_TEST_CASE_HEAD(migrate_schema__from_v2__parallel)
+{
+    logging::set_inmemory();
+
+    std::string required_files =
+        testdata_file("schema_v2.sql").str() + " " +
+        testdata_file("testdata_v2.sql").str();
+    for (int i = 2; i < store::detail::current_schema_version; ++i)
+        required_files += " " + store::detail::migration_file(i, i + 1).str();
+
+    set_md_var("require.files", required_files);
+}
+ATF_TEST_CASE_BODY(migrate_schema__from_v2__parallel)
+{
+    const fs::path testpath("test.db");
+
+    sqlite::database db = sqlite::database::open(
+        testpath, sqlite::open_readwrite | sqlite::open_create);
+    db.exec(utils::read_file(testdata_file("schema_v2.sql")));
+    db.exec(utils::read_file(testdata_file("testdata_v2.sql")));
+    db.close();
+
+    /// Records the progress reported by the migration.
+    class progress_hooks : public store::migrate_hooks {
+    public:
+        /// Values of the done and total parameters of every call.
+        std::vector< std::pair< std::size_t, std::size_t > > calls;
+
+        /// Records a call.
+        ///
+        /// \param done Number of actions processed so far.
+        /// \param total Number of actions to process.
+        void
+        extracted_action(const std::size_t done, const std::size_t total)
+        {
+            calls.push_back(std::make_pair(done, total));
+        }
+    } hooks;
+    store::migrate_schema(testpath, 2, hooks);
+
+    ATF_REQUIRE_EQ(3, hooks.calls.size());
+    for (std::size_t i = 0; i < hooks.calls.size(); ++i) {
+        ATF_REQUIRE_EQ(i + 1, hooks.calls[i].first);
+        ATF_REQUIRE_EQ(3, hooks.calls[i].second);
+    }
+
+    check_action_2(fs::path(".kyua/store/"
+        "results.test_suite_root.20130108-111331-000000.db"));
+    check_action_3(fs::path(".kyua/store/"
+        "results.usr_tests.20130108-123832-000000.db"));
+    check_action_4(fs::path(".kyua/store/"
+        "results.usr_tests.20130108-112635-000000.db"));
+    ATF_REQUIRE(!fs::exists(testpath));
+}
+
+
+ATF_TEST_CASE(migrate_schema__from_v3);
+ATF_TEST_CASE_HEAD(migrate_schema__from_v3)
+{
+    logging::set_inmemory();
+
+    std::string required_files =
+        testdata_file("schema_v3.sql").str() + " " +
+        testdata_file("testdata_v3_2.sql").str();
+    for (int i = 3; i < store::detail::current_schema_version; ++i)
+        required_files += " " + store::detail::migration_file(i, i + 1).str();
+
+    set_md_var("require.files", required_files);
+}
+ATF_TEST_CASE_BODY(migrate_schema__from_v3)
+{
+    const fs::path testpath("test.db");
+
+    sqlite::database db = sqlite::database::open(
+        testpath, sqlite::open_readwrite | sqlite::open_create);
+    db.exec(utils::read_file(testdata_file("schema_v3.sql")));
+    db.exec(utils::read_file(testdata_file("testdata_v3_2.sql")));
+    db.close();
+
+    store::migrate_hooks hooks;
+    store::migrate_schema(testpath, 1, hooks);
+
+    // Databases at or after the chunked schema are migrated in place.
+    check_action_2(testpath);
+
+    check_summary(testpath);
+}
+
+
+ATF_TEST_CASE(migrate_schema__indexes);
+ATF_TEST_CASE_HEAD(migrate_schema__indexes)
+{
+    logging::set_inmemory();
+
+    std::string required_files =
+        store::detail::schema_file().str() + " " +
+        testdata_file("schema_v3.sql").str();
+    for (int i = 3; i < store::detail::current_schema_version; ++i)
+        required_files += " " + store::detail::migration_file(i, i + 1).str();
+
+    set_md_var("require.files", required_files);
+}
+ATF_TEST_CASE_BODY(migrate_schema__indexes)
+{
+    {
+        sqlite::database db = sqlite::database::open(
+            fs::path("current.db"),
+            sqlite::open_readwrite | sqlite::open_create);
+        db.exec(utils::read_file(store::detail::schema_file()));
+        db.close();
+    }
+
+    {
+        sqlite::database db = sqlite::database::open(
+            fs::path("migrated.db"),
+            sqlite::open_readwrite | sqlite::open_create);
+        db.exec(utils::read_file(testdata_file("schema_v3.sql")));
+        db.close();
+    }
+    store::migrate_hooks hooks;
+    store::migrate_schema(fs::path("migrated.db"), 1, hooks);
+
+    const std::set< std::string > indexes = get_indexes(
+        fs::path("current.db"));
+    ATF_REQUIRE(indexes.find("index_test_results_by_result_type") !=
+                indexes.end());
+    ATF_REQUIRE_EQ(indexes, get_indexes(fs::path("migrated.db")));
+}
+
+
 ATF_INIT_TEST_CASES(tcs)
 {
     ATF_ADD_TEST_CASE(tcs, current_schema_1);
@@ -489,4 +681,7 @@ ATF_INIT_TEST_CASES(tcs)
 
     ATF_ADD_TEST_CASE(tcs, migrate_schema__from_v1);
     ATF_ADD_TEST_CASE(tcs, migrate_schema__from_v2);
+    ATF_ADD_TEST_CASE(tcs, migrate_schema__from_v2__parallel);
+    ATF_ADD_TEST_CASE(tcs, migrate_schema__from_v3);
+    ATF_ADD_TEST_CASE(tcs, migrate_schema__indexes);
 }
@@ -0,0 +1,456 @@
+-- Copyright 2026 The Kyua Authors.
+-- All rights reserved.
+--
+-- Redistribution and use in source and binary forms, with or without
+-- modification, are permitted provided that the following conditions are
+-- met:
+--
+-- * Redistributions of source code must retain the above copyright
+--   notice, this list of conditions and the following disclaimer.
+-- * Redistributions in binary form must reproduce the above copyright
+--   notice, this list of conditions and the following disclaimer in the
+--   documentation and/or other materials provided with the distribution.
+-- * Neither the name of Google Inc. nor the names of its contributors
+--   may be used to endorse or promote products derived from this software
+--   without specific prior written permission.
+--
+-- THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+-- "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+-- LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+-- A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+-- OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+-- SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+-- LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+-- DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+-- THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+-- (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+-- OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+-- \file store/schema_v4.sql
+-- Definition of the database schema.
+--
+-- The whole contents of this file are wrapped in a transaction.  We want
+-- to ensure that the initial contents of the database (the table layout as
+-- well as any predefined values) are written atomically to simplify error
+-- handling in our code.
+
+
+BEGIN TRANSACTION;
+
+
+-- -------------------------------------------------------------------------
+-- Metadata.
+-- -------------------------------------------------------------------------
+
+
+-- Database-wide properties.
+--
+-- Rows in this table are immutable: modifying the metadata implies writing
+-- a new record with a new schema_version greater than all existing
+-- records, and never updating previous records.  When extracting data from
+-- this table, the only "valid" row is the one with the highest
+-- scheam_version.  All the other rows are meaningless and only exist for
+-- historical purposes.
+--
+-- In other words, this table keeps the history of the database metadata.
+-- The only reason for doing this is for debugging purposes.  It may come
+-- in handy to know when a particular database-wide operation happened if
+-- it turns out that the database got corrupted.
+CREATE TABLE metadata (
+    schema_version INTEGER PRIMARY KEY CHECK (schema_version >= 1),
+    timestamp TIMESTAMP NOT NULL CHECK (timestamp >= 0)
+);
+
+
+-- -------------------------------------------------------------------------
+-- Contexts.
+-- -------------------------------------------------------------------------
+
+
+-- Execution contexts.
+--
+-- A context represents the execution environment of the test run.
+-- We record such information for information and debugging purposes.
+CREATE TABLE contexts (
+    cwd TEXT NOT NULL
+
+    -- TODO(jmmv): Record the run-time configuration.
+);
+
+
+-- Environment variables of a context.
+CREATE TABLE env_vars (
+    var_name TEXT PRIMARY KEY,
+    var_value TEXT NOT NULL
+);
+
+
+-- -------------------------------------------------------------------------
+-- Test suites.
+--
+-- The tables in this section represent all the components that form a test
+-- suite.  This includes data about the test suite itself (test programs
+-- and test cases), and also the data about particular runs (test results).
+--
+-- As you will notice, every object has a unique identifier and there is no
+-- attempt to deduplicate data.  This has the interesting result of making
+-- the distinction of a test case and a test result a pure syntactic
+-- difference, because there is always a 1:1 relation.
+-- -------------------------------------------------------------------------
+
+
+-- Representation of the metadata objects.
+--
+-- The way this table works is like this: every time we record a metadata
+-- object, we calculate what its identifier should be as the last rowid of
+-- the table.  All properties of that metadata object thus receive the same
+-- identifier.
+--
+-- Identical metadata objects are only stored once and their identifier is
+-- shared by all the test programs and test cases that refer to them.
+CREATE TABLE metadatas (
+    metadata_id INTEGER NOT NULL,
+
+    -- The name of the property.
+    property_name TEXT NOT NULL,
+
+    -- One of the values of the property.
+    property_value TEXT,
+
+    PRIMARY KEY (metadata_id, property_name)
+);
+
+
+-- Optimize the loading of the metadata of any single entity.
+--
+-- The metadata_id column of the metadatas table is not enough to act as a
+-- primary key, yet we need to locate entries in the metadatas table solely by
+-- their identifier.
+--
+-- TODO(jmmv): I think this index is useless given that the primary key in the
+-- metadatas table includes the metadata_id as the first component.  Need to
+-- verify this and drop the index or this comment appropriately.
+CREATE INDEX index_metadatas_by_id
+    ON metadatas (metadata_id);
+
+
+-- Representation of a test program.
+--
+-- At the moment, there are no substantial differences between the
+-- different interfaces, so we can simplify the design by with having a
+-- single table representing all test caes.  We may need to revisit this in
+-- the future.
+CREATE TABLE test_programs (
+    test_program_id INTEGER PRIMARY KEY AUTOINCREMENT,
+
+    -- The absolute path to the test program.  This should not be necessary
+    -- because it is basically the concatenation of root and relative_path.
+    -- However, this allows us to very easily search for test programs
+    -- regardless of where they were executed from.  (I.e. different
+    -- combinations of root + relative_path can map to the same absolute path).
+    absolute_path TEXT NOT NULL,
+
+    -- The path to the root of the test suite (where the Kyuafile lives).
+    root TEXT NOT NULL,
+
+    -- The path to the test program, relative to the root.
+    relative_path TEXT NOT NULL,
+
+    -- Name of the test suite the test program belongs to.
+    test_suite_name TEXT NOT NULL,
+
+    -- Reference to the various rows of metadatas.
+    metadata_id INTEGER,
+
+    -- The name of the test program interface.
+    --
+    -- Note that this indicates both the interface for the test program and
+    -- its test cases.  See below for the corresponding detail tables.
+    interface TEXT NOT NULL,
+
+    -- Name of the Kyuafile-defined variant this test program ran as, or NULL
+    -- if the test program has no variants.  The variant configuration
+    -- variables themselves are not recorded.
+    variant TEXT
+);
+
+
+-- Optimize the lookup of test programs by their relative path, which is what
+-- the user-provided filters of the reporting commands refer to.
+CREATE INDEX index_test_programs_by_relative_path
+    ON test_programs (relative_path);
+
+
+-- Optimize the sorting of results by test program, as done by all reports.
+CREATE INDEX index_test_programs_by_absolute_path
+    ON test_programs (absolute_path);
+
+
+-- Representation of a test case.
+--
+-- At the moment, there are no substantial differences between the
+-- different interfaces, so we can simplify the design by with having a
+-- single table representing all test caes.  We may need to revisit this in
+-- the future.
+CREATE TABLE test_cases (
+    test_case_id INTEGER PRIMARY KEY AUTOINCREMENT,
+    test_program_id INTEGER REFERENCES test_programs,
+    name TEXT NOT NULL,
+
+    -- Reference to the various rows of metadatas.
+    metadata_id INTEGER
+);
+
+
+-- Optimize the loading of all test cases that are part of a test program.
+CREATE INDEX index_test_cases_by_test_programs_id
+    ON test_cases (test_program_id);
+
+
+-- Representation of test case results.
+--
+-- Note that there is a 1:1 relation between test cases and their results.
+-- If a test case was retried after failing, this holds the result of its
+-- last attempt and test_retried_results holds those of the earlier ones.
+CREATE TABLE test_results (
+    test_case_id INTEGER PRIMARY KEY REFERENCES test_cases,
+    result_type TEXT NOT NULL,
+    result_reason TEXT,
+
+    start_time TIMESTAMP NOT NULL,
+    end_time TIMESTAMP NOT NULL,
+
+    -- Number of the attempt that yielded this result, starting at 1.
+    attempt INTEGER NOT NULL DEFAULT 1 CHECK (attempt >= 1)
+);
+
+
+-- Optimize the selection of results by their type, as done when reports are
+-- restricted to some result types only.
+CREATE INDEX index_test_results_by_result_type
+    ON test_results (result_type);
+
+
+-- Resources consumed by test cases, as reported by the operating system.
+--
+-- There is at most one row per test case, and there is none for test
+-- cases run on platforms that do not report resource usage.  Times are in
+-- microseconds and the maximum resident set size is in bytes.
+CREATE TABLE test_resource_usage (
+    test_case_id INTEGER PRIMARY KEY REFERENCES test_cases,
+
+    user_time INTEGER NOT NULL,
+    system_time INTEGER NOT NULL,
+    max_rss INTEGER NOT NULL,
+    in_blocks INTEGER NOT NULL,
+    out_blocks INTEGER NOT NULL,
+    voluntary_switches INTEGER NOT NULL,
+    involuntary_switches INTEGER NOT NULL
+);
+
+
+-- Results of the failed attempts of test cases that were retried.
+--
+-- The columns match those of test_results, but there can be many rows per
+-- test case.  The final result of the test case is never in here.
+CREATE TABLE test_retried_results (
+    test_case_id INTEGER NOT NULL REFERENCES test_cases,
+    attempt INTEGER NOT NULL CHECK (attempt >= 1),
+    result_type TEXT NOT NULL,
+    result_reason TEXT,
+
+    start_time TIMESTAMP NOT NULL,
+    end_time TIMESTAMP NOT NULL,
+
+    PRIMARY KEY (test_case_id, attempt)
+);
+
+
+-- Cache keys of test cases, used to skip test cases whose inputs did not
+-- change since they last passed.
+--
+-- The key is an opaque digest of the test program binary, the files required
+-- by the test case, its metadata and its configuration variables.  There is
+-- no row for test cases run without result caching enabled.
+CREATE TABLE test_cache_keys (
+    test_case_id INTEGER PRIMARY KEY REFERENCES test_cases,
+    cache_key TEXT NOT NULL
+);
+
+
+-- CPUs to which test cases were pinned.
+--
+-- The slot is the execution slot that ran the test case and the cpus
+-- column holds a list of processor numbers and ranges, such as 0-3,8.  There
+-- is no row for test cases run without CPU affinity enabled.
+CREATE TABLE test_cpu_affinities (
+    test_case_id INTEGER PRIMARY KEY REFERENCES test_cases,
+    slot INTEGER NOT NULL CHECK (slot >= 0),
+    numa_node INTEGER NOT NULL CHECK (numa_node >= 0),
+    cpus TEXT NOT NULL
+);
+
+
+-- Results of the individual checks reported by test cases.
+--
+-- There is one row per check, such as each test point of a TAP test
+-- program, numbered by position in the order in which the test case reported
+-- them.  The reason holds the description of the check.  There are no rows
+-- for test cases run without the store_sub_results configuration variable
+-- enabled.
+CREATE TABLE test_sub_results (
+    test_case_id INTEGER NOT NULL REFERENCES test_cases,
+    position INTEGER NOT NULL CHECK (position >= 1),
+    result_type TEXT NOT NULL,
+    result_reason TEXT,
+
+    PRIMARY KEY (test_case_id, position)
+);
+
+
+-- Histograms of the latencies of the phases of the execution.
+--
+-- There is one row per non-empty bucket of the histogram of each phase, such
+-- as the spawning of the test cases or the storing of their results.  The
+-- upper_bound is the largest latency in microseconds that falls into the
+-- bucket and the count is the number of measurements in the bucket.
+CREATE TABLE phase_latencies (
+    phase TEXT NOT NULL,
+    upper_bound INTEGER NOT NULL CHECK (upper_bound >= 0),
+    count INTEGER NOT NULL CHECK (count >= 1),
+
+    PRIMARY KEY (phase, upper_bound)
+);
+
+
+-- Aggregates of the results of the test cases, one row per result type.
+--
+-- The rows are kept up to date as results are stored so that the reporting
+-- commands can print the totals of a run without scanning all its results.
+-- The total_duration is the sum of the run times of the test cases in
+-- microseconds.
+CREATE TABLE result_summaries (
+    result_type TEXT PRIMARY KEY,
+    results_count INTEGER NOT NULL CHECK (results_count >= 1),
+    total_duration INTEGER NOT NULL,
+    min_start_time TIMESTAMP NOT NULL,
+    max_end_time TIMESTAMP NOT NULL
+);
+
+
+-- Use of the execution slots during the run, one row per activity.
+--
+-- The slot_time is the time in microseconds that all the slots together spent
+-- in the activity: running test cases ('test') or listings ('list'), or
+-- sitting idle while the listings completed ('list'), while kyua spawned
+-- subprocesses ('spawn'), stored results ('store') or deleted work directories
+-- ('cleanup'), while the exclusive test cases ran ('exclusive'), or for any
+-- other reason, such as having no test cases left to start ('idle').
+CREATE TABLE slot_usage (
+    activity TEXT PRIMARY KEY,
+    slot_time INTEGER NOT NULL CHECK (slot_time >= 0)
+);
+
+
+-- Timeline of the operations carried out during the execution.
+--
+-- The kind identifies the type of the operation, such as the execution of a
+-- test case or the listing of a test program, and the name identifies its
+-- subject.  The pid is the subprocess that carried out the operation, if any;
+-- operations done by kyua itself, such as the cleanup of a work directory,
+-- have none.
+CREATE TABLE run_events (
+    event_id INTEGER PRIMARY KEY AUTOINCREMENT,
+    kind TEXT NOT NULL,
+    name TEXT NOT NULL,
+    pid INTEGER,
+    start_time TIMESTAMP NOT NULL,
+    end_time TIMESTAMP NOT NULL
+);
+
+
+-- Collection of output files of the test case.
+CREATE TABLE test_case_files (
+    test_case_id INTEGER NOT NULL REFERENCES test_cases,
+
+    -- The raw name of the file.
+    --
+    -- The special names '__STDOUT__' and '__STDERR__' are reserved to hold
+    -- the stdout and stderr of the test case, respectively.  If any of
+    -- these are empty, there will be no corresponding entry in this table
+    -- (hence why we do not allow NULLs in these fields).
+    file_name TEXT NOT NULL,
+
+    -- Pointer to the file itself.
+    file_id INTEGER NOT NULL REFERENCES files,
+
+    PRIMARY KEY (test_case_id, file_name)
+);
+
+
+-- Covering index to locate the files of a test case.
+--
+-- The primary key already allows looking up the entries of a test case by
+-- name, but including file_id saves a lookup into the table itself when
+-- reports join test cases with their stdout and stderr.
+CREATE INDEX index_test_case_files_by_test_case_id
+    ON test_case_files (test_case_id, file_name, file_id);
+
+
+-- -------------------------------------------------------------------------
+-- Verbatim files.
+-- -------------------------------------------------------------------------
+
+
+-- Copies of files or logs generated during testing.
+--
+-- Files are deduplicated by their contents: writers look up existing rows
+-- by contents_hash and, if the contents match byte by byte, reference the
+-- existing file_id instead of storing a new copy.
+CREATE TABLE files (
+    file_id INTEGER PRIMARY KEY,
+
+    -- The contents of the file, encoded as indicated by codec.
+    contents BLOB NOT NULL,
+
+    -- Hash of the encoded contents, used to locate candidates for
+    -- deduplication.
+    --
+    -- This is purely an optimization and collisions are possible, so the
+    -- contents must always be compared before reusing a row.  The value
+    -- may be NULL for files migrated from older schema versions.
+    contents_hash TEXT,
+
+    -- Encoding of the contents: 'none' for verbatim copies or 'zlib' for
+    -- data compressed with zlib.
+    codec TEXT NOT NULL DEFAULT 'none',
+
+    -- Length of the decoded contents in bytes, so that readers can learn it
+    -- without decoding the file.  The value may be NULL for files stored by
+    -- older versions of kyua.
+    size INTEGER CHECK (size IS NULL OR size >= 0)
+);
+
+
+-- Optimize the lookup of files with the same contents.
+CREATE INDEX index_files_by_contents_hash
+    ON files (contents_hash);
+
+
+-- -------------------------------------------------------------------------
+-- Initialization of values.
+-- -------------------------------------------------------------------------
+
+
+-- Create a new metadata record.
+--
+-- For every new database, we want to ensure that the metadata is valid if
+-- the database creation (i.e. the whole transaction) succeeded.
+--
+-- If you modify the value of the schema version in this statement, you
+-- will also have to modify the version encoded in the backend module.
+INSERT INTO metadata (timestamp, schema_version)
+    VALUES (strftime('%s', 'now'), 4);
+
+
+COMMIT TRANSACTION;
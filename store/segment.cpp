@@ -0,0 +1,619 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "store/segment.hpp"
+
+#if defined(HAVE_CONFIG_H)
+#   include "config.h"
+#endif
+
+extern "C" {
+#include <sys/stat.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+}
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+#include <utility>
+#include <vector>
+
+#include "store/exceptions.hpp"
+#include "utils/format/macros.hpp"
+#include "utils/fs/path.hpp"
+#include "utils/logging/macros.hpp"
+#include "utils/sanity.hpp"
+#include "utils/sqlite/database.hpp"
+#include "utils/sqlite/statement.ipp"
+
+namespace fs = utils::fs;
+namespace sqlite = utils::sqlite;
+
+
+/// Name of the codec for files whose contents live in a segment file.
+///
+/// The contents column of these files holds a reference to the segment, as
+/// formatted by format_segment_ref(), instead of the contents themselves.
+const char* const store::detail::codec_segment = "segment";
+
+
+namespace {
+
+
+/// Size of the chunks in which contents are copied to and from segments.
+static const std::size_t chunk_size = 64 * 1024;
+
+
+/// Reads a range of a file at a given position.
+///
+/// \param fd The file to read from.
+/// \param offset The position of the first byte to read.
+/// \param [out] buffer The buffer into which to read the data.
+/// \param length The number of bytes to read.
+///
+/// \return True if the whole range was read; false if the file is too short
+/// or on error.
+static bool
+pread_fully(const int fd, int64_t offset, char* buffer, std::size_t length)
+{
+    while (length > 0) {
+        const ssize_t ret = ::pread(fd, buffer, length,
+                                    static_cast< off_t >(offset));
+        if (ret == -1) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        } else if (ret == 0) {
+            return false;
+        }
+        buffer += ret;
+        offset += ret;
+        length -= static_cast< std::size_t >(ret);
+    }
+    return true;
+}
+
+
+/// Reads the next chunk of a stream whose length is known upfront.
+///
+/// \param input The stream from which to read.
+/// \param [out] buffer The buffer into which to read the data.
+/// \param pending Number of bytes left in the stream.
+///
+/// \return The number of bytes read into buffer.
+///
+/// \throw store::error If the read is short.
+static std::size_t
+read_chunk(std::istream& input, char* buffer, const std::size_t pending)
+{
+    const std::size_t length = std::min(chunk_size, pending);
+    input.read(buffer, static_cast< std::streamsize >(length));
+    if (input.gcount() != static_cast< std::streamsize >(length))
+        throw store::error("Failed to read file");
+    return length;
+}
+
+
+}  // anonymous namespace
+
+
+/// Computes the path to the segment file of a results database.
+///
+/// \param database Path to the results database.
+///
+/// \return The path to the segment, which follows the naming scheme of the
+/// journal files of SQLite.
+fs::path
+store::detail::segment_path(const fs::path& database)
+{
+    return fs::path(database.str() + "-files");
+}
+
+
+/// Formats a reference to the contents of a segment.
+///
+/// \param ref The reference to format.
+///
+/// \return The textual representation of the reference, to be stored in the
+/// contents column of the files table.
+std::string
+store::detail::format_segment_ref(const segment_ref& ref)
+{
+    return F("%s %s %s") % ref.codec % ref.offset % ref.length;
+}
+
+
+/// Parses a reference to the contents of a segment.
+///
+/// \param data The stored representation of the reference.
+/// \param size The length of data in bytes.
+///
+/// \return The parsed reference.
+///
+/// \throw integrity_error If the reference is malformed.
+store::detail::segment_ref
+store::detail::parse_segment_ref(const void* data, const std::size_t size)
+{
+    const std::string text(static_cast< const char* >(data), size);
+    std::istringstream input(text);
+
+    segment_ref ref;
+    if (!(input >> ref.codec >> ref.offset >> ref.length) || !input.eof() ||
+        ref.offset < 0 || ref.length < 0)
+        throw store::integrity_error(F("Invalid segment reference '%s'") %
+                                     text);
+    return ref;
+}
+
+
+/// Opens a segment file for reading.
+///
+/// \param path Path to the segment.
+///
+/// \throw integrity_error If the segment cannot be opened.
+store::detail::segment_reader::segment_reader(const fs::path& path) :
+    _fd(::open(path.c_str(), O_RDONLY))
+{
+    if (_fd == -1) {
+        const int original_errno = errno;
+        throw store::integrity_error(F("Cannot open segment file %s: %s") %
+                                     path % std::strerror(original_errno));
+    }
+}
+
+
+/// Closes the segment file.
+store::detail::segment_reader::~segment_reader(void)
+{
+    (void)::close(_fd);
+}
+
+
+/// Reads a range of the contents referenced by a segment reference.
+///
+/// \param ref The reference to the contents.
+/// \param offset Position within the contents of the first byte to read.
+/// \param [out] buffer The buffer into which to read the data.
+/// \param length Number of bytes to read.
+///
+/// \pre The range must be within the referenced contents.
+///
+/// \throw integrity_error If the segment is shorter than the reference.
+void
+store::detail::segment_reader::read(const segment_ref& ref,
+                                    const int64_t offset, char* buffer,
+                                    const std::size_t length)
+{
+    PRE(offset >= 0 && offset + static_cast< int64_t >(length) <= ref.length);
+    if (!pread_fully(_fd, ref.offset + offset, buffer, length))
+        throw store::integrity_error(F("Segment file is missing %s bytes at "
+                                       "offset %s") % length %
+                                     (ref.offset + offset));
+}
+
+
+/// Internal implementation of segment_writer.
+struct store::detail::segment_writer::impl : utils::noncopyable {
+    /// Path to the segment.
+    fs::path path;
+
+    /// File descriptor of the segment, or -1 if not opened yet.
+    int fd;
+
+    /// Length of the segment, where the next contents are appended.
+    int64_t end;
+
+    /// Whether there are appended contents that have not been synced yet.
+    bool dirty;
+
+    /// Constructor.
+    ///
+    /// \param path_ Path to the segment.
+    explicit impl(const fs::path& path_) :
+        path(path_), fd(-1), end(0), dirty(false)
+    {
+    }
+
+    /// Destructor.
+    ~impl(void)
+    {
+        if (fd != -1)
+            (void)::close(fd);
+    }
+
+    /// Opens the segment if not yet open.
+    ///
+    /// Any data past the contents known to be referenced, such as the
+    /// leftovers of a rolled back transaction, is kept: new contents are
+    /// always appended after it.
+    ///
+    /// The segment is not opened in append mode because copy_file_range(2)
+    /// rejects such targets; writes go to explicit offsets instead, which is
+    /// equivalent as there is a single writer.
+    ///
+    /// \throw store::error If the segment cannot be opened.
+    void
+    open(void)
+    {
+        if (fd != -1)
+            return;
+
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        if (fd == -1) {
+            const int original_errno = errno;
+            throw store::error(F("Cannot open segment file %s: %s") % path %
+                               std::strerror(original_errno));
+        }
+        struct ::stat sb;
+        if (::fstat(fd, &sb) == -1) {
+            const int original_errno = errno;
+            (void)::close(fd);
+            fd = -1;
+            throw store::error(F("Cannot stat segment file %s: %s") % path %
+                               std::strerror(original_errno));
+        }
+        end = static_cast< int64_t >(sb.st_size);
+        LI(F("Appending file contents to segment %s") % path);
+    }
+
+    /// Appends a chunk of data to the segment.
+    ///
+    /// \param data The data to append.
+    /// \param length The length of data in bytes.
+    ///
+    /// \throw store::error If the write fails.
+    void
+    write(const char* data, std::size_t length)
+    {
+        dirty = true;
+        while (length > 0) {
+            const ssize_t ret = ::pwrite(fd, data, length,
+                                         static_cast< off_t >(end));
+            if (ret == -1) {
+                if (errno == EINTR)
+                    continue;
+                const int original_errno = errno;
+                throw store::error(F("Failed to write to segment file %s: %s")
+                                   % path % std::strerror(original_errno));
+            }
+            data += ret;
+            end += ret;
+            length -= static_cast< std::size_t >(ret);
+        }
+    }
+
+    /// Appends the contents of another file to the segment.
+    ///
+    /// The data is moved by the kernel with copy_file_range(2) if possible
+    /// and copied through user space otherwise.
+    ///
+    /// \param input Descriptor of the file to copy from, starting at its
+    ///     beginning.  Its file offset is not used.
+    /// \param length The number of bytes to copy.
+    ///
+    /// \throw store::error If the file cannot be read or the write fails.
+    void
+    copy(const int input, const std::size_t length)
+    {
+        dirty = true;
+        std::size_t done = 0;
+
+#if defined(HAVE_COPY_FILE_RANGE)
+        while (done < length) {
+            off_t in_offset = static_cast< off_t >(done);
+            off_t out_offset = static_cast< off_t >(end);
+            const ssize_t ret = ::copy_file_range(input, &in_offset, fd,
+                                                  &out_offset, length - done,
+                                                  0);
+            if (ret == -1 && errno == EINTR)
+                continue;
+            if (ret <= 0) {
+                // Not all file systems support in-kernel copies, and the
+                // input may have shrunk; the loop below sorts this out.
+                break;
+            }
+            done += static_cast< std::size_t >(ret);
+            end += ret;
+        }
+#endif
+
+        char buffer[chunk_size];
+        while (done < length) {
+            const std::size_t chunk = std::min(chunk_size, length - done);
+            if (!pread_fully(input, static_cast< int64_t >(done), buffer,
+                             chunk))
+                throw store::error(F("Failed to read file to append to "
+                                     "segment %s") % path);
+            write(buffer, chunk);
+            done += chunk;
+        }
+    }
+};
+
+
+/// Prepares to append to a segment file.
+///
+/// \param path Path to the segment, which is only created by the first append.
+store::detail::segment_writer::segment_writer(const fs::path& path) :
+    _pimpl(new impl(path))
+{
+}
+
+
+/// Closes the segment file.
+///
+/// Appended contents that were not synced yet are not flushed.
+store::detail::segment_writer::~segment_writer(void)
+{
+}
+
+
+/// Appends contents held in memory to the segment.
+///
+/// \param codec The codec with which the contents are encoded.
+/// \param data The encoded contents.
+/// \param length The length of data in bytes.
+///
+/// \return The reference to the appended contents.
+///
+/// \throw store::error If the segment cannot be written to.
+store::detail::segment_ref
+store::detail::segment_writer::append(const std::string& codec,
+                                      const char* data,
+                                      const std::size_t length)
+{
+    _pimpl->open();
+
+    segment_ref ref;
+    ref.codec = codec;
+    ref.offset = _pimpl->end;
+    ref.length = static_cast< int64_t >(length);
+    _pimpl->write(data, length);
+    return ref;
+}
+
+
+/// Appends the whole contents of an open file to the segment.
+///
+/// This avoids bringing the contents into user space when the kernel can copy
+/// them on its own.
+///
+/// \param codec The codec with which the contents are encoded.
+/// \param input Descriptor of the file holding the encoded contents.
+/// \param length The length of the file in bytes.
+///
+/// \return The reference to the appended contents.
+///
+/// \throw store::error If the file cannot be read or the segment cannot be
+///     written to.
+store::detail::segment_ref
+store::detail::segment_writer::append(const std::string& codec,
+                                      const int input,
+                                      const std::size_t length)
+{
+    _pimpl->open();
+
+    segment_ref ref;
+    ref.codec = codec;
+    ref.offset = _pimpl->end;
+    ref.length = static_cast< int64_t >(length);
+    _pimpl->copy(input, length);
+    return ref;
+}
+
+
+/// Appends contents read from a stream to the segment.
+///
+/// \param codec The codec with which the contents are encoded.
+/// \param input The stream from which to read the encoded contents.
+/// \param length The length of the contents in bytes.
+///
+/// \return The reference to the appended contents.
+///
+/// \throw store::error If the stream cannot be read or the segment cannot be
+///     written to.
+store::detail::segment_ref
+store::detail::segment_writer::append(const std::string& codec,
+                                      std::istream& input,
+                                      const std::size_t length)
+{
+    _pimpl->open();
+
+    segment_ref ref;
+    ref.codec = codec;
+    ref.offset = _pimpl->end;
+    ref.length = static_cast< int64_t >(length);
+
+    char buffer[chunk_size];
+    for (std::size_t pending = length; pending > 0; ) {
+        const std::size_t chunk = read_chunk(input, buffer, pending);
+        _pimpl->write(buffer, chunk);
+        pending -= chunk;
+    }
+    return ref;
+}
+
+
+/// Checks if contents in the segment match contents held in memory.
+///
+/// \param ref The reference to the contents in the segment.
+/// \param data The contents to compare to.
+/// \param length The length of data in bytes.
+///
+/// \return True if the contents are the same; false otherwise.
+///
+/// \throw store::error If the segment cannot be read.
+bool
+store::detail::segment_writer::same_contents(const segment_ref& ref,
+                                             const char* data,
+                                             const std::size_t length)
+{
+    if (ref.length != static_cast< int64_t >(length))
+        return false;
+    _pimpl->open();
+
+    char buffer[chunk_size];
+    for (std::size_t offset = 0; offset < length; ) {
+        const std::size_t chunk = std::min(chunk_size, length - offset);
+        if (!pread_fully(_pimpl->fd, ref.offset + offset, buffer, chunk)) {
+            LW(F("Segment %s is shorter than its references") % _pimpl->path);
+            return false;
+        }
+        if (!std::equal(buffer, buffer + chunk, data + offset))
+            return false;
+        offset += chunk;
+    }
+    return true;
+}
+
+
+/// Checks if contents in the segment match contents read from a stream.
+///
+/// The stream is rewound on exit.
+///
+/// \param ref The reference to the contents in the segment.
+/// \param input The stream from which to read the contents to compare to.
+/// \param length The length of the contents in bytes.
+///
+/// \return True if the contents are the same; false otherwise.
+///
+/// \throw store::error If the stream or the segment cannot be read.
+bool
+store::detail::segment_writer::same_contents(const segment_ref& ref,
+                                             std::istream& input,
+                                             const std::size_t length)
+{
+    if (ref.length != static_cast< int64_t >(length))
+        return false;
+    _pimpl->open();
+
+    bool same = true;
+    char stream_buffer[chunk_size];
+    char segment_buffer[chunk_size];
+    for (std::size_t offset = 0; same && offset < length; ) {
+        const std::size_t chunk = read_chunk(input, stream_buffer,
+                                             length - offset);
+        if (!pread_fully(_pimpl->fd, ref.offset + offset, segment_buffer,
+                         chunk)) {
+            LW(F("Segment %s is shorter than its references") % _pimpl->path);
+            same = false;
+        } else {
+            same = std::equal(stream_buffer, stream_buffer + chunk,
+                              segment_buffer);
+        }
+        offset += chunk;
+    }
+
+    input.clear();
+    input.seekg(0, std::ios::beg);
+    if (!input)
+        throw store::error("Failed to rewind file");
+    return same;
+}
+
+
+/// Makes the appended contents durable.
+///
+/// \throw store::error If the segment cannot be synced.
+void
+store::detail::segment_writer::sync(void)
+{
+    if (!_pimpl->dirty)
+        return;
+    if (::fsync(_pimpl->fd) == -1) {
+        const int original_errno = errno;
+        throw store::error(F("Failed to sync segment file %s: %s") %
+                           _pimpl->path % std::strerror(original_errno));
+    }
+    _pimpl->dirty = false;
+}
+
+
+/// Moves the contents of files stored in a segment into the database.
+///
+/// This has to run within a transaction.  Once it is committed, the database
+/// no longer needs the segment.
+///
+/// \param db The database that holds the files.
+/// \param schema The name of the database, as known to SQLite, that holds the
+///     files table to process.
+/// \param segment Path to the segment that the references point to.
+/// \param min_file_id Lowest identifier of the files to process.
+///
+/// \return The number of files whose contents were moved.
+///
+/// \throw integrity_error If a reference is invalid or the segment cannot be
+///     read.
+/// \throw sqlite::error If the database cannot be updated.
+std::size_t
+store::detail::fold_segment(sqlite::database& db, const std::string& schema,
+                            const fs::path& segment, const int64_t min_file_id)
+{
+    std::vector< std::pair< int64_t, segment_ref > > files;
+    {
+        sqlite::statement stmt = db.create_statement(
+            F("SELECT file_id, contents FROM %s.files "
+              "WHERE codec == :codec AND file_id >= :min_file_id") % schema);
+        stmt.bind(":codec", codec_segment);
+        stmt.bind(":min_file_id", min_file_id);
+        while (stmt.step()) {
+            const sqlite::blob ref = stmt.safe_column_blob("contents");
+            files.push_back(std::make_pair(
+                stmt.safe_column_int64("file_id"),
+                parse_segment_ref(ref.memory, ref.size)));
+        }
+    }
+    if (files.empty())
+        return 0;
+
+    LI(F("Moving the contents of %s files from segment %s into the database")
+       % files.size() % segment);
+    segment_reader reader(segment);
+    sqlite::statement stmt = db.create_statement(
+        F("UPDATE %s.files SET contents = :contents, codec = :codec "
+          "WHERE file_id == :file_id") % schema);
+    for (std::vector< std::pair< int64_t, segment_ref > >::const_iterator
+             iter = files.begin(); iter != files.end(); ++iter) {
+        const segment_ref& ref = (*iter).second;
+        std::string contents(static_cast< std::size_t >(ref.length), '\0');
+        if (!contents.empty())
+            reader.read(ref, 0, &contents[0], contents.length());
+
+        stmt.bind(":contents", sqlite::blob(contents.data(),
+                                            static_cast< int >(
+                                                contents.length())));
+        stmt.bind(":codec", ref.codec);
+        stmt.bind(":file_id", (*iter).first);
+        stmt.step_without_results();
+        stmt.reset();
+    }
+    return files.size();
+}
@@ -0,0 +1,126 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// \file store/segment.hpp
+/// Storage of the contents of large files outside of the results database.
+///
+/// The contents of files can be appended to a segment file that sits next to
+/// the results database, in which case the files table only holds a reference
+/// to them.  This keeps large outputs out of the pages and the journal of the
+/// database.
+
+#if !defined(STORE_SEGMENT_HPP)
+#define STORE_SEGMENT_HPP
+
+extern "C" {
+#include <stdint.h>
+}
+
+#include <cstddef>
+#include <istream>
+#include <memory>
+#include <string>
+
+#include "utils/fs/path_fwd.hpp"
+#include "utils/noncopyable.hpp"
+#include "utils/sqlite/database_fwd.hpp"
+
+namespace store {
+
+
+namespace detail {
+
+
+extern const char* const codec_segment;
+
+
+/// Location of some encoded contents within a segment file.
+struct segment_ref {
+    /// Codec with which the contents are encoded in the segment.
+    std::string codec;
+
+    /// Position of the first byte of the contents in the segment.
+    int64_t offset;
+
+    /// Length of the encoded contents in bytes.
+    int64_t length;
+};
+
+
+utils::fs::path segment_path(const utils::fs::path&);
+std::string format_segment_ref(const segment_ref&);
+segment_ref parse_segment_ref(const void*, const std::size_t);
+
+
+/// Random-access reader of a segment file.
+class segment_reader : utils::noncopyable {
+    /// File descriptor of the segment.
+    int _fd;
+
+public:
+    explicit segment_reader(const utils::fs::path&);
+    ~segment_reader(void);
+
+    void read(const segment_ref&, const int64_t, char*, const std::size_t);
+};
+
+
+/// Appender of contents to a segment file.
+///
+/// The segment is created on the first append.  Appended contents are made
+/// durable by sync(), which has to happen before the database rows that
+/// reference them are committed.
+class segment_writer : utils::noncopyable {
+    struct impl;
+
+    /// Pointer to the internal implementation.
+    std::auto_ptr< impl > _pimpl;
+
+public:
+    explicit segment_writer(const utils::fs::path&);
+    ~segment_writer(void);
+
+    segment_ref append(const std::string&, const char*, const std::size_t);
+    segment_ref append(const std::string&, const int, const std::size_t);
+    segment_ref append(const std::string&, std::istream&, const std::size_t);
+    bool same_contents(const segment_ref&, const char*, const std::size_t);
+    bool same_contents(const segment_ref&, std::istream&, const std::size_t);
+    void sync(void);
+};
+
+
+std::size_t fold_segment(utils::sqlite::database&, const std::string&,
+                         const utils::fs::path&, const int64_t);
+
+
+}  // namespace detail
+
+
+}  // namespace store
+
+#endif  // !defined(STORE_SEGMENT_HPP)
@@ -0,0 +1,208 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "store/segment.hpp"
+
+extern "C" {
+#include <fcntl.h>
+#include <unistd.h>
+}
+
+#include <cstring>
+#include <sstream>
+#include <string>
+
+#include <atf-c++.hpp>
+
+#include "store/exceptions.hpp"
+#include "utils/fs/path.hpp"
+
+namespace fs = utils::fs;
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(segment_path);
+ATF_TEST_CASE_BODY(segment_path)
+{
+    ATF_REQUIRE_EQ(fs::path("/a/results.db-files"),
+                   store::detail::segment_path(fs::path("/a/results.db")));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(segment_ref__format_and_parse);
+ATF_TEST_CASE_BODY(segment_ref__format_and_parse)
+{
+    store::detail::segment_ref ref;
+    ref.codec = "zlib";
+    ref.offset = 1234;
+    ref.length = 56;
+
+    const std::string text = store::detail::format_segment_ref(ref);
+    ATF_REQUIRE_EQ("zlib 1234 56", text);
+
+    const store::detail::segment_ref parsed =
+        store::detail::parse_segment_ref(text.data(), text.length());
+    ATF_REQUIRE_EQ("zlib", parsed.codec);
+    ATF_REQUIRE_EQ(1234, parsed.offset);
+    ATF_REQUIRE_EQ(56, parsed.length);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(segment_ref__parse_invalid);
+ATF_TEST_CASE_BODY(segment_ref__parse_invalid)
+{
+    const char* invalid[] = { "", "none", "none 1", "none 1 2 3", "none -1 2",
+                              "none 1 -2", "none a 2", NULL };
+    for (const char** text = invalid; *text != NULL; ++text) {
+        ATF_REQUIRE_THROW_RE(store::integrity_error,
+                             "Invalid segment reference",
+                             store::detail::parse_segment_ref(
+                                 *text, std::strlen(*text)));
+    }
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(writer_and_reader);
+ATF_TEST_CASE_BODY(writer_and_reader)
+{
+    store::detail::segment_ref first, second;
+    {
+        store::detail::segment_writer writer(fs::path("test-files"));
+        first = writer.append("none", "first contents", 14);
+        std::istringstream input("second");
+        second = writer.append("zlib", input, 6);
+        writer.sync();
+    }
+    ATF_REQUIRE_EQ("none", first.codec);
+    ATF_REQUIRE_EQ(0, first.offset);
+    ATF_REQUIRE_EQ(14, first.length);
+    ATF_REQUIRE_EQ("zlib", second.codec);
+    ATF_REQUIRE_EQ(14, second.offset);
+    ATF_REQUIRE_EQ(6, second.length);
+
+    store::detail::segment_reader reader(fs::path("test-files"));
+    char buffer[8];
+    reader.read(first, 6, buffer, 8);
+    ATF_REQUIRE_EQ("contents", std::string(buffer, 8));
+    reader.read(second, 0, buffer, 6);
+    ATF_REQUIRE_EQ("second", std::string(buffer, 6));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(writer__append_file);
+ATF_TEST_CASE_BODY(writer__append_file)
+{
+    // Use a size that is not a multiple of the chunk size used internally.
+    std::string contents;
+    for (int i = 0; i < 300000; ++i)
+        contents += static_cast< char >('a' + i % 26);
+    atf::utils::create_file("input.txt", contents);
+
+    store::detail::segment_writer writer(fs::path("test-files"));
+    (void)writer.append("none", "head", 4);
+    const int fd = ::open("input.txt", O_RDONLY);
+    ATF_REQUIRE(fd != -1);
+    const store::detail::segment_ref ref = writer.append("none", fd,
+                                                         contents.length());
+    ::close(fd);
+    writer.sync();
+    ATF_REQUIRE_EQ(4, ref.offset);
+    ATF_REQUIRE_EQ(static_cast< int64_t >(contents.length()), ref.length);
+
+    ATF_REQUIRE(writer.same_contents(ref, contents.data(), contents.length()));
+    ATF_REQUIRE(atf::utils::compare_file("test-files", "head" + contents));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(writer__append_existing);
+ATF_TEST_CASE_BODY(writer__append_existing)
+{
+    atf::utils::create_file("test-files", "leftover");
+
+    store::detail::segment_writer writer(fs::path("test-files"));
+    const store::detail::segment_ref ref = writer.append("none", "new", 3);
+    writer.sync();
+    ATF_REQUIRE_EQ(8, ref.offset);
+    ATF_REQUIRE(atf::utils::compare_file("test-files", "leftovernew"));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(writer__same_contents);
+ATF_TEST_CASE_BODY(writer__same_contents)
+{
+    store::detail::segment_writer writer(fs::path("test-files"));
+    const store::detail::segment_ref ref = writer.append("none", "abcdef", 6);
+
+    ATF_REQUIRE(writer.same_contents(ref, "abcdef", 6));
+    ATF_REQUIRE(!writer.same_contents(ref, "abcdeX", 6));
+    ATF_REQUIRE(!writer.same_contents(ref, "abcde", 5));
+
+    std::istringstream same("abcdef");
+    ATF_REQUIRE(writer.same_contents(ref, same, 6));
+    ATF_REQUIRE_EQ(0, same.tellg());
+    std::istringstream different("Xbcdef");
+    ATF_REQUIRE(!writer.same_contents(ref, different, 6));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(reader__missing);
+ATF_TEST_CASE_BODY(reader__missing)
+{
+    ATF_REQUIRE_THROW_RE(store::integrity_error, "Cannot open segment",
+                         store::detail::segment_reader(fs::path("missing")));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(reader__truncated);
+ATF_TEST_CASE_BODY(reader__truncated)
+{
+    atf::utils::create_file("test-files", "short");
+
+    store::detail::segment_ref ref;
+    ref.codec = "none";
+    ref.offset = 2;
+    ref.length = 10;
+
+    store::detail::segment_reader reader(fs::path("test-files"));
+    char buffer[10];
+    ATF_REQUIRE_THROW_RE(store::integrity_error, "missing 10 bytes",
+                         reader.read(ref, 0, buffer, 10));
+}
+
+
+ATF_INIT_TEST_CASES(tcs)
+{
+    ATF_ADD_TEST_CASE(tcs, segment_path);
+    ATF_ADD_TEST_CASE(tcs, segment_ref__format_and_parse);
+    ATF_ADD_TEST_CASE(tcs, segment_ref__parse_invalid);
+    ATF_ADD_TEST_CASE(tcs, writer_and_reader);
+    ATF_ADD_TEST_CASE(tcs, writer__append_file);
+    ATF_ADD_TEST_CASE(tcs, writer__append_existing);
+    ATF_ADD_TEST_CASE(tcs, writer__same_contents);
+    ATF_ADD_TEST_CASE(tcs, reader__missing);
+    ATF_ADD_TEST_CASE(tcs, reader__truncated);
+}
@@ -0,0 +1,719 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "store/snapshot.hpp"
+
+extern "C" {
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <unistd.h>
+}
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <utility>
+#include <vector>
+
+#include "model/test_result.hpp"
+#include "store/dbtypes.hpp"
+#include "store/exceptions.hpp"
+#include "store/read_backend.hpp"
+#include "store/read_transaction.hpp"
+#include "utils/format/macros.hpp"
+#include "utils/fs/path.hpp"
+#include "utils/logging/macros.hpp"
+#include "utils/noncopyable.hpp"
+#include "utils/optional.ipp"
+#include "utils/sanity.hpp"
+#include "utils/sqlite/database.hpp"
+#include "utils/sqlite/exceptions.hpp"
+#include "utils/sqlite/statement.ipp"
+
+namespace datetime = utils::datetime;
+namespace fs = utils::fs;
+namespace sqlite = utils::sqlite;
+
+
+namespace {
+
+
+/// Magic string at the beginning of every snapshot.
+static const char snapshot_magic[8] = {
+    'K', 'Y', 'U', 'A', 'S', 'N', 'A', 'P' };
+
+
+/// Version of the format of the snapshots.
+static const uint32_t snapshot_version = 1;
+
+
+/// Value stored in the header to detect snapshots of other byte orders.
+static const uint32_t byte_order_mark = 0x01020304;
+
+
+/// Dictionary of the result types, indexed by their code in a snapshot.
+///
+/// The codes are part of the file format, so new types must be appended.
+static const model::test_result_type result_types[] = {
+    model::test_result_broken,
+    model::test_result_expected_failure,
+    model::test_result_failed,
+    model::test_result_passed,
+    model::test_result_skipped,
+};
+
+
+/// Number of entries in result_types.
+static const std::size_t num_result_types =
+    sizeof(result_types) / sizeof(result_types[0]);
+
+
+/// Fixed-size header at the beginning of a snapshot.
+struct header {
+    /// Must match snapshot_magic.
+    char magic[8];
+
+    /// Must match snapshot_version.
+    uint32_t version;
+
+    /// Must match byte_order_mark.
+    uint32_t byte_order;
+
+    /// Number of results in the snapshot.
+    uint64_t rows;
+
+    /// Number of entries in the table of unique strings.
+    uint64_t strings;
+
+    /// Size in bytes of the contents of all strings.
+    uint64_t strings_size;
+
+    /// Start time, in microseconds, that the start times are relative to.
+    int64_t base_time;
+};
+
+
+/// Rounds a size up so that the section that follows it is aligned.
+///
+/// \param size The size to round.
+///
+/// \return The rounded size.
+static std::size_t
+align(const std::size_t size)
+{
+    return (size + 7) & ~static_cast< std::size_t >(7);
+}
+
+
+/// Offsets of the columns of a snapshot from the beginning of the file.
+///
+/// Every column is aligned to 8 bytes so that it can be accessed in place once
+/// the file is memory-mapped.
+struct sections {
+    /// Offsets to the contents of every string, plus one to their end.
+    std::size_t string_offsets;
+
+    /// Start times relative to the base time, in microseconds.
+    std::size_t start_times;
+
+    /// Durations, in microseconds.
+    std::size_t durations;
+
+    /// Index of the relative path of the test program of every result.
+    std::size_t test_programs;
+
+    /// Index of the name of the test case of every result.
+    std::size_t test_cases;
+
+    /// Code of the type of every result.
+    std::size_t result_types;
+
+    /// Contents of all strings, each followed by a nul character.
+    std::size_t strings;
+
+    /// Expected size of the whole file.
+    std::size_t total;
+
+    /// Computes the offsets of the columns.
+    ///
+    /// \param h The header of the snapshot.
+    explicit sections(const header& h)
+    {
+        const std::size_t rows = static_cast< std::size_t >(h.rows);
+        string_offsets = align(sizeof(header));
+        start_times = string_offsets + align(
+            (static_cast< std::size_t >(h.strings) + 1) * sizeof(uint64_t));
+        durations = start_times + align(rows * sizeof(int64_t));
+        test_programs = durations + align(rows * sizeof(int64_t));
+        test_cases = test_programs + align(rows * sizeof(uint32_t));
+        result_types = test_cases + align(rows * sizeof(uint32_t));
+        strings = result_types + align(rows * sizeof(uint8_t));
+        total = strings + static_cast< std::size_t >(h.strings_size);
+    }
+};
+
+
+/// Table of unique strings being built for a new snapshot.
+class string_table {
+    /// Indexes of the strings already in the table.
+    std::map< std::string, uint32_t > _indexes;
+
+    /// Strings in the table, in the order in which they were added.
+    std::vector< std::string > _strings;
+
+public:
+    /// Gets the index of a string, adding it to the table if missing.
+    ///
+    /// \param str The string to look up.
+    ///
+    /// \return The index of the string in the table.
+    uint32_t
+    intern(const std::string& str)
+    {
+        const std::map< std::string, uint32_t >::const_iterator iter =
+            _indexes.find(str);
+        if (iter != _indexes.end())
+            return (*iter).second;
+        const uint32_t index = static_cast< uint32_t >(_strings.size());
+        _indexes.insert(std::make_pair(str, index));
+        _strings.push_back(str);
+        return index;
+    }
+
+    /// Gets the strings in the table.
+    ///
+    /// \return The strings, in the order of their indexes.
+    const std::vector< std::string >&
+    strings(void) const
+    {
+        return _strings;
+    }
+};
+
+
+/// Writes a column of fixed-width values followed by its alignment padding.
+///
+/// \param output The stream to write to.
+/// \param values The values to write.
+template< typename Type >
+static void
+write_column(std::ofstream& output, const std::vector< Type >& values)
+{
+    const std::size_t size = values.size() * sizeof(Type);
+    if (size > 0)
+        output.write(reinterpret_cast< const char* >(&values[0]), size);
+    static const char padding[8] = { 0 };
+    output.write(padding, align(size) - size);
+}
+
+
+/// Gets the dictionary code of a result type.
+///
+/// \param type The result type to encode.
+///
+/// \return The code of the type.
+static uint8_t
+encode_result_type(const model::test_result_type type)
+{
+    for (std::size_t i = 0; i < num_result_types; ++i) {
+        if (result_types[i] == type)
+            return static_cast< uint8_t >(i);
+    }
+    UNREACHABLE;
+}
+
+
+}  // anonymous namespace
+
+
+/// Internal implementation for results_snapshot.
+struct store::results_snapshot::impl : utils::noncopyable {
+    /// Start of the memory-mapped file.
+    void* _data;
+
+    /// Size of the memory-mapped file.
+    std::size_t _size;
+
+    /// Header of the snapshot, at the start of the mapping.
+    const header* _header;
+
+    /// Offsets of the contents of every string within _strings.
+    const uint64_t* _string_offsets;
+
+    /// Start times of the results relative to the base time.
+    const int64_t* _start_times;
+
+    /// Durations of the results.
+    const int64_t* _durations;
+
+    /// Index of the test program of every result.
+    const uint32_t* _test_programs;
+
+    /// Index of the test case of every result.
+    const uint32_t* _test_cases;
+
+    /// Code of the type of every result.
+    const uint8_t* _result_types;
+
+    /// Contents of all strings.
+    const char* _strings;
+
+    /// Maps a snapshot into memory and validates it.
+    ///
+    /// \param file The snapshot to open.
+    ///
+    /// \throw store::error If the file cannot be mapped.
+    /// \throw store::integrity_error If the file is not a valid snapshot.
+    explicit impl(const fs::path& file) : _data(MAP_FAILED), _size(0)
+    {
+        const int fd = ::open(file.c_str(), O_RDONLY);
+        if (fd == -1) {
+            const int original_errno = errno;
+            throw store::error(F("Cannot open snapshot %s: %s") % file %
+                               std::strerror(original_errno));
+        }
+        struct ::stat sb;
+        if (::fstat(fd, &sb) == -1) {
+            const int original_errno = errno;
+            ::close(fd);
+            throw store::error(F("Cannot stat snapshot %s: %s") % file %
+                               std::strerror(original_errno));
+        }
+        if (static_cast< std::size_t >(sb.st_size) < sizeof(header)) {
+            ::close(fd);
+            throw store::integrity_error(F("Snapshot %s is truncated") % file);
+        }
+        _size = static_cast< std::size_t >(sb.st_size);
+        _data = ::mmap(NULL, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+        const int original_errno = errno;
+        ::close(fd);
+        if (_data == MAP_FAILED)
+            throw store::error(F("Cannot map snapshot %s: %s") % file %
+                               std::strerror(original_errno));
+
+        try {
+            validate(file);
+        } catch (...) {
+            ::munmap(_data, _size);
+            throw;
+        }
+    }
+
+    /// Unmaps the snapshot.
+    ~impl(void)
+    {
+        ::munmap(_data, _size);
+    }
+
+    /// Sets up the pointers to the columns and checks their contents.
+    ///
+    /// \param file The path to the snapshot, for error reporting purposes.
+    ///
+    /// \throw store::integrity_error If the snapshot is not valid.
+    void
+    validate(const fs::path& file)
+    {
+        const char* base = static_cast< const char* >(_data);
+        _header = reinterpret_cast< const header* >(base);
+        if (std::memcmp(_header->magic, snapshot_magic,
+                        sizeof(snapshot_magic)) != 0)
+            throw store::integrity_error(F("%s is not a snapshot") % file);
+        if (_header->byte_order != byte_order_mark)
+            throw store::integrity_error(F("Snapshot %s was created on a "
+                                           "machine of another byte order") %
+                                         file);
+        if (_header->version != snapshot_version)
+            throw store::integrity_error(F("Snapshot %s has unsupported "
+                                           "version %s") % file %
+                                         _header->version);
+        if (_header->rows > _size || _header->strings > _size ||
+            _header->strings_size > _size)
+            throw store::integrity_error(F("Snapshot %s is truncated") % file);
+        const sections offsets(*_header);
+        if (offsets.total != _size)
+            throw store::integrity_error(F("Snapshot %s is truncated") % file);
+
+        _string_offsets = reinterpret_cast< const uint64_t* >(
+            base + offsets.string_offsets);
+        _start_times = reinterpret_cast< const int64_t* >(
+            base + offsets.start_times);
+        _durations = reinterpret_cast< const int64_t* >(
+            base + offsets.durations);
+        _test_programs = reinterpret_cast< const uint32_t* >(
+            base + offsets.test_programs);
+        _test_cases = reinterpret_cast< const uint32_t* >(
+            base + offsets.test_cases);
+        _result_types = reinterpret_cast< const uint8_t* >(
+            base + offsets.result_types);
+        _strings = base + offsets.strings;
+
+        // Checking every index upfront keeps the accessors free of checks,
+        // and is a single sequential pass over the columns anyway.
+        if (_string_offsets[0] != 0 ||
+            _string_offsets[_header->strings] != _header->strings_size)
+            throw store::integrity_error(F("Snapshot %s has an invalid "
+                                           "string table") % file);
+        for (uint64_t i = 0; i < _header->strings; ++i) {
+            if (_string_offsets[i] >= _string_offsets[i + 1] ||
+                _string_offsets[i + 1] > _header->strings_size ||
+                _strings[_string_offsets[i + 1] - 1] != '\0')
+                throw store::integrity_error(F("Snapshot %s has an invalid "
+                                               "string table") % file);
+        }
+        for (uint64_t i = 0; i < _header->rows; ++i) {
+            if (_test_programs[i] >= _header->strings ||
+                _test_cases[i] >= _header->strings ||
+                _result_types[i] >= num_result_types)
+                throw store::integrity_error(F("Snapshot %s has an invalid "
+                                               "result in row %s") % file % i);
+        }
+    }
+
+    /// Gets a string from the table of unique strings.
+    ///
+    /// \param index The index of the string.
+    ///
+    /// \return The string.
+    std::string
+    string(const uint32_t index) const
+    {
+        return std::string(_strings + _string_offsets[index],
+                           _string_offsets[index + 1] -
+                           _string_offsets[index] - 1);
+    }
+};
+
+
+/// Constructor.
+///
+/// \param pimpl_ The internal implementation of the snapshot.
+store::results_snapshot::results_snapshot(impl* pimpl_) : _pimpl(pimpl_)
+{
+}
+
+
+/// Destructor.
+store::results_snapshot::~results_snapshot(void)
+{
+}
+
+
+/// Creates the snapshot of a results file.
+///
+/// The snapshot is first written to a temporary file and then moved into
+/// place so that concurrent readers never observe partial snapshots.
+///
+/// \param results_file The results file to read.
+/// \param snapshot The path to the snapshot to create.  Any existing file is
+///     replaced.
+///
+/// \throw store::error If the results file cannot be read or if the snapshot
+///     cannot be written.
+void
+store::results_snapshot::create(const fs::path& results_file,
+                                const fs::path& snapshot)
+{
+    std::vector< int64_t > start_times;
+    std::vector< int64_t > durations;
+    std::vector< uint32_t > test_programs;
+    std::vector< uint32_t > test_cases;
+    std::vector< uint8_t > types;
+    string_table strings;
+
+    read_backend backend = read_backend::open_ro(results_file);
+    try {
+        sqlite::statement stmt = backend.database().create_statement(
+            "SELECT test_programs.relative_path, test_cases.name, "
+            "    test_results.result_type, test_results.start_time, "
+            "    test_results.end_time "
+            "FROM test_results "
+            "    NATURAL JOIN test_cases "
+            "    JOIN test_programs "
+            "        ON test_cases.test_program_id = "
+            "            test_programs.test_program_id "
+            "ORDER BY test_results.test_case_id");
+        while (stmt.step()) {
+            test_programs.push_back(strings.intern(stmt.column_text(0)));
+            test_cases.push_back(strings.intern(stmt.column_text(1)));
+            types.push_back(encode_result_type(
+                column_test_result_type(stmt, "result_type")));
+            int64_t times[2];
+            column_timestamps(stmt, 3, 2, times);
+            if (times[1] < times[0])
+                throw store::integrity_error(F("Result of %s:%s ends before "
+                                               "it starts") %
+                                             stmt.column_text(0) %
+                                             stmt.column_text(1));
+            start_times.push_back(times[0]);
+            durations.push_back(times[1] - times[0]);
+        }
+    } catch (const sqlite::error& e) {
+        backend.close();
+        throw store::error(F("Cannot read results file %s: %s") %
+                           results_file % e.what());
+    }
+    backend.close();
+
+    header h;
+    std::memcpy(h.magic, snapshot_magic, sizeof(snapshot_magic));
+    h.version = snapshot_version;
+    h.byte_order = byte_order_mark;
+    h.rows = types.size();
+    h.strings = strings.strings().size();
+    h.base_time = 0;
+    for (std::vector< int64_t >::const_iterator iter = start_times.begin();
+         iter != start_times.end(); ++iter) {
+        if (iter == start_times.begin() || *iter < h.base_time)
+            h.base_time = *iter;
+    }
+    for (std::vector< int64_t >::iterator iter = start_times.begin();
+         iter != start_times.end(); ++iter)
+        *iter -= h.base_time;
+
+    std::vector< uint64_t > string_offsets;
+    string_offsets.reserve(strings.strings().size() + 1);
+    uint64_t offset = 0;
+    for (std::vector< std::string >::const_iterator iter =
+             strings.strings().begin(); iter != strings.strings().end();
+         ++iter) {
+        string_offsets.push_back(offset);
+        offset += (*iter).length() + 1;
+    }
+    string_offsets.push_back(offset);
+    h.strings_size = offset;
+
+    const fs::path temp(F("%s.%s") % snapshot % ::getpid());
+    std::ofstream output(temp.c_str(), std::ios::binary);
+    if (!output)
+        throw store::error(F("Cannot create snapshot %s") % temp);
+    output.write(reinterpret_cast< const char* >(&h), sizeof(h));
+    static const char padding[8] = { 0 };
+    output.write(padding, align(sizeof(h)) - sizeof(h));
+    write_column(output, string_offsets);
+    write_column(output, start_times);
+    write_column(output, durations);
+    write_column(output, test_programs);
+    write_column(output, test_cases);
+    write_column(output, types);
+    for (std::vector< std::string >::const_iterator iter =
+             strings.strings().begin(); iter != strings.strings().end();
+         ++iter)
+        output.write((*iter).c_str(), (*iter).length() + 1);
+    output.close();
+    if (!output) {
+        ::unlink(temp.c_str());
+        throw store::error(F("Failed to write snapshot %s") % temp);
+    }
+
+    if (std::rename(temp.c_str(), snapshot.c_str()) == -1) {
+        const int original_errno = errno;
+        ::unlink(temp.c_str());
+        throw store::error(F("Cannot rename %s to %s: %s") % temp % snapshot %
+                           std::strerror(original_errno));
+    }
+    LI(F("Created snapshot %s of results file %s with %s results") %
+       snapshot % results_file % h.rows);
+}
+
+
+/// Opens a snapshot.
+///
+/// \param file The snapshot to open.
+///
+/// \return The memory-mapped snapshot.
+///
+/// \throw store::error If the file cannot be opened or is not a valid
+///     snapshot.
+store::results_snapshot
+store::results_snapshot::open(const fs::path& file)
+{
+    return results_snapshot(new impl(file));
+}
+
+
+/// Opens the snapshot of a results file, creating it if necessary.
+///
+/// The snapshot is recreated if it does not exist, if it is older than the
+/// results file, as happens when the results file is compacted, or if it is
+/// not valid.
+///
+/// \param results_file The results file the snapshot belongs to.
+/// \param snapshot The path to the snapshot.
+///
+/// \return The memory-mapped snapshot.
+///
+/// \throw store::error If the snapshot cannot be created or opened.
+store::results_snapshot
+store::results_snapshot::open_or_create(const fs::path& results_file,
+                                        const fs::path& snapshot)
+{
+    struct ::stat results_sb;
+    if (::stat(results_file.c_str(), &results_sb) == -1) {
+        const int original_errno = errno;
+        throw store::error(F("Cannot stat results file %s: %s") %
+                           results_file % std::strerror(original_errno));
+    }
+
+    struct ::stat snapshot_sb;
+    if (::stat(snapshot.c_str(), &snapshot_sb) != -1 &&
+        snapshot_sb.st_mtime >= results_sb.st_mtime) {
+        try {
+            return open(snapshot);
+        } catch (const store::error& e) {
+            LW(F("Recreating invalid snapshot %s: %s") % snapshot % e.what());
+        }
+    }
+
+    create(results_file, snapshot);
+    return open(snapshot);
+}
+
+
+/// Gets the number of results in the snapshot.
+///
+/// \return The number of results.
+std::size_t
+store::results_snapshot::size(void) const
+{
+    return static_cast< std::size_t >(_pimpl->_header->rows);
+}
+
+
+/// Gets the test program of a result.
+///
+/// \param i The index of the result; must be lower than size().
+///
+/// \return The relative path to the test program.
+fs::path
+store::results_snapshot::test_program(const std::size_t i) const
+{
+    PRE(i < size());
+    return fs::path(_pimpl->string(_pimpl->_test_programs[i]));
+}
+
+
+/// Gets the name of the test case of a result.
+///
+/// \param i The index of the result; must be lower than size().
+///
+/// \return The name of the test case.
+std::string
+store::results_snapshot::test_case_name(const std::size_t i) const
+{
+    PRE(i < size());
+    return _pimpl->string(_pimpl->_test_cases[i]);
+}
+
+
+/// Gets the type of a result.
+///
+/// \param i The index of the result; must be lower than size().
+///
+/// \return The result type.
+model::test_result_type
+store::results_snapshot::result_type(const std::size_t i) const
+{
+    PRE(i < size());
+    return result_types[_pimpl->_result_types[i]];
+}
+
+
+/// Gets the start time of a result.
+///
+/// \param i The index of the result; must be lower than size().
+///
+/// \return The start time of the test case.
+datetime::timestamp
+store::results_snapshot::start_time(const std::size_t i) const
+{
+    PRE(i < size());
+    return datetime::timestamp::from_microseconds(
+        _pimpl->_header->base_time + _pimpl->_start_times[i]);
+}
+
+
+/// Gets the duration of a result.
+///
+/// \param i The index of the result; must be lower than size().
+///
+/// \return The duration of the test case.
+datetime::delta
+store::results_snapshot::duration(const std::size_t i) const
+{
+    PRE(i < size());
+    return datetime::delta::from_microseconds(_pimpl->_durations[i]);
+}
+
+
+/// Aggregates all the results in the snapshot.
+///
+/// This only scans the columns of the result types and times, without
+/// decoding any string.
+///
+/// \return The summary of the results.
+store::results_summary
+store::results_snapshot::summarize(void) const
+{
+    const std::size_t rows = size();
+
+    std::size_t counts[num_result_types] = { 0 };
+    int64_t total_duration = 0;
+    int64_t first_start = 0;
+    int64_t last_end = 0;
+    for (std::size_t i = 0; i < rows; ++i) {
+        ++counts[_pimpl->_result_types[i]];
+        const int64_t start = _pimpl->_start_times[i];
+        const int64_t duration = _pimpl->_durations[i];
+        total_duration += duration;
+        if (i == 0 || start < first_start)
+            first_start = start;
+        if (i == 0 || start + duration > last_end)
+            last_end = start + duration;
+    }
+
+    results_summary summary;
+    for (std::size_t i = 0; i < num_result_types; ++i) {
+        if (counts[i] > 0)
+            summary.counts[result_types[i]] = counts[i];
+    }
+    summary.total_duration = datetime::delta::from_microseconds(
+        total_duration);
+    if (rows > 0) {
+        const int64_t base_time = _pimpl->_header->base_time;
+        summary.start_time = datetime::timestamp::from_microseconds(
+            base_time + first_start);
+        summary.end_time = datetime::timestamp::from_microseconds(
+            base_time + last_end);
+    }
+    return summary;
+}
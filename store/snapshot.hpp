@@ -0,0 +1,91 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+/// \file store/snapshot.hpp
+/// Columnar snapshots of results files for fast whole-run analysis.
+///
+/// Reading the results of a run through the results file costs a query step
+/// and several allocations per test case, which dominates any report that only
+/// aggregates the results of many runs.  A snapshot holds the same results,
+/// minus their outputs and metadata, as fixed-width columns in a single file
+/// that is memory-mapped on open: the result types are stored as one byte
+/// each, the times as 64-bit integers and the names of the test programs and
+/// test cases as indexes into a table of unique strings.  Like the trends
+/// index, snapshots are derived data and can be regenerated at any time from
+/// their results files.
+
+#if !defined(STORE_SNAPSHOT_HPP)
+#define STORE_SNAPSHOT_HPP
+
+#include "store/snapshot_fwd.hpp"
+
+#include <cstddef>
+#include <string>
+
+#include "model/test_result_fwd.hpp"
+#include "store/read_transaction_fwd.hpp"
+#include "utils/datetime.hpp"
+#include "utils/fs/path_fwd.hpp"
+#include "utils/optional.hpp"
+#include "utils/shared_ptr.hpp"
+
+namespace store {
+
+
+/// Read-only, memory-mapped columnar copy of the results of a run.
+class results_snapshot {
+    struct impl;
+
+    /// Pointer to the shared internal implementation.
+    std::shared_ptr< impl > _pimpl;
+
+    results_snapshot(impl*);
+
+public:
+    ~results_snapshot(void);
+
+    static void create(const utils::fs::path&, const utils::fs::path&);
+    static results_snapshot open(const utils::fs::path&);
+    static results_snapshot open_or_create(const utils::fs::path&,
+                                           const utils::fs::path&);
+
+    std::size_t size(void) const;
+    utils::fs::path test_program(const std::size_t) const;
+    std::string test_case_name(const std::size_t) const;
+    model::test_result_type result_type(const std::size_t) const;
+    utils::datetime::timestamp start_time(const std::size_t) const;
+    utils::datetime::delta duration(const std::size_t) const;
+
+    results_summary summarize(void) const;
+};
+
+
+}  // namespace store
+
+#endif  // !defined(STORE_SNAPSHOT_HPP)
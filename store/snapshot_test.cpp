@@ -0,0 +1,332 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "store/snapshot.hpp"
+
+#include <fstream>
+#include <map>
+#include <string>
+
+#include <atf-c++.hpp>
+
+#include "model/context.hpp"
+#include "model/metadata.hpp"
+#include "model/test_program.hpp"
+#include "model/test_result.hpp"
+#include "store/exceptions.hpp"
+#include "store/read_transaction.hpp"
+#include "store/write_backend.hpp"
+#include "store/write_transaction.hpp"
+#include "utils/datetime.hpp"
+#include "utils/fs/path.hpp"
+#include "utils/logging/operations.hpp"
+#include "utils/optional.ipp"
+
+namespace datetime = utils::datetime;
+namespace fs = utils::fs;
+namespace logging = utils::logging;
+
+
+namespace {
+
+
+/// Creates a results file with three test cases in two test programs.
+///
+/// \param file The results file to create.
+static void
+create_results(const char* file)
+{
+    store::write_backend backend = store::write_backend::open_rw(
+        fs::path(file));
+    store::write_transaction tx = backend.start_write();
+
+    tx.put_context(model::context(fs::path("/the/cwd"),
+                                  std::map< std::string, std::string >()));
+
+    const model::test_program program1 = model::test_program_builder(
+        "plain", fs::path("dir/prog1"), fs::path("/the/root"), "suite")
+        .add_test_case("main")
+        .build();
+    const model::test_program program2 = model::test_program_builder(
+        "atf", fs::path("prog2"), fs::path("/the/root"), "suite")
+        .add_test_case("main")
+        .add_test_case("other")
+        .build();
+    const int64_t tp1_id = tx.put_test_program(program1);
+    const int64_t tp2_id = tx.put_test_program(program2);
+
+    const int64_t tc1_id = tx.put_test_case(program1, "main", tp1_id);
+    tx.put_result(model::test_result(model::test_result_passed), tc1_id,
+                  datetime::timestamp::from_microseconds(1000000),
+                  datetime::timestamp::from_microseconds(1500000));
+
+    const int64_t tc2_id = tx.put_test_case(program2, "main", tp2_id);
+    tx.put_result(model::test_result(model::test_result_failed, "Oops"),
+                  tc2_id,
+                  datetime::timestamp::from_microseconds(1200000),
+                  datetime::timestamp::from_microseconds(3200000));
+
+    const int64_t tc3_id = tx.put_test_case(program2, "other", tp2_id);
+    tx.put_result(model::test_result(model::test_result_passed), tc3_id,
+                  datetime::timestamp::from_microseconds(900000),
+                  datetime::timestamp::from_microseconds(1000000));
+
+    tx.commit();
+    backend.close();
+}
+
+
+}  // anonymous namespace
+
+
+ATF_TEST_CASE(create_and_open);
+ATF_TEST_CASE_HEAD(create_and_open)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(create_and_open)
+{
+    create_results("test.db");
+    store::results_snapshot::create(fs::path("test.db"), fs::path("test.snap"));
+
+    const store::results_snapshot snapshot = store::results_snapshot::open(
+        fs::path("test.snap"));
+    ATF_REQUIRE_EQ(3, snapshot.size());
+
+    ATF_REQUIRE_EQ(fs::path("dir/prog1"), snapshot.test_program(0));
+    ATF_REQUIRE_EQ("main", snapshot.test_case_name(0));
+    ATF_REQUIRE_EQ(model::test_result_passed, snapshot.result_type(0));
+    ATF_REQUIRE_EQ(datetime::timestamp::from_microseconds(1000000),
+                   snapshot.start_time(0));
+    ATF_REQUIRE_EQ(datetime::delta(0, 500000), snapshot.duration(0));
+
+    ATF_REQUIRE_EQ(fs::path("prog2"), snapshot.test_program(1));
+    ATF_REQUIRE_EQ("main", snapshot.test_case_name(1));
+    ATF_REQUIRE_EQ(model::test_result_failed, snapshot.result_type(1));
+    ATF_REQUIRE_EQ(datetime::timestamp::from_microseconds(1200000),
+                   snapshot.start_time(1));
+    ATF_REQUIRE_EQ(datetime::delta(2, 0), snapshot.duration(1));
+
+    ATF_REQUIRE_EQ(fs::path("prog2"), snapshot.test_program(2));
+    ATF_REQUIRE_EQ("other", snapshot.test_case_name(2));
+    ATF_REQUIRE_EQ(model::test_result_passed, snapshot.result_type(2));
+    ATF_REQUIRE_EQ(datetime::timestamp::from_microseconds(900000),
+                   snapshot.start_time(2));
+    ATF_REQUIRE_EQ(datetime::delta(0, 100000), snapshot.duration(2));
+}
+
+
+ATF_TEST_CASE(create__replace);
+ATF_TEST_CASE_HEAD(create__replace)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(create__replace)
+{
+    create_results("test.db");
+    atf::utils::create_file("test.snap", "old contents");
+    store::results_snapshot::create(fs::path("test.db"), fs::path("test.snap"));
+    ATF_REQUIRE_EQ(3, store::results_snapshot::open(
+                       fs::path("test.snap")).size());
+}
+
+
+ATF_TEST_CASE(create__missing_results);
+ATF_TEST_CASE_HEAD(create__missing_results)
+{
+    logging::set_inmemory();
+}
+ATF_TEST_CASE_BODY(create__missing_results)
+{
+    ATF_REQUIRE_THROW(store::error, store::results_snapshot::create(
+                          fs::path("missing.db"), fs::path("test.snap")));
+    ATF_REQUIRE(!atf::utils::file_exists("test.snap"));
+}
+
+
+ATF_TEST_CASE(open_or_create__missing);
+ATF_TEST_CASE_HEAD(open_or_create__missing)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(open_or_create__missing)
+{
+    create_results("test.db");
+    ATF_REQUIRE_EQ(3, store::results_snapshot::open_or_create(
+                       fs::path("test.db"), fs::path("test.snap")).size());
+    ATF_REQUIRE(atf::utils::file_exists("test.snap"));
+}
+
+
+ATF_TEST_CASE(open_or_create__reuse);
+ATF_TEST_CASE_HEAD(open_or_create__reuse)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(open_or_create__reuse)
+{
+    create_results("test.db");
+    store::write_backend::open_rw(fs::path("empty.db")).close();
+    store::results_snapshot::create(fs::path("empty.db"),
+                                    fs::path("test.snap"));
+
+    // The snapshot is not older than the results file, so it is used as is
+    // even though it does not match the contents of the results file.
+    ATF_REQUIRE_EQ(0, store::results_snapshot::open_or_create(
+                       fs::path("test.db"), fs::path("test.snap")).size());
+}
+
+
+ATF_TEST_CASE(open_or_create__invalid);
+ATF_TEST_CASE_HEAD(open_or_create__invalid)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(open_or_create__invalid)
+{
+    create_results("test.db");
+    atf::utils::create_file("test.snap", "garbage");
+    ATF_REQUIRE_EQ(3, store::results_snapshot::open_or_create(
+                       fs::path("test.db"), fs::path("test.snap")).size());
+}
+
+
+ATF_TEST_CASE(summarize);
+ATF_TEST_CASE_HEAD(summarize)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(summarize)
+{
+    create_results("test.db");
+    store::results_snapshot::create(fs::path("test.db"), fs::path("test.snap"));
+
+    const store::results_summary summary = store::results_snapshot::open(
+        fs::path("test.snap")).summarize();
+
+    std::map< model::test_result_type, std::size_t > exp_counts;
+    exp_counts[model::test_result_passed] = 2;
+    exp_counts[model::test_result_failed] = 1;
+    ATF_REQUIRE(exp_counts == summary.counts);
+    ATF_REQUIRE_EQ(datetime::delta(2, 600000), summary.total_duration);
+    ATF_REQUIRE_EQ(datetime::timestamp::from_microseconds(900000),
+                   summary.start_time.get());
+    ATF_REQUIRE_EQ(datetime::timestamp::from_microseconds(3200000),
+                   summary.end_time.get());
+}
+
+
+ATF_TEST_CASE(summarize__empty);
+ATF_TEST_CASE_HEAD(summarize__empty)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(summarize__empty)
+{
+    store::write_backend::open_rw(fs::path("test.db")).close();
+    store::results_snapshot::create(fs::path("test.db"), fs::path("test.snap"));
+
+    const store::results_snapshot snapshot = store::results_snapshot::open(
+        fs::path("test.snap"));
+    ATF_REQUIRE_EQ(0, snapshot.size());
+    const store::results_summary summary = snapshot.summarize();
+    ATF_REQUIRE(summary.counts.empty());
+    ATF_REQUIRE_EQ(datetime::delta(), summary.total_duration);
+    ATF_REQUIRE(!summary.start_time);
+    ATF_REQUIRE(!summary.end_time);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(open__missing);
+ATF_TEST_CASE_BODY(open__missing)
+{
+    ATF_REQUIRE_THROW_RE(store::error, "Cannot open snapshot",
+                         store::results_snapshot::open(fs::path("missing")));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(open__not_a_snapshot);
+ATF_TEST_CASE_BODY(open__not_a_snapshot)
+{
+    atf::utils::create_file("test.snap", "This is not a snapshot, but it is "
+                            "long enough to hold a header\n");
+    ATF_REQUIRE_THROW_RE(store::integrity_error, "not a snapshot",
+                         store::results_snapshot::open(fs::path("test.snap")));
+}
+
+
+ATF_TEST_CASE(open__truncated);
+ATF_TEST_CASE_HEAD(open__truncated)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(open__truncated)
+{
+    create_results("test.db");
+    store::results_snapshot::create(fs::path("test.db"), fs::path("test.snap"));
+
+    std::string contents;
+    {
+        std::ifstream input("test.snap");
+        ATF_REQUIRE(input);
+        contents.assign(std::istreambuf_iterator< char >(input),
+                        std::istreambuf_iterator< char >());
+    }
+    atf::utils::create_file("test.snap",
+                            contents.substr(0, contents.length() - 1));
+    ATF_REQUIRE_THROW_RE(store::integrity_error, "truncated",
+                         store::results_snapshot::open(fs::path("test.snap")));
+}
+
+
+ATF_INIT_TEST_CASES(tcs)
+{
+    ATF_ADD_TEST_CASE(tcs, create_and_open);
+    ATF_ADD_TEST_CASE(tcs, create__replace);
+    ATF_ADD_TEST_CASE(tcs, create__missing_results);
+
+    ATF_ADD_TEST_CASE(tcs, open_or_create__missing);
+    ATF_ADD_TEST_CASE(tcs, open_or_create__reuse);
+    ATF_ADD_TEST_CASE(tcs, open_or_create__invalid);
+
+    ATF_ADD_TEST_CASE(tcs, summarize);
+    ATF_ADD_TEST_CASE(tcs, summarize__empty);
+
+    ATF_ADD_TEST_CASE(tcs, open__missing);
+    ATF_ADD_TEST_CASE(tcs, open__not_a_snapshot);
+    ATF_ADD_TEST_CASE(tcs, open__truncated);
+}
@@ -38,6 +38,7 @@
 #include "store/read_transaction.hpp"
 #include "store/write_backend.hpp"
 #include "store/write_transaction.hpp"
+#include "utils/config/tree.ipp"
 #include "utils/datetime.hpp"
 #include "utils/fs/operations.hpp"
 #include "utils/fs/path.hpp"
@@ -45,6 +46,7 @@
 #include "utils/sqlite/database.hpp"
 #include "utils/units.hpp"
 
+namespace config = utils::config;
 namespace datetime = utils::datetime;
 namespace fs = utils::fs;
 namespace logging = utils::logging;
@@ -162,9 +164,60 @@ ATF_TEST_CASE_BODY(get_put_test_case__ok)
 }
 
 
+ATF_TEST_CASE(get_put_test_program__variant);
+ATF_TEST_CASE_HEAD(get_put_test_program__variant)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(get_put_test_program__variant)
+{
+    config::properties_map vars;
+    vars["mode"] = "fast";
+    const model::test_program plain_program = model::test_program_builder(
+        "atf", fs::path("the/binary"), fs::path("/some/root"), "the-suite")
+        .add_test_case("tc1")
+        .build();
+    const model::test_program variant_program = model::test_program_builder(
+        "atf", fs::path("the/binary"), fs::path("/some/root"), "the-suite")
+        .add_test_case("tc1")
+        .set_variant("fast", vars)
+        .build();
+
+    int64_t plain_id, variant_id;
+    {
+        store::write_backend backend = store::write_backend::open_rw(
+            fs::path("test.db"));
+        backend.database().exec("PRAGMA foreign_keys = OFF");
+
+        store::write_transaction tx = backend.start_write();
+        plain_id = tx.put_test_program(plain_program);
+        tx.put_test_case(plain_program, "tc1", plain_id);
+        variant_id = tx.put_test_program(variant_program);
+        tx.put_test_case(variant_program, "tc1", variant_id);
+        tx.commit();
+    }
+
+    store::read_backend backend = store::read_backend::open_ro(
+        fs::path("test.db"));
+    backend.database().exec("PRAGMA foreign_keys = OFF");
+
+    store::read_transaction tx = backend.start_read();
+    ATF_REQUIRE(plain_program ==
+                *store::detail::get_test_program(backend, plain_id));
+    const model::test_program_ptr loaded_variant_program =
+        store::detail::get_test_program(backend, variant_id);
+    ATF_REQUIRE_EQ("fast", loaded_variant_program->variant());
+    ATF_REQUIRE(loaded_variant_program->variant_vars().empty());
+    ATF_REQUIRE_EQ(variant_program.relative_path(),
+                   loaded_variant_program->relative_path());
+}
+
+
 ATF_INIT_TEST_CASES(tcs)
 {
     ATF_ADD_TEST_CASE(tcs, get_put_context__ok);
 
     ATF_ADD_TEST_CASE(tcs, get_put_test_case__ok);
+    ATF_ADD_TEST_CASE(tcs, get_put_test_program__variant);
 }
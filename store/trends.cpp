@@ -0,0 +1,746 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "store/trends.hpp"
+
+extern "C" {
+#include <stdint.h>
+}
+
+#include <algorithm>
+#include <cmath>
+#include <set>
+
+#include "store/exceptions.hpp"
+#include "store/layout.hpp"
+#include "store/read_backend.hpp"
+#include "utils/format/macros.hpp"
+#include "utils/logging/macros.hpp"
+#include "utils/noncopyable.hpp"
+#include "utils/optional.ipp"
+#include "utils/sanity.hpp"
+#include "utils/sqlite/database.hpp"
+#include "utils/sqlite/exceptions.hpp"
+#include "utils/sqlite/statement.ipp"
+#include "utils/sqlite/transaction.hpp"
+
+namespace datetime = utils::datetime;
+namespace fs = utils::fs;
+namespace layout = store::layout;
+namespace sqlite = utils::sqlite;
+
+using utils::none;
+using utils::optional;
+
+
+namespace {
+
+
+/// Schema of the trends index.
+///
+/// Unlike the schema of the results files, this is not versioned: the index
+/// only holds data derived from the results files, so a future incompatible
+/// layout can simply use a different file name and rebuild it.
+static const char* const trends_schema =
+    "CREATE TABLE IF NOT EXISTS trend_runs ("
+    "    run_id INTEGER PRIMARY KEY AUTOINCREMENT, "
+    "    test_suite TEXT NOT NULL, "
+    "    results_file TEXT NOT NULL UNIQUE, "
+    "    start_time TIMESTAMP NOT NULL); "
+
+    "CREATE INDEX IF NOT EXISTS index_trend_runs_by_test_suite "
+    "    ON trend_runs (test_suite, start_time); "
+
+    "CREATE TABLE IF NOT EXISTS trend_results ("
+    "    run_id INTEGER NOT NULL REFERENCES trend_runs, "
+    "    test_program TEXT NOT NULL, "
+    "    variant TEXT NOT NULL, "
+    "    test_case TEXT NOT NULL, "
+    "    result_type TEXT NOT NULL, "
+    "    duration INTEGER NOT NULL, "
+    "    PRIMARY KEY (run_id, test_program, variant, test_case));";
+
+
+/// Copies the results of the attached "source" database into the index.
+///
+/// Any previous data for the same results file is replaced.  A run made with
+/// --repeat or --until-fail holds several attempts of each test case; these
+/// are folded into a single row that carries the worst result and the mean
+/// duration of all attempts.
+///
+/// \param db The trends index, with the results file attached as "source".
+/// \param test_suite The test suite the results file belongs to.
+/// \param results_file The path to the results file.
+static void
+add_attached(sqlite::database& db, const std::string& test_suite,
+             const fs::path& results_file)
+{
+    sqlite::transaction tx = db.begin_transaction();
+
+    {
+        sqlite::statement stmt = db.create_statement(
+            "DELETE FROM main.trend_results WHERE run_id IN "
+            "    (SELECT run_id FROM main.trend_runs "
+            "     WHERE results_file = :results_file)");
+        stmt.bind(":results_file", results_file.str());
+        stmt.step_without_results();
+    }
+    {
+        sqlite::statement stmt = db.create_statement(
+            "DELETE FROM main.trend_runs WHERE results_file = :results_file");
+        stmt.bind(":results_file", results_file.str());
+        stmt.step_without_results();
+    }
+
+    {
+        sqlite::statement stmt = db.create_statement(
+            "INSERT INTO main.trend_runs (test_suite, results_file, "
+            "    start_time) "
+            "SELECT :test_suite, :results_file, COALESCE(MIN(start_time), 0) "
+            "FROM source.test_results");
+        stmt.bind(":test_suite", test_suite);
+        stmt.bind(":results_file", results_file.str());
+        stmt.step_without_results();
+    }
+    const int64_t run_id = db.last_insert_rowid();
+
+    {
+        sqlite::statement stmt = db.create_statement(
+            "INSERT INTO main.trend_results "
+            "SELECT :run_id, test_programs.relative_path, "
+            "    COALESCE(test_programs.variant, ''), test_cases.name, "
+            "    CASE "
+            "        WHEN SUM(test_results.result_type = 'broken') > 0 "
+            "            THEN 'broken' "
+            "        WHEN SUM(test_results.result_type = 'failed') > 0 "
+            "            THEN 'failed' "
+            "        ELSE MIN(test_results.result_type) "
+            "    END, "
+            "    CAST(AVG(test_results.end_time - test_results.start_time) "
+            "        AS INTEGER) "
+            "FROM source.test_results "
+            "    JOIN source.test_cases "
+            "        ON test_results.test_case_id = test_cases.test_case_id "
+            "    JOIN source.test_programs "
+            "        ON test_cases.test_program_id = "
+            "            test_programs.test_program_id "
+            "GROUP BY test_programs.relative_path, "
+            "    COALESCE(test_programs.variant, ''), test_cases.name");
+        stmt.bind(":run_id", run_id);
+        stmt.step_without_results();
+    }
+
+    tx.commit();
+}
+
+
+/// Gets the results files of a test suite that are already in the index.
+///
+/// \param db The trends index.
+/// \param test_suite The test suite to query.
+///
+/// \return The paths to the indexed results files.
+static std::set< std::string >
+indexed_files(sqlite::database& db, const std::string& test_suite)
+{
+    std::set< std::string > files;
+    sqlite::statement stmt = db.create_statement(
+        "SELECT results_file FROM trend_runs WHERE test_suite = :test_suite");
+    stmt.bind(":test_suite", test_suite);
+    while (stmt.step())
+        files.insert(stmt.column_text(0));
+    return files;
+}
+
+
+/// Gets the value at a percentile of a sorted collection of durations.
+///
+/// \param durations The durations in microseconds, sorted in increasing order.
+///     Must not be empty.
+/// \param percent The percentile to compute, in the [0, 100] range.
+///
+/// \return The smallest duration that is greater than or equal to percent% of
+/// the durations.
+static int64_t
+percentile_of(const std::vector< int64_t >& durations, const double percent)
+{
+    PRE(!durations.empty());
+    const std::size_t rank = static_cast< std::size_t >(
+        std::ceil(percent / 100.0 * static_cast< double >(durations.size())));
+    return durations[rank == 0 ? 0 : rank - 1];
+}
+
+
+/// Computes the trend of a test case out of its durations.
+///
+/// \param test_program Relative path to the test program.
+/// \param variant Variant of the test program; empty if none.
+/// \param test_case Name of the test case.
+/// \param failures Number of runs in which the test case did not pass.
+/// \param previous Durations in microseconds in the runs before the latest
+///     one, sorted in increasing order.  Must not be empty.
+/// \param latest Duration in microseconds in the latest run.
+///
+/// \return The trend of the test case.
+static store::case_trend
+make_trend(const std::string& test_program, const std::string& variant,
+           const std::string& test_case, const std::size_t failures,
+           const std::vector< int64_t >& previous, const int64_t latest)
+{
+    PRE(!previous.empty());
+
+    int64_t total = 0;
+    for (std::vector< int64_t >::const_iterator iter = previous.begin();
+         iter != previous.end(); ++iter)
+        total += *iter;
+    const int64_t mean = total / static_cast< int64_t >(previous.size());
+
+    double squares = 0.0;
+    for (std::vector< int64_t >::const_iterator iter = previous.begin();
+         iter != previous.end(); ++iter) {
+        const double deviation = static_cast< double >(*iter - mean);
+        squares += deviation * deviation;
+    }
+    const int64_t stddev = static_cast< int64_t >(
+        std::sqrt(squares / static_cast< double >(previous.size())));
+
+    return store::case_trend(
+        fs::path(test_program), variant, test_case, previous.size() + 1,
+        failures, datetime::delta::from_microseconds(mean),
+        datetime::delta::from_microseconds(percentile_of(previous, 50)),
+        datetime::delta::from_microseconds(percentile_of(previous, 95)),
+        datetime::delta::from_microseconds(stddev),
+        datetime::delta::from_microseconds(latest));
+}
+
+
+/// Computes the trends of the test cases that ran in a given run.
+///
+/// The durations of every test case in the given run are compared to their
+/// durations in the runs of the same test suite that precede it, up to the
+/// given number of runs in total.  Test cases that did not run in the given
+/// run or in any of the previous ones are ignored.
+///
+/// \param db The trends index.
+/// \param run_id The run to compute the trends for.
+/// \param max_runs Number of runs to consider, including the given one.
+///
+/// \return The trends of the test cases, sorted by name.
+///
+/// \throw sqlite::error If the index cannot be queried.
+static store::case_trends_vector
+compute_trends(sqlite::database& db, const int64_t run_id,
+               const std::size_t max_runs)
+{
+    sqlite::statement stmt = db.create_statement(
+        "SELECT test_program, variant, test_case, run_id = :run_id, "
+        "    result_type IN ('broken', 'failed'), duration "
+        "FROM trend_results "
+        "WHERE run_id IN "
+        "    (SELECT others.run_id "
+        "     FROM trend_runs AS others JOIN trend_runs AS anchor "
+        "         ON others.test_suite = anchor.test_suite "
+        "     WHERE anchor.run_id = :run_id "
+        "         AND (others.start_time < anchor.start_time "
+        "             OR (others.start_time = anchor.start_time "
+        "                 AND others.run_id <= anchor.run_id)) "
+        "     ORDER BY others.start_time DESC, others.run_id DESC "
+        "     LIMIT :max_runs) "
+        "ORDER BY test_program, variant, test_case, duration");
+    stmt.bind(":run_id", run_id);
+    stmt.bind(":max_runs", static_cast< int64_t >(max_runs));
+
+    store::case_trends_vector trends;
+    std::string test_program, variant, test_case;
+    std::size_t failures = 0;
+    std::vector< int64_t > previous;
+    optional< int64_t > latest;
+    bool more = stmt.step();
+    while (more) {
+        test_program = stmt.column_text(0);
+        variant = stmt.column_text(1);
+        test_case = stmt.column_text(2);
+        if (stmt.column_int64(3) != 0)
+            latest = stmt.column_int64(5);
+        else
+            previous.push_back(stmt.column_int64(5));
+        failures += static_cast< std::size_t >(stmt.column_int64(4));
+
+        more = stmt.step();
+        if (!more || stmt.column_text(0) != test_program ||
+            stmt.column_text(1) != variant ||
+            stmt.column_text(2) != test_case) {
+            if (latest && !previous.empty())
+                trends.push_back(make_trend(test_program, variant, test_case,
+                                            failures, previous,
+                                            latest.get()));
+            failures = 0;
+            previous.clear();
+            latest = none;
+        }
+    }
+    return trends;
+}
+
+
+/// Sorts trends by decreasing slowdown.
+///
+/// \param trend1 The first trend to compare.
+/// \param trend2 The second trend to compare.
+///
+/// \return True if trend1 got slower than trend2; ties are broken by name.
+static bool
+slower_first(const store::case_trend& trend1, const store::case_trend& trend2)
+{
+    const int64_t slowdown1 = trend1.latest_duration.to_microseconds() -
+        trend1.mean_duration.to_microseconds();
+    const int64_t slowdown2 = trend2.latest_duration.to_microseconds() -
+        trend2.mean_duration.to_microseconds();
+    if (slowdown1 != slowdown2)
+        return slowdown1 > slowdown2;
+    if (trend1.test_program != trend2.test_program)
+        return trend1.test_program < trend2.test_program;
+    if (trend1.variant != trend2.variant)
+        return trend1.variant < trend2.variant;
+    return trend1.test_case < trend2.test_case;
+}
+
+
+/// Selects the test cases that regressed in a run.
+///
+/// \param db The trends index.
+/// \param run_id The run to inspect.
+/// \param max_runs Number of runs to consider, including the given one.
+/// \param max_cases Maximum number of test cases to return.
+/// \param threshold Fraction of the mean duration by which a test case must
+///     have slowed down to be returned.
+///
+/// \return The regressed test cases, sorted by decreasing slowdown.
+///
+/// \throw sqlite::error If the index cannot be queried.
+static store::case_trends_vector
+find_slowdowns(sqlite::database& db, const int64_t run_id,
+               const std::size_t max_runs, const std::size_t max_cases,
+               const double threshold)
+{
+    const store::case_trends_vector all = compute_trends(db, run_id, max_runs);
+
+    store::case_trends_vector trends;
+    for (store::case_trends_vector::const_iterator iter = all.begin();
+         iter != all.end(); ++iter) {
+        if ((*iter).regressed(threshold))
+            trends.push_back(*iter);
+    }
+    std::sort(trends.begin(), trends.end(), slower_first);
+    if (trends.size() > max_cases)
+        trends.erase(trends.begin() + max_cases, trends.end());
+    return trends;
+}
+
+
+}  // anonymous namespace
+
+
+/// Constructor for a case_trend.
+///
+/// \param test_program_ Relative path to the test program.
+/// \param variant_ Variant of the test program; empty if none.
+/// \param test_case_ Name of the test case.
+/// \param runs_ Number of runs that executed the test case.
+/// \param failures_ Number of runs in which the test case did not pass.
+/// \param mean_duration_ Mean duration in the runs before the latest one.
+/// \param median_duration_ Median duration in the runs before the latest one.
+/// \param p95_duration_ 95th percentile of the duration in the runs before the
+///     latest one.
+/// \param stddev_duration_ Standard deviation of the duration in the runs
+///     before the latest one.
+/// \param latest_duration_ Duration in the latest run.
+store::case_trend::case_trend(const fs::path& test_program_,
+                              const std::string& variant_,
+                              const std::string& test_case_,
+                              const std::size_t runs_,
+                              const std::size_t failures_,
+                              const datetime::delta& mean_duration_,
+                              const datetime::delta& median_duration_,
+                              const datetime::delta& p95_duration_,
+                              const datetime::delta& stddev_duration_,
+                              const datetime::delta& latest_duration_) :
+    test_program(test_program_),
+    variant(variant_),
+    test_case(test_case_),
+    runs(runs_),
+    failures(failures_),
+    mean_duration(mean_duration_),
+    median_duration(median_duration_),
+    p95_duration(p95_duration_),
+    stddev_duration(stddev_duration_),
+    latest_duration(latest_duration_)
+{
+}
+
+
+/// Checks whether the test case got slower beyond a threshold.
+///
+/// \param threshold Fraction of the mean duration by which the latest duration
+///     must exceed the mean duration, such as 0.2 for 20%.  Zero flags any
+///     slowdown.
+///
+/// \return True if the latest duration exceeds the mean duration by more than
+/// the threshold.
+bool
+store::case_trend::regressed(const double threshold) const
+{
+    PRE(threshold >= 0.0);
+    const int64_t mean = mean_duration.to_microseconds();
+    const int64_t latest = latest_duration.to_microseconds();
+    return latest > mean &&
+        static_cast< double >(latest - mean) >
+        static_cast< double >(mean) * threshold;
+}
+
+
+/// Constructor for a trend_case_id.
+///
+/// \param test_program_ Relative path to the test program.
+/// \param variant_ Variant of the test program; empty if none.
+/// \param test_case_ Name of the test case.
+store::trend_case_id::trend_case_id(const fs::path& test_program_,
+                                    const std::string& variant_,
+                                    const std::string& test_case_) :
+    test_program(test_program_),
+    variant(variant_),
+    test_case(test_case_)
+{
+}
+
+
+/// Less-than comparator to allow using identifiers as map keys.
+///
+/// \param other The object to compare to.
+///
+/// \return True if this identifier sorts before the other one.
+bool
+store::trend_case_id::operator<(const trend_case_id& other) const
+{
+    if (test_program != other.test_program)
+        return test_program < other.test_program;
+    if (variant != other.variant)
+        return variant < other.variant;
+    return test_case < other.test_case;
+}
+
+
+/// Internal implementation for the trends index.
+struct store::trends_index::impl : utils::noncopyable {
+    /// The SQLite database holding the index.
+    sqlite::database database;
+
+    /// Constructor.
+    ///
+    /// \param database_ The SQLite database instance.
+    impl(sqlite::database& database_) :
+        database(database_)
+    {
+    }
+};
+
+
+/// Constructs a new trends index.
+///
+/// \param pimpl_ The internal data.
+store::trends_index::trends_index(impl* pimpl_) :
+    _pimpl(pimpl_)
+{
+}
+
+
+/// Destructor.
+store::trends_index::~trends_index(void)
+{
+}
+
+
+/// Opens the trends index, creating it if it does not exist yet.
+///
+/// \param file The database file to be opened.
+///
+/// \return The opened index.
+///
+/// \throw store::error If there is any problem opening or creating the index.
+store::trends_index
+store::trends_index::open_rw(const fs::path& file)
+{
+    sqlite::database db = detail::open_and_setup(
+        file, sqlite::open_readwrite | sqlite::open_create);
+    try {
+        db.exec(trends_schema);
+    } catch (const sqlite::error& e) {
+        throw store::error(F("Cannot initialize trends index '%s': %s") %
+                           file % e.what());
+    }
+    return trends_index(new impl(db));
+}
+
+
+/// Closes the SQLite database.
+void
+store::trends_index::close(void)
+{
+    _pimpl->database.close();
+}
+
+
+/// Records the results of a run in the index.
+///
+/// If the results file was already indexed, its previous data is replaced.
+/// This allows calling this function again on a results file that was indexed
+/// while it was still being written to.
+///
+/// \param test_suite The test suite the results file belongs to.
+/// \param results_file The results file to index.
+///
+/// \throw store::error If the results file is invalid or if the index cannot
+///     be updated.
+void
+store::trends_index::add_run(const std::string& test_suite,
+                             const fs::path& results_file)
+{
+    LI(F("Adding results file %s to the trends index") % results_file);
+
+    // Opening the results file through the read backend validates its schema
+    // version; the copy itself runs entirely within SQLite.
+    read_backend::open_ro(results_file).close();
+
+    sqlite::database& db = _pimpl->database;
+    try {
+        // ATTACH cannot run within a transaction, so this happens outside of
+        // the one that add_attached() uses to copy the data.
+        sqlite::statement attach = db.create_statement(
+            "ATTACH DATABASE :path AS source");
+        attach.bind(":path", results_file.str());
+        attach.step_without_results();
+    } catch (const sqlite::error& e) {
+        throw store::error(F("Cannot attach '%s': %s") % results_file %
+                           e.what());
+    }
+
+    try {
+        add_attached(db, test_suite, results_file);
+    } catch (const sqlite::error& e) {
+        db.exec("DETACH DATABASE source");
+        throw store::error(F("Failed to index '%s': %s") % results_file %
+                           e.what());
+    }
+    db.exec("DETACH DATABASE source");
+}
+
+
+/// Adds the results files of a test suite that are missing from the index.
+///
+/// Only the timestamped results files in the store directory are considered.
+/// Results files that cannot be indexed are skipped with a warning so that a
+/// single damaged file does not prevent querying the rest.
+///
+/// \param test_suite The test suite to synchronize.
+///
+/// \return The number of results files added to the index.
+///
+/// \throw store::error If the index cannot be queried.
+std::size_t
+store::trends_index::sync(const std::string& test_suite)
+{
+    std::set< std::string > indexed;
+    try {
+        indexed = indexed_files(_pimpl->database, test_suite);
+    } catch (const sqlite::error& e) {
+        throw store::error(F("Cannot query the trends index: %s") % e.what());
+    }
+
+    std::size_t added = 0;
+    const std::vector< fs::path > files = layout::list_results(test_suite);
+    for (std::vector< fs::path >::const_iterator iter = files.begin();
+         iter != files.end(); ++iter) {
+        if (indexed.find((*iter).str()) != indexed.end())
+            continue;
+
+        try {
+            add_run(test_suite, *iter);
+            ++added;
+        } catch (const store::error& e) {
+            LW(F("Skipping results file %s: %s") % *iter % e.what());
+        }
+    }
+    return added;
+}
+
+
+/// Finds the test cases that got slower in the latest run of a test suite.
+///
+/// The duration of every test case in the latest run is compared to its
+/// durations over the previous runs within the window.  Test cases that did not
+/// run in the latest run or in any of the previous ones are ignored.
+///
+/// \param test_suite The test suite to query.
+/// \param max_runs Number of most recent runs to consider, including the
+///     latest one.  Must be at least 2.
+/// \param max_cases Maximum number of test cases to return.
+/// \param threshold Fraction of the mean duration by which a test case must
+///     have slowed down to be returned.  See case_trend::regressed().
+///
+/// \return The test cases whose latest duration exceeds their mean duration by
+/// more than the threshold, sorted by decreasing slowdown.
+///
+/// \throw store::error If the index cannot be queried.
+store::case_trends_vector
+store::trends_index::slowdowns(const std::string& test_suite,
+                               const std::size_t max_runs,
+                               const std::size_t max_cases,
+                               const double threshold)
+{
+    PRE(max_runs >= 2);
+
+    try {
+        sqlite::statement stmt = _pimpl->database.create_statement(
+            "SELECT run_id FROM trend_runs WHERE test_suite = :test_suite "
+            "ORDER BY start_time DESC, run_id DESC LIMIT 1");
+        stmt.bind(":test_suite", test_suite);
+        if (!stmt.step())
+            return case_trends_vector();
+        const int64_t run_id = stmt.column_int64(0);
+        stmt.step_without_results();
+
+        return find_slowdowns(_pimpl->database, run_id, max_runs, max_cases,
+                              threshold);
+    } catch (const sqlite::error& e) {
+        throw store::error(F("Cannot query the trends index: %s") % e.what());
+    }
+}
+
+
+/// Finds the test cases that got slower in the run of a results file.
+///
+/// This is like slowdowns() but compares the run recorded in the given results
+/// file, not necessarily the latest one, to the runs that preceded it.
+///
+/// \param results_file The results file holding the run to inspect.  Must have
+///     been added to the index.
+/// \param max_runs Number of runs to consider, including the one of the
+///     results file.  Must be at least 2.
+/// \param max_cases Maximum number of test cases to return.
+/// \param threshold Fraction of the mean duration by which a test case must
+///     have slowed down to be returned.  See case_trend::regressed().
+///
+/// \return The test cases whose duration in the run exceeds their mean duration
+/// by more than the threshold, sorted by decreasing slowdown.  Empty if the
+/// results file is not in the index.
+///
+/// \throw store::error If the index cannot be queried.
+store::case_trends_vector
+store::trends_index::slowdowns_in(const fs::path& results_file,
+                                  const std::size_t max_runs,
+                                  const std::size_t max_cases,
+                                  const double threshold)
+{
+    PRE(max_runs >= 2);
+
+    try {
+        sqlite::statement stmt = _pimpl->database.create_statement(
+            "SELECT run_id FROM trend_runs WHERE results_file = :results_file");
+        stmt.bind(":results_file", results_file.str());
+        if (!stmt.step())
+            return case_trends_vector();
+        const int64_t run_id = stmt.column_int64(0);
+        stmt.step_without_results();
+
+        return find_slowdowns(_pimpl->database, run_id, max_runs, max_cases,
+                              threshold);
+    } catch (const sqlite::error& e) {
+        throw store::error(F("Cannot query the trends index: %s") % e.what());
+    }
+}
+
+
+/// Computes a percentile of the durations of the test cases of a test suite.
+///
+/// \param test_suite The test suite to query.
+/// \param max_runs Number of most recent runs to consider.
+/// \param min_runs Minimum number of runs, within the considered ones, that
+///     must have executed a test case for it to be returned.  Must be at
+///     least 1.
+/// \param percent The percentile to compute, in the [0, 100] range.
+///
+/// \return The percentile of the durations of every test case that ran in
+/// enough of the considered runs.
+///
+/// \throw store::error If the index cannot be queried.
+store::case_durations_map
+store::trends_index::percentiles(const std::string& test_suite,
+                                 const std::size_t max_runs,
+                                 const std::size_t min_runs,
+                                 const double percent)
+{
+    PRE(min_runs >= 1);
+    PRE(percent >= 0.0 && percent <= 100.0);
+
+    case_durations_map percentiles;
+    try {
+        sqlite::statement stmt = _pimpl->database.create_statement(
+            "SELECT test_program, variant, test_case, duration "
+            "FROM trend_results "
+            "WHERE run_id IN "
+            "    (SELECT run_id FROM trend_runs "
+            "     WHERE test_suite = :test_suite "
+            "     ORDER BY start_time DESC, run_id DESC "
+            "     LIMIT :max_runs) "
+            "ORDER BY test_program, variant, test_case, duration");
+        stmt.bind(":test_suite", test_suite);
+        stmt.bind(":max_runs", static_cast< int64_t >(max_runs));
+
+        std::vector< int64_t > durations;
+        bool more = stmt.step();
+        while (more) {
+            const trend_case_id id(fs::path(stmt.column_text(0)),
+                                   stmt.column_text(1), stmt.column_text(2));
+            durations.push_back(stmt.column_int64(3));
+
+            more = stmt.step();
+            if (!more || stmt.column_text(0) != id.test_program.str() ||
+                stmt.column_text(1) != id.variant ||
+                stmt.column_text(2) != id.test_case) {
+                if (durations.size() >= min_runs)
+                    percentiles.insert(case_durations_map::value_type(
+                        id, datetime::delta::from_microseconds(
+                            percentile_of(durations, percent))));
+                durations.clear();
+            }
+        }
+    } catch (const sqlite::error& e) {
+        throw store::error(F("Cannot query the trends index: %s") % e.what());
+    }
+    return percentiles;
+}
@@ -0,0 +1,143 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// \file store/trends.hpp
+/// Index of the durations and results of test cases across runs.
+///
+/// Every results file holds a single run, so answering questions that span
+/// many runs would require opening all of them.  The trends index is a
+/// separate database that aggregates the per-run duration and result of every
+/// test case, keyed so that querying the history of a test suite is a single
+/// indexed lookup.  The index is derived data: it can be deleted at any time
+/// and be rebuilt from the results files.
+
+#if !defined(STORE_TRENDS_HPP)
+#define STORE_TRENDS_HPP
+
+#include "store/trends_fwd.hpp"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "utils/datetime.hpp"
+#include "utils/fs/path.hpp"
+#include "utils/shared_ptr.hpp"
+
+namespace store {
+
+
+/// Evolution of the duration of a test case over a series of runs.
+struct case_trend {
+    /// Relative path to the test program containing the test case.
+    utils::fs::path test_program;
+
+    /// Variant of the test program; empty if none.
+    std::string variant;
+
+    /// Name of the test case.
+    std::string test_case;
+
+    /// Number of runs, within the queried ones, that executed the test case.
+    std::size_t runs;
+
+    /// Number of runs in which the test case was broken or failed.
+    std::size_t failures;
+
+    /// Mean duration of the test case in the runs before the latest one.
+    utils::datetime::delta mean_duration;
+
+    /// Median duration of the test case in the runs before the latest one.
+    utils::datetime::delta median_duration;
+
+    /// 95th percentile of the duration in the runs before the latest one.
+    utils::datetime::delta p95_duration;
+
+    /// Standard deviation of the duration in the runs before the latest one.
+    utils::datetime::delta stddev_duration;
+
+    /// Duration of the test case in the latest run.
+    utils::datetime::delta latest_duration;
+
+    case_trend(const utils::fs::path&, const std::string&, const std::string&,
+               const std::size_t, const std::size_t,
+               const utils::datetime::delta&, const utils::datetime::delta&,
+               const utils::datetime::delta&, const utils::datetime::delta&,
+               const utils::datetime::delta&);
+
+    bool regressed(const double) const;
+};
+
+
+/// Identifier of a test case across the runs in the trends index.
+struct trend_case_id {
+    /// Relative path to the test program containing the test case.
+    utils::fs::path test_program;
+
+    /// Variant of the test program; empty if none.
+    std::string variant;
+
+    /// Name of the test case.
+    std::string test_case;
+
+    trend_case_id(const utils::fs::path&, const std::string&,
+                  const std::string&);
+
+    bool operator<(const trend_case_id&) const;
+};
+
+
+/// Database holding the durations and results of test cases across runs.
+class trends_index {
+    struct impl;
+
+    /// Pointer to the shared internal implementation.
+    std::shared_ptr< impl > _pimpl;
+
+    trends_index(impl*);
+
+public:
+    ~trends_index(void);
+
+    static trends_index open_rw(const utils::fs::path&);
+    void close(void);
+
+    void add_run(const std::string&, const utils::fs::path&);
+    std::size_t sync(const std::string&);
+    case_trends_vector slowdowns(const std::string&, const std::size_t,
+                                 const std::size_t, const double = 0.0);
+    case_trends_vector slowdowns_in(const utils::fs::path&, const std::size_t,
+                                    const std::size_t, const double = 0.0);
+    case_durations_map percentiles(const std::string&, const std::size_t,
+                                   const std::size_t, const double);
+};
+
+
+}  // namespace store
+
+#endif  // !defined(STORE_TRENDS_HPP)
@@ -0,0 +1,453 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "store/trends.hpp"
+
+#include <map>
+#include <string>
+
+#include <atf-c++.hpp>
+
+#include "model/context.hpp"
+#include "model/test_program.hpp"
+#include "model/test_result.hpp"
+#include "store/exceptions.hpp"
+#include "store/layout.hpp"
+#include "store/write_backend.hpp"
+#include "store/write_transaction.hpp"
+#include "utils/datetime.hpp"
+#include "utils/env.hpp"
+#include "utils/fs/operations.hpp"
+#include "utils/fs/path.hpp"
+#include "utils/logging/operations.hpp"
+#include "utils/sqlite/database.hpp"
+#include "utils/sqlite/statement.ipp"
+
+namespace datetime = utils::datetime;
+namespace fs = utils::fs;
+namespace layout = store::layout;
+namespace logging = utils::logging;
+namespace sqlite = utils::sqlite;
+
+
+namespace {
+
+
+/// Creates a results file with a test program holding two test cases.
+///
+/// \param file The results file to create.
+/// \param day Day of the month in which the run started.
+/// \param first_duration Duration in seconds of the "first" test case.
+/// \param second_duration Duration in seconds of the "second" test case.
+/// \param second_result The result of the "second" test case.
+static void
+create_results(const fs::path& file, const int day,
+               const int first_duration, const int second_duration,
+               const model::test_result& second_result)
+{
+    store::write_backend backend = store::write_backend::open_rw(file);
+    store::write_transaction tx = backend.start_write();
+
+    tx.put_context(model::context(fs::path("/the/root"),
+                                  std::map< std::string, std::string >()));
+
+    const model::test_program test_program = model::test_program_builder(
+        "plain", fs::path("dir/prog"), fs::path("/the/root"), "suite")
+        .add_test_case("first")
+        .add_test_case("second")
+        .build();
+    const int64_t tp_id = tx.put_test_program(test_program);
+
+    const datetime::timestamp start = datetime::timestamp::from_values(
+        2015, 1, day, 3, 4, 5, 0);
+    const int64_t tc1_id = tx.put_test_case(test_program, "first", tp_id);
+    tx.put_result(model::test_result(model::test_result_passed), tc1_id,
+                  start, start + datetime::delta(first_duration, 0));
+    const int64_t tc2_id = tx.put_test_case(test_program, "second", tp_id);
+    tx.put_result(second_result, tc2_id,
+                  start, start + datetime::delta(second_duration, 0));
+
+    tx.commit();
+    backend.close();
+}
+
+
+/// Counts the rows in a table of the trends index.
+///
+/// \param file The trends index to query.
+/// \param table The name of the table.
+///
+/// \return The number of rows.
+static int64_t
+count_rows(const char* file, const char* table)
+{
+    sqlite::database db = sqlite::database::open(fs::path(file),
+                                                 sqlite::open_readonly);
+    sqlite::statement stmt = db.create_statement(
+        std::string("SELECT COUNT(*) FROM ") + table);
+    ATF_REQUIRE(stmt.step());
+    return stmt.column_int64(0);
+}
+
+
+}  // anonymous namespace
+
+
+ATF_TEST_CASE(add_run__slowdowns);
+ATF_TEST_CASE_HEAD(add_run__slowdowns)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(add_run__slowdowns)
+{
+    const model::test_result passed(model::test_result_passed);
+    const model::test_result failed(model::test_result_failed, "Oops");
+    create_results(fs::path("a.db"), 1, 10, 4, passed);
+    create_results(fs::path("b.db"), 2, 20, 6, failed);
+    create_results(fs::path("c.db"), 3, 16, 8, passed);
+    create_results(fs::path("d.db"), 4, 1, 1, passed);
+
+    store::trends_index index = store::trends_index::open_rw(
+        fs::path("trends.db"));
+    // Add the runs out of order to ensure the latest one is found by date.
+    index.add_run("suite", fs::path("c.db"));
+    index.add_run("suite", fs::path("a.db"));
+    index.add_run("suite", fs::path("b.db"));
+    index.add_run("other", fs::path("d.db"));
+
+    const store::case_trends_vector trends = index.slowdowns("suite", 3, 10);
+    ATF_REQUIRE_EQ(2, trends.size());
+
+    ATF_REQUIRE_EQ(fs::path("dir/prog"), trends[0].test_program);
+    ATF_REQUIRE_EQ("", trends[0].variant);
+    ATF_REQUIRE_EQ("second", trends[0].test_case);
+    ATF_REQUIRE_EQ(3, trends[0].runs);
+    ATF_REQUIRE_EQ(1, trends[0].failures);
+    ATF_REQUIRE_EQ(datetime::delta(5, 0), trends[0].mean_duration);
+    ATF_REQUIRE_EQ(datetime::delta(4, 0), trends[0].median_duration);
+    ATF_REQUIRE_EQ(datetime::delta(6, 0), trends[0].p95_duration);
+    ATF_REQUIRE_EQ(datetime::delta(1, 0), trends[0].stddev_duration);
+    ATF_REQUIRE_EQ(datetime::delta(8, 0), trends[0].latest_duration);
+
+    ATF_REQUIRE_EQ("first", trends[1].test_case);
+    ATF_REQUIRE_EQ(3, trends[1].runs);
+    ATF_REQUIRE_EQ(0, trends[1].failures);
+    ATF_REQUIRE_EQ(datetime::delta(15, 0), trends[1].mean_duration);
+    ATF_REQUIRE_EQ(datetime::delta(10, 0), trends[1].median_duration);
+    ATF_REQUIRE_EQ(datetime::delta(20, 0), trends[1].p95_duration);
+    ATF_REQUIRE_EQ(datetime::delta(5, 0), trends[1].stddev_duration);
+    ATF_REQUIRE_EQ(datetime::delta(16, 0), trends[1].latest_duration);
+
+    index.close();
+}
+
+
+ATF_TEST_CASE(slowdowns__limits);
+ATF_TEST_CASE_HEAD(slowdowns__limits)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(slowdowns__limits)
+{
+    const model::test_result passed(model::test_result_passed);
+    create_results(fs::path("a.db"), 1, 1, 1, passed);
+    create_results(fs::path("b.db"), 2, 20, 6, passed);
+    create_results(fs::path("c.db"), 3, 16, 8, passed);
+
+    store::trends_index index = store::trends_index::open_rw(
+        fs::path("trends.db"));
+    index.add_run("suite", fs::path("a.db"));
+    index.add_run("suite", fs::path("b.db"));
+    index.add_run("suite", fs::path("c.db"));
+
+    // Only the "second" test case got slower in the last two runs.
+    store::case_trends_vector trends = index.slowdowns("suite", 2, 10);
+    ATF_REQUIRE_EQ(1, trends.size());
+    ATF_REQUIRE_EQ("second", trends[0].test_case);
+    ATF_REQUIRE_EQ(2, trends[0].runs);
+
+    trends = index.slowdowns("suite", 3, 1);
+    ATF_REQUIRE_EQ(1, trends.size());
+    ATF_REQUIRE_EQ("first", trends[0].test_case);
+
+    ATF_REQUIRE(index.slowdowns("unknown", 3, 10).empty());
+}
+
+
+ATF_TEST_CASE(slowdowns__threshold);
+ATF_TEST_CASE_HEAD(slowdowns__threshold)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(slowdowns__threshold)
+{
+    const model::test_result passed(model::test_result_passed);
+    create_results(fs::path("a.db"), 1, 10, 4, passed);
+    create_results(fs::path("b.db"), 2, 20, 6, passed);
+    create_results(fs::path("c.db"), 3, 16, 8, passed);
+
+    store::trends_index index = store::trends_index::open_rw(
+        fs::path("trends.db"));
+    index.add_run("suite", fs::path("a.db"));
+    index.add_run("suite", fs::path("b.db"));
+    index.add_run("suite", fs::path("c.db"));
+
+    // "first" is 6.7% slower than its mean and "second" is 60% slower.
+    ATF_REQUIRE_EQ(2, index.slowdowns("suite", 3, 10, 0.05).size());
+
+    const store::case_trends_vector trends = index.slowdowns(
+        "suite", 3, 10, 0.5);
+    ATF_REQUIRE_EQ(1, trends.size());
+    ATF_REQUIRE_EQ("second", trends[0].test_case);
+
+    ATF_REQUIRE(index.slowdowns("suite", 3, 10, 0.6).empty());
+}
+
+
+ATF_TEST_CASE(slowdowns_in);
+ATF_TEST_CASE_HEAD(slowdowns_in)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(slowdowns_in)
+{
+    const model::test_result passed(model::test_result_passed);
+    create_results(fs::path("a.db"), 1, 10, 4, passed);
+    create_results(fs::path("b.db"), 2, 20, 6, passed);
+    create_results(fs::path("c.db"), 3, 1, 1, passed);
+
+    store::trends_index index = store::trends_index::open_rw(
+        fs::path("trends.db"));
+    index.add_run("suite", fs::path("a.db"));
+    index.add_run("suite", fs::path("b.db"));
+    index.add_run("suite", fs::path("c.db"));
+
+    // The run in b.db is only compared to the ones that preceded it.
+    const store::case_trends_vector trends = index.slowdowns_in(
+        fs::path("b.db"), 10, 10);
+    ATF_REQUIRE_EQ(2, trends.size());
+    ATF_REQUIRE_EQ("first", trends[0].test_case);
+    ATF_REQUIRE_EQ(2, trends[0].runs);
+    ATF_REQUIRE_EQ(datetime::delta(10, 0), trends[0].mean_duration);
+    ATF_REQUIRE_EQ(datetime::delta(0, 0), trends[0].stddev_duration);
+    ATF_REQUIRE_EQ(datetime::delta(20, 0), trends[0].latest_duration);
+    ATF_REQUIRE_EQ("second", trends[1].test_case);
+
+    ATF_REQUIRE(index.slowdowns("suite", 10, 10).empty());
+    ATF_REQUIRE(index.slowdowns_in(fs::path("a.db"), 10, 10).empty());
+    ATF_REQUIRE(index.slowdowns_in(fs::path("unknown.db"), 10, 10).empty());
+}
+
+
+ATF_TEST_CASE(percentiles);
+ATF_TEST_CASE_HEAD(percentiles)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(percentiles)
+{
+    const model::test_result passed(model::test_result_passed);
+    create_results(fs::path("a.db"), 1, 10, 4, passed);
+    create_results(fs::path("b.db"), 2, 20, 6, passed);
+    create_results(fs::path("c.db"), 3, 16, 8, passed);
+    create_results(fs::path("d.db"), 4, 1, 1, passed);
+
+    store::trends_index index = store::trends_index::open_rw(
+        fs::path("trends.db"));
+    index.add_run("suite", fs::path("a.db"));
+    index.add_run("suite", fs::path("b.db"));
+    index.add_run("suite", fs::path("c.db"));
+    index.add_run("other", fs::path("d.db"));
+
+    const store::trend_case_id first(fs::path("dir/prog"), "", "first");
+    const store::trend_case_id second(fs::path("dir/prog"), "", "second");
+
+    store::case_durations_map durations = index.percentiles(
+        "suite", 10, 3, 100);
+    ATF_REQUIRE_EQ(2, durations.size());
+    ATF_REQUIRE_EQ(datetime::delta(20, 0), durations.find(first)->second);
+    ATF_REQUIRE_EQ(datetime::delta(8, 0), durations.find(second)->second);
+
+    durations = index.percentiles("suite", 2, 1, 50);
+    ATF_REQUIRE_EQ(2, durations.size());
+    ATF_REQUIRE_EQ(datetime::delta(16, 0), durations.find(first)->second);
+    ATF_REQUIRE_EQ(datetime::delta(6, 0), durations.find(second)->second);
+
+    ATF_REQUIRE(index.percentiles("suite", 2, 3, 50).empty());
+    ATF_REQUIRE(index.percentiles("unknown", 10, 1, 50).empty());
+}
+
+
+ATF_TEST_CASE(add_run__replace);
+ATF_TEST_CASE_HEAD(add_run__replace)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(add_run__replace)
+{
+    create_results(fs::path("a.db"), 1, 10, 4,
+                   model::test_result(model::test_result_passed));
+
+    store::trends_index index = store::trends_index::open_rw(
+        fs::path("trends.db"));
+    index.add_run("suite", fs::path("a.db"));
+    index.add_run("suite", fs::path("a.db"));
+    index.close();
+
+    ATF_REQUIRE_EQ(1, count_rows("trends.db", "trend_runs"));
+    ATF_REQUIRE_EQ(2, count_rows("trends.db", "trend_results"));
+}
+
+
+ATF_TEST_CASE(add_run__repeated);
+ATF_TEST_CASE_HEAD(add_run__repeated)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(add_run__repeated)
+{
+    {
+        store::write_backend backend = store::write_backend::open_rw(
+            fs::path("a.db"));
+        store::write_transaction tx = backend.start_write();
+        tx.put_context(model::context(
+            fs::path("/the/root"), std::map< std::string, std::string >()));
+
+        const model::test_program test_program = model::test_program_builder(
+            "plain", fs::path("dir/prog"), fs::path("/the/root"), "suite")
+            .add_test_case("main")
+            .build();
+        const int64_t tp_id = tx.put_test_program(test_program);
+
+        const datetime::timestamp start = datetime::timestamp::from_values(
+            2015, 1, 1, 3, 4, 5, 0);
+        const int64_t tc1_id = tx.put_test_case(test_program, "main", tp_id);
+        tx.put_result(model::test_result(model::test_result_passed), tc1_id,
+                      start, start + datetime::delta(2, 0));
+        const int64_t tc2_id = tx.put_test_case(test_program, "main", tp_id);
+        tx.put_result(model::test_result(model::test_result_failed, "Oops"),
+                      tc2_id, start, start + datetime::delta(4, 0));
+
+        tx.commit();
+        backend.close();
+    }
+
+    store::trends_index index = store::trends_index::open_rw(
+        fs::path("trends.db"));
+    index.add_run("suite", fs::path("a.db"));
+    index.close();
+
+    ATF_REQUIRE_EQ(1, count_rows("trends.db", "trend_runs"));
+    ATF_REQUIRE_EQ(1, count_rows("trends.db", "trend_results"));
+
+    sqlite::database db = sqlite::database::open(fs::path("trends.db"),
+                                                 sqlite::open_readonly);
+    sqlite::statement stmt = db.create_statement(
+        "SELECT result_type, duration FROM trend_results");
+    ATF_REQUIRE(stmt.step());
+    ATF_REQUIRE_EQ("failed", stmt.column_text(0));
+    ATF_REQUIRE_EQ(3000000, stmt.column_int64(1));
+}
+
+
+ATF_TEST_CASE(add_run__invalid);
+ATF_TEST_CASE_HEAD(add_run__invalid)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(add_run__invalid)
+{
+    store::trends_index index = store::trends_index::open_rw(
+        fs::path("trends.db"));
+    ATF_REQUIRE_THROW(store::error,
+                      index.add_run("suite", fs::path("missing.db")));
+    index.close();
+
+    ATF_REQUIRE_EQ(0, count_rows("trends.db", "trend_runs"));
+}
+
+
+ATF_TEST_CASE(sync);
+ATF_TEST_CASE_HEAD(sync)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(sync)
+{
+    utils::setenv("HOME", (fs::current_path() / "homedir").str());
+    const fs::path store_dir = layout::query_store_dir();
+    fs::mkdir_p(store_dir, 0755);
+
+    const model::test_result passed(model::test_result_passed);
+    create_results(store_dir / "results.suite.20150101-030405-000000.db",
+                   1, 10, 4, passed);
+    create_results(store_dir / "results.other.20150102-030405-000000.db",
+                   2, 20, 6, passed);
+    atf::utils::create_file(
+        (store_dir / "results.suite.20150102-030405-000000.db").str(),
+        "invalid");
+
+    store::trends_index index = store::trends_index::open_rw(
+        layout::query_trends_file());
+    ATF_REQUIRE_EQ(1, index.sync("suite"));
+    ATF_REQUIRE_EQ(0, index.sync("suite"));
+
+    create_results(store_dir / "results.suite.20150103-030405-000000.db",
+                   3, 16, 8, passed);
+    ATF_REQUIRE_EQ(1, index.sync("suite"));
+
+    const store::case_trends_vector trends = index.slowdowns("suite", 10, 10);
+    ATF_REQUIRE_EQ(2, trends.size());
+    ATF_REQUIRE_EQ("first", trends[0].test_case);
+    ATF_REQUIRE_EQ("second", trends[1].test_case);
+}
+
+
+ATF_INIT_TEST_CASES(tcs)
+{
+    ATF_ADD_TEST_CASE(tcs, add_run__slowdowns);
+    ATF_ADD_TEST_CASE(tcs, add_run__replace);
+    ATF_ADD_TEST_CASE(tcs, add_run__repeated);
+    ATF_ADD_TEST_CASE(tcs, add_run__invalid);
+
+    ATF_ADD_TEST_CASE(tcs, slowdowns__limits);
+    ATF_ADD_TEST_CASE(tcs, slowdowns__threshold);
+    ATF_ADD_TEST_CASE(tcs, slowdowns_in);
+    ATF_ADD_TEST_CASE(tcs, percentiles);
+
+    ATF_ADD_TEST_CASE(tcs, sync);
+}
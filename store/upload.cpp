@@ -0,0 +1,563 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "store/upload.hpp"
+
+extern "C" {
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+}
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <string>
+
+#include "store/exceptions.hpp"
+#include "store/segment.hpp"
+#include "utils/defs.hpp"
+#include "utils/format/macros.hpp"
+#include "utils/fs/exceptions.hpp"
+#include "utils/fs/operations.hpp"
+#include "utils/fs/path.hpp"
+#include "utils/logging/macros.hpp"
+#include "utils/logging/operations.hpp"
+#include "utils/noncopyable.hpp"
+#include "utils/process/child.ipp"
+#include "utils/process/exceptions.hpp"
+#include "utils/process/fdstream.hpp"
+#include "utils/process/operations.hpp"
+#include "utils/process/status.hpp"
+#include "utils/sanity.hpp"
+#include "utils/signals/interrupts.hpp"
+#include "utils/signals/misc.hpp"
+#include "utils/signals/programmer.hpp"
+#include "utils/sqlite/database.hpp"
+#include "utils/sqlite/exceptions.hpp"
+
+namespace fs = utils::fs;
+namespace logging = utils::logging;
+namespace process = utils::process;
+namespace signals = utils::signals;
+namespace sqlite = utils::sqlite;
+
+
+namespace {
+
+
+/// Acknowledgement sent by the worker for an upload that succeeded.
+static const char ack_success = 'S';
+
+
+/// Acknowledgement sent by the worker for an upload that failed.
+static const char ack_failure = 'F';
+
+
+/// Marks a file descriptor so that it is not inherited by executed programs.
+///
+/// \param fd The file descriptor to mark.
+static void
+set_cloexec(const int fd)
+{
+    (void)::fcntl(fd, F_SETFD, ::fcntl(fd, F_GETFD) | FD_CLOEXEC);
+}
+
+
+/// Closes the two ends of a pipe.
+///
+/// \param fds The descriptors of the pipe, as returned by pipe(2).
+static void
+close_pipe(const int fds[2])
+{
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
+
+
+/// Signal handler that does nothing.
+///
+/// \param unused_signo The signal that caused this handler to be called.
+static void
+null_handler(const int UTILS_UNUSED_PARAM(signo))
+{
+}
+
+
+/// Functor to execute the sink in a subprocess.
+class run_sink_child {
+    /// Path to the sink program.
+    const fs::path _program;
+
+    /// Arguments to pass to the sink.
+    const process::args_vector _args;
+
+public:
+    /// Constructor.
+    ///
+    /// \param program Path to the sink program.
+    /// \param args Arguments to pass to the sink.
+    run_sink_child(const fs::path& program, const process::args_vector& args) :
+        _program(program), _args(args)
+    {
+    }
+
+    /// Executes the sink.
+    void
+    operator()(void) UTILS_NORETURN
+    {
+        process::exec(_program, _args);
+    }
+};
+
+
+/// Runs the sink for a single upload and waits for it to complete.
+///
+/// The output of the sink goes to the stderr of the worker so that any
+/// diagnostics it prints reach the user without clobbering the reports that
+/// may be going to stdout.
+///
+/// \param program Path to the sink program.
+/// \param args Arguments to pass to the sink.
+///
+/// \return True if the sink exited successfully; false otherwise.
+static bool
+run_sink(const fs::path& program, const process::args_vector& args)
+{
+    try {
+        std::auto_ptr< process::child > child = process::child::fork_fds(
+            run_sink_child(program, args), STDERR_FILENO, STDERR_FILENO);
+        const process::status status = child->wait();
+        return status.exited() && status.exitstatus() == EXIT_SUCCESS;
+    } catch (const process::error& e) {
+        std::cerr << F("kyua: E: Cannot run %s: %s.\n") % program % e.what();
+        return false;
+    }
+}
+
+
+/// Main loop of the worker process that runs the sink.
+///
+/// Each request consists of the arguments to pass to the sink, each of them
+/// terminated by a NUL character, followed by an empty argument.  The worker
+/// runs the sink once per request, in order, and acknowledges every request
+/// once its upload is done.  The worker exits when the requests channel is
+/// closed, after going through all the requests received until then.
+///
+/// \param program Path to the sink program.
+/// \param requests_fd Read end of the channel of requests.
+/// \param acks_fd Write end of the channel of acknowledgements.
+static void
+run_worker(const fs::path& program, const int requests_fd, const int acks_fd)
+    UTILS_NORETURN;
+static void
+run_worker(const fs::path& program, const int requests_fd, const int acks_fd)
+{
+    process::ifdstream input(requests_fd);
+    process::args_vector args;
+    std::string arg;
+    while (std::getline(input, arg, '\0')) {
+        if (!arg.empty()) {
+            args.push_back(arg);
+            continue;
+        }
+
+        const char ack = run_sink(program, args) ? ack_success : ack_failure;
+        while (::write(acks_fd, &ack, sizeof(ack)) == -1 && errno == EINTR) {}
+        args.clear();
+    }
+    std::cerr.flush();
+    ::_exit(EXIT_SUCCESS);
+}
+
+
+}  // anonymous namespace
+
+
+/// Gets the path to the snapshots of a results file taken for uploading.
+///
+/// \param results_file The results file being uploaded.
+///
+/// \return The path to the snapshot, which follows the naming scheme of the
+/// journal files of SQLite.
+fs::path
+store::detail::upload_snapshot_path(const fs::path& results_file)
+{
+    return fs::path(results_file.str() + "-snapshot");
+}
+
+
+/// Internal implementation for the uploader.
+struct store::uploader::impl : utils::noncopyable {
+    /// The results file being uploaded.
+    const fs::path results_file;
+
+    /// Write end of the channel of requests to the worker; -1 if closed.
+    int requests_fd;
+
+    /// Read end of the channel of acknowledgements from the worker; -1 if the
+    /// worker is gone.
+    int acks_fd;
+
+    /// Descriptions of the uploads that have not been acknowledged yet.
+    std::deque< std::string > pending;
+
+    /// Number of bytes of the segment file handed to the sink so far.
+    int64_t segment_offset;
+
+    /// Whether finish() has been called.
+    bool finished;
+
+    /// Constructor.
+    ///
+    /// The worker is detached from this process by forking it twice so that
+    /// it never shows up as a terminated child of ours: the executor takes
+    /// care of all of those and would not know what to do with the worker.
+    ///
+    /// \param program Path to the sink program.
+    /// \param results_file_ The results file to upload.
+    ///
+    /// \throw error If the worker cannot be started.
+    impl(const fs::path& program, const fs::path& results_file_) :
+        results_file(results_file_),
+        requests_fd(-1),
+        acks_fd(-1),
+        segment_offset(0),
+        finished(false)
+    {
+        int requests[2];
+        if (::pipe(requests) == -1) {
+            const int original_errno = errno;
+            throw error(F("Cannot create the uploads channel: %s") %
+                        std::strerror(original_errno));
+        }
+        int acks[2];
+        if (::pipe(acks) == -1) {
+            const int original_errno = errno;
+            close_pipe(requests);
+            throw error(F("Cannot create the uploads channel: %s") %
+                        std::strerror(original_errno));
+        }
+
+        std::cout.flush();
+        std::cerr.flush();
+        logging::flush();
+
+        const pid_t pid = ::fork();
+        if (pid == -1) {
+            const int original_errno = errno;
+            close_pipe(requests);
+            close_pipe(acks);
+            throw error(F("Cannot start the upload worker: %s") %
+                        std::strerror(original_errno));
+        } else if (pid == 0) {
+            ::close(requests[1]);
+            ::close(acks[0]);
+            const pid_t worker_pid = ::fork();
+            if (worker_pid == 0) {
+                ::setsid();
+                (void)signals::reset_all();
+                set_cloexec(requests[0]);
+                set_cloexec(acks[1]);
+                run_worker(program, requests[0], acks[1]);
+            }
+            ::_exit(worker_pid == -1 ? EXIT_FAILURE : EXIT_SUCCESS);
+        }
+
+        ::close(requests[0]);
+        ::close(acks[1]);
+        requests_fd = requests[1];
+        acks_fd = acks[0];
+        set_cloexec(requests_fd);
+        set_cloexec(acks_fd);
+        (void)::fcntl(acks_fd, F_SETFL, ::fcntl(acks_fd, F_GETFL) | O_NONBLOCK);
+
+        // The intermediate process is not registered with the signals module
+        // as it terminates right away, so do not use process::wait() on it.
+        int status;
+        while (::waitpid(pid, &status, 0) == -1 && errno == EINTR) {}
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) {
+            close_channels();
+            throw error("Cannot start the upload worker");
+        }
+        LI(F("Uploading %s with %s") % results_file % program);
+    }
+
+    /// Destructor.
+    ///
+    /// If the uploads were not finished, the worker is left behind to complete
+    /// the upload in progress, if any, and to exit on its own afterwards.
+    ~impl(void)
+    {
+        close_channels();
+    }
+
+    /// Closes the channels to the worker that are still open.
+    void
+    close_channels(void)
+    {
+        if (requests_fd != -1) {
+            ::close(requests_fd);
+            requests_fd = -1;
+        }
+        if (acks_fd != -1) {
+            ::close(acks_fd);
+            acks_fd = -1;
+        }
+    }
+
+    /// Processes the acknowledgements sent by the worker.
+    ///
+    /// \param wait Whether to block until the worker exits.  If false, only
+    ///     the acknowledgements that have already arrived are processed.
+    ///
+    /// \throw signals::interrupted_error If an interrupt arrives while
+    ///     waiting.
+    void
+    process_acks(const bool wait)
+    {
+        while (acks_fd != -1) {
+            if (wait) {
+                struct ::pollfd poll_fd;
+                poll_fd.fd = acks_fd;
+                poll_fd.events = POLLIN;
+                if (::poll(&poll_fd, 1, -1) == -1) {
+                    if (errno == EINTR) {
+                        signals::check_interrupt();
+                        continue;
+                    }
+                }
+            }
+
+            char acks[64];
+            const ssize_t count = ::read(acks_fd, acks, sizeof(acks));
+            if (count == -1) {
+                if (errno == EINTR)
+                    continue;
+                if (errno != EAGAIN)
+                    LW(F("Failed to read from the upload worker: %s") %
+                       std::strerror(errno));
+                if (errno != EAGAIN || !wait)
+                    return;
+            } else if (count == 0) {
+                if (!pending.empty())
+                    LW(F("The upload worker exited with %s uploads pending") %
+                       pending.size());
+                pending.clear();
+                ::close(acks_fd);
+                acks_fd = -1;
+            } else {
+                for (ssize_t i = 0; i < count && !pending.empty(); ++i) {
+                    if (acks[i] == ack_success)
+                        LD(F("Uploaded %s") % pending.front());
+                    else
+                        LW(F("Failed to upload %s") % pending.front());
+                    pending.pop_front();
+                }
+            }
+        }
+    }
+
+    /// Hands an upload over to the worker.
+    ///
+    /// \param args The arguments to pass to the sink.
+    void
+    request(const process::args_vector& args)
+    {
+        PRE(!args.empty());
+        if (requests_fd == -1 || acks_fd == -1) {
+            LD(F("Not uploading %s: the upload worker is gone") % args[0]);
+            return;
+        }
+
+        std::string message;
+        std::string description;
+        for (process::args_vector::const_iterator iter = args.begin();
+             iter != args.end(); ++iter) {
+            PRE(!(*iter).empty() && (*iter).find('\0') == std::string::npos);
+            message += *iter;
+            message += '\0';
+            if (!description.empty())
+                description += ' ';
+            description += *iter;
+        }
+        message += '\0';
+
+        // Writing to the worker after it died raises SIGPIPE, which must not
+        // take us down: the results are what matters, not their upload.
+        signals::programmer sigpipe(SIGPIPE, null_handler);
+        std::size_t done = 0;
+        while (done < message.length()) {
+            const ssize_t count = ::write(requests_fd, message.data() + done,
+                                          message.length() - done);
+            if (count == -1) {
+                if (errno == EINTR)
+                    continue;
+                LW(F("Failed to send %s to the upload worker: %s") %
+                   description % std::strerror(errno));
+                ::close(requests_fd);
+                requests_fd = -1;
+                break;
+            }
+            done += count;
+        }
+        sigpipe.unprogram();
+
+        if (done == message.length())
+            pending.push_back(description);
+    }
+
+    /// Hands the part of the segment file not uploaded yet to the worker.
+    void
+    request_segment(void)
+    {
+        const fs::path segment = detail::segment_path(results_file);
+        struct ::stat sb;
+        if (::stat(segment.c_str(), &sb) == -1)
+            return;
+        const int64_t size = static_cast< int64_t >(sb.st_size);
+        if (size <= segment_offset)
+            return;
+
+        process::args_vector args;
+        args.push_back("segment");
+        args.push_back(segment.str());
+        args.push_back(F("%s") % segment_offset);
+        args.push_back(F("%s") % (size - segment_offset));
+        request(args);
+        segment_offset = size;
+    }
+};
+
+
+/// Starts the background uploads of a results file.
+///
+/// \param program Path to the sink, the program that performs the uploads.
+/// \param results_file The results file to upload.  It need not exist yet.
+///
+/// \throw error If the worker that runs the sink cannot be started.
+store::uploader::uploader(const fs::path& program,
+                          const fs::path& results_file) :
+    _pimpl(new impl(program, results_file))
+{
+}
+
+
+/// Destructor.
+store::uploader::~uploader(void)
+{
+}
+
+
+/// Uploads the state of the results database at a checkpoint.
+///
+/// This takes a snapshot of the database and hands it to the sink along with
+/// the new contents of the segment file.  The database must not be in the
+/// middle of any write, which is the case right after a commit.
+///
+/// \param db The connection to the results database.  Taking the snapshot
+///     from it allows uploading databases that do not live in a file yet.
+///
+/// \return True if the uploads were handed to the sink; false if the sink was
+/// still busy with previous uploads, in which case this checkpoint is skipped.
+///
+/// \pre finish() has not been called yet.
+///
+/// \throw error If the snapshot cannot be taken.
+bool
+store::uploader::checkpoint(sqlite::database& db)
+{
+    PRE(!_pimpl->finished);
+
+    _pimpl->process_acks(false);
+    if (!_pimpl->pending.empty()) {
+        LD(F("Skipping upload checkpoint; %s uploads still pending") %
+           _pimpl->pending.size());
+        return false;
+    }
+
+    const fs::path snapshot = detail::upload_snapshot_path(
+        _pimpl->results_file);
+    try {
+        sqlite::database target = sqlite::database::open(
+            snapshot, sqlite::open_readwrite | sqlite::open_create);
+        db.backup(target);
+        target.close();
+    } catch (const sqlite::error& e) {
+        throw error(F("Cannot take snapshot %s: %s") % snapshot % e.what());
+    }
+
+    process::args_vector args;
+    args.push_back("snapshot");
+    args.push_back(snapshot.str());
+    _pimpl->request(args);
+    _pimpl->request_segment();
+    return true;
+}
+
+
+/// Uploads the complete results file and waits for all uploads to finish.
+///
+/// \pre finish() has not been called yet.
+/// \pre The results file is complete and all its contents are committed.
+///
+/// \throw signals::interrupted_error If an interrupt arrives while waiting.
+void
+store::uploader::finish(void)
+{
+    PRE(!_pimpl->finished);
+    _pimpl->finished = true;
+
+    _pimpl->request_segment();
+    process::args_vector args;
+    args.push_back("results");
+    args.push_back(_pimpl->results_file.str());
+    _pimpl->request(args);
+
+    if (_pimpl->requests_fd != -1) {
+        ::close(_pimpl->requests_fd);
+        _pimpl->requests_fd = -1;
+    }
+    _pimpl->process_acks(true);
+
+    const fs::path snapshot = detail::upload_snapshot_path(
+        _pimpl->results_file);
+    if (fs::exists(snapshot)) {
+        try {
+            fs::unlink(snapshot);
+        } catch (const fs::error& e) {
+            LW(F("Failed to remove snapshot %s: %s") % snapshot % e.what());
+        }
+    }
+}
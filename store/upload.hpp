@@ -0,0 +1,88 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// \file store/upload.hpp
+/// Upload of results files to remote storage while they are being written.
+///
+/// An uploader hands the files that make up a results database to an external
+/// program, the sink, which is in charge of copying them to wherever they have
+/// to go.  The sink runs in a background process so that slow uploads do not
+/// delay the run.
+
+#if !defined(STORE_UPLOAD_HPP)
+#define STORE_UPLOAD_HPP
+
+#include <memory>
+
+#include "utils/fs/path_fwd.hpp"
+#include "utils/noncopyable.hpp"
+#include "utils/sqlite/database_fwd.hpp"
+
+namespace store {
+
+
+namespace detail {
+
+
+utils::fs::path upload_snapshot_path(const utils::fs::path&);
+
+
+}  // namespace detail
+
+
+/// Feeds the files of a results database to a sink while a run progresses.
+///
+/// The sink is invoked once per file to upload with the kind of the file and
+/// its path as arguments:
+///
+/// * "snapshot <path>": a consistent copy of the database taken at a
+///   checkpoint, which replaces any previous snapshot.
+/// * "segment <path> <offset> <length>": a range of the segment file of the
+///   database that has not been uploaded yet.
+/// * "results <path>": the complete results file, once the run is done.
+///
+/// The invocations happen in order, one at a time, and new checkpoints are
+/// ignored while the sink is still busy with the previous ones.
+class uploader : utils::noncopyable {
+    struct impl;
+
+    /// Pointer to the internal implementation.
+    std::auto_ptr< impl > _pimpl;
+
+public:
+    uploader(const utils::fs::path&, const utils::fs::path&);
+    ~uploader(void);
+
+    bool checkpoint(utils::sqlite::database&);
+    void finish(void);
+};
+
+
+}  // namespace store
+
+#endif  // !defined(STORE_UPLOAD_HPP)
@@ -0,0 +1,249 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "store/upload.hpp"
+
+extern "C" {
+#include <sys/stat.h>
+}
+
+#include <fstream>
+#include <string>
+
+#include <atf-c++.hpp>
+
+#include "store/segment.hpp"
+#include "utils/format/macros.hpp"
+#include "utils/fs/operations.hpp"
+#include "utils/fs/path.hpp"
+#include "utils/sqlite/database.hpp"
+#include "utils/sqlite/statement.ipp"
+
+namespace fs = utils::fs;
+namespace sqlite = utils::sqlite;
+
+
+namespace {
+
+
+/// Creates a sink that records its invocations in the sink.log file.
+///
+/// The sink also copies every snapshot it gets to snapshot.copy and, if the
+/// wait file exists, waits for the go file to appear before completing.
+///
+/// \param exit_code Exit code for the sink to return.
+///
+/// \return The path to the sink.
+static fs::path
+create_sink(const int exit_code = 0)
+{
+    const fs::path cwd = fs::current_path();
+    atf::utils::create_file(
+        "sink",
+        F("#! /bin/sh\n"
+          "echo \"$*\" >>%s\n"
+          "[ \"${1}\" = snapshot ] && cp \"${2}\" %s\n"
+          "if [ -f %s ]; then\n"
+          "    while [ ! -f %s ]; do sleep 0.01; done\n"
+          "fi\n"
+          "exit %s\n") % (cwd / "sink.log") % (cwd / "snapshot.copy") %
+        (cwd / "wait") % (cwd / "go") % exit_code);
+    ATF_REQUIRE(::chmod("sink", 0755) != -1);
+    return cwd / "sink";
+}
+
+
+/// Creates a database with a single row.
+///
+/// \param file The database to create.
+/// \param value The value to store in its row.
+///
+/// \return The connection to the database.
+static sqlite::database
+create_database(const fs::path& file, const int value)
+{
+    sqlite::database db = sqlite::database::open(
+        file, sqlite::open_readwrite | sqlite::open_create);
+    db.exec(F("CREATE TABLE data (value INTEGER); "
+              "INSERT INTO data VALUES (%s);") % value);
+    return db;
+}
+
+
+/// Appends some text to a file.
+///
+/// \param file The file to append to.
+/// \param text The text to append.
+static void
+append_file(const fs::path& file, const char* text)
+{
+    std::ofstream output(file.c_str(), std::ios::app);
+    ATF_REQUIRE(output);
+    output << text;
+}
+
+
+}  // anonymous namespace
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(upload_snapshot_path);
+ATF_TEST_CASE_BODY(upload_snapshot_path)
+{
+    ATF_REQUIRE_EQ(fs::path("/a/results.db-snapshot"),
+                   store::detail::upload_snapshot_path(
+                       fs::path("/a/results.db")));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(uploader__finish_only);
+ATF_TEST_CASE_BODY(uploader__finish_only)
+{
+    const fs::path results = fs::current_path() / "results.db";
+    create_database(results, 1).close();
+
+    store::uploader uploader(create_sink(), results);
+    uploader.finish();
+
+    ATF_REQUIRE(atf::utils::compare_file(
+        "sink.log", F("results %s\n") % results));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(uploader__checkpoints);
+ATF_TEST_CASE_BODY(uploader__checkpoints)
+{
+    const fs::path results = fs::current_path() / "results.db";
+    const fs::path segment = store::detail::segment_path(results);
+    const fs::path snapshot = store::detail::upload_snapshot_path(results);
+    sqlite::database db = create_database(results, 1234);
+    append_file(segment, "first");
+
+    store::uploader uploader(create_sink(), results);
+    ATF_REQUIRE(uploader.checkpoint(db));
+    append_file(segment, "second");
+    uploader.finish();
+    ATF_REQUIRE(!fs::exists(snapshot));
+
+    ATF_REQUIRE(atf::utils::compare_file(
+        "sink.log",
+        F("snapshot %s\n"
+          "segment %s 0 5\n"
+          "segment %s 5 6\n"
+          "results %s\n") % snapshot % segment % segment % results));
+
+    sqlite::database copy = sqlite::database::open(
+        fs::path("snapshot.copy"), sqlite::open_readonly);
+    sqlite::statement stmt = copy.create_statement("SELECT value FROM data");
+    ATF_REQUIRE(stmt.step());
+    ATF_REQUIRE_EQ(1234, stmt.column_int(0));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(uploader__in_memory);
+ATF_TEST_CASE_BODY(uploader__in_memory)
+{
+    const fs::path results = fs::current_path() / "results.db";
+    sqlite::database db = sqlite::database::in_memory();
+    db.exec("CREATE TABLE data (value INTEGER); INSERT INTO data VALUES (5);");
+
+    store::uploader uploader(create_sink(), results);
+    ATF_REQUIRE(uploader.checkpoint(db));
+    create_database(results, 5).close();
+    uploader.finish();
+
+    ATF_REQUIRE(atf::utils::compare_file(
+        "sink.log",
+        F("snapshot %s\n"
+          "results %s\n") % store::detail::upload_snapshot_path(results) %
+        results));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(uploader__skip_while_busy);
+ATF_TEST_CASE_BODY(uploader__skip_while_busy)
+{
+    const fs::path results = fs::current_path() / "results.db";
+    sqlite::database db = create_database(results, 1);
+    atf::utils::create_file("wait", "");
+
+    store::uploader uploader(create_sink(), results);
+    ATF_REQUIRE(uploader.checkpoint(db));
+    ATF_REQUIRE(!uploader.checkpoint(db));
+    atf::utils::create_file("go", "");
+    uploader.finish();
+
+    ATF_REQUIRE(atf::utils::compare_file(
+        "sink.log",
+        F("snapshot %s\n"
+          "results %s\n") % store::detail::upload_snapshot_path(results) %
+        results));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(uploader__sink_fails);
+ATF_TEST_CASE_BODY(uploader__sink_fails)
+{
+    const fs::path results = fs::current_path() / "results.db";
+    sqlite::database db = create_database(results, 1);
+
+    store::uploader uploader(create_sink(1), results);
+    ATF_REQUIRE(uploader.checkpoint(db));
+    uploader.finish();
+
+    ATF_REQUIRE(atf::utils::compare_file(
+        "sink.log",
+        F("snapshot %s\n"
+          "results %s\n") % store::detail::upload_snapshot_path(results) %
+        results));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(uploader__sink_missing);
+ATF_TEST_CASE_BODY(uploader__sink_missing)
+{
+    const fs::path results = fs::current_path() / "results.db";
+    sqlite::database db = create_database(results, 1);
+
+    store::uploader uploader(fs::current_path() / "missing", results);
+    ATF_REQUIRE(uploader.checkpoint(db));
+    uploader.finish();
+    ATF_REQUIRE(!fs::exists(store::detail::upload_snapshot_path(results)));
+}
+
+
+ATF_INIT_TEST_CASES(tcs)
+{
+    ATF_ADD_TEST_CASE(tcs, upload_snapshot_path);
+
+    ATF_ADD_TEST_CASE(tcs, uploader__finish_only);
+    ATF_ADD_TEST_CASE(tcs, uploader__checkpoints);
+    ATF_ADD_TEST_CASE(tcs, uploader__in_memory);
+    ATF_ADD_TEST_CASE(tcs, uploader__skip_while_busy);
+    ATF_ADD_TEST_CASE(tcs, uploader__sink_fails);
+    ATF_ADD_TEST_CASE(tcs, uploader__sink_missing);
+}
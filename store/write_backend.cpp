@@ -28,6 +28,7 @@
 
 #include "store/write_backend.hpp"
 
+#include <cstddef>
 #include <stdexcept>
 
 #include "store/exceptions.hpp"
@@ -36,9 +37,11 @@
 #include "store/write_transaction.hpp"
 #include "utils/env.hpp"
 #include "utils/format/macros.hpp"
+#include "utils/fs/operations.hpp"
 #include "utils/fs/path.hpp"
 #include "utils/logging/macros.hpp"
 #include "utils/noncopyable.hpp"
+#include "utils/optional.ipp"
 #include "utils/sanity.hpp"
 #include "utils/stream.hpp"
 #include "utils/sqlite/database.hpp"
@@ -60,7 +63,7 @@ namespace sqlite = utils::sqlite;
 ///
 /// This variable is not const to allow tests to modify it.  No other code
 /// should change its value.
-int store::detail::current_schema_version = 3;
+int store::detail::current_schema_version = 4;
 
 
 namespace {
@@ -79,6 +82,94 @@ empty_database(sqlite::database& db)
 }
 
 
+/// Checks if a string is part of a list of valid values.
+///
+/// \param value The string to check.
+/// \param valid NULL-terminated list of valid values.
+///
+/// \return True if the value is in the list.
+static bool
+is_one_of(const std::string& value, const char* const* valid)
+{
+    for (; *valid != NULL; ++valid) {
+        if (value == *valid)
+            return true;
+    }
+    return false;
+}
+
+
+/// Validates a write profile.
+///
+/// \param profile The profile to validate.
+///
+/// \throw store::error If any of the settings is invalid.
+static void
+validate_profile(const store::write_profile& profile)
+{
+    static const char* const journal_modes[] = {
+        "delete", "truncate", "persist", "memory", "wal", "off", NULL };
+    static const char* const synchronous_modes[] = {
+        "off", "normal", "full", "extra", NULL };
+
+    if (profile.journal_mode &&
+        !is_one_of(profile.journal_mode.get(), journal_modes))
+        throw store::error(F("Invalid journal mode '%s'") %
+                           profile.journal_mode.get());
+    if (profile.synchronous &&
+        !is_one_of(profile.synchronous.get(), synchronous_modes))
+        throw store::error(F("Invalid synchronous mode '%s'") %
+                           profile.synchronous.get());
+    if (profile.mmap_size && profile.mmap_size.get() < 0)
+        throw store::error(F("Invalid mmap size %s; must be positive or 0") %
+                           profile.mmap_size.get());
+    if (profile.page_size) {
+        const int page_size = profile.page_size.get();
+        if (page_size < 512 || page_size > 65536 ||
+            (page_size & (page_size - 1)) != 0)
+            throw store::error(F("Invalid page size %s; must be a power of "
+                                 "two between 512 and 65536") % page_size);
+    }
+}
+
+
+/// Applies a write profile to a database.
+///
+/// This must be called before the database is initialized because the page
+/// size cannot be changed once the database contains data.
+///
+/// \param db The database to configure.
+/// \param profile The settings to apply, already validated.
+///
+/// \throw sqlite::error If any of the settings cannot be applied.
+static void
+apply_profile(sqlite::database& db, const store::write_profile& profile)
+{
+    if (profile.page_size)
+        db.exec(F("PRAGMA page_size = %s") % profile.page_size.get());
+
+    if (profile.journal_mode) {
+        sqlite::statement stmt = db.create_statement(
+            F("PRAGMA journal_mode = %s") % profile.journal_mode.get());
+        // SQLite does not fail when the requested journal mode cannot be
+        // used (e.g. WAL on some file systems) but it reports the mode that
+        // is actually in effect.
+        if (stmt.step() &&
+            stmt.column_text(0) != profile.journal_mode.get()) {
+            LW(F("Cannot set journal mode to %s; using %s") %
+               profile.journal_mode.get() % stmt.column_text(0));
+        }
+    }
+
+    if (profile.synchronous)
+        db.exec(F("PRAGMA synchronous = %s") % profile.synchronous.get());
+    if (profile.cache_size)
+        db.exec(F("PRAGMA cache_size = %s") % profile.cache_size.get());
+    if (profile.mmap_size)
+        db.exec(F("PRAGMA mmap_size = %s") % profile.mmap_size.get());
+}
+
+
 }  // anonymous namespace
 
 
@@ -162,19 +253,95 @@ store::write_backend::~write_backend(void)
 /// Opens a database in read-write mode and creates it if necessary.
 ///
 /// \param file The database file to be opened.
+/// \param profile The SQLite settings to apply to the database.
 ///
 /// \return The backend representation.
 ///
 /// \throw store::error If there is any problem opening or creating
-///     the database.
+///     the database, or if the profile is invalid.
 store::write_backend
-store::write_backend::open_rw(const fs::path& file)
+store::write_backend::open_rw(const fs::path& file,
+                              const write_profile& profile)
 {
+    validate_profile(profile);
+
     sqlite::database db = detail::open_and_setup(
         file, sqlite::open_readwrite | sqlite::open_create);
     if (!empty_database(db))
         throw error(F("%s already exists and is not empty; cannot open "
                       "for write") % file);
+    try {
+        apply_profile(db, profile);
+    } catch (const sqlite::error& e) {
+        throw error(F("Cannot configure '%s': %s") % file % e.what());
+    }
+    detail::initialize(db);
+    return write_backend(new impl(db));
+}
+
+
+/// Opens an existing database in read-write mode to add more results to it.
+///
+/// This allows resuming a run that was interrupted: the results already in the
+/// database are kept and new test programs, test cases and results are
+/// appended after them.
+///
+/// \param file The database file to be opened.
+/// \param profile The SQLite settings to apply to the database.  The page size
+///     cannot change once a database has contents, so it is ignored.
+///
+/// \return The backend representation.
+///
+/// \throw store::error If there is any problem opening the database, if it is
+///     empty, if its schema is not the current one or if the profile is
+///     invalid.
+store::write_backend
+store::write_backend::open_append(const fs::path& file,
+                                  const write_profile& profile)
+{
+    validate_profile(profile);
+
+    sqlite::database db = detail::open_and_setup(file, sqlite::open_readwrite);
+    if (empty_database(db))
+        throw error(F("%s is empty; cannot append to it") % file);
+    const metadata metadata = metadata::fetch_latest(db);
+    if (metadata.schema_version() < detail::current_schema_version)
+        throw old_schema_error(metadata.schema_version());
+    else if (metadata.schema_version() > detail::current_schema_version)
+        throw integrity_error(
+            F("Database at schema version %s, which is newer than the "
+              "supported version %s")
+            % metadata.schema_version() % detail::current_schema_version);
+
+    write_profile current_profile = profile;
+    current_profile.page_size = utils::none;
+    try {
+        apply_profile(db, current_profile);
+    } catch (const sqlite::error& e) {
+        throw error(F("Cannot configure '%s': %s") % file % e.what());
+    }
+    return write_backend(new impl(db));
+}
+
+
+/// Creates a database that is only kept in memory.
+///
+/// The contents of the database are lost once the backend is closed unless
+/// they are first written to disk with save().  This avoids all the I/O on
+/// the results file while a run is in progress.
+///
+/// \return The backend representation.
+///
+/// \throw store::error If there is any problem creating the database.
+store::write_backend
+store::write_backend::open_in_memory(void)
+{
+    sqlite::database db = sqlite::database::in_memory();
+    try {
+        db.exec("PRAGMA foreign_keys = ON");
+    } catch (const sqlite::error& e) {
+        throw error(F("Cannot set up in-memory database: %s") % e.what());
+    }
     detail::initialize(db);
     return write_backend(new impl(db));
 }
@@ -188,6 +355,56 @@ store::write_backend::close(void)
 }
 
 
+/// Checks that save() can write a database to a file.
+///
+/// This allows failing early, before doing the work to fill the database,
+/// instead of when saving it.
+///
+/// \param file The database file that will be created.
+///
+/// \throw store::error If the file already exists and is not empty or cannot
+///     be opened.
+void
+store::write_backend::check_save(const fs::path& file)
+{
+    if (!fs::exists(file))
+        return;
+    sqlite::database target = detail::open_and_setup(file,
+                                                     sqlite::open_readonly);
+    if (!empty_database(target))
+        throw error(F("%s already exists and is not empty; cannot save "
+                      "database") % file);
+    target.close();
+}
+
+
+/// Writes a copy of the database to a new file.
+///
+/// This is intended to persist the contents of a database created by
+/// open_in_memory() with a single sequential write once they are complete.
+/// Any pending write transaction is not included in the copy.
+///
+/// \param file The database file to create.
+///
+/// \throw store::error If the file already exists and is not empty, or if
+///     there is any problem writing it.
+void
+store::write_backend::save(const fs::path& file)
+{
+    sqlite::database target = detail::open_and_setup(
+        file, sqlite::open_readwrite | sqlite::open_create);
+    if (!empty_database(target))
+        throw error(F("%s already exists and is not empty; cannot save "
+                      "database") % file);
+    try {
+        _pimpl->database.backup(target);
+    } catch (const sqlite::error& e) {
+        throw error(F("Cannot save database to '%s': %s") % file % e.what());
+    }
+    target.close();
+}
+
+
 /// Gets the connection to the SQLite database.
 ///
 /// \return A database connection.
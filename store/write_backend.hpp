@@ -34,9 +34,12 @@
 
 #include "store/write_backend_fwd.hpp"
 
+#include <string>
+
 #include "store/metadata_fwd.hpp"
 #include "store/write_transaction_fwd.hpp"
 #include "utils/fs/path_fwd.hpp"
+#include "utils/optional.hpp"
 #include "utils/shared_ptr.hpp"
 #include "utils/sqlite/database_fwd.hpp"
 
@@ -53,6 +56,28 @@ metadata initialize(utils::sqlite::database&);
 }  // anonymous namespace
 
 
+/// SQLite settings to apply to a database opened for writing.
+///
+/// These allow trading the durability of the results file for a lower write
+/// latency.  Settings that are not set keep the defaults of SQLite.
+struct write_profile {
+    /// Journal mode: delete, truncate, persist, memory, wal or off.
+    utils::optional< std::string > journal_mode;
+
+    /// Synchronous mode: off, normal, full or extra.
+    utils::optional< std::string > synchronous;
+
+    /// Size of the page cache: in pages if positive or in KiB if negative.
+    utils::optional< int > cache_size;
+
+    /// Maximum amount of bytes of the database to access via mmap(2).
+    utils::optional< int > mmap_size;
+
+    /// Size of the database pages: a power of two between 512 and 65536.
+    utils::optional< int > page_size;
+};
+
+
 /// Public interface to the database store for write-only operations.
 class write_backend {
     struct impl;
@@ -67,8 +92,14 @@ class write_backend {
 public:
     ~write_backend(void);
 
-    static write_backend open_rw(const utils::fs::path&);
+    static write_backend open_rw(const utils::fs::path&,
+                                 const write_profile& = write_profile());
+    static write_backend open_append(const utils::fs::path&,
+                                     const write_profile& = write_profile());
+    static write_backend open_in_memory(void);
+    static void check_save(const utils::fs::path&);
     void close(void);
+    void save(const utils::fs::path&);
 
     utils::sqlite::database& database(void);
     write_transaction start_write(void);
@@ -45,6 +45,7 @@ extern int current_schema_version;
 
 
 class write_backend;
+struct write_profile;
 
 
 }  // namespace store
@@ -28,14 +28,20 @@
 
 #include "store/write_backend.hpp"
 
+#include <string>
+
 #include <atf-c++.hpp>
 
 #include "store/exceptions.hpp"
 #include "store/metadata.hpp"
+#include "store/read_backend.hpp"
 #include "utils/datetime.hpp"
 #include "utils/env.hpp"
+#include "utils/format/macros.hpp"
+#include "utils/fs/operations.hpp"
 #include "utils/fs/path.hpp"
 #include "utils/logging/operations.hpp"
+#include "utils/optional.ipp"
 #include "utils/sqlite/database.hpp"
 #include "utils/sqlite/exceptions.hpp"
 #include "utils/sqlite/statement.ipp"
@@ -46,6 +52,30 @@ namespace logging = utils::logging;
 namespace sqlite = utils::sqlite;
 
 
+namespace {
+
+
+/// Queries the value of a pragma.
+///
+/// \param db The database to query.
+/// \param name The name of the pragma.
+///
+/// \return The textual representation of the value of the pragma.
+static std::string
+get_pragma(sqlite::database& db, const std::string& name)
+{
+    sqlite::statement stmt = db.create_statement("PRAGMA " + name);
+    ATF_REQUIRE(stmt.step());
+    if (stmt.column_type(0) == sqlite::type_integer)
+        return F("%s") % stmt.column_int64(0);
+    else
+        return stmt.column_text(0);
+}
+
+
+}  // anonymous namespace
+
+
 ATF_TEST_CASE(detail__initialize__ok);
 ATF_TEST_CASE_HEAD(detail__initialize__ok)
 {
@@ -106,7 +136,7 @@ ATF_TEST_CASE_WITHOUT_HEAD(detail__schema_file__builtin);
 ATF_TEST_CASE_BODY(detail__schema_file__builtin)
 {
     utils::unsetenv("KYUA_STOREDIR");
-    ATF_REQUIRE_EQ(fs::path(KYUA_STOREDIR) / "schema_v3.sql",
+    ATF_REQUIRE_EQ(fs::path(KYUA_STOREDIR) / "schema_v4.sql",
                    store::detail::schema_file());
 }
 
@@ -171,6 +201,208 @@ ATF_TEST_CASE_BODY(write_backend__open_rw__create_missing)
 }
 
 
+ATF_TEST_CASE(write_backend__open_rw__profile);
+ATF_TEST_CASE_HEAD(write_backend__open_rw__profile)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(write_backend__open_rw__profile)
+{
+    store::write_profile profile;
+    profile.journal_mode = "memory";
+    profile.synchronous = "off";
+    profile.cache_size = -4096;
+    profile.mmap_size = 0;
+    profile.page_size = 8192;
+
+    store::write_backend backend = store::write_backend::open_rw(
+        fs::path("test.db"), profile);
+    sqlite::database& db = backend.database();
+    ATF_REQUIRE_EQ("memory", get_pragma(db, "journal_mode"));
+    ATF_REQUIRE_EQ("0", get_pragma(db, "synchronous"));
+    ATF_REQUIRE_EQ("-4096", get_pragma(db, "cache_size"));
+    ATF_REQUIRE_EQ("8192", get_pragma(db, "page_size"));
+    db.exec("SELECT * FROM metadata");
+}
+
+
+ATF_TEST_CASE(write_backend__open_rw__invalid_profile);
+ATF_TEST_CASE_HEAD(write_backend__open_rw__invalid_profile)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(write_backend__open_rw__invalid_profile)
+{
+    {
+        store::write_profile profile;
+        profile.journal_mode = "WAL; DROP TABLE metadata";
+        ATF_REQUIRE_THROW_RE(store::error, "Invalid journal mode",
+                             store::write_backend::open_rw(
+                                 fs::path("test.db"), profile));
+    }
+    {
+        store::write_profile profile;
+        profile.synchronous = "sometimes";
+        ATF_REQUIRE_THROW_RE(store::error, "Invalid synchronous mode",
+                             store::write_backend::open_rw(
+                                 fs::path("test.db"), profile));
+    }
+    {
+        store::write_profile profile;
+        profile.mmap_size = -1;
+        ATF_REQUIRE_THROW_RE(store::error, "Invalid mmap size -1",
+                             store::write_backend::open_rw(
+                                 fs::path("test.db"), profile));
+    }
+    {
+        store::write_profile profile;
+        profile.page_size = 1000;
+        ATF_REQUIRE_THROW_RE(store::error, "Invalid page size 1000",
+                             store::write_backend::open_rw(
+                                 fs::path("test.db"), profile));
+    }
+    ATF_REQUIRE(!fs::exists(fs::path("test.db")));
+}
+
+
+ATF_TEST_CASE(write_backend__open_append__ok);
+ATF_TEST_CASE_HEAD(write_backend__open_append__ok)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(write_backend__open_append__ok)
+{
+    {
+        store::write_backend backend = store::write_backend::open_rw(
+            fs::path("test.db"));
+        backend.database().exec("INSERT INTO contexts (cwd) VALUES ('/a')");
+        backend.close();
+    }
+
+    store::write_profile profile;
+    profile.journal_mode = "wal";
+    profile.page_size = 8192;
+    store::write_backend backend = store::write_backend::open_append(
+        fs::path("test.db"), profile);
+    sqlite::database& db = backend.database();
+    ATF_REQUIRE_EQ("wal", get_pragma(db, "journal_mode"));
+    db.exec("INSERT INTO contexts (cwd) VALUES ('/b')");
+    sqlite::statement stmt = db.create_statement(
+        "SELECT COUNT(*) FROM contexts");
+    ATF_REQUIRE(stmt.step());
+    ATF_REQUIRE_EQ(2, stmt.column_int64(0));
+}
+
+
+ATF_TEST_CASE(write_backend__open_append__errors);
+ATF_TEST_CASE_HEAD(write_backend__open_append__errors)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(write_backend__open_append__errors)
+{
+    ATF_REQUIRE_THROW(store::error, store::write_backend::open_append(
+                          fs::path("missing.db")));
+
+    {
+        sqlite::database db = sqlite::database::open(
+            fs::path("empty.db"), sqlite::open_readwrite | sqlite::open_create);
+    }
+    ATF_REQUIRE_THROW_RE(store::error, "empty.db is empty",
+                         store::write_backend::open_append(
+                             fs::path("empty.db")));
+
+    {
+        store::write_backend backend = store::write_backend::open_rw(
+            fs::path("old.db"));
+        backend.database().exec("UPDATE metadata SET schema_version = 3");
+        backend.close();
+    }
+    ATF_REQUIRE_THROW(store::old_schema_error,
+                      store::write_backend::open_append(fs::path("old.db")));
+}
+
+
+ATF_TEST_CASE(write_backend__open_in_memory);
+ATF_TEST_CASE_HEAD(write_backend__open_in_memory)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(write_backend__open_in_memory)
+{
+    store::write_backend backend = store::write_backend::open_in_memory();
+    backend.database().exec("SELECT * FROM metadata");
+    ATF_REQUIRE(!backend.database().db_filename());
+}
+
+
+ATF_TEST_CASE(write_backend__save__ok);
+ATF_TEST_CASE_HEAD(write_backend__save__ok)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(write_backend__save__ok)
+{
+    store::write_backend backend = store::write_backend::open_in_memory();
+    backend.database().exec("CREATE TABLE extra (col INTEGER PRIMARY KEY)");
+    backend.database().exec("INSERT INTO extra VALUES (5)");
+    backend.save(fs::path("test.db"));
+    backend.close();
+
+    store::read_backend copy = store::read_backend::open_ro(
+        fs::path("test.db"));
+    sqlite::statement stmt = copy.database().create_statement(
+        "SELECT col FROM extra");
+    ATF_REQUIRE(stmt.step());
+    ATF_REQUIRE_EQ(5, stmt.column_int(0));
+    ATF_REQUIRE(!stmt.step());
+}
+
+
+ATF_TEST_CASE(write_backend__save__error_if_not_empty);
+ATF_TEST_CASE_HEAD(write_backend__save__error_if_not_empty)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(write_backend__save__error_if_not_empty)
+{
+    store::write_backend::open_rw(fs::path("test.db")).close();
+
+    store::write_backend backend = store::write_backend::open_in_memory();
+    ATF_REQUIRE_THROW_RE(store::error, "test.db already exists",
+                         backend.save(fs::path("test.db")));
+}
+
+
+ATF_TEST_CASE(write_backend__check_save);
+ATF_TEST_CASE_HEAD(write_backend__check_save)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(write_backend__check_save)
+{
+    store::write_backend::check_save(fs::path("test.db"));
+    ATF_REQUIRE(!fs::exists(fs::path("test.db")));
+
+    atf::utils::create_file("test.db", "");
+    store::write_backend::check_save(fs::path("test.db"));
+
+    fs::unlink(fs::path("test.db"));
+    store::write_backend::open_rw(fs::path("test.db")).close();
+    ATF_REQUIRE_THROW_RE(store::error, "test.db already exists",
+                         store::write_backend::check_save(
+                             fs::path("test.db")));
+}
+
+
 ATF_TEST_CASE(write_backend__close);
 ATF_TEST_CASE_HEAD(write_backend__close)
 {
@@ -200,5 +432,13 @@ ATF_INIT_TEST_CASES(tcs)
     ATF_ADD_TEST_CASE(tcs, write_backend__open_rw__ok_if_empty);
     ATF_ADD_TEST_CASE(tcs, write_backend__open_rw__error_if_not_empty);
     ATF_ADD_TEST_CASE(tcs, write_backend__open_rw__create_missing);
+    ATF_ADD_TEST_CASE(tcs, write_backend__open_rw__profile);
+    ATF_ADD_TEST_CASE(tcs, write_backend__open_rw__invalid_profile);
+    ATF_ADD_TEST_CASE(tcs, write_backend__open_append__ok);
+    ATF_ADD_TEST_CASE(tcs, write_backend__open_append__errors);
+    ATF_ADD_TEST_CASE(tcs, write_backend__open_in_memory);
+    ATF_ADD_TEST_CASE(tcs, write_backend__save__ok);
+    ATF_ADD_TEST_CASE(tcs, write_backend__save__error_if_not_empty);
+    ATF_ADD_TEST_CASE(tcs, write_backend__check_save);
     ATF_ADD_TEST_CASE(tcs, write_backend__close);
 }
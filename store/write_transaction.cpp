@@ -29,11 +29,25 @@
 #include "store/write_transaction.hpp"
 
 extern "C" {
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <fcntl.h>
 #include <stdint.h>
+#include <unistd.h>
 }
 
+#include <algorithm>
 #include <fstream>
+#include <limits>
 #include <map>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
 
 #include "model/context.hpp"
 #include "model/metadata.hpp"
@@ -41,24 +55,32 @@ extern "C" {
 #include "model/test_program.hpp"
 #include "model/test_result.hpp"
 #include "model/types.hpp"
+#include "store/codec.hpp"
 #include "store/dbtypes.hpp"
 #include "store/exceptions.hpp"
+#include "store/segment.hpp"
 #include "store/write_backend.hpp"
 #include "utils/datetime.hpp"
+#include "utils/fnv.hpp"
 #include "utils/format/macros.hpp"
 #include "utils/fs/path.hpp"
+#include "utils/latency_histogram.hpp"
+#include "utils/load.hpp"
 #include "utils/logging/macros.hpp"
 #include "utils/noncopyable.hpp"
 #include "utils/optional.ipp"
+#include "utils/process/resource_usage.hpp"
 #include "utils/sanity.hpp"
 #include "utils/stream.hpp"
 #include "utils/sqlite/database.hpp"
 #include "utils/sqlite/exceptions.hpp"
+#include "utils/sqlite/incremental_blob.hpp"
 #include "utils/sqlite/statement.ipp"
 #include "utils/sqlite/transaction.hpp"
 
 namespace datetime = utils::datetime;
 namespace fs = utils::fs;
+namespace process = utils::process;
 namespace sqlite = utils::sqlite;
 
 using utils::none;
@@ -81,10 +103,12 @@ put_env_vars(sqlite::database& db,
     sqlite::statement stmt = db.create_statement(
         "INSERT INTO env_vars (var_name, var_value) "
         "VALUES (:var_name, :var_value)");
+    const sqlite::parameter< std::string > var_name = { 1, ":var_name" };
+    const sqlite::parameter< std::string > var_value = { 2, ":var_value" };
     for (std::map< std::string, std::string >::const_iterator iter =
              env.begin(); iter != env.end(); iter++) {
-        stmt.bind(":var_name", (*iter).first);
-        stmt.bind(":var_value", (*iter).second);
+        stmt.bind(var_name, (*iter).first);
+        stmt.bind(var_value, (*iter).second);
         stmt.step_without_results();
         stmt.reset();
     }
@@ -100,7 +124,7 @@ put_env_vars(sqlite::database& db,
 static int64_t
 last_rowid(sqlite::database& db, const std::string& table)
 {
-    sqlite::statement stmt = db.create_statement(
+    sqlite::statement stmt = db.cached_statement(
         F("SELECT MAX(ROWID) AS max_rowid FROM %s") % table);
     stmt.step();
     if (stmt.column_type(0) == sqlite::type_null) {
@@ -112,73 +136,722 @@ last_rowid(sqlite::database& db, const std::string& table)
 }
 
 
+/// Collection of stored metadata objects, keyed by their properties.
+typedef std::map< model::properties_map, int64_t > metadata_ids_map;
+
+
 /// Stores a metadata object.
 ///
+/// Metadata objects are interned: if an object with the same properties has
+/// already been stored, its identifier is reused and nothing is written.  This
+/// is very common because most test cases in a test program carry the same
+/// (often default) metadata.
+///
 /// \param db The database into which to store the information.
 /// \param md The metadata to store.
+/// \param [in,out] interned The metadata objects already stored in db.  Updated
+///     with the new object, if any.
 ///
-/// \return The identifier of the new metadata object.
+/// \return The identifier of the metadata object.
 static int64_t
-put_metadata(sqlite::database& db, const model::metadata& md)
+put_metadata(sqlite::database& db, const model::metadata& md,
+             metadata_ids_map& interned)
 {
     const model::properties_map props = md.to_properties();
 
+    const metadata_ids_map::const_iterator existing = interned.find(props);
+    if (existing != interned.end())
+        return (*existing).second;
+
     const int64_t metadata_id = last_rowid(db, "metadatas");
 
-    sqlite::statement stmt = db.create_statement(
+    sqlite::statement stmt = db.cached_statement(
         "INSERT INTO metadatas (metadata_id, property_name, property_value) "
         "VALUES (:metadata_id, :property_name, :property_value)");
+    const sqlite::parameter< std::string > property_name =
+        { 2, ":property_name" };
+    const sqlite::parameter< std::string > property_value =
+        { 3, ":property_value" };
     stmt.bind(":metadata_id", metadata_id);
 
     for (model::properties_map::const_iterator iter = props.begin();
          iter != props.end(); ++iter) {
-        stmt.bind(":property_name", (*iter).first);
-        stmt.bind(":property_value", (*iter).second);
+        stmt.bind(property_name, (*iter).first);
+        stmt.bind(property_value, (*iter).second);
         stmt.step_without_results();
         stmt.reset();
     }
 
+    interned.insert(metadata_ids_map::value_type(props, metadata_id));
     return metadata_id;
 }
 
 
+/// Maximum number of rows to insert with a single statement.
+///
+/// Multi-row insertions are limited by the number of variables that a single
+/// statement can reference, which is 999 in older versions of SQLite.
+static const std::size_t max_rows_per_insert = 100;
+
+
+/// Size of the chunks in which put_file() copies files into the database.
+static const std::size_t put_file_chunk_size = 64 * 1024;
+
+
+/// Read-only memory mapping of a regular file.
+class mapped_file : utils::noncopyable {
+    /// File descriptor of the mapped file.
+    int _fd;
+
+    /// Address of the mapping, or NULL if the file is empty.
+    void* _memory;
+
+    /// Length of the file and of the mapping.
+    std::size_t _length;
+
+public:
+    /// Maps a file into memory.
+    ///
+    /// \param path The file to map.
+    ///
+    /// \throw store::error If the file cannot be mapped, for example because
+    ///     it is not a regular file.
+    explicit mapped_file(const fs::path& path) :
+        _fd(-1), _memory(NULL), _length(0)
+    {
+        _fd = ::open(path.c_str(), O_RDONLY);
+        if (_fd == -1)
+            throw store::error(F("Cannot open file %s") % path);
+
+        struct ::stat sb;
+        if (::fstat(_fd, &sb) == -1 || !S_ISREG(sb.st_mode)) {
+            ::close(_fd);
+            throw store::error(F("Cannot map %s; not a regular file") % path);
+        }
+        _length = static_cast< std::size_t >(sb.st_size);
+
+        if (_length > 0) {
+            _memory = ::mmap(NULL, _length, PROT_READ, MAP_PRIVATE, _fd, 0);
+            if (_memory == MAP_FAILED) {
+                ::close(_fd);
+                throw store::error(F("Cannot map %s") % path);
+            }
+        }
+    }
+
+    /// Unmaps the file.
+    ~mapped_file(void)
+    {
+        if (_memory != NULL)
+            (void)::munmap(_memory, _length);
+        (void)::close(_fd);
+    }
+
+    /// Gets the contents of the file.
+    ///
+    /// \return A pointer to the first byte of the file, or NULL if empty.
+    const char*
+    data(void) const
+    {
+        return static_cast< const char* >(_memory);
+    }
+
+    /// Gets the length of the file.
+    ///
+    /// \return The length of the file in bytes.
+    std::size_t
+    length(void) const
+    {
+        return _length;
+    }
+
+    /// Gets the descriptor of the file.
+    ///
+    /// \return The open descriptor, which remains owned by this object.
+    int
+    fd(void) const
+    {
+        return _fd;
+    }
+};
+
+
+/// Rewinds an input stream to its beginning.
+///
+/// \param input The stream to rewind.
+///
+/// \throw store::error If the stream cannot be rewound.
+static void
+rewind_stream(std::istream& input)
+{
+    input.clear();
+    input.seekg(0, std::ios::beg);
+    if (!input)
+        throw store::error("Failed to rewind file");
+}
+
+
+/// Reads the next chunk of a file whose length is known upfront.
+///
+/// \param input The stream from which to read.
+/// \param [out] buffer The buffer into which to read the data.
+/// \param offset Position of the stream; used to compute the chunk size.
+/// \param length Total length of the file.
+///
+/// \return The number of bytes read into buffer.
+///
+/// \throw store::error If the read is short.
+static int
+read_chunk(std::istream& input, char* buffer, const int offset,
+           const std::size_t length)
+{
+    const std::streamsize pending = std::min(
+        static_cast< std::streamsize >(put_file_chunk_size),
+        static_cast< std::streamsize >(length - offset));
+    input.read(buffer, pending);
+    if (input.gcount() != pending)
+        throw store::error("Failed to read file");
+    return static_cast< int >(pending);
+}
+
+
+/// Formats a hash for storage in the contents_hash column of the files table.
+///
+/// \param hash The 64-bit FNV-1a hash to format.
+///
+/// \return The textual representation of the hash.
+static std::string
+format_hash(const uint64_t hash)
+{
+    return "fnv1a64:" + utils::fnv1a64_hex(hash);
+}
+
+
+/// Computes the hash of the contents of a file.
+///
+/// The stream is rewound on exit.
+///
+/// \param input The stream from which to read the file.
+/// \param length Total length of the file.
+///
+/// \return A textual representation of the hash, suitable for storage in the
+/// contents_hash column of the files table.
+///
+/// \throw store::error If the file cannot be read.
+static std::string
+hash_contents(std::istream& input, const std::size_t length)
+{
+    uint64_t hash = utils::fnv1a64_basis;
+
+    char buffer[put_file_chunk_size];
+    int offset = 0;
+    while (static_cast< std::size_t >(offset) < length) {
+        const int chunk = read_chunk(input, buffer, offset, length);
+        hash = utils::fnv1a64_update(hash, buffer, chunk);
+        offset += chunk;
+    }
+    rewind_stream(input);
+
+    return format_hash(hash);
+}
+
+
+/// Computes the hash of the contents of a file mapped in memory.
+///
+/// \param memory The contents of the file.
+/// \param length Total length of the file.
+///
+/// \return A textual representation of the hash, as returned by
+/// hash_contents().
+static std::string
+hash_contents(const char* memory, const std::size_t length)
+{
+    return format_hash(utils::fnv1a64_update(utils::fnv1a64_basis, memory,
+                                             length));
+}
+
+
+/// Checks if a stored file has the same contents as a file on disk.
+///
+/// The stream is rewound on exit.
+///
+/// \param db The database in which the file is stored.
+/// \param file_id The identifier of the stored file.
+/// \param input The stream from which to read the file on disk.
+/// \param length Total length of the file on disk, which must match the
+///     length of the stored file.
+///
+/// \return True if the contents are the same; false otherwise.
+///
+/// \throw store::error If the file cannot be read.
+/// \throw sqlite::error If there are problems reading the database.
+static bool
+same_contents(sqlite::database& db, const int64_t file_id,
+              std::istream& input, const std::size_t length)
+{
+    sqlite::incremental_blob blob = db.open_blob("files", "contents", file_id,
+                                                 false);
+    PRE(static_cast< std::size_t >(blob.size()) == length);
+
+    bool same = true;
+    char disk_buffer[put_file_chunk_size];
+    char db_buffer[put_file_chunk_size];
+    int offset = 0;
+    while (same && static_cast< std::size_t >(offset) < length) {
+        const int chunk = read_chunk(input, disk_buffer, offset, length);
+        blob.read(offset, db_buffer, chunk);
+        same = std::equal(disk_buffer, disk_buffer + chunk, db_buffer);
+        offset += chunk;
+    }
+    blob.close();
+    rewind_stream(input);
+    return same;
+}
+
+
+/// Checks if a stored file has the same contents as a file mapped in memory.
+///
+/// \param db The database in which the file is stored.
+/// \param file_id The identifier of the stored file.
+/// \param memory The contents of the file on disk.
+/// \param length Total length of the file on disk, which must match the
+///     length of the stored file.
+///
+/// \return True if the contents are the same; false otherwise.
+///
+/// \throw sqlite::error If there are problems reading the database.
+static bool
+same_contents(sqlite::database& db, const int64_t file_id,
+              const char* memory, const std::size_t length)
+{
+    sqlite::incremental_blob blob = db.open_blob("files", "contents", file_id,
+                                                 false);
+    PRE(static_cast< std::size_t >(blob.size()) == length);
+
+    bool same = true;
+    char db_buffer[put_file_chunk_size];
+    std::size_t offset = 0;
+    while (same && offset < length) {
+        const int chunk = static_cast< int >(
+            std::min(put_file_chunk_size, length - offset));
+        blob.read(static_cast< int >(offset), db_buffer, chunk);
+        same = std::equal(db_buffer, db_buffer + chunk, memory + offset);
+        offset += chunk;
+    }
+    blob.close();
+    return same;
+}
+
+
+/// Gets the stored files that could have the same contents as a file on disk.
+///
+/// \param db The database in which to look for the files.
+/// \param codec The codec with which the file on disk is encoded.
+/// \param hash The hash of the file on disk, as returned by hash_contents().
+/// \param length Total length of the file on disk.
+///
+/// \return The identifiers of the stored files with matching hash and length.
+///
+/// \throw sqlite::error If there are problems reading the database.
+static std::vector< int64_t >
+find_candidates(sqlite::database& db, const std::string& codec,
+                const std::string& hash, const std::size_t length)
+{
+    sqlite::statement stmt = db.cached_statement(
+        "SELECT file_id FROM files "
+        "WHERE contents_hash == :contents_hash "
+        "AND codec == :codec "
+        "AND length(contents) == :length");
+    stmt.bind(":contents_hash", hash);
+    stmt.bind(":codec", codec);
+    stmt.bind(":length", static_cast< int64_t >(length));
+
+    std::vector< int64_t > file_ids;
+    while (stmt.step())
+        file_ids.push_back(stmt.safe_column_int64("file_id"));
+    return file_ids;
+}
+
+
+/// Looks for a stored file with the same contents as a file on disk.
+///
+/// \param db The database in which to look for the file.
+/// \param codec The codec with which the file on disk is encoded.
+/// \param hash The hash of the file on disk, as returned by hash_contents().
+/// \param input The stream from which to read the file on disk.
+/// \param length Total length of the file on disk.
+///
+/// \return The identifier of the stored file, or none if there is no match.
+///
+/// \throw store::error If the file cannot be read.
+/// \throw sqlite::error If there are problems reading the database.
+static optional< int64_t >
+find_file(sqlite::database& db, const std::string& codec,
+          const std::string& hash, std::istream& input,
+          const std::size_t length)
+{
+    const std::vector< int64_t > file_ids = find_candidates(db, codec, hash,
+                                                            length);
+    for (std::vector< int64_t >::const_iterator iter = file_ids.begin();
+         iter != file_ids.end(); ++iter) {
+        if (same_contents(db, *iter, input, length))
+            return utils::make_optional(*iter);
+        LD(F("Hash collision with file %s") % *iter);
+    }
+    return none;
+}
+
+
+/// Looks for a stored file with the same contents as a file mapped in memory.
+///
+/// \param db The database in which to look for the file.
+/// \param hash The hash of the file, as returned by hash_contents().
+/// \param memory The contents of the file on disk.
+/// \param length Total length of the file on disk.
+///
+/// \return The identifier of the stored file, or none if there is no match.
+///
+/// \throw sqlite::error If there are problems reading the database.
+static optional< int64_t >
+find_file(sqlite::database& db, const std::string& hash, const char* memory,
+          const std::size_t length)
+{
+    const std::vector< int64_t > file_ids = find_candidates(
+        db, store::detail::codec_none, hash, length);
+    for (std::vector< int64_t >::const_iterator iter = file_ids.begin();
+         iter != file_ids.end(); ++iter) {
+        if (same_contents(db, *iter, memory, length))
+            return utils::make_optional(*iter);
+        LD(F("Hash collision with file %s") % *iter);
+    }
+    return none;
+}
+
+
+/// Gets the files in a segment that could have the same contents as a file.
+///
+/// \param db The database in which to look for the files.
+/// \param codec The codec with which the file is encoded.
+/// \param hash The hash of the encoded file, as returned by hash_contents().
+/// \param length Total length of the encoded file.
+///
+/// \return The identifiers of the matching files and the references to their
+/// contents.
+///
+/// \throw store::error If any of the references is invalid.
+/// \throw sqlite::error If there are problems reading the database.
+static std::vector< std::pair< int64_t, store::detail::segment_ref > >
+find_segment_candidates(sqlite::database& db, const std::string& codec,
+                        const std::string& hash, const std::size_t length)
+{
+    sqlite::statement stmt = db.cached_statement(
+        "SELECT file_id, contents FROM files "
+        "WHERE contents_hash == :contents_hash "
+        "AND codec == :codec");
+    stmt.bind(":contents_hash", hash);
+    stmt.bind(":codec", store::detail::codec_segment);
+
+    std::vector< std::pair< int64_t, store::detail::segment_ref > > files;
+    while (stmt.step()) {
+        const sqlite::blob contents = stmt.safe_column_blob("contents");
+        const store::detail::segment_ref ref =
+            store::detail::parse_segment_ref(contents.memory, contents.size);
+        if (ref.codec == codec &&
+            ref.length == static_cast< int64_t >(length))
+            files.push_back(std::make_pair(
+                stmt.safe_column_int64("file_id"), ref));
+    }
+    return files;
+}
+
+
+/// Looks for a file in a segment with the same contents as a file on disk.
+///
+/// \param db The database in which to look for the file.
+/// \param segment The segment that holds the contents of the files.
+/// \param codec The codec with which the file on disk is encoded.
+/// \param hash The hash of the file on disk, as returned by hash_contents().
+/// \param input The stream from which to read the file on disk.
+/// \param length Total length of the file on disk.
+///
+/// \return The identifier of the stored file, or none if there is no match.
+///
+/// \throw store::error If the file or the segment cannot be read.
+/// \throw sqlite::error If there are problems reading the database.
+static optional< int64_t >
+find_segment_file(sqlite::database& db, store::detail::segment_writer& segment,
+                  const std::string& codec, const std::string& hash,
+                  std::istream& input, const std::size_t length)
+{
+    const std::vector< std::pair< int64_t, store::detail::segment_ref > >
+        files = find_segment_candidates(db, codec, hash, length);
+    for (std::vector< std::pair< int64_t, store::detail::segment_ref > >::
+             const_iterator iter = files.begin(); iter != files.end(); ++iter) {
+        if (segment.same_contents((*iter).second, input, length))
+            return utils::make_optional((*iter).first);
+        LD(F("Hash collision with file %s") % (*iter).first);
+    }
+    return none;
+}
+
+
+/// Looks for a file in a segment with the same contents as a mapped file.
+///
+/// \param db The database in which to look for the file.
+/// \param segment The segment that holds the contents of the files.
+/// \param hash The hash of the file, as returned by hash_contents().
+/// \param memory The contents of the file on disk.
+/// \param length Total length of the file on disk.
+///
+/// \return The identifier of the stored file, or none if there is no match.
+///
+/// \throw store::error If the segment cannot be read.
+/// \throw sqlite::error If there are problems reading the database.
+static optional< int64_t >
+find_segment_file(sqlite::database& db, store::detail::segment_writer& segment,
+                  const std::string& hash, const char* memory,
+                  const std::size_t length)
+{
+    const std::vector< std::pair< int64_t, store::detail::segment_ref > >
+        files = find_segment_candidates(db, store::detail::codec_none, hash,
+                                        length);
+    for (std::vector< std::pair< int64_t, store::detail::segment_ref > >::
+             const_iterator iter = files.begin(); iter != files.end(); ++iter) {
+        if (segment.same_contents((*iter).second, memory, length))
+            return utils::make_optional((*iter).first);
+        LD(F("Hash collision with file %s") % (*iter).first);
+    }
+    return none;
+}
+
+
+/// Records a file whose contents were appended to a segment.
+///
+/// \param db The database into which to store the file.
+/// \param ref The reference to the contents of the file in the segment.
+/// \param hash The hash of the encoded contents.
+/// \param size Length of the decoded contents in bytes.
+///
+/// \return The identifier of the stored file.
+///
+/// \throw sqlite::error If there are problems writing to the database.
+static int64_t
+put_segment_file(sqlite::database& db, const store::detail::segment_ref& ref,
+                 const std::string& hash, const std::size_t size)
+{
+    const std::string contents = store::detail::format_segment_ref(ref);
+
+    sqlite::statement stmt = db.cached_statement(
+        "INSERT INTO files (contents, contents_hash, codec, size) "
+        "VALUES (:contents, :contents_hash, :codec, :size)");
+    stmt.bind(":contents", sqlite::blob(contents.data(),
+                                        static_cast< int >(contents.length())));
+    stmt.bind(":contents_hash", hash);
+    stmt.bind(":codec", store::detail::codec_segment);
+    stmt.bind(":size", static_cast< int64_t >(size));
+    stmt.step_without_results();
+    stmt.clear_bindings();
+    return db.last_insert_rowid();
+}
+
+
+/// Stores an uncompressed file mapped in memory into the database as a BLOB.
+///
+/// The contents are handed to SQLite straight from the mapping, so they are
+/// not copied through any intermediate buffers on their way to the database.
+///
+/// \param db The database into which to store the file.
+/// \param path Path to the file to be stored; used for logging only.
+/// \param mapping The mapped contents of the file.
+/// \param segment If not NULL, the segment to which to append the contents
+///     instead of storing them in the database.
+///
+/// \return The identifier of the stored file, or none if the file was empty.
+///
+/// \throw store::error If the file is too large or the segment cannot be
+///     written to.
+/// \throw sqlite::error If there are problems writing to the database.
+static optional< int64_t >
+put_mapped_file(sqlite::database& db, const fs::path& path,
+                const mapped_file& mapping,
+                store::detail::segment_writer* segment)
+{
+    const std::size_t length = mapping.length();
+    if (length == 0)
+        return none;
+    if (length > static_cast< std::size_t >(
+            std::numeric_limits< int >::max()))
+        throw store::error(F("File %s is too large to be stored") % path);
+
+    const std::string hash = hash_contents(mapping.data(), length);
+    const optional< int64_t > existing_id = find_file(db, hash, mapping.data(),
+                                                      length);
+    if (existing_id) {
+        LD(F("Reusing stored file %s for %s") % existing_id.get() % path);
+        return existing_id;
+    }
+
+    if (segment != NULL) {
+        const optional< int64_t > segment_id = find_segment_file(
+            db, *segment, hash, mapping.data(), length);
+        if (segment_id) {
+            LD(F("Reusing stored file %s for %s") % segment_id.get() % path);
+            return segment_id;
+        }
+        // Let the kernel copy the file into the segment instead of writing
+        // it out of the mapping, which has only been read for hashing.
+        return utils::make_optional(put_segment_file(
+            db, segment->append(store::detail::codec_none, mapping.fd(),
+                                length), hash, length));
+    }
+
+    sqlite::statement stmt = db.cached_statement(
+        "INSERT INTO files (contents, contents_hash, codec, size) "
+        "VALUES (:contents, :contents_hash, :codec, :size)");
+    stmt.bind(":contents", sqlite::blob(mapping.data(),
+                                        static_cast< int >(length)));
+    stmt.bind(":contents_hash", hash);
+    stmt.bind(":codec", store::detail::codec_none);
+    stmt.bind(":size", static_cast< int64_t >(length));
+    stmt.step_without_results();
+    // The blob was bound without copying it, so make sure SQLite does not
+    // keep a reference to the mapping once it goes away.
+    stmt.clear_bindings();
+    return optional< int64_t >(db.last_insert_rowid());
+}
+
+
 /// Stores an arbitrary file into the database as a BLOB.
 ///
+/// Files are deduplicated: if the database already contains a file with the
+/// same contents, the identifier of the existing file is returned and no new
+/// copy is stored.
+///
 /// \param db The database into which to store the file.
 /// \param path Path to the file to be stored.
+/// \param compression_level The zlib compression level with which to store
+///     the file, or 0 to store the file verbatim.
+/// \param segment If not NULL, the segment to which to append the contents of
+///     large files instead of storing them in the database.
+/// \param segment_threshold Minimum length of the files, before compression,
+///     whose contents go to the segment.
 ///
 /// \return The identifier of the stored file, or none if the file was empty.
 ///
+/// \throw store::error If the file cannot be read or the segment cannot be
+///     written to.
 /// \throw sqlite::error If there are problems writing to the database.
 static optional< int64_t >
-put_file(sqlite::database& db, const fs::path& path)
+put_file(sqlite::database& db, const fs::path& path,
+         const int compression_level, store::detail::segment_writer* segment,
+         const std::size_t segment_threshold)
 {
-    std::ifstream input(path.c_str());
-    if (!input)
+    if (compression_level == 0) {
+        std::auto_ptr< mapped_file > mapping;
+        try {
+            mapping.reset(new mapped_file(path));
+        } catch (const store::error& e) {
+            LD(F("Streaming file instead of mapping it: %s") % e.what());
+        }
+        if (mapping.get() != NULL)
+            return put_mapped_file(
+                db, path, *mapping,
+                mapping->length() >= segment_threshold ? segment : NULL);
+    }
+
+    std::ifstream file(path.c_str());
+    if (!file)
         throw store::error(F("Cannot open file %s") % path);
 
+    std::istream* input = &file;
+    std::auto_ptr< std::istringstream > buffered;
+    std::size_t length;
     try {
-        if (utils::stream_length(input) == 0)
-            return none;
+        length = utils::stream_length(file);
     } catch (const std::runtime_error& e) {
-        // Skipping empty files is an optimization.  If we fail to calculate the
-        // size of the file, just ignore the problem.  If there are real issues
-        // with the file, the read below will fail anyway.
-        LD(F("Cannot determine if file is empty: %s") % e.what());
+        // We cannot stream the file without knowing its size upfront, so fall
+        // back to loading it in memory.  If there are real issues with the
+        // file, the read below will fail anyway.
+        LD(F("Cannot determine the size of the file: %s") % e.what());
+        buffered.reset(new std::istringstream(utils::read_stream(file)));
+        input = buffered.get();
+        length = buffered->str().length();
     }
+    if (length == 0)
+        return none;
+    const std::size_t size = length;
+    if (size < segment_threshold)
+        segment = NULL;
 
-    // TODO(jmmv): This will probably cause an unreasonable amount of memory
-    // consumption if we decide to store arbitrary files in the database (other
-    // than stdout or stderr).  Should this happen, we need to investigate a
-    // better way to feel blobs into SQLite.
-    const std::string contents = utils::read_stream(input);
+    std::string codec = store::detail::codec_none;
+    if (compression_level > 0) {
+        // The compressed data is held in memory, which should be acceptable
+        // given that compression is only worth it for highly compressible
+        // data such as the output of tests.
+        try {
+            buffered.reset(new std::istringstream(
+                store::detail::compress_zlib(*input, compression_level)));
+        } catch (const store::error& e) {
+            throw store::error(F("%s %s") % e.what() % path);
+        }
+        input = buffered.get();
+        length = buffered->str().length();
+        codec = store::detail::codec_zlib;
+    }
 
-    sqlite::statement stmt = db.create_statement(
-        "INSERT INTO files (contents) VALUES (:contents)");
-    stmt.bind(":contents", sqlite::blob(contents.c_str(), contents.length()));
-    stmt.step_without_results();
+    if (length > static_cast< std::size_t >(
+            std::numeric_limits< int >::max()))
+        throw store::error(F("File %s is too large to be stored") % path);
 
-    return optional< int64_t >(db.last_insert_rowid());
+    try {
+        const std::string hash = hash_contents(*input, length);
+        const optional< int64_t > existing_id = find_file(db, codec, hash,
+                                                          *input, length);
+        if (existing_id) {
+            LD(F("Reusing stored file %s for %s") % existing_id.get() % path);
+            return existing_id;
+        }
+
+        if (segment != NULL) {
+            const optional< int64_t > segment_id = find_segment_file(
+                db, *segment, codec, hash, *input, length);
+            if (segment_id) {
+                LD(F("Reusing stored file %s for %s") % segment_id.get() %
+                   path);
+                return segment_id;
+            }
+            return utils::make_optional(put_segment_file(
+                db, segment->append(codec, *input, length), hash, size));
+        }
+
+        // Reserve space for the contents and then fill them in in chunks so
+        // that our memory consumption is bounded regardless of the size of
+        // the file.
+        sqlite::statement stmt = db.cached_statement(
+            "INSERT INTO files (contents, contents_hash, codec, size) "
+            "VALUES (:contents, :contents_hash, :codec, :size)");
+        stmt.bind(":contents", sqlite::zeroblob(static_cast< int >(length)));
+        stmt.bind(":contents_hash", hash);
+        stmt.bind(":codec", codec);
+        stmt.bind(":size", static_cast< int64_t >(size));
+        stmt.step_without_results();
+        const int64_t file_id = db.last_insert_rowid();
+
+        sqlite::incremental_blob blob = db.open_blob("files", "contents",
+                                                     file_id, true);
+        char buffer[put_file_chunk_size];
+        int offset = 0;
+        while (static_cast< std::size_t >(offset) < length) {
+            const int chunk = read_chunk(*input, buffer, offset, length);
+            blob.write(offset, buffer, chunk);
+            offset += chunk;
+        }
+        blob.close();
+
+        return optional< int64_t >(file_id);
+    } catch (const store::error& e) {
+        throw store::error(F("%s %s") % e.what() % path);
+    }
 }
 
 
@@ -196,15 +869,41 @@ struct store::write_transaction::impl : utils::noncopyable {
     /// The backing SQLite transaction.
     sqlite::transaction _tx;
 
+    /// The zlib compression level for stored files; 0 disables compression.
+    int _compression_level;
+
+    /// The segment to which to append the contents of large files, if any.
+    std::auto_ptr< store::detail::segment_writer > _segment;
+
+    /// Minimum length of the files whose contents go to the segment.
+    std::size_t _segment_threshold;
+
+    /// The metadata objects stored so far by this transaction.
+    metadata_ids_map _interned_metadata;
+
     /// Opens a transaction.
     ///
     /// \param backend_ The backend this transaction is connected to.
     impl(write_backend& backend_) :
         _backend(backend_),
         _db(backend_.database()),
-        _tx(backend_.database().begin_transaction())
+        _tx(backend_.database().begin_transaction()),
+        _compression_level(0),
+        _segment_threshold(0)
     {
     }
+
+    /// Makes the contents appended to the segment durable, if any.
+    ///
+    /// This has to happen before committing the rows that reference them.
+    ///
+    /// \throw error If the segment cannot be synced.
+    void
+    sync_segment(void)
+    {
+        if (_segment.get() != NULL)
+            _segment->sync();
+    }
 };
 
 
@@ -229,8 +928,31 @@ store::write_transaction::~write_transaction(void)
 void
 store::write_transaction::commit(void)
 {
+    _pimpl->sync_segment();
+    try {
+        _pimpl->_tx.commit();
+    } catch (const sqlite::error& e) {
+        throw error(e.what());
+    }
+}
+
+
+/// Commits the data stored so far and keeps the transaction open.
+///
+/// This allows long-lived transactions to bound the size of the journal and to
+/// make their partial results visible to readers.  The identifiers returned by
+/// the put_* methods before the checkpoint remain valid afterwards, and so do
+/// any internal caches, because the rows they refer to have been committed.
+/// A later rollback() only discards the changes made since the checkpoint.
+///
+/// \throw error If there is any problem when talking to the database.
+void
+store::write_transaction::checkpoint(void)
+{
+    _pimpl->sync_segment();
     try {
         _pimpl->_tx.commit();
+        _pimpl->_tx = _pimpl->_db.begin_transaction();
     } catch (const sqlite::error& e) {
         throw error(e.what());
     }
@@ -251,6 +973,50 @@ store::write_transaction::rollback(void)
 }
 
 
+/// Sets the compression level for the files stored by this transaction.
+///
+/// \param level The zlib compression level, from 1 (fastest) to 9 (best), or
+///     0 to store files verbatim.  Only affects files stored afterwards.
+///
+/// \throw error If the level is out of range.
+void
+store::write_transaction::set_compression_level(const int level)
+{
+    if (level < 0 || level > 9)
+        throw error(F("Invalid compression level %s; must be between 0 and 9")
+                    % level);
+    _pimpl->_compression_level = level;
+}
+
+
+/// Stores the contents of large files in a segment next to the database.
+///
+/// The contents of the files of at least the given length are appended to a
+/// segment file named after the database, and the database only records where
+/// they are.  This keeps large outputs out of the pages and the journal of the
+/// database; readers resolve the references transparently and compacting the
+/// results file moves the contents back into it.
+///
+/// Databases that live in memory have no place for a segment, so they keep
+/// storing all files themselves.
+///
+/// \param threshold Minimum length of the files, before compression, whose
+///     contents go to the segment.  Only affects files stored afterwards.
+void
+store::write_transaction::set_segment_threshold(const std::size_t threshold)
+{
+    const optional< fs::path >& db_path = _pimpl->_db.db_filename();
+    if (!db_path) {
+        LD("Not using a segment for an in-memory database");
+        return;
+    }
+    if (_pimpl->_segment.get() == NULL)
+        _pimpl->_segment.reset(new store::detail::segment_writer(
+            store::detail::segment_path(db_path.get())));
+    _pimpl->_segment_threshold = threshold;
+}
+
+
 /// Puts a context into the database.
 ///
 /// \pre The context has not been put yet.
@@ -291,14 +1057,15 @@ store::write_transaction::put_test_program(
 {
     try {
         const int64_t metadata_id = put_metadata(
-            _pimpl->_db, test_program.get_metadata());
+            _pimpl->_db, test_program.get_metadata(),
+            _pimpl->_interned_metadata);
 
-        sqlite::statement stmt = _pimpl->_db.create_statement(
+        sqlite::statement stmt = _pimpl->_db.cached_statement(
             "INSERT INTO test_programs (absolute_path, "
             "                           root, relative_path, test_suite_name, "
-            "                           metadata_id, interface) "
+            "                           metadata_id, interface, variant) "
             "VALUES (:absolute_path, :root, :relative_path, "
-            "        :test_suite_name, :metadata_id, :interface)");
+            "        :test_suite_name, :metadata_id, :interface, :variant)");
         stmt.bind(":absolute_path", test_program.absolute_path().str());
         // TODO(jmmv): The root is not necessarily absolute.  We need to ensure
         // that we can recover the absolute path of the test program.  Maybe we
@@ -308,6 +1075,10 @@ store::write_transaction::put_test_program(
         stmt.bind(":test_suite_name", test_program.test_suite_name());
         stmt.bind(":metadata_id", metadata_id);
         stmt.bind(":interface", test_program.interface_name());
+        if (test_program.variant().empty())
+            stmt.bind(":variant", sqlite::null());
+        else
+            stmt.bind(":variant", test_program.variant());
         stmt.step_without_results();
         return _pimpl->_db.last_insert_rowid();
     } catch (const sqlite::error& e) {
@@ -337,9 +1108,10 @@ store::write_transaction::put_test_case(const model::test_program& test_program,
 
     try {
         const int64_t metadata_id = put_metadata(
-            _pimpl->_db, test_case.get_raw_metadata());
+            _pimpl->_db, test_case.get_raw_metadata(),
+            _pimpl->_interned_metadata);
 
-        sqlite::statement stmt = _pimpl->_db.create_statement(
+        sqlite::statement stmt = _pimpl->_db.cached_statement(
             "INSERT INTO test_cases (test_program_id, name, metadata_id) "
             "VALUES (:test_program_id, :name, :metadata_id)");
         stmt.bind(":test_program_id", test_program_id);
@@ -353,6 +1125,84 @@ store::write_transaction::put_test_case(const model::test_program& test_program,
 }
 
 
+/// Puts a test program and some of its test cases into the database at once.
+///
+/// This is equivalent to put_test_program() followed by put_test_case() for
+/// every test case but inserts the test cases with multi-row statements,
+/// which is much cheaper than issuing one statement per test case.
+///
+/// \pre The test program and its test cases have not been put yet.
+/// \post The test program and the test cases are stored into the database
+///     with new identifiers.
+///
+/// \param test_program The test program to put.
+/// \param test_case_names The names of the test cases to put, all of which
+///     must belong to the test program and be different.
+///
+/// \return The identifier of the inserted test program and those of the
+/// inserted test cases.
+///
+/// \throw error If there is any problem when talking to the database.
+std::pair< int64_t, store::test_case_ids_map >
+store::write_transaction::put_test_program_with_cases(
+    const model::test_program& test_program,
+    const std::vector< std::string >& test_case_names)
+{
+    const int64_t test_program_id = put_test_program(test_program);
+
+    try {
+        std::vector< int64_t > metadata_ids;
+        metadata_ids.reserve(test_case_names.size());
+        for (std::vector< std::string >::const_iterator iter =
+                 test_case_names.begin(); iter != test_case_names.end();
+             ++iter) {
+            const model::test_case& test_case = test_program.find(*iter);
+            metadata_ids.push_back(put_metadata(
+                _pimpl->_db, test_case.get_raw_metadata(),
+                _pimpl->_interned_metadata));
+        }
+
+        test_case_ids_map ids;
+        for (std::size_t first = 0; first < test_case_names.size();
+             first += max_rows_per_insert) {
+            const std::size_t count = std::min(max_rows_per_insert,
+                                               test_case_names.size() - first);
+
+            std::string sql = "INSERT INTO test_cases "
+                "(test_program_id, name, metadata_id) VALUES ";
+            for (std::size_t i = 0; i < count; ++i) {
+                if (i > 0)
+                    sql += ", ";
+                sql += "(?, ?, ?)";
+            }
+
+            sqlite::statement stmt = _pimpl->_db.cached_statement(sql);
+            for (std::size_t i = 0; i < count; ++i) {
+                const int base = static_cast< int >(i * 3);
+                stmt.bind(base + 1, test_program_id);
+                stmt.bind(base + 2, test_case_names[first + i]);
+                stmt.bind(base + 3, metadata_ids[first + i]);
+            }
+            stmt.step_without_results();
+
+            // A single statement inserts its rows with consecutive
+            // identifiers, so the last one tells us all the others.
+            const int64_t last_id = _pimpl->_db.last_insert_rowid();
+            for (std::size_t i = 0; i < count; ++i) {
+                const bool inserted = ids.insert(test_case_ids_map::value_type(
+                    test_case_names[first + i],
+                    last_id - static_cast< int64_t >(count - 1 - i))).second;
+                INV_MSG(inserted, F("Test case %s put more than once") %
+                        test_case_names[first + i]);
+            }
+        }
+        return std::make_pair(test_program_id, ids);
+    } catch (const sqlite::error& e) {
+        throw error(e.what());
+    }
+}
+
+
 /// Stores a file generated by a test case into the database as a BLOB.
 ///
 /// \param name The name of the file to store in the database.  This needs to be
@@ -372,13 +1222,15 @@ store::write_transaction::put_test_case_file(const std::string& name,
 {
     LD(F("Storing %s (%s) of test case %s") % name % path % test_case_id);
     try {
-        const optional< int64_t > file_id = put_file(_pimpl->_db, path);
+        const optional< int64_t > file_id = put_file(
+            _pimpl->_db, path, _pimpl->_compression_level,
+            _pimpl->_segment.get(), _pimpl->_segment_threshold);
         if (!file_id) {
             LD("Not storing empty file");
             return none;
         }
 
-        sqlite::statement stmt = _pimpl->_db.create_statement(
+        sqlite::statement stmt = _pimpl->_db.cached_statement(
             "INSERT INTO test_case_files (test_case_id, file_name, file_id) "
             "VALUES (:test_case_id, :file_name, :file_id)");
         stmt.bind(":test_case_id", test_case_id);
@@ -386,7 +1238,7 @@ store::write_transaction::put_test_case_file(const std::string& name,
         stmt.bind(":file_id", file_id.get());
         stmt.step_without_results();
 
-        return optional< int64_t >(_pimpl->_db.last_insert_rowid());
+        return file_id;
     } catch (const sqlite::error& e) {
         throw error(e.what());
     }
@@ -402,6 +1254,7 @@ store::write_transaction::put_test_case_file(const std::string& name,
 /// \param test_case_id The test case this result corresponds to.
 /// \param start_time The time when the test started to run.
 /// \param end_time The time when the test finished running.
+/// \param attempt The number of the attempt that yielded this result.
 ///
 /// \return The identifier of the inserted result.
 ///
@@ -410,16 +1263,19 @@ int64_t
 store::write_transaction::put_result(const model::test_result& result,
                                      const int64_t test_case_id,
                                      const datetime::timestamp& start_time,
-                                     const datetime::timestamp& end_time)
+                                     const datetime::timestamp& end_time,
+                                     const int attempt)
 {
+    PRE(attempt >= 1);
     try {
-        sqlite::statement stmt = _pimpl->_db.create_statement(
+        sqlite::statement stmt = _pimpl->_db.cached_statement(
             "INSERT INTO test_results (test_case_id, result_type, "
             "                          result_reason, start_time, "
-            "                          end_time) "
+            "                          end_time, attempt) "
             "VALUES (:test_case_id, :result_type, :result_reason, "
-            "        :start_time, :end_time)");
+            "        :start_time, :end_time, :attempt)");
         stmt.bind(":test_case_id", test_case_id);
+        stmt.bind(":attempt", attempt);
 
         store::bind_test_result_type(stmt, ":result_type", result.type());
         if (result.reason().empty())
@@ -433,8 +1289,365 @@ store::write_transaction::put_result(const model::test_result& result,
         stmt.step_without_results();
         const int64_t result_id = _pimpl->_db.last_insert_rowid();
 
+        // Keep the aggregates in sync so that reports can print the totals
+        // of the run without going over all results.
+        sqlite::statement summary_stmt = _pimpl->_db.cached_statement(
+            "INSERT OR REPLACE INTO result_summaries "
+            "SELECT :result_type, "
+            "    COALESCE(existing.results_count, 0) + 1, "
+            "    COALESCE(existing.total_duration, 0) + "
+            "        :end_time - :start_time, "
+            "    MIN(COALESCE(existing.min_start_time, :start_time), "
+            "        :start_time), "
+            "    MAX(COALESCE(existing.max_end_time, :end_time), :end_time) "
+            "FROM (SELECT 1) LEFT JOIN result_summaries AS existing "
+            "    ON existing.result_type = :result_type");
+        store::bind_test_result_type(summary_stmt, ":result_type",
+                                     result.type());
+        store::bind_timestamp(summary_stmt, ":start_time", start_time);
+        store::bind_timestamp(summary_stmt, ":end_time", end_time);
+        summary_stmt.step_without_results();
+
         return result_id;
     } catch (const sqlite::error& e) {
         throw error(e.what());
     }
 }
+
+
+/// Puts the result of a failed attempt of a test case into the database.
+///
+/// \param result The result of the attempt.
+/// \param test_case_id The test case this result corresponds to.
+/// \param attempt The number of the attempt, starting at 1.
+/// \param start_time The time when the attempt started to run.
+/// \param end_time The time when the attempt finished running.
+///
+/// \throw error If there is any problem when talking to the database.
+void
+store::write_transaction::put_retried_result(
+    const model::test_result& result, const int64_t test_case_id,
+    const int attempt, const datetime::timestamp& start_time,
+    const datetime::timestamp& end_time)
+{
+    PRE(attempt >= 1);
+    try {
+        sqlite::statement stmt = _pimpl->_db.cached_statement(
+            "INSERT INTO test_retried_results (test_case_id, attempt, "
+            "    result_type, result_reason, start_time, end_time) "
+            "VALUES (:test_case_id, :attempt, :result_type, :result_reason, "
+            "        :start_time, :end_time)");
+        stmt.bind(":test_case_id", test_case_id);
+        stmt.bind(":attempt", attempt);
+        store::bind_test_result_type(stmt, ":result_type", result.type());
+        if (result.reason().empty())
+            stmt.bind(":result_reason", sqlite::null());
+        else
+            stmt.bind(":result_reason", result.reason());
+        store::bind_timestamp(stmt, ":start_time", start_time);
+        store::bind_timestamp(stmt, ":end_time", end_time);
+        stmt.step_without_results();
+    } catch (const sqlite::error& e) {
+        throw error(e.what());
+    }
+}
+
+
+/// Puts the resources consumed by a test case into the database.
+///
+/// \param usage The resource usage of the test case.
+/// \param test_case_id The identifier of the test case.
+///
+/// \throw error If there is an error storing the resource usage.
+void
+store::write_transaction::put_resource_usage(
+    const process::resource_usage& usage, const int64_t test_case_id)
+{
+    try {
+        sqlite::statement stmt = _pimpl->_db.cached_statement(
+            "INSERT INTO test_resource_usage (test_case_id, user_time, "
+            "    system_time, max_rss, in_blocks, out_blocks, "
+            "    voluntary_switches, involuntary_switches) "
+            "VALUES (:test_case_id, :user_time, :system_time, :max_rss, "
+            "        :in_blocks, :out_blocks, :voluntary_switches, "
+            "        :involuntary_switches)");
+        stmt.bind(":test_case_id", test_case_id);
+        store::bind_delta(stmt, ":user_time", usage.user_time());
+        store::bind_delta(stmt, ":system_time", usage.system_time());
+        stmt.bind(":max_rss", static_cast< int64_t >(usage.max_rss()));
+        stmt.bind(":in_blocks", static_cast< int64_t >(usage.in_blocks()));
+        stmt.bind(":out_blocks", static_cast< int64_t >(usage.out_blocks()));
+        stmt.bind(":voluntary_switches",
+                  static_cast< int64_t >(usage.voluntary_switches()));
+        stmt.bind(":involuntary_switches",
+                  static_cast< int64_t >(usage.involuntary_switches()));
+        stmt.step_without_results();
+    } catch (const sqlite::error& e) {
+        throw error(e.what());
+    }
+}
+
+
+/// Puts the cache key of a test case into the database.
+///
+/// \param cache_key The cache key of the test case.
+/// \param test_case_id The identifier of the test case.
+///
+/// \throw error If there is an error storing the cache key.
+void
+store::write_transaction::put_cache_key(const std::string& cache_key,
+                                        const int64_t test_case_id)
+{
+    try {
+        sqlite::statement stmt = _pimpl->_db.cached_statement(
+            "INSERT INTO test_cache_keys (test_case_id, cache_key) "
+            "VALUES (:test_case_id, :cache_key)");
+        stmt.bind(":test_case_id", test_case_id);
+        stmt.bind(":cache_key", cache_key);
+        stmt.step_without_results();
+    } catch (const sqlite::error& e) {
+        throw error(e.what());
+    }
+}
+
+
+/// Puts the CPU affinity of a test case into the database.
+///
+/// If the test case already has an affinity, which happens when it is
+/// retried, the new one replaces it so that the record matches the final
+/// attempt.
+///
+/// \param slot The execution slot that ran the test case.
+/// \param numa_node The NUMA node the CPUs of the slot belong to.
+/// \param cpus The CPUs to which the test case was pinned.
+/// \param test_case_id The identifier of the test case.
+///
+/// \throw error If there is an error storing the affinity.
+void
+store::write_transaction::put_cpu_affinity(const int slot,
+                                           const int numa_node,
+                                           const std::set< int >& cpus,
+                                           const int64_t test_case_id)
+{
+    PRE(!cpus.empty());
+
+    try {
+        sqlite::statement stmt = _pimpl->_db.cached_statement(
+            "INSERT OR REPLACE INTO test_cpu_affinities "
+            "    (test_case_id, slot, numa_node, cpus) "
+            "VALUES (:test_case_id, :slot, :numa_node, :cpus)");
+        stmt.bind(":test_case_id", test_case_id);
+        stmt.bind(":slot", slot);
+        stmt.bind(":numa_node", numa_node);
+        stmt.bind(":cpus", utils::format_cpu_list(cpus));
+        stmt.step_without_results();
+    } catch (const sqlite::error& e) {
+        throw error(e.what());
+    }
+}
+
+
+/// Puts the results of the individual checks of a test case into the database.
+///
+/// All the results are inserted through a single prepared statement within
+/// the current transaction.
+///
+/// \param results The results of the checks, in the order in which the test
+///     case reported them.
+/// \param test_case_id The identifier of the test case.
+///
+/// \throw error If there is an error storing the results.
+void
+store::write_transaction::put_sub_results(
+    const std::vector< model::test_result >& results,
+    const int64_t test_case_id)
+{
+    if (results.empty())
+        return;
+
+    try {
+        sqlite::statement stmt = _pimpl->_db.cached_statement(
+            "INSERT INTO test_sub_results (test_case_id, position, "
+            "                              result_type, result_reason) "
+            "VALUES (:test_case_id, :position, :result_type, "
+            "        :result_reason)");
+        const sqlite::parameter< int64_t > position_param = { 2, ":position" };
+        const sqlite::parameter< std::string > result_type =
+            { 3, ":result_type" };
+        const sqlite::parameter< std::string > result_reason =
+            { 4, ":result_reason" };
+        stmt.bind(":test_case_id", test_case_id);
+        int64_t position = 1;
+        for (std::vector< model::test_result >::const_iterator
+                 iter = results.begin(); iter != results.end();
+             ++iter, ++position) {
+            stmt.bind(position_param, position);
+            store::bind_test_result_type(stmt, result_type, (*iter).type());
+            if ((*iter).reason().empty())
+                stmt.bind(result_reason, sqlite::null());
+            else
+                stmt.bind(result_reason, (*iter).reason());
+            stmt.step_without_results();
+            stmt.reset();
+        }
+    } catch (const sqlite::error& e) {
+        throw error(e.what());
+    }
+}
+
+
+/// Puts the latencies of the phases of the execution into the database.
+///
+/// Only the non-empty buckets of each histogram are stored.
+///
+/// \param latencies The histograms of the latencies, keyed by phase name.
+///
+/// \throw error If there is an error storing the latencies.
+void
+store::write_transaction::put_latencies(
+    const utils::latency_histograms_map& latencies)
+{
+    try {
+        // Add up to any latencies already stored by an earlier session of
+        // the same run.
+        sqlite::statement stmt = _pimpl->_db.cached_statement(
+            "INSERT OR REPLACE INTO phase_latencies (phase, upper_bound, "
+            "                                        count) "
+            "SELECT :phase, :upper_bound, "
+            "    COALESCE(existing.count, 0) + :count "
+            "FROM (SELECT 1) LEFT JOIN phase_latencies AS existing "
+            "    ON existing.phase = :phase "
+            "        AND existing.upper_bound = :upper_bound");
+        const sqlite::parameter< int64_t > upper_bound = { 2, ":upper_bound" };
+        const sqlite::parameter< int64_t > count = { 3, ":count" };
+        for (utils::latency_histograms_map::const_iterator
+                 iter = latencies.begin(); iter != latencies.end(); ++iter) {
+            stmt.bind(":phase", (*iter).first);
+            const utils::latency_histogram::buckets_map buckets =
+                (*iter).second.buckets();
+            for (utils::latency_histogram::buckets_map::const_iterator
+                     iter2 = buckets.begin(); iter2 != buckets.end();
+                 ++iter2) {
+                stmt.bind(upper_bound, (*iter2).first);
+                stmt.bind(count, static_cast< int64_t >((*iter2).second));
+                stmt.step_without_results();
+                stmt.reset();
+            }
+        }
+    } catch (const sqlite::error& e) {
+        throw error(e.what());
+    }
+}
+
+
+/// Puts the use of the execution slots during the run into the database.
+///
+/// \param usage The time that the slots spent in each activity, keyed by the
+///     name of the activity.
+///
+/// \throw error If there is an error storing the usage.
+void
+store::write_transaction::put_slot_usage(
+    const std::map< std::string, datetime::delta >& usage)
+{
+    try {
+        // Add up to any usage already stored by an earlier session of the
+        // same run.
+        sqlite::statement stmt = _pimpl->_db.cached_statement(
+            "INSERT OR REPLACE INTO slot_usage (activity, slot_time) "
+            "SELECT :activity, "
+            "    COALESCE(existing.slot_time, 0) + :slot_time "
+            "FROM (SELECT 1) LEFT JOIN slot_usage AS existing "
+            "    ON existing.activity = :activity");
+        for (std::map< std::string, datetime::delta >::const_iterator
+                 iter = usage.begin(); iter != usage.end(); ++iter) {
+            stmt.bind(":activity", (*iter).first);
+            bind_delta(stmt, ":slot_time", (*iter).second);
+            stmt.step_without_results();
+            stmt.reset();
+        }
+    } catch (const sqlite::error& e) {
+        throw error(e.what());
+    }
+}
+
+
+/// Puts an event of the timeline of the execution into the database.
+///
+/// \param kind The type of the operation, such as "test" or "list".
+/// \param name The subject of the operation, such as the test case name.
+/// \param pid The subprocess that carried out the operation, if any.
+/// \param start_time The time at which the operation started.
+/// \param end_time The time at which the operation finished.
+///
+/// \throw error If there is an error storing the event.
+void
+store::write_transaction::put_run_event(const std::string& kind,
+                                        const std::string& name,
+                                        const optional< int >& pid,
+                                        const datetime::timestamp& start_time,
+                                        const datetime::timestamp& end_time)
+{
+    try {
+        sqlite::statement stmt = _pimpl->_db.cached_statement(
+            "INSERT INTO run_events (kind, name, pid, start_time, end_time) "
+            "VALUES (:kind, :name, :pid, :start_time, :end_time)");
+        stmt.bind(":kind", kind);
+        stmt.bind(":name", name);
+        if (pid)
+            stmt.bind(":pid", pid.get());
+        else
+            stmt.bind(":pid", sqlite::null());
+        store::bind_timestamp(stmt, ":start_time", start_time);
+        store::bind_timestamp(stmt, ":end_time", end_time);
+        stmt.step_without_results();
+    } catch (const sqlite::error& e) {
+        throw error(e.what());
+    }
+}
+
+
+/// Deletes the test cases that were put into the database without a result.
+///
+/// Test cases are put before they run, so a run that is interrupted leaves
+/// behind the test cases that were in flight or about to start.  Resuming the
+/// run puts them again, so the stale copies have to go for readers not to see
+/// them pending forever.  The contents of their files are left for
+/// compaction to reclaim.
+///
+/// \return The number of deleted test cases.
+///
+/// \throw error If there is an error deleting the test cases.
+std::size_t
+store::write_transaction::discard_pending_test_cases(void)
+{
+    static const char* dependents[] = {
+        "test_case_files", "test_cache_keys", "test_cpu_affinities",
+        "test_resource_usage", "test_retried_results", "test_sub_results",
+        NULL,
+    };
+
+    static const char* pending =
+        "SELECT test_case_id FROM test_cases WHERE test_case_id NOT IN "
+        "    (SELECT test_case_id FROM test_results)";
+
+    try {
+        std::size_t count;
+        {
+            sqlite::statement stmt = _pimpl->_db.create_statement(
+                F("SELECT COUNT(*) AS count FROM (%s)") % pending);
+            const bool has_row = stmt.step();
+            INV(has_row);
+            count = static_cast< std::size_t >(
+                stmt.safe_column_int64("count"));
+        }
+        for (const char** table = dependents; *table != NULL; ++table)
+            _pimpl->_db.exec(F("DELETE FROM %s WHERE test_case_id IN (%s)") %
+                             *table % pending);
+        _pimpl->_db.exec(F("DELETE FROM test_cases WHERE test_case_id IN "
+                           "(%s)") % pending);
+        return count;
+    } catch (const sqlite::error& e) {
+        throw error(e.what());
+    }
+}
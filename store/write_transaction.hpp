@@ -38,7 +38,12 @@ extern "C" {
 #include <stdint.h>
 }
 
+#include <cstddef>
+#include <map>
+#include <set>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "model/context_fwd.hpp"
 #include "model/test_program_fwd.hpp"
@@ -46,12 +51,18 @@ extern "C" {
 #include "store/write_backend_fwd.hpp"
 #include "utils/datetime_fwd.hpp"
 #include "utils/fs/path_fwd.hpp"
+#include "utils/latency_histogram_fwd.hpp"
 #include "utils/optional_fwd.hpp"
+#include "utils/process/resource_usage_fwd.hpp"
 #include "utils/shared_ptr.hpp"
 
 namespace store {
 
 
+/// Identifiers of the test cases of a test program, keyed by their names.
+typedef std::map< std::string, int64_t > test_case_ids_map;
+
+
 /// Representation of a write-only transaction.
 ///
 /// Transactions are the entry place for high-level calls that access the
@@ -69,18 +80,42 @@ public:
     ~write_transaction(void);
 
     void commit(void);
+    void checkpoint(void);
     void rollback(void);
 
+    void set_compression_level(const int);
+    void set_segment_threshold(const std::size_t);
+
     void put_context(const model::context&);
     int64_t put_test_program(const model::test_program&);
     int64_t put_test_case(const model::test_program&, const std::string&,
                           const int64_t);
+    std::pair< int64_t, test_case_ids_map > put_test_program_with_cases(
+        const model::test_program&, const std::vector< std::string >&);
     utils::optional< int64_t > put_test_case_file(const std::string&,
                                                   const utils::fs::path&,
                                                   const int64_t);
     int64_t put_result(const model::test_result&, const int64_t,
+                       const utils::datetime::timestamp&,
+                       const utils::datetime::timestamp&, const int = 1);
+    void put_retried_result(const model::test_result&, const int64_t,
+                            const int, const utils::datetime::timestamp&,
+                            const utils::datetime::timestamp&);
+    void put_resource_usage(const utils::process::resource_usage&,
+                            const int64_t);
+    void put_cache_key(const std::string&, const int64_t);
+    void put_cpu_affinity(const int, const int, const std::set< int >&,
+                          const int64_t);
+    void put_sub_results(const std::vector< model::test_result >&,
+                         const int64_t);
+    void put_latencies(const utils::latency_histograms_map&);
+    void put_slot_usage(const std::map< std::string,
+                                        utils::datetime::delta >&);
+    void put_run_event(const std::string&, const std::string&,
+                       const utils::optional< int >&,
                        const utils::datetime::timestamp&,
                        const utils::datetime::timestamp&);
+    std::size_t discard_pending_test_cases(void);
 };
 
 
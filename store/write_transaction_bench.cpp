@@ -0,0 +1,329 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// \file store/write_transaction_bench.cpp
+/// Benchmarks for the hot paths of store::write_transaction.
+
+#include "store/write_transaction.hpp"
+
+extern "C" {
+#include <sys/stat.h>
+
+#include <stdint.h>
+}
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <atf-c++.hpp>
+
+#include "model/context.hpp"
+#include "model/test_program.hpp"
+#include "model/test_result.hpp"
+#include "store/segment.hpp"
+#include "store/write_backend.hpp"
+#include "utils/datetime.hpp"
+#include "utils/format/macros.hpp"
+#include "utils/fs/path.hpp"
+#include "utils/latency_histogram.hpp"
+#include "utils/logging/operations.hpp"
+#include "utils/optional.ipp"
+#include "utils/sqlite/database.hpp"
+#include "utils/test_utils.ipp"
+
+namespace datetime = utils::datetime;
+namespace fs = utils::fs;
+namespace logging = utils::logging;
+
+
+namespace {
+
+
+/// Number of test cases in each test program of the replayed runs.
+const std::size_t cases_per_program = 50;
+
+
+/// Number of results after which the replayed runs checkpoint the store.
+const std::size_t checkpoint_results = 1000;
+
+
+/// Draws a random number from the standard normal distribution.
+///
+/// \return A random number computed with the Box-Muller transform.
+static double
+random_normal(void)
+{
+    const double u1 = (std::rand() + 1.0) / (RAND_MAX + 2.0);
+    const double u2 = (std::rand() + 1.0) / (RAND_MAX + 2.0);
+    return std::sqrt(-2.0 * std::log(u1)) * std::cos(6.283185307179586 * u2);
+}
+
+
+/// Writes the output of a replayed test case.
+///
+/// Four out of five outputs are empty and a few others repeat the same warning,
+/// as is common in real runs.  The sizes of the rest follow a log-normal
+/// distribution with a median of 512 bytes and a long tail capped at 1 MiB.
+///
+/// \param path The file to write.
+/// \param id Identifier of the test case, to make its output unique.
+static void
+write_output(const fs::path& path, const std::size_t id)
+{
+    std::ofstream output(path.c_str(), std::ios::trunc);
+    ATF_REQUIRE(output);
+
+    const int kind = std::rand() % 100;
+    if (kind < 80) {
+        return;
+    } else if (kind < 85) {
+        output << "WARNING: The test program uses a deprecated interface\n";
+        return;
+    }
+
+    const double size = std::exp(std::log(512.0) + 2.0 * random_normal());
+    const std::size_t bytes = static_cast< std::size_t >(
+        std::min(size, 1024.0 * 1024.0));
+    std::size_t written = 0;
+    for (std::size_t line = 0; written < bytes; ++line) {
+        const std::string text = F("Test case %s: check %s passed\n") % id %
+            line;
+        output << text;
+        written += text.length();
+    }
+}
+
+
+/// Gets the size of a file.
+///
+/// \param path The file to query.
+///
+/// \return The size of the file in bytes, or 0 if it does not exist.
+static off_t
+file_size(const fs::path& path)
+{
+    struct ::stat sb;
+    if (::stat(path.c_str(), &sb) == -1)
+        return 0;
+    return sb.st_size;
+}
+
+
+/// Replays a run with realistic results and outputs into a new store.
+///
+/// The run stores benchmark_iterations test cases, 100000 by default, in test
+/// programs of cases_per_program test cases each and checkpoints the store
+/// every checkpoint_results results.  Only the time spent within the store is
+/// measured.  Besides the usual throughput line, this reports the number of
+/// results stored per second, the distribution of the commit latencies and the
+/// final sizes of the database and of its segment.
+///
+/// \param tc The calling test.
+/// \param profile SQLite settings for the database.
+/// \param compression_level Compression level for the stored files.
+/// \param segment_threshold Minimum length of the files to store in the
+///     segment; none to keep all of them in the database.
+static void
+replay_run(const atf::tests::tc* tc, const store::write_profile& profile,
+           const int compression_level,
+           const utils::optional< std::size_t >& segment_threshold)
+{
+    const std::size_t iterations = utils::benchmark_iterations(tc, 100000);
+    std::srand(1);
+
+    const fs::path db_path("test.db");
+    store::write_backend backend = store::write_backend::open_rw(db_path,
+                                                                 profile);
+    store::write_transaction tx = backend.start_write();
+    tx.set_compression_level(compression_level);
+    if (segment_threshold)
+        tx.set_segment_threshold(segment_threshold.get());
+    tx.put_context(model::context(fs::path("/the/work/dir"),
+                                  std::map< std::string, std::string >()));
+
+    const datetime::timestamp start_time = datetime::timestamp::from_values(
+        2012, 01, 30, 22, 10, 00, 0);
+    const datetime::timestamp end_time = datetime::timestamp::from_values(
+        2012, 01, 30, 22, 10, 01, 0);
+    const fs::path stdout_path("stdout.txt");
+    const fs::path stderr_path("stderr.txt");
+
+    utils::latency_histogram commit_latencies;
+    datetime::delta store_time;
+    std::size_t id = 0;
+    for (std::size_t program_id = 0; id < iterations; ++program_id) {
+        model::test_program_builder builder(
+            "atf", fs::path(F("dir%s/program%s") % (program_id / 10) %
+                            program_id),
+            fs::path("/usr/tests"), "the-suite");
+        std::vector< std::string > names;
+        for (std::size_t i = 0; i < cases_per_program; ++i) {
+            names.push_back(F("case%s") % i);
+            builder.add_test_case(names[i]);
+        }
+        const model::test_program program = builder.build();
+
+        datetime::timestamp before = datetime::timestamp::now();
+        const store::test_case_ids_map ids = tx.put_test_program_with_cases(
+            program, names).second;
+        store_time += datetime::timestamp::now() - before;
+
+        for (std::size_t i = 0; i < names.size() && id < iterations;
+             ++i, ++id) {
+            write_output(stdout_path, id);
+            write_output(stderr_path, id);
+            const model::test_result result = std::rand() % 100 < 5 ?
+                model::test_result(model::test_result_failed,
+                                   "Some check failed") :
+                model::test_result(model::test_result_passed);
+            const int64_t test_case_id = (*ids.find(names[i])).second;
+
+            before = datetime::timestamp::now();
+            tx.put_result(result, test_case_id, start_time, end_time);
+            tx.put_test_case_file("__STDOUT__", stdout_path, test_case_id);
+            tx.put_test_case_file("__STDERR__", stderr_path, test_case_id);
+            if ((id + 1) % checkpoint_results == 0) {
+                const datetime::timestamp commit_start =
+                    datetime::timestamp::now();
+                tx.checkpoint();
+                commit_latencies.record_interval(commit_start,
+                                                 datetime::timestamp::now());
+            }
+            store_time += datetime::timestamp::now() - before;
+        }
+    }
+
+    const datetime::timestamp commit_start = datetime::timestamp::now();
+    tx.commit();
+    backend.close();
+    commit_latencies.record_interval(commit_start, datetime::timestamp::now());
+    store_time += datetime::timestamp::now() - commit_start;
+
+    utils::report_benchmark(tc, iterations, store_time);
+    const std::string ident = tc->get_md_var("ident");
+    std::cout << ident << ".results_per_second = "
+              << (iterations * 1000000 /
+                  std::max(store_time.to_microseconds(), int64_t(1))) << '\n';
+    utils::report_benchmark_latencies(tc, "commit", commit_latencies);
+    std::cout << ident << ".db_bytes = " << file_size(db_path) << '\n';
+    std::cout << ident << ".segment_bytes = "
+              << file_size(store::detail::segment_path(db_path)) << '\n';
+}
+
+
+}  // anonymous namespace
+
+
+ATF_TEST_CASE(put_result);
+ATF_TEST_CASE_HEAD(put_result)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(put_result)
+{
+    utils::require_run_benchmarks(this);
+    const std::size_t iterations = utils::benchmark_iterations(this, 10000);
+
+    store::write_backend backend = store::write_backend::open_rw(
+        fs::path("test.db"));
+    backend.database().exec("PRAGMA foreign_keys = OFF");
+    store::write_transaction tx = backend.start_write();
+
+    const model::test_result result(model::test_result_failed,
+                                    "Some check failed");
+    const datetime::timestamp start_time = datetime::timestamp::from_values(
+        2012, 01, 30, 22, 10, 00, 0);
+    const datetime::timestamp end_time = datetime::timestamp::from_values(
+        2012, 01, 30, 22, 15, 30, 123456);
+
+    const datetime::timestamp start = datetime::timestamp::now();
+    for (std::size_t i = 0; i < iterations; ++i)
+        tx.put_result(result, static_cast< int64_t >(i), start_time, end_time);
+    tx.commit();
+    utils::report_benchmark(this, iterations,
+                            datetime::timestamp::now() - start);
+}
+
+
+/// Defines a benchmark that replays a run into a store with some settings.
+///
+/// \param name The name of the test case, prefixed by replay__.
+/// \param journal The journal mode of the database; NULL for the default.
+/// \param sync The synchronous mode of the database; NULL for the default.
+/// \param level Compression level for the stored files.
+/// \param threshold Minimum length of the files to store in the segment; none
+///     to keep all of them in the database.
+#define REPLAY_BENCHMARK(name, journal, sync, level, threshold) \
+    ATF_TEST_CASE(replay__ ## name); \
+    ATF_TEST_CASE_HEAD(replay__ ## name) \
+    { \
+        logging::set_inmemory(); \
+        set_md_var("require.files", store::detail::schema_file().c_str()); \
+        set_md_var("timeout", "3600"); \
+    } \
+    ATF_TEST_CASE_BODY(replay__ ## name) \
+    { \
+        utils::require_run_benchmarks(this); \
+        store::write_profile profile; \
+        const char* journal_mode = journal; \
+        if (journal_mode != NULL) \
+            profile.journal_mode = std::string(journal_mode); \
+        const char* synchronous = sync; \
+        if (synchronous != NULL) \
+            profile.synchronous = std::string(synchronous); \
+        replay_run(this, profile, level, threshold); \
+    }
+
+
+REPLAY_BENCHMARK(default, NULL, NULL, 0, utils::none);
+REPLAY_BENCHMARK(wal, "wal", "normal", 0, utils::none);
+REPLAY_BENCHMARK(compression, NULL, NULL, 6, utils::none);
+REPLAY_BENCHMARK(segment, NULL, NULL, 0,
+                 utils::make_optional(std::size_t(4096)));
+REPLAY_BENCHMARK(all, "wal", "normal", 6,
+                 utils::make_optional(std::size_t(4096)));
+
+
+ATF_INIT_TEST_CASES(tcs)
+{
+    ATF_ADD_TEST_CASE(tcs, put_result);
+    ATF_ADD_TEST_CASE(tcs, replay__default);
+    ATF_ADD_TEST_CASE(tcs, replay__wal);
+    ATF_ADD_TEST_CASE(tcs, replay__compression);
+    ATF_ADD_TEST_CASE(tcs, replay__segment);
+    ATF_ADD_TEST_CASE(tcs, replay__all);
+}
@@ -28,9 +28,13 @@
 
 #include "store/write_transaction.hpp"
 
+#include <cstddef>
 #include <cstring>
 #include <map>
+#include <set>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include <atf-c++.hpp>
 
@@ -42,17 +46,23 @@
 #include "store/exceptions.hpp"
 #include "store/write_backend.hpp"
 #include "utils/datetime.hpp"
+#include "utils/format/macros.hpp"
 #include "utils/fs/path.hpp"
+#include "utils/latency_histogram.hpp"
 #include "utils/logging/operations.hpp"
 #include "utils/optional.ipp"
+#include "utils/process/resource_usage.hpp"
 #include "utils/sqlite/database.hpp"
 #include "utils/sqlite/exceptions.hpp"
 #include "utils/sqlite/statement.ipp"
+#include "utils/units.hpp"
 
 namespace datetime = utils::datetime;
 namespace fs = utils::fs;
 namespace logging = utils::logging;
+namespace process = utils::process;
 namespace sqlite = utils::sqlite;
+namespace units = utils::units;
 
 using utils::optional;
 
@@ -149,6 +159,54 @@ ATF_TEST_CASE_BODY(commit__fail)
 }
 
 
+ATF_TEST_CASE(checkpoint__ok);
+ATF_TEST_CASE_HEAD(checkpoint__ok)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(checkpoint__ok)
+{
+    store::write_backend backend = store::write_backend::open_rw(
+        fs::path("test.db"));
+    store::write_transaction tx = backend.start_write();
+    const model::metadata md = model::metadata_builder()
+        .add_custom("var1", "value1")
+        .build();
+    const model::test_program test_program = model::test_program_builder(
+        "plain", fs::path("the/binary"), fs::path("/some/root"), "suite")
+        .add_test_case("first", md)
+        .add_test_case("second", md)
+        .build();
+    const int64_t tp_id = tx.put_test_program(test_program);
+    const int64_t tc1_id = tx.put_test_case(test_program, "first", tp_id);
+
+    tx.checkpoint();
+
+    {
+        sqlite::database db = sqlite::database::open(
+            fs::path("test.db"), sqlite::open_readonly);
+        sqlite::statement stmt = db.create_statement(
+            "SELECT test_case_id FROM test_cases");
+        ATF_REQUIRE(stmt.step());
+        ATF_REQUIRE_EQ(tc1_id, stmt.column_int64(0));
+        ATF_REQUIRE(!stmt.step());
+    }
+
+    // The identifiers and caches from before the checkpoint must still be
+    // usable, and a rollback must only discard the new changes.
+    const int64_t tc2_id = tx.put_test_case(test_program, "second", tp_id);
+    tx.rollback();
+
+    sqlite::statement stmt = backend.database().create_statement(
+        "SELECT test_case_id FROM test_cases");
+    ATF_REQUIRE(stmt.step());
+    ATF_REQUIRE_EQ(tc1_id, stmt.column_int64(0));
+    ATF_REQUIRE(!stmt.step());
+    ATF_REQUIRE(tc1_id != tc2_id);
+}
+
+
 ATF_TEST_CASE(rollback__ok);
 ATF_TEST_CASE_HEAD(rollback__ok)
 {
@@ -208,6 +266,122 @@ ATF_TEST_CASE_BODY(put_test_program__ok)
 }
 
 
+ATF_TEST_CASE(put_test_case__interned_metadata);
+ATF_TEST_CASE_HEAD(put_test_case__interned_metadata)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(put_test_case__interned_metadata)
+{
+    const model::metadata md = model::metadata_builder()
+        .add_custom("var1", "value1")
+        .build();
+    const model::test_program test_program = model::test_program_builder(
+        "plain", fs::path("the/binary"), fs::path("/some/root"), "the-suite")
+        .add_test_case("tc1", md)
+        .add_test_case("tc2")
+        .add_test_case("tc3", md)
+        .build();
+
+    store::write_backend backend = store::write_backend::open_rw(
+        fs::path("test.db"));
+    backend.database().exec("PRAGMA foreign_keys = OFF");
+    store::write_transaction tx = backend.start_write();
+    const int64_t test_program_id = tx.put_test_program(test_program);
+    tx.put_test_case(test_program, "tc1", test_program_id);
+    tx.put_test_case(test_program, "tc2", test_program_id);
+    tx.put_test_case(test_program, "tc3", test_program_id);
+    tx.commit();
+
+    // The test program and tc2 share the default metadata, and tc1 and tc3
+    // share the custom one.
+    sqlite::statement stmt = backend.database().create_statement(
+        "SELECT COUNT(DISTINCT metadata_id) AS count FROM metadatas");
+    ATF_REQUIRE(stmt.step());
+    ATF_REQUIRE_EQ(2, stmt.safe_column_int64("count"));
+
+    sqlite::statement stmt2 = backend.database().create_statement(
+        "SELECT name, metadata_id FROM test_cases ORDER BY name");
+    ATF_REQUIRE(stmt2.step());
+    const int64_t tc1_metadata_id = stmt2.safe_column_int64("metadata_id");
+    ATF_REQUIRE(stmt2.step());
+    const int64_t tc2_metadata_id = stmt2.safe_column_int64("metadata_id");
+    ATF_REQUIRE(stmt2.step());
+    const int64_t tc3_metadata_id = stmt2.safe_column_int64("metadata_id");
+    ATF_REQUIRE(!stmt2.step());
+    ATF_REQUIRE_EQ(tc1_metadata_id, tc3_metadata_id);
+    ATF_REQUIRE(tc1_metadata_id != tc2_metadata_id);
+}
+
+
+ATF_TEST_CASE(put_test_program_with_cases__ok);
+ATF_TEST_CASE_HEAD(put_test_program_with_cases__ok)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(put_test_program_with_cases__ok)
+{
+    const model::metadata md = model::metadata_builder()
+        .add_custom("var1", "value1")
+        .build();
+    model::test_program_builder builder(
+        "plain", fs::path("the/binary"), fs::path("/some/root"), "the-suite");
+    std::vector< std::string > names;
+    for (int i = 0; i < 250; ++i) {
+        const std::string name = F("tc%s") % i;
+        if (i % 2 == 0)
+            builder.add_test_case(name, md);
+        else
+            builder.add_test_case(name);
+        // Leave one test case out to check that only the requested ones are
+        // put, in any order.
+        if (i != 7)
+            names.insert(names.begin(), name);
+    }
+    const model::test_program test_program = builder.build();
+
+    store::write_backend backend = store::write_backend::open_rw(
+        fs::path("test.db"));
+    backend.database().exec("PRAGMA foreign_keys = OFF");
+    store::write_transaction tx = backend.start_write();
+    const std::pair< int64_t, store::test_case_ids_map > ids =
+        tx.put_test_program_with_cases(test_program, names);
+    const int64_t tc7_id = tx.put_test_case(test_program, "tc7", ids.first);
+    tx.commit();
+
+    ATF_REQUIRE_EQ(names.size(), ids.second.size());
+    ATF_REQUIRE(ids.second.find("tc7") == ids.second.end());
+
+    sqlite::statement stmt = backend.database().create_statement(
+        "SELECT test_case_id, test_program_id, name FROM test_cases");
+    std::size_t count = 0;
+    while (stmt.step()) {
+        const int64_t test_case_id = stmt.safe_column_int64("test_case_id");
+        const std::string name = stmt.safe_column_text("name");
+        ATF_REQUIRE_EQ(ids.first, stmt.safe_column_int64("test_program_id"));
+        if (name == "tc7") {
+            ATF_REQUIRE_EQ(tc7_id, test_case_id);
+        } else {
+            const store::test_case_ids_map::const_iterator iter =
+                ids.second.find(name);
+            ATF_REQUIRE(iter != ids.second.end());
+            ATF_REQUIRE_EQ((*iter).second, test_case_id);
+        }
+        ++count;
+    }
+    ATF_REQUIRE_EQ(names.size() + 1, count);
+
+    // The test program and the odd test cases share the default metadata,
+    // and the even test cases share the custom one.
+    sqlite::statement stmt2 = backend.database().create_statement(
+        "SELECT COUNT(DISTINCT metadata_id) AS count FROM metadatas");
+    ATF_REQUIRE(stmt2.step());
+    ATF_REQUIRE_EQ(2, stmt2.safe_column_int64("count"));
+}
+
+
 ATF_TEST_CASE(put_test_case__fail);
 ATF_TEST_CASE_HEAD(put_test_case__fail)
 {
@@ -288,6 +462,215 @@ ATF_TEST_CASE_BODY(put_test_case_file__some)
 }
 
 
+ATF_TEST_CASE(put_test_case_file__large);
+ATF_TEST_CASE_HEAD(put_test_case_file__large)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(put_test_case_file__large)
+{
+    // Use a size that is not a multiple of the chunk size used internally.
+    std::string contents;
+    for (int i = 0; i < 300000; ++i)
+        contents += static_cast< char >('a' + i % 26);
+
+    atf::utils::create_file("input.txt", contents);
+
+    store::write_backend backend = store::write_backend::open_rw(
+        fs::path("test.db"));
+    backend.database().exec("PRAGMA foreign_keys = OFF");
+    store::write_transaction tx = backend.start_write();
+    const optional< int64_t > file_id = tx.put_test_case_file(
+        "my-file", fs::path("input.txt"), 123L);
+    tx.commit();
+    ATF_REQUIRE(file_id);
+
+    sqlite::statement stmt = backend.database().create_statement(
+        "SELECT * FROM test_case_files NATURAL JOIN files");
+
+    ATF_REQUIRE(stmt.step());
+    const sqlite::blob blob = stmt.safe_column_blob("contents");
+    ATF_REQUIRE(contents.length() == static_cast< std::size_t >(blob.size));
+    ATF_REQUIRE(std::memcmp(contents.c_str(), blob.memory, blob.size) == 0);
+    ATF_REQUIRE(!stmt.step());
+}
+
+
+ATF_TEST_CASE(put_test_case_file__dedup);
+ATF_TEST_CASE_HEAD(put_test_case_file__dedup)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(put_test_case_file__dedup)
+{
+    atf::utils::create_file("input1.txt", "Same contents");
+    atf::utils::create_file("input2.txt", "Same contents");
+    atf::utils::create_file("input3.txt", "Different contents");
+
+    store::write_backend backend = store::write_backend::open_rw(
+        fs::path("test.db"));
+    backend.database().exec("PRAGMA foreign_keys = OFF");
+    store::write_transaction tx = backend.start_write();
+    const optional< int64_t > file_id1 = tx.put_test_case_file(
+        "__STDOUT__", fs::path("input1.txt"), 1L);
+    const optional< int64_t > file_id2 = tx.put_test_case_file(
+        "__STDOUT__", fs::path("input2.txt"), 2L);
+    const optional< int64_t > file_id3 = tx.put_test_case_file(
+        "__STDERR__", fs::path("input3.txt"), 2L);
+    tx.commit();
+    ATF_REQUIRE(file_id1 && file_id2 && file_id3);
+    ATF_REQUIRE_EQ(file_id1.get(), file_id2.get());
+    ATF_REQUIRE(file_id1.get() != file_id3.get());
+
+    sqlite::statement stmt = backend.database().create_statement(
+        "SELECT count(*) AS count FROM files");
+    ATF_REQUIRE(stmt.step());
+    ATF_REQUIRE_EQ(2, stmt.safe_column_int64("count"));
+
+    sqlite::statement stmt2 = backend.database().create_statement(
+        "SELECT count(*) AS count FROM test_case_files");
+    ATF_REQUIRE(stmt2.step());
+    ATF_REQUIRE_EQ(3, stmt2.safe_column_int64("count"));
+}
+
+
+ATF_TEST_CASE(put_test_case_file__dedup_hash_collision);
+ATF_TEST_CASE_HEAD(put_test_case_file__dedup_hash_collision)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(put_test_case_file__dedup_hash_collision)
+{
+    atf::utils::create_file("input.txt", "abcd");
+
+    store::write_backend backend = store::write_backend::open_rw(
+        fs::path("test.db"));
+    backend.database().exec("PRAGMA foreign_keys = OFF");
+    store::write_transaction tx = backend.start_write();
+    const optional< int64_t > file_id1 = tx.put_test_case_file(
+        "my-file", fs::path("input.txt"), 1L);
+    ATF_REQUIRE(file_id1);
+
+    // Simulate a collision by keeping the hash but changing the contents.
+    backend.database().exec("UPDATE files SET contents = x'77787980'");
+
+    const optional< int64_t > file_id2 = tx.put_test_case_file(
+        "my-file", fs::path("input.txt"), 2L);
+    tx.commit();
+    ATF_REQUIRE(file_id2);
+    ATF_REQUIRE(file_id1.get() != file_id2.get());
+
+    sqlite::statement stmt = backend.database().create_statement(
+        "SELECT contents FROM files WHERE file_id == :file_id");
+    stmt.bind(":file_id", file_id2.get());
+    ATF_REQUIRE(stmt.step());
+    const sqlite::blob blob = stmt.safe_column_blob("contents");
+    ATF_REQUIRE_EQ(4, blob.size);
+    ATF_REQUIRE(std::memcmp("abcd", blob.memory, blob.size) == 0);
+}
+
+
+ATF_TEST_CASE(put_test_case_file__segment);
+ATF_TEST_CASE_HEAD(put_test_case_file__segment)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(put_test_case_file__segment)
+{
+    atf::utils::create_file("small.txt", "Small");
+    atf::utils::create_file("large1.txt", "Large contents");
+    atf::utils::create_file("large2.txt", "Large contents");
+
+    store::write_backend backend = store::write_backend::open_rw(
+        fs::path("test.db"));
+    backend.database().exec("PRAGMA foreign_keys = OFF");
+    store::write_transaction tx = backend.start_write();
+    tx.set_segment_threshold(10);
+    const optional< int64_t > small_id = tx.put_test_case_file(
+        "__STDOUT__", fs::path("small.txt"), 1L);
+    const optional< int64_t > large_id1 = tx.put_test_case_file(
+        "__STDOUT__", fs::path("large1.txt"), 2L);
+    const optional< int64_t > large_id2 = tx.put_test_case_file(
+        "__STDOUT__", fs::path("large2.txt"), 3L);
+    tx.commit();
+    ATF_REQUIRE(small_id && large_id1 && large_id2);
+    ATF_REQUIRE(small_id.get() != large_id1.get());
+    ATF_REQUIRE_EQ(large_id1.get(), large_id2.get());
+
+    sqlite::statement stmt = backend.database().create_statement(
+        "SELECT codec, size FROM files ORDER BY file_id");
+    ATF_REQUIRE(stmt.step());
+    ATF_REQUIRE_EQ("none", stmt.safe_column_text("codec"));
+    ATF_REQUIRE(stmt.step());
+    ATF_REQUIRE_EQ("segment", stmt.safe_column_text("codec"));
+    ATF_REQUIRE_EQ(14, stmt.safe_column_int64("size"));
+    ATF_REQUIRE(!stmt.step());
+
+    ATF_REQUIRE(atf::utils::compare_file("test.db-files", "Large contents"));
+}
+
+
+ATF_TEST_CASE(put_test_case_file__compressed);
+ATF_TEST_CASE_HEAD(put_test_case_file__compressed)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(put_test_case_file__compressed)
+{
+    std::string contents;
+    for (int i = 0; i < 1000; ++i)
+        contents += "This is a test!\n";
+    atf::utils::create_file("input1.txt", contents);
+    atf::utils::create_file("input2.txt", contents);
+
+    store::write_backend backend = store::write_backend::open_rw(
+        fs::path("test.db"));
+    backend.database().exec("PRAGMA foreign_keys = OFF");
+    store::write_transaction tx = backend.start_write();
+    tx.set_compression_level(6);
+    const optional< int64_t > file_id1 = tx.put_test_case_file(
+        "my-file", fs::path("input1.txt"), 1L);
+    const optional< int64_t > file_id2 = tx.put_test_case_file(
+        "my-file", fs::path("input2.txt"), 2L);
+    tx.commit();
+    ATF_REQUIRE(file_id1 && file_id2);
+    ATF_REQUIRE_EQ(file_id1.get(), file_id2.get());
+
+    sqlite::statement stmt = backend.database().create_statement(
+        "SELECT codec, length(contents) AS length FROM files");
+    ATF_REQUIRE(stmt.step());
+    ATF_REQUIRE_EQ("zlib", stmt.safe_column_text("codec"));
+    ATF_REQUIRE(stmt.safe_column_int64("length") <
+                static_cast< int64_t >(contents.length()));
+    ATF_REQUIRE(!stmt.step());
+}
+
+
+ATF_TEST_CASE(set_compression_level__invalid);
+ATF_TEST_CASE_HEAD(set_compression_level__invalid)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(set_compression_level__invalid)
+{
+    store::write_backend backend = store::write_backend::open_rw(
+        fs::path("test.db"));
+    store::write_transaction tx = backend.start_write();
+    ATF_REQUIRE_THROW_RE(store::error, "Invalid compression level -1",
+                         tx.set_compression_level(-1));
+    ATF_REQUIRE_THROW_RE(store::error, "Invalid compression level 10",
+                         tx.set_compression_level(10));
+    tx.set_compression_level(0);
+    tx.set_compression_level(9);
+}
+
+
 ATF_TEST_CASE(put_test_case_file__fail);
 ATF_TEST_CASE_HEAD(put_test_case_file__fail)
 {
@@ -395,16 +778,423 @@ ATF_TEST_CASE_BODY(put_result__fail)
 }
 
 
+ATF_TEST_CASE(put_result__summaries);
+ATF_TEST_CASE_HEAD(put_result__summaries)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(put_result__summaries)
+{
+    store::write_backend backend = store::write_backend::open_rw(
+        fs::path("test.db"));
+    backend.database().exec("PRAGMA foreign_keys = OFF");
+    store::write_transaction tx = backend.start_write();
+    tx.put_result(model::test_result(model::test_result_passed), 1,
+                  datetime::timestamp::from_microseconds(3000),
+                  datetime::timestamp::from_microseconds(3500));
+    tx.put_result(model::test_result(model::test_result_failed, "foo"), 2,
+                  datetime::timestamp::from_microseconds(1000),
+                  datetime::timestamp::from_microseconds(1100));
+    tx.put_result(model::test_result(model::test_result_passed), 3,
+                  datetime::timestamp::from_microseconds(2000),
+                  datetime::timestamp::from_microseconds(4000));
+    tx.commit();
+
+    sqlite::statement stmt = backend.database().create_statement(
+        "SELECT result_type, results_count, total_duration, min_start_time, "
+        "    max_end_time FROM result_summaries ORDER BY result_type");
+    ATF_REQUIRE(stmt.step());
+    ATF_REQUIRE_EQ("failed", stmt.column_text(0));
+    ATF_REQUIRE_EQ(1, stmt.column_int64(1));
+    ATF_REQUIRE_EQ(100, stmt.column_int64(2));
+    ATF_REQUIRE_EQ(1000, stmt.column_int64(3));
+    ATF_REQUIRE_EQ(1100, stmt.column_int64(4));
+    ATF_REQUIRE(stmt.step());
+    ATF_REQUIRE_EQ("passed", stmt.column_text(0));
+    ATF_REQUIRE_EQ(2, stmt.column_int64(1));
+    ATF_REQUIRE_EQ(2500, stmt.column_int64(2));
+    ATF_REQUIRE_EQ(2000, stmt.column_int64(3));
+    ATF_REQUIRE_EQ(4000, stmt.column_int64(4));
+    ATF_REQUIRE(!stmt.step());
+}
+
+
+ATF_TEST_CASE(put_resource_usage__ok);
+ATF_TEST_CASE_HEAD(put_resource_usage__ok)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(put_resource_usage__ok)
+{
+    const process::resource_usage usage(
+        datetime::delta(1, 500), datetime::delta(0, 250),
+        units::bytes(2048), 3, 4, 5, 6);
+
+    store::write_backend backend = store::write_backend::open_rw(
+        fs::path("test.db"));
+    backend.database().exec("PRAGMA foreign_keys = OFF");
+    store::write_transaction tx = backend.start_write();
+    tx.put_resource_usage(usage, 312L);
+    tx.commit();
+
+    sqlite::statement stmt = backend.database().create_statement(
+        "SELECT test_case_id, user_time, system_time, max_rss, in_blocks, "
+        "out_blocks, voluntary_switches, involuntary_switches "
+        "FROM test_resource_usage");
+    ATF_REQUIRE(stmt.step());
+    ATF_REQUIRE_EQ(312, stmt.column_int64(0));
+    ATF_REQUIRE_EQ(1000500, stmt.column_int64(1));
+    ATF_REQUIRE_EQ(250, stmt.column_int64(2));
+    ATF_REQUIRE_EQ(2048, stmt.column_int64(3));
+    ATF_REQUIRE_EQ(3, stmt.column_int64(4));
+    ATF_REQUIRE_EQ(4, stmt.column_int64(5));
+    ATF_REQUIRE_EQ(5, stmt.column_int64(6));
+    ATF_REQUIRE_EQ(6, stmt.column_int64(7));
+    ATF_REQUIRE(!stmt.step());
+}
+
+
+ATF_TEST_CASE(put_cache_key__ok);
+ATF_TEST_CASE_HEAD(put_cache_key__ok)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(put_cache_key__ok)
+{
+    store::write_backend backend = store::write_backend::open_rw(
+        fs::path("test.db"));
+    backend.database().exec("PRAGMA foreign_keys = OFF");
+    store::write_transaction tx = backend.start_write();
+    tx.put_cache_key("the-key", 312L);
+    tx.commit();
+
+    sqlite::statement stmt = backend.database().create_statement(
+        "SELECT test_case_id, cache_key FROM test_cache_keys");
+    ATF_REQUIRE(stmt.step());
+    ATF_REQUIRE_EQ(312, stmt.column_int64(0));
+    ATF_REQUIRE_EQ("the-key", stmt.column_text(1));
+    ATF_REQUIRE(!stmt.step());
+}
+
+
+ATF_TEST_CASE(put_cpu_affinity__ok);
+ATF_TEST_CASE_HEAD(put_cpu_affinity__ok)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(put_cpu_affinity__ok)
+{
+    store::write_backend backend = store::write_backend::open_rw(
+        fs::path("test.db"));
+    backend.database().exec("PRAGMA foreign_keys = OFF");
+    store::write_transaction tx = backend.start_write();
+    std::set< int > cpus;
+    cpus.insert(0);
+    tx.put_cpu_affinity(2, 0, cpus, 312L);
+    cpus.insert(1);
+    cpus.insert(2);
+    cpus.insert(5);
+    tx.put_cpu_affinity(3, 1, cpus, 312L);
+    tx.put_cpu_affinity(0, 0, cpus, 313L);
+    tx.commit();
+
+    sqlite::statement stmt = backend.database().create_statement(
+        "SELECT test_case_id, slot, numa_node, cpus FROM test_cpu_affinities "
+        "ORDER BY test_case_id");
+    ATF_REQUIRE(stmt.step());
+    ATF_REQUIRE_EQ(312, stmt.column_int64(0));
+    ATF_REQUIRE_EQ(3, stmt.column_int(1));
+    ATF_REQUIRE_EQ(1, stmt.column_int(2));
+    ATF_REQUIRE_EQ("0-2,5", stmt.column_text(3));
+    ATF_REQUIRE(stmt.step());
+    ATF_REQUIRE_EQ(313, stmt.column_int64(0));
+    ATF_REQUIRE(!stmt.step());
+}
+
+
+ATF_TEST_CASE(put_sub_results__ok);
+ATF_TEST_CASE_HEAD(put_sub_results__ok)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(put_sub_results__ok)
+{
+    store::write_backend backend = store::write_backend::open_rw(
+        fs::path("test.db"));
+    backend.database().exec("PRAGMA foreign_keys = OFF");
+    store::write_transaction tx = backend.start_write();
+    std::vector< model::test_result > results;
+    tx.put_sub_results(results, 312L);
+    results.push_back(model::test_result(model::test_result_passed));
+    results.push_back(model::test_result(model::test_result_failed,
+                                         "2 - second"));
+    tx.put_sub_results(results, 313L);
+    tx.commit();
+
+    sqlite::statement stmt = backend.database().create_statement(
+        "SELECT test_case_id, position, result_type, result_reason "
+        "FROM test_sub_results ORDER BY position");
+    ATF_REQUIRE(stmt.step());
+    ATF_REQUIRE_EQ(313, stmt.column_int64(0));
+    ATF_REQUIRE_EQ(1, stmt.column_int64(1));
+    ATF_REQUIRE_EQ("passed", stmt.column_text(2));
+    ATF_REQUIRE(stmt.column_type(3) == sqlite::type_null);
+    ATF_REQUIRE(stmt.step());
+    ATF_REQUIRE_EQ(313, stmt.column_int64(0));
+    ATF_REQUIRE_EQ(2, stmt.column_int64(1));
+    ATF_REQUIRE_EQ("failed", stmt.column_text(2));
+    ATF_REQUIRE_EQ("2 - second", stmt.column_text(3));
+    ATF_REQUIRE(!stmt.step());
+}
+
+
+ATF_TEST_CASE(put_latencies__ok);
+ATF_TEST_CASE_HEAD(put_latencies__ok)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(put_latencies__ok)
+{
+    utils::latency_histograms_map latencies;
+    latencies["spawn"].record(datetime::delta(0, 5));
+    latencies["spawn"].record(datetime::delta(0, 5));
+    latencies["wait"].record(datetime::delta(0, 3));
+    latencies["unused"];
+
+    store::write_backend backend = store::write_backend::open_rw(
+        fs::path("test.db"));
+    store::write_transaction tx = backend.start_write();
+    tx.put_latencies(latencies);
+    tx.commit();
+
+    sqlite::statement stmt = backend.database().create_statement(
+        "SELECT phase, upper_bound, count FROM phase_latencies "
+        "ORDER BY phase, upper_bound");
+    ATF_REQUIRE(stmt.step());
+    ATF_REQUIRE_EQ("spawn", stmt.column_text(0));
+    ATF_REQUIRE_EQ(5, stmt.column_int64(1));
+    ATF_REQUIRE_EQ(2, stmt.column_int64(2));
+    ATF_REQUIRE(stmt.step());
+    ATF_REQUIRE_EQ("wait", stmt.column_text(0));
+    ATF_REQUIRE_EQ(3, stmt.column_int64(1));
+    ATF_REQUIRE_EQ(1, stmt.column_int64(2));
+    ATF_REQUIRE(!stmt.step());
+}
+
+
+ATF_TEST_CASE(put_latencies__accumulate);
+ATF_TEST_CASE_HEAD(put_latencies__accumulate)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(put_latencies__accumulate)
+{
+    utils::latency_histograms_map latencies;
+    latencies["spawn"].record(datetime::delta(0, 5));
+    latencies["wait"].record(datetime::delta(0, 3));
+    std::map< std::string, datetime::delta > usage;
+    usage["test"] = datetime::delta(2, 0);
+
+    store::write_backend backend = store::write_backend::open_rw(
+        fs::path("test.db"));
+    {
+        store::write_transaction tx = backend.start_write();
+        tx.put_latencies(latencies);
+        tx.put_slot_usage(usage);
+        tx.commit();
+    }
+    latencies.erase("wait");
+    usage["idle"] = datetime::delta(1, 0);
+    {
+        store::write_transaction tx = backend.start_write();
+        tx.put_latencies(latencies);
+        tx.put_slot_usage(usage);
+        tx.commit();
+    }
+
+    {
+        sqlite::statement stmt = backend.database().create_statement(
+            "SELECT phase, upper_bound, count FROM phase_latencies "
+            "ORDER BY phase, upper_bound");
+        ATF_REQUIRE(stmt.step());
+        ATF_REQUIRE_EQ("spawn", stmt.column_text(0));
+        ATF_REQUIRE_EQ(5, stmt.column_int64(1));
+        ATF_REQUIRE_EQ(2, stmt.column_int64(2));
+        ATF_REQUIRE(stmt.step());
+        ATF_REQUIRE_EQ("wait", stmt.column_text(0));
+        ATF_REQUIRE_EQ(1, stmt.column_int64(2));
+        ATF_REQUIRE(!stmt.step());
+    }
+    {
+        sqlite::statement stmt = backend.database().create_statement(
+            "SELECT activity, slot_time FROM slot_usage ORDER BY activity");
+        ATF_REQUIRE(stmt.step());
+        ATF_REQUIRE_EQ("idle", stmt.column_text(0));
+        ATF_REQUIRE_EQ(1000000, stmt.column_int64(1));
+        ATF_REQUIRE(stmt.step());
+        ATF_REQUIRE_EQ("test", stmt.column_text(0));
+        ATF_REQUIRE_EQ(4000000, stmt.column_int64(1));
+        ATF_REQUIRE(!stmt.step());
+    }
+}
+
+
+ATF_TEST_CASE(discard_pending_test_cases__ok);
+ATF_TEST_CASE_HEAD(discard_pending_test_cases__ok)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(discard_pending_test_cases__ok)
+{
+    const model::test_program test_program = model::test_program_builder(
+        "plain", fs::path("the/binary"), fs::path("/some/root"), "the-suite")
+        .add_test_case("done").add_test_case("running")
+        .add_test_case("queued").build();
+    const datetime::timestamp start_time = datetime::timestamp::from_values(
+        2012, 01, 30, 22, 10, 00, 0);
+    const datetime::timestamp end_time = datetime::timestamp::from_values(
+        2012, 01, 30, 22, 15, 30, 0);
+
+    store::write_backend backend = store::write_backend::open_rw(
+        fs::path("test.db"));
+    store::write_transaction tx = backend.start_write();
+    const int64_t program_id = tx.put_test_program(test_program);
+    const int64_t done_id = tx.put_test_case(test_program, "done", program_id);
+    const int64_t running_id = tx.put_test_case(test_program, "running",
+                                                program_id);
+    (void)tx.put_test_case(test_program, "queued", program_id);
+    tx.put_result(model::test_result(model::test_result_passed), done_id,
+                  start_time, end_time);
+    tx.put_cache_key("the-key", done_id);
+    tx.put_cache_key("other-key", running_id);
+    tx.put_retried_result(model::test_result(model::test_result_failed, "x"),
+                          running_id, 1, start_time, end_time);
+
+    ATF_REQUIRE_EQ(2, tx.discard_pending_test_cases());
+    ATF_REQUIRE_EQ(0, tx.discard_pending_test_cases());
+    tx.commit();
+
+    {
+        sqlite::statement stmt = backend.database().create_statement(
+            "SELECT test_case_id, name FROM test_cases");
+        ATF_REQUIRE(stmt.step());
+        ATF_REQUIRE_EQ(done_id, stmt.column_int64(0));
+        ATF_REQUIRE_EQ("done", stmt.column_text(1));
+        ATF_REQUIRE(!stmt.step());
+    }
+    {
+        sqlite::statement stmt = backend.database().create_statement(
+            "SELECT test_case_id FROM test_cache_keys");
+        ATF_REQUIRE(stmt.step());
+        ATF_REQUIRE_EQ(done_id, stmt.column_int64(0));
+        ATF_REQUIRE(!stmt.step());
+    }
+    {
+        sqlite::statement stmt = backend.database().create_statement(
+            "SELECT * FROM test_retried_results");
+        ATF_REQUIRE(!stmt.step());
+    }
+}
+
+
+ATF_TEST_CASE(put_retried_result__ok);
+ATF_TEST_CASE_HEAD(put_retried_result__ok)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(put_retried_result__ok)
+{
+    const datetime::timestamp start_time = datetime::timestamp::from_values(
+        2012, 01, 30, 22, 10, 00, 0);
+    const datetime::timestamp end_time = datetime::timestamp::from_values(
+        2012, 01, 30, 22, 15, 30, 123456);
+
+    store::write_backend backend = store::write_backend::open_rw(
+        fs::path("test.db"));
+    backend.database().exec("PRAGMA foreign_keys = OFF");
+    store::write_transaction tx = backend.start_write();
+    tx.put_retried_result(model::test_result(model::test_result_failed, "1st"),
+                          312L, 1, start_time, end_time);
+    tx.put_retried_result(model::test_result(model::test_result_broken, "2nd"),
+                          312L, 2, start_time, end_time);
+    tx.put_result(model::test_result(model::test_result_passed), 312L,
+                  start_time, end_time, 3);
+    tx.commit();
+
+    sqlite::statement stmt = backend.database().create_statement(
+        "SELECT attempt, result_type, result_reason "
+        "FROM test_retried_results WHERE test_case_id = 312 "
+        "ORDER BY attempt");
+    ATF_REQUIRE(stmt.step());
+    ATF_REQUIRE_EQ(1, stmt.column_int(0));
+    ATF_REQUIRE_EQ("failed", stmt.column_text(1));
+    ATF_REQUIRE_EQ("1st", stmt.column_text(2));
+    ATF_REQUIRE(stmt.step());
+    ATF_REQUIRE_EQ(2, stmt.column_int(0));
+    ATF_REQUIRE_EQ("broken", stmt.column_text(1));
+    ATF_REQUIRE_EQ("2nd", stmt.column_text(2));
+    ATF_REQUIRE(!stmt.step());
+
+    sqlite::statement stmt2 = backend.database().create_statement(
+        "SELECT attempt, result_type FROM test_results "
+        "WHERE test_case_id = 312");
+    ATF_REQUIRE(stmt2.step());
+    ATF_REQUIRE_EQ(3, stmt2.column_int(0));
+    ATF_REQUIRE_EQ("passed", stmt2.column_text(1));
+    ATF_REQUIRE(!stmt2.step());
+}
+
+
+ATF_TEST_CASE(put_retried_result__duplicate);
+ATF_TEST_CASE_HEAD(put_retried_result__duplicate)
+{
+    logging::set_inmemory();
+    set_md_var("require.files", store::detail::schema_file().c_str());
+}
+ATF_TEST_CASE_BODY(put_retried_result__duplicate)
+{
+    const datetime::timestamp zero = datetime::timestamp::from_microseconds(0);
+    const model::test_result result(model::test_result_failed, "foo");
+
+    store::write_backend backend = store::write_backend::open_rw(
+        fs::path("test.db"));
+    backend.database().exec("PRAGMA foreign_keys = OFF");
+    store::write_transaction tx = backend.start_write();
+    tx.put_retried_result(result, 312L, 1, zero, zero);
+    ATF_REQUIRE_THROW(store::error,
+                      tx.put_retried_result(result, 312L, 1, zero, zero));
+    tx.commit();
+}
+
+
 ATF_INIT_TEST_CASES(tcs)
 {
     ATF_ADD_TEST_CASE(tcs, commit__ok);
     ATF_ADD_TEST_CASE(tcs, commit__fail);
+    ATF_ADD_TEST_CASE(tcs, checkpoint__ok);
     ATF_ADD_TEST_CASE(tcs, rollback__ok);
 
     ATF_ADD_TEST_CASE(tcs, put_test_program__ok);
+    ATF_ADD_TEST_CASE(tcs, put_test_case__interned_metadata);
+    ATF_ADD_TEST_CASE(tcs, put_test_program_with_cases__ok);
     ATF_ADD_TEST_CASE(tcs, put_test_case__fail);
     ATF_ADD_TEST_CASE(tcs, put_test_case_file__empty);
     ATF_ADD_TEST_CASE(tcs, put_test_case_file__some);
+    ATF_ADD_TEST_CASE(tcs, put_test_case_file__large);
+    ATF_ADD_TEST_CASE(tcs, put_test_case_file__dedup);
+    ATF_ADD_TEST_CASE(tcs, put_test_case_file__dedup_hash_collision);
+    ATF_ADD_TEST_CASE(tcs, put_test_case_file__segment);
+    ATF_ADD_TEST_CASE(tcs, put_test_case_file__compressed);
+    ATF_ADD_TEST_CASE(tcs, set_compression_level__invalid);
     ATF_ADD_TEST_CASE(tcs, put_test_case_file__fail);
 
     ATF_ADD_TEST_CASE(tcs, put_result__ok__broken);
@@ -413,4 +1203,17 @@ ATF_INIT_TEST_CASES(tcs)
     ATF_ADD_TEST_CASE(tcs, put_result__ok__passed);
     ATF_ADD_TEST_CASE(tcs, put_result__ok__skipped);
     ATF_ADD_TEST_CASE(tcs, put_result__fail);
+    ATF_ADD_TEST_CASE(tcs, put_result__summaries);
+
+    ATF_ADD_TEST_CASE(tcs, put_resource_usage__ok);
+    ATF_ADD_TEST_CASE(tcs, put_retried_result__ok);
+    ATF_ADD_TEST_CASE(tcs, put_retried_result__duplicate);
+
+    ATF_ADD_TEST_CASE(tcs, put_cache_key__ok);
+    ATF_ADD_TEST_CASE(tcs, put_cpu_affinity__ok);
+    ATF_ADD_TEST_CASE(tcs, put_sub_results__ok);
+    ATF_ADD_TEST_CASE(tcs, put_latencies__ok);
+    ATF_ADD_TEST_CASE(tcs, put_latencies__accumulate);
+
+    ATF_ADD_TEST_CASE(tcs, discard_pending_test_cases__ok);
 }
@@ -0,0 +1,430 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "utils/cgroup.hpp"
+
+extern "C" {
+#include <stdint.h>
+}
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "utils/format/macros.hpp"
+#include "utils/fs/path.hpp"
+#include "utils/logging/macros.hpp"
+#include "utils/optional.ipp"
+#include "utils/text/exceptions.hpp"
+#include "utils/text/operations.ipp"
+#include "utils/units.hpp"
+
+namespace fs = utils::fs;
+namespace text = utils::text;
+namespace units = utils::units;
+
+using utils::none;
+using utils::optional;
+
+
+namespace {
+
+
+/// Path to the file that lists the control groups of the current process.
+static const char* proc_cgroup_path = "/proc/self/cgroup";
+
+
+/// Path to the mount point of the control group hierarchies.
+static const char* cgroup_root = "/sys/fs/cgroup";
+
+
+/// Smallest value that cgroup v1 uses to represent the lack of a limit.
+///
+/// cgroup v1 has no "max" keyword and reports unlimited memory as the largest
+/// multiple of the page size that fits in a signed 64-bit integer instead.
+static const int64_t unlimited_threshold = int64_t(1) << 62;
+
+
+/// The directories of the control group of the process in one hierarchy.
+struct controller_dirs {
+    /// Whether the directories belong to the unified hierarchy of cgroup v2.
+    bool unified;
+
+    /// The directory of the control group and those of all its ancestors.
+    std::vector< fs::path > dirs;
+
+    /// Constructs an empty set of directories.
+    controller_dirs(void) : unified(false)
+    {
+    }
+};
+
+
+/// Reads the first line of a file.
+///
+/// \param file The file to read.
+///
+/// \return The first line of the file, or none if the file cannot be read.
+static optional< std::string >
+read_first_line(const fs::path& file)
+{
+    std::ifstream input(file.c_str());
+    if (!input)
+        return none;
+    std::string line;
+    if (!std::getline(input, line))
+        return none;
+    return utils::make_optional(line);
+}
+
+
+/// Parses a limit exposed by a control group.
+///
+/// \param raw_value The textual representation of the limit.
+/// \param file The file from which the limit was read, for error reporting.
+///
+/// \return The value of the limit, or none if the value represents the lack of
+/// a limit or is invalid.
+static optional< int64_t >
+parse_limit(const std::string& raw_value, const fs::path& file)
+{
+    if (raw_value == "max")
+        return none;
+    int64_t value;
+    try {
+        value = text::to_type< int64_t >(raw_value);
+    } catch (const text::value_error& e) {
+        LW(F("Invalid value '%s' in %s") % raw_value % file);
+        return none;
+    }
+    if (value < 0 || value >= unlimited_threshold)
+        return none;
+    return utils::make_optional(value);
+}
+
+
+/// Reads a limit exposed by a control group.
+///
+/// \param file The file that holds the limit.
+///
+/// \return The value of the limit, or none if the file does not exist or if
+/// there is no limit.
+static optional< int64_t >
+read_limit(const fs::path& file)
+{
+    const optional< std::string > raw_value = read_first_line(file);
+    if (!raw_value)
+        return none;
+    return parse_limit(raw_value.get(), file);
+}
+
+
+/// Locates the directories of the control group of the process.
+///
+/// \param root Path to the mount point of the control group hierarchies.
+/// \param paths The control groups of the process.
+/// \param controller The controller whose hierarchy to locate.
+///
+/// \return The directories of the control group in the cgroup v1 hierarchy of
+/// the controller if it is mounted or in the unified hierarchy otherwise.  The
+/// directories are empty if the process does not belong to any of these.
+static controller_dirs
+find_controller(const fs::path& root,
+                const utils::detail::cgroup_paths_map& paths,
+                const std::string& controller)
+{
+    controller_dirs result;
+
+    fs::path dir = root;
+    utils::detail::cgroup_paths_map::const_iterator iter = paths.find(
+        controller);
+    if (iter != paths.end()) {
+        dir = dir / controller;
+    } else {
+        iter = paths.find("");
+        if (iter == paths.end())
+            return result;
+        result.unified = true;
+    }
+
+    // The limits of the ancestors apply as well.  Within a container that does
+    // not have its own cgroup namespace, the paths of the process are those of
+    // the host and do not exist; only the root of the hierarchy, which
+    // the container runtime limits, is then accessible.
+    result.dirs.push_back(dir);
+    const std::vector< std::string > components = text::split(
+        (*iter).second, '/');
+    for (std::vector< std::string >::const_iterator component =
+             components.begin(); component != components.end(); ++component) {
+        if ((*component).empty())
+            continue;
+        dir = dir / *component;
+        result.dirs.push_back(dir);
+    }
+    return result;
+}
+
+
+/// Gets the control groups of the current process.
+///
+/// The query is run only once and the result is cached.
+///
+/// \return The control groups of the process, which are empty if the system
+/// does not support them.
+static const utils::detail::cgroup_paths_map&
+own_cgroup_paths(void)
+{
+    static bool queried = false;
+    static utils::detail::cgroup_paths_map paths;
+    if (!queried) {
+        std::ifstream input(proc_cgroup_path);
+        if (input)
+            paths = utils::detail::parse_cgroup_paths(input);
+        queried = true;
+    }
+    return paths;
+}
+
+
+}  // anonymous namespace
+
+
+/// Parses the list of control groups of a process.
+///
+/// The input is expected to follow the format of /proc/self/cgroup, which has
+/// one "id:controllers:path" line per hierarchy.  The controllers are
+/// separated by commas, and the unified hierarchy of cgroup v2 has none.
+///
+/// \param input The stream from which to read the list.
+///
+/// \return The path of the process in each hierarchy, keyed by the controllers
+/// of the hierarchy.  Malformed lines are ignored.
+utils::detail::cgroup_paths_map
+utils::detail::parse_cgroup_paths(std::istream& input)
+{
+    cgroup_paths_map paths;
+    std::string line;
+    while (std::getline(input, line)) {
+        const std::string::size_type first = line.find(':');
+        if (first == std::string::npos)
+            continue;
+        const std::string::size_type second = line.find(':', first + 1);
+        if (second == std::string::npos)
+            continue;
+
+        const std::string controllers = line.substr(first + 1,
+                                                    second - first - 1);
+        const std::string path = line.substr(second + 1);
+        if (controllers.empty()) {
+            paths[""] = path;
+        } else {
+            const std::vector< std::string > names = text::split(
+                controllers, ',');
+            for (std::vector< std::string >::const_iterator iter =
+                     names.begin(); iter != names.end(); ++iter)
+                paths[*iter] = path;
+        }
+    }
+    return paths;
+}
+
+
+/// Finds the memory limit of a control group.
+///
+/// \param root Path to the mount point of the control group hierarchies.
+/// \param paths The control groups of the process.
+///
+/// \return The smallest of the memory limits of the control group and of its
+/// ancestors, or none if none is limited.
+optional< units::bytes >
+utils::detail::find_cgroup_memory_limit(const fs::path& root,
+                                        const cgroup_paths_map& paths)
+{
+    const controller_dirs memory = find_controller(root, paths, "memory");
+    const char* limit_name = memory.unified ?
+        "memory.max" : "memory.limit_in_bytes";
+
+    optional< int64_t > limit;
+    for (std::vector< fs::path >::const_iterator iter = memory.dirs.begin();
+         iter != memory.dirs.end(); ++iter) {
+        const optional< int64_t > value = read_limit(*iter / limit_name);
+        if (value && (!limit || value.get() < limit.get()))
+            limit = value;
+    }
+    if (!limit)
+        return none;
+    return utils::make_optional(units::bytes(limit.get()));
+}
+
+
+/// Finds the memory that a control group can still allocate.
+///
+/// \param root Path to the mount point of the control group hierarchies.
+/// \param paths The control groups of the process.
+///
+/// \return The smallest of the differences between the memory limit and the
+/// memory usage of the control group and of its ancestors, or none if none is
+/// limited.
+optional< units::bytes >
+utils::detail::find_cgroup_memory_headroom(const fs::path& root,
+                                           const cgroup_paths_map& paths)
+{
+    const controller_dirs memory = find_controller(root, paths, "memory");
+    const char* limit_name = memory.unified ?
+        "memory.max" : "memory.limit_in_bytes";
+    const char* usage_name = memory.unified ?
+        "memory.current" : "memory.usage_in_bytes";
+
+    optional< int64_t > headroom;
+    for (std::vector< fs::path >::const_iterator iter = memory.dirs.begin();
+         iter != memory.dirs.end(); ++iter) {
+        const optional< int64_t > limit = read_limit(*iter / limit_name);
+        if (!limit)
+            continue;
+        const optional< int64_t > usage = read_limit(*iter / usage_name);
+        if (!usage)
+            continue;
+
+        const int64_t value = limit.get() > usage.get() ?
+            limit.get() - usage.get() : 0;
+        if (!headroom || value < headroom.get())
+            headroom = value;
+    }
+    if (!headroom)
+        return none;
+    return utils::make_optional(units::bytes(headroom.get()));
+}
+
+
+/// Finds the CPU quota of a control group.
+///
+/// \param root Path to the mount point of the control group hierarchies.
+/// \param paths The control groups of the process.
+///
+/// \return The smallest of the CPU quotas of the control group and of its
+/// ancestors, as the number of CPUs whose time the group can consume, or none
+/// if none is limited.
+optional< double >
+utils::detail::find_cgroup_cpu_quota(const fs::path& root,
+                                     const cgroup_paths_map& paths)
+{
+    const controller_dirs cpu = find_controller(root, paths, "cpu");
+
+    optional< double > quota;
+    for (std::vector< fs::path >::const_iterator iter = cpu.dirs.begin();
+         iter != cpu.dirs.end(); ++iter) {
+        optional< int64_t > runtime, period;
+        if (cpu.unified) {
+            const fs::path file = *iter / "cpu.max";
+            const optional< std::string > line = read_first_line(file);
+            if (!line)
+                continue;
+            const std::vector< std::string > fields = text::split(
+                line.get(), ' ');
+            if (fields.size() != 2) {
+                LW(F("Invalid value '%s' in %s") % line.get() % file);
+                continue;
+            }
+            runtime = parse_limit(fields[0], file);
+            period = parse_limit(fields[1], file);
+        } else {
+            runtime = read_limit(*iter / "cpu.cfs_quota_us");
+            period = read_limit(*iter / "cpu.cfs_period_us");
+        }
+        if (!runtime || !period || period.get() == 0)
+            continue;
+
+        const double value = static_cast< double >(runtime.get()) /
+            period.get();
+        if (!quota || value < quota.get())
+            quota = value;
+    }
+    return quota;
+}
+
+
+/// Queries the memory limit of the control group of the current process.
+///
+/// The real query is run only once and the result is cached.  Further calls to
+/// this function will always return the same value.
+///
+/// \return The memory limit, or none if the process is not limited or if the
+/// system does not support control groups.
+optional< units::bytes >
+utils::cgroup_memory_limit(void)
+{
+    static bool queried = false;
+    static optional< units::bytes > limit;
+    if (!queried) {
+        limit = detail::find_cgroup_memory_limit(fs::path(cgroup_root),
+                                                 own_cgroup_paths());
+        if (limit)
+            LI(F("Memory limit of the control group: %s") % limit.get());
+        queried = true;
+    }
+    return limit;
+}
+
+
+/// Queries the memory that the control group of the process can allocate.
+///
+/// Unlike the limits, the usage of the control group changes continuously so
+/// this is not cached.
+///
+/// \return The headroom of the control group, or none if the process is not
+/// limited or if the system does not support control groups.
+optional< units::bytes >
+utils::cgroup_memory_headroom(void)
+{
+    return detail::find_cgroup_memory_headroom(fs::path(cgroup_root),
+                                               own_cgroup_paths());
+}
+
+
+/// Queries the CPU quota of the control group of the current process.
+///
+/// The real query is run only once and the result is cached.  Further calls to
+/// this function will always return the same value.
+///
+/// \return The number of CPUs whose time the process can consume, which may
+/// be fractional, or none if the process is not limited or if the system does
+/// not support control groups.
+optional< double >
+utils::cgroup_cpu_quota(void)
+{
+    static bool queried = false;
+    static optional< double > quota;
+    if (!queried) {
+        quota = detail::find_cgroup_cpu_quota(fs::path(cgroup_root),
+                                              own_cgroup_paths());
+        if (quota)
+            LI(F("CPU quota of the control group: %s CPUs") % quota.get());
+        queried = true;
+    }
+    return quota;
+}
@@ -0,0 +1,79 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// \file utils/cgroup.hpp
+/// Utilities to query the resource limits of the control group of the process.
+///
+/// Processes running within a container usually see the resources of the whole
+/// host while their control group only lets them use a fraction of them.  The
+/// functions in this module expose the limits of the control group so that the
+/// callers can size their work accordingly.  Both the unified hierarchy of
+/// cgroup v2 and the per-controller hierarchies of cgroup v1 are supported.
+
+#if !defined(UTILS_CGROUP_HPP)
+#define UTILS_CGROUP_HPP
+
+#include <istream>
+#include <map>
+#include <string>
+
+#include "utils/fs/path_fwd.hpp"
+#include "utils/optional_fwd.hpp"
+#include "utils/units_fwd.hpp"
+
+namespace utils {
+
+
+optional< units::bytes > cgroup_memory_limit(void);
+optional< units::bytes > cgroup_memory_headroom(void);
+optional< double > cgroup_cpu_quota(void);
+
+
+namespace detail {
+
+
+/// Mapping of controller names to the paths of the process in their hierarchy.
+///
+/// The path in the unified hierarchy of cgroup v2 is keyed by the empty
+/// string.
+typedef std::map< std::string, std::string > cgroup_paths_map;
+
+
+cgroup_paths_map parse_cgroup_paths(std::istream&);
+optional< units::bytes > find_cgroup_memory_limit(const fs::path&,
+                                                  const cgroup_paths_map&);
+optional< units::bytes > find_cgroup_memory_headroom(const fs::path&,
+                                                     const cgroup_paths_map&);
+optional< double > find_cgroup_cpu_quota(const fs::path&,
+                                         const cgroup_paths_map&);
+
+
+}  // namespace detail
+}  // namespace utils
+
+#endif  // !defined(UTILS_CGROUP_HPP)
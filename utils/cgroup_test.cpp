@@ -0,0 +1,298 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "utils/cgroup.hpp"
+
+#include <sstream>
+#include <string>
+
+#include <atf-c++.hpp>
+
+#include "utils/fs/operations.hpp"
+#include "utils/fs/path.hpp"
+#include "utils/optional.ipp"
+#include "utils/units.hpp"
+
+namespace detail = utils::detail;
+namespace fs = utils::fs;
+namespace units = utils::units;
+
+
+namespace {
+
+
+/// Creates a file that exposes a control group value.
+///
+/// \param file The path to the file to create; its directory is created too.
+/// \param contents The contents of the file, without the trailing newline.
+static void
+create_value(const char* file, const std::string& contents)
+{
+    const fs::path path(file);
+    fs::mkdir_p(path.branch_path(), 0755);
+    atf::utils::create_file(path.str(), contents + "\n");
+}
+
+
+/// Builds the control groups of a process that only uses cgroup v2.
+///
+/// \param path The path of the process in the unified hierarchy.
+///
+/// \return The control groups map.
+static detail::cgroup_paths_map
+unified_paths(const std::string& path)
+{
+    detail::cgroup_paths_map paths;
+    paths[""] = path;
+    return paths;
+}
+
+
+}  // anonymous namespace
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(cgroup_memory_limit);
+ATF_TEST_CASE_BODY(cgroup_memory_limit)
+{
+    const utils::optional< units::bytes > limit = utils::cgroup_memory_limit();
+    if (limit)
+        ATF_REQUIRE(limit.get() > 0);
+    ATF_REQUIRE(limit == utils::cgroup_memory_limit());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(cgroup_cpu_quota);
+ATF_TEST_CASE_BODY(cgroup_cpu_quota)
+{
+    const utils::optional< double > quota = utils::cgroup_cpu_quota();
+    if (quota)
+        ATF_REQUIRE(quota.get() >= 0.0);
+    ATF_REQUIRE(quota == utils::cgroup_cpu_quota());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(parse_cgroup_paths__v2);
+ATF_TEST_CASE_BODY(parse_cgroup_paths__v2)
+{
+    std::istringstream input("0::/user.slice/session-1.scope\n");
+    detail::cgroup_paths_map exp_paths;
+    exp_paths[""] = "/user.slice/session-1.scope";
+    ATF_REQUIRE(exp_paths == detail::parse_cgroup_paths(input));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(parse_cgroup_paths__v1);
+ATF_TEST_CASE_BODY(parse_cgroup_paths__v1)
+{
+    std::istringstream input(
+        "12:memory:/docker/abc\n"
+        "4:cpu,cpuacct:/docker/abc\n"
+        "1:name=systemd:/docker/abc\n"
+        "0::/\n");
+    detail::cgroup_paths_map exp_paths;
+    exp_paths["memory"] = "/docker/abc";
+    exp_paths["cpu"] = "/docker/abc";
+    exp_paths["cpuacct"] = "/docker/abc";
+    exp_paths["name=systemd"] = "/docker/abc";
+    exp_paths[""] = "/";
+    ATF_REQUIRE(exp_paths == detail::parse_cgroup_paths(input));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(parse_cgroup_paths__invalid);
+ATF_TEST_CASE_BODY(parse_cgroup_paths__invalid)
+{
+    std::istringstream input("garbage\n4:cpu\n\n");
+    ATF_REQUIRE(detail::parse_cgroup_paths(input).empty());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(find_cgroup_memory_limit__v2);
+ATF_TEST_CASE_BODY(find_cgroup_memory_limit__v2)
+{
+    create_value("root/memory.max", "max");
+    create_value("root/a/memory.max", "2147483648");
+    create_value("root/a/b/memory.max", "max");
+
+    const utils::optional< units::bytes > limit =
+        detail::find_cgroup_memory_limit(fs::path("root"),
+                                         unified_paths("/a/b"));
+    ATF_REQUIRE(limit);
+    ATF_REQUIRE_EQ(2 * units::GB, limit.get());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(find_cgroup_memory_limit__v1);
+ATF_TEST_CASE_BODY(find_cgroup_memory_limit__v1)
+{
+    // The path of the process is that of the host, which the container does not
+    // see, so only the root of the hierarchy is in effect.
+    create_value("root/memory/memory.limit_in_bytes", "1073741824");
+
+    detail::cgroup_paths_map paths;
+    paths["memory"] = "/docker/abc";
+    paths[""] = "/";
+    const utils::optional< units::bytes > limit =
+        detail::find_cgroup_memory_limit(fs::path("root"), paths);
+    ATF_REQUIRE(limit);
+    ATF_REQUIRE_EQ(units::GB, limit.get());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(find_cgroup_memory_limit__unlimited);
+ATF_TEST_CASE_BODY(find_cgroup_memory_limit__unlimited)
+{
+    create_value("root/memory/memory.limit_in_bytes", "9223372036854771712");
+    create_value("root/memory.max", "max");
+
+    detail::cgroup_paths_map paths;
+    paths["memory"] = "/";
+    ATF_REQUIRE(!detail::find_cgroup_memory_limit(fs::path("root"), paths));
+    ATF_REQUIRE(!detail::find_cgroup_memory_limit(fs::path("root"),
+                                                  unified_paths("/")));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(find_cgroup_memory_limit__none);
+ATF_TEST_CASE_BODY(find_cgroup_memory_limit__none)
+{
+    create_value("root/memory.max", "1024");
+    ATF_REQUIRE(!detail::find_cgroup_memory_limit(
+        fs::path("root"), detail::cgroup_paths_map()));
+    ATF_REQUIRE(!detail::find_cgroup_memory_limit(
+        fs::path("missing"), unified_paths("/")));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(find_cgroup_memory_limit__invalid);
+ATF_TEST_CASE_BODY(find_cgroup_memory_limit__invalid)
+{
+    create_value("root/memory.max", "lots");
+    create_value("root/a/memory.max", "4096");
+
+    const utils::optional< units::bytes > limit =
+        detail::find_cgroup_memory_limit(fs::path("root"),
+                                         unified_paths("/a"));
+    ATF_REQUIRE(limit);
+    ATF_REQUIRE_EQ(4 * units::KB, limit.get());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(find_cgroup_memory_headroom);
+ATF_TEST_CASE_BODY(find_cgroup_memory_headroom)
+{
+    create_value("root/memory.max", "10000");
+    create_value("root/memory.current", "7000");
+    create_value("root/a/memory.max", "5000");
+    create_value("root/a/memory.current", "1000");
+
+    const utils::optional< units::bytes > headroom =
+        detail::find_cgroup_memory_headroom(fs::path("root"),
+                                            unified_paths("/a"));
+    ATF_REQUIRE(headroom);
+    ATF_REQUIRE_EQ(3000, headroom.get());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(find_cgroup_memory_headroom__exhausted);
+ATF_TEST_CASE_BODY(find_cgroup_memory_headroom__exhausted)
+{
+    create_value("root/memory/memory.limit_in_bytes", "4096");
+    create_value("root/memory/memory.usage_in_bytes", "8192");
+
+    detail::cgroup_paths_map paths;
+    paths["memory"] = "/";
+    const utils::optional< units::bytes > headroom =
+        detail::find_cgroup_memory_headroom(fs::path("root"), paths);
+    ATF_REQUIRE(headroom);
+    ATF_REQUIRE_EQ(0, headroom.get());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(find_cgroup_cpu_quota__v2);
+ATF_TEST_CASE_BODY(find_cgroup_cpu_quota__v2)
+{
+    create_value("root/cpu.max", "400000 100000");
+    create_value("root/a/cpu.max", "150000 100000");
+    create_value("root/a/b/cpu.max", "max 100000");
+
+    const utils::optional< double > quota = detail::find_cgroup_cpu_quota(
+        fs::path("root"), unified_paths("/a/b"));
+    ATF_REQUIRE(quota);
+    ATF_REQUIRE_EQ(1.5, quota.get());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(find_cgroup_cpu_quota__v1);
+ATF_TEST_CASE_BODY(find_cgroup_cpu_quota__v1)
+{
+    create_value("root/cpu/cpu.cfs_quota_us", "-1");
+    create_value("root/cpu/cpu.cfs_period_us", "100000");
+    create_value("root/cpu/a/cpu.cfs_quota_us", "50000");
+    create_value("root/cpu/a/cpu.cfs_period_us", "100000");
+
+    detail::cgroup_paths_map paths;
+    paths["cpu"] = "/a";
+    paths["cpuacct"] = "/a";
+    const utils::optional< double > quota = detail::find_cgroup_cpu_quota(
+        fs::path("root"), paths);
+    ATF_REQUIRE(quota);
+    ATF_REQUIRE_EQ(0.5, quota.get());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(find_cgroup_cpu_quota__unlimited);
+ATF_TEST_CASE_BODY(find_cgroup_cpu_quota__unlimited)
+{
+    create_value("root/cpu.max", "max 100000");
+    create_value("root/a/cpu.max", "invalid");
+
+    ATF_REQUIRE(!detail::find_cgroup_cpu_quota(fs::path("root"),
+                                               unified_paths("/a")));
+}
+
+
+ATF_INIT_TEST_CASES(tcs)
+{
+    ATF_ADD_TEST_CASE(tcs, cgroup_memory_limit);
+    ATF_ADD_TEST_CASE(tcs, cgroup_cpu_quota);
+
+    ATF_ADD_TEST_CASE(tcs, parse_cgroup_paths__v2);
+    ATF_ADD_TEST_CASE(tcs, parse_cgroup_paths__v1);
+    ATF_ADD_TEST_CASE(tcs, parse_cgroup_paths__invalid);
+    ATF_ADD_TEST_CASE(tcs, find_cgroup_memory_limit__v2);
+    ATF_ADD_TEST_CASE(tcs, find_cgroup_memory_limit__v1);
+    ATF_ADD_TEST_CASE(tcs, find_cgroup_memory_limit__unlimited);
+    ATF_ADD_TEST_CASE(tcs, find_cgroup_memory_limit__none);
+    ATF_ADD_TEST_CASE(tcs, find_cgroup_memory_limit__invalid);
+    ATF_ADD_TEST_CASE(tcs, find_cgroup_memory_headroom);
+    ATF_ADD_TEST_CASE(tcs, find_cgroup_memory_headroom__exhausted);
+    ATF_ADD_TEST_CASE(tcs, find_cgroup_cpu_quota__v2);
+    ATF_ADD_TEST_CASE(tcs, find_cgroup_cpu_quota__v1);
+    ATF_ADD_TEST_CASE(tcs, find_cgroup_cpu_quota__unlimited);
+}
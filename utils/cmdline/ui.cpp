@@ -60,6 +60,25 @@ using utils::none;
 using utils::optional;
 
 
+namespace {
+
+
+/// Checks whether stdout is connected to a terminal.
+///
+/// The result is cached during execution, just like screen_width().
+///
+/// \return True if stdout is a terminal; false otherwise.
+static bool
+stdout_is_tty(void)
+{
+    static const bool is_tty = ::isatty(STDOUT_FILENO) == 1;
+    return is_tty;
+}
+
+
+}  // anonymous namespace
+
+
 /// Destructor for the class.
 cmdline::ui::~ui(void)
 {
@@ -110,6 +129,40 @@ cmdline::ui::out(const std::string& message, const bool newline)
 }
 
 
+/// Writes a batch of lines to stdout.
+///
+/// This is equivalent to calling out() once per line but is meant for commands
+/// that print large amounts of output: the lines are written in one go, the
+/// log only records the batch instead of every line, and the stream is only
+/// flushed when stdout is a terminal so that redirected output is buffered.
+///
+/// \param lines The lines to print.  Should not include trailing newline
+///     characters.
+void
+cmdline::ui::out_lines(const std::vector< std::string >& lines)
+{
+    if (lines.empty())
+        return;
+    LI(F("stdout: %s lines starting with: %s") % lines.size() % lines[0]);
+
+    std::string::size_type length = 0;
+    for (std::vector< std::string >::const_iterator iter = lines.begin();
+         iter != lines.end(); ++iter)
+        length += (*iter).length() + 1;
+
+    std::string buffer;
+    buffer.reserve(length);
+    for (std::vector< std::string >::const_iterator iter = lines.begin();
+         iter != lines.end(); ++iter) {
+        buffer += *iter;
+        buffer += '\n';
+    }
+    std::cout.write(buffer.data(), buffer.length());
+    if (stdout_is_tty())
+        std::cout.flush();
+}
+
+
 /// Queries the width of the screen.
 ///
 /// This information comes first from the COLUMNS environment variable.  If not
@@ -171,11 +224,7 @@ cmdline::ui::out_wrap(const std::string& message)
 {
     const optional< std::size_t > max_width = screen_width();
     if (max_width) {
-        const std::vector< std::string > lines = text::refill(
-            message, max_width.get());
-        for (std::vector< std::string >::const_iterator iter = lines.begin();
-             iter != lines.end(); iter++)
-            out(*iter);
+        out_lines(text::refill(message, max_width.get()));
     } else
         out(message);
 }
@@ -199,13 +248,16 @@ cmdline::ui::out_tag_wrap(const std::string& tag, const std::string& message,
     if (max_width && max_width.get() > tag.length()) {
         const std::vector< std::string > lines = text::refill(
             message, max_width.get() - tag.length());
+        std::vector< std::string > tagged;
         for (std::vector< std::string >::const_iterator iter = lines.begin();
              iter != lines.end(); iter++) {
             if (repeat || iter == lines.begin())
-                out(F("%s%s") % tag % *iter);
+                tagged.push_back(F("%s%s") % tag % *iter);
             else
-                out(F("%s%s") % std::string(tag.length(), ' ') % *iter);
+                tagged.push_back(F("%s%s") % std::string(tag.length(), ' ') %
+                                 *iter);
         }
+        out_lines(tagged);
     } else {
         out(F("%s%s") % tag % message);
     }
@@ -230,10 +282,11 @@ cmdline::ui::out_table(const text::table& table,
     if (max_width)
         formatter.set_table_width(max_width.get() - prefix.length());
 
-    const std::vector< std::string > lines = formatter.format(table);
-    for (std::vector< std::string >::const_iterator iter = lines.begin();
+    std::vector< std::string > lines = formatter.format(table);
+    for (std::vector< std::string >::iterator iter = lines.begin();
          iter != lines.end(); ++iter)
-        out(prefix + *iter);
+        (*iter).insert(0, prefix);
+    out_lines(lines);
 }
 
 
@@ -36,6 +36,7 @@
 
 #include <cstddef>
 #include <string>
+#include <vector>
 
 #include "utils/optional_fwd.hpp"
 #include "utils/text/table_fwd.hpp"
@@ -58,6 +59,7 @@ public:
 
     virtual void err(const std::string&, const bool = true);
     virtual void out(const std::string&, const bool = true);
+    virtual void out_lines(const std::vector< std::string >&);
     virtual optional< std::size_t > screen_width(void) const;
 
     void out_wrap(const std::string&);
@@ -83,6 +83,19 @@ ui_mock::out(const std::string& message, const bool newline)
 }
 
 
+/// Writes a batch of lines to stdout and records them for further inspection.
+///
+/// \param lines The lines to print and record, without the trailing newline
+///     characters.
+void
+ui_mock::out_lines(const std::vector< std::string >& lines)
+{
+    for (std::vector< std::string >::const_iterator iter = lines.begin();
+         iter != lines.end(); ++iter)
+        out(*iter);
+}
+
+
 /// Queries the width of the screen.
 ///
 /// \return Always none, as we do not want to depend on line wrapping in our
@@ -64,6 +64,7 @@ public:
 
     void err(const std::string&, const bool = true);
     void out(const std::string&, const bool = true);
+    void out_lines(const std::vector< std::string >&);
     optional< std::size_t > screen_width(void) const;
 
     const std::vector< std::string >& err_log(void) const;
@@ -45,6 +45,10 @@ extern "C" {
 
 #include <cerrno>
 #include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
 
 #include <atf-c++.hpp>
 
@@ -234,6 +238,41 @@ ATF_TEST_CASE_BODY(ui__out__tolerates_newline)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(ui__out_lines);
+ATF_TEST_CASE_BODY(ui__out_lines)
+{
+    std::vector< std::string > lines;
+    lines.push_back("First line");
+    lines.push_back("");
+    lines.push_back("Third line");
+
+    cmdline::ui_mock ui;
+    ui.out_lines(lines);
+    ATF_REQUIRE(ui.err_log().empty());
+    ATF_REQUIRE(lines == ui.out_log());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(ui__out_lines__real);
+ATF_TEST_CASE_BODY(ui__out_lines__real)
+{
+    std::vector< std::string > lines;
+    lines.push_back("First line");
+    lines.push_back("Second line");
+
+    std::cout.flush();
+    std::streambuf* old_buffer = std::cout.rdbuf();
+    std::ostringstream output;
+    std::cout.rdbuf(output.rdbuf());
+    cmdline::ui ui;
+    ui.out_lines(lines);
+    ui.out_lines(std::vector< std::string >());
+    std::cout.rdbuf(old_buffer);
+
+    ATF_REQUIRE_EQ("First line\nSecond line\n", output.str());
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(ui__out_wrap__no_refill);
 ATF_TEST_CASE_BODY(ui__out_wrap__no_refill)
 {
@@ -408,6 +447,8 @@ ATF_INIT_TEST_CASES(tcs)
     ATF_ADD_TEST_CASE(tcs, ui__err__tolerates_newline);
     ATF_ADD_TEST_CASE(tcs, ui__out);
     ATF_ADD_TEST_CASE(tcs, ui__out__tolerates_newline);
+    ATF_ADD_TEST_CASE(tcs, ui__out_lines);
+    ATF_ADD_TEST_CASE(tcs, ui__out_lines__real);
 
     ATF_ADD_TEST_CASE(tcs, ui__out_wrap__no_refill);
     ATF_ADD_TEST_CASE(tcs, ui__out_wrap__refill);
@@ -28,6 +28,8 @@
 
 #include "utils/config/tree.ipp"
 
+#include <algorithm>
+
 #include "utils/config/exceptions.hpp"
 #include "utils/format/macros.hpp"
 #include "utils/text/operations.hpp"
@@ -58,11 +60,38 @@ utils::config::detail::flatten_key(const tree_key& key)
 utils::config::detail::tree_key
 utils::config::detail::parse_key(const std::string& str)
 {
-    const tree_key key = text::split(str, '.');
-    if (key.empty())
+    if (str.empty())
         throw invalid_key_error("Empty key");
-    for (tree_key::const_iterator iter = key.begin(); iter != key.end(); iter++)
-        if ((*iter).empty())
-            throw invalid_key_error(F("Empty component in key '%s'") % str);
+    // Validate the key before splitting it so that the components are only
+    // copied out of valid keys, into a vector sized to hold them all.
+    if (str[0] == '.' || str[str.length() - 1] == '.' ||
+        str.find("..") != std::string::npos)
+        throw invalid_key_error(F("Empty component in key '%s'") % str);
+
+    tree_key key;
+    key.reserve(std::count(str.begin(), str.end(), '.') + 1);
+    text::split(str, '.', key);
     return key;
 }
+
+
+/// Constructs a new key handle.
+///
+/// \param dotted_key The key to be queried in dotted representation.
+///
+/// \throw invalid_key_error If the key is empty or invalid for any other
+///     reason.
+config::key_handle::key_handle(const std::string& dotted_key) :
+    _key(detail::parse_key(dotted_key)), _node(NULL)
+{
+}
+
+
+/// Gets the tokenized key represented by this handle.
+///
+/// \return The key.
+const config::detail::tree_key&
+config::key_handle::key(void) const
+{
+    return _key;
+}
@@ -36,6 +36,10 @@
 
 #include <string>
 
+#include "utils/config/nodes_fwd.hpp"
+#include "utils/config/tree_fwd.hpp"
+#include "utils/shared_ptr.hpp"
+
 namespace utils {
 namespace config {
 namespace detail {
@@ -46,6 +50,38 @@ tree_key parse_key(const std::string&);
 
 
 }  // namespace detail
+
+
+/// Pre-parsed key to query the same node of a tree repeatedly.
+///
+/// The key is tokenized once at construction time and the handle remembers the
+/// node it resolved to in the last tree it was used with.  Subsequent queries
+/// on that same tree (or on any shallow copy of it) skip both the parsing of
+/// the key and the walk through the inner nodes.  Queries on any other tree
+/// resolve the key again.
+///
+/// Handles are intended to be defined once as constants next to the code that
+/// performs the queries; the remembered node is not part of the observable
+/// state of the handle.
+class key_handle {
+    /// The tokenized key.
+    detail::tree_key _key;
+
+    /// Root of the tree in which _node was resolved.
+    mutable std::weak_ptr< detail::static_inner_node > _root;
+
+    /// Node that the key resolved to within _root, if any.
+    mutable const detail::base_node* _node;
+
+    friend class config::tree;
+
+public:
+    explicit key_handle(const std::string&);
+
+    const detail::tree_key& key(void) const;
+};
+
+
 }  // namespace config
 }  // namespace utils
 
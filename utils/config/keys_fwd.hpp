@@ -45,6 +45,10 @@ typedef std::vector< std::string > tree_key;
 
 
 }  // namespace detail
+
+
+class key_handle;
+
 }  // namespace config
 }  // namespace utils
 
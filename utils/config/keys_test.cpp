@@ -102,6 +102,23 @@ ATF_TEST_CASE_BODY(parse_key__empty_component)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(key_handle__ok);
+ATF_TEST_CASE_BODY(key_handle__ok)
+{
+    const config::key_handle handle("a.b.c");
+    ATF_REQUIRE(config::detail::parse_key("a.b.c") == handle.key());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(key_handle__invalid_key);
+ATF_TEST_CASE_BODY(key_handle__invalid_key)
+{
+    ATF_REQUIRE_THROW_RE(config::invalid_key_error,
+                         "Empty component in key 'a..b'",
+                         config::key_handle("a..b"));
+}
+
+
 ATF_INIT_TEST_CASES(tcs)
 {
     ATF_ADD_TEST_CASE(tcs, flatten_key__one);
@@ -111,4 +128,7 @@ ATF_INIT_TEST_CASES(tcs)
     ATF_ADD_TEST_CASE(tcs, parse_key__many);
     ATF_ADD_TEST_CASE(tcs, parse_key__empty_key);
     ATF_ADD_TEST_CASE(tcs, parse_key__empty_component);
+
+    ATF_ADD_TEST_CASE(tcs, key_handle__ok);
+    ATF_ADD_TEST_CASE(tcs, key_handle__invalid_key);
 }
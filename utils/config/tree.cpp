@@ -61,6 +61,28 @@ config::tree::~tree(void)
 }
 
 
+/// Locates the node addressed by a pre-parsed key.
+///
+/// The node is remembered by the handle so that later queries on this same
+/// tree can skip the walk.  Nodes are never removed from a tree once created,
+/// so the remembered node stays valid for as long as the root is alive.
+///
+/// \param handle The key to locate.
+///
+/// \return The node addressed by the key.
+///
+/// \throw unknown_key_error If the provided key is unknown.
+const config::detail::base_node*
+config::tree::resolve(const key_handle& handle) const
+{
+    if (handle._node == NULL || handle._root.lock() != _root) {
+        handle._node = _root->lookup_ro(handle._key, 0);
+        handle._root = _root;
+    }
+    return handle._node;
+}
+
+
 /// Generates a deep copy of the input tree.
 ///
 /// \return A new tree that is an exact copy of this tree.
@@ -155,6 +177,25 @@ config::tree::is_set(const std::string& dotted_key) const
 }
 
 
+/// Checks if the node addressed by a pre-parsed key is set.
+///
+/// \param handle The key to be checked.
+///
+/// \return True if the key is set to a specific value (not just defined).
+/// False if the key is not set or if the key does not exist.
+bool
+config::tree::is_set(const key_handle& handle) const
+{
+    try {
+        const detail::base_node* raw_node = resolve(handle);
+        const leaf_node* child = dynamic_cast< const leaf_node* >(raw_node);
+        return child != NULL && child->is_set();
+    } catch (const unknown_key_error& unused_error) {
+        return false;
+    }
+}
+
+
 /// Pushes a leaf node's value onto the Lua stack.
 ///
 /// \param dotted_key The key to be pushed.
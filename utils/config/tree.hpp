@@ -86,6 +86,8 @@ class tree {
 
     tree(const bool, detail::static_inner_node*);
 
+    const detail::base_node* resolve(const key_handle&) const;
+
 public:
     tree(const bool = true);
     ~tree(void);
@@ -99,10 +101,13 @@ public:
     void define_dynamic(const std::string&);
 
     bool is_set(const std::string&) const;
+    bool is_set(const key_handle&) const;
 
     template< class LeafType >
     const typename LeafType::value_type& lookup(const std::string&) const;
     template< class LeafType >
+    const typename LeafType::value_type& lookup(const key_handle&) const;
+    template< class LeafType >
     typename LeafType::value_type& lookup_rw(const std::string&);
 
     template< class LeafType >
@@ -92,6 +92,26 @@ config::tree::lookup(const std::string& dotted_key) const
 }
 
 
+/// Gets a read-only reference to the value of a leaf addressed by a handle.
+///
+/// \tparam LeafType The node type of the leaf we are querying.
+/// \param handle The pre-parsed key of the leaf.
+///
+/// \return A reference to the value in the located leaf, if successful.
+///
+/// \throw unknown_key_error If the provided key is unknown.
+template< class LeafType >
+const typename LeafType::value_type&
+config::tree::lookup(const key_handle& handle) const
+{
+    const LeafType* child = dynamic_cast< const LeafType* >(resolve(handle));
+    if (child != NULL && child->is_set())
+        return child->value();
+    else
+        throw unknown_key_error(handle.key());
+}
+
+
 /// Gets a read-write reference to the value of a leaf addressed by its key.
 ///
 /// \tparam LeafType The node type of the leaf we are querying.
@@ -30,6 +30,7 @@
 
 #include <atf-c++.hpp>
 
+#include "utils/config/keys.hpp"
 #include "utils/config/nodes.ipp"
 #include "utils/format/macros.hpp"
 #include "utils/text/operations.ipp"
@@ -446,6 +447,69 @@ ATF_TEST_CASE_BODY(lookup__unknown_key)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(lookup__key_handle);
+ATF_TEST_CASE_BODY(lookup__key_handle)
+{
+    const config::key_handle handle("a.b.c");
+
+    config::tree tree1;
+    tree1.define< config::int_node >("a.b.c");
+    tree1.set< config::int_node >("a.b.c", 123);
+    ATF_REQUIRE_EQ(123, tree1.lookup< config::int_node >(handle));
+
+    const config::tree shallow = tree1;
+    tree1.set< config::int_node >("a.b.c", 456);
+    ATF_REQUIRE_EQ(456, shallow.lookup< config::int_node >(handle));
+
+    config::tree deep = tree1.deep_copy();
+    deep.set< config::int_node >("a.b.c", 789);
+    ATF_REQUIRE_EQ(789, deep.lookup< config::int_node >(handle));
+    ATF_REQUIRE_EQ(456, tree1.lookup< config::int_node >(handle));
+
+    {
+        config::tree tree2;
+        tree2.define_dynamic("a");
+        tree2.set< config::int_node >("a.b.c", 1);
+        ATF_REQUIRE_EQ(1, tree2.lookup< config::int_node >(handle));
+    }
+    config::tree tree3;
+    tree3.define_dynamic("a");
+    tree3.set< config::int_node >("a.b.c", 3);
+    ATF_REQUIRE_EQ(3, tree3.lookup< config::int_node >(handle));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(lookup__key_handle__unknown_key);
+ATF_TEST_CASE_BODY(lookup__key_handle__unknown_key)
+{
+    config::tree tree;
+    tree.define< config::int_node >("a.b.c");
+    tree.define< config::string_node >("a.d");
+    tree.define_dynamic("e");
+
+    ATF_REQUIRE_THROW(config::unknown_key_error,
+                      tree.lookup< config::int_node >(
+                          config::key_handle("a.b.c")));
+    ATF_REQUIRE_THROW(config::unknown_key_error,
+                      tree.lookup< config::int_node >(
+                          config::key_handle("a.b")));
+    ATF_REQUIRE_THROW(config::unknown_key_error,
+                      tree.lookup< config::int_node >(
+                          config::key_handle("a.x")));
+
+    tree.set< config::string_node >("a.d", "foo");
+    ATF_REQUIRE_THROW(config::unknown_key_error,
+                      tree.lookup< config::int_node >(
+                          config::key_handle("a.d")));
+
+    const config::key_handle handle("e.f");
+    ATF_REQUIRE_THROW(config::unknown_key_error,
+                      tree.lookup< config::int_node >(handle));
+    tree.set< config::int_node >("e.f", 5);
+    ATF_REQUIRE_EQ(5, tree.lookup< config::int_node >(handle));
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(is_set__one_level);
 ATF_TEST_CASE_BODY(is_set__one_level)
 {
@@ -492,6 +556,27 @@ ATF_TEST_CASE_BODY(is_set__multiple_levels)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(is_set__key_handle);
+ATF_TEST_CASE_BODY(is_set__key_handle)
+{
+    config::tree tree;
+
+    tree.define< config::int_node >("a.b.var1");
+    tree.define< config::string_node >("a.b.var2");
+
+    const config::key_handle var1("a.b.var1");
+    const config::key_handle var2("a.b.var2");
+    ATF_REQUIRE(!tree.is_set(var1));
+    ATF_REQUIRE(!tree.is_set(var2));
+    ATF_REQUIRE(!tree.is_set(config::key_handle("a.b")));
+    ATF_REQUIRE(!tree.is_set(config::key_handle("a.b.var1.trailing")));
+
+    tree.set< config::int_node >("a.b.var1", 42);
+    ATF_REQUIRE( tree.is_set(var1));
+    ATF_REQUIRE(!tree.is_set(var2));
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(is_set__invalid_key);
 ATF_TEST_CASE_BODY(is_set__invalid_key)
 {
@@ -1043,9 +1128,12 @@ ATF_INIT_TEST_CASES(tcs)
 
     ATF_ADD_TEST_CASE(tcs, lookup__invalid_key);
     ATF_ADD_TEST_CASE(tcs, lookup__unknown_key);
+    ATF_ADD_TEST_CASE(tcs, lookup__key_handle);
+    ATF_ADD_TEST_CASE(tcs, lookup__key_handle__unknown_key);
 
     ATF_ADD_TEST_CASE(tcs, is_set__one_level);
     ATF_ADD_TEST_CASE(tcs, is_set__multiple_levels);
+    ATF_ADD_TEST_CASE(tcs, is_set__key_handle);
     ATF_ADD_TEST_CASE(tcs, is_set__invalid_key);
 
     ATF_ADD_TEST_CASE(tcs, set__invalid_key);
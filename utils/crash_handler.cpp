@@ -0,0 +1,177 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// \file utils/crash_handler.cpp
+/// Preloadable library that records a backtrace when a test program crashes.
+///
+/// This is built as a shared object that the scheduler injects into test
+/// programs via LD_PRELOAD.  When the program receives a fatal signal, the
+/// handler appends a backtrace to the file named by KYUA_CRASH_REPORT and then
+/// lets the signal terminate the program as usual.  Having this report makes
+/// running GDB on a core file unnecessary, so the handler also disables the
+/// core dump once the report is safely written.
+///
+/// The code in this file runs in the context of arbitrary test programs and
+/// within signal handlers, so it must not depend on any other Kyua module and
+/// must stick to async-signal-safe calls.
+
+extern "C" {
+#include <sys/resource.h>
+
+#include <execinfo.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+}
+
+#include <cstdlib>
+#include <cstring>
+
+
+namespace {
+
+
+/// Fatal signals for which to record a backtrace.
+static const int crash_signals[] = {
+    SIGABRT, SIGBUS, SIGFPE, SIGILL, SIGSEGV, SIGSYS, SIGTRAP };
+
+
+/// Maximum number of frames to record.
+static const int max_frames = 128;
+
+
+/// Path to the report file, captured at load time.
+///
+/// We cannot query the environment from within the signal handler, and the
+/// program may have modified it by then anyway.
+static char report_path[4096];
+
+
+/// Writes a string to a file descriptor, ignoring errors.
+///
+/// \param fd The file descriptor to write to.
+/// \param str The string to write.
+static void
+write_string(const int fd, const char* str)
+{
+    std::size_t pending = std::strlen(str);
+    while (pending > 0) {
+        const ssize_t length = ::write(fd, str, pending);
+        if (length <= 0)
+            return;
+        str += length;
+        pending -= length;
+    }
+}
+
+
+/// Writes a non-negative integer to a file descriptor, ignoring errors.
+///
+/// \param fd The file descriptor to write to.
+/// \param value The number to write.
+static void
+write_number(const int fd, int value)
+{
+    char buffer[16];
+    char* pos = buffer + sizeof(buffer) - 1;
+    *pos = '\0';
+    do {
+        *--pos = '0' + value % 10;
+        value /= 10;
+    } while (value > 0 && pos > buffer);
+    write_string(fd, pos);
+}
+
+
+/// Signal handler that records the backtrace of the crashing thread.
+///
+/// The handler is installed with SA_RESETHAND and SA_NODEFER so that raising
+/// the signal again at the end terminates the program with the original
+/// signal, which is what the caller expects to see in the exit status.
+///
+/// \param signo The number of the received signal.
+static void
+crash_handler(const int signo)
+{
+    const int fd = ::open(report_path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (fd != -1) {
+        write_string(fd, "Backtrace of PID ");
+        write_number(fd, ::getpid());
+        write_string(fd, " on signal ");
+        write_number(fd, signo);
+        write_string(fd, ":\n");
+
+        void* frames[max_frames];
+        const int nframes = ::backtrace(frames, max_frames);
+        ::backtrace_symbols_fd(frames, nframes, fd);
+        if (::close(fd) != -1) {
+            // The report is complete so a core file would be redundant.
+            struct ::rlimit rl;
+            rl.rlim_cur = 0;
+            rl.rlim_max = 0;
+            (void)::setrlimit(RLIMIT_CORE, &rl);
+        }
+    }
+
+    ::raise(signo);
+}
+
+
+/// Installs the crash handler when the library is loaded.
+class installer {
+public:
+    /// Captures the report path and programs the signal handlers.
+    installer(void)
+    {
+        const char* path = std::getenv("KYUA_CRASH_REPORT");
+        if (path == NULL || std::strlen(path) >= sizeof(report_path))
+            return;
+        std::strcpy(report_path, path);
+
+        // The first call to backtrace() may need to load the unwinder, which
+        // allocates memory; do it now rather than within the signal handler.
+        void* frame;
+        (void)::backtrace(&frame, 1);
+
+        struct ::sigaction sa;
+        std::memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = crash_handler;
+        sigemptyset(&sa.sa_mask);
+        sa.sa_flags = SA_RESETHAND | SA_NODEFER;
+        for (std::size_t i = 0;
+             i < sizeof(crash_signals) / sizeof(crash_signals[0]); ++i)
+            (void)::sigaction(crash_signals[i], &sa, NULL);
+    }
+};
+
+
+/// Instance whose constructor runs when the library is loaded.
+static installer the_installer;
+
+
+}  // anonymous namespace
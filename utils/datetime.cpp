@@ -38,7 +38,6 @@ extern "C" {
 
 #include "utils/format/macros.hpp"
 #include "utils/optional.ipp"
-#include "utils/noncopyable.hpp"
 #include "utils/sanity.hpp"
 
 namespace datetime = utils::datetime;
@@ -253,33 +252,11 @@ datetime::operator<<(std::ostream& output, const delta& object)
 }
 
 
-namespace utils {
-namespace datetime {
-
-
-/// Internal representation for datetime::timestamp.
-struct timestamp::impl : utils::noncopyable {
-    /// The raw timestamp as provided by libc.
-    ::timeval data;
-
-    /// Constructs an impl object from initialized data.
-    ///
-    /// \param data_ The raw timestamp to use.
-    impl(const ::timeval& data_) : data(data_)
-    {
-    }
-};
-
-
-}  // namespace datetime
-}  // namespace utils
-
-
 /// Constructs a new timestamp.
 ///
-/// \param pimpl_ An existing impl representation.
-datetime::timestamp::timestamp(std::shared_ptr< impl > pimpl_) :
-    _pimpl(pimpl_)
+/// \param useconds_ Microseconds since the epoch in UTC.
+datetime::timestamp::timestamp(const int64_t useconds_) :
+    _useconds(useconds_)
 {
 }
 
@@ -293,10 +270,7 @@ datetime::timestamp
 datetime::timestamp::from_microseconds(const int64_t value)
 {
     PRE(value >= 0);
-    ::timeval data;
-    data.tv_sec = static_cast< time_t >(value / 1000000);
-    data.tv_usec = static_cast< suseconds_t >(value % 1000000);
-    return timestamp(std::shared_ptr< impl >(new impl(data)));
+    return timestamp(value);
 }
 
 
@@ -349,10 +323,8 @@ datetime::timestamp::from_values(const int year, const int month,
     // Ignored: timedata.tm_wday
     // Ignored: timedata.tm_yday
 
-    ::timeval data;
-    data.tv_sec = ::mktime(&timedata);
-    data.tv_usec = static_cast< suseconds_t >(microsecond);
-    return timestamp(std::shared_ptr< impl >(new impl(data)));
+    return timestamp(static_cast< int64_t >(::mktime(&timedata)) * 1000000 +
+                     microsecond);
 }
 
 
@@ -370,8 +342,8 @@ datetime::timestamp::now(void)
         const int ret = ::gettimeofday(&data, NULL);
         INV(ret != -1);
     }
-
-    return timestamp(std::shared_ptr< impl >(new impl(data)));
+    return timestamp(static_cast< int64_t >(data.tv_sec) * 1000000 +
+                     data.tv_usec);
 }
 
 
@@ -387,7 +359,7 @@ datetime::timestamp::strftime(const std::string& format) const
     // This conversion to time_t is necessary because tv_sec is not guaranteed
     // to be a time_t.  For example, it isn't in NetBSD 5.x
     ::time_t epoch_seconds;
-    epoch_seconds = _pimpl->data.tv_sec;
+    epoch_seconds = static_cast< ::time_t >(to_seconds());
     if (::gmtime_r(&epoch_seconds, &timedata) == NULL)
         UNREACHABLE_MSG("gmtime_r(3) did not accept the value returned by "
                         "gettimeofday(2)");
@@ -405,7 +377,8 @@ datetime::timestamp::strftime(const std::string& format) const
 std::string
 datetime::timestamp::to_iso8601_in_utc(void) const
 {
-    return F("%s.%06sZ") % strftime("%Y-%m-%dT%H:%M:%S") % _pimpl->data.tv_usec;
+    return F("%s.%06sZ") % strftime("%Y-%m-%dT%H:%M:%S") %
+        (_useconds % 1000000);
 }
 
 
@@ -415,8 +388,7 @@ datetime::timestamp::to_iso8601_in_utc(void) const
 int64_t
 datetime::timestamp::to_microseconds(void) const
 {
-    return static_cast< int64_t >(_pimpl->data.tv_sec) * 1000000 +
-        _pimpl->data.tv_usec;
+    return _useconds;
 }
 
 
@@ -426,7 +398,7 @@ datetime::timestamp::to_microseconds(void) const
 int64_t
 datetime::timestamp::to_seconds(void) const
 {
-    return static_cast< int64_t >(_pimpl->data.tv_sec);
+    return _useconds / 1000000;
 }
 
 
@@ -460,8 +432,7 @@ datetime::set_mock_now(const timestamp& mock_now_)
 bool
 datetime::timestamp::operator==(const datetime::timestamp& other) const
 {
-    return _pimpl->data.tv_sec == other._pimpl->data.tv_sec &&
-        _pimpl->data.tv_usec == other._pimpl->data.tv_usec;
+    return _useconds == other._useconds;
 }
 
 
@@ -485,7 +456,7 @@ datetime::timestamp::operator!=(const datetime::timestamp& other) const
 bool
 datetime::timestamp::operator<(const datetime::timestamp& other) const
 {
-    return to_microseconds() < other.to_microseconds();
+    return _useconds < other._useconds;
 }
 
 
@@ -498,7 +469,7 @@ datetime::timestamp::operator<(const datetime::timestamp& other) const
 bool
 datetime::timestamp::operator<=(const datetime::timestamp& other) const
 {
-    return to_microseconds() <= other.to_microseconds();
+    return _useconds <= other._useconds;
 }
 
 
@@ -510,7 +481,7 @@ datetime::timestamp::operator<=(const datetime::timestamp& other) const
 bool
 datetime::timestamp::operator>(const datetime::timestamp& other) const
 {
-    return to_microseconds() > other.to_microseconds();
+    return _useconds > other._useconds;
 }
 
 
@@ -523,7 +494,7 @@ datetime::timestamp::operator>(const datetime::timestamp& other) const
 bool
 datetime::timestamp::operator>=(const datetime::timestamp& other) const
 {
-    return to_microseconds() >= other.to_microseconds();
+    return _useconds >= other._useconds;
 }
 
 
@@ -611,3 +582,167 @@ datetime::operator<<(std::ostream& output, const timestamp& object)
 {
     return (output << object.to_microseconds() << "us");
 }
+
+
+/// Constructs a new monotonic time.
+///
+/// \param useconds_ Microseconds since the origin of the monotonic clock.
+datetime::monotonic_time::monotonic_time(const int64_t useconds_) :
+    _useconds(useconds_)
+{
+}
+
+
+/// Queries the current time of the monotonic clock.
+///
+/// If a mock time has been set with set_mock_now(), the monotonic clock
+/// follows it so that durations measured with it are predictable in tests.
+///
+/// \return A new monotonic time.
+datetime::monotonic_time
+datetime::monotonic_time::now(void)
+{
+    if (mock_now)
+        return monotonic_time(mock_now.get().to_microseconds());
+
+#if defined(CLOCK_MONOTONIC)
+    ::timespec data;
+    {
+        const int ret = ::clock_gettime(CLOCK_MONOTONIC, &data);
+        INV(ret != -1);
+    }
+    return monotonic_time(static_cast< int64_t >(data.tv_sec) * 1000000 +
+                          data.tv_nsec / 1000);
+#else
+    return monotonic_time(timestamp::now().to_microseconds());
+#endif
+}
+
+
+/// Returns the number of microseconds since the origin of the clock.
+///
+/// \return A number of microseconds.
+int64_t
+datetime::monotonic_time::to_microseconds(void) const
+{
+    return _useconds;
+}
+
+
+/// Checks if two monotonic times are equal.
+///
+/// \param other The object to compare to.
+///
+/// \return True if the two times are equal; false otherwise.
+bool
+datetime::monotonic_time::operator==(const monotonic_time& other) const
+{
+    return _useconds == other._useconds;
+}
+
+
+/// Checks if two monotonic times are different.
+///
+/// \param other The object to compare to.
+///
+/// \return True if the two times are different; false otherwise.
+bool
+datetime::monotonic_time::operator!=(const monotonic_time& other) const
+{
+    return !(*this == other);
+}
+
+
+/// Checks if a monotonic time is before another.
+///
+/// \param other The object to compare to.
+///
+/// \return True if this time comes before other; false otherwise.
+bool
+datetime::monotonic_time::operator<(const monotonic_time& other) const
+{
+    return _useconds < other._useconds;
+}
+
+
+/// Checks if a monotonic time is before or equal to another.
+///
+/// \param other The object to compare to.
+///
+/// \return True if this time comes before other or is equal to it; false
+/// otherwise.
+bool
+datetime::monotonic_time::operator<=(const monotonic_time& other) const
+{
+    return _useconds <= other._useconds;
+}
+
+
+/// Checks if a monotonic time is after another.
+///
+/// \param other The object to compare to.
+///
+/// \return True if this time comes after other; false otherwise.
+bool
+datetime::monotonic_time::operator>(const monotonic_time& other) const
+{
+    return _useconds > other._useconds;
+}
+
+
+/// Checks if a monotonic time is after or equal to another.
+///
+/// \param other The object to compare to.
+///
+/// \return True if this time comes after other or is equal to it; false
+/// otherwise.
+bool
+datetime::monotonic_time::operator>=(const monotonic_time& other) const
+{
+    return _useconds >= other._useconds;
+}
+
+
+/// Calculates the addition of a delta to a monotonic time.
+///
+/// \param other The delta to add.
+///
+/// \return A new monotonic time in the future.
+datetime::monotonic_time
+datetime::monotonic_time::operator+(const delta& other) const
+{
+    return monotonic_time(_useconds + other.to_microseconds());
+}
+
+
+/// Calculates the delta between two monotonic times.
+///
+/// \param other The subtrahend.
+///
+/// \return The difference between this object and the other object.
+///
+/// \throw std::runtime_error If the subtraction would result in a negative time
+///     delta, which are currently not supported.
+datetime::delta
+datetime::monotonic_time::operator-(const monotonic_time& other) const
+{
+    if ((*this) < other) {
+        throw std::runtime_error(
+            F("Cannot subtract %s from %s as it would result in a negative "
+              "datetime::delta, which are not supported") % other % (*this));
+    }
+    return delta::from_microseconds(_useconds - other._useconds);
+}
+
+
+/// Injects the object into a stream.
+///
+/// \param output The stream into which to inject the object.
+/// \param object The object to format.
+///
+/// \return The output stream.
+std::ostream&
+datetime::operator<<(std::ostream& output, const monotonic_time& object)
+{
+    return (output << object.to_microseconds() << "us");
+}
@@ -42,8 +42,6 @@ extern "C" {
 #include <ostream>
 #include <string>
 
-#include "utils/shared_ptr.hpp"
-
 namespace utils {
 namespace datetime {
 
@@ -87,17 +85,13 @@ std::ostream& operator<<(std::ostream&, const delta&);
 
 /// Represents a fixed date/time.
 ///
-/// Timestamps are immutable objects and therefore we can simply use a shared
-/// pointer to hide the implementation type of the date.  By not using an auto
-/// pointer, we don't have to worry about providing our own copy constructor and
-/// assignment opertor.
+/// Timestamps are plain values holding the microseconds since the epoch, so
+/// they are cheap to create and copy.
 class timestamp {
-    struct impl;
-
-    /// Pointer to the shared internal implementation.
-    std::shared_ptr< impl > _pimpl;
+    /// Microseconds since the epoch in UTC.
+    int64_t _useconds;
 
-    timestamp(std::shared_ptr< impl >);
+    explicit timestamp(const int64_t);
 
 public:
     static timestamp from_microseconds(const int64_t);
@@ -129,6 +123,38 @@ public:
 std::ostream& operator<<(std::ostream&, const timestamp&);
 
 
+/// Represents a point in time of a monotonic clock.
+///
+/// Monotonic times are not tied to the calendar: they are only meaningful when
+/// compared to, or subtracted from, other monotonic times.  Unlike timestamps,
+/// they are not affected by adjustments of the system clock, so they are the
+/// right tool to measure durations and to track deadlines.
+class monotonic_time {
+    /// Microseconds since an arbitrary point in the past.
+    int64_t _useconds;
+
+    explicit monotonic_time(const int64_t);
+
+public:
+    static monotonic_time now(void);
+
+    int64_t to_microseconds(void) const;
+
+    bool operator==(const monotonic_time&) const;
+    bool operator!=(const monotonic_time&) const;
+    bool operator<(const monotonic_time&) const;
+    bool operator<=(const monotonic_time&) const;
+    bool operator>(const monotonic_time&) const;
+    bool operator>=(const monotonic_time&) const;
+
+    monotonic_time operator+(const delta&) const;
+    delta operator-(const monotonic_time&) const;
+};
+
+
+std::ostream& operator<<(std::ostream&, const monotonic_time&);
+
+
 void set_mock_now(const int, const int, const int, const int, const int,
                   const int, const int);
 void set_mock_now(const timestamp&);
@@ -556,6 +556,56 @@ ATF_TEST_CASE_BODY(timestamp__output)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(monotonic_time__now__mock);
+ATF_TEST_CASE_BODY(monotonic_time__now__mock)
+{
+    datetime::set_mock_now(datetime::timestamp::from_microseconds(
+        1291970750123456LL));
+    const datetime::monotonic_time start = datetime::monotonic_time::now();
+    ATF_REQUIRE_EQ(1291970750123456LL, start.to_microseconds());
+
+    datetime::set_mock_now(datetime::timestamp::from_microseconds(
+        1291970752123457LL));
+    ATF_REQUIRE_EQ(datetime::delta(2, 1),
+                   datetime::monotonic_time::now() - start);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(monotonic_time__now__real);
+ATF_TEST_CASE_BODY(monotonic_time__now__real)
+{
+    const datetime::monotonic_time before = datetime::monotonic_time::now();
+    ::usleep(10000);
+    const datetime::monotonic_time after = datetime::monotonic_time::now();
+    ATF_REQUIRE(before < after);
+    ATF_REQUIRE(after - before >= datetime::delta(0, 10000));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(monotonic_time__arithmetic);
+ATF_TEST_CASE_BODY(monotonic_time__arithmetic)
+{
+    datetime::set_mock_now(datetime::timestamp::from_microseconds(1000));
+    const datetime::monotonic_time time1 = datetime::monotonic_time::now();
+    const datetime::monotonic_time time2 = time1 + datetime::delta(1, 5);
+
+    ATF_REQUIRE(time1 == time1);
+    ATF_REQUIRE(time1 != time2);
+    ATF_REQUIRE(time1 < time2);
+    ATF_REQUIRE(time1 <= time1);
+    ATF_REQUIRE(time2 > time1);
+    ATF_REQUIRE(time2 >= time2);
+    ATF_REQUIRE_EQ(1001005, time2.to_microseconds());
+
+    ATF_REQUIRE_EQ(datetime::delta(0, 0), time1 - time1);
+    ATF_REQUIRE_EQ(datetime::delta(1, 5), time2 - time1);
+    ATF_REQUIRE_THROW_RE(
+        std::runtime_error,
+        "Cannot subtract 1001005us from 1000us .*negative datetime::delta",
+        time1 - time2);
+}
+
+
 ATF_INIT_TEST_CASES(tcs)
 {
     ATF_ADD_TEST_CASE(tcs, delta__defaults);
@@ -590,4 +640,8 @@ ATF_INIT_TEST_CASES(tcs)
     ATF_ADD_TEST_CASE(tcs, timestamp__subtract_delta_and_set);
     ATF_ADD_TEST_CASE(tcs, timestamp__subtraction);
     ATF_ADD_TEST_CASE(tcs, timestamp__output);
+
+    ATF_ADD_TEST_CASE(tcs, monotonic_time__now__mock);
+    ATF_ADD_TEST_CASE(tcs, monotonic_time__now__real);
+    ATF_ADD_TEST_CASE(tcs, monotonic_time__arithmetic);
 }
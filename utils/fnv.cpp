@@ -0,0 +1,91 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "utils/fnv.hpp"
+
+#include <iomanip>
+#include <sstream>
+
+
+namespace {
+
+
+/// Prime by which the 64-bit FNV-1a hash is multiplied on every byte.
+static const uint64_t fnv1a64_prime = 1099511628211ULL;
+
+
+}  // anonymous namespace
+
+
+/// Updates a 64-bit FNV-1a hash with a chunk of data.
+///
+/// This does not allocate memory and is async-signal-safe.
+///
+/// \param hash The hash of the data preceding this chunk; fnv1a64_basis if
+///     this is the first chunk.
+/// \param data The chunk of data to account for.
+/// \param length The length of data in bytes.
+///
+/// \return The updated hash.
+uint64_t
+utils::fnv1a64_update(uint64_t hash, const void* data,
+                      const std::size_t length)
+{
+    const unsigned char* bytes = static_cast< const unsigned char* >(data);
+    for (std::size_t i = 0; i < length; ++i) {
+        hash ^= bytes[i];
+        hash *= fnv1a64_prime;
+    }
+    return hash;
+}
+
+
+/// Computes the 64-bit FNV-1a hash of a string.
+///
+/// \param data The string to hash.
+///
+/// \return The hash of the string.
+uint64_t
+utils::fnv1a64(const std::string& data)
+{
+    return fnv1a64_update(fnv1a64_basis, data.data(), data.length());
+}
+
+
+/// Formats a 64-bit hash as a fixed-width hexadecimal string.
+///
+/// \param hash The hash to format.
+///
+/// \return The 16 lowercase hexadecimal digits of the hash.
+std::string
+utils::fnv1a64_hex(const uint64_t hash)
+{
+    std::ostringstream output;
+    output << std::hex << std::setw(16) << std::setfill('0') << hash;
+    return output.str();
+}
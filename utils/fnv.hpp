@@ -0,0 +1,61 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// \file utils/fnv.hpp
+/// Implementation of the 64-bit FNV-1a hash function.
+///
+/// FNV-1a is not cryptographically secure, but it is cheap to compute and,
+/// unlike std::hash-like facilities, yields the same values on every machine
+/// and across runs.  This makes it suitable to derive the names of cache
+/// entries and to detect changes in data that is stored persistently.
+
+#if !defined(UTILS_FNV_HPP)
+#define UTILS_FNV_HPP
+
+extern "C" {
+#include <stdint.h>
+}
+
+#include <cstddef>
+#include <string>
+
+namespace utils {
+
+
+/// Initial value of a 64-bit FNV-1a hash.
+const uint64_t fnv1a64_basis = 14695981039346656037ULL;
+
+
+uint64_t fnv1a64_update(uint64_t, const void*, const std::size_t);
+uint64_t fnv1a64(const std::string&);
+std::string fnv1a64_hex(const uint64_t);
+
+
+}  // namespace utils
+
+#endif  // !defined(UTILS_FNV_HPP)
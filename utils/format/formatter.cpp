@@ -28,7 +28,6 @@
 
 #include "utils/format/formatter.hpp"
 
-#include <memory>
 #include <string>
 #include <utility>
 
@@ -44,6 +43,10 @@ namespace text = utils::text;
 namespace {
 
 
+/// Size of a buffer large enough to hold any formatted integer.
+const std::size_t integer_buffer_size = 32;
+
+
 /// Finds the next placeholder in a string.
 ///
 /// \param format The original format string provided by the user; needed for
@@ -55,13 +58,13 @@ namespace {
 ///     placeholder.
 ///
 /// \return The position in the string in which the placeholder is located and
-/// the placeholder itself.  If there are no placeholders left, this returns
-/// the length of the string and an empty string.
+/// the length of the placeholder.  If there are no placeholders left, this
+/// returns the length of the string and 0.
 ///
 /// \throw bad_format_error If the input string contains a trailing formatting
 ///     character.  We cannot detect any other kind of invalid formatter because
 ///     we do not implement a full parser for them.
-static std::pair< std::string::size_type, std::string >
+static std::pair< std::string::size_type, std::string::size_type >
 find_next_placeholder(const std::string& format,
                       const std::string& expansion,
                       std::string::size_type begin)
@@ -70,19 +73,18 @@ find_next_placeholder(const std::string& format,
     while (begin != std::string::npos && expansion[begin + 1] == '%')
         begin = expansion.find('%', begin + 2);
     if (begin == std::string::npos)
-        return std::make_pair(expansion.length(), "");
+        return std::make_pair(expansion.length(), 0);
     if (begin == expansion.length() - 1)
         throw format::bad_format_error(format, "Trailing %");
 
     std::string::size_type end = begin + 1;
     while (end < expansion.length() && expansion[end] != 's')
         end++;
-    const std::string placeholder = expansion.substr(begin, end - begin + 1);
-    if (end == expansion.length() ||
-        placeholder.find('%', 1) != std::string::npos)
+    const std::string::size_type length = end - begin + 1;
+    if (end == expansion.length() || expansion.find('%', begin + 1) < end)
         throw format::bad_format_error(format, "Unterminated placeholder '" +
-                                       placeholder + "'");
-    return std::make_pair(begin, placeholder);
+                                       expansion.substr(begin, length) + "'");
+    return std::make_pair(begin, length);
 }
 
 
@@ -106,72 +108,63 @@ to_int(const std::string& format, const std::string& str, const char* what)
 }
 
 
-/// Constructs an std::ostringstream based on a formatting placeholder.
-///
-/// \param format The format placeholder; may be empty.
+/// Replaces '%%' by '%' in a given string range.
 ///
-/// \return A new std::ostringstream that is prepared to format a single
-/// object in the manner specified by the format placeholder.
+/// \param in The string to be rewritten in place.
+/// \param begin The position at which to start the replacement.
+/// \param end The position at which to end the replacement.  Any '%' in the
+///     range must be part of a '%%' pair.
 ///
-/// \throw bad_format_error If the format string is bad.  We do minimal
-///     validation on this string though.
-static std::ostringstream*
-new_ostringstream(const std::string& format)
+/// \return The amount of characters removed.
+static std::string::size_type
+strip_double_percent(std::string& in, const std::string::size_type begin,
+                     const std::string::size_type end)
 {
-    std::auto_ptr< std::ostringstream > output(new std::ostringstream());
-
-    if (format.length() <= 2) {
-        // If the format is empty, we create a new stream so that we don't have
-        // to check for NULLs later on.  We rarely should hit this condition
-        // (and when we do it's a bug in the caller), so this is not a big deal.
-        //
-        // Otherwise, if the format is a regular '%s', then we don't have to do
-        // any processing for additional formatters.  So this is just a "fast
-        // path".
-    } else {
-        std::string partial = format.substr(1, format.length() - 2);
-        if (partial[0] == '0') {
-            output->fill('0');
-            partial.erase(0, 1);
-        }
-        if (!partial.empty()) {
-            const std::string::size_type dot = partial.find('.');
-            if (dot != 0)
-                output->width(to_int(format, partial.substr(0, dot), "width"));
-            if (dot != std::string::npos) {
-                output->setf(std::ios::fixed, std::ios::floatfield);
-                output->precision(to_int(format, partial.substr(dot + 1),
-                                         "precision"));
-            }
-        }
+    std::string::size_type out = begin;
+    for (std::string::size_type pos = begin; pos < end; ++pos) {
+        in[out++] = in[pos];
+        if (in[pos] == '%')
+            ++pos;
     }
-
-    return output.release();
+    in.erase(out, end - out);
+    return end - out;
 }
 
 
-/// Replaces '%%' by '%' in a given string range.
+/// Formats an unsigned integer in decimal.
 ///
-/// \param in The input string to be rewritten.
-/// \param begin The position at which to start the replacement.
-/// \param end The position at which to end the replacement.
+/// \param value The integer to format.
+/// \param end Pointer to the end of the buffer in which to store the digits,
+///     which are written backwards.
 ///
-/// \return The modified string and the amount of characters removed.
-static std::pair< std::string, int >
-strip_double_percent(const std::string& in, const std::string::size_type begin,
-                     std::string::size_type end)
+/// \return A pointer to the first digit.
+static char*
+format_unsigned(unsigned long long value, char* end)
 {
-    std::string part = in.substr(begin, end - begin);
-
-    int removed = 0;
-    std::string::size_type pos = part.find("%%");
-    while (pos != std::string::npos) {
-        part.erase(pos, 1);
-        ++removed;
-        pos = part.find("%%", pos + 1);
-    }
+    do {
+        *--end = static_cast< char >('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+    return end;
+}
 
-    return std::make_pair(in.substr(0, begin) + part + in.substr(end), removed);
+
+/// Formats a signed integer in decimal.
+///
+/// \param value The integer to format.
+/// \param end Pointer to the end of the buffer in which to store the digits,
+///     which are written backwards.
+///
+/// \return A pointer to the first character of the number.
+static char*
+format_signed(const long long value, char* end)
+{
+    if (value >= 0)
+        return format_unsigned(static_cast< unsigned long long >(value), end);
+    char* begin = format_unsigned(
+        0ULL - static_cast< unsigned long long >(value), end);
+    *--begin = '-';
+    return begin;
 }
 
 
@@ -180,41 +173,59 @@ strip_double_percent(const std::string& in, const std::string::size_type begin,
 
 /// Performs internal initialization of the formatter.
 ///
-/// This is separate from the constructor just because it is shared by different
-/// overloaded constructors.
+/// Locates the next placeholder starting at _last_pos, strips any '%%' that
+/// precede it and parses its modifiers.  This is separate from the constructor
+/// just because it is shared by different code paths.
 void
 format::formatter::init(void)
 {
-    const std::pair< std::string::size_type, std::string > placeholder =
-        find_next_placeholder(_format, _expansion, _last_pos);
-    const std::pair< std::string, int > no_percents =
-        strip_double_percent(_expansion, _last_pos, placeholder.first);
-
-    _oss = new_ostringstream(placeholder.second);
-
-    _expansion = no_percents.first;
-    _placeholder_pos = placeholder.first - no_percents.second;
-    _placeholder = placeholder.second;
+    const std::pair< std::string::size_type, std::string::size_type >
+        placeholder = find_next_placeholder(_format, _expansion, _last_pos);
+    const std::string::size_type removed = strip_double_percent(
+        _expansion, _last_pos, placeholder.first);
+
+    _placeholder_pos = placeholder.first - removed;
+    _placeholder_length = placeholder.second;
+    _fill = ' ';
+    _width = 0;
+    _precision = -1;
+
+    if (_placeholder_length > 2) {
+        // A regular '%s' does not need any further processing, so this is
+        // only done for placeholders with modifiers.
+        const std::string format = _expansion.substr(_placeholder_pos,
+                                                     _placeholder_length);
+        std::string partial = format.substr(1, format.length() - 2);
+        if (partial[0] == '0') {
+            _fill = '0';
+            partial.erase(0, 1);
+        }
+        if (!partial.empty()) {
+            const std::string::size_type dot = partial.find('.');
+            if (dot != 0)
+                _width = to_int(format, partial.substr(0, dot), "width");
+            if (dot != std::string::npos)
+                _precision = to_int(format, partial.substr(dot + 1),
+                                    "precision");
+        }
+    }
 }
 
 
 /// Constructs a new formatter object (internal).
 ///
+/// The caller is responsible for filling in the expansion and calling init().
+///
 /// \param format The format string.
-/// \param expansion The format string with any replacements performed so far.
 /// \param last_pos The position from which to start looking for formatting
 ///     placeholders.  This must be maintained in case one of the replacements
 ///     introduced a new placeholder, which must be ignored.  Think, for
 ///     example, replacing a "%s" string with "foo %s".
 format::formatter::formatter(const std::string& format,
-                             const std::string& expansion,
                              const std::string::size_type last_pos) :
     _format(format),
-    _expansion(expansion),
-    _last_pos(last_pos),
-    _oss(NULL)
+    _last_pos(last_pos)
 {
-    init();
 }
 
 
@@ -226,19 +237,12 @@ format::formatter::formatter(const std::string& format,
 format::formatter::formatter(const std::string& format) :
     _format(format),
     _expansion(format),
-    _last_pos(0),
-    _oss(NULL)
+    _last_pos(0)
 {
     init();
 }
 
 
-format::formatter::~formatter(void)
-{
-    delete _oss;
-}
-
-
 /// Returns the formatted string.
 const std::string&
 format::formatter::str(void) const
@@ -265,14 +269,155 @@ format::formatter::operator const std::string&(void) const
 format::formatter
 format::formatter::operator%(const bool& value) const
 {
-    (*_oss) << (value ? "true" : "false");
-    return replace(_oss->str());
+    return value ? replace_padded("true", 4) : replace_padded("false", 5);
+}
+
+
+/// Specialization of operator% for characters.
+///
+/// \param value The character to inject into the format string.
+///
+/// \return A new formatter that has one less format placeholder.
+format::formatter
+format::formatter::operator%(const char& value) const
+{
+    return replace_padded(&value, 1);
+}
+
+
+/// Specialization of operator% for C strings.
+///
+/// \param value The string to inject into the format string.
+///
+/// \return A new formatter that has one less format placeholder.
+format::formatter
+format::formatter::operator%(const char* const& value) const
+{
+    return replace_padded(value, std::char_traits< char >::length(value));
+}
+
+
+/// Specialization of operator% for strings.
+///
+/// \param value The string to inject into the format string.
+///
+/// \return A new formatter that has one less format placeholder.
+format::formatter
+format::formatter::operator%(const std::string& value) const
+{
+    return replace_padded(value.c_str(), value.length());
+}
+
+
+/// Specialization of operator% for integers.
+///
+/// \param value The integer to inject into the format string.
+///
+/// \return A new formatter that has one less format placeholder.
+format::formatter
+format::formatter::operator%(const int& value) const
+{
+    char buffer[integer_buffer_size];
+    char* end = buffer + sizeof(buffer);
+    const char* begin = format_signed(value, end);
+    return replace_padded(begin, end - begin);
+}
+
+
+/// Specialization of operator% for long integers.
+///
+/// \param value The integer to inject into the format string.
+///
+/// \return A new formatter that has one less format placeholder.
+format::formatter
+format::formatter::operator%(const long& value) const
+{
+    char buffer[integer_buffer_size];
+    char* end = buffer + sizeof(buffer);
+    const char* begin = format_signed(value, end);
+    return replace_padded(begin, end - begin);
+}
+
+
+/// Specialization of operator% for long long integers.
+///
+/// \param value The integer to inject into the format string.
+///
+/// \return A new formatter that has one less format placeholder.
+format::formatter
+format::formatter::operator%(const long long& value) const
+{
+    char buffer[integer_buffer_size];
+    char* end = buffer + sizeof(buffer);
+    const char* begin = format_signed(value, end);
+    return replace_padded(begin, end - begin);
+}
+
+
+/// Specialization of operator% for unsigned integers.
+///
+/// \param value The integer to inject into the format string.
+///
+/// \return A new formatter that has one less format placeholder.
+format::formatter
+format::formatter::operator%(const unsigned int& value) const
+{
+    char buffer[integer_buffer_size];
+    char* end = buffer + sizeof(buffer);
+    const char* begin = format_unsigned(value, end);
+    return replace_padded(begin, end - begin);
+}
+
+
+/// Specialization of operator% for unsigned long integers.
+///
+/// \param value The integer to inject into the format string.
+///
+/// \return A new formatter that has one less format placeholder.
+format::formatter
+format::formatter::operator%(const unsigned long& value) const
+{
+    char buffer[integer_buffer_size];
+    char* end = buffer + sizeof(buffer);
+    const char* begin = format_unsigned(value, end);
+    return replace_padded(begin, end - begin);
+}
+
+
+/// Specialization of operator% for unsigned long long integers.
+///
+/// \param value The integer to inject into the format string.
+///
+/// \return A new formatter that has one less format placeholder.
+format::formatter
+format::formatter::operator%(const unsigned long long& value) const
+{
+    char buffer[integer_buffer_size];
+    char* end = buffer + sizeof(buffer);
+    const char* begin = format_unsigned(value, end);
+    return replace_padded(begin, end - begin);
+}
+
+
+/// Configures a stream to format an argument for the current placeholder.
+///
+/// \param output The stream to configure.
+void
+format::formatter::prepare(std::ostream& output) const
+{
+    output.fill(_fill);
+    output.width(_width);
+    if (_precision != -1) {
+        output.setf(std::ios::fixed, std::ios::floatfield);
+        output.precision(_precision);
+    }
 }
 
 
 /// Replaces the first formatting placeholder with a value.
 ///
-/// \param arg The replacement string.
+/// \param arg The replacement string, which need not be nul-terminated.
+/// \param length The length of arg.
 ///
 /// \return A new formatter in which the first formatting placeholder has been
 ///     replaced by arg and is ready to replace the next item.
@@ -280,12 +425,43 @@ format::formatter::operator%(const bool& value) const
 /// \throw utils::format::extra_args_error If there are no more formatting
 ///     placeholders in the input string, or if the placeholder is invalid.
 format::formatter
-format::formatter::replace(const std::string& arg) const
+format::formatter::replace(const char* arg,
+                           const std::string::size_type length) const
 {
     if (_placeholder_pos == _expansion.length())
-        throw format::extra_args_error(_format, arg);
+        throw format::extra_args_error(_format, std::string(arg, length));
+
+    formatter result(_format, _placeholder_pos + length);
+    result._expansion.reserve(_expansion.length() - _placeholder_length +
+                              length);
+    result._expansion.append(_expansion, 0, _placeholder_pos);
+    result._expansion.append(arg, length);
+    result._expansion.append(_expansion,
+                             _placeholder_pos + _placeholder_length,
+                             std::string::npos);
+    result.init();
+    return result;
+}
+
+
+/// Replaces the first formatting placeholder with a value and its padding.
+///
+/// This is the equivalent of formatting arg through a stream configured by
+/// prepare(), for the types that know how to render themselves directly.
+///
+/// \param arg The replacement string, which need not be nul-terminated.
+/// \param length The length of arg.
+///
+/// \return A new formatter in which the first formatting placeholder has been
+///     replaced by arg and is ready to replace the next item.
+format::formatter
+format::formatter::replace_padded(const char* arg,
+                                  const std::string::size_type length) const
+{
+    if (_width <= 0 || static_cast< std::string::size_type >(_width) <= length)
+        return replace(arg, length);
 
-    const std::string expansion = _expansion.substr(0, _placeholder_pos)
-        + arg + _expansion.substr(_placeholder_pos + _placeholder.length());
-    return formatter(_format, expansion, _placeholder_pos + arg.length());
+    std::string padded(_width - length, _fill);
+    padded.append(arg, length);
+    return replace(padded.c_str(), padded.length());
 }
@@ -48,7 +48,7 @@
 
 #include "utils/format/formatter_fwd.hpp"
 
-#include <sstream>
+#include <ostream>
 #include <string>
 
 namespace utils {
@@ -62,6 +62,9 @@ namespace format {
 /// formatter instance, but calls to operator% return new formatter objects with
 /// one less formatting placeholder.
 ///
+/// Strings, booleans, characters and integers are appended directly to the new
+/// expansion.  Any other type is formatted through a temporary stream.
+///
 /// In general, one can format a string in the following manner:
 ///
 /// \code
@@ -92,27 +95,42 @@ class formatter {
     /// The position of the first placeholder in the current expansion.
     std::string::size_type _placeholder_pos;
 
-    /// The first placeholder in the current expansion.
-    std::string _placeholder;
+    /// The length of the first placeholder in the current expansion.
+    std::string::size_type _placeholder_length;
+
+    /// The padding character of the first placeholder.
+    char _fill;
 
-    /// Stream used to format any possible argument supplied by operator%().
-    std::ostringstream* _oss;
+    /// The width of the first placeholder, or 0 if unspecified.
+    int _width;
 
-    formatter replace(const std::string&) const;
+    /// The precision of the first placeholder, or -1 if unspecified.
+    int _precision;
 
     void init(void);
-    formatter(const std::string&, const std::string&,
-              const std::string::size_type);
+    void prepare(std::ostream&) const;
+    formatter replace(const char*, const std::string::size_type) const;
+    formatter replace_padded(const char*, const std::string::size_type) const;
+
+    formatter(const std::string&, const std::string::size_type);
 
 public:
     explicit formatter(const std::string&);
-    ~formatter(void);
 
     const std::string& str(void) const;
     operator const std::string&(void) const;
 
     template< typename Type > formatter operator%(const Type&) const;
     formatter operator%(const bool&) const;
+    formatter operator%(const char&) const;
+    formatter operator%(const char* const&) const;
+    formatter operator%(const std::string&) const;
+    formatter operator%(const int&) const;
+    formatter operator%(const long&) const;
+    formatter operator%(const long long&) const;
+    formatter operator%(const unsigned int&) const;
+    formatter operator%(const unsigned long&) const;
+    formatter operator%(const unsigned long long&) const;
 };
 
 
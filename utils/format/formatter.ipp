@@ -30,6 +30,7 @@
 #define UTILS_FORMAT_FORMATTER_IPP
 
 #include <ostream>
+#include <sstream>
 
 #include "utils/format/formatter.hpp"
 
@@ -51,8 +52,11 @@ template< typename Type >
 inline formatter
 formatter::operator%(const Type& arg) const
 {
-    (*_oss) << arg;
-    return replace(_oss->str());
+    std::ostringstream output;
+    prepare(output);
+    output << arg;
+    const std::string text = output.str();
+    return replace(text.c_str(), text.length());
 }
 
 
@@ -0,0 +1,113 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// \file utils/format/formatter_bench.cpp
+/// Benchmarks for format::formatter, which backs the F() macro.
+
+#include "utils/format/formatter.hpp"
+
+#include <cstddef>
+#include <string>
+
+#include <atf-c++.hpp>
+
+#include "utils/datetime.hpp"
+#include "utils/format/macros.hpp"
+#include "utils/test_utils.ipp"
+
+namespace datetime = utils::datetime;
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(format__strings);
+ATF_TEST_CASE_BODY(format__strings)
+{
+    utils::require_run_benchmarks(this);
+    const std::size_t iterations = utils::benchmark_iterations(this, 100000);
+
+    const std::string name = "some_test_program";
+    std::size_t bytes = 0;
+    const datetime::timestamp start = datetime::timestamp::now();
+    for (std::size_t i = 0; i < iterations; ++i) {
+        const std::string text = F("Running %s:%s") % name % "main";
+        bytes += text.length();
+    }
+    utils::report_benchmark(this, iterations,
+                            datetime::timestamp::now() - start);
+
+    ATF_REQUIRE_EQ(iterations * 30, bytes);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(format__integers);
+ATF_TEST_CASE_BODY(format__integers)
+{
+    utils::require_run_benchmarks(this);
+    const std::size_t iterations = utils::benchmark_iterations(this, 100000);
+
+    std::size_t bytes = 0;
+    const datetime::timestamp start = datetime::timestamp::now();
+    for (std::size_t i = 0; i < iterations; ++i) {
+        const std::string text = F("%s/%s") % (i % 10) % (i % 10);
+        bytes += text.length();
+    }
+    utils::report_benchmark(this, iterations,
+                            datetime::timestamp::now() - start);
+
+    ATF_REQUIRE_EQ(iterations * 3, bytes);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(format__log_line);
+ATF_TEST_CASE_BODY(format__log_line)
+{
+    utils::require_run_benchmarks(this);
+    const std::size_t iterations = utils::benchmark_iterations(this, 100000);
+
+    std::size_t bytes = 0;
+    const datetime::timestamp start = datetime::timestamp::now();
+    for (std::size_t i = 0; i < iterations; ++i) {
+        // Mimics the message composed by every call to LD().
+        const std::string message = F("Spawned test with PID %s") % 12345;
+        const std::string text = F("%s %s %s %s:%s: %s") %
+            "20150101-000000" % 'D' % 54321 % "engine/scheduler.cpp" % 1024 %
+            message;
+        bytes += text.length();
+    }
+    utils::report_benchmark(this, iterations,
+                            datetime::timestamp::now() - start);
+
+    ATF_REQUIRE(bytes > 0);
+}
+
+
+ATF_INIT_TEST_CASES(tcs)
+{
+    ATF_ADD_TEST_CASE(tcs, format__strings);
+    ATF_ADD_TEST_CASE(tcs, format__integers);
+    ATF_ADD_TEST_CASE(tcs, format__log_line);
+}
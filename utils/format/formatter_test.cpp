@@ -28,7 +28,9 @@
 
 #include "utils/format/formatter.hpp"
 
+#include <limits>
 #include <ostream>
+#include <string>
 
 #include <atf-c++.hpp>
 
@@ -185,6 +187,7 @@ ATF_TEST_CASE_BODY(format__bool)
 {
     EQ("true", F("%s") % true);
     EQ("false", F("%s") % false);
+    EQ("  true", F("%6s") % true);
 }
 
 
@@ -192,6 +195,7 @@ ATF_TEST_CASE_WITHOUT_HEAD(format__char);
 ATF_TEST_CASE_BODY(format__char)
 {
     EQ("Z", F("%s") % 'Z');
+    EQ("  Z", F("%3s") % 'Z');
 }
 
 
@@ -213,6 +217,38 @@ ATF_TEST_CASE_BODY(format__int)
     EQ("3", F("%0s") % 3);
     EQ(" -123", F("%5s") % -123);
     EQ("00078", F("%05s") % 78);
+    EQ("00-12", F("%05s") % -12);
+    EQ("78", F("%1.3s") % 78);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(format__int_types);
+ATF_TEST_CASE_BODY(format__int_types)
+{
+    EQ("-1 -2 -3", F("%s %s %s") % -1 % -2L % -3LL);
+    EQ("1 2 3", F("%s %s %s") % 1U % 2UL % 3ULL);
+    EQ("0", F("%s") % 0UL);
+
+    EQ("-2147483648", F("%s") % std::numeric_limits< int >::min());
+    EQ("4294967295", F("%s") % std::numeric_limits< unsigned int >::max());
+    EQ("-9223372036854775808",
+       F("%s") % std::numeric_limits< long long >::min());
+    EQ("18446744073709551615",
+       F("%s") % std::numeric_limits< unsigned long long >::max());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(format__string);
+ATF_TEST_CASE_BODY(format__string)
+{
+    EQ("  foo", F("%5s") % "foo");
+    EQ("foo", F("%2s") % "foo");
+    EQ("foo", F("%.1s") % "foo");
+    EQ("00bar", F("%05s") % std::string("bar"));
+
+    const char* pointer = "baz";
+    EQ("[baz]", F("[%s]") % pointer);
+    EQ(std::string("[a\0b]", 5), F("[%s]") % std::string("a\0b", 3));
 }
 
 
@@ -261,5 +297,7 @@ ATF_INIT_TEST_CASES(tcs)
     ATF_ADD_TEST_CASE(tcs, format__char);
     ATF_ADD_TEST_CASE(tcs, format__float);
     ATF_ADD_TEST_CASE(tcs, format__int);
+    ATF_ADD_TEST_CASE(tcs, format__int_types);
+    ATF_ADD_TEST_CASE(tcs, format__string);
     ATF_ADD_TEST_CASE(tcs, format__error);
 }
@@ -37,6 +37,7 @@ extern "C" {
 #include <cerrno>
 #include <memory>
 
+#include "utils/defs.hpp"
 #include "utils/format/macros.hpp"
 #include "utils/fs/exceptions.hpp"
 #include "utils/fs/path.hpp"
@@ -49,10 +50,47 @@ namespace fs = utils::fs;
 namespace text = utils::text;
 
 
+namespace {
+
+
+/// Converts the type of a raw directory entry to our representation.
+///
+/// \param de The raw directory entry.
+///
+/// \return The type of the entry, or entry_type_unknown if the system did not
+/// report it.
+#if defined(DT_UNKNOWN)
+static fs::entry_type
+to_entry_type(const ::dirent& de)
+{
+    switch (de.d_type) {
+    case DT_UNKNOWN: return fs::entry_type_unknown;
+    case DT_DIR: return fs::entry_type_directory;
+    case DT_LNK: return fs::entry_type_symlink;
+    case DT_REG: return fs::entry_type_regular;
+    default: return fs::entry_type_other;
+    }
+}
+#else
+static fs::entry_type
+to_entry_type(const ::dirent& UTILS_UNUSED_PARAM(de))
+{
+    return fs::entry_type_unknown;
+}
+#endif
+
+
+}  // anonymous namespace
+
+
 /// Constructs a new directory entry.
 ///
 /// \param name_ Name of the directory entry.
-fs::directory_entry::directory_entry(const std::string& name_) : name(name_)
+/// \param type_ Type of the directory entry, if known.
+fs::directory_entry::directory_entry(const std::string& name_,
+                                     const entry_type type_) :
+    name(name_),
+    type(type_)
 {
 }
 
@@ -206,8 +244,15 @@ struct utils::fs::detail::directory_iterator::impl : utils::noncopyable {
         if (result == NULL) {
             _entry.reset(NULL);
             close();
+        } else if (_entry.get() == NULL) {
+            _entry.reset(new directory_entry(_dirent.d_name,
+                                             to_entry_type(_dirent)));
         } else {
-            _entry.reset(new directory_entry(_dirent.d_name));
+            // Reuse the entry to avoid one allocation per iteration.  This is
+            // safe because the returned references are documented to be
+            // invalidated when the iterator advances.
+            _entry->name = _dirent.d_name;
+            _entry->type = to_entry_type(_dirent);
         }
     }
 };
@@ -295,7 +340,8 @@ detail::directory_iterator::operator++(void)
 
 /// Dereferences the iterator to its contents.
 ///
-/// \return A reference to the directory entry pointed to by the iterator.
+/// \return A reference to the directory entry pointed to by the iterator.  The
+/// reference is only valid until the iterator is advanced.
 const fs::directory_entry&
 detail::directory_iterator::operator*(void) const
 {
@@ -306,7 +352,8 @@ detail::directory_iterator::operator*(void) const
 
 /// Dereferences the iterator to its contents.
 ///
-/// \return A pointer to the directory entry pointed to by the iterator.
+/// \return A pointer to the directory entry pointed to by the iterator.  The
+/// pointer is only valid until the iterator is advanced.
 const fs::directory_entry*
 detail::directory_iterator::operator->(void) const
 {
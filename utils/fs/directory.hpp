@@ -44,12 +44,31 @@ namespace utils {
 namespace fs {
 
 
+/// Types of directory entries, as reported by the directory scan.
+///
+/// Not all systems nor file systems report the type of the entries; callers
+/// must be prepared to stat(2) the entries of unknown type themselves.
+enum entry_type {
+    entry_type_unknown = 0,
+    entry_type_directory,
+    entry_type_other,
+    entry_type_regular,
+    entry_type_symlink,
+};
+
+
 /// Representation of a single directory entry.
 struct directory_entry {
     /// Name of the directory entry.
     std::string name;
 
-    explicit directory_entry(const std::string&);
+    /// Type of the directory entry, if known.
+    ///
+    /// This is informational only and does not partake in comparisons.
+    entry_type type;
+
+    explicit directory_entry(const std::string&,
+                             const entry_type = entry_type_unknown);
 
     bool operator==(const directory_entry&) const;
     bool operator!=(const directory_entry&) const;
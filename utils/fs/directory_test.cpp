@@ -28,6 +28,11 @@
 
 #include "utils/fs/directory.hpp"
 
+extern "C" {
+#include <unistd.h>
+}
+
+#include <map>
 #include <sstream>
 
 #include <atf-c++.hpp>
@@ -45,6 +50,11 @@ ATF_TEST_CASE_BODY(directory_entry__public_fields)
 {
     const fs::directory_entry entry("name");
     ATF_REQUIRE_EQ("name", entry.name);
+    ATF_REQUIRE_EQ(fs::entry_type_unknown, entry.type);
+
+    const fs::directory_entry typed("other", fs::entry_type_regular);
+    ATF_REQUIRE_EQ("other", typed.name);
+    ATF_REQUIRE_EQ(fs::entry_type_regular, typed.type);
 }
 
 
@@ -138,6 +148,35 @@ ATF_TEST_CASE_BODY(integration__some_contents)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(integration__types);
+ATF_TEST_CASE_BODY(integration__types)
+{
+    fs::mkdir(fs::path("full"), 0755);
+    atf::utils::create_file("full/file", "");
+    fs::mkdir(fs::path("full/subdir"), 0755);
+    ATF_REQUIRE(::symlink("file", "full/link") != -1);
+
+    std::map< std::string, fs::entry_type > exp_types;
+    exp_types["file"] = fs::entry_type_regular;
+    exp_types["link"] = fs::entry_type_symlink;
+    exp_types["subdir"] = fs::entry_type_directory;
+
+    int checked = 0;
+    const fs::directory dir(fs::path("full"));
+    for (fs::directory::const_iterator iter = dir.begin(); iter != dir.end();
+         ++iter) {
+        if (iter->name == "." || iter->name == "..")
+            continue;
+        // Some file systems do not report types, in which case the caller
+        // has to stat(2) the entry; anything else must be accurate.
+        if (iter->type != fs::entry_type_unknown)
+            ATF_REQUIRE_EQ(exp_types[iter->name], iter->type);
+        ++checked;
+    }
+    ATF_REQUIRE_EQ(3, checked);
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(integration__open_failure);
 ATF_TEST_CASE_BODY(integration__open_failure)
 {
@@ -185,6 +224,7 @@ ATF_INIT_TEST_CASES(tcs)
 
     ATF_ADD_TEST_CASE(tcs, integration__empty);
     ATF_ADD_TEST_CASE(tcs, integration__some_contents);
+    ATF_ADD_TEST_CASE(tcs, integration__types);
     ATF_ADD_TEST_CASE(tcs, integration__open_failure);
     ATF_ADD_TEST_CASE(tcs, integration__iterators_equality);
 }
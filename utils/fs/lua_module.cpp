@@ -29,11 +29,15 @@
 #include "utils/fs/lua_module.hpp"
 
 extern "C" {
+#include <sys/stat.h>
+
 #include <dirent.h>
 }
 
 #include <cerrno>
 #include <cstring>
+#include <memory>
+#include <set>
 #include <stdexcept>
 #include <string>
 
@@ -44,9 +48,15 @@ extern "C" {
 #include "utils/format/macros.hpp"
 #include "utils/fs/operations.hpp"
 #include "utils/fs/path.hpp"
+#include "utils/optional.ipp"
 #include "utils/sanity.hpp"
+#include "utils/text/regex.hpp"
 
 namespace fs = utils::fs;
+namespace text = utils::text;
+
+using utils::none;
+using utils::optional;
 
 
 namespace {
@@ -78,6 +88,40 @@ qualify_path(lutok::state& state, const fs::path& path)
 }
 
 
+/// Records that the contents of a directory have been inspected.
+///
+/// This is a no-op unless the module was opened with a set of inspected
+/// directories.
+///
+/// \param state The Lua state.
+/// \param directory The qualified path to the inspected directory.
+static void
+record_inspected_dir(lutok::state& state, const fs::path& directory)
+{
+    lutok::stack_cleaner cleaner(state);
+
+    state.get_global("_fs_inspected_dirs");
+    if (state.is_userdata(-1))
+        (*state.to_userdata< std::set< fs::path >* >(-1))->insert(directory);
+}
+
+
+/// Records that an operation on the file system has been performed.
+///
+/// This is a no-op unless the module was opened with a counter of operations.
+///
+/// \param state The Lua state.
+static void
+record_operation(lutok::state& state)
+{
+    lutok::stack_cleaner cleaner(state);
+
+    state.get_global("_fs_operations");
+    if (state.is_userdata(-1))
+        ++(**state.to_userdata< std::size_t* >(-1));
+}
+
+
 /// Safely gets a path from the Lua state.
 ///
 /// \param state The Lua state.
@@ -97,6 +141,67 @@ to_path(lutok::state& state, const int index)
 }
 
 
+/// Criteria to select the directory entries returned by fs.files().
+///
+/// The entries are matched in C++ so that scanning large directories does not
+/// require pushing every single entry to Lua only to discard most of them.
+struct files_filter {
+    /// The directory being scanned.
+    fs::path directory;
+
+    /// Prefix that the name of the entries must have, if any.
+    optional< std::string > prefix;
+
+    /// Suffix that the name of the entries must have, if any.
+    optional< std::string > suffix;
+
+    /// Extended regular expression that the name of the entries must match.
+    optional< text::regex > regex;
+
+    /// Whether the entries must be executable regular files.
+    bool executable;
+
+    /// Constructor for a filter that matches all entries.
+    ///
+    /// \param directory_ The directory being scanned.
+    explicit files_filter(const fs::path& directory_) :
+        directory(directory_), executable(false)
+    {
+    }
+
+    /// Checks whether a directory entry matches the filter.
+    ///
+    /// \param state The Lua state.
+    /// \param name The name of the entry.
+    ///
+    /// \return True if the entry has to be returned to the caller.
+    bool
+    matches(lutok::state& state, const std::string& name) const
+    {
+        if (prefix && name.compare(0, prefix.get().length(),
+                                   prefix.get()) != 0)
+            return false;
+        if (suffix && (name.length() < suffix.get().length() ||
+                       name.compare(name.length() - suffix.get().length(),
+                                    suffix.get().length(),
+                                    suffix.get()) != 0))
+            return false;
+        if (regex && !regex.get().match(name))
+            return false;
+        if (executable) {
+            record_operation(state);
+            struct ::stat sb;
+            if (::stat((directory / name).c_str(), &sb) == -1)
+                return false;
+            if (!S_ISREG(sb.st_mode) ||
+                (sb.st_mode & (S_IXUSR | S_IXGRP | S_IXOTH)) == 0)
+                return false;
+        }
+        return true;
+    }
+};
+
+
 /// Lua binding for fs::path::basename.
 ///
 /// \pre stack(-1) The input path.
@@ -151,6 +256,8 @@ lua_fs_exists(lutok::state& state)
     lutok::stack_cleaner cleaner(state);
 
     const fs::path path = qualify_path(state, to_path(state, -1));
+    record_inspected_dir(state, path.branch_path());
+    record_operation(state);
     state.push_boolean(fs::exists(path));
     cleaner.forget();
     return 1;
@@ -163,7 +270,11 @@ lua_fs_exists(lutok::state& state)
 /// returns the next entry.  See lua_fs_files() for the iterator generator
 /// function.
 ///
+/// Entries that do not match the filter of the iterator are skipped without
+/// returning to Lua.
+///
 /// \pre upvalue(1) The userdata containing an open DIR* object.
+/// \pre upvalue(2) The userdata containing the files_filter* object.
 ///
 /// \param state The lua state.
 ///
@@ -175,13 +286,18 @@ files_iterator(lutok::state& state)
     lutok::stack_cleaner cleaner(state);
 
     DIR** dirp = state.to_userdata< DIR* >(state.upvalue_index(1));
-    const struct dirent* entry = ::readdir(*dirp);
-    if (entry == NULL)
-        return 0;
-    else {
-        state.push_string(entry->d_name);
-        cleaner.forget();
-        return 1;
+    const files_filter* filter = *state.to_userdata< files_filter* >(
+        state.upvalue_index(2));
+    for (;;) {
+        record_operation(state);
+        const struct dirent* entry = ::readdir(*dirp);
+        if (entry == NULL)
+            return 0;
+        else if (filter->matches(state, entry->d_name)) {
+            state.push_string(entry->d_name);
+            cleaner.forget();
+            return 1;
+        }
     }
 }
 
@@ -216,9 +332,110 @@ files_gc(lutok::state& state)
 }
 
 
+/// Lua binding for the destruction of the filter of the files iterator.
+///
+/// \pre stack(-1) The userdata containing the files_filter* object.
+/// \post The files_filter* object is released.
+///
+/// \param state The lua state.
+///
+/// \return The number of result values, i.e. 0.
+static int
+files_filter_gc(lutok::state& state)
+{
+    lutok::stack_cleaner cleaner(state);
+
+    PRE(state.is_userdata(-1));
+
+    files_filter** filterp = state.to_userdata< files_filter* >(-1);
+    // Same as in files_gc: protect against multiple invocations.
+    delete *filterp;
+    *filterp = NULL;
+
+    return 0;
+}
+
+
+/// Gets an optional string property of the filter table of fs.files().
+///
+/// \pre stack(-1) The filter table.
+///
+/// \param state The Lua state.
+/// \param name The name of the property to query.
+///
+/// \return The value of the property, or none if it is not set.
+///
+/// \throw std::runtime_error If the property is not a string.
+static optional< std::string >
+get_filter_string(lutok::state& state, const char* name)
+{
+    lutok::stack_cleaner cleaner(state);
+
+    state.push_string(name);
+    state.get_table(-2);
+    if (state.is_nil(-1))
+        return none;
+    if (!state.is_string(-1))
+        throw std::runtime_error(F("Filter property '%s' must be a string") %
+                                 name);
+    return utils::make_optional(state.to_string(-1));
+}
+
+
+/// Parses the filter table of fs.files().
+///
+/// \pre stack(-1) The filter table.
+///
+/// \param state The Lua state.
+/// \param [in,out] filter The filter into which to store the criteria.
+///
+/// \throw std::runtime_error If the table contains unknown or invalid
+///     properties.
+/// \throw text::regex_error If the regular expression is invalid.
+static void
+parse_files_filter(lutok::state& state, files_filter& filter)
+{
+    lutok::stack_cleaner cleaner(state);
+
+    if (!state.is_table(-1))
+        throw std::runtime_error("Need a table as the filter");
+
+    state.push_nil();
+    while (state.next(-2)) {
+        if (!state.is_string(-2))
+            throw std::runtime_error("Filter properties must be strings");
+        const std::string name = state.to_string(-2);
+        if (name != "executable" && name != "prefix" && name != "regex" &&
+            name != "suffix")
+            throw std::runtime_error(F("Unknown filter property '%s'") % name);
+        state.pop(1);
+    }
+
+    filter.prefix = get_filter_string(state, "prefix");
+    filter.suffix = get_filter_string(state, "suffix");
+    const optional< std::string > regex = get_filter_string(state, "regex");
+    if (regex)
+        filter.regex = text::regex::compile_cached(regex.get(), 0);
+
+    state.push_string("executable");
+    state.get_table(-2);
+    if (!state.is_nil(-1)) {
+        if (!state.is_boolean(-1))
+            throw std::runtime_error("Filter property 'executable' must be a "
+                                     "boolean");
+        filter.executable = state.to_boolean(-1);
+    }
+    state.pop(1);
+}
+
+
 /// Lua binding to create an iterator to scan the contents of a directory.
 ///
-/// \pre stack(-1) The input path.
+/// \pre stack(1) The input path.
+/// \pre stack(2) An optional table with the criteria that the returned entries
+///     must match: 'prefix' and 'suffix' strings for the name of the entries, a
+///     'regex' extended regular expression for the name of the entries and an
+///     'executable' boolean to only return executable regular files.
 /// \post stack(-1) The iterator function.
 ///
 /// \param state The Lua state.
@@ -229,7 +446,15 @@ lua_fs_files(lutok::state& state)
 {
     lutok::stack_cleaner cleaner(state);
 
-    const fs::path path = qualify_path(state, to_path(state, -1));
+    const fs::path path = qualify_path(state, to_path(state, 1));
+    std::auto_ptr< files_filter > filter(new files_filter(path));
+    if (state.get_top() >= 2 && !state.is_nil(2)) {
+        state.push_value(2);
+        parse_files_filter(state, *filter);
+        state.pop(1);
+    }
+    record_inspected_dir(state, path);
+    record_operation(state);
 
     DIR** dirp = state.new_userdata< DIR* >();
 
@@ -247,7 +472,18 @@ lua_fs_files(lutok::state& state)
                                  std::strerror(original_errno));
     }
 
-    state.push_cxx_closure(files_iterator, 1);
+    files_filter** filterp = state.new_userdata< files_filter* >();
+
+    state.new_table();
+    state.push_string("__gc");
+    state.push_cxx_function(files_filter_gc);
+    state.set_table(-3);
+
+    state.set_metatable(-2);
+
+    *filterp = filter.release();
+
+    state.push_cxx_closure(files_iterator, 2);
 
     cleaner.forget();
     return 1;
@@ -338,3 +574,55 @@ fs::open_fs(lutok::state& s, const fs::path& start_dir)
     members["join"] = lua_fs_join;
     lutok::create_module(s, "fs", members);
 }
+
+
+/// Creates a Lua 'fs' module that records the directories it inspects.
+///
+/// \post The global 'fs' symbol is set to a table that contains functions to a
+/// variety of utilites from the fs C++ module.
+///
+/// \param s The Lua state.
+/// \param start_dir The start directory to use in all operations that reference
+///     the underlying file sytem.
+/// \param inspected_dirs Set into which to record the qualified paths of the
+///     directories whose contents are inspected by fs.exists() and fs.files().
+///     Must remain valid for as long as the Lua state is used.
+void
+fs::open_fs(lutok::state& s, const fs::path& start_dir,
+            std::set< fs::path >* inspected_dirs)
+{
+    open_fs(s, start_dir);
+
+    lutok::stack_cleaner cleaner(s);
+
+    *s.new_userdata< std::set< fs::path >* >() = inspected_dirs;
+    s.set_global("_fs_inspected_dirs");
+}
+
+
+/// Creates a Lua 'fs' module that records the file system accesses it does.
+///
+/// \post The global 'fs' symbol is set to a table that contains functions to a
+/// variety of utilites from the fs C++ module.
+///
+/// \param s The Lua state.
+/// \param start_dir The start directory to use in all operations that reference
+///     the underlying file sytem.
+/// \param inspected_dirs Set into which to record the qualified paths of the
+///     directories whose contents are inspected by fs.exists() and fs.files().
+///     Must remain valid for as long as the Lua state is used.
+/// \param operations Counter to increment on every operation on the file
+///     system: every fs.exists() call, every fs.files() call and every
+///     directory entry read by the latter.  Must remain valid for as long as
+///     the Lua state is used.
+void
+fs::open_fs(lutok::state& s, const fs::path& start_dir,
+            std::set< fs::path >* inspected_dirs, std::size_t* operations)
+{
+    open_fs(s, start_dir, inspected_dirs);
+
+    lutok::stack_cleaner cleaner(s);
+
+    *s.new_userdata< std::size_t* >() = operations;
+    s.set_global("_fs_operations");
+}
@@ -32,10 +32,17 @@
 /// When the fs module is bound to Lua, the module has the concept of a "start
 /// directory".  The start directory is the directory used to qualify all
 /// relative paths, and is provided at module binding time.
+///
+/// The module can also record the directories whose contents are inspected
+/// by the Lua code, which allows callers to know what the results of the code
+/// depend on, and count the operations on the file system that the code does.
 
 #if !defined(UTILS_FS_LUA_MODULE_HPP)
 #define UTILS_FS_LUA_MODULE_HPP
 
+#include <cstddef>
+#include <set>
+
 #include <lutok/state.hpp>
 
 #include "utils/fs/path.hpp"
@@ -46,6 +53,9 @@ namespace fs {
 
 void open_fs(lutok::state&);
 void open_fs(lutok::state&, const fs::path&);
+void open_fs(lutok::state&, const fs::path&, std::set< fs::path >*);
+void open_fs(lutok::state&, const fs::path&, std::set< fs::path >*,
+             std::size_t*);
 
 
 }  // namespace fs
@@ -28,6 +28,13 @@
 
 #include "utils/fs/lua_module.hpp"
 
+extern "C" {
+#include <sys/stat.h>
+}
+
+#include <cstddef>
+#include <set>
+
 #include <atf-c++.hpp>
 #include <lutok/operations.hpp>
 #include <lutok/state.hpp>
@@ -184,6 +191,24 @@ ATF_TEST_CASE_BODY(exists__custom_start_dir)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(exists__inspected_dirs);
+ATF_TEST_CASE_BODY(exists__inspected_dirs)
+{
+    std::set< fs::path > inspected_dirs;
+    lutok::state state;
+    fs::open_fs(state, fs::path("root"), &inspected_dirs);
+
+    lutok::do_string(state, "return fs.exists('foo')", 0, 1, 0);
+    lutok::do_string(state, "return fs.exists('subdir/bar')", 0, 1, 0);
+    state.pop(2);
+
+    std::set< fs::path > exp_dirs;
+    exp_dirs.insert(fs::path("root"));
+    exp_dirs.insert(fs::path("root/subdir"));
+    ATF_REQUIRE(exp_dirs == inspected_dirs);
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(files__none);
 ATF_TEST_CASE_BODY(files__none)
 {
@@ -255,6 +280,151 @@ ATF_TEST_CASE_BODY(files__some_with_custom_start_dir)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(files__filter__prefix_and_suffix);
+ATF_TEST_CASE_BODY(files__filter__prefix_and_suffix)
+{
+    lutok::state state;
+    state.open_table();
+    fs::open_fs(state);
+
+    fs::mkdir(fs::path("root"), 0755);
+    atf::utils::create_file("root/a_test", "");
+    atf::utils::create_file("root/b_test", "");
+    atf::utils::create_file("root/a_helper", "");
+    atf::utils::create_file("root/test", "");
+
+    lutok::do_string(state,
+                     "names = {}\n"
+                     "for file in fs.files('root', {suffix='_test'}) do\n"
+                     "    table.insert(names, file)\n"
+                     "end\n"
+                     "for file in fs.files('root', {prefix='a_',"
+                     " suffix='_helper'}) do\n"
+                     "    table.insert(names, file)\n"
+                     "end\n"
+                     "table.sort(names)\n"
+                     "return table.concat(names, ' ')",
+                     0, 1, 0);
+    ATF_REQUIRE_EQ("a_helper a_test b_test", state.to_string(-1));
+    state.pop(1);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(files__filter__regex);
+ATF_TEST_CASE_BODY(files__filter__regex)
+{
+    lutok::state state;
+    state.open_table();
+    fs::open_fs(state);
+
+    fs::mkdir(fs::path("root"), 0755);
+    atf::utils::create_file("root/t_1", "");
+    atf::utils::create_file("root/t_22", "");
+    atf::utils::create_file("root/t_x", "");
+
+    lutok::do_string(state,
+                     "names = {}\n"
+                     "for file in fs.files('root', {regex='^t_[0-9]+$'}) do\n"
+                     "    table.insert(names, file)\n"
+                     "end\n"
+                     "table.sort(names)\n"
+                     "return table.concat(names, ' ')",
+                     0, 1, 0);
+    ATF_REQUIRE_EQ("t_1 t_22", state.to_string(-1));
+    state.pop(1);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(files__filter__executable);
+ATF_TEST_CASE_BODY(files__filter__executable)
+{
+    lutok::state state;
+    state.open_table();
+    fs::open_fs(state);
+
+    fs::mkdir(fs::path("root"), 0755);
+    fs::mkdir(fs::path("root/subdir"), 0755);
+    atf::utils::create_file("root/program", "");
+    ATF_REQUIRE(::chmod("root/program", 0755) != -1);
+    atf::utils::create_file("root/data", "");
+
+    lutok::do_string(state,
+                     "names = {}\n"
+                     "for file in fs.files('root', {executable=true}) do\n"
+                     "    table.insert(names, file)\n"
+                     "end\n"
+                     "return table.concat(names, ' ')",
+                     0, 1, 0);
+    ATF_REQUIRE_EQ("program", state.to_string(-1));
+    state.pop(1);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(files__filter__fail);
+ATF_TEST_CASE_BODY(files__filter__fail)
+{
+    lutok::state state;
+    fs::open_fs(state);
+
+    fs::mkdir(fs::path("root"), 0755);
+
+    ATF_REQUIRE_THROW_RE(lutok::error, "Need a table",
+                         lutok::do_string(state, "fs.files('root', 'x')",
+                                          0, 0, 0));
+    ATF_REQUIRE_THROW_RE(lutok::error, "Unknown filter property 'glob'",
+                         lutok::do_string(state, "fs.files('root', "
+                                          "{glob='*'})", 0, 0, 0));
+    ATF_REQUIRE_THROW_RE(lutok::error, "'suffix' must be a string",
+                         lutok::do_string(state, "fs.files('root', "
+                                          "{suffix=true})", 0, 0, 0));
+    ATF_REQUIRE_THROW_RE(lutok::error, "'executable' must be a boolean",
+                         lutok::do_string(state, "fs.files('root', "
+                                          "{executable='yes'})", 0, 0, 0));
+    ATF_REQUIRE_THROW_RE(lutok::error, "regcomp",
+                         lutok::do_string(state, "fs.files('root', "
+                                          "{regex='('})", 0, 0, 0));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(files__inspected_dirs);
+ATF_TEST_CASE_BODY(files__inspected_dirs)
+{
+    std::set< fs::path > inspected_dirs;
+    lutok::state state;
+    fs::open_fs(state, fs::current_path(), &inspected_dirs);
+
+    fs::mkdir(fs::path("root"), 0755);
+
+    lutok::do_string(state, "for file in fs.files('root') do end", 0, 0, 0);
+
+    std::set< fs::path > exp_dirs;
+    exp_dirs.insert(fs::current_path() / "root");
+    ATF_REQUIRE(exp_dirs == inspected_dirs);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(files__operations);
+ATF_TEST_CASE_BODY(files__operations)
+{
+    std::set< fs::path > inspected_dirs;
+    std::size_t operations = 0;
+    lutok::state state;
+    fs::open_fs(state, fs::current_path(), &inspected_dirs, &operations);
+
+    fs::mkdir(fs::path("root"), 0755);
+    atf::utils::create_file("root/file1", "");
+    atf::utils::create_file("root/file2", "");
+
+    // One operation to open the directory and one per read of its entries,
+    // which include '.', '..' and the final end-of-directory marker.
+    lutok::do_string(state, "for file in fs.files('root') do end", 0, 0, 0);
+    ATF_REQUIRE_EQ(6, operations);
+
+    lutok::do_string(state, "fs.exists('root/file1')", 0, 0, 0);
+    ATF_REQUIRE_EQ(7, operations);
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(files__fail_arg);
 ATF_TEST_CASE_BODY(files__fail_arg)
 {
@@ -361,10 +531,17 @@ ATF_INIT_TEST_CASES(tcs)
     ATF_ADD_TEST_CASE(tcs, exists__ok);
     ATF_ADD_TEST_CASE(tcs, exists__fail);
     ATF_ADD_TEST_CASE(tcs, exists__custom_start_dir);
+    ATF_ADD_TEST_CASE(tcs, exists__inspected_dirs);
 
     ATF_ADD_TEST_CASE(tcs, files__none);
     ATF_ADD_TEST_CASE(tcs, files__some);
     ATF_ADD_TEST_CASE(tcs, files__some_with_custom_start_dir);
+    ATF_ADD_TEST_CASE(tcs, files__filter__prefix_and_suffix);
+    ATF_ADD_TEST_CASE(tcs, files__filter__regex);
+    ATF_ADD_TEST_CASE(tcs, files__filter__executable);
+    ATF_ADD_TEST_CASE(tcs, files__filter__fail);
+    ATF_ADD_TEST_CASE(tcs, files__inspected_dirs);
+    ATF_ADD_TEST_CASE(tcs, files__operations);
     ATF_ADD_TEST_CASE(tcs, files__fail_arg);
     ATF_ADD_TEST_CASE(tcs, files__fail_opendir);
 
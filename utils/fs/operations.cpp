@@ -34,6 +34,7 @@
 
 extern "C" {
 #include <sys/param.h>
+#include <sys/ioctl.h>
 #if defined(HAVE_SYS_MOUNT_H)
 #   include <sys/mount.h>
 #endif
@@ -46,13 +47,19 @@ extern "C" {
 #endif
 #include <sys/wait.h>
 
+#if defined(HAVE_LINUX_FS_H)
+#   include <linux/fs.h>
+#endif
+#include <dirent.h>
+#include <fcntl.h>
 #include <unistd.h>
 }
 
 #include <cerrno>
+#include <climits>
 #include <cstdlib>
 #include <cstring>
-#include <fstream>
+#include <iomanip>
 #include <iostream>
 #include <sstream>
 #include <string>
@@ -75,6 +82,11 @@ namespace units = utils::units;
 using utils::optional;
 
 
+#if defined(HAVE_FDOPENDIR) && defined(HAVE_OPENAT) && defined(HAVE_UNLINKAT)
+#   define USE_AT_FUNCTIONS 1
+#endif
+
+
 namespace {
 
 
@@ -219,12 +231,6 @@ run_mount_tmpfs(const fs::path& mount_point, const uint64_t size)
     }
     mount_args[last] = NULL;
 
-    const char** arg;
-    std::cout << "Mounting tmpfs onto " << mount_point << " with:";
-    for (arg = &mount_args[0]; *arg != NULL; arg++)
-        std::cout << " " << *arg;
-    std::cout << "\n";
-
     const int ret = ::execvp(mount_args[0],
                              UTILS_UNCONST(char* const, mount_args));
     INV(ret == -1);
@@ -319,11 +325,96 @@ safe_stat(const fs::path& path)
 }
 
 
+/// Sets the permissions of a file.
+///
+/// \param path The file to modify.
+/// \param mode The new mode; only the permission bits are considered.
+///
+/// \throw fs::system_error If the call to chmod(2) fails.
+static void
+set_mode(const fs::path& path, const mode_t mode)
+{
+    if (::chmod(path.c_str(), mode & 07777) == -1) {
+        const int original_errno = errno;
+        throw fs::system_error(F("Cannot set permissions of %s") % path,
+                               original_errno);
+    }
+}
+
+
+/// Copies the contents of a file descriptor into another.
+///
+/// \param input Descriptor to read from, positioned at the beginning.
+/// \param output Descriptor to write to, empty and positioned at the
+///     beginning.
+/// \param source Name of the input file, for error reporting purposes.
+/// \param target Name of the output file, for error reporting purposes.
+///
+/// \throw fs::error If reading or writing fails.
+static void
+copy_fd(const int input, const int output, const fs::path& source,
+        const fs::path& target)
+{
+#if defined(FICLONE)
+    if (::ioctl(output, FICLONE, input) == 0)
+        return;
+#endif
+
+#if defined(HAVE_COPY_FILE_RANGE)
+    for (;;) {
+        const ssize_t length = ::copy_file_range(input, NULL, output, NULL,
+                                                 SSIZE_MAX, 0);
+        if (length == 0)
+            return;
+        else if (length == -1) {
+            if (errno == EINTR)
+                continue;
+            // The file systems may not support in-kernel copies across them;
+            // fall back to the user-space loop, which resumes from the file
+            // offsets where the partial copy stopped.
+            break;
+        }
+    }
+#endif
+
+    char buffer[64 * 1024];
+    for (;;) {
+        const ssize_t length = ::read(input, buffer, sizeof(buffer));
+        if (length == 0)
+            return;
+        else if (length == -1) {
+            if (errno == EINTR)
+                continue;
+            throw fs::error(F("Error while reading input file %s") % source);
+        }
+
+        const char* data = buffer;
+        std::size_t pending = length;
+        while (pending > 0) {
+            const ssize_t written = ::write(output, data, pending);
+            if (written == -1) {
+                if (errno == EINTR)
+                    continue;
+                throw fs::error(F("Error while writing output file %s") %
+                                target);
+            }
+            data += written;
+            pending -= written;
+        }
+    }
+}
+
+
 }  // anonymous namespace
 
 
 /// Copies a file.
 ///
+/// The copy is attempted in the cheapest possible way: first by cloning the
+/// extents of the source when the file system supports reflinks, then by
+/// letting the kernel move the data with copy_file_range(2), and finally by
+/// resorting to a read/write loop in user space.
+///
 /// \param source The file to copy.
 /// \param target The destination of the new copy; must be a file name, not a
 ///     directory.
@@ -332,22 +423,79 @@ safe_stat(const fs::path& path)
 void
 fs::copy(const fs::path& source, const fs::path& target)
 {
-    std::ifstream input(source.c_str());
-    if (!input)
+    const int input = ::open(source.c_str(), O_RDONLY);
+    if (input == -1)
         throw error(F("Cannot open copy source %s") % source);
 
-    std::ofstream output(target.c_str());
-    if (!output)
+    const int output = ::open(target.c_str(), O_WRONLY | O_CREAT | O_TRUNC,
+                              0666);
+    if (output == -1) {
+        ::close(input);
         throw error(F("Cannot create copy target %s") % target);
+    }
 
-    char buffer[1024];
-    while (input.good()) {
-        input.read(buffer, sizeof(buffer));
-        if (input.good() || input.eof())
-            output.write(buffer, input.gcount());
+    try {
+        copy_fd(input, output, source, target);
+    } catch (...) {
+        ::close(output);
+        ::close(input);
+        throw;
+    }
+    ::close(input);
+    if (::close(output) == -1)
+        throw error(F("Error while writing output file %s") % target);
+}
+
+
+/// Copies a file or a directory hierarchy.
+///
+/// Regular files are copied with fs::copy() so that they benefit from its
+/// fast paths, directories are recreated with the permissions of the source
+/// and symbolic links are recreated verbatim.  Any other file type is
+/// skipped.
+///
+/// \param source The file or directory to copy.
+/// \param target The destination of the new copy; must not exist.
+///
+/// \throw error If there is a problem copying any of the files.
+void
+fs::copy_tree(const fs::path& source, const fs::path& target)
+{
+    const struct ::stat sb = safe_stat(source);
+
+    if (S_ISDIR(sb.st_mode)) {
+        // Keep the directory writable while we populate it; its final
+        // permissions are only applied once all its contents are in place.
+        fs::mkdir(target, 0700);
+        const fs::directory dir(source);
+        for (fs::directory::const_iterator iter = dir.begin();
+             iter != dir.end(); ++iter) {
+            if (iter->name == "." || iter->name == "..")
+                continue;
+            copy_tree(source / iter->name, target / iter->name);
+        }
+        set_mode(target, sb.st_mode);
+    } else if (S_ISLNK(sb.st_mode)) {
+        utils::auto_array< char > buffer(new char[sb.st_size + 1]);
+        const ssize_t length = ::readlink(source.c_str(), buffer.get(),
+                                          sb.st_size + 1);
+        if (length == -1) {
+            const int original_errno = errno;
+            throw fs::system_error(F("Cannot read link %s") % source,
+                                   original_errno);
+        }
+        buffer[length] = '\0';
+        if (::symlink(buffer.get(), target.c_str()) == -1) {
+            const int original_errno = errno;
+            throw fs::system_error(F("Cannot create link %s") % target,
+                                   original_errno);
+        }
+    } else if (S_ISREG(sb.st_mode)) {
+        copy(source, target);
+        set_mode(target, sb.st_mode);
+    } else {
+        LW(F("Not copying %s: unsupported file type") % source);
     }
-    if (!input.good() && !input.eof())
-        throw error(F("Error while reading input file %s") % source);
 }
 
 
@@ -425,6 +573,33 @@ fs::find_in_path(const char* name)
 }
 
 
+/// Formats the modification time of a file with the finest known precision.
+///
+/// Two versions of a file written within the same second have different
+/// modification times in this format as long as the system records them with
+/// subsecond precision.
+///
+/// \param sb The status of the file.
+///
+/// \return The modification time as seconds and nanoseconds.  The nanoseconds
+/// are zero if the system does not provide them.
+std::string
+fs::format_mtime(const struct ::stat& sb)
+{
+#if defined(HAVE_STRUCT_STAT_ST_MTIM)
+    const long nanoseconds = sb.st_mtim.tv_nsec;
+#elif defined(HAVE_STRUCT_STAT_ST_MTIMESPEC)
+    const long nanoseconds = sb.st_mtimespec.tv_nsec;
+#else
+    const long nanoseconds = 0;
+#endif
+    std::ostringstream output;
+    output << sb.st_mtime << '.' << std::setw(9) << std::setfill('0')
+           << nanoseconds;
+    return output.str();
+}
+
+
 /// Calculates the free space in a given file system.
 ///
 /// \param path Path to a file in the file system for which to check the free
@@ -647,6 +822,9 @@ fs::mount_tmpfs(const fs::path& in_mount_point, const units::bytes& size)
     const fs::path mount_point = in_mount_point.is_absolute() ?
         in_mount_point : in_mount_point.to_absolute();
 
+    // Executors mount one file system per work directory, so this must not
+    // go to the console.
+    LI(F("Mounting tmpfs onto %s with size %s") % mount_point % size);
     const pid_t pid = ::fork();
     if (pid == -1) {
         const int original_errno = errno;
@@ -682,10 +860,171 @@ retry:
 }
 
 
+#if defined(USE_AT_FUNCTIONS)
+/// Flags to open a directory for traversal within rm_r().
+static const int rm_r_open_flags = O_RDONLY
+#   if defined(O_DIRECTORY)
+    | O_DIRECTORY
+#   endif
+#   if defined(O_NOFOLLOW)
+    | O_NOFOLLOW
+#   endif
+#   if defined(O_CLOEXEC)
+    | O_CLOEXEC
+#   endif
+    ;
+
+
+static void rm_r_at(const int, const fs::path&, const dev_t);
+
+
+/// Removes a subdirectory of a directory being traversed by rm_r_at().
+///
+/// If the subdirectory lives in a different device than its parent, it is a
+/// mount point and is unmounted first so that we never remove the contents of
+/// a file system that just happens to be mounted within the tree.
+///
+/// \param parent_fd File descriptor of the parent directory.
+/// \param name Name of the subdirectory within its parent.
+/// \param path Path to the subdirectory, used for unmounting and for error
+///     reporting only.
+/// \param sb Status of the subdirectory as returned by fstatat(2).
+/// \param parent_device Device of the parent directory.
+///
+/// \throw fs::error If there is a problem removing any directory or file.
+static void
+rm_r_subdirectory_at(const int parent_fd, const char* name,
+                     const fs::path& path, const struct ::stat& sb,
+                     const dev_t parent_device)
+{
+    dev_t device = sb.st_dev;
+    if (device != parent_device) {
+        LI(F("Unmounting file system on %s before removing it") % path);
+        fs::unmount(path);
+        device = parent_device;
+    }
+
+    const int fd = ::openat(parent_fd, name, rm_r_open_flags);
+    if (fd == -1) {
+        const int original_errno = errno;
+        throw fs::system_error(F("Failed to open directory %s") % path,
+                               original_errno);
+    }
+    rm_r_at(fd, path, device);
+
+    LD(F("Removing empty directory %s") % path);
+    if (::unlinkat(parent_fd, name, AT_REMOVEDIR) == -1) {
+        const int original_errno = errno;
+        throw fs::system_error(F("Removal of %s failed") % path,
+                               original_errno);
+    }
+}
+
+
+/// Removes the contents of a directory relative to its file descriptor.
+///
+/// Traversing the tree via file descriptors avoids building and resolving a
+/// full path for every file, and the types reported by readdir(3) avoid a
+/// stat(2) call for every entry that is not a directory.
+///
+/// \param fd File descriptor of the directory to empty.  Ownership is taken
+///     by this function, which closes it on return.
+/// \param path Path to the directory, used for error reporting only.
+/// \param device Device in which the directory lives.
+///
+/// \throw fs::error If there is a problem removing any directory or file.
+static void
+rm_r_at(const int fd, const fs::path& path, const dev_t device)
+{
+    ::DIR* dirp = ::fdopendir(fd);
+    if (dirp == NULL) {
+        const int original_errno = errno;
+        ::close(fd);
+        throw fs::system_error(F("Failed to open directory %s") % path,
+                               original_errno);
+    }
+
+    try {
+        for (;;) {
+            errno = 0;
+            const struct ::dirent* de = ::readdir(dirp);
+            if (de == NULL) {
+                if (errno != 0) {
+                    const int original_errno = errno;
+                    throw fs::system_error(F("Failed to read directory %s") %
+                                           path, original_errno);
+                }
+                break;
+            }
+
+            const char* name = de->d_name;
+            if (std::strcmp(name, ".") == 0 || std::strcmp(name, "..") == 0)
+                continue;
+
+            struct ::stat sb;
+            bool is_directory = false;
+#   if defined(DT_DIR) && defined(DT_UNKNOWN)
+            if (de->d_type == DT_DIR || de->d_type == DT_UNKNOWN)
+#   endif
+            {
+                if (::fstatat(fd, name, &sb, AT_SYMLINK_NOFOLLOW) == -1) {
+                    const int original_errno = errno;
+                    throw fs::system_error(F("Failed to stat %s") %
+                                           (path / name), original_errno);
+                }
+                is_directory = S_ISDIR(sb.st_mode);
+            }
+
+            if (is_directory) {
+                rm_r_subdirectory_at(fd, name, path / name, sb, device);
+            } else if (::unlinkat(fd, name, 0) == -1) {
+                const int original_errno = errno;
+                throw fs::system_error(F("Removal of %s failed") %
+                                       (path / name), original_errno);
+            }
+        }
+    } catch (...) {
+        ::closedir(dirp);
+        throw;
+    }
+    ::closedir(dirp);
+}
+#endif
+
+
+/// Hints the system that the contents of a file are about to be read.
+///
+/// The system reads the file ahead asynchronously if it supports doing so,
+/// which hides the latency of slow storage from a later use of the file.  This
+/// is a best-effort operation, so errors are ignored.
+///
+/// \param path The file to prefetch.
+///
+/// \return True if the hint was issued; false if the file cannot be opened or
+/// if the system does not support the operation.
+bool
+fs::prefetch(const fs::path& path)
+{
+#if defined(HAVE_POSIX_FADVISE) && defined(POSIX_FADV_WILLNEED)
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd == -1)
+        return false;
+    const int error = ::posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+    ::close(fd);
+    return error == 0;
+#else
+    (void)path;
+    return false;
+#endif
+}
+
+
 /// Recursively removes a directory.
 ///
 /// This operation simulates a "rm -r".  No effort is made to forcibly delete
-/// files and no attention is paid to mount points.
+/// files.  Symbolic links are removed, never followed, and any file systems
+/// mounted within the tree are unmounted before their mount points are
+/// removed.
 ///
 /// \param directory The directory to remove.
 ///
@@ -693,6 +1032,22 @@ retry:
 void
 fs::rm_r(const fs::path& directory)
 {
+#if defined(USE_AT_FUNCTIONS)
+    const int fd = ::open(directory.c_str(), rm_r_open_flags);
+    if (fd == -1) {
+        const int original_errno = errno;
+        throw fs::system_error(F("Failed to open directory %s") % directory,
+                               original_errno);
+    }
+    struct ::stat sb;
+    if (::fstat(fd, &sb) == -1) {
+        const int original_errno = errno;
+        ::close(fd);
+        throw fs::system_error(F("Failed to stat %s") % directory,
+                               original_errno);
+    }
+    rm_r_at(fd, directory, sb.st_dev);
+#else
     const fs::directory dir(directory);
 
     for (fs::directory::const_iterator iter = dir.begin(); iter != dir.end();
@@ -702,7 +1057,9 @@ fs::rm_r(const fs::path& directory)
 
         const fs::path entry = directory / iter->name;
 
-        if (fs::is_directory(entry)) {
+        if (iter->type == fs::entry_type_directory ||
+            (iter->type == fs::entry_type_unknown &&
+             fs::is_directory(entry))) {
             LD(F("Descending into %s") % entry);
             fs::rm_r(entry);
         } else {
@@ -710,6 +1067,7 @@ fs::rm_r(const fs::path& directory)
             fs::unlink(entry);
         }
     }
+#endif
 
     LD(F("Removing empty directory %s") % directory);
     fs::rmdir(directory);
@@ -43,14 +43,18 @@
 #include "utils/optional_fwd.hpp"
 #include "utils/units_fwd.hpp"
 
+struct stat;
+
 namespace utils {
 namespace fs {
 
 
 void copy(const fs::path&, const fs::path&);
+void copy_tree(const fs::path&, const fs::path&);
 path current_path(void);
 bool exists(const fs::path&);
 utils::optional< path > find_in_path(const char*);
+std::string format_mtime(const struct ::stat&);
 utils::units::bytes free_disk_space(const fs::path&);
 bool is_directory(const fs::path&);
 void mkdir(const path&, const int);
@@ -59,6 +63,7 @@ fs::path mkdtemp_public(const std::string&);
 fs::path mkstemp(const std::string&);
 void mount_tmpfs(const path&);
 void mount_tmpfs(const path&, const units::bytes&);
+bool prefetch(const path&);
 void rm_r(const path&);
 void rmdir(const path&);
 std::set< directory_entry > scan_directory(const path&);
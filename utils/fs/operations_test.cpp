@@ -28,9 +28,14 @@
 
 #include "utils/fs/operations.hpp"
 
+#if defined(HAVE_CONFIG_H)
+#   include "config.h"
+#endif
+
 extern "C" {
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/time.h>
 #include <sys/wait.h>
 
 #include <dirent.h>
@@ -145,6 +150,71 @@ ATF_TEST_CASE_BODY(copy__fail_create)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(copy__large);
+ATF_TEST_CASE_BODY(copy__large)
+{
+    const fs::path source("f1.txt");
+    const fs::path target("f2.txt");
+
+    std::string contents;
+    for (int i = 0; i < 100000; ++i)
+        contents += (F("Line %s\n") % i).str();
+    atf::utils::create_file(source.str(), contents);
+    atf::utils::create_file(target.str(), "Old contents to be truncated");
+    fs::copy(source, target);
+    ATF_REQUIRE(atf::utils::compare_file(target.str(), contents));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(copy_tree__file);
+ATF_TEST_CASE_BODY(copy_tree__file)
+{
+    atf::utils::create_file("f1.txt", "This is the input");
+    ATF_REQUIRE(::chmod("f1.txt", 0750) != -1);
+    fs::copy_tree(fs::path("f1.txt"), fs::path("f2.txt"));
+
+    ATF_REQUIRE(atf::utils::compare_file("f2.txt", "This is the input"));
+    struct ::stat sb;
+    ATF_REQUIRE(::stat("f2.txt", &sb) != -1);
+    ATF_REQUIRE_EQ(0750, sb.st_mode & 07777);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(copy_tree__directory);
+ATF_TEST_CASE_BODY(copy_tree__directory)
+{
+    fs::mkdir(fs::path("source"), 0755);
+    fs::mkdir(fs::path("source/subdir"), 0755);
+    atf::utils::create_file("source/file", "first");
+    atf::utils::create_file("source/subdir/file", "second");
+    ATF_REQUIRE(::symlink("../file", "source/subdir/link") != -1);
+    ATF_REQUIRE(::chmod("source/subdir", 0555) != -1);
+
+    fs::copy_tree(fs::path("source"), fs::path("target"));
+
+    ATF_REQUIRE(atf::utils::compare_file("target/file", "first"));
+    ATF_REQUIRE(atf::utils::compare_file("target/subdir/file", "second"));
+    ATF_REQUIRE(atf::utils::compare_file("target/subdir/link", "first"));
+    struct ::stat sb;
+    ATF_REQUIRE(::lstat("target/subdir/link", &sb) != -1);
+    ATF_REQUIRE(S_ISLNK(sb.st_mode));
+    ATF_REQUIRE(::stat("target/subdir", &sb) != -1);
+    ATF_REQUIRE_EQ(0555, sb.st_mode & 07777);
+
+    ATF_REQUIRE(::chmod("source/subdir", 0755) != -1);
+    ATF_REQUIRE(::chmod("target/subdir", 0755) != -1);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(copy_tree__fail);
+ATF_TEST_CASE_BODY(copy_tree__fail)
+{
+    ATF_REQUIRE_THROW_RE(fs::error, "Cannot get information about missing",
+                         fs::copy_tree(fs::path("missing"),
+                                       fs::path("target")));
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(current_path__ok);
 ATF_TEST_CASE_BODY(current_path__ok)
 {
@@ -258,6 +328,27 @@ ATF_TEST_CASE_BODY(find_in_path__always_absolute)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(format_mtime);
+ATF_TEST_CASE_BODY(format_mtime)
+{
+    atf::utils::create_file("file", "");
+    struct ::timeval times[2];
+    times[0].tv_sec = 1234567890;
+    times[0].tv_usec = 42;
+    times[1] = times[0];
+    ATF_REQUIRE(::utimes("file", times) != -1);
+
+    struct ::stat sb;
+    ATF_REQUIRE(::stat("file", &sb) != -1);
+#if defined(HAVE_STRUCT_STAT_ST_MTIM) || \
+    defined(HAVE_STRUCT_STAT_ST_MTIMESPEC)
+    ATF_REQUIRE_EQ("1234567890.000042000", fs::format_mtime(sb));
+#else
+    ATF_REQUIRE_EQ("1234567890.000000000", fs::format_mtime(sb));
+#endif
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(free_disk_space__ok__smoke);
 ATF_TEST_CASE_BODY(free_disk_space__ok__smoke)
 {
@@ -635,6 +726,24 @@ ATF_TEST_CASE_BODY(mount_tmpfs__fail)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(prefetch__ok);
+ATF_TEST_CASE_BODY(prefetch__ok)
+{
+    atf::utils::create_file("file", "Some contents");
+    // The hint is best-effort and may be unsupported, so only check that it
+    // leaves the file intact.
+    (void)fs::prefetch(fs::path("file"));
+    ATF_REQUIRE(atf::utils::compare_file("file", "Some contents"));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(prefetch__missing);
+ATF_TEST_CASE_BODY(prefetch__missing)
+{
+    ATF_REQUIRE(!fs::prefetch(fs::path("missing")));
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(rm_r__empty);
 ATF_TEST_CASE_BODY(rm_r__empty)
 {
@@ -664,6 +773,68 @@ ATF_TEST_CASE_BODY(rm_r__files_and_directories)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(rm_r__does_not_follow_symlinks);
+ATF_TEST_CASE_BODY(rm_r__does_not_follow_symlinks)
+{
+    fs::mkdir(fs::path("target"), 0755);
+    atf::utils::create_file("target/file", "");
+    fs::mkdir(fs::path("root"), 0755);
+    ATF_REQUIRE(::symlink("../target", "root/link") != -1);
+    ATF_REQUIRE(::symlink("../target/file", "root/file-link") != -1);
+    ATF_REQUIRE(::symlink("missing", "root/broken-link") != -1);
+
+    fs::rm_r(fs::path("root"));
+    ATF_REQUIRE(!lookup(".", "root", S_IFDIR));
+    ATF_REQUIRE(lookup("target", "file", S_IFREG));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(rm_r__many_files);
+ATF_TEST_CASE_BODY(rm_r__many_files)
+{
+    fs::mkdir(fs::path("root"), 0755);
+    for (int i = 0; i < 10; ++i) {
+        const fs::path subdir = fs::path("root") / (F("dir%s") % i);
+        fs::mkdir(subdir, 0755);
+        for (int j = 0; j < 100; ++j)
+            atf::utils::create_file((subdir / (F("file%s") % j)).str(), "");
+    }
+
+    fs::rm_r(fs::path("root"));
+    ATF_REQUIRE(!lookup(".", "root", S_IFDIR));
+}
+
+
+ATF_TEST_CASE(rm_r__unmounts)
+ATF_TEST_CASE_HEAD(rm_r__unmounts)
+{
+    set_md_var("require.user", "root");
+}
+ATF_TEST_CASE_BODY(rm_r__unmounts)
+{
+    const fs::path mount_point("root/dir/mount_point");
+    fs::mkdir_p(mount_point, 0755);
+    try {
+        fs::mount_tmpfs(mount_point);
+    } catch (const fs::unsupported_operation_error& e) {
+        ATF_SKIP(e.what());
+    }
+    fs::mkdir(mount_point / "subdir", 0755);
+    atf::utils::create_file((mount_point / "subdir/file").str(), "");
+
+    fs::rm_r(fs::path("root"));
+    ATF_REQUIRE(!lookup(".", "root", S_IFDIR));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(rm_r__fail)
+ATF_TEST_CASE_BODY(rm_r__fail)
+{
+    ATF_REQUIRE_THROW_RE(fs::system_error, "Failed to open directory missing",
+                         fs::rm_r(fs::path("missing")));
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(rmdir__ok)
 ATF_TEST_CASE_BODY(rmdir__ok)
 {
@@ -771,6 +942,10 @@ ATF_INIT_TEST_CASES(tcs)
     ATF_ADD_TEST_CASE(tcs, copy__ok);
     ATF_ADD_TEST_CASE(tcs, copy__fail_open);
     ATF_ADD_TEST_CASE(tcs, copy__fail_create);
+    ATF_ADD_TEST_CASE(tcs, copy__large);
+    ATF_ADD_TEST_CASE(tcs, copy_tree__file);
+    ATF_ADD_TEST_CASE(tcs, copy_tree__directory);
+    ATF_ADD_TEST_CASE(tcs, copy_tree__fail);
 
     ATF_ADD_TEST_CASE(tcs, current_path__ok);
     ATF_ADD_TEST_CASE(tcs, current_path__enoent);
@@ -784,6 +959,8 @@ ATF_INIT_TEST_CASES(tcs)
     ATF_ADD_TEST_CASE(tcs, find_in_path__current_directory);
     ATF_ADD_TEST_CASE(tcs, find_in_path__always_absolute);
 
+    ATF_ADD_TEST_CASE(tcs, format_mtime);
+
     ATF_ADD_TEST_CASE(tcs, free_disk_space__ok__smoke);
     ATF_ADD_TEST_CASE(tcs, free_disk_space__ok__real);
     ATF_ADD_TEST_CASE(tcs, free_disk_space__fail);
@@ -809,8 +986,15 @@ ATF_INIT_TEST_CASES(tcs)
     ATF_ADD_TEST_CASE(tcs, mount_tmpfs__ok__explicit_size);
     ATF_ADD_TEST_CASE(tcs, mount_tmpfs__fail);
 
+    ATF_ADD_TEST_CASE(tcs, prefetch__ok);
+    ATF_ADD_TEST_CASE(tcs, prefetch__missing);
+
     ATF_ADD_TEST_CASE(tcs, rm_r__empty);
     ATF_ADD_TEST_CASE(tcs, rm_r__files_and_directories);
+    ATF_ADD_TEST_CASE(tcs, rm_r__does_not_follow_symlinks);
+    ATF_ADD_TEST_CASE(tcs, rm_r__many_files);
+    ATF_ADD_TEST_CASE(tcs, rm_r__unmounts);
+    ATF_ADD_TEST_CASE(tcs, rm_r__fail);
 
     ATF_ADD_TEST_CASE(tcs, rmdir__ok);
     ATF_ADD_TEST_CASE(tcs, rmdir__fail);
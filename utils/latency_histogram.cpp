@@ -0,0 +1,269 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "utils/latency_histogram.hpp"
+
+#include <algorithm>
+
+#include "utils/datetime.hpp"
+#include "utils/sanity.hpp"
+
+namespace datetime = utils::datetime;
+
+
+namespace {
+
+
+/// Number of bits of precision kept for each value.
+///
+/// Each power of two is split into 2^sub_bucket_bits buckets of equal width.
+static const int sub_bucket_bits = 3;
+
+
+/// Number of buckets in which each power of two is split.
+static const int64_t sub_buckets = 1 << sub_bucket_bits;
+
+
+/// Computes the bucket a value belongs to.
+///
+/// \param value The value in microseconds.  Must not be negative.
+///
+/// \return The index of the bucket.
+static std::size_t
+bucket_of(const int64_t value)
+{
+    PRE(value >= 0);
+    if (value < sub_buckets)
+        return static_cast< std::size_t >(value);
+
+    int magnitude = 0;
+    while ((value >> magnitude) >= sub_buckets * 2)
+        ++magnitude;
+    const int64_t sub_bucket = (value >> magnitude) - sub_buckets;
+    return static_cast< std::size_t >(
+        sub_buckets * (magnitude + 1) + sub_bucket);
+}
+
+
+/// Computes the largest value that belongs to a bucket.
+///
+/// \param bucket The index of the bucket.
+///
+/// \return The inclusive upper bound of the bucket in microseconds.
+static int64_t
+upper_bound_of(const std::size_t bucket)
+{
+    const int64_t index = static_cast< int64_t >(bucket);
+    if (index < sub_buckets)
+        return index;
+
+    const int magnitude = static_cast< int >(index / sub_buckets) - 1;
+    const int64_t sub_bucket = index % sub_buckets;
+    return ((sub_buckets + sub_bucket + 1) << magnitude) - 1;
+}
+
+
+}  // anonymous namespace
+
+
+/// Constructs an empty histogram.
+utils::latency_histogram::latency_histogram(void) :
+    _count(0), _min(0), _max(0), _total(0)
+{
+}
+
+
+/// Records a value.
+///
+/// \param value The latency to record.
+void
+utils::latency_histogram::record(const datetime::delta& value)
+{
+    const int64_t usecs = value.to_microseconds();
+    const std::size_t bucket = bucket_of(usecs);
+    if (bucket >= _counts.size())
+        _counts.resize(bucket + 1, 0);
+    ++_counts[bucket];
+
+    if (_count == 0 || usecs < _min)
+        _min = usecs;
+    if (_count == 0 || usecs > _max)
+        _max = usecs;
+    _total += usecs;
+    ++_count;
+}
+
+
+/// Records the time elapsed between two instants.
+///
+/// The wall clock may be adjusted while an operation is being measured, so an
+/// end time prior to the start time is recorded as a zero latency instead of
+/// being rejected.
+///
+/// \param start The time at which the measured operation started.
+/// \param end The time at which the measured operation finished.
+void
+utils::latency_histogram::record_interval(const datetime::timestamp& start,
+                                          const datetime::timestamp& end)
+{
+    if (end < start)
+        record(datetime::delta());
+    else
+        record(end - start);
+}
+
+
+/// Adds all the values recorded in another histogram to this one.
+///
+/// \param other The histogram to merge into this one.
+void
+utils::latency_histogram::merge(const latency_histogram& other)
+{
+    if (other._count == 0)
+        return;
+
+    if (other._counts.size() > _counts.size())
+        _counts.resize(other._counts.size(), 0);
+    for (std::size_t i = 0; i < other._counts.size(); ++i)
+        _counts[i] += other._counts[i];
+
+    if (_count == 0 || other._min < _min)
+        _min = other._min;
+    if (_count == 0 || other._max > _max)
+        _max = other._max;
+    _total += other._total;
+    _count += other._count;
+}
+
+
+/// Returns the number of recorded values.
+///
+/// \return A count.
+std::size_t
+utils::latency_histogram::count(void) const
+{
+    return _count;
+}
+
+
+/// Returns the smallest recorded value.
+///
+/// \pre At least one value has been recorded.
+///
+/// \return A time delta.
+datetime::delta
+utils::latency_histogram::min(void) const
+{
+    PRE(_count > 0);
+    return datetime::delta::from_microseconds(_min);
+}
+
+
+/// Returns the largest recorded value.
+///
+/// \pre At least one value has been recorded.
+///
+/// \return A time delta.
+datetime::delta
+utils::latency_histogram::max(void) const
+{
+    PRE(_count > 0);
+    return datetime::delta::from_microseconds(_max);
+}
+
+
+/// Returns the sum of all recorded values.
+///
+/// \return A time delta, which is zero if no values have been recorded.
+datetime::delta
+utils::latency_histogram::total(void) const
+{
+    return datetime::delta::from_microseconds(_total);
+}
+
+
+/// Returns the mean of the recorded values.
+///
+/// \pre At least one value has been recorded.
+///
+/// \return A time delta.
+datetime::delta
+utils::latency_histogram::mean(void) const
+{
+    PRE(_count > 0);
+    return datetime::delta::from_microseconds(
+        _total / static_cast< int64_t >(_count));
+}
+
+
+/// Returns an upper estimate of a percentile of the recorded values.
+///
+/// \pre At least one value has been recorded.
+///
+/// \param percent The percentile to compute, in the [0, 100] range.
+///
+/// \return The upper bound of the bucket holding the percentile, clamped to
+/// the range of recorded values.  The 0th percentile is the exact minimum.
+datetime::delta
+utils::latency_histogram::percentile(const double percent) const
+{
+    PRE(_count > 0);
+    PRE(percent >= 0.0 && percent <= 100.0);
+
+    const std::size_t rank = static_cast< std::size_t >(
+        percent / 100.0 * static_cast< double >(_count) + 0.5);
+    if (rank == 0)
+        return min();
+
+    std::size_t seen = 0;
+    for (std::size_t i = 0; i < _counts.size(); ++i) {
+        seen += _counts[i];
+        if (seen >= rank) {
+            const int64_t value = std::min(std::max(upper_bound_of(i), _min),
+                                           _max);
+            return datetime::delta::from_microseconds(value);
+        }
+    }
+    UNREACHABLE;
+}
+
+
+/// Returns the non-empty buckets of the histogram.
+///
+/// \return A mapping of the inclusive upper bound of each bucket, in
+/// microseconds, to the number of values recorded in it.
+utils::latency_histogram::buckets_map
+utils::latency_histogram::buckets(void) const
+{
+    buckets_map buckets;
+    for (std::size_t i = 0; i < _counts.size(); ++i) {
+        if (_counts[i] > 0)
+            buckets[upper_bound_of(i)] = _counts[i];
+    }
+    return buckets;
+}
@@ -0,0 +1,97 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// \file utils/latency_histogram.hpp
+/// Compact histograms of latencies.
+
+#if !defined(UTILS_LATENCY_HISTOGRAM_HPP)
+#define UTILS_LATENCY_HISTOGRAM_HPP
+
+#include "utils/latency_histogram_fwd.hpp"
+
+extern "C" {
+#include <stdint.h>
+}
+
+#include <cstddef>
+#include <map>
+#include <vector>
+
+#include "utils/datetime_fwd.hpp"
+
+namespace utils {
+
+
+/// Histogram of latencies with a bounded relative error.
+///
+/// Latencies are recorded with microsecond resolution into buckets whose width
+/// grows with their magnitude, in the spirit of HDR histograms: values below 8
+/// microseconds are recorded exactly and larger values are recorded with a
+/// relative error of at most 12.5%.  This keeps the histogram small regardless
+/// of the number and the range of the recorded values, while the minimum, the
+/// maximum and the total of the values are tracked exactly.
+class latency_histogram {
+    /// Number of values recorded in each bucket, indexed by bucket.
+    std::vector< std::size_t > _counts;
+
+    /// Total number of recorded values.
+    std::size_t _count;
+
+    /// Smallest recorded value in microseconds.
+    int64_t _min;
+
+    /// Largest recorded value in microseconds.
+    int64_t _max;
+
+    /// Sum of all recorded values in microseconds.
+    int64_t _total;
+
+public:
+    /// Mapping of inclusive bucket upper bounds, in microseconds, to counts.
+    typedef std::map< int64_t, std::size_t > buckets_map;
+
+    latency_histogram(void);
+
+    void record(const datetime::delta&);
+    void record_interval(const datetime::timestamp&,
+                         const datetime::timestamp&);
+    void merge(const latency_histogram&);
+
+    std::size_t count(void) const;
+    datetime::delta min(void) const;
+    datetime::delta max(void) const;
+    datetime::delta total(void) const;
+    datetime::delta mean(void) const;
+    datetime::delta percentile(const double) const;
+    buckets_map buckets(void) const;
+};
+
+
+}  // namespace utils
+
+#endif  // !defined(UTILS_LATENCY_HISTOGRAM_HPP)
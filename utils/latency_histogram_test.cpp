@@ -0,0 +1,182 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "utils/latency_histogram.hpp"
+
+#include <atf-c++.hpp>
+
+#include "utils/datetime.hpp"
+
+namespace datetime = utils::datetime;
+
+
+namespace {
+
+
+/// Shorthand to build a delta from microseconds.
+///
+/// \param usecs The number of microseconds.
+///
+/// \return A time delta.
+static datetime::delta
+us(const int64_t usecs)
+{
+    return datetime::delta::from_microseconds(usecs);
+}
+
+
+}  // anonymous namespace
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(empty);
+ATF_TEST_CASE_BODY(empty)
+{
+    const utils::latency_histogram histogram;
+    ATF_REQUIRE_EQ(0, histogram.count());
+    ATF_REQUIRE_EQ(us(0), histogram.total());
+    ATF_REQUIRE(histogram.buckets().empty());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(record__exact_statistics);
+ATF_TEST_CASE_BODY(record__exact_statistics)
+{
+    utils::latency_histogram histogram;
+    histogram.record(us(1000));
+    histogram.record(us(3));
+    histogram.record(us(2000000));
+
+    ATF_REQUIRE_EQ(3, histogram.count());
+    ATF_REQUIRE_EQ(us(3), histogram.min());
+    ATF_REQUIRE_EQ(us(2000000), histogram.max());
+    ATF_REQUIRE_EQ(us(2001003), histogram.total());
+    ATF_REQUIRE_EQ(us(667001), histogram.mean());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(record_interval);
+ATF_TEST_CASE_BODY(record_interval)
+{
+    const datetime::timestamp start = datetime::timestamp::from_values(
+        2026, 10, 14, 12, 0, 0, 0);
+    const datetime::timestamp end = start + us(2500);
+
+    utils::latency_histogram histogram;
+    histogram.record_interval(start, end);
+    histogram.record_interval(end, start);
+    ATF_REQUIRE_EQ(2, histogram.count());
+    ATF_REQUIRE_EQ(us(0), histogram.min());
+    ATF_REQUIRE_EQ(us(2500), histogram.max());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(buckets__small_values_exact);
+ATF_TEST_CASE_BODY(buckets__small_values_exact)
+{
+    utils::latency_histogram histogram;
+    for (int64_t i = 0; i < 8; ++i)
+        histogram.record(us(i));
+    histogram.record(us(5));
+
+    utils::latency_histogram::buckets_map exp_buckets;
+    for (int64_t i = 0; i < 8; ++i)
+        exp_buckets[i] = (i == 5) ? 2 : 1;
+    ATF_REQUIRE(exp_buckets == histogram.buckets());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(buckets__bounded_error);
+ATF_TEST_CASE_BODY(buckets__bounded_error)
+{
+    for (int64_t value = 1; value < 100000000; value = value * 3 + 1) {
+        utils::latency_histogram histogram;
+        histogram.record(us(value));
+        const utils::latency_histogram::buckets_map buckets =
+            histogram.buckets();
+        ATF_REQUIRE_EQ(1, buckets.size());
+        const int64_t upper = (*buckets.begin()).first;
+        ATF_REQUIRE(upper >= value);
+        ATF_REQUIRE(upper - value <= value / 8);
+    }
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(percentile);
+ATF_TEST_CASE_BODY(percentile)
+{
+    utils::latency_histogram histogram;
+    for (int64_t i = 1; i <= 100; ++i)
+        histogram.record(us(i * 1000));
+
+    ATF_REQUIRE_EQ(us(1000), histogram.percentile(0));
+    ATF_REQUIRE(histogram.percentile(50) >= us(50000));
+    ATF_REQUIRE(histogram.percentile(50) <= us(50000 + 50000 / 8));
+    ATF_REQUIRE(histogram.percentile(99) >= us(99000));
+    ATF_REQUIRE_EQ(us(100000), histogram.percentile(100));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(merge);
+ATF_TEST_CASE_BODY(merge)
+{
+    utils::latency_histogram histogram1;
+    histogram1.record(us(10));
+    histogram1.record(us(500));
+
+    utils::latency_histogram histogram2;
+    histogram2.record(us(1));
+    histogram2.record(us(500));
+    histogram2.record(us(90000));
+
+    histogram1.merge(histogram2);
+    histogram1.merge(utils::latency_histogram());
+    ATF_REQUIRE_EQ(5, histogram1.count());
+    ATF_REQUIRE_EQ(us(1), histogram1.min());
+    ATF_REQUIRE_EQ(us(90000), histogram1.max());
+    ATF_REQUIRE_EQ(us(91011), histogram1.total());
+
+    std::size_t total = 0;
+    const utils::latency_histogram::buckets_map buckets =
+        histogram1.buckets();
+    for (utils::latency_histogram::buckets_map::const_iterator iter =
+             buckets.begin(); iter != buckets.end(); ++iter)
+        total += (*iter).second;
+    ATF_REQUIRE_EQ(5, total);
+}
+
+
+ATF_INIT_TEST_CASES(tcs)
+{
+    ATF_ADD_TEST_CASE(tcs, empty);
+    ATF_ADD_TEST_CASE(tcs, record__exact_statistics);
+    ATF_ADD_TEST_CASE(tcs, record_interval);
+    ATF_ADD_TEST_CASE(tcs, buckets__small_values_exact);
+    ATF_ADD_TEST_CASE(tcs, buckets__bounded_error);
+    ATF_ADD_TEST_CASE(tcs, percentile);
+    ATF_ADD_TEST_CASE(tcs, merge);
+}
@@ -0,0 +1,348 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "utils/load.hpp"
+
+#if defined(HAVE_CONFIG_H)
+#   include "config.h"
+#endif
+
+extern "C" {
+#if defined(HAVE_SCHED_GETAFFINITY)
+#   include <sched.h>
+#endif
+#include <stdlib.h>
+#include <unistd.h>
+}
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "utils/cgroup.hpp"
+#include "utils/format/macros.hpp"
+#include "utils/fs/directory.hpp"
+#include "utils/fs/exceptions.hpp"
+#include "utils/fs/path.hpp"
+#include "utils/logging/macros.hpp"
+#include "utils/optional.ipp"
+#include "utils/sanity.hpp"
+#include "utils/text/exceptions.hpp"
+#include "utils/text/operations.ipp"
+
+namespace fs = utils::fs;
+namespace text = utils::text;
+
+using utils::none;
+using utils::optional;
+
+
+namespace {
+
+
+/// Path to the file that exposes the CPU pressure stall information on Linux.
+static const char* cpu_pressure_path = "/proc/pressure/cpu";
+
+
+/// Path to the directory that describes the NUMA nodes on Linux.
+static const char* numa_nodes_path = "/sys/devices/system/node";
+
+
+/// Reads the first line of a file.
+///
+/// \param file The file to read.
+///
+/// \return The first line of the file, or none if the file cannot be read.
+static optional< std::string >
+read_first_line(const fs::path& file)
+{
+    std::ifstream input(file.c_str());
+    if (!input)
+        return none;
+    std::string line;
+    if (!std::getline(input, line))
+        return none;
+    return utils::make_optional(line);
+}
+
+
+}  // anonymous namespace
+
+
+/// Parses a list of CPUs in the format used by Linux.
+///
+/// The format is a comma-separated list of CPU numbers or of ranges of CPU
+/// numbers, such as "0-3,8,10-11".
+///
+/// \param raw_list The list to parse.
+///
+/// \return The CPUs in the list.
+///
+/// \throw text::value_error If the list is malformed.
+std::set< int >
+utils::detail::parse_cpu_list(const std::string& raw_list)
+{
+    std::set< int > cpus;
+    if (raw_list.empty())
+        return cpus;
+
+    const std::vector< std::string > items = text::split(raw_list, ',');
+    for (std::vector< std::string >::const_iterator iter = items.begin();
+         iter != items.end(); ++iter) {
+        const std::string::size_type dash = (*iter).find('-');
+        const int first = text::to_type< int >((*iter).substr(0, dash));
+        const int last = dash == std::string::npos ?
+            first : text::to_type< int >((*iter).substr(dash + 1));
+        if (first < 0 || last < first)
+            throw text::value_error(F("Invalid CPU range '%s'") % *iter);
+        for (int cpu = first; cpu <= last; ++cpu)
+            cpus.insert(cpu);
+    }
+    return cpus;
+}
+
+
+/// Formats a set of CPUs in the format used by Linux.
+///
+/// \param cpus The CPUs to format.
+///
+/// \return A comma-separated list of CPU numbers or ranges of CPU numbers,
+/// such as "0-3,8,10-11".
+std::string
+utils::format_cpu_list(const std::set< int >& cpus)
+{
+    std::string list;
+    std::set< int >::const_iterator iter = cpus.begin();
+    while (iter != cpus.end()) {
+        const int first = *iter;
+        int last = first;
+        for (++iter; iter != cpus.end() && *iter == last + 1; ++iter)
+            last = *iter;
+
+        if (!list.empty())
+            list += ",";
+        if (first == last)
+            list += F("%s") % first;
+        else
+            list += F("%s-%s") % first % last;
+    }
+    return list;
+}
+
+
+/// Parses the contents of a pressure stall information file.
+///
+/// The input is expected to follow the format of the files in /proc/pressure,
+/// whose first line looks like "some avg10=1.23 avg60=0.50 avg300=0.10
+/// total=12345".
+///
+/// \param input The stream from which to read the contents of the file.
+///
+/// \return The percentage of time in the last 10 seconds during which at least
+/// one task was stalled waiting for the resource, or none if the input is
+/// not valid.
+optional< double >
+utils::detail::parse_pressure(std::istream& input)
+{
+    std::string line;
+    std::vector< std::string > fields;
+    while (std::getline(input, line)) {
+        text::split(line, ' ', fields);
+        if (fields.empty() || fields[0] != "some")
+            continue;
+
+        for (std::vector< std::string >::const_iterator iter =
+                 fields.begin() + 1; iter != fields.end(); ++iter) {
+            if ((*iter).find("avg10=") != 0)
+                continue;
+            try {
+                return utils::make_optional(
+                    text::to_type< double >((*iter).substr(6)));
+            } catch (const text::value_error& e) {
+                LW(F("Invalid pressure value '%s'") % *iter);
+                return none;
+            }
+        }
+    }
+    return none;
+}
+
+
+/// Queries the number of CPUs that are available to run processes.
+///
+/// \return The number of online CPUs, which is always at least 1 even if the
+/// system cannot tell.
+std::size_t
+utils::online_cpus(void)
+{
+    const long cpus = ::sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus < 1) {
+        LW("Cannot query the number of online CPUs; assuming 1");
+        return 1;
+    }
+    return static_cast< std::size_t >(cpus);
+}
+
+
+/// Queries the CPUs on which the current process is allowed to run.
+///
+/// \return The CPUs in the affinity mask of the current process if the system
+/// supports querying it, or all online CPUs otherwise.
+std::set< int >
+utils::available_cpus(void)
+{
+    std::set< int > cpus;
+#if defined(HAVE_SCHED_GETAFFINITY)
+    ::cpu_set_t mask;
+    CPU_ZERO(&mask);
+    if (::sched_getaffinity(0, sizeof(mask), &mask) != -1) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &mask))
+                cpus.insert(cpu);
+        }
+    }
+#endif
+    if (cpus.empty()) {
+        const int count = static_cast< int >(online_cpus());
+        for (int cpu = 0; cpu < count; ++cpu)
+            cpus.insert(cpu);
+    }
+    POST(!cpus.empty());
+    return cpus;
+}
+
+
+/// Queries the number of CPUs whose time the current process can consume.
+///
+/// This is the number of CPUs in the affinity mask of the process, further
+/// limited by the CPU quota of its control group, rounded up, when running
+/// within a container.  This is the right figure to size the parallelism of
+/// the process with, as opposed to the number of online CPUs of the host.
+///
+/// \return The number of usable CPUs, which is always at least 1.
+std::size_t
+utils::usable_cpus(void)
+{
+    std::size_t cpus = available_cpus().size();
+    const optional< double > quota = cgroup_cpu_quota();
+    if (quota) {
+        const std::size_t limit = std::max(
+            static_cast< std::size_t >(std::ceil(quota.get())),
+            static_cast< std::size_t >(1));
+        cpus = std::min(cpus, limit);
+    }
+    POST(cpus > 0);
+    return cpus;
+}
+
+
+/// Queries the CPUs available to the current process grouped by NUMA node.
+///
+/// \return The available CPUs of every NUMA node that has any, keyed by node
+/// number.  If the system does not describe its NUMA nodes, this returns a
+/// single node 0 with all the available CPUs.
+std::map< int, std::set< int > >
+utils::numa_nodes(void)
+{
+    const std::set< int > available = available_cpus();
+
+    std::map< int, std::set< int > > nodes;
+    try {
+        const fs::directory dir((fs::path(numa_nodes_path)));
+        for (fs::directory::const_iterator iter = dir.begin();
+             iter != dir.end(); ++iter) {
+            if (iter->name.find("node") != 0)
+                continue;
+
+            int node;
+            try {
+                node = text::to_type< int >(iter->name.substr(4));
+            } catch (const text::value_error& e) {
+                continue;
+            }
+
+            const optional< std::string > raw_list = read_first_line(
+                fs::path(numa_nodes_path) / iter->name / "cpulist");
+            if (!raw_list)
+                continue;
+
+            std::set< int > cpus;
+            try {
+                cpus = detail::parse_cpu_list(raw_list.get());
+            } catch (const text::value_error& e) {
+                LW(F("Ignoring NUMA node %s: %s") % node % e.what());
+                continue;
+            }
+            for (std::set< int >::const_iterator cpu = cpus.begin();
+                 cpu != cpus.end(); ++cpu) {
+                if (available.find(*cpu) != available.end())
+                    nodes[node].insert(*cpu);
+            }
+        }
+    } catch (const fs::error& e) {
+        LD(F("Cannot query the NUMA nodes: %s") % e.what());
+    }
+
+    if (nodes.empty())
+        nodes[0] = available;
+    return nodes;
+}
+
+
+/// Queries the 1-minute load average of the system.
+///
+/// \return The number of runnable processes averaged over the last minute, or
+/// none if the system cannot tell.
+optional< double >
+utils::load_average(void)
+{
+#if defined(HAVE_GETLOADAVG)
+    double loads[1];
+    if (::getloadavg(loads, 1) == 1)
+        return utils::make_optional(loads[0]);
+#endif
+    return none;
+}
+
+
+/// Queries the CPU pressure stall information of the system.
+///
+/// \return The percentage of time in the last 10 seconds during which at least
+/// one runnable task could not get a CPU, or none if the system does not
+/// provide this information.
+optional< double >
+utils::cpu_pressure(void)
+{
+    std::ifstream input(cpu_pressure_path);
+    if (!input)
+        return none;
+    return detail::parse_pressure(input);
+}
@@ -0,0 +1,217 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "utils/load.hpp"
+
+#include <sstream>
+
+#include <atf-c++.hpp>
+
+#include "utils/optional.ipp"
+#include "utils/text/exceptions.hpp"
+
+namespace text = utils::text;
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(online_cpus);
+ATF_TEST_CASE_BODY(online_cpus)
+{
+    const std::size_t cpus = utils::online_cpus();
+    ATF_REQUIRE(cpus >= 1);
+    ATF_REQUIRE(cpus < 100000);  // Large enough for now...
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(available_cpus);
+ATF_TEST_CASE_BODY(available_cpus)
+{
+    const std::set< int > cpus = utils::available_cpus();
+    ATF_REQUIRE(!cpus.empty());
+    ATF_REQUIRE(*cpus.begin() >= 0);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(usable_cpus);
+ATF_TEST_CASE_BODY(usable_cpus)
+{
+    const std::size_t cpus = utils::usable_cpus();
+    ATF_REQUIRE(cpus >= 1);
+    ATF_REQUIRE(cpus <= utils::available_cpus().size());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(numa_nodes);
+ATF_TEST_CASE_BODY(numa_nodes)
+{
+    const std::set< int > available = utils::available_cpus();
+    const std::map< int, std::set< int > > nodes = utils::numa_nodes();
+    ATF_REQUIRE(!nodes.empty());
+
+    std::set< int > all_cpus;
+    for (std::map< int, std::set< int > >::const_iterator iter = nodes.begin();
+         iter != nodes.end(); ++iter) {
+        ATF_REQUIRE(!(*iter).second.empty());
+        for (std::set< int >::const_iterator cpu = (*iter).second.begin();
+             cpu != (*iter).second.end(); ++cpu) {
+            ATF_REQUIRE(available.find(*cpu) != available.end());
+            ATF_REQUIRE(all_cpus.insert(*cpu).second);
+        }
+    }
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(format_cpu_list);
+ATF_TEST_CASE_BODY(format_cpu_list)
+{
+    std::set< int > cpus;
+    ATF_REQUIRE_EQ("", utils::format_cpu_list(cpus));
+    cpus.insert(5);
+    ATF_REQUIRE_EQ("5", utils::format_cpu_list(cpus));
+    cpus.insert(0);
+    cpus.insert(1);
+    cpus.insert(2);
+    cpus.insert(7);
+    cpus.insert(8);
+    ATF_REQUIRE_EQ("0-2,5,7-8", utils::format_cpu_list(cpus));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(parse_cpu_list__ok);
+ATF_TEST_CASE_BODY(parse_cpu_list__ok)
+{
+    ATF_REQUIRE(utils::detail::parse_cpu_list("").empty());
+
+    std::set< int > exp_cpus;
+    exp_cpus.insert(0);
+    exp_cpus.insert(1);
+    exp_cpus.insert(2);
+    exp_cpus.insert(5);
+    exp_cpus.insert(7);
+    exp_cpus.insert(8);
+    ATF_REQUIRE(exp_cpus == utils::detail::parse_cpu_list("0-2,5,7-8"));
+    ATF_REQUIRE_EQ("0-2,5,7-8",
+                   utils::format_cpu_list(utils::detail::parse_cpu_list(
+                       "0-2,5,7-8")));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(parse_cpu_list__invalid);
+ATF_TEST_CASE_BODY(parse_cpu_list__invalid)
+{
+    ATF_REQUIRE_THROW(text::value_error,
+                      utils::detail::parse_cpu_list("a"));
+    ATF_REQUIRE_THROW(text::value_error,
+                      utils::detail::parse_cpu_list("1,,2"));
+    ATF_REQUIRE_THROW_RE(text::value_error, "Invalid CPU range '3-1'",
+                         utils::detail::parse_cpu_list("3-1"));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(load_average);
+ATF_TEST_CASE_BODY(load_average)
+{
+    const utils::optional< double > load = utils::load_average();
+    if (load)
+        ATF_REQUIRE(load.get() >= 0.0);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(cpu_pressure);
+ATF_TEST_CASE_BODY(cpu_pressure)
+{
+    const utils::optional< double > pressure = utils::cpu_pressure();
+    if (pressure) {
+        ATF_REQUIRE(pressure.get() >= 0.0);
+        ATF_REQUIRE(pressure.get() <= 100.0);
+    }
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(parse_pressure__ok);
+ATF_TEST_CASE_BODY(parse_pressure__ok)
+{
+    std::istringstream input(
+        "some avg10=12.50 avg60=3.00 avg300=0.75 total=123456\n"
+        "full avg10=1.00 avg60=0.00 avg300=0.00 total=1234\n");
+    const utils::optional< double > pressure =
+        utils::detail::parse_pressure(input);
+    ATF_REQUIRE(pressure);
+    ATF_REQUIRE_EQ(12.5, pressure.get());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(parse_pressure__no_newline);
+ATF_TEST_CASE_BODY(parse_pressure__no_newline)
+{
+    std::istringstream input("some avg10=0.25 avg60=0.00");
+    const utils::optional< double > pressure =
+        utils::detail::parse_pressure(input);
+    ATF_REQUIRE(pressure);
+    ATF_REQUIRE_EQ(0.25, pressure.get());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(parse_pressure__invalid);
+ATF_TEST_CASE_BODY(parse_pressure__invalid)
+{
+    {
+        std::istringstream input("");
+        ATF_REQUIRE(!utils::detail::parse_pressure(input));
+    }
+    {
+        std::istringstream input("full avg10=1.00 avg60=0.00\n");
+        ATF_REQUIRE(!utils::detail::parse_pressure(input));
+    }
+    {
+        std::istringstream input("some avg60=1.00\n");
+        ATF_REQUIRE(!utils::detail::parse_pressure(input));
+    }
+    {
+        std::istringstream input("some avg10=abc avg60=1.00\n");
+        ATF_REQUIRE(!utils::detail::parse_pressure(input));
+    }
+}
+
+
+ATF_INIT_TEST_CASES(tcs)
+{
+    ATF_ADD_TEST_CASE(tcs, online_cpus);
+    ATF_ADD_TEST_CASE(tcs, available_cpus);
+    ATF_ADD_TEST_CASE(tcs, usable_cpus);
+    ATF_ADD_TEST_CASE(tcs, numa_nodes);
+    ATF_ADD_TEST_CASE(tcs, load_average);
+    ATF_ADD_TEST_CASE(tcs, cpu_pressure);
+
+    ATF_ADD_TEST_CASE(tcs, format_cpu_list);
+    ATF_ADD_TEST_CASE(tcs, parse_cpu_list__ok);
+    ATF_ADD_TEST_CASE(tcs, parse_cpu_list__invalid);
+
+    ATF_ADD_TEST_CASE(tcs, parse_pressure__ok);
+    ATF_ADD_TEST_CASE(tcs, parse_pressure__no_newline);
+    ATF_ADD_TEST_CASE(tcs, parse_pressure__invalid);
+}
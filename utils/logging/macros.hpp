@@ -37,32 +37,53 @@
 #include "utils/logging/operations.hpp"
 
 
+#if !defined(UTILS_LOGGING_MAX_LEVEL)
+/// Least severe level of the messages that are compiled in.
+///
+/// Messages of less severe levels are discarded at compile time, so they cost
+/// nothing at run time regardless of the log level chosen by the user.  The
+/// build can redefine this to any of the values of utils::logging::level.
+#   define UTILS_LOGGING_MAX_LEVEL utils::logging::level_debug
+#endif
+
+
+/// Logs a message if its level is enabled.
+///
+/// The message is only evaluated if it is going to be recorded, so it is fine
+/// to compose it with expensive operations such as F().
+///
+/// \param level The level of the message.
+/// \param message The message to log.
+#define UTILS_LOGGING_LOG(level, message) \
+    do { \
+        if ((level) <= UTILS_LOGGING_MAX_LEVEL && \
+            utils::logging::is_enabled(level)) \
+            utils::logging::log((level), __FILE__, __LINE__, (message)); \
+    } while (false)
+
+
 /// Logs a debug message.
 ///
 /// \param message The message to log.
-#define LD(message) utils::logging::log(utils::logging::level_debug, \
-                                        __FILE__, __LINE__, message)
+#define LD(message) UTILS_LOGGING_LOG(utils::logging::level_debug, message)
 
 
 /// Logs an error message.
 ///
 /// \param message The message to log.
-#define LE(message) utils::logging::log(utils::logging::level_error, \
-                                        __FILE__, __LINE__, message)
+#define LE(message) UTILS_LOGGING_LOG(utils::logging::level_error, message)
 
 
 /// Logs an informational message.
 ///
 /// \param message The message to log.
-#define LI(message) utils::logging::log(utils::logging::level_info, \
-                                        __FILE__, __LINE__, message)
+#define LI(message) UTILS_LOGGING_LOG(utils::logging::level_info, message)
 
 
 /// Logs a warning message.
 ///
 /// \param message The message to log.
-#define LW(message) utils::logging::log(utils::logging::level_warning, \
-                                        __FILE__, __LINE__, message)
+#define LW(message) UTILS_LOGGING_LOG(utils::logging::level_warning, message)
 
 
 #endif  // !defined(UTILS_LOGGING_MACROS_HPP)
@@ -106,10 +106,81 @@ ATF_TEST_CASE_BODY(lw)
 }
 
 
+namespace {
+
+
+/// Number of times that count_evaluation() has been called.
+static int evaluations = 0;
+
+
+/// Records that a log message has been built.
+///
+/// \param message The message to return.
+///
+/// \return The input message.
+static std::string
+count_evaluation(const std::string& message)
+{
+    ++evaluations;
+    return message;
+}
+
+
+}  // anonymous namespace
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(disabled_level_is_not_evaluated);
+ATF_TEST_CASE_BODY(disabled_level_is_not_evaluated)
+{
+    logging::set_persistency("warning", fs::path("test.log"));
+    datetime::set_mock_now(2011, 2, 21, 18, 30, 0, 0);
+    LD(count_evaluation("Debug message"));
+    LI(count_evaluation("Info message"));
+    ATF_REQUIRE_EQ(0, evaluations);
+    LW(count_evaluation("Warning message"));
+    LE(count_evaluation("Error message"));
+    ATF_REQUIRE_EQ(2, evaluations);
+
+    std::ifstream input("test.log");
+    ATF_REQUIRE(input);
+
+    std::string line;
+    ATF_REQUIRE(std::getline(input, line).good());
+    ATF_REQUIRE_MATCH("20110221-183000 W .*: Warning message", line);
+    ATF_REQUIRE(std::getline(input, line).good());
+    ATF_REQUIRE_MATCH("20110221-183000 E .*: Error message", line);
+    ATF_REQUIRE(!std::getline(input, line));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(single_statement);
+ATF_TEST_CASE_BODY(single_statement)
+{
+    logging::set_persistency("debug", fs::path("test.log"));
+    datetime::set_mock_now(2011, 2, 21, 18, 30, 0, 0);
+    bool other_branch = false;
+    if (evaluations == 0)
+        LI("Info message");
+    else
+        other_branch = true;
+    ATF_REQUIRE(!other_branch);
+
+    std::ifstream input("test.log");
+    ATF_REQUIRE(input);
+
+    std::string line;
+    ATF_REQUIRE(std::getline(input, line).good());
+    ATF_REQUIRE_MATCH("20110221-183000 I .*: Info message", line);
+}
+
+
 ATF_INIT_TEST_CASES(tcs)
 {
     ATF_ADD_TEST_CASE(tcs, ld);
     ATF_ADD_TEST_CASE(tcs, le);
     ATF_ADD_TEST_CASE(tcs, li);
     ATF_ADD_TEST_CASE(tcs, lw);
+
+    ATF_ADD_TEST_CASE(tcs, disabled_level_is_not_evaluated);
+    ATF_ADD_TEST_CASE(tcs, single_statement);
 }
@@ -32,6 +32,7 @@ extern "C" {
 #include <unistd.h>
 }
 
+#include <cstdlib>
 #include <stdexcept>
 #include <string>
 #include <utility>
@@ -90,6 +91,10 @@ namespace {
 static const char* timestamp_format = "%Y%m%d-%H%M%S";
 
 
+/// Maximum time, in microseconds, that a buffered entry waits to be written.
+static const int64_t max_buffered_time = 1000000;
+
+
 /// Mutable global state.
 struct global_state {
     /// Current log level.
@@ -107,9 +112,28 @@ struct global_state {
     /// Stream to the currently open log file.
     std::auto_ptr< std::ostream > logfile;
 
+    /// Maximum size of the pending buffer; 0 writes every entry right away.
+    std::size_t buffer_size;
+
+    /// Formatted entries not yet written to the log file.
+    std::string pending;
+
+    /// PID of the process that owns the pending buffer.
+    ///
+    /// A forked child inherits a copy of the buffer of its parent, which the
+    /// parent will write on its own.  The child detects this by comparing its
+    /// PID to this value and discards the copy.
+    pid_t pending_owner;
+
+    /// Time of the last write to the log file, in microseconds.
+    int64_t last_write;
+
     global_state() :
         log_level(logging::level_debug),
-        auto_set_persistency(true)
+        auto_set_persistency(true),
+        buffer_size(0),
+        pending_owner(0),
+        last_write(0)
     {
     }
 };
@@ -158,9 +182,56 @@ level_to_char(const logging::level level)
 }
 
 
+/// Writes the pending log entries, if any, to the log file.
+///
+/// \param globals The global state of the module.
+/// \param now The current time.
+static void
+write_pending(struct global_state* globals, const datetime::timestamp& now)
+{
+    PRE(globals->logfile.get() != NULL);
+
+    globals->last_write = now.to_microseconds();
+    if (globals->pending.empty())
+        return;
+    globals->logfile->write(globals->pending.c_str(),
+                            globals->pending.length());
+    globals->logfile->flush();
+    globals->pending.clear();
+}
+
+
+/// Writes any buffered log entries before the program exits.
+static void
+flush_at_exit(void)
+{
+    logging::flush();
+}
+
+
 }  // anonymous namespace
 
 
+/// Writes any buffered log entries to the log file.
+///
+/// This is a no-op unless the log was made persistent with a buffer.  Callers
+/// should use this before operations that may lose the buffer, such as forking
+/// a child that may log or terminating the process abruptly.
+void
+logging::flush(void)
+{
+    struct global_state* globals = get_globals();
+
+    if (globals->logfile.get() == NULL)
+        return;
+    if (globals->pending_owner != ::getpid()) {
+        globals->pending.clear();
+        return;
+    }
+    write_pending(globals, datetime::timestamp::now());
+}
+
+
 /// Generates a standard log name.
 ///
 /// This always adds the same timestamp to the log name for a particular run.
@@ -183,10 +254,29 @@ logging::generate_log_name(const fs::path& logdir, const std::string& progname)
 }
 
 
+/// Checks whether messages of a given level are recorded.
+///
+/// Messages are always recorded while the log is in memory, because the level
+/// is not known until set_persistency() is called.
+///
+/// \param message_level The level to check.
+///
+/// \return True if log() would record a message of the given level; false if
+/// it would discard it.
+bool
+logging::is_enabled(const level message_level)
+{
+    return message_level <= get_globals()->log_level;
+}
+
+
 /// Logs an entry to the log file.
 ///
 /// If the log is not yet set to persistent mode, the entry is recorded in the
-/// in-memory backlog.  Otherwise, it is just written to disk.
+/// in-memory backlog.  Otherwise, it is written to disk.  If the log was set up
+/// with a buffer, entries are accumulated and written in batches: whenever the
+/// buffer fills up, when a warning or an error is logged, or when the oldest
+/// entry has been waiting for more than a second.
 ///
 /// \param message_level The level of the entry.
 /// \param file The file from which the log message is generated.
@@ -215,15 +305,35 @@ logging::log(const level message_level, const char* file, const int line,
         return;
 
     // Update doc/troubleshooting.texi if you change the log format.
+    const pid_t pid = ::getpid();
     const std::string message = F("%s %s %s %s:%s: %s") %
         now.strftime(timestamp_format) % level_to_char(message_level) %
-        ::getpid() % file % line % user_message;
+        pid % file % line % user_message;
     if (globals->logfile.get() == NULL)
         globals->backlog.push_back(std::make_pair(message_level, message));
-    else {
+    else if (globals->buffer_size == 0) {
         INV(globals->backlog.empty());
         (*globals->logfile) << message << '\n';
         globals->logfile->flush();
+    } else {
+        INV(globals->backlog.empty());
+        if (globals->pending_owner != pid) {
+            // We are a forked child: the inherited entries belong to our
+            // parent and we do not want to buffer our own because we will
+            // most likely exec or exit without flushing.
+            globals->pending.clear();
+            globals->buffer_size = 0;
+            (*globals->logfile) << message << '\n';
+            globals->logfile->flush();
+            return;
+        }
+
+        globals->pending += message;
+        globals->pending += '\n';
+        if (globals->pending.length() >= globals->buffer_size ||
+            message_level <= level_warning ||
+            now.to_microseconds() - globals->last_write >= max_buffered_time)
+            write_pending(globals, now);
     }
 }
 
@@ -241,8 +351,10 @@ logging::set_inmemory(void)
 
     if (globals->logfile.get() != NULL) {
         INV(globals->backlog.empty());
+        flush();
         globals->logfile->flush();
         globals->logfile.reset(NULL);
+        globals->buffer_size = 0;
     }
 }
 
@@ -257,13 +369,22 @@ logging::set_inmemory(void)
 ///
 /// Any log entries above the provided new_level are discarded.
 ///
+/// By default, every entry is written to disk as soon as it is logged.  A
+/// non-zero buffer_size makes the module accumulate entries in memory and write
+/// them in batches instead, which is much cheaper when the log level is debug.
+/// The buffer never grows past this size: a full buffer is written to disk
+/// synchronously.  Entries buffered at exit are written automatically but all
+/// other paths that lose the process image should call flush() first.
+///
 /// \param new_level The new log level.
 /// \param path The file to write the logs to.
+/// \param buffer_size Amount of bytes to buffer before writing to disk.
 ///
 /// \throw std::range_error If the given log level is invalid.
 /// \throw std::runtime_error If the given file cannot be created.
 void
-logging::set_persistency(const std::string& new_level, const fs::path& path)
+logging::set_persistency(const std::string& new_level, const fs::path& path,
+                         const std::size_t buffer_size)
 {
     struct global_state* globals = get_globals();
 
@@ -297,4 +418,16 @@ logging::set_persistency(const std::string& new_level, const fs::path& path)
     }
     globals->logfile->flush();
     globals->backlog.clear();
+
+    globals->buffer_size = buffer_size;
+    globals->pending.clear();
+    globals->pending_owner = ::getpid();
+    globals->last_write = datetime::timestamp::now().to_microseconds();
+    if (buffer_size > 0) {
+        static bool atexit_registered = false;
+        if (!atexit_registered) {
+            std::atexit(flush_at_exit);
+            atexit_registered = true;
+        }
+    }
 }
@@ -29,11 +29,15 @@
 #include "utils/logging/operations.hpp"
 
 extern "C" {
+#include <sys/wait.h>
+
 #include <unistd.h>
 }
 
+#include <cstdlib>
 #include <fstream>
 #include <string>
+#include <vector>
 
 #include <atf-c++.hpp>
 
@@ -124,6 +128,28 @@ ATF_TEST_CASE_BODY(log)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(is_enabled__inmemory);
+ATF_TEST_CASE_BODY(is_enabled__inmemory)
+{
+    logging::set_inmemory();
+    ATF_REQUIRE(logging::is_enabled(logging::level_error));
+    ATF_REQUIRE(logging::is_enabled(logging::level_warning));
+    ATF_REQUIRE(logging::is_enabled(logging::level_info));
+    ATF_REQUIRE(logging::is_enabled(logging::level_debug));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(is_enabled__persistent);
+ATF_TEST_CASE_BODY(is_enabled__persistent)
+{
+    logging::set_persistency("info", fs::path("test.log"));
+    ATF_REQUIRE(logging::is_enabled(logging::level_error));
+    ATF_REQUIRE(logging::is_enabled(logging::level_warning));
+    ATF_REQUIRE(logging::is_enabled(logging::level_info));
+    ATF_REQUIRE(!logging::is_enabled(logging::level_debug));
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(set_inmemory__reset);
 ATF_TEST_CASE_BODY(set_inmemory__reset)
 {
@@ -319,6 +345,137 @@ ATF_TEST_CASE_BODY(set_persistency__some_backlog__warning)
 }
 
 
+/// Reads all the lines of a file.
+///
+/// \param path The file to read.
+///
+/// \return The lines in the file, without their trailing newlines.
+static std::vector< std::string >
+read_lines(const char* path)
+{
+    std::vector< std::string > lines;
+    std::ifstream input(path);
+    ATF_REQUIRE(input);
+    std::string line;
+    while (std::getline(input, line).good())
+        lines.push_back(line);
+    return lines;
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(set_persistency__buffered__flush);
+ATF_TEST_CASE_BODY(set_persistency__buffered__flush)
+{
+    datetime::set_mock_now(2011, 2, 21, 18, 20, 0, 0);
+    logging::set_persistency("debug", fs::path("test.log"), 1024);
+
+    logging::log(logging::level_debug, "file", 123, "Debug message");
+    ATF_REQUIRE(read_lines("test.log").empty());
+
+    logging::flush();
+    const std::vector< std::string > lines = read_lines("test.log");
+    ATF_REQUIRE_EQ(1, lines.size());
+    ATF_REQUIRE_EQ(
+        (F("20110221-182000 D %s file:123: Debug message") % ::getpid()).str(),
+        lines[0]);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(set_persistency__buffered__full);
+ATF_TEST_CASE_BODY(set_persistency__buffered__full)
+{
+    datetime::set_mock_now(2011, 2, 21, 18, 20, 0, 0);
+    logging::set_persistency("debug", fs::path("test.log"), 90);
+
+    logging::log(logging::level_debug, "file", 123, "Debug message 1");
+    ATF_REQUIRE(read_lines("test.log").empty());
+    logging::log(logging::level_debug, "file", 123, "Debug message 2");
+    ATF_REQUIRE_EQ(2, read_lines("test.log").size());
+    logging::log(logging::level_debug, "file", 123, "Debug message 3");
+    ATF_REQUIRE_EQ(2, read_lines("test.log").size());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(set_persistency__buffered__warning);
+ATF_TEST_CASE_BODY(set_persistency__buffered__warning)
+{
+    datetime::set_mock_now(2011, 2, 21, 18, 20, 0, 0);
+    logging::set_persistency("debug", fs::path("test.log"), 1024);
+
+    logging::log(logging::level_debug, "file", 123, "Debug message");
+    logging::log(logging::level_info, "file", 123, "Info message");
+    ATF_REQUIRE(read_lines("test.log").empty());
+    logging::log(logging::level_warning, "file", 123, "Warning message");
+
+    const std::vector< std::string > lines = read_lines("test.log");
+    ATF_REQUIRE_EQ(3, lines.size());
+    ATF_REQUIRE_MATCH("D .*Debug message$", lines[0]);
+    ATF_REQUIRE_MATCH("I .*Info message$", lines[1]);
+    ATF_REQUIRE_MATCH("W .*Warning message$", lines[2]);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(set_persistency__buffered__timeout);
+ATF_TEST_CASE_BODY(set_persistency__buffered__timeout)
+{
+    datetime::set_mock_now(2011, 2, 21, 18, 20, 0, 0);
+    logging::set_persistency("debug", fs::path("test.log"), 1024);
+
+    logging::log(logging::level_debug, "file", 123, "Debug message 1");
+    datetime::set_mock_now(2011, 2, 21, 18, 20, 0, 999999);
+    logging::log(logging::level_debug, "file", 123, "Debug message 2");
+    ATF_REQUIRE(read_lines("test.log").empty());
+    datetime::set_mock_now(2011, 2, 21, 18, 20, 1, 0);
+    logging::log(logging::level_debug, "file", 123, "Debug message 3");
+    ATF_REQUIRE_EQ(3, read_lines("test.log").size());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(set_persistency__buffered__fork);
+ATF_TEST_CASE_BODY(set_persistency__buffered__fork)
+{
+    datetime::set_mock_now(2011, 2, 21, 18, 20, 0, 0);
+    logging::set_persistency("debug", fs::path("test.log"), 1024);
+
+    logging::log(logging::level_debug, "file", 123, "Parent message");
+
+    const pid_t pid = ::fork();
+    ATF_REQUIRE(pid != -1);
+    if (pid == 0) {
+        logging::log(logging::level_debug, "file", 123, "Child message");
+        logging::flush();
+        ::_exit(EXIT_SUCCESS);
+    }
+    int status;
+    ATF_REQUIRE_EQ(pid, ::waitpid(pid, &status, 0));
+    ATF_REQUIRE(WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS);
+
+    std::vector< std::string > lines = read_lines("test.log");
+    ATF_REQUIRE_EQ(1, lines.size());
+    ATF_REQUIRE_MATCH((F("D %s file:123: Child message$") % pid).str(),
+                      lines[0]);
+
+    logging::flush();
+    lines = read_lines("test.log");
+    ATF_REQUIRE_EQ(2, lines.size());
+    ATF_REQUIRE_MATCH((F("D %s file:123: Parent message$") %
+                       ::getpid()).str(),
+                      lines[1]);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(set_inmemory__buffered);
+ATF_TEST_CASE_BODY(set_inmemory__buffered)
+{
+    datetime::set_mock_now(2011, 2, 21, 18, 20, 0, 0);
+    logging::set_persistency("debug", fs::path("test.log"), 1024);
+
+    logging::log(logging::level_debug, "file", 123, "Debug message");
+    logging::set_inmemory();
+    ATF_REQUIRE_EQ(1, read_lines("test.log").size());
+}
+
+
 ATF_TEST_CASE(set_persistency__fail);
 ATF_TEST_CASE_HEAD(set_persistency__fail)
 {
@@ -343,7 +500,11 @@ ATF_INIT_TEST_CASES(tcs)
 
     ATF_ADD_TEST_CASE(tcs, log);
 
+    ATF_ADD_TEST_CASE(tcs, is_enabled__inmemory);
+    ATF_ADD_TEST_CASE(tcs, is_enabled__persistent);
+
     ATF_ADD_TEST_CASE(tcs, set_inmemory__reset);
+    ATF_ADD_TEST_CASE(tcs, set_inmemory__buffered);
 
     ATF_ADD_TEST_CASE(tcs, set_persistency__no_backlog);
     ATF_ADD_TEST_CASE(tcs, set_persistency__some_backlog__debug);
@@ -351,4 +512,9 @@ ATF_INIT_TEST_CASES(tcs)
     ATF_ADD_TEST_CASE(tcs, set_persistency__some_backlog__info);
     ATF_ADD_TEST_CASE(tcs, set_persistency__some_backlog__warning);
     ATF_ADD_TEST_CASE(tcs, set_persistency__fail);
+    ATF_ADD_TEST_CASE(tcs, set_persistency__buffered__flush);
+    ATF_ADD_TEST_CASE(tcs, set_persistency__buffered__full);
+    ATF_ADD_TEST_CASE(tcs, set_persistency__buffered__warning);
+    ATF_ADD_TEST_CASE(tcs, set_persistency__buffered__timeout);
+    ATF_ADD_TEST_CASE(tcs, set_persistency__buffered__fork);
 }
@@ -42,21 +42,33 @@ extern "C" {
 #if defined(HAVE_SYS_SYSCTL_H)
 #   include <sys/sysctl.h>
 #endif
+#include <unistd.h>
 }
 
 #include <cerrno>
 #include <cstddef>
 #include <cstring>
+#include <fstream>
 #include <stdexcept>
+#include <string>
+#include <vector>
 
+#include "utils/cgroup.hpp"
 #include "utils/defs.hpp"
 #include "utils/format/macros.hpp"
 #include "utils/logging/macros.hpp"
+#include "utils/optional.ipp"
+#include "utils/text/exceptions.hpp"
+#include "utils/text/operations.ipp"
 #include "utils/units.hpp"
 #include "utils/sanity.hpp"
 
+namespace text = utils::text;
 namespace units = utils::units;
 
+using utils::none;
+using utils::optional;
+
 
 namespace {
 
@@ -73,6 +85,14 @@ static const char* query_type_unknown = "unknown";
 static const char* query_type_sysctlbyname = "sysctlbyname";
 
 
+/// Value of query_type when we have to use sysconf(3).
+static const char* query_type_sysconf = "sysconf";
+
+
+/// Path to the file that describes the memory usage of the system on Linux.
+static const char* meminfo_path = "/proc/meminfo";
+
+
 /// Name of the sysctl MIB with the physical memory as detected by configure.
 ///
 /// This should only be used if memory_query_type is 'sysctl'.
@@ -137,8 +157,83 @@ query_sysctl(const char* mib)
 }
 
 
+/// Multiplies a number of pages returned by sysconf(3) by the page size.
+///
+/// \param pages The result of the sysconf(3) query of the number of pages.
+///
+/// \return The amount of memory in the pages, in bytes, or 0 if the system
+/// cannot tell.
+static int64_t
+pages_to_bytes(const long pages)
+{
+    const long page_size = ::sysconf(_SC_PAGESIZE);
+    if (pages < 0 || page_size < 0)
+        return 0;
+    return static_cast< int64_t >(pages) * page_size;
+}
+
+
+/// Gets the amount of physical memory through sysconf(3).
+///
+/// \pre The system supports the _SC_PHYS_PAGES sysconf(3) variable.
+///
+/// \return The amount of physical memory, in bytes.
+static int64_t
+query_sysconf(void)
+{
+#if defined(_SC_PHYS_PAGES)
+    return pages_to_bytes(::sysconf(_SC_PHYS_PAGES));
+#else
+    UNREACHABLE;
+#endif
+}
+
+
+/// Parses the available memory out of the contents of /proc/meminfo.
+///
+/// \param input The stream from which to read the contents of the file, which
+///     has one "Name: value kB" line per statistic.
+///
+/// \return The value of the MemAvailable statistic, or none if the input does
+/// not have it or if it is not valid.
+optional< units::bytes >
+utils::detail::parse_meminfo_available(std::istream& input)
+{
+    std::string line;
+    std::vector< std::string > fields;
+    while (std::getline(input, line)) {
+        if (line.find("MemAvailable:") != 0)
+            continue;
+
+        text::split(line.substr(13), ' ', fields);
+        std::vector< std::string > values;
+        for (std::vector< std::string >::const_iterator iter = fields.begin();
+             iter != fields.end(); ++iter) {
+            if (!(*iter).empty())
+                values.push_back(*iter);
+        }
+        if (values.size() != 2 || values[1] != "kB") {
+            LW(F("Invalid meminfo line '%s'") % line);
+            return none;
+        }
+        try {
+            return utils::make_optional(units::bytes(
+                text::to_type< uint64_t >(values[0]) * units::KB));
+        } catch (const text::value_error& e) {
+            LW(F("Invalid meminfo line '%s'") % line);
+            return none;
+        }
+    }
+    return none;
+}
+
+
 /// Queries the total amount of physical memory.
 ///
+/// When running within a control group with a memory limit, such as within a
+/// container, the limit is returned instead if it is smaller than the memory
+/// of the host.
+///
 /// The real query is run only once and the result is cached.  Further calls to
 /// this function will always return the same value.
 ///
@@ -154,11 +249,53 @@ utils::physical_memory(void)
             amount = 0;
         } else if (std::strcmp(query_type, query_type_sysctlbyname) == 0) {
             amount = query_sysctl(query_sysctl_mib);
+        } else if (std::strcmp(query_type, query_type_sysconf) == 0) {
+            amount = query_sysconf();
         } else
             UNREACHABLE_MSG("Unimplemented memory query type");
         LI(F("Physical memory as returned by query type '%s': %s") %
            query_type % amount);
+
+        const optional< units::bytes > limit = cgroup_memory_limit();
+        if (limit && (amount == 0 ||
+                      limit.get() < static_cast< uint64_t >(amount))) {
+            amount = static_cast< int64_t >(limit.get());
+            LI(F("Physical memory limited by the control group: %s") %
+               amount);
+        }
     }
     POST(amount > -1);
     return units::bytes(amount);
 }
+
+
+/// Queries the amount of memory that new processes can use right away.
+///
+/// This is the memory that is free or that the system can reclaim without
+/// swapping, capped by the memory that the control group of the process can
+/// still allocate.  The value changes continuously so it is never cached.
+///
+/// \return The amount of available memory, in bytes, or none if the system
+/// cannot tell.
+optional< units::bytes >
+utils::available_memory(void)
+{
+    optional< units::bytes > available;
+    {
+        std::ifstream input(meminfo_path);
+        if (input)
+            available = detail::parse_meminfo_available(input);
+    }
+#if defined(_SC_AVPHYS_PAGES)
+    if (!available) {
+        const int64_t amount = pages_to_bytes(::sysconf(_SC_AVPHYS_PAGES));
+        if (amount > 0)
+            available = units::bytes(amount);
+    }
+#endif
+
+    const optional< units::bytes > headroom = cgroup_memory_headroom();
+    if (headroom && (!available || headroom.get() < available.get()))
+        available = headroom;
+    return available;
+}
@@ -32,14 +32,25 @@
 #if !defined(UTILS_MEMORY_HPP)
 #define UTILS_MEMORY_HPP
 
+#include <istream>
+
+#include "utils/optional_fwd.hpp"
 #include "utils/units_fwd.hpp"
 
 namespace utils {
 
 
 units::bytes physical_memory(void);
+optional< units::bytes > available_memory(void);
+
+
+namespace detail {
+
+
+optional< units::bytes > parse_meminfo_available(std::istream&);
 
 
+}  // namespace detail
 }  // namespace utils
 
 #endif  // !defined(UTILS_MEMORY_HPP)
@@ -33,9 +33,11 @@
 #include "utils/memory.hpp"
 
 #include <cstring>
+#include <sstream>
 
 #include <atf-c++.hpp>
 
+#include "utils/optional.ipp"
 #include "utils/units.hpp"
 
 namespace units = utils::units;
@@ -48,7 +50,8 @@ ATF_TEST_CASE_BODY(physical_memory)
 
     if (std::strcmp(MEMORY_QUERY_TYPE, "unknown") == 0) {
         ATF_REQUIRE(memory == 0);
-    } else if (std::strcmp(MEMORY_QUERY_TYPE, "sysctlbyname") == 0) {
+    } else if (std::strcmp(MEMORY_QUERY_TYPE, "sysctlbyname") == 0 ||
+               std::strcmp(MEMORY_QUERY_TYPE, "sysconf") == 0) {
         ATF_REQUIRE(memory > 0);
         ATF_REQUIRE(memory < 100 * units::TB);  // Large enough for now...
     } else {
@@ -57,7 +60,57 @@ ATF_TEST_CASE_BODY(physical_memory)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(available_memory);
+ATF_TEST_CASE_BODY(available_memory)
+{
+    const utils::optional< units::bytes > memory = utils::available_memory();
+    if (memory && utils::physical_memory() > 0)
+        ATF_REQUIRE(memory.get() <= 100 * units::TB);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(parse_meminfo_available__ok);
+ATF_TEST_CASE_BODY(parse_meminfo_available__ok)
+{
+    std::istringstream input(
+        "MemTotal:       16318420 kB\n"
+        "MemFree:         1234567 kB\n"
+        "MemAvailable:    8388608 kB\n"
+        "Buffers:          123456 kB\n");
+    const utils::optional< units::bytes > memory =
+        utils::detail::parse_meminfo_available(input);
+    ATF_REQUIRE(memory);
+    ATF_REQUIRE_EQ(8 * units::GB, memory.get());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(parse_meminfo_available__invalid);
+ATF_TEST_CASE_BODY(parse_meminfo_available__invalid)
+{
+    {
+        std::istringstream input("");
+        ATF_REQUIRE(!utils::detail::parse_meminfo_available(input));
+    }
+    {
+        std::istringstream input("MemTotal:       16318420 kB\n");
+        ATF_REQUIRE(!utils::detail::parse_meminfo_available(input));
+    }
+    {
+        std::istringstream input("MemAvailable:    8388608\n");
+        ATF_REQUIRE(!utils::detail::parse_meminfo_available(input));
+    }
+    {
+        std::istringstream input("MemAvailable:    lots kB\n");
+        ATF_REQUIRE(!utils::detail::parse_meminfo_available(input));
+    }
+}
+
+
 ATF_INIT_TEST_CASES(tcs)
 {
     ATF_ADD_TEST_CASE(tcs, physical_memory);
+    ATF_ADD_TEST_CASE(tcs, available_memory);
+
+    ATF_ADD_TEST_CASE(tcs, parse_meminfo_available__ok);
+    ATF_ADD_TEST_CASE(tcs, parse_meminfo_available__invalid);
 }
@@ -74,6 +74,8 @@ public:
     const T& get(void) const;
     const T& get_default(const T&) const;
     T& get(void);
+
+    void swap(optional< T >&);
 };
 
 
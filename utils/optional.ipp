@@ -199,6 +199,22 @@ utils::optional< T >::get_default(const T& default_value) const
 }
 
 
+/// Exchanges the values of two optional objects.
+///
+/// This does not copy the values, so it is the way to hand over a large value
+/// from one optional object to another.
+///
+/// \param other The optional object to exchange the value with.
+template< class T >
+void
+utils::optional< T >::swap(optional< T >& other)
+{
+    T* data = _data;
+    _data = other._data;
+    other._data = data;
+}
+
+
 /// Tests whether the optional object contains data or not.
 ///
 /// \return True if the object is not none; false otherwise.
@@ -203,6 +203,30 @@ ATF_TEST_CASE_BODY(memory)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(swap);
+ATF_TEST_CASE_BODY(swap)
+{
+    ATF_REQUIRE_EQ(0, test_alloc::instances);
+    {
+        optional< test_alloc > optional1(test_alloc(3));
+        optional< test_alloc > optional2;
+        optional1.swap(optional2);
+        ATF_REQUIRE_EQ(1, test_alloc::instances);
+        ATF_REQUIRE(!optional1);
+        ATF_REQUIRE_EQ(3, optional2.get().value);
+
+        const test_alloc* data = &optional2.get();
+        optional1 = test_alloc(5);
+        optional1.swap(optional2);
+        ATF_REQUIRE_EQ(2, test_alloc::instances);
+        ATF_REQUIRE_EQ(3, optional1.get().value);
+        ATF_REQUIRE(data == &optional1.get());
+        ATF_REQUIRE_EQ(5, optional2.get().value);
+    }
+    ATF_REQUIRE_EQ(0, test_alloc::instances);
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(get_default);
 ATF_TEST_CASE_BODY(get_default)
 {
@@ -278,6 +302,7 @@ ATF_INIT_TEST_CASES(tcs)
     ATF_ADD_TEST_CASE(tcs, assign);
     ATF_ADD_TEST_CASE(tcs, return);
     ATF_ADD_TEST_CASE(tcs, memory);
+    ATF_ADD_TEST_CASE(tcs, swap);
     ATF_ADD_TEST_CASE(tcs, get_default);
     ATF_ADD_TEST_CASE(tcs, make_optional);
     ATF_ADD_TEST_CASE(tcs, operators_eq_and_ne);
@@ -35,6 +35,7 @@ extern "C" {
 #include <unistd.h>
 }
 
+#include <map>
 #include <stdexcept>
 
 #include "utils/format/macros.hpp"
@@ -56,6 +57,32 @@ static utils::optional< passwd_ns::user > fake_current_user;
 static std::vector< passwd_ns::user > mock_users;
 
 
+/// Users resolved through the system databases, keyed by name.
+///
+/// Querying the system databases may be slow (e.g. when they are backed by a
+/// remote directory service) so we remember every successful lookup for the
+/// lifetime of the process.  Subprocesses inherit the contents of the cache.
+static std::map< std::string, passwd_ns::user > users_by_name;
+
+
+/// Users resolved through the system databases, keyed by identifier.
+static std::map< unsigned int, passwd_ns::user > users_by_uid;
+
+
+/// Records a user resolved through the system databases.
+///
+/// \param user The user to remember.
+///
+/// \return The user.
+static passwd_ns::user
+remember_user(const passwd_ns::user& user)
+{
+    users_by_name.insert(std::make_pair(user.name, user));
+    users_by_uid.insert(std::make_pair(user.uid, user));
+    return user;
+}
+
+
 /// Formats a user for logging purposes.
 ///
 /// \param user The user to format.
@@ -115,6 +142,8 @@ passwd_ns::current_user(void)
 
 /// Gets information about a user by its name.
 ///
+/// Successful lookups are cached for the lifetime of the process.
+///
 /// \param name The name of the user to query.
 ///
 /// \return The information about the user.
@@ -124,12 +153,17 @@ passwd_ns::user
 passwd_ns::find_user_by_name(const std::string& name)
 {
     if (mock_users.empty()) {
+        const std::map< std::string, user >::const_iterator iter =
+            users_by_name.find(name);
+        if (iter != users_by_name.end())
+            return (*iter).second;
+
         const struct ::passwd* pw = ::getpwnam(name.c_str());
         if (pw == NULL)
             throw std::runtime_error(F("Failed to get information about the "
                                        "user '%s'") % name);
         INV(pw->pw_name == name);
-        return user(pw->pw_name, pw->pw_uid, pw->pw_gid);
+        return remember_user(user(pw->pw_name, pw->pw_uid, pw->pw_gid));
     } else {
         for (std::vector< user >::const_iterator iter = mock_users.begin();
              iter != mock_users.end(); iter++) {
@@ -144,6 +178,8 @@ passwd_ns::find_user_by_name(const std::string& name)
 
 /// Gets information about a user by its identifier.
 ///
+/// Successful lookups are cached for the lifetime of the process.
+///
 /// \param uid The identifier of the user to query.
 ///
 /// \return The information about the user.
@@ -153,12 +189,17 @@ passwd_ns::user
 passwd_ns::find_user_by_uid(const unsigned int uid)
 {
     if (mock_users.empty()) {
+        const std::map< unsigned int, user >::const_iterator iter =
+            users_by_uid.find(uid);
+        if (iter != users_by_uid.end())
+            return (*iter).second;
+
         const struct ::passwd* pw = ::getpwuid(uid);
         if (pw == NULL)
             throw std::runtime_error(F("Failed to get information about the "
                                        "user with UID %s") % uid);
         INV(pw->pw_uid == uid);
-        return user(pw->pw_name, pw->pw_uid, pw->pw_gid);
+        return remember_user(user(pw->pw_name, pw->pw_uid, pw->pw_gid));
     } else {
         for (std::vector< user >::const_iterator iter = mock_users.begin();
              iter != mock_users.end(); iter++) {
@@ -185,10 +226,14 @@ passwd_ns::set_current_user_for_testing(const user& new_current_user)
 
 /// Overrides the current set of users for testing purposes.
 ///
+/// This also discards any users cached from the system databases.
+///
 /// \param users The new users set.  Cannot be empty.
 void
 passwd_ns::set_mock_users_for_testing(const std::vector< user >& users)
 {
     PRE(!users.empty());
     mock_users = users;
+    users_by_name.clear();
+    users_by_uid.clear();
 }
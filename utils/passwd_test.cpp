@@ -162,6 +162,30 @@ ATF_TEST_CASE_BODY(find_user_by_uid__fake)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(find_user__cached);
+ATF_TEST_CASE_BODY(find_user__cached)
+{
+    const passwd_ns::user by_uid = passwd_ns::find_user_by_uid(::getuid());
+    const passwd_ns::user by_name = passwd_ns::find_user_by_name(by_uid.name);
+    ATF_REQUIRE_EQ(by_uid.name, by_name.name);
+    ATF_REQUIRE_EQ(by_uid.uid, by_name.uid);
+    ATF_REQUIRE_EQ(by_uid.gid, by_name.gid);
+
+    const passwd_ns::user again = passwd_ns::find_user_by_uid(::getuid());
+    ATF_REQUIRE_EQ(by_uid.name, again.name);
+    ATF_REQUIRE_EQ(by_uid.uid, again.uid);
+    ATF_REQUIRE_EQ(by_uid.gid, again.gid);
+
+    std::vector< passwd_ns::user > users;
+    users.push_back(passwd_ns::user(by_uid.name, by_uid.uid + 1000, 15));
+    passwd_ns::set_mock_users_for_testing(users);
+
+    const passwd_ns::user mocked = passwd_ns::find_user_by_name(by_uid.name);
+    ATF_REQUIRE_EQ(by_uid.uid + 1000, mocked.uid);
+    ATF_REQUIRE_EQ(15, mocked.gid);
+}
+
+
 ATF_INIT_TEST_CASES(tcs)
 {
     ATF_ADD_TEST_CASE(tcs, user__public_fields);
@@ -176,4 +200,5 @@ ATF_INIT_TEST_CASES(tcs)
     ATF_ADD_TEST_CASE(tcs, find_user_by_name__fake);
     ATF_ADD_TEST_CASE(tcs, find_user_by_uid__ok);
     ATF_ADD_TEST_CASE(tcs, find_user_by_uid__fake);
+    ATF_ADD_TEST_CASE(tcs, find_user__cached);
 }
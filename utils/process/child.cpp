@@ -28,23 +28,33 @@
 
 #include "utils/process/child.ipp"
 
+#if defined(HAVE_CONFIG_H)
+#  include "config.h"
+#endif
+
 extern "C" {
 #include <sys/stat.h>
 #include <sys/wait.h>
 
 #include <fcntl.h>
 #include <signal.h>
+#if defined(HAVE_POSIX_SPAWN)
+#   include <spawn.h>
+#endif
 #include <unistd.h>
 }
 
 #include <cerrno>
+#include <cstring>
 #include <iostream>
 #include <memory>
+#include <vector>
 
 #include "utils/defs.hpp"
 #include "utils/format/macros.hpp"
 #include "utils/fs/path.hpp"
 #include "utils/logging/macros.hpp"
+#include "utils/logging/operations.hpp"
 #include "utils/noncopyable.hpp"
 #include "utils/process/exceptions.hpp"
 #include "utils/process/fdstream.hpp"
@@ -81,10 +91,24 @@ struct child::impl : utils::noncopyable {
 
 
 namespace fs = utils::fs;
+namespace logging = utils::logging;
 namespace process = utils::process;
 namespace signals = utils::signals;
 
 
+#if defined(HAVE_POSIX_SPAWN) && defined(POSIX_SPAWN_SETSID)
+/// Whether spawn_capture() and spawn_files() can avoid forking the parent.
+///
+/// posix_spawn(3) is only usable if it can put the child in its own session,
+/// which is what our fork-based code does.
+#   define USE_POSIX_SPAWN 1
+
+extern "C" {
+    extern char** environ;
+}
+#endif
+
+
 namespace {
 
 
@@ -143,6 +167,134 @@ log_exec(const fs::path& program, const process::args_vector& args)
 }
 
 
+#if defined(USE_POSIX_SPAWN)
+/// Spawns a binary with posix_spawn(3) instead of fork(2) and exec(2).
+///
+/// This avoids duplicating the address space of the parent, which is costly
+/// when the parent is large, but it only applies when the child does not need
+/// any setup other than file descriptor redirections.  The child gets the same
+/// setup as with fork_capture_aux() and fork_files_aux().
+///
+/// \param program The binary to execute.
+/// \param args The arguments to pass to the binary, without the program name.
+/// \param actions The file actions that redirect the output of the child.
+///
+/// \return The PID of the child, or -1 if posix_spawn(3) failed.  Errors are
+/// not reported because the caller is expected to retry with fork(2), which
+/// reports them from within the child in the usual manner.
+static pid_t
+posix_spawn_with(const fs::path& program, const process::args_vector& args,
+                 const posix_spawn_file_actions_t* actions)
+{
+    std::vector< char* > argv;
+    argv.push_back(const_cast< char* >(program.c_str()));
+    for (process::args_vector::const_iterator iter = args.begin();
+         iter != args.end(); ++iter)
+        argv.push_back(const_cast< char* >((*iter).c_str()));
+    argv.push_back(NULL);
+
+    posix_spawnattr_t attr;
+    if (::posix_spawnattr_init(&attr) != 0)
+        return -1;
+    pid_t pid = -1;
+    // Interrupts need not be inhibited here: the child runs none of our code
+    // and add_pid_to_kill() kills it if an interrupt fired before its
+    // registration.
+    if (::posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSID) == 0) {
+        const int error = ::posix_spawn(&pid, program.c_str(), actions, &attr,
+                                        &argv[0], environ);
+        if (error == 0) {
+            signals::add_pid_to_kill(pid);
+        } else {
+            LD(F("posix_spawn of %s failed: %s; falling back to fork") %
+               program % std::strerror(error));
+            pid = -1;
+        }
+    }
+    ::posix_spawnattr_destroy(&attr);
+    return pid;
+}
+
+
+/// Spawns a binary with posix_spawn(3), redirecting its output to files.
+///
+/// \param program The binary to execute.
+/// \param args The arguments to pass to the binary, without the program name.
+/// \param stdout_file The name of the file in which to store the stdout, or
+///     /dev/stdout to inherit it.
+/// \param stderr_file The name of the file in which to store the stderr, or
+///     /dev/stderr to inherit it.
+///
+/// \return The PID of the child, or -1 if fork(2) has to be used instead.
+static pid_t
+posix_spawn_files(const fs::path& program, const process::args_vector& args,
+                  const fs::path& stdout_file, const fs::path& stderr_file)
+{
+    const int flags = O_CREAT | O_WRONLY | O_APPEND;
+    const mode_t mode = S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH;
+
+    posix_spawn_file_actions_t actions;
+    if (::posix_spawn_file_actions_init(&actions) != 0)
+        return -1;
+    pid_t pid = -1;
+    if ((stdout_file == fs::path("/dev/stdout") ||
+         ::posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO,
+                                            stdout_file.c_str(), flags,
+                                            mode) == 0) &&
+        (stderr_file == fs::path("/dev/stderr") ||
+         ::posix_spawn_file_actions_addopen(&actions, STDERR_FILENO,
+                                            stderr_file.c_str(), flags,
+                                            mode) == 0)) {
+        pid = posix_spawn_with(program, args, &actions);
+    }
+    ::posix_spawn_file_actions_destroy(&actions);
+    return pid;
+}
+
+
+/// Spawns a binary with posix_spawn(3), capturing its output in a pipe.
+///
+/// \param program The binary to execute.
+/// \param args The arguments to pass to the binary, without the program name.
+/// \param [out] output_fd The read end of the pipe connected to the stdout
+///     and stderr of the child.  Only set on success.
+///
+/// \return The PID of the child, or -1 if fork(2) has to be used instead.
+static pid_t
+posix_spawn_capture(const fs::path& program, const process::args_vector& args,
+                    int* output_fd)
+{
+    int fds[2];
+    if (process::detail::syscall_pipe(fds) == -1)
+        return -1;
+
+    posix_spawn_file_actions_t actions;
+    if (::posix_spawn_file_actions_init(&actions) != 0) {
+        ::close(fds[0]);
+        ::close(fds[1]);
+        return -1;
+    }
+    pid_t pid = -1;
+    if (::posix_spawn_file_actions_addclose(&actions, fds[0]) == 0 &&
+        ::posix_spawn_file_actions_adddup2(&actions, fds[1],
+                                           STDOUT_FILENO) == 0 &&
+        ::posix_spawn_file_actions_adddup2(&actions, fds[1],
+                                           STDERR_FILENO) == 0 &&
+        ::posix_spawn_file_actions_addclose(&actions, fds[1]) == 0) {
+        pid = posix_spawn_with(program, args, &actions);
+    }
+    ::posix_spawn_file_actions_destroy(&actions);
+
+    ::close(fds[1]);
+    if (pid == -1)
+        ::close(fds[0]);
+    else
+        *output_fd = fds[0];
+    return pid;
+}
+#endif
+
+
 }  // anonymous namespace
 
 
@@ -197,6 +349,7 @@ process::child::fork_capture_aux(void)
 {
     std::cout.flush();
     std::cerr.flush();
+    logging::flush();
 
     int fds[2];
     if (detail::syscall_pipe(fds) == -1)
@@ -258,6 +411,7 @@ process::child::fork_files_aux(const fs::path& stdout_file,
 {
     std::cout.flush();
     std::cerr.flush();
+    logging::flush();
 
     std::auto_ptr< signals::interrupts_inhibiter > inhibiter(
         new signals::interrupts_inhibiter);
@@ -296,6 +450,63 @@ process::child::fork_files_aux(const fs::path& stdout_file,
 }
 
 
+/// Helper function for fork_fds().
+///
+/// Please note: if you update this function to change the return type or to
+/// raise different errors, do not forget to update fork_fds() accordingly.
+///
+/// \param stdout_fd The descriptor to which to write the stdout.
+/// \param stderr_fd The descriptor to which to write the stderr.
+///
+/// \return In the case of the parent, a new child object returned as a
+/// dynamically-allocated object because children classes are unique and thus
+/// noncopyable.  In the case of the child, a NULL pointer.
+///
+/// \throw process::system_error If the call to fork(2) fails.
+std::auto_ptr< process::child >
+process::child::fork_fds_aux(const int stdout_fd, const int stderr_fd)
+{
+    PRE(stdout_fd != -1 && stderr_fd != -1);
+
+    std::cout.flush();
+    std::cerr.flush();
+    logging::flush();
+
+    std::auto_ptr< signals::interrupts_inhibiter > inhibiter(
+        new signals::interrupts_inhibiter);
+    pid_t pid = detail::syscall_fork();
+    if (pid == -1) {
+        inhibiter.reset(NULL);  // Unblock signals.
+        throw process::system_error("fork(2) failed", errno);
+    } else if (pid == 0) {
+        inhibiter.reset(NULL);  // Unblock signals.
+        ::setsid();
+
+        try {
+            if (stdout_fd != STDOUT_FILENO)
+                safe_dup(stdout_fd, STDOUT_FILENO);
+            if (stderr_fd != STDERR_FILENO)
+                safe_dup(stderr_fd, STDERR_FILENO);
+            if (stdout_fd > STDERR_FILENO)
+                ::close(stdout_fd);
+            if (stderr_fd > STDERR_FILENO && stderr_fd != stdout_fd)
+                ::close(stderr_fd);
+        } catch (const system_error& e) {
+            std::cerr << F("Failed to set up subprocess: %s\n") % e.what();
+            std::abort();
+        }
+        return std::auto_ptr< process::child >(NULL);
+    } else {
+        LD(F("Spawned process %s: stdout=fd %s, stderr=fd %s") % pid %
+           stdout_fd % stderr_fd);
+        signals::add_pid_to_kill(pid);
+        inhibiter.reset(NULL);  // Unblock signals.
+        return std::auto_ptr< process::child >(
+            new process::child(new impl(pid, NULL)));
+    }
+}
+
+
 /// Spawns a new binary and multiplexes and captures its stdout and stderr.
 ///
 /// If the subprocess cannot be completely set up for any reason, it attempts to
@@ -312,6 +523,22 @@ process::child::fork_files_aux(const fs::path& stdout_file,
 std::auto_ptr< process::child >
 process::child::spawn_capture(const fs::path& program, const args_vector& args)
 {
+#if defined(USE_POSIX_SPAWN)
+    std::cout.flush();
+    std::cerr.flush();
+    logging::flush();
+
+    int output_fd;
+    const pid_t pid = posix_spawn_capture(program, args, &output_fd);
+    if (pid != -1) {
+        LD(F("Spawned process %s with posix_spawn: stdout and stderr "
+             "inherited") % pid);
+        log_exec(program, args);
+        return std::auto_ptr< process::child >(new process::child(
+            new impl(pid, new process::ifdstream(output_fd))));
+    }
+#endif
+
     std::auto_ptr< child > child = fork_capture_aux();
     if (child.get() == NULL)
         exec(program, args);
@@ -341,6 +568,22 @@ process::child::spawn_files(const fs::path& program,
                             const fs::path& stdout_file,
                             const fs::path& stderr_file)
 {
+#if defined(USE_POSIX_SPAWN)
+    std::cout.flush();
+    std::cerr.flush();
+    logging::flush();
+
+    const pid_t pid = posix_spawn_files(program, args, stdout_file,
+                                        stderr_file);
+    if (pid != -1) {
+        LD(F("Spawned process %s with posix_spawn: stdout=%s, stderr=%s") %
+           pid % stdout_file % stderr_file);
+        log_exec(program, args);
+        return std::auto_ptr< process::child >(new process::child(
+            new impl(pid, NULL)));
+    }
+#endif
+
     std::auto_ptr< child > child = fork_files_aux(stdout_file, stderr_file);
     if (child.get() == NULL)
         exec(program, args);
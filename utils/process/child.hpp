@@ -83,6 +83,8 @@ class child : noncopyable {
     static std::auto_ptr< child > fork_files_aux(const fs::path&,
                                                  const fs::path&);
 
+    static std::auto_ptr< child > fork_fds_aux(const int, const int);
+
     explicit child(impl *);
 
 public:
@@ -96,6 +98,9 @@ public:
     static std::auto_ptr< child > fork_files(Hook, const fs::path&,
                                              const fs::path&);
 
+    template< typename Hook >
+    static std::auto_ptr< child > fork_fds(Hook, const int, const int);
+
     static std::auto_ptr< child > spawn_capture(
         const fs::path&, const args_vector&);
     static std::auto_ptr< child > spawn_files(
@@ -72,6 +72,41 @@ child::fork_files(Hook hook, const fs::path& stdout_file,
 }
 
 
+/// Spawns a new subprocess and redirects its stdout and stderr to descriptors.
+///
+/// If the subprocess cannot be completely set up for any reason, it attempts to
+/// dump an error message to its stderr channel and it then calls std::abort().
+///
+/// \param hook The function to execute in the subprocess.  Must not return.
+/// \param stdout_fd The descriptor to which to write the stdout.
+/// \param stderr_fd The descriptor to which to write the stderr.  May be the
+///     same as stdout_fd.
+///
+/// \return A new child object, returned as a dynamically-allocated object
+/// because children classes are unique and thus noncopyable.
+///
+/// \throw process::system_error If the process cannot be spawned due to a
+///     system call error.
+template< typename Hook >
+std::auto_ptr< child >
+child::fork_fds(Hook hook, const int stdout_fd, const int stderr_fd)
+{
+    std::auto_ptr< child > child = fork_fds_aux(stdout_fd, stderr_fd);
+    if (child.get() == NULL) {
+        try {
+            hook();
+            std::abort();
+        } catch (const std::runtime_error& e) {
+            detail::report_error_and_abort(e);
+        } catch (...) {
+            detail::report_error_and_abort();
+        }
+    }
+
+    return child;
+}
+
+
 /// Spawns a new subprocess and multiplexes and captures its stdout and stderr.
 ///
 /// If the subprocess cannot be completely set up for any reason, it attempts to
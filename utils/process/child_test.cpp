@@ -642,6 +642,55 @@ ATF_TEST_CASE_BODY(child__fork_files__create_stderr_fail)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(child__fork_fds__ok);
+ATF_TEST_CASE_BODY(child__fork_fds__ok)
+{
+    const int fd1 = ::open("file1.txt", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    ATF_REQUIRE(fd1 != -1);
+    const int fd2 = ::open("file2.txt", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    ATF_REQUIRE(fd2 != -1);
+
+    std::auto_ptr< process::child > child = process::child::fork_fds(
+        child_simple_function< 15, 'Z' >, fd1, fd2);
+    ::close(fd1);
+    ::close(fd2);
+    const process::status status = child->wait();
+    ATF_REQUIRE(status.exited());
+    ATF_REQUIRE_EQ(15, status.exitstatus());
+
+    ATF_REQUIRE( atf::utils::grep_file("^To stdout: Z$", "file1.txt"));
+    ATF_REQUIRE(!atf::utils::grep_file("^To stdout: Z$", "file2.txt"));
+
+    ATF_REQUIRE( atf::utils::grep_file("^To stderr: Z$", "file2.txt"));
+    ATF_REQUIRE(!atf::utils::grep_file("^To stderr: Z$", "file1.txt"));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(child__fork_fds__same_fd);
+ATF_TEST_CASE_BODY(child__fork_fds__same_fd)
+{
+    int fds[2];
+    ATF_REQUIRE(::pipe(fds) != -1);
+
+    std::auto_ptr< process::child > child = process::child::fork_fds(
+        child_simple_function< 16, 'Y' >, fds[1], fds[1]);
+    ::close(fds[1]);
+
+    std::string output;
+    char buffer[128];
+    ssize_t length;
+    while ((length = ::read(fds[0], buffer, sizeof(buffer))) > 0)
+        output.append(buffer, length);
+    ::close(fds[0]);
+
+    const process::status status = child->wait();
+    ATF_REQUIRE(status.exited());
+    ATF_REQUIRE_EQ(16, status.exitstatus());
+    ATF_REQUIRE(output.find("To stdout: Y\n") != std::string::npos);
+    ATF_REQUIRE(output.find("To stderr: Y\n") != std::string::npos);
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(child__spawn__absolute_path);
 ATF_TEST_CASE_BODY(child__spawn__absolute_path)
 {
@@ -722,6 +771,46 @@ ATF_TEST_CASE_BODY(child__spawn__no_path)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(child__spawn__own_session);
+ATF_TEST_CASE_BODY(child__spawn__own_session)
+{
+    std::vector< std::string > args;
+    args.push_back("check-session");
+
+    std::auto_ptr< process::child > child1 = process::child::spawn_files(
+        get_helpers(this), args, fs::path("out"), fs::path("err"));
+    const process::status status1 = child1->wait();
+    ATF_REQUIRE(status1.exited());
+    ATF_REQUIRE_EQ(EXIT_SUCCESS, status1.exitstatus());
+
+    std::auto_ptr< process::child > child2 = process::child::spawn_capture(
+        get_helpers(this), args);
+    const process::status status2 = child2->wait();
+    ATF_REQUIRE(status2.exited());
+    ATF_REQUIRE_EQ(EXIT_SUCCESS, status2.exitstatus());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(child__spawn__files_append);
+ATF_TEST_CASE_BODY(child__spawn__files_append)
+{
+    atf::utils::create_file("out", "before\n");
+
+    std::vector< std::string > args;
+    args.push_back("print-args");
+
+    std::auto_ptr< process::child > child = process::child::spawn_files(
+        get_helpers(this), args, fs::path("out"), fs::path("err"));
+    const process::status status = child->wait();
+    ATF_REQUIRE(status.exited());
+    ATF_REQUIRE_EQ(EXIT_SUCCESS, status.exitstatus());
+
+    ATF_REQUIRE(atf::utils::grep_file("^before$", "out"));
+    ATF_REQUIRE(atf::utils::grep_file("^argv\\[1\\] = print-args$", "out"));
+    ATF_REQUIRE(atf::utils::compare_file("err", ""));
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(child__spawn__no_args);
 ATF_TEST_CASE_BODY(child__spawn__no_args)
 {
@@ -835,10 +924,15 @@ ATF_INIT_TEST_CASES(tcs)
     ATF_ADD_TEST_CASE(tcs, child__fork_files__create_stdout_fail);
     ATF_ADD_TEST_CASE(tcs, child__fork_files__create_stderr_fail);
 
+    ATF_ADD_TEST_CASE(tcs, child__fork_fds__ok);
+    ATF_ADD_TEST_CASE(tcs, child__fork_fds__same_fd);
+
     ATF_ADD_TEST_CASE(tcs, child__spawn__absolute_path);
     ATF_ADD_TEST_CASE(tcs, child__spawn__relative_path);
     ATF_ADD_TEST_CASE(tcs, child__spawn__basename_only);
     ATF_ADD_TEST_CASE(tcs, child__spawn__no_path);
+    ATF_ADD_TEST_CASE(tcs, child__spawn__own_session);
+    ATF_ADD_TEST_CASE(tcs, child__spawn__files_append);
     ATF_ADD_TEST_CASE(tcs, child__spawn__no_args);
     ATF_ADD_TEST_CASE(tcs, child__spawn__some_args);
     ATF_ADD_TEST_CASE(tcs, child__spawn__missing_program);
@@ -34,19 +34,31 @@
 
 extern "C" {
 #include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
 #include <sys/wait.h>
 
+#include <fcntl.h>
+#include <poll.h>
 #include <signal.h>
+#include <unistd.h>
 }
 
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <map>
 #include <memory>
 #include <stdexcept>
+#include <utility>
+#include <vector>
 
 #include "utils/datetime.hpp"
 #include "utils/format/macros.hpp"
 #include "utils/fs/auto_cleaners.hpp"
+#include "utils/fs/directory.hpp"
 #include "utils/fs/exceptions.hpp"
 #include "utils/fs/operations.hpp"
 #include "utils/fs/path.hpp"
@@ -57,12 +69,16 @@ extern "C" {
 #include "utils/passwd.hpp"
 #include "utils/process/child.ipp"
 #include "utils/process/deadline_killer.hpp"
+#include "utils/process/exceptions.hpp"
 #include "utils/process/isolation.hpp"
 #include "utils/process/operations.hpp"
+#include "utils/process/resource_usage.hpp"
 #include "utils/process/status.hpp"
 #include "utils/sanity.hpp"
 #include "utils/signals/interrupts.hpp"
+#include "utils/signals/programmer.hpp"
 #include "utils/signals/timer.hpp"
+#include "utils/units.hpp"
 
 namespace datetime = utils::datetime;
 namespace executor = utils::process::executor;
@@ -71,6 +87,7 @@ namespace logging = utils::logging;
 namespace passwd = utils::passwd;
 namespace process = utils::process;
 namespace signals = utils::signals;
+namespace units = utils::units;
 
 using utils::none;
 using utils::optional;
@@ -87,9 +104,601 @@ static const char* work_directory_template = PACKAGE_TARNAME ".XXXXXX";
 typedef std::map< int, executor::exec_handle > exec_handles_map;
 
 
+/// Collection of emptied control directories ready to be reused.
+typedef std::vector< fs::path > spare_directories_vector;
+
+
+/// Maximum number of subprocesses to use to remove directories at teardown.
+static const std::size_t max_cleanup_workers = 8;
+
+
+/// Minimum number of directories to remove for the teardown to go parallel.
+///
+/// Forking is not free, so removing just a few directories is faster if done
+/// in the calling process.
+static const std::size_t min_parallel_cleanup = 16;
+
+
+/// Checks if a directory looks like one freshly created by spawn_pre().
+///
+/// \param directory The directory to check.
+///
+/// \return True if the directory is a real directory owned by us and with no
+/// permissions beyond those that spawn_pre() gives it; false otherwise.
+static bool
+is_pristine_directory(const fs::path& directory)
+{
+    struct ::stat sb;
+    if (::lstat(directory.c_str(), &sb) == -1)
+        return false;
+    return S_ISDIR(sb.st_mode) && sb.st_uid == ::geteuid() &&
+        (sb.st_mode & 0700) == 0700 && (sb.st_mode & 07777 & ~0755) == 0;
+}
+
+
+/// Removes all the contents of a directory, but not the directory itself.
+///
+/// \param directory The directory to empty.
+/// \param keep Name of an entry to leave untouched; may be empty.
+///
+/// \throw fs::error If there is a problem removing any directory or file.
+static void
+remove_contents(const fs::path& directory, const std::string& keep)
+{
+    const fs::directory dir(directory);
+    for (fs::directory::const_iterator iter = dir.begin(); iter != dir.end();
+         ++iter) {
+        if (iter->name == "." || iter->name == ".." || iter->name == keep)
+            continue;
+
+        const fs::path entry = directory / iter->name;
+        bool is_directory = iter->type == fs::entry_type_directory;
+        if (iter->type == fs::entry_type_unknown) {
+            struct ::stat sb;
+            is_directory = ::lstat(entry.c_str(), &sb) != -1 &&
+                S_ISDIR(sb.st_mode);
+        }
+        if (is_directory)
+            fs::rm_r(entry);
+        else
+            fs::unlink(entry);
+    }
+}
+
+
+/// Checks if a directory is empty.
+///
+/// \param directory The directory to check.
+/// \param keep Name of an entry to ignore; may be empty.
+///
+/// \return True if the directory has no entries other than keep.
+///
+/// \throw fs::error If the directory cannot be read.
+static bool
+is_empty_directory(const fs::path& directory, const std::string& keep)
+{
+    const fs::directory dir(directory);
+    for (fs::directory::const_iterator iter = dir.begin(); iter != dir.end();
+         ++iter) {
+        if (iter->name != "." && iter->name != ".." && iter->name != keep)
+            return false;
+    }
+    return true;
+}
+
+
+/// Empties a control directory so that spawn_pre() can hand it out again.
+///
+/// Creating and deleting the control and work directories of every subprocess
+/// is expensive on slow file systems, so we keep them around once they are
+/// empty.  Directories that may have been tampered with by the subprocess, for
+/// example because they were handed to an unprivileged user or had their
+/// permissions changed, are not recycled.
+///
+/// \param control_directory The control directory to recycle.
+///
+/// \return True if the directory is ready for reuse; false if it has to be
+/// deleted instead.
+///
+/// \throw fs::error If there is a problem removing any directory or file, or
+///     if the directory is not empty afterwards; e.g. because a process left
+///     behind by the subprocess keeps creating files in it.
+static bool
+recycle_control_directory(const fs::path& control_directory)
+{
+    const fs::path work_directory = control_directory /
+        executor::detail::work_subdir;
+    if (!is_pristine_directory(control_directory) ||
+        !is_pristine_directory(work_directory))
+        return false;
+
+    remove_contents(control_directory, executor::detail::work_subdir);
+    remove_contents(work_directory, "");
+    if (!is_empty_directory(control_directory,
+                            executor::detail::work_subdir) ||
+        !is_empty_directory(work_directory, "")) {
+        LW(F("Control directory %s is not empty after cleaning it up; "
+             "not recycling it") % control_directory);
+        throw fs::error(F("Failed to empty control directory %s") %
+                        control_directory);
+    }
+    return true;
+}
+
+
+/// Removes a directory, logging any errors.
+///
+/// \param directory The directory to remove.
+///
+/// \return True if the directory was removed; false otherwise.
+static bool
+remove_directory(const fs::path& directory)
+{
+    try {
+        fs::rm_r(directory);
+        return true;
+    } catch (const fs::error& e) {
+        LE(F("Failed to clean up subprocess work directory %s: %s") %
+           directory % e.what());
+        return false;
+    }
+}
+
+
+/// Functor to remove a subset of directories in a subprocess.
+class remove_directories_worker {
+    /// All the directories to remove.
+    const std::vector< fs::path >& _directories;
+
+    /// Index of the first directory to be removed by this worker.
+    const std::size_t _first;
+
+    /// Distance between the indices of the directories of this worker.
+    const std::size_t _step;
+
+public:
+    /// Constructor.
+    ///
+    /// \param directories All the directories to remove.
+    /// \param first Index of the first directory to be removed by this worker.
+    /// \param step Distance between the directories removed by this worker.
+    remove_directories_worker(const std::vector< fs::path >& directories,
+                              const std::size_t first,
+                              const std::size_t step) :
+        _directories(directories), _first(first), _step(step)
+    {
+    }
+
+    /// Body of the subprocess.
+    void
+    operator()(void)
+    {
+        bool ok = true;
+        for (std::size_t i = _first; i < _directories.size(); i += _step)
+            ok &= remove_directory(_directories[i]);
+        logging::flush();
+        ::_exit(ok ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+};
+
+
+/// Checks if a subprocess has terminated without reaping it.
+///
+/// \param pid The subprocess to check.
+///
+/// \return True if the subprocess is waitable; false otherwise.
+static bool
+has_terminated(const int pid)
+{
+    ::siginfo_t info;
+    info.si_pid = 0;
+    if (::waitid(P_PID, pid, &info, WEXITED | WNOHANG | WNOWAIT) == -1)
+        return true;  // Let the caller's wait report the error.
+    return info.si_pid != 0;
+}
+
+
+/// Removes a collection of directories concurrently.
+///
+/// \param directories The directories to remove.
+/// \param deadline If not none, the time at which to give up on removing the
+///     directories that have not been removed yet.
+///
+/// \return True if all directories were removed; false otherwise.
+static bool
+remove_directories(const std::vector< fs::path >& directories,
+                   const optional< datetime::monotonic_time >& deadline)
+{
+    if (directories.size() < min_parallel_cleanup) {
+        bool ok = true;
+        for (std::vector< fs::path >::const_iterator iter =
+                 directories.begin(); iter != directories.end(); ++iter) {
+            if (deadline && datetime::monotonic_time::now() >= deadline.get()) {
+                LW("Teardown timed out; leaving work directories behind");
+                return false;
+            }
+            ok &= remove_directory(*iter);
+        }
+        return ok;
+    }
+
+    const std::size_t nworkers = std::min(max_cleanup_workers,
+                                          directories.size() /
+                                          (min_parallel_cleanup / 2));
+    LI(F("Removing %s work directories with %s subprocesses") %
+       directories.size() % nworkers);
+
+    std::vector< std::shared_ptr< process::child > > workers;
+    for (std::size_t i = 0; i < nworkers; ++i) {
+        try {
+            workers.push_back(std::shared_ptr< process::child >(
+                process::child::fork_files(
+                    remove_directories_worker(directories, i, nworkers),
+                    fs::path("/dev/stdout"), fs::path("/dev/stderr"))
+                .release()));
+        } catch (const process::system_error& e) {
+            LW(F("Failed to spawn cleanup subprocess: %s") % e.what());
+            break;
+        }
+    }
+    // Remove the directories of the workers that could not be spawned.
+    bool ok = true;
+    for (std::size_t i = workers.size(); i < nworkers; ++i) {
+        for (std::size_t j = i; j < directories.size(); j += nworkers)
+            ok &= remove_directory(directories[j]);
+    }
+
+    for (std::vector< std::shared_ptr< process::child > >::const_iterator
+             iter = workers.begin(); iter != workers.end(); ++iter) {
+        process::child& worker = **iter;
+        if (deadline) {
+            while (!has_terminated(worker.pid())) {
+                if (datetime::monotonic_time::now() >= deadline.get()) {
+                    LW(F("Teardown timed out; killing cleanup subprocess %s "
+                         "and leaving work directories behind") %
+                       worker.pid());
+                    process::terminate_group(worker.pid());
+                    break;
+                }
+                ::usleep(10000);
+            }
+        }
+        try {
+            const process::status status = worker.wait();
+            ok &= status.exited() && status.exitstatus() == EXIT_SUCCESS;
+        } catch (const process::system_error& e) {
+            LW(F("Failed to wait for cleanup subprocess %s: %s") %
+               worker.pid() % e.what());
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+
+/// Maximum time to wait for abandoned subprocesses to die at teardown.
+///
+/// Abandoned subprocesses did not die when killed before, so they might be
+/// stuck for good; do not let them hold up the teardown.
+static const datetime::delta lingering_reap_timeout(0, 100000);
+
+
+/// Reaps the subprocesses of a collection that have already terminated.
+///
+/// \param [in,out] pids The subprocesses to check.  Those that are reaped are
+///     removed from the collection.
+static void
+reap_terminated(std::vector< int >& pids)
+{
+    std::vector< int >::iterator iter = pids.begin();
+    while (iter != pids.end()) {
+        int status;
+        const pid_t ret = ::waitpid(*iter, &status, WNOHANG);
+        if (ret == 0 || (ret == -1 && errno == EINTR)) {
+            ++iter;
+        } else {
+            if (ret == -1) {
+                // Should not happen.
+                LW(F("Failed to wait for PID %s") % *iter);
+            }
+            iter = pids.erase(iter);
+        }
+    }
+}
+
+
+/// Reaps a collection of subprocesses that have just been killed.
+///
+/// All the subprocesses are polled together so that the teardown takes as long
+/// as the slowest subprocess to die instead of the sum of all of them.
+///
+/// \param pids The subprocesses to wait for until they die.
+/// \param lingering_pids The abandoned subprocesses to wait for, but only for
+///     up to lingering_reap_timeout.
+static void
+reap_killed(std::vector< int > pids, std::vector< int > lingering_pids)
+{
+    const datetime::monotonic_time lingering_deadline =
+        datetime::monotonic_time::now() + lingering_reap_timeout;
+    for (;;) {
+        reap_terminated(pids);
+        reap_terminated(lingering_pids);
+        if (pids.empty()) {
+            if (lingering_pids.empty())
+                break;
+            if (datetime::monotonic_time::now() >= lingering_deadline) {
+                for (std::vector< int >::const_iterator iter =
+                         lingering_pids.begin();
+                     iter != lingering_pids.end(); ++iter)
+                    LW(F("Leaving stuck subprocess %s behind") % *iter);
+                break;
+            }
+        }
+        ::usleep(1000);
+    }
+}
+
+
+/// Open descriptor of the mount namespace of a subprocess.
+///
+/// The namespace holds the tmpfs of the work directory of the subprocess, so
+/// it is kept open after the subprocess exits for any followup subprocesses to
+/// join it.  Closing the descriptor once the subprocess is cleaned up tears
+/// down the namespace and discards the file system along with its contents.
+class mounts_holder : utils::noncopyable {
+    /// The open descriptor; -1 once released.
+    int _fd;
+
+public:
+    /// Constructor.
+    ///
+    /// \param fd Open descriptor of the namespace.  Ownership is transferred.
+    explicit mounts_holder(const int fd) :
+        _fd(fd)
+    {
+        PRE(fd != -1);
+    }
+
+    /// Destructor.
+    ~mounts_holder(void)
+    {
+        release();
+    }
+
+    /// Gets the descriptor of the namespace.
+    ///
+    /// \return The open descriptor, or -1 if already released.
+    int
+    fd(void) const
+    {
+        return _fd;
+    }
+
+    /// Closes the descriptor, which tears down the namespace unless any
+    /// subprocess still runs in it.  Does nothing if already released.
+    void
+    release(void)
+    {
+        if (_fd == -1)
+            return;
+        if (::close(_fd) == -1)
+            LW(F("Failed to close mount namespace descriptor %s") % _fd);
+        _fd = -1;
+    }
+};
+
+
+/// Shared mount namespace of a subprocess and its followups; NULL if none.
+typedef std::shared_ptr< mounts_holder > mounts_ptr;
+
+
+/// Output streams of a subprocess provided by an output sink.
+///
+/// These are shared by the subprocess and its followups, which append to the
+/// same streams, and are released once all of them have been cleaned up.
+class outputs_holder : utils::noncopyable {
+    /// The sink that provided the streams.
+    std::shared_ptr< executor::output_sink > _sink;
+
+    /// The file from which to read the stdout back.
+    const fs::path _stdout_file;
+
+    /// The file from which to read the stderr back.
+    const fs::path _stderr_file;
+
+    /// Whether the streams have already been released.
+    bool _released;
+
+public:
+    /// Constructor.
+    ///
+    /// \param sink The sink that provided the streams.
+    /// \param stdout_file The file from which to read the stdout back.
+    /// \param stderr_file The file from which to read the stderr back.
+    outputs_holder(std::shared_ptr< executor::output_sink > sink,
+                   const fs::path& stdout_file, const fs::path& stderr_file) :
+        _sink(sink), _stdout_file(stdout_file), _stderr_file(stderr_file),
+        _released(false)
+    {
+    }
+
+    /// Destructor.
+    ~outputs_holder(void)
+    {
+        release();
+    }
+
+    /// Hands the streams back to the sink.  Does nothing if already released.
+    void
+    release(void)
+    {
+        if (_released)
+            return;
+        _released = true;
+        try {
+            _sink->release(_stdout_file);
+            _sink->release(_stderr_file);
+        } catch (const std::runtime_error& e) {
+            LW(F("Failed to release output of subprocess: %s") % e.what());
+        }
+    }
+};
+
+
+/// Output streams of a subprocess and its followups; NULL if they are files in
+/// the control directory.
+typedef std::shared_ptr< outputs_holder > outputs_ptr;
+
+
+/// Maximum time to wait for a new subprocess to set up its mount namespace.
+static const int receive_mounts_timeout_msec = 30000;
+
+
+/// Waits for a new subprocess to report that it created its mount namespace.
+///
+/// The subprocess blocks until we acknowledge that we hold its namespace open,
+/// so that the namespace survives even if the subprocess exits right away.  If
+/// the subprocess does not report back in receive_mounts_timeout_msec, such as
+/// when it is stuck mounting its file system, we give up on its namespace:
+/// closing the socket releases the subprocess, which then runs without us
+/// holding its namespace open.
+///
+/// \param sync_fd The socket connected to the subprocess.  Closed on return.
+/// \param pid The PID of the subprocess.
+///
+/// \return The namespace of the subprocess, or NULL if it runs in ours.
+static mounts_ptr
+receive_mounts(const int sync_fd, const int pid)
+{
+    mounts_ptr mounts;
+
+    struct ::pollfd pfd;
+    pfd.fd = sync_fd;
+    pfd.events = POLLIN;
+    int polled;
+    while ((polled = ::poll(&pfd, 1, receive_mounts_timeout_msec)) == -1 &&
+           errno == EINTR) {
+        // Retry.
+    }
+
+    char ready;
+    ssize_t ret = -1;
+    if (polled == 1) {
+        while ((ret = ::read(sync_fd, &ready, 1)) == -1 && errno == EINTR) {
+            // Retry.
+        }
+    } else if (polled == 0) {
+        LW(F("Subprocess %s did not set up its mount namespace in time; "
+             "its work directory will be lost") % pid);
+    }
+    if (ret == 1) {
+        const std::string path = F("/proc/%s/ns/mnt") % pid;
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd == -1) {
+            LW(F("Cannot open %s; work directory of subprocess %s will be "
+                 "lost: %s") % path % pid % std::strerror(errno));
+        } else {
+            (void)::fcntl(fd, F_SETFD, FD_CLOEXEC);
+            mounts.reset(new mounts_holder(fd));
+        }
+
+        const char ack = 'a';
+        while (::send(sync_fd, &ack, 1, MSG_NOSIGNAL) == -1 && errno == EINTR) {
+            // Retry.
+        }
+    } else {
+        LD(F("Subprocess %s runs in the mount namespace of the executor") %
+           pid);
+    }
+
+    ::close(sync_fd);
+    return mounts;
+}
+
+
+/// SIGCHLD handler for the executor.
+///
+/// This does nothing on its own: its only purpose is to make the termination
+/// of a subprocess interrupt the wait in wakeup_signals_blocker::suspend(),
+/// which would not happen with the default disposition of the signal.
+///
+/// \param signo The signal received; must be SIGCHLD.
+static void
+sigchld_handler(const int signo)
+{
+    PRE(signo == SIGCHLD);
+}
+
+
+/// Blocks the signals that report progress to wait_any() while alive.
+///
+/// Checking for terminated subprocesses, expired timers and interrupts while
+/// these signals are blocked, and then waiting for them with suspend() if there
+/// is nothing to do, ensures that none of them is lost in between the checks
+/// and the wait.
+class wakeup_signals_blocker : utils::noncopyable {
+    /// The signal mask to restore on destruction.
+    sigset_t _old_mask;
+
+public:
+    /// Blocks the signals.
+    wakeup_signals_blocker(void)
+    {
+        sigset_t mask;
+        sigemptyset(&mask);
+        sigaddset(&mask, SIGALRM);
+        sigaddset(&mask, SIGCHLD);
+        sigaddset(&mask, SIGHUP);
+        sigaddset(&mask, SIGINT);
+        sigaddset(&mask, SIGTERM);
+        const int ret = ::sigprocmask(SIG_BLOCK, &mask, &_old_mask);
+        INV(ret != -1);
+    }
+
+    /// Restores the original signal mask.
+    ~wakeup_signals_blocker(void)
+    {
+        const int ret = ::sigprocmask(SIG_SETMASK, &_old_mask, NULL);
+        INV(ret != -1);
+    }
+
+    /// Waits until any of the blocked signals is delivered and handled.
+    ///
+    /// The signals are unblocked and waited for atomically, so any signal that
+    /// arrived since the construction of this object is handled right away.
+    void
+    suspend(void) const
+    {
+        (void)::sigsuspend(&_old_mask);
+    }
+};
+
+
 }  // anonymous namespace
 
 
+/// Maximum time the implicit teardown of an executor waits for cleanup.
+///
+/// The implicit teardown happens when an executor_handle is destroyed without
+/// having been explicitly cleaned up, which typically is the result of an
+/// interrupt.  Any work directories that could not be removed in this time are
+/// left behind so that the user does not feel that the interrupt was ignored.
+datetime::delta executor::interrupted_cleanup_timeout(5, 0);
+
+
+/// Time to wait for a subprocess to die after its timeout fires.
+///
+/// Subprocesses that are still alive after this time, such as those stuck in
+/// an uninterruptible sleep, are reported as timed out right away and reaped
+/// in the background whenever they finally terminate.  This keeps a single
+/// stuck subprocess from holding on to the caller's resources.
+datetime::delta executor::abandon_delay(1, 0);
+
+
+/// Time to sleep between polls while waiting for a timed out subprocess.
+static const useconds_t abandon_poll_usec = 10000;
+
+
 /// Basename of the file containing the stdout of the subprocess.
 const char* utils::process::executor::detail::stdout_name = "stdout.txt";
 
@@ -106,23 +715,73 @@ const char* utils::process::executor::detail::stderr_name = "stderr.txt";
 const char* utils::process::executor::detail::work_subdir = "work";
 
 
+/// Resolves the current user so that it is cached before forking a child.
+///
+/// Errors are ignored: the child reports them in the usual manner.
+void
+utils::process::executor::detail::resolve_current_user(void)
+{
+    try {
+        (void)passwd::current_user();
+    } catch (const std::runtime_error& e) {
+        LW(F("Cannot resolve the current user: %s") % e.what());
+    }
+}
+
+
 /// Prepares a subprocess to run a user-provided hook in a controlled manner.
 ///
 /// \param unprivileged_user User to switch to if not none.
 /// \param control_directory Path to the subprocess-specific control directory.
 /// \param work_directory Path to the subprocess-specific work directory.
+/// \param mounts Mount namespace in which to run the subprocess.
 void
 utils::process::executor::detail::setup_child(
     const optional< passwd::user > unprivileged_user,
     const fs::path& control_directory,
-    const fs::path& work_directory)
+    const fs::path& work_directory,
+    const mounts_setup& mounts)
 {
     logging::set_inmemory();
+    if (mounts.join) {
+        (void)process::join_mounts(mounts.fd);
+    } else if (mounts.fd != -1) {
+        if (process::isolate_mounts(work_directory,
+                                    units::bytes(mounts.size))) {
+            char ready = 'r';
+            if (::send(mounts.fd, &ready, 1, MSG_NOSIGNAL) == 1) {
+                while (::read(mounts.fd, &ready, 1) == -1 && errno == EINTR) {
+                    // Retry until the parent holds the namespace.
+                }
+            }
+        }
+        ::close(mounts.fd);
+    }
     process::isolate_path(unprivileged_user, control_directory);
     process::isolate_child(unprivileged_user, work_directory);
 }
 
 
+/// Destructor.
+executor::output_sink::~output_sink(void)
+{
+}
+
+
+/// Releases the destination of an output stream once it is no longer used.
+///
+/// This is called once the subprocess that wrote to the stream, and any of its
+/// followups, have been cleaned up.  The default implementation does nothing.
+///
+/// \param unused_file The file returned by open().
+///
+/// \throw std::runtime_error If the destination cannot be released.
+void
+executor::output_sink::release(const fs::path& UTILS_UNUSED_PARAM(file))
+{
+}
+
+
 /// Internal implementation for the exit_handle class.
 struct utils::process::executor::exec_handle::impl : utils::noncopyable {
     /// PID of the process being run.
@@ -138,7 +797,13 @@ struct utils::process::executor::exec_handle::impl : utils::noncopyable {
     const fs::path stderr_file;
 
     /// Start time.
-    datetime::timestamp start_time;
+    const datetime::timestamp start_time;
+
+    /// Start time according to the monotonic clock, to measure the duration.
+    const datetime::monotonic_time monotonic_start;
+
+    /// Time at which the timer kills the subprocess.
+    const datetime::monotonic_time deadline;
 
     /// User the subprocess is running as if different than the current one.
     const optional< passwd::user > unprivileged_user;
@@ -149,6 +814,12 @@ struct utils::process::executor::exec_handle::impl : utils::noncopyable {
     /// Number of owners of the on-disk state.
     executor::detail::refcnt_t state_owners;
 
+    /// Mount namespace holding the work directory, if any.
+    mounts_ptr mounts;
+
+    /// Output streams provided by an output sink, if any.
+    outputs_ptr outputs;
+
     /// Constructor.
     ///
     /// \param pid_ PID of the forked process.
@@ -164,6 +835,10 @@ struct utils::process::executor::exec_handle::impl : utils::noncopyable {
     ///     For first-time processes, this should be a new counter set to 0;
     ///     for followup processes, this should point to the same counter used
     ///     by the preceding process.
+    /// \param mounts_ Mount namespace holding the work directory, if any.
+    ///     Followup processes share the one of the preceding process.
+    /// \param outputs_ Output streams provided by an output sink, if any.
+    ///     Followup processes share the ones of the preceding process.
     impl(const int pid_,
          const fs::path& control_directory_,
          const fs::path& stdout_file_,
@@ -171,15 +846,21 @@ struct utils::process::executor::exec_handle::impl : utils::noncopyable {
          const datetime::timestamp& start_time_,
          const datetime::delta& timeout,
          const optional< passwd::user > unprivileged_user_,
-         executor::detail::refcnt_t state_owners_) :
+         executor::detail::refcnt_t state_owners_,
+         const mounts_ptr mounts_,
+         const outputs_ptr outputs_) :
         pid(pid_),
         control_directory(control_directory_),
         stdout_file(stdout_file_),
         stderr_file(stderr_file_),
         start_time(start_time_),
+        monotonic_start(datetime::monotonic_time::now()),
+        deadline(monotonic_start + timeout),
         unprivileged_user(unprivileged_user_),
         timer(timeout, pid_),
-        state_owners(state_owners_)
+        state_owners(state_owners_),
+        mounts(mounts_),
+        outputs(outputs_)
     {
         (*state_owners)++;
         POST(*state_owners > 0);
@@ -267,6 +948,9 @@ struct utils::process::executor::exit_handle::impl : utils::noncopyable {
     /// Termination status of the subprocess, or none if it timed out.
     const optional< process::status > status;
 
+    /// Resources consumed by the subprocess, if known.
+    const optional< process::resource_usage > usage;
+
     /// The user the process ran as, if different than the current one.
     const optional< passwd::user > unprivileged_user;
 
@@ -292,12 +976,18 @@ struct utils::process::executor::exit_handle::impl : utils::noncopyable {
     /// For all other cases, this will hold a higher value.
     detail::refcnt_t state_owners;
 
-    /// Mutable pointer to the corresponding executor state.
+    /// Mount namespace holding the work directory, if any.
+    mounts_ptr mounts;
+
+    /// Output streams provided by an output sink, if any.
+    outputs_ptr outputs;
+
+    /// Mutable pointer to the spare control directories of the executor.
     ///
     /// This object references a member of the executor_handle that yielded this
-    /// exit_handle instance.  We need this direct access to clean up after
-    /// ourselves when the handle is destroyed.
-    exec_handles_map& all_exec_handles;
+    /// exit_handle instance so that we can return our control directory for
+    /// reuse.
+    spare_directories_vector& spare_directories;
 
     /// Whether the subprocess state has been cleaned yet or not.
     ///
@@ -309,6 +999,7 @@ struct utils::process::executor::exit_handle::impl : utils::noncopyable {
     /// \param original_pid_ Original PID of the terminated subprocess.
     /// \param status_ Termination status of the subprocess, or none if
     ///     timed out.
+    /// \param usage_ Resources consumed by the subprocess, if known.
     /// \param unprivileged_user_ The user the process ran as, if different than
     ///     the current one.
     /// \param start_time_ Timestamp of when the subprocess was spawned.
@@ -319,11 +1010,14 @@ struct utils::process::executor::exit_handle::impl : utils::noncopyable {
     /// \param stdout_file_ Path to the subprocess's stdout file.
     /// \param stderr_file_ Path to the subprocess's stderr file.
     /// \param [in,out] state_owners_ Number of owners of the on-disk state.
-    /// \param [in,out] all_exec_handles_ Global object keeping track of all
-    ///     active executions for an executor.  This is a pointer to a member of
-    ///     the executor_handle object.
+    /// \param mounts_ Mount namespace holding the work directory, if any.
+    /// \param outputs_ Output streams provided by an output sink, if any.
+    /// \param [in,out] spare_directories_ Global collection of reusable control
+    ///     directories.  This is a pointer to a member of the executor_handle
+    ///     object.
     impl(const int original_pid_,
          const optional< process::status > status_,
+         const optional< process::resource_usage > usage_,
          const optional< passwd::user > unprivileged_user_,
          const datetime::timestamp& start_time_,
          const datetime::timestamp& end_time_,
@@ -331,14 +1025,16 @@ struct utils::process::executor::exit_handle::impl : utils::noncopyable {
          const fs::path& stdout_file_,
          const fs::path& stderr_file_,
          detail::refcnt_t state_owners_,
-         exec_handles_map& all_exec_handles_) :
-        original_pid(original_pid_), status(status_),
+         const mounts_ptr mounts_,
+         const outputs_ptr outputs_,
+         spare_directories_vector& spare_directories_) :
+        original_pid(original_pid_), status(status_), usage(usage_),
         unprivileged_user(unprivileged_user_),
         start_time(start_time_), end_time(end_time_),
         control_directory(control_directory_),
         stdout_file(stdout_file_), stderr_file(stderr_file_),
-        state_owners(state_owners_),
-        all_exec_handles(all_exec_handles_), cleaned(false)
+        state_owners(state_owners_), mounts(mounts_), outputs(outputs_),
+        spare_directories(spare_directories_), cleaned(false)
     {
     }
 
@@ -366,7 +1062,17 @@ struct utils::process::executor::exit_handle::impl : utils::noncopyable {
         PRE(*state_owners > 0);
         if (*state_owners == 1) {
             LI(F("Cleaning up exit_handle for exec_handle %s") % original_pid);
-            fs::rm_r(control_directory);
+            // Tearing down the namespace discards the work directory at once
+            // and leaves behind the empty mount point to be recycled.
+            if (mounts)
+                mounts->release();
+            if (outputs)
+                outputs->release();
+            if (recycle_control_directory(control_directory)) {
+                spare_directories.push_back(control_directory);
+            } else {
+                fs::rm_r(control_directory);
+            }
         } else {
             LI(F("Not cleaning up exit_handle for exec_handle %s; "
                  "%s owners left") % original_pid % (*state_owners - 1));
@@ -380,8 +1086,8 @@ struct utils::process::executor::exit_handle::impl : utils::noncopyable {
         // Marking this object as clean here, even if we did not do actually the
         // cleaning above, is fine (albeit a bit confusing).  Note that "another
         // owner" refers to a handle for a different PID, so that handle will be
-        // the one issuing the cleanup.
-        all_exec_handles.erase(original_pid);
+        // the one issuing the cleanup.  The subprocess was untracked when it
+        // was reaped: its PID may belong to a different subprocess by now.
         cleaned = true;
     }
 };
@@ -452,6 +1158,19 @@ executor::exit_handle::status(void) const
 }
 
 
+/// Returns the resources consumed by the subprocess.
+///
+/// Unlike status(), this is available even if the subprocess timed out.
+///
+/// \return The resource usage of the subprocess, or none if the platform does
+/// not report it.
+const optional< process::resource_usage >&
+executor::exit_handle::usage(void) const
+{
+    return _pimpl->usage;
+}
+
+
 /// Returns the user the process ran as if different than the current one.
 ///
 /// \return None if the credentials of the process were the same as the current
@@ -507,6 +1226,22 @@ executor::exit_handle::work_directory(void) const
 }
 
 
+/// Checks whether the subprocess ran in its own mount namespace.
+///
+/// If so, the contents of work_directory() are only visible from within the
+/// namespace, which followup subprocesses join, and the executor only sees an
+/// empty mount point.
+///
+/// \return True if the namespace of the subprocess is still held open; false
+/// if the subprocess ran in the namespace of the executor or if cleanup() was
+/// already called.
+bool
+executor::exit_handle::isolated_mounts(void) const
+{
+    return _pimpl->mounts.get() != NULL && _pimpl->mounts->fd() != -1;
+}
+
+
 /// Returns the path to the subprocess's stdout file.
 ///
 /// \return The path to a file that exists until cleanup() is called.
@@ -541,12 +1276,40 @@ struct utils::process::executor::executor_handle::impl : utils::noncopyable {
     /// Interrupts handler.
     std::auto_ptr< signals::interrupts_handler > interrupts_handler;
 
+    /// Programmer for the SIGCHLD handler that wakes up wait_any().
+    std::auto_ptr< signals::programmer > sigchld_programmer;
+
     /// Root work directory for all executed subprocesses.
     std::auto_ptr< fs::auto_directory > root_work_directory;
 
     /// Mapping of PIDs to the data required at run time.
     exec_handles_map all_exec_handles;
 
+    /// Emptied control directories of completed subprocesses, for reuse.
+    spare_directories_vector spare_directories;
+
+    /// Subprocesses reported as timed out but that have not terminated yet.
+    ///
+    /// Each of these holds a reference on the on-disk state of its subprocess
+    /// so that the control directory is not removed or reused while the
+    /// subprocess lives, and drops it once the subprocess is reaped.
+    std::map< int, std::pair< fs::path, detail::refcnt_t > > lingering;
+
+    /// Whether the root work directory is backed by a tmpfs we mounted.
+    bool root_tmpfs;
+
+    /// Size of the tmpfs to mount on each new work directory, if any.
+    optional< units::bytes > work_tmpfs_size;
+
+    /// Size of the tmpfs of the mount namespace of each subprocess, if any.
+    optional< units::bytes > work_mounts_size;
+
+    /// Parent end of the socket to talk to the subprocess being spawned.
+    int mounts_socket;
+
+    /// Destination of the output of new subprocesses; NULL to use files.
+    std::shared_ptr< executor::output_sink > output_sink;
+
     /// Whether the executor state has been cleaned yet or not.
     ///
     /// Used to keep track of explicit calls to the public cleanup().
@@ -556,8 +1319,11 @@ struct utils::process::executor::executor_handle::impl : utils::noncopyable {
     impl(void) :
         last_subprocess(0),
         interrupts_handler(new signals::interrupts_handler()),
+        sigchld_programmer(new signals::programmer(SIGCHLD, sigchld_handler)),
         root_work_directory(new fs::auto_directory(
             fs::auto_directory::mkdtemp_public(work_directory_template))),
+        root_tmpfs(false),
+        mounts_socket(-1),
         cleaned(false)
     {
     }
@@ -568,7 +1334,9 @@ struct utils::process::executor::executor_handle::impl : utils::noncopyable {
         if (!cleaned) {
             LW("Implicitly cleaning up executor; ignoring errors!");
             try {
-                cleanup();
+                cleanup(utils::make_optional(
+                    datetime::monotonic_time::now() +
+                    executor::interrupted_cleanup_timeout));
                 cleaned = true;
             } catch (const std::runtime_error& error) {
                 LE(F("Executor global cleanup failed: %s") % error.what());
@@ -576,53 +1344,238 @@ struct utils::process::executor::executor_handle::impl : utils::noncopyable {
         }
     }
 
+    /// Creates a new control directory and its work subdirectory.
+    ///
+    /// \return The path to the new control directory.
+    ///
+    /// \throw fs::error If the directories cannot be created or the tmpfs of
+    ///     the work directory cannot be mounted.
+    fs::path
+    create_control_directory(void)
+    {
+        ++last_subprocess;
+
+        const fs::path control_directory = root_work_directory->directory() /
+            (F("%s") % last_subprocess);
+        const fs::path work_directory = control_directory /
+            detail::work_subdir;
+        fs::mkdir_p(work_directory, 0755);
+
+        if (work_tmpfs_size) {
+            try {
+                fs::mount_tmpfs(work_directory, work_tmpfs_size.get());
+                // A fresh tmpfs is world-writable; restore the permissions of
+                // a regular work directory so that it can be recycled.
+                if (::chmod(work_directory.c_str(), 0755) == -1) {
+                    const int original_errno = errno;
+                    throw fs::system_error(F("Failed to set permissions of "
+                                             "%s") % work_directory,
+                                           original_errno);
+                }
+            } catch (const fs::error&) {
+                try {
+                    fs::rm_r(control_directory);
+                } catch (const fs::error& e2) {
+                    LW(F("Failed to remove %s: %s") % control_directory %
+                       e2.what());
+                }
+                throw;
+            }
+        }
+
+        return control_directory;
+    }
+
     /// Cleans up the executor state.
+    ///
+    /// All remaining subprocesses are killed before any of them is waited for
+    /// so that they all die concurrently, they are then reaped together in a
+    /// single polling loop, and their work directories are finally removed in
+    /// parallel.
+    ///
+    /// \param deadline If not none, the time at which to stop removing work
+    ///     directories and leave the remaining ones behind.
     void
-    cleanup(void)
+    cleanup(const optional< datetime::monotonic_time >& deadline = none)
     {
         PRE(!cleaned);
 
+        std::vector< int > pids;
+        std::vector< fs::path > directories;
         for (exec_handles_map::const_iterator iter = all_exec_handles.begin();
              iter != all_exec_handles.end(); ++iter) {
             const int& pid = (*iter).first;
             const exec_handle& data = (*iter).second;
 
             process::terminate_group(pid);
-            int status;
-            if (::waitpid(pid, &status, 0) == -1) {
-                // Should not happen.
-                LW(F("Failed to wait for PID %s") % pid);
+            if (data._pimpl->mounts)
+                data._pimpl->mounts->release();
+            if (data._pimpl->outputs)
+                data._pimpl->outputs->release();
+            pids.push_back(pid);
+            directories.push_back(data.control_directory());
+        }
+        all_exec_handles.clear();
+
+        std::vector< int > lingering_pids;
+        for (std::map< int, std::pair< fs::path, detail::refcnt_t > >::
+                 const_iterator iter = lingering.begin();
+             iter != lingering.end(); ++iter) {
+            const int pid = (*iter).first;
+            process::terminate_group(pid);
+            lingering_pids.push_back(pid);
+            if (--(*(*iter).second.second) == 0)
+                directories.push_back((*iter).second.first);
+        }
+        lingering.clear();
+
+        reap_killed(pids, lingering_pids);
+
+        directories.insert(directories.end(), spare_directories.begin(),
+                           spare_directories.end());
+        spare_directories.clear();
+
+        // The tmpfs of the work directories sit on top of the root tmpfs, so
+        // they have to be unmounted, which rm_r does, before the latter.
+        bool removed = false;
+        bool timed_out = false;
+        if (work_tmpfs_size) {
+            removed = true;
+            if (!remove_directories(directories, deadline)) {
+                timed_out = deadline &&
+                    datetime::monotonic_time::now() >= deadline.get();
             }
+        }
 
+        bool unmounted = false;
+        if (root_tmpfs && !timed_out) {
             try {
-                fs::rm_r(data.control_directory());
+                fs::unmount(root_work_directory->directory());
+                unmounted = true;
             } catch (const fs::error& e) {
-                LE(F("Failed to clean up subprocess work directory %s: %s") %
-                   data.control_directory() % e.what());
+                LE(F("Failed to unmount tmpfs from %s: %s") %
+                   root_work_directory->directory() % e.what());
             }
+            root_tmpfs = false;
         }
-        all_exec_handles.clear();
 
-        try {
-            // The following only causes the work directory to be deleted, not
-            // any of its contents, so we expect this to always succeed.  This
-            // *should* be sufficient because, in the loop above, we have
-            // individually wiped the subdirectories of any still-unclean
-            // subprocesses.
-            root_work_directory->cleanup();
-        } catch (const fs::error& e) {
-            LE(F("Failed to clean up executor work directory %s: %s; this is "
-                 "an internal error") % root_work_directory->directory()
-               % e.what());
+        // Unmounting the tmpfs discards all of its contents at once.
+        if (!unmounted && !removed &&
+            !remove_directories(directories, deadline)) {
+            timed_out = deadline &&
+                datetime::monotonic_time::now() >= deadline.get();
+        }
+
+        if (timed_out) {
+            LW(F("Leaving executor work directory %s behind") %
+               root_work_directory->directory());
+        } else {
+            try {
+                // The following only causes the work directory to be deleted,
+                // not any of its contents, so we expect this to always
+                // succeed.  This *should* be sufficient because, above, we
+                // have individually wiped the subdirectories of any
+                // still-unclean subprocesses.
+                root_work_directory->cleanup();
+            } catch (const fs::error& e) {
+                LE(F("Failed to clean up executor work directory %s: %s; this "
+                     "is an internal error") % root_work_directory->directory()
+                   % e.what());
+            }
         }
         root_work_directory.reset(NULL);
 
+        sigchld_programmer->unprogram();
+        sigchld_programmer.reset(NULL);
+
         interrupts_handler->unprogram();
         interrupts_handler.reset(NULL);
     }
 
+    /// Reaps a terminated subprocess after killing any leftover children.
+    ///
+    /// The subprocess must have been found as terminated but not yet waited for
+    /// so that its PID, and thus the ID of its process group, cannot have been
+    /// recycled when we kill the group.
+    ///
+    /// \param original_pid The PID of the terminated subprocess.
+    ///
+    /// \return A pointer to an object describing the waited-for subprocess.
+    executor::exit_handle
+    reap(const int original_pid)
+    {
+        process::terminate_group_of_zombie(original_pid);
+        return post_wait(original_pid, process::wait(original_pid));
+    }
+
+    /// Reaps a terminated subprocess if it was abandoned earlier.
+    ///
+    /// \param original_pid The PID of the terminated subprocess, which must
+    ///     not have been waited for yet.
+    ///
+    /// \return True if the subprocess was abandoned and has now been reaped;
+    /// false if it is a regular subprocess that the caller has to reap.
+    bool
+    reap_lingering(const int original_pid)
+    {
+        const std::map< int, std::pair< fs::path, detail::refcnt_t > >::
+            iterator iter = lingering.find(original_pid);
+        if (iter == lingering.end())
+            return false;
+
+        process::terminate_group_of_zombie(original_pid);
+        (void)process::wait(original_pid);
+        LI(F("Reaped abandoned subprocess %s") % original_pid);
+        if (--(*(*iter).second.second) == 0)
+            (void)remove_directory((*iter).second.first);
+        lingering.erase(iter);
+        return true;
+    }
+
+    /// Reports a subprocess that outlived its timeout as timed out.
+    ///
+    /// The subprocess stays around as a lingering process until it terminates,
+    /// at which point any of the wait calls reaps it transparently.
+    ///
+    /// \param [out] pending Set to true if there are subprocesses whose timeout
+    ///     fired recently and that may still terminate on their own.
+    ///
+    /// \return A handle for the abandoned subprocess, or none if there is no
+    /// subprocess to abandon.
+    optional< executor::exit_handle >
+    abandon_stuck(bool& pending)
+    {
+        pending = false;
+        const datetime::monotonic_time now = datetime::monotonic_time::now();
+        for (exec_handles_map::iterator iter = all_exec_handles.begin();
+             iter != all_exec_handles.end(); ++iter) {
+            const exec_handle data = (*iter).second;
+            if (!data._pimpl->timer.fired())
+                continue;
+            if (now < data._pimpl->deadline + executor::abandon_delay) {
+                pending = true;
+                continue;
+            }
+
+            LW(F("Subprocess with exec_handle %s did not terminate after "
+                 "timing out; abandoning it") % data.pid());
+            process::terminate_group(data.pid());
+            all_exec_handles.erase(iter);
+            ++(*data._pimpl->state_owners);
+            lingering.insert(std::make_pair(data.pid(), std::make_pair(
+                data.control_directory(), data._pimpl->state_owners)));
+            return utils::make_optional(
+                make_exit_handle(data, none, none));
+        }
+        return none;
+    }
+
     /// Common code to run after any of the wait calls.
     ///
+    /// The subprocess stops being tracked right away, before the caller gets a
+    /// chance to clean it up, because its PID is free for reuse by any new
+    /// subprocess from now on.
+    ///
     /// \param original_pid The PID of the terminated subprocess.
     /// \param status The exit status of the terminated subprocess.
     ///
@@ -633,12 +1586,11 @@ struct utils::process::executor::executor_handle::impl : utils::noncopyable {
         PRE(original_pid == status.dead_pid());
         LI(F("Waited for subprocess with exec_handle %s") % original_pid);
 
-        process::terminate_group(status.dead_pid());
-
         const exec_handles_map::iterator iter = all_exec_handles.find(
             original_pid);
-        exec_handle& data = (*iter).second;
+        const exec_handle data = (*iter).second;
         data._pimpl->timer.unprogram();
+        all_exec_handles.erase(iter);
 
         // It is tempting to assert here (and old code did) that, if the timer
         // has fired, the process has been forcibly killed by us.  This is not
@@ -651,6 +1603,25 @@ struct utils::process::executor::executor_handle::impl : utils::noncopyable {
         // this correctly but we don't care because this should not really
         // happen.
 
+        return make_exit_handle(
+            data,
+            data._pimpl->timer.fired() ? none : utils::make_optional(status),
+            status.usage());
+    }
+
+    /// Creates the exit handle of a subprocess that is no longer running.
+    ///
+    /// \param data The execution handle of the subprocess.
+    /// \param status The termination status of the subprocess, or none if it
+    ///     timed out.
+    /// \param usage The resources consumed by the subprocess, if known.
+    ///
+    /// \return A pointer to an object describing the subprocess.
+    executor::exit_handle
+    make_exit_handle(const exec_handle& data,
+                     const optional< process::status >& status,
+                     const optional< process::resource_usage >& usage)
+    {
         if (!fs::exists(data.stdout_file())) {
             std::ofstream new_stdout(data.stdout_file().c_str());
         }
@@ -661,15 +1632,19 @@ struct utils::process::executor::executor_handle::impl : utils::noncopyable {
         return exit_handle(std::shared_ptr< exit_handle::impl >(
             new exit_handle::impl(
                 data.pid(),
-                data._pimpl->timer.fired() ?
-                    none : utils::make_optional(status),
+                status,
+                usage,
                 data._pimpl->unprivileged_user,
-                data._pimpl->start_time, datetime::timestamp::now(),
+                data._pimpl->start_time,
+                data._pimpl->start_time + (datetime::monotonic_time::now() -
+                                           data._pimpl->monotonic_start),
                 data.control_directory(),
                 data.stdout_file(),
                 data.stderr_file(),
                 data._pimpl->state_owners,
-                all_exec_handles)));
+                data._pimpl->mounts,
+                data._pimpl->outputs,
+                spare_directories)));
     }
 };
 
@@ -696,6 +1671,137 @@ executor::executor_handle::root_work_directory(void) const
 }
 
 
+/// Backs the root work directory with a tmpfs file system.
+///
+/// This keeps the creation and removal of the work directories of the
+/// subprocesses off the disk, which matters on slow or network-backed file
+/// systems.  The file system is unmounted by cleanup().
+///
+/// \pre No subprocesses have been spawned yet.
+///
+/// \throw fs::error If the tmpfs cannot be mounted, for example because we
+///     lack the privileges to do so.
+void
+executor::executor_handle::mount_root_tmpfs(void)
+{
+    PRE(_pimpl->last_subprocess == 0);
+    PRE(!_pimpl->root_tmpfs);
+
+    fs::mount_tmpfs(_pimpl->root_work_directory->directory());
+    _pimpl->root_tmpfs = true;
+    LI(F("Mounted tmpfs on %s") % _pimpl->root_work_directory->directory());
+}
+
+
+/// Backs the work directory of every execution slot with its own tmpfs.
+///
+/// Each new work directory gets a size-limited tmpfs that stays mounted while
+/// the directory is recycled across subprocesses, so a subprocess can only
+/// fill its own file system and emptying it never touches the disk.  The
+/// number of mounts thus tracks the number of subprocesses that run
+/// concurrently.  The file systems are unmounted when their directories are
+/// removed.
+///
+/// The first work directory is created right away so that any problem with
+/// mounting the file system is reported here.
+///
+/// \pre No subprocesses have been spawned yet.
+///
+/// \param size Maximum size of each file system; 0 for no limit.
+///
+/// \throw fs::error If the tmpfs cannot be mounted, for example because we
+///     lack the privileges to do so.
+void
+executor::executor_handle::mount_work_tmpfs(const units::bytes& size)
+{
+    PRE(_pimpl->last_subprocess == 0);
+    PRE(!_pimpl->work_tmpfs_size);
+    PRE(!_pimpl->work_mounts_size);
+
+    _pimpl->work_tmpfs_size = size;
+    try {
+        _pimpl->spare_directories.push_back(
+            _pimpl->create_control_directory());
+    } catch (const fs::error&) {
+        _pimpl->work_tmpfs_size = none;
+        _pimpl->last_subprocess = 0;
+        throw;
+    }
+    LI(F("Mounting a tmpfs of %s on each work directory") % size);
+}
+
+
+/// Runs every subprocess in its own mount namespace.
+///
+/// Each subprocess mounts a fresh tmpfs on its work directory inside a private
+/// mount namespace, so whatever it writes there never reaches the disk and is
+/// discarded at once when the last process in the namespace goes away, which
+/// is when the cleanup of its exit_handle runs.  Followup subprocesses spawned
+/// with spawn_followup() join the namespace of their base subprocess.
+///
+/// Because the parent lives outside of the namespace, it only sees the empty
+/// mount point when inspecting the work directory of a subprocess.
+///
+/// This is only supported on Linux.  Subprocesses that cannot set up the
+/// namespace run with the mounts of the executor instead.
+///
+/// \pre No subprocesses have been spawned yet.
+///
+/// \param size Maximum size of each file system; 0 for no limit.
+///
+/// \throw fs::error If we lack the privileges to create mount namespaces.
+void
+executor::executor_handle::isolate_work_mounts(const units::bytes& size)
+{
+    PRE(_pimpl->last_subprocess == 0);
+    PRE(!_pimpl->work_tmpfs_size);
+    PRE(!_pimpl->work_mounts_size);
+
+    if (!passwd::current_user().is_root())
+        throw fs::error("Creating mount namespaces requires root privileges");
+    _pimpl->work_mounts_size = size;
+    LI(F("Isolating each work directory in a mount namespace with a tmpfs "
+         "of %s") % size);
+}
+
+
+/// Sets the destination of the output of new subprocesses.
+///
+/// Subprocesses spawned afterwards without explicit output targets write
+/// their stdout and stderr to the descriptors provided by the sink.  Followup
+/// subprocesses keep appending to the streams of their base subprocess.
+///
+/// \param sink The sink to use, or NULL to go back to files in the control
+///     directories.
+void
+executor::executor_handle::set_output_sink(
+    const std::shared_ptr< output_sink > sink)
+{
+    _pimpl->output_sink = sink;
+}
+
+
+/// Creates control directories in advance for the subprocesses to spawn.
+///
+/// Spawning a subprocess takes a control directory left behind by an earlier
+/// subprocess if there is any, or creates a new one otherwise, which involves
+/// mounting its tmpfs if mount_work_tmpfs() was called.  Reserving directories
+/// while waiting for subprocesses moves this work out of the spawns.
+///
+/// \param count Number of spare control directories to have available.
+///
+/// \throw fs::error If the creation of any directory fails.
+void
+executor::executor_handle::reserve_directories(const std::size_t count)
+{
+    while (_pimpl->spare_directories.size() < count) {
+        const fs::path control_directory = _pimpl->create_control_directory();
+        LD(F("Reserved control directory %s") % control_directory);
+        _pimpl->spare_directories.push_back(control_directory);
+    }
+}
+
+
 /// Cleans up the executor state.
 ///
 /// This function should be called explicitly as it provides the means to
@@ -733,14 +1839,96 @@ executor::executor_handle::spawn_pre(void)
 {
     signals::check_interrupt();
 
-    ++_pimpl->last_subprocess;
+    if (!_pimpl->spare_directories.empty()) {
+        const fs::path control_directory = _pimpl->spare_directories.back();
+        _pimpl->spare_directories.pop_back();
+        LD(F("Reusing control directory %s") % control_directory);
+        return control_directory;
+    }
+
+    return _pimpl->create_control_directory();
+}
+
+
+/// Prepares the mount namespace of a new subprocess.
+///
+/// \return The setup to pass to the subprocess; its descriptor is -1 if the
+/// subprocess has to keep the mounts of the executor.
+executor::detail::mounts_setup
+executor::executor_handle::spawn_mounts_pre(void)
+{
+    if (_pimpl->mounts_socket != -1) {
+        // Left behind by a previous spawn() that failed to fork.
+        ::close(_pimpl->mounts_socket);
+        _pimpl->mounts_socket = -1;
+    }
 
-    const fs::path control_directory =
-        _pimpl->root_work_directory->directory() /
-        (F("%s") % _pimpl->last_subprocess);
-    fs::mkdir_p(control_directory / detail::work_subdir, 0755);
+    detail::mounts_setup mounts = { -1, false, 0 };
+    if (!_pimpl->work_mounts_size)
+        return mounts;
 
-    return control_directory;
+    int fds[2];
+    if (::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == -1) {
+        const int original_errno = errno;
+        LW(F("Cannot create socket to set up mount namespace: %s") %
+           std::strerror(original_errno));
+        return mounts;
+    }
+    (void)::fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    (void)::fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+    _pimpl->mounts_socket = fds[0];
+    mounts.fd = fds[1];
+    mounts.size = _pimpl->work_mounts_size.get();
+    return mounts;
+}
+
+
+/// Opens the output streams of a new subprocess through the output sink.
+///
+/// \param [in,out] stdout_file Path to the subprocess' stdout in its control
+///     directory; updated to where the sink puts it.
+/// \param [in,out] stderr_file Path to the subprocess' stderr in its control
+///     directory; updated to where the sink puts it.
+///
+/// \return The descriptors for the subprocess to write to; both -1 if there is
+/// no sink and the subprocess has to write to its files instead.
+///
+/// \throw std::runtime_error If the sink fails to open the streams.
+executor::detail::output_fds
+executor::executor_handle::spawn_output_pre(fs::path& stdout_file,
+                                            fs::path& stderr_file)
+{
+    detail::output_fds fds = { -1, -1 };
+    if (_pimpl->output_sink.get() == NULL)
+        return fds;
+
+    fds.stdout_fd = _pimpl->output_sink->open(stdout_file);
+    try {
+        fds.stderr_fd = _pimpl->output_sink->open(stderr_file);
+    } catch (...) {
+        ::close(fds.stdout_fd);
+        _pimpl->output_sink->release(stdout_file);
+        throw;
+    }
+    return fds;
+}
+
+
+/// Releases the output streams of a subprocess that failed to spawn.
+///
+/// \param fds The descriptors returned by spawn_output_pre().
+/// \param stdout_file Path to the subprocess' stdout.
+/// \param stderr_file Path to the subprocess' stderr.
+void
+executor::executor_handle::spawn_output_abort(const detail::output_fds& fds,
+                                              const fs::path& stdout_file,
+                                              const fs::path& stderr_file)
+{
+    if (fds.stdout_fd == -1)
+        return;
+    ::close(fds.stdout_fd);
+    ::close(fds.stderr_fd);
+    outputs_holder(_pimpl->output_sink, stdout_file, stderr_file).release();
 }
 
 
@@ -749,8 +1937,10 @@ executor::executor_handle::spawn_pre(void)
 /// \param control_directory Control directory as returned by spawn_pre().
 /// \param stdout_file Path to the subprocess' stdout.
 /// \param stderr_file Path to the subprocess' stderr.
+/// \param fds Output descriptors as returned by spawn_output_pre().
 /// \param timeout Maximum amount of time the subprocess can run for.
 /// \param unprivileged_user If not none, user to switch to before execution.
+/// \param mounts Mount namespace setup as returned by spawn_mounts_pre().
 /// \param child The process created by spawn().
 ///
 /// \return The execution handle of the started subprocess.
@@ -759,10 +1949,28 @@ executor::executor_handle::spawn_post(
     const fs::path& control_directory,
     const fs::path& stdout_file,
     const fs::path& stderr_file,
+    const detail::output_fds& fds,
     const datetime::delta& timeout,
     const optional< passwd::user > unprivileged_user,
+    const detail::mounts_setup& mounts,
     std::auto_ptr< process::child > child)
 {
+    outputs_ptr outputs;
+    if (fds.stdout_fd != -1) {
+        ::close(fds.stdout_fd);
+        ::close(fds.stderr_fd);
+        outputs.reset(new outputs_holder(_pimpl->output_sink, stdout_file,
+                                         stderr_file));
+    }
+
+    mounts_ptr namespace_mounts;
+    if (mounts.fd != -1) {
+        ::close(mounts.fd);
+        const int sync_fd = _pimpl->mounts_socket;
+        _pimpl->mounts_socket = -1;
+        namespace_mounts = receive_mounts(sync_fd, child->pid());
+    }
+
     const exec_handle handle(std::shared_ptr< exec_handle::impl >(
         new exec_handle::impl(
             child->pid(),
@@ -772,7 +1980,9 @@ executor::executor_handle::spawn_post(
             datetime::timestamp::now(),
             timeout,
             unprivileged_user,
-            detail::refcnt_t(new detail::refcnt_t::element_type(0)))));
+            detail::refcnt_t(new detail::refcnt_t::element_type(0)),
+            namespace_mounts,
+            outputs)));
     INV_MSG(_pimpl->all_exec_handles.find(handle.pid()) ==
             _pimpl->all_exec_handles.end(),
             F("PID %s already in all_exec_handles; not properly cleaned "
@@ -785,10 +1995,23 @@ executor::executor_handle::spawn_post(
 
 
 /// Pre-helper for the spawn_followup() method.
-void
-executor::executor_handle::spawn_followup_pre(void)
+///
+/// \param base Exit handle of the subprocess to use as context.
+///
+/// \return The setup to pass to the subprocess so that it joins the mount
+/// namespace of the base subprocess, if any.
+executor::detail::mounts_setup
+executor::executor_handle::spawn_followup_pre(const exit_handle& base)
 {
     signals::check_interrupt();
+
+    const mounts_ptr& base_mounts = base._pimpl->mounts;
+    detail::mounts_setup mounts = { -1, false, 0 };
+    if (base_mounts && base_mounts->fd() != -1) {
+        mounts.fd = base_mounts->fd();
+        mounts.join = true;
+    }
+    return mounts;
 }
 
 
@@ -815,7 +2038,9 @@ executor::executor_handle::spawn_followup_post(
             datetime::timestamp::now(),
             timeout,
             base.unprivileged_user(),
-            base.state_owners())));
+            base.state_owners(),
+            base._pimpl->mounts,
+            base._pimpl->outputs)));
     INV_MSG(_pimpl->all_exec_handles.find(handle.pid()) ==
             _pimpl->all_exec_handles.end(),
             F("PID %s already in all_exec_handles; not properly cleaned "
@@ -836,20 +2061,96 @@ executor::exit_handle
 executor::executor_handle::wait(const exec_handle exec_handle)
 {
     signals::check_interrupt();
-    const process::status status = process::wait(exec_handle.pid());
-    return _pimpl->post_wait(exec_handle.pid(), status);
+    return _pimpl->reap(process::peek(exec_handle.pid()));
 }
 
 
 /// Waits for completion of any forked process.
 ///
+/// Subprocesses that do not terminate within abandon_delay of their timeout
+/// firing are returned as timed out without waiting for them any longer.
+///
+/// The termination of any subprocess, the expiration of any timer and the
+/// arrival of any interrupt wake up the wait, at which point this polls for the
+/// killed subprocesses until they die or until they have to be abandoned.
+///
 /// \return A pointer to an object describing the waited-for subprocess.
 executor::exit_handle
 executor::executor_handle::wait_any(void)
 {
-    signals::check_interrupt();
-    const process::status status = process::wait_any();
-    return _pimpl->post_wait(status.dead_pid(), status);
+    for (;;) {
+        optional< int > pid;
+        bool pending = false;
+        {
+            const wakeup_signals_blocker blocker;
+            signals::check_interrupt();
+
+            pid = process::peek_any(false);
+            if (!pid) {
+                const optional< exit_handle > stuck = _pimpl->abandon_stuck(
+                    pending);
+                if (stuck)
+                    return stuck.get();
+                if (!pending) {
+                    blocker.suspend();
+                    continue;
+                }
+            }
+        }
+
+        if (pending) {
+            // Give the timed out subprocesses a chance to die before
+            // abandoning them.
+            ::usleep(abandon_poll_usec);
+            continue;
+        }
+
+        if (!_pimpl->reap_lingering(pid.get()))
+            return _pimpl->reap(pid.get());
+    }
+}
+
+
+/// Checks for completion of any forked process without blocking.
+///
+/// \return A pointer to an object describing the waited-for subprocess, or
+/// none if no subprocess has terminated yet.
+optional< executor::exit_handle >
+executor::executor_handle::poll_any(void)
+{
+    for (;;) {
+        signals::check_interrupt();
+
+        const optional< int > pid = process::peek_any(false);
+        if (!pid) {
+            bool unused_pending;
+            return _pimpl->abandon_stuck(unused_pending);
+        }
+
+        if (!_pimpl->reap_lingering(pid.get()))
+            return utils::make_optional(_pimpl->reap(pid.get()));
+    }
+}
+
+
+/// Forcibly terminates a subprocess before it completes.
+///
+/// The subprocess and any other process in its process group are killed.  The
+/// subprocess must still be waited for with any of the wait calls, which report
+/// it as killed by a signal.  This is a no-op if the subprocess has already
+/// been waited for: its PID may have been reused by then.
+///
+/// \param original_pid The PID of the subprocess, as returned by
+///     exec_handle::pid().
+void
+executor::executor_handle::terminate(const int original_pid)
+{
+    if (_pimpl->all_exec_handles.find(original_pid) ==
+        _pimpl->all_exec_handles.end())
+        return;
+
+    LI(F("Terminating subprocess with exec_handle %s") % original_pid);
+    process::terminate_group(original_pid);
 }
 
 
@@ -64,6 +64,10 @@
 
 #include "utils/process/executor_fwd.hpp"
 
+extern "C" {
+#include <stdint.h>
+}
+
 #include <cstddef>
 
 #include "utils/datetime_fwd.hpp"
@@ -71,8 +75,10 @@
 #include "utils/optional.hpp"
 #include "utils/passwd_fwd.hpp"
 #include "utils/process/child_fwd.hpp"
+#include "utils/process/resource_usage_fwd.hpp"
 #include "utils/process/status_fwd.hpp"
 #include "utils/shared_ptr.hpp"
+#include "utils/units_fwd.hpp"
 
 namespace utils {
 namespace process {
@@ -91,13 +97,72 @@ extern const char* work_subdir;
 typedef std::shared_ptr< std::size_t > refcnt_t;
 
 
+/// Mount namespace in which a subprocess runs.
+struct mounts_setup {
+    /// Descriptor to pass to the subprocess, or -1 to keep the mounts of the
+    /// executor.
+    ///
+    /// If join is false, this is the socket on which the subprocess reports
+    /// that it created its own namespace.  Otherwise, this is the namespace to
+    /// join.
+    int fd;
+
+    /// Whether the subprocess joins an existing namespace.
+    bool join;
+
+    /// Size of the tmpfs of a new namespace, in bytes; 0 for no limit.
+    uint64_t size;
+};
+
+
+/// Descriptors to which a new subprocess writes its output.
+struct output_fds {
+    /// Descriptor for the stdout, or -1 to write to the stdout file.
+    int stdout_fd;
+
+    /// Descriptor for the stderr, or -1 to write to the stderr file.
+    int stderr_fd;
+};
+
+
+void resolve_current_user(void);
 void setup_child(const utils::optional< utils::passwd::user >,
-                 const utils::fs::path&, const utils::fs::path&);
+                 const utils::fs::path&, const utils::fs::path&,
+                 const mounts_setup&);
 
 
 }   // namespace detail
 
 
+/// Destination of the output of the subprocesses spawned by the executor.
+///
+/// By default, the stdout and stderr of a subprocess are written to files in
+/// its control directory.  A sink installed with
+/// executor_handle::set_output_sink() can provide other destinations, such as
+/// in-memory files or pipes, without the callers of spawn() having to change
+/// how they read the output back: they keep using the paths returned by
+/// exit_handle::stdout_file() and exit_handle::stderr_file().
+class output_sink {
+public:
+    virtual ~output_sink(void);
+
+    /// Opens the destination of an output stream of a new subprocess.
+    ///
+    /// \param [in,out] file On input, the file in the control directory to
+    ///     which the stream would be written by default.  On output, the file
+    ///     from which the stream can be read back and to which followup
+    ///     subprocesses append their own output.
+    ///
+    /// \return The descriptor to which the subprocess writes the stream.  The
+    /// executor closes it once the subprocess has been spawned.
+    ///
+    /// \throw std::runtime_error If the destination cannot be opened.
+    virtual int open(utils::fs::path& file) = 0;
+
+    virtual void release(const utils::fs::path& file);
+};
+
+
 /// Maintenance data held while a subprocess is being executed.
 ///
 /// This data structure exists from the moment a subprocess is executed via
@@ -158,11 +223,13 @@ public:
 
     int original_pid(void) const;
     const utils::optional< utils::process::status >& status(void) const;
+    const utils::optional< utils::process::resource_usage >& usage(void) const;
     const utils::optional< utils::passwd::user >& unprivileged_user(void) const;
     const utils::datetime::timestamp& start_time() const;
     const utils::datetime::timestamp& end_time() const;
     utils::fs::path control_directory(void) const;
     utils::fs::path work_directory(void) const;
+    bool isolated_mounts(void) const;
     const utils::fs::path& stdout_file(void) const;
     const utils::fs::path& stderr_file(void) const;
 };
@@ -182,14 +249,20 @@ class executor_handle {
     executor_handle(void) throw();
 
     utils::fs::path spawn_pre(void);
+    detail::mounts_setup spawn_mounts_pre(void);
+    detail::output_fds spawn_output_pre(utils::fs::path&, utils::fs::path&);
+    void spawn_output_abort(const detail::output_fds&,
+                            const utils::fs::path&, const utils::fs::path&);
     exec_handle spawn_post(const utils::fs::path&,
                            const utils::fs::path&,
                            const utils::fs::path&,
+                           const detail::output_fds&,
                            const utils::datetime::delta&,
                            const utils::optional< utils::passwd::user >,
+                           const detail::mounts_setup&,
                            std::auto_ptr< utils::process::child >);
 
-    void spawn_followup_pre(void);
+    detail::mounts_setup spawn_followup_pre(const exit_handle&);
     exec_handle spawn_followup_post(const exit_handle&,
                                     const utils::datetime::delta&,
                                     std::auto_ptr< utils::process::child >);
@@ -199,6 +272,11 @@ public:
 
     const utils::fs::path& root_work_directory(void) const;
 
+    void mount_root_tmpfs(void);
+    void mount_work_tmpfs(const utils::units::bytes&);
+    void isolate_work_mounts(const utils::units::bytes&);
+    void set_output_sink(const std::shared_ptr< output_sink >);
+    void reserve_directories(const std::size_t);
     void cleanup(void);
 
     template< class Hook >
@@ -215,11 +293,17 @@ public:
 
     exit_handle wait(const exec_handle);
     exit_handle wait_any(void);
+    utils::optional< exit_handle > poll_any(void);
+    void terminate(const int);
 
     void check_interrupt(void) const;
 };
 
 
+extern utils::datetime::delta interrupted_cleanup_timeout;
+extern utils::datetime::delta abandon_delay;
+
+
 executor_handle setup(void);
 
 
@@ -68,6 +68,9 @@ class run_child {
     /// the control and work directories will be writable by this user.
     const optional< passwd::user > _unprivileged_user;
 
+    /// Mount namespace in which to run the subprocess.
+    const mounts_setup _mounts;
+
 public:
     /// Constructor.
     ///
@@ -75,14 +78,17 @@ public:
     /// \param control_directory Directory where control files can be placed.
     /// \param work_directory Directory to enter when running the subprocess.
     /// \param unprivileged_user If set, user to switch to before execution.
+    /// \param mounts Mount namespace in which to run the subprocess.
     run_child(Hook hook,
               const fs::path& control_directory,
               const fs::path& work_directory,
-              const optional< passwd::user > unprivileged_user) :
+              const optional< passwd::user > unprivileged_user,
+              const mounts_setup& mounts) :
         _hook(hook),
         _control_directory(control_directory),
         _work_directory(work_directory),
-        _unprivileged_user(unprivileged_user)
+        _unprivileged_user(unprivileged_user),
+        _mounts(mounts)
     {
     }
 
@@ -91,7 +97,8 @@ public:
     operator()(void)
     {
         executor::detail::setup_child(_unprivileged_user,
-                                      _control_directory, _work_directory);
+                                      _control_directory, _work_directory,
+                                      _mounts);
         _hook(_control_directory);
     }
 };
@@ -111,6 +118,10 @@ public:
 /// \param stderr_target If not none, file to which to write the stderr of the
 ///     test case.
 ///
+/// If neither target is given and an output sink has been installed, the
+/// output of the subprocess goes to the destinations provided by the sink
+/// instead of to files in its control directory.
+///
 /// \return A handle for the background operation.  Used to match the result of
 /// the execution returned by wait_any() with this invocation.
 template< class Hook >
@@ -123,21 +134,42 @@ executor::executor_handle::spawn(
     const optional< fs::path > stderr_target)
 {
     const fs::path unique_work_directory = spawn_pre();
+    const detail::mounts_setup mounts = spawn_mounts_pre();
+
+    // The child looks up the current user to decide whether it can drop
+    // privileges.  Resolve it here so that the child gets it from the cache it
+    // inherits instead of querying the system databases after every fork.
+    if (unprivileged_user)
+        detail::resolve_current_user();
 
-    const fs::path stdout_path = stdout_target ?
+    fs::path stdout_path = stdout_target ?
         stdout_target.get() : (unique_work_directory / detail::stdout_name);
-    const fs::path stderr_path = stderr_target ?
+    fs::path stderr_path = stderr_target ?
         stderr_target.get() : (unique_work_directory / detail::stderr_name);
 
-    std::auto_ptr< process::child > child = process::child::fork_files(
-        detail::run_child< Hook >(hook,
-                                  unique_work_directory,
-                                  unique_work_directory / detail::work_subdir,
-                                  unprivileged_user),
-        stdout_path, stderr_path);
+    detail::output_fds fds = { -1, -1 };
+    if (!stdout_target && !stderr_target)
+        fds = spawn_output_pre(stdout_path, stderr_path);
+
+    const fs::path work_directory = unique_work_directory / detail::work_subdir;
+    const detail::run_child< Hook > body(hook, unique_work_directory,
+                                         work_directory, unprivileged_user,
+                                         mounts);
+
+    std::auto_ptr< process::child > child;
+    try {
+        if (fds.stdout_fd == -1)
+            child = process::child::fork_files(body, stdout_path, stderr_path);
+        else
+            child = process::child::fork_fds(body, fds.stdout_fd,
+                                             fds.stderr_fd);
+    } catch (...) {
+        spawn_output_abort(fds, stdout_path, stderr_path);
+        throw;
+    }
 
-    return spawn_post(unique_work_directory, stdout_path, stderr_path,
-                      timeout, unprivileged_user, child);
+    return spawn_post(unique_work_directory, stdout_path, stderr_path, fds,
+                      timeout, unprivileged_user, mounts, child);
 }
 
 
@@ -145,7 +177,8 @@ executor::executor_handle::spawn(
 ///
 /// By context we understand the on-disk state of a previously-executed process,
 /// thus the new subprocess spawned by this function will run with the same
-/// control and work directories as another process.
+/// control and work directories as another process.  If the base process ran
+/// in its own mount namespace, the new subprocess joins it.
 ///
 /// \tparam Hook Type of the hook.
 /// \param hook Function or functor to run in the subprocess.
@@ -163,13 +196,13 @@ executor::executor_handle::spawn_followup(Hook hook,
                                           const exit_handle& base,
                                           const datetime::delta& timeout)
 {
-    spawn_followup_pre();
+    const detail::mounts_setup mounts = spawn_followup_pre(base);
 
     std::auto_ptr< process::child > child = process::child::fork_files(
         detail::run_child< Hook >(hook,
                                   base.control_directory(),
                                   base.work_directory(),
-                                  base.unprivileged_user()),
+                                  base.unprivileged_user(), mounts),
         base.stdout_file(), base.stderr_file());
 
     return spawn_followup_post(base, timeout, child);
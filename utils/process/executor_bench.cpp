@@ -0,0 +1,224 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// \file utils/process/executor_bench.cpp
+/// Stress benchmarks for the spawning and reaping of many subprocesses.
+
+#include "utils/process/executor.ipp"
+
+#include <cstddef>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <string>
+
+#include <atf-c++.hpp>
+
+#include "utils/datetime.hpp"
+#include "utils/defs.hpp"
+#include "utils/format/macros.hpp"
+#include "utils/fs/path.hpp"
+#include "utils/latency_histogram.hpp"
+#include "utils/optional.ipp"
+#include "utils/process/operations.hpp"
+#include "utils/process/status.hpp"
+#include "utils/test_utils.ipp"
+#include "utils/text/operations.ipp"
+
+namespace datetime = utils::datetime;
+namespace executor = utils::process::executor;
+namespace fs = utils::fs;
+namespace process = utils::process;
+namespace text = utils::text;
+
+using utils::none;
+
+
+namespace {
+
+
+/// Subprocess that runs the print-and-sleep helper.
+class helper_child {
+    /// Path to the helpers binary.
+    fs::path _helpers;
+
+    /// Number of bytes for the helper to print to stdout.
+    std::size_t _bytes;
+
+    /// Time for the helper to sleep for after printing, in microseconds.
+    unsigned long _usecs;
+
+public:
+    /// Constructor.
+    ///
+    /// \param helpers Path to the helpers binary.
+    /// \param bytes Number of bytes for the helper to print to stdout.
+    /// \param usecs Time for the helper to sleep for, in microseconds.
+    helper_child(const fs::path& helpers, const std::size_t bytes,
+                 const unsigned long usecs) :
+        _helpers(helpers), _bytes(bytes), _usecs(usecs)
+    {
+    }
+
+    /// Runs the subprocess.
+    ///
+    /// \param unused_control_directory Directory where control files separate
+    ///     from the work directory can be placed.
+    void
+    operator()(const fs::path& UTILS_UNUSED_PARAM(control_directory))
+        UTILS_NORETURN
+    {
+        process::args_vector args;
+        args.push_back("print-and-sleep");
+        args.push_back(F("%s") % _bytes);
+        args.push_back(F("%s") % _usecs);
+        process::exec(_helpers, args);
+    }
+};
+
+
+/// Gets the number of subprocesses to keep running at once.
+///
+/// \param tc The calling test.
+///
+/// \return The value of the benchmark_concurrency configuration variable, or
+/// 500 if not set.
+static std::size_t
+benchmark_concurrency(const atf::tests::tc* tc)
+{
+    if (tc->has_config_var("benchmark_concurrency"))
+        return text::to_type< std::size_t >(
+            tc->get_config_var("benchmark_concurrency"));
+    else
+        return 500;
+}
+
+
+/// Spawns and reaps many subprocesses with randomized parameters.
+///
+/// The executor is kept full: a new subprocess is spawned as soon as any other
+/// terminates.  The parameters of the subprocesses are drawn from a fixed seed
+/// so that consecutive runs are comparable.
+///
+/// \param tc The calling test.
+/// \param timeout_percent Percentage of the subprocesses whose timeout is
+///     shorter than their lifetime.
+static void
+run_stress(const atf::tests::tc* tc, const int timeout_percent)
+{
+    const fs::path helpers = fs::path(tc->get_config_var("srcdir")) /
+        "helpers";
+    const std::size_t iterations = utils::benchmark_iterations(tc, 2000);
+    const std::size_t concurrency = benchmark_concurrency(tc);
+    std::srand(1);
+
+    utils::latency_histogram spawn_latencies;
+    utils::latency_histogram reap_latencies;
+    std::map< int, datetime::delta > lifetimes;
+    std::size_t timed_out = 0;
+
+    executor::executor_handle handle = executor::setup();
+    const datetime::timestamp start = datetime::timestamp::now();
+    std::size_t spawned = 0;
+    std::size_t reaped = 0;
+    while (reaped < iterations) {
+        while (spawned < iterations && spawned - reaped < concurrency) {
+            const unsigned long usecs = 2000 + std::rand() % 20000;
+            const std::size_t bytes = std::rand() % 65536;
+            const datetime::delta lifetime =
+                datetime::delta::from_microseconds(usecs);
+            const datetime::delta timeout = std::rand() % 100 <
+                timeout_percent ?
+                datetime::delta::from_microseconds(usecs / 2) :
+                datetime::delta(60, 0);
+
+            const datetime::timestamp before = datetime::timestamp::now();
+            const executor::exec_handle exec_handle = handle.spawn(
+                helper_child(helpers, bytes, usecs), timeout, none);
+            spawn_latencies.record_interval(before,
+                                            datetime::timestamp::now());
+            lifetimes[exec_handle.pid()] = lifetime;
+            ++spawned;
+        }
+
+        executor::exit_handle exit_handle = handle.wait_any();
+        const std::map< int, datetime::delta >::iterator iter =
+            lifetimes.find(exit_handle.original_pid());
+        ATF_REQUIRE(iter != lifetimes.end());
+        if (exit_handle.status() && exit_handle.status().get().exited()) {
+            // The time past the lifetime of the subprocess is what it took to
+            // exec the helper and to notice its termination.
+            const datetime::timestamp expected_end =
+                exit_handle.start_time() + (*iter).second;
+            if (exit_handle.end_time() > expected_end)
+                reap_latencies.record(exit_handle.end_time() - expected_end);
+        } else {
+            ++timed_out;
+        }
+        lifetimes.erase(iter);
+        exit_handle.cleanup();
+        ++reaped;
+    }
+    utils::report_benchmark(tc, iterations,
+                            datetime::timestamp::now() - start);
+    handle.cleanup();
+
+    std::cout << tc->get_md_var("ident") << ".concurrency = " << concurrency
+              << '\n';
+    std::cout << tc->get_md_var("ident") << ".timed_out = " << timed_out
+              << '\n';
+    utils::report_benchmark_latencies(tc, "spawn", spawn_latencies);
+    if (reap_latencies.count() > 0)
+        utils::report_benchmark_latencies(tc, "reap", reap_latencies);
+}
+
+
+}  // anonymous namespace
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(spawn_wait__stress);
+ATF_TEST_CASE_BODY(spawn_wait__stress)
+{
+    utils::require_run_benchmarks(this);
+    run_stress(this, 5);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(spawn_wait__timeouts);
+ATF_TEST_CASE_BODY(spawn_wait__timeouts)
+{
+    utils::require_run_benchmarks(this);
+    run_stress(this, 100);
+}
+
+
+ATF_INIT_TEST_CASES(tcs)
+{
+    ATF_ADD_TEST_CASE(tcs, spawn_wait__stress);
+    ATF_ADD_TEST_CASE(tcs, spawn_wait__timeouts);
+}
@@ -40,6 +40,7 @@ namespace executor {
 class exec_handle;
 class executor_handle;
 class exit_handle;
+class output_sink;
 
 
 }  // namespace executor
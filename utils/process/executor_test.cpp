@@ -30,17 +30,23 @@
 
 extern "C" {
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <sys/time.h>
 #include <sys/wait.h>
 
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
 #include <signal.h>
 #include <unistd.h>
 }
 
 #include <cerrno>
+#include <cstddef>
 #include <cstdlib>
 #include <fstream>
 #include <iostream>
+#include <string>
 #include <vector>
 
 #include <atf-c++.hpp>
@@ -48,18 +54,23 @@ extern "C" {
 #include "utils/datetime.hpp"
 #include "utils/defs.hpp"
 #include "utils/env.hpp"
+#include "utils/fs/directory.hpp"
+#include "utils/fs/exceptions.hpp"
 #include "utils/format/containers.ipp"
 #include "utils/format/macros.hpp"
 #include "utils/fs/operations.hpp"
 #include "utils/fs/path.hpp"
 #include "utils/optional.ipp"
 #include "utils/passwd.hpp"
+#include "utils/process/operations.hpp"
 #include "utils/process/status.hpp"
+#include "utils/process/system.hpp"
 #include "utils/sanity.hpp"
 #include "utils/signals/exceptions.hpp"
 #include "utils/stacktrace.hpp"
 #include "utils/text/exceptions.hpp"
 #include "utils/text/operations.ipp"
+#include "utils/units.hpp"
 
 namespace datetime = utils::datetime;
 namespace executor = utils::process::executor;
@@ -68,6 +79,7 @@ namespace passwd = utils::passwd;
 namespace process = utils::process;
 namespace signals = utils::signals;
 namespace text = utils::text;
+namespace units = utils::units;
 
 using utils::none;
 using utils::optional;
@@ -132,6 +144,34 @@ public:
 };
 
 
+/// Subprocess that checks whether a cookie exists.
+class child_check_cookie {
+    /// Name of the cookie to look for.
+    const std::string _cookie_name;
+
+public:
+    /// Constructor.
+    ///
+    /// \param cookie_name Name of the cookie to look for.
+    child_check_cookie(const std::string& cookie_name) :
+        _cookie_name(cookie_name)
+    {
+    }
+
+    /// Runs the subprocess.
+    ///
+    /// \param unused_control_directory Directory where control files separate
+    ///     from the work directory can be placed.
+    void
+    operator()(const fs::path& UTILS_UNUSED_PARAM(control_directory))
+        UTILS_NORETURN
+    {
+        do_exit(atf::utils::file_exists(_cookie_name) ?
+                EXIT_SUCCESS : EXIT_FAILURE);
+    }
+};
+
+
 static void child_delete_all(const fs::path&) UTILS_NORETURN;
 
 
@@ -349,6 +389,46 @@ do_spawn(executor::executor_handle& handle, Hook hook,
 }
 
 
+/// Output sink that writes each stream to a file in the current directory.
+class file_output_sink : public executor::output_sink {
+    /// Number of streams opened so far.
+    int _opened;
+
+public:
+    /// Files passed to release(), in order.
+    std::vector< fs::path > released;
+
+    /// Constructor.
+    file_output_sink(void) : _opened(0)
+    {
+    }
+
+    /// Opens the destination of an output stream of a new subprocess.
+    ///
+    /// \param [in,out] file Replaced by the file the stream is written to.
+    ///
+    /// \return A descriptor for the subprocess to write to.
+    int
+    open(fs::path& file)
+    {
+        file = fs::current_path() / (F("sink-%s.txt") % ++_opened);
+        const int fd = ::open(file.c_str(), O_WRONLY | O_CREAT | O_TRUNC,
+                              0644);
+        ATF_REQUIRE(fd != -1);
+        return fd;
+    }
+
+    /// Records the release of an output stream.
+    ///
+    /// \param file The file returned by open().
+    void
+    release(const fs::path& file)
+    {
+        released.push_back(file);
+    }
+};
+
+
 /// Checks for a specific exit status in the status of a exit_handle.
 ///
 /// \param exit_status The expected exit status.
@@ -400,6 +480,63 @@ retry:
 }
 
 
+/// Replacement for kill(2) and killpg(2) that does not deliver any signal.
+///
+/// Installing this in place of the system calls used to terminate subprocesses
+/// simulates subprocesses that do not die when killed, such as those stuck in
+/// an uninterruptible sleep.
+///
+/// \param unused_pid The process or process group to signal.
+/// \param unused_signo The signal to deliver.
+///
+/// \return Always 0 to pretend that the signal was delivered.
+static int
+kill_noop(const pid_t UTILS_UNUSED_PARAM(pid),
+          const int UTILS_UNUSED_PARAM(signo))
+{
+    return 0;
+}
+
+
+/// Spawns a subprocess that does not die when its timeout fires.
+///
+/// The subprocess is left running after being abandoned by the executor, so
+/// the caller is responsible for killing it.
+///
+/// \param handle The executor on which to spawn the subprocess.
+/// \param [out] pid The PID of the stuck subprocess.
+///
+/// \return The exit handle of the subprocess as returned by wait_any().
+static executor::exit_handle
+wait_stuck(executor::executor_handle& handle, int& pid)
+{
+    process::detail::syscall_kill = kill_noop;
+    process::detail::syscall_killpg = kill_noop;
+    const executor::exec_handle exec_handle = do_spawn(
+        handle, child_pause, datetime::delta(1, 0));
+    executor::exit_handle exit_handle = handle.wait_any();
+    process::detail::syscall_kill = ::kill;
+    process::detail::syscall_killpg = ::killpg;
+
+    pid = exec_handle.pid();
+    ATF_REQUIRE_EQ(pid, exit_handle.original_pid());
+    return exit_handle;
+}
+
+
+/// Checks if a directory exists and is empty.
+///
+/// \param directory The directory to check.
+///
+/// \return True if the directory has no entries other than "." and "..".
+static bool
+is_empty_directory(const fs::path& directory)
+{
+    return fs::is_directory(directory) &&
+        fs::scan_directory(directory).size() == 2;
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(integration__run_one);
 ATF_TEST_CASE_BODY(integration__run_one)
 {
@@ -416,6 +553,141 @@ ATF_TEST_CASE_BODY(integration__run_one)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(integration__poll_any);
+ATF_TEST_CASE_BODY(integration__poll_any)
+{
+    executor::executor_handle handle = executor::setup();
+
+    const executor::exec_handle sleep_handle = do_spawn(handle,
+                                                        child_sleep(60));
+    const executor::exec_handle exit_handle = do_spawn(handle, child_exit(41));
+
+    optional< executor::exit_handle > result;
+    while (!(result = handle.poll_any()))
+        ::usleep(1000);
+    ATF_REQUIRE_EQ(exit_handle.pid(), result.get().original_pid());
+    require_exit(41, result.get().status());
+    result.get().cleanup();
+
+    ATF_REQUIRE(!handle.poll_any());
+
+    ::kill(sleep_handle.pid(), SIGKILL);
+    executor::exit_handle sleep_result = handle.wait_any();
+    ATF_REQUIRE_EQ(sleep_handle.pid(), sleep_result.original_pid());
+    sleep_result.cleanup();
+
+    handle.cleanup();
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(integration__terminate);
+ATF_TEST_CASE_BODY(integration__terminate)
+{
+    executor::executor_handle handle = executor::setup();
+
+    const executor::exec_handle exec_handle = do_spawn(handle,
+                                                       child_sleep(60));
+    handle.terminate(exec_handle.pid());
+
+    executor::exit_handle exit_handle = handle.wait_any();
+    ATF_REQUIRE_EQ(exec_handle.pid(), exit_handle.original_pid());
+    ATF_REQUIRE(exit_handle.status());
+    ATF_REQUIRE(exit_handle.status().get().signaled());
+    ATF_REQUIRE_EQ(SIGKILL, exit_handle.status().get().termsig());
+
+    // Terminating an already-waited subprocess is a no-op.
+    handle.terminate(exec_handle.pid());
+    exit_handle.cleanup();
+
+    handle.cleanup();
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(integration__abandon_stuck);
+ATF_TEST_CASE_BODY(integration__abandon_stuck)
+{
+    executor::abandon_delay = datetime::delta(0, 100000);
+    executor::executor_handle handle = executor::setup();
+
+    int pid;
+    executor::exit_handle exit_handle = wait_stuck(handle, pid);
+    ATF_REQUIRE(!exit_handle.status());
+    const datetime::delta duration =
+        exit_handle.end_time() - exit_handle.start_time();
+    ATF_REQUIRE(duration < datetime::delta(10, 0));
+    ATF_REQUIRE(duration >= datetime::delta(1, 100000));
+    ATF_REQUIRE(::kill(pid, 0) != -1);
+    exit_handle.cleanup();
+
+    ATF_REQUIRE(::kill(pid, SIGKILL) != -1);
+    handle.cleanup();
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(integration__abandon_stuck__reaped);
+ATF_TEST_CASE_BODY(integration__abandon_stuck__reaped)
+{
+    executor::abandon_delay = datetime::delta(0, 100000);
+    executor::executor_handle handle = executor::setup();
+
+    int pid;
+    wait_stuck(handle, pid).cleanup();
+
+    ATF_REQUIRE(::kill(pid, SIGKILL) != -1);
+    ATF_REQUIRE_EQ(pid, process::peek(pid));
+
+    // The stuck subprocess dies long before this one does, so the wait has to
+    // reap the former on its way to returning the latter.
+    const executor::exec_handle exec_handle = do_spawn(handle,
+                                                       child_sleep(1));
+    executor::exit_handle exit_handle = handle.wait_any();
+    ATF_REQUIRE_EQ(exec_handle.pid(), exit_handle.original_pid());
+    require_exit(EXIT_SUCCESS, exit_handle.status());
+    exit_handle.cleanup();
+    ensure_dead(pid);
+
+    handle.cleanup();
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(integration__abandon_stuck__control_directory);
+ATF_TEST_CASE_BODY(integration__abandon_stuck__control_directory)
+{
+    executor::abandon_delay = datetime::delta(0, 100000);
+    executor::executor_handle handle = executor::setup();
+
+    int pid;
+    executor::exit_handle stuck_handle = wait_stuck(handle, pid);
+    const fs::path control_directory = stuck_handle.control_directory();
+    stuck_handle.cleanup();
+    ATF_REQUIRE(fs::exists(control_directory));
+
+    {
+        const executor::exec_handle exec_handle = do_spawn(handle,
+                                                           child_exit(15));
+        ATF_REQUIRE(exec_handle.control_directory() != control_directory);
+        executor::exit_handle exit_handle = handle.wait_any();
+        ATF_REQUIRE_EQ(exec_handle.pid(), exit_handle.original_pid());
+        require_exit(15, exit_handle.status());
+        exit_handle.cleanup();
+    }
+    ATF_REQUIRE(fs::exists(control_directory));
+
+    const executor::exec_handle exec_handle = do_spawn(handle, child_pause);
+    ATF_REQUIRE(exec_handle.control_directory() != control_directory);
+
+    ATF_REQUIRE(::kill(pid, SIGKILL) != -1);
+    ATF_REQUIRE_EQ(pid, process::peek(pid));
+    ATF_REQUIRE(!handle.poll_any());
+    ATF_REQUIRE(!fs::exists(control_directory));
+
+    handle.terminate(exec_handle.pid());
+    handle.wait_any().cleanup();
+
+    handle.cleanup();
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(integration__run_many);
 ATF_TEST_CASE_BODY(integration__run_many)
 {
@@ -463,8 +735,7 @@ ATF_TEST_CASE_BODY(integration__run_many)
                         exit_handle.stdout_file().str()));
         ATF_REQUIRE(!atf::utils::file_exists(
                         exit_handle.stderr_file().str()));
-        ATF_REQUIRE(!atf::utils::file_exists(
-                        exit_handle.work_directory().str()));
+        ATF_REQUIRE(is_empty_directory(exit_handle.work_directory()));
     }
 
     handle.cleanup();
@@ -533,6 +804,60 @@ ATF_TEST_CASE_BODY(integration__custom_output_files)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(integration__output_sink);
+ATF_TEST_CASE_BODY(integration__output_sink)
+{
+    executor::executor_handle handle = executor::setup();
+    std::shared_ptr< file_output_sink > sink(new file_output_sink());
+    handle.set_output_sink(sink);
+
+    (void)handle.spawn(child_create_cookie("cookie.1"), infinite_timeout, none);
+    executor::exit_handle exit_1_handle = handle.wait_any();
+
+    const fs::path stdout_file = fs::current_path() / "sink-1.txt";
+    const fs::path stderr_file = fs::current_path() / "sink-2.txt";
+    ATF_REQUIRE_EQ(stdout_file, exit_1_handle.stdout_file());
+    ATF_REQUIRE_EQ(stderr_file, exit_1_handle.stderr_file());
+    ATF_REQUIRE(!atf::utils::file_exists(
+        (exit_1_handle.control_directory() / "stdout.txt").str()));
+
+    (void)handle.spawn_followup(child_create_cookie("cookie.2"), exit_1_handle,
+                                infinite_timeout);
+    executor::exit_handle exit_2_handle = handle.wait_any();
+    ATF_REQUIRE_EQ(stdout_file, exit_2_handle.stdout_file());
+    ATF_REQUIRE_EQ(stderr_file, exit_2_handle.stderr_file());
+
+    ATF_REQUIRE(atf::utils::compare_file(
+                    stdout_file.str(),
+                    "Creating cookie: cookie.1 (stdout)\n"
+                    "Creating cookie: cookie.2 (stdout)\n"));
+    ATF_REQUIRE(atf::utils::compare_file(
+                    stderr_file.str(),
+                    "Creating cookie: cookie.1 (stderr)\n"
+                    "Creating cookie: cookie.2 (stderr)\n"));
+
+    exit_2_handle.cleanup();
+    ATF_REQUIRE(sink->released.empty());
+    exit_1_handle.cleanup();
+    ATF_REQUIRE_EQ(2, sink->released.size());
+    ATF_REQUIRE_EQ(stdout_file, sink->released[0]);
+    ATF_REQUIRE_EQ(stderr_file, sink->released[1]);
+
+    // Explicit output targets take precedence over the sink.
+    const fs::path custom_file("custom-stdout.txt");
+    (void)do_spawn(handle, child_print, infinite_timeout, none,
+                   utils::make_optional(custom_file));
+    executor::exit_handle exit_3_handle = handle.wait_any();
+    ATF_REQUIRE_EQ(custom_file, exit_3_handle.stdout_file());
+    ATF_REQUIRE(atf::utils::compare_file(
+        exit_3_handle.stderr_file().str(), "stderr: some other text\n"));
+    exit_3_handle.cleanup();
+    ATF_REQUIRE_EQ(2, sink->released.size());
+
+    handle.cleanup();
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(integration__timestamps);
 ATF_TEST_CASE_BODY(integration__timestamps)
 {
@@ -575,9 +900,12 @@ ATF_TEST_CASE_BODY(integration__files)
 
     ATF_REQUIRE(!atf::utils::file_exists(exit_handle.stdout_file().str()));
     ATF_REQUIRE(!atf::utils::file_exists(exit_handle.stderr_file().str()));
-    ATF_REQUIRE(!atf::utils::file_exists(exit_handle.work_directory().str()));
+    ATF_REQUIRE(!atf::utils::file_exists(
+                    (exit_handle.work_directory() / "cookie.12345").str()));
 
     handle.cleanup();
+
+    ATF_REQUIRE(!atf::utils::file_exists(exit_handle.work_directory().str()));
 }
 
 
@@ -636,9 +964,231 @@ ATF_TEST_CASE_BODY(integration__followup)
 
     ATF_REQUIRE(!atf::utils::file_exists(exit_1_handle.stdout_file().str()));
     ATF_REQUIRE(!atf::utils::file_exists(exit_1_handle.stderr_file().str()));
+    ATF_REQUIRE(!atf::utils::file_exists(
+                    (exit_1_handle.work_directory() / "cookie.1").str()));
+
+    handle.cleanup();
+
     ATF_REQUIRE(!atf::utils::file_exists(exit_1_handle.work_directory().str()));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(integration__reuse_work_directory);
+ATF_TEST_CASE_BODY(integration__reuse_work_directory)
+{
+    executor::executor_handle handle = executor::setup();
+
+    (void)handle.spawn(child_create_cookie("cookie.1"), infinite_timeout, none);
+    executor::exit_handle exit_1_handle = handle.wait_any();
+    ATF_REQUIRE(atf::utils::file_exists(
+                    (exit_1_handle.work_directory() / "cookie.1").str()));
+    exit_1_handle.cleanup();
+
+    (void)handle.spawn(child_create_cookie("cookie.2"), infinite_timeout, none);
+    executor::exit_handle exit_2_handle = handle.wait_any();
+    ATF_REQUIRE_EQ(exit_1_handle.control_directory(),
+                   exit_2_handle.control_directory());
+    ATF_REQUIRE(!atf::utils::file_exists(
+                    (exit_2_handle.work_directory() / "cookie.1").str()));
+    ATF_REQUIRE(atf::utils::file_exists(
+                    (exit_2_handle.work_directory() / "cookie.2").str()));
+    ATF_REQUIRE(atf::utils::compare_file(
+                    exit_2_handle.stdout_file().str(),
+                    "Creating cookie: cookie.2 (stdout)\n"));
+    exit_2_handle.cleanup();
+
+    handle.cleanup();
+
+    ATF_REQUIRE(!atf::utils::file_exists(
+                    exit_2_handle.control_directory().str()));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(integration__reserve_directories);
+ATF_TEST_CASE_BODY(integration__reserve_directories)
+{
+    executor::executor_handle handle = executor::setup();
+
+    handle.reserve_directories(2);
+    const fs::path control_1 = handle.root_work_directory() / "1";
+    const fs::path control_2 = handle.root_work_directory() / "2";
+    ATF_REQUIRE(atf::utils::file_exists(control_1.str()));
+    ATF_REQUIRE(atf::utils::file_exists(control_2.str()));
+
+    (void)handle.spawn(child_create_cookie("cookie.1"), infinite_timeout, none);
+    executor::exit_handle exit_1_handle = handle.wait_any();
+    ATF_REQUIRE(exit_1_handle.control_directory() == control_1 ||
+                exit_1_handle.control_directory() == control_2);
+    ATF_REQUIRE(atf::utils::file_exists(
+                    (exit_1_handle.work_directory() / "cookie.1").str()));
+    exit_1_handle.cleanup();
+
+    // There are enough spare directories already: reserving again must not
+    // create any other.
+    handle.reserve_directories(2);
+    ATF_REQUIRE(!atf::utils::file_exists(
+                    (handle.root_work_directory() / "3").str()));
+
+    handle.cleanup();
+
+    ATF_REQUIRE(!atf::utils::file_exists(control_1.str()));
+    ATF_REQUIRE(!atf::utils::file_exists(control_2.str()));
+}
+
+
+/// Checks if a work directory is the mount point of its own file system.
+///
+/// \param exit_handle The handle of the subprocess owning the directory.
+///
+/// \return True if the work directory lives in a different device than its
+/// control directory.
+static bool
+has_own_mount(const executor::exit_handle& exit_handle)
+{
+    struct ::stat control_sb, work_sb;
+    ATF_REQUIRE(::stat(exit_handle.control_directory().c_str(),
+                       &control_sb) != -1);
+    ATF_REQUIRE(::stat(exit_handle.work_directory().c_str(), &work_sb) != -1);
+    return control_sb.st_dev != work_sb.st_dev;
+}
+
+
+ATF_TEST_CASE(integration__work_tmpfs);
+ATF_TEST_CASE_HEAD(integration__work_tmpfs)
+{
+    set_md_var("require.user", "root");
+}
+ATF_TEST_CASE_BODY(integration__work_tmpfs)
+{
+    executor::executor_handle handle = executor::setup();
+    try {
+        handle.mount_work_tmpfs(units::bytes(1024 * 1024));
+    } catch (const fs::error& e) {
+        handle.cleanup();
+        skip(F("Cannot mount tmpfs: %s") % e.what());
+    }
+
+    (void)handle.spawn(child_create_cookie("cookie.1"), infinite_timeout, none);
+    executor::exit_handle exit_1_handle = handle.wait_any();
+    ATF_REQUIRE(has_own_mount(exit_1_handle));
+    ATF_REQUIRE(atf::utils::file_exists(
+                    (exit_1_handle.work_directory() / "cookie.1").str()));
+    exit_1_handle.cleanup();
+
+    (void)handle.spawn(child_create_cookie("cookie.2"), infinite_timeout, none);
+    executor::exit_handle exit_2_handle = handle.wait_any();
+    ATF_REQUIRE_EQ(exit_1_handle.control_directory(),
+                   exit_2_handle.control_directory());
+    ATF_REQUIRE(has_own_mount(exit_2_handle));
+    ATF_REQUIRE(!atf::utils::file_exists(
+                    (exit_2_handle.work_directory() / "cookie.1").str()));
+    ATF_REQUIRE(atf::utils::file_exists(
+                    (exit_2_handle.work_directory() / "cookie.2").str()));
+    exit_2_handle.cleanup();
 
     handle.cleanup();
+
+    ATF_REQUIRE(!atf::utils::file_exists(
+                    exit_2_handle.control_directory().str()));
+}
+
+
+/// Counts the descriptors of mount namespaces open by this process.
+///
+/// \return The number of descriptors.
+static std::size_t
+count_mount_namespaces(void)
+{
+    std::size_t count = 0;
+    DIR* dir = ::opendir("/proc/self/fd");
+    ATF_REQUIRE(dir != NULL);
+    const struct dirent* entry;
+    while ((entry = ::readdir(dir)) != NULL) {
+        const std::string path = F("/proc/self/fd/%s") % entry->d_name;
+        char target[PATH_MAX];
+        const ssize_t length = ::readlink(path.c_str(), target,
+                                          sizeof(target));
+        if (length != -1 &&
+            std::string(target, length).find("mnt:") == 0)
+            ++count;
+    }
+    ::closedir(dir);
+    return count;
+}
+
+
+ATF_TEST_CASE(integration__work_mounts__followup);
+ATF_TEST_CASE_HEAD(integration__work_mounts__followup)
+{
+    set_md_var("require.user", "root");
+}
+ATF_TEST_CASE_BODY(integration__work_mounts__followup)
+{
+    executor::executor_handle handle = executor::setup();
+    try {
+        handle.isolate_work_mounts(units::bytes(1024 * 1024));
+    } catch (const fs::error& e) {
+        handle.cleanup();
+        skip(F("Cannot isolate mounts: %s") % e.what());
+    }
+
+    const std::size_t namespaces_before = count_mount_namespaces();
+
+    (void)handle.spawn(child_create_cookie("cookie"), infinite_timeout, none);
+    executor::exit_handle exit_1_handle = handle.wait_any();
+    if (!exit_1_handle.isolated_mounts()) {
+        exit_1_handle.cleanup();
+        handle.cleanup();
+        skip("Cannot create mount namespaces");
+    }
+    require_exit(EXIT_SUCCESS, exit_1_handle.status());
+    ATF_REQUIRE_EQ(namespaces_before + 1, count_mount_namespaces());
+
+    // We only see the mount point, but the followup sees the cookie.
+    ATF_REQUIRE(!atf::utils::file_exists(
+                    (exit_1_handle.work_directory() / "cookie").str()));
+    (void)handle.spawn_followup(child_check_cookie("cookie"), exit_1_handle,
+                                infinite_timeout);
+    executor::exit_handle exit_2_handle = handle.wait_any();
+    require_exit(EXIT_SUCCESS, exit_2_handle.status());
+    ATF_REQUIRE(exit_2_handle.isolated_mounts());
+
+    // The namespace goes away once the last of the handles is cleaned up.
+    exit_1_handle.cleanup();
+    ATF_REQUIRE_EQ(namespaces_before + 1, count_mount_namespaces());
+    exit_2_handle.cleanup();
+    ATF_REQUIRE(!exit_2_handle.isolated_mounts());
+    ATF_REQUIRE_EQ(namespaces_before, count_mount_namespaces());
+
+    handle.cleanup();
+}
+
+
+ATF_TEST_CASE(integration__work_tmpfs__nested);
+ATF_TEST_CASE_HEAD(integration__work_tmpfs__nested)
+{
+    set_md_var("require.user", "root");
+}
+ATF_TEST_CASE_BODY(integration__work_tmpfs__nested)
+{
+    executor::executor_handle handle = executor::setup();
+    const fs::path root = handle.root_work_directory();
+    try {
+        handle.mount_root_tmpfs();
+        handle.mount_work_tmpfs(units::bytes(1024 * 1024));
+    } catch (const fs::error& e) {
+        handle.cleanup();
+        skip(F("Cannot mount tmpfs: %s") % e.what());
+    }
+
+    (void)handle.spawn(child_create_cookie("cookie.1"), infinite_timeout, none);
+    executor::exit_handle exit_handle = handle.wait_any();
+    ATF_REQUIRE(has_own_mount(exit_handle));
+    exit_handle.cleanup();
+
+    handle.cleanup();
+
+    ATF_REQUIRE(!atf::utils::file_exists(root.str()));
 }
 
 
@@ -777,6 +1327,53 @@ ATF_TEST_CASE_BODY(integration__auto_cleanup)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(integration__auto_cleanup__many);
+ATF_TEST_CASE_BODY(integration__auto_cleanup__many)
+{
+    std::vector< int > pids;
+    fs::path root_work_directory("unset");
+    {
+        executor::executor_handle handle = executor::setup();
+        root_work_directory = handle.root_work_directory();
+
+        // Enough leaked subprocesses for their work directories to be removed
+        // in parallel by the implicit teardown.
+        for (int i = 0; i < 40; ++i)
+            pids.push_back(do_spawn(handle, child_pause).pid());
+    }
+    for (std::vector< int >::const_iterator iter = pids.begin();
+         iter != pids.end(); ++iter) {
+        ensure_dead(*iter);
+    }
+    ATF_REQUIRE(!fs::exists(root_work_directory));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(integration__cleanup__many);
+ATF_TEST_CASE_BODY(integration__cleanup__many)
+{
+    executor::executor_handle handle = executor::setup();
+
+    std::vector< int > pids;
+    for (int i = 0; i < 128; ++i)
+        pids.push_back(do_spawn(handle, child_pause).pid());
+
+    // All subprocesses are killed and reaped together, so tearing them down
+    // must take roughly as long as tearing down a single one.
+    const datetime::monotonic_time start = datetime::monotonic_time::now();
+    handle.cleanup();
+    ATF_REQUIRE(datetime::monotonic_time::now() - start <
+                datetime::delta(5, 0));
+
+    // ensure_dead() also fails for zombies, so this checks that the
+    // subprocesses were reaped.
+    for (std::vector< int >::const_iterator iter = pids.begin();
+         iter != pids.end(); ++iter) {
+        ensure_dead(*iter);
+    }
+}
+
+
 /// Ensures that interrupting an executor cleans things up correctly.
 ///
 /// This test scenario is tricky.  We spawn a master child process that runs the
@@ -945,19 +1542,32 @@ ATF_TEST_CASE_BODY(integration__prevent_clobbering_control_files)
 ATF_INIT_TEST_CASES(tcs)
 {
     ATF_ADD_TEST_CASE(tcs, integration__run_one);
+    ATF_ADD_TEST_CASE(tcs, integration__poll_any);
+    ATF_ADD_TEST_CASE(tcs, integration__terminate);
+    ATF_ADD_TEST_CASE(tcs, integration__abandon_stuck);
+    ATF_ADD_TEST_CASE(tcs, integration__abandon_stuck__reaped);
+    ATF_ADD_TEST_CASE(tcs, integration__abandon_stuck__control_directory);
     ATF_ADD_TEST_CASE(tcs, integration__run_many);
 
     ATF_ADD_TEST_CASE(tcs, integration__parameters_and_output);
     ATF_ADD_TEST_CASE(tcs, integration__custom_output_files);
+    ATF_ADD_TEST_CASE(tcs, integration__output_sink);
     ATF_ADD_TEST_CASE(tcs, integration__timestamps);
     ATF_ADD_TEST_CASE(tcs, integration__files);
 
     ATF_ADD_TEST_CASE(tcs, integration__followup);
+    ATF_ADD_TEST_CASE(tcs, integration__reuse_work_directory);
+    ATF_ADD_TEST_CASE(tcs, integration__reserve_directories);
+    ATF_ADD_TEST_CASE(tcs, integration__work_tmpfs);
+    ATF_ADD_TEST_CASE(tcs, integration__work_tmpfs__nested);
+    ATF_ADD_TEST_CASE(tcs, integration__work_mounts__followup);
 
     ATF_ADD_TEST_CASE(tcs, integration__output_files_always_exist);
     ATF_ADD_TEST_CASE(tcs, integration__timeouts);
     ATF_ADD_TEST_CASE(tcs, integration__unprivileged_user);
     ATF_ADD_TEST_CASE(tcs, integration__auto_cleanup);
+    ATF_ADD_TEST_CASE(tcs, integration__auto_cleanup__many);
+    ATF_ADD_TEST_CASE(tcs, integration__cleanup__many);
     ATF_ADD_TEST_CASE(tcs, integration__signal_handling);
     ATF_ADD_TEST_CASE(tcs, integration__isolate_child_is_called);
     ATF_ADD_TEST_CASE(tcs, integration__process_group_is_terminated);
@@ -44,7 +44,8 @@ struct ifdstream::impl : utils::noncopyable {
     /// Initializes private implementation data.
     ///
     /// \param fd The file descriptor.
-    impl(const int fd) : _systembuf(fd) {}
+    /// \param bufsize The size of the read buffer.
+    impl(const int fd, const std::size_t bufsize) : _systembuf(fd, bufsize) {}
 };
 
 
@@ -60,9 +61,12 @@ namespace process = utils::process;
 /// This grabs ownership of the file descriptor.
 ///
 /// \param fd The file descriptor to read from.  Must be open and valid.
-process::ifdstream::ifdstream(const int fd) :
+/// \param bufsize The size of the read buffer.  Subprocesses can produce
+///     large amounts of output, so the default is large enough to keep the
+///     number of read(2) calls low.
+process::ifdstream::ifdstream(const int fd, const std::size_t bufsize) :
     std::istream(NULL),
-    _pimpl(new impl(fd))
+    _pimpl(new impl(fd, bufsize))
 {
     rdbuf(&_pimpl->_systembuf);
 }
@@ -34,6 +34,7 @@
 
 #include "utils/process/fdstream_fwd.hpp"
 
+#include <cstddef>
 #include <istream>
 #include <memory>
 
@@ -55,7 +56,7 @@ class ifdstream : public std::istream, noncopyable
     std::auto_ptr< impl > _pimpl;
 
 public:
-    explicit ifdstream(const int);
+    explicit ifdstream(const int, const std::size_t = 65536);
     ~ifdstream(void);
 };
 
@@ -67,7 +67,31 @@ ATF_TEST_CASE_BODY(ifdstream)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(ifdstream__small_buffer);
+ATF_TEST_CASE_BODY(ifdstream__small_buffer)
+{
+    int fds[2];
+    ATF_REQUIRE(::pipe(fds) != -1);
+
+    ifdstream rend(fds[0], 3);
+
+    systembuf wbuf(fds[1], 5);
+    std::ostream wend(&wbuf);
+
+    // XXX This assumes that the pipe's buffer is big enough to accept
+    // the data written without blocking!
+    wend << "A line longer than the buffers\nAnd another\n";
+    wend.flush();
+    std::string tmp;
+    std::getline(rend, tmp);
+    ATF_REQUIRE_EQ("A line longer than the buffers", tmp);
+    std::getline(rend, tmp);
+    ATF_REQUIRE_EQ("And another", tmp);
+}
+
+
 ATF_INIT_TEST_CASES(tcs)
 {
     ATF_ADD_TEST_CASE(tcs, ifdstream);
+    ATF_ADD_TEST_CASE(tcs, ifdstream__small_buffer);
 }
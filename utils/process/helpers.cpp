@@ -26,10 +26,23 @@
 // (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 // OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
+extern "C" {
+#include <unistd.h>
+}
+
+#include <cstddef>
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
 #include <sstream>
+#include <string>
+
+
+static int
+check_session(void)
+{
+    return ::getsid(0) == ::getpid() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
 
 
 static int
@@ -42,6 +55,29 @@ print_args(int argc, char* argv[])
 }
 
 
+static int
+print_and_sleep(int argc, char* argv[])
+{
+    if (argc != 4)
+        std::abort();
+
+    std::istringstream bytes_iss(argv[2]);
+    std::size_t bytes;
+    bytes_iss >> bytes;
+    std::istringstream usecs_iss(argv[3]);
+    unsigned long usecs;
+    usecs_iss >> usecs;
+
+    const std::string line(63, 'x');
+    for (std::size_t i = 0; i < bytes / 64; ++i)
+        std::cout << line << '\n';
+    std::cout << std::string(bytes % 64, 'x');
+    std::cout.flush();
+    ::usleep(usecs);
+    return EXIT_SUCCESS;
+}
+
+
 static int
 return_code(int argc, char* argv[])
 {
@@ -63,7 +99,11 @@ main(int argc, char* argv[])
         std::exit(EXIT_FAILURE);
     }
 
-    if (std::strcmp(argv[1], "print-args") == 0) {
+    if (std::strcmp(argv[1], "check-session") == 0) {
+        return check_session();
+    } else if (std::strcmp(argv[1], "print-and-sleep") == 0) {
+        return print_and_sleep(argc, argv);
+    } else if (std::strcmp(argv[1], "print-args") == 0) {
         return print_args(argc, argv);
     } else if (std::strcmp(argv[1], "return-code") == 0) {
         return return_code(argc, argv);
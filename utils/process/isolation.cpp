@@ -28,34 +28,60 @@
 
 #include "utils/process/isolation.hpp"
 
+#if defined(HAVE_CONFIG_H)
+#   include "config.h"
+#endif
+
 extern "C" {
+#include <sys/types.h>
+#if defined(HAVE_CPUSET_SETAFFINITY)
+#   include <sys/param.h>
+#   include <sys/cpuset.h>
+#endif
+#if defined(__linux__)
+#   include <sys/mount.h>
+#endif
+#include <sys/resource.h>
 #include <sys/stat.h>
+#if defined(__linux__)
+#   include <sys/syscall.h>
+#endif
 
 #include <grp.h>
+#if defined(HAVE_SCHED_SETAFFINITY) || defined(__linux__)
+#   include <sched.h>
+#endif
 #include <signal.h>
 #include <unistd.h>
+
+extern char** environ;
 }
 
 #include <cerrno>
+#include <cstddef>
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
+#include <string>
 
+#include "utils/datetime.hpp"
 #include "utils/defs.hpp"
 #include "utils/format/macros.hpp"
 #include "utils/fs/path.hpp"
-#include "utils/env.hpp"
 #include "utils/logging/macros.hpp"
 #include "utils/optional.ipp"
 #include "utils/passwd.hpp"
 #include "utils/sanity.hpp"
 #include "utils/signals/misc.hpp"
 #include "utils/stacktrace.hpp"
+#include "utils/units.hpp"
 
+namespace datetime = utils::datetime;
 namespace fs = utils::fs;
 namespace passwd = utils::passwd;
 namespace process = utils::process;
 namespace signals = utils::signals;
+namespace units = utils::units;
 
 using utils::optional;
 
@@ -67,6 +93,10 @@ const int process::exit_isolation_failure = 124;
 namespace {
 
 
+/// Niceness that lower_priority() adds to the current one.
+static const int low_priority_niceness = 10;
+
+
 static void fail(const std::string&, const int) UTILS_NORETURN;
 
 
@@ -83,43 +113,128 @@ fail(const std::string& message, const int original_errno)
 }
 
 
-/// Changes the owner of a path.
+/// Changes the owner of a path unless it already has the desired owner.
 ///
 /// This function is intended to be called from a subprocess getting ready to
 /// invoke an external binary.  Therefore, if there is any error during the
 /// setup, the new process is terminated with an error code.
 ///
+/// Directories may have been created with the right owner already, for
+/// example in a work root prepared for the unprivileged user.  Checking first
+/// avoids the metadata update that chown(2) performs even when the owner does
+/// not change, which is a synchronous write on most file systems.
+///
 /// \param file The path to the file or directory to affect.
 /// \param uid The UID to set on the path.
 /// \param gid The GID to set on the path.
 static void
 do_chown(const fs::path& file, const uid_t uid, const gid_t gid)
 {
+    struct ::stat sb;
+    if (::lstat(file.c_str(), &sb) != -1 && sb.st_uid == uid &&
+        sb.st_gid == gid)
+        return;
+
     if (::chown(file.c_str(), uid, gid) == -1)
         fail(F("chown(%s, %s, %s) failed; UID is %s and GID is %s")
              % file % uid % gid % ::getuid() % ::getgid(), errno);
 }
 
 
+/// Checks if an environment entry defines any of the given variables.
+///
+/// \param entry The entry to check, in the NAME=value form.
+/// \param names NULL-terminated list of variable names.
+///
+/// \return True if the name of the entry is in the list; false otherwise.
+static bool
+defines_any(const char* entry, const char* const* names)
+{
+    for (const char* const* iter = names; *iter != NULL; ++iter) {
+        const std::size_t length = std::strlen(*iter);
+        if (std::strncmp(entry, *iter, length) == 0 && entry[length] == '=')
+            return true;
+    }
+    return false;
+}
+
+
+/// Duplicates a NAME=value string to be placed in the environment.
+///
+/// \param name The name of the variable.
+/// \param value The value of the variable.
+///
+/// \return A new string that is never released, as it becomes part of the
+/// environment of the process.
+static char*
+make_entry(const char* name, const std::string& value)
+{
+    const std::string entry = F("%s=%s") % name % value;
+    char* copy = new char[entry.length() + 1];
+    std::strcpy(copy, entry.c_str());
+    return copy;
+}
+
+
 /// Resets the environment of the process to a known state.
 ///
-/// \param work_directory Path to the work directory being used.
+/// The new environment is built in a single pass over the inherited one and
+/// installed at once, instead of unsetting and setting each variable in turn,
+/// which would rescan and reallocate the environment on every call.  The
+/// variables inherited from the parent are shared, not copied.  Later calls to
+/// utils::setenv() keep working on the new environment.
 ///
-/// \throw std::runtime_error If there is a problem setting up the environment.
+/// \param work_directory Path to the work directory being used.
 static void
 prepare_environment(const fs::path& work_directory)
 {
-    const char* to_unset[] = { "LANG", "LC_ALL", "LC_COLLATE", "LC_CTYPE",
-                               "LC_MESSAGES", "LC_MONETARY", "LC_NUMERIC",
-                               "LC_TIME", NULL };
-    const char** iter;
-    for (iter = to_unset; *iter != NULL; ++iter) {
-        utils::unsetenv(*iter);
+    static const char* const to_replace[] = {
+        "HOME", "LANG", "LC_ALL", "LC_COLLATE", "LC_CTYPE", "LC_MESSAGES",
+        "LC_MONETARY", "LC_NUMERIC", "LC_TIME", "TMPDIR", "TZ", NULL };
+
+    std::size_t count = 0;
+    for (char** iter = environ; iter != NULL && *iter != NULL; ++iter)
+        ++count;
+
+    char** new_environ = new char*[count + 4];
+    std::size_t last = 0;
+    for (std::size_t i = 0; i < count; ++i) {
+        if (!defines_any(environ[i], to_replace))
+            new_environ[last++] = environ[i];
     }
+    new_environ[last++] = make_entry("HOME", work_directory.str());
+    new_environ[last++] = make_entry("TMPDIR", work_directory.str());
+    new_environ[last++] = make_entry("TZ", "UTC");
+    new_environ[last] = NULL;
+    environ = new_environ;
+}
+
+
+/// Lowers a resource limit of the current process.
+///
+/// The hard limit is never raised: if it is already below the requested
+/// values, it is kept and the soft limit is clamped to it.
+///
+/// \param resource The resource to limit, as one of the RLIMIT_* constants.
+/// \param name Name of the resource, for error reporting purposes.
+/// \param soft The new soft limit.
+/// \param hard The new hard limit.  Must not be below soft.
+static void
+do_setrlimit(const int resource, const char* name, const ::rlim_t soft,
+             const ::rlim_t hard)
+{
+    PRE(soft <= hard);
+
+    struct ::rlimit rl;
+    if (::getrlimit(resource, &rl) == -1)
+        fail(F("getrlimit(%s) failed") % name, errno);
 
-    utils::setenv("HOME", work_directory.str());
-    utils::setenv("TMPDIR", work_directory.str());
-    utils::setenv("TZ", "UTC");
+    if (rl.rlim_max == RLIM_INFINITY || hard < rl.rlim_max)
+        rl.rlim_max = hard;
+    rl.rlim_cur = soft < rl.rlim_max ? soft : rl.rlim_max;
+    if (::setrlimit(resource, &rl) == -1)
+        fail(F("setrlimit(%s, %s, %s) failed") % name % rl.rlim_cur %
+             rl.rlim_max, errno);
 }
 
 
@@ -205,3 +320,202 @@ process::isolate_path(const optional< passwd::user >& unprivileged_user,
         do_chown(file, user.uid, ::getgid());
     }
 }
+
+
+/// Imposes hard limits on the resources the current process can consume.
+///
+/// The limits are inherited by any process spawned from this one, so this is
+/// intended to be called from a subprocess right before it executes the
+/// binary to be constrained.  If there is any error during the setup, the
+/// process is terminated with an error code.
+///
+/// \param max_memory If not none, the maximum size of the address space of the
+///     process.  Allocations beyond it fail.
+/// \param max_cpu_time If not none, the maximum CPU time the process can
+///     consume.  The process receives SIGXCPU when it reaches the limit and is
+///     killed one second later if it is still running.
+void
+process::limit_resources(const optional< units::bytes >& max_memory,
+                         const optional< datetime::delta >& max_cpu_time)
+{
+    if (max_memory) {
+        const ::rlim_t bytes = static_cast< ::rlim_t >(
+            static_cast< uint64_t >(max_memory.get()));
+#if defined(RLIMIT_AS)
+        do_setrlimit(RLIMIT_AS, "RLIMIT_AS", bytes, bytes);
+#else
+        do_setrlimit(RLIMIT_DATA, "RLIMIT_DATA", bytes, bytes);
+#endif
+    }
+
+    if (max_cpu_time) {
+        const datetime::delta& delta = max_cpu_time.get();
+        const ::rlim_t seconds = static_cast< ::rlim_t >(
+            delta.seconds + (delta.useconds > 0 ? 1 : 0));
+        do_setrlimit(RLIMIT_CPU, "RLIMIT_CPU", seconds, seconds + 1);
+    }
+}
+
+
+/// Restricts the current process to run on a set of CPUs.
+///
+/// The affinity is inherited by any process spawned afterwards.  Pinning is
+/// only an optimization, so failing to apply it is not fatal.
+///
+/// \param cpus The CPUs on which to run.  Must not be empty.
+///
+/// \return True if the affinity was applied; false if the system does not
+/// support setting it or if it rejected the given CPUs.
+bool
+process::set_cpu_affinity(const std::set< int >& cpus)
+{
+    PRE(!cpus.empty());
+
+#if defined(HAVE_SCHED_SETAFFINITY)
+    ::cpu_set_t mask;
+    CPU_ZERO(&mask);
+    for (std::set< int >::const_iterator iter = cpus.begin();
+         iter != cpus.end(); ++iter) {
+        if (*iter < CPU_SETSIZE)
+            CPU_SET(*iter, &mask);
+    }
+    if (::sched_setaffinity(0, sizeof(mask), &mask) == -1) {
+        LW(F("sched_setaffinity failed: %s") % std::strerror(errno));
+        return false;
+    }
+    return true;
+#elif defined(HAVE_CPUSET_SETAFFINITY)
+    ::cpuset_t mask;
+    CPU_ZERO(&mask);
+    for (std::set< int >::const_iterator iter = cpus.begin();
+         iter != cpus.end(); ++iter) {
+        if (*iter < CPU_SETSIZE)
+            CPU_SET(*iter, &mask);
+    }
+    if (::cpuset_setaffinity(CPU_LEVEL_WHICH, CPU_WHICH_PID, -1,
+                             sizeof(mask), &mask) == -1) {
+        LW(F("cpuset_setaffinity failed: %s") % std::strerror(errno));
+        return false;
+    }
+    return true;
+#else
+    LW("Don't know how to set the CPU affinity of a process");
+    return false;
+#endif
+}
+
+
+/// Lowers the CPU and I/O scheduling priorities of the current process.
+///
+/// The priorities are inherited by any process spawned afterwards.  This only
+/// serves to keep a process from competing with more important ones, so
+/// failing to apply it is not fatal.  Raising the priorities instead is not
+/// supported because unprivileged processes cannot do so.
+///
+/// \return True if the priorities were lowered; false if the system rejected
+/// any of them.
+bool
+process::lower_priority(void)
+{
+    bool ok = true;
+
+    // getpriority(2) can legitimately return -1, so errno tells errors apart.
+    errno = 0;
+    const int niceness = ::getpriority(PRIO_PROCESS, 0);
+    if (niceness == -1 && errno != 0) {
+        LW(F("getpriority failed: %s") % std::strerror(errno));
+        ok = false;
+    } else if (::setpriority(PRIO_PROCESS, 0,
+                             niceness + low_priority_niceness) == -1) {
+        LW(F("setpriority failed: %s") % std::strerror(errno));
+        ok = false;
+    }
+
+#if defined(SYS_ioprio_set)
+    // There is no libc wrapper for ioprio_set(2), so the constants below come
+    // from linux/ioprio.h: the lowest level of the best-effort class for the
+    // calling process.
+    static const int ioprio_who_process = 1;
+    static const int ioprio_class_be = 2;
+    static const int ioprio_class_shift = 13;
+    static const int ioprio_lowest_level = 7;
+    if (::syscall(SYS_ioprio_set, ioprio_who_process, 0,
+                  (ioprio_class_be << ioprio_class_shift) |
+                  ioprio_lowest_level) == -1) {
+        LW(F("ioprio_set failed: %s") % std::strerror(errno));
+        ok = false;
+    }
+#endif
+
+    return ok;
+}
+
+
+/// Moves the current process into a private mount namespace.
+///
+/// The namespace gets a fresh tmpfs mounted on the work directory, and none of
+/// the mounts made in it propagate back to the original namespace.  The
+/// namespace, and thus the file system with all of its contents, goes away at
+/// once when the last process in it exits and the last descriptor that refers
+/// to it is closed, so nothing has to be removed or unmounted afterwards.
+///
+/// This is intended to be called from a subprocess before it enters its work
+/// directory.  The work directory is only isolated if it is possible, so
+/// failing to do so is not fatal.
+///
+/// \param work_directory Path to the work directory to back with a tmpfs.
+/// \param size Maximum size of the tmpfs; 0 for no limit.
+///
+/// \return True if the process runs in its own namespace with the tmpfs on the
+/// work directory; false otherwise.
+bool
+process::isolate_mounts(const fs::path& work_directory,
+                        const units::bytes& size)
+{
+#if defined(__linux__) && defined(CLONE_NEWNS)
+    if (::unshare(CLONE_NEWNS) == -1) {
+        LW(F("unshare(CLONE_NEWNS) failed: %s") % std::strerror(errno));
+        return false;
+    }
+    if (::mount("none", "/", NULL, MS_REC | MS_PRIVATE, NULL) == -1) {
+        LW(F("Cannot make the mounts private: %s") % std::strerror(errno));
+        return false;
+    }
+
+    std::string options = "mode=0755";
+    if (size > 0)
+        options += F(",size=%s") % static_cast< uint64_t >(size);
+    if (::mount("tmpfs", work_directory.c_str(), "tmpfs", MS_NOSUID | MS_NODEV,
+                options.c_str()) == -1) {
+        LW(F("Cannot mount tmpfs on %s: %s") % work_directory %
+           std::strerror(errno));
+        return false;
+    }
+    return true;
+#else
+    LW(F("Don't know how to isolate the mounts of %s") % work_directory);
+    return false;
+#endif
+}
+
+
+/// Moves the current process into the mount namespace of another one.
+///
+/// \param fd Open descriptor of the namespace, as obtained from the ns/mnt
+///     entry of the process that created it with isolate_mounts().
+///
+/// \return True if the process joined the namespace; false otherwise.
+bool
+process::join_mounts(const int fd)
+{
+#if defined(__linux__) && defined(CLONE_NEWNS)
+    if (::setns(fd, CLONE_NEWNS) == -1) {
+        LW(F("setns(CLONE_NEWNS) failed: %s") % std::strerror(errno));
+        return false;
+    }
+    return true;
+#else
+    LW(F("Don't know how to join the mount namespace %s") % fd);
+    return false;
+#endif
+}
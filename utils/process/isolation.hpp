@@ -35,9 +35,13 @@
 #if !defined(UTILS_PROCESS_ISOLATION_HPP)
 #define UTILS_PROCESS_ISOLATION_HPP
 
+#include <set>
+
+#include "utils/datetime_fwd.hpp"
 #include "utils/fs/path_fwd.hpp"
 #include "utils/optional_fwd.hpp"
 #include "utils/passwd_fwd.hpp"
+#include "utils/units_fwd.hpp"
 
 namespace utils {
 namespace process {
@@ -52,6 +56,15 @@ void isolate_child(const utils::optional< utils::passwd::user >&,
 void isolate_path(const utils::optional< utils::passwd::user >&,
                   const utils::fs::path&);
 
+void limit_resources(const utils::optional< utils::units::bytes >&,
+                     const utils::optional< utils::datetime::delta >&);
+
+bool set_cpu_affinity(const std::set< int >&);
+bool lower_priority(void);
+
+bool isolate_mounts(const utils::fs::path&, const utils::units::bytes&);
+bool join_mounts(const int);
+
 
 }  // namespace process
 }  // namespace utils
@@ -37,27 +37,34 @@ extern "C" {
 }
 
 #include <cerrno>
+#include <csignal>
 #include <cstdlib>
 #include <fstream>
 #include <iostream>
+#include <set>
 
 #include <atf-c++.hpp>
 
+#include "utils/datetime.hpp"
 #include "utils/defs.hpp"
 #include "utils/env.hpp"
 #include "utils/format/macros.hpp"
 #include "utils/fs/operations.hpp"
 #include "utils/fs/path.hpp"
+#include "utils/load.hpp"
 #include "utils/optional.ipp"
 #include "utils/passwd.hpp"
 #include "utils/process/child.ipp"
 #include "utils/process/status.hpp"
 #include "utils/sanity.hpp"
 #include "utils/test_utils.ipp"
+#include "utils/units.hpp"
 
+namespace datetime = utils::datetime;
 namespace fs = utils::fs;
 namespace passwd = utils::passwd;
 namespace process = utils::process;
+namespace units = utils::units;
 
 using utils::none;
 using utils::optional;
@@ -205,6 +212,122 @@ check_enable_core_dumps(void)
 }
 
 
+/// Subprocess that validates that allocations beyond the memory limit fail.
+///
+/// \post Exits with success if a large allocation fails; failure otherwise.
+static void
+check_limit_memory(void)
+{
+    process::limit_resources(utils::make_optional(units::bytes(64 * units::MB)),
+                             none);
+
+    void* buffer = std::malloc(512 * units::MB);
+    if (buffer != NULL) {
+        std::cerr << "Allocation beyond the memory limit succeeded\n";
+        std::exit(EXIT_FAILURE);
+    }
+    std::exit(EXIT_SUCCESS);
+}
+
+
+/// Subprocess that spins until it exhausts its CPU time limit.
+///
+/// \post Never exits on its own; the kernel terminates it.
+static void
+check_limit_cpu_time(void)
+{
+    process::limit_resources(none, utils::make_optional(datetime::delta(1, 0)));
+
+    volatile unsigned long counter = 0;
+    for (;;)
+        ++counter;
+}
+
+
+/// Subprocess that validates that no limits leave the process untouched.
+///
+/// \post Exits with success if the limits did not change; failure otherwise.
+static void
+check_limit_none(void)
+{
+    struct ::rlimit before_as, before_cpu;
+    if (::getrlimit(RLIMIT_AS, &before_as) == -1 ||
+        ::getrlimit(RLIMIT_CPU, &before_cpu) == -1)
+        std::exit(EXIT_FAILURE);
+
+    process::limit_resources(none, none);
+
+    struct ::rlimit after_as, after_cpu;
+    if (::getrlimit(RLIMIT_AS, &after_as) == -1 ||
+        ::getrlimit(RLIMIT_CPU, &after_cpu) == -1)
+        std::exit(EXIT_FAILURE);
+
+    if (before_as.rlim_cur != after_as.rlim_cur ||
+        before_as.rlim_max != after_as.rlim_max ||
+        before_cpu.rlim_cur != after_cpu.rlim_cur ||
+        before_cpu.rlim_max != after_cpu.rlim_max)
+        std::exit(EXIT_FAILURE);
+    std::exit(EXIT_SUCCESS);
+}
+
+
+/// Subprocess that pins itself to a single CPU.
+///
+/// \post Exits with success if the process can only run on the chosen CPU
+/// afterwards, with failure if it can run elsewhere, and with 2 if the
+/// affinity could not be set.
+static void
+check_set_cpu_affinity(void)
+{
+    std::set< int > cpus;
+    cpus.insert(*utils::available_cpus().rbegin());
+
+    if (!process::set_cpu_affinity(cpus))
+        std::exit(2);
+    if (utils::available_cpus() != cpus)
+        std::exit(EXIT_FAILURE);
+    std::exit(EXIT_SUCCESS);
+}
+
+
+/// Subprocess that lowers its own priority.
+///
+/// \post Exits with success if the niceness of the process grows, with failure
+/// otherwise, and with 2 if the priority could not be lowered.
+static void
+check_lower_priority(void)
+{
+    errno = 0;
+    const int old_niceness = ::getpriority(PRIO_PROCESS, 0);
+    if (old_niceness == -1 && errno != 0)
+        std::exit(2);
+
+    if (!process::lower_priority())
+        std::exit(2);
+
+    errno = 0;
+    const int new_niceness = ::getpriority(PRIO_PROCESS, 0);
+    if (new_niceness == -1 && errno != 0)
+        std::exit(2);
+    std::exit(new_niceness > old_niceness ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+
+/// Subprocess that leaves a file behind in an isolated work directory.
+///
+/// \post Exits with success if the file was created in a private tmpfs; with 2
+/// if the mounts cannot be isolated; with failure otherwise.
+static void
+check_isolate_mounts(void)
+{
+    if (!process::isolate_mounts(fs::path("work"), units::bytes(1024 * 1024)))
+        std::exit(2);
+    atf::utils::create_file("work/leftover", "");
+    std::exit(fs::exists(fs::path("work/leftover")) ?
+              EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+
 /// Subprocess that checks if the work directory is entered.
 class check_enter_work_directory {
     /// Directory to enter.  May be releative.
@@ -316,6 +439,27 @@ ATF_TEST_CASE_BODY(isolate_child__clean_environment)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(isolate_child__setenv_after);
+ATF_TEST_CASE_BODY(isolate_child__setenv_after)
+{
+    utils::setenv("LANG", "C");
+    utils::setenv("LEAVE_ME_ALONE", "kill-some-day");
+
+    fs::mkdir(fs::path("some-directory"), 0755);
+    process::isolate_child(none, fs::path("some-directory"));
+
+    utils::setenv("HOME", "other-directory");
+    utils::setenv("NEW_VARIABLE", "some-value");
+    utils::unsetenv("LEAVE_ME_ALONE");
+
+    ATF_REQUIRE(!utils::getenv("LANG"));
+    ATF_REQUIRE(!utils::getenv("LEAVE_ME_ALONE"));
+    ATF_REQUIRE_EQ("other-directory", utils::getenv("HOME").get());
+    ATF_REQUIRE_EQ("some-value", utils::getenv("NEW_VARIABLE").get());
+    ATF_REQUIRE_EQ("some-directory", utils::getenv("TMPDIR").get());
+}
+
+
 ATF_TEST_CASE(isolate_child__other_user_when_unprivileged);
 ATF_TEST_CASE_HEAD(isolate_child__other_user_when_unprivileged)
 {
@@ -486,6 +630,72 @@ ATF_TEST_CASE_BODY(isolate_child__reset_umask)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(limit_resources__memory);
+ATF_TEST_CASE_BODY(limit_resources__memory)
+{
+    const process::status status = fork_and_run(check_limit_memory);
+    ATF_REQUIRE(status.exited());
+    ATF_REQUIRE_EQ(EXIT_SUCCESS, status.exitstatus());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(limit_resources__cpu_time);
+ATF_TEST_CASE_BODY(limit_resources__cpu_time)
+{
+    const process::status status = fork_and_run(check_limit_cpu_time);
+    ATF_REQUIRE(status.signaled());
+    ATF_REQUIRE(status.termsig() == SIGXCPU || status.termsig() == SIGKILL);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(limit_resources__none);
+ATF_TEST_CASE_BODY(limit_resources__none)
+{
+    const process::status status = fork_and_run(check_limit_none);
+    ATF_REQUIRE(status.exited());
+    ATF_REQUIRE_EQ(EXIT_SUCCESS, status.exitstatus());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(set_cpu_affinity);
+ATF_TEST_CASE_BODY(set_cpu_affinity)
+{
+    const process::status status = fork_and_run(check_set_cpu_affinity);
+    ATF_REQUIRE(status.exited());
+    if (status.exitstatus() == 2)
+        skip("Cannot set the CPU affinity on this system");
+    ATF_REQUIRE_EQ(EXIT_SUCCESS, status.exitstatus());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(lower_priority);
+ATF_TEST_CASE_BODY(lower_priority)
+{
+    const process::status status = fork_and_run(check_lower_priority);
+    ATF_REQUIRE(status.exited());
+    if (status.exitstatus() == 2)
+        skip("Cannot lower the priority on this system");
+    ATF_REQUIRE_EQ(EXIT_SUCCESS, status.exitstatus());
+}
+
+
+ATF_TEST_CASE(isolate_mounts);
+ATF_TEST_CASE_HEAD(isolate_mounts)
+{
+    set_md_var("require.user", "root");
+}
+ATF_TEST_CASE_BODY(isolate_mounts)
+{
+    fs::mkdir(fs::path("work"), 0755);
+    const process::status status = fork_and_run(check_isolate_mounts);
+    ATF_REQUIRE(status.exited());
+    if (status.exitstatus() == 2)
+        skip("Cannot isolate the mounts on this system");
+    ATF_REQUIRE_EQ(EXIT_SUCCESS, status.exitstatus());
+    ATF_REQUIRE(!fs::exists(fs::path("work/leftover")));
+}
+
+
 /// Executes isolate_path() and compares the on-disk changes to expected values.
 ///
 /// \param unprivileged_user The user to pass to isolate_path; may be none.
@@ -564,6 +774,35 @@ ATF_TEST_CASE_BODY(isolate_path__drop_privileges)
 }
 
 
+ATF_TEST_CASE(isolate_path__already_owned);
+ATF_TEST_CASE_HEAD(isolate_path__already_owned)
+{
+    set_md_var("require.config", "unprivileged-user");
+    set_md_var("require.user", "root");
+}
+ATF_TEST_CASE_BODY(isolate_path__already_owned)
+{
+    const passwd::user unprivileged_user = passwd::find_user_by_name(
+        get_config_var("unprivileged-user"));
+
+    const fs::path dir("dir");
+    fs::mkdir(dir, 0755);
+    ATF_REQUIRE(::chown(dir.c_str(), unprivileged_user.uid,
+                        unprivileged_user.gid) != -1);
+    struct ::stat old_sb;
+    ATF_REQUIRE(::stat(dir.c_str(), &old_sb) != -1);
+
+    ::sleep(1);
+    process::isolate_path(utils::make_optional(unprivileged_user), dir);
+
+    struct ::stat new_sb;
+    ATF_REQUIRE(::stat(dir.c_str(), &new_sb) != -1);
+    ATF_REQUIRE_EQ(unprivileged_user.uid, new_sb.st_uid);
+    ATF_REQUIRE_EQ(unprivileged_user.gid, new_sb.st_gid);
+    ATF_REQUIRE_EQ(old_sb.st_ctime, new_sb.st_ctime);
+}
+
+
 ATF_TEST_CASE(isolate_path__drop_privileges_only_uid);
 ATF_TEST_CASE_HEAD(isolate_path__drop_privileges_only_uid)
 {
@@ -601,6 +840,7 @@ ATF_TEST_CASE_BODY(isolate_path__drop_privileges_only_gid)
 ATF_INIT_TEST_CASES(tcs)
 {
     ATF_ADD_TEST_CASE(tcs, isolate_child__clean_environment);
+    ATF_ADD_TEST_CASE(tcs, isolate_child__setenv_after);
     ATF_ADD_TEST_CASE(tcs, isolate_child__other_user_when_unprivileged);
     ATF_ADD_TEST_CASE(tcs, isolate_child__drop_privileges);
     ATF_ADD_TEST_CASE(tcs, isolate_child__drop_privileges_fail_uid);
@@ -613,10 +853,19 @@ ATF_INIT_TEST_CASES(tcs)
     ATF_ADD_TEST_CASE(tcs, isolate_child__process_group);
     ATF_ADD_TEST_CASE(tcs, isolate_child__reset_umask);
 
+    ATF_ADD_TEST_CASE(tcs, limit_resources__memory);
+    ATF_ADD_TEST_CASE(tcs, limit_resources__cpu_time);
+    ATF_ADD_TEST_CASE(tcs, limit_resources__none);
+
+    ATF_ADD_TEST_CASE(tcs, set_cpu_affinity);
+    ATF_ADD_TEST_CASE(tcs, lower_priority);
+    ATF_ADD_TEST_CASE(tcs, isolate_mounts);
+
     ATF_ADD_TEST_CASE(tcs, isolate_path__no_user);
     ATF_ADD_TEST_CASE(tcs, isolate_path__same_user);
     ATF_ADD_TEST_CASE(tcs, isolate_path__other_user_when_unprivileged);
     ATF_ADD_TEST_CASE(tcs, isolate_path__drop_privileges);
+    ATF_ADD_TEST_CASE(tcs, isolate_path__already_owned);
     ATF_ADD_TEST_CASE(tcs, isolate_path__drop_privileges_only_uid);
     ATF_ADD_TEST_CASE(tcs, isolate_path__drop_privileges_only_gid);
 }
@@ -28,8 +28,14 @@
 
 #include "utils/process/operations.hpp"
 
+#if defined(HAVE_CONFIG_H)
+#   include "config.h"
+#endif
+
 extern "C" {
 #include <sys/types.h>
+#include <sys/resource.h>
+#include <sys/time.h>
 #include <sys/wait.h>
 
 #include <signal.h>
@@ -41,18 +47,27 @@ extern "C" {
 #include <cstring>
 #include <iostream>
 
+#include "utils/datetime.hpp"
 #include "utils/format/macros.hpp"
 #include "utils/fs/path.hpp"
 #include "utils/logging/macros.hpp"
+#include "utils/optional.ipp"
 #include "utils/process/exceptions.hpp"
+#include "utils/process/resource_usage.hpp"
 #include "utils/process/system.hpp"
 #include "utils/process/status.hpp"
 #include "utils/sanity.hpp"
 #include "utils/signals/interrupts.hpp"
+#include "utils/units.hpp"
 
+namespace datetime = utils::datetime;
 namespace fs = utils::fs;
 namespace process = utils::process;
 namespace signals = utils::signals;
+namespace units = utils::units;
+
+using utils::none;
+using utils::optional;
 
 
 /// Maximum number of arguments supported by exec.
@@ -66,6 +81,71 @@ namespace signals = utils::signals;
 namespace {
 
 
+#if defined(HAVE_WAIT4)
+/// Converts a time value reported by getrusage(2) to a delta.
+///
+/// \param tv The time value to convert.
+///
+/// \return The converted time delta.
+static datetime::delta
+to_delta(const struct ::timeval& tv)
+{
+    return datetime::delta(tv.tv_sec, tv.tv_usec);
+}
+
+
+/// Converts the resource usage reported by wait4(2).
+///
+/// \param ru The resource usage to convert.
+///
+/// \return The converted resource usage.
+static process::resource_usage
+to_resource_usage(const struct ::rusage& ru)
+{
+#   if defined(__APPLE__)
+    // Darwin reports the maximum resident set size in bytes.
+    const units::bytes max_rss(ru.ru_maxrss);
+#   else
+    const units::bytes max_rss(static_cast< uint64_t >(ru.ru_maxrss) * 1024);
+#   endif
+    return process::resource_usage(to_delta(ru.ru_utime), to_delta(ru.ru_stime),
+                                   max_rss, ru.ru_inblock, ru.ru_oublock,
+                                   ru.ru_nvcsw, ru.ru_nivcsw);
+}
+#endif
+
+
+/// Waits for a child process and builds its termination status.
+///
+/// The resources consumed by the process are recorded in the status if the
+/// platform reports them.
+///
+/// \param pid The process to wait for, or -1 to wait for any child.
+/// \param options Flags for waitpid(2).
+/// \param [out] status The termination status, if a process was awaited.
+///
+/// \return The PID of the awaited process, 0 if WNOHANG was specified and no
+/// process has terminated yet, or -1 on error with errno set.
+static pid_t
+wait_and_collect(const pid_t pid, const int options,
+                 optional< process::status >& status)
+{
+    int stat_loc;
+#if defined(HAVE_WAIT4)
+    struct ::rusage ru;
+    const pid_t waited = ::wait4(pid, &stat_loc, options, &ru);
+    if (waited > 0)
+        status = process::status(waited, stat_loc, to_resource_usage(ru));
+#else
+    const pid_t waited = process::detail::syscall_waitpid(pid, &stat_loc,
+                                                          options);
+    if (waited > 0)
+        status = process::status(waited, stat_loc);
+#endif
+    return waited;
+}
+
+
 /// Exception-based, type-improved version of wait(2).
 ///
 /// \return The PID of the terminated process and its termination status.
@@ -75,14 +155,18 @@ static process::status
 safe_wait(void)
 {
     LD("Waiting for any child process");
-    int stat_loc;
-    const pid_t pid = ::wait(&stat_loc);
-    if (pid == -1) {
+    optional< process::status > status;
+    pid_t waited;
+    while ((waited = wait_and_collect(-1, 0, status)) == -1 &&
+           errno == EINTR) {
+        // Retry.
+    }
+    if (waited == -1) {
         const int original_errno = errno;
         throw process::system_error("Failed to wait for any child process",
                                     original_errno);
     }
-    return process::status(pid, stat_loc);
+    return status.get();
 }
 
 
@@ -97,13 +181,52 @@ static process::status
 safe_waitpid(const pid_t pid)
 {
     LD(F("Waiting for pid=%s") % pid);
-    int stat_loc;
-    if (process::detail::syscall_waitpid(pid, &stat_loc, 0) == -1) {
+    optional< process::status > status;
+    pid_t waited;
+    while ((waited = wait_and_collect(pid, 0, status)) == -1 &&
+           errno == EINTR) {
+        // Retry.
+    }
+    if (waited == -1) {
         const int original_errno = errno;
         throw process::system_error(F("Failed to wait for PID %s") % pid,
                                     original_errno);
     }
-    return process::status(pid, stat_loc);
+    return status.get();
+}
+
+
+/// Finds a terminated child process without reaping it.
+///
+/// \param idtype Type of the identifier for waitid(2); P_PID or P_ALL.
+/// \param id Identifier of the process to look for if idtype is P_PID.
+/// \param block Whether to block until a process terminates.
+/// \param interruptible Whether a blocking wait returns early when interrupted
+///     by a signal.  If false, the wait is retried instead.
+///
+/// \return The PID of the terminated process, or 0 if block was false and no
+/// process has terminated yet or if the wait was interrupted.
+///
+/// \throw process::system_error If the call to waitid(2) fails.
+static pid_t
+safe_peek(const ::idtype_t idtype, const ::id_t id, const bool block,
+          const bool interruptible)
+{
+    ::siginfo_t info;
+    int ret;
+    do {
+        std::memset(&info, 0, sizeof(info));
+        ret = ::waitid(idtype, id, &info,
+                       WEXITED | WNOWAIT | (block ? 0 : WNOHANG));
+    } while (ret == -1 && errno == EINTR && !interruptible);
+    if (ret == -1) {
+        if (errno == EINTR)
+            return 0;
+        const int original_errno = errno;
+        throw process::system_error("Failed to find a terminated child "
+                                    "process", original_errno);
+    }
+    return info.si_pid;
 }
 
 
@@ -212,8 +335,27 @@ process::exec_unsafe(const fs::path& program, const args_vector& args)
 void
 process::terminate_group(const int pgid)
 {
-    (void)::killpg(pgid, SIGKILL);
-    (void)::kill(pgid, SIGKILL);
+    (void)process::detail::syscall_killpg(pgid, SIGKILL);
+    (void)process::detail::syscall_kill(pgid, SIGKILL);
+}
+
+
+/// Forcibly kills the process group of a terminated but unreaped leader.
+///
+/// This is a cheaper and safer alternative to terminate_group() for the case
+/// where the process group leader has already terminated but has not yet been
+/// waited for, as reported by peek() or peek_any().  The leader must have set
+/// up its process group before terminating, so killing the leader on its own
+/// is unnecessary.  And, because the zombie leader still holds its PID, the
+/// process group ID cannot have been recycled by an unrelated process.
+///
+/// This function is safe to call from an signal handler context.
+///
+/// \param pgid PID of the terminated leader and ID of its process group.
+void
+process::terminate_group_of_zombie(const int pgid)
+{
+    (void)process::detail::syscall_killpg(pgid, SIGKILL);
 }
 
 
@@ -237,6 +379,72 @@ process::terminate_self_with(const status& status)
 }
 
 
+/// Blocks until a subprocess terminates without waiting for it.
+///
+/// The subprocess is left as a zombie and must later be waited for with
+/// wait().  In the meantime, its PID cannot be recycled.
+///
+/// \param pid Identifier of the process to look for.
+///
+/// \return The PID of the terminated process, which matches pid.
+///
+/// \throw process::system_error If the call to waitid(2) fails.
+int
+process::peek(const int pid)
+{
+    return safe_peek(P_PID, pid, true, false);
+}
+
+
+/// Finds any terminated subprocess without waiting for it.
+///
+/// The subprocess is left as a zombie and must later be waited for with
+/// wait().  In the meantime, its PID cannot be recycled.
+///
+/// \param block Whether to block until a subprocess terminates.  A blocking
+///     wait is cut short by any signal whose handler was programmed without
+///     restarting system calls, such as the expiration of a timer, so that the
+///     caller can react to it.
+///
+/// \return The PID of the terminated subprocess, or none if block was false
+/// and there are child processes but none of them has terminated yet, or if the
+/// wait was interrupted by a signal.
+///
+/// \throw process::system_error If the call to waitid(2) fails.
+optional< int >
+process::peek_any(const bool block)
+{
+    const pid_t pid = safe_peek(P_ALL, 0, block, true);
+    if (pid == 0)
+        return none;
+    return utils::make_optional(static_cast< int >(pid));
+}
+
+
+/// Checks for completion of any subprocess without blocking.
+///
+/// \return The termination status of the child process that terminated, or
+/// none if there are child processes but none of them has terminated yet.
+///
+/// \throw process::system_error If the call to waitpid(2) fails.
+optional< process::status >
+process::poll_any(void)
+{
+    optional< process::status > status;
+    const pid_t pid = wait_and_collect(-1, WNOHANG, status);
+    if (pid == -1) {
+        const int original_errno = errno;
+        throw process::system_error("Failed to poll for any child process",
+                                    original_errno);
+    } else if (pid == 0) {
+        return none;
+    }
+
+    signals::remove_pid_to_kill(pid);
+    return status;
+}
+
+
 /// Blocks to wait for completion of a subprocess.
 ///
 /// \param pid Identifier of the process to wait for.
@@ -248,10 +456,7 @@ process::status
 process::wait(const int pid)
 {
     const process::status status = safe_waitpid(pid);
-    {
-        signals::interrupts_inhibiter inhibiter;
-        signals::remove_pid_to_kill(pid);
-    }
+    signals::remove_pid_to_kill(pid);
     return status;
 }
 
@@ -265,9 +470,6 @@ process::status
 process::wait_any(void)
 {
     const process::status status = safe_wait();
-    {
-        signals::interrupts_inhibiter inhibiter;
-        signals::remove_pid_to_kill(status.dead_pid());
-    }
+    signals::remove_pid_to_kill(status.dead_pid());
     return status;
 }
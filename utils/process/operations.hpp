@@ -36,6 +36,7 @@
 
 #include "utils/defs.hpp"
 #include "utils/fs/path_fwd.hpp"
+#include "utils/optional_fwd.hpp"
 #include "utils/process/status_fwd.hpp"
 
 namespace utils {
@@ -44,7 +45,11 @@ namespace process {
 
 void exec(const utils::fs::path&, const args_vector&) throw() UTILS_NORETURN;
 void exec_unsafe(const utils::fs::path&, const args_vector&) UTILS_NORETURN;
+int peek(const int);
+utils::optional< int > peek_any(const bool);
+utils::optional< status > poll_any(void);
 void terminate_group(const int);
+void terminate_group_of_zombie(const int);
 void terminate_self_with(const status&) UTILS_NORETURN;
 status wait(const int);
 status wait_any(void);
@@ -38,20 +38,30 @@ extern "C" {
 
 #include <cerrno>
 #include <iostream>
+#include <memory>
 
 #include <atf-c++.hpp>
 
+#include "utils/datetime.hpp"
 #include "utils/defs.hpp"
 #include "utils/format/containers.ipp"
 #include "utils/fs/path.hpp"
+#include "utils/optional.ipp"
 #include "utils/process/child.ipp"
 #include "utils/process/exceptions.hpp"
 #include "utils/process/status.hpp"
+#include "utils/signals/timer.hpp"
 #include "utils/stacktrace.hpp"
 #include "utils/test_utils.ipp"
+#include "utils/units.hpp"
 
+namespace datetime = utils::datetime;
 namespace fs = utils::fs;
 namespace process = utils::process;
+namespace signals = utils::signals;
+namespace units = utils::units;
+
+using utils::optional;
 
 
 namespace {
@@ -321,6 +331,48 @@ ATF_TEST_CASE_BODY(terminate_group__setpgrp_not_executed)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(terminate_group_of_zombie);
+ATF_TEST_CASE_BODY(terminate_group_of_zombie)
+{
+    int fds[2];
+    ATF_REQUIRE(::pipe(fds) != -1);
+
+    const pid_t pid = ::fork();
+    ATF_REQUIRE(pid != -1);
+    if (pid == 0) {
+        ::setpgid(::getpid(), ::getpid());
+        const pid_t pid2 = ::fork();
+        if (pid2 == -1) {
+            std::exit(EXIT_FAILURE);
+        } else if (pid2 == 0) {
+            ::close(fds[0]);
+            write_loop(fds[1]);
+        }
+        std::exit(EXIT_SUCCESS);
+    }
+    ::close(fds[1]);
+
+    int dummy;
+    std::cerr << "Waiting for the grandchild to start\n";
+    while (::read(fds[0], &dummy, sizeof(dummy)) <= 0) {
+        // Wait for the grandchild to come up.
+    }
+
+    ATF_REQUIRE_EQ(pid, process::peek(pid));
+    process::terminate_group_of_zombie(pid);
+    std::cerr << "Waiting for the grandchild to die\n";
+    while (::read(fds[0], &dummy, sizeof(dummy)) > 0) {
+        // Wait for the grandchild to terminate.  If it doesn't, then the test
+        // case will time out.
+    }
+
+    int status;
+    ATF_REQUIRE(::waitpid(pid, &status, 0) != -1);
+    ATF_REQUIRE(WIFEXITED(status));
+    ATF_REQUIRE_EQ(EXIT_SUCCESS, WEXITSTATUS(status));
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(terminate_self_with__exitstatus);
 ATF_TEST_CASE_BODY(terminate_self_with__exitstatus)
 {
@@ -392,6 +444,21 @@ ATF_TEST_CASE_BODY(wait__ok)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(wait__usage);
+ATF_TEST_CASE_BODY(wait__usage)
+{
+    std::auto_ptr< process::child > child = process::child::fork_capture(
+        child_exit< 0 >);
+    const pid_t pid = child->pid();
+    child.reset();  // Ensure there is no conflict between destructor and wait.
+
+    const process::status status = process::wait(pid);
+    if (!status.usage())
+        ATF_SKIP("Resource usage not supported in this platform");
+    ATF_REQUIRE(status.usage().get().max_rss() > units::bytes(0));
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(wait__fail);
 ATF_TEST_CASE_BODY(wait__fail)
 {
@@ -399,6 +466,107 @@ ATF_TEST_CASE_BODY(wait__fail)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(peek__leaves_zombie);
+ATF_TEST_CASE_BODY(peek__leaves_zombie)
+{
+    const int pid = process::child::fork_capture(child_exit< 15 >)->pid();
+
+    ATF_REQUIRE_EQ(pid, process::peek(pid));
+    ATF_REQUIRE_EQ(pid, process::peek(pid));
+
+    const process::status status = process::wait(pid);
+    ATF_REQUIRE(status.exited());
+    ATF_REQUIRE_EQ(15, status.exitstatus());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(peek_any__none_ready);
+ATF_TEST_CASE_BODY(peek_any__none_ready)
+{
+    std::auto_ptr< process::child > child = process::child::fork_capture(
+        suspend);
+
+    ATF_REQUIRE(!process::peek_any(false));
+
+    ::kill(child->pid(), SIGKILL);
+    ATF_REQUIRE_EQ(child->pid(), process::peek_any(true).get());
+    const process::status status = process::wait_any();
+    ATF_REQUIRE(status.signaled());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(peek_any__interrupted_by_timer);
+ATF_TEST_CASE_BODY(peek_any__interrupted_by_timer)
+{
+    std::auto_ptr< process::child > child = process::child::fork_capture(
+        suspend);
+
+    signals::timer timer(datetime::delta(0, 100000));
+    ATF_REQUIRE(!process::peek_any(true));
+    ATF_REQUIRE(timer.fired());
+    timer.unprogram();
+
+    ::kill(child->pid(), SIGKILL);
+    ATF_REQUIRE_EQ(child->pid(), process::peek_any(true).get());
+    const process::status status = process::wait_any();
+    ATF_REQUIRE(status.signaled());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(peek_any__none_is_failure);
+ATF_TEST_CASE_BODY(peek_any__none_is_failure)
+{
+    try {
+        (void)process::peek_any(true);
+        fail("Expected exception but none raised");
+    } catch (const process::system_error& e) {
+        ATF_REQUIRE(atf::utils::grep_string("Failed to find", e.what()));
+        ATF_REQUIRE_EQ(ECHILD, e.original_errno());
+    }
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(poll_any__none_ready);
+ATF_TEST_CASE_BODY(poll_any__none_ready)
+{
+    std::auto_ptr< process::child > child = process::child::fork_capture(
+        suspend);
+
+    ATF_REQUIRE(!process::poll_any());
+
+    ::kill(child->pid(), SIGKILL);
+    const process::status status = process::wait_any();
+    ATF_REQUIRE(status.signaled());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(poll_any__one);
+ATF_TEST_CASE_BODY(poll_any__one)
+{
+    const int pid = process::child::fork_capture(child_exit< 15 >)->pid();
+
+    optional< process::status > status;
+    while (!(status = process::poll_any()))
+        ::usleep(1000);
+    ATF_REQUIRE_EQ(pid, status.get().dead_pid());
+    ATF_REQUIRE(status.get().exited());
+    ATF_REQUIRE_EQ(15, status.get().exitstatus());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(poll_any__none_is_failure);
+ATF_TEST_CASE_BODY(poll_any__none_is_failure)
+{
+    try {
+        (void)process::poll_any();
+        fail("Expected exception but none raised");
+    } catch (const process::system_error& e) {
+        ATF_REQUIRE(atf::utils::grep_string("Failed to poll", e.what()));
+        ATF_REQUIRE_EQ(ECHILD, e.original_errno());
+    }
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(wait_any__one);
 ATF_TEST_CASE_BODY(wait_any__one)
 {
@@ -457,14 +625,25 @@ ATF_INIT_TEST_CASES(tcs)
 
     ATF_ADD_TEST_CASE(tcs, terminate_group__setpgrp_executed);
     ATF_ADD_TEST_CASE(tcs, terminate_group__setpgrp_not_executed);
+    ATF_ADD_TEST_CASE(tcs, terminate_group_of_zombie);
 
     ATF_ADD_TEST_CASE(tcs, terminate_self_with__exitstatus);
     ATF_ADD_TEST_CASE(tcs, terminate_self_with__termsig);
     ATF_ADD_TEST_CASE(tcs, terminate_self_with__termsig_and_core);
 
     ATF_ADD_TEST_CASE(tcs, wait__ok);
+    ATF_ADD_TEST_CASE(tcs, wait__usage);
     ATF_ADD_TEST_CASE(tcs, wait__fail);
 
+    ATF_ADD_TEST_CASE(tcs, peek__leaves_zombie);
+    ATF_ADD_TEST_CASE(tcs, peek_any__none_ready);
+    ATF_ADD_TEST_CASE(tcs, peek_any__interrupted_by_timer);
+    ATF_ADD_TEST_CASE(tcs, peek_any__none_is_failure);
+
+    ATF_ADD_TEST_CASE(tcs, poll_any__none_ready);
+    ATF_ADD_TEST_CASE(tcs, poll_any__one);
+    ATF_ADD_TEST_CASE(tcs, poll_any__none_is_failure);
+
     ATF_ADD_TEST_CASE(tcs, wait_any__one);
     ATF_ADD_TEST_CASE(tcs, wait_any__many);
     ATF_ADD_TEST_CASE(tcs, wait_any__none_is_failure);
@@ -0,0 +1,182 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "utils/process/resource_usage.hpp"
+
+#include "utils/format/macros.hpp"
+
+namespace datetime = utils::datetime;
+namespace process = utils::process;
+namespace units = utils::units;
+
+
+/// Constructs a new resource usage record.
+///
+/// \param user_time_ CPU time spent in user mode.
+/// \param system_time_ CPU time spent in kernel mode.
+/// \param max_rss_ Maximum resident set size.
+/// \param in_blocks_ Number of block input operations.
+/// \param out_blocks_ Number of block output operations.
+/// \param voluntary_switches_ Number of voluntary context switches.
+/// \param involuntary_switches_ Number of involuntary context switches.
+process::resource_usage::resource_usage(const datetime::delta& user_time_,
+                                        const datetime::delta& system_time_,
+                                        const units::bytes& max_rss_,
+                                        const uint64_t in_blocks_,
+                                        const uint64_t out_blocks_,
+                                        const uint64_t voluntary_switches_,
+                                        const uint64_t involuntary_switches_) :
+    _user_time(user_time_),
+    _system_time(system_time_),
+    _max_rss(max_rss_),
+    _in_blocks(in_blocks_),
+    _out_blocks(out_blocks_),
+    _voluntary_switches(voluntary_switches_),
+    _involuntary_switches(involuntary_switches_)
+{
+}
+
+
+/// Returns the CPU time spent in user mode.
+///
+/// \return A time delta.
+const datetime::delta&
+process::resource_usage::user_time(void) const
+{
+    return _user_time;
+}
+
+
+/// Returns the CPU time spent in kernel mode.
+///
+/// \return A time delta.
+const datetime::delta&
+process::resource_usage::system_time(void) const
+{
+    return _system_time;
+}
+
+
+/// Returns the maximum resident set size.
+///
+/// \return A number of bytes.
+const units::bytes&
+process::resource_usage::max_rss(void) const
+{
+    return _max_rss;
+}
+
+
+/// Returns the number of block input operations.
+///
+/// \return A counter.
+uint64_t
+process::resource_usage::in_blocks(void) const
+{
+    return _in_blocks;
+}
+
+
+/// Returns the number of block output operations.
+///
+/// \return A counter.
+uint64_t
+process::resource_usage::out_blocks(void) const
+{
+    return _out_blocks;
+}
+
+
+/// Returns the number of voluntary context switches.
+///
+/// \return A counter.
+uint64_t
+process::resource_usage::voluntary_switches(void) const
+{
+    return _voluntary_switches;
+}
+
+
+/// Returns the number of involuntary context switches.
+///
+/// \return A counter.
+uint64_t
+process::resource_usage::involuntary_switches(void) const
+{
+    return _involuntary_switches;
+}
+
+
+/// Equality comparator.
+///
+/// \param other The object to compare to.
+///
+/// \return True if the two objects are equal; false otherwise.
+bool
+process::resource_usage::operator==(const resource_usage& other) const
+{
+    return _user_time == other._user_time &&
+        _system_time == other._system_time &&
+        _max_rss == other._max_rss &&
+        _in_blocks == other._in_blocks &&
+        _out_blocks == other._out_blocks &&
+        _voluntary_switches == other._voluntary_switches &&
+        _involuntary_switches == other._involuntary_switches;
+}
+
+
+/// Inequality comparator.
+///
+/// \param other The object to compare to.
+///
+/// \return True if the two objects are different; false otherwise.
+bool
+process::resource_usage::operator!=(const resource_usage& other) const
+{
+    return !(*this == other);
+}
+
+
+/// Injects the object into a stream.
+///
+/// \param output The stream into which to inject the object.
+/// \param object The object to format.
+///
+/// \return The output stream.
+std::ostream&
+process::operator<<(std::ostream& output, const resource_usage& object)
+{
+    output << F("resource_usage{user_time=%s, system_time=%s, max_rss=%s, "
+                "in_blocks=%s, out_blocks=%s, voluntary_switches=%s, "
+                "involuntary_switches=%s}")
+        % object.user_time() % object.system_time()
+        % static_cast< uint64_t >(object.max_rss())
+        % object.in_blocks() % object.out_blocks()
+        % object.voluntary_switches() % object.involuntary_switches();
+    return output;
+}
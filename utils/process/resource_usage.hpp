@@ -0,0 +1,100 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// \file utils/process/resource_usage.hpp
+/// Provides the utils::process::resource_usage class.
+
+#if !defined(UTILS_PROCESS_RESOURCE_USAGE_HPP)
+#define UTILS_PROCESS_RESOURCE_USAGE_HPP
+
+#include "utils/process/resource_usage_fwd.hpp"
+
+extern "C" {
+#include <stdint.h>
+}
+
+#include <ostream>
+
+#include "utils/datetime.hpp"
+#include "utils/units.hpp"
+
+namespace utils {
+namespace process {
+
+
+/// Resources consumed by a terminated process.
+///
+/// The counters include those of any descendants of the process that it
+/// waited for, as reported by wait4(2).
+class resource_usage {
+    /// CPU time spent in user mode.
+    datetime::delta _user_time;
+
+    /// CPU time spent in kernel mode.
+    datetime::delta _system_time;
+
+    /// Maximum resident set size.
+    units::bytes _max_rss;
+
+    /// Number of block input operations.
+    uint64_t _in_blocks;
+
+    /// Number of block output operations.
+    uint64_t _out_blocks;
+
+    /// Number of voluntary context switches.
+    uint64_t _voluntary_switches;
+
+    /// Number of involuntary context switches.
+    uint64_t _involuntary_switches;
+
+public:
+    resource_usage(const datetime::delta&, const datetime::delta&,
+                   const units::bytes&, const uint64_t, const uint64_t,
+                   const uint64_t, const uint64_t);
+
+    const datetime::delta& user_time(void) const;
+    const datetime::delta& system_time(void) const;
+    const units::bytes& max_rss(void) const;
+    uint64_t in_blocks(void) const;
+    uint64_t out_blocks(void) const;
+    uint64_t voluntary_switches(void) const;
+    uint64_t involuntary_switches(void) const;
+
+    bool operator==(const resource_usage&) const;
+    bool operator!=(const resource_usage&) const;
+};
+
+
+std::ostream& operator<<(std::ostream&, const resource_usage&);
+
+
+}  // namespace process
+}  // namespace utils
+
+#endif  // !defined(UTILS_PROCESS_RESOURCE_USAGE_HPP)
@@ -0,0 +1,99 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "utils/process/resource_usage.hpp"
+
+#include <sstream>
+
+#include <atf-c++.hpp>
+
+#include "utils/datetime.hpp"
+#include "utils/units.hpp"
+
+namespace datetime = utils::datetime;
+namespace process = utils::process;
+namespace units = utils::units;
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(getters);
+ATF_TEST_CASE_BODY(getters)
+{
+    const process::resource_usage usage(
+        datetime::delta(1, 2), datetime::delta(3, 4), units::bytes(5),
+        6, 7, 8, 9);
+    ATF_REQUIRE_EQ(datetime::delta(1, 2), usage.user_time());
+    ATF_REQUIRE_EQ(datetime::delta(3, 4), usage.system_time());
+    ATF_REQUIRE_EQ(units::bytes(5), usage.max_rss());
+    ATF_REQUIRE_EQ(6, usage.in_blocks());
+    ATF_REQUIRE_EQ(7, usage.out_blocks());
+    ATF_REQUIRE_EQ(8, usage.voluntary_switches());
+    ATF_REQUIRE_EQ(9, usage.involuntary_switches());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(operators_eq_and_ne);
+ATF_TEST_CASE_BODY(operators_eq_and_ne)
+{
+    const process::resource_usage usage1(
+        datetime::delta(1, 0), datetime::delta(2, 0), units::bytes(3),
+        4, 5, 6, 7);
+    const process::resource_usage usage2(
+        datetime::delta(1, 0), datetime::delta(2, 0), units::bytes(3),
+        4, 5, 6, 7);
+    const process::resource_usage usage3(
+        datetime::delta(1, 0), datetime::delta(2, 0), units::bytes(3),
+        4, 5, 6, 8);
+
+    ATF_REQUIRE(  usage1 == usage2);
+    ATF_REQUIRE(!(usage1 != usage2));
+    ATF_REQUIRE(!(usage1 == usage3));
+    ATF_REQUIRE(  usage1 != usage3);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(output);
+ATF_TEST_CASE_BODY(output)
+{
+    const process::resource_usage usage(
+        datetime::delta(1, 2), datetime::delta(0, 3), units::bytes(1024),
+        4, 5, 6, 7);
+    std::ostringstream str;
+    str << usage;
+    ATF_REQUIRE_EQ("resource_usage{user_time=1000002us, system_time=3us, "
+                   "max_rss=1024, in_blocks=4, out_blocks=5, "
+                   "voluntary_switches=6, involuntary_switches=7}",
+                   str.str());
+}
+
+
+ATF_INIT_TEST_CASES(tcs)
+{
+    ATF_ADD_TEST_CASE(tcs, getters);
+    ATF_ADD_TEST_CASE(tcs, operators_eq_and_ne);
+    ATF_ADD_TEST_CASE(tcs, output);
+}
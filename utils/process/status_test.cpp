@@ -39,7 +39,14 @@ extern "C" {
 
 #include <atf-c++.hpp>
 
+#include "utils/datetime.hpp"
+#include "utils/process/resource_usage.hpp"
 #include "utils/test_utils.ipp"
+#include "utils/units.hpp"
+
+namespace datetime = utils::datetime;
+namespace process = utils::process;
+namespace units = utils::units;
 
 using utils::process::status;
 
@@ -116,6 +123,21 @@ ATF_TEST_CASE_BODY(fake_signaled)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(usage);
+ATF_TEST_CASE_BODY(usage)
+{
+    const process::resource_usage usage(
+        datetime::delta(1, 0), datetime::delta(2, 0), units::bytes(3),
+        4, 5, 6, 7);
+    const status exited(1234, 0, usage);
+    ATF_REQUIRE(exited.exited());
+    ATF_REQUIRE_EQ(usage, exited.usage().get());
+
+    ATF_REQUIRE(!status::fake_exited(0).usage());
+    ATF_REQUIRE(!status(1234, 0).usage());
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(output__exitstatus);
 ATF_TEST_CASE_BODY(output__exitstatus)
 {
@@ -199,6 +221,7 @@ ATF_INIT_TEST_CASES(tcs)
     ATF_ADD_TEST_CASE(tcs, fake_exited);
     ATF_ADD_TEST_CASE(tcs, fake_signaled);
 
+    ATF_ADD_TEST_CASE(tcs, usage);
     ATF_ADD_TEST_CASE(tcs, output__exitstatus);
     ATF_ADD_TEST_CASE(tcs, output__signaled_without_core);
     ATF_ADD_TEST_CASE(tcs, output__signaled_with_core);
@@ -33,6 +33,7 @@ extern "C" {
 #include <sys/wait.h>
 
 #include <fcntl.h>
+#include <signal.h>
 #include <unistd.h>
 }
 
@@ -47,6 +48,14 @@ int (*detail::syscall_dup2)(const int, const int) = ::dup2;
 pid_t (*detail::syscall_fork)(void) = ::fork;
 
 
+/// Indirection to execute the kill(2) system call.
+int (*detail::syscall_kill)(const pid_t, const int) = ::kill;
+
+
+/// Indirection to execute the killpg(2) system call.
+int (*detail::syscall_killpg)(const pid_t, const int) = ::killpg;
+
+
 /// Indirection to execute the open(2) system call.
 int (*detail::syscall_open)(const char*, const int, ...) = ::open;
 
@@ -54,6 +54,8 @@ namespace detail {
 
 extern int (*syscall_dup2)(const int, const int);
 extern pid_t (*syscall_fork)(void);
+extern int (*syscall_kill)(const pid_t, const int);
+extern int (*syscall_killpg)(const pid_t, const int);
 extern int (*syscall_open)(const char*, const int, ...);
 extern int (*syscall_pipe)(int[2]);
 extern pid_t (*syscall_waitpid)(const pid_t, int*, const int);
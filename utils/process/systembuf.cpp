@@ -32,6 +32,8 @@ extern "C" {
 #include <unistd.h>
 }
 
+#include <cerrno>
+
 #include "utils/auto_array.ipp"
 #include "utils/noncopyable.hpp"
 #include "utils/sanity.hpp"
@@ -51,6 +53,9 @@ struct systembuf::impl : utils::noncopyable {
     utils::auto_array< char > _read_buf;
 
     /// In-memory buffer for write operations.
+    ///
+    /// This is only allocated on the first write so that streams that are
+    /// exclusively used for reading do not pay for an unused buffer.
     utils::auto_array< char > _write_buf;
 
     /// Initializes private implementation data.
@@ -60,8 +65,7 @@ struct systembuf::impl : utils::noncopyable {
     impl(const int fd, const std::size_t bufsize) :
         _fd(fd),
         _bufsize(bufsize),
-        _read_buf(new char[bufsize]),
-        _write_buf(new char[bufsize])
+        _read_buf(new char[bufsize])
     {
     }
 };
@@ -76,7 +80,7 @@ struct systembuf::impl : utils::noncopyable {
 systembuf::systembuf(const int fd, std::size_t bufsize) :
     _pimpl(new impl(fd, bufsize))
 {
-    setp(_pimpl->_write_buf.get(), _pimpl->_write_buf.get() + _pimpl->_bufsize);
+    PRE(bufsize > 0);
 }
 
 
@@ -98,8 +102,11 @@ systembuf::underflow(void)
     PRE(gptr() >= egptr());
 
     bool ok;
-    ssize_t cnt = ::read(_pimpl->_fd, _pimpl->_read_buf.get(),
-                         _pimpl->_bufsize);
+    ssize_t cnt;
+    while ((cnt = ::read(_pimpl->_fd, _pimpl->_read_buf.get(),
+                         _pimpl->_bufsize)) == -1 && errno == EINTR) {
+        // Retry.
+    }
     ok = (cnt != -1 && cnt != 0);
 
     if (!ok)
@@ -125,8 +132,13 @@ systembuf::int_type
 systembuf::overflow(int c)
 {
     PRE(pptr() >= epptr());
-    if (sync() == -1)
+    if (_pimpl->_write_buf.get() == NULL) {
+        _pimpl->_write_buf.reset(new char[_pimpl->_bufsize]);
+        setp(_pimpl->_write_buf.get(),
+             _pimpl->_write_buf.get() + _pimpl->_bufsize);
+    } else if (sync() == -1) {
         return traits_type::eof();
+    }
     if (!traits_type::eq_int_type(c, traits_type::eof())) {
         traits_type::assign(*pptr(), c);
         pbump(1);
@@ -142,9 +154,16 @@ int
 systembuf::sync(void)
 {
     ssize_t cnt = pptr() - pbase();
+    if (cnt == 0)
+        return 0;
 
     bool ok;
-    ok = ::write(_pimpl->_fd, pbase(), cnt) == cnt;
+    ssize_t written;
+    while ((written = ::write(_pimpl->_fd, pbase(), cnt)) == -1 &&
+           errno == EINTR) {
+        // Retry.
+    }
+    ok = written == cnt;
 
     if (ok)
         pbump(-cnt);
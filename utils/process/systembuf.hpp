@@ -60,7 +60,7 @@ protected:
     int sync(void);
 
 public:
-    explicit systembuf(const int, std::size_t = 8192);
+    explicit systembuf(const int, std::size_t = 65536);
     ~systembuf(void);
 };
 
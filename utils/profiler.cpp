@@ -0,0 +1,418 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "utils/profiler.hpp"
+
+#if defined(HAVE_CONFIG_H)
+#  include "config.h"
+#endif
+
+extern "C" {
+#if defined(HAVE_PROFILER)
+#  include <sys/time.h>
+
+#  include <dlfcn.h>
+#  include <execinfo.h>
+#  include <signal.h>
+#endif
+
+#include <stdint.h>
+}
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined(HAVE_PROFILER)
+#  include <cxxabi.h>
+#endif
+
+#include "utils/datetime.hpp"
+#include "utils/defs.hpp"
+#include "utils/fnv.hpp"
+#include "utils/format/macros.hpp"
+#include "utils/logging/macros.hpp"
+#include "utils/sanity.hpp"
+
+namespace datetime = utils::datetime;
+
+
+namespace {
+
+
+/// Maximum number of frames recorded for every sample.
+///
+/// Deeper stacks are truncated and keep their innermost frames.
+static const int max_frames = 64;
+
+
+/// Maximum number of distinct stacks that can be recorded.
+///
+/// Samples of any new stacks past this limit are dropped rather than recorded
+/// because memory cannot be allocated from within the signal handler.
+static const std::size_t max_stacks = 8192;
+
+
+/// Number of frames at the top of every backtrace that belong to the profiler.
+///
+/// These are the signal handler and the trampoline through which the kernel
+/// invokes it.
+static const int skipped_frames = 2;
+
+
+/// A distinct stack and the number of samples it received.
+struct stack_entry {
+    /// Number of samples that hit this stack; zero if the entry is free.
+    std::size_t count;
+
+    /// Number of valid frames in frames.
+    int depth;
+
+    /// Addresses of the frames, from the innermost to the outermost.
+    void* frames[max_frames];
+};
+
+
+/// Hash table of the recorded stacks with open addressing.
+struct sample_table {
+    /// Entries of the table, preallocated to hold max_stacks stacks.
+    std::vector< stack_entry > entries;
+
+    /// Total number of samples taken, including the dropped ones.
+    std::size_t samples;
+
+    /// Number of samples dropped because the table was full.
+    std::size_t dropped_samples;
+
+    /// Constructs an empty table.
+    sample_table(void) :
+        entries(max_stacks), samples(0), dropped_samples(0)
+    {
+        for (std::size_t i = 0; i < entries.size(); ++i)
+            entries[i].count = 0;
+    }
+
+    /// Records a sample.
+    ///
+    /// This runs within the signal handler, so it must not allocate memory nor
+    /// call any function that is not async-signal-safe.
+    ///
+    /// \param frames Addresses of the frames of the sample, from the innermost
+    ///     to the outermost.
+    /// \param depth Number of frames in frames.
+    void
+    record(void* const* frames, const int depth)
+    {
+        ++samples;
+
+        const uint64_t hash = utils::fnv1a64_update(
+            utils::fnv1a64_basis, frames, depth * sizeof(void*));
+
+        for (std::size_t probe = 0; probe < entries.size(); ++probe) {
+            stack_entry& entry = entries[(hash + probe) % entries.size()];
+            if (entry.count == 0) {
+                std::memcpy(entry.frames, frames, depth * sizeof(void*));
+                entry.depth = depth;
+                entry.count = 1;
+                return;
+            } else if (entry.depth == depth &&
+                       std::memcmp(entry.frames, frames,
+                                   depth * sizeof(void*)) == 0) {
+                ++entry.count;
+                return;
+            }
+        }
+        ++dropped_samples;
+    }
+};
+
+
+/// Table of the active profiler, if any, for the signal handler to update.
+static sample_table* volatile active_table = NULL;
+
+
+#if defined(HAVE_PROFILER)
+
+
+/// Signal handler that records a sample of the current stack.
+///
+/// \param unused_signo The number of the received signal.
+static void
+sigprof_handler(const int UTILS_UNUSED_PARAM(signo))
+{
+    const int original_errno = errno;
+    sample_table* table = active_table;
+    if (table != NULL) {
+        void* frames[skipped_frames + max_frames];
+        const int nframes = ::backtrace(frames, skipped_frames + max_frames);
+        if (nframes > skipped_frames)
+            table->record(frames + skipped_frames, nframes - skipped_frames);
+    }
+    errno = original_errno;
+}
+
+
+/// Computes the name of a code address.
+///
+/// \param address The address to symbolize.
+///
+/// \return The demangled name of the function that contains the address if it
+/// is known; otherwise, the name of the module that contains the address and
+/// the offset of the address within it, which tools like addr2line(1) can
+/// resolve later.
+static std::string
+symbolize(const void* address)
+{
+    Dl_info info;
+    if (::dladdr(const_cast< void* >(address), &info) == 0)
+        return F("%s") % address;
+
+    if (info.dli_sname != NULL) {
+        int status;
+        char* demangled = abi::__cxa_demangle(info.dli_sname, NULL, NULL,
+                                              &status);
+        if (demangled != NULL) {
+            const std::string name(demangled);
+            std::free(demangled);
+            return name;
+        }
+        return info.dli_sname;
+    }
+
+    const char* module = info.dli_fname;
+    if (module != NULL) {
+        const char* slash = std::strrchr(module, '/');
+        if (slash != NULL)
+            module = slash + 1;
+    }
+    std::ostringstream output;
+    output << (module == NULL ? "?" : module) << "+0x" << std::hex
+           << (reinterpret_cast< uintptr_t >(address) -
+               reinterpret_cast< uintptr_t >(info.dli_fbase));
+    return output.str();
+}
+
+
+#endif  // defined(HAVE_PROFILER)
+
+
+}  // anonymous namespace
+
+
+/// Internal implementation of the profiler.
+struct utils::profiler::impl : utils::noncopyable {
+    /// Recorded samples.
+    sample_table table;
+
+    /// Whether the profiler is still taking samples.
+    bool running;
+
+#if defined(HAVE_PROFILER)
+    /// Disposition of SIGPROF before the profiler was started.
+    struct ::sigaction old_sigprof;
+#endif
+
+    /// Constructor.
+    impl(void) : running(false)
+    {
+    }
+};
+
+
+/// Whether the profiler is supported on this platform.
+#if defined(HAVE_PROFILER)
+const bool utils::profiler::supported = true;
+#else
+const bool utils::profiler::supported = false;
+#endif
+
+
+/// Starts profiling the current process.
+///
+/// Samples are taken every time the process consumes the given amount of CPU
+/// time, in user or in system mode.  The time spent by the children of the
+/// process is not accounted for.
+///
+/// The profiler interrupts the process with SIGPROF to take the samples, so
+/// any system calls of the process may fail with EINTR while it is running.
+///
+/// \pre No other profiler is running.
+///
+/// \param interval The CPU time between samples; must be positive.
+///
+/// \throw std::runtime_error If profiling is not supported or if the profiler
+///     cannot be started.
+utils::profiler::profiler(const datetime::delta& interval) :
+    _pimpl(new impl())
+{
+    PRE(active_table == NULL);
+    PRE(interval > datetime::delta());
+
+#if defined(HAVE_PROFILER)
+    // The first call to backtrace() may need to load the unwinder, which
+    // allocates memory; do it now rather than within the signal handler.
+    void* frame;
+    (void)::backtrace(&frame, 1);
+
+    struct ::sigaction sa;
+    std::memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = sigprof_handler;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESTART;
+    if (::sigaction(SIGPROF, &sa, &_pimpl->old_sigprof) == -1) {
+        const int original_errno = errno;
+        throw std::runtime_error(F("Failed to program SIGPROF: %s") %
+                                 std::strerror(original_errno));
+    }
+    active_table = &_pimpl->table;
+
+    struct ::itimerval timer;
+    timer.it_interval.tv_sec = interval.seconds;
+    timer.it_interval.tv_usec = interval.useconds;
+    timer.it_value = timer.it_interval;
+    if (::setitimer(ITIMER_PROF, &timer, NULL) == -1) {
+        const int original_errno = errno;
+        active_table = NULL;
+        (void)::sigaction(SIGPROF, &_pimpl->old_sigprof, NULL);
+        throw std::runtime_error(F("Failed to program the profiling timer: "
+                                   "%s") % std::strerror(original_errno));
+    }
+    _pimpl->running = true;
+#else
+    throw std::runtime_error("Profiling is not supported on this platform");
+#endif
+}
+
+
+/// Destructor; stops the profiler if it is still running.
+utils::profiler::~profiler(void)
+{
+    stop();
+}
+
+
+/// Stops taking samples.
+///
+/// This is idempotent, and the recorded samples remain available afterwards.
+void
+utils::profiler::stop(void)
+{
+    if (!_pimpl->running)
+        return;
+
+#if defined(HAVE_PROFILER)
+    struct ::itimerval timer;
+    std::memset(&timer, 0, sizeof(timer));
+    (void)::setitimer(ITIMER_PROF, &timer, NULL);
+    (void)::sigaction(SIGPROF, &_pimpl->old_sigprof, NULL);
+#endif
+    active_table = NULL;
+    _pimpl->running = false;
+}
+
+
+/// Returns the number of samples taken so far.
+///
+/// \return A count that includes the dropped samples.
+std::size_t
+utils::profiler::samples(void) const
+{
+    return _pimpl->table.samples;
+}
+
+
+/// Returns the number of samples that could not be recorded.
+///
+/// \return A count of the samples of new stacks taken once the maximum number
+/// of distinct stacks had been recorded.
+std::size_t
+utils::profiler::dropped_samples(void) const
+{
+    return _pimpl->table.dropped_samples;
+}
+
+
+/// Writes the recorded samples in the folded stacks format.
+///
+/// Stacks whose frames resolve to the same names are merged, and the output
+/// is sorted by stack.
+///
+/// \pre The profiler has been stopped.
+///
+/// \param output The stream into which to write the samples.
+void
+utils::profiler::write_folded(std::ostream& output) const
+{
+    PRE(!_pimpl->running);
+
+    std::map< std::string, std::size_t > folded;
+#if defined(HAVE_PROFILER)
+    std::map< const void*, std::string > names;
+    const std::vector< stack_entry >& entries = _pimpl->table.entries;
+    for (std::size_t i = 0; i < entries.size(); ++i) {
+        const stack_entry& entry = entries[i];
+        if (entry.count == 0)
+            continue;
+
+        std::string stack;
+        for (int j = entry.depth - 1; j >= 0; --j) {
+            // Except for the innermost frame, the addresses are those at which
+            // execution resumes after a call, and these may already belong to
+            // the next function.
+            const char* address = static_cast< const char* >(entry.frames[j]);
+            if (j > 0)
+                --address;
+
+            std::map< const void*, std::string >::const_iterator iter =
+                names.find(address);
+            if (iter == names.end())
+                iter = names.insert(std::make_pair(
+                    address, symbolize(address))).first;
+
+            if (!stack.empty())
+                stack += ';';
+            stack += (*iter).second;
+        }
+        folded[stack] += entry.count;
+    }
+#endif
+
+    for (std::map< std::string, std::size_t >::const_iterator
+             iter = folded.begin(); iter != folded.end(); ++iter)
+        output << (*iter).first << ' ' << (*iter).second << '\n';
+
+    if (_pimpl->table.dropped_samples > 0)
+        LW(F("Dropped %s of %s profiling samples because too many distinct "
+             "stacks were seen") % _pimpl->table.dropped_samples %
+           _pimpl->table.samples);
+}
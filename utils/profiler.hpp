@@ -0,0 +1,80 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// \file utils/profiler.hpp
+/// Statistical profiler of the CPU time of the current process.
+///
+/// The profiler samples the stack of the process at regular intervals of the
+/// CPU time it consumes, which does not include the time of its children, and
+/// counts the samples of every distinct stack.  The results are written in the
+/// folded format that flame graph generators take as input: every line holds
+/// the frames of a stack, from the outermost to the innermost and separated by
+/// semicolons, followed by a space and the number of samples of the stack.
+
+#if !defined(UTILS_PROFILER_HPP)
+#define UTILS_PROFILER_HPP
+
+#include "utils/profiler_fwd.hpp"
+
+#include <cstddef>
+#include <memory>
+#include <ostream>
+
+#include "utils/datetime_fwd.hpp"
+#include "utils/noncopyable.hpp"
+
+namespace utils {
+
+
+/// Samples the stack of the current process while it is alive.
+///
+/// Only one profiler can be active at any given time because the samples are
+/// taken from a SIGPROF handler.
+class profiler : noncopyable {
+    struct impl;
+
+    /// Pointer to the internal implementation.
+    std::auto_ptr< impl > _pimpl;
+
+public:
+    static const bool supported;
+
+    explicit profiler(const datetime::delta&);
+    ~profiler(void);
+
+    void stop(void);
+
+    std::size_t samples(void) const;
+    std::size_t dropped_samples(void) const;
+    void write_folded(std::ostream&) const;
+};
+
+
+}  // namespace utils
+
+#endif  // !defined(UTILS_PROFILER_HPP)
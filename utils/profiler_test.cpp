@@ -0,0 +1,166 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "utils/profiler.hpp"
+
+#include <cstddef>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <atf-c++.hpp>
+
+#include "utils/datetime.hpp"
+#include "utils/text/operations.ipp"
+
+namespace datetime = utils::datetime;
+namespace text = utils::text;
+
+
+namespace {
+
+
+/// Consumes CPU time until the profiler has taken some samples.
+///
+/// \param profiler The running profiler.
+/// \param samples Number of samples to wait for.
+static void
+burn_cpu(const utils::profiler& profiler, const std::size_t samples)
+{
+    volatile unsigned long counter = 0;
+    const datetime::timestamp deadline = datetime::timestamp::now() +
+        datetime::delta(30, 0);
+    while (profiler.samples() < samples) {
+        ATF_REQUIRE(datetime::timestamp::now() < deadline);
+        for (int i = 0; i < 100000; ++i)
+            counter = counter + i;
+    }
+}
+
+
+/// Skips the calling test if profiling is not supported.
+static void
+require_supported(void)
+{
+    if (!utils::profiler::supported)
+        ATF_SKIP("Profiling is not supported on this platform");
+}
+
+
+}  // anonymous namespace
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(samples);
+ATF_TEST_CASE_BODY(samples)
+{
+    require_supported();
+
+    utils::profiler profiler(datetime::delta::from_microseconds(1000));
+    burn_cpu(profiler, 20);
+    profiler.stop();
+    const std::size_t samples = profiler.samples();
+    ATF_REQUIRE(samples >= 20);
+    ATF_REQUIRE_EQ(0, profiler.dropped_samples());
+
+    burn_cpu(utils::profiler(datetime::delta::from_microseconds(1000)), 1);
+    ATF_REQUIRE_EQ(samples, profiler.samples());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(stop__idempotent);
+ATF_TEST_CASE_BODY(stop__idempotent)
+{
+    require_supported();
+
+    utils::profiler profiler(datetime::delta(1, 0));
+    profiler.stop();
+    profiler.stop();
+    ATF_REQUIRE_EQ(0, profiler.samples());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(write_folded__format);
+ATF_TEST_CASE_BODY(write_folded__format)
+{
+    require_supported();
+
+    utils::profiler profiler(datetime::delta::from_microseconds(1000));
+    burn_cpu(profiler, 20);
+    profiler.stop();
+
+    std::ostringstream output;
+    profiler.write_folded(output);
+
+    std::size_t total = 0;
+    const std::vector< std::string > lines = text::split(output.str(), '\n');
+    ATF_REQUIRE(lines.size() >= 2);
+    ATF_REQUIRE(lines[lines.size() - 1].empty());
+    for (std::size_t i = 0; i < lines.size() - 1; ++i) {
+        const std::string::size_type space = lines[i].rfind(' ');
+        ATF_REQUIRE(space != std::string::npos);
+        ATF_REQUIRE(space > 0);
+        total += text::to_type< std::size_t >(lines[i].substr(space + 1));
+    }
+    ATF_REQUIRE_EQ(profiler.samples(), total);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(write_folded__empty);
+ATF_TEST_CASE_BODY(write_folded__empty)
+{
+    require_supported();
+
+    utils::profiler profiler(datetime::delta(60, 0));
+    profiler.stop();
+
+    std::ostringstream output;
+    profiler.write_folded(output);
+    ATF_REQUIRE(output.str().empty());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(unsupported);
+ATF_TEST_CASE_BODY(unsupported)
+{
+    if (utils::profiler::supported)
+        ATF_SKIP("Profiling is supported on this platform");
+
+    ATF_REQUIRE_THROW_RE(std::runtime_error, "not supported",
+                         utils::profiler(datetime::delta(1, 0)));
+}
+
+
+ATF_INIT_TEST_CASES(tcs)
+{
+    ATF_ADD_TEST_CASE(tcs, samples);
+    ATF_ADD_TEST_CASE(tcs, stop__idempotent);
+    ATF_ADD_TEST_CASE(tcs, write_folded__format);
+    ATF_ADD_TEST_CASE(tcs, write_folded__empty);
+    ATF_ADD_TEST_CASE(tcs, unsupported);
+}
@@ -44,6 +44,7 @@ extern "C" {
 
 #include "utils/format/macros.hpp"
 #include "utils/logging/macros.hpp"
+#include "utils/logging/operations.hpp"
 
 
 namespace {
@@ -93,6 +94,10 @@ crash_handler(const int signo)
                 "doing before the crash happened; if possible, include the log "
                 "file mentioned above\n") % PACKAGE_BUGREPORT);
 
+    // Best effort only: the process is likely unstable at this point, but any
+    // buffered entries are what make the log useful for the report.
+    utils::logging::flush();
+
     /// The handler is installed with SA_RESETHAND, so this is safe to do.  We
     /// really want to call the default handler to generate any possible core
     /// dumps.
@@ -40,6 +40,7 @@
 #   include <tr1/memory>
 namespace std {
     using tr1::shared_ptr;
+    using tr1::weak_ptr;
 }
 #endif
 
@@ -35,9 +35,9 @@ extern "C" {
 #include <unistd.h>
 }
 
+#include <cstddef>
 #include <cstdlib>
 #include <cstring>
-#include <set>
 
 #include "utils/logging/macros.hpp"
 #include "utils/process/operations.hpp"
@@ -56,12 +56,28 @@ namespace {
 static volatile int fired_signal = -1;
 
 
-/// Collection of PIDs.
-typedef std::set< pid_t > pids_set;
+/// Number of PIDs that fit in every chunk of the registry of processes.
+static const std::size_t pids_per_chunk = 64;
 
 
-/// List of processes to kill upon reception of a signal.
-static pids_set pids_to_kill;
+/// Chunk of the registry of processes to kill upon reception of a signal.
+///
+/// The registry is only modified outside of the signal handler and the handler
+/// only reads it, so it needs no locking nor signal masking as long as every
+/// update is a single store: a slot holds either 0 or a complete PID, and a
+/// chunk is only linked into the registry once all its slots are zeroed.
+/// Chunks are never released for the same reason.
+struct pids_chunk {
+    /// PIDs of the registered processes; 0 denotes a free slot.
+    volatile pid_t pids[pids_per_chunk];
+
+    /// Next chunk in the registry, or NULL if this is the last one.
+    pids_chunk* volatile next;
+};
+
+
+/// Registry of processes to kill upon reception of a signal.
+static pids_chunk* volatile pids_to_kill = NULL;
 
 
 /// Programmer status for the SIGHUP signal.
@@ -107,13 +123,36 @@ signal_handler(const int signo)
 
     fired_signal = signo;
 
-    for (pids_set::const_iterator iter = pids_to_kill.begin();
-        iter != pids_to_kill.end(); ++iter) {
-        process::terminate_group(*iter);
+    for (pids_chunk* chunk = pids_to_kill; chunk != NULL;
+         chunk = chunk->next) {
+        for (std::size_t i = 0; i < pids_per_chunk; ++i) {
+            const pid_t pid = chunk->pids[i];
+            if (pid != 0)
+                process::terminate_group(pid);
+        }
     }
 }
 
 
+/// Looks for a slot in the registry of processes to kill.
+///
+/// \param pid The PID to look for, or 0 to look for a free slot.
+///
+/// \return The slot holding the PID, or NULL if there is none.
+static volatile pid_t*
+find_pid_slot(const pid_t pid)
+{
+    for (pids_chunk* chunk = pids_to_kill; chunk != NULL;
+         chunk = chunk->next) {
+        for (std::size_t i = 0; i < pids_per_chunk; ++i) {
+            if (chunk->pids[i] == pid)
+                return &chunk->pids[i];
+        }
+    }
+    return NULL;
+}
+
+
 /// Installs signal handlers for potential interrupts.
 ///
 /// \pre Must not have been called before.
@@ -273,31 +312,43 @@ signals::check_interrupt(void)
 
 /// Registers a child process to be killed upon reception of an interrupt.
 ///
-/// \pre Must be called with interrupts being inhibited.  The caller must ensure
-/// that the call call to fork() and the addition of the PID happen atomically.
+/// This does not require interrupts to be inhibited.  If an interrupt fires
+/// between the creation of the child process and its registration, the child
+/// process is killed here instead of by the signal handler.
 ///
-/// \param pid The PID of the child process.  Must not have been yet regsitered.
+/// \param pid The PID of the child process.  Must not have been yet registered.
 void
 signals::add_pid_to_kill(const pid_t pid)
 {
-    PRE(interrupts_inhibiter_active);
-    PRE(pids_to_kill.find(pid) == pids_to_kill.end());
-    pids_to_kill.insert(pid);
+    PRE(pid > 0);
+    PRE(find_pid_slot(pid) == NULL);
+
+    volatile pid_t* slot = find_pid_slot(0);
+    if (slot == NULL) {
+        pids_chunk* chunk = new pids_chunk;
+        for (std::size_t i = 0; i < pids_per_chunk; ++i)
+            chunk->pids[i] = 0;
+        chunk->next = pids_to_kill;
+        pids_to_kill = chunk;
+        slot = &chunk->pids[0];
+    }
+    *slot = pid;
+
+    if (fired_signal != -1)
+        process::terminate_group(pid);
 }
 
 
 /// Unregisters a child process previously registered via add_pid_to_kill().
 ///
-/// \pre Must be called with interrupts being inhibited.  This is not necessary,
-/// but pushing this to the caller simplifies our logic and provides consistency
-/// with the add_pid_to_kill() call.
+/// This does not require interrupts to be inhibited.
 ///
 /// \param pid The PID of the child process.  Must have been registered
 ///     previously, and the process must have already been awaited for.
 void
 signals::remove_pid_to_kill(const pid_t pid)
 {
-    PRE(interrupts_inhibiter_active);
-    PRE(pids_to_kill.find(pid) != pids_to_kill.end());
-    pids_to_kill.erase(pid);
+    volatile pid_t* slot = find_pid_slot(pid);
+    PRE(slot != NULL);
+    *slot = 0;
 }
@@ -35,6 +35,7 @@ extern "C" {
 
 #include <cstdlib>
 #include <iostream>
+#include <vector>
 
 #include <atf-c++.hpp>
 
@@ -42,6 +43,7 @@ extern "C" {
 #include "utils/fs/path.hpp"
 #include "utils/process/child.ipp"
 #include "utils/process/status.hpp"
+#include "utils/shared_ptr.hpp"
 #include "utils/signals/exceptions.hpp"
 #include "utils/signals/programmer.hpp"
 
@@ -224,6 +226,68 @@ ATF_TEST_CASE_BODY(interrupts_handler__kill_children)
 }
 
 
+ATF_TEST_CASE(interrupts_handler__kill_many_children);
+ATF_TEST_CASE_HEAD(interrupts_handler__kill_many_children)
+{
+    set_md_var("timeout", "30");
+}
+ATF_TEST_CASE_BODY(interrupts_handler__kill_many_children)
+{
+    // Spawn more children than fit in a single chunk of the registry of
+    // processes to kill so that the signal handler has to walk several.
+    std::vector< std::shared_ptr< process::child > > children;
+    for (int i = 0; i < 100; ++i)
+        children.push_back(std::shared_ptr< process::child >(
+            process::child::fork_files(
+                pause_child, fs::path("/dev/stdout"), fs::path("/dev/stderr"))
+            .release()));
+    // Release some slots so that later registrations reuse them.
+    for (int i = 0; i < 10; ++i) {
+        ::kill(children[i]->pid(), SIGKILL);
+        (void)children[i]->wait();
+    }
+    children.erase(children.begin(), children.begin() + 10);
+    for (int i = 0; i < 10; ++i)
+        children.push_back(std::shared_ptr< process::child >(
+            process::child::fork_files(
+                pause_child, fs::path("/dev/stdout"), fs::path("/dev/stderr"))
+            .release()));
+
+    signals::interrupts_handler interrupts;
+    ::kill(::getpid(), SIGHUP);
+
+    for (std::vector< std::shared_ptr< process::child > >::iterator iter =
+             children.begin(); iter != children.end(); ++iter) {
+        const process::status status = (*iter)->wait();
+        ATF_REQUIRE(status.signaled());
+        ATF_REQUIRE_EQ(SIGKILL, status.termsig());
+    }
+}
+
+
+ATF_TEST_CASE(interrupts_handler__kill_late_children);
+ATF_TEST_CASE_HEAD(interrupts_handler__kill_late_children)
+{
+    set_md_var("timeout", "10");
+}
+ATF_TEST_CASE_BODY(interrupts_handler__kill_late_children)
+{
+    signals::interrupts_handler interrupts;
+    ::kill(::getpid(), SIGHUP);
+
+    // The interrupt fired before the child was registered, so the child has
+    // to be killed by its registration.  If this does not happen, the wait
+    // call below would block indefinitely and cause our test to time out.
+    std::auto_ptr< process::child > child(process::child::fork_files(
+         pause_child, fs::path("/dev/stdout"), fs::path("/dev/stderr")));
+    const process::status status = child->wait();
+    ATF_REQUIRE(status.signaled());
+    ATF_REQUIRE_EQ(SIGKILL, status.termsig());
+
+    ATF_REQUIRE_THROW(signals::interrupted_error, signals::check_interrupt());
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(interrupts_inhibiter__sigalrm);
 ATF_TEST_CASE_BODY(interrupts_inhibiter__sigalrm)
 {
@@ -258,6 +322,8 @@ ATF_INIT_TEST_CASES(tcs)
     ATF_ADD_TEST_CASE(tcs, interrupts_handler__sigint);
     ATF_ADD_TEST_CASE(tcs, interrupts_handler__sigterm);
     ATF_ADD_TEST_CASE(tcs, interrupts_handler__kill_children);
+    ATF_ADD_TEST_CASE(tcs, interrupts_handler__kill_many_children);
+    ATF_ADD_TEST_CASE(tcs, interrupts_handler__kill_late_children);
 
     ATF_ADD_TEST_CASE(tcs, interrupts_inhibiter__sigalrm);
     ATF_ADD_TEST_CASE(tcs, interrupts_inhibiter__sighup);
@@ -78,15 +78,18 @@ namespace signals = utils::signals;
 ///
 /// \param signo The signal for which to install the handler.
 /// \param handler The handler to install.
+/// \param restart Whether system calls interrupted by the signal are restarted
+///     automatically.  If false, they fail with EINTR instead.
 ///
 /// \throw signals::system_error If there is an error programming the signal.
-signals::programmer::programmer(const int signo, const handler_type handler) :
+signals::programmer::programmer(const int signo, const handler_type handler,
+                                const bool restart) :
     _pimpl(new impl(signo))
 {
     struct ::sigaction sa;
     sa.sa_handler = handler;
     sigemptyset(&sa.sa_mask);
-    sa.sa_flags = SA_RESTART;
+    sa.sa_flags = restart ? SA_RESTART : 0;
 
     if (::sigaction(_pimpl->signo, &sa, &_pimpl->old_sa) == -1) {
         const int original_errno = errno;
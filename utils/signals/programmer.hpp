@@ -50,7 +50,7 @@ class programmer : noncopyable {
     std::auto_ptr< impl > _pimpl;
 
 public:
-    programmer(const int, const handler_type);
+    programmer(const int, const handler_type, const bool = true);
     ~programmer(void);
 
     void unprogram(void);
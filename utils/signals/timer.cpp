@@ -37,7 +37,6 @@ extern "C" {
 #include <cerrno>
 #include <map>
 #include <set>
-#include <vector>
 
 #include "utils/datetime.hpp"
 #include "utils/format/macros.hpp"
@@ -94,14 +93,12 @@ class global_state : utils::noncopyable {
     /// be unique, and we want all of these pointers to be valid.
     typedef std::set< signals::timer* > timers_set;
 
-    /// Sequence of ordered timers.
-    typedef std::vector< signals::timer* > timers_vector;
-
-    /// Collection of active timestamps by their activation timestamp.
+    /// Collection of active timers by their activation time.
     ///
     /// This collection is ordered intentionally so that it can be scanned
-    /// sequentially to find either expired or expiring-now timers.
-    typedef std::map< datetime::timestamp, timers_set > timers_by_timestamp_map;
+    /// sequentially to find either expired or expiring-now timers.  Timers stay
+    /// in here until they are unprogrammed, even if they fired already.
+    typedef std::map< datetime::monotonic_time, timers_set > timers_by_time_map;
 
     /// The original timer before any timer was programmed.
     ::itimerval _old_timeval;
@@ -110,10 +107,10 @@ class global_state : utils::noncopyable {
     std::auto_ptr< signals::programmer > _sigalrm_programmer;
 
     /// Time of the current activation of the timer.
-    datetime::timestamp _timer_activation;
+    datetime::monotonic_time _timer_activation;
 
-    /// Mapping of all active timers using their timestamp as the key.
-    timers_by_timestamp_map _all_timers;
+    /// Mapping of all active timers using their activation time as the key.
+    timers_by_time_map _all_timers;
 
     /// Adds a timer to the _all_timers map.
     ///
@@ -135,101 +132,77 @@ class global_state : utils::noncopyable {
     void
     remove_from_all_timers(signals::timer* timer)
     {
-        // We may not find the timer in _all_timers if the timer has fired,
-        // because fire() took it out from the map.
-        timers_by_timestamp_map::iterator iter = _all_timers.find(
+        timers_by_time_map::iterator iter = _all_timers.find(
             timer->when());
-        if (iter != _all_timers.end()) {
-            timers_set& timers = (*iter).second;
-            INV(timers.find(timer) != timers.end());
-            timers.erase(timer);
-            if (timers.empty()) {
-                _all_timers.erase(iter);
-            }
+        INV(iter != _all_timers.end());
+        timers_set& timers = (*iter).second;
+        INV(timers.find(timer) != timers.end());
+        timers.erase(timer);
+        if (timers.empty()) {
+            _all_timers.erase(iter);
         }
     }
 
-    /// Calculates all timers to execute at this timestamp.
-    ///
-    /// \param now The current timestamp.
-    /// \param unused_inhibiter Reference to the active interrupts inhibiter, to
-    ///     ensure that this is called with interrupts inhibited.
-    ///
-    /// \post _all_timers is updated to contain only the timers that are
-    /// strictly in the future.
-    ///
-    /// \return A sequence of valid timers that need to be invoked in the order
-    /// of activation.  These are all previously registered timers with
-    /// activations in the past.
-    timers_vector
-    compute_timers_to_run_and_prune_old(
-        const datetime::timestamp& now,
-        const signals::interrupts_inhibiter& UTILS_UNUSED_PARAM(inhibiter))
-    {
-        timers_vector to_run;
-
-        timers_by_timestamp_map::iterator iter = _all_timers.begin();
-        while (iter != _all_timers.end() && (*iter).first <= now) {
-            const timers_set& timers = (*iter).second;
-            to_run.insert(to_run.end(), timers.begin(), timers.end());
-
-            // Remove expired entries here so that we can always assume that
-            // the first entry in all_timers corresponds to the next
-            // activation.
-            const timers_by_timestamp_map::iterator previous_iter = iter;
-            ++iter;
-            _all_timers.erase(previous_iter);
-        }
-
-        return to_run;
-    }
-
     /// Adjusts the global system timer to point to the next activation.
     ///
-    /// \param now The current timestamp.
+    /// This does not log nor allocate memory because fire() calls it from the
+    /// SIGALRM handler.
+    ///
+    /// \param now The current time of the monotonic clock.
     /// \param unused_inhibiter Reference to the active interrupts inhibiter, to
     ///     ensure that this is called with interrupts inhibited.
     ///
+    /// \return True if the system timer was reprogrammed; false otherwise.
+    ///
     /// \throw system_error If the programming fails.
-    void
+    bool
     reprogram_system_timer(
-        const datetime::timestamp& now,
+        const datetime::monotonic_time& now,
         const signals::interrupts_inhibiter& UTILS_UNUSED_PARAM(inhibiter))
     {
         if (_all_timers.empty()) {
-            // Nothing to do.  We can reach this case if all the existing timers
-            // are in the past and they all fired.  Just ignore the request and
-            // leave the global timer as is.
-            return;
+            // Nothing to do.  Just ignore the request and leave the global
+            // timer as is.
+            return false;
         }
 
-        // While fire() prunes old entries from the list of timers, it is
-        // possible for this routine to run with "expired" timers (i.e. timers
-        // whose deadline lies in the past but that have not yet fired for
-        // whatever reason that is out of our control) in the list.  We have to
-        // iterate until we find the next activation instead of assuming that
-        // the first entry represents the desired value.
-        timers_by_timestamp_map::const_iterator iter = _all_timers.begin();
+        // The list of timers keeps "expired" timers (i.e. timers whose
+        // deadline lies in the past, be it because they fired already and
+        // have not been unprogrammed yet or because they have not yet fired
+        // for whatever reason that is out of our control) until they are
+        // unprogrammed.  We have to iterate until we find the next activation
+        // instead of assuming that the first entry represents the desired
+        // value.  Timers due right now are skipped too: programming the system
+        // timer with a zero delta would disarm it.
+        timers_by_time_map::const_iterator iter = _all_timers.begin();
         PRE(!(*iter).second.empty());
-        datetime::timestamp next = (*iter).first;
-        while (next < now) {
+        datetime::monotonic_time next = (*iter).first;
+        while (next <= now) {
             ++iter;
             if (iter == _all_timers.end()) {
                 // Nothing to do.  We can reach this case if all the existing
-                // timers are in the past but they have not yet fired.
-                return;
+                // timers are in the past.
+                return false;
             }
             PRE(!(*iter).second.empty());
             next = (*iter).first;
         }
 
-        if (next < _timer_activation || now > _timer_activation) {
-            INV(next >= now);
-            const datetime::delta delta = next - now;
-            LD(F("Reprogramming timer; firing on %s; now is %s") % next % now);
-            safe_setitimer(delta, NULL);
+        // Reprogram the system timer whenever the next activation moves, not
+        // only when it moves earlier.  If we left the system timer pointing to
+        // the activation of a timer that was unprogrammed, we would get a
+        // spurious SIGALRM that does no useful work and interrupts any
+        // blocking system call in progress (e.g. the wait for a subprocess).
+        // This is the common case when running many subprocesses that finish
+        // before their deadlines, and a setitimer(2) call is much cheaper than
+        // a signal delivery.
+        if (next != _timer_activation || now > _timer_activation) {
+            INV(next > now);
+            safe_setitimer(next - now, NULL);
             _timer_activation = next;
+            return true;
         }
+        return false;
     }
 
 public:
@@ -240,10 +213,10 @@ public:
     /// involves keeping track of the old handlers so that we can restore them.
     ///
     /// \param timer The timer being programmed.
-    /// \param now The current timestamp.
+    /// \param now The current time of the monotonic clock.
     ///
     /// \throw system_error If the programming fails.
-    global_state(signals::timer* timer, const datetime::timestamp& now) :
+    global_state(signals::timer* timer, const datetime::monotonic_time& now) :
         _timer_activation(timer->when())
     {
         PRE(now < timer->when());
@@ -254,8 +227,11 @@ public:
         LD(F("Installing first timer; firing on %s; now is %s") %
            timer->when() % now);
 
+        // Blocking system calls must not be restarted when a timer fires so
+        // that the caller gets a chance to react to the expiration, e.g. to
+        // give up on a killed subprocess that does not die.
         _sigalrm_programmer.reset(
-            new signals::programmer(SIGALRM, sigalrm_handler));
+            new signals::programmer(SIGALRM, sigalrm_handler, false));
         try {
             safe_setitimer(delta, &_old_timeval);
             _timer_activation = timer->when();
@@ -290,16 +266,18 @@ public:
     /// handler for SIGALRM.
     ///
     /// \param timer The timer being programmed.
-    /// \param now The current timestamp.
+    /// \param now The current time of the monotonic clock.
     ///
     /// \throw system_error If the programming fails.
     void
-    program_new(signals::timer* timer, const datetime::timestamp& now)
+    program_new(signals::timer* timer, const datetime::monotonic_time& now)
     {
         signals::interrupts_inhibiter inhibiter;
 
         add_to_all_timers(timer);
-        reprogram_system_timer(now, inhibiter);
+        if (reprogram_system_timer(now, inhibiter))
+            LD(F("Reprogrammed timer; firing on %s; now is %s") %
+               _timer_activation % now);
     }
 
     /// Unprograms a timer.
@@ -322,30 +300,39 @@ public:
         if (_all_timers.empty()) {
             return false;
         } else {
-            reprogram_system_timer(datetime::timestamp::now(), inhibiter);
+            const datetime::monotonic_time now =
+                datetime::monotonic_time::now();
+            if (reprogram_system_timer(now, inhibiter))
+                LD(F("Reprogrammed timer; firing on %s; now is %s") %
+                   _timer_activation % now);
             return true;
         }
     }
 
     /// Executes active timers.
     ///
-    /// Active timers are all those that fire on or before 'now'.
+    /// Active timers are all those that fire on or before 'now' and that did
+    /// not fire yet.  This runs from the SIGALRM handler, which may have
+    /// interrupted the program in the middle of a malloc(3) call, so it must
+    /// not allocate memory: the fired timers are left in _all_timers for
+    /// unprogram() to remove them later.
     ///
     /// \param now The current time.
     void
-    fire(const datetime::timestamp& now)
+    fire(const datetime::monotonic_time& now)
     {
-        timers_vector to_run;
-        {
-            signals::interrupts_inhibiter inhibiter;
-            to_run = compute_timers_to_run_and_prune_old(now, inhibiter);
-            reprogram_system_timer(now, inhibiter);
-        }
+        signals::interrupts_inhibiter inhibiter;
 
-        for (timers_vector::iterator iter = to_run.begin();
-             iter != to_run.end(); ++iter) {
-            signals::detail::invoke_do_fired(*iter);
+        for (timers_by_time_map::const_iterator iter = _all_timers.begin();
+             iter != _all_timers.end() && (*iter).first <= now; ++iter) {
+            const timers_set& timers = (*iter).second;
+            for (timers_set::const_iterator iter2 = timers.begin();
+                 iter2 != timers.end(); ++iter2) {
+                if (!(*iter2)->fired())
+                    signals::detail::invoke_do_fired(*iter2);
+            }
         }
+        (void)reprogram_system_timer(now, inhibiter);
     }
 };
 
@@ -361,7 +348,7 @@ static void
 sigalrm_handler(const int signo)
 {
     PRE(signo == SIGALRM);
-    globals->fire(datetime::timestamp::now());
+    globals->fire(datetime::monotonic_time::now());
 }
 
 
@@ -385,12 +372,12 @@ utils::signals::detail::invoke_do_fired(timer* timer)
 /// module breaks as well because we use pointers to the parent timer as the
 /// identifier of the timer.
 struct utils::signals::timer::impl : utils::noncopyable {
-    /// Timestamp when this timer is expected to fire.
+    /// Monotonic time when this timer is expected to fire.
     ///
-    /// Note that the timer might be processed after this timestamp, so users of
+    /// Note that the timer might be processed after this time, so users of
     /// this field need to check for timers that fire on or before the
     /// activation time.
-    datetime::timestamp when;
+    datetime::monotonic_time when;
 
     /// True until unprogram() is called.
     bool programmed;
@@ -403,8 +390,8 @@ struct utils::signals::timer::impl : utils::noncopyable {
 
     /// Constructor.
     ///
-    /// \param when_ Timestamp when this timer is expected to fire.
-    impl(const datetime::timestamp& when_) :
+    /// \param when_ Monotonic time when this timer is expected to fire.
+    impl(const datetime::monotonic_time& when_) :
         when(when_), programmed(true), fired(false)
     {
     }
@@ -426,7 +413,7 @@ signals::timer::timer(const datetime::delta& delta)
 {
     signals::interrupts_inhibiter inhibiter;
 
-    const datetime::timestamp now = datetime::timestamp::now();
+    const datetime::monotonic_time now = datetime::monotonic_time::now();
     _pimpl.reset(new impl(now + delta));
     if (globals.get() == NULL) {
         globals.reset(new global_state(this, now));
@@ -455,7 +442,7 @@ signals::timer::~timer(void)
     }
 
     if (!_pimpl->fired) {
-        const datetime::timestamp now = datetime::timestamp::now();
+        const datetime::monotonic_time now = datetime::monotonic_time::now();
         if (now > _pimpl->when) {
             LW("Expired timer never fired; the code never called unprogram()!");
         }
@@ -465,9 +452,9 @@ signals::timer::~timer(void)
 
 /// Returns the time of the timer activation.
 ///
-/// \return A timestamp that has no relation to the current time (i.e. can be in
-/// the future or in the past) nor the timer's activation status.
-const datetime::timestamp&
+/// \return A monotonic time that has no relation to the current time (i.e. can
+/// be in the future or in the past) nor the timer's activation status.
+const datetime::monotonic_time&
 signals::timer::when(void) const
 {
     return _pimpl->when;
@@ -476,8 +463,9 @@ signals::timer::when(void) const
 
 /// Callback for the SIGALRM handler when this timer expires.
 ///
-/// \warning This is executed from a signal handler context without signals
-/// inhibited.  See signal(7) for acceptable system calls.
+/// \warning This is executed from a signal handler context with signals
+/// inhibited.  See signal(7) for acceptable system calls.  Timers cannot be
+/// programmed nor unprogrammed from here.
 void
 signals::timer::do_fired(void)
 {
@@ -492,8 +480,9 @@ signals::timer::do_fired(void)
 /// The default callback does nothing.  We record the activation of the timer
 /// separately, which may be appropriate in the majority of the cases.
 ///
-/// \warning This is executed from a signal handler context without signals
-/// inhibited.  See signal(7) for acceptable system calls.
+/// \warning This is executed from a signal handler context with signals
+/// inhibited.  See signal(7) for acceptable system calls.  Timers cannot be
+/// programmed nor unprogrammed from here.
 void
 signals::timer::callback(void)
 {
@@ -541,7 +530,7 @@ signals::timer::unprogram(void)
     // Handle the case where the timer has expired before we ever got its
     // corresponding signal.  Do so by invoking its callback now.
     if (!_pimpl->fired) {
-        const datetime::timestamp now = datetime::timestamp::now();
+        const datetime::monotonic_time now = datetime::monotonic_time::now();
         if (now > _pimpl->when) {
             LW(F("Firing expired timer on destruction (was to fire on %s)") %
                _pimpl->when);
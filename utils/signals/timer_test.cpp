@@ -29,12 +29,15 @@
 #include "utils/signals/timer.hpp"
 
 extern "C" {
+#include <sys/time.h>
+
 #include <signal.h>
 #include <unistd.h>
 }
 
 #include <cstddef>
 #include <iostream>
+#include <string>
 #include <vector>
 
 #include <atf-c++.hpp>
@@ -257,6 +260,50 @@ ATF_TEST_CASE_BODY(multiprogram_and_cancel_some)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(multiprogram_and_cancel_first);
+ATF_TEST_CASE_BODY(multiprogram_and_cancel_first)
+{
+    signals::timer timer1(datetime::delta(1, 0));
+    signals::timer timer2(datetime::delta(30, 0));
+
+    timer1.unprogram();
+
+    // The system timer must now point to the activation of the remaining
+    // timer; otherwise, we would get a spurious SIGALRM when timer1 was due.
+    ::itimerval timeval;
+    ATF_REQUIRE(::getitimer(ITIMER_REAL, &timeval) != -1);
+    ATF_REQUIRE(timeval.it_value.tv_sec >= 20);
+
+    timer2.unprogram();
+    ATF_REQUIRE(!timer1.fired());
+    ATF_REQUIRE(!timer2.fired());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(multiprogram_and_unprogram_after_firing);
+ATF_TEST_CASE_BODY(multiprogram_and_unprogram_after_firing)
+{
+    std::vector< int > items;
+    delayed_inserter timer1(datetime::delta(0, 10000), items, 1);
+    delayed_inserter timer2(datetime::delta(0, 20000), items, 2);
+
+    std::vector< signals::timer* > timers;
+    timers.push_back(&timer1);
+    timers.push_back(&timer2);
+    wait_timers(timers);
+
+    // Both timers are out of the schedule because they fired, but they are
+    // still programmed: unprogramming the first must not release the global
+    // state that the second one still needs.
+    timer1.unprogram();
+    timer2.unprogram();
+
+    signals::timer timer3(datetime::delta(30, 0));
+    timer3.unprogram();
+    ATF_REQUIRE(!timer3.fired());
+}
+
+
 ATF_TEST_CASE(multiprogram_and_expire_before_activations);
 ATF_TEST_CASE_HEAD(multiprogram_and_expire_before_activations)
 {
@@ -373,6 +420,42 @@ ATF_TEST_CASE_BODY(unprogram)
 }
 
 
+ATF_TEST_CASE(fire_while_allocating);
+ATF_TEST_CASE_HEAD(fire_while_allocating)
+{
+    set_md_var("descr", "Ensure that the activation of timers does not "
+               "corrupt the heap when the program is allocating memory and "
+               "that timers that fired do not prevent the activation of the "
+               "later ones");
+    set_md_var("timeout", "20");
+}
+ATF_TEST_CASE_BODY(fire_while_allocating)
+{
+    std::vector< signals::timer* > timers;
+    for (int i = 0; i < 200; ++i)
+        timers.push_back(new signals::timer(datetime::delta(0, 1000 * (i + 1))));
+
+    bool all_fired;
+    do {
+        for (int i = 0; i < 100; ++i) {
+            std::vector< std::string > garbage(i, std::string(i, 'x'));
+            ATF_REQUIRE_EQ(static_cast< std::size_t >(i), garbage.size());
+        }
+
+        all_fired = true;
+        for (std::vector< signals::timer* >::const_iterator
+                 iter = timers.begin(); iter != timers.end(); ++iter)
+            all_fired &= (*iter)->fired();
+    } while (!all_fired);
+
+    for (std::vector< signals::timer* >::reverse_iterator
+             iter = timers.rbegin(); iter != timers.rend(); ++iter) {
+        (*iter)->unprogram();
+        delete *iter;
+    }
+}
+
+
 ATF_TEST_CASE(infinitesimal);
 ATF_TEST_CASE_HEAD(infinitesimal)
 {
@@ -420,9 +503,12 @@ ATF_INIT_TEST_CASES(tcs)
     ATF_ADD_TEST_CASE(tcs, multiprogram_ordered);
     ATF_ADD_TEST_CASE(tcs, multiprogram_reorder_next_activations);
     ATF_ADD_TEST_CASE(tcs, multiprogram_and_cancel_some);
+    ATF_ADD_TEST_CASE(tcs, multiprogram_and_cancel_first);
+    ATF_ADD_TEST_CASE(tcs, multiprogram_and_unprogram_after_firing);
     ATF_ADD_TEST_CASE(tcs, multiprogram_and_expire_before_activations);
     ATF_ADD_TEST_CASE(tcs, expire_before_firing);
     ATF_ADD_TEST_CASE(tcs, reprogram_from_scratch);
     ATF_ADD_TEST_CASE(tcs, unprogram);
+    ATF_ADD_TEST_CASE(tcs, fire_while_allocating);
     ATF_ADD_TEST_CASE(tcs, infinitesimal);
 }
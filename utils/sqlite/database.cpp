@@ -33,6 +33,8 @@ extern "C" {
 }
 
 #include <cstring>
+#include <map>
+#include <memory>
 #include <stdexcept>
 
 #include "utils/format/macros.hpp"
@@ -42,6 +44,7 @@ extern "C" {
 #include "utils/optional.ipp"
 #include "utils/sanity.hpp"
 #include "utils/sqlite/exceptions.hpp"
+#include "utils/sqlite/incremental_blob.hpp"
 #include "utils/sqlite/statement.ipp"
 #include "utils/sqlite/transaction.hpp"
 
@@ -63,6 +66,17 @@ struct utils::sqlite::database::impl : utils::noncopyable {
     /// Whether we own the database or not (to decide if we close it).
     bool owned;
 
+    /// Non-owning wrapper over db for the statements in statements_cache.
+    ///
+    /// Statements keep a reference to the database they belong to, so cached
+    /// statements need a database object that lives as long as the cache.
+    /// This is lazily initialized to avoid infinite recursion during
+    /// construction.
+    std::auto_ptr< database > cache_db;
+
+    /// Prepared statements indexed by their SQL text.
+    std::map< std::string, statement > statements_cache;
+
     /// Constructor.
     ///
     /// \param db_filename_ The path to the database as seen at construction
@@ -126,6 +140,9 @@ struct utils::sqlite::database::impl : utils::noncopyable {
     close(void)
     {
         PRE(db != NULL);
+        // Cached statements must be finalized before closing the database or
+        // else the close would fail with SQLITE_BUSY.
+        statements_cache.clear();
         int error = ::sqlite3_close(db);
         // For now, let's consider a return of SQLITE_BUSY an error.  We should
         // not be trying to close a busy database in our code.  Maybe revisit
@@ -287,6 +304,29 @@ sqlite::database::exec(const std::string& sql)
 }
 
 
+/// Copies the whole contents of the database into another one.
+///
+/// This uses the online backup API of SQLite, which copies the pages of the
+/// database in a single pass.  Any previous contents of the target database
+/// are replaced.
+///
+/// \param target The database into which to copy the contents.
+///
+/// \throw api_error If there is any problem while copying the contents.
+void
+sqlite::database::backup(database& target)
+{
+    ::sqlite3_backup* handle = ::sqlite3_backup_init(
+        target._pimpl->db, "main", _pimpl->db, "main");
+    if (handle == NULL)
+        throw api_error::from_database(target, "sqlite3_backup_init");
+    const int step_error = ::sqlite3_backup_step(handle, -1);
+    const int finish_error = ::sqlite3_backup_finish(handle);
+    if (step_error != SQLITE_DONE || finish_error != SQLITE_OK)
+        throw api_error::from_database(target, "sqlite3_backup_step");
+}
+
+
 /// Opens a new transaction.
 ///
 /// \return An object representing the state of the transaction.
@@ -318,6 +358,116 @@ sqlite::database::create_statement(const std::string& sql)
 }
 
 
+/// Prepares the next statement out of a string that may contain several.
+///
+/// This allows executing a script of statements one at a time so that each
+/// statement is prepared only after the previous ones have run and, thus, can
+/// refer to the objects they create.
+///
+/// \param sql The SQL statements to prepare.
+/// \param [in,out] offset Position within sql at which the next statement
+///     starts.  Updated to point past the prepared statement.
+///
+/// \return The prepared statement, or none if the rest of sql does not hold
+/// any statements but only whitespace or comments.
+///
+/// \throw api_error If the statement is invalid.
+optional< sqlite::statement >
+sqlite::database::create_next_statement(const std::string& sql,
+                                        std::string::size_type& offset)
+{
+    PRE(offset <= sql.length());
+    const char* start = sql.c_str() + offset;
+    sqlite3_stmt* stmt;
+    const char* tail;
+    const int error = ::sqlite3_prepare_v2(_pimpl->db, start,
+                                           sql.length() - offset + 1, &stmt,
+                                           &tail);
+    if (error != SQLITE_OK)
+        throw api_error::from_database(*this, "sqlite3_prepare_v2");
+    offset += tail - start;
+    if (stmt == NULL) {
+        offset = sql.length();
+        return none;
+    }
+    LD(F("Created statement: %s") % std::string(start, tail - start));
+    return utils::make_optional(statement(*this, static_cast< void* >(stmt)));
+}
+
+
+/// Gets a prepared statement from the cache, preparing it if necessary.
+///
+/// Use this instead of create_statement() for statements that are executed
+/// repeatedly to avoid parsing the same SQL over and over again.  The returned
+/// statement is reset and has its bindings cleared, so it is ready to be bound
+/// and executed as if it had just been prepared.
+///
+/// Because all callers share the same statement for a given SQL text, the
+/// caller must not request the same SQL again while it is still processing
+/// the results of a previous request; doing so resets the statement under its
+/// feet.  The statement is reset again once the caller drops the returned
+/// object and all of its copies, so callers need not step it to completion
+/// for it to release its locks on the database.
+///
+/// \param sql The SQL statement to prepare.
+///
+/// \return The prepared statement.
+///
+/// \throw api_error If the statement cannot be prepared.
+sqlite::statement
+sqlite::database::cached_statement(const std::string& sql)
+{
+    PRE(_pimpl->db != NULL);
+
+    std::map< std::string, statement >::iterator iter =
+        _pimpl->statements_cache.find(sql);
+    if (iter == _pimpl->statements_cache.end()) {
+        if (_pimpl->cache_db.get() == NULL)
+            _pimpl->cache_db.reset(new database(_pimpl->db_filename,
+                                                _pimpl->db, false));
+
+        LD(F("Caching statement: %s") % sql);
+        sqlite3_stmt* stmt;
+        const int error = ::sqlite3_prepare_v2(_pimpl->db, sql.c_str(),
+                                               sql.length() + 1, &stmt, NULL);
+        if (error != SQLITE_OK)
+            throw api_error::from_database(*this, "sqlite3_prepare_v2");
+        iter = _pimpl->statements_cache.insert(std::make_pair(
+            sql, statement(*_pimpl->cache_db, static_cast< void* >(stmt))))
+            .first;
+    }
+    return iter->second.lease();
+}
+
+
+/// Opens a BLOB for incremental I/O.
+///
+/// \param table The name of the table containing the BLOB.
+/// \param column The name of the column containing the BLOB.
+/// \param rowid The row identifier of the row containing the BLOB.
+/// \param writable Whether to open the BLOB for writing or only for reading.
+///
+/// \return The BLOB handle.
+///
+/// \throw api_error If the BLOB cannot be opened; e.g. if the row does not
+///     exist or if the cell does not hold a BLOB.
+sqlite::incremental_blob
+sqlite::database::open_blob(const std::string& table,
+                            const std::string& column,
+                            const int64_t rowid,
+                            const bool writable)
+{
+    LD(F("Opening BLOB: %s.%s in row %s") % table % column % rowid);
+    ::sqlite3_blob* blob;
+    const int error = ::sqlite3_blob_open(_pimpl->db, "main", table.c_str(),
+                                          column.c_str(), rowid,
+                                          writable ? 1 : 0, &blob);
+    if (error != SQLITE_OK)
+        throw api_error::from_database(*this, "sqlite3_blob_open");
+    return incremental_blob(*this, static_cast< void* >(blob));
+}
+
+
 /// Returns the row identifier of the last insert.
 ///
 /// \return A row identifier.
@@ -42,11 +42,13 @@ extern "C" {
 }
 
 #include <cstddef>
+#include <string>
 
 #include "utils/fs/path_fwd.hpp"
 #include "utils/optional_fwd.hpp"
 #include "utils/shared_ptr.hpp"
 #include "utils/sqlite/c_gate_fwd.hpp"
+#include "utils/sqlite/incremental_blob_fwd.hpp"
 #include "utils/sqlite/statement_fwd.hpp"
 #include "utils/sqlite/transaction_fwd.hpp"
 
@@ -97,9 +99,15 @@ public:
     const utils::optional< utils::fs::path >& db_filename(void) const;
 
     void exec(const std::string&);
+    void backup(database&);
 
     transaction begin_transaction(void);
     statement create_statement(const std::string&);
+    utils::optional< statement > create_next_statement(
+        const std::string&, std::string::size_type&);
+    statement cached_statement(const std::string&);
+    incremental_blob open_blob(const std::string&, const std::string&,
+                               const int64_t, const bool);
 
     int64_t last_insert_rowid(void);
 };
@@ -28,6 +28,8 @@
 
 #include "utils/sqlite/database.hpp"
 
+#include <memory>
+
 #include <atf-c++.hpp>
 
 #include "utils/fs/operations.hpp"
@@ -43,6 +45,47 @@ namespace sqlite = utils::sqlite;
 using utils::optional;
 
 
+namespace {
+
+
+/// Counts the number of prepared statements in a database.
+///
+/// \param db The database to query.
+///
+/// \return The number of statements that have not been finalized yet.
+static int
+count_statements(::sqlite3* db)
+{
+    int count = 0;
+    for (::sqlite3_stmt* stmt = ::sqlite3_next_stmt(db, NULL); stmt != NULL;
+         stmt = ::sqlite3_next_stmt(db, stmt))
+        ++count;
+    return count;
+}
+
+
+/// Counts the number of active prepared statements in a database.
+///
+/// \param db The database to query.
+///
+/// \return The number of statements that have been stepped but have not been
+/// run to completion nor reset yet.
+static int
+count_busy_statements(::sqlite3* db)
+{
+    int count = 0;
+    for (::sqlite3_stmt* stmt = ::sqlite3_next_stmt(db, NULL); stmt != NULL;
+         stmt = ::sqlite3_next_stmt(db, stmt)) {
+        if (::sqlite3_stmt_busy(stmt))
+            ++count;
+    }
+    return count;
+}
+
+
+}  // anonymous namespace
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(in_memory);
 ATF_TEST_CASE_BODY(in_memory)
 {
@@ -224,6 +267,83 @@ ATF_TEST_CASE_BODY(create_statement__ok)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(create_next_statement__several);
+ATF_TEST_CASE_BODY(create_next_statement__several)
+{
+    sqlite::database db = sqlite::database::in_memory();
+    const std::string script =
+        "CREATE TABLE test (a INTEGER);\n"
+        "INSERT INTO test VALUES (5);  -- Comment.\n"
+        "SELECT a FROM test;\n"
+        "-- Trailing comment.\n";
+
+    std::string::size_type offset = 0;
+    optional< sqlite::statement > stmt = db.create_next_statement(script,
+                                                                  offset);
+    ATF_REQUIRE(stmt);
+    ATF_REQUIRE(!stmt.get().step());
+    stmt = db.create_next_statement(script, offset);
+    ATF_REQUIRE(stmt);
+    ATF_REQUIRE(!stmt.get().step());
+    stmt = db.create_next_statement(script, offset);
+    ATF_REQUIRE(stmt);
+    ATF_REQUIRE(stmt.get().step());
+    ATF_REQUIRE_EQ(5, stmt.get().column_int(0));
+    ATF_REQUIRE(!stmt.get().step());
+
+    ATF_REQUIRE(!db.create_next_statement(script, offset));
+    ATF_REQUIRE_EQ(script.length(), offset);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(create_next_statement__fail);
+ATF_TEST_CASE_BODY(create_next_statement__fail)
+{
+    sqlite::database db = sqlite::database::in_memory();
+    const std::string script = "SELECT 1; SELECT * FROM missing";
+    std::string::size_type offset = 0;
+    ATF_REQUIRE(db.create_next_statement(script, offset));
+    REQUIRE_API_ERROR("sqlite3_prepare_v2",
+                      db.create_next_statement(script, offset));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(backup__ok);
+ATF_TEST_CASE_BODY(backup__ok)
+{
+    sqlite::database db = sqlite::database::in_memory();
+    db.exec(create_test_table_sql);
+
+    {
+        sqlite::database target = sqlite::database::open(
+            fs::path("test.db"), sqlite::open_readwrite | sqlite::open_create);
+        target.exec("CREATE TABLE other (col INTEGER PRIMARY KEY)");
+        db.backup(target);
+        target.close();
+    }
+
+    sqlite::database target = sqlite::database::open(
+        fs::path("test.db"), sqlite::open_readonly);
+    verify_test_table(raw(target));
+    REQUIRE_API_ERROR("sqlite3_exec", target.exec("SELECT * FROM other"));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(backup__fail);
+ATF_TEST_CASE_BODY(backup__fail)
+{
+    sqlite::database::open(fs::path("test.db"),
+                           sqlite::open_readwrite | sqlite::open_create)
+        .close();
+
+    sqlite::database db = sqlite::database::in_memory();
+    db.exec(create_test_table_sql);
+    sqlite::database target = sqlite::database::open(
+        fs::path("test.db"), sqlite::open_readonly);
+    REQUIRE_API_ERROR("sqlite3_backup_step", db.backup(target));
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(begin_transaction);
 ATF_TEST_CASE_BODY(begin_transaction)
 {
@@ -243,6 +363,129 @@ ATF_TEST_CASE_BODY(create_statement__fail)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(cached_statement__reuse);
+ATF_TEST_CASE_BODY(cached_statement__reuse)
+{
+    sqlite::database db = sqlite::database::in_memory();
+
+    {
+        sqlite::statement stmt = db.cached_statement("SELECT :value");
+        stmt.bind(":value", 5);
+        ATF_REQUIRE(stmt.step());
+        ATF_REQUIRE_EQ(5, stmt.column_int(0));
+    }
+    ATF_REQUIRE_EQ(1, count_statements(raw(db)));
+
+    // The statement was left in the middle of its execution and with a value
+    // bound; make sure we get it back clean.
+    sqlite::statement stmt = db.cached_statement("SELECT :value");
+    ATF_REQUIRE_EQ(1, count_statements(raw(db)));
+    ATF_REQUIRE(stmt.step());
+    ATF_REQUIRE(stmt.column_type(0) == sqlite::type_null);
+    ATF_REQUIRE(!stmt.step());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(cached_statement__reset_on_release);
+ATF_TEST_CASE_BODY(cached_statement__reset_on_release)
+{
+    sqlite::database db = sqlite::database::in_memory();
+    db.exec("CREATE TABLE test (a INTEGER NOT NULL)");
+    db.exec("INSERT INTO test VALUES (1)");
+    db.exec("INSERT INTO test VALUES (2)");
+
+    {
+        sqlite::statement stmt = db.cached_statement("SELECT a FROM test");
+        ATF_REQUIRE(stmt.step());
+        {
+            sqlite::statement copy = stmt;
+        }
+        ATF_REQUIRE_EQ(1, count_busy_statements(raw(db)));
+    }
+    ATF_REQUIRE_EQ(1, count_statements(raw(db)));
+    ATF_REQUIRE_EQ(0, count_busy_statements(raw(db)));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(cached_statement__stale_release);
+ATF_TEST_CASE_BODY(cached_statement__stale_release)
+{
+    sqlite::database db = sqlite::database::in_memory();
+    db.exec("CREATE TABLE test (a INTEGER NOT NULL)");
+    db.exec("INSERT INTO test VALUES (1)");
+    db.exec("INSERT INTO test VALUES (2)");
+
+    std::auto_ptr< sqlite::statement > old(new sqlite::statement(
+        db.cached_statement("SELECT a FROM test")));
+    sqlite::statement stmt = db.cached_statement("SELECT a FROM test");
+    ATF_REQUIRE(stmt.step());
+    ATF_REQUIRE_EQ(1, stmt.column_int(0));
+
+    // Releasing an older lease must not reset the statement under the feet
+    // of its current holder.
+    old.reset();
+    ATF_REQUIRE(stmt.step());
+    ATF_REQUIRE_EQ(2, stmt.column_int(0));
+    ATF_REQUIRE(!stmt.step());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(cached_statement__keyed_by_sql);
+ATF_TEST_CASE_BODY(cached_statement__keyed_by_sql)
+{
+    sqlite::database db = sqlite::database::in_memory();
+    db.cached_statement("SELECT 1");
+    db.cached_statement("SELECT 2");
+    db.cached_statement("SELECT 1");
+    ATF_REQUIRE_EQ(2, count_statements(raw(db)));
+
+    sqlite::statement stmt = db.cached_statement("SELECT 2");
+    ATF_REQUIRE(stmt.step());
+    ATF_REQUIRE_EQ(2, stmt.column_int(0));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(cached_statement__outlives_copy);
+ATF_TEST_CASE_BODY(cached_statement__outlives_copy)
+{
+    sqlite::database db = sqlite::database::in_memory();
+    db.exec("CREATE TABLE test (a INTEGER NOT NULL)");
+    {
+        sqlite::database db2 = db;
+        db2.cached_statement("INSERT INTO test VALUES (:value)");
+    }
+
+    // Errors are reported against the database of the statement, which must
+    // still be valid even if the object used to create the statement is gone.
+    sqlite::statement stmt = db.cached_statement(
+        "INSERT INTO test VALUES (:value)");
+    ATF_REQUIRE_EQ(1, count_statements(raw(db)));
+    REQUIRE_API_ERROR("sqlite3_step", stmt.step());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(cached_statement__fail);
+ATF_TEST_CASE_BODY(cached_statement__fail)
+{
+    sqlite::database db = sqlite::database::in_memory();
+    REQUIRE_API_ERROR("sqlite3_prepare_v2",
+                      db.cached_statement("SELECT * FROM missing"));
+    ATF_REQUIRE_EQ(0, count_statements(raw(db)));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(cached_statement__close);
+ATF_TEST_CASE_BODY(cached_statement__close)
+{
+    sqlite::database db = sqlite::database::in_memory();
+    {
+        sqlite::statement stmt = db.cached_statement("SELECT 3");
+        ATF_REQUIRE(stmt.step());
+    }
+    db.close();
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(last_insert_rowid);
 ATF_TEST_CASE_BODY(last_insert_rowid)
 {
@@ -278,10 +521,23 @@ ATF_INIT_TEST_CASES(tcs)
     ATF_ADD_TEST_CASE(tcs, exec__ok);
     ATF_ADD_TEST_CASE(tcs, exec__fail);
 
+    ATF_ADD_TEST_CASE(tcs, backup__ok);
+    ATF_ADD_TEST_CASE(tcs, backup__fail);
+
     ATF_ADD_TEST_CASE(tcs, begin_transaction);
 
     ATF_ADD_TEST_CASE(tcs, create_statement__ok);
     ATF_ADD_TEST_CASE(tcs, create_statement__fail);
+    ATF_ADD_TEST_CASE(tcs, create_next_statement__several);
+    ATF_ADD_TEST_CASE(tcs, create_next_statement__fail);
+
+    ATF_ADD_TEST_CASE(tcs, cached_statement__reuse);
+    ATF_ADD_TEST_CASE(tcs, cached_statement__reset_on_release);
+    ATF_ADD_TEST_CASE(tcs, cached_statement__stale_release);
+    ATF_ADD_TEST_CASE(tcs, cached_statement__keyed_by_sql);
+    ATF_ADD_TEST_CASE(tcs, cached_statement__outlives_copy);
+    ATF_ADD_TEST_CASE(tcs, cached_statement__fail);
+    ATF_ADD_TEST_CASE(tcs, cached_statement__close);
 
     ATF_ADD_TEST_CASE(tcs, last_insert_rowid);
 }
@@ -0,0 +1,170 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "utils/sqlite/incremental_blob.hpp"
+
+extern "C" {
+#include <sqlite3.h>
+}
+
+#include "utils/format/macros.hpp"
+#include "utils/logging/macros.hpp"
+#include "utils/noncopyable.hpp"
+#include "utils/sanity.hpp"
+#include "utils/sqlite/c_gate.hpp"
+#include "utils/sqlite/database.hpp"
+#include "utils/sqlite/exceptions.hpp"
+
+namespace sqlite = utils::sqlite;
+
+
+/// Internal implementation for sqlite::incremental_blob.
+struct utils::sqlite::incremental_blob::impl : utils::noncopyable {
+    /// The database this BLOB belongs to.
+    sqlite::database& db;
+
+    /// The SQLite 3 internal BLOB handle; NULL once closed.
+    ::sqlite3_blob* blob;
+
+    /// Constructor.
+    ///
+    /// \param db_ The database this BLOB belongs to.  As with statements, we
+    ///     keep a reference to the database, so the database must outlive
+    ///     this object.
+    /// \param blob_ The SQLite internal BLOB handle.
+    impl(database& db_, ::sqlite3_blob* blob_) :
+        db(db_),
+        blob(blob_)
+    {
+    }
+
+    /// Destructor.
+    ~impl(void)
+    {
+        if (blob != NULL) {
+            if (::sqlite3_blob_close(blob) != SQLITE_OK)
+                LW(F("Error while closing a BLOB handle: %s") %
+                   ::sqlite3_errmsg(database_c_gate(db).c_database()));
+        }
+    }
+
+    /// Releases the BLOB handle.
+    ///
+    /// \throw api_error If closing the handle reports an error.
+    void
+    close(void)
+    {
+        PRE(blob != NULL);
+        const int error = ::sqlite3_blob_close(blob);
+        blob = NULL;
+        if (error != SQLITE_OK)
+            throw sqlite::api_error::from_database(db, "sqlite3_blob_close");
+    }
+};
+
+
+/// Initializes a BLOB handle.
+///
+/// \param db The database this BLOB belongs to.
+/// \param raw_blob A void pointer representing a SQLite native BLOB handle.
+sqlite::incremental_blob::incremental_blob(database& db, void* raw_blob) :
+    _pimpl(new impl(db, static_cast< ::sqlite3_blob* >(raw_blob)))
+{
+}
+
+
+/// Destructor for the BLOB handle.
+///
+/// Remember that incremental_blob is reference-counted, so the actual handle
+/// is only released when all references are destroyed.  Errors during the
+/// release are only logged; call close() explicitly to detect them.
+sqlite::incremental_blob::~incremental_blob(void)
+{
+}
+
+
+/// Closes the BLOB handle.
+///
+/// \throw api_error If closing the handle fails.
+void
+sqlite::incremental_blob::close(void)
+{
+    _pimpl->close();
+}
+
+
+/// Returns the size of the BLOB.
+///
+/// \return The size of the BLOB in bytes.
+int
+sqlite::incremental_blob::size(void)
+{
+    PRE(_pimpl->blob != NULL);
+    return ::sqlite3_blob_bytes(_pimpl->blob);
+}
+
+
+/// Reads a chunk of the BLOB.
+///
+/// \param offset The offset within the BLOB from which to start reading.
+/// \param buffer The buffer into which to store the data.
+/// \param length The number of bytes to read.  offset + length must not exceed
+///     the size of the BLOB.
+///
+/// \throw api_error If the read fails.
+void
+sqlite::incremental_blob::read(const int offset, void* buffer,
+                               const int length)
+{
+    PRE(_pimpl->blob != NULL);
+    const int error = ::sqlite3_blob_read(_pimpl->blob, buffer, length,
+                                          offset);
+    if (error != SQLITE_OK)
+        throw api_error::from_database(_pimpl->db, "sqlite3_blob_read");
+}
+
+
+/// Writes a chunk of the BLOB.
+///
+/// \param offset The offset within the BLOB at which to start writing.
+/// \param buffer The data to write.
+/// \param length The number of bytes to write.  offset + length must not
+///     exceed the size of the BLOB.
+///
+/// \throw api_error If the write fails, including if the BLOB was opened in
+///     read-only mode.
+void
+sqlite::incremental_blob::write(const int offset, const void* buffer,
+                                const int length)
+{
+    PRE(_pimpl->blob != NULL);
+    const int error = ::sqlite3_blob_write(_pimpl->blob, buffer, length,
+                                           offset);
+    if (error != SQLITE_OK)
+        throw api_error::from_database(_pimpl->db, "sqlite3_blob_write");
+}
@@ -0,0 +1,74 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// \file utils/sqlite/incremental_blob.hpp
+/// A RAII model for SQLite incremental BLOB I/O handles.
+
+#if !defined(UTILS_SQLITE_INCREMENTAL_BLOB_HPP)
+#define UTILS_SQLITE_INCREMENTAL_BLOB_HPP
+
+#include "utils/sqlite/incremental_blob_fwd.hpp"
+
+#include "utils/shared_ptr.hpp"
+#include "utils/sqlite/database_fwd.hpp"
+
+namespace utils {
+namespace sqlite {
+
+
+/// A RAII model for an open BLOB in a SQLite 3 database.
+///
+/// Incremental BLOB I/O allows reading and writing the contents of a BLOB in
+/// chunks, which permits processing BLOBs of arbitrary size with bounded
+/// memory.  The size of a BLOB cannot be changed through this interface: to
+/// write a new BLOB, first insert a sqlite::zeroblob of the desired size and
+/// then open it for writing.
+class incremental_blob {
+    struct impl;
+
+    /// Pointer to the shared internal implementation.
+    std::shared_ptr< impl > _pimpl;
+
+    incremental_blob(database&, void*);
+    friend class database;
+
+public:
+    ~incremental_blob(void);
+
+    void close(void);
+
+    int size(void);
+    void read(const int, void*, const int);
+    void write(const int, const void*, const int);
+};
+
+
+}  // namespace sqlite
+}  // namespace utils
+
+#endif  // !defined(UTILS_SQLITE_INCREMENTAL_BLOB_HPP)
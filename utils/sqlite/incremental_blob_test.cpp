@@ -0,0 +1,141 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "utils/sqlite/incremental_blob.hpp"
+
+#include <cstring>
+#include <string>
+
+#include <atf-c++.hpp>
+
+#include "utils/sqlite/database.hpp"
+#include "utils/sqlite/statement.ipp"
+#include "utils/sqlite/test_utils.hpp"
+
+namespace sqlite = utils::sqlite;
+
+
+namespace {
+
+
+/// Creates a table with a single zero-filled BLOB.
+///
+/// \param db The database in which to create the table.
+/// \param size The size of the BLOB to create.
+///
+/// \return The row identifier of the BLOB.
+static int64_t
+create_zeroblob(sqlite::database& db, const int size)
+{
+    db.exec("CREATE TABLE test (contents BLOB)");
+    sqlite::statement stmt = db.create_statement(
+        "INSERT INTO test (contents) VALUES (:contents)");
+    stmt.bind(":contents", sqlite::zeroblob(size));
+    stmt.step_without_results();
+    return db.last_insert_rowid();
+}
+
+
+}  // anonymous namespace
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(write_and_read);
+ATF_TEST_CASE_BODY(write_and_read)
+{
+    sqlite::database db = sqlite::database::in_memory();
+    const int64_t rowid = create_zeroblob(db, 10);
+
+    {
+        sqlite::incremental_blob blob = db.open_blob("test", "contents", rowid,
+                                                     true);
+        ATF_REQUIRE_EQ(10, blob.size());
+        blob.write(0, "abcd", 4);
+        blob.write(4, "efghij", 6);
+        blob.close();
+    }
+
+    sqlite::incremental_blob blob = db.open_blob("test", "contents", rowid,
+                                                 false);
+    ATF_REQUIRE_EQ(10, blob.size());
+    char buffer[6];
+    blob.read(2, buffer, 5);
+    buffer[5] = '\0';
+    ATF_REQUIRE_EQ(std::string("cdefg"), buffer);
+
+    sqlite::statement stmt = db.create_statement("SELECT contents FROM test");
+    ATF_REQUIRE(stmt.step());
+    const sqlite::blob contents = stmt.column_blob(0);
+    ATF_REQUIRE_EQ(10, contents.size);
+    ATF_REQUIRE(std::memcmp("abcdefghij", contents.memory, 10) == 0);
+    ATF_REQUIRE(!stmt.step());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(open__missing_row);
+ATF_TEST_CASE_BODY(open__missing_row)
+{
+    sqlite::database db = sqlite::database::in_memory();
+    const int64_t rowid = create_zeroblob(db, 10);
+
+    REQUIRE_API_ERROR("sqlite3_blob_open",
+                      db.open_blob("test", "contents", rowid + 1, false));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(read__out_of_range);
+ATF_TEST_CASE_BODY(read__out_of_range)
+{
+    sqlite::database db = sqlite::database::in_memory();
+    const int64_t rowid = create_zeroblob(db, 10);
+
+    sqlite::incremental_blob blob = db.open_blob("test", "contents", rowid,
+                                                 false);
+    char buffer[4];
+    REQUIRE_API_ERROR("sqlite3_blob_read", blob.read(8, buffer, 4));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(write__read_only);
+ATF_TEST_CASE_BODY(write__read_only)
+{
+    sqlite::database db = sqlite::database::in_memory();
+    const int64_t rowid = create_zeroblob(db, 10);
+
+    sqlite::incremental_blob blob = db.open_blob("test", "contents", rowid,
+                                                 false);
+    REQUIRE_API_ERROR("sqlite3_blob_write", blob.write(0, "abcd", 4));
+}
+
+
+ATF_INIT_TEST_CASES(tcs)
+{
+    ATF_ADD_TEST_CASE(tcs, write_and_read);
+    ATF_ADD_TEST_CASE(tcs, open__missing_row);
+    ATF_ADD_TEST_CASE(tcs, read__out_of_range);
+    ATF_ADD_TEST_CASE(tcs, write__read_only);
+}
@@ -111,6 +111,44 @@ struct utils::sqlite::statement::impl : utils::noncopyable {
     /// Cache for the column names in a statement; lazily initialized.
     std::map< std::string, int > column_cache;
 
+    /// Identifier of the latest lease of this statement; see lease().
+    unsigned long lease_id;
+
+    /// Deleter of leased statements that resets them when they are released.
+    class releaser {
+        /// The leased statement, kept alive until the lease is released.
+        std::shared_ptr< impl > _pimpl;
+
+        /// Identifier of the lease.
+        unsigned long _lease_id;
+
+    public:
+        /// Constructor.
+        ///
+        /// \param pimpl_ The leased statement.
+        /// \param lease_id_ Identifier of the lease.
+        releaser(const std::shared_ptr< impl >& pimpl_,
+                 const unsigned long lease_id_) :
+            _pimpl(pimpl_), _lease_id(lease_id_)
+        {
+        }
+
+        /// Resets the statement unless it has been leased again since.
+        ///
+        /// Statements that have not been stepped to completion nor reset keep
+        /// the database locked, which would block other connections until the
+        /// statement is leased again.
+        void
+        operator()(impl* UTILS_UNUSED_PARAM(pimpl))
+        {
+            if (_pimpl->lease_id == _lease_id) {
+                (void)::sqlite3_reset(_pimpl->stmt);
+                (void)::sqlite3_clear_bindings(_pimpl->stmt);
+            }
+            _pimpl.reset();
+        }
+    };
+
     /// Constructor.
     ///
     /// \param db_ The database this statement belongs to.  Be aware that we
@@ -121,7 +159,8 @@ struct utils::sqlite::statement::impl : utils::noncopyable {
     /// \param stmt_ The SQLite internal statement.
     impl(database& db_, ::sqlite3_stmt* stmt_) :
         db(db_),
-        stmt(stmt_)
+        stmt(stmt_),
+        lease_id(0)
     {
     }
 
@@ -154,6 +193,37 @@ sqlite::statement::statement(database& db, void* raw_stmt) :
 }
 
 
+/// Initializes a statement object that shares an existing implementation.
+///
+/// This is an internal function used by lease().
+///
+/// \param pimpl The implementation to share.
+sqlite::statement::statement(const std::shared_ptr< impl >& pimpl) :
+    _pimpl(pimpl)
+{
+}
+
+
+/// Hands out this statement to a caller of database::cached_statement().
+///
+/// The statement is reset and has its bindings cleared now, in case a previous
+/// lease was not released, and again once the last copy of the returned object
+/// is destroyed.  The latter keeps statements that were not stepped to
+/// completion from holding their locks on the database while they sit in the
+/// cache.
+///
+/// \return A new reference to this statement.
+sqlite::statement
+sqlite::statement::lease(void)
+{
+    ++_pimpl->lease_id;
+    (void)::sqlite3_reset(_pimpl->stmt);
+    (void)::sqlite3_clear_bindings(_pimpl->stmt);
+    return statement(std::shared_ptr< impl >(
+        _pimpl.get(), impl::releaser(_pimpl, _pimpl->lease_id)));
+}
+
+
 /// Destructor for the statement.
 ///
 /// Remember that statements are reference-counted, so the statement will only
@@ -474,6 +544,106 @@ sqlite::statement::safe_column_bytes(const char* name)
 }
 
 
+/// Type-checked version of column_blob for a typed column.
+///
+/// \param column The column to retrieve.
+///
+/// \return The same as column_blob if the value can be retrieved.
+///
+/// \throw error If the type of the cell does not match the column.
+sqlite::blob
+sqlite::statement::safe_column(const sqlite::column< blob >& column)
+{
+    PRE_MSG(column_name(column.index) == column.name,
+            F("Column index %s does not match its name") % column.index);
+    const int index = column.index;
+    if (column_type(index) != sqlite::type_blob)
+        throw sqlite::error(_pimpl->db.db_filename(),
+                            F("Column '%s' is not a blob") % column.name);
+    return column_blob(index);
+}
+
+
+/// Type-checked version of column_double for a typed column.
+///
+/// \param column The column to retrieve.
+///
+/// \return The same as column_double if the value can be retrieved.
+///
+/// \throw error If the type of the cell does not match the column.
+double
+sqlite::statement::safe_column(const sqlite::column< double >& column)
+{
+    PRE_MSG(column_name(column.index) == column.name,
+            F("Column index %s does not match its name") % column.index);
+    const int index = column.index;
+    if (column_type(index) != sqlite::type_float)
+        throw sqlite::error(_pimpl->db.db_filename(),
+                            F("Column '%s' is not a float") % column.name);
+    return column_double(index);
+}
+
+
+/// Type-checked version of column_int for a typed column.
+///
+/// \param column The column to retrieve.
+///
+/// \return The same as column_int if the value can be retrieved.
+///
+/// \throw error If the type of the cell does not match the column.
+int
+sqlite::statement::safe_column(const sqlite::column< int >& column)
+{
+    PRE_MSG(column_name(column.index) == column.name,
+            F("Column index %s does not match its name") % column.index);
+    const int index = column.index;
+    if (column_type(index) != sqlite::type_integer)
+        throw sqlite::error(_pimpl->db.db_filename(),
+                            F("Column '%s' is not an integer") % column.name);
+    return column_int(index);
+}
+
+
+/// Type-checked version of column_int64 for a typed column.
+///
+/// \param column The column to retrieve.
+///
+/// \return The same as column_int64 if the value can be retrieved.
+///
+/// \throw error If the type of the cell does not match the column.
+int64_t
+sqlite::statement::safe_column(const sqlite::column< int64_t >& column)
+{
+    PRE_MSG(column_name(column.index) == column.name,
+            F("Column index %s does not match its name") % column.index);
+    const int index = column.index;
+    if (column_type(index) != sqlite::type_integer)
+        throw sqlite::error(_pimpl->db.db_filename(),
+                            F("Column '%s' is not an integer") % column.name);
+    return column_int64(index);
+}
+
+
+/// Type-checked version of column_text for a typed column.
+///
+/// \param column The column to retrieve.
+///
+/// \return The same as column_text if the value can be retrieved.
+///
+/// \throw error If the type of the cell does not match the column.
+std::string
+sqlite::statement::safe_column(const sqlite::column< std::string >& column)
+{
+    PRE_MSG(column_name(column.index) == column.name,
+            F("Column index %s does not match its name") % column.index);
+    const int index = column.index;
+    if (column_type(index) != sqlite::type_text)
+        throw sqlite::error(_pimpl->db.db_filename(),
+                            F("Column '%s' is not a string") % column.name);
+    return column_text(index);
+}
+
+
 /// Resets a statement to allow further processing.
 void
 sqlite::statement::reset(void)
@@ -574,6 +744,20 @@ sqlite::statement::bind(const int index, const std::string& text)
 }
 
 
+/// Binds a zero-filled BLOB to a prepared statement.
+///
+/// \param index The index of the binding.
+/// \param b The description of the zero-filled BLOB; only its size matters.
+///
+/// \throw api_error If the binding fails.
+void
+sqlite::statement::bind(const int index, const zeroblob& b)
+{
+    const int error = ::sqlite3_bind_zeroblob(_pimpl->stmt, index, b.size);
+    handle_bind_error(_pimpl->db, "sqlite3_bind_zeroblob", error);
+}
+
+
 /// Returns the index of the highest parameter.
 ///
 /// \return A parameter index.
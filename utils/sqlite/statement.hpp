@@ -78,6 +78,67 @@ class null {
 };
 
 
+/// Representation of a BLOB of a given size filled with zeros.
+///
+/// Binding one of these reserves space for a BLOB without having to allocate
+/// its contents in memory, which can later be filled using incremental BLOB
+/// I/O.  See database::open_blob().
+class zeroblob {
+public:
+    /// Size of the BLOB in bytes.
+    int size;
+
+    /// Constructs a new zero-filled blob.
+    ///
+    /// \param size_ The size of the blob.
+    explicit zeroblob(const int size_) :
+        size(size_)
+    {
+    }
+};
+
+
+/// A parameter of a prepared statement with a known position and type.
+///
+/// Statements run in tight loops declare their parameters as constants of this
+/// type next to their SQL.  Binding a value through one of these skips the
+/// lookup of the parameter by name, and binding a value of a different type
+/// does not compile.
+template< typename T >
+struct parameter {
+    /// Type of the values bound to the parameter.
+    typedef T value_type;
+
+    /// Position of the parameter in the statement, starting at 1.
+    ///
+    /// Named parameters are numbered in the order in which they first appear
+    /// in the SQL.
+    int index;
+
+    /// Name of the parameter, including its prefix.
+    ///
+    /// Debug builds check it against the statement to catch stale indexes.
+    const char* name;
+};
+
+
+/// A column of the results of a statement with a known position and type.
+///
+/// This is the counterpart of parameter for the columns read from every row
+/// of a query: reading a cell through one of these skips the lookup of the
+/// column by name, and the type of the returned value is fixed by the column.
+template< typename T >
+struct column {
+    /// Position of the column in the results, starting at 0.
+    int index;
+
+    /// Name of the column, used in errors.
+    ///
+    /// Debug builds check it against the statement to catch stale indexes.
+    const char* name;
+};
+
+
 /// A RAII model for an SQLite 3 statement.
 class statement {
     struct impl;
@@ -86,6 +147,8 @@ class statement {
     std::shared_ptr< impl > _pimpl;
 
     statement(database&, void*);
+    explicit statement(const std::shared_ptr< impl >&);
+    statement lease(void);
     friend class database;
 
 public:
@@ -113,6 +176,12 @@ public:
     std::string safe_column_text(const char*);
     int safe_column_bytes(const char*);
 
+    blob safe_column(const column< blob >&);
+    double safe_column(const column< double >&);
+    int safe_column(const column< int >&);
+    int64_t safe_column(const column< int64_t >&);
+    std::string safe_column(const column< std::string >&);
+
     void reset(void);
 
     void bind(const int, const blob&);
@@ -121,7 +190,11 @@ public:
     void bind(const int, const int64_t);
     void bind(const int, const null&);
     void bind(const int, const std::string&);
+    void bind(const int, const zeroblob&);
     template< class T > void bind(const char*, const T&);
+    template< class T > void bind(const parameter< T >&,
+                                  const typename parameter< T >::value_type&);
+    template< class T > void bind(const parameter< T >&, const null&);
 
     int bind_parameter_count(void);
     int bind_parameter_index(const std::string&);
@@ -31,6 +31,8 @@
 
 #include "utils/sqlite/statement.hpp"
 
+#include "utils/sanity.hpp"
+
 
 /// Binds a value to a parameter of a prepared statement.
 ///
@@ -49,4 +51,39 @@ utils::sqlite::statement::bind(const char* parameter, const T& value)
 }
 
 
+/// Binds a value to a parameter of a prepared statement by its position.
+///
+/// \param parameter The parameter; must exist at the given position.
+/// \param value The value to bind to the parameter.
+///
+/// \throw api_error If the binding fails.
+template< class T >
+void
+utils::sqlite::statement::bind(
+    const parameter< T >& parameter,
+    const typename sqlite::parameter< T >::value_type& value)
+{
+    PRE_MSG(bind_parameter_name(parameter.index) == parameter.name,
+            "Parameter index does not match its name");
+    bind(parameter.index, value);
+}
+
+
+/// Binds NULL to a parameter of a prepared statement by its position.
+///
+/// \param parameter The parameter; must exist at the given position.
+/// \param value The NULL value.
+///
+/// \throw api_error If the binding fails.
+template< class T >
+void
+utils::sqlite::statement::bind(const parameter< T >& parameter,
+                               const null& value)
+{
+    PRE_MSG(bind_parameter_name(parameter.index) == parameter.name,
+            "Parameter index does not match its name");
+    bind(parameter.index, value);
+}
+
+
 #endif  // !defined(UTILS_SQLITE_STATEMENT_IPP)
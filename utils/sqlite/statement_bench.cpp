@@ -0,0 +1,209 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// \file utils/sqlite/statement_bench.cpp
+/// Benchmarks for the hot paths of sqlite::statement.
+
+#include "utils/sqlite/statement.ipp"
+
+extern "C" {
+#include <stdint.h>
+}
+
+#include <cstddef>
+#include <string>
+
+#include <atf-c++.hpp>
+
+#include "utils/datetime.hpp"
+#include "utils/sqlite/database.hpp"
+#include "utils/test_utils.ipp"
+
+namespace datetime = utils::datetime;
+namespace sqlite = utils::sqlite;
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(insert__bind_step);
+ATF_TEST_CASE_BODY(insert__bind_step)
+{
+    utils::require_run_benchmarks(this);
+    const std::size_t iterations = utils::benchmark_iterations(this, 100000);
+
+    sqlite::database db = sqlite::database::in_memory();
+    db.exec("CREATE TABLE t (a INTEGER PRIMARY KEY, b TEXT)");
+    db.exec("BEGIN TRANSACTION");
+    sqlite::statement stmt = db.create_statement(
+        "INSERT INTO t (a, b) VALUES (:a, :b)");
+
+    const datetime::timestamp start = datetime::timestamp::now();
+    for (std::size_t i = 0; i < iterations; ++i) {
+        stmt.bind(":a", static_cast< int64_t >(i));
+        stmt.bind(":b", "some text");
+        stmt.step_without_results();
+        stmt.reset();
+    }
+    utils::report_benchmark(this, iterations,
+                            datetime::timestamp::now() - start);
+
+    db.exec("COMMIT");
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(insert__typed_bind_step);
+ATF_TEST_CASE_BODY(insert__typed_bind_step)
+{
+    utils::require_run_benchmarks(this);
+    const std::size_t iterations = utils::benchmark_iterations(this, 100000);
+
+    sqlite::database db = sqlite::database::in_memory();
+    db.exec("CREATE TABLE t (a INTEGER PRIMARY KEY, b TEXT)");
+    db.exec("BEGIN TRANSACTION");
+    sqlite::statement stmt = db.create_statement(
+        "INSERT INTO t (a, b) VALUES (:a, :b)");
+    const sqlite::parameter< int64_t > a = { 1, ":a" };
+    const sqlite::parameter< std::string > b = { 2, ":b" };
+    const std::string text = "some text";
+
+    const datetime::timestamp start = datetime::timestamp::now();
+    for (std::size_t i = 0; i < iterations; ++i) {
+        stmt.bind(a, static_cast< int64_t >(i));
+        stmt.bind(b, text);
+        stmt.step_without_results();
+        stmt.reset();
+    }
+    utils::report_benchmark(this, iterations,
+                            datetime::timestamp::now() - start);
+
+    db.exec("COMMIT");
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(insert__cached_statement);
+ATF_TEST_CASE_BODY(insert__cached_statement)
+{
+    utils::require_run_benchmarks(this);
+    const std::size_t iterations = utils::benchmark_iterations(this, 100000);
+
+    sqlite::database db = sqlite::database::in_memory();
+    db.exec("CREATE TABLE t (a INTEGER PRIMARY KEY, b TEXT)");
+    db.exec("BEGIN TRANSACTION");
+
+    const datetime::timestamp start = datetime::timestamp::now();
+    for (std::size_t i = 0; i < iterations; ++i) {
+        sqlite::statement stmt = db.cached_statement(
+            "INSERT INTO t (a, b) VALUES (:a, :b)");
+        stmt.bind(":a", static_cast< int64_t >(i));
+        stmt.bind(":b", "some text");
+        stmt.step_without_results();
+    }
+    utils::report_benchmark(this, iterations,
+                            datetime::timestamp::now() - start);
+
+    db.exec("COMMIT");
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(select__step);
+ATF_TEST_CASE_BODY(select__step)
+{
+    utils::require_run_benchmarks(this);
+    const std::size_t iterations = utils::benchmark_iterations(this, 100000);
+
+    sqlite::database db = sqlite::database::in_memory();
+    db.exec("CREATE TABLE t (a INTEGER PRIMARY KEY, b TEXT)");
+    db.exec("BEGIN TRANSACTION");
+    {
+        sqlite::statement stmt = db.create_statement(
+            "INSERT INTO t (a, b) VALUES (:a, 'some text')");
+        for (std::size_t i = 0; i < iterations; ++i) {
+            stmt.bind(":a", static_cast< int64_t >(i));
+            stmt.step_without_results();
+            stmt.reset();
+        }
+    }
+    db.exec("COMMIT");
+
+    sqlite::statement stmt = db.create_statement("SELECT a, b FROM t");
+    std::size_t rows = 0;
+    std::size_t bytes = 0;
+    const datetime::timestamp start = datetime::timestamp::now();
+    while (stmt.step()) {
+        bytes += stmt.safe_column_text("b").length();
+        ++rows;
+    }
+    utils::report_benchmark(this, rows, datetime::timestamp::now() - start);
+
+    ATF_REQUIRE_EQ(iterations, rows);
+    ATF_REQUIRE_EQ(iterations * 9, bytes);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(select__typed_step);
+ATF_TEST_CASE_BODY(select__typed_step)
+{
+    utils::require_run_benchmarks(this);
+    const std::size_t iterations = utils::benchmark_iterations(this, 100000);
+
+    sqlite::database db = sqlite::database::in_memory();
+    db.exec("CREATE TABLE t (a INTEGER PRIMARY KEY, b TEXT)");
+    db.exec("BEGIN TRANSACTION");
+    {
+        sqlite::statement stmt = db.create_statement(
+            "INSERT INTO t (a, b) VALUES (:a, 'some text')");
+        for (std::size_t i = 0; i < iterations; ++i) {
+            stmt.bind(":a", static_cast< int64_t >(i));
+            stmt.step_without_results();
+            stmt.reset();
+        }
+    }
+    db.exec("COMMIT");
+
+    sqlite::statement stmt = db.create_statement("SELECT a, b FROM t");
+    const sqlite::column< std::string > b = { 1, "b" };
+    std::size_t rows = 0;
+    std::size_t bytes = 0;
+    const datetime::timestamp start = datetime::timestamp::now();
+    while (stmt.step()) {
+        bytes += stmt.safe_column(b).length();
+        ++rows;
+    }
+    utils::report_benchmark(this, rows, datetime::timestamp::now() - start);
+
+    ATF_REQUIRE_EQ(iterations, rows);
+    ATF_REQUIRE_EQ(iterations * 9, bytes);
+}
+
+
+ATF_INIT_TEST_CASES(tcs)
+{
+    ATF_ADD_TEST_CASE(tcs, insert__bind_step);
+    ATF_ADD_TEST_CASE(tcs, insert__typed_bind_step);
+    ATF_ADD_TEST_CASE(tcs, insert__cached_statement);
+    ATF_ADD_TEST_CASE(tcs, select__step);
+    ATF_ADD_TEST_CASE(tcs, select__typed_step);
+}
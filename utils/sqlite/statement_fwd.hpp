@@ -47,8 +47,11 @@ enum type {
 
 
 class blob;
+template< typename T > struct column;
 class null;
+template< typename T > struct parameter;
 class statement;
+class zeroblob;
 
 
 }  // namespace sqlite
@@ -500,6 +500,59 @@ ATF_TEST_CASE_BODY(safe_column_bytes__ok__text)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(safe_column__typed__ok);
+ATF_TEST_CASE_BODY(safe_column__typed__ok)
+{
+    sqlite::database db = sqlite::database::in_memory();
+    db.exec("CREATE TABLE foo (a BLOB, b REAL, c INTEGER, d INTEGER, e TEXT);"
+            "INSERT INTO foo VALUES (x'cafe', 0.5, 123, 4294967419, 'hi');");
+    sqlite::statement stmt = db.create_statement("SELECT * FROM foo");
+    ATF_REQUIRE(stmt.step());
+
+    const sqlite::column< sqlite::blob > a = { 0, "a" };
+    const sqlite::column< double > b = { 1, "b" };
+    const sqlite::column< int > c = { 2, "c" };
+    const sqlite::column< int64_t > d = { 3, "d" };
+    const sqlite::column< std::string > e = { 4, "e" };
+
+    const sqlite::blob blob = stmt.safe_column(a);
+    ATF_REQUIRE_EQ(2, blob.size);
+    ATF_REQUIRE_EQ(0.5, stmt.safe_column(b));
+    ATF_REQUIRE_EQ(123, stmt.safe_column(c));
+    ATF_REQUIRE_EQ(4294967419LL, stmt.safe_column(d));
+    ATF_REQUIRE_EQ("hi", stmt.safe_column(e));
+    ATF_REQUIRE(!stmt.step());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(safe_column__typed__fail);
+ATF_TEST_CASE_BODY(safe_column__typed__fail)
+{
+    sqlite::database db = sqlite::database::in_memory();
+    db.exec("CREATE TABLE foo (a INTEGER, b TEXT);"
+            "INSERT INTO foo VALUES (NULL, 'abc');");
+    sqlite::statement stmt = db.create_statement("SELECT * FROM foo");
+    ATF_REQUIRE(stmt.step());
+
+    const sqlite::column< sqlite::blob > a_blob = { 0, "a" };
+    ATF_REQUIRE_THROW_RE(sqlite::error, "'a' is not a blob",
+                         stmt.safe_column(a_blob));
+    const sqlite::column< double > b_double = { 1, "b" };
+    ATF_REQUIRE_THROW_RE(sqlite::error, "'b' is not a float",
+                         stmt.safe_column(b_double));
+    const sqlite::column< int > b_int = { 1, "b" };
+    ATF_REQUIRE_THROW_RE(sqlite::error, "'b' is not an integer",
+                         stmt.safe_column(b_int));
+    const sqlite::column< int64_t > b_int64 = { 1, "b" };
+    ATF_REQUIRE_THROW_RE(sqlite::error, "'b' is not an integer",
+                         stmt.safe_column(b_int64));
+    const sqlite::column< std::string > a_text = { 0, "a" };
+    ATF_REQUIRE_THROW_RE(sqlite::error, "'a' is not a string",
+                         stmt.safe_column(a_text));
+    ATF_REQUIRE(!stmt.step());
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(safe_column_bytes__fail);
 ATF_TEST_CASE_BODY(safe_column_bytes__fail)
 {
@@ -650,6 +703,22 @@ ATF_TEST_CASE_BODY(bind__text__transient)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(bind__zeroblob);
+ATF_TEST_CASE_BODY(bind__zeroblob)
+{
+    sqlite::database db = sqlite::database::in_memory();
+    sqlite::statement stmt = db.create_statement("SELECT 3, ?");
+
+    stmt.bind(1, sqlite::zeroblob(3));
+    ATF_REQUIRE(stmt.step());
+    ATF_REQUIRE(sqlite::type_blob == stmt.column_type(1));
+    const sqlite::blob blob = stmt.column_blob(1);
+    ATF_REQUIRE_EQ(3, blob.size);
+    ATF_REQUIRE(std::memcmp("\0\0\0", blob.memory, 3) == 0);
+    ATF_REQUIRE(!stmt.step());
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(bind__by_name);
 ATF_TEST_CASE_BODY(bind__by_name)
 {
@@ -667,6 +736,28 @@ ATF_TEST_CASE_BODY(bind__by_name)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(bind__typed);
+ATF_TEST_CASE_BODY(bind__typed)
+{
+    sqlite::database db = sqlite::database::in_memory();
+    sqlite::statement stmt = db.create_statement(
+        "SELECT :foo, :bar, :baz");
+
+    const sqlite::parameter< int64_t > foo = { 1, ":foo" };
+    const sqlite::parameter< std::string > bar = { 2, ":bar" };
+    const sqlite::parameter< std::string > baz = { 3, ":baz" };
+    stmt.bind(foo, 4294967419LL);
+    stmt.bind(bar, "Hello");
+    stmt.bind(baz, sqlite::null());
+    ATF_REQUIRE(stmt.step());
+    ATF_REQUIRE_EQ(4294967419LL, stmt.column_int64(0));
+    ATF_REQUIRE(sqlite::type_text == stmt.column_type(1));
+    ATF_REQUIRE_EQ("Hello", stmt.column_text(1));
+    ATF_REQUIRE(sqlite::type_null == stmt.column_type(2));
+    ATF_REQUIRE(!stmt.step());
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(bind_parameter_count);
 ATF_TEST_CASE_BODY(bind_parameter_count)
 {
@@ -765,6 +856,9 @@ ATF_INIT_TEST_CASES(tcs)
     ATF_ADD_TEST_CASE(tcs, safe_column_bytes__ok__text);
     ATF_ADD_TEST_CASE(tcs, safe_column_bytes__fail);
 
+    ATF_ADD_TEST_CASE(tcs, safe_column__typed__ok);
+    ATF_ADD_TEST_CASE(tcs, safe_column__typed__fail);
+
     ATF_ADD_TEST_CASE(tcs, reset);
 
     ATF_ADD_TEST_CASE(tcs, bind__blob);
@@ -774,7 +868,9 @@ ATF_INIT_TEST_CASES(tcs)
     ATF_ADD_TEST_CASE(tcs, bind__null);
     ATF_ADD_TEST_CASE(tcs, bind__text);
     ATF_ADD_TEST_CASE(tcs, bind__text__transient);
+    ATF_ADD_TEST_CASE(tcs, bind__zeroblob);
     ATF_ADD_TEST_CASE(tcs, bind__by_name);
+    ATF_ADD_TEST_CASE(tcs, bind__typed);
 
     ATF_ADD_TEST_CASE(tcs, bind_parameter_count);
     ATF_ADD_TEST_CASE(tcs, bind_parameter_index);
@@ -55,6 +55,7 @@ extern "C" {
 #include "utils/process/operations.hpp"
 #include "utils/process/status.hpp"
 #include "utils/sanity.hpp"
+#include "utils/units.hpp"
 
 namespace datetime = utils::datetime;
 namespace executor = utils::process::executor;
@@ -76,6 +77,24 @@ using utils::optional;
 const char* utils::builtin_gdb = GDB;
 
 
+/// Built-in path to the preloadable crash handler library.
+///
+/// This is the value that should be passed to the find_crash_handler()
+/// function.  If empty, the crash handler was not built and stacktraces can
+/// only be gathered with GDB.
+///
+/// Test cases can override the value of this built-in constant to unit-test the
+/// behavior of the functions below.
+const char* utils::builtin_crash_handler = CRASH_HANDLER;
+
+
+/// Path to the file that describes where the kernel writes core files.
+///
+/// Test cases can override the value of this constant to unit-test the
+/// behavior of the functions below.
+const char* utils::core_pattern_file = "/proc/sys/kernel/core_pattern";
+
+
 /// Maximum time the external GDB process is allowed to run for.
 datetime::delta utils::gdb_timeout(60, 0);
 
@@ -98,6 +117,51 @@ static const std::string::size_type max_core_name_length =
     ;
 
 
+/// Name of the file in the control directory in which the crash handler of a
+/// program records its backtrace.
+static const char* crash_report_name = "crash_report";
+
+
+/// Appends the report of the crash handler of a program to its stderr.
+///
+/// \param gdb_err Stream to the stderr of the crashed program.
+/// \param status The exit status of the crashed program.
+/// \param control_directory The control directory of the crashed program.
+///
+/// \return True if the crash handler left a report; false otherwise.
+static bool
+append_crash_report(std::ostream& gdb_err, const process::status& status,
+                    const fs::path& control_directory)
+{
+    const fs::path report = control_directory / crash_report_name;
+    std::ifstream input(report.c_str());
+    if (!input)
+        return false;
+
+    LD(F("Found crash report %s") % report);
+    gdb_err << F("Process with PID %s exited with signal %s; crash handler "
+                 "recorded this stack trace\n") %
+        status.dead_pid() % status.termsig();
+    gdb_err << input.rdbuf();
+    return true;
+}
+
+
+/// Writes the reason why no core file could be found.
+///
+/// \param output Stream into which to write the reason.
+static void
+report_missing_core(std::ostream& output)
+{
+    const optional< std::string > pipe = utils::find_core_pipe();
+    if (pipe)
+        output << F("Cannot find any core file; cores are piped to '%s'\n") %
+            pipe.get();
+    else
+        output << F("Cannot find any core file\n");
+}
+
+
 /// Functor to execute GDB in a subprocess.
 class run_gdb {
     /// Path to the GDB binary to use.
@@ -106,8 +170,14 @@ class run_gdb {
     /// Path to the program being debugged.
     const fs::path& _program;
 
-    /// Path to the dumped core.
-    const fs::path& _core_name;
+    /// Path to the dumped core, or none to look for it from the subprocess.
+    const optional< fs::path > _core_name;
+
+    /// The exit status of the program being debugged.
+    const process::status& _status;
+
+    /// The directory from which the program being debugged was run.
+    const fs::path _work_directory;
 
 public:
     /// Constructs the functor.
@@ -116,10 +186,18 @@ public:
     /// \param program_ Path to the program being debugged.  Can be relative to
     ///     the given work directory.
     /// \param core_name_ Path to the dumped core.  Use find_core() to deduce
-    ///     a valid candidate.  Can be relative to the given work directory.
+    ///     a valid candidate.  Can be relative to the given work directory.  If
+    ///     none, the subprocess looks for the core itself, which is necessary
+    ///     when the core is only visible from within the mount namespace that
+    ///     the subprocess joins.
+    /// \param status_ The exit status of the program being debugged.
+    /// \param work_directory_ The directory from which the program being
+    ///     debugged was run.
     run_gdb(const fs::path& gdb_, const fs::path& program_,
-            const fs::path& core_name_) :
-        _gdb(gdb_), _program(program_), _core_name(core_name_)
+            const optional< fs::path >& core_name_,
+            const process::status& status_, const fs::path& work_directory_) :
+        _gdb(gdb_), _program(program_), _core_name(core_name_),
+        _status(status_), _work_directory(work_directory_)
     {
     }
 
@@ -130,6 +208,13 @@ public:
     void
     operator()(const fs::path& control_directory)
     {
+        const optional< fs::path > core_name = _core_name ? _core_name :
+            utils::find_core(_program, _status, _work_directory);
+        if (!core_name) {
+            report_missing_core(std::cerr);
+            ::_exit(EXIT_FAILURE);
+        }
+
         const fs::path gdb_script_path = control_directory / "gdb.script";
 
         // Old versions of GDB, such as the one shipped by FreeBSD as of
@@ -152,7 +237,7 @@ public:
         args.push_back("-x");
         args.push_back(gdb_script_path.str());
         args.push_back(_program.str());
-        args.push_back(_core_name.str());
+        args.push_back(core_name.get().str());
 
         // Force all GDB output to go to stderr.  We print messages to stderr
         // when grabbing the stacktrace and we do not want GDB's output to end
@@ -192,6 +277,51 @@ utils::find_gdb(void)
 }
 
 
+/// Looks for the preloadable crash handler library.
+///
+/// \return The absolute path to the library if it is available, otherwise
+/// none.
+optional< fs::path >
+utils::find_crash_handler(void)
+{
+    if (std::strlen(builtin_crash_handler) == 0)
+        return none;
+
+    const fs::path handler(builtin_crash_handler);
+    if (!handler.is_absolute() || !fs::exists(handler)) {
+        LD(F("Crash handler %s not available") % handler);
+        return none;
+    }
+    return utils::make_optional(handler);
+}
+
+
+/// Injects the crash handler into the program that the caller will execute.
+///
+/// This must be called from the subprocess that is about to execute the
+/// program.  It is a no-op if the crash handler is not available, in which
+/// case stacktraces will be gathered with GDB if the program dumps core.
+///
+/// \param control_directory The control directory of the subprocess, in which
+///     the crash handler records its report.
+void
+utils::setup_crash_handler(const fs::path& control_directory)
+{
+    const optional< fs::path > handler = find_crash_handler();
+    if (!handler)
+        return;
+
+    utils::setenv("KYUA_CRASH_REPORT",
+                  (control_directory / crash_report_name).str());
+
+    const optional< std::string > preload = utils::getenv("LD_PRELOAD");
+    if (preload && !preload.get().empty())
+        utils::setenv("LD_PRELOAD", preload.get() + ":" + handler.get().str());
+    else
+        utils::setenv("LD_PRELOAD", handler.get().str());
+}
+
+
 /// Looks for a core file for the given program.
 ///
 /// \param program The name of the binary that generated the core file.  Can be
@@ -230,6 +360,31 @@ utils::find_core(const fs::path& program, const process::status& status,
 }
 
 
+/// Checks if the kernel hands core files to a program instead of the disk.
+///
+/// When the core pattern starts with a pipe, cores never reach the work
+/// directory of the crashed program and find_core() cannot locate them.  This
+/// allows callers to explain where the core went instead.
+///
+/// \return The command line that receives the core files, if any.
+optional< std::string >
+utils::find_core_pipe(void)
+{
+    std::ifstream input(core_pattern_file);
+    if (!input)
+        return none;
+
+    std::string pattern;
+    if (!std::getline(input, pattern) || pattern.empty() || pattern[0] != '|')
+        return none;
+
+    const std::string::size_type start = pattern.find_first_not_of(" \t", 1);
+    if (start == std::string::npos)
+        return none;
+    return utils::make_optional(pattern.substr(start));
+}
+
+
 /// Raises core size limit to its possible maximum.
 ///
 /// This is a best-effort operation.  There is no guarantee that the operation
@@ -271,33 +426,88 @@ utils::unlimit_core_size(void)
 }
 
 
-/// Gathers a stacktrace of a crashed program.
+/// Caps the core size limit to a given size.
+///
+/// Cores larger than the limit are truncated by the kernel, which is still
+/// enough for GDB to recover the stacks of the crashed threads in most cases
+/// but avoids writing the whole address space of large programs to disk.  A
+/// limit of zero disables cores altogether.  The soft limit is never raised
+/// above the hard limit.
+///
+/// \param max_size Maximum size of the core files to generate.
+///
+/// \return True if the core size could be limited; false otherwise.
+bool
+utils::limit_core_size(const units::bytes& max_size)
+{
+    struct ::rlimit rl;
+    if (::getrlimit(RLIMIT_CORE, &rl) == -1) {
+        const int original_errno = errno;
+        LW(F("getrlimit should not have failed but got: %s") %
+           std::strerror(original_errno));
+        return false;
+    }
+
+    const ::rlim_t value = static_cast< ::rlim_t >(max_size);
+    if (rl.rlim_max == RLIM_INFINITY || value < rl.rlim_max)
+        rl.rlim_cur = value;
+    else
+        rl.rlim_cur = rl.rlim_max;
+    LD(F("Lowering soft core size limit to %s") % rl.rlim_cur);
+    if (::setrlimit(RLIMIT_CORE, &rl) == -1) {
+        const int original_errno = errno;
+        LW(F("setrlimit should not have failed but got: %s") %
+           std::strerror(original_errno));
+        return false;
+    }
+    return true;
+}
+
+
+/// Starts gathering a stacktrace of a crashed program in the background.
+///
+/// If the crash handler of the program left a report, that report is appended
+/// to the stderr of the program and there is no need to run GDB.  Otherwise,
+/// GDB runs as a followup of the crashed program to reuse its context and its
+/// output is appended to the stderr of the program.  The caller must collect
+/// the termination of the returned subprocess via the executor and then pass
+/// its exit handle to finish_stacktrace().
+///
+/// If the program ran in its own mount namespace, its work directory is an
+/// empty mount point from our point of view, so the core file can only be
+/// found from within the namespace.  In that case, the GDB subprocess, which
+/// joins the namespace, looks for the core file itself and reports if there is
+/// none.
 ///
 /// \param program The name of the binary that crashed and dumped a core file.
 ///     Can be either absolute or relative.
-/// \param status The exit status of the program.
-/// \param work_directory The directory from which the program was run.
-/// \param output Stream into which to dump the stack trace and any additional
-///     information.
+/// \param executor_handle The executor in which to spawn GDB.
+/// \param exit_handle The exit handle of the crashed program.
 ///
-/// \post If anything goes wrong, the diagnostic messages are written to the
-/// output.  This function should not throw.
-void
-utils::dump_stacktrace(const fs::path& program,
-                       executor::executor_handle& executor_handle,
-                       const executor::exit_handle& exit_handle)
+/// \return The handle of the GDB subprocess, or none if GDB is not needed or
+/// could not be started.  In the latter case, the reasons have already been
+/// written to the stderr of the program and there is nothing else to do.
+optional< executor::exec_handle >
+utils::start_stacktrace(const fs::path& program,
+                        executor::executor_handle& executor_handle,
+                        const executor::exit_handle& exit_handle)
 {
     PRE(exit_handle.status());
     const process::status& status = exit_handle.status().get();
-    PRE(status.signaled() && status.coredump());
+    PRE(status.signaled());
 
     std::ofstream gdb_err(exit_handle.stderr_file().c_str(), std::ios::app);
     if (!gdb_err) {
         LW(F("Failed to open %s to append GDB's output") %
            exit_handle.stderr_file());
-        return;
+        return none;
     }
 
+    if (append_crash_report(gdb_err, status, exit_handle.control_directory()))
+        return none;
+    if (!status.coredump())
+        return none;
+
     gdb_err << F("Process with PID %s exited with signal %s and dumped core; "
                  "attempting to gather stack trace\n") %
         status.dead_pid() % status.termsig();
@@ -306,23 +516,41 @@ utils::dump_stacktrace(const fs::path& program,
     if (!gdb) {
         gdb_err << F("Cannot find GDB binary; builtin was '%s'\n") %
             builtin_gdb;
-        return;
+        return none;
     }
 
-    const optional< fs::path > core_file = find_core(
-        program, status, exit_handle.work_directory());
-    if (!core_file) {
-        gdb_err << F("Cannot find any core file\n");
-        return;
+    optional< fs::path > core_file;
+    if (!exit_handle.isolated_mounts()) {
+        core_file = find_core(program, status, exit_handle.work_directory());
+        if (!core_file) {
+            report_missing_core(gdb_err);
+            return none;
+        }
     }
 
-    gdb_err.flush();
-    const executor::exec_handle exec_handle =
-        executor_handle.spawn_followup(
-            run_gdb(gdb.get(), program, core_file.get()),
-            exit_handle, gdb_timeout);
-    const executor::exit_handle gdb_exit_handle =
-        executor_handle.wait(exec_handle);
+    gdb_err.close();
+    return utils::make_optional(executor_handle.spawn_followup(
+        run_gdb(gdb.get(), program, core_file, status,
+                exit_handle.work_directory()), exit_handle, gdb_timeout));
+}
+
+
+/// Records the termination of a GDB run started by start_stacktrace().
+///
+/// \param gdb_exit_handle The exit handle of the GDB subprocess.
+///
+/// \post The outcome of GDB is appended to the stderr of the crashed program.
+/// This function should not throw.
+void
+utils::finish_stacktrace(const executor::exit_handle& gdb_exit_handle)
+{
+    std::ofstream gdb_err(gdb_exit_handle.stderr_file().c_str(),
+                          std::ios::app);
+    if (!gdb_err) {
+        LW(F("Failed to open %s to append GDB's output") %
+           gdb_exit_handle.stderr_file());
+        return;
+    }
 
     const optional< process::status >& gdb_status = gdb_exit_handle.status();
     if (!gdb_status) {
@@ -338,6 +566,30 @@ utils::dump_stacktrace(const fs::path& program,
 }
 
 
+/// Gathers a stacktrace of a crashed program.
+///
+/// This is the synchronous version of start_stacktrace() and
+/// finish_stacktrace().
+///
+/// \param program The name of the binary that crashed and dumped a core file.
+///     Can be either absolute or relative.
+/// \param executor_handle The executor in which to spawn GDB.
+/// \param exit_handle The exit handle of the crashed program.
+///
+/// \post If anything goes wrong, the diagnostic messages are written to the
+/// stderr of the program.  This function should not throw.
+void
+utils::dump_stacktrace(const fs::path& program,
+                       executor::executor_handle& executor_handle,
+                       const executor::exit_handle& exit_handle)
+{
+    const optional< executor::exec_handle > exec_handle = start_stacktrace(
+        program, executor_handle, exit_handle);
+    if (exec_handle)
+        finish_stacktrace(executor_handle.wait(exec_handle.get()));
+}
+
+
 /// Gathers a stacktrace of a program if it crashed.
 ///
 /// This is just a convenience function to allow appending the stacktrace to an
@@ -362,7 +614,7 @@ utils::dump_stacktrace_if_available(const fs::path& program,
                                     const executor::exit_handle& exit_handle)
 {
     const optional< process::status >& status = exit_handle.status();
-    if (!status || !status.get().signaled() || !status.get().coredump())
+    if (!status || !status.get().signaled())
         return;
 
     dump_stacktrace(program, executor_handle, exit_handle);
@@ -33,26 +33,39 @@
 #define ENGINE_STACKTRACE_HPP
 
 #include <ostream>
+#include <string>
 
 #include "utils/datetime_fwd.hpp"
 #include "utils/fs/path_fwd.hpp"
 #include "utils/optional_fwd.hpp"
 #include "utils/process/executor_fwd.hpp"
 #include "utils/process/status_fwd.hpp"
+#include "utils/units_fwd.hpp"
 
 namespace utils {
 
 
 extern const char* builtin_gdb;
+extern const char* builtin_crash_handler;
+extern const char* core_pattern_file;
 extern utils::datetime::delta gdb_timeout;
 
 utils::optional< utils::fs::path > find_gdb(void);
+utils::optional< utils::fs::path > find_crash_handler(void);
+void setup_crash_handler(const utils::fs::path&);
 
 utils::optional< utils::fs::path > find_core(const utils::fs::path&,
                                              const utils::process::status&,
                                              const utils::fs::path&);
+utils::optional< std::string > find_core_pipe(void);
 
 bool unlimit_core_size(void);
+bool limit_core_size(const utils::units::bytes&);
+
+utils::optional< utils::process::executor::exec_handle > start_stacktrace(
+    const utils::fs::path&, utils::process::executor::executor_handle&,
+    const utils::process::executor::exit_handle&);
+void finish_stacktrace(const utils::process::executor::exit_handle&);
 
 void dump_stacktrace(const utils::fs::path&,
                      utils::process::executor::executor_handle&,
@@ -44,6 +44,8 @@ extern "C" {
 
 #include "utils/datetime.hpp"
 #include "utils/env.hpp"
+#include "utils/format/macros.hpp"
+#include "utils/fs/exceptions.hpp"
 #include "utils/fs/operations.hpp"
 #include "utils/fs/path.hpp"
 #include "utils/optional.ipp"
@@ -53,11 +55,13 @@ extern "C" {
 #include "utils/process/status.hpp"
 #include "utils/sanity.hpp"
 #include "utils/test_utils.ipp"
+#include "utils/units.hpp"
 
 namespace datetime = utils::datetime;
 namespace executor = utils::process::executor;
 namespace fs = utils::fs;
 namespace process = utils::process;
+namespace units = utils::units;
 
 using utils::none;
 using utils::optional;
@@ -131,6 +135,21 @@ child_exit(const fs::path& UTILS_UNUSED_PARAM(control_directory))
 }
 
 
+static void child_create_fake_core(const fs::path&) UTILS_NORETURN;
+
+
+/// Subprocess that creates a fake core file for the "fake" program.
+///
+/// \param unused_control_directory Directory where control files separate from
+///     the work directory can be placed.
+static void
+child_create_fake_core(const fs::path& UTILS_UNUSED_PARAM(control_directory))
+{
+    atf::utils::create_file("fake.core", "Invalid core file, but not read");
+    ::_exit(EXIT_SUCCESS);
+}
+
+
 static void child_pause(const fs::path&) UTILS_NORETURN;
 
 
@@ -282,6 +301,40 @@ ATF_TEST_CASE_BODY(unlimit_core_size__hard_is_zero)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(limit_core_size);
+ATF_TEST_CASE_BODY(limit_core_size)
+{
+    struct rlimit rl;
+    ATF_REQUIRE(::getrlimit(RLIMIT_CORE, &rl) != -1);
+    if (rl.rlim_max != RLIM_INFINITY && rl.rlim_max < 8192)
+        skip("Hard core size limit too low to run this test");
+
+    ATF_REQUIRE(utils::limit_core_size(units::bytes(4096)));
+    ATF_REQUIRE(::getrlimit(RLIMIT_CORE, &rl) != -1);
+    ATF_REQUIRE_EQ(static_cast< rlim_t >(4096), rl.rlim_cur);
+
+    ATF_REQUIRE(utils::limit_core_size(units::bytes(0)));
+    ATF_REQUIRE(::getrlimit(RLIMIT_CORE, &rl) != -1);
+    ATF_REQUIRE_EQ(static_cast< rlim_t >(0), rl.rlim_cur);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(limit_core_size__above_hard);
+ATF_TEST_CASE_BODY(limit_core_size__above_hard)
+{
+    struct rlimit rl;
+    rl.rlim_cur = 0;
+    rl.rlim_max = 8192;
+    if (::setrlimit(RLIMIT_CORE, &rl) == -1)
+        skip("Failed to lower the core size limit");
+
+    ATF_REQUIRE(utils::limit_core_size(units::bytes(1024 * 1024)));
+    ATF_REQUIRE(::getrlimit(RLIMIT_CORE, &rl) != -1);
+    ATF_REQUIRE_EQ(static_cast< rlim_t >(8192), rl.rlim_cur);
+    ATF_REQUIRE_EQ(static_cast< rlim_t >(8192), rl.rlim_max);
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(find_gdb__use_builtin);
 ATF_TEST_CASE_BODY(find_gdb__use_builtin)
 {
@@ -327,6 +380,68 @@ ATF_TEST_CASE_BODY(find_gdb__bogus_value)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(find_crash_handler__disabled);
+ATF_TEST_CASE_BODY(find_crash_handler__disabled)
+{
+    utils::builtin_crash_handler = "";
+    ATF_REQUIRE(!utils::find_crash_handler());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(find_crash_handler__missing);
+ATF_TEST_CASE_BODY(find_crash_handler__missing)
+{
+    const std::string handler = (fs::current_path() / "missing.so").str();
+    utils::builtin_crash_handler = handler.c_str();
+    ATF_REQUIRE(!utils::find_crash_handler());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(find_crash_handler__ok);
+ATF_TEST_CASE_BODY(find_crash_handler__ok)
+{
+    atf::utils::create_file("handler.so", "");
+    const fs::path handler = fs::current_path() / "handler.so";
+    utils::builtin_crash_handler = handler.c_str();
+    const optional< fs::path > found = utils::find_crash_handler();
+    ATF_REQUIRE(found);
+    ATF_REQUIRE_EQ(handler, found.get());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(setup_crash_handler__disabled);
+ATF_TEST_CASE_BODY(setup_crash_handler__disabled)
+{
+    utils::builtin_crash_handler = "";
+    utils::unsetenv("KYUA_CRASH_REPORT");
+    utils::unsetenv("LD_PRELOAD");
+    utils::setup_crash_handler(fs::path("/the/control"));
+    ATF_REQUIRE(!utils::getenv("KYUA_CRASH_REPORT"));
+    ATF_REQUIRE(!utils::getenv("LD_PRELOAD"));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(setup_crash_handler__enabled);
+ATF_TEST_CASE_BODY(setup_crash_handler__enabled)
+{
+    atf::utils::create_file("handler.so", "");
+    const fs::path handler = fs::current_path() / "handler.so";
+    utils::builtin_crash_handler = handler.c_str();
+
+    utils::unsetenv("LD_PRELOAD");
+    utils::setup_crash_handler(fs::path("/the/control"));
+    ATF_REQUIRE_EQ("/the/control/crash_report",
+                   utils::getenv("KYUA_CRASH_REPORT").get());
+    ATF_REQUIRE_EQ(handler.str(), utils::getenv("LD_PRELOAD").get());
+
+    utils::setenv("LD_PRELOAD", "other.so");
+    utils::setup_crash_handler(fs::path("/the/control"));
+    ATF_REQUIRE_EQ("other.so:" + handler.str(),
+                   utils::getenv("LD_PRELOAD").get());
+    utils::unsetenv("LD_PRELOAD");
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(find_core__found__short);
 ATF_TEST_CASE_BODY(find_core__found__short)
 {
@@ -368,6 +483,35 @@ ATF_TEST_CASE_BODY(find_core__not_found)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(find_core_pipe__missing);
+ATF_TEST_CASE_BODY(find_core_pipe__missing)
+{
+    utils::core_pattern_file = "missing";
+    ATF_REQUIRE(!utils::find_core_pipe());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(find_core_pipe__file);
+ATF_TEST_CASE_BODY(find_core_pipe__file)
+{
+    atf::utils::create_file("core_pattern", "%e.core\n");
+    utils::core_pattern_file = "core_pattern";
+    ATF_REQUIRE(!utils::find_core_pipe());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(find_core_pipe__pipe);
+ATF_TEST_CASE_BODY(find_core_pipe__pipe)
+{
+    atf::utils::create_file("core_pattern",
+                            "| /usr/lib/systemd/systemd-coredump %P %s\n");
+    utils::core_pattern_file = "core_pattern";
+    const optional< std::string > pipe = utils::find_core_pipe();
+    ATF_REQUIRE(pipe);
+    ATF_REQUIRE_EQ("/usr/lib/systemd/systemd-coredump %P %s", pipe.get());
+}
+
+
 ATF_TEST_CASE(dump_stacktrace__integration);
 ATF_TEST_CASE_HEAD(dump_stacktrace__integration)
 {
@@ -537,6 +681,132 @@ ATF_TEST_CASE_BODY(dump_stacktrace__gdb_timeout)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(start_stacktrace__async);
+ATF_TEST_CASE_BODY(start_stacktrace__async)
+{
+    utils::setenv("PATH", ".");
+    create_script("fake-gdb", "echo 'frame 1'; exit 0");
+    const std::string gdb = (fs::current_path() / "fake-gdb").str();
+    utils::builtin_gdb = gdb.c_str();
+
+    executor::executor_handle handle = executor::setup();
+    executor::exit_handle exit_handle = generate_core(this, "short", handle);
+
+    atf::utils::create_file((exit_handle.work_directory() / "fake.core").str(),
+                            "Invalid core file, but not read");
+    const optional< executor::exec_handle > gdb_handle =
+        utils::start_stacktrace(fs::path("fake"), handle, exit_handle);
+    ATF_REQUIRE(gdb_handle);
+    ATF_REQUIRE(!atf::utils::grep_file("GDB exited successfully",
+                                       exit_handle.stderr_file().str()));
+
+    executor::exit_handle gdb_exit_handle = handle.wait_any();
+    ATF_REQUIRE_EQ(gdb_handle.get().pid(), gdb_exit_handle.original_pid());
+    utils::finish_stacktrace(gdb_exit_handle);
+
+    ATF_REQUIRE(atf::utils::grep_file("^frame 1$",
+                                      exit_handle.stderr_file().str()));
+    ATF_REQUIRE(atf::utils::grep_file("GDB exited successfully",
+                                      exit_handle.stderr_file().str()));
+
+    gdb_exit_handle.cleanup();
+    exit_handle.cleanup();
+    handle.cleanup();
+}
+
+
+ATF_TEST_CASE(start_stacktrace__isolated_mounts);
+ATF_TEST_CASE_HEAD(start_stacktrace__isolated_mounts)
+{
+    set_md_var("require.user", "root");
+}
+ATF_TEST_CASE_BODY(start_stacktrace__isolated_mounts)
+{
+    create_script("fake-gdb", "echo \"core is $6\"; exit 0");
+    const std::string gdb = (fs::current_path() / "fake-gdb").str();
+    utils::builtin_gdb = gdb.c_str();
+
+    executor::executor_handle handle = executor::setup();
+    try {
+        handle.isolate_work_mounts(units::bytes(0));
+    } catch (const fs::error& e) {
+        handle.cleanup();
+        skip(F("Cannot isolate mounts: %s") % e.what());
+    }
+    executor::exit_handle exit_handle = generate_core(this, "short", handle);
+    if (!exit_handle.isolated_mounts())
+        skip("Cannot create mount namespaces");
+
+    // The core file only exists within the namespace of the crashed program.
+    (void)handle.spawn_followup(child_create_fake_core, exit_handle,
+                                datetime::delta(60, 0));
+    handle.wait_any().cleanup();
+    ATF_REQUIRE(!fs::exists(exit_handle.work_directory() / "fake.core"));
+
+    const optional< executor::exec_handle > gdb_handle =
+        utils::start_stacktrace(fs::path("fake"), handle, exit_handle);
+    ATF_REQUIRE(gdb_handle);
+    executor::exit_handle gdb_exit_handle = handle.wait_any();
+    utils::finish_stacktrace(gdb_exit_handle);
+
+    ATF_REQUIRE(atf::utils::grep_file(
+        F("^core is %s$") % (exit_handle.work_directory() / "fake.core"),
+        exit_handle.stderr_file().str()));
+    ATF_REQUIRE(atf::utils::grep_file("GDB exited successfully",
+                                      exit_handle.stderr_file().str()));
+
+    gdb_exit_handle.cleanup();
+    exit_handle.cleanup();
+    handle.cleanup();
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(start_stacktrace__crash_report);
+ATF_TEST_CASE_BODY(start_stacktrace__crash_report)
+{
+    utils::setenv("PATH", ".");
+    utils::builtin_gdb = "missing-gdb";
+
+    executor::executor_handle handle = executor::setup();
+    executor::exit_handle exit_handle = generate_core(this, "short", handle);
+
+    atf::utils::create_file(
+        (exit_handle.control_directory() / "crash_report").str(),
+        "frame from the handler\n");
+    ATF_REQUIRE(!utils::start_stacktrace(fs::path("fake"), handle,
+                                         exit_handle));
+    ATF_REQUIRE(atf::utils::grep_file("crash handler recorded this stack",
+                                      exit_handle.stderr_file().str()));
+    ATF_REQUIRE(atf::utils::grep_file("^frame from the handler$",
+                                      exit_handle.stderr_file().str()));
+    ATF_REQUIRE(!atf::utils::grep_file("GDB",
+                                       exit_handle.stderr_file().str()));
+
+    exit_handle.cleanup();
+    handle.cleanup();
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(start_stacktrace__cannot_find_gdb);
+ATF_TEST_CASE_BODY(start_stacktrace__cannot_find_gdb)
+{
+    utils::setenv("PATH", ".");
+    utils::builtin_gdb = "missing-gdb";
+
+    executor::executor_handle handle = executor::setup();
+    executor::exit_handle exit_handle = generate_core(this, "short", handle);
+
+    ATF_REQUIRE(!utils::start_stacktrace(fs::path("fake"), handle,
+                                         exit_handle));
+    ATF_REQUIRE(atf::utils::grep_file(
+                    "Cannot find GDB binary; builtin was 'missing-gdb'",
+                    exit_handle.stderr_file().str()));
+
+    exit_handle.cleanup();
+    handle.cleanup();
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(dump_stacktrace_if_available__append);
 ATF_TEST_CASE_BODY(dump_stacktrace_if_available__append)
 {
@@ -607,15 +877,29 @@ ATF_INIT_TEST_CASES(tcs)
     ATF_ADD_TEST_CASE(tcs, unlimit_core_size);
     ATF_ADD_TEST_CASE(tcs, unlimit_core_size__hard_is_zero);
 
+    ATF_ADD_TEST_CASE(tcs, limit_core_size);
+    ATF_ADD_TEST_CASE(tcs, limit_core_size__above_hard);
+
     ATF_ADD_TEST_CASE(tcs, find_gdb__use_builtin);
     ATF_ADD_TEST_CASE(tcs, find_gdb__search_builtin__ok);
     ATF_ADD_TEST_CASE(tcs, find_gdb__search_builtin__fail);
     ATF_ADD_TEST_CASE(tcs, find_gdb__bogus_value);
 
+    ATF_ADD_TEST_CASE(tcs, find_crash_handler__disabled);
+    ATF_ADD_TEST_CASE(tcs, find_crash_handler__missing);
+    ATF_ADD_TEST_CASE(tcs, find_crash_handler__ok);
+
+    ATF_ADD_TEST_CASE(tcs, setup_crash_handler__disabled);
+    ATF_ADD_TEST_CASE(tcs, setup_crash_handler__enabled);
+
     ATF_ADD_TEST_CASE(tcs, find_core__found__short);
     ATF_ADD_TEST_CASE(tcs, find_core__found__long);
     ATF_ADD_TEST_CASE(tcs, find_core__not_found);
 
+    ATF_ADD_TEST_CASE(tcs, find_core_pipe__missing);
+    ATF_ADD_TEST_CASE(tcs, find_core_pipe__file);
+    ATF_ADD_TEST_CASE(tcs, find_core_pipe__pipe);
+
     ATF_ADD_TEST_CASE(tcs, dump_stacktrace__integration);
     ATF_ADD_TEST_CASE(tcs, dump_stacktrace__ok);
     ATF_ADD_TEST_CASE(tcs, dump_stacktrace__cannot_find_core);
@@ -623,6 +907,11 @@ ATF_INIT_TEST_CASES(tcs)
     ATF_ADD_TEST_CASE(tcs, dump_stacktrace__gdb_fail);
     ATF_ADD_TEST_CASE(tcs, dump_stacktrace__gdb_timeout);
 
+    ATF_ADD_TEST_CASE(tcs, start_stacktrace__async);
+    ATF_ADD_TEST_CASE(tcs, start_stacktrace__isolated_mounts);
+    ATF_ADD_TEST_CASE(tcs, start_stacktrace__crash_report);
+    ATF_ADD_TEST_CASE(tcs, start_stacktrace__cannot_find_gdb);
+
     ATF_ADD_TEST_CASE(tcs, dump_stacktrace_if_available__append);
     ATF_ADD_TEST_CASE(tcs, dump_stacktrace_if_available__no_status);
     ATF_ADD_TEST_CASE(tcs, dump_stacktrace_if_available__no_coredump);
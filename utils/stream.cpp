@@ -28,11 +28,18 @@
 
 #include "utils/stream.hpp"
 
+extern "C" {
+#include <fcntl.h>
+#include <unistd.h>
+}
+
+#include <cerrno>
+#include <cstring>
 #include <fstream>
 #include <iostream>
-#include <sstream>
 #include <stdexcept>
 
+#include "utils/auto_array.ipp"
 #include "utils/format/macros.hpp"
 #include "utils/fs/path.hpp"
 #include "utils/sanity.hpp"
@@ -51,6 +58,10 @@ static const fs::path stdout_path("/dev/stdout");
 static const fs::path stderr_path("/dev/stderr");
 
 
+/// Size of the chunks in which read_fd and read_stream consume their input.
+static const std::size_t read_chunk_size = 65536;
+
+
 }  // anonymous namespace
 
 
@@ -110,20 +121,63 @@ utils::stream_length(std::istream& is)
 }
 
 
+/// Reads the whole contents of a file descriptor into memory.
+///
+/// This uses read(2) directly so that bulk reads do not go through the
+/// buffering layers of the C++ streams.  The file descriptor is consumed up
+/// to its end of file but is not closed.
+///
+/// \param fd The file descriptor from which to read.
+///
+/// \return A plain string containing the raw contents read from fd.
+///
+/// \throw std::runtime_error If reading from the file descriptor fails.
+std::string
+utils::read_fd(const int fd)
+{
+    std::string contents;
+
+    utils::auto_array< char > tmp(new char[read_chunk_size]);
+    for (;;) {
+        const ssize_t cnt = ::read(fd, tmp.get(), read_chunk_size);
+        if (cnt == -1) {
+            if (errno == EINTR)
+                continue;
+            const int original_errno = errno;
+            throw std::runtime_error(F("Failed to read from file descriptor "
+                                       "%s: %s") % fd %
+                                     std::strerror(original_errno));
+        } else if (cnt == 0) {
+            break;
+        }
+        contents.append(tmp.get(), cnt);
+    }
+
+    return contents;
+}
+
+
 /// Reads a whole file into memory.
 ///
 /// \param path The file to read.
 ///
 /// \return A plain string containing the raw contents of the file.
 ///
-/// \throw std::runtime_error If the file cannot be opened.
+/// \throw std::runtime_error If the file cannot be opened or read.
 std::string
 utils::read_file(const fs::path& path)
 {
-    std::ifstream input(path.c_str());
-    if (!input)
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd == -1)
         throw std::runtime_error(F("Failed to open '%s' for read") % path);
-    return read_stream(input);
+    try {
+        const std::string contents = read_fd(fd);
+        ::close(fd);
+        return contents;
+    } catch (...) {
+        ::close(fd);
+        throw;
+    }
 }
 
 
@@ -135,15 +189,15 @@ utils::read_file(const fs::path& path)
 std::string
 utils::read_stream(std::istream& input)
 {
-    std::ostringstream buffer;
+    std::string contents;
 
-    char tmp[1024];
+    utils::auto_array< char > tmp(new char[read_chunk_size]);
     while (input.good()) {
-        input.read(tmp, sizeof(tmp));
+        input.read(tmp.get(), read_chunk_size);
         if (input.good() || input.eof()) {
-            buffer.write(tmp, input.gcount());
+            contents.append(tmp.get(), input.gcount());
         }
     }
 
-    return buffer.str();
+    return contents;
 }
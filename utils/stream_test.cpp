@@ -28,6 +28,11 @@
 
 #include "utils/stream.hpp"
 
+extern "C" {
+#include <fcntl.h>
+#include <unistd.h>
+}
+
 #include <cstdlib>
 #include <sstream>
 
@@ -103,6 +108,55 @@ ATF_TEST_CASE_BODY(stream_length__some)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(read_fd__empty);
+ATF_TEST_CASE_BODY(read_fd__empty)
+{
+    atf::utils::create_file("input.txt", "");
+    const int fd = ::open("input.txt", O_RDONLY);
+    ATF_REQUIRE(fd != -1);
+    ATF_REQUIRE_EQ("", utils::read_fd(fd));
+    ::close(fd);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(read_fd__pipe);
+ATF_TEST_CASE_BODY(read_fd__pipe)
+{
+    std::string contents;
+    for (int i = 0; i < 100000; i++)
+        contents += "abcdef";
+
+    int fds[2];
+    ATF_REQUIRE(::pipe(fds) != -1);
+    const pid_t pid = atf::utils::fork();
+    if (pid == 0) {
+        ::close(fds[0]);
+        std::size_t done = 0;
+        while (done < contents.length()) {
+            const ssize_t cnt = ::write(fds[1], contents.c_str() + done,
+                                        contents.length() - done);
+            if (cnt == -1)
+                std::exit(EXIT_FAILURE);
+            done += cnt;
+        }
+        std::exit(EXIT_SUCCESS);
+    }
+    ::close(fds[1]);
+    ATF_REQUIRE_EQ(contents, utils::read_fd(fds[0]));
+    ::close(fds[0]);
+    atf::utils::wait(pid, EXIT_SUCCESS, "", "");
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(read_fd__fail);
+ATF_TEST_CASE_BODY(read_fd__fail)
+{
+    ATF_REQUIRE_THROW_RE(std::runtime_error,
+                         "Failed to read from file descriptor 1234",
+                         utils::read_fd(1234));
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(read_file__ok);
 ATF_TEST_CASE_BODY(read_file__ok)
 {
@@ -112,6 +166,17 @@ ATF_TEST_CASE_BODY(read_file__ok)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(read_file__large);
+ATF_TEST_CASE_BODY(read_file__large)
+{
+    std::string contents;
+    for (int i = 0; i < 100000; i++)
+        contents += "line\n";
+    atf::utils::create_file("input.txt", contents);
+    ATF_REQUIRE_EQ(contents, utils::read_file(fs::path("input.txt")));
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(read_file__missing_file);
 ATF_TEST_CASE_BODY(read_file__missing_file)
 {
@@ -149,7 +214,12 @@ ATF_INIT_TEST_CASES(tcs)
     ATF_ADD_TEST_CASE(tcs, stream_length__empty);
     ATF_ADD_TEST_CASE(tcs, stream_length__some);
 
+    ATF_ADD_TEST_CASE(tcs, read_fd__empty);
+    ATF_ADD_TEST_CASE(tcs, read_fd__pipe);
+    ATF_ADD_TEST_CASE(tcs, read_fd__fail);
+
     ATF_ADD_TEST_CASE(tcs, read_file__ok);
+    ATF_ADD_TEST_CASE(tcs, read_file__large);
     ATF_ADD_TEST_CASE(tcs, read_file__missing_file);
 
     ATF_ADD_TEST_CASE(tcs, read_stream__empty);
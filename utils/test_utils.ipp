@@ -36,14 +36,20 @@
 
 extern "C" {
 #include <sys/resource.h>
+
+#include <stdint.h>
 }
 
+#include <cstddef>
 #include <cstdlib>
 #include <iostream>
+#include <string>
 
 #include <atf-c++.hpp>
 
+#include "utils/datetime.hpp"
 #include "utils/defs.hpp"
+#include "utils/latency_histogram.hpp"
 #include "utils/stacktrace.hpp"
 #include "utils/text/operations.ipp"
 
@@ -110,4 +116,85 @@ prepare_coredump_test(const atf::tests::tc* tc)
 }
 
 
+/// Skips the test if benchmarks have not been enabled by the user.
+///
+/// Benchmarks do not verify anything and take a long time, so they only run
+/// when explicitly requested.
+///
+/// \param tc The calling test.
+inline void
+require_run_benchmarks(const atf::tests::tc* tc)
+{
+    if (!tc->has_config_var("run_benchmarks") ||
+        !text::to_type< bool >(tc->get_config_var("run_benchmarks"))) {
+        tc->skip("run_benchmarks=false; not running benchmark");
+    }
+}
+
+
+/// Gets the number of iterations to run a benchmark for.
+///
+/// \param tc The calling test.
+/// \param default_iterations Iterations to run unless the user overrides them.
+///
+/// \return A number of iterations.
+inline std::size_t
+benchmark_iterations(const atf::tests::tc* tc,
+                     const std::size_t default_iterations)
+{
+    if (tc->has_config_var("benchmark_iterations"))
+        return text::to_type< std::size_t >(
+            tc->get_config_var("benchmark_iterations"));
+    else
+        return default_iterations;
+}
+
+
+/// Prints the measurements of a benchmark.
+///
+/// The output consists of "name.metric = value" lines, where name is the
+/// name of the calling test.
+///
+/// \param tc The calling test.
+/// \param iterations Number of iterations run by the benchmark.
+/// \param elapsed Time it took to run all the iterations.
+inline void
+report_benchmark(const atf::tests::tc* tc, const std::size_t iterations,
+                 const datetime::delta& elapsed)
+{
+    const std::string name = tc->get_md_var("ident");
+    std::cout << name << ".iterations = " << iterations << '\n';
+    std::cout << name << ".ns_per_iteration = "
+              << (iterations > 0 ?
+                  elapsed.to_microseconds() * 1000 /
+                  static_cast< int64_t >(iterations) : 0)
+              << '\n';
+}
+
+
+/// Prints the distribution of some latencies measured by a benchmark.
+///
+/// The output consists of "name.metric_pN_us = value" lines, where name is the
+/// name of the calling test, for the median, the 90th and the 99th percentiles
+/// and the maximum.
+///
+/// \param tc The calling test.
+/// \param metric Name of the measured latency.
+/// \param latencies The measurements; must not be empty.
+inline void
+report_benchmark_latencies(const atf::tests::tc* tc, const std::string& metric,
+                           const latency_histogram& latencies)
+{
+    const std::string name = tc->get_md_var("ident") + "." + metric;
+    std::cout << name << "_p50_us = "
+              << latencies.percentile(50).to_microseconds() << '\n';
+    std::cout << name << "_p90_us = "
+              << latencies.percentile(90).to_microseconds() << '\n';
+    std::cout << name << "_p99_us = "
+              << latencies.percentile(99).to_microseconds() << '\n';
+    std::cout << name << "_max_us = " << latencies.max().to_microseconds()
+              << '\n';
+}
+
+
 }  // namespace utils
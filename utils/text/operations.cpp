@@ -28,6 +28,14 @@
 
 #include "utils/text/operations.ipp"
 
+#if defined(__SSE2__)
+#   include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#   include <arm_neon.h>
+#endif
+
+#include <cstdio>
+#include <cstring>
 #include <sstream>
 
 #include "utils/format/macros.hpp"
@@ -36,6 +44,214 @@
 namespace text = utils::text;
 
 
+namespace {
+
+
+/// Checks if a character might need to be escaped in XML.
+///
+/// This is a cheap superset of the characters that escape_xml_char() acts on
+/// so that the common case of plain text can be skipped over quickly.
+///
+/// \param c The character to check.
+///
+/// \return True if the character has to be inspected further.
+inline bool
+is_xml_candidate(const unsigned char c)
+{
+    return c < 0x20 || c > 0x7E || c == '"' || c == '&' || c == '\'' ||
+        c == '<' || c == '>';
+}
+
+
+/// Locates the next character that might need to be escaped in XML.
+///
+/// Whole blocks of the input are checked at once when the platform supports
+/// it, which is what makes escaping large test outputs cheap: these are
+/// mostly plain text with the occasional special character.
+///
+/// \param data The input to scan.
+/// \param pos The position in data at which to start scanning.
+/// \param size The length of data in bytes.
+///
+/// \return The position of the first candidate character at or after pos, or
+/// size if there is none.
+static std::size_t
+find_xml_candidate(const char* data, std::size_t pos, const std::size_t size)
+{
+#if defined(__SSE2__)
+    // The comparisons are signed, so the bytes at or above 0x80 are negative
+    // and thus caught by the less-than check.
+    const __m128i low = _mm_set1_epi8(0x20);
+    const __m128i high = _mm_set1_epi8(0x7E);
+    while (pos + 16 <= size) {
+        const __m128i block = _mm_loadu_si128(
+            reinterpret_cast< const __m128i* >(data + pos));
+        __m128i mask = _mm_or_si128(_mm_cmplt_epi8(block, low),
+                                    _mm_cmpgt_epi8(block, high));
+        mask = _mm_or_si128(mask, _mm_cmpeq_epi8(block, _mm_set1_epi8('"')));
+        mask = _mm_or_si128(mask, _mm_cmpeq_epi8(block, _mm_set1_epi8('&')));
+        mask = _mm_or_si128(mask, _mm_cmpeq_epi8(block, _mm_set1_epi8('\'')));
+        mask = _mm_or_si128(mask, _mm_cmpeq_epi8(block, _mm_set1_epi8('<')));
+        mask = _mm_or_si128(mask, _mm_cmpeq_epi8(block, _mm_set1_epi8('>')));
+        const int bits = _mm_movemask_epi8(mask);
+        if (bits != 0)
+            return pos + __builtin_ctz(bits);
+        pos += 16;
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    const uint8x16_t low = vdupq_n_u8(0x20);
+    const uint8x16_t high = vdupq_n_u8(0x7E);
+    while (pos + 16 <= size) {
+        const uint8x16_t block = vld1q_u8(
+            reinterpret_cast< const uint8_t* >(data + pos));
+        uint8x16_t mask = vorrq_u8(vcltq_u8(block, low),
+                                   vcgtq_u8(block, high));
+        mask = vorrq_u8(mask, vceqq_u8(block, vdupq_n_u8('"')));
+        mask = vorrq_u8(mask, vceqq_u8(block, vdupq_n_u8('&')));
+        mask = vorrq_u8(mask, vceqq_u8(block, vdupq_n_u8('\'')));
+        mask = vorrq_u8(mask, vceqq_u8(block, vdupq_n_u8('<')));
+        mask = vorrq_u8(mask, vceqq_u8(block, vdupq_n_u8('>')));
+        if (vmaxvq_u8(mask) != 0)
+            break;
+        pos += 16;
+    }
+#endif
+
+    for (; pos < size; ++pos) {
+        if (is_xml_candidate(static_cast< unsigned char >(data[pos])))
+            return pos;
+    }
+    return size;
+}
+
+
+/// Computes the escaped form of a single character in XML.
+///
+/// The list of XML special characters is specified here:
+///     http://www.w3.org/TR/xml11/#charsets
+///
+/// \param c The character to escape.
+/// \param [out] buffer Storage for the escaped form of the character.  Must be
+///     able to hold at least 16 bytes.
+///
+/// \return The length of the escaped form stored in buffer, or 0 if the
+/// character does not need to be escaped.
+static std::size_t
+escape_xml_char(const unsigned char c, char* buffer)
+{
+    const char* replacement;
+    if (c == '"') {
+        replacement = "&quot;";
+    } else if (c == '&') {
+        replacement = "&amp;";
+    } else if (c == '<') {
+        replacement = "&lt;";
+    } else if (c == '>') {
+        replacement = "&gt;";
+    } else if (c == '\'') {
+        replacement = "&apos;";
+    } else if ((c >= 0x01 && c <= 0x08) ||
+               (c >= 0x0B && c <= 0x0C) ||
+               (c >= 0x0E && c <= 0x1F) ||
+               (c >= 0x7F && c <= 0x84) ||
+               (c >= 0x86 && c <= 0x9F)) {
+        // for RestrictedChar characters, escape them
+        // as '&amp;#[decimal ASCII value];'
+        // so that in the XML file we will see the escaped
+        // character.
+        return static_cast< std::size_t >(
+            std::snprintf(buffer, 16, "&amp;#%u;", static_cast< unsigned >(c)));
+    } else {
+        return 0;
+    }
+    const std::size_t length = std::strlen(replacement);
+    std::memcpy(buffer, replacement, length);
+    return length;
+}
+
+
+/// Replaces XML special characters from a buffer and writes the result.
+///
+/// \tparam Sink The type of the output; must provide an append(const char*,
+///     std::size_t) method.
+/// \param data The input to quote.
+/// \param size The length of data in bytes.
+/// \param output The object into which to write the quoted input.
+template< class Sink >
+static void
+escape_xml_into(const char* data, const std::size_t size, Sink& output)
+{
+    std::size_t start = 0;
+    std::size_t pos = find_xml_candidate(data, 0, size);
+    while (pos < size) {
+        char buffer[16];
+        const std::size_t length = escape_xml_char(
+            static_cast< unsigned char >(data[pos]), buffer);
+        if (length > 0) {
+            output.append(data + start, pos - start);
+            output.append(buffer, length);
+            start = pos + 1;
+        }
+        pos = find_xml_candidate(data, pos + 1, size);
+    }
+    output.append(data + start, size - start);
+}
+
+
+/// Adapter to use an output stream as the sink of escape_xml_into().
+class stream_sink {
+    /// The stream to write to.
+    std::ostream& _output;
+
+public:
+    /// Constructor.
+    ///
+    /// \param output_ The stream to write to.
+    explicit stream_sink(std::ostream& output_) : _output(output_)
+    {
+    }
+
+    /// Writes a block of data to the stream.
+    ///
+    /// \param data The data to write.
+    /// \param size The length of data in bytes.
+    void
+    append(const char* data, const std::size_t size)
+    {
+        if (size > 0)
+            _output.write(data, size);
+    }
+};
+
+
+/// Stores a substring as the next element of a vector of words.
+///
+/// The element is overwritten in place if it already exists so that its
+/// storage is reused; otherwise, the vector is extended.
+///
+/// \param [in,out] words The vector of words being filled.
+/// \param [in,out] count The number of words stored so far in this pass.
+///     Incremented by one.
+/// \param str The string from which to extract the word.
+/// \param start The position of the word in str.
+/// \param length The length of the word.
+static void
+assign_word(std::vector< std::string >& words,
+            std::vector< std::string >::size_type& count,
+            const std::string& str, const std::string::size_type start,
+            const std::string::size_type length)
+{
+    if (count < words.size())
+        words[count].assign(str, start, length);
+    else
+        words.push_back(str.substr(start, length));
+    ++count;
+}
+
+
+}  // anonymous namespace
+
+
 /// Replaces XML special characters from an input string.
 ///
 /// The list of XML special characters is specified here:
@@ -47,37 +263,100 @@ namespace text = utils::text;
 std::string
 text::escape_xml(const std::string& in)
 {
-    std::ostringstream quoted;
+    std::string quoted;
+    quoted.reserve(in.length());
+    escape_xml(in.data(), in.length(), quoted);
+    return quoted;
+}
+
 
-    for (std::string::const_iterator it = in.begin();
-         it != in.end(); ++it) {
-        unsigned char c = (unsigned char)*it;
+/// Replaces XML special characters from a buffer and writes the result.
+///
+/// The escaping is done on a character basis, so a long input can be processed
+/// in arbitrary chunks with consecutive calls to this function.
+///
+/// \param data The input to quote.
+/// \param size The length of data in bytes.
+/// \param output The stream into which to write the quoted input.
+void
+text::escape_xml(const char* data, const std::size_t size,
+                 std::ostream& output)
+{
+    stream_sink sink(output);
+    escape_xml_into(data, size, sink);
+}
+
+
+/// Replaces XML special characters from a buffer and appends the result.
+///
+/// This is like the stream-based version but avoids the overhead of the
+/// stream when the caller accumulates the output in memory anyway.
+///
+/// \param data The input to quote.
+/// \param size The length of data in bytes.
+/// \param output The string to which to append the quoted input.
+void
+text::escape_xml(const char* data, const std::size_t size,
+                 std::string& output)
+{
+    escape_xml_into(data, size, output);
+}
+
+
+/// Escapes a string for its inclusion within a JSON string literal.
+///
+/// \param in The input to escape.
+///
+/// \return The escaped string, without the surrounding quotes.
+std::string
+text::escape_json(const std::string& in)
+{
+    std::ostringstream escaped;
+    escape_json(in.data(), in.length(), escaped);
+    return escaped.str();
+}
+
+
+/// Escapes a buffer for its inclusion within a JSON string literal.
+///
+/// JSON strings must be valid Unicode but the input can be arbitrary binary
+/// data, so every byte outside of the printable ASCII range is written as the
+/// code point of the same value; i.e. the input is treated as ISO-8859-1 text.
+/// The escaping is done on a character basis, so a long input can be processed
+/// in arbitrary chunks with consecutive calls to this function.
+///
+/// \param data The input to escape.
+/// \param size The length of data in bytes.
+/// \param output The stream into which to write the escaped input.
+void
+text::escape_json(const char* data, const std::size_t size,
+                  std::ostream& output)
+{
+    static const char hex_digits[] = "0123456789abcdef";
+
+    std::size_t start = 0;
+    for (std::size_t i = 0; i < size; ++i) {
+        const unsigned char c = static_cast< unsigned char >(data[i]);
+        if (c >= 0x20 && c < 0x7F && c != '"' && c != '\\')
+            continue;
+
+        output.write(data + start, i - start);
         if (c == '"') {
-            quoted << "&quot;";
-        } else if (c == '&') {
-            quoted << "&amp;";
-        } else if (c == '<') {
-            quoted << "&lt;";
-        } else if (c == '>') {
-            quoted << "&gt;";
-        } else if (c == '\'') {
-            quoted << "&apos;";
-        } else if ((c >= 0x01 && c <= 0x08) ||
-                   (c >= 0x0B && c <= 0x0C) ||
-                   (c >= 0x0E && c <= 0x1F) ||
-                   (c >= 0x7F && c <= 0x84) ||
-                   (c >= 0x86 && c <= 0x9F)) {
-            // for RestrictedChar characters, escape them
-            // as '&amp;#[decimal ASCII value];'
-            // so that in the XML file we will see the escaped
-            // character.
-            quoted << "&amp;#" << static_cast< std::string::size_type >(*it)
-                   << ";";
+            output << "\\\"";
+        } else if (c == '\\') {
+            output << "\\\\";
+        } else if (c == '\n') {
+            output << "\\n";
+        } else if (c == '\r') {
+            output << "\\r";
+        } else if (c == '\t') {
+            output << "\\t";
         } else {
-            quoted << *it;
+            output << "\\u00" << hex_digits[c >> 4] << hex_digits[c & 0x0F];
         }
+        start = i + 1;
     }
-    return quoted.str();
+    output.write(data + start, size - start);
 }
 
 
@@ -122,6 +401,27 @@ std::vector< std::string >
 text::refill(const std::string& input, const std::size_t target_width)
 {
     std::vector< std::string > output;
+    refill(input, target_width, output);
+    return output;
+}
+
+
+/// Fills a paragraph to the specified length into an existing vector.
+///
+/// See the documentation for refill() for additional details.  This variant
+/// is meant for callers that refill many paragraphs in a row: the strings
+/// already in output are overwritten in place, so their storage is reused
+/// across calls.
+///
+/// \param input The string to refill.
+/// \param target_width The width to refill the paragraph to.
+/// \param [out] output The refilled paragraph as a sequence of independent
+///     lines.  Any previous contents are replaced.
+void
+text::refill(const std::string& input, const std::size_t target_width,
+             std::vector< std::string >& output)
+{
+    std::vector< std::string >::size_type count = 0;
 
     std::string::size_type start = 0;
     while (start < input.length()) {
@@ -148,17 +448,17 @@ text::refill(const std::string& input, const std::size_t target_width)
         INV(width != std::string::npos);
         INV(start + width <= input.length());
         INV(input[start + width] == ' ' || input[start + width] == '\0');
-        output.push_back(input.substr(start, width));
+        assign_word(output, count, input, start, width);
 
         start += width + 1;
     }
 
     if (input.empty()) {
-        INV(output.empty());
-        output.push_back("");
+        INV(count == 0);
+        assign_word(output, count, input, 0, 0);
     }
 
-    return output;
+    output.resize(count);
 }
 
 
@@ -189,16 +489,30 @@ text::replace_all(const std::string& input, const std::string& search,
                   const std::string& replacement)
 {
     std::string output;
+    output.reserve(input.length());
+    replace_all(input, search, replacement, output);
+    return output;
+}
 
+
+/// Replaces all occurrences of a substring in a string into a buffer.
+///
+/// \param input The string in which to perform the replacement.
+/// \param search The pattern to be replaced.
+/// \param replacement The substring to replace search with.
+/// \param [in,out] output The string to which to append the input with the
+///     replacements performed.
+void
+text::replace_all(const std::string& input, const std::string& search,
+                  const std::string& replacement, std::string& output)
+{
     std::string::size_type pos, lastpos = 0;
     while ((pos = input.find(search, lastpos)) != std::string::npos) {
-        output += input.substr(lastpos, pos - lastpos);
-        output += replacement;
+        output.append(input, lastpos, pos - lastpos);
+        output.append(replacement);
         lastpos = pos + search.length();
     }
-    output += input.substr(lastpos);
-
-    return output;
+    output.append(input, lastpos, std::string::npos);
 }
 
 
@@ -213,17 +527,35 @@ std::vector< std::string >
 text::split(const std::string& str, const char delimiter)
 {
     std::vector< std::string > words;
+    split(str, delimiter, words);
+    return words;
+}
+
+
+/// Splits a string into different components into an existing vector.
+///
+/// The strings already in words are overwritten in place, so splitting many
+/// strings in a row with the same vector reuses their storage.
+///
+/// \param str The string to split.
+/// \param delimiter The separator to use to split the words.
+/// \param [out] words The different words in the input string as split by
+///     the provided delimiter.  Any previous contents are replaced.
+void
+text::split(const std::string& str, const char delimiter,
+            std::vector< std::string >& words)
+{
+    std::vector< std::string >::size_type count = 0;
     if (!str.empty()) {
-        std::string::size_type pos = str.find(delimiter);
-        words.push_back(str.substr(0, pos));
-        while (pos != std::string::npos) {
-            ++pos;
-            const std::string::size_type next = str.find(delimiter, pos);
-            words.push_back(str.substr(pos, next - pos));
-            pos = next;
+        std::string::size_type start = 0;
+        std::string::size_type pos;
+        while ((pos = str.find(delimiter, start)) != std::string::npos) {
+            assign_word(words, count, str, start, pos - start);
+            start = pos + 1;
         }
+        assign_word(words, count, str, start, str.length() - start);
     }
-    return words;
+    words.resize(count);
 }
 
 
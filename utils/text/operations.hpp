@@ -33,6 +33,7 @@
 #define UTILS_TEXT_OPERATIONS_HPP
 
 #include <cstddef>
+#include <ostream>
 #include <string>
 #include <vector>
 
@@ -41,18 +42,26 @@ namespace text {
 
 
 std::string escape_xml(const std::string&);
+void escape_xml(const char*, const std::size_t, std::ostream&);
+void escape_xml(const char*, const std::size_t, std::string&);
+std::string escape_json(const std::string&);
+void escape_json(const char*, const std::size_t, std::ostream&);
 std::string quote(const std::string&, const char);
 
 
 std::vector< std::string > refill(const std::string&, const std::size_t);
+void refill(const std::string&, const std::size_t, std::vector< std::string >&);
 std::string refill_as_string(const std::string&, const std::size_t);
 
 std::string replace_all(const std::string&, const std::string&,
                         const std::string&);
+void replace_all(const std::string&, const std::string&, const std::string&,
+                 std::string&);
 
 template< typename Collection >
 std::string join(const Collection&, const std::string&);
 std::vector< std::string > split(const std::string&, const char);
+void split(const std::string&, const char, std::vector< std::string >&);
 
 template< typename Type >
 Type to_type(const std::string&);
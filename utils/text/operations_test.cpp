@@ -28,8 +28,10 @@
 
 #include "utils/text/operations.ipp"
 
+#include <algorithm>
 #include <iostream>
 #include <set>
+#include <sstream>
 #include <string>
 #include <vector>
 
@@ -96,6 +98,84 @@ ATF_TEST_CASE_BODY(escape_xml__some_escaping)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(escape_xml__high_bytes);
+ATF_TEST_CASE_BODY(escape_xml__high_bytes)
+{
+    ATF_REQUIRE_EQ("&amp;#128;&amp;#159;", text::escape_xml("\x80\x9f"));
+    ATF_REQUIRE_EQ("\x85\xa0\xff", text::escape_xml("\x85\xa0\xff"));
+    ATF_REQUIRE_EQ("caf\xc3\xa9", text::escape_xml("caf\xc3\xa9"));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(escape_xml__long_input);
+ATF_TEST_CASE_BODY(escape_xml__long_input)
+{
+    const std::string plain(100, 'x');
+    ATF_REQUIRE_EQ(plain, text::escape_xml(plain));
+
+    // Place a special character at every position to exercise the boundaries
+    // of the blocks that are scanned at once.
+    for (std::string::size_type i = 0; i < plain.length(); ++i) {
+        std::string input = plain;
+        input[i] = '<';
+        const std::string expected = plain.substr(0, i) + "&lt;" +
+            plain.substr(i + 1);
+        ATF_REQUIRE_EQ(expected, text::escape_xml(input));
+    }
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(escape_xml__string);
+ATF_TEST_CASE_BODY(escape_xml__string)
+{
+    const std::string input = "foo \"bar& <tag>\b yay' baz";
+
+    std::string output = "prefix: ";
+    text::escape_xml(input.data(), input.length(), output);
+    ATF_REQUIRE_EQ("prefix: " + text::escape_xml(input), output);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(escape_xml__stream);
+ATF_TEST_CASE_BODY(escape_xml__stream)
+{
+    const std::string input = "foo \"bar& <tag>\b yay' baz";
+
+    std::ostringstream whole;
+    text::escape_xml(input.data(), input.length(), whole);
+    ATF_REQUIRE_EQ(text::escape_xml(input), whole.str());
+
+    std::ostringstream chunked;
+    for (std::string::size_type i = 0; i < input.length(); i += 3)
+        text::escape_xml(input.data() + i, std::min(std::string::size_type(3),
+                                                    input.length() - i),
+                         chunked);
+    ATF_REQUIRE_EQ(text::escape_xml(input), chunked.str());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(escape_json__no_escaping);
+ATF_TEST_CASE_BODY(escape_json__no_escaping)
+{
+    ATF_REQUIRE_EQ("", text::escape_json(""));
+    ATF_REQUIRE_EQ("Some text! <tag> & 'quotes'",
+                   text::escape_json("Some text! <tag> & 'quotes'"));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(escape_json__some_escaping);
+ATF_TEST_CASE_BODY(escape_json__some_escaping)
+{
+    ATF_REQUIRE_EQ("a\\\"b\\\\c", text::escape_json("a\"b\\c"));
+    ATF_REQUIRE_EQ("\\u0008\\u000c\\n\\r\\t",
+                   text::escape_json("\b\f\n\r\t"));
+    ATF_REQUIRE_EQ("\\u0001\\u001f\\u007f\\u00e9",
+                   text::escape_json("\x01\x1f\x7f\xe9"));
+    ATF_REQUIRE_EQ("nul\\u0000byte",
+                   text::escape_json(std::string("nul\0byte", 8)));
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(quote__empty);
 ATF_TEST_CASE_BODY(quote__empty)
 {
@@ -212,6 +292,26 @@ ATF_TEST_CASE_BODY(refill__preserve_whitespace)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(refill__reuse_output);
+ATF_TEST_CASE_BODY(refill__reuse_output)
+{
+    std::vector< std::string > lines(5, "stale contents");
+
+    text::refill("foo bar baz", 5, lines);
+    ATF_REQUIRE_EQ(3, lines.size());
+    ATF_REQUIRE_EQ("foo", lines[0]);
+    ATF_REQUIRE_EQ("bar", lines[1]);
+    ATF_REQUIRE_EQ("baz", lines[2]);
+
+    text::refill("", 5, lines);
+    ATF_REQUIRE_EQ(1, lines.size());
+    ATF_REQUIRE_EQ("", lines[0]);
+
+    text::refill("a b c d e f", 1, lines);
+    ATF_REQUIRE(text::refill("a b c d e f", 1) == lines);
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(join__empty);
 ATF_TEST_CASE_BODY(join__empty)
 {
@@ -302,6 +402,26 @@ ATF_TEST_CASE_BODY(split__several__delimiters)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(split__reuse_output);
+ATF_TEST_CASE_BODY(split__reuse_output)
+{
+    std::vector< std::string > words;
+
+    text::split("first second third", ' ', words);
+    ATF_REQUIRE(text::split("first second third", ' ') == words);
+
+    text::split("a", ' ', words);
+    ATF_REQUIRE_EQ(1, words.size());
+    ATF_REQUIRE_EQ("a", words[0]);
+
+    text::split("", ' ', words);
+    ATF_REQUIRE(words.empty());
+
+    text::split("XfooXXbar", 'X', words);
+    ATF_REQUIRE(text::split("XfooXXbar", 'X') == words);
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(replace_all__empty);
 ATF_TEST_CASE_BODY(replace_all__empty)
 {
@@ -336,6 +456,17 @@ ATF_TEST_CASE_BODY(replace_all__several)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(replace_all__append);
+ATF_TEST_CASE_BODY(replace_all__append)
+{
+    std::string output = "prefix: ";
+    text::replace_all("oo foo bar", "oo", "OO", output);
+    ATF_REQUIRE_EQ("prefix: OO fOO bar", output);
+    text::replace_all("", "oo", "OO", output);
+    ATF_REQUIRE_EQ("prefix: OO fOO bar", output);
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(to_type__ok__bool);
 ATF_TEST_CASE_BODY(to_type__ok__bool)
 {
@@ -398,6 +529,13 @@ ATF_INIT_TEST_CASES(tcs)
     ATF_ADD_TEST_CASE(tcs, escape_xml__empty);
     ATF_ADD_TEST_CASE(tcs, escape_xml__no_escaping);
     ATF_ADD_TEST_CASE(tcs, escape_xml__some_escaping);
+    ATF_ADD_TEST_CASE(tcs, escape_xml__high_bytes);
+    ATF_ADD_TEST_CASE(tcs, escape_xml__long_input);
+    ATF_ADD_TEST_CASE(tcs, escape_xml__string);
+    ATF_ADD_TEST_CASE(tcs, escape_xml__stream);
+
+    ATF_ADD_TEST_CASE(tcs, escape_json__no_escaping);
+    ATF_ADD_TEST_CASE(tcs, escape_json__some_escaping);
 
     ATF_ADD_TEST_CASE(tcs, quote__empty);
     ATF_ADD_TEST_CASE(tcs, quote__no_escaping);
@@ -410,6 +548,7 @@ ATF_INIT_TEST_CASES(tcs)
     ATF_ADD_TEST_CASE(tcs, refill__break_many);
     ATF_ADD_TEST_CASE(tcs, refill__cannot_break);
     ATF_ADD_TEST_CASE(tcs, refill__preserve_whitespace);
+    ATF_ADD_TEST_CASE(tcs, refill__reuse_output);
 
     ATF_ADD_TEST_CASE(tcs, join__empty);
     ATF_ADD_TEST_CASE(tcs, join__one);
@@ -420,11 +559,13 @@ ATF_INIT_TEST_CASES(tcs)
     ATF_ADD_TEST_CASE(tcs, split__one);
     ATF_ADD_TEST_CASE(tcs, split__several__simple);
     ATF_ADD_TEST_CASE(tcs, split__several__delimiters);
+    ATF_ADD_TEST_CASE(tcs, split__reuse_output);
 
     ATF_ADD_TEST_CASE(tcs, replace_all__empty);
     ATF_ADD_TEST_CASE(tcs, replace_all__none);
     ATF_ADD_TEST_CASE(tcs, replace_all__one);
     ATF_ADD_TEST_CASE(tcs, replace_all__several);
+    ATF_ADD_TEST_CASE(tcs, replace_all__append);
 
     ATF_ADD_TEST_CASE(tcs, to_type__ok__bool);
     ATF_ADD_TEST_CASE(tcs, to_type__ok__numerical);
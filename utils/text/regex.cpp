@@ -34,7 +34,11 @@ extern "C" {
 #include <regex.h>
 }
 
-#include "utils/auto_array.ipp"
+#include <list>
+#include <map>
+#include <utility>
+#include <vector>
+
 #include "utils/defs.hpp"
 #include "utils/format/macros.hpp"
 #include "utils/noncopyable.hpp"
@@ -84,20 +88,25 @@ struct utils::text::regex_matches::impl : utils::noncopyable {
     /// input string outlasts the lifecycle of the regex_matches.  However, that
     /// contract is very easy to break with hardcoded strings (as we do in
     /// tests).  Just go for the safer case here.
-    const std::string _string;
+    std::string _string;
 
-    /// Maximum number of matching groups we expect, including the full match.
+    /// Native regular expression match representation.
     ///
-    /// In other words, this is the size of the _matches array.
-    const std::size_t _nmatches;
+    /// The size of this vector is the maximum number of matching groups we
+    /// expect, including the full match.  Its storage is kept across calls to
+    /// exec() so that reusing this object does not allocate memory.
+    std::vector< ::regmatch_t > _matches;
 
-    /// Native regular expression match representation.
-    utils::auto_array< ::regmatch_t > _matches;
+    /// Whether the last call to exec() matched the string.
+    bool _matched;
 
-    /// Constructor.
-    ///
-    /// This executes the regex on the given string and sets up the internal
-    /// class state based on the results.
+    /// Constructor for an object that holds no matches.
+    impl(void) :
+        _matched(false)
+    {
+    }
+
+    /// Executes a regex on a string and records the results.
     ///
     /// \param preg The native regex object.
     /// \param str The string on which to execute the regex.
@@ -105,26 +114,23 @@ struct utils::text::regex_matches::impl : utils::noncopyable {
     ///     bound and may be greater than the actual matches.
     ///
     /// \throw regex_error If the call to regexec(3) fails.
-    impl(const ::regex_t* preg, const std::string& str,
-         const std::size_t ngroups) :
-        _string(str),
-        _nmatches(ngroups + 1),
-        _matches(new ::regmatch_t[_nmatches])
+    void
+    exec(const ::regex_t* preg, const std::string& str,
+         const std::size_t ngroups)
     {
-        const int error = ::regexec(preg, _string.c_str(), _nmatches,
-                                    _matches.get(), 0);
-        if (error == REG_NOMATCH) {
-            _matches.reset(NULL);
-        } else if (error != 0) {
+        _string = str;
+        _matches.resize(ngroups + 1);
+        _matched = false;
+
+        const int error = ::regexec(preg, _string.c_str(), _matches.size(),
+                                    &_matches[0], 0);
+        if (error == 0) {
+            _matched = true;
+        } else if (error != REG_NOMATCH) {
             throw_regex_error(error, preg,
                               F("regexec on '%s' failed") % _string);
         }
     }
-
-    /// Destructor.
-    ~impl(void)
-    {
-    }
 };
 
 
@@ -137,6 +143,15 @@ text::regex_matches::regex_matches(std::shared_ptr< impl > pimpl) :
 }
 
 
+/// Constructs an object without matches.
+///
+/// This is meant to be passed to regex::match() to be filled in.
+text::regex_matches::regex_matches(void) :
+    _pimpl(new impl())
+{
+}
+
+
 /// Destructor.
 text::regex_matches::~regex_matches(void)
 {
@@ -154,12 +169,12 @@ std::size_t
 text::regex_matches::count(void) const
 {
     std::size_t total = 0;
-    if (_pimpl->_matches.get() != NULL) {
-        for (std::size_t i = 0; i < _pimpl->_nmatches; ++i) {
+    if (_pimpl->_matched) {
+        for (std::size_t i = 0; i < _pimpl->_matches.size(); ++i) {
             if (_pimpl->_matches[i].rm_so != -1)
                 ++total;
         }
-        INV(total <= _pimpl->_nmatches);
+        INV(total <= _pimpl->_matches.size());
     }
     return total;
 }
@@ -192,7 +207,7 @@ text::regex_matches::get(const std::size_t index) const
 /// \return True if the object contains one or more matches; false otherwise.
 text::regex_matches::operator bool(void) const
 {
-    return _pimpl->_matches.get() != NULL;
+    return _pimpl->_matched;
 }
 
 
@@ -269,6 +284,76 @@ text::regex::compile(const std::string& regex_, const std::size_t ngroups,
 }
 
 
+namespace {
+
+
+/// Maximum number of compiled regular expressions kept by compile_cached().
+const std::size_t cache_capacity = 64;
+
+
+/// Identifies a compiled regular expression: its text, its number of capture
+/// groups and whether it ignores case.
+typedef std::pair< std::string, std::pair< std::size_t, bool > > cache_key;
+
+
+/// Compiled regular expressions, from the most to the least recently used.
+typedef std::list< std::pair< cache_key, text::regex > > cache_list;
+
+
+/// Index of the entries of a cache_list by their key.
+typedef std::map< cache_key, cache_list::iterator > cache_index;
+
+
+/// The cached regular expressions in LRU order.
+static cache_list compiled_lru;
+
+
+/// Index to locate the cached regular expressions in compiled_lru.
+static cache_index compiled_index;
+
+
+}  // anonymous namespace
+
+
+/// Compiles a regular expression or reuses a previous compilation of it.
+///
+/// Compiled regular expressions are kept in a process-wide cache of limited
+/// size, from which the least recently used ones are evicted.  This is meant
+/// for callers that would otherwise compile the same expressions repeatedly.
+///
+/// \param regex_ The regular expression to compile.
+/// \param ngroups Number of capture groups in the regular expression.  This is
+///     an upper bound and does NOT include the default full string match.
+/// \param ignore_case Whether to ignore case during matching.
+///
+/// \return A regular expression, ready to match strings.
+///
+/// \throw regex_error If the regular expression is invalid and cannot be
+///     compiled.  Invalid expressions are not cached.
+text::regex
+text::regex::compile_cached(const std::string& regex_,
+                            const std::size_t ngroups, const bool ignore_case)
+{
+    const cache_key key(regex_, std::make_pair(ngroups, ignore_case));
+
+    const cache_index::iterator iter = compiled_index.find(key);
+    if (iter != compiled_index.end()) {
+        compiled_lru.splice(compiled_lru.begin(), compiled_lru,
+                            (*iter).second);
+        return (*iter).second->second;
+    }
+
+    const regex compiled = compile(regex_, ngroups, ignore_case);
+    compiled_lru.push_front(std::make_pair(key, compiled));
+    compiled_index[key] = compiled_lru.begin();
+    if (compiled_lru.size() > cache_capacity) {
+        compiled_index.erase(compiled_lru.back().first);
+        compiled_lru.pop_back();
+    }
+    return compiled;
+}
+
+
 /// Matches the regular expression against a string.
 ///
 /// \param str String to match the regular expression against.
@@ -277,16 +362,38 @@ text::regex::compile(const std::string& regex_, const std::size_t ngroups,
 text::regex_matches
 text::regex::match(const std::string& str) const
 {
-    std::shared_ptr< regex_matches::impl > pimpl(new regex_matches::impl(
-        &_pimpl->_preg, str, _pimpl->_ngroups));
-    return regex_matches(pimpl);
+    regex_matches matches;
+    (void)match(str, matches);
+    return matches;
+}
+
+
+/// Matches the regular expression against a string into an existing object.
+///
+/// Reusing the same matches object across calls avoids allocating memory for
+/// every match, which matters when matching many strings in a loop.
+///
+/// \param str String to match the regular expression against.
+/// \param [out] matches The object in which to store the results of the
+///     match.  Any copies of it made before this call are not modified.
+///
+/// \return True if the regular expression matched the string.
+bool
+text::regex::match(const std::string& str, regex_matches& matches) const
+{
+    if (matches._pimpl.use_count() != 1)
+        matches._pimpl.reset(new regex_matches::impl());
+    matches._pimpl->exec(&_pimpl->_preg, str, _pimpl->_ngroups);
+    return matches;
 }
 
 
 /// Compiles and matches a regular expression once.
 ///
 /// This is syntactic sugar to simplify the instantiation of a new regex object
-/// and its subsequent match on a string.
+/// and its subsequent match on a string.  The compiled regex is kept in the
+/// cache of compile_cached(), so matching the same expression again does not
+/// recompile it.
 ///
 /// \param regex_ The regular expression to compile and match.
 /// \param str String to match the regular expression against.
@@ -298,5 +405,5 @@ text::regex_matches
 text::match_regex(const std::string& regex_, const std::string& str,
                   const std::size_t ngroups, const bool ignore_case)
 {
-    return regex::compile(regex_, ngroups, ignore_case).match(str);
+    return regex::compile_cached(regex_, ngroups, ignore_case).match(str);
 }
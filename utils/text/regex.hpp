@@ -35,6 +35,7 @@
 #include "utils/text/regex_fwd.hpp"
 
 #include <cstddef>
+#include <string>
 
 #include "utils/shared_ptr.hpp"
 
@@ -53,6 +54,7 @@ class regex_matches {
     regex_matches(std::shared_ptr< impl >);
 
 public:
+    regex_matches(void);
     ~regex_matches(void);
 
     std::size_t count(void) const;
@@ -78,7 +80,10 @@ public:
 
     static regex compile(const std::string&, const std::size_t,
                          const bool = false);
+    static regex compile_cached(const std::string&, const std::size_t,
+                                const bool = false);
     regex_matches match(const std::string&) const;
+    bool match(const std::string&, regex_matches&) const;
 };
 
 
@@ -28,6 +28,8 @@
 
 #include "utils/text/regex.hpp"
 
+#include <string>
+
 #include <atf-c++.hpp>
 
 #include "utils/text/exceptions.hpp"
@@ -153,6 +155,59 @@ ATF_TEST_CASE_BODY(integration__ignore_case)
     ATF_REQUIRE( text::match_regex("foo", "bar FOO bar", 0, true));
 }
 
+ATF_TEST_CASE_WITHOUT_HEAD(integration__reuse_matches);
+ATF_TEST_CASE_BODY(integration__reuse_matches)
+{
+    const text::regex regex = text::regex::compile("number is ([0-9]+)", 1);
+
+    text::regex_matches matches;
+    ATF_REQUIRE(!matches);
+    ATF_REQUIRE_EQ(0, matches.count());
+
+    ATF_REQUIRE(regex.match("my number is 581.", matches));
+    ATF_REQUIRE_EQ(2, matches.count());
+    ATF_REQUIRE_EQ("581", matches.get(1));
+    const text::regex_matches copy = matches;
+
+    ATF_REQUIRE(!regex.match("no numbers here", matches));
+    ATF_REQUIRE(!matches);
+    ATF_REQUIRE_EQ(0, matches.count());
+
+    ATF_REQUIRE(regex.match("your number is 6", matches));
+    ATF_REQUIRE_EQ("6", matches.get(1));
+
+    // Copies taken before reusing the object must not be affected.
+    ATF_REQUIRE(copy);
+    ATF_REQUIRE_EQ("581", copy.get(1));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(integration__compile_cached);
+ATF_TEST_CASE_BODY(integration__compile_cached)
+{
+    for (int i = 0; i < 3; ++i) {
+        const text::regex regex = text::regex::compile_cached("a([0-9])", 1);
+        const text::regex_matches matches = regex.match("xa7");
+        ATF_REQUIRE(matches);
+        ATF_REQUIRE_EQ("7", matches.get(1));
+    }
+
+    // The same text with different flags must not share a cache entry.
+    ATF_REQUIRE(!text::regex::compile_cached("abc", 0).match("ABC"));
+    ATF_REQUIRE(text::regex::compile_cached("abc", 0, true).match("ABC"));
+
+    // Evicted entries are compiled again on demand.
+    for (int i = 0; i < 100; ++i)
+        (void)text::match_regex(std::string(i + 1, 'x'), "xxx", 0);
+    ATF_REQUIRE(text::regex::compile_cached("a([0-9])", 1).match("a1"));
+
+    // Invalid expressions fail every time rather than being cached.
+    for (int i = 0; i < 2; ++i)
+        ATF_REQUIRE_THROW(text::regex_error,
+                          text::regex::compile_cached("(unbalanced", 0));
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(integration__invalid_regex);
 ATF_TEST_CASE_BODY(integration__invalid_regex)
 {
@@ -173,5 +228,7 @@ ATF_INIT_TEST_CASES(tcs)
     ATF_ADD_TEST_CASE(tcs, integration__capture_groups_overspecified);
     ATF_ADD_TEST_CASE(tcs, integration__reuse_regex_in_multiple_matches);
     ATF_ADD_TEST_CASE(tcs, integration__ignore_case);
+    ATF_ADD_TEST_CASE(tcs, integration__reuse_matches);
+    ATF_ADD_TEST_CASE(tcs, integration__compile_cached);
     ATF_ADD_TEST_CASE(tcs, integration__invalid_regex);
 }
@@ -167,13 +167,15 @@ pad_cell(const std::string& input, const std::size_t length, const bool is_last)
 /// \param [in,out] textual_rows The output lines as processed so far.  This is
 ///     updated to accomodate for the contents of the refilled cell, extending
 ///     the rows as necessary.
+/// \param [in,out] rows Scratch space for the lines of the refilled cell,
+///     reused across the cells of a row to avoid reallocating them.
 static void
 refill_cell(const text::table_row& row, const text::widths_vector& widths,
             const text::table_row::size_type column,
-            std::vector< text::table_row >& textual_rows)
+            std::vector< text::table_row >& textual_rows,
+            std::vector< std::string >& rows)
 {
-    const std::vector< std::string > rows = text::refill(row[column],
-                                                         widths[column]);
+    text::refill(row[column], widths[column], rows);
 
     if (textual_rows.size() < rows.size())
         textual_rows.resize(rows.size(), text::table_row(row.size()));
@@ -208,13 +210,14 @@ format_row(const text::table_row& row, const text::widths_vector& widths,
     PRE(row.size() == widths.size());
 
     std::vector< text::table_row > textual_rows(1, text::table_row(row.size()));
+    std::vector< std::string > refilled;
 
     for (text::table_row::size_type column = 0; column < row.size(); ++column) {
         if (widths[column] > row[column].length())
             textual_rows[0][column] = pad_cell(row[column], widths[column],
                                                column == row.size() - 1);
         else
-            refill_cell(row, widths, column, textual_rows);
+            refill_cell(row, widths, column, textual_rows, refilled);
     }
 
     std::vector< std::string > lines;
@@ -29,9 +29,12 @@
 #include "utils/text/templates.hpp"
 
 #include <algorithm>
+#include <cstddef>
 #include <fstream>
+#include <map>
 #include <sstream>
 #include <stack>
+#include <vector>
 
 #include "utils/format/macros.hpp"
 #include "utils/fs/path.hpp"
@@ -203,6 +206,84 @@ public:
 statement_def::types_map statement_def::_types;
 
 
+/// Definition of an expression.
+///
+/// An expression is the text found between a pair of delimiters in the input,
+/// or the argument to a conditional.  This class provides a mechanism to parse
+/// the textual expression into its components.
+struct expression_def {
+    /// Types of the known expressions.
+    enum expression_type {
+        /// Value of a variable, as in 'name'.
+        type_variable,
+
+        /// Existence of a variable or vector, as in 'defined(name)'.
+        type_defined,
+
+        /// Number of elements in a vector, as in 'length(name)'.
+        type_length,
+
+        /// Value of a vector at a position, as in 'name(index)'.
+        type_index,
+    };
+
+    /// The type of the expression.
+    expression_type type;
+
+    /// The name of the variable or vector the expression refers to.
+    std::string name;
+
+    /// The name of the variable holding the index; only for type_index.
+    std::string index;
+
+    /// Creates a new expression.
+    ///
+    /// \param type_ The type of the expression.
+    /// \param name_ The name of the variable or vector being queried.
+    /// \param index_ The name of the index variable, if any.
+    expression_def(const expression_type type_, const std::string& name_,
+                   const std::string& index_) :
+        type(type_), name(name_), index(index_)
+    {
+    }
+
+    /// Parses an expression.
+    ///
+    /// \param expression The textual representation of the expression without
+    ///     any delimiters.
+    ///
+    /// \return The parsed expression.
+    ///
+    /// \throw text::syntax_error If the expression is not correctly defined.
+    static expression_def
+    parse(const std::string& expression)
+    {
+        const std::string::size_type paren_open = expression.find('(');
+        if (paren_open == std::string::npos)
+            return expression_def(type_variable, expression, "");
+
+        const std::string::size_type paren_close = expression.find(
+            ')', paren_open);
+        if (paren_close == std::string::npos)
+            throw text::syntax_error(F("Expected ')' in expression '%s')") %
+                                     expression);
+        if (paren_close != expression.length() - 1)
+            throw text::syntax_error(F("Unexpected text found after ')' in "
+                                       "expression '%s'") % expression);
+
+        const std::string arg0 = expression.substr(0, paren_open);
+        const std::string arg1 = expression.substr(
+            paren_open + 1, paren_close - paren_open - 1);
+        if (arg0 == "defined")
+            return expression_def(type_defined, arg1, "");
+        else if (arg0 == "length")
+            return expression_def(type_length, arg1, "");
+        else
+            return expression_def(type_index, arg0, arg1);
+    }
+};
+
+
 /// Definition of a loop.
 ///
 /// This simple structure is used to keep track of the parameters of a loop.
@@ -522,6 +603,659 @@ public:
 };
 
 
+/// Reference to an identifier from a compiled template.
+struct operand_def {
+    /// The name of the identifier, used to report errors.
+    std::string name;
+
+    /// Whether the identifier refers to the iterator of an enclosing loop.
+    bool is_iterator;
+
+    /// Depth of the loop if is_iterator is true; slot of the symbol otherwise.
+    std::size_t id;
+
+    /// Constructs an empty operand; to be filled in by the compiler.
+    operand_def(void) : is_iterator(false), id(0)
+    {
+    }
+};
+
+
+/// Expression with its identifiers resolved to slots.
+struct compiled_expression {
+    /// The type of the expression.
+    expression_def::expression_type type;
+
+    /// The variable or vector the expression refers to.
+    operand_def name;
+
+    /// The variable holding the index; only for type_index.
+    operand_def index;
+
+    /// Constructs an empty expression; to be filled in by the compiler.
+    compiled_expression(void) : type(expression_def::type_variable)
+    {
+    }
+};
+
+
+/// Piece of output text, optionally followed by an expression.
+struct segment_def {
+    /// Literal text to emit.
+    std::string text;
+
+    /// Whether the text is followed by the value of an expression.
+    bool has_expression;
+
+    /// The expression to emit after the text, if has_expression is true.
+    compiled_expression expression;
+
+    /// Constructs a new segment with literal text only.
+    ///
+    /// \param text_ The literal text.
+    explicit segment_def(const std::string& text_) :
+        text(text_), has_expression(false)
+    {
+    }
+};
+
+
+/// Single step of a compiled template.
+struct instruction_def {
+    /// Types of the known instructions.
+    enum opcode {
+        /// Emits the segments.
+        op_print,
+
+        /// Jumps to target if the condition evaluates to false.
+        op_if,
+
+        /// Jumps to target unconditionally.
+        op_jump,
+
+        /// Starts a loop; jumps to target if the vector is empty.
+        op_loop,
+
+        /// Ends a loop; jumps to target if there are iterations left.
+        op_endloop,
+    };
+
+    /// The type of the instruction.
+    opcode op;
+
+    /// Text and expressions to emit; only for op_print.
+    std::vector< segment_def > segments;
+
+    /// Condition to evaluate; only for op_if.
+    compiled_expression condition;
+
+    /// Vector to iterate over; only for op_loop and op_endloop.
+    operand_def vector;
+
+    /// Nesting level of the loop; only for op_loop and op_endloop.
+    std::size_t depth;
+
+    /// Index of the instruction to jump to.
+    std::size_t target;
+
+    /// Constructs a new instruction.
+    ///
+    /// \param op_ The type of the instruction.
+    explicit instruction_def(const opcode op_) : op(op_), depth(0), target(0)
+    {
+    }
+};
+
+
+/// Instruction list of a compiled template.
+struct program_def {
+    /// Names of all the global identifiers, indexed by their slot.
+    std::vector< std::string > symbols;
+
+    /// The instructions to execute, in order.
+    std::vector< instruction_def > instructions;
+
+    /// Maximum nesting level of loops.
+    std::size_t loop_depth;
+
+    /// Constructs an empty program.
+    program_def(void) : loop_depth(0)
+    {
+    }
+};
+
+
+/// Stateful class to compile the templates in an input stream.
+///
+/// The syntax accepted by the compiler is the same one accepted by
+/// templates_parser, except that the structure of the whole document is
+/// validated upfront and that statements cannot contain expressions.
+class templates_compiler : utils::noncopyable {
+    /// Conditional or loop that has not been closed yet.
+    struct block_def {
+        /// The statement that opened the block.
+        statement_def::statement_type type;
+
+        /// Index of the instruction that opened the block.
+        std::size_t start;
+
+        /// Index of the jump emitted for an else clause, or 0 if none.
+        std::size_t jump;
+
+        /// Nesting level of the loop; only for loops.
+        std::size_t depth;
+
+        /// Name of the iterator defined by the loop; only for loops.
+        std::string iterator;
+
+        /// Constructs a new block.
+        ///
+        /// \param type_ The statement that opened the block.
+        /// \param start_ Index of the instruction that opened the block.
+        block_def(const statement_def::statement_type type_,
+                  const std::size_t start_) :
+            type(type_), start(start_), jump(0), depth(0)
+        {
+        }
+    };
+
+    /// The program being generated.
+    program_def& _program;
+
+    /// Prefix that marks a line as a statement.
+    const std::string _prefix;
+
+    /// Delimiter to surround an expression instantiation.
+    const std::string _delimiter;
+
+    /// Mapping of global identifiers to their slots in the program.
+    std::map< std::string, std::size_t > _slots;
+
+    /// Blocks enclosing the current point, the innermost last.
+    std::vector< block_def > _blocks;
+
+    /// Current count of nested loops.
+    std::size_t _loop_level;
+
+    /// Whether new text can be appended to the last instruction.
+    ///
+    /// This is false after any statement, as the next instruction may be the
+    /// target of a jump.
+    bool _can_append;
+
+    /// Resolves an identifier to an iterator or a global slot.
+    ///
+    /// \param name The identifier to resolve.
+    /// \param allow_iterator Whether the identifier may refer to an iterator.
+    ///
+    /// \return The resolved operand.
+    operand_def
+    resolve(const std::string& name, const bool allow_iterator)
+    {
+        operand_def operand;
+        operand.name = name;
+
+        if (allow_iterator) {
+            for (std::vector< block_def >::const_reverse_iterator iter =
+                     _blocks.rbegin(); iter != _blocks.rend(); ++iter) {
+                if ((*iter).type == statement_def::type_loop &&
+                    (*iter).iterator == name) {
+                    operand.is_iterator = true;
+                    operand.id = (*iter).depth;
+                    return operand;
+                }
+            }
+        }
+
+        const std::map< std::string, std::size_t >::const_iterator iter =
+            _slots.find(name);
+        if (iter == _slots.end()) {
+            operand.id = _program.symbols.size();
+            _slots[name] = operand.id;
+            _program.symbols.push_back(name);
+        } else {
+            operand.id = (*iter).second;
+        }
+        return operand;
+    }
+
+    /// Parses and resolves an expression.
+    ///
+    /// \param text The textual expression, without delimiters.
+    ///
+    /// \return The compiled expression.
+    ///
+    /// \throw text::syntax_error If the expression is malformed.
+    compiled_expression
+    compile_expression(const std::string& text)
+    {
+        const expression_def parsed = expression_def::parse(text);
+
+        compiled_expression expression;
+        expression.type = parsed.type;
+        switch (parsed.type) {
+        case expression_def::type_variable:
+        case expression_def::type_defined:
+            expression.name = resolve(parsed.name, true);
+            break;
+
+        case expression_def::type_length:
+            expression.name = resolve(parsed.name, false);
+            break;
+
+        case expression_def::type_index:
+            expression.name = resolve(parsed.name, false);
+            expression.index = resolve(parsed.index, true);
+            break;
+        }
+        return expression;
+    }
+
+    /// Gets the instruction to which to append output text.
+    ///
+    /// \return A reference to a print instruction at the end of the program.
+    instruction_def&
+    print_instruction(void)
+    {
+        if (!_can_append) {
+            _program.instructions.push_back(
+                instruction_def(instruction_def::op_print));
+            _can_append = true;
+        }
+        return _program.instructions.back();
+    }
+
+    /// Appends literal text to the output.
+    ///
+    /// \param text The text to append.
+    void
+    append_text(const std::string& text)
+    {
+        std::vector< segment_def >& segments = print_instruction().segments;
+        if (!segments.empty() && !segments.back().has_expression)
+            segments.back().text += text;
+        else
+            segments.push_back(segment_def(text));
+    }
+
+    /// Appends the value of an expression to the output.
+    ///
+    /// \param expression The expression to append.
+    void
+    append_expression(const compiled_expression& expression)
+    {
+        std::vector< segment_def >& segments = print_instruction().segments;
+        if (segments.empty() || segments.back().has_expression)
+            segments.push_back(segment_def(""));
+        segments.back().has_expression = true;
+        segments.back().expression = expression;
+    }
+
+    /// Compiles a line that is not a statement.
+    ///
+    /// This splits the line in the same way as templates_parser::evaluate().
+    ///
+    /// \param line The line to compile.
+    ///
+    /// \throw text::syntax_error If the expressions in the line are malformed.
+    void
+    compile_text(const std::string& line)
+    {
+        std::string::size_type last_pos = 0;
+        for (;;) {
+            const std::string::size_type open_pos = line.find(
+                _delimiter, last_pos);
+            const std::string::size_type close_pos =
+                open_pos == std::string::npos ? std::string::npos :
+                line.find(_delimiter, open_pos + _delimiter.length());
+            if (close_pos == std::string::npos) {
+                append_text(line.substr(last_pos) + '\n');
+                return;
+            }
+
+            append_text(line.substr(last_pos, open_pos - last_pos));
+            append_expression(compile_expression(line.substr(
+                open_pos + _delimiter.length(),
+                close_pos - open_pos - _delimiter.length())));
+            last_pos = close_pos + _delimiter.length();
+        }
+    }
+
+    /// Gets the innermost block, which must be of a given type.
+    ///
+    /// \param type The expected type of the block.
+    /// \param statement Name of the statement being compiled, for errors.
+    ///
+    /// \return A reference to the innermost block.
+    ///
+    /// \throw text::syntax_error If there is no block of the given type.
+    block_def&
+    current_block(const statement_def::statement_type type,
+                  const char* statement)
+    {
+        if (_blocks.empty() || _blocks.back().type != type)
+            throw text::syntax_error(F("Unexpected statement '%s'") %
+                                     statement);
+        return _blocks.back();
+    }
+
+    /// Compiles a statement line.
+    ///
+    /// \param line The line to compile; it must be a statement.
+    ///
+    /// \throw text::syntax_error If the statement is not valid.
+    void
+    compile_statement(const std::string& line)
+    {
+        if (line.find(_delimiter) != std::string::npos)
+            throw text::syntax_error(F("Expressions are not allowed in "
+                                       "statement '%s'") % line);
+
+        const statement_def statement = statement_def::parse(
+            line.substr(_prefix.length()));
+        std::vector< instruction_def >& instructions = _program.instructions;
+        _can_append = false;
+
+        switch (statement.type) {
+        case statement_def::type_else: {
+            block_def& block = current_block(statement_def::type_if, "else");
+            if (block.jump != 0)
+                throw text::syntax_error("Unexpected statement 'else'");
+            block.jump = instructions.size();
+            instructions.push_back(instruction_def(instruction_def::op_jump));
+            instructions[block.start].target = instructions.size();
+        } break;
+
+        case statement_def::type_endif: {
+            const block_def& block = current_block(statement_def::type_if,
+                                                   "endif");
+            instructions[block.jump != 0 ? block.jump : block.start].target =
+                instructions.size();
+            _blocks.pop_back();
+        } break;
+
+        case statement_def::type_endloop: {
+            const block_def& block = current_block(statement_def::type_loop,
+                                                   "endloop");
+            instruction_def instruction(instruction_def::op_endloop);
+            instruction.vector = instructions[block.start].vector;
+            instruction.depth = block.depth;
+            instruction.target = block.start + 1;
+            instructions.push_back(instruction);
+            instructions[block.start].target = instructions.size();
+            _blocks.pop_back();
+            _loop_level--;
+        } break;
+
+        case statement_def::type_if: {
+            instruction_def instruction(instruction_def::op_if);
+            instruction.condition = compile_expression(
+                statement.arguments[0]);
+            _blocks.push_back(block_def(statement_def::type_if,
+                                        instructions.size()));
+            instructions.push_back(instruction);
+        } break;
+
+        case statement_def::type_loop: {
+            instruction_def instruction(instruction_def::op_loop);
+            instruction.vector = resolve(statement.arguments[0], false);
+            instruction.depth = _loop_level;
+            block_def block(statement_def::type_loop, instructions.size());
+            block.depth = _loop_level;
+            block.iterator = statement.arguments[1];
+            _blocks.push_back(block);
+            instructions.push_back(instruction);
+            _loop_level++;
+            _program.loop_depth = std::max(_program.loop_depth, _loop_level);
+        } break;
+        }
+    }
+
+public:
+    /// Constructs a new template compiler.
+    ///
+    /// \param program_ The program into which to store the compiled template.
+    /// \param prefix_ The prefix that identifies lines as statements.
+    /// \param delimiter_ Delimiter to surround a variable instantiation.
+    templates_compiler(program_def& program_, const std::string& prefix_,
+                       const std::string& delimiter_) :
+        _program(program_),
+        _prefix(prefix_),
+        _delimiter(delimiter_),
+        _loop_level(0),
+        _can_append(false)
+    {
+    }
+
+    /// Compiles a given input.
+    ///
+    /// \param input The stream containing the template.
+    ///
+    /// \throw text::syntax_error If the input is not valid.
+    void
+    compile(std::istream& input)
+    {
+        std::string line;
+        while (std::getline(input, line).good()) {
+            if (line.length() >= _prefix.length() &&
+                line.compare(0, _prefix.length(), _prefix) == 0 &&
+                line.compare(0, _delimiter.length(), _delimiter) != 0)
+                compile_statement(line);
+            else
+                compile_text(line);
+        }
+
+        if (!_blocks.empty())
+            throw text::syntax_error(F("Missing '%s' statement") %
+                (_blocks.back().type == statement_def::type_if ?
+                 "endif" : "endloop"));
+    }
+};
+
+
+/// Stateful class to apply templates to a compiled template.
+class templates_executor : utils::noncopyable {
+    /// Convenience name for a vector of strings.
+    typedef std::vector< std::string > strings_vector;
+
+    /// The program to execute.
+    const program_def& _program;
+
+    /// Values of the global variables, indexed by slot; NULL if undefined.
+    std::vector< const std::string* > _variables;
+
+    /// Values of the global vectors, indexed by slot; NULL if undefined.
+    std::vector< const strings_vector* > _vectors;
+
+    /// Current index of every active loop, indexed by nesting level.
+    std::vector< std::size_t > _indexes;
+
+    /// Scratch space to hold the values of computed expressions.
+    std::string _buffer;
+
+    /// Gets the value of an operand that refers to a variable.
+    ///
+    /// \param operand The operand to query.
+    ///
+    /// \return The value of the variable.
+    ///
+    /// \throw text::syntax_error If the variable does not exist.
+    const std::string&
+    get_variable(const operand_def& operand)
+    {
+        if (operand.is_iterator) {
+            _buffer = F("%s") % _indexes[operand.id];
+            return _buffer;
+        }
+        const std::string* value = _variables[operand.id];
+        if (value == NULL)
+            throw text::syntax_error(F("Unknown variable '%s'") %
+                                     operand.name);
+        return *value;
+    }
+
+    /// Gets the contents of an operand that refers to a vector.
+    ///
+    /// \param operand The operand to query; cannot be an iterator.
+    ///
+    /// \return The contents of the vector.
+    ///
+    /// \throw text::syntax_error If the vector does not exist.
+    const strings_vector&
+    get_vector(const operand_def& operand) const
+    {
+        PRE(!operand.is_iterator);
+        const strings_vector* vector = _vectors[operand.id];
+        if (vector == NULL)
+            throw text::syntax_error(F("Unknown vector '%s'") % operand.name);
+        return *vector;
+    }
+
+    /// Gets the position held by an index operand.
+    ///
+    /// \param operand The operand to query.
+    ///
+    /// \return The index.
+    ///
+    /// \throw text::syntax_error If the variable does not exist or is not an
+    ///     integer.
+    std::size_t
+    get_index(const operand_def& operand)
+    {
+        if (operand.is_iterator)
+            return _indexes[operand.id];
+
+        const std::string& index_str = get_variable(operand);
+        try {
+            return text::to_type< std::size_t >(index_str);
+        } catch (const text::value_error& e) {
+            throw text::syntax_error(F("Index '%s' not an integer, value "
+                                       "'%s'") % operand.name % index_str);
+        }
+    }
+
+    /// Evaluates an expression.
+    ///
+    /// \param expression The expression to evaluate.
+    ///
+    /// \return The value of the expression.  The reference is only valid until
+    /// the next evaluation.
+    ///
+    /// \throw text::syntax_error If the expression cannot be evaluated.
+    const std::string&
+    evaluate(const compiled_expression& expression)
+    {
+        switch (expression.type) {
+        case expression_def::type_variable:
+            return get_variable(expression.name);
+
+        case expression_def::type_defined:
+            _buffer = (expression.name.is_iterator ||
+                       _variables[expression.name.id] != NULL ||
+                       _vectors[expression.name.id] != NULL) ?
+                "true" : "false";
+            return _buffer;
+
+        case expression_def::type_length:
+            _buffer = F("%s") % get_vector(expression.name).size();
+            return _buffer;
+
+        case expression_def::type_index: {
+            const strings_vector& vector = get_vector(expression.name);
+            const std::size_t index = get_index(expression.index);
+            if (index >= vector.size())
+                throw text::syntax_error(F("Index '%s' out of range at "
+                                           "position '%s'") %
+                                         expression.index.name % index);
+            return vector[index];
+        }
+        }
+        UNREACHABLE;
+    }
+
+public:
+    /// Constructs a new executor.
+    ///
+    /// \param program_ The compiled template to execute.
+    /// \param templates The templates to apply to the program.  Must remain
+    ///     unmodified while the executor is alive.
+    templates_executor(const program_def& program_,
+                       const text::templates_def& templates) :
+        _program(program_),
+        _indexes(program_.loop_depth)
+    {
+        _variables.reserve(_program.symbols.size());
+        _vectors.reserve(_program.symbols.size());
+        for (std::vector< std::string >::const_iterator iter =
+                 _program.symbols.begin(); iter != _program.symbols.end();
+             ++iter) {
+            _variables.push_back(templates.find_variable(*iter));
+            _vectors.push_back(templates.find_vector(*iter));
+        }
+    }
+
+    /// Executes the program.
+    ///
+    /// \param output The stream into which to write the results.
+    ///
+    /// \throw text::syntax_error If any expression cannot be evaluated.  Note
+    ///     that the output is not guaranteed to be unmodified on exit if an
+    ///     error is encountered.
+    void
+    execute(std::ostream& output)
+    {
+        const std::vector< instruction_def >& instructions =
+            _program.instructions;
+
+        std::size_t pc = 0;
+        while (pc < instructions.size()) {
+            const instruction_def& instruction = instructions[pc];
+            switch (instruction.op) {
+            case instruction_def::op_print:
+                for (std::vector< segment_def >::const_iterator iter =
+                         instruction.segments.begin();
+                     iter != instruction.segments.end(); ++iter) {
+                    output << (*iter).text;
+                    if ((*iter).has_expression)
+                        output << evaluate((*iter).expression);
+                }
+                pc++;
+                break;
+
+            case instruction_def::op_if: {
+                const std::string& value = evaluate(instruction.condition);
+                if (value.empty() || value == "0" || value == "false")
+                    pc = instruction.target;
+                else
+                    pc++;
+            } break;
+
+            case instruction_def::op_jump:
+                pc = instruction.target;
+                break;
+
+            case instruction_def::op_loop:
+                if (get_vector(instruction.vector).empty()) {
+                    pc = instruction.target;
+                } else {
+                    _indexes[instruction.depth] = 0;
+                    pc++;
+                }
+                break;
+
+            case instruction_def::op_endloop:
+                if (++_indexes[instruction.depth] <
+                    get_vector(instruction.vector).size())
+                    pc = instruction.target;
+                else
+                    pc++;
+                break;
+            }
+        }
+    }
+};
+
+
 }  // anonymous namespace
 
 
@@ -648,6 +1382,34 @@ text::templates_def::get_vector(const std::string& name) const
 }
 
 
+/// Looks up a variable without raising an error if it does not exist.
+///
+/// \param name The name of the variable.
+///
+/// \return A pointer to the value of the variable, valid until the templates
+/// are modified, or NULL if the variable does not exist.
+const std::string*
+text::templates_def::find_variable(const std::string& name) const
+{
+    const variables_map::const_iterator iter = _variables.find(name);
+    return iter == _variables.end() ? NULL : &(*iter).second;
+}
+
+
+/// Looks up a vector without raising an error if it does not exist.
+///
+/// \param name The name of the vector.
+///
+/// \return A pointer to the vector, valid until the templates are modified, or
+/// NULL if the vector does not exist.
+const text::templates_def::strings_vector*
+text::templates_def::find_vector(const std::string& name) const
+{
+    const vectors_map::const_iterator iter = _vectors.find(name);
+    return iter == _vectors.end() ? NULL : &(*iter).second;
+}
+
+
 /// Indexes a vector and gets the value.
 ///
 /// \param name The name of the vector to index.
@@ -668,7 +1430,7 @@ text::templates_def::get_vector(const std::string& name,
     std::size_t index;
     try {
         index = text::to_type< std::size_t >(index_str);
-    } catch (const text::syntax_error& e) {
+    } catch (const text::value_error& e) {
         throw text::syntax_error(F("Index '%s' not an integer, value '%s'") %
                                  index_name % index_str);
     }
@@ -697,30 +1459,21 @@ text::templates_def::get_vector(const std::string& name,
 std::string
 text::templates_def::evaluate(const std::string& expression) const
 {
-    const std::string::size_type paren_open = expression.find('(');
-    if (paren_open == std::string::npos) {
-        return get_variable(expression);
-    } else {
-        const std::string::size_type paren_close = expression.find(
-            ')', paren_open);
-        if (paren_close == std::string::npos)
-            throw text::syntax_error(F("Expected ')' in expression '%s')") %
-                                     expression);
-        if (paren_close != expression.length() - 1)
-            throw text::syntax_error(F("Unexpected text found after ')' in "
-                                       "expression '%s'") % expression);
+    const expression_def parsed = expression_def::parse(expression);
+    switch (parsed.type) {
+    case expression_def::type_variable:
+        return get_variable(parsed.name);
 
-        const std::string arg0 = expression.substr(0, paren_open);
-        const std::string arg1 = expression.substr(
-            paren_open + 1, paren_close - paren_open - 1);
-        if (arg0 == "defined") {
-            return exists(arg1) ? "true" : "false";
-        } else if (arg0 == "length") {
-            return F("%s") % get_vector(arg1).size();
-        } else {
-            return get_vector(arg0, arg1);
-        }
+    case expression_def::type_defined:
+        return exists(parsed.name) ? "true" : "false";
+
+    case expression_def::type_length:
+        return F("%s") % get_vector(parsed.name).size();
+
+    case expression_def::type_index:
+        return get_vector(parsed.name, parsed.index);
     }
+    UNREACHABLE;
 }
 
 
@@ -762,3 +1515,65 @@ text::instantiate(const templates_def& templates,
 
     instantiate(templates, input, output);
 }
+
+
+/// Internal implementation of a compiled_template.
+struct utils::text::compiled_template::impl : utils::noncopyable {
+    /// The instructions generated from the template.
+    program_def program;
+};
+
+
+/// Constructs a new compiled template from its internal implementation.
+///
+/// \param pimpl The internal implementation.
+text::compiled_template::compiled_template(std::shared_ptr< impl > pimpl) :
+    _pimpl(pimpl)
+{
+}
+
+
+/// Destructor.
+text::compiled_template::~compiled_template(void)
+{
+}
+
+
+/// Preprocesses a template for later instantiation.
+///
+/// Contrary to the instantiate() variants that process the input directly,
+/// this validates the structure of the whole template upfront: unknown
+/// statements, unbalanced conditionals and loops and malformed expressions are
+/// reported even if they would not have been reached.
+///
+/// \param input The template to compile.
+///
+/// \return The compiled template.
+///
+/// \throw text::syntax_error If the template is not valid.
+text::compiled_template
+text::compile(std::istream& input)
+{
+    std::shared_ptr< compiled_template::impl > pimpl(
+        new compiled_template::impl());
+    templates_compiler compiler(pimpl->program, "%", "%%");
+    compiler.compile(input);
+    return compiled_template(pimpl);
+}
+
+
+/// Applies a set of templates to a compiled template.
+///
+/// \param templates The templates to use.
+/// \param input The compiled template to process.
+/// \param output The stream to which to write the processed text.
+///
+/// \throw text::syntax_error If there is any problem evaluating the
+///     expressions in the template.
+void
+text::instantiate(const templates_def& templates,
+                  const compiled_template& input, std::ostream& output)
+{
+    templates_executor executor(input._pimpl->program, templates);
+    executor.execute(output);
+}
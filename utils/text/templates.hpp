@@ -63,6 +63,7 @@
 #include <vector>
 
 #include "utils/fs/path_fwd.hpp"
+#include "utils/shared_ptr.hpp"
 
 namespace utils {
 namespace text {
@@ -108,12 +109,44 @@ public:
     const std::string& get_variable(const std::string&) const;
     const strings_vector& get_vector(const std::string&) const;
 
+    const std::string* find_variable(const std::string&) const;
+    const strings_vector* find_vector(const std::string&) const;
+
     std::string evaluate(const std::string&) const;
 };
 
 
+/// Template preprocessed for repeated instantiation.
+///
+/// A compiled template holds the statements and expressions of a template in
+/// parsed form, with every identifier mapped to a slot that is resolved only
+/// once per instantiation.  This avoids rescanning the template text and
+/// reparsing its contents when the same template has to be applied to many
+/// different definitions.
+///
+/// Compiled templates are immutable and cheap to copy.
+class compiled_template {
+    struct impl;
+
+    /// Pointer to the shared internal implementation.
+    std::shared_ptr< impl > _pimpl;
+
+    compiled_template(std::shared_ptr< impl >);
+
+    friend compiled_template compile(std::istream&);
+    friend void instantiate(const templates_def&, const compiled_template&,
+                            std::ostream&);
+
+public:
+    ~compiled_template(void);
+};
+
+
+compiled_template compile(std::istream&);
+
 void instantiate(const templates_def&, std::istream&, std::ostream&);
 void instantiate(const templates_def&, const fs::path&, const fs::path&);
+void instantiate(const templates_def&, const compiled_template&, std::ostream&);
 
 
 }  // namespace text
@@ -0,0 +1,138 @@
+// Copyright 2026 The Kyua Authors.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// \file utils/text/templates_bench.cpp
+/// Benchmarks for text::instantiate.
+
+#include "utils/text/templates.hpp"
+
+#include <cstddef>
+#include <sstream>
+#include <string>
+
+#include <atf-c++.hpp>
+
+#include "utils/datetime.hpp"
+#include "utils/format/macros.hpp"
+#include "utils/test_utils.ipp"
+
+namespace datetime = utils::datetime;
+namespace text = utils::text;
+
+
+namespace {
+
+
+/// Template that resembles the ones used by kyua report-html.
+static const char* report_template =
+    "<h1>%%title%%</h1>\n"
+    "%if defined(results)\n"
+    "<ul>\n"
+    "%loop results iter\n"
+    "<li>%%results(iter)%%: %%durations(iter)%%</li>\n"
+    "%endloop\n"
+    "</ul>\n"
+    "%else\n"
+    "<p>No results</p>\n"
+    "%endif\n";
+
+
+/// Generates the definitions to apply to report_template.
+///
+/// \return A new templates definition.
+static text::templates_def
+report_templates(void)
+{
+    text::templates_def templates;
+    templates.add_variable("title", "Summary of the test run");
+    templates.add_vector("results");
+    templates.add_vector("durations");
+    for (int i = 0; i < 100; ++i) {
+        templates.add_to_vector("results", F("test_program_%s:main") % i);
+        templates.add_to_vector("durations", F("%s.000s") % i);
+    }
+    return templates;
+}
+
+
+}  // anonymous namespace
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(instantiate__report);
+ATF_TEST_CASE_BODY(instantiate__report)
+{
+    utils::require_run_benchmarks(this);
+    const std::size_t iterations = utils::benchmark_iterations(this, 1000);
+
+    const std::string input = report_template;
+    const text::templates_def templates = report_templates();
+
+    std::size_t bytes = 0;
+    const datetime::timestamp start = datetime::timestamp::now();
+    for (std::size_t i = 0; i < iterations; ++i) {
+        std::istringstream in(input);
+        std::ostringstream out;
+        text::instantiate(templates, in, out);
+        bytes += out.str().length();
+    }
+    utils::report_benchmark(this, iterations,
+                            datetime::timestamp::now() - start);
+
+    ATF_REQUIRE(bytes > 0);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(instantiate__report__compiled);
+ATF_TEST_CASE_BODY(instantiate__report__compiled)
+{
+    utils::require_run_benchmarks(this);
+    const std::size_t iterations = utils::benchmark_iterations(this, 1000);
+
+    std::istringstream input(report_template);
+    const text::compiled_template compiled = text::compile(input);
+    const text::templates_def templates = report_templates();
+
+    std::size_t bytes = 0;
+    const datetime::timestamp start = datetime::timestamp::now();
+    for (std::size_t i = 0; i < iterations; ++i) {
+        std::ostringstream out;
+        text::instantiate(templates, compiled, out);
+        bytes += out.str().length();
+    }
+    utils::report_benchmark(this, iterations,
+                            datetime::timestamp::now() - start);
+
+    ATF_REQUIRE(bytes > 0);
+}
+
+
+ATF_INIT_TEST_CASES(tcs)
+{
+    ATF_ADD_TEST_CASE(tcs, instantiate__report);
+    ATF_ADD_TEST_CASE(tcs, instantiate__report__compiled);
+}
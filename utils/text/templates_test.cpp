@@ -44,10 +44,32 @@ namespace text = utils::text;
 namespace {
 
 
+/// Compiles an input string and applies a set of templates to it.
+///
+/// \param templates The templates to apply.
+/// \param input_str The input document to compile.
+///
+/// \return The generated document.
+///
+/// \throw text::syntax_error If the compilation or the instantiation fail.
+static std::string
+compile_and_instantiate(const text::templates_def& templates,
+                        const std::string& input_str)
+{
+    std::istringstream input(input_str);
+    const text::compiled_template compiled = text::compile(input);
+
+    std::ostringstream output;
+    text::instantiate(templates, compiled, output);
+    return output.str();
+}
+
+
 /// Applies a set of templates to an input string and validates the output.
 ///
 /// This fails the test case if exp_output does not match the document generated
-/// by the application of the templates.
+/// by the application of the templates, either directly or after compiling the
+/// input.
 ///
 /// \param templates The templates to apply.
 /// \param input_str The input document to which to apply the templates.
@@ -61,6 +83,10 @@ do_test_ok(const text::templates_def& templates, const std::string& input_str,
 
     text::instantiate(templates, input, output);
     ATF_REQUIRE_EQ(exp_output, output.str());
+
+    const std::string compiled_output = compile_and_instantiate(templates,
+                                                                input_str);
+    ATF_REQUIRE_EQ(exp_output, compiled_output);
 }
 
 
@@ -81,6 +107,21 @@ do_test_fail(const text::templates_def& templates, const std::string& input_str,
 
     ATF_REQUIRE_THROW_RE(text::syntax_error, exp_message,
                          text::instantiate(templates, input, output));
+    ATF_REQUIRE_THROW_RE(text::syntax_error, exp_message,
+                         compile_and_instantiate(templates, input_str));
+}
+
+
+/// Compiles an input string and checks for an error.
+///
+/// \param input_str The input document to compile.
+/// \param exp_message The expected error message in the raised exception.
+static void
+do_compile_fail(const std::string& input_str, const std::string& exp_message)
+{
+    std::istringstream input(input_str);
+    ATF_REQUIRE_THROW_RE(text::syntax_error, exp_message,
+                         text::compile(input));
 }
 
 
@@ -899,6 +940,109 @@ ATF_TEST_CASE_BODY(instantiate__invalid_narguments)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(compile__reuse);
+ATF_TEST_CASE_BODY(compile__reuse)
+{
+    std::istringstream input(
+        "%if defined(names)\n"
+        "%loop names i\n"
+        "%%i%%: %%names(i)%%\n"
+        "%endloop\n"
+        "%else\n"
+        "%%title%%\n"
+        "%endif\n");
+    const text::compiled_template compiled = text::compile(input);
+
+    text::templates_def templates1;
+    templates1.add_vector("names");
+    templates1.add_to_vector("names", "foo");
+    templates1.add_to_vector("names", "bar");
+    std::ostringstream output1;
+    text::instantiate(templates1, compiled, output1);
+    ATF_REQUIRE_EQ("0: foo\n1: bar\n", output1.str());
+
+    text::templates_def templates2;
+    templates2.add_variable("title", "No names");
+    std::ostringstream output2;
+    text::instantiate(templates2, compiled, output2);
+    ATF_REQUIRE_EQ("No names\n", output2.str());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(compile__iterator_shadows_variable);
+ATF_TEST_CASE_BODY(compile__iterator_shadows_variable)
+{
+    const std::string input =
+        "%%i%%\n"
+        "%loop table i\n"
+        "%%i%%\n"
+        "%endloop\n"
+        "%%i%%\n";
+
+    text::templates_def templates;
+    templates.add_variable("i", "global");
+    templates.add_vector("table");
+    templates.add_to_vector("table", "a");
+    templates.add_to_vector("table", "b");
+
+    ATF_REQUIRE_EQ("global\n0\n1\nglobal\n",
+                   compile_and_instantiate(templates, input));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(compile__index_variable);
+ATF_TEST_CASE_BODY(compile__index_variable)
+{
+    const std::string input = "%%table(pos)%%\n";
+
+    text::templates_def templates;
+    templates.add_vector("table");
+    templates.add_to_vector("table", "a");
+    templates.add_to_vector("table", "b");
+    templates.add_variable("pos", "1");
+    ATF_REQUIRE_EQ("b\n", compile_and_instantiate(templates, input));
+
+    templates.add_variable("pos", "x");
+    do_test_fail(templates, input, "Index 'pos' not an integer");
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(compile__missing_end);
+ATF_TEST_CASE_BODY(compile__missing_end)
+{
+    do_compile_fail("%if a\n", "Missing 'endif' statement");
+    do_compile_fail("%loop a i\n", "Missing 'endloop' statement");
+    do_compile_fail("%loop a i\n%if b\n%endloop\n",
+                    "Unexpected statement 'endloop'");
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(compile__unexpected_statement);
+ATF_TEST_CASE_BODY(compile__unexpected_statement)
+{
+    do_compile_fail("%else\n", "Unexpected statement 'else'");
+    do_compile_fail("%endif\n", "Unexpected statement 'endif'");
+    do_compile_fail("%endloop\n", "Unexpected statement 'endloop'");
+    do_compile_fail("%if a\n%else\n%else\n%endif\n",
+                    "Unexpected statement 'else'");
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(compile__errors_in_skipped_code);
+ATF_TEST_CASE_BODY(compile__errors_in_skipped_code)
+{
+    do_compile_fail("%if false\n%%a(b%%\n%endif\n", "Expected '\\)'");
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(compile__expression_in_statement);
+ATF_TEST_CASE_BODY(compile__expression_in_statement)
+{
+    do_compile_fail("%if %%a%%\n%endif\n",
+                    "Expressions are not allowed in statement");
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(instantiate__files__ok);
 ATF_TEST_CASE_BODY(instantiate__files__ok)
 {
@@ -995,6 +1139,14 @@ ATF_INIT_TEST_CASES(tcs)
     ATF_ADD_TEST_CASE(tcs, instantiate__unknown_statement);
     ATF_ADD_TEST_CASE(tcs, instantiate__invalid_narguments);
 
+    ATF_ADD_TEST_CASE(tcs, compile__reuse);
+    ATF_ADD_TEST_CASE(tcs, compile__iterator_shadows_variable);
+    ATF_ADD_TEST_CASE(tcs, compile__index_variable);
+    ATF_ADD_TEST_CASE(tcs, compile__missing_end);
+    ATF_ADD_TEST_CASE(tcs, compile__unexpected_statement);
+    ATF_ADD_TEST_CASE(tcs, compile__errors_in_skipped_code);
+    ATF_ADD_TEST_CASE(tcs, compile__expression_in_statement);
+
     ATF_ADD_TEST_CASE(tcs, instantiate__files__ok);
     ATF_ADD_TEST_CASE(tcs, instantiate__files__input_error);
     ATF_ADD_TEST_CASE(tcs, instantiate__files__output_error);